@@ -13,6 +13,9 @@ option(USE_IMAGEMAGICK "Use ImageMagick library for image import." OFF)
 option(USE_DARKTABLE_PROFILING OFF)
 option(CUSTOM_CFLAGS "Don't override compiler optimization flags." OFF)
 option(BINARY_PACKAGE_BUILD "Sets march optimization to generic" OFF)
+option(USE_TARGET_CLONES "Build CPU specific variants of the pixel processing loops, selected at startup" ON)
+set(TARGET_CLONES_X86_64 "default;sse2;sse3;sse4.1;sse4.2;popcnt;avx;avx2;avx512f;fma4" CACHE STRING
+    "x86_64 instruction sets the pixel processing loops are built for, used with USE_TARGET_CLONES")
 option(USE_XMLLINT "Run xmllint to test if darktableconfig.xml is valid" ON)
 option(USE_PORTMIDI "Enable MIDI device support using PortMidi" ON)
 option(USE_OPENJPEG "Enable JPEG 2000 support" ON)
@@ -49,3 +52,9 @@ if(APPLE)
 else(APPLE)
     set(USE_MAC_INTEGRATION OFF)
 endif(APPLE)
+
+if(APPLE)
+    option(USE_METAL "Set up a Metal compute device on macOS (experimental, not used by the pixelpipe yet)" OFF)
+else(APPLE)
+    set(USE_METAL OFF)
+endif(APPLE)
@@ -49,6 +49,49 @@ rawprepare_1f(read_only image2d_t in, write_only image2d_t out,
   write_imagef(out, (int2)(x, y), pixel_scaled);
 }
 
+/* hot pixels on a single plane sensor: offsets holds for each site of the 6x6
+   sensor period the four nearest sites of the same color as x/y pairs */
+kernel void
+hotpixels_1f(read_only image2d_t in, write_only image2d_t out,
+             const int width, const int height, const int border,
+             const float threshold, const float multiplier,
+             const int min_neighbours,
+             global const int *offsets, global int *fixed)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float pixel = read_imagef(in, sampleri, (int2)(x, y)).x;
+  float result = pixel;
+
+  if(pixel > threshold
+     && x >= border && y >= border && x < width - border && y < height - border)
+  {
+    const float mid = pixel * multiplier;
+    global const int *off = offsets + 8 * (6 * (y % 6) + (x % 6));
+    int count = 0;
+    float maxin = 0.0f;
+    for(int n = 0; n < 4; n++)
+    {
+      const float other = read_imagef(in, sampleri, (int2)(x + off[2 * n], y + off[2 * n + 1])).x;
+      if(mid > other)
+      {
+        count++;
+        maxin = fmax(maxin, other);
+      }
+    }
+    if(count >= min_neighbours)
+    {
+      result = maxin;
+      atomic_inc(fixed);
+    }
+  }
+
+  write_imagef(out, (int2)(x, y), result);
+}
+
 kernel void
 rawprepare_1f_gainmap(read_only image2d_t in, write_only image2d_t out,
               const int width, const int height,
@@ -3377,122 +3420,39 @@ overexposed (read_only image2d_t in,
 }
 
 
-/* kernel for the rawoverexposed plugin. */
+/* kernel for the rawoverexposed plugin. overlay holds 0 for pixels that
+   weren't clipped in the raw, 1 + their cfa color otherwise. */
 kernel void
-rawoverexposed_mark_cfa (read_only image2d_t in,
-                         write_only image2d_t out,
-                         global float *pi,
-                         const int width,
-                         const int height,
-                         read_only image2d_t raw,
-                         const int raw_width,
-                         const int raw_height,
-                         const unsigned int filters,
-                         global const unsigned char (*const xtrans)[6],
-                         global unsigned int *threshold,
-                         global float4 *colors)
-{
-  const int x = get_global_id(0);
-  const int y = get_global_id(1);
-
-  if(x >= width || y >= height) return;
-
-  const int piwidth = 2*width;
-  global float *ppi = pi + mad24(y, piwidth, 2*x);
-
-  const int raw_x = ppi[0];
-  const int raw_y = ppi[1];
-
-  if(raw_x < 0 || raw_y < 0 || raw_x >= raw_width || raw_y >= raw_height) return;
-
-  const uint raw_pixel = read_imageui(raw, sampleri, (int2)(raw_x, raw_y)).x;
-
-  const int c = fcol(raw_y, raw_x, filters, xtrans);
-  if(raw_pixel < threshold[c]) return;
-
-  float4 pixel = fmax(0.0f, read_imagef(in, sampleri, (int2)(x, y)));
-  const float4 color = colors[c & 3];
-
-  // cfa color
-  pixel.xyz = color.xyz;
-  write_imagef (out, (int2)(x, y), pixel);
-}
-
-kernel void
-rawoverexposed_mark_solid (read_only image2d_t in,
-                           write_only image2d_t out,
-                           global float *pi,
-                           const int width,
-                           const int height,
-                           read_only image2d_t raw,
-                           const int raw_width,
-                           const int raw_height,
-                           const unsigned int filters,
-                           global const unsigned char (*const xtrans)[6],
-                           global unsigned int *threshold,
-                           const float4 solid_color)
+rawoverexposed_mark (read_only image2d_t in,
+                     write_only image2d_t out,
+                     global const unsigned char *overlay,
+                     const int width,
+                     const int height,
+                     const int mode,
+                     global float4 *colors,
+                     const float4 solid_color)
 {
   const int x = get_global_id(0);
   const int y = get_global_id(1);
 
   if(x >= width || y >= height) return;
 
-  const int piwidth = 2*width;
-  global float *ppi = pi + mad24(y, piwidth, 2*x);
-
-  const int raw_x = ppi[0];
-  const int raw_y = ppi[1];
-
-  if(raw_x < 0 || raw_y < 0 || raw_x >= raw_width || raw_y >= raw_height) return;
-
-  const uint raw_pixel = read_imageui(raw, sampleri, (int2)(raw_x, raw_y)).x;
-
-  const int c = fcol(raw_y, raw_x, filters, xtrans);
-  if(raw_pixel < threshold[c]) return;
+  const int code = overlay[mad24(y, width, x)];
+  if(!code) return;
 
+  const int c = code - 1;
   float4 pixel = fmax(0.0f, read_imagef(in, sampleri, (int2)(x, y)));
 
-  // solid color
-  pixel.xyz = solid_color.xyz;
-
-  write_imagef (out, (int2)(x, y), pixel);
-}
-
-kernel void
-rawoverexposed_falsecolor (read_only image2d_t in,
-                           write_only image2d_t out,
-                           global float *pi,
-                           const int width,
-                           const int height,
-                           read_only image2d_t raw,
-                           const int raw_width,
-                           const int raw_height,
-                           const unsigned int filters,
-                           global const unsigned char (*const xtrans)[6],
-                           global unsigned int *threshold)
-{
-  const int x = get_global_id(0);
-  const int y = get_global_id(1);
-
-  if(x >= width || y >= height) return;
-
-  const int piwidth = 2*width;
-  global float *ppi = pi + mad24(y, piwidth, 2*x);
-
-  const int raw_x = ppi[0];
-  const int raw_y = ppi[1];
-
-  if(raw_x < 0 || raw_y < 0 || raw_x >= raw_width || raw_y >= raw_height) return;
-
-  const uint raw_pixel = read_imageui(raw, sampleri, (int2)(raw_x, raw_y)).x;
-
-  const int c = fcol(raw_y, raw_x, filters, xtrans);
-  if(raw_pixel < threshold[c]) return;
-
-  float4 pixel = fmax(0.0f, read_imagef(in, sampleri, (int2)(x, y)));
-  if(c == 2)      pixel.z = 0.0f;
-  else if(c == 1) pixel.y = 0.0f;
-  else if(c == 0) pixel.x = 0.0f;
+  if(mode == 0)       // cfa color
+    pixel.xyz = colors[c & 3].xyz;
+  else if(mode == 1)  // solid color
+    pixel.xyz = solid_color.xyz;
+  else if(c == 2)     // false color
+    pixel.z = 0.0f;
+  else if(c == 1)
+    pixel.y = 0.0f;
+  else if(c == 0)
+    pixel.x = 0.0f;
 
   write_imagef (out, (int2)(x, y), pixel);
 }
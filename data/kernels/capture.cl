@@ -167,6 +167,100 @@ __kernel void kernel_9x9_div(global float *in,
   out[i] = luminance[i] / fmax(val, CAPTURE_YMIN);
 }
 
+static inline float _blur_9x9_local(local const float *d,
+                                    const int wd,
+                                    global const float *kern,
+                                    const int bd)
+{
+  float val = 0.0f;
+  for(int ir = -bd; ir <= bd; ir++)
+    for(int ic = -bd; ic <= bd; ic++)
+      val += kern[5 * abs(ir) + abs(ic)] * d[mad24(ir, wd, ic)];
+  return val;
+}
+
+/* one deconvolution iteration as kernel_9x9_div followed by kernel_9x9_mul.
+   the estimate with a border of 8 and the ratio with a border of 4 are
+   kept in local memory, only the new estimate is written to out. ratio
+   holds the values used for pixels outside the blend mask. the gauss
+   coefficients are zero outside the radius so the full 5x5 or 9x9 loops
+   give the same sums as the unrolled ones, zero padding the same as the
+   clipped borders. */
+__kernel void kernel_9x9_iter(global float *in,
+                              global float *out,
+                              global float *ratio,
+                              global float *luminance,
+                              global float *blend,
+                              global float *kernels,
+                              global unsigned char *table,
+                              const int w1,
+                              const int height,
+                              local float *estimate,
+                              local float *quotient)
+{
+  const int lxid = get_local_id(0);
+  const int lyid = get_local_id(1);
+  const int lxsz = get_local_size(0);
+  const int lysz = get_local_size(1);
+  const int col = get_global_id(0);
+  const int row = get_global_id(1);
+  const int x0 = col - lxid;
+  const int y0 = row - lyid;
+  const int gsz = lxsz * lysz;
+  const int lidx = mad24(lyid, lxsz, lxid);
+
+  const int ewd = lxsz + 16;
+  const int esz = ewd * (lysz + 16);
+  for(int k = lidx; k < esz; k += gsz)
+  {
+    const int gx = x0 + k % ewd - 8;
+    const int gy = y0 + k / ewd - 8;
+    estimate[k] = (gx >= 0 && gy >= 0 && gx < w1 && gy < height) ? in[mad24(gy, w1, gx)] : 0.0f;
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  const int qwd = lxsz + 8;
+  const int qsz = qwd * (lysz + 8);
+  for(int k = lidx; k < qsz; k += gsz)
+  {
+    const int qx = k % qwd;
+    const int qy = k / qwd;
+    const int gx = x0 + qx - 4;
+    const int gy = y0 + qy - 4;
+    float q = 0.0f;
+    if(gx >= 0 && gy >= 0 && gx < w1 && gy < height)
+    {
+      const int j = mad24(gy, w1, gx);
+      if(blend[j] > 0.0f)
+      {
+        const float val = _blur_9x9_local(estimate + mad24(qy + 4, ewd, qx + 4), ewd,
+                                          kernels + CAPTURE_KERNEL_ALIGN * table[j],
+                                          table[j] < CAPTURE_SMALL_ULIM ? 2 : 4);
+        q = luminance[j] / fmax(val, CAPTURE_YMIN);
+      }
+      else
+        q = ratio[j];
+    }
+    quotient[k] = q;
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if(col >= w1 || row >= height) return;
+
+  const int i = mad24(row, w1, col);
+  const float est = estimate[mad24(lyid + 8, ewd, lxid + 8)];
+  if(blend[i] <= 0.0f)
+  {
+    out[i] = est;
+    return;
+  }
+
+  const float val = _blur_9x9_local(quotient + mad24(lyid + 4, qwd, lxid + 4), qwd,
+                                    kernels + CAPTURE_KERNEL_ALIGN * table[i],
+                                    table[i] < CAPTURE_SMALL_ULIM ? 2 : 4);
+  out[i] = est * val;
+}
+
 __kernel void prepare_blend(__read_only image2d_t cfa,
                             __read_only image2d_t dev_out,
                             const int filters,
@@ -0,0 +1,287 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common.h"
+
+// keep in sync with src/common/luminance_mask.h and src/iop/toneequal.c
+#define DT_TONEEQ_MEAN 0
+#define DT_TONEEQ_LIGHTNESS 1
+#define DT_TONEEQ_VALUE 2
+#define DT_TONEEQ_NORM_1 3
+#define DT_TONEEQ_NORM_2 4
+#define DT_TONEEQ_NORM_POWER 5
+#define DT_TONEEQ_GEOMEAN 6
+
+#define DT_TONEEQ_MIN_EV (-8.0f)
+#define DT_TONEEQ_MAX_EV (0.0f)
+#define TONEEQ_MIN_FLOAT 1.52587890625e-05f // exp2f(-16.0f)
+
+static inline float _linear_contrast(const float pixel, const float fulcrum, const float contrast)
+{
+  return fmax((pixel - fulcrum) * contrast + fulcrum, TONEEQ_MIN_FLOAT);
+}
+
+__kernel void
+toneeq_luminance(read_only image2d_t in,
+                 global float *luminance,
+                 const int width,
+                 const int height,
+                 const int method,
+                 const float exposure_boost,
+                 const float fulcrum,
+                 const float contrast_boost)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float4 pixel = read_imagef(in, samplerA, (int2)(x, y));
+  float lum;
+  switch(method)
+  {
+    case DT_TONEEQ_MEAN:
+      lum = (pixel.x + pixel.y + pixel.z) / 3.0f;
+      break;
+    case DT_TONEEQ_LIGHTNESS:
+      lum = (fmax(fmax(pixel.x, pixel.y), pixel.z) + fmin(fmin(pixel.x, pixel.y), pixel.z)) / 2.0f;
+      break;
+    case DT_TONEEQ_VALUE:
+      lum = fmax(fmax(pixel.x, pixel.y), pixel.z);
+      break;
+    case DT_TONEEQ_NORM_1:
+      lum = fabs(pixel.x) + fabs(pixel.y) + fabs(pixel.z);
+      break;
+    case DT_TONEEQ_NORM_POWER:
+    {
+      const float4 value = fabs(pixel);
+      const float4 square = value * value;
+      lum = (square.x * value.x + square.y * value.y + square.z * value.z)
+            / (square.x + square.y + square.z);
+      break;
+    }
+    case DT_TONEEQ_GEOMEAN:
+      lum = pow(fabs(pixel.x * pixel.y * pixel.z), 1.0f / 3.0f);
+      break;
+    case DT_TONEEQ_NORM_2:
+    default:
+      lum = sqrt(pixel.x * pixel.x + pixel.y * pixel.y + pixel.z * pixel.z);
+      break;
+  }
+
+  luminance[mad24(y, width, x)] = _linear_contrast(exposure_boost * lum, fulcrum, contrast_boost);
+}
+
+// same sampling as interpolate_bilinear() in src/common/fast_guided_filter.h
+static inline void _bilinear_coords(const int x, const int y,
+                                    const int width_in, const int height_in,
+                                    const int width_out, const int height_out,
+                                    int *k_nw, int *k_ne, int *k_sw, int *k_se,
+                                    float *dx_next, float *dy_next)
+{
+  const float x_in = (float)x / (float)width_out * (float)width_in;
+  const float y_in = (float)y / (float)height_out * (float)height_in;
+
+  const int x_prev = (int)floor(x_in);
+  const int y_prev = (int)floor(y_in);
+  const int x_next = min(x_prev + 1, width_in - 1);
+  const int y_next = min(y_prev + 1, height_in - 1);
+
+  *dx_next = (float)x_next - x_in;
+  *dy_next = (float)y_next - y_in;
+
+  const int xp = min(x_prev, width_in - 1);
+  const int yp = min(y_prev, height_in - 1);
+  *k_nw = mad24(yp, width_in, xp);
+  *k_ne = mad24(yp, width_in, x_next);
+  *k_sw = mad24(y_next, width_in, xp);
+  *k_se = mad24(y_next, width_in, x_next);
+}
+
+__kernel void
+toneeq_downsample(global const float *in,
+                  const int width_in,
+                  const int height_in,
+                  global float *out,
+                  const int width_out,
+                  const int height_out)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width_out || y >= height_out) return;
+
+  int k_nw, k_ne, k_sw, k_se;
+  float dx_next, dy_next;
+  _bilinear_coords(x, y, width_in, height_in, width_out, height_out,
+                   &k_nw, &k_ne, &k_sw, &k_se, &dx_next, &dy_next);
+  const float dx_prev = 1.0f - dx_next;
+  const float dy_prev = 1.0f - dy_next;
+
+  out[mad24(y, width_out, x)] = dy_prev * (in[k_sw] * dx_next + in[k_se] * dx_prev)
+                              + dy_next * (in[k_nw] * dx_next + in[k_ne] * dx_prev);
+}
+
+__kernel void
+toneeq_quantize(global const float *in,
+                global float *out,
+                const int width,
+                const int height,
+                const float sampling,
+                const float clip_min,
+                const float clip_max)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int k = mad24(y, width, x);
+  out[k] = sampling == 0.0f
+    ? in[k]
+    : clamp(exp2(floor(log2(in[k]) / sampling) * sampling), clip_min, clip_max);
+}
+
+// upsample the a and b parameters of the fast guided filter and blend the image
+__kernel void
+toneeq_guided_blend(global float *image,
+                    global const float2 *ds_ab,
+                    const int width,
+                    const int height,
+                    const int ds_width,
+                    const int ds_height,
+                    const int geomean)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  int k_nw, k_ne, k_sw, k_se;
+  float dx_next, dy_next;
+  _bilinear_coords(x, y, ds_width, ds_height, width, height,
+                   &k_nw, &k_ne, &k_sw, &k_se, &dx_next, &dy_next);
+  const float dx_prev = 1.0f - dx_next;
+  const float dy_prev = 1.0f - dy_next;
+
+  const float2 ab = dy_prev * (ds_ab[k_sw] * dx_next + ds_ab[k_se] * dx_prev)
+                  + dy_next * (ds_ab[k_nw] * dx_next + ds_ab[k_ne] * dx_prev);
+
+  const int k = mad24(y, width, x);
+  const float pixel = image[k];
+  const float blended = fmax(pixel * ab.x + ab.y, TONEEQ_MIN_FLOAT);
+  image[k] = geomean ? sqrt(pixel * blended) : blended;
+}
+
+// upsample the averages and variances of the exposure independent guided filter
+// and blend the image. ds_av holds 4 channels with a mask, 2 without.
+__kernel void
+toneeq_eigf_blend(global float *image,
+                  global const float *mask,
+                  global const float *ds_av,
+                  const int width,
+                  const int height,
+                  const int ds_width,
+                  const int ds_height,
+                  const int use_mask,
+                  const int geomean,
+                  const float feathering)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  int k_nw, k_ne, k_sw, k_se;
+  float dx_next, dy_next;
+  _bilinear_coords(x, y, ds_width, ds_height, width, height,
+                   &k_nw, &k_ne, &k_sw, &k_se, &dx_next, &dy_next);
+  const float dx_prev = 1.0f - dx_next;
+  const float dy_prev = 1.0f - dy_next;
+
+  const int k = mad24(y, width, x);
+  const float pixel = image[k];
+  float a, b;
+
+  if(use_mask)
+  {
+    global const float4 *av4 = (global const float4 *)ds_av;
+    const float4 av = dy_prev * (av4[k_sw] * dx_next + av4[k_se] * dx_prev)
+                    + dy_next * (av4[k_nw] * dx_next + av4[k_ne] * dx_prev);
+    const float norm_g = fmax(av.x * pixel, 1e-6f);
+    const float norm_m = fmax(av.z * mask[k], 1e-6f);
+    const float normalized_var_guide = av.y / norm_g;
+    const float normalized_covar = av.w / sqrt(norm_g * norm_m);
+    a = normalized_covar / (normalized_var_guide + feathering);
+    b = av.z - a * av.x;
+  }
+  else
+  {
+    global const float2 *av2 = (global const float2 *)ds_av;
+    const float2 av = dy_prev * (av2[k_sw] * dx_next + av2[k_se] * dx_prev)
+                    + dy_next * (av2[k_nw] * dx_next + av2[k_ne] * dx_prev);
+    const float norm_g = fmax(av.x * pixel, 1e-6f);
+    const float normalized_var_guide = av.y / norm_g;
+    a = normalized_var_guide / (normalized_var_guide + feathering);
+    b = av.x - a * av.x;
+  }
+
+  const float blended = fmax(pixel * a + b, TONEEQ_MIN_FLOAT);
+  image[k] = geomean ? sqrt(pixel * blended) : blended;
+}
+
+__kernel void
+toneeq_apply(read_only image2d_t in,
+             global const float *luminance,
+             write_only image2d_t out,
+             const int width,
+             const int height,
+             global const float *lut,
+             const float lutres)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float4 pixel = read_imagef(in, samplerA, (int2)(x, y));
+  const float exposure = clamp(log2(luminance[mad24(y, width, x)]),
+                               DT_TONEEQ_MIN_EV, DT_TONEEQ_MAX_EV);
+  const float correction = lut[(int)round((exposure - DT_TONEEQ_MIN_EV) * lutres)];
+
+  write_imagef(out, (int2)(x, y), pixel * correction);
+}
+
+__kernel void
+toneeq_display_mask(read_only image2d_t in,
+                    global const float *luminance,
+                    write_only image2d_t out,
+                    const int width,
+                    const int height)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  // normalize the mask intensity between -8 EV and 0 EV for clarity,
+  // and add a "gamma" 2.0 for better legibility in shadows
+  const float lum = luminance[mad24(y, width, x)];
+  const float intensity = sqrt(fmin(fmax(lum - 0.00390625f, 0.0f) / 0.99609375f, 1.0f));
+  const float alpha = read_imagef(in, samplerA, (int2)(x, y)).w;
+  write_imagef(out, (int2)(x, y), (float4)(intensity, intensity, intensity, alpha));
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
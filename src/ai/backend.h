@@ -96,6 +96,11 @@ void dt_ai_snapshot_conf_state(void);
  *  their own paths (or leak at process exit, which is fine). */
 void dt_ai_backend_cleanup_globals(void);
 
+/** Unload the sessions kept idle for reuse, only those on an accelerated
+ *  provider if gpu_only is set. Called when device memory runs short.
+ *  Returns the number of sessions unloaded. */
+int dt_ai_release_idle_sessions(const gboolean gpu_only);
+
 /** Read plugins/ai/models_path and expand ~ if present. Returns a
  *  newly-allocated path, or NULL if the conf key is empty/unset.
  *  Caller frees with g_free(). */
@@ -358,6 +363,9 @@ typedef struct {
  *                   When the model package declares per-file cpu_only entries,
  *                   matching is done against this filename's stem (the
  *                   basename minus the ".onnx" extension).
+ *                   A "<stem>.fp16" or "<stem>.int8" attribute names a
+ *                   reduced precision export that is loaded instead when
+ *                   it suits the provider (see plugins/ai/precision).
  * @param provider Execution provider (DT_AI_PROVIDER_CONFIGURED = use user config).
  *                 The load function may override this to CPU when the model
  *                 declares the configured GPU EP unsafe (see cpu_only attribute).
@@ -424,6 +432,27 @@ int dt_ai_run(dt_ai_context_t *ctx, dt_ai_tensor_t *inputs,
                            int num_inputs, dt_ai_tensor_t *outputs,
                            int num_outputs);
 
+/**
+ * @brief Number of reusable tensor buffers per context.
+ */
+#define DT_AI_BUFFER_SLOTS 8
+
+/**
+ * @brief Get a tensor buffer owned by the context.
+ *
+ * Callers preparing the same tensors run after run (tiled inference)
+ * fill these in place instead of allocating per call. The buffer of a
+ * slot is kept, and only grown, until the model is freed. On CUDA it
+ * comes from page-locked host memory so uploads and downloads DMA
+ * straight from it without a staging copy. Not thread safe for one
+ * context, like dt_ai_run().
+ * @param ctx The AI context.
+ * @param slot Buffer index, 0 .. DT_AI_BUFFER_SLOTS - 1.
+ * @param bytes Minimum size in bytes.
+ * @return The buffer, or NULL on error. Contents are undefined.
+ */
+void *dt_ai_get_buffer(dt_ai_context_t *ctx, int slot, size_t bytes);
+
 /**
  * @brief Get the number of model inputs.
  * @param ctx The AI context.
@@ -486,6 +515,10 @@ int dt_ai_get_output_shape(dt_ai_context_t *ctx, int index,
 
 /**
  * @brief Unload a model and free execution context.
+ *
+ * The session is kept idle for plugins/ai/session_idle_timeout seconds
+ * and handed out again by a load with the same parameters. Sessions
+ * that failed an inference are freed right away.
  * @param ctx The AI context to unload.
  */
 void dt_ai_unload_model(dt_ai_context_t *ctx);
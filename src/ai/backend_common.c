@@ -469,7 +469,8 @@ dt_ai_provider_t dt_ai_env_get_provider(dt_ai_environment_t *env)
 // =backend-specific load (defined in backend_onnx.c)
 
 extern dt_ai_context_t *
-dt_ai_onnx_load_ext(const char *model_dir, const char *model_file,
+dt_ai_onnx_load_ext(const char *model_id,
+                    const char *model_dir, const char *model_file,
                     dt_ai_provider_t provider, dt_ai_opt_level_t opt_level,
                     const dt_ai_dim_override_t *dim_overrides, int n_overrides,
                     uint32_t ep_flags);
@@ -491,6 +492,66 @@ _resolve_ort_optimization(const dt_ai_model_info_t *info,
 
 static const char *_opt_level_to_string(dt_ai_opt_level_t level);
 
+// precision variants: a package may ship reduced precision exports next
+// to the fp32 model, declared as "<stem>.fp16" / "<stem>.int8" attributes
+// holding the onnx file name. GPU providers are bandwidth and memory
+// bound and run fp16 natively, quantised int8 pays off on the CPU class
+// ones. tensors stay float32 for the callers, dt_ai_run() converts at the
+// boundary. plugins/ai/precision forces one variant, "fp32" disables them
+static char *_resolve_precision_file(const dt_ai_model_info_t *info,
+                                     const char *model_dir,
+                                     const char *model_file,
+                                     dt_ai_provider_t provider)
+{
+  if(!info) return NULL;
+
+  const char *precision = NULL;
+  gchar *conf = dt_conf_get_string("plugins/ai/precision");
+  if(!g_strcmp0(conf, "fp16") || !g_strcmp0(conf, "int8"))
+    precision = !g_strcmp0(conf, "fp16") ? "fp16" : "int8";
+  else if(g_strcmp0(conf, "fp32"))
+  {
+    switch(provider)
+    {
+      case DT_AI_PROVIDER_CUDA:
+      case DT_AI_PROVIDER_MIGRAPHX:
+      case DT_AI_PROVIDER_DIRECTML:
+      case DT_AI_PROVIDER_COREML:
+        precision = "fp16";
+        break;
+      default:
+        precision = "int8";
+        break;
+    }
+  }
+  g_free(conf);
+  if(!precision) return NULL;
+
+  const char *file = model_file ? model_file : "model.onnx";
+  const char *dot = strrchr(file, '.');
+  gchar *stem = dot ? g_strndup(file, dot - file) : g_strdup(file);
+  gchar *key = g_strdup_printf("%s.%s", stem, precision);
+  char *variant = dt_ai_model_attribute_string(info, key);
+  g_free(key);
+  g_free(stem);
+  if(!variant) return NULL;
+
+  gchar *path = g_build_filename(model_dir, variant, NULL);
+  const gboolean exists = g_file_test(path, G_FILE_TEST_IS_REGULAR);
+  g_free(path);
+  if(!exists)
+  {
+    dt_print(DT_DEBUG_AI, "[darktable_ai] %s variant %s of %s is missing",
+             precision, variant, info->id);
+    g_free(variant);
+    return NULL;
+  }
+
+  dt_print(DT_DEBUG_AI, "[darktable_ai] using %s variant %s of %s",
+           precision, variant, info->id);
+  return variant;
+}
+
 // model loading with backend dispatch
 
 dt_ai_context_t *dt_ai_load_model(dt_ai_environment_t *env,
@@ -571,8 +632,23 @@ dt_ai_context_t *dt_ai_load_model_ext(dt_ai_environment_t *env,
 
   if(strcmp(backend_copy, "onnx") == 0)
   {
-    ctx = dt_ai_onnx_load_ext(model_dir, model_file, resolved, resolved_opt,
-                               dim_overrides, n_overrides, ep_flags);
+    // a reduced precision export is only a faster copy of the model,
+    // if it doesn't load fall back to the declared file
+    char *variant = _resolve_precision_file(model_info, model_dir,
+                                            model_file, resolved);
+    if(variant)
+    {
+      ctx = dt_ai_onnx_load_ext(model_id, model_dir, variant, resolved, resolved_opt,
+                                dim_overrides, n_overrides, ep_flags);
+      if(!ctx)
+        dt_print(DT_DEBUG_AI,
+                 "[darktable_ai] %s/%s failed to load, using full precision",
+                 model_id, variant);
+      g_free(variant);
+    }
+    if(!ctx)
+      ctx = dt_ai_onnx_load_ext(model_id, model_dir, model_file, resolved, resolved_opt,
+                                dim_overrides, n_overrides, ep_flags);
   }
   else
   {
@@ -1218,6 +1294,7 @@ static const char *_ep_name(dt_ai_provider_t provider)
 {
   switch(provider)
   {
+    case DT_AI_PROVIDER_CPU:       return "cpu";
     case DT_AI_PROVIDER_COREML:    return "coreml";
     case DT_AI_PROVIDER_CUDA:      return "cuda";
     case DT_AI_PROVIDER_MIGRAPHX:  return "migraphx";
@@ -18,9 +18,11 @@
 
 #include "backend.h"
 #include "common/darktable.h"
+#include "common/memory_account.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <onnxruntime_c_api.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -61,6 +63,25 @@ struct dt_ai_context_t
   // TRUE when any output has symbolic/dynamic shape dims.
   // in that case dt_ai_run() lets ORT allocate outputs and copies back
   gboolean dynamic_outputs;
+
+  // provider the session was requested for
+  dt_ai_provider_t provider;
+
+  // reusable tensor buffers, see dt_ai_get_buffer()
+  void *buffers[DT_AI_BUFFER_SLOTS];
+  size_t buffer_sizes[DT_AI_BUFFER_SLOTS];
+  OrtMemoryInfo *pinned_info;
+  OrtAllocator *pinned;   // CUDA page-locked host memory, NULL if unavailable
+  gboolean pinned_tried;
+
+  // kept across dt_ai_run() calls, NULL until first needed
+  OrtIoBinding *binding;
+
+  // session pool bookkeeping, see _pool_release()
+  gchar *pool_key;    // creation parameters
+  size_t pool_bytes;  // estimated from the model file size
+  gint64 released;    // monotonic time the session went idle
+  gboolean failed;    // an inference failed, don't hand it out again
 };
 
 // minimum ORT API we accept. v18 = ORT 1.18, required for ROCm 6.0
@@ -71,6 +92,9 @@ struct dt_ai_context_t
 // cache size for per-device VRAM lookups; ORT also uses a uint32 device id
 #define DT_AI_MAX_CUDA_DEVICES 8
 
+// how often idle sessions are checked for eviction
+#define DT_AI_POOL_POLL_SECONDS 30
+
 // ORT runtime singletons (one OrtApi + one OrtEnv per process,
 // initialized lazily via g_once)
 static struct {
@@ -102,6 +126,7 @@ static struct {
 };
 
 static int _device_id_from_conf(const char *conf_key, const char *env_var);
+static void _pool_flush(void);
 static gchar *_lookup_device_name(const dt_ai_provider_t provider,
                                   const int device_id);
 static gchar *_backend_cache_fingerprint(dt_ai_provider_t provider,
@@ -376,6 +401,7 @@ void dt_ai_snapshot_conf_state(void)
 
 void dt_ai_backend_cleanup_globals(void)
 {
+  _pool_flush();
   g_free(g_ort.version);            g_ort.version = NULL;
   g_free(g_conf_snapshot.ort_path); g_conf_snapshot.ort_path = NULL;
   g_free(g_conf_snapshot.provider); g_conf_snapshot.provider = NULL;
@@ -2248,12 +2274,238 @@ int dt_ai_probe_provider(dt_ai_provider_t provider)
   return result;
 }
 
+// Session Pool
+
+// released sessions stay loaded for a while, keyed by everything that
+// went into creating them, so batch jobs and switching between tools
+// don't pay session creation and graph optimization on every use.
+// entries are most recently released first
+static struct {
+  GMutex lock;
+  GList *idle;    // dt_ai_context_t *
+  size_t bytes;   // estimated size of the idle sessions
+  guint timeout;  // idle eviction source, 0 if none
+} g_pool;
+
+static void _free_context(dt_ai_context_t *ctx);
+
+static gchar *_pool_key(const char *onnx_path,
+                        dt_ai_provider_t provider,
+                        dt_ai_opt_level_t opt_level,
+                        const dt_ai_dim_override_t *dim_overrides,
+                        int n_overrides,
+                        uint32_t ep_flags)
+{
+  GString *key = g_string_new(onnx_path);
+  g_string_append_printf(key, "|%d|%d|%u", provider, opt_level, ep_flags);
+  for(int i = 0; i < n_overrides; i++)
+    if(dim_overrides[i].name)
+      g_string_append_printf(key, "|%s=%" PRId64,
+                             dim_overrides[i].name, dim_overrides[i].value);
+  return g_string_free(key, FALSE);
+}
+
+// unlinks sessions idle for longer than the timeout or beyond the size
+// budget and returns them, to be freed outside of the lock
+static GList *_pool_expire_locked(const gboolean all)
+{
+  const gint64 timeout
+    = (gint64)dt_conf_get_int("plugins/ai/session_idle_timeout") * G_TIME_SPAN_SECOND;
+  const size_t budget = (size_t)MAX(0, dt_conf_get_int("plugins/ai/session_cache_size")) << 20;
+  const gint64 now = g_get_monotonic_time();
+
+  GList *expired = NULL;
+  size_t kept = 0;
+  GList *l = g_pool.idle;
+  while(l)
+  {
+    GList *next = l->next;
+    dt_ai_context_t *ctx = l->data;
+    if(all || now - ctx->released >= timeout || kept + ctx->pool_bytes > budget)
+    {
+      g_pool.idle = g_list_remove_link(g_pool.idle, l);
+      g_pool.bytes -= ctx->pool_bytes;
+      expired = g_list_concat(l, expired);
+    }
+    else
+      kept += ctx->pool_bytes;
+    l = next;
+  }
+  return expired;
+}
+
+static void _pool_free_list(GList *expired)
+{
+  for(GList *l = expired; l; l = l->next)
+  {
+    dt_ai_context_t *ctx = l->data;
+    dt_print(DT_DEBUG_AI, "[darktable_ai] unloading idle session %s", ctx->pool_key);
+    _free_context(ctx);
+  }
+  g_list_free(expired);
+}
+
+static gboolean _pool_timeout(gpointer user_data)
+{
+  g_mutex_lock(&g_pool.lock);
+  GList *expired = _pool_expire_locked(FALSE);
+  const gboolean again = g_pool.idle != NULL;
+  if(!again) g_pool.timeout = 0;
+  g_mutex_unlock(&g_pool.lock);
+
+  _pool_free_list(expired);
+  return again ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static dt_ai_context_t *_pool_take(const char *key)
+{
+  dt_ai_context_t *found = NULL;
+  g_mutex_lock(&g_pool.lock);
+  GList *expired = _pool_expire_locked(FALSE);
+  for(GList *l = g_pool.idle; l; l = l->next)
+  {
+    dt_ai_context_t *ctx = l->data;
+    if(!strcmp(ctx->pool_key, key))
+    {
+      found = ctx;
+      g_pool.idle = g_list_delete_link(g_pool.idle, l);
+      g_pool.bytes -= ctx->pool_bytes;
+      break;
+    }
+  }
+  g_mutex_unlock(&g_pool.lock);
+
+  _pool_free_list(expired);
+  return found;
+}
+
+// returns FALSE if the session should be freed right away
+static gboolean _pool_release(dt_ai_context_t *ctx)
+{
+  if(!ctx->pool_key || ctx->failed
+     || dt_conf_get_int("plugins/ai/session_idle_timeout") <= 0)
+    return FALSE;
+
+  ctx->released = g_get_monotonic_time();
+  g_mutex_lock(&g_pool.lock);
+  g_pool.idle = g_list_prepend(g_pool.idle, ctx);
+  g_pool.bytes += ctx->pool_bytes;
+  GList *expired = _pool_expire_locked(FALSE);
+  if(g_pool.idle && !g_pool.timeout)
+    g_pool.timeout = g_timeout_add_seconds(DT_AI_POOL_POLL_SECONDS, _pool_timeout, NULL);
+  g_mutex_unlock(&g_pool.lock);
+
+  _pool_free_list(expired);
+  return TRUE;
+}
+
+int dt_ai_release_idle_sessions(const gboolean gpu_only)
+{
+  g_mutex_lock(&g_pool.lock);
+  GList *expired = NULL;
+  GList *l = g_pool.idle;
+  while(l)
+  {
+    GList *next = l->next;
+    dt_ai_context_t *ctx = l->data;
+    if(!gpu_only || ctx->provider != DT_AI_PROVIDER_CPU)
+    {
+      g_pool.idle = g_list_remove_link(g_pool.idle, l);
+      g_pool.bytes -= ctx->pool_bytes;
+      expired = g_list_concat(l, expired);
+    }
+    l = next;
+  }
+  g_mutex_unlock(&g_pool.lock);
+
+  const int count = g_list_length(expired);
+  if(count)
+    dt_print(DT_DEBUG_AI, "[darktable_ai] device memory is short, unloading %d idle sessions",
+             count);
+  _pool_free_list(expired);
+  return count;
+}
+
+static void _pool_flush(void)
+{
+  g_mutex_lock(&g_pool.lock);
+  GList *expired = _pool_expire_locked(TRUE);
+  if(g_pool.timeout) g_source_remove(g_pool.timeout);
+  g_pool.timeout = 0;
+  g_mutex_unlock(&g_pool.lock);
+
+  _pool_free_list(expired);
+}
+
+// graph optimization of the CPU provider is portable between runs on
+// the same machine, so the optimized model is kept in the backend cache
+// and loaded as is next time. accelerated providers keep their own
+// compile caches (OpenVINO, MIGraphX) or produce device specific graphs
+static gchar *_optimized_model_path(const char *model_id,
+                                    const char *onnx_path,
+                                    const char *pool_key)
+{
+  if(!model_id) return NULL;
+
+  gchar *fp = _backend_cache_fingerprint(DT_AI_PROVIDER_CPU, -1);
+  char dir[PATH_MAX] = { 0 };
+  const gboolean ok = dt_ai_backend_cache_dir(DT_AI_PROVIDER_CPU, fp, model_id,
+                                              dir, sizeof(dir));
+  g_free(fp);
+  if(!ok) return NULL;
+
+  gchar *base = g_path_get_basename(onnx_path);
+  gchar *name = g_strdup_printf("%08x_%s",
+                                (uint32_t)g_str_hash(pool_key), base);
+  gchar *path = g_build_filename(dir, name, NULL);
+  g_free(name);
+  g_free(base);
+  return path;
+}
+
+static OrtStatus *_create_session(OrtSessionOptions *session_opts,
+                                  const char *path,
+                                  OrtSession **session)
+{
+#ifdef _WIN32
+  wchar_t *path_wide = (wchar_t *)g_utf8_to_utf16(path, -1, NULL, NULL, NULL);
+  OrtStatus *status = g_ort.api->CreateSession(g_ort.env, path_wide, session_opts, session);
+  g_free(path_wide);
+  return status;
+#else
+  return g_ort.api->CreateSession(g_ort.env, path, session_opts, session);
+#endif
+}
+
+static OrtStatus *_set_optimized_model_path(OrtSessionOptions *session_opts,
+                                            const char *path)
+{
+#ifdef _WIN32
+  wchar_t *path_wide = (wchar_t *)g_utf8_to_utf16(path, -1, NULL, NULL, NULL);
+  OrtStatus *status = g_ort.api->SetOptimizedModelFilePath(session_opts, path_wide);
+  g_free(path_wide);
+  return status;
+#else
+  return g_ort.api->SetOptimizedModelFilePath(session_opts, path);
+#endif
+}
+
+// the cached model is only trusted if it is newer than the original
+static gboolean _optimized_model_valid(const char *cached, const char *onnx_path)
+{
+  GStatBuf c, o;
+  return cached && !g_stat(cached, &c) && !g_stat(onnx_path, &o)
+         && c.st_size > 0 && c.st_mtime >= o.st_mtime;
+}
+
 // ONNX Model Loading
 
 // load ONNX model from model_dir/model_file with dimension overrides.
-// if model_file is NULL, defaults to "model.onnx".
+// if model_file is NULL, defaults to "model.onnx". an idle session
+// created with the same parameters is reused if there is one
 dt_ai_context_t *
-dt_ai_onnx_load_ext(const char *model_dir, const char *model_file,
+dt_ai_onnx_load_ext(const char *model_id,
+                    const char *model_dir, const char *model_file,
                     dt_ai_provider_t provider, dt_ai_opt_level_t opt_level,
                     const dt_ai_dim_override_t *dim_overrides, int n_overrides,
                     uint32_t ep_flags)
@@ -2285,9 +2537,23 @@ dt_ai_onnx_load_ext(const char *model_dir, const char *model_file,
     return NULL;
   }
 
+  gchar *pool_key = _pool_key(onnx_path, provider, opt_level,
+                              dim_overrides, n_overrides, ep_flags);
+  dt_ai_context_t *pooled = _pool_take(pool_key);
+  if(pooled)
+  {
+    dt_print(DT_DEBUG_AI, "[darktable_ai] reusing idle session: %s", onnx_path);
+    g_free(pool_key);
+    g_free(onnx_path);
+    return pooled;
+  }
+
   dt_print(DT_DEBUG_AI, "[darktable_ai] loading: %s", onnx_path);
 
   dt_ai_context_t *ctx = g_new0(dt_ai_context_t, 1);
+  ctx->pool_key = pool_key;
+  ctx->failed = TRUE;  // not pooled before it is fully set up
+  ctx->provider = provider;
 
   OrtStatus *status;
   OrtSessionOptions *session_opts;
@@ -2343,12 +2609,46 @@ dt_ai_onnx_load_ext(const char *model_dir, const char *model_file,
   // optimize: enable hardware acceleration (AMD caches set at env init)
   _enable_acceleration(session_opts, provider, ep_flags);
 
+  // warm start from the model optimized by an earlier run, or have ORT
+  // write it out while creating this session
+  gchar *optimized = provider == DT_AI_PROVIDER_CPU && opt_level != DT_AI_OPT_DISABLED
+    ? _optimized_model_path(model_id, onnx_path, pool_key)
+    : NULL;
+  if(optimized && _optimized_model_valid(optimized, onnx_path))
+  {
+    OrtStatus *s = g_ort.api->SetSessionGraphOptimizationLevel(session_opts, ORT_DISABLE_ALL);
+    if(s) g_ort.api->ReleaseStatus(s);
+    s = _create_session(session_opts, optimized, &ctx->session);
+    if(s)
+    {
+      dt_print(DT_DEBUG_AI, "[darktable_ai] dropping cached optimized model %s: %s",
+               optimized, g_ort.api->GetErrorMessage(s));
+      g_ort.api->ReleaseStatus(s);
+      g_unlink(optimized);
+      ctx->session = NULL;
+      s = g_ort.api->SetSessionGraphOptimizationLevel(session_opts, ort_opt);
+      if(s) g_ort.api->ReleaseStatus(s);
+    }
+    else
+      dt_print(DT_DEBUG_AI, "[darktable_ai] loaded optimized model %s", optimized);
+  }
+  if(optimized && !ctx->session)
+  {
+    OrtStatus *s = _set_optimized_model_path(session_opts, optimized);
+    if(s) g_ort.api->ReleaseStatus(s);
+  }
+  g_free(optimized);
+
 #ifdef _WIN32
   // on windows, CreateSession expects a wide character string
   wchar_t *onnx_path_wide = (wchar_t *)g_utf8_to_utf16(onnx_path, -1, NULL, NULL, NULL);
-  status = g_ort.api->CreateSession(g_ort.env, onnx_path_wide, session_opts, &ctx->session);
+  status = ctx->session
+    ? NULL
+    : g_ort.api->CreateSession(g_ort.env, onnx_path_wide, session_opts, &ctx->session);
 #else
-  status = g_ort.api->CreateSession(g_ort.env, onnx_path, session_opts, &ctx->session);
+  status = ctx->session
+    ? NULL
+    : g_ort.api->CreateSession(g_ort.env, onnx_path, session_opts, &ctx->session);
 #endif
 
   // smart fallback: try progressively simpler configurations
@@ -2419,6 +2719,9 @@ dt_ai_onnx_load_ext(const char *model_dir, const char *model_file,
   g_free(onnx_path_wide);
 #endif
   g_ort.api->ReleaseSessionOptions(session_opts);
+  // weights dominate the footprint of a session
+  GStatBuf st;
+  ctx->pool_bytes = g_stat(onnx_path, &st) ? 0 : (size_t)st.st_size;
   g_free(onnx_path);
 
   if(status)
@@ -2430,6 +2733,7 @@ dt_ai_onnx_load_ext(const char *model_dir, const char *model_file,
     dt_ai_unload_model(ctx);
     return NULL;
   }
+  dt_mem_account_alloc(DT_MEM_ACCOUNT_AI, ctx->pool_bytes);
 
   status
     = g_ort.api->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &ctx->memory_info);
@@ -2601,9 +2905,32 @@ dt_ai_onnx_load_ext(const char *model_dir, const char *model_file,
     if(ctx->dynamic_outputs) break;
   }
 
+  ctx->failed = FALSE;
   return ctx;
 }
 
+static OrtStatus *_run_bound(dt_ai_context_t *ctx,
+                             const char **input_names,
+                             OrtValue **input_tensors,
+                             const int num_inputs,
+                             const char **output_names,
+                             OrtValue **output_tensors,
+                             const int num_outputs)
+{
+  OrtStatus *status = NULL;
+  for(int i = 0; i < num_inputs && !status; i++)
+    status = g_ort.api->BindInput(ctx->binding, input_names[i], input_tensors[i]);
+  for(int i = 0; i < num_outputs && !status; i++)
+    status = g_ort.api->BindOutput(ctx->binding, output_names[i], output_tensors[i]);
+  if(!status)
+    status = g_ort.api->RunWithBinding(ctx->session, NULL, ctx->binding);
+
+  // the bound values reference caller buffers, don't keep them around
+  g_ort.api->ClearBoundInputs(ctx->binding);
+  g_ort.api->ClearBoundOutputs(ctx->binding);
+  return status;
+}
+
 int dt_ai_run(
   dt_ai_context_t *ctx,
   dt_ai_tensor_t *inputs,
@@ -2771,21 +3098,43 @@ int dt_ai_run(
     }
   }
 
-  // run
-  status = g_ort.api->Run(ctx->session,
-                      NULL,
-                      input_names,
-                      (const OrtValue *const *)input_tensors,
-                      num_inputs,
-                      output_names,
-                      num_outputs,
-                      output_tensors);
+  // run. with every output in caller memory go through the context's
+  // I/O binding: providers copy results straight into the bound buffers
+  // and the binding is set up once per session instead of per call
+  gboolean bound = TRUE;
+  for(int i = 0; i < num_outputs; i++)
+    bound = bound && output_tensors[i] != NULL;
+  if(bound && !ctx->binding)
+  {
+    status = g_ort.api->CreateIoBinding(ctx->session, &ctx->binding);
+    if(status)
+    {
+      g_ort.api->ReleaseStatus(status);
+      status = NULL;
+      ctx->binding = NULL;
+    }
+  }
+  bound = bound && ctx->binding;
+
+  if(bound)
+    status = _run_bound(ctx, input_names, input_tensors, num_inputs,
+                        output_names, output_tensors, num_outputs);
+  else
+    status = g_ort.api->Run(ctx->session,
+                        NULL,
+                        input_names,
+                        (const OrtValue *const *)input_tensors,
+                        num_inputs,
+                        output_names,
+                        num_outputs,
+                        output_tensors);
 
   if(status)
   {
     dt_print(DT_DEBUG_AI, "[darktable_ai] run error: %s", g_ort.api->GetErrorMessage(status));
     g_ort.api->ReleaseStatus(status);
     ret = -3;
+    ctx->failed = TRUE;
   }
   else
   {
@@ -2948,6 +3297,54 @@ cleanup:
   return ret;
 }
 
+// page-locked host memory lets the CUDA EP DMA tensors directly, ORT
+// only hands it out through an allocator bound to a CUDA session
+static void _init_pinned(dt_ai_context_t *ctx)
+{
+  ctx->pinned_tried = TRUE;
+  if(ctx->provider != DT_AI_PROVIDER_CUDA) return;
+
+  OrtStatus *status = g_ort.api->CreateMemoryInfo("CudaPinned", OrtDeviceAllocator, 0,
+                                                  OrtMemTypeCPUOutput, &ctx->pinned_info);
+  if(!status)
+    status = g_ort.api->CreateAllocator(ctx->session, ctx->pinned_info, &ctx->pinned);
+  if(status)
+  {
+    dt_print(DT_DEBUG_AI, "[darktable_ai] no pinned host memory: %s",
+             g_ort.api->GetErrorMessage(status));
+    g_ort.api->ReleaseStatus(status);
+    ctx->pinned = NULL;
+    if(ctx->pinned_info) g_ort.api->ReleaseMemoryInfo(ctx->pinned_info);
+    ctx->pinned_info = NULL;
+  }
+}
+
+void *dt_ai_get_buffer(dt_ai_context_t *ctx, int slot, size_t bytes)
+{
+  if(!ctx || !ctx->session || slot < 0 || slot >= DT_AI_BUFFER_SLOTS || bytes == 0)
+    return NULL;
+
+  if(ctx->buffer_sizes[slot] >= bytes)
+    return ctx->buffers[slot];
+
+  if(!ctx->pinned_tried) _init_pinned(ctx);
+
+  if(ctx->buffers[slot])
+  {
+    if(ctx->pinned)
+      ctx->pinned->Free(ctx->pinned, ctx->buffers[slot]);
+    else
+      dt_free_align(ctx->buffers[slot]);
+    dt_mem_account_free(DT_MEM_ACCOUNT_AI, ctx->buffer_sizes[slot]);
+  }
+  ctx->buffers[slot] = ctx->pinned
+    ? ctx->pinned->Alloc(ctx->pinned, bytes)
+    : dt_alloc_aligned(bytes);
+  ctx->buffer_sizes[slot] = ctx->buffers[slot] ? bytes : 0;
+  if(ctx->buffers[slot]) dt_mem_account_alloc(DT_MEM_ACCOUNT_AI, bytes);
+  return ctx->buffers[slot];
+}
+
 int dt_ai_get_input_count(dt_ai_context_t *ctx)
 {
   return ctx ? (int)ctx->input_count : 0;
@@ -3040,11 +3437,36 @@ int dt_ai_get_output_shape(dt_ai_context_t *ctx, int index,
 }
 
 void dt_ai_unload_model(dt_ai_context_t *ctx)
+{
+  if(ctx && !_pool_release(ctx))
+    _free_context(ctx);
+}
+
+static void _free_context(dt_ai_context_t *ctx)
 {
   if(ctx)
   {
+    for(int k = 0; k < DT_AI_BUFFER_SLOTS; k++)
+    {
+      if(!ctx->buffers[k]) continue;
+      if(ctx->pinned)
+        ctx->pinned->Free(ctx->pinned, ctx->buffers[k]);
+      else
+        dt_free_align(ctx->buffers[k]);
+      dt_mem_account_free(DT_MEM_ACCOUNT_AI, ctx->buffer_sizes[k]);
+    }
+    if(ctx->pinned)
+      g_ort.api->ReleaseAllocator(ctx->pinned);
+    if(ctx->pinned_info)
+      g_ort.api->ReleaseMemoryInfo(ctx->pinned_info);
+    if(ctx->binding)
+      g_ort.api->ReleaseIoBinding(ctx->binding);
+    // the allocators above belong to the session, release it last
     if(ctx->session)
+    {
       g_ort.api->ReleaseSession(ctx->session);
+      dt_mem_account_free(DT_MEM_ACCOUNT_AI, ctx->pool_bytes);
+    }
     // note: OrtEnv is a shared singleton (g_ort.env), not per-context
     if(ctx->memory_info)
       g_ort.api->ReleaseMemoryInfo(ctx->memory_info);
@@ -3068,6 +3490,7 @@ void dt_ai_unload_model(dt_ai_context_t *ctx)
     g_free(ctx->output_names);
     g_free(ctx->input_types);
     g_free(ctx->output_types);
+    g_free(ctx->pool_key);
     g_free(ctx);
   }
 }
@@ -124,6 +124,10 @@ struct _DtBauhausWidget
   // gap to add to the top padding due to the vertical centering
   int top_gap;
 
+  // background and baseline of a slider, drawn again when their hash changes
+  cairo_surface_t *background;
+  dt_hash_t background_hash;
+
   // goes last, might extend past the end:
   union
   {
@@ -764,6 +768,7 @@ static void _widget_finalize(GObject *widget)
     g_ptr_array_free(d->entries, TRUE);
     free(d->text);
   }
+  if(w->background) cairo_surface_destroy(w->background);
   g_free(w->label);
   g_free(w->section);
   g_free(w->tooltip);
@@ -2231,9 +2236,10 @@ static void _draw_color_wheel(dt_bauhaus_widget_t *w,
   cairo_restore(cr);
 }
 
-static void _draw_baseline(dt_bauhaus_widget_t *w,
-                           cairo_t *cr,
-                           const float slider_width)
+// the part of the baseline that doesn't depend on the position
+static void _draw_baseline_background(dt_bauhaus_widget_t *w,
+                                      cairo_t *cr,
+                                      const float slider_width)
 {
   // draw line for orientation in slider
   if(w->type != DT_BAUHAUS_SLIDER) return;
@@ -2285,6 +2291,22 @@ static void _draw_baseline(dt_bauhaus_widget_t *w,
     cairo_fill(cr);
   }
 
+  cairo_restore(cr);
+
+  if(d->grad_cnt > 0) cairo_pattern_destroy(gradient);
+}
+
+static void _draw_baseline_fill(dt_bauhaus_widget_t *w,
+                                cairo_t *cr,
+                                const float slider_width)
+{
+  if(w->type != DT_BAUHAUS_SLIDER) return;
+
+  dt_bauhaus_t *bh = darktable.bauhaus;
+  const dt_bauhaus_slider_data_t *d = &w->slider;
+  const float htm = bh->line_height + INNER_PADDING;
+  const float htM = bh->baseline_size - bh->border_width;
+
   // get the reference of the slider aka the position of the 0 value
   const float origin =
     fmaxf(fminf((d->factor > 0
@@ -2298,16 +2320,22 @@ static void _draw_baseline(dt_bauhaus_widget_t *w,
   // - but only if set
   if(d->fill_feedback)
   {
+    cairo_save(cr);
     // only brighten, useful for colored sliders to not get too faint:
     cairo_set_operator(cr, CAIRO_OPERATOR_SCREEN);
     set_color(cr, bh->color_fill);
     cairo_rectangle(cr, origin, htm, delta, htM);
     cairo_fill(cr);
+    cairo_restore(cr);
   }
+}
 
-  cairo_restore(cr);
-
-  if(d->grad_cnt > 0) cairo_pattern_destroy(gradient);
+static void _draw_baseline(dt_bauhaus_widget_t *w,
+                           cairo_t *cr,
+                           const float slider_width)
+{
+  _draw_baseline_background(w, cr, slider_width);
+  _draw_baseline_fill(w, cr, slider_width);
 }
 
 static void _popup_reject(void)
@@ -2614,6 +2642,70 @@ static gboolean _popup_draw(GtkWidget *widget,
   return TRUE;
 }
 
+static dt_hash_t _slider_background_hash(const dt_bauhaus_widget_t *w,
+                                         const int width,
+                                         const int height,
+                                         const int slider_width,
+                                         const GtkStateFlags state,
+                                         const GdkRGBA *bg_color)
+{
+  const dt_bauhaus_t *bh = darktable.bauhaus;
+  const dt_bauhaus_slider_data_t *d = &w->slider;
+  const int size[] = { width, height, slider_width, state, d->grad_cnt };
+  const float range[] = { d->min, d->max, d->soft_min, d->soft_max, d->hard_min, d->hard_max,
+                          bh->line_height, bh->baseline_size, bh->border_width };
+
+  dt_hash_t hash = dt_hash(DT_INITHASH, size, sizeof(size));
+  hash = dt_hash(hash, range, sizeof(range));
+  hash = dt_hash(hash, &w->margin, sizeof(w->margin));
+  hash = dt_hash(hash, &w->padding, sizeof(w->padding));
+  hash = dt_hash(hash, bg_color, sizeof(GdkRGBA));
+  hash = dt_hash(hash, &bh->color_bg, sizeof(GdkRGBA));
+  hash = dt_hash(hash, &bh->color_fg_insensitive, sizeof(GdkRGBA));
+  hash = dt_hash(hash, &darktable.gui->ppd, sizeof(darktable.gui->ppd));
+  if(d->grad_cnt > 0)
+  {
+    hash = dt_hash(hash, d->grad_col, sizeof(float) * 3 * d->grad_cnt);
+    hash = dt_hash(hash, d->grad_pos, sizeof(float) * d->grad_cnt);
+  }
+  return hash;
+}
+
+// the background and baseline of a slider only change with its size,
+// range, gradient, state and the theme. they are kept in a surface so
+// that moving the slider only draws the indicator and the texts.
+static void _slider_paint_background(dt_bauhaus_widget_t *w,
+                                     GtkStyleContext *context,
+                                     cairo_t *cr,
+                                     const int width,
+                                     const int height,
+                                     const int slider_width,
+                                     const GtkStateFlags state,
+                                     const GdkRGBA *bg_color)
+{
+  const dt_hash_t hash =
+    _slider_background_hash(w, width, height, slider_width, state, bg_color);
+
+  if(!w->background || w->background_hash != hash)
+  {
+    if(w->background) cairo_surface_destroy(w->background);
+    w->background = dt_cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    w->background_hash = hash;
+
+    cairo_t *bcr = cairo_create(w->background);
+    gtk_render_background(context, bcr, w->margin.left, w->margin.top,
+                          width - w->margin.left - w->margin.right,
+                          height - w->margin.top - w->margin.bottom);
+    cairo_translate(bcr, w->margin.left + w->padding.left, w->margin.top + w->padding.top);
+    cairo_set_line_width(bcr, 1.0);
+    _draw_baseline_background(w, bcr, slider_width);
+    cairo_destroy(bcr);
+  }
+
+  cairo_set_source_surface(cr, w->background, 0, 0);
+  cairo_paint(cr);
+}
+
 static gboolean _widget_draw(GtkWidget *widget,
                              cairo_t *crf)
 {
@@ -2625,6 +2717,14 @@ static gboolean _widget_draw(GtkWidget *widget,
   cairo_t *cr = cairo_create(cst);
   GtkStyleContext *context = gtk_widget_get_style_context(widget);
 
+  // only draw what has been invalidated
+  GdkRectangle clip;
+  if(gdk_cairo_get_clip_rectangle(crf, &clip))
+  {
+    cairo_rectangle(cr, clip.x, clip.y, clip.width, clip.height);
+    cairo_clip(cr);
+  }
+
   GdkRGBA *fg_color = _default_color_assign();
   GdkRGBA *bg_color;
   GdkRGBA *text_color = _default_color_assign();
@@ -2641,7 +2741,10 @@ static gboolean _widget_draw(GtkWidget *widget,
   const int w2 = width - w->margin.left - w->margin.right;
   const int h3 = h2 - w->padding.top - w->padding.bottom;
   const int w3 = w2 - w->padding.left - w->padding.right - _widget_get_quad_width(w);
-  gtk_render_background(context, cr, w->margin.left, w->margin.top, w2, h2);
+  if(w->type == DT_BAUHAUS_SLIDER)
+    _slider_paint_background(w, context, cr, width, height, w3, state, bg_color);
+  else
+    gtk_render_background(context, cr, w->margin.left, w->margin.top, w2, h2);
   cairo_translate(cr, w->margin.left + w->padding.left, w->margin.top + w->padding.top);
 
   // draw type specific content:
@@ -2728,8 +2831,8 @@ static gboolean _widget_draw(GtkWidget *widget,
     }
     case DT_BAUHAUS_SLIDER:
     {
-      // line for orientation
-      _draw_baseline(w, cr, w3);
+      // line for orientation, its background is in the cached surface
+      _draw_baseline_fill(w, cr, w3);
 
       float value_width = 0;
       if(gtk_widget_is_sensitive(widget))
@@ -3212,10 +3315,13 @@ void dt_bauhaus_slider_set(GtkWidget *widget,
                                          d->hard_max - d->hard_min);
   // set new temp range to include new value
   // if angle has wrapped around, then set to full range
+  const float old_min = d->min, old_max = d->max;
   d->min = (gpos == rpos) ? MIN(d->min, rpos) : d->hard_min;
   d->max = (gpos == rpos) ? MAX(d->max, rpos) : d->hard_max;;
   const float rawval = (gpos - d->min) / (d->max - d->min);
   _slider_set_normalized(w, d->curve(rawval, DT_BAUHAUS_SET));
+  // the whole baseline moves with the range
+  if(d->min != old_min || d->max != old_max) gtk_widget_queue_draw(widget);
 }
 
 void dt_bauhaus_slider_set_val(GtkWidget *widget,
@@ -3433,9 +3539,38 @@ static gboolean _slider_value_change_dragging(gpointer data)
   return G_SOURCE_REMOVE;
 }
 
+// invalidate the texts and the baseline between the old and the new position
+static void _slider_queue_draw_pos(dt_bauhaus_widget_t *w,
+                                   const float oldpos,
+                                   const float newpos)
+{
+  GtkWidget *widget = GTK_WIDGET(w);
+  const int width = gtk_widget_get_allocated_width(widget);
+  if(!gtk_widget_get_realized(widget) || width <= 1)
+  {
+    gtk_widget_queue_draw(widget);
+    return;
+  }
+
+  const dt_bauhaus_t *bh = darktable.bauhaus;
+  const int left = w->margin.left + w->padding.left;
+  const float w3 = width - left - w->margin.right - w->padding.right
+                   - _widget_get_quad_width(w);
+  const float baseline = w->margin.top + w->padding.top + bh->line_height + INNER_PADDING;
+  const float reach = bh->marker_size + bh->border_width + 1.0f;
+
+  gtk_widget_queue_draw_area(widget, 0, 0, width, ceilf(baseline));
+
+  const float x0 = floorf(left + MIN(oldpos, newpos) * w3 - reach);
+  const float x1 = ceilf(left + MAX(oldpos, newpos) * w3 + reach);
+  const float y1 = ceilf(baseline + bh->baseline_size + reach);
+  gtk_widget_queue_draw_area(widget, x0, floorf(baseline), x1 - x0, y1 - floorf(baseline));
+}
+
 static void _slider_set_normalized(dt_bauhaus_widget_t *w, float pos)
 {
   dt_bauhaus_slider_data_t *d = &w->slider;
+  const float oldpos = d->pos;
   float rpos = CLAMP(pos, 0.0f, 1.0f);
   rpos = d->curve(rpos, DT_BAUHAUS_GET);
   rpos = d->min + (d->max - d->min) * rpos;
@@ -3444,7 +3579,7 @@ static void _slider_set_normalized(dt_bauhaus_widget_t *w, float pos)
 
   rpos = (rpos - d->min) / (d->max - d->min);
   d->pos = d->curve(rpos, DT_BAUHAUS_SET);
-  gtk_widget_queue_draw(GTK_WIDGET(w));
+  _slider_queue_draw_pos(w, oldpos, d->pos);
   if(darktable.bauhaus->current == w)
     gtk_widget_queue_draw(darktable.bauhaus->popup.area);
   if(!DT_IN_GUI_UPDATE())
@@ -34,6 +34,8 @@
 #include "common/history.h"
 #include "common/image.h"
 #include "common/image_cache.h"
+#include "common/mipmap_cache.h"
+#include "common/numa.h"
 #include "common/points.h"
 #include "control/conf.h"
 #include "develop/imageop.h"
@@ -41,6 +43,7 @@
 #include "imageio/imageio_jpeg.h"
 #include "imageio/imageio_module.h"
 
+#include <gio/gio.h>
 #include <inttypes.h>
 #include <libintl.h>
 #include <sys/time.h>
@@ -75,6 +78,10 @@ fprintf(stderr, "darktable %s\n"
                 "  darktable-cli [IMAGE_FILE | IMAGE_FOLDER]\n"
                 "                [XMP_FILE] DIR [OPTIONS]\n"
                 "                [--core DARKTABLE_OPTIONS]\n"
+                "  darktable-cli --batch <MANIFEST | -> [--jobs <n>] [OPTIONS]\n"
+                "                [--core DARKTABLE_OPTIONS]\n"
+                "  darktable-cli --serve <SOCKET | [HOST]:PORT> [--jobs <n>] [OPTIONS]\n"
+                "                [--core DARKTABLE_OPTIONS]\n"
                 "\n"
                 "Options:\n"
                 "   --apply-custom-presets <0|1|false|true>, default: true\n"
@@ -95,6 +102,16 @@ fprintf(stderr, "darktable %s\n"
                 "                          multiple times instead of input file\n"
                 "   --library <path> read the history stack from library database\n"
                 "                    instead of XMP sidecar files\n"
+                "   --batch <file|-> export the jobs of a manifest, one per line:\n"
+                "                    <input> TAB [<xmp>] TAB <output> [TAB <options>]\n"
+                "                    results are written to stdout as JSON lines\n"
+                "   --serve <path|[host]:port> render requests from a unix or TCP socket:\n"
+                "                    <input> TAB [<xmp>] TAB <format> [TAB <options>]\n"
+                "                    answered by a JSON line and the encoded image\n"
+                "                    TCP only on loopback, clients can read any file\n"
+                "                    the user can\n"
+                "   --jobs <n> number of concurrent exports in batch and server mode,\n"
+                "              default: 1\n"
                 "   --icc-type <type> specify icc type, default to NONE\n"
                 "                     use --help icc-type for list of supported types\n"
                 "   --icc-file <file> specify icc filename, default to NONE\n"
@@ -210,6 +227,800 @@ static gboolean _inputs_have_xmp_sidecar(const GList* inputs)
   return inputs != NULL;
 }
 
+// the usual extensions of the formats, takes ownership of ext
+static gchar *_format_name(gchar *ext)
+{
+  const char *name = !strcmp(ext, "jpg") ? "jpeg"
+                   : !strcmp(ext, "tif") ? "tiff"
+                   : !strcmp(ext, "jxl") ? "jpegxl"
+                   : NULL;
+  if(!name) return ext;
+  g_free(ext);
+  return g_strdup(name);
+}
+
+// --batch: the jobs of a manifest share one initialised core. each line is
+//   <input> TAB [<xmp>] TAB <output> [TAB <options>]
+// with the per-image options of the command line. the result of every job
+// is written to stdout as a JSON object on its own line once it's done.
+
+#define DT_BATCH_MAX_LINE (4 * PATH_MAX)
+
+typedef struct _batch_options_t
+{
+  int width;
+  int height;
+  gboolean high_quality;
+  gboolean upscale;
+  gboolean export_masks;
+  gboolean style_overwrite;
+  const char *style;
+  const char *out_ext;
+  dt_colorspaces_color_profile_type_t icc_type;
+  const char *icc_filename;
+  dt_iop_color_intent_t icc_intent;
+} _batch_options_t;
+
+typedef struct _batch_job_t
+{
+  int line;
+  gchar **fields; // input, xmp, output and options
+  gchar **argv;   // the options, the strings of o point into it
+  _batch_options_t o;
+  dt_imgid_t imgid;
+  gchar *error;
+  double import_time;
+  double export_time;
+
+  // server: the requested format and the directory the result goes to
+  gchar *format;
+  gchar *spool;
+} _batch_job_t;
+
+typedef struct _batch_t
+{
+  FILE *manifest;
+  int line;
+  dt_pthread_mutex_t manifest_lock;
+
+  const _batch_options_t *defaults;
+  gboolean custom_presets;
+  dt_imageio_module_storage_t *storage;
+  int omp_threads;
+  dt_atomic_int worker;
+
+  // import and results, one job at a time
+  dt_pthread_mutex_t lock;
+  pthread_cond_t cond;
+  GHashTable *busy; // images being exported
+  GHashTable *seen; // images imported by an earlier job -> _batch_seen_t
+  int failed;
+} _batch_t;
+
+// the file an image has been rendered from, to notice if it is replaced
+typedef struct _batch_seen_t
+{
+  gint64 mtime;
+  goffset size;
+  gboolean imported; // not in the library before, removed again on trimming
+} _batch_seen_t;
+
+// beyond this many images imported by this process, the ones not being
+// exported are removed again so a long running server doesn't grow
+#define DT_CLI_SEEN_MAX 1024
+
+static gboolean _batch_parse_bool(const char *value,
+                                  gboolean *out)
+{
+  gchar *str = g_ascii_strup(value, -1);
+  gboolean ok = TRUE;
+  if(!g_strcmp0(str, "0") || !g_strcmp0(str, "FALSE"))
+    *out = FALSE;
+  else if(!g_strcmp0(str, "1") || !g_strcmp0(str, "TRUE"))
+    *out = TRUE;
+  else
+    ok = FALSE;
+  g_free(str);
+  return ok;
+}
+
+// the options of a manifest line over the ones of the command line,
+// returns the error message or NULL
+static gchar *_batch_parse_options(_batch_options_t *o,
+                                   gchar **argv)
+{
+  for(int k = 0; argv[k]; k++)
+  {
+    const char *opt = argv[k];
+    if(!strcmp(opt, "--style-overwrite"))
+    {
+      o->style_overwrite = TRUE;
+      continue;
+    }
+
+    char *value = argv[k + 1];
+    if(!value) return g_strdup_printf(_("missing value for %s"), opt);
+    k++;
+
+    gboolean ok = TRUE;
+    if(!strcmp(opt, "--width"))
+      o->width = MAX(atoi(value), 0);
+    else if(!strcmp(opt, "--height"))
+      o->height = MAX(atoi(value), 0);
+    else if(!strcmp(opt, "--hq"))
+      ok = _batch_parse_bool(value, &o->high_quality);
+    else if(!strcmp(opt, "--upscale"))
+      ok = _batch_parse_bool(value, &o->upscale);
+    else if(!strcmp(opt, "--export_masks"))
+      ok = _batch_parse_bool(value, &o->export_masks);
+    else if(!strcmp(opt, "--style"))
+      o->style = value;
+    else if(!strcmp(opt, "--out-ext"))
+    {
+      if(*value == '.') value++;
+      o->out_ext = value;
+      ok = *value && strlen(value) <= DT_MAX_OUTPUT_EXT_LENGTH;
+    }
+    else if(!strcmp(opt, "--icc-type"))
+    {
+      gchar *str = g_ascii_strup(value, -1);
+      o->icc_type = get_icc_type(str);
+      g_free(str);
+      ok = o->icc_type < DT_COLORSPACE_LAST;
+    }
+    else if(!strcmp(opt, "--icc-file"))
+    {
+      o->icc_filename = value;
+      ok = g_file_test(value, G_FILE_TEST_IS_REGULAR);
+    }
+    else if(!strcmp(opt, "--icc-intent"))
+    {
+      gchar *str = g_ascii_strup(value, -1);
+      o->icc_intent = get_icc_intent(str);
+      g_free(str);
+      ok = o->icc_intent < DT_INTENT_LAST;
+    }
+    else
+      return g_strdup_printf(_("unknown option '%s'"), opt);
+
+    if(!ok) return g_strdup_printf(_("bad value for %s: '%s'"), opt, value);
+  }
+  return NULL;
+}
+
+static void _batch_job_init(const _batch_t *b,
+                            _batch_job_t *job,
+                            const int line)
+{
+  memset(job, 0, sizeof(_batch_job_t));
+  job->line = line;
+  job->o = *b->defaults;
+  job->imgid = NO_IMGID;
+}
+
+// the fields of a manifest line or request, FALSE for empty lines and comments
+static gboolean _batch_parse_line(_batch_job_t *job,
+                                  char *buf)
+{
+  buf[strcspn(buf, "\r\n")] = '\0';
+  if(buf[0] == '\0' || buf[0] == '#') return FALSE;
+
+  job->fields = g_strsplit(buf, "\t", 4);
+  if(g_strv_length(job->fields) < 3 || !*job->fields[0] || !*job->fields[2])
+    job->error = g_strdup(_("expected <input> TAB [<xmp>] TAB <output> [TAB <options>]"));
+  else if(job->fields[3] && *g_strstrip(job->fields[3]))
+  {
+    GError *error = NULL;
+    if(g_shell_parse_argv(job->fields[3], NULL, &job->argv, &error))
+      job->error = _batch_parse_options(&job->o, job->argv);
+    else
+    {
+      job->error = g_strdup(error->message);
+      g_error_free(error);
+    }
+  }
+  return TRUE;
+}
+
+// read the next job, FALSE at the end of the manifest. manifest_lock held.
+static gboolean _batch_next_job(_batch_t *b,
+                                _batch_job_t *job)
+{
+  char buf[DT_BATCH_MAX_LINE];
+  while(fgets(buf, sizeof(buf), b->manifest))
+  {
+    _batch_job_init(b, job, ++b->line);
+
+    const size_t len = strlen(buf);
+    if(len && buf[len - 1] != '\n' && !feof(b->manifest))
+    {
+      // skip the rest of the line
+      int c;
+      while((c = fgetc(b->manifest)) != EOF && c != '\n');
+      job->error = g_strdup(_("line too long"));
+      return TRUE;
+    }
+    if(_batch_parse_line(job, buf)) return TRUE;
+  }
+  return FALSE;
+}
+
+static void _batch_job_clear(_batch_job_t *job)
+{
+  g_strfreev(job->fields);
+  g_strfreev(job->argv);
+  g_free(job->error);
+  g_free(job->format);
+  g_free(job->spool);
+}
+
+// forget the images of earlier jobs. those imported by us are removed from the
+// library, a later job imports them again and reads their sidecar. lock held.
+static void _batch_trim_seen(_batch_t *b)
+{
+  if(g_hash_table_size(b->seen) <= DT_CLI_SEEN_MAX) return;
+
+  GHashTableIter it;
+  gpointer key, value;
+  g_hash_table_iter_init(&it, b->seen);
+  while(g_hash_table_iter_next(&it, &key, &value))
+  {
+    const _batch_seen_t *seen = value;
+    if(!seen->imported || g_hash_table_contains(b->busy, key)) continue;
+    dt_image_remove(GPOINTER_TO_INT(key));
+    g_hash_table_iter_remove(&it);
+  }
+}
+
+// import the input and give it the history of the job. lock held.
+static void _batch_import(_batch_t *b,
+                          _batch_job_t *job)
+{
+  const char *input = job->fields[0];
+  const char *xmp = job->fields[1];
+
+  GStatBuf st;
+  if(!g_file_test(input, G_FILE_TEST_IS_REGULAR) || g_stat(input, &st))
+  {
+    job->error = g_strdup_printf(_("can't open file %s"), input);
+    return;
+  }
+
+  dt_film_t film;
+  gchar *directory = g_path_get_dirname(input);
+  const dt_filmid_t filmid = dt_film_new(&film, directory);
+  g_free(directory);
+  const gboolean known = dt_is_valid_imgid(dt_image_get_id_full_path(input));
+  if(dt_is_valid_filmid(filmid))
+    job->imgid = dt_image_import(filmid, input, TRUE, FALSE);
+  if(!dt_is_valid_imgid(job->imgid))
+  {
+    job->error = g_strdup_printf(_("can't import file %s"), input);
+    return;
+  }
+
+  // another job may be exporting the same image with its own history
+  gpointer key = GINT_TO_POINTER(job->imgid);
+  while(g_hash_table_contains(b->busy, key))
+    dt_pthread_cond_wait(&b->cond, &b->lock);
+
+  // the import returns the id of a known path, a file replaced since would
+  // be rendered from the mipmaps and image information of the old one
+  _batch_seen_t *seen = g_hash_table_lookup(b->seen, key);
+  if(known && (!seen || seen->mtime != st.st_mtime || seen->size != st.st_size))
+  {
+    dt_mipmap_cache_remove(job->imgid);
+    dt_mipmap_cache_evict_at_size(job->imgid, DT_MIPMAP_FULL);
+    dt_mipmap_cache_evict_at_size(job->imgid, DT_MIPMAP_F);
+    dt_image_t *image = dt_image_cache_get(job->imgid, 'w');
+    if(image)
+    {
+      dt_exif_read(image, input);
+      dt_image_cache_write_release(image, DT_IMAGE_CACHE_RELAXED);
+    }
+  }
+
+  // the import did read the sidecar, unless the image came with an
+  // earlier job which might have left another history behind
+  gchar *sidecar = *xmp ? NULL : g_strconcat(input, ".xmp", NULL);
+  if(sidecar && !g_file_test(sidecar, G_FILE_TEST_EXISTS))
+    g_clear_pointer(&sidecar, g_free);
+  const char *history = *xmp ? xmp : sidecar;
+
+  if(*xmp || seen)
+  {
+    if(history)
+    {
+      dt_image_t *image = dt_image_cache_get(job->imgid, 'w');
+      if(dt_exif_xmp_read(image, history, FALSE))
+        job->error = g_strdup_printf(_("can't open XMP file %s"), history);
+      // don't write new xmp:
+      dt_image_cache_write_release(image, DT_IMAGE_CACHE_RELAXED);
+    }
+    else
+      dt_history_delete_on_image_ext(job->imgid, FALSE, TRUE);
+  }
+  g_free(sidecar);
+
+  if(job->error) return;
+  if(!seen)
+  {
+    seen = g_malloc(sizeof(_batch_seen_t));
+    seen->imported = !known;
+    g_hash_table_insert(b->seen, key, seen);
+  }
+  seen->mtime = st.st_mtime;
+  seen->size = st.st_size;
+  g_hash_table_add(b->busy, key);
+  _batch_trim_seen(b);
+}
+
+// the output pattern and format name, same rules as for the command line
+static gchar *_batch_output(const _batch_job_t *job,
+                            gchar **pattern,
+                            gchar **ext)
+{
+  gchar *output = g_strdup(job->fields[2]);
+  if(g_file_test(output, G_FILE_TEST_IS_DIR))
+  {
+    if(g_str_has_suffix(output, "/")) output[strlen(output) - 1] = '\0';
+    *pattern = g_strconcat(output, "/$(FILE_NAME)", NULL);
+    *ext = g_strdup(job->o.out_ext ? job->o.out_ext : "jpg");
+    g_free(output);
+  }
+  else
+  {
+    char *dot = strrchr(output, '.');
+    if(!job->o.out_ext)
+    {
+      if(!dot || strlen(dot) <= 1 || strlen(dot) > DT_MAX_OUTPUT_EXT_LENGTH)
+      {
+        g_free(output);
+        return g_strdup(_("no valid output file extension given"));
+      }
+      *ext = g_strdup(dot + 1);
+      *dot = '\0';
+    }
+    else
+    {
+      *ext = g_strdup(job->o.out_ext);
+      if(dot && !strcmp(job->o.out_ext, dot + 1)) *dot = '\0';
+    }
+    *pattern = output;
+  }
+  *ext = _format_name(*ext);
+  return NULL;
+}
+
+static void _batch_export(_batch_t *b,
+                          _batch_job_t *job)
+{
+  gchar *pattern = NULL;
+  gchar *ext = NULL;
+  job->error = _batch_output(job, &pattern, &ext);
+  if(job->error) return;
+
+  dt_imageio_module_storage_t *storage = b->storage;
+  dt_imageio_module_format_t *format = dt_imageio_get_format_by_name(ext);
+  dt_imageio_module_data_t *sdata = format ? storage->get_params(storage) : NULL;
+  dt_imageio_module_data_t *fdata = sdata ? format->get_params(format) : NULL;
+  if(!format)
+    job->error = g_strdup_printf(_("unknown extension '.%s'"), ext);
+  else if(!fdata)
+    job->error = g_strdup(_("failed to get parameters from the export modules"));
+  g_free(ext);
+
+  if(!job->error)
+  {
+    g_strlcpy((char *)sdata, pattern, DT_MAX_PATH_FOR_PARAMS);
+
+    uint32_t w, h, fw, fh, sw, sh;
+    fw = fh = sw = sh = 0;
+    storage->dimension(storage, sdata, &sw, &sh);
+    format->dimension(format, fdata, &fw, &fh);
+    w = (sw == 0 || fw == 0) ? MAX(sw, fw) : MIN(sw, fw);
+    h = (sh == 0 || fh == 0) ? MAX(sh, fh) : MIN(sh, fh);
+
+    fdata->max_width = (w != 0 && job->o.width > w) ? w : job->o.width;
+    fdata->max_height = (h != 0 && job->o.height > h) ? h : job->o.height;
+    fdata->style[0] = '\0';
+    fdata->style_append = !job->o.style_overwrite;
+    if(job->o.style)
+      g_strlcpy(fdata->style, job->o.style, sizeof(fdata->style));
+
+    dt_export_metadata_t metadata = { 0 };
+    if(b->custom_presets)
+    {
+      metadata.flags = dt_lib_export_metadata_get_conf_flags();
+      metadata.list = dt_util_str_to_glist("\1", dt_lib_export_metadata_get_conf());
+      if(metadata.list)
+        metadata.list = g_list_delete_link(metadata.list, metadata.list);
+    }
+    else
+    {
+      metadata.flags = dt_lib_export_metadata_default_flags();
+      metadata.list = NULL;
+    }
+
+    if(storage->store(storage, sdata, job->imgid, format, fdata, 1, 1,
+                      job->o.high_quality, job->o.upscale, FALSE, 1.0,
+                      job->o.export_masks, job->o.icc_type,
+                      job->o.icc_filename, job->o.icc_intent, &metadata) != 0)
+      job->error = g_strdup(_("export failed"));
+    g_list_free_full(metadata.list, g_free);
+  }
+
+  if(fdata) format->free_params(format, fdata);
+  if(sdata) storage->free_params(storage, sdata);
+  g_free(pattern);
+}
+
+static void _json_string(GString *s,
+                         const char *str)
+{
+  if(!str)
+  {
+    g_string_append(s, "null");
+    return;
+  }
+  g_string_append_c(s, '"');
+  for(; *str; str++)
+  {
+    const unsigned char c = *str;
+    if(c == '"' || c == '\\')
+      g_string_append_printf(s, "\\%c", c);
+    else if(c < 0x20)
+      g_string_append_printf(s, "\\u%04x", c);
+    else
+      g_string_append_c(s, c);
+  }
+  g_string_append_c(s, '"');
+}
+
+// the result of the job as one line of JSON, with the size of the
+// encoded image that follows it for the server
+static GString *_batch_result(const _batch_job_t *job,
+                              const gssize size)
+{
+  GString *s = g_string_new(NULL);
+  g_string_append_printf(s, "{\"line\": %d, \"input\": ", job->line);
+  _json_string(s, job->fields ? job->fields[0] : NULL);
+  g_string_append(s, ", \"output\": ");
+  _json_string(s, job->fields && job->fields[0] && job->fields[1] ? job->fields[2] : NULL);
+  g_string_append_printf(s, ", \"imgid\": %d, \"status\": \"%s\", \"error\": ",
+                         job->imgid, job->error ? "failed" : "ok");
+  _json_string(s, job->error);
+  g_string_append_printf(s, ", \"import_time\": %.3f, \"export_time\": %.3f",
+                         job->import_time, job->export_time);
+  if(size >= 0) g_string_append_printf(s, ", \"size\": %" G_GSSIZE_FORMAT, size);
+  g_string_append(s, "}\n");
+  return s;
+}
+
+// one line of JSON on stdout. lock held.
+static void _batch_report(_batch_t *b,
+                          const _batch_job_t *job)
+{
+  GString *s = _batch_result(job, -1);
+  fputs(s->str, stdout);
+  fflush(stdout);
+  g_string_free(s, TRUE);
+
+  if(job->error) b->failed++;
+}
+
+// import and export one job, the lock is taken when needed
+static void _batch_process(_batch_t *b,
+                           _batch_job_t *job)
+{
+  if(job->error) return;
+
+  dt_pthread_mutex_lock(&b->lock);
+  const double start = dt_get_wtime();
+  _batch_import(b, job);
+  job->import_time = dt_get_wtime() - start;
+  dt_pthread_mutex_unlock(&b->lock);
+  if(job->error) return;
+
+  // the pixelpipes of the workers run side by side
+  const double export_start = dt_get_wtime();
+  _batch_export(b, job);
+  job->export_time = dt_get_wtime() - export_start;
+
+  dt_pthread_mutex_lock(&b->lock);
+  g_hash_table_remove(b->busy, GINT_TO_POINTER(job->imgid));
+  pthread_cond_broadcast(&b->cond);
+  dt_pthread_mutex_unlock(&b->lock);
+}
+
+static void *_batch_run(void *data)
+{
+  _batch_t *b = data;
+#ifdef _OPENMP
+  omp_set_num_threads(b->omp_threads);
+#endif
+  dt_pthread_setname("cli batch");
+  dt_numa_bind_team(dt_atomic_add_int(&b->worker, 1));
+
+  while(TRUE)
+  {
+    _batch_job_t job;
+    dt_pthread_mutex_lock(&b->manifest_lock);
+    const gboolean more = _batch_next_job(b, &job);
+    dt_pthread_mutex_unlock(&b->manifest_lock);
+    if(!more) break;
+
+    _batch_process(b, &job);
+
+    dt_pthread_mutex_lock(&b->lock);
+    _batch_report(b, &job);
+    dt_pthread_mutex_unlock(&b->lock);
+    _batch_job_clear(&job);
+  }
+  return NULL;
+}
+
+static int _batch_main(int argc,
+                       char **argv,
+                       const char *manifest,
+                       const int jobs,
+                       const _batch_options_t *defaults,
+                       const gboolean custom_presets)
+{
+  const gboolean from_stdin = !strcmp(manifest, "-");
+  FILE *f = from_stdin ? stdin : g_fopen(manifest, "r");
+  if(!f)
+  {
+    fprintf(stderr, _("error: can't open manifest %s"), manifest);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+
+  // init dt without gui and without data.db:
+  if(dt_init(argc, argv, FALSE, custom_presets, NULL))
+  {
+    if(!from_stdin) fclose(f);
+    return 1;
+  }
+
+  _batch_t b = {
+    .manifest = f,
+    .defaults = defaults,
+    .custom_presets = custom_presets,
+    .storage = dt_imageio_get_storage_by_name("disk"), // only exporting to disk makes sense
+    .omp_threads = MAX(1, dt_get_num_threads() / jobs),
+    .busy = g_hash_table_new(NULL, NULL),
+    .seen = g_hash_table_new_full(NULL, NULL, NULL, g_free),
+  };
+
+  int res = 1;
+  if(b.storage == NULL)
+    fprintf(
+        stderr, "%s\n",
+        _("cannot find disk storage module. please check your installation, something seems to be broken."));
+  else
+  {
+    dt_pthread_mutex_init(&b.manifest_lock, NULL);
+    dt_pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.cond, NULL);
+
+    pthread_t *worker = g_malloc0_n(jobs, sizeof(pthread_t));
+    int started = 0;
+    for(int k = 0; jobs > 1 && k < jobs; k++)
+      if(!dt_pthread_create(&worker[started], _batch_run, &b)) started++;
+    // a single worker or none could be started, do the work ourselves
+    if(started == 0)
+      _batch_run(&b);
+    for(int k = 0; k < started; k++)
+      pthread_join(worker[k], NULL);
+    g_free(worker);
+
+    pthread_cond_destroy(&b.cond);
+    dt_pthread_mutex_destroy(&b.lock);
+    dt_pthread_mutex_destroy(&b.manifest_lock);
+    res = b.failed ? 1 : 0;
+  }
+
+  g_hash_table_destroy(b.busy);
+  g_hash_table_destroy(b.seen);
+  if(!from_stdin) fclose(f);
+  dt_cleanup();
+  return res;
+}
+
+// --serve: render requests over a socket, with the caches of one core kept
+// warm between them. a client sends lines of
+//   <input> TAB [<xmp>] TAB <format> [TAB <options>]
+// and gets for each the JSON result of the job followed by the "size"
+// bytes of the encoded image.
+
+// export the job into a directory of its own and read the result back
+static gchar *_serve_job(_batch_t *b,
+                         _batch_job_t *job,
+                         gsize *size)
+{
+  *size = 0;
+  if(job->error) return NULL;
+
+  GError *error = NULL;
+  job->spool = g_dir_make_tmp("darktable-cli-XXXXXX", &error);
+  if(!job->spool)
+  {
+    job->error = g_strdup(error->message);
+    g_error_free(error);
+    return NULL;
+  }
+
+  // the requested format is the extension of the output
+  job->format = job->fields[2];
+  job->fields[2] = g_strdup(job->spool);
+  job->o.out_ext = *job->format == '.' ? job->format + 1 : job->format;
+
+  _batch_process(b, job);
+
+  gchar *result = NULL;
+  GDir *dir = g_dir_open(job->spool, 0, NULL);
+  const gchar *name;
+  while(dir && (name = g_dir_read_name(dir)))
+  {
+    gchar *path = g_build_filename(job->spool, name, NULL);
+    if(!job->error && !result && !g_file_get_contents(path, &result, size, &error))
+    {
+      job->error = g_strdup(error->message);
+      g_clear_error(&error);
+    }
+    g_unlink(path);
+    g_free(path);
+  }
+  if(dir) g_dir_close(dir);
+  g_rmdir(job->spool);
+
+  if(!job->error && !result) job->error = g_strdup(_("export failed"));
+  // don't tell the client about the spool directory
+  g_free(job->fields[2]);
+  job->fields[2] = g_strdup(job->format);
+  return result;
+}
+
+static void _serve_connection(gpointer data,
+                              gpointer user_data)
+{
+  GSocketConnection *connection = data;
+  _batch_t *b = user_data;
+#ifdef _OPENMP
+  omp_set_num_threads(b->omp_threads);
+#endif
+
+  GDataInputStream *in =
+    g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+  GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+
+  int line = 0;
+  gboolean ok = TRUE;
+  gchar *request;
+  while(ok && (request = g_data_input_stream_read_line(in, NULL, NULL, NULL)))
+  {
+    _batch_job_t job;
+    _batch_job_init(b, &job, ++line);
+    if(_batch_parse_line(&job, request))
+    {
+      gsize size;
+      gchar *result = _serve_job(b, &job, &size);
+      GString *s = _batch_result(&job, size);
+      ok = g_output_stream_write_all(out, s->str, s->len, NULL, NULL, NULL)
+        && (!result || g_output_stream_write_all(out, result, size, NULL, NULL, NULL))
+        && g_output_stream_flush(out, NULL, NULL);
+      dt_print(DT_DEBUG_IMAGEIO, "[darktable-cli] served %s: %s",
+               job.fields[0], job.error ? job.error : "ok");
+      g_string_free(s, TRUE);
+      g_free(result);
+    }
+    _batch_job_clear(&job);
+    g_free(request);
+  }
+
+  g_object_unref(in);
+  g_object_unref(connection);
+}
+
+// [host]:port for TCP, on localhost without host, anything else is the
+// path of a unix socket. requests name arbitrary files to be read and there
+// is no authentication, so TCP is only served on a loopback address.
+static GSocketAddress *_serve_address(const char *address)
+{
+  const char *colon = strrchr(address, ':');
+  char *end = NULL;
+  const long port = colon ? strtol(colon + 1, &end, 10) : 0;
+  if(colon && !strchr(address, '/') && end && *end == '\0' && port > 0 && port < 65536)
+  {
+    gchar *host = colon == address ? g_strdup("127.0.0.1") : g_strndup(address, colon - address);
+    GSocketAddress *a = g_inet_socket_address_new_from_string(host, port);
+    g_free(host);
+    if(a && !g_inet_address_get_is_loopback
+                (g_inet_socket_address_get_address(G_INET_SOCKET_ADDRESS(a))))
+    {
+      fprintf(stderr, _("error: only loopback addresses can be served, use a unix socket"
+                        " or a tunnel for remote clients\n"));
+      g_clear_object(&a);
+    }
+    return a;
+  }
+
+#ifdef S_ISSOCK
+  // left behind by an earlier server
+  GStatBuf st;
+  if(!g_stat(address, &st) && S_ISSOCK(st.st_mode)) g_unlink(address);
+#endif
+  return g_unix_socket_address_new(address);
+}
+
+static int _serve_main(int argc,
+                       char **argv,
+                       const char *address,
+                       const int jobs,
+                       const _batch_options_t *defaults,
+                       const gboolean custom_presets)
+{
+  GSocketAddress *addr = _serve_address(address);
+  if(!addr)
+  {
+    fprintf(stderr, _("error: invalid address %s"), address);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+
+  // init dt without gui and without data.db:
+  if(dt_init(argc, argv, FALSE, custom_presets, NULL))
+  {
+    g_object_unref(addr);
+    return 1;
+  }
+
+  _batch_t b = {
+    .defaults = defaults,
+    .custom_presets = custom_presets,
+    .storage = dt_imageio_get_storage_by_name("disk"),
+    .omp_threads = MAX(1, dt_get_num_threads() / jobs),
+    .busy = g_hash_table_new(NULL, NULL),
+    .seen = g_hash_table_new_full(NULL, NULL, NULL, g_free),
+  };
+  dt_pthread_mutex_init(&b.lock, NULL);
+  pthread_cond_init(&b.cond, NULL);
+
+  GError *error = NULL;
+  GSocketListener *listener = g_socket_listener_new();
+  if(b.storage == NULL)
+    fprintf(
+        stderr, "%s\n",
+        _("cannot find disk storage module. please check your installation, something seems to be broken."));
+  else if(!g_socket_listener_add_address(listener, addr, G_SOCKET_TYPE_STREAM,
+                                         G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error))
+    fprintf(stderr, _("error: can't listen on %s: %s\n"), address, error->message);
+  else
+  {
+    // only the user running the server may connect to a unix socket
+    if(G_IS_UNIX_SOCKET_ADDRESS(addr)) g_chmod(address, 0600);
+    fprintf(stderr, _("notice: serving render requests on %s\n"), address);
+    // one connection per worker, the others wait in the queue of the pool
+    GThreadPool *pool = g_thread_pool_new(_serve_connection, &b, jobs, FALSE, NULL);
+    GSocketConnection *connection;
+    while((connection = g_socket_listener_accept(listener, NULL, NULL, &error)))
+      g_thread_pool_push(pool, connection, NULL);
+    fprintf(stderr, _("error: can't accept connections: %s\n"), error->message);
+    g_thread_pool_free(pool, FALSE, TRUE);
+  }
+  g_clear_error(&error);
+
+  g_object_unref(listener);
+  g_object_unref(addr);
+  pthread_cond_destroy(&b.cond);
+  dt_pthread_mutex_destroy(&b.lock);
+  g_hash_table_destroy(b.busy);
+  g_hash_table_destroy(b.seen);
+  dt_cleanup();
+  return 1;
+}
+
 int main(int argc, char *arg[])
 {
 #ifdef __APPLE__
@@ -231,6 +1042,9 @@ int main(int argc, char *arg[])
   gchar *output_ext = NULL;
   char *style = NULL;
   char *library = NULL;
+  char *batch = NULL;
+  char *serve = NULL;
+  int batch_jobs = 1;
   int file_counter = 0;
   int width = 0, height = 0, bpp = 0;
   gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE,
@@ -385,6 +1199,21 @@ int main(int argc, char *arg[])
         k++;
         library = arg[k];
       }
+      else if(!strcmp(arg[k], "--batch") && argc > k + 1)
+      {
+        k++;
+        batch = arg[k];
+      }
+      else if(!strcmp(arg[k], "--serve") && argc > k + 1)
+      {
+        k++;
+        serve = arg[k];
+      }
+      else if(!strcmp(arg[k], "--jobs") && argc > k + 1)
+      {
+        k++;
+        batch_jobs = MAX(atoi(arg[k]), 1);
+      }
       else if(!strcmp(arg[k], "--icc-type") && argc > k + 1)
       {
         k++;
@@ -463,7 +1292,20 @@ int main(int argc, char *arg[])
   m_arg[m_argc] = NULL;
 
   gboolean args_error = FALSE;
-  if(inputs && file_counter < 1)
+  if(batch || serve)
+  {
+    if(batch && serve)
+    {
+      fprintf(stderr, _("error: --batch and --serve can't be used together\n\n"));
+      args_error = TRUE;
+    }
+    else if(inputs || file_counter > 0)
+    {
+      fprintf(stderr, _("error: input and output are given by the jobs in batch and server mode\n\n"));
+      args_error = TRUE;
+    }
+  }
+  else if(inputs && file_counter < 1)
   {
     fprintf(stderr, _("error: output file or directory must be specified\n\n"));
     args_error = TRUE;
@@ -497,6 +1339,30 @@ int main(int argc, char *arg[])
     exit(1);
   }
 
+  if(batch || serve)
+  {
+    const _batch_options_t defaults = {
+      .width = width,
+      .height = height,
+      .high_quality = high_quality,
+      .upscale = upscale,
+      .export_masks = export_masks,
+      .style_overwrite = style_overwrite,
+      .style = style,
+      .out_ext = output_ext,
+      .icc_type = icc_type,
+      .icc_filename = icc_filename,
+      .icc_intent = icc_intent,
+    };
+    const int res = batch
+      ? _batch_main(m_argc, m_arg, batch, batch_jobs, &defaults, custom_presets)
+      : _serve_main(m_argc, m_arg, serve, batch_jobs, &defaults, custom_presets);
+    free(m_arg);
+    g_free(output_ext);
+    g_free(icc_filename);
+    exit(res);
+  }
+
   if(inputs && file_counter == 1)
   {
     //user specified inputs as options, and only dest is present
@@ -730,23 +1596,7 @@ int main(int argc, char *arg[])
     }
   }
 
-  if(!strcmp(output_ext, "jpg"))
-  {
-    g_free(output_ext);
-    output_ext = g_strdup("jpeg");
-  }
-
-  if(!strcmp(output_ext, "tif"))
-  {
-    g_free(output_ext);
-    output_ext = g_strdup("tiff");
-  }
-
-  if(!strcmp(output_ext, "jxl"))
-  {
-    g_free(output_ext);
-    output_ext = g_strdup("jpegxl");
-  }
+  output_ext = _format_name(output_ext);
 
   // init the export data structures
   dt_imageio_module_format_t *format;
@@ -844,7 +1694,7 @@ int main(int argc, char *arg[])
   for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
   {
     const int id = GPOINTER_TO_INT(iter->data);
-    dt_export_metadata_t metadata;
+    dt_export_metadata_t metadata = { 0 };
     // TODO: have a parameter in command line to get the export presets
     if(custom_presets)
     {
@@ -858,9 +1708,12 @@ int main(int argc, char *arg[])
       metadata.flags = dt_lib_export_metadata_default_flags();
       metadata.list = NULL;
     }
-    if(storage->store(storage, sdata, id, format, fdata, num, total, high_quality,
-                      upscale, FALSE, 1.0, export_masks,
-                      icc_type, icc_filename, icc_intent, &metadata) != 0)
+    // a deferred image is waited for by finalize_store()
+    const int stored =
+      storage->store(storage, sdata, id, format, fdata, num, total, high_quality,
+                     upscale, FALSE, 1.0, export_masks,
+                     icc_type, icc_filename, icc_intent, &metadata);
+    if(stored != 0 && stored != DT_IMAGEIO_STORE_DEFERRED)
       res = 1;
   }
 
@@ -23,6 +23,7 @@
 #include "common/ai_models.h"
 #include "common/colorspaces.h"
 #include "common/iop_order.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include "control/jobs.h"
 #include "develop/develop.h"
@@ -36,6 +37,11 @@
 #define OVERLAP_DENOISE 64
 #define OVERLAP_UPSCALE 16
 
+// upper bound for batched tile inference and the memory one batch may
+// take on the device (inputs, outputs and a rough activation estimate)
+#define DT_RESTORE_MAX_BATCH 4
+#define DT_RESTORE_BATCH_BYTES ((size_t)768 << 20)
+
 // --- environment lifecycle ---
 
 dt_restore_env_t *dt_restore_env_init(void)
@@ -204,6 +210,48 @@ static int _resolve_tile_size(const dt_ai_model_info_t *info,
   return tile_size;
 }
 
+// resolve how many tiles go into one inference call. only models whose
+// batch dim is dynamic (or baked > 1) can take more than one; the count
+// comes from "<stem>.max_batch" or top-level "max_batch" and is capped
+// by a fixed activation budget since the backend can't report free
+// device memory. CPU sessions gain nothing from batching, stay at 1
+static int _resolve_max_batch(const dt_ai_model_info_t *info,
+                              const char *stem,
+                              dt_ai_context_t *ai_ctx,
+                              const int tile_size,
+                              const int scale)
+{
+  int64_t shape[4] = { 0 };
+  const int ndim = dt_ai_get_output_shape(ai_ctx, 0, shape, 4);
+  if(ndim != 4 || shape[0] == 1) return 1;
+
+  char *provider = dt_conf_get_string(DT_AI_CONF_PROVIDER);
+  const gboolean cpu = dt_ai_provider_from_string(provider) == DT_AI_PROVIDER_CPU;
+  g_free(provider);
+  if(cpu) return 1;
+
+  int batch = DT_RESTORE_MAX_BATCH;
+  if(stem)
+  {
+    char *key = g_strdup_printf("%s.max_batch", stem);
+    batch = dt_ai_model_attribute_int(info, key, 0);
+    g_free(key);
+  }
+  if(batch <= 0)
+    batch = dt_ai_model_attribute_int(info, "max_batch", DT_RESTORE_MAX_BATCH);
+  if(shape[0] > 1) batch = MIN(batch, (int)shape[0]);
+
+  // input, output and an estimate for the activations of one tile,
+  // half precision variants need half of it on the device
+  const size_t out_dim = (size_t)tile_size * scale;
+  const size_t elem = dt_ai_get_input_type(ai_ctx, 0) == DT_AI_FLOAT16
+    ? sizeof(uint16_t) : sizeof(float);
+  const size_t tile_bytes
+    = (size_t)3 * elem * ((size_t)tile_size * tile_size + 2 * out_dim * out_dim);
+  const int fit = (int)MAX(1, DT_RESTORE_BATCH_BYTES / MAX(1, tile_bytes));
+  return CLAMP(MIN(batch, fit), 1, DT_RESTORE_MAX_BATCH);
+}
+
 // internal: resolve task -> model_id -> load static ONNX. `stem` is the
 // file-stem variant key inside the package's attributes object (e.g.
 // "model_bayer" → looks up attributes.model_bayer.* and loads
@@ -347,6 +395,7 @@ static dt_restore_context_t *_load(dt_restore_env_t *env,
   ctx->model_id            = model_id;
   ctx->model_file          = model_file;   // take ownership
   ctx->tile_size           = tile_size;
+  ctx->max_batch           = _resolve_max_batch(info, stem, ai_ctx, tile_size, scale);
   ctx->preserve_wide_gamut = TRUE;
 
   // resolve policy enums: per-variant defaults reproduce today's
@@ -621,6 +670,7 @@ gboolean dt_restore_reload_session_cpu(dt_restore_context_t *ctx)
     return FALSE;
   }
   ctx->ai_ctx = new_ctx;
+  ctx->max_batch = 1;
   return TRUE;
 }
 
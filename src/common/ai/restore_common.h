@@ -142,6 +142,7 @@ struct dt_restore_context_t
   float                          target_mean;  // NAN = no exposure boost
   int scale;        // model upscale factor (1 for denoise, 2/4 for upscale)
   int tile_size;    // static input dim baked into the loaded ONNX
+  int max_batch;    // tiles per inference call, 1 for fixed batch exports
   // color management (RGB path): convert working profile → sRGB before
   // inference and back after. if has_profile is FALSE, fall back to
   // gamma-only conversion (treats working-profile numbers as if sRGB).
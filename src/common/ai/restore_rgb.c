@@ -195,41 +195,23 @@ void dt_restore_set_preserve_wide_gamut(dt_restore_context_t *ctx, gboolean pres
   if(ctx) ctx->preserve_wide_gamut = preserve;
 }
 
-int dt_restore_run_patch(dt_restore_context_t *ctx,
-                         const float *in_patch,
-                         int w, int h,
-                         float *out_patch,
-                         int scale)
+// tensor buffers of the session used by dt_restore_run_patches()
+#define _BUF_MODEL_INPUT 0
+#define _BUF_NOISE_MAP   1
+
+// convert one planar patch to gamma-encoded sRGB. If a working profile
+// is set, first convert primaries (working profile -> sRGB linear) so the
+// model sees the image as if it were native sRGB. Otherwise only apply the
+// gamma curve (legacy path, shifts hues for wide-gamut). in_gamut_mask,
+// when given, records which pixels were in sRGB gamut so the output pass
+// can skip recomputing WP->sRGB
+static void _patch_to_model(const dt_restore_context_t *ctx,
+                            const float *in_patch,
+                            const size_t plane,
+                            float *srgb_in,
+                            uint8_t *in_gamut_mask)
 {
-  if(!ctx || !ctx->ai_ctx) return 1;
-  const size_t in_pixels = (size_t)w * h * 3;
-  const int out_w = w * scale;
-  const int out_h = h * scale;
-  const size_t out_pixels = (size_t)out_w * out_h * 3;
-  const size_t plane = (size_t)w * h;
-
-  // convert to sRGB gamma-encoded. If a working profile is set,
-  // first convert primaries (working profile -> sRGB linear) so the
-  // model sees the image as if it were native sRGB. Otherwise only
-  // apply the gamma curve (legacy path, shifts hues for wide-gamut).
-  // input layout is planar NCHW: R plane, then G plane, then B plane.
-  // in_gamut_mask records which pixels were in sRGB gamut (scale==1
-  // only) so the output pass can skip recomputing WP->sRGB
-  float *srgb_in = g_try_malloc(in_pixels * sizeof(float));
-  uint8_t *in_gamut_mask = NULL;
-  if(!srgb_in) return 1;
-  // only allocate the gamut mask when denoise pass-through is requested
-  const gboolean need_gamut_mask
-    = ctx->has_profile && scale == 1 && ctx->preserve_wide_gamut;
-  if(need_gamut_mask)
-  {
-    in_gamut_mask = g_try_malloc(plane);
-    if(!in_gamut_mask)
-    {
-      g_free(srgb_in);
-      return 1;
-    }
-  }
+  const size_t in_pixels = plane * 3;
 
   if(ctx->has_profile)
   {
@@ -285,74 +267,32 @@ int dt_restore_run_patch(dt_restore_context_t *ctx,
     for(size_t i = 0; i < in_pixels; i++)
       srgb_in[i] = _linear_to_srgb(fminf(in_patch[i], 1.0f));
   }
+}
 
-  const int num_inputs = dt_ai_get_input_count(ctx->ai_ctx);
-  if(num_inputs > MAX_MODEL_INPUTS)
-  {
-    g_free(srgb_in);
-    return 1;
-  }
-
-  int64_t input_shape[] = {1, 3, h, w};
-  dt_ai_tensor_t inputs[MAX_MODEL_INPUTS];
-  memset(inputs, 0, sizeof(inputs));
-  inputs[0] = (dt_ai_tensor_t){
-    .data = (void *)srgb_in,
-    .shape = input_shape,
-    .ndim = 4,
-    .type = DT_AI_FLOAT};
-
-  // noise level map for multi-input models
-  float *noise_map = NULL;
-  int64_t noise_shape[] = {1, 1, h, w};
-  if(num_inputs >= 2)
-  {
-    const size_t map_size = (size_t)w * h;
-    noise_map = g_try_malloc(map_size * sizeof(float));
-    if(!noise_map)
-    {
-      g_free(srgb_in);
-      return 1;
-    }
-    const float sigma_norm = 25.0f / 255.0f;
-    for(size_t i = 0; i < map_size; i++)
-      noise_map[i] = sigma_norm;
-    inputs[1] = (dt_ai_tensor_t){
-      .data = (void *)noise_map,
-      .shape = noise_shape,
-      .ndim = 4,
-      .type = DT_AI_FLOAT};
-  }
-
-  int64_t output_shape[] = {1, 3, out_h, out_w};
-  dt_ai_tensor_t output = {
-    .data = (void *)out_patch,
-    .shape = output_shape,
-    .ndim = 4,
-    .type = DT_AI_FLOAT};
-
-  int ret = dt_ai_run(ctx->ai_ctx, inputs, num_inputs,
-                      &output, 1);
-  g_free(srgb_in);
-  g_free(noise_map);
-  if(ret != 0)
-  {
-    g_free(in_gamut_mask);
-    return ret;
-  }
+// convert model output back to the working profile
+//
+// with profile: apply inverse sRGB gamma, then check if the ORIGINAL
+// input pixel (converted to sRGB linear) is representable in sRGB
+// gamut. if yes, use model output converted back to working profile.
+// if no, pass through the original pixel (wide-gamut colors preserved,
+// no denoising on those pixels). upscale has no pixel-to-pixel
+// correspondence so pass-through is not possible — always use the
+// model output
+//
+// without profile: fall back to per-channel pass-through in the
+// original (working-profile-as-sRGB) space
+static void _patch_from_model(const dt_restore_context_t *ctx,
+                              const float *in_patch,
+                              int w, int h,
+                              float *out_patch,
+                              int scale,
+                              const uint8_t *in_gamut_mask)
+{
+  const int out_w = w * scale;
+  const int out_h = h * scale;
+  const size_t out_pixels = (size_t)out_w * out_h * 3;
+  const size_t plane = (size_t)w * h;
 
-  // convert model output back to the working profile
-  //
-  // with profile: apply inverse sRGB gamma, then check if the ORIGINAL
-  // input pixel (converted to sRGB linear) is representable in sRGB
-  // gamut. if yes, use model output converted back to working profile.
-  // if no, pass through the original pixel (wide-gamut colors preserved,
-  // no denoising on those pixels). upscale has no pixel-to-pixel
-  // correspondence so pass-through is not possible — always use the
-  // model output
-  //
-  // without profile: fall back to per-channel pass-through in the
-  // original (working-profile-as-sRGB) space
   const gboolean boost = ctx->shadow_boost;
   if(ctx->has_profile && scale == 1 && ctx->preserve_wide_gamut)
   {
@@ -494,10 +434,113 @@ int dt_restore_run_patch(dt_restore_context_t *ctx,
     }
   }
 
+}
+
+int dt_restore_run_patches(dt_restore_context_t *ctx,
+                           const float *in_patches,
+                           int n,
+                           int w, int h,
+                           float *out_patches,
+                           int scale)
+{
+  if(!ctx || !ctx->ai_ctx || n <= 0) return 1;
+  const size_t plane = (size_t)w * h;
+  const size_t in_pixels = plane * 3;
+  const size_t out_pixels = in_pixels * scale * scale;
+
+  // input layout is planar NCHW: per patch an R plane, then G plane,
+  // then B plane, patches back to back. the model input is converted
+  // straight into the session's tensor buffers, reused patch to patch
+  float *srgb_in = dt_ai_get_buffer(ctx->ai_ctx, _BUF_MODEL_INPUT,
+                                    in_pixels * n * sizeof(float));
+  uint8_t *in_gamut_mask = NULL;
+  if(!srgb_in) return 1;
+  // only allocate the gamut mask when denoise pass-through is requested
+  const gboolean need_gamut_mask
+    = ctx->has_profile && scale == 1 && ctx->preserve_wide_gamut;
+  if(need_gamut_mask)
+  {
+    in_gamut_mask = g_try_malloc(plane * n);
+    if(!in_gamut_mask) return 1;
+  }
+
+  for(int b = 0; b < n; b++)
+    _patch_to_model(ctx, in_patches + b * in_pixels, plane,
+                    srgb_in + b * in_pixels,
+                    in_gamut_mask ? in_gamut_mask + b * plane : NULL);
+
+  const int num_inputs = dt_ai_get_input_count(ctx->ai_ctx);
+  if(num_inputs > MAX_MODEL_INPUTS)
+  {
+    g_free(in_gamut_mask);
+    return 1;
+  }
+
+  int64_t input_shape[] = {n, 3, h, w};
+  dt_ai_tensor_t inputs[MAX_MODEL_INPUTS];
+  memset(inputs, 0, sizeof(inputs));
+  inputs[0] = (dt_ai_tensor_t){
+    .data = (void *)srgb_in,
+    .shape = input_shape,
+    .ndim = 4,
+    .type = DT_AI_FLOAT};
+
+  // noise level map for multi-input models
+  float *noise_map = NULL;
+  int64_t noise_shape[] = {n, 1, h, w};
+  if(num_inputs >= 2)
+  {
+    const size_t map_size = plane * n;
+    noise_map = dt_ai_get_buffer(ctx->ai_ctx, _BUF_NOISE_MAP,
+                                 map_size * sizeof(float));
+    if(!noise_map)
+    {
+      g_free(in_gamut_mask);
+      return 1;
+    }
+    const float sigma_norm = 25.0f / 255.0f;
+    for(size_t i = 0; i < map_size; i++)
+      noise_map[i] = sigma_norm;
+    inputs[1] = (dt_ai_tensor_t){
+      .data = (void *)noise_map,
+      .shape = noise_shape,
+      .ndim = 4,
+      .type = DT_AI_FLOAT};
+  }
+
+  int64_t output_shape[] = {n, 3, h * scale, w * scale};
+  dt_ai_tensor_t output = {
+    .data = (void *)out_patches,
+    .shape = output_shape,
+    .ndim = 4,
+    .type = DT_AI_FLOAT};
+
+  int ret = dt_ai_run(ctx->ai_ctx, inputs, num_inputs,
+                      &output, 1);
+  if(ret != 0)
+  {
+    g_free(in_gamut_mask);
+    return ret;
+  }
+
+  for(int b = 0; b < n; b++)
+    _patch_from_model(ctx, in_patches + b * in_pixels, w, h,
+                      out_patches + b * out_pixels, scale,
+                      in_gamut_mask ? in_gamut_mask + b * plane : NULL);
+
   g_free(in_gamut_mask);
   return 0;
 }
 
+int dt_restore_run_patch(dt_restore_context_t *ctx,
+                         const float *in_patch,
+                         int w, int h,
+                         float *out_patch,
+                         int scale)
+{
+  return dt_restore_run_patches(ctx, in_patch, 1, w, h, out_patch, scale);
+}
+
 // per-image gate for the shadow-boost curve; enable only when the image
 // has substantial near-black area to protect — bright images would only
 // pay the curve cost (minor highlight compression) for no gain;
@@ -524,6 +567,123 @@ static gboolean _image_has_deep_shadows(const float *in_data, int w, int h)
   return total > 0 && (float)dark / total >= _SHADOW_BOOST_FRACTION;
 }
 
+// tile grid shared by the gather and scatter helpers of
+// dt_restore_process_tiled()
+typedef struct _tile_grid_t
+{
+  const float *in_data;
+  int width, height;
+  int out_w;
+  int T, O, S;
+  int step;
+} _tile_grid_t;
+
+// interleaved RGBx -> planar RGB for tiles tx0 .. tx0 + n - 1 of the
+// tile row starting at y, mirrored at the image borders
+static void _gather_batch(const _tile_grid_t *g,
+                          const int y, const int tx0, const int n,
+                          float *tile_in)
+{
+  const int T = g->T;
+  const size_t in_plane = (size_t)T * T;
+  const int width = g->width;
+  const int height = g->height;
+  const float *in_data = g->in_data;
+
+  for(int b = 0; b < n; b++)
+  {
+    float *tile = tile_in + b * in_plane * 3;
+    const int x = (tx0 + b) * g->step;
+    const int in_x = x - g->O;
+    const int in_y = y - g->O;
+    const int needs_mirror
+      = (in_x < 0 || in_y < 0
+         || in_x + T > width
+         || in_y + T > height);
+
+    if(needs_mirror)
+    {
+      for(int dy = 0; dy < T; ++dy)
+      {
+        const int sy = _mirror(in_y + dy, height);
+        for(int dx = 0; dx < T; ++dx)
+        {
+          const int sx
+            = _mirror(in_x + dx, width);
+          const size_t po = (size_t)dy * T + dx;
+          const size_t si
+            = ((size_t)sy * width + sx) * 4;
+          tile[po] = in_data[si + 0];
+          tile[po + in_plane]
+            = in_data[si + 1];
+          tile[po + 2 * in_plane]
+            = in_data[si + 2];
+        }
+      }
+    }
+    else
+    {
+      for(int dy = 0; dy < T; ++dy)
+      {
+        const float *row
+          = in_data
+            + ((size_t)(in_y + dy) * width
+               + in_x) * 4;
+        const size_t ro = (size_t)dy * T;
+        for(int dx = 0; dx < T; ++dx)
+        {
+          tile[ro + dx] = row[dx * 4 + 0];
+          tile[ro + dx + in_plane]
+            = row[dx * 4 + 1];
+          tile[ro + dx + 2 * in_plane]
+            = row[dx * 4 + 2];
+        }
+      }
+    }
+  }
+}
+
+// valid region of tiles tx0 .. tx0 + n - 1 -> row buffer
+static void _scatter_batch(const _tile_grid_t *g,
+                           const float *tile_out,
+                           const int tx0, const int n,
+                           const int valid_h_out,
+                           float *row_buf)
+{
+  const int S = g->S;
+  const int T_out = g->T * S;
+  const int O_out = g->O * S;
+  const size_t out_plane = (size_t)T_out * T_out;
+  const int out_w = g->out_w;
+
+  for(int b = 0; b < n; b++)
+  {
+    const float *tile = tile_out + b * out_plane * 3;
+    const int x = (tx0 + b) * g->step;
+    const int valid_w = (x + g->step > g->width)
+      ? g->width - x : g->step;
+    const int valid_w_out = valid_w * S;
+
+    for(int dy = 0; dy < valid_h_out; ++dy)
+    {
+      const size_t src_row
+        = (size_t)(O_out + dy) * T_out + O_out;
+      const size_t dst_row
+        = ((size_t)dy * out_w + x * S) * 3;
+      for(int dx = 0; dx < valid_w_out; ++dx)
+      {
+        row_buf[dst_row + dx * 3 + 0]
+          = tile[src_row + dx];
+        row_buf[dst_row + dx * 3 + 1]
+          = tile[src_row + dx + out_plane];
+        row_buf[dst_row + dx * 3 + 2]
+          = tile[src_row + dx
+                 + 2 * out_plane];
+      }
+    }
+  }
+}
+
 int dt_restore_process_tiled(dt_restore_context_t *ctx,
                              const float *in_data,
                              int width, int height,
@@ -554,7 +714,6 @@ int dt_restore_process_tiled(dt_restore_context_t *ctx,
 
   int step = T - 2 * O;
   int T_out = T * S;
-  int O_out = O * S;
   int step_out = step * S;
   size_t in_plane = (size_t)T * T;
   size_t out_plane = (size_t)T_out * T_out;
@@ -562,22 +721,42 @@ int dt_restore_process_tiled(dt_restore_context_t *ctx,
   int rows = (height + step - 1) / step;
   int total_tiles = cols * rows;
 
+  // tiles of one row go through the model together, a batch never
+  // spans two rows so completed scanlines can be delivered as before
+  int batch = MAX(1, MIN(ctx->max_batch, cols));
+
   dt_print(DT_DEBUG_AI,
            "[restore_rgb] tiling %dx%d (scale=%d)"
-           " -> %dx%d, %dx%d grid (%d tiles, T=%d)",
+           " -> %dx%d, %dx%d grid (%d tiles, T=%d, batch=%d)",
            width, height, S, out_w, height * S,
-           cols, rows, total_tiles, T);
-
-  float *tile_in = g_try_malloc(
-    in_plane * 3 * sizeof(float));
-  float *tile_out = g_try_malloc(
-    out_plane * 3 * sizeof(float));
+           cols, rows, total_tiles, T, batch);
+
+  const _tile_grid_t grid = {
+    .in_data = in_data,
+    .width = width, .height = height,
+    .out_w = out_w,
+    .T = T, .O = O, .S = S,
+    .step = step };
+
+  // two sets of batch buffers: while the model works on one, the
+  // previous batch is scattered and the next one gathered into the other
+  float *tile_in[2], *tile_out[2];
+  for(int k = 0; k < 2; k++)
+  {
+    tile_in[k] = g_try_malloc(
+      in_plane * 3 * batch * sizeof(float));
+    tile_out[k] = g_try_malloc(
+      out_plane * 3 * batch * sizeof(float));
+  }
   float *row_buf = g_try_malloc(
     (size_t)out_w * step_out * 3 * sizeof(float));
-  if(!tile_in || !tile_out || !row_buf)
+  if(!tile_in[0] || !tile_in[1] || !tile_out[0] || !tile_out[1] || !row_buf)
   {
-    g_free(tile_in);
-    g_free(tile_out);
+    for(int k = 0; k < 2; k++)
+    {
+      g_free(tile_in[k]);
+      g_free(tile_out[k]);
+    }
     g_free(row_buf);
     return 1;
   }
@@ -591,12 +770,16 @@ int dt_restore_process_tiled(dt_restore_context_t *ctx,
     const int valid_h = (y + step > height)
       ? height - y : step;
     const int valid_h_out = valid_h * S;
+    const int nbatch = (cols + batch - 1) / batch;
 
     memset(row_buf, 0,
            (size_t)out_w * valid_h_out * 3
            * sizeof(float));
 
-    for(int tx = 0; tx < cols; tx++)
+    _gather_batch(&grid, y, 0, MIN(batch, cols), tile_in[0]);
+
+    gboolean retry_row = FALSE;
+    for(int j = 0; j < nbatch; j++)
     {
       if(control_job
          && dt_control_job_get_state(control_job)
@@ -606,61 +789,45 @@ int dt_restore_process_tiled(dt_restore_context_t *ctx,
         goto cleanup;
       }
 
-      const int x = tx * step;
-      const int in_x = x - O;
-      const int in_y = y - O;
-      const int needs_mirror
-        = (in_x < 0 || in_y < 0
-           || in_x + T > width
-           || in_y + T > height);
+      const int cur = j & 1;
+      const int tx0 = j * batch;
+      const int n = MIN(batch, cols - tx0);
+      const int prev_n = j > 0 ? batch : 0;
+      const int next_n = j + 1 < nbatch ? MIN(batch, cols - tx0 - batch) : 0;
+      float *in_cur = tile_in[cur];
+      float *out_cur = tile_out[cur];
+      float *in_next = tile_in[!cur];
+      const float *out_prev = tile_out[!cur];
+      int err = 0;
 
-      // interleaved RGBx -> planar RGB
-      if(needs_mirror)
+#ifdef _OPENMP
+#pragma omp parallel sections num_threads(2) if(prev_n || next_n) default(none) \
+  dt_omp_firstprivate(ctx, grid, in_cur, out_cur, in_next, out_prev, n, prev_n, next_n, \
+                      tx0, batch, y, T, S, valid_h_out, row_buf)          \
+  shared(err)
+#endif
       {
-        for(int dy = 0; dy < T; ++dy)
+#ifdef _OPENMP
+#pragma omp section
+#endif
+        err = dt_restore_run_patches(ctx, in_cur, n, T, T, out_cur, S);
+#ifdef _OPENMP
+#pragma omp section
+#endif
         {
-          const int sy = _mirror(in_y + dy, height);
-          for(int dx = 0; dx < T; ++dx)
-          {
-            const int sx
-              = _mirror(in_x + dx, width);
-            const size_t po = (size_t)dy * T + dx;
-            const size_t si
-              = ((size_t)sy * width + sx) * 4;
-            tile_in[po] = in_data[si + 0];
-            tile_in[po + in_plane]
-              = in_data[si + 1];
-            tile_in[po + 2 * in_plane]
-              = in_data[si + 2];
-          }
-        }
-      }
-      else
-      {
-        for(int dy = 0; dy < T; ++dy)
-        {
-          const float *row
-            = in_data
-              + ((size_t)(in_y + dy) * width
-                 + in_x) * 4;
-          const size_t ro = (size_t)dy * T;
-          for(int dx = 0; dx < T; ++dx)
-          {
-            tile_in[ro + dx] = row[dx * 4 + 0];
-            tile_in[ro + dx + in_plane]
-              = row[dx * 4 + 1];
-            tile_in[ro + dx + 2 * in_plane]
-              = row[dx * 4 + 2];
-          }
+          if(prev_n)
+            _scatter_batch(&grid, out_prev, tx0 - batch, prev_n, valid_h_out, row_buf);
+          if(next_n)
+            _gather_batch(&grid, y, tx0 + batch, next_n, in_next);
         }
       }
 
-      if(dt_restore_run_patch(
-           ctx, tile_in, T, T, tile_out, S) != 0)
+      if(err != 0)
       {
-        // GPU failure on the first tile: retry once on CPU. safe only
-        // before any rows have been delivered to the writer
-        if(tx == 0 && ty == 0 && !cpu_fallback_done
+        // GPU failure on the first batch: retry the row once on CPU,
+        // one tile at a time. safe only before any rows have been
+        // delivered to the writer
+        if(j == 0 && ty == 0 && !cpu_fallback_done
            && dt_restore_reload_session_cpu(ctx))
         {
           dt_print(DT_DEBUG_AI,
@@ -668,45 +835,35 @@ int dt_restore_process_tiled(dt_restore_context_t *ctx,
           dt_control_log(_("AI denoise: GPU inference failed, "
                            "falling back to CPU"));
           cpu_fallback_done = TRUE;
-          tx--;  // re-run the same tile on the new session
-          continue;
+          retry_row = TRUE;
+          break;
         }
         dt_print(DT_DEBUG_AI,
-                 "[restore_rgb] inference failed at tile %d,%d (T=%d)",
-                 tx, ty, T);
+                 "[restore_rgb] inference failed at tile %d,%d (T=%d, batch=%d)",
+                 tx0, ty, T, n);
         res = 1;
         goto cleanup;
       }
 
-      // valid region -> row buffer
-      const int valid_w = (x + step > width)
-        ? width - x : step;
-      const int valid_w_out = valid_w * S;
-
-      for(int dy = 0; dy < valid_h_out; ++dy)
-      {
-        const size_t src_row
-          = (size_t)(O_out + dy) * T_out + O_out;
-        const size_t dst_row
-          = ((size_t)dy * out_w + x * S) * 3;
-        for(int dx = 0; dx < valid_w_out; ++dx)
-        {
-          row_buf[dst_row + dx * 3 + 0]
-            = tile_out[src_row + dx];
-          row_buf[dst_row + dx * 3 + 1]
-            = tile_out[src_row + dx + out_plane];
-          row_buf[dst_row + dx * 3 + 2]
-            = tile_out[src_row + dx
-                       + 2 * out_plane];
-        }
-      }
+      // the last batch has nobody to scatter it
+      if(j + 1 == nbatch)
+        _scatter_batch(&grid, out_cur, tx0, n, valid_h_out, row_buf);
 
-      tile_count++;
+      tile_count += n;
       if(control_job)
         dt_control_job_set_progress(control_job,
                                     (double)tile_count / total_tiles);
     }
 
+    if(retry_row)
+    {
+      // the buffers stay large enough for a single tile
+      batch = MAX(1, MIN(ctx->max_batch, cols));
+      tile_count = 0;
+      ty--;
+      continue;
+    }
+
     // deliver completed scanlines via callback
     for(int dy = 0; dy < valid_h_out; dy++)
     {
@@ -721,8 +878,11 @@ int dt_restore_process_tiled(dt_restore_context_t *ctx,
   }
 
 cleanup:
-  g_free(tile_in);
-  g_free(tile_out);
+  for(int k = 0; k < 2; k++)
+  {
+    g_free(tile_in[k]);
+    g_free(tile_out[k]);
+  }
   g_free(row_buf);
   return res;
 }
@@ -116,6 +116,26 @@ int dt_restore_run_patch(dt_restore_context_t *ctx,
                          float *out_patch,
                          int scale);
 
+// @brief run several equally sized patches in one inference call
+//
+// same as dt_restore_run_patch() with n patches stacked on the batch
+// dimension; only valid for models with ctx->max_batch >= n.
+//
+// @param ctx loaded restore context
+// @param in_patches n input tiles back to back (planar RGB each)
+// @param n number of tiles
+// @param w tile width
+// @param h tile height
+// @param out_patches n output tiles (planar RGB, 3 * w*s * h*s each)
+// @param scale upscale factor (1 for denoise)
+// @return 0 on success
+int dt_restore_run_patches(dt_restore_context_t *ctx,
+                           const float *in_patches,
+                           int n,
+                           int w, int h,
+                           float *out_patches,
+                           int scale);
+
 // @brief process an image with tiled inference
 //
 // tiles the input, runs inference on each tile, and delivers
@@ -23,6 +23,8 @@
 #include "common/darktable.h"
 #include "common/file_location.h"
 #include "common/grealpath.h"
+#include "common/history.h"
+#include "common/image_cache.h"
 #include <inttypes.h>
 #include <math.h>
 #include <stdlib.h>
@@ -1171,7 +1173,7 @@ void dt_seg_reset_encoding(dt_seg_context_t *ctx)
 
 // file format: magic + version + metadata + encoder outputs + RGB
 #define SEG_CACHE_MAGIC 0x44545347  // "DTSG"
-#define SEG_CACHE_VERSION 1
+#define SEG_CACHE_VERSION 3
 #define SEG_CACHE_SUBDIR "objmasks"
 
 // build the per-database cache directory path.
@@ -1209,6 +1211,76 @@ static gboolean _get_cache_dir(char *out, size_t size)
   return FALSE;
 }
 
+// the embeddings are computed from the developed image, so they belong to
+// the image and its history: duplicates diverging from their source get
+// their own entry
+static dt_hash_t _image_hash(const dt_imgid_t imgid)
+{
+  if(!dt_is_valid_imgid(imgid)) return 0;
+  dt_hash_t hash = dt_hash(DT_INITHASH, &imgid, sizeof(imgid));
+  dt_history_hash_values_t history = { NULL, 0, NULL, 0, NULL, 0 };
+  dt_history_hash_read(imgid, &history);
+  hash = dt_hash(hash, history.current, history.current_len);
+  dt_history_hash_free(&history);
+  return hash;
+}
+
+// the file name covers everything a cached file is validated against,
+// so a present file is a hit without reading it. files are prefixed by
+// the image id so they can be dropped with the image.
+static gboolean _get_cache_path(const dt_seg_context_t *ctx,
+                                const dt_imgid_t imgid,
+                                const dt_hash_t image_hash,
+                                const dt_hash_t distort_hash,
+                                char *dir, size_t dir_size,
+                                char *out, size_t size)
+{
+  if(!image_hash || !ctx->model_id || !_get_cache_dir(dir, dir_size))
+    return FALSE;
+
+  const char *ver = ctx->model_version ? ctx->model_version : "0.0";
+  dt_hash_t key = dt_hash(image_hash, &distort_hash, sizeof(distort_hash));
+  key = dt_hash(key, ctx->model_id, strlen(ctx->model_id));
+  key = dt_hash(key, ver, strlen(ver));
+  snprintf(out, size, "%s/%d-%016" PRIx64 ".seg", dir, imgid, (uint64_t)key);
+  return TRUE;
+}
+
+void dt_seg_disk_cache_remove(const dt_imgid_t imgid)
+{
+  char dir[PATH_MAX] = {0};
+  if(!dt_is_valid_imgid(imgid) || !_get_cache_dir(dir, sizeof(dir)))
+    return;
+
+  char prefix[32];
+  snprintf(prefix, sizeof(prefix), "%d-", imgid);
+  GDir *gdir = g_dir_open(dir, 0, NULL);
+  if(!gdir) return;
+  const gchar *name;
+  while((name = g_dir_read_name(gdir)))
+  {
+    if(!g_str_has_prefix(name, prefix) || !g_str_has_suffix(name, ".seg"))
+      continue;
+    gchar *path = g_build_filename(dir, name, NULL);
+    g_unlink(path);
+    g_free(path);
+  }
+  g_dir_close(gdir);
+}
+
+gboolean dt_seg_disk_cache_exists(const dt_seg_context_t *ctx,
+                                  const dt_imgid_t imgid,
+                                  const dt_hash_t distort_hash)
+{
+  if(!ctx) return FALSE;
+
+  char dir[PATH_MAX] = {0};
+  char path[PATH_MAX] = {0};
+  return _get_cache_path(ctx, imgid, _image_hash(imgid), distort_hash,
+                         dir, sizeof(dir), path, sizeof(path))
+         && g_file_test(path, G_FILE_TEST_IS_REGULAR);
+}
+
 gboolean dt_seg_disk_cache_save(dt_seg_context_t *ctx,
                                 const dt_imgid_t imgid,
                                 const dt_hash_t distort_hash,
@@ -1219,14 +1291,14 @@ gboolean dt_seg_disk_cache_save(dt_seg_context_t *ctx,
   if(!ctx || !ctx->image_encoded)
     return FALSE;
 
+  const dt_hash_t image_hash = _image_hash(imgid);
   char dir[PATH_MAX] = {0};
-  if(!_get_cache_dir(dir, sizeof(dir)))
+  char path[PATH_MAX] = {0};
+  if(!_get_cache_path(ctx, imgid, image_hash, distort_hash,
+                      dir, sizeof(dir), path, sizeof(path)))
     return FALSE;
   g_mkdir_with_parents(dir, 0755);
 
-  char path[PATH_MAX] = {0};
-  snprintf(path, sizeof(path), "%s/%d.seg", dir, imgid);
-
   FILE *fp = g_fopen(path, "wb");
   if(!fp)
   {
@@ -1248,7 +1320,7 @@ gboolean dt_seg_disk_cache_save(dt_seg_context_t *ctx,
   // header
   ok = ok && fwrite(&magic, 4, 1, fp) == 1;
   ok = ok && fwrite(&version, 4, 1, fp) == 1;
-  ok = ok && fwrite(&imgid, 4, 1, fp) == 1;
+  ok = ok && fwrite(&image_hash, 8, 1, fp) == 1;
   ok = ok && fwrite(&distort_hash, 8, 1, fp) == 1;
   ok = ok && fwrite(&mid_len, 4, 1, fp) == 1;
   if(mid_len > 0)
@@ -1310,26 +1382,26 @@ gboolean dt_seg_disk_cache_load(dt_seg_context_t *ctx,
 {
   if(!ctx) return FALSE;
 
+  const dt_hash_t image_hash = _image_hash(imgid);
   char dir[PATH_MAX] = {0};
-  if(!_get_cache_dir(dir, sizeof(dir)))
-    return FALSE;
-
   char path[PATH_MAX] = {0};
-  snprintf(path, sizeof(path), "%s/%d.seg", dir, imgid);
+  if(!_get_cache_path(ctx, imgid, image_hash, distort_hash,
+                      dir, sizeof(dir), path, sizeof(path)))
+    return FALSE;
 
   FILE *fp = g_fopen(path, "rb");
   if(!fp) return FALSE;
 
   gboolean ok = TRUE;
   uint32_t magic = 0, version = 0;
-  dt_hash_t file_distort_hash = 0;
-  int32_t file_imgid = 0, enc_w = 0, enc_h = 0, n_out = 0;
+  dt_hash_t file_image_hash = 0, file_distort_hash = 0;
+  int32_t enc_w = 0, enc_h = 0, n_out = 0;
   float scale = 0.0f;
 
   // read header
   ok = ok && fread(&magic, 4, 1, fp) == 1;
   ok = ok && fread(&version, 4, 1, fp) == 1;
-  ok = ok && fread(&file_imgid, 4, 1, fp) == 1;
+  ok = ok && fread(&file_image_hash, 8, 1, fp) == 1;
   ok = ok && fread(&file_distort_hash, 8, 1, fp) == 1;
   // read model id
   uint32_t mid_len = 0;
@@ -1355,7 +1427,7 @@ gboolean dt_seg_disk_cache_load(dt_seg_context_t *ctx,
   const char *cur_ver = ctx->model_version ? ctx->model_version : "0.0";
   if(!ok || magic != SEG_CACHE_MAGIC
      || version != SEG_CACHE_VERSION
-     || file_imgid != imgid
+     || file_image_hash != image_hash
      || file_distort_hash != distort_hash
      || !ctx->model_id
      || strcmp(file_model_id, ctx->model_id) != 0
@@ -136,11 +136,23 @@ void dt_seg_reset_prev_mask(dt_seg_context_t *ctx);
 
 /* --- disk cache for encoder embeddings --- */
 
+/**
+ * @brief Check for cached embeddings without loading them.
+ *        The cache is keyed on the image and its history.
+ * @param ctx Segmentation context with model loaded.
+ * @param imgid Image ID to look up.
+ * @param distort_hash Current distortion module param hash.
+ * @return TRUE if dt_seg_disk_cache_load() would find an entry.
+ */
+gboolean dt_seg_disk_cache_exists(const dt_seg_context_t *ctx,
+                                  const dt_imgid_t imgid,
+                                  const dt_hash_t distort_hash);
+
 /**
  * @brief Save current encoder embeddings + RGB to disk cache.
  *        No-op if no active encoding.
  * @param ctx Segmentation context with active encoding.
- * @param imgid Image ID (used as filename key).
+ * @param imgid Image ID, the entry is valid for its current history.
  * @param distort_hash Hash of distortion module params (invalidation).
  * @param rgb RGB image (uint8, HWC, 3ch) for edge refinement.
  * @param rgb_w RGB width.
@@ -169,6 +181,12 @@ gboolean dt_seg_disk_cache_load(dt_seg_context_t *ctx,
                                 const dt_imgid_t imgid,
                                 const dt_hash_t distort_hash);
 
+/**
+ * @brief Delete all cached embeddings of an image, for any history.
+ * @param imgid Image ID being removed.
+ */
+void dt_seg_disk_cache_remove(const dt_imgid_t imgid);
+
 /**
  * @brief Return the encoded RGB guide (uint8 HWC, 3ch) and its
  *        dimensions. The pointer is owned by the context and stays
@@ -0,0 +1,144 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/artifact_cache.h"
+#include "common/debug.h"
+
+#include <string.h>
+
+// memory kept for the results of all computations
+#define DT_ARTIFACT_CACHE_BYTES ((size_t)256 << 20)
+
+typedef struct _artifact_t
+{
+  dt_hash_t key;
+  size_t size;
+  GList link;     // in the lru queue, data is the artifact itself
+  float data[];   // float for the alignment of image buffers
+} _artifact_t;
+
+static struct
+{
+  GMutex lock;
+  GHashTable *table; // key -> _artifact_t
+  GQueue lru;        // least recently used first
+  size_t bytes;
+  size_t hits;
+  size_t misses;
+} _artifacts;
+
+dt_hash_t dt_artifact_key_init(const char *op)
+{
+  return dt_hash(DT_INITHASH, op, strlen(op));
+}
+
+dt_hash_t dt_artifact_key_add(dt_hash_t key,
+                              const void *data,
+                              const size_t size)
+{
+  // the inputs are mostly image buffers, go through them a word at a time
+  const uint8_t *bytes = data;
+  const size_t words = size / sizeof(uint64_t);
+  for(size_t k = 0; k < words; k++)
+  {
+    uint64_t word;
+    memcpy(&word, bytes + k * sizeof(uint64_t), sizeof(uint64_t));
+    key = (key ^ word) * 0x100000001b3ull;
+  }
+  return dt_hash(key, bytes + words * sizeof(uint64_t), size % sizeof(uint64_t));
+}
+
+static void _artifact_free(gpointer data)
+{
+  _artifact_t *a = data;
+  g_queue_unlink(&_artifacts.lru, &a->link);
+  _artifacts.bytes -= a->size;
+  g_free(a);
+}
+
+gboolean dt_artifact_cache_get(const dt_hash_t key,
+                               void *data,
+                               const size_t size)
+{
+  g_mutex_lock(&_artifacts.lock);
+  _artifact_t *a = _artifacts.table ? g_hash_table_lookup(_artifacts.table, &key) : NULL;
+  const gboolean found = a && a->size == size;
+  if(found)
+  {
+    memcpy(data, a->data, size);
+    g_queue_unlink(&_artifacts.lru, &a->link);
+    g_queue_push_tail_link(&_artifacts.lru, &a->link);
+    _artifacts.hits++;
+  }
+  else
+    _artifacts.misses++;
+  g_mutex_unlock(&_artifacts.lock);
+
+  return found;
+}
+
+void dt_artifact_cache_put(const dt_hash_t key,
+                           const void *data,
+                           const size_t size)
+{
+  if(size > DT_ARTIFACT_CACHE_BYTES / 4) return;
+
+  _artifact_t *a = g_try_malloc(sizeof(_artifact_t) + size);
+  if(!a) return;
+  a->key = key;
+  a->size = size;
+  a->link = (GList){ .data = a };
+  memcpy(a->data, data, size);
+
+  g_mutex_lock(&_artifacts.lock);
+  if(!_artifacts.table)
+  {
+    _artifacts.table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, _artifact_free);
+    g_queue_init(&_artifacts.lru);
+  }
+
+  g_hash_table_replace(_artifacts.table, &a->key, a);
+  g_queue_push_tail_link(&_artifacts.lru, &a->link);
+  _artifacts.bytes += size;
+
+  while(_artifacts.bytes > DT_ARTIFACT_CACHE_BYTES)
+  {
+    _artifact_t *old = g_queue_peek_head(&_artifacts.lru);
+    g_hash_table_remove(_artifacts.table, &old->key);
+  }
+
+  dt_print(DT_DEBUG_CACHE | DT_DEBUG_VERBOSE,
+           "[artifact cache] %u results, %zu MB, %zu hits, %zu misses",
+           g_hash_table_size(_artifacts.table), _artifacts.bytes >> 20,
+           _artifacts.hits, _artifacts.misses);
+  g_mutex_unlock(&_artifacts.lock);
+}
+
+void dt_artifact_cache_cleanup(void)
+{
+  g_mutex_lock(&_artifacts.lock);
+  if(_artifacts.table) g_hash_table_destroy(_artifacts.table);
+  _artifacts.table = NULL;
+  g_mutex_unlock(&_artifacts.lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,46 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+/*
+ * results of expensive computations which only depend on their inputs,
+ * shared by all pipes and exports. the key is built from everything the
+ * result depends on: the name of the computation, its parameters and its
+ * input buffer. the oldest results are dropped beyond the size budget.
+ */
+
+/** start a key for the computation op, e.g. "retouch heal" */
+dt_hash_t dt_artifact_key_init(const char *op);
+/** add something the result depends on to the key */
+dt_hash_t dt_artifact_key_add(dt_hash_t key, const void *data, const size_t size);
+
+/** copy the result stored for key into data. FALSE if there is none of that size. */
+gboolean dt_artifact_cache_get(const dt_hash_t key, void *data, const size_t size);
+/** store a copy of the result for key */
+void dt_artifact_cache_put(const dt_hash_t key, const void *data, const size_t size);
+
+void dt_artifact_cache_cleanup(void);
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -27,6 +27,11 @@ extern inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value
 extern void dt_atomic_incr_int(dt_atomic_int *var);
 extern void dt_atomic_decr_int(dt_atomic_int *var);
 extern int dt_atomic_incr_int_if_zero(dt_atomic_int *var);
+extern inline void dt_atomic_set_int64(dt_atomic_int64 *var, int64_t value);
+extern inline int64_t dt_atomic_get_int64(dt_atomic_int64 *var);
+extern inline int64_t dt_atomic_add_int64(dt_atomic_int64 *var, int64_t incr);
+extern inline int64_t dt_atomic_sub_int64(dt_atomic_int64 *var, int64_t decr);
+extern inline int dt_atomic_CAS_int64(dt_atomic_int64 *var, int64_t *expected, int64_t value);
 
 #if !defined(__STDC_NO_ATOMICS__)
 // using C11 atomics, everything is handled in the header file, so we don't need to define anything in this file
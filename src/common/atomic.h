@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 // implement an atomic variable for inter-thread signalling purposes
 // the manner in which we implement depends on the capabilities of the compiler:
 //   1. standard-compliant C++ compiler: use C++11 atomics in <atomic>
@@ -40,6 +42,14 @@ inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value)
 inline void dt_atomic_incr_int(dt_atomic_int *var) { std::atomic_fetch_add(var,1); }
 inline void dt_atomic_decr_int(dt_atomic_int *var) { std::atomic_fetch_sub(var,1); }
 
+typedef std::atomic<int64_t> dt_atomic_int64;
+inline void dt_atomic_set_int64(dt_atomic_int64 *var, int64_t value) { std::atomic_store(var,value); }
+inline int64_t dt_atomic_get_int64(dt_atomic_int64 *var) { return std::atomic_load(var); }
+inline int64_t dt_atomic_add_int64(dt_atomic_int64 *var, int64_t incr) { return std::atomic_fetch_add(var,incr); }
+inline int64_t dt_atomic_sub_int64(dt_atomic_int64 *var, int64_t decr) { return std::atomic_fetch_sub(var,decr); }
+inline int dt_atomic_CAS_int64(dt_atomic_int64 *var, int64_t *expected, int64_t value)
+{ return std::atomic_compare_exchange_strong(var,expected,value); }
+
 #elif !defined(__STDC_NO_ATOMICS__)
 
 #include <stdatomic.h>
@@ -55,6 +65,14 @@ inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value)
 inline void dt_atomic_incr_int(dt_atomic_int *var) { atomic_fetch_add(var,1); }
 inline void dt_atomic_decr_int(dt_atomic_int *var) { atomic_fetch_sub(var,1); }
 
+typedef atomic_int_least64_t dt_atomic_int64;
+inline void dt_atomic_set_int64(dt_atomic_int64 *var, int64_t value) { atomic_store(var,value); }
+inline int64_t dt_atomic_get_int64(dt_atomic_int64 *var) { return atomic_load(var); }
+inline int64_t dt_atomic_add_int64(dt_atomic_int64 *var, int64_t incr) { return atomic_fetch_add(var,incr); }
+inline int64_t dt_atomic_sub_int64(dt_atomic_int64 *var, int64_t decr) { return atomic_fetch_sub(var,decr); }
+inline int dt_atomic_CAS_int64(dt_atomic_int64 *var, int64_t *expected, int64_t value)
+{ return atomic_compare_exchange_strong(var,expected,value); }
+
 #elif defined(__GNUC__)
 // we don't have or aren't supposed to use C11 atomics, but the compiler is a recent-enough version of GCC
 // that we can use GNU intrinsics corresponding to the C11 atomics
@@ -73,6 +91,15 @@ inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value)
 inline void dt_atomic_incr_int(dt_atomic_int *var) { __atomic_fetch_add(var,1,__ATOMIC_SEQ_CST); }
 inline void dt_atomic_decr_int(dt_atomic_int *var) { __atomic_fetch_sub(var,1,__ATOMIC_SEQ_CST); }
 
+typedef volatile int64_t dt_atomic_int64;
+inline void dt_atomic_set_int64(dt_atomic_int64 *var, int64_t value) { __atomic_store(var,&value,__ATOMIC_SEQ_CST); }
+inline int64_t dt_atomic_get_int64(dt_atomic_int64 *var)
+{ int64_t value ; __atomic_load(var,&value,__ATOMIC_SEQ_CST); return value; }
+inline int64_t dt_atomic_add_int64(dt_atomic_int64 *var, int64_t incr) { return __atomic_fetch_add(var,incr,__ATOMIC_SEQ_CST); }
+inline int64_t dt_atomic_sub_int64(dt_atomic_int64 *var, int64_t decr) { return __atomic_fetch_sub(var,decr,__ATOMIC_SEQ_CST); }
+inline int dt_atomic_CAS_int64(dt_atomic_int64 *var, int64_t *expected, int64_t value)
+{ return __atomic_compare_exchange(var,expected,&value,0,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST); }
+
 #else
 // we don't have or aren't supposed to use C11 atomics, and don't have GNU intrinsics, so
 // fall back to using a mutex for synchronization
@@ -152,6 +179,55 @@ inline void dt_atomic_decr_int(dt_atomic_int *var)
   pthread_mutex_unlock(&dt_atom_mutex);
 }
 
+typedef int64_t dt_atomic_int64;
+inline void dt_atomic_set_int64(dt_atomic_int64 *var, int64_t value)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  *var = value;
+  pthread_mutex_unlock(&dt_atom_mutex);
+}
+
+inline int64_t dt_atomic_get_int64(dt_atomic_int64 *var)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  int64_t value = *var;
+  pthread_mutex_unlock(&dt_atom_mutex);
+  return value;
+}
+
+inline int64_t dt_atomic_add_int64(dt_atomic_int64 *var, int64_t incr)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  int64_t value = *var;
+  *var += incr;
+  pthread_mutex_unlock(&dt_atom_mutex);
+  return value;
+}
+
+inline int64_t dt_atomic_sub_int64(dt_atomic_int64 *var, int64_t decr)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  int64_t value = *var;
+  *var -= decr;
+  pthread_mutex_unlock(&dt_atom_mutex);
+  return value;
+}
+
+inline int dt_atomic_CAS_int64(dt_atomic_int64 *var, int64_t *expected, int64_t value)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  int64_t origvalue = *var;
+  int success = 0;
+  if (origvalue == *expected)
+  {
+    *var = value;
+    success = 1;
+  }
+  *expected = origvalue;
+  pthread_mutex_unlock(&dt_atom_mutex);
+  return success;
+}
+
 #endif // __STDC_NO_ATOMICS__
 
 inline int dt_atomic_incr_int_if_zero(dt_atomic_int *var)
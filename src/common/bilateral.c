@@ -135,26 +135,6 @@ size_t dt_bilateral_singlebuffer_size2(const int width,
 }
 #endif /* !HAVE_OPENCL */
 
-static size_t image_to_grid(const dt_bilateral_t *const b,
-                            const int i,
-                            const int j,
-                            const float L,
-                            float *xf,
-                            float *yf,
-                            float *zf)
-{
-  float x = CLAMPS(i * b->sigma_s_inv, 0, b->size_x - 1);
-  float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
-  float z = CLAMPS(L * b->sigma_r_inv, 0, b->size_z - 1);
-  const int xi = MIN((int)x, b->size_x - 2);
-  const int yi = MIN((int)y, b->size_y - 2);
-  const int zi = MIN((int)z, b->size_z - 2);
-  *xf = x - xi;
-  *yf = y - yi;
-  *zf = z - zi;
-  return ((xi + yi * b->size_x) * b->size_z) + zi;
-}
-
 static size_t image_to_relgrid(const dt_bilateral_t *const b,
                                const int i,
                                const float L,
@@ -330,50 +310,53 @@ static void blur_line_z(float *buf,
   }
 }
 
-DT_OMP_DECLARE_SIMD(aligned(buf:64))
-static void blur_line(float *buf,
-                      const int offset1,
-                      const int offset2,
-                      const int offset3,
-                      const int size1,
-                      const int size2,
-                      const int size3)
+// gaussian blur of the grid along x or y. The grid points along z are
+// contiguous, so a whole z-row of the line is filtered at once, which
+// vectorises, and the threads each take complete lines instead of
+// z-planes, of which there are only a few dozens.
+static void blur_line_zrows(float *buf,
+                            const int line_offset,
+                            const int step,
+                            const int num_lines,
+                            const int line_length,
+                            const int size_z)
 {
   const float w0 = 6.f / 16.f;
   const float w1 = 4.f / 16.f;
   const float w2 = 1.f / 16.f;
+
+  // per thread: the two previous unfiltered z-rows and a zero z-row
+  // standing for the points past the end of the line
+  size_t padded_size;
+  float *const scratch = dt_calloc_perthread_float(3 * size_z, &padded_size);
+  if(!scratch) return;
+
   DT_OMP_FOR()
-  for(int k = 0; k < size1; k++)
+  for(int j = 0; j < num_lines; j++)
   {
-    size_t index = (size_t)k * offset1;
-    for(int j = 0; j < size2; j++)
+    float *const prev1 = dt_get_perthread(scratch, padded_size);
+    float *const prev2 = prev1 + size_z;
+    const float *const zero = prev1 + 2 * size_z;
+    memset(prev1, 0, sizeof(float) * 2 * size_z);
+
+    float *const line = buf + (size_t)j * line_offset;
+    for(int i = 0; i < line_length; i++)
     {
-      float tmp1 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * buf[index + offset3]
-        + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      float tmp2 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp1)
-        + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      for(int i = 2; i < size3 - 2; i++)
+      float *const cur = line + (size_t)i * step;
+      const float *const next1 = i + 1 < line_length ? cur + step : zero;
+      const float *const next2 = i + 2 < line_length ? cur + 2 * step : zero;
+      DT_OMP_SIMD()
+      for(int z = 0; z < size_z; z++)
       {
-        const float tmp3 = buf[index];
-        buf[index]
-            = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2)
-          + w2 * (buf[index + 2 * offset3] + tmp1);
-        index += offset3;
-        tmp1 = tmp2;
-        tmp2 = tmp3;
+        const float v = cur[z];
+        cur[z] = v * w0 + w1 * (next1[z] + prev1[z]) + w2 * (next2[z] + prev2[z]);
+        prev2[z] = prev1[z];
+        prev1[z] = v;
       }
-      const float tmp3 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2) + w2 * tmp1;
-      index += offset3;
-      buf[index] = buf[index] * w0 + w1 * tmp3 + w2 * tmp2;
-      index += offset3;
-      index += offset2 - offset3 * size3;
     }
   }
+
+  dt_free_align(scratch);
 }
 
 
@@ -386,9 +369,9 @@ void dt_bilateral_blur(const dt_bilateral_t *b)
   const int oy = b->size_x * b->size_z;
   const int oz = 1;
   // gaussian up to 3 sigma
-  blur_line(b->buf, oz, oy, ox, b->size_z, b->size_y, b->size_x);
+  blur_line_zrows(b->buf, oy, ox, b->size_y, b->size_x, b->size_z);
   // gaussian up to 3 sigma
-  blur_line(b->buf, oz, ox, oy, b->size_z, b->size_x, b->size_y);
+  blur_line_zrows(b->buf, ox, oy, b->size_x, b->size_y, b->size_z);
   // -2 derivative of the gaussian up to 3 sigma: x*exp(-x*x)
   blur_line_z(b->buf, ox, oy, oz, b->size_x, b->size_y, b->size_z);
 }
@@ -410,16 +393,21 @@ void dt_bilateral_slice(const dt_bilateral_t *const b,
   const int height = b->height;
 
   if(!buf) return;
-  DT_OMP_FOR(collapse(2))
+  DT_OMP_FOR()
   for(int j = 0; j < height; j++)
   {
+    // the y coordinate in the grid is the same for the whole row
+    const float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
+    const int yi = MIN((int)y, b->size_y - 2);
+    const float yf = y - yi;
+    const size_t base = (size_t)yi * oy;
     for(int i = 0; i < width; i++)
     {
       size_t index = 4 * (j * width + i);
-      float xf, yf, zf;
+      float xf, zf;
       const float L = in[index];
       // trilinear lookup:
-      const size_t gi = image_to_grid(b, i, j, L, &xf, &yf, &zf);
+      const size_t gi = base + image_to_relgrid(b, i, L, &xf, &zf);
       const float Lout = fmaxf( 0.0f, L
                          + norm * (buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
                                    + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
@@ -452,16 +440,21 @@ void dt_bilateral_slice_to_output(const dt_bilateral_t *const b,
   const int height = b->height;
 
   if(!buf) return;
-  DT_OMP_FOR(collapse(2))
+  DT_OMP_FOR()
   for(int j = 0; j < height; j++)
   {
+    // the y coordinate in the grid is the same for the whole row
+    const float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
+    const int yi = MIN((int)y, b->size_y - 2);
+    const float yf = y - yi;
+    const size_t base = (size_t)yi * oy;
     for(int i = 0; i < width; i++)
     {
       size_t index = 4 * (j * width + i);
-      float xf, yf, zf;
+      float xf, zf;
       const float L = in[index];
       // trilinear lookup:
-      const size_t gi = image_to_grid(b, i, j, L, &xf, &yf, &zf);
+      const size_t gi = base + image_to_relgrid(b, i, L, &xf, &zf);
       const float Lout = norm * (buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
                                  + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
                                  + buf[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
@@ -27,52 +27,113 @@
 
 // this implements a concurrent LRU cache
 
-void dt_cache_init(dt_cache_t *cache,
-                   const size_t entry_size,
-                   const size_t cost_quota)
+static inline dt_cache_shard_t *_get_shard(const dt_cache_t *cache,
+                                           const uint32_t key)
+{
+  // keys are often consecutive image ids, spread them by fibonacci hashing
+  return &cache->shards[((key * 0x9e3779b1u) >> 16) & cache->shard_mask];
+}
+
+static inline void _lru_unlink(dt_cache_shard_t *shard,
+                               dt_cache_entry_t *entry)
+{
+  if(entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+  else                shard->lru_head = entry->lru_next;
+  if(entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+  else                shard->lru_tail = entry->lru_prev;
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+// put at end of lru list (most recently used)
+static inline void _lru_append(dt_cache_shard_t *shard,
+                               dt_cache_entry_t *entry)
+{
+  entry->lru_next = NULL;
+  entry->lru_prev = shard->lru_tail;
+  if(shard->lru_tail) shard->lru_tail->lru_next = entry;
+  else                shard->lru_head = entry;
+  shard->lru_tail = entry;
+}
+
+static inline void _lru_promote(dt_cache_shard_t *shard,
+                                dt_cache_entry_t *entry)
+{
+  if(shard->lru_tail == entry) return;
+  _lru_unlink(shard, entry);
+  _lru_append(shard, entry);
+}
+
+void dt_cache_init_sharded(dt_cache_t *cache,
+                           const size_t entry_size,
+                           const size_t cost_quota,
+                           const int shards)
 {
-  cache->cost = 0;
-  cache->lru = 0;
+  uint32_t num = 1;
+  while(num < (uint32_t)shards && num < 0x10000) num <<= 1;
+
+  dt_atomic_set_int64(&cache->cost, 0);
   cache->entry_size = entry_size;
   cache->cost_quota = cost_quota;
-  dt_pthread_mutex_init(&cache->lock, 0);
   cache->allocate = 0;
   cache->allocate_data = 0;
   cache->cleanup = 0;
   cache->cleanup_data = 0;
-  cache->hashtable = g_hash_table_new(0, 0);
+  cache->shard_mask = num - 1;
+  cache->shards = calloc(num, sizeof(dt_cache_shard_t));
+  for(uint32_t k = 0; k < num; k++)
+  {
+    dt_cache_shard_t *shard = &cache->shards[k];
+    dt_pthread_mutex_init(&shard->lock, 0);
+    shard->cost = 0;
+    shard->lru_head = shard->lru_tail = NULL;
+    shard->hashtable = g_hash_table_new(0, 0);
+  }
+}
+
+void dt_cache_init(dt_cache_t *cache,
+                   const size_t entry_size,
+                   const size_t cost_quota)
+{
+  dt_cache_init_sharded(cache, entry_size, cost_quota, 1);
 }
 
 void dt_cache_cleanup(dt_cache_t *cache)
 {
-  g_hash_table_destroy(cache->hashtable);
-  for(GList *l = cache->lru; l; l = g_list_next(l))
+  for(uint32_t k = 0; k <= cache->shard_mask; k++)
   {
-    dt_cache_entry_t *entry = l->data;
-
-    if(cache->cleanup)
+    dt_cache_shard_t *shard = &cache->shards[k];
+    g_hash_table_destroy(shard->hashtable);
+    dt_cache_entry_t *next = NULL;
+    for(dt_cache_entry_t *entry = shard->lru_head; entry; entry = next)
     {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+      next = entry->lru_next;
 
-      cache->cleanup(cache->cleanup_data, entry);
-    }
-    else
-      dt_free_align(entry->data);
+      if(cache->cleanup)
+      {
+        assert(entry->data_size);
+        ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
 
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
+        cache->cleanup(cache->cleanup_data, entry);
+      }
+      else
+        dt_free_align(entry->data);
+
+      dt_pthread_rwlock_destroy(&entry->lock);
+      g_slice_free1(sizeof(*entry), entry);
+    }
+    dt_pthread_mutex_destroy(&shard->lock);
   }
-  g_list_free(cache->lru);
-  dt_pthread_mutex_destroy(&cache->lock);
+  free(cache->shards);
+  cache->shards = NULL;
 }
 
 gboolean dt_cache_contains(dt_cache_t *cache,
                           const uint32_t key)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean result = g_hash_table_contains(cache->hashtable, GINT_TO_POINTER(key));
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_cache_shard_t *shard = _get_shard(cache, key);
+  dt_pthread_mutex_lock(&shard->lock);
+  const gboolean result = g_hash_table_contains(shard->hashtable, GINT_TO_POINTER(key));
+  dt_pthread_mutex_unlock(&shard->lock);
   return result;
 }
 
@@ -83,9 +144,10 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
                                    const char mode)
 {
   gpointer orig_key, value;
+  dt_cache_shard_t *shard = _get_shard(cache, key);
   const double start = dt_get_debug_wtime();
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
+  dt_pthread_mutex_lock(&shard->lock);
+  const gboolean res = g_hash_table_lookup_extended(shard->hashtable,
                                                     GINT_TO_POINTER(key),
                                                     &orig_key,
                                                     &value);
@@ -99,13 +161,12 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       return NULL;
     }
     // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_promote(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
     const double end = dt_get_debug_wtime();
     if(end - start > 0.1)
       dt_print(DT_DEBUG_ALWAYS, "try+ wait time %.06fs mode %c", end - start, mode);
@@ -120,13 +181,17 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
 
     return entry;
   }
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   const double end = dt_get_debug_wtime();
   if(end - start > 0.1)
     dt_print(DT_DEBUG_ALWAYS, "try- wait time %.06fs", end - start);
   return NULL;
 }
 
+static void _cache_gc(dt_cache_t *cache,
+                      dt_cache_shard_t *locked,
+                      const float fill_ratio);
+
 // if found, the data void* is returned. if not, it is set to be
 // the given *data and a new hash table entry is created, which can be
 // found using the given key later on.
@@ -137,10 +202,11 @@ dt_cache_entry_t *dt_cache_get_with_caller(dt_cache_t *cache,
                                            const int line)
 {
   gpointer orig_key, value;
+  dt_cache_shard_t *shard = _get_shard(cache, key);
   const double start = dt_get_debug_wtime();
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
+  dt_pthread_mutex_lock(&shard->lock);
+  const gboolean res = g_hash_table_lookup_extended(shard->hashtable,
                                                     GINT_TO_POINTER(key),
                                                     &orig_key,
                                                     &value);
@@ -153,14 +219,13 @@ restart:
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       g_usleep(5);
       goto restart;
     }
     // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_promote(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
 
 #ifdef _DEBUG
     const pthread_t writer = dt_pthread_rwlock_get_writer(&entry->lock);
@@ -189,10 +254,10 @@ restart:
 
   // first try to clean up.
   // also wait if we can't free more than the requested fill ratio.
-  if(cache->cost > 0.8f * cache->cost_quota)
+  if(dt_cache_get_cost(cache) > 0.8f * cache->cost_quota)
   {
     // need to roll back all the way to get a consistent lock state:
-    dt_cache_gc(cache, 0.8f);
+    _cache_gc(cache, shard, 0.8f);
   }
 
   // here dies your 32-bit system:
@@ -202,11 +267,11 @@ restart:
   entry->data = 0;
   entry->data_size = cache->entry_size;
   entry->cost = 1;
-  entry->link = g_list_append(0, entry);
+  entry->lru_prev = entry->lru_next = NULL;
   entry->key = key;
   entry->_lock_demoting = FALSE;
 
-  g_hash_table_insert(cache->hashtable, GINT_TO_POINTER(key), entry);
+  g_hash_table_insert(shard->hashtable, GINT_TO_POINTER(key), entry);
 
   assert(cache->allocate || entry->data_size);
 
@@ -226,12 +291,13 @@ restart:
   else
     dt_pthread_rwlock_rdlock_with_caller(&entry->lock, file, line);
 
-  cache->cost += entry->cost;
+  shard->cost += entry->cost;
+  dt_atomic_add_int64(&cache->cost, entry->cost);
 
   // put at end of lru list (most recently used):
-  cache->lru = g_list_concat(cache->lru, entry->link);
+  _lru_append(shard, entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   const double end = dt_get_debug_wtime();
   if(end - start > 0.1)
     dt_print(DT_DEBUG_ALWAYS, "wait time %.06fs", end - start);
@@ -246,23 +312,24 @@ gboolean dt_cache_remove(dt_cache_t *cache,
 {
   dt_cache_entry_t *entry;
   gpointer orig_key, value;
+  dt_cache_shard_t *shard = _get_shard(cache, key);
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
+  dt_pthread_mutex_lock(&shard->lock);
 
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
+  const gboolean res = g_hash_table_lookup_extended(shard->hashtable,
                                                     GINT_TO_POINTER(key),
                                                     &orig_key,
                                                     &value);
   entry = (dt_cache_entry_t *)value;
   if(!res)
   { // not found in cache, not deleting.
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     return TRUE;
   }
   // need write lock to be able to delete:
   if(dt_pthread_rwlock_trywrlock(&entry->lock))
   {
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
@@ -272,15 +339,15 @@ restart:
     // oops, we are currently demoting (rw -> r) lock to this entry in
     // some thread. do not touch!
     dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
 
-  const gboolean removed = g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(key));
+  const gboolean removed = g_hash_table_remove(shard->hashtable, GINT_TO_POINTER(key));
   (void)removed; // make non-assert compile happy
   assert(removed);
-  cache->lru = g_list_delete_link(cache->lru, entry->link);
+  _lru_unlink(shard, entry);
 
   if(cache->cleanup)
   {
@@ -294,27 +361,29 @@ restart:
 
   dt_pthread_rwlock_unlock(&entry->lock);
   dt_pthread_rwlock_destroy(&entry->lock);
-  cache->cost -= entry->cost;
+  shard->cost -= entry->cost;
+  dt_atomic_sub_int64(&cache->cost, entry->cost);
   g_slice_free1(sizeof(*entry), entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   return FALSE;
 }
 
-// best-effort garbage collection. never blocks, never fails. well,
-// sometimes it just doesn't free anything.
-void dt_cache_gc(dt_cache_t *cache,
-                 const float fill_ratio)
+// collect garbage in one shard that must be locked by the caller until
+// either the cache or the shard reach their target cost.
+static void _shard_gc(dt_cache_t *cache,
+                      dt_cache_shard_t *shard,
+                      const size_t target,
+                      const size_t shard_target)
 {
-  GList *l = cache->lru;
-  while(l)
+  dt_cache_entry_t *next = shard->lru_head;
+  while(next)
   {
-    dt_cache_entry_t *entry = l->data;
-    assert(entry->link->data == entry);
-    l = g_list_next(l); // we might remove this element, so walk to
-                        // the next one while we still have the
-                        // pointer..
-    if(cache->cost < cache->cost_quota * fill_ratio)
+    dt_cache_entry_t *entry = next;
+    next = entry->lru_next; // we might remove this element, so walk to
+                            // the next one while we still have the
+                            // pointer..
+    if(dt_cache_get_cost(cache) < target || shard->cost <= shard_target)
       break;
 
     // if still locked by anyone else give up:
@@ -330,9 +399,10 @@ void dt_cache_gc(dt_cache_t *cache,
     }
 
     // delete!
-    g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(entry->key));
-    cache->lru = g_list_delete_link(cache->lru, entry->link);
-    cache->cost -= entry->cost;
+    g_hash_table_remove(shard->hashtable, GINT_TO_POINTER(entry->key));
+    _lru_unlink(shard, entry);
+    shard->cost -= entry->cost;
+    dt_atomic_sub_int64(&cache->cost, entry->cost);
 
     if(cache->cleanup)
     {
@@ -350,6 +420,51 @@ void dt_cache_gc(dt_cache_t *cache,
   }
 }
 
+/* As keys are spread evenly all shards are first cleaned down to their share of the
+   target cost, a second pass cleans without that limit. The shard locked by the caller
+   goes first, others are skipped if locked as we must not wait for them while holding a lock.
+*/
+static void _cache_gc(dt_cache_t *cache,
+                      dt_cache_shard_t *locked,
+                      const float fill_ratio)
+{
+  const size_t target = cache->cost_quota * fill_ratio;
+  const uint32_t num = cache->shard_mask + 1;
+  const size_t share = num > 1 ? target / num : 0;
+
+  for(int pass = 0; pass < 2; pass++)
+  {
+    const size_t shard_target = pass == 0 ? share : 0;
+    if(locked)
+      _shard_gc(cache, locked, target, shard_target);
+
+    for(uint32_t k = 0; k < num && dt_cache_get_cost(cache) >= target; k++)
+    {
+      dt_cache_shard_t *shard = &cache->shards[k];
+      if(shard == locked) continue;
+
+      if(locked)
+      {
+        if(dt_pthread_mutex_trylock(&shard->lock)) continue;
+      }
+      else
+        dt_pthread_mutex_lock(&shard->lock);
+
+      _shard_gc(cache, shard, target, shard_target);
+      dt_pthread_mutex_unlock(&shard->lock);
+    }
+    if(dt_cache_get_cost(cache) < target || num == 1) break;
+  }
+}
+
+// best-effort garbage collection. never blocks on entries, never fails. well,
+// sometimes it just doesn't free anything.
+void dt_cache_gc(dt_cache_t *cache,
+                 const float fill_ratio)
+{
+  _cache_gc(cache, NULL, fill_ratio);
+}
+
 void dt_cache_release_with_caller(dt_cache_t *cache,
                                   dt_cache_entry_t *entry,
                                   const char *file,
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "common/atomic.h"
 #include "common/dtpthread.h"
 #include <glib.h>
 #include <inttypes.h>
@@ -28,7 +29,9 @@ typedef struct dt_cache_entry_t
   void *data;
   size_t data_size;
   size_t cost;
-  GList *link;
+  // intrusive lru list of the shard, promotion doesn't need any allocation
+  struct dt_cache_entry_t *lru_prev;
+  struct dt_cache_entry_t *lru_next;
   dt_pthread_rwlock_t lock;
   gboolean _lock_demoting;
   uint32_t key;
@@ -37,16 +40,28 @@ typedef struct dt_cache_entry_t
 typedef void((*dt_cache_allocate_t)(void *userdata, dt_cache_entry_t *entry));
 typedef void((*dt_cache_cleanup_t)(void *userdata, dt_cache_entry_t *entry));
 
-typedef struct dt_cache_t
+// keys are distributed over independent shards, each with its own lock, hashtable and lru list.
+typedef struct dt_cache_shard_t
 {
-  dt_pthread_mutex_t lock; // big fat lock. we're only expecting a couple hand full of cpu threads to use this concurrently.
+  dt_pthread_mutex_t lock; // big fat lock of this shard.
+
+  size_t cost;           // cost of the entries in this shard, protected by lock
 
-  size_t entry_size; // cache line allocation
-  size_t cost;       // user supplied cost per cache line (bytes?)
-  size_t cost_quota; // quota to try and meet. but don't use as hard limit.
+  GHashTable *hashtable;      // stores (key, entry) pairs
+  dt_cache_entry_t *lru_head; // about to be kicked from cache
+  dt_cache_entry_t *lru_tail; // most recently used
+} dt_cache_shard_t;
+
+typedef struct dt_cache_t
+{
+  // a cache with a single shard has one big fat lock, that's fine if we're
+  // only expecting a couple hand full of cpu threads to use it concurrently.
+  dt_cache_shard_t *shards;
+  uint32_t shard_mask; // number of shards - 1
 
-  GHashTable *hashtable; // stores (key, entry) pairs
-  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
+  size_t entry_size;    // cache line allocation
+  dt_atomic_int64 cost; // user supplied cost per cache line (bytes?), summed over all shards
+  size_t cost_quota;    // quota to try and meet. but don't use as hard limit.
 
   // callback functions for cache misses/garbage collection
   dt_cache_allocate_t allocate;
@@ -59,8 +74,19 @@ typedef struct dt_cache_t
 void dt_cache_init(dt_cache_t *cache,
                    const size_t entry_size,
                    const size_t cost_quota);
+// same as dt_cache_init() but distributes the keys to the given number
+// of shards (rounded up to a power of 2) to reduce lock contention
+void dt_cache_init_sharded(dt_cache_t *cache,
+                           const size_t entry_size,
+                           const size_t cost_quota,
+                           const int shards);
 void dt_cache_cleanup(dt_cache_t *cache);
 
+static inline size_t dt_cache_get_cost(dt_cache_t *cache)
+{
+  return (size_t)dt_atomic_get_int64(&cache->cost);
+}
+
 static inline void dt_cache_set_allocate_callback(dt_cache_t *cache,
                                                   dt_cache_allocate_t allocate_cb,
                                                   void *allocate_data)
@@ -97,9 +123,9 @@ void dt_cache_release_with_caller(dt_cache_t *cache,
 gboolean dt_cache_contains(dt_cache_t *cache, const uint32_t key);
 // returns FALSE on success, TRUE if the key was not found.
 gboolean dt_cache_remove(dt_cache_t *cache, const uint32_t key);
-// removes from the tip of the lru list, until the fill ratio of the hashtable
+// removes from the tip of the lru lists, until the fill ratio of the cache
 // goes below the given parameter, in terms of the user defined cost measure.
-// will never lock and never fail, but sometimes not free memory (in case all
+// will never lock entries and never fail, but sometimes not free memory (in case all
 // is locked)
 void dt_cache_gc(dt_cache_t *cache,
                  const float fill_ratio);
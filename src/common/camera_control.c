@@ -17,6 +17,7 @@
 */
 
 #include "common/camera_control.h"
+#include "common/colorspaces.h"
 #include "common/exif.h"
 #include "common/image.h"
 #include "control/control.h"
@@ -130,6 +131,8 @@ static gpointer _camera_get_job(const dt_camctl_t *c,
 static void _camera_process_job(const dt_camctl_t *c,
                                 const dt_camera_t *camera,
                                 gpointer job);
+/** Decode a live view frame and make it the shown one */
+static int _live_view_decode(dt_camera_t *cam, dt_imageio_jpeg_t *jpg);
 
 /** Dispatch functions for listener interfaces */
 static const char *_dispatch_request_image_path(const dt_camctl_t *c,
@@ -386,29 +389,12 @@ static void _camera_process_job(const dt_camctl_t *c,
           //if(color_space == DT_COLORSPACE_DISPLAY)
           //  color_space = DT_COLORSPACE_SRGB;
           // no embedded colorspace, assume is sRGB
-          uint8_t *const buffer =
-            (uint8_t *)dt_alloc_align_uint8(4 * jpg.width * jpg.height);
-          if(!buffer)
-          {
-            dt_print(DT_DEBUG_CAMCTL,
-                     "[camera_control] live view could not allocate image buffer");
-          }
-          else if(dt_imageio_jpeg_decompress(&jpg, buffer))
-          {
+          if(!cam->live_view_zoom && cam->live_view_fit_width > 0)
+            dt_imageio_jpeg_scale_to_fit(&jpg, cam->live_view_fit_width,
+                                         cam->live_view_fit_height);
+          if(_live_view_decode(cam, &jpg))
             dt_print(DT_DEBUG_CAMCTL,
                      "[camera_control] live view failed to decompress jpeg");
-          }
-          else
-          {
-            dt_pthread_mutex_lock(&cam->live_view_buffer_mutex);
-            // FIXME: don't need to alloc/dealloc if the image dimensions haven't changed
-            if(cam->live_view_buffer) dt_free_align(cam->live_view_buffer);
-            cam->live_view_buffer = buffer;
-            cam->live_view_width = jpg.width;
-            cam->live_view_height = jpg.height;
-            //cam->live_view_color_space = color_space;
-            dt_pthread_mutex_unlock(&cam->live_view_buffer_mutex);
-          }
         }
       }
       if(fp) gp_file_free(fp);
@@ -566,6 +552,68 @@ static void _camera_process_job(const dt_camctl_t *c,
 /* LIVE VIEW */
 /*************/
 
+// decode a frame into the back buffers, convert it to the display
+// profile and swap it with the shown one. only this camera's job thread
+// touches the back buffers.
+static int _live_view_decode(dt_camera_t *cam, dt_imageio_jpeg_t *jpg)
+{
+  const size_t npixels = (size_t)jpg->width * jpg->height;
+  if(cam->live_view_back_pixels < npixels)
+  {
+    dt_free_align(cam->live_view_back);
+    dt_free_align(cam->live_view_back_display);
+    cam->live_view_back = dt_alloc_align_uint8(4 * npixels);
+    cam->live_view_back_display = dt_alloc_align_uint8(4 * npixels);
+    cam->live_view_back_pixels = npixels;
+    if(!cam->live_view_back || !cam->live_view_back_display)
+    {
+      dt_free_align(cam->live_view_back);
+      dt_free_align(cam->live_view_back_display);
+      cam->live_view_back = cam->live_view_back_display = NULL;
+      cam->live_view_back_pixels = 0;
+      return 1;
+    }
+  }
+
+  if(dt_imageio_jpeg_decompress(jpg, cam->live_view_back)) return 1;
+
+  // the rows of a cairo RGB24 surface are 4 * width bytes, no padding
+  pthread_rwlock_rdlock(&darktable.color_profiles->xprofile_lock);
+  const dt_colorspaces_transform_t *compiled =
+    darktable.color_profiles->compiled_srgb_to_display;
+  if(compiled)
+  {
+    const uint8_t *const in = cam->live_view_back;
+    uint8_t *const out = cam->live_view_back_display;
+    const int width = jpg->width;
+    DT_OMP_FOR()
+    for(int row = 0; row < jpg->height; row++)
+      dt_colorspaces_transform_rgba8(compiled, in + (size_t)row * width * 4,
+                                     out + (size_t)row * width * 4, width);
+  }
+  else
+    cmsDoTransformLineStride(darktable.color_profiles->transform_srgb_to_display,
+                             cam->live_view_back, cam->live_view_back_display,
+                             jpg->width, jpg->height, jpg->width * 4, jpg->width * 4, 0, 0);
+  pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
+
+  dt_pthread_mutex_lock(&cam->live_view_buffer_mutex);
+  uint8_t *buffer = cam->live_view_buffer;
+  uint8_t *display = cam->live_view_display;
+  const size_t pixels = cam->live_view_pixels;
+  cam->live_view_buffer = cam->live_view_back;
+  cam->live_view_display = cam->live_view_back_display;
+  cam->live_view_pixels = cam->live_view_back_pixels;
+  cam->live_view_width = jpg->width;
+  cam->live_view_height = jpg->height;
+  cam->live_view_frame++;
+  cam->live_view_back = buffer;
+  cam->live_view_back_display = display;
+  cam->live_view_back_pixels = pixels;
+  dt_pthread_mutex_unlock(&cam->live_view_buffer_mutex);
+  return 0;
+}
+
 static void *_camctl_camera_get_live_view(void *data)
 {
   dt_camctl_t *camctl = (dt_camctl_t *)data;
@@ -732,6 +780,10 @@ static void _camctl_camera_destroy_struct(dt_camera_t *cam)
     dt_free_align(cam->live_view_buffer);
     cam->live_view_buffer = NULL; // just in case someone else is using this
   }
+  dt_free_align(cam->live_view_display);
+  dt_free_align(cam->live_view_back);
+  dt_free_align(cam->live_view_back_display);
+  cam->live_view_display = cam->live_view_back = cam->live_view_back_display = NULL;
   g_free(cam->model);
   g_free(cam->port);
   dt_pthread_mutex_destroy(&cam->jobqueue_lock);
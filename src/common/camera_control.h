@@ -98,6 +98,16 @@ typedef struct dt_camera_t
   /** The last preview image from the camera */
   uint8_t *live_view_buffer;
   int live_view_width, live_view_height;
+  /** The same converted to the display profile, cairo RGB24 */
+  uint8_t *live_view_display;
+  /** Counts the frames, a new one replaces the last one whether drawn or not */
+  uint32_t live_view_frame;
+  /** The buffers the next frame is decoded into, swapped with the above */
+  uint8_t *live_view_back, *live_view_back_display;
+  size_t live_view_back_pixels, live_view_pixels;
+  /** Size the view shows the live view at, 0 for the full frame. the frames are
+      decoded with jpeg scaling no larger than needed to cover it */
+  int live_view_fit_width, live_view_fit_height;
   //dt_colorspaces_color_profile_type_t live_view_color_space;
   /** Rotation of live view, multiples of 90° */
   int32_t live_view_rotation;
@@ -21,6 +21,8 @@
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/metadata.h"
+#include "common/phash.h"
+#include "common/selection.h"
 #include "common/utility.h"
 #include "common/map_locations.h"
 #include "common/datetime.h"
@@ -244,14 +246,16 @@ static void _dt_collection_set_selq_pre_sort(const dt_collection_t *collection,
   g_free(fields);
 }
 
-int dt_collection_update(const dt_collection_t *collection)
+/* builds the where part of the collection query, with and without the images
+   hidden in collapsed groups. if groups is given, an sql list of group ids, the
+   representative images are only looked for in these groups, which gives the
+   same result for the images of these groups. */
+static void _collection_build_where(const dt_collection_t *collection,
+                                    const gchar *groups,
+                                    gchar **where,
+                                    gchar **where_no_group)
 {
-  uint32_t result;
-  gchar *wq, *wq_no_group, *sq, *selq_pre, *selq_post, *query, *query_no_group;
-  wq = wq_no_group = sq = selq_pre = selq_post = query = query_no_group = NULL;
-
-  /* build where part */
-
+  gchar *wq = NULL;
   int and_term = and_operator_initial();
 
   /* add default filters */
@@ -273,11 +277,14 @@ int dt_collection_update(const dt_collection_t *collection)
     g_free(where_ext);
   }
 
-  wq_no_group = g_strdup(wq);
+  gchar *wq_no_group = g_strdup(wq);
 
   /* grouping */
   if(darktable.gui && darktable.gui->grouping)
   {
+    gchar *group_where = groups
+      ? g_strdup_printf("(%s) AND group_id IN (%s)", wq_no_group, groups)
+      : g_strdup(wq_no_group);
     // clang-format off
     /* Show the expanded group... */
     dt_util_str_cat
@@ -293,8 +300,9 @@ int dt_collection_update(const dt_collection_t *collection)
        "(SELECT id,"
        "        MIN(ABS(id-group_id)*2 + CASE WHEN (id-group_id) < 0 THEN 1 ELSE 0 END)"
        " FROM main.images AS mi WHERE %s GROUP BY group_id)))",
-       darktable.gui->expanded_group_id, wq_no_group);
+       darktable.gui->expanded_group_id, group_where);
     // clang-format on
+    g_free(group_where);
 
     /* Additionally, when a group is expanded, make sure the
      * representative image wasn't filtered out.  This is important,
@@ -303,6 +311,33 @@ int dt_collection_update(const dt_collection_t *collection)
     dt_util_str_cat(&wq, " OR (mi.id = %d)", darktable.gui->expanded_group_id);
   }
 
+  *where = wq;
+  *where_no_group = wq_no_group;
+}
+
+// recounts the collection after the query has changed
+static void _collection_recount(const dt_collection_t *collection)
+{
+  /* update the cached count. collection isn't a real const anyway, we
+   * are writing to it in _dt_collection_store, too. */
+  ((dt_collection_t *)collection)->count = UINT32_MAX;
+  ((dt_collection_t *)collection)->count_no_group =
+    _dt_collection_compute_count(collection, TRUE);
+  dt_collection_hint_message(collection);
+
+  _collection_update_aspect_ratio(collection);
+}
+
+static int _collection_update(const dt_collection_t *collection,
+                              const gboolean recount)
+{
+  uint32_t result;
+  gchar *wq, *wq_no_group, *sq, *selq_pre, *selq_post, *query, *query_no_group;
+  wq = wq_no_group = sq = selq_pre = selq_post = query = query_no_group = NULL;
+
+  /* build where part */
+  _collection_build_where(collection, NULL, &wq, &wq_no_group);
+
   // get all the sort items
   dt_collection_params_t *params = (dt_collection_params_t *)&collection->params;
   for(int i = 0; i < DT_COLLECTION_SORT_LAST; i++)
@@ -381,18 +416,16 @@ int dt_collection_update(const dt_collection_t *collection)
   g_free(query);
   g_free(query_no_group);
 
-  /* update the cached count. collection isn't a real const anyway, we
-   * are writing to it in _dt_collection_store, too. */
-  ((dt_collection_t *)collection)->count = UINT32_MAX;
-  ((dt_collection_t *)collection)->count_no_group =
-    _dt_collection_compute_count(collection, TRUE);
-  dt_collection_hint_message(collection);
-
-  _collection_update_aspect_ratio(collection);
+  if(recount) _collection_recount(collection);
 
   return result;
 }
 
+int dt_collection_update(const dt_collection_t *collection)
+{
+  return _collection_update(collection, TRUE);
+}
+
 void dt_collection_reset(const dt_collection_t *collection)
 {
   dt_collection_params_t *params = (dt_collection_params_t *)&collection->params;
@@ -877,7 +910,8 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection,
   gchar *fq = g_strstr_len(query, strlen(query), "FROM");
   count_query = g_strdup_printf("SELECT COUNT(DISTINCT sel.id) %s", fq);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), count_query, -1, &stmt, NULL);
+  sqlite3 *reader = dt_database_get_reader(darktable.db);
+  DT_DEBUG_SQLITE3_PREPARE_V2(reader, count_query, -1, &stmt, NULL);
   if(collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
   {
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
@@ -888,6 +922,7 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection,
     count = sqlite3_column_int(stmt, 0);
 
   sqlite3_finalize(stmt);
+  dt_database_release_reader(darktable.db, reader);
   g_free(count_query);
   return count;
 }
@@ -906,15 +941,7 @@ uint32_t dt_collection_get_count_no_group(const dt_collection_t *collection)
 
 uint32_t dt_collection_get_selected_count(void)
 {
-  sqlite3_stmt *stmt = NULL;
-  uint32_t count = 0;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.selected_images",
-                              -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-    count = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-  return count;
+  return dt_selection_get_count(darktable.selection);
 }
 
 uint32_t dt_collection_get_collected_count(void)
@@ -1352,6 +1379,135 @@ static gchar *_add_wildcards(const gchar *text)
   return cam2;
 }
 
+// the text search is a substring match over the filename, folder, maker,
+// model, metadata and tags of each image. with the FTS5 trigram tokenizer
+// the "%text%" case is looked up in memory.search_index instead of
+// scanning all of them with joins. the index is built on the first search
+// and kept up to date by temporary triggers of the main connection.
+
+#define SEARCH_DOC_SELECT                                                          \
+  "SELECT i.id, i.filename"                                                        \
+  "  || char(10) || IFNULL(fr.folder, '')"                                         \
+  "  || char(10) || IFNULL(mk.name, '')"                                           \
+  "  || char(10) || IFNULL(md.name, '')"                                           \
+  "  || IFNULL((SELECT char(10) || GROUP_CONCAT(value, char(10))"                  \
+  "             FROM main.meta_data WHERE id = i.id), '')"                         \
+  "  || IFNULL((SELECT char(10)"                                                   \
+  "                    || GROUP_CONCAT(t.name || IFNULL(char(10) || t.synonyms, ''), char(10))" \
+  "             FROM main.tagged_images AS ti JOIN data.tags AS t ON t.id = ti.tagid" \
+  "             WHERE ti.imgid = i.id), '')"                                       \
+  " FROM main.images AS i"                                                         \
+  " LEFT JOIN main.film_rolls AS fr ON fr.id = i.film_id"                          \
+  " LEFT JOIN main.makers AS mk ON mk.id = i.maker_id"                             \
+  " LEFT JOIN main.models AS md ON md.id = i.model_id"
+
+// the targets of the trigger statements can't be qualified, search_index
+// resolves to the memory schema
+#define SEARCH_DOC_REFRESH(imgid_expr)                                             \
+  " DELETE FROM search_index WHERE rowid = " imgid_expr ";"                 \
+  " INSERT INTO search_index (rowid, doc) " SEARCH_DOC_SELECT               \
+  " WHERE i.id = " imgid_expr ";"
+
+static const char *_search_index_triggers[] =
+{
+  "CREATE TEMP TRIGGER search_images_insert AFTER INSERT ON main.images"
+  " BEGIN" SEARCH_DOC_REFRESH("NEW.id") " END",
+  "CREATE TEMP TRIGGER search_images_update"
+  " AFTER UPDATE OF filename, film_id, maker_id, model_id ON main.images"
+  " BEGIN" SEARCH_DOC_REFRESH("NEW.id") " END",
+  "CREATE TEMP TRIGGER search_images_delete AFTER DELETE ON main.images"
+  " BEGIN DELETE FROM search_index WHERE rowid = OLD.id; END",
+  "CREATE TEMP TRIGGER search_meta_insert AFTER INSERT ON main.meta_data"
+  " BEGIN" SEARCH_DOC_REFRESH("NEW.id") " END",
+  "CREATE TEMP TRIGGER search_meta_update AFTER UPDATE ON main.meta_data"
+  " BEGIN" SEARCH_DOC_REFRESH("NEW.id") " END",
+  "CREATE TEMP TRIGGER search_meta_delete AFTER DELETE ON main.meta_data"
+  " BEGIN" SEARCH_DOC_REFRESH("OLD.id") " END",
+  "CREATE TEMP TRIGGER search_tagged_insert AFTER INSERT ON main.tagged_images"
+  " BEGIN" SEARCH_DOC_REFRESH("NEW.imgid") " END",
+  "CREATE TEMP TRIGGER search_tagged_delete AFTER DELETE ON main.tagged_images"
+  " BEGIN" SEARCH_DOC_REFRESH("OLD.imgid") " END",
+  "CREATE TEMP TRIGGER search_tags_update AFTER UPDATE OF name, synonyms ON data.tags"
+  " BEGIN"
+  "  DELETE FROM search_index"
+  "   WHERE rowid IN (SELECT imgid FROM main.tagged_images WHERE tagid = NEW.id);"
+  "  INSERT INTO search_index (rowid, doc) " SEARCH_DOC_SELECT
+  "   WHERE i.id IN (SELECT imgid FROM main.tagged_images WHERE tagid = NEW.id);"
+  " END",
+  "CREATE TEMP TRIGGER search_film_update AFTER UPDATE OF folder ON main.film_rolls"
+  " BEGIN"
+  "  DELETE FROM search_index"
+  "   WHERE rowid IN (SELECT id FROM main.images WHERE film_id = NEW.id);"
+  "  INSERT INTO search_index (rowid, doc) " SEARCH_DOC_SELECT
+  "   WHERE i.film_id = NEW.id;"
+  " END",
+};
+
+static gboolean _search_index_ready(void)
+{
+  // 0: not built yet, 1: ready, -1: not available (no FTS5 trigram)
+  static int state = 0;
+  if(state) return state > 0;
+
+  sqlite3 *db = dt_database_get(darktable.db);
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  state = -1;
+  if(sqlite3_exec(db, "CREATE VIRTUAL TABLE memory.search_index"
+                      " USING fts5(doc, tokenize = 'trigram')",
+                  NULL, NULL, NULL) != SQLITE_OK)
+  {
+    dt_print(DT_DEBUG_SQL, "[collection] no FTS5 trigram support, text search uses LIKE");
+    return FALSE;
+  }
+
+  dt_database_start_transaction(darktable.db);
+  gboolean ok = sqlite3_exec(db, "INSERT INTO memory.search_index (rowid, doc) "
+                             SEARCH_DOC_SELECT, NULL, NULL, NULL) == SQLITE_OK;
+  for(size_t k = 0; ok && k < G_N_ELEMENTS(_search_index_triggers); k++)
+    ok = sqlite3_exec(db, _search_index_triggers[k], NULL, NULL, NULL) == SQLITE_OK;
+
+  if(!ok)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[collection] could not build the search index: %s",
+             sqlite3_errmsg(db));
+    dt_database_rollback_transaction(darktable.db);
+    sqlite3_exec(db, "DROP TABLE IF EXISTS memory.search_index", NULL, NULL, NULL);
+    return FALSE;
+  }
+  dt_database_release_transaction(darktable.db);
+
+  state = 1;
+  dt_show_times(&start, "[collection] build search index");
+  return TRUE;
+}
+
+// the MATCH phrase for a "%text%" search, NULL if the index can't answer
+// it exactly: anchored or inner wildcards, or less than the 3 characters
+// of a trigram
+static gchar *_search_index_phrase(const gchar *text)
+{
+  const size_t len = strlen(text);
+  if(len < 5 || text[0] != '%' || text[len - 1] != '%') return NULL;
+
+  gchar *inner = g_strndup(text + 1, len - 2);
+  if(g_utf8_strlen(inner, -1) < 3 || strpbrk(inner, "%_\n"))
+  {
+    g_free(inner);
+    return NULL;
+  }
+
+  // FTS5 string: double the inner double quotes
+  gchar **parts = g_strsplit(inner, "\"", -1);
+  gchar *joined = g_strjoinv("\"\"", parts);
+  gchar *phrase = g_strdup_printf("\"%s\"", joined);
+  g_strfreev(parts);
+  g_free(joined);
+  g_free(inner);
+  return phrase;
+}
+
 static gchar *get_query_string(const dt_collection_properties_t property, const gchar *text)
 {
   char *escaped_text = sqlite3_mprintf("%q", text);
@@ -1600,6 +1756,12 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
           ("(mi.version > (SELECT MIN(version) FROM main.images"
            "               WHERE film_id = mi.film_id AND filename = mi.filename)) ");
       }
+      else if(!g_strcmp0(escaped_text, _("near duplicates"))
+         || !g_strcmp0(escaped_text, "$NEAR_DUPLICATES"))
+      {
+        dt_phash_update_near_duplicates(dt_conf_get_int("plugins/lighttable/duplicates/phash_distance"));
+        query = g_strdup("(mi.id IN (SELECT imgid FROM memory.near_duplicates)) ");
+      }
       else // by default, we select all the images
       {
         query = g_strdup("1 = 1");
@@ -2267,6 +2429,16 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
 
       case DT_COLLECTION_PROP_TEXTSEARCH: // text search
       {
+        gchar *phrase = g_strcmp0(escaped_text, "%%") ? _search_index_phrase(text) : NULL;
+        if(phrase && _search_index_ready())
+        {
+          char *escaped_phrase = sqlite3_mprintf("%q", phrase);
+          query = g_strdup_printf("(mi.id IN (SELECT rowid FROM memory.search_index"
+                                  "           WHERE search_index MATCH '%s'))",
+                                  escaped_phrase);
+          sqlite3_free(escaped_phrase);
+        }
+        else
         // clang-format off
         if(g_strcmp0(escaped_text, "%%") != 0)
           query = g_strdup_printf
@@ -2285,6 +2457,7 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
              escaped_text, escaped_text, escaped_text,
              escaped_text, escaped_text, escaped_text, escaped_text );
         // clang-format on
+        g_free(phrase);
       }
       break;
 
@@ -2663,6 +2836,223 @@ static void _get_query_part(const dt_collection_properties_t property,
   }
 }
 
+// above this number of changed images the collection is rebuilt from scratch
+#define DT_COLLECTION_PATCH_MAX_IMAGES 500
+
+// TRUE if a change of property can move images inside the current sort order
+static gboolean _collection_sort_uses(const dt_collection_t *collection,
+                                      const dt_collection_properties_t property)
+{
+  const gboolean *sorts = collection->params.sorts;
+
+  if(!(collection->params.query_flags & COLLECTION_QUERY_USE_SORT))
+    return FALSE;
+
+  // colour labels are joined, an image may appear once per label
+  if(sorts[DT_COLLECTION_SORT_COLOR])
+    return TRUE;
+
+  switch(property)
+  {
+    case DT_COLLECTION_PROP_RATING:
+    case DT_COLLECTION_PROP_RATING_RANGE:
+      return sorts[DT_COLLECTION_SORT_RATING];
+    case DT_COLLECTION_PROP_COLORLABEL:
+      return FALSE;
+    case DT_COLLECTION_PROP_TAG:
+      return sorts[DT_COLLECTION_SORT_CUSTOM_ORDER];
+    case DT_COLLECTION_PROP_GEOTAGGING:
+      return FALSE;
+    default:
+      if(property >= DT_COLLECTION_PROP_METADATA_OFFSET
+         || (property >= DT_COLLECTION_PROP_METADATA
+             && property < DT_COLLECTION_PROP_METADATA + DT_METADATA_LEGACY_NUMBER))
+        return sorts[DT_COLLECTION_SORT_TITLE] || sorts[DT_COLLECTION_SORT_DESCRIPTION];
+      // anything else might be a change of the query itself
+      return TRUE;
+  }
+}
+
+static GList *_collection_query_ids(const gchar *query)
+{
+  GList *ids = NULL;
+  sqlite3_stmt *stmt = NULL;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    ids = g_list_prepend(ids, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+  return g_list_reverse(ids);
+}
+
+static gchar *_collection_ids_to_sql(GList *ids)
+{
+  gchar *txt = NULL;
+  for(GList *l = ids; l; l = g_list_next(l))
+    dt_util_str_cat(&txt, txt ? ",%d" : "%d", GPOINTER_TO_INT(l->data));
+  return txt;
+}
+
+/* the query hasn't changed but the properties of the images in list have.
+   re-evaluate the collection for the groups of these images only and remove
+   the images which dropped out from memory.collected_images, keeping the
+   positions of all others. returns FALSE if the collection needs to be
+   rebuilt, i.e. if images have to be added. */
+static gboolean _collection_patch(const dt_collection_t *collection,
+                                  GList *list)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  const dt_imgid_t expanded = darktable.gui ? darktable.gui->expanded_group_id : NO_IMGID;
+
+  gchar *imgs = _collection_ids_to_sql(list);
+  if(!imgs) return FALSE;
+
+  gboolean ok = FALSE;
+  gchar *wq = NULL, *wq_no_group = NULL, *groups = NULL, *query = NULL;
+  GHashTable *dropped = NULL;
+  GList *old_ids = NULL, *new_ids = NULL, *left_ids = NULL;
+
+  // the expanded image is shown whatever its properties are, and images
+  // hidden in collapsed groups haven't been collected at all
+  for(GList *l = list; l; l = g_list_next(l))
+    if(GPOINTER_TO_INT(l->data) == expanded) goto end;
+
+  // clang-format off
+  query = g_strdup_printf("SELECT (SELECT COUNT(*) FROM memory.collected_images"
+                          "        WHERE imgid IN (%s))"
+                          "     = (SELECT COUNT(*) FROM main.images WHERE id IN (%s))",
+                          imgs, imgs);
+  // clang-format on
+  sqlite3_stmt *stmt = NULL;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  const gboolean all_collected = sqlite3_step(stmt) == SQLITE_ROW
+                                 && sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  g_free(query);
+  if(!all_collected) goto end;
+
+  query = g_strdup_printf("SELECT DISTINCT group_id FROM main.images WHERE id IN (%s)", imgs);
+  GList *group_ids = _collection_query_ids(query);
+  groups = _collection_ids_to_sql(group_ids);
+  g_list_free(group_ids);
+  g_free(query);
+
+  // what is shown of these groups before and after the change
+  query = g_strdup_printf("SELECT c.imgid FROM memory.collected_images AS c, main.images AS mi"
+                          " WHERE mi.id = c.imgid AND mi.group_id IN (%s)", groups);
+  old_ids = _collection_query_ids(query);
+  g_free(query);
+
+  _collection_build_where(collection, groups, &wq, &wq_no_group);
+  query = g_strdup_printf("SELECT mi.id FROM main.images AS mi"
+                          " WHERE (%s) AND mi.group_id IN (%s)", wq, groups);
+  new_ids = _collection_query_ids(query);
+  g_free(query);
+
+  dropped = g_hash_table_new(NULL, NULL);
+  for(GList *l = old_ids; l; l = g_list_next(l))
+    g_hash_table_add(dropped, l->data);
+  for(GList *l = new_ids; l; l = g_list_next(l))
+  {
+    // new images would need to be sorted in, leave it to the full update
+    if(!g_hash_table_remove(dropped, l->data)) goto end;
+  }
+
+  // the images which don't count anymore when groups are ignored
+  query = g_strdup_printf("SELECT mi.id FROM main.images AS mi"
+                          " WHERE mi.id IN (%s) AND NOT (%s)", imgs, wq_no_group);
+  left_ids = _collection_query_ids(query);
+  g_free(query);
+
+  const guint removed = g_hash_table_size(dropped);
+  if(removed)
+  {
+    GList *removed_ids = g_hash_table_get_keys(dropped);
+    gchar *txt = _collection_ids_to_sql(removed_ids);
+    g_list_free(removed_ids);
+
+    // the rowid is the position of the image, used by the thumbtable and the
+    // culling, so the images after the removed ones move up
+    query = g_strdup_printf("SELECT rowid FROM memory.collected_images"
+                            " WHERE imgid IN (%s) ORDER BY rowid", txt);
+    GList *rowids = _collection_query_ids(query);
+    g_free(query);
+
+    dt_database_start_transaction(darktable.db);
+    query = g_strdup_printf("DELETE FROM memory.collected_images WHERE imgid IN (%s)", txt);
+    DT_DEBUG_SQLITE3_EXEC(db, query, NULL, NULL, NULL);
+    g_free(query);
+    g_free(txt);
+
+    // move through negative rowids to never collide with an existing one
+    // clang-format off
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "UPDATE memory.collected_images SET rowid = ?1 - rowid"
+                                " WHERE rowid > ?2 AND rowid < ?3",
+                                -1, &stmt, NULL);
+    // clang-format on
+    int shift = 0;
+    for(GList *l = rowids; l; l = g_list_next(l))
+    {
+      shift++;
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, shift);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, GPOINTER_TO_INT(l->data));
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, l->next ? GPOINTER_TO_INT(l->next->data) : G_MAXINT);
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
+    }
+    sqlite3_finalize(stmt);
+    g_list_free(rowids);
+
+    // clang-format off
+    DT_DEBUG_SQLITE3_EXEC(db,
+                          "UPDATE memory.collected_images SET rowid = -rowid"
+                          " WHERE rowid < 0",
+                          NULL, NULL, NULL);
+    DT_DEBUG_SQLITE3_EXEC(db,
+                          "UPDATE memory.sqlite_sequence"
+                          " SET seq = (SELECT IFNULL(MAX(rowid), 0) FROM memory.collected_images)"
+                          " WHERE name = 'collected_images'",
+                          NULL, NULL, NULL);
+    // clang-format on
+    dt_database_release_transaction(darktable.db);
+  }
+
+  const guint left = g_list_length(left_ids);
+  if(left)
+  {
+    gchar *txt = _collection_ids_to_sql(left_ids);
+    query = g_strdup_printf("DELETE FROM main.selected_images WHERE imgid IN (%s)", txt);
+    DT_DEBUG_SQLITE3_EXEC(db, query, NULL, NULL, NULL);
+    g_free(query);
+    g_free(txt);
+    if(sqlite3_changes(db) > 0)
+      DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_SELECTION_CHANGED);
+  }
+
+  dt_collection_t *c = (dt_collection_t *)collection;
+  c->count_no_group -= MIN(left, c->count_no_group);
+  if(c->count != UINT32_MAX)
+    c->count -= MIN(removed, c->count);
+  if(removed || left)
+    dt_collection_hint_message(collection);
+
+  dt_print(DT_DEBUG_SQL, "[collection] patched %u changed images, %u removed",
+           g_list_length(list), removed);
+  ok = TRUE;
+
+end:
+  if(dropped) g_hash_table_destroy(dropped);
+  g_list_free(old_ids);
+  g_list_free(new_ids);
+  g_list_free(left_ids);
+  g_free(groups);
+  g_free(wq);
+  g_free(wq_no_group);
+  g_free(imgs);
+  return ok;
+}
+
 void dt_collection_update_query(const dt_collection_t *collection,
                                 const dt_collection_change_t query_change,
                                 const dt_collection_properties_t changed_property,
@@ -2816,17 +3206,37 @@ void dt_collection_update_query(const dt_collection_t *collection,
     (collection,
      (dt_collection_get_filter_flags(collection) & ~COLLECTION_FILTER_FILM_ID));
 
+  /* when only the properties of a few images have changed, there is no need
+     to evaluate the whole collection again */
+  const gboolean patchable = !collection->clone
+    && collection == darktable.collection
+    && query_change == DT_COLLECTION_CHANGE_RELOAD
+    && !g_list_is_empty(list)
+    && g_list_length(list) <= DT_COLLECTION_PATCH_MAX_IMAGES;
+  gchar *old_query = patchable ? g_strdup(collection->query) : NULL;
+  gchar *old_query_no_group = patchable ? g_strdup(collection->query_no_group) : NULL;
+
   /* update query and at last the visual */
   //if(collection->clone) //TODO: check whether we need an
   //unconditional update here, slowing down the UI
-  dt_collection_update(collection);  // if original collection, this
-                                     // update will be made by a
-                                     // signal handler
+  _collection_update(collection, FALSE); // if original collection, this
+                                         // update will be made by a
+                                         // signal handler
+
+  const gboolean patched = patchable
+    && old_query && !g_strcmp0(old_query, collection->query)
+    && !g_strcmp0(old_query_no_group, collection->query_no_group)
+    && !_collection_sort_uses(collection, changed_property)
+    && _collection_patch(collection, list);
+  g_free(old_query);
+  g_free(old_query_no_group);
+
+  if(!patched) _collection_recount(collection);
 
   // remove from selected images where not in this query.
   sqlite3_stmt *stmt = NULL;
   const gchar *cquery = dt_collection_get_query_no_group(collection);
-  if(cquery && cquery[0] != '\0')
+  if(!patched && cquery && cquery[0] != '\0')
   {
     gchar *complete_query = g_strdup_printf("DELETE FROM main.selected_images"
                                             " WHERE imgid NOT IN (%s)", cquery);
@@ -2849,7 +3259,7 @@ void dt_collection_update_query(const dt_collection_t *collection,
   /* raise signal of collection change, only if this is an original */
   if(!collection->clone)
   {
-    dt_collection_memory_update();
+    if(!patched) dt_collection_memory_update();
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_COLLECTION_CHANGED,
                             query_change, changed_property,
                             list, next);
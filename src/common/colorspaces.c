@@ -1160,6 +1160,11 @@ static void _update_display_transforms(dt_colorspaces_t *self)
     cmsDeleteTransform(self->transform_adobe_rgb_to_display);
   self->transform_adobe_rgb_to_display = NULL;
 
+  dt_colorspaces_transform_free(self->compiled_srgb_to_display);
+  self->compiled_srgb_to_display = NULL;
+  dt_colorspaces_transform_free(self->compiled_adobe_rgb_to_display);
+  self->compiled_adobe_rgb_to_display = NULL;
+
   const dt_colorspaces_color_profile_t *display_dt_profile =
     _get_profile(self,
                  self->display_type,
@@ -1186,6 +1191,18 @@ static void _update_display_transforms(dt_colorspaces_t *self)
                        TYPE_BGRA_8,
                        self->display_intent,
                        0);
+
+  self->compiled_srgb_to_display =
+    dt_colorspaces_transform_create(_get_profile(self, DT_COLORSPACE_SRGB, "",
+                                                 DT_PROFILE_DIRECTION_DISPLAY)->profile,
+                                    display_profile,
+                                    self->display_intent);
+
+  self->compiled_adobe_rgb_to_display =
+    dt_colorspaces_transform_create(_get_profile(self, DT_COLORSPACE_ADOBERGB, "",
+                                                 DT_PROFILE_DIRECTION_DISPLAY)->profile,
+                                    display_profile,
+                                    self->display_intent);
 }
 
 static void _update_display2_transforms(dt_colorspaces_t *self)
@@ -1741,6 +1758,11 @@ void dt_colorspaces_cleanup(dt_colorspaces_t *self)
     cmsDeleteTransform(self->transform_adobe_rgb_to_display2);
   self->transform_adobe_rgb_to_display2 = NULL;
 
+  dt_colorspaces_transform_free(self->compiled_srgb_to_display);
+  self->compiled_srgb_to_display = NULL;
+  dt_colorspaces_transform_free(self->compiled_adobe_rgb_to_display);
+  self->compiled_adobe_rgb_to_display = NULL;
+
   for(GList *iter = self->profiles; iter; iter = g_list_next(iter))
   {
     dt_colorspaces_color_profile_t *p = iter->data;
@@ -2644,6 +2666,248 @@ gboolean dt_colorspaces_profile_is_wide_gamut(const dt_colorspaces_color_profile
   return FALSE;
 }
 
+/* Compiled 8 bit display transforms.
+   Matrix profiles are evaluated by tone curve tables and a 3x3 matrix, all
+   others by a 3D LUT sampled from lcms once and interpolated tetrahedrally.
+   The plain lcms transform is kept only if neither can be built.
+*/
+#define DT_CT_LUT_SIZE 33
+#define DT_CT_ENCODE_SIZE 16384
+
+typedef enum dt_colorspaces_transform_type_t
+{
+  DT_CT_MATRIX = 0,
+  DT_CT_LUT = 1,
+  DT_CT_LCMS = 2,
+} dt_colorspaces_transform_type_t;
+
+struct dt_colorspaces_transform_t
+{
+  dt_colorspaces_transform_type_t type;
+  cmsHTRANSFORM xform;
+  // matrix: linearisation of the 8 bit input, matrix and encoding of the output
+  float linear[3][256];
+  dt_colormatrix_t matrix_t;
+  uint8_t *encode[3];
+  // lut: grid position and weight of all 8 bit input values
+  float *lut;
+  int index[256];
+  float weight[256];
+};
+
+static gboolean _transform_compile_matrix(dt_colorspaces_transform_t *t,
+                                          cmsHPROFILE input,
+                                          cmsHPROFILE output)
+{
+  dt_colormatrix_t in_matrix, out_matrix;
+  float *curves = dt_alloc_align_float(3 * DT_CT_ENCODE_SIZE);
+  if(!curves) return FALSE;
+
+  if(dt_colorspaces_get_matrix_from_input_profile(input, in_matrix,
+                                                  t->linear[0], t->linear[1], t->linear[2], 256)
+     || dt_colorspaces_get_matrix_from_output_profile(output, out_matrix,
+                                                      curves,
+                                                      curves + DT_CT_ENCODE_SIZE,
+                                                      curves + 2 * DT_CT_ENCODE_SIZE,
+                                                      DT_CT_ENCODE_SIZE))
+  {
+    dt_free_align(curves);
+    return FALSE;
+  }
+
+  for(int c = 0; c < 3; c++)
+  {
+    // linear curves are marked by the profile functions
+    if(t->linear[c][0] < 0.0f)
+      for(int k = 0; k < 256; k++) t->linear[c][k] = k / 255.0f;
+
+    const float *curve = curves + c * DT_CT_ENCODE_SIZE;
+    const gboolean linear = curve[0] < 0.0f;
+    t->encode[c] = dt_alloc_aligned(DT_CT_ENCODE_SIZE);
+    if(t->encode[c])
+      for(int k = 0; k < DT_CT_ENCODE_SIZE; k++)
+      {
+        const float v = linear ? k / (DT_CT_ENCODE_SIZE - 1.0f) : curve[k];
+        t->encode[c][k] = (uint8_t)CLAMP(roundf(255.0f * v), 0, 255);
+      }
+  }
+  dt_free_align(curves);
+  if(!t->encode[0] || !t->encode[1] || !t->encode[2]) return FALSE;
+
+  dt_colormatrix_t m;
+  dt_colormatrix_mul(m, out_matrix, in_matrix);
+  dt_colormatrix_transpose(t->matrix_t, m);
+  t->type = DT_CT_MATRIX;
+  return TRUE;
+}
+
+static gboolean _transform_compile_lut(dt_colorspaces_transform_t *t,
+                                       cmsHPROFILE input,
+                                       cmsHPROFILE output,
+                                       const dt_iop_color_intent_t intent)
+{
+  cmsHTRANSFORM xform = cmsCreateTransform(input, TYPE_RGB_FLT, output, TYPE_RGB_FLT, intent, 0);
+  if(!xform) return FALSE;
+
+  const int n = DT_CT_LUT_SIZE;
+  t->lut = dt_alloc_align_float((size_t)3 * n * n * n);
+  if(!t->lut)
+  {
+    cmsDeleteTransform(xform);
+    return FALSE;
+  }
+
+  // the grid is laid out with blue changing fastest, a row of blue is
+  // sampled in one go
+  DT_OMP_FOR(collapse(2))
+  for(int r = 0; r < n; r++)
+    for(int g = 0; g < n; g++)
+    {
+      float row[3 * DT_CT_LUT_SIZE];
+      for(int b = 0; b < n; b++)
+      {
+        row[3 * b + 0] = r / (n - 1.0f);
+        row[3 * b + 1] = g / (n - 1.0f);
+        row[3 * b + 2] = b / (n - 1.0f);
+      }
+      cmsDoTransform(xform, row, t->lut + (size_t)3 * n * (g + n * r), n);
+    }
+  cmsDeleteTransform(xform);
+
+  for(int k = 0; k < 256; k++)
+  {
+    const float pos = k * (n - 1) / 255.0f;
+    t->index[k] = MIN((int)pos, n - 2);
+    t->weight[k] = pos - t->index[k];
+  }
+  t->type = DT_CT_LUT;
+  return TRUE;
+}
+
+dt_colorspaces_transform_t *dt_colorspaces_transform_create(cmsHPROFILE input,
+                                                            cmsHPROFILE output,
+                                                            const dt_iop_color_intent_t intent)
+{
+  if(!input || !output) return NULL;
+
+  dt_colorspaces_transform_t *t = calloc(1, sizeof(dt_colorspaces_transform_t));
+  if(!t) return NULL;
+
+  // absolute colorimetric is not handled by the matrix path
+  const gboolean matrix = intent != DT_INTENT_ABSOLUTE_COLORIMETRIC
+    && cmsGetColorSpace(input) == cmsSigRgbData
+    && cmsGetColorSpace(output) == cmsSigRgbData
+    && _transform_compile_matrix(t, input, output);
+
+  if(!matrix)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      dt_free_align(t->encode[c]);
+      t->encode[c] = NULL;
+    }
+    if(!_transform_compile_lut(t, input, output, intent))
+    {
+      t->xform = cmsCreateTransform(input, TYPE_RGBA_8, output, TYPE_BGRA_8, intent, 0);
+      t->type = DT_CT_LCMS;
+      if(!t->xform)
+      {
+        free(t);
+        return NULL;
+      }
+    }
+  }
+
+  dt_print(DT_DEBUG_PERF, "[colorspaces] compiled display transform using %s",
+           t->type == DT_CT_MATRIX ? "matrix" : t->type == DT_CT_LUT ? "3D LUT" : "lcms");
+  return t;
+}
+
+void dt_colorspaces_transform_free(dt_colorspaces_transform_t *t)
+{
+  if(!t) return;
+  if(t->xform) cmsDeleteTransform(t->xform);
+  for(int c = 0; c < 3; c++) dt_free_align(t->encode[c]);
+  dt_free_align(t->lut);
+  free(t);
+}
+
+static inline void _transform_lut_pixel(const dt_colorspaces_transform_t *t,
+                                        const uint8_t *in,
+                                        dt_aligned_pixel_t out)
+{
+  const int n = DT_CT_LUT_SIZE;
+  const size_t sr = (size_t)3 * n * n, sg = 3 * n, sb = 3;
+  const float fr = t->weight[in[0]], fg = t->weight[in[1]], fb = t->weight[in[2]];
+  const float *c000 = t->lut + t->index[in[0]] * sr + t->index[in[1]] * sg + t->index[in[2]] * sb;
+  const float *c111 = c000 + sr + sg + sb;
+
+  // tetrahedral interpolation, the cube is split along its diagonal into six
+  // tetrahedra selected by the order of the fractional parts
+  const float *c1, *c2;
+  float w0, w1, w2, w3;
+  if(fr >= fg)
+  {
+    if(fg >= fb)      { c1 = c000 + sr; c2 = c000 + sr + sg; w0 = 1.0f - fr; w1 = fr - fg; w2 = fg - fb; w3 = fb; }
+    else if(fr >= fb) { c1 = c000 + sr; c2 = c000 + sr + sb; w0 = 1.0f - fr; w1 = fr - fb; w2 = fb - fg; w3 = fg; }
+    else              { c1 = c000 + sb; c2 = c000 + sr + sb; w0 = 1.0f - fb; w1 = fb - fr; w2 = fr - fg; w3 = fg; }
+  }
+  else
+  {
+    if(fb >= fg)      { c1 = c000 + sb; c2 = c000 + sg + sb; w0 = 1.0f - fb; w1 = fb - fg; w2 = fg - fr; w3 = fr; }
+    else if(fb >= fr) { c1 = c000 + sg; c2 = c000 + sg + sb; w0 = 1.0f - fg; w1 = fg - fb; w2 = fb - fr; w3 = fr; }
+    else              { c1 = c000 + sg; c2 = c000 + sr + sg; w0 = 1.0f - fg; w1 = fg - fr; w2 = fr - fb; w3 = fb; }
+  }
+  for(int c = 0; c < 3; c++)
+    out[c] = w0 * c000[c] + w1 * c1[c] + w2 * c2[c] + w3 * c111[c];
+}
+
+void dt_colorspaces_transform_rgba8(const dt_colorspaces_transform_t *t,
+                                    const uint8_t *const restrict in,
+                                    uint8_t *const restrict out,
+                                    const size_t npixels)
+{
+  if(!t)
+  {
+    for(size_t k = 0; k < 4 * npixels; k += 4)
+    {
+      out[k + 0] = in[k + 2];
+      out[k + 1] = in[k + 1];
+      out[k + 2] = in[k + 0];
+    }
+  }
+  else if(t->type == DT_CT_MATRIX)
+  {
+    const int last = DT_CT_ENCODE_SIZE - 1;
+    for(size_t k = 0; k < 4 * npixels; k += 4)
+    {
+      const dt_aligned_pixel_t rgb = { t->linear[0][in[k + 0]],
+                                       t->linear[1][in[k + 1]],
+                                       t->linear[2][in[k + 2]], 0.0f };
+      dt_aligned_pixel_t res;
+      dt_apply_transposed_color_matrix(rgb, t->matrix_t, res);
+      for_each_channel(c)
+        res[c] = CLAMPF(res[c], 0.0f, 1.0f) * last + 0.5f;
+      out[k + 0] = t->encode[2][(int)res[2]];
+      out[k + 1] = t->encode[1][(int)res[1]];
+      out[k + 2] = t->encode[0][(int)res[0]];
+    }
+  }
+  else if(t->type == DT_CT_LUT)
+  {
+    for(size_t k = 0; k < 4 * npixels; k += 4)
+    {
+      dt_aligned_pixel_t res;
+      _transform_lut_pixel(t, in + k, res);
+      out[k + 0] = (uint8_t)CLAMP(255.0f * res[2] + 0.5f, 0.0f, 255.0f);
+      out[k + 1] = (uint8_t)CLAMP(255.0f * res[1] + 0.5f, 0.0f, 255.0f);
+      out[k + 2] = (uint8_t)CLAMP(255.0f * res[0] + 0.5f, 0.0f, 255.0f);
+    }
+  }
+  else
+    cmsDoTransform(t->xform, in, out, npixels);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -159,6 +159,9 @@ typedef enum dt_colorspaces_cicp_matrix_coefficients_t
     DT_CICP_MATRIX_COEFFICIENTS_UNSPECIFIED = 2
 } dt_colorspaces_cicp_matrix_coefficients_t;
 
+/** a transform compiled from two profiles, see dt_colorspaces_transform_create() */
+typedef struct dt_colorspaces_transform_t dt_colorspaces_transform_t;
+
 typedef struct dt_colorspaces_t
 {
   GList *profiles;
@@ -190,6 +193,8 @@ typedef struct dt_colorspaces_t
 
   cmsHTRANSFORM transform_srgb_to_display, transform_adobe_rgb_to_display;
   cmsHTRANSFORM transform_srgb_to_display2, transform_adobe_rgb_to_display2;
+  // the same as the display transforms above compiled for fast drawing
+  dt_colorspaces_transform_t *compiled_srgb_to_display, *compiled_adobe_rgb_to_display;
 
 } dt_colorspaces_t;
 
@@ -395,6 +400,20 @@ void dt_colorspaces_update_display_transforms();
 /** same for display2 */
 void dt_colorspaces_update_display2_transforms();
 
+/** compile an 8 bit RGBA to BGRA transform between two profiles. matrix profiles are
+ * evaluated by tone curve tables and a matrix, all others via a 3D LUT sampled once
+ * from lcms. returns NULL if no transform can be made. */
+dt_colorspaces_transform_t *dt_colorspaces_transform_create(cmsHPROFILE input,
+                                                            cmsHPROFILE output,
+                                                            const dt_iop_color_intent_t intent);
+void dt_colorspaces_transform_free(dt_colorspaces_transform_t *t);
+/** apply a compiled transform to npixels of 8 bit RGBA writing BGRA, the alpha of out
+ * is not touched. with t == NULL the channels are just swapped. */
+void dt_colorspaces_transform_rgba8(const dt_colorspaces_transform_t *t,
+                                    const uint8_t *const restrict in,
+                                    uint8_t *const restrict out,
+                                    const size_t npixels);
+
 /** Calculate CAM->XYZ, XYZ->CAM matrices **/
 gboolean dt_colorspaces_conversion_matrices_xyz(const float adobe_XYZ_to_CAM[4][3],
                                            float in_XYZ_to_CAM[9],
@@ -25,6 +25,7 @@
 #include <sys/malloc.h>
 #endif
 
+#include "common/artifact_cache.h"
 #include "common/collection.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
@@ -45,17 +46,24 @@
 #include "common/image_cache.h"
 #include "common/iop_order.h"
 #include "common/l10n.h"
+#include "common/memory_account.h"
+#include "common/memory_budget.h"
+#include "common/numa.h"
 #include "common/mipmap_cache.h"
 #include "common/noiseprofiles.h"
 #include "common/opencl.h"
 #include "common/points.h"
 #include "common/resource_limits.h"
+#include "common/trace.h"
 #include "common/undo.h"
 #include "common/gimp.h"
 #include "common/pfm.h"
 #ifdef HAVE_AI
 #include "common/ai_models.h"
 #endif
+#ifdef HAVE_METAL
+#include "osx/metal.h"
+#endif
 #include "control/conf.h"
 #include "control/control.h"
 #include "control/crawler.h"
@@ -65,6 +73,8 @@
 #include "control/signal.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
+#include "develop/masks.h"
+#include "develop/pixelpipe_cache.h"
 #include "gui/accelerators.h"
 #include "gui/workspace.h"
 #include "gui/gtk.h"
@@ -260,13 +270,21 @@ static int usage(const char *argv0)
          "\n"
          "--dumpdir DIR\n"
          "\n"
+         "--trace FILE\n"
+         "    Write a trace of all pixelpipe module runs with their timing, device,\n"
+         "    tiling and cache use to FILE in the Chrome trace event format,\n"
+         "    it can be loaded into Perfetto or chrome://tracing.\n"
+         "\n"
          "-d CHANNEL\n"
          "    Enable debug output to the terminal (or to the log file if on Windows).\n"
          "    Valid channels are:\n\n"
          "    act_on, ai, cache, camctl, camsupport, control, dev, expose,\n"
          "    imageio, input, ioporder, lighttable, lua, masks, memory,\n"
          "    nan, opencl, params, perf, pipe, print, pwstorage, signal,\n"
-         "    sql, tiling, picker, undo\n"
+         "    sql, sqlplan, tiling, picker, undo\n"
+         "\n"
+         "    sqlplan runs EXPLAIN QUERY PLAN once for every distinct prepared\n"
+         "    statement and reports the ones scanning a whole table.\n"
          "\n"
          "    It is also possible to specify names that activate all channels\n"
          "    or a certain subset, as well as increase verbosity:\n"
@@ -721,9 +739,88 @@ void dt_dump_pipe_diff_pfm(
   dt_free_align(o);
 }
 
+// startup phases, reported at the end of dt_init() with -d perf
+#define DT_INIT_MAX_PHASES 32
+
+typedef struct _init_phase_t
+{
+  const char *name;
+  double start, end; // since darktable.start_wtime
+  gboolean background;
+} _init_phase_t;
+
+static struct
+{
+  GMutex lock;
+  _init_phase_t phase[DT_INIT_MAX_PHASES];
+  int count;
+  gboolean reported;
+} _init_phases;
+
+static void _init_phase_print(const _init_phase_t *phase)
+{
+  dt_print(DT_DEBUG_PERF, "[dt_init] %-10s %-24s %7.3f - %7.3f  (%.3f secs)",
+           phase->background ? "background" : "main", phase->name,
+           phase->start, phase->end, phase->end - phase->start);
+}
+
+// record the phase name started at start, returns the current time for
+// the start of the next one
+static double _init_phase(const char *name,
+                          const double start,
+                          const gboolean background)
+{
+  const double now = dt_get_wtime();
+  const _init_phase_t phase = { name, start - darktable.start_wtime,
+                                now - darktable.start_wtime, background };
+  g_mutex_lock(&_init_phases.lock);
+  if(_init_phases.reported)
+    _init_phase_print(&phase); // a background phase outlasting dt_init()
+  else if(_init_phases.count < DT_INIT_MAX_PHASES)
+    _init_phases.phase[_init_phases.count++] = phase;
+  g_mutex_unlock(&_init_phases.lock);
+  return now;
+}
+
+static void _init_phases_report(void)
+{
+  g_mutex_lock(&_init_phases.lock);
+  for(int k = 0; k < _init_phases.count; k++)
+    _init_phase_print(&_init_phases.phase[k]);
+  _init_phases.reported = TRUE;
+  g_mutex_unlock(&_init_phases.lock);
+}
+
+// the color profiles only get used once the GUI and the modules are set
+// up, scan them while the library is opened
+static void *_init_colorspaces_thread(void *data)
+{
+  const double start = dt_get_wtime();
+  darktable.color_profiles = dt_colorspaces_init();
+  _init_phase("color profiles", start, TRUE);
+  return NULL;
+}
+
+typedef struct _init_opencl_t
+{
+  int options;
+  gboolean print_statistics;
+} _init_opencl_t;
+
+static void *_init_opencl_thread(void *data)
+{
+  const _init_opencl_t *params = data;
+  const double start = dt_get_wtime();
+  dt_opencl_init(darktable.opencl, params->options, params->print_statistics);
+  _init_phase("OpenCL", start, TRUE);
+  return NULL;
+}
+
 static int32_t _detect_opencl_job_run(dt_job_t *job)
 {
+  const double start = dt_get_wtime();
   dt_opencl_init(darktable.opencl, GPOINTER_TO_INT(dt_control_job_get_params(job)), TRUE);
+  _init_phase("OpenCL", start, TRUE);
   return 0;
 }
 
@@ -785,6 +882,43 @@ void dt_stop_backthumbs_crawler(const gboolean wait)
   }
 }
 
+// the CPU specific variant the loader picks on this machine, the
+// per-pixel loops may have been built without any
+static char *_get_clones_string(void)
+{
+#if defined(DT_CLONE_TARGETS_X86_64)
+  static const char *const built[] = { DT_TARGET_CLONES_X86_64 };
+  __builtin_cpu_init();
+  // same preference as the ifunc resolver, widest vectors first
+  const struct { const char *isa; gboolean supported; } probe[] =
+  {
+    { "avx512f", __builtin_cpu_supports("avx512f") },
+    { "avx2",    __builtin_cpu_supports("avx2") },
+    { "fma4",    __builtin_cpu_supports("fma4") },
+    { "avx",     __builtin_cpu_supports("avx") },
+    { "popcnt",  __builtin_cpu_supports("popcnt") },
+    { "sse4.2",  __builtin_cpu_supports("sse4.2") },
+    { "sse4.1",  __builtin_cpu_supports("sse4.1") },
+    { "sse3",    __builtin_cpu_supports("sse3") },
+    { "sse2",    __builtin_cpu_supports("sse2") },
+  };
+  for(size_t i = 0; i < G_N_ELEMENTS(probe); i++)
+  {
+    if(!probe[i].supported) continue;
+    for(size_t k = 0; k < G_N_ELEMENTS(built); k++)
+      if(!strcmp(built[k], probe[i].isa))
+        return g_strdup_printf("ENABLED  - %s variant used on this CPU\n", probe[i].isa);
+  }
+  return g_strdup("ENABLED  - default variant used on this CPU\n");
+#elif defined(DT_CLONE_TARGETS_PPC64)
+  return g_strdup(__builtin_cpu_supports("arch_3_00")
+                  ? "ENABLED  - power9 variant used on this CPU\n"
+                  : "ENABLED  - default variant used on this CPU\n");
+#else
+  return g_strdup("DISABLED\n");
+#endif
+}
+
 static char *_get_version_string(void)
 {
   const char *exiv2_version = EXV_PACKAGE_VERSION "\n";
@@ -820,12 +954,14 @@ static char *_get_version_string(void)
                                        STR(LUA_API_VERSION_PATCH) "\n";
 #endif
 
+char *clones_info = _get_clones_string();
+
 char *version = g_strdup_printf(
                "darktable %s [%s]\n"
                "Copyright (C) 2012-%s Johannes Hanika and other contributors.\n\n"
                "Compile options:\n"
                "  Bit depth              -> %zu bit\n"
-               "%s%s%s%s%s%s%s%s%s\n"
+               "%s%s%s%s%s%s%s%s%s%s%s\n"
                "See %s for detailed documentation.\n"
                "See %s to report bugs.\n",
                darktable_package_version,
@@ -847,6 +983,8 @@ char *version = g_strdup_printf(
                "  SSE2 optimizations     -> DISABLED\n"
 #endif
 
+               "  CPU specific variants  -> ", clones_info,
+
 #ifdef _OPENMP
                "  OpenMP                 -> ENABLED\n"
 #else
@@ -859,6 +997,10 @@ char *version = g_strdup_printf(
                "  OpenCL                 -> DISABLED - GPU acceleration is NOT available\n"
 #endif
 
+#ifdef HAVE_METAL
+               "  Metal                  -> ENABLED  - device setup only, not used for processing\n"
+#endif
+
 #ifdef USE_LUA
                "  Lua                    -> ENABLED  - API version ", lua_api_version,
 #else
@@ -952,6 +1094,7 @@ char *version = g_strdup_printf(
                PACKAGE_DOCS,
                PACKAGE_BUGREPORT);
 
+  g_free(clones_info);
   return version;
 }
 
@@ -1072,6 +1215,12 @@ int dt_init(int argc,
         argv[k-1] = NULL;
         argv[k] = NULL;
       }
+      else if(!strcmp(argv[k], "--trace") && argc > k + 1)
+      {
+        dt_trace_init(argv[++k]);
+        argv[k-1] = NULL;
+        argv[k] = NULL;
+      }
       else if(!strcmp(argv[k], "--bench-module") && argc > k + 1)
       {
         darktable.bench_module = argv[++k];
@@ -1153,6 +1302,7 @@ int dt_init(int argc,
           !strcmp(darg, "pwstorage") ? DT_DEBUG_PWSTORAGE : // pwstorage module
           !strcmp(darg, "opencl") ? DT_DEBUG_OPENCL : // gpu accel via opencl
           !strcmp(darg, "sql") ? DT_DEBUG_SQL : // SQLite3 queries
+          !strcmp(darg, "sqlplan") ? DT_DEBUG_SQL_PLAN : // full scans in SQLite3 query plans
           !strcmp(darg, "memory") ? DT_DEBUG_MEMORY : // some stats on mem usage now and then.
           !strcmp(darg, "lighttable") ? DT_DEBUG_LIGHTTABLE : // lighttable related stuff.
           !strcmp(darg, "nan") ? DT_DEBUG_NAN : // check for NANs when processing the pipe.
@@ -1680,8 +1830,14 @@ int dt_init(int argc,
   // detect cpu features and decide which codepaths to enable
   dt_codepaths_init();
 
-  // get the list of color profiles
-  darktable.color_profiles = dt_colorspaces_init();
+  double phase_start = _init_phase("configuration", start_wtime, FALSE);
+
+  // get the list of color profiles, in the background until the GUI needs them
+  pthread_t colorspaces_thread;
+  const gboolean colorspaces_threaded =
+    !dt_pthread_create(&colorspaces_thread, _init_colorspaces_thread, NULL);
+  if(!colorspaces_threaded)
+    darktable.color_profiles = dt_colorspaces_init();
 
 #ifdef HAVE_AI
   // initialize AI models registry (the singleton darktable.ai_registry)
@@ -1706,6 +1862,7 @@ int dt_init(int argc,
   {
     dt_print(DT_DEBUG_ALWAYS, "ERROR : cannot open database");
     dt_splash_screen_destroy();
+    if(colorspaces_threaded) dt_pthread_join(colorspaces_thread);
     return 1;
   }
   else if(!dt_database_get_lock_acquired(darktable.db))
@@ -1741,6 +1898,7 @@ int dt_init(int argc,
     if(!image_loaded_elsewhere && init_gui) dt_database_show_error(darktable.db, dblabel);
 
     dt_print(DT_DEBUG_ALWAYS, "ERROR: can't acquire database lock, aborting.");
+    if(colorspaces_threaded) dt_pthread_join(colorspaces_thread);
     return 1;
   }
 
@@ -1750,6 +1908,7 @@ int dt_init(int argc,
   // init darktable tags table
   dt_splash_screen_set_progress(_("setting up tags table"));
   dt_set_darktable_tags();
+  phase_start = _init_phase("image library", phase_start, FALSE);
 
   // Initialize the signal system
   dt_splash_screen_set_progress(_("initializing signals and control"));
@@ -1855,6 +2014,7 @@ int dt_init(int argc,
   }
 
   dt_get_sysresource_level();
+  dt_numa_init();
   res->mipmap_memory = _get_mipmap_size();
   dt_print(DT_DEBUG_MEMORY | DT_DEBUG_DEV,
     "  mipmap cache:    %luMB", res->mipmap_memory / DT_MEGA);
@@ -1900,23 +2060,42 @@ int dt_init(int argc,
   // Do locale-sensitive init BEFORE starting any background worker jobs
   dt_splash_screen_set_progress(_("loading noise profiles"));
   darktable.noiseprofile_parser = dt_noiseprofile_init(noiseprofiles_from_command);
+  phase_start = _init_phase("control, styles, presets", phase_start, FALSE);
 
   dt_splash_screen_set_progress(_("starting OpenCL"));
   darktable.opencl = (dt_opencl_t *)calloc(1, sizeof(dt_opencl_t));
   darktable.points = (dt_points_t *)calloc(1, sizeof(dt_points_t));
   dt_points_init(darktable.points, dt_get_num_threads());
 
-  // Only then kick off the OpenCL background job
+  // Only then kick off the OpenCL background job. Without GUI there are no
+  // workers for it yet, a thread of its own joins before Lua is started.
+  pthread_t opencl_thread;
+  gboolean opencl_threaded = FALSE;
+  _init_opencl_t opencl_params = { options, print_statistics };
   if(init_gui)
     dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG, _detect_opencl_job_create(options));
   else
-    dt_opencl_init(darktable.opencl, options, print_statistics);
+  {
+    opencl_threaded = !dt_pthread_create(&opencl_thread, _init_opencl_thread, &opencl_params);
+    if(!opencl_threaded)
+      dt_opencl_init(darktable.opencl, options, print_statistics);
+  }
+
+#ifdef HAVE_METAL
+  // not used by the pixelpipe yet, only sets up and checks the device
+  dt_metal_init();
+#endif
 
   // must come before mipmap_cache, because that one will need to access image dimensions stored in here:
   dt_image_cache_init();
 
   dt_mipmap_cache_init();
 
+  dt_dev_pixelpipe_cache_global_init();
+
+  // scales the cache budgets above with the memory pressure of the system
+  dt_memory_budget_init();
+
   // set up the list of exiv2 metadata
   dt_exif_set_exiv2_taglist();
 
@@ -1928,6 +2107,16 @@ int dt_init(int argc,
   dt_splash_screen_set_progress(_("synchronizing local copies"));
   dt_image_local_copy_synch();
 
+  phase_start = _init_phase("caches, metadata", phase_start, FALSE);
+
+  // the camera live view, the GUI, image formats and modules need the
+  // color profiles
+  if(colorspaces_threaded)
+  {
+    dt_pthread_join(colorspaces_thread);
+    phase_start = _init_phase("wait for color profiles", phase_start, FALSE);
+  }
+
 #ifdef HAVE_GPHOTO2
   // Initialize the camera control.  this is done late so that the
   // gui can react to the signal sent but before switching to
@@ -1960,6 +2149,7 @@ int dt_init(int argc,
         && dt_get_num_threads() >= 4
         && !(dbfilename_from_command && !strcmp(dbfilename_from_command, ":memory:"));
 
+    phase_start = _init_phase("GUI", phase_start, FALSE);
   }
 
   dt_splash_screen_set_progress(_("loading image formats"));
@@ -1979,8 +2169,10 @@ int dt_init(int argc,
   {
     dt_print(DT_DEBUG_ALWAYS, "[dt_init] ERROR: iop order looks bad, aborting.");
     dt_splash_screen_destroy();
+    if(opencl_threaded) dt_pthread_join(opencl_thread);
     return 1;
   }
+  phase_start = _init_phase("image formats, modules", phase_start, FALSE);
 
   if(darktable.dump_pfm_module)
     dt_print(DT_DEBUG_ALWAYS,
@@ -2006,12 +2198,20 @@ int dt_init(int argc,
     dt_splash_screen_set_progress(_("loading utility modules"));
     darktable.lib = (dt_lib_t *)calloc(1, sizeof(dt_lib_t));
     dt_lib_init(darktable.lib);
+    phase_start = _init_phase("views, utility modules", phase_start, FALSE);
+  }
+
+  if(opencl_threaded)
+  {
+    dt_pthread_join(opencl_thread);
+    phase_start = _init_phase("wait for OpenCL", phase_start, FALSE);
   }
 
 /* init lua last, since it's user made stuff it must be in the real environment */
 #ifdef USE_LUA
   dt_splash_screen_set_progress(_("initializing Lua"));
   dt_lua_init(darktable.lua_state.state, lua_command);
+  phase_start = _init_phase("Lua", phase_start, FALSE);
 #endif
 
   if(init_gui)
@@ -2087,12 +2287,17 @@ int dt_init(int argc,
     // finally set the cursor to be the default.
     // for some reason this is needed on some systems to pick up the correctly themed cursor
     dt_control_change_cursor("default");
+    _init_phase("main window", phase_start, FALSE);
   }
   free(config_info);
 
   // fire up a background job to perform sidecar writes
   dt_control_sidecar_synch_start();
 
+  // snapshots and maintenance of the library while it's quiet
+  if(init_gui)
+    dt_database_start_idle_tasks(darktable.db);
+
 #if defined(WIN32)
   dt_capabilities_add("windows");
   dt_capabilities_add("nonapple");
@@ -2105,6 +2310,7 @@ int dt_init(int argc,
 
   dt_print(DT_DEBUG_CONTROL,
            "[dt_init] startup took %f seconds", dt_get_wtime() - start_wtime);
+  _init_phases_report();
 
   dt_print_mem_usage("after successful startup");
 
@@ -2237,9 +2443,15 @@ void dt_cleanup()
   else
     dt_control_cleanup(FALSE);
 
+  // sidecar writes requested after the background job has finished
+  dt_sidecar_synch_flush();
 
+  dt_memory_budget_cleanup();
+  dt_mem_account_print("at shutdown");
   dt_image_cache_cleanup();
   dt_mipmap_cache_cleanup();
+  dt_dev_pixelpipe_cache_global_cleanup();
+  dt_masks_raster_cache_cleanup();
 
   dt_colorspaces_cleanup(darktable.color_profiles);
 #ifdef HAVE_AI
@@ -2260,6 +2472,9 @@ void dt_cleanup()
   dt_opencl_cleanup(darktable.opencl);
   free(darktable.opencl);
   darktable.opencl = NULL;
+#ifdef HAVE_METAL
+  dt_metal_cleanup();
+#endif
 #ifdef HAVE_GPHOTO2
   dt_camctl_destroy((dt_camctl_t *)darktable.camctl);
   darktable.camctl = NULL;
@@ -2319,8 +2534,11 @@ void dt_cleanup()
     g_object_unref(darktable.noiseprofile_parser);
     darktable.noiseprofile_parser = NULL;
   }
+  dt_noiseprofile_cleanup();
+  dt_artifact_cache_cleanup();
 
   dt_capabilities_cleanup();
+  dt_trace_cleanup();
 
   if(darktable.tmp_directory)
     g_free(darktable.tmp_directory);
@@ -2386,6 +2604,7 @@ void *dt_alloc_aligned(const size_t size)
 #else
   void *ptr = NULL;
   if(posix_memalign(&ptr, alignment, aligned_size)) return NULL;
+  dt_numa_place(ptr, aligned_size);
   return ptr;
 #endif
 }
@@ -2465,6 +2684,51 @@ int dt_worker_threads()
   return wthreads;
 }
 
+static dt_atomic_int _budget_active[DT_THREAD_BUDGET_CLASSES];
+static const int _budget_weight[DT_THREAD_BUDGET_CLASSES] = { 4, 2, 1, 1 };
+static const char *_budget_name[DT_THREAD_BUDGET_CLASSES] = { "full", "preview", "export", "background" };
+
+int dt_thread_budget_acquire(const dt_thread_budget_class_t cls, int *previous)
+{
+#ifdef _OPENMP
+  *previous = omp_get_max_threads();
+  dt_atomic_add_int(&_budget_active[cls], 1);
+
+  int weights = 0;
+  int pipes = 0;
+  for(int k = 0; k < DT_THREAD_BUDGET_CLASSES; k++)
+  {
+    const int active = dt_atomic_get_int(&_budget_active[k]);
+    weights += active * _budget_weight[k];
+    pipes += active;
+  }
+
+  // pipes started later don't shrink the teams of the running ones,
+  // they get their smaller share on their next run
+  const int total = dt_get_num_threads();
+  const int share = pipes > 1 ? MAX(1, total * _budget_weight[cls] / MAX(1, weights)) : total;
+  // callers like the export lanes may already have limited their team
+  const int threads = MIN(share, *previous);
+  if(threads != *previous) omp_set_num_threads(threads);
+
+  dt_print(DT_DEBUG_PERF, "[thread budget] %s pipe uses %d of %d threads, %d pipes running",
+           _budget_name[cls], threads, total, pipes);
+  return threads;
+#else
+  *previous = 1;
+  dt_atomic_add_int(&_budget_active[cls], 1);
+  return 1;
+#endif
+}
+
+void dt_thread_budget_release(const dt_thread_budget_class_t cls, const int previous)
+{
+  dt_atomic_sub_int(&_budget_active[cls], 1);
+#ifdef _OPENMP
+  if(omp_get_max_threads() != previous) omp_set_num_threads(previous);
+#endif
+}
+
 size_t dt_get_available_mem()
 {
   dt_sys_resources_t *res = &darktable.dtresources;
@@ -2771,6 +3035,8 @@ void dt_print_mem_usage(char *info)
 #else
   dt_print(DT_DEBUG_ALWAYS, "dt_print_mem_usage() currently unsupported on this platform");
 #endif
+
+  dt_mem_account_print(info);
 }
 
 // clang-format off
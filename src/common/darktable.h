@@ -145,12 +145,15 @@ G_BEGIN_DECLS
 /* Create cloned functions for various CPU SSE generations */
 /* See for instructions https://hannes.hauswedell.net/post/2017/12/09/fmv/ */
 /* TL;DR : use only on SIMD functions containing low-level paralellized/vectorized loops */
-#if __has_attribute(target_clones) && !defined(_WIN32) && !defined(NATIVE_ARCH) && !defined(__APPLE__) && defined(__GLIBC__)
+/* The x86_64 variants are chosen at build time, see USE_TARGET_CLONES and TARGET_CLONES_X86_64 */
+#if __has_attribute(target_clones) && defined(USE_TARGET_CLONES) && !defined(_WIN32) && !defined(NATIVE_ARCH) && !defined(__APPLE__) && defined(__GLIBC__)
 # if defined(__amd64__) || defined(__amd64) || defined(__x86_64__) || defined(__x86_64)
-#define __DT_CLONE_TARGETS__ __attribute__((target_clones("default", "sse2", "sse3", "sse4.1", "sse4.2", "popcnt", "avx", "avx2", "avx512f", "fma4")))
+#define __DT_CLONE_TARGETS__ __attribute__((target_clones(DT_TARGET_CLONES_X86_64)))
+#define DT_CLONE_TARGETS_X86_64 1
 # elif defined(__PPC64__)
 /* __PPC64__ is the only macro tested for in is_supported_platform.h, other macros would fail there anyway. */
 #define __DT_CLONE_TARGETS__ __attribute__((target_clones("default","cpu=power9")))
+#define DT_CLONE_TARGETS_PPC64 1
 # else
 #define __DT_CLONE_TARGETS__
 # endif
@@ -389,6 +392,7 @@ typedef enum dt_debug_thread_t
   DT_DEBUG_EXPOSE         = 1 << 26,
   DT_DEBUG_PICKER         = 1 << 27,
   DT_DEBUG_AI             = 1 << 28,
+  DT_DEBUG_SQL_PLAN       = 1 << 29,
   DT_DEBUG_ALL            = 0xffffffff & ~DT_DEBUG_VERBOSE,
   DT_DEBUG_COMMON         = DT_DEBUG_OPENCL | DT_DEBUG_PARAMS | DT_DEBUG_IMAGEIO | DT_DEBUG_PIPE | DT_DEBUG_LUA | DT_DEBUG_AI,
   DT_DEBUG_RESTRICT       = DT_DEBUG_VERBOSE | DT_DEBUG_PERF,
@@ -551,6 +555,22 @@ int dt_worker_threads();
 size_t dt_get_available_mem();
 size_t dt_get_singlebuffer_mem();
 
+// the OpenMP threads are split between the pipes running at the same time,
+// weighted by the class of the pipe so the darkroom view stays responsive
+typedef enum dt_thread_budget_class_t
+{
+  DT_THREAD_BUDGET_FULL = 0,   // darkroom center view
+  DT_THREAD_BUDGET_PREVIEW,    // navigation and second window
+  DT_THREAD_BUDGET_EXPORT,
+  DT_THREAD_BUDGET_BACKGROUND, // thumbnails
+  DT_THREAD_BUDGET_CLASSES
+} dt_thread_budget_class_t;
+
+// claim a share of the threads for the OpenMP team of the calling thread.
+// returns the team size in effect, *previous must be passed to the release.
+int dt_thread_budget_acquire(const dt_thread_budget_class_t cls, int *previous);
+void dt_thread_budget_release(const dt_thread_budget_class_t cls, const int previous);
+
 void dt_dump_pfm_file(const char *pipe,
                       const void *data,
                       const int width,
@@ -815,16 +835,42 @@ static inline int dt_get_thread_num()
 #define DT_INITHASH 5381
 #define DT_INVALID_HASH 0
 typedef uint64_t dt_hash_t;
+static inline uint64_t _dt_hash_mix(const uint64_t a, const uint64_t b)
+{
+  const __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static inline uint64_t _dt_hash_read(const uint8_t *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
 static inline dt_hash_t dt_hash(dt_hash_t hash, const void *data, const size_t size)
 {
-  const uint8_t* str = (uint8_t*)data;
-  // Scramble bits in str to create an (hopefully) unique hash representing the state of str
-  // Dan Bernstein algo v2 http://www.cse.yorku.ca/~oz/hash.html
+  // Scramble bits in data to create an (hopefully) unique hash representing the state of data.
+  // wyhash style: 16 bytes per step are folded into the hash by a 64x64->128 bit multiply.
   // hash should be inited to DT_INITHASH if first run, or from a previous hash computed with this function.
-  for(size_t i = 0; i < size; i++)
-    hash = ((hash << 5) + hash) ^ str[i];
+  // The values depend on the byte order, they are not meant to be exchanged between machines.
+  const uint64_t p0 = 0xa0761d6478bd642full;
+  const uint64_t p1 = 0xe7037ed1a0b428dbull;
+  const uint8_t *str = (const uint8_t *)data;
+  size_t n = size;
+  for(; n > 16; n -= 16, str += 16)
+    hash = _dt_hash_mix(_dt_hash_read(str) ^ p0, _dt_hash_read(str + 8) ^ hash);
+
+  uint64_t a = 0, b = 0;
+  if(n > 8)
+  {
+    a = _dt_hash_read(str);
+    memcpy(&b, str + 8, n - 8);
+  }
+  else if(n)
+    memcpy(&a, str, n);
 
-  return hash;
+  return _dt_hash_mix(p1 ^ size, _dt_hash_mix(a ^ p0, b ^ hash ^ p1));
 }
 
 // Allocate a buffer for 'n' objects each of size 'objsize' bytes for
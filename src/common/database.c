@@ -51,7 +51,7 @@
 #define LAST_FULL_DATABASE_VERSION_DATA    10
 
 // You HAVE TO bump THESE versions whenever you add an update branches to _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 57
+#define CURRENT_DATABASE_VERSION_LIBRARY 64
 #define CURRENT_DATABASE_VERSION_DATA    13
 
 #define USE_NESTED_TRANSACTIONS
@@ -59,6 +59,9 @@
 /* transaction id */
 static dt_atomic_int _trxid;
 
+// read-only connections opened in WAL mode
+#define DT_DATABASE_READERS_MAX 4
+
 typedef struct dt_database_t
 {
   gboolean lock_acquired;
@@ -74,8 +77,27 @@ typedef struct dt_database_t
 
   gchar *error_message, *error_dbfilename;
   int error_other_pid;
+
+  /* idle prepared statements by their sql text, see dt_database_prepare_cached() */
+  dt_pthread_mutex_t stmt_lock;
+  GHashTable *stmt_cache;
+
+  /* write-ahead logging and the read-only connections it allows, see
+     dt_database_get_reader() */
+  gboolean wal;
+  dt_pthread_mutex_t reader_lock;
+  sqlite3 *readers[DT_DATABASE_READERS_MAX];
+  gboolean reader_busy[DT_DATABASE_READERS_MAX];
+  int num_readers;
+
+  /* called on rollbacks of the main handle, see dt_database_connect_rollback() */
+  GHookList rollback_hooks;
 } dt_database_t;
 
+// idle statements kept per sql text and sql texts kept overall
+#define DT_DATABASE_STMT_IDLE_MAX 4
+#define DT_DATABASE_STMT_CACHE_MAX 256
+
 
 /* migrates database from old place to new */
 static void _database_migrate_to_xdg_structure();
@@ -2967,6 +2989,86 @@ static int _upgrade_library_schema_step(dt_database_t *db,
              "[init] can't add `flash_tagvalue' column to images table in database\n");
     new_version = 57;
   }
+  else if(version == 57)
+  {
+    // indexes for the range filters of the collection, an index on a
+    // single column of images also covers the id (the rowid)
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_exposure_index ON images (exposure)",
+             "can't create index on 'exposure'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_aperture_index ON images (aperture)",
+             "can't create index on 'aperture'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_iso_index ON images (iso)",
+             "can't create index on 'iso'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_focal_length_index ON images (focal_length)",
+             "can't create index on 'focal_length'");
+
+    // make the tag and colour label joins covering, tagged_images has a rowid
+    // apart from its primary key so the old index had to go back to the table
+    TRY_EXEC("DROP INDEX IF EXISTS main.tagged_images_tagid_index",
+             "can't drop index 'tagged_images_tagid_index'");
+    TRY_EXEC("CREATE INDEX main.tagged_images_tagid_index ON tagged_images (tagid, imgid)",
+             "can't create index on 'tagid, imgid'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.color_labels_color_index ON color_labels (color, imgid)",
+             "can't create index on 'color, imgid'");
+    new_version = 58;
+  }
+  else if(version == 58)
+  {
+    // mtime of the folder when the crawler last found nothing to report,
+    // unchanged folders are skipped on the next start
+    TRY_EXEC("ALTER TABLE main.film_rolls ADD COLUMN crawl_mtime INTEGER DEFAULT 0",
+             "can't add `crawl_mtime' column to film_rolls table in database");
+    new_version = 59;
+  }
+  else if(version == 59)
+  {
+    // persistent export queue: the settings of each export and the images
+    // still to go, so that an interrupted export is resumed on the next start
+    TRY_EXEC("CREATE TABLE main.export_batches"
+             " (id INTEGER PRIMARY KEY, params BLOB NOT NULL, created INTEGER)",
+             "can't create table export_batches");
+    TRY_EXEC("CREATE TABLE main.export_queue"
+             " (batch INTEGER NOT NULL, position INTEGER NOT NULL, imgid INTEGER NOT NULL,"
+             "  done INTEGER NOT NULL DEFAULT 0, history_hash BLOB,"
+             "  PRIMARY KEY (batch, position),"
+             "  FOREIGN KEY(batch) REFERENCES export_batches(id) ON DELETE CASCADE)",
+             "can't create table export_queue");
+    new_version = 60;
+  }
+  else if(version == 60)
+  {
+    // what each file exported to disk was developed from: history, export
+    // settings and darktable version, hashed together
+    TRY_EXEC("CREATE TABLE main.export_manifest"
+             " (filename VARCHAR PRIMARY KEY, imgid INTEGER, hash INTEGER)",
+             "can't create table export_manifest");
+    new_version = 61;
+  }
+  else if(version == 61)
+  {
+    // perceptual hash of the first thumbnail of each image
+    TRY_EXEC("CREATE TABLE main.image_phash"
+             " (imgid INTEGER PRIMARY KEY, phash INTEGER NOT NULL,"
+             "  FOREIGN KEY(imgid) REFERENCES images(id) ON DELETE CASCADE ON UPDATE CASCADE)",
+             "can't create table image_phash");
+    new_version = 62;
+  }
+  else if(version == 62)
+  {
+    // modification time of each file when its info was last refreshed
+    TRY_EXEC("CREATE TABLE main.image_exif_mtime"
+             " (imgid INTEGER PRIMARY KEY, mtime INTEGER NOT NULL,"
+             "  FOREIGN KEY(imgid) REFERENCES images(id) ON DELETE CASCADE ON UPDATE CASCADE)",
+             "can't create table image_exif_mtime");
+    new_version = 63;
+  }
+  else if(version == 63)
+  {
+    // how often an export batch has been resumed without making progress
+    TRY_EXEC("ALTER TABLE main.export_batches ADD COLUMN attempts INTEGER NOT NULL DEFAULT 0",
+             "can't add `attempts' column to export_batches table in database");
+    new_version = 64;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -3708,6 +3810,10 @@ static void _create_memory_schema(dt_database_t *db)
       db->handle,
       "CREATE TABLE memory.collected_images (rowid INTEGER PRIMARY KEY AUTOINCREMENT, imgid INTEGER)", NULL,
       NULL, NULL);
+  // the thumbtable and darkroom look up the position of an image all the time
+  sqlite3_exec(db->handle,
+      "CREATE INDEX memory.collected_images_imgid_index ON collected_images (imgid)", NULL,
+      NULL, NULL);
   sqlite3_exec(db->handle, "CREATE TABLE memory.tmp_selection (imgid INTEGER PRIMARY KEY)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE TABLE memory.taglist "
                            "(tmpid INTEGER PRIMARY KEY, id INTEGER UNIQUE ON CONFLICT IGNORE, "
@@ -3742,6 +3848,20 @@ static void _create_memory_schema(dt_database_t *db)
   sqlite3_exec(db->handle,
       "CREATE TABLE memory.film_folder (id INTEGER PRIMARY KEY, status INTEGER)",
       NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TABLE memory.near_duplicates (imgid INTEGER PRIMARY KEY, grp INTEGER)",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TABLE memory.removed_images (imgid INTEGER PRIMARY KEY)",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TABLE memory.compress_images (imgid INTEGER PRIMARY KEY, history_end INTEGER,"
+      " manager INTEGER, masks INTEGER)",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TABLE memory.compress_renum (imgid INTEGER, num INTEGER, new_num INTEGER,"
+      " PRIMARY KEY (imgid, num))",
+      NULL, NULL, NULL);
   // clang-format on
 }
 
@@ -4257,6 +4377,167 @@ gchar* _get_pragma_string_val(sqlite3 *db,
   return val;
 }
 
+static inline gboolean _is_mem_db(const dt_database_t *db)
+{
+  return !g_strcmp0(db->dbfilename_data, ":memory:") || !g_strcmp0(db->dbfilename_library, ":memory:");
+}
+
+// how long a connection waits for a lock held by another one, in ms
+#define DT_DATABASE_BUSY_TIMEOUT 5000
+
+static void _init_icu(sqlite3 *handle)
+{
+#ifdef HAVE_ICU
+  // check if sqlite is already icu enabled
+  // if not enabled expected error: no such function:icu_load_collation
+  sqlite3_stmt *stmt;
+  int rc = sqlite3_prepare_v2(handle,
+                              "SELECT icu_load_collation('en_US', 'english')",
+                              -1, &stmt, NULL);
+  sqlite3_finalize(stmt);
+
+  if(rc != SQLITE_OK)
+  {
+    rc = sqlite3IcuInit(handle);
+    if(rc != SQLITE_OK)
+      dt_print(DT_DEBUG_ALWAYS, "[sqlite] init icu extension error %d", rc);
+  }
+#endif
+}
+
+// the in-memory database shared by the writer and the readers of this instance
+static void _memory_db_uri(const dt_database_t *db,
+                           char *uri,
+                           const size_t size)
+{
+  snprintf(uri, size, "file:dt_memory_%d_%p?mode=memory&cache=shared",
+           (int)getpid(), (void *)db);
+}
+
+static int64_t _file_size(const char *filename)
+{
+  GStatBuf st;
+  return g_stat(filename, &st) == 0 ? (int64_t)st.st_size : 0;
+}
+
+// scale the page cache with the size of the databases, a big library
+// gets more cache (up to 256 MiB) and, in WAL mode, is memory mapped
+static void _tune_cache(const dt_database_t *db,
+                        sqlite3 *handle)
+{
+  const char *schemas[2] = { "main", "data" };
+  const char *files[2] = { db->dbfilename_library, db->dbfilename_data };
+
+  for(int k = 0; k < 2; k++)
+  {
+    if(!g_strcmp0(files[k], ":memory:")) continue;
+
+    const int64_t size = _file_size(files[k]);
+    // negative cache sizes are in KiB
+    const int64_t cache_kb = CLAMP(size / 2 / 1024, 8 * 1024, 256 * 1024);
+    gchar *query = g_strdup_printf("PRAGMA %s.cache_size = -%" G_GINT64_FORMAT,
+                                   schemas[k], cache_kb);
+    sqlite3_exec(handle, query, NULL, NULL, NULL);
+    g_free(query);
+
+    if(db->wal)
+    {
+      const int64_t mmap_size = MIN(2 * size, (int64_t)1 << 30);
+      query = g_strdup_printf("PRAGMA %s.mmap_size = %" G_GINT64_FORMAT,
+                              schemas[k], mmap_size);
+      sqlite3_exec(handle, query, NULL, NULL, NULL);
+      g_free(query);
+    }
+    dt_print(DT_DEBUG_SQL, "[init sql] %s: %" G_GINT64_FORMAT " bytes, cache %" G_GINT64_FORMAT " KiB",
+             schemas[k], size, cache_kb);
+  }
+}
+
+// open the read-only connections handed out by dt_database_get_reader().
+// they see the same memory database as the writer and read its tables
+// without locking them.
+static void _open_readers(dt_database_t *db)
+{
+  char uri[128];
+  _memory_db_uri(db, uri, sizeof(uri));
+
+  const int wanted = CLAMP(dt_conf_get_int("database/readers"), 0, DT_DATABASE_READERS_MAX);
+  for(int i = 0; i < wanted; i++)
+  {
+    sqlite3 *handle = NULL;
+    if(sqlite3_open_v2(db->dbfilename_library, &handle,
+                       SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, NULL) != SQLITE_OK)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[init sql] could not open reader connection: %s",
+               sqlite3_errmsg(handle));
+      sqlite3_close(handle);
+      break;
+    }
+
+    gboolean ok = TRUE;
+    sqlite3_stmt *stmt;
+    if(sqlite3_prepare_v2(handle, "ATTACH DATABASE ?1 AS data", -1, &stmt, NULL) == SQLITE_OK)
+    {
+      sqlite3_bind_text(stmt, 1, db->dbfilename_data, -1, SQLITE_TRANSIENT);
+      ok = sqlite3_step(stmt) == SQLITE_DONE;
+    }
+    else
+      ok = FALSE;
+    sqlite3_finalize(stmt);
+
+    if(ok && sqlite3_prepare_v2(handle, "ATTACH DATABASE ?1 AS memory", -1, &stmt, NULL) == SQLITE_OK)
+    {
+      sqlite3_bind_text(stmt, 1, uri, -1, SQLITE_TRANSIENT);
+      ok = sqlite3_step(stmt) == SQLITE_DONE;
+    }
+    else
+      ok = FALSE;
+    sqlite3_finalize(stmt);
+
+    if(!ok)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[init sql] could not attach databases to reader: %s",
+               sqlite3_errmsg(handle));
+      sqlite3_close(handle);
+      break;
+    }
+
+    sqlite3_exec(handle, "PRAGMA read_uncommitted = 1", NULL, NULL, NULL);
+    sqlite3_exec(handle, "PRAGMA query_only = 1", NULL, NULL, NULL);
+    sqlite3_busy_timeout(handle, DT_DATABASE_BUSY_TIMEOUT);
+    _tune_cache(db, handle);
+    _init_icu(handle);
+
+    db->readers[db->num_readers++] = handle;
+  }
+
+  dt_print(DT_DEBUG_SQL, "[init sql] WAL mode with %d reader connections", db->num_readers);
+}
+
+static void _run_rollback_hooks(const dt_database_t *db)
+{
+  sqlite3_mutex_enter(sqlite3_db_mutex(db->handle));
+  g_hook_list_invoke((GHookList *)&db->rollback_hooks, FALSE);
+  sqlite3_mutex_leave(sqlite3_db_mutex(db->handle));
+}
+
+static void _rollback_hook(void *data)
+{
+  _run_rollback_hooks((const dt_database_t *)data);
+}
+
+void dt_database_connect_rollback(const dt_database_t *db,
+                                  GHookFunc func,
+                                  gpointer data)
+{
+  sqlite3_mutex_enter(sqlite3_db_mutex(db->handle));
+  GHook *hook = g_hook_alloc((GHookList *)&db->rollback_hooks);
+  hook->func = func;
+  hook->data = data;
+  g_hook_append((GHookList *)&db->rollback_hooks, hook);
+  sqlite3_mutex_leave(sqlite3_db_mutex(db->handle));
+}
+
 dt_database_t *dt_database_init(const char *alternative,
                                 const gboolean load_data,
                                 const gboolean has_gui)
@@ -4350,6 +4631,11 @@ start:
   dt_database_t *db = g_malloc0(sizeof(dt_database_t));
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
+  dt_pthread_mutex_init(&db->stmt_lock, NULL);
+  db->stmt_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  dt_pthread_mutex_init(&db->reader_lock, NULL);
+  g_hook_list_init(&db->rollback_hooks, sizeof(GHook));
+  db->wal = dt_conf_get_bool("database/wal") && !_is_mem_db(db);
 
   dt_atomic_set_int(&_trxid, 0);
 
@@ -4387,7 +4673,9 @@ start:
 
 
   /* opening / creating database */
-  if(sqlite3_open(db->dbfilename_library, &db->handle) != SQLITE_OK)
+  if(sqlite3_open_v2(db->dbfilename_library, &db->handle,
+                     SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI,
+                     NULL) != SQLITE_OK)
   {
     dt_print(DT_DEBUG_ALWAYS, "[init] could not find database %s%s%s",
                               dbname ? " `" : "", dbname ? dbname : "", dbname ? "'!" : "");
@@ -4406,9 +4694,19 @@ start:
   }
 
   /* attach a memory database to db connection for use with temporary tables
-     used during instance life time, which is discarded on exit.
+     used during instance life time, which is discarded on exit. in WAL mode
+     it lives in a shared cache so that the reader connections see it too.
   */
-  sqlite3_exec(db->handle, "attach database ':memory:' as memory", NULL, NULL, NULL);
+  if(db->wal)
+  {
+    char uri[128];
+    _memory_db_uri(db, uri, sizeof(uri));
+    gchar *attach = g_strdup_printf("ATTACH DATABASE '%s' AS memory", uri);
+    sqlite3_exec(db->handle, attach, NULL, NULL, NULL);
+    g_free(attach);
+  }
+  else
+    sqlite3_exec(db->handle, "attach database ':memory:' as memory", NULL, NULL, NULL);
 
   // attach the data database which contains presets, styles, tags and similar things not tied to single images
   sqlite3_stmt *stmt;
@@ -4427,9 +4725,21 @@ start:
   sqlite3_finalize(stmt);
 
   // some sqlite3 config
-  sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  if(db->wal)
+  {
+    // readers never block the writer and the other way around, a crash
+    // may lose the last transactions but never corrupts the database
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = WAL", NULL, NULL, NULL);
+    sqlite3_exec(db->handle, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+    sqlite3_busy_timeout(db->handle, DT_DATABASE_BUSY_TIMEOUT);
+  }
+  else
+  {
+    sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  }
   sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
+  _tune_cache(db, db->handle);
 
   // WARNING: the foreign_keys pragma must not be used, the integrity of the
   // database rely on it.
@@ -4834,21 +5144,10 @@ start:
   // take care of potential bad data in the db.
   _sanitize_db(db);
 
-#ifdef HAVE_ICU
-  // check if sqlite is already icu enabled
-  // if not enabled expected error: no such function:icu_load_collation
-  rc = sqlite3_prepare_v2(db->handle,
-                          "SELECT icu_load_collation('en_US', 'english')",
-                          -1, &stmt, NULL);
-  sqlite3_finalize(stmt);
+  _init_icu(db->handle);
+  sqlite3_rollback_hook(db->handle, _rollback_hook, db);
 
-  if(rc != SQLITE_OK)
-  {
-    rc = sqlite3IcuInit(db->handle);
-    if(rc != SQLITE_OK)
-      dt_print(DT_DEBUG_ALWAYS, "[sqlite] init icu extension error %d", rc);
-  }
-#endif
+  if(db->wal) _open_readers(db);
 
 error:
   g_free(dbname);
@@ -4894,9 +5193,146 @@ void dt_upgrade_maker_model(const dt_database_t *db)
   sqlite3_finalize(stmt);
 }
 
+static gboolean _stmt_cache_finalize(gpointer key,
+                                     gpointer value,
+                                     gpointer user_data)
+{
+  for(GSList *l = value; l; l = g_slist_next(l))
+    sqlite3_finalize(l->data);
+  g_slist_free(value);
+  return TRUE;
+}
+
+// finalizes all idle cached statements, checked out ones are finalized
+// when they are given back
+static void _stmt_cache_flush(const dt_database_t *db)
+{
+  dt_pthread_mutex_lock((dt_pthread_mutex_t *)&db->stmt_lock);
+  g_hash_table_foreach_remove(db->stmt_cache, _stmt_cache_finalize, NULL);
+  dt_pthread_mutex_unlock((dt_pthread_mutex_t *)&db->stmt_lock);
+}
+
+sqlite3_stmt *dt_database_prepare_cached(const dt_database_t *db,
+                                         const char *sql)
+{
+  sqlite3_stmt *stmt = NULL;
+  dt_pthread_mutex_lock((dt_pthread_mutex_t *)&db->stmt_lock);
+  GSList *idle = g_hash_table_lookup(db->stmt_cache, sql);
+  if(idle)
+  {
+    stmt = idle->data;
+    g_hash_table_insert(db->stmt_cache, g_strdup(sql), g_slist_delete_link(idle, idle));
+  }
+  dt_pthread_mutex_unlock((dt_pthread_mutex_t *)&db->stmt_lock);
+
+  if(!stmt)
+  {
+    // prepared with the same checks and logging as everywhere
+    DT_DEBUG_SQLITE3_PREPARE_V2(db->handle, sql, -1, &stmt, NULL);
+  }
+  return stmt;
+}
+
+void dt_database_release_cached(const dt_database_t *db,
+                                sqlite3_stmt *stmt)
+{
+  if(!stmt) return;
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  dt_pthread_mutex_lock((dt_pthread_mutex_t *)&db->stmt_lock);
+  const char *sql = sqlite3_sql(stmt);
+  GSList *idle = g_hash_table_lookup(db->stmt_cache, sql);
+  const gboolean keep =
+    (g_hash_table_contains(db->stmt_cache, sql)
+     || g_hash_table_size(db->stmt_cache) < DT_DATABASE_STMT_CACHE_MAX)
+    && g_slist_length(idle) < DT_DATABASE_STMT_IDLE_MAX;
+  if(keep)
+    g_hash_table_insert(db->stmt_cache, g_strdup(sql), g_slist_prepend(idle, stmt));
+  dt_pthread_mutex_unlock((dt_pthread_mutex_t *)&db->stmt_lock);
+
+  if(!keep) sqlite3_finalize(stmt);
+}
+
+// sql texts already explained for '-d sqlplan' and how many had full scans
+static GMutex _explain_lock;
+static GHashTable *_explained = NULL;
+static int _explained_scans = 0;
+
+void dt_database_explain_query(sqlite3 *handle,
+                               const char *sql,
+                               const char *file,
+                               const int line,
+                               const char *function)
+{
+  if(!sql || !g_ascii_strncasecmp(sql, "EXPLAIN", 7)) return;
+
+  g_mutex_lock(&_explain_lock);
+  if(!_explained)
+    _explained = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  const gboolean seen = !g_hash_table_add(_explained, g_strdup(sql));
+  g_mutex_unlock(&_explain_lock);
+  if(seen) return;
+
+  gchar *query = g_strdup_printf("EXPLAIN QUERY PLAN %s", sql);
+  sqlite3_stmt *stmt = NULL;
+  // not through DT_DEBUG_SQLITE3_PREPARE_V2, we'd explain the explanation
+  if(sqlite3_prepare_v2(handle, query, -1, &stmt, NULL) == SQLITE_OK)
+  {
+    gchar *scans = NULL;
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      // columns are id, parent, notused and detail
+      const char *detail = (const char *)sqlite3_column_text(stmt, 3);
+      // "SCAN images" or "SCAN TABLE images" before sqlite 3.36, an index
+      // used for the scan or a constant row is fine
+      if(detail
+         && g_str_has_prefix(detail, "SCAN ")
+         && !strstr(detail, " USING ")
+         && !strstr(detail, "CONSTANT ROW"))
+        dt_util_str_cat(&scans, "%s%s", scans ? ", " : "", detail);
+    }
+    if(scans)
+    {
+      g_mutex_lock(&_explain_lock);
+      _explained_scans++;
+      g_mutex_unlock(&_explain_lock);
+      dt_print(DT_DEBUG_SQL_PLAN, "[sql plan] %s:%d, function %s(): %s in \"%s\"",
+               file, line, function, scans, sql);
+    }
+    g_free(scans);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+}
+
+static void _explain_summary(void)
+{
+  g_mutex_lock(&_explain_lock);
+  if(_explained)
+  {
+    dt_print(DT_DEBUG_SQL_PLAN, "[sql plan] %u distinct statements explained, %d with full scans",
+             g_hash_table_size(_explained), _explained_scans);
+    g_hash_table_destroy(_explained);
+    _explained = NULL;
+    _explained_scans = 0;
+  }
+  g_mutex_unlock(&_explain_lock);
+}
+
 void dt_database_destroy(const dt_database_t *db)
 {
+  _explain_summary();
+  _stmt_cache_flush(db);
+  g_hash_table_destroy(db->stmt_cache);
+  dt_pthread_mutex_destroy((dt_pthread_mutex_t *)&db->stmt_lock);
+  // the readers go first, the last connection closed checkpoints the WAL
+  for(int i = 0; i < db->num_readers; i++)
+    sqlite3_close(db->readers[i]);
+  dt_pthread_mutex_destroy((dt_pthread_mutex_t *)&db->reader_lock);
   sqlite3_close(db->handle);
+  g_hook_list_clear((GHookList *)&db->rollback_hooks);
   if(db->lockfile_data)
   {
     g_unlink(db->lockfile_data);
@@ -4919,6 +5355,48 @@ sqlite3 *dt_database_get(const dt_database_t *db)
   return db ? db->handle : NULL;
 }
 
+sqlite3 *dt_database_get_reader(const dt_database_t *db)
+{
+  if(!db) return NULL;
+
+  // inside a transaction the writer must see its own changes
+  if(!db->num_readers || dt_atomic_get_int(&_trxid) > 0)
+    return db->handle;
+
+  dt_database_t *dbw = (dt_database_t *)db;
+  sqlite3 *handle = db->handle;
+  dt_pthread_mutex_lock(&dbw->reader_lock);
+  for(int i = 0; i < db->num_readers; i++)
+  {
+    if(!db->reader_busy[i])
+    {
+      dbw->reader_busy[i] = TRUE;
+      handle = db->readers[i];
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&dbw->reader_lock);
+  return handle;
+}
+
+void dt_database_release_reader(const dt_database_t *db,
+                                sqlite3 *handle)
+{
+  if(!db || handle == db->handle) return;
+
+  dt_database_t *dbw = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&dbw->reader_lock);
+  for(int i = 0; i < db->num_readers; i++)
+  {
+    if(db->readers[i] == handle)
+    {
+      dbw->reader_busy[i] = FALSE;
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&dbw->reader_lock);
+}
+
 const gchar *dt_database_get_path(const dt_database_t *db)
 {
   return db->dbfilename_library;
@@ -4981,6 +5459,9 @@ gboolean dt_database_get_lock_acquired(const dt_database_t *db)
 
 void dt_database_cleanup_busy_statements(const dt_database_t *db)
 {
+  // the cached statements are idle, not leaked
+  _stmt_cache_flush(db);
+
   sqlite3_stmt *stmt = NULL;
   while( (stmt = sqlite3_next_stmt(db->handle, NULL)) != NULL)
   {
@@ -5000,10 +5481,29 @@ void dt_database_cleanup_busy_statements(const dt_database_t *db)
 
 #define ERRCHECK {if(err!=NULL) {dt_print(DT_DEBUG_SQL, "[db maintenance] maintenance error: '%s'",err); sqlite3_free(err); err=NULL;}}
 
+// both databases give their free pages back with PRAGMA incremental_vacuum
+static gboolean _database_is_incremental(const dt_database_t *db)
+{
+  return _get_pragma_int_val(db->handle, "main.auto_vacuum") == 2
+    && _get_pragma_int_val(db->handle, "data.auto_vacuum") == 2;
+}
+
 void dt_database_perform_maintenance(const dt_database_t *db)
 {
   char* err = NULL;
 
+  if(_database_is_incremental(db))
+  {
+    // the free pages left by the background maintenance, no full rewrite.
+    // dt_database_optimize() follows at close and analyzes what needs it.
+    DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA main.incremental_vacuum", NULL, NULL, &err);
+    ERRCHECK
+    DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA data.incremental_vacuum", NULL, NULL, &err);
+    ERRCHECK
+    dt_print(DT_DEBUG_SQL, "[db maintenance] incremental maintenance done");
+    return;
+  }
+
   const int main_pre_free_count = _get_pragma_int_val(db->handle, "main.freelist_count");
   const int main_page_size = _get_pragma_int_val(db->handle, "main.page_size");
   const int data_pre_free_count = _get_pragma_int_val(db->handle, "data.freelist_count");
@@ -5024,6 +5524,12 @@ void dt_database_perform_maintenance(const dt_database_t *db)
     return;
   }
 
+  // this full vacuum also switches the databases to incremental vacuuming,
+  // later maintenance is done in the background, see dt_database_start_idle_tasks()
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA data.auto_vacuum = INCREMENTAL", NULL, NULL, &err);
+  ERRCHECK
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA main.auto_vacuum = INCREMENTAL", NULL, NULL, &err);
+  ERRCHECK
   DT_DEBUG_SQLITE3_EXEC(db->handle, "VACUUM data", NULL, NULL, &err);
   ERRCHECK
   DT_DEBUG_SQLITE3_EXEC(db->handle, "VACUUM main", NULL, NULL, &err);
@@ -5058,11 +5564,6 @@ void dt_database_perform_maintenance(const dt_database_t *db)
 }
 #undef ERRCHECK
 
-static inline gboolean _is_mem_db(const dt_database_t *db)
-{
-  return !g_strcmp0(db->dbfilename_data, ":memory:") || !g_strcmp0(db->dbfilename_library, ":memory:");
-}
-
 gboolean dt_database_maybe_maintenance(const dt_database_t *db)
 {
   if(_is_mem_db(db))
@@ -5129,7 +5630,8 @@ static int _backup_db(
   sqlite3 *src_db,            // Database handle to back up
   const char *src_db_name,    // Database name to back up
   const char *dest_filename,  // Name of file to back up to
-  void(*xProgress)(int, int)  // Progress function to invoke
+  void(*xProgress)(int, int), // Progress function to invoke
+  gboolean(*keep_going)(void) // Checked between the steps, NULL to always finish
 )
 {
   sqlite3 *dest_db;           // Database connection opened on dest_filename
@@ -5150,6 +5652,12 @@ static int _backup_db(
       const int pc = MIN(spc, MAX(5,spc/100));
       do
       {
+        if(keep_going && !keep_going())
+        {
+          dt_print(DT_DEBUG_SQL, "[db backup] %s interrupted", src_db_name);
+          rc = SQLITE_INTERRUPT;
+          break;
+        }
         rc = sqlite3_backup_step(sb_dest, pc);
         if(xProgress)
           xProgress(
@@ -5166,7 +5674,8 @@ static int _backup_db(
       // Release resources allocated by backup_init()
       (void)sqlite3_backup_finish(sb_dest);
     }
-    rc = sqlite3_errcode(dest_db);
+    if(rc != SQLITE_INTERRUPT)
+      rc = sqlite3_errcode(dest_db);
   }
   // Close the database connection opened on database file dest_filename
   // and return the result of this function
@@ -5174,11 +5683,10 @@ static int _backup_db(
   return rc;
 }
 
-gboolean dt_database_snapshot(const dt_database_t *db)
+static gboolean _database_snapshot(const dt_database_t *db,
+                                   sqlite3 *handle,
+                                   gboolean(*keep_going)(void))
 {
-  // backing up memory db is pointelss
-  if(_is_mem_db(db))
-    return FALSE;
   GDateTime *date_now = g_date_time_new_now_local();
   gchar *date_suffix = g_date_time_format(date_now, "%Y%m%d%H%M%S");
   g_date_time_unref(date_now);
@@ -5189,7 +5697,7 @@ gboolean dt_database_snapshot(const dt_database_t *db)
   gchar *lib_backup_file = g_strdup_printf(file_pattern, db->dbfilename_library, date_suffix);
   gchar *lib_tmpbackup_file = g_strdup_printf(temp_pattern, db->dbfilename_library, date_suffix);
 
-  int rc = _backup_db(db->handle, "main", lib_tmpbackup_file, _print_backup_progress);
+  int rc = _backup_db(handle, "main", lib_tmpbackup_file, _print_backup_progress, keep_going);
   if(rc != SQLITE_OK)
   {
     g_unlink(lib_tmpbackup_file);
@@ -5207,7 +5715,7 @@ gboolean dt_database_snapshot(const dt_database_t *db)
 
   g_free(date_suffix);
 
-  rc = _backup_db(db->handle, "data", dat_tmpbackup_file, _print_backup_progress);
+  rc = _backup_db(handle, "data", dat_tmpbackup_file, _print_backup_progress, keep_going);
   if(rc != SQLITE_OK)
   {
     g_unlink(dat_tmpbackup_file);
@@ -5222,6 +5730,14 @@ gboolean dt_database_snapshot(const dt_database_t *db)
   return TRUE;
 }
 
+gboolean dt_database_snapshot(const dt_database_t *db)
+{
+  // backing up memory db is pointelss
+  if(_is_mem_db(db))
+    return FALSE;
+  return _database_snapshot(db, db->handle, NULL);
+}
+
 gboolean dt_database_maybe_snapshot(const dt_database_t *db)
 {
   if(_is_mem_db(db))
@@ -5433,6 +5949,147 @@ static gint _db_snap_sort(gconstpointer a, gconstpointer b, gpointer user_data)
   return ret;
 }
 
+// snapshots and maintenance while darktable runs. every DT_DATABASE_IDLE_CHECK
+// seconds the library is checked for changes, once it has been quiet for two
+// checks in a row a background job makes the due snapshot or gives free pages
+// back, a few at a time for as long as the library stays quiet.
+#define DT_DATABASE_IDLE_CHECK 30
+#define DT_DATABASE_VACUUM_PAGES 256
+
+static struct
+{
+  const dt_database_t *db;
+  int changes;             // sqlite3_total_changes() at the last check
+  int quiet;               // checks in a row without changes
+  dt_atomic_int running;   // the job is queued or running
+  gboolean snapshot_done;
+  gboolean optimized;
+} _idle;
+
+static gboolean _database_idle_keep_going(void)
+{
+  return dt_control_running();
+}
+
+// nothing written since the last check and no transaction open
+static gboolean _database_idle_quiet(void)
+{
+  return dt_control_running()
+    && dt_atomic_get_int(&_trxid) == 0
+    && sqlite3_total_changes(_idle.db->handle) == _idle.changes;
+}
+
+static void _database_idle_snapshot(const dt_database_t *db)
+{
+  // made at close by choice, or not at all
+  if(dt_conf_is_equal("database/create_snapshot", "on close")
+     || !dt_database_maybe_snapshot(db))
+  {
+    _idle.snapshot_done = TRUE;
+    return;
+  }
+
+  char **snaps_to_remove = dt_database_snaps_to_remove(db);
+
+  // with write-ahead logging a reader copies a consistent state without
+  // holding up the writer, otherwise the writer is copied a bit at a time
+  sqlite3 *handle = dt_database_get_reader(db);
+  dt_times_t start;
+  dt_get_perf_times(&start);
+  const gboolean done = _database_snapshot(db, handle, _database_idle_keep_going);
+  dt_database_release_reader(db, handle);
+  dt_show_times(&start, "[db backup] background snapshot");
+
+  for(int i = 0; done && snaps_to_remove && snaps_to_remove[i]; i++)
+  {
+    // make file to remove writable, mostly problem on windows.
+    g_chmod(snaps_to_remove[i],
+            S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+    dt_print(DT_DEBUG_SQL, "[db backup] removing old snap: %s", snaps_to_remove[i]);
+    g_remove(snaps_to_remove[i]);
+  }
+  g_strfreev(snaps_to_remove);
+
+  // an interrupted one is tried again at the next quiet time
+  _idle.snapshot_done = done || !dt_control_running();
+}
+
+static void _database_idle_vacuum(const dt_database_t *db)
+{
+  // until the first full vacuum at close switched the databases over
+  if(!_database_is_incremental(db)) return;
+
+  static const char *schemas[] = { "main", "data" };
+  for(int k = 0; k < G_N_ELEMENTS(schemas); k++)
+  {
+    gchar *count = g_strdup_printf("%s.freelist_count", schemas[k]);
+    gchar *vacuum = g_strdup_printf("PRAGMA %s.incremental_vacuum(%d)",
+                                    schemas[k], DT_DATABASE_VACUUM_PAGES);
+    int free_pages;
+    while(_database_idle_quiet()
+          && (free_pages = _get_pragma_int_val(db->handle, count)) > 0)
+    {
+      dt_print(DT_DEBUG_SQL, "[db maintenance] %s: %d free pages", schemas[k], free_pages);
+      if(sqlite3_exec(db->handle, vacuum, NULL, NULL, NULL) != SQLITE_OK) break;
+    }
+    g_free(vacuum);
+    g_free(count);
+  }
+}
+
+static int32_t _database_idle_job_run(dt_job_t *job)
+{
+  const dt_database_t *db = _idle.db;
+
+  if(!_idle.snapshot_done)
+    _database_idle_snapshot(db);
+
+  if(_database_idle_quiet() && dt_database_maybe_maintenance(db))
+    _database_idle_vacuum(db);
+
+  if(!_idle.optimized && _database_idle_quiet())
+  {
+    DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA optimize", NULL, NULL, NULL);
+    _idle.optimized = TRUE;
+  }
+
+  // our own writes don't count as activity
+  _idle.changes = sqlite3_total_changes(db->handle);
+  dt_atomic_set_int(&_idle.running, FALSE);
+  return 0;
+}
+
+static gboolean _database_idle_check(gpointer user_data)
+{
+  if(!dt_control_running()) return G_SOURCE_REMOVE;
+  if(dt_atomic_get_int(&_idle.running)) return G_SOURCE_CONTINUE;
+
+  const int changes = sqlite3_total_changes(_idle.db->handle);
+  _idle.quiet = changes == _idle.changes ? _idle.quiet + 1 : 0;
+  _idle.changes = changes;
+
+  if(_idle.quiet >= 2)
+  {
+    dt_job_t *job = dt_control_job_create(&_database_idle_job_run, "database maintenance");
+    if(job)
+    {
+      dt_atomic_set_int(&_idle.running, TRUE);
+      _idle.quiet = 0;
+      dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG, job);
+    }
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+void dt_database_start_idle_tasks(const dt_database_t *db)
+{
+  if(_is_mem_db(db)) return;
+
+  _idle.db = db;
+  _idle.changes = sqlite3_total_changes(db->handle);
+  g_timeout_add_seconds(DT_DATABASE_IDLE_CHECK, _database_idle_check, NULL);
+}
+
 char **dt_database_snaps_to_remove(const dt_database_t *db)
 {
   if(_is_mem_db(db))
@@ -5918,6 +6575,8 @@ void dt_database_rollback_transaction(const dt_database_t *db)
     char SQLTRX[64] = { 0 };
     g_snprintf(SQLTRX, sizeof(SQLTRX), "ROLLBACK TRANSACTION TO SAVEPOINT trx%d", trxid - 1);
     DT_DEBUG_SQLITE3_EXEC(dt_database_get(db), SQLTRX, NULL, NULL, NULL);
+    // sqlite doesn't call the rollback hook for savepoints
+    _run_rollback_hooks(db);
   }
 #else
   {
@@ -24,6 +24,7 @@
 G_BEGIN_DECLS
 
 struct dt_database_t;
+struct sqlite3_stmt;
 
 /** allocates and initializes database */
 struct dt_database_t *dt_database_init(const char *alternative,
@@ -33,6 +34,13 @@ struct dt_database_t *dt_database_init(const char *alternative,
 void dt_database_destroy(const struct dt_database_t *);
 /** get handle */
 struct sqlite3 *dt_database_get(const struct dt_database_t *);
+/** get a read-only connection for queries, in WAL mode and outside of a
+    transaction. it doesn't see uncommitted changes of the main handle,
+    which is returned instead when no reader is free. give it back with
+    dt_database_release_reader(). */
+struct sqlite3 *dt_database_get_reader(const struct dt_database_t *db);
+void dt_database_release_reader(const struct dt_database_t *db,
+                                struct sqlite3 *handle);
 /** Returns database path */
 const gchar *dt_database_get_path(const struct dt_database_t *db);
 /** test if database was already locked by another instance */
@@ -51,12 +59,39 @@ void dt_database_cleanup_busy_statements(const struct dt_database_t *db);
 gboolean dt_database_snapshot(const struct dt_database_t *db);
 /** check if creating database snapshot is recommended */
 gboolean dt_database_maybe_snapshot(const struct dt_database_t *db);
+/** make the due snapshot and the maintenance in the background whenever
+    the library is left alone for a while */
+void dt_database_start_idle_tasks(const struct dt_database_t *db);
 /** get list of snapshot files to remove after successful snapshot */
 char **dt_database_snaps_to_remove(const struct dt_database_t *db);
 /** get possibly the freshest snapshot to restore */
 gchar *dt_database_get_most_recent_snap(const char* db_filename);
 
 int32_t dt_database_last_insert_rowid(const struct dt_database_t *);
+
+/** returns a prepared statement for the constant sql text, reusing an idle one
+    prepared before. it is checked out to the caller until given back with
+    dt_database_release_cached(), which also resets it and clears the bindings.
+    only meant for sql issued over and over again, not for generated queries. */
+struct sqlite3_stmt *dt_database_prepare_cached(const struct dt_database_t *db,
+                                                const char *sql);
+void dt_database_release_cached(const struct dt_database_t *db,
+                                struct sqlite3_stmt *stmt);
+
+/** runs EXPLAIN QUERY PLAN on sql, the first time this text is seen, and reports
+    full table scans. used by DT_DEBUG_SQLITE3_PREPARE_V2 with '-d sqlplan'. */
+void dt_database_explain_query(struct sqlite3 *handle,
+                               const char *sql,
+                               const char *file,
+                               const int line,
+                               const char *function);
+
+/** calls func(data) after the main handle rolled back a transaction or a
+    savepoint, for the in-memory copies kept up to date by triggers */
+void dt_database_connect_rollback(const struct dt_database_t *db,
+                                  GHookFunc func,
+                                  gpointer data);
+
 // nested transactions support
 
 void dt_database_start_transaction(const struct dt_database_t *db);
@@ -21,6 +21,8 @@
 
 #include <exception>
 #include <math.h>
+#include <memory>
+#include <mutex>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -31,24 +33,24 @@
 #include "iop/Permutohedral.h"
 
 
-// one mean-field iteration: re-splat the foreground probability + a
-// normalisation channel via cached replay, blur, slice and normalise
+// one mean-field iteration: splat the foreground probability + a
+// normalisation channel into the prepared lattice, blur, slice and normalise
 template <int D>
 static void _mf_filter(PermutohedralLattice<D, 2> &lattice,
                        const float *const __restrict__ probs,
+                       float *const __restrict__ values,
                        float *const __restrict__ out,
                        const int npixels)
 {
-  lattice.clearValues();
-
-  // splat is sequential — multiple pixels can map to the same lattice
-  // vertex, parallel writes would race
+  DT_OMP_FOR()
   for(int i = 0; i < npixels; i++)
   {
-    const float val[2] = { probs[i], 1.0f };
-    lattice.quickSplat(val, (size_t)i);
+    values[2 * i + 0] = probs[i];
+    values[2 * i + 1] = 1.0f;
   }
 
+  // each vertex gathers what its pixels contribute, no races
+  lattice.gatherSplat(values);
   lattice.blur();
 
   DT_OMP_FOR(shared(lattice))
@@ -84,18 +86,29 @@ static void _initial_splat(PermutohedralLattice<D, 2> &lattice,
 }
 
 
-template <int D>
-static void _slice_normalize(PermutohedralLattice<D, 2> &lattice,
-                             float *const __restrict__ out,
-                             const int npixels)
+// the lattices only depend on the guide image and the feature scales,
+// refining several masks on the same image builds them once
+struct _crf_lattices_t
 {
-  DT_OMP_FOR(shared(lattice))
-  for(int i = 0; i < npixels; i++)
-  {
-    float val[2];
-    lattice.slice(val, (size_t)i);
-    out[i] = (val[1] > 1e-10f) ? (val[0] / val[1]) : 0.0f;
-  }
+  dt_hash_t key;
+  std::unique_ptr<PermutohedralLattice<2, 2>> spatial;
+  std::unique_ptr<PermutohedralLattice<5, 2>> bilateral;
+};
+
+static std::mutex _crf_cache_lock;
+static std::unique_ptr<_crf_lattices_t> _crf_cache;
+
+static dt_hash_t _crf_key(const unsigned char *rgb,
+                          const int width,
+                          const int height,
+                          const float sigma_spatial,
+                          const float sigma_rgb)
+{
+  dt_hash_t key = dt_hash(DT_INITHASH, &width, sizeof(width));
+  key = dt_hash(key, &height, sizeof(height));
+  key = dt_hash(key, &sigma_spatial, sizeof(sigma_spatial));
+  key = dt_hash(key, &sigma_rgb, sizeof(sigma_rgb));
+  return dt_hash(key, rgb, (size_t)width * height * 3);
 }
 
 
@@ -119,51 +132,27 @@ extern "C" void dt_dense_crf_binary(float *probabilities,
   const float inv_sigma_s = 1.0f / sigma_spatial;
   const float inv_sigma_c = 1.0f / sigma_rgb;
 
-  float *__restrict__ spatial_features
-    = (float *)dt_alloc_aligned((size_t)n * 2 * sizeof(float));
-  float *__restrict__ bilateral_features
-    = (float *)dt_alloc_aligned((size_t)n * 5 * sizeof(float));
   float *const __restrict__ unary
     = (float *)dt_alloc_aligned((size_t)n * sizeof(float));
+  float *const __restrict__ values
+    = (float *)dt_alloc_aligned((size_t)n * 2 * sizeof(float));
   float *const __restrict__ msg_spatial
     = (float *)dt_alloc_aligned((size_t)n * sizeof(float));
   float *const __restrict__ msg_bilateral
     = (float *)dt_alloc_aligned((size_t)n * sizeof(float));
 
-  if(!spatial_features || !bilateral_features
-     || !unary || !msg_spatial || !msg_bilateral)
+  if(!unary || !values || !msg_spatial || !msg_bilateral)
   {
     dt_print(DT_DEBUG_ALWAYS,
              "[densecrf] failed to allocate scratch buffers for %dx%d",
              width, height);
-    dt_free_align(spatial_features);
-    dt_free_align(bilateral_features);
     dt_free_align(unary);
+    dt_free_align(values);
     dt_free_align(msg_spatial);
     dt_free_align(msg_bilateral);
     return;
   }
 
-  // features pre-scaled by 1/sigma so the lattice's implicit Gaussian
-  // has unit standard deviation in feature space
-  DT_OMP_FOR(collapse(2))
-  for(int y = 0; y < height; y++)
-  {
-    for(int x = 0; x < width; x++)
-    {
-      const int i = y * width + x;
-      const float xs = (float)x * inv_sigma_s;
-      const float ys = (float)y * inv_sigma_s;
-      spatial_features[i * 2 + 0] = xs;
-      spatial_features[i * 2 + 1] = ys;
-      bilateral_features[i * 5 + 0] = xs;
-      bilateral_features[i * 5 + 1] = ys;
-      bilateral_features[i * 5 + 2] = (float)rgb[i * 3 + 0] * inv_sigma_c;
-      bilateral_features[i * 5 + 3] = (float)rgb[i * 3 + 1] * inv_sigma_c;
-      bilateral_features[i * 5 + 4] = (float)rgb[i * 3 + 2] * inv_sigma_c;
-    }
-  }
-
   DT_OMP_FOR()
   for(int i = 0; i < n; i++)
   {
@@ -171,47 +160,96 @@ extern "C" void dt_dense_crf_binary(float *probabilities,
     unary[i] = logf(p / (1.0f - p));
   }
 
-  const size_t n_threads = (size_t)dt_get_num_threads();
-  // hash-table sizing hint — cap so small sigmas can't request GBs;
-  // the lattice re-grows as needed if we under-estimate
-  const size_t MAX_GRID_HINT = (size_t)1 << 24;  // ~16M buckets
-  size_t spatial_grid = (size_t)((float)height * inv_sigma_s
-                                 * (float)width * inv_sigma_s);
-  size_t bilateral_grid = (size_t)((float)height * inv_sigma_s
-                                   * (float)width * inv_sigma_s
-                                   * inv_sigma_c * inv_sigma_c * inv_sigma_c
-                                   * 256.0f * 256.0f * 256.0f);
-  if(spatial_grid > MAX_GRID_HINT)   spatial_grid   = MAX_GRID_HINT;
-  if(bilateral_grid > MAX_GRID_HINT) bilateral_grid = MAX_GRID_HINT;
+  // take the lattices of the last guide image if they fit, a concurrent
+  // refinement builds its own
+  const dt_hash_t key = _crf_key(rgb, width, height, sigma_spatial, sigma_rgb);
+  std::unique_ptr<_crf_lattices_t> lattices;
+  {
+    std::lock_guard<std::mutex> lock(_crf_cache_lock);
+    if(_crf_cache && _crf_cache->key == key) lattices = std::move(_crf_cache);
+  }
 
   // Permutohedral lattices use `new` internally and can throw std::bad_alloc
   // on OOM; catch here so the exception never crosses the C boundary
   try
   {
-    PermutohedralLattice<2, 2> spatial(n, n_threads, spatial_grid);
-    PermutohedralLattice<5, 2> bilateral(n, n_threads, bilateral_grid);
+    if(lattices)
+      dt_print(DT_DEBUG_PERF, "[densecrf] reusing the lattices for %dx%d", width, height);
+    else
+    {
+      float *__restrict__ spatial_features
+        = (float *)dt_alloc_aligned((size_t)n * 2 * sizeof(float));
+      float *__restrict__ bilateral_features
+        = (float *)dt_alloc_aligned((size_t)n * 5 * sizeof(float));
+      if(!spatial_features || !bilateral_features)
+      {
+        dt_free_align(spatial_features);
+        dt_free_align(bilateral_features);
+        throw std::bad_alloc();
+      }
 
-    _initial_splat(spatial, spatial_features, probabilities, n);
-    _initial_splat(bilateral, bilateral_features, probabilities, n);
+      // features pre-scaled by 1/sigma so the lattice's implicit Gaussian
+      // has unit standard deviation in feature space
+      DT_OMP_FOR(collapse(2))
+      for(int y = 0; y < height; y++)
+      {
+        for(int x = 0; x < width; x++)
+        {
+          const int i = y * width + x;
+          const float xs = (float)x * inv_sigma_s;
+          const float ys = (float)y * inv_sigma_s;
+          spatial_features[i * 2 + 0] = xs;
+          spatial_features[i * 2 + 1] = ys;
+          bilateral_features[i * 5 + 0] = xs;
+          bilateral_features[i * 5 + 1] = ys;
+          bilateral_features[i * 5 + 2] = (float)rgb[i * 3 + 0] * inv_sigma_c;
+          bilateral_features[i * 5 + 3] = (float)rgb[i * 3 + 1] * inv_sigma_c;
+          bilateral_features[i * 5 + 4] = (float)rgb[i * 3 + 2] * inv_sigma_c;
+        }
+      }
 
-    dt_free_align(spatial_features);   spatial_features = NULL;
-    dt_free_align(bilateral_features); bilateral_features = NULL;
+      const size_t n_threads = (size_t)dt_get_num_threads();
+      // hash-table sizing hint — cap so small sigmas can't request GBs;
+      // the lattice re-grows as needed if we under-estimate
+      const size_t MAX_GRID_HINT = (size_t)1 << 24;  // ~16M buckets
+      size_t spatial_grid = (size_t)((float)height * inv_sigma_s
+                                     * (float)width * inv_sigma_s);
+      size_t bilateral_grid = (size_t)((float)height * inv_sigma_s
+                                       * (float)width * inv_sigma_s
+                                       * inv_sigma_c * inv_sigma_c * inv_sigma_c
+                                       * 256.0f * 256.0f * 256.0f);
+      if(spatial_grid > MAX_GRID_HINT)   spatial_grid   = MAX_GRID_HINT;
+      if(bilateral_grid > MAX_GRID_HINT) bilateral_grid = MAX_GRID_HINT;
 
-    for(int iter = 0; iter < n_iterations; iter++)
-    {
-      if(iter == 0)
+      lattices.reset(new _crf_lattices_t);
+      lattices->key = key;
+      try
       {
-        // iter 0: lattices have initial splat values, just blur+slice
-        spatial.blur();
-        bilateral.blur();
-        _slice_normalize(spatial, msg_spatial, n);
-        _slice_normalize(bilateral, msg_bilateral, n);
+        lattices->spatial.reset(new PermutohedralLattice<2, 2>(n, n_threads, spatial_grid));
+        lattices->bilateral.reset(new PermutohedralLattice<5, 2>(n, n_threads, bilateral_grid));
+
+        // the multi-threaded splat builds the lattice topology, the
+        // values are replaced by the first gatherSplat()
+        _initial_splat(*lattices->spatial, spatial_features, probabilities, n);
+        _initial_splat(*lattices->bilateral, bilateral_features, probabilities, n);
       }
-      else
+      catch(...)
       {
-        _mf_filter(spatial, probabilities, msg_spatial, n);
-        _mf_filter(bilateral, probabilities, msg_bilateral, n);
+        dt_free_align(spatial_features);
+        dt_free_align(bilateral_features);
+        throw;
       }
+      dt_free_align(spatial_features);
+      dt_free_align(bilateral_features);
+
+      lattices->spatial->prepareReuse();
+      lattices->bilateral->prepareReuse();
+    }
+
+    for(int iter = 0; iter < n_iterations; iter++)
+    {
+      _mf_filter(*lattices->spatial, probabilities, values, msg_spatial, n);
+      _mf_filter(*lattices->bilateral, probabilities, values, msg_bilateral, n);
 
       // binary Potts mean-field update:
       //   log Q(1)/Q(0) = unary_logit + Σ_k w_k · (2·filtered(p) − 1)
@@ -225,6 +263,10 @@ extern "C" void dt_dense_crf_binary(float *probabilities,
         probabilities[i] = 1.0f / (1.0f + expf(-energy));
       }
     }
+
+    // keep them for the next mask, replacing older ones
+    std::lock_guard<std::mutex> lock(_crf_cache_lock);
+    _crf_cache = std::move(lattices);
   }
   catch(const std::exception &e)
   {
@@ -235,9 +277,14 @@ extern "C" void dt_dense_crf_binary(float *probabilities,
     dt_print(DT_DEBUG_ALWAYS, "[densecrf] aborted: unknown exception");
   }
 
-  dt_free_align(spatial_features);
-  dt_free_align(bilateral_features);
   dt_free_align(unary);
+  dt_free_align(values);
   dt_free_align(msg_spatial);
   dt_free_align(msg_bilateral);
 }
+
+extern "C" void dt_dense_crf_release_cache(void)
+{
+  std::lock_guard<std::mutex> lock(_crf_cache_lock);
+  _crf_cache.reset();
+}
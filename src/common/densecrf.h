@@ -61,6 +61,14 @@ void dt_dense_crf_binary(float *probabilities,
                          float w_bilateral,
                          int n_iterations);
 
+/**
+ * @brief Free the lattices kept from the last refinement.
+ *
+ * Refining another mask with the same guide image and sigmas reuses
+ * them instead of building them again.
+ */
+void dt_dense_crf_release_cache(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -52,6 +52,7 @@
 */
 
 #include <math.h>
+#include <string.h>
 #include "common/math.h"
 #include "common/distance_transform.h"
 #include "common/imagebuf.h"
@@ -90,59 +91,78 @@ static void _image_distance_transform(const float *f,
   }
 }
 
-float dt_image_distance_transform(const float *const src,
-                                  float *const out,
-                                  const size_t width,
-                                  const size_t height,
-                                  const float clip,
-                                  const dt_distance_transform_t mode)
+// the columns are transformed in blocks: a block is copied row by row
+// into a column-major buffer, so out is read and written in cache lines
+// instead of one float per row
+#define DT_DISTANCE_TRANSFORM_BLOCK 16
+
+// a line without any seed, or only seeds, is left as it is
+static inline gboolean _line_is_flat(const float *f,
+                                     const size_t n)
 {
-  switch(mode)
-  {
-    case DT_DISTANCE_TRANSFORM_NONE:
-      break;
-    case DT_DISTANCE_TRANSFORM_MASK:
-      DT_OMP_FOR()
-      for(size_t i = 0; i < width * height; i++)
-        out[i] = (src[i] < clip) ? 0.0f : DT_DISTANCE_TRANSFORM_MAX;
-      break;
-    default:
-      dt_iop_image_fill(out, 0.0f, width, height, 1);
-      dt_print(DT_DEBUG_ALWAYS,
-               "[dt_image_distance_transform] called with unsupported mode %i", mode);
-      return 0.0f;
-  }
+  for(size_t i = 1; i < n; i++)
+    if(f[i] != f[0]) return FALSE;
+  return TRUE;
+}
 
+static float _distance_transform(float *const out,
+                                 const size_t width,
+                                 const size_t height)
+{
   const size_t maxdim = MAX(width, height);
   float max_distance = 0.0f;
   DT_OMP_PRAGMA(parallel reduction(max : max_distance)
                 dt_omp_firstprivate(out, maxdim, width, height))
   {
-    float *f = dt_alloc_align_float(maxdim);
+    float *f = dt_alloc_align_float(DT_DISTANCE_TRANSFORM_BLOCK * height);
     float *z = dt_alloc_align_float(maxdim + 1);
     float *d = dt_alloc_align_float(maxdim);
     int *v = dt_alloc_align_int(maxdim);
 
     // transform along columns
     DT_OMP_PRAGMA(for schedule (static))
-    for(size_t x = 0; x < width; x++)
+    for(size_t x0 = 0; x0 < width; x0 += DT_DISTANCE_TRANSFORM_BLOCK)
     {
+      const size_t bw = MIN(DT_DISTANCE_TRANSFORM_BLOCK, width - x0);
       for(size_t y = 0; y < height; y++)
-        f[y] = out[y*width + x];
-      _image_distance_transform(f, z, d, v, height);
+      {
+        const float *row = out + y * width + x0;
+        for(size_t c = 0; c < bw; c++)
+          f[c * height + y] = row[c];
+      }
+      for(size_t c = 0; c < bw; c++)
+      {
+        float *col = f + c * height;
+        if(_line_is_flat(col, height)) continue;
+        _image_distance_transform(col, z, d, v, height);
+        memcpy(col, d, sizeof(float) * height);
+      }
       for(size_t y = 0; y < height; y++)
-        out[y*width + x] = d[y];
+      {
+        float *row = out + y * width + x0;
+        for(size_t c = 0; c < bw; c++)
+          row[c] = f[c * height + y];
+      }
     }
     // implicit barrier :-)
     // transform along rows
     DT_OMP_PRAGMA(for schedule (static) nowait)
     for(size_t y = 0; y < height; y++)
     {
-      _image_distance_transform(&out[y*width], z, d, v, width);
+      float *row = &out[y*width];
+      if(_line_is_flat(row, width))
+      {
+        // the transform of a constant line is the line itself
+        const float val = sqrtf(row[0]);
+        for(size_t x = 0; x < width; x++) row[x] = val;
+        max_distance = fmaxf(max_distance, val);
+        continue;
+      }
+      _image_distance_transform(row, z, d, v, width);
       for(size_t x = 0; x < width; x++)
       {
         const float val = sqrtf(d[x]);
-        out[y*width + x] = val;
+        row[x] = val;
         max_distance = fmaxf(max_distance, val);
       }
     }
@@ -154,6 +174,116 @@ float dt_image_distance_transform(const float *const src,
   return max_distance;
 }
 
+static gboolean _prepare_mode(const float *const src,
+                              float *const out,
+                              const size_t width,
+                              const size_t height,
+                              const float clip,
+                              const dt_distance_transform_t mode)
+{
+  switch(mode)
+  {
+    case DT_DISTANCE_TRANSFORM_NONE:
+      return TRUE;
+    case DT_DISTANCE_TRANSFORM_MASK:
+      DT_OMP_FOR()
+      for(size_t i = 0; i < width * height; i++)
+        out[i] = (src[i] < clip) ? 0.0f : DT_DISTANCE_TRANSFORM_MAX;
+      return TRUE;
+    default:
+      dt_iop_image_fill(out, 0.0f, width, height, 1);
+      dt_print(DT_DEBUG_ALWAYS,
+               "[dt_image_distance_transform] called with unsupported mode %i", mode);
+      return FALSE;
+  }
+}
+
+float dt_image_distance_transform(const float *const src,
+                                  float *const out,
+                                  const size_t width,
+                                  const size_t height,
+                                  const float clip,
+                                  const dt_distance_transform_t mode)
+{
+  if(!_prepare_mode(src, out, width, height, clip, mode))
+    return 0.0f;
+
+  return _distance_transform(out, width, height);
+}
+
+float dt_image_distance_transform_approx(const float *const src,
+                                         float *const out,
+                                         const size_t width,
+                                         const size_t height,
+                                         const float clip,
+                                         const dt_distance_transform_t mode,
+                                         const int factor)
+{
+  if(factor <= 1 || width < (size_t)2 * factor || height < (size_t)2 * factor)
+    return dt_image_distance_transform(src, out, width, height, clip, mode);
+
+  if(!_prepare_mode(src, out, width, height, clip, mode))
+    return 0.0f;
+
+  const size_t cw = (width + factor - 1) / factor;
+  const size_t ch = (height + factor - 1) / factor;
+  float *coarse = dt_alloc_align_float(cw * ch);
+  if(!coarse)
+    return _distance_transform(out, width, height);
+
+  // a coarse cell is a seed if any of its pixels is one, so that the
+  // distances are never overestimated by more than the cell size
+  DT_OMP_FOR()
+  for(size_t cy = 0; cy < ch; cy++)
+  {
+    for(size_t cx = 0; cx < cw; cx++)
+    {
+      float val = DT_DISTANCE_TRANSFORM_MAX;
+      const size_t y1 = MIN((cy + 1) * factor, height);
+      const size_t x1 = MIN((cx + 1) * factor, width);
+      for(size_t y = cy * factor; y < y1 && val > 0.0f; y++)
+        for(size_t x = cx * factor; x < x1; x++)
+          if(out[y * width + x] == 0.0f)
+          {
+            val = 0.0f;
+            break;
+          }
+      coarse[cy * cw + cx] = val;
+    }
+  }
+
+  _distance_transform(coarse, cw, ch);
+  const float cmax_full = sqrtf(DT_DISTANCE_TRANSFORM_MAX);
+
+  // back to full size by bilinear interpolation, seed pixels stay 0
+  float max_distance = 0.0f;
+  const float scale = 1.0f / factor;
+  DT_OMP_FOR(reduction(max : max_distance))
+  for(size_t y = 0; y < height; y++)
+  {
+    const float fy = CLAMPF((y + 0.5f) * scale - 0.5f, 0.0f, ch - 1);
+    const size_t y0 = MIN((size_t)fy, ch - 2);
+    const float wy = fy - y0;
+    for(size_t x = 0; x < width; x++)
+    {
+      const size_t i = y * width + x;
+      if(out[i] == 0.0f) continue;
+      const float fx = CLAMPF((x + 0.5f) * scale - 0.5f, 0.0f, cw - 1);
+      const size_t x0 = MIN((size_t)fx, cw - 2);
+      const float wx = fx - x0;
+      const float *c = coarse + y0 * cw + x0;
+      const float top = c[0] + wx * (c[1] - c[0]);
+      const float bottom = c[cw] + wx * (c[cw + 1] - c[cw]);
+      // without any seed all of them are at the maximum already
+      const float val = fminf(factor * (top + wy * (bottom - top)), cmax_full);
+      out[i] = val;
+      max_distance = fmaxf(max_distance, val);
+    }
+  }
+  dt_free_align(coarse);
+  return max_distance;
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
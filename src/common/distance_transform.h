@@ -31,6 +31,16 @@ float dt_image_distance_transform(const float *const src,
                                   const float clip,
                                   const dt_distance_transform_t mode);
 
+// faster approximation for previews: the distances are computed at 1/factor
+// of the size and interpolated back, they are off by up to factor pixels
+float dt_image_distance_transform_approx(const float *const src,
+                                         float *const out,
+                                         const size_t width,
+                                         const size_t height,
+                                         const float clip,
+                                         const dt_distance_transform_t mode,
+                                         const int factor);
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -219,6 +219,8 @@ dt_dlopencl_t *dt_dlopencl_init(const char *name)
                                            (void (**)(void)) & ocl->symbols->dt_clEnqueueCopyBuffer);
     success = success && dt_gmodule_symbol(module, "clEnqueueMapBuffer",
                                            (void (**)(void)) & ocl->symbols->dt_clEnqueueMapBuffer);
+    success = success && dt_gmodule_symbol(module, "clEnqueueMapImage",
+                                           (void (**)(void)) & ocl->symbols->dt_clEnqueueMapImage);
     success = success && dt_gmodule_symbol(module, "clEnqueueUnmapMemObject",
                                            (void (**)(void)) & ocl->symbols->dt_clEnqueueUnmapMemObject);
     success = success && dt_gmodule_symbol(module, "clGetMemObjectInfo",
@@ -231,6 +233,12 @@ dt_dlopencl_t *dt_dlopencl_init(const char *name)
                                            ((void (**)(void)) & ocl->symbols->dt_clEnqueueFillBuffer));
     success = success && dt_gmodule_symbol(module, "clEnqueueFillImage",
                                            ((void (**)(void)) & ocl->symbols->dt_clEnqueueFillImage));
+    success = success && dt_gmodule_symbol(module, "clFlush",
+                                           ((void (**)(void)) & ocl->symbols->dt_clFlush));
+    success = success && dt_gmodule_symbol(module, "clEnqueueMarker",
+                                           ((void (**)(void)) & ocl->symbols->dt_clEnqueueMarker));
+    success = success && dt_gmodule_symbol(module, "clEnqueueWaitForEvents",
+                                           ((void (**)(void)) & ocl->symbols->dt_clEnqueueWaitForEvents));
   }
 
   ocl->have_opencl = success;
@@ -44,10 +44,106 @@ dwt_params_t *dt_dwt_init(float *image, const int width, const int height, const
   p->merge_from_scale = merge_from_scale;
   p->user_data = user_data;
   p->preview_scale = preview_scale;
+  p->cache = NULL;
 
   return p;
 }
 
+void dt_dwt_set_cache(dwt_params_t *p, dwt_cache_t *cache)
+{
+  p->cache = cache;
+}
+
+void dt_dwt_cache_free(dwt_cache_t *cache)
+{
+  if(!cache) return;
+
+  for(int k = 0; k < DT_DWT_CACHE_LAYERS; k++)
+    dt_free_align(cache->layers[k]);
+  memset(cache, 0, sizeof(dwt_cache_t));
+}
+
+// hash of the image to decompose, rows are hashed in parallel on 32 bit words.
+// this is a single pass over the image against two or more for each scale.
+static uint64_t _dwt_cache_hash(const float *const img, const dwt_params_t *const p)
+{
+  const size_t rowsize = (size_t)4 * p->width;
+  uint64_t *rows = dt_alloc_align_type(uint64_t, p->height);
+  if(!rows) return DT_INVALID_HASH;
+
+  DT_OMP_FOR()
+  for(int row = 0; row < p->height; row++)
+  {
+    const uint32_t *const words = (const uint32_t *)(img + rowsize * row);
+    uint64_t h = 14695981039346656037lu;
+    for(size_t k = 0; k < rowsize; k++)
+      h = (h ^ words[k]) * 1099511628211lu;
+    rows[row] = h;
+  }
+
+  const int dims[3] = { p->width, p->height, p->scales };
+  dt_hash_t hash = dt_hash(DT_INITHASH, dims, sizeof(dims));
+  hash = dt_hash(hash, rows, sizeof(uint64_t) * p->height);
+  dt_free_align(rows);
+
+  return hash == DT_INVALID_HASH ? 1 : hash;
+}
+
+// can the cached decomposition serve a request for these scales?
+static gboolean _dwt_cache_valid(const dwt_cache_t *const c,
+                                 const dwt_params_t *const p,
+                                 const uint64_t hash)
+{
+  if(!c || hash == DT_INVALID_HASH || c->hash != hash
+     || c->width != p->width || c->height != p->height || c->scales != p->scales)
+    return FALSE;
+
+  // a preview of a single scale stops decomposing once it is reached
+  const gboolean single = p->return_layer > 0 && p->return_layer <= p->scales;
+  return single
+    ? c->num_details >= p->return_layer
+    : c->num_details == p->scales && c->has_residual;
+}
+
+// start filling the cache for a new image if it fits in our memory budget
+static gboolean _dwt_cache_reset(dwt_cache_t *const c,
+                                 const dwt_params_t *const p,
+                                 const uint64_t hash)
+{
+  dt_dwt_cache_free(c);
+
+  const size_t layer_size = sizeof(float) * 4 * p->width * p->height;
+  if(hash == DT_INVALID_HASH
+     || p->scales + 1 > DT_DWT_CACHE_LAYERS
+     || layer_size * (p->scales + 1) > dt_get_available_mem() / 8)
+    return FALSE;
+
+  c->hash = hash;
+  c->width = p->width;
+  c->height = p->height;
+  c->scales = p->scales;
+  return TRUE;
+}
+
+static void _dwt_cache_store(dwt_cache_t *const c,
+                             const int layer,
+                             const float *const buf,
+                             const dwt_params_t *const p)
+{
+  c->layers[layer] = dt_alloc_align_float((size_t)4 * p->width * p->height);
+  if(!c->layers[layer])
+  {
+    // what is stored so far can still serve single scale previews
+    if(c->num_details == 0) c->hash = DT_INVALID_HASH;
+    return;
+  }
+  dt_iop_image_copy_by_size(c->layers[layer], buf, p->width, p->height, 4);
+  if(layer < p->scales)
+    c->num_details = layer + 1;
+  else
+    c->has_residual = TRUE;
+}
+
 void dt_dwt_free(dwt_params_t *p)
 {
   if(!p) return;
@@ -256,6 +352,13 @@ static void dwt_wavelet_decompose(float *img,
     return;
   }
 
+  // the forward transform of this very image may be cached already, else
+  // the scales are stored as they are computed and before layer_func()
+  // modifies them
+  const uint64_t hash = p->cache ? _dwt_cache_hash(img, p) : DT_INVALID_HASH;
+  const gboolean from_cache = _dwt_cache_valid(p->cache, p, hash);
+  gboolean to_cache = !from_cache && p->cache && _dwt_cache_reset(p->cache, p, hash);
+
   // iterate over wavelet scales
   unsigned int hpass = 0;
   int bcontinue = 1;
@@ -263,7 +366,16 @@ static void dwt_wavelet_decompose(float *img,
   {
     unsigned int lpass = (1 - (lev & 1));
 
-    dwt_decompose_layer(buffer[lpass], buffer[hpass], temp, padded_size, lev, p);
+    if(from_cache)
+      dt_iop_image_copy_by_size(buffer[hpass], p->cache->layers[lev], p->width, p->height, p->ch);
+    else
+      dwt_decompose_layer(buffer[lpass], buffer[hpass], temp, padded_size, lev, p);
+
+    if(to_cache)
+    {
+      _dwt_cache_store(p->cache, lev, buffer[hpass], p);
+      to_cache = p->cache->num_details == lev + 1;
+    }
 
     // no merge scales or we didn't reach the merge scale from yet
     if(p->merge_from_scale == 0 || p->merge_from_scale > lev + 1)
@@ -311,6 +423,12 @@ static void dwt_wavelet_decompose(float *img,
   // all scales have been processed
   if(bcontinue)
   {
+    if(from_cache)
+      dt_iop_image_copy_by_size(buffer[hpass], p->cache->layers[p->scales],
+                                p->width, p->height, p->ch);
+    else if(to_cache)
+      _dwt_cache_store(p->cache, p->scales, buffer[hpass], p);
+
     // allow to process residual image
     if(layer_func) layer_func(buffer[hpass], p, p->scales + 1);
 
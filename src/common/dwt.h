@@ -19,6 +19,26 @@
 #ifndef DT_DEVELOP_DWT_H
 #define DT_DEVELOP_DWT_H
 
+#include <stdint.h>
+
+// detail scales and residual a dwt_cache_t can hold
+#define DT_DWT_CACHE_LAYERS 32
+
+/* forward transform of the last image decomposed, kept by the caller between dwt_decompose() calls.
+ * it is keyed by a hash of the image as it is handed to the decomposition, that is after layer_func()
+ * ran on scale 0, and by its size and number of scales, so only the synthesis runs again when the same
+ * input is decomposed with other parameters */
+typedef struct dwt_cache_t
+{
+  uint64_t hash;  // 0 when empty
+  int width;
+  int height;
+  int scales;
+  int num_details;        // detail scales stored
+  int has_residual;       // residual image stored after the detail scales
+  float *layers[DT_DWT_CACHE_LAYERS];
+} dwt_cache_t;
+
 /* structure returned by dt_dwt_init() to be used when calling dwt_decompose() */
 typedef struct dwt_params_t
 {
@@ -31,6 +51,7 @@ typedef struct dwt_params_t
   int merge_from_scale;
   void *user_data;
   float preview_scale;
+  dwt_cache_t *cache;
 } dwt_params_t;
 
 /* function prototype for the layer_func on dwt_decompose() call */
@@ -53,6 +74,13 @@ dwt_params_t *dt_dwt_init(float *image, const int width, const int height, const
 /* free resources used by dwt_decompose() */
 void dt_dwt_free(dwt_params_t *p);
 
+/* let dwt_decompose() reuse and update the forward transform in cache, the caller owns the cache and
+ * releases it with dt_dwt_cache_free(). the cache is only filled if it fits in the memory budget. */
+void dt_dwt_set_cache(dwt_params_t *p, dwt_cache_t *cache);
+
+/* free the layers of a decomposition cache and empty it */
+void dt_dwt_cache_free(dwt_cache_t *cache);
+
 /* returns the maximum number of scales that dwt_decompose() will accept for the current image size */
 int dwt_get_max_scale(dwt_params_t *p);
 
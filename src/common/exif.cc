@@ -3124,33 +3124,33 @@ int dt_exif_read_blob(uint8_t **buf,
   }
 }
 
+// Whether a blob of len bytes gets compressed with the compress_xmp_tags
+// setting config. If input data field exceeds a certain size we compress it
+// and convert to base64; main reason for compression: make more XMP data fit
+// into 64k segment within JPEG output files.
+static gboolean _exif_xmp_compress(const char *config,
+                                   const int len)
+{
+#define COMPRESS_THRESHOLD 100
+
+  if(!config) return FALSE;
+
+  return !strcmp(config, "always")
+    || (len > COMPRESS_THRESHOLD && !strcmp(config, "only large entries"));
+
+#undef COMPRESS_THRESHOLD
+}
+
 // Encode binary blob into text:
 char *dt_exif_xmp_encode(const unsigned char *input,
                          const int len,
                          int *output_len)
 {
-#define COMPRESS_THRESHOLD 100
-
-  gboolean do_compress = FALSE;
-
-  // If input data field exceeds a certain size we compress it and convert to base64;
-  // main reason for compression: make more XMP data fit into 64k segment within
-  // JPEG output files.
   char *config = dt_conf_get_string("compress_xmp_tags");
-  if(config)
-  {
-    if(!strcmp(config, "always"))
-      do_compress = TRUE;
-    else if((len > COMPRESS_THRESHOLD) && !strcmp(config, "only large entries"))
-      do_compress = TRUE;
-    else
-      do_compress = FALSE;
-    g_free(config);
-  }
+  const gboolean do_compress = _exif_xmp_compress(config, len);
+  g_free(config);
 
   return dt_exif_xmp_encode_internal(input, len, output_len, do_compress);
-
-#undef COMPRESS_THRESHOLD
 }
 
 char *dt_exif_xmp_encode_internal(const unsigned char *input,
@@ -4865,6 +4865,199 @@ static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
   xmpData["Xmp.darktable.history_end"] = history_end;
 }
 
+// Append the attribute darktable:name="value" of an rdf:li of the history
+// sequences, escaped the way the XMP toolkit does.
+static void _xmp_append_attr(std::string &xml,
+                             const char *name,
+                             const char *value)
+{
+  xml += "\n      darktable:";
+  xml += name;
+  xml += "=\"";
+  for(const char *c = value; c && *c; c++)
+  {
+    switch(*c)
+    {
+      case '&': xml += "&amp;"; break;
+      case '<': xml += "&lt;"; break;
+      case '>': xml += "&gt;"; break;
+      case '"': xml += "&quot;"; break;
+      case '\t': xml += "&#x9;"; break;
+      case '\n': xml += "&#xA;"; break;
+      case '\r': xml += "&#xD;"; break;
+      default: xml += *c;
+    }
+  }
+  xml += '"';
+}
+
+static void _xmp_append_attr_int(std::string &xml,
+                                 const char *name,
+                                 const int32_t value)
+{
+  char text[16];
+  snprintf(text, sizeof(text), "%d", value);
+  _xmp_append_attr(xml, name, text);
+}
+
+static void _xmp_append_attr_blob(std::string &xml,
+                                  const char *name,
+                                  const void *blob,
+                                  const int32_t len,
+                                  const char *compress)
+{
+  char *text = dt_exif_xmp_encode_internal((const unsigned char *)blob, len, NULL,
+                                           _exif_xmp_compress(compress, len));
+  _xmp_append_attr(xml, name, text);
+  free(text);
+}
+
+// Same as _set_xmp_dt_history() but the masks_history and history sequences
+// are serialized directly as the RDF elements exiv2 would write in compact
+// format, saving the XmpData key lookups and the XMP toolkit round-trip which
+// dominate the sidecar writes of long histories. Returns history_end.
+static int _get_xmp_dt_history_rdf(std::string &xml,
+                                   const dt_imgid_t imgid,
+                                   int history_end)
+{
+  sqlite3_stmt *stmt;
+
+  // read once for all the params of the stack
+  const char *compress = dt_conf_get_string_const("compress_xmp_tags");
+
+  // Masks history:
+  xml += "   <darktable:masks_history>\n    <rdf:Seq>";
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(
+      dt_database_get(darktable.db),
+      "SELECT imgid, formid, form, name, version, points, points_count, source, num"
+      " FROM main.masks_history"
+      " WHERE imgid = ?1"
+      " ORDER BY num",
+      -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    xml += "\n     <rdf:li";
+    _xmp_append_attr_int(xml, "mask_num", sqlite3_column_int(stmt, 8));
+    _xmp_append_attr_int(xml, "mask_id", sqlite3_column_int(stmt, 1));
+    _xmp_append_attr_int(xml, "mask_type", sqlite3_column_int(stmt, 2));
+    _xmp_append_attr(xml, "mask_name", (const char *)sqlite3_column_text(stmt, 3));
+    _xmp_append_attr_int(xml, "mask_version", sqlite3_column_int(stmt, 4));
+    _xmp_append_attr_blob(xml, "mask_points", sqlite3_column_blob(stmt, 5),
+                          sqlite3_column_bytes(stmt, 5), compress);
+    _xmp_append_attr_int(xml, "mask_nb", sqlite3_column_int(stmt, 6));
+    _xmp_append_attr_blob(xml, "mask_src", sqlite3_column_blob(stmt, 7),
+                          sqlite3_column_bytes(stmt, 7), compress);
+    xml += "/>";
+  }
+  sqlite3_finalize(stmt);
+  xml += "\n    </rdf:Seq>\n   </darktable:masks_history>\n";
+
+  // History stack:
+  int num = 1;
+
+  xml += "   <darktable:history>\n    <rdf:Seq>";
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(
+      dt_database_get(darktable.db),
+      "SELECT module, operation, op_params, enabled, blendop_params, "
+      "       blendop_version, multi_priority, multi_name, num, multi_name_hand_edited"
+      " FROM main.history"
+      " WHERE imgid = ?1"
+      " ORDER BY num",
+      -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *operation = (const char *)sqlite3_column_text(stmt, 1);
+    if(!operation) continue; // no op is fatal.
+
+    const char *multi_name = (const char *)sqlite3_column_text(stmt, 7);
+    const void *blendop_blob = sqlite3_column_blob(stmt, 4);
+
+    xml += "\n     <rdf:li";
+    _xmp_append_attr_int(xml, "num", sqlite3_column_int(stmt, 8));
+    _xmp_append_attr(xml, "operation", operation);
+    _xmp_append_attr_int(xml, "enabled", sqlite3_column_int(stmt, 3));
+    _xmp_append_attr_int(xml, "modversion", sqlite3_column_int(stmt, 0));
+    _xmp_append_attr_blob(xml, "params", sqlite3_column_blob(stmt, 2),
+                          sqlite3_column_bytes(stmt, 2), compress);
+    _xmp_append_attr(xml, "multi_name", multi_name ? multi_name : "");
+    _xmp_append_attr_int(xml, "multi_name_hand_edited", sqlite3_column_int(stmt, 9));
+    _xmp_append_attr_int(xml, "multi_priority", sqlite3_column_int(stmt, 6));
+    if(blendop_blob)
+    {
+      _xmp_append_attr_int(xml, "blendop_version", sqlite3_column_int(stmt, 5));
+      _xmp_append_attr_blob(xml, "blendop_params", blendop_blob,
+                            sqlite3_column_bytes(stmt, 4), compress);
+    }
+    xml += "/>";
+
+    num++;
+  }
+  sqlite3_finalize(stmt);
+  xml += "\n    </rdf:Seq>\n   </darktable:history>\n";
+
+  if(history_end == -1)
+    history_end = num - 1;
+  else
+    history_end = MIN(history_end, num - 1); // safeguard for some old buggy libraries
+
+  return history_end;
+}
+
+// Cut the darktable:masks_history and darktable:history elements out of the
+// text of a sidecar, they are rewritten anyway and are most of its parsing.
+static void _xmp_cut_dt_history(std::string &packet)
+{
+  if(packet.find("xmlns:darktable=\"http://darktable.sf.net/\"") == std::string::npos)
+    return;
+
+  static const char *elements[] = { "darktable:masks_history", "darktable:history" };
+  for(size_t k = 0; k < G_N_ELEMENTS(elements); k++)
+  {
+    const std::string open = std::string("<") + elements[k] + ">";
+    const std::string close = std::string("</") + elements[k] + ">";
+    size_t start;
+    while((start = packet.find(open)) != std::string::npos)
+    {
+      const size_t end = packet.find(close, start);
+      if(end == std::string::npos) break;
+      packet.erase(start, end + close.length() - start);
+    }
+  }
+}
+
+// Insert the history elements as the last children of the rdf:Description
+// of a packet encoded by exiv2. FALSE if the packet hasn't the expected form.
+static gboolean _xmp_splice_dt_history(std::string &packet,
+                                       const std::string &xml)
+{
+  if(packet.find("xmlns:darktable=\"http://darktable.sf.net/\"") == std::string::npos)
+    return FALSE;
+
+  const size_t close = packet.rfind("</rdf:Description>");
+  if(close != std::string::npos)
+  {
+    // on its own line, before the indentation of the closing tag
+    const size_t line = packet.rfind('\n', close);
+    packet.insert(line == std::string::npos ? close : line + 1, xml);
+    return TRUE;
+  }
+
+  // only attributes: the description is an empty element. '>' is always
+  // escaped inside the attribute values.
+  const size_t desc = packet.find("<rdf:Description");
+  if(desc == std::string::npos) return FALSE;
+  const size_t gt = packet.find('>', desc);
+  if(gt == std::string::npos || packet[gt - 1] != '/') return FALSE;
+  packet.replace(gt - 1, 2, ">\n" + xml + "  </rdf:Description>");
+  return TRUE;
+}
+
 // Add timestamps to XmpData.
 static void _set_xmp_timestamps(Exiv2::XmpData &xmpData,
                                 const dt_imgid_t imgid)
@@ -5125,9 +5318,12 @@ static void _set_xmp_dt_metadata(Exiv2::XmpData &xmpData,
 
 // Helper to create an xmp data thing. Throws Exiv2 exceptions if
 // stuff goes wrong.
+// With history non-NULL the history sequences are serialized in there
+// instead of being added to xmpData, see _get_xmp_dt_history_rdf().
 static void _exif_xmp_read_data(Exiv2::XmpData &xmpData,
                                 const dt_imgid_t imgid,
-                                const char *info)
+                                const char *info,
+                                std::string *history)
 {
   const double start = dt_get_debug_wtime();
   const int xmp_version = DT_XMP_EXIF_VERSION;
@@ -5230,7 +5426,11 @@ static void _exif_xmp_read_data(Exiv2::XmpData &xmpData,
     xmpData["Xmp.darktable.auto_presets_applied"] = 1;
   else
     xmpData["Xmp.darktable.auto_presets_applied"] = 0;
-  _set_xmp_dt_history(xmpData, imgid, history_end);
+  if(history)
+    xmpData["Xmp.darktable.history_end"] =
+      _get_xmp_dt_history_rdf(*history, imgid, history_end);
+  else
+    _set_xmp_dt_history(xmpData, imgid, history_end);
 
   // We need to read the iop-order list
   xmpData["Xmp.darktable.iop_order_version"] = iop_order_version;
@@ -5457,7 +5657,7 @@ char *dt_exif_xmp_read_string(const dt_imgid_t imgid)
 
     // Last but not least, attach what we have in DB to the XMP. In theory that should be
     // the same as what we just copied over from the sidecar file, but you never know ...
-    _exif_xmp_read_data(xmpData, imgid, "dt_exif_xmp_read_string");
+    _exif_xmp_read_data(xmpData, imgid, "dt_exif_xmp_read_string", NULL);
 
     // Serialize the xmp data and output the xmp packet
     std::string xmpPacket;
@@ -6104,6 +6304,8 @@ gboolean dt_exif_xmp_write(const dt_imgid_t imgid,
 #else
       xmpPacket.assign(reinterpret_cast<char *>(buf.pData_), buf.size_);
 #endif
+      // Keep the foreign tags only, the history is spliced in again below.
+      _xmp_cut_dt_history(xmpPacket);
       Exiv2::XmpParser::decode(xmpData, xmpPacket);
 
       // Because XmpSeq or XmpBag are added to the list, we first have to
@@ -6112,11 +6314,13 @@ gboolean dt_exif_xmp_write(const dt_imgid_t imgid,
     }
 
     // Initialize xmp data:
-    _exif_xmp_read_data(xmpData, imgid, "dt_exif_xmp_write");
+    std::string history;
+    _exif_xmp_read_data(xmpData, imgid, "dt_exif_xmp_write", &history);
 
     // Serialize the xmp data and output the xmp packet.
     if(Exiv2::XmpParser::encode(xmpPacket, xmpData,
-       Exiv2::XmpParser::useCompactFormat | Exiv2::XmpParser::omitPacketWrapper) != 0)
+       Exiv2::XmpParser::useCompactFormat | Exiv2::XmpParser::omitPacketWrapper) != 0
+       || !_xmp_splice_dt_history(xmpPacket, history))
     {
       throw Exiv2::Error(Exiv2::ErrorCode::kerErrorMessage, "[xmp_write] failed to serialize xmp data");
     }
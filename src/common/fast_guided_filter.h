@@ -28,6 +28,7 @@
 #include "common/box_filters.h"
 #include "common/darktable.h"
 #include "common/imagebuf.h"
+#include "control/control.h"
 
 
 /* NOTE: this code complies with the optimizations in "common/extra_optimizations.h".
@@ -159,20 +160,17 @@ static inline void variance_analyse(const float *const restrict guide, // I
                                     const size_t width,
                                     const size_t height,
                                     const int radius,
-                                    const float feathering)
+                                    const float feathering,
+                                    float *const restrict input)
 {
   // Compute a box average (filter) on a grey image over a window of size 2*radius + 1
   // then get the variance of the guide and covariance with its mask
   // output a and b, the linear blending params
   // p, the mask is the quantised guide I
+  // input is a caller-provided scratch buffer of 4 * width * height floats,
+  // laid out as an array of struct : { { guide , mask, guide * guide, guide * mask } }
 
   const size_t Ndim = width * height;
-  const size_t Ndimch = Ndim * 4;
-
-  /*
-  * input is array of struct : { { guide , mask, guide * guide, guide * mask } }
-  */
-  float *const restrict input = dt_alloc_align_float(Ndimch);
 
   // Pre-multiply guide and mask and pack all inputs into an array of 4×1 SIMD struct
   DT_OMP_FOR_SIMD()
@@ -198,8 +196,6 @@ static inline void variance_analyse(const float *const restrict guide, // I
     ab[2*idx] = a;
     ab[2*idx+1] = b;
   }
-
-  if(input != NULL) dt_free_align(input);
 }
 
 
@@ -231,6 +227,63 @@ static inline void apply_linear_blending_w_geomean(float *const restrict image,
 }
 
 
+__DT_CLONE_TARGETS__
+static inline void apply_blending_upsampled(float *const restrict image,
+                                            const float *const restrict ds_ab,
+                                            const size_t width,
+                                            const size_t height,
+                                            const size_t ds_width,
+                                            const size_t ds_height,
+                                            const dt_iop_guided_filter_blending_t filter)
+{
+  // Upsample the blending parameters a and b on the fly, with the same sampling as
+  // interpolate_bilinear(), and blend the full-resolution image in the same pass.
+  // This saves a full-resolution 2-channel buffer and one pass over it.
+  const gboolean geomean = filter == DT_GF_BLENDING_GEOMEAN;
+
+  DT_OMP_FOR()
+  for(size_t i = 0; i < height; i++)
+  {
+    const float y_in = (float)i / (float)height * (float)ds_height;
+    size_t y_prev = (size_t)floorf(y_in);
+    size_t y_next = y_prev + 1;
+    y_prev = (y_prev < ds_height) ? y_prev : ds_height - 1;
+    y_next = (y_next < ds_height) ? y_next : ds_height - 1;
+    const float Dy_next = (float)y_next - y_in;
+    const float Dy_prev = 1.f - Dy_next;
+    const float *const row_prev = ds_ab + y_prev * ds_width * 2;
+    const float *const row_next = ds_ab + y_next * ds_width * 2;
+    float *const restrict row_out = image + i * width;
+
+    for(size_t j = 0; j < width; j++)
+    {
+      const float x_in = (float)j / (float)width * (float)ds_width;
+      size_t x_prev = (size_t)floorf(x_in);
+      size_t x_next = x_prev + 1;
+      x_prev = (x_prev < ds_width) ? x_prev : ds_width - 1;
+      x_next = (x_next < ds_width) ? x_next : ds_width - 1;
+      const float Dx_next = (float)x_next - x_in;
+      const float Dx_prev = 1.f - Dx_next;
+
+      const float *const Q_NW = row_prev + x_prev * 2;
+      const float *const Q_NE = row_prev + x_next * 2;
+      const float *const Q_SW = row_next + x_prev * 2;
+      const float *const Q_SE = row_next + x_next * 2;
+
+      const float a = Dy_prev * (Q_SW[0] * Dx_next + Q_SE[0] * Dx_prev) +
+                      Dy_next * (Q_NW[0] * Dx_next + Q_NE[0] * Dx_prev);
+      const float b = Dy_prev * (Q_SW[1] * Dx_next + Q_SE[1] * Dx_prev) +
+                      Dy_next * (Q_NW[1] * Dx_next + Q_NE[1] * Dx_prev);
+
+      // Note : image is positive at the outside of the luminance mask
+      const float pixel = row_out[j];
+      const float blended = fmaxf(pixel * a + b, MIN_FLOAT);
+      row_out[j] = geomean ? sqrtf(pixel * blended) : blended;
+    }
+  }
+}
+
+
 __DT_CLONE_TARGETS__
 static inline void quantize(const float *const restrict image,
                             float *const restrict out,
@@ -264,6 +317,70 @@ static inline void quantize(const float *const restrict image,
 }
 
 
+// all the downscaled buffers of the fast guided filter live in one arena of
+// FAST_SURFACE_BLUR_ARENA_SIZE(num_elem_ds) floats: ds_image, ds_mask, ds_ab (2 channels)
+// and the 4-channel scratch of variance_analyse(). every slice is padded to 16 floats
+// so each one stays 64-bytes aligned.
+#define FAST_SURFACE_BLUR_SLICE(n) ((((size_t)(n)) + 15) & ~(size_t)15)
+#define FAST_SURFACE_BLUR_ARENA_SIZE(n) (8 * FAST_SURFACE_BLUR_SLICE(n))
+
+static inline float *fast_surface_blur_arena_alloc(const size_t num_elem_ds,
+                                                   float **ds_image,
+                                                   float **ds_mask,
+                                                   float **ds_ab,
+                                                   float **workspace)
+{
+  const size_t slice = FAST_SURFACE_BLUR_SLICE(num_elem_ds);
+  float *const arena = dt_alloc_align_float(FAST_SURFACE_BLUR_ARENA_SIZE(num_elem_ds));
+  if(!arena) return NULL;
+  *ds_image = arena;
+  *ds_mask = arena + slice;
+  *ds_ab = arena + 2 * slice;
+  *workspace = arena + 4 * slice;
+  return arena;
+}
+
+// the downscaled part of fast_surface_blur(), computing the blending parameters
+// a and b into ds_ab. also used by the OpenCL code path which does the scaling
+// and blending on the device. workspace holds 4 * ds_width * ds_height floats
+// and is reused by every iteration.
+__DT_CLONE_TARGETS__
+static inline void fast_surface_blur_ds(float *const restrict ds_image,
+                                        float *const restrict ds_mask,
+                                        float *const restrict ds_ab,
+                                        float *const restrict workspace,
+                                        const size_t ds_width,
+                                        const size_t ds_height,
+                                        const int ds_radius,
+                                        const float feathering,
+                                        const int iterations,
+                                        const float quantization,
+                                        const float quantize_min,
+                                        const float quantize_max)
+{
+  const size_t num_elem_ds = ds_width * ds_height;
+
+  // Iterations of filter models the diffusion, sort of
+  for(int i = 0; i < iterations; ++i)
+  {
+    // (Re)build the mask from the quantized image to help guiding
+    quantize(ds_image, ds_mask, num_elem_ds, quantization, quantize_min, quantize_max);
+
+    // Perform the patch-wise variance analyse to get
+    // the a and b parameters for the linear blending s.t. mask = a * I + b
+    variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering, workspace);
+
+    // Compute the patch-wise average of parameters a and b
+    dt_box_mean(ds_ab, ds_height, ds_width, 2, ds_radius, 1);
+
+    if(i != iterations - 1)
+    {
+      // Process the intermediate filtered image
+      apply_linear_blending(ds_image, ds_ab, num_elem_ds);
+    }
+  }
+}
+
 __DT_CLONE_TARGETS__
 static inline void fast_surface_blur(float *const restrict image,
                                       const size_t width,
@@ -288,57 +405,27 @@ static inline void fast_surface_blur(float *const restrict image,
   const size_t ds_width = width / scaling;
 
   const size_t num_elem_ds = ds_width * ds_height;
-  const size_t num_elem = width * height;
 
-  float *const restrict ds_image = dt_alloc_align_float(num_elem_ds);
-  float *const restrict ds_mask = dt_alloc_align_float(num_elem_ds);
-  float *const restrict ds_ab = dt_alloc_align_float(num_elem_ds * 2);
-  float *const restrict ab = dt_alloc_align_float(num_elem * 2);
+  float *ds_image = NULL, *ds_mask = NULL, *ds_ab = NULL, *workspace = NULL;
+  float *const arena = fast_surface_blur_arena_alloc(num_elem_ds, &ds_image, &ds_mask, &ds_ab, &workspace);
 
-  if(!ds_image || !ds_mask || !ds_ab || !ab)
+  if(!arena)
   {
     dt_print(DT_DEBUG_PIPE, "fast guided filter failed to allocate memory");
     dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
-    goto clean;
+    return;
   }
 
   // Downsample the image for speed-up
   interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1);
 
-  // Iterations of filter models the diffusion, sort of
-  for(int i = 0; i < iterations; ++i)
-  {
-    // (Re)build the mask from the quantized image to help guiding
-    quantize(ds_image, ds_mask, ds_width * ds_height, quantization, quantize_min, quantize_max);
-
-    // Perform the patch-wise variance analyse to get
-    // the a and b parameters for the linear blending s.t. mask = a * I + b
-    variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering);
-
-    // Compute the patch-wise average of parameters a and b
-    dt_box_mean(ds_ab, ds_height, ds_width, 2, ds_radius, 1);
-
-    if(i != iterations - 1)
-    {
-      // Process the intermediate filtered image
-      apply_linear_blending(ds_image, ds_ab, num_elem_ds);
-    }
-  }
-
-  // Upsample the blending parameters a and b
-  interpolate_bilinear(ds_ab, ds_width, ds_height, ab, width, height, 2);
+  fast_surface_blur_ds(ds_image, ds_mask, ds_ab, workspace, ds_width, ds_height, ds_radius,
+                       feathering, iterations, quantization, quantize_min, quantize_max);
 
-  // Finally, blend the guided image
-  if(filter == DT_GF_BLENDING_LINEAR)
-    apply_linear_blending(image, ab, num_elem);
-  else if(filter == DT_GF_BLENDING_GEOMEAN)
-    apply_linear_blending_w_geomean(image, ab, num_elem);
+  // Finally, upsample the blending parameters a and b and blend the guided image
+  apply_blending_upsampled(image, ds_ab, width, height, ds_width, ds_height, filter);
 
-clean:
-  dt_free_align(ab);
-  dt_free_align(ds_ab);
-  dt_free_align(ds_mask);
-  dt_free_align(ds_image);
+  dt_free_align(arena);
 }
 
 // clang-format off
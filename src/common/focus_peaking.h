@@ -73,27 +73,34 @@ static inline void _get_indices(const size_t i,
   index[7] = lower_line + right_row;      // south east
 }
 
-static inline void dt_focuspeaking(cairo_t *cr,
-                                   const int buf_width,
-                                   const int buf_height,
-                                   uint8_t *const restrict image)
+static inline void _focuspeaking_free(void *data)
+{
+  dt_free_align(data);
+}
+
+// compute the focus peaking overlay of an 8 bit image as an ARGB32 surface
+static inline cairo_surface_t *dt_focuspeaking_surface(const int buf_width,
+                                                       const int buf_height,
+                                                       uint8_t *const restrict image)
 {
   float *const restrict luma = dt_alloc_align_float((size_t)buf_width * buf_height);
   uint8_t *const restrict focus_peaking = dt_alloc_align_uint8(buf_width * buf_height * 4);
 
   const size_t npixels = (size_t)buf_height * buf_width;
+
+  // remove gamma 2.2 and take the square, there are only 256 input values
+  float DT_ALIGNED_ARRAY power[256];
+  for(int k = 0; k < 256; k++)
+    power[k] = powf(_uint8_to_float(k), 2.0f * 2.2f);
+
   // Create a luma buffer as the euclidian norm of RGB channels
   DT_OMP_FOR_SIMD(aligned(image, luma:64))
   for(size_t index = 0; index < npixels; index++)
     {
       const size_t index_RGB = index * 4;
-
-      // remove gamma 2.2 and take the square is equivalent to this:
-      const float exponent = 2.0f * 2.2f;
-
-      luma[index] = sqrtf( powf(_uint8_to_float(image[index_RGB]), exponent) +
-                           powf(_uint8_to_float(image[index_RGB + 1]), exponent) +
-                           powf(_uint8_to_float(image[index_RGB + 2]), exponent) );
+      luma[index] = sqrtf(power[image[index_RGB]]
+                          + power[image[index_RGB + 1]]
+                          + power[image[index_RGB + 2]]);
     }
 
   // Prefilter noise
@@ -193,24 +200,44 @@ static inline void dt_focuspeaking(cairo_t *cr,
       }
     }
 
-  // draw the focus peaking overlay
-  cairo_save(cr);
-  cairo_rectangle(cr, 0, 0, buf_width, buf_height);
+  dt_free_align(luma);
+  dt_free_align(luma_ds);
+
+  // the surface owns the overlay
   cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *)focus_peaking,
                                                                  CAIRO_FORMAT_ARGB32,
                                                                  buf_width, buf_height,
                                                                  cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, buf_width));
+  static const cairo_user_data_key_t key;
+  if(cairo_surface_set_user_data(surface, &key, focus_peaking, _focuspeaking_free)
+     != CAIRO_STATUS_SUCCESS)
+    dt_free_align(focus_peaking);
+  return surface;
+}
+
+// draw an overlay made by dt_focuspeaking_surface()
+static inline void dt_focuspeaking_paint(cairo_t *cr,
+                                         cairo_surface_t *surface)
+{
+  cairo_save(cr);
+  cairo_rectangle(cr, 0, 0,
+                  cairo_image_surface_get_width(surface),
+                  cairo_image_surface_get_height(surface));
   cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
   cairo_set_source_surface(cr, surface, 0.0, 0.0);
   cairo_pattern_set_filter(cairo_get_source (cr), darktable.gui->filter_image);
   cairo_fill(cr);
   cairo_restore(cr);
+}
 
-  // cleanup
+static inline void dt_focuspeaking(cairo_t *cr,
+                                   const int buf_width,
+                                   const int buf_height,
+                                   uint8_t *const restrict image)
+{
+  cairo_surface_t *surface = dt_focuspeaking_surface(buf_width, buf_height, image);
+  dt_focuspeaking_paint(cr, surface);
   cairo_surface_destroy(surface);
-  dt_free_align(luma);
-  dt_free_align(luma_ds);
-  dt_free_align(focus_peaking);
 }
 
 // clang-format off
@@ -154,6 +154,133 @@ size_t dt_gaussian_singlebuffer_size(const int width,    // width of input image
 }
 
 
+// number of floats of adjacent columns filtered together by the vertical
+// pass, a few cachelines of each row
+#define DT_GAUSS_COLUMN_FLOATS 64
+
+// vertical filter of the n floats of adjacent columns starting at in and
+// out, rows are stride floats apart. the filter state of all columns is
+// kept side by side so each step works on whole cachelines and the inner
+// loops vectorise across the columns.
+static inline void _gaussian_column_block(const float *const in,
+                                          float *const out,
+                                          const size_t stride,
+                                          const size_t height,
+                                          const int n,
+                                          const float *const blockmin,
+                                          const float *const blockmax,
+                                          const float a0,
+                                          const float a1,
+                                          const float a2,
+                                          const float a3,
+                                          const float b1,
+                                          const float b2,
+                                          const float coefp,
+                                          const float coefn)
+{
+  float DT_ALIGNED_ARRAY xp[DT_GAUSS_COLUMN_FLOATS];
+  float DT_ALIGNED_ARRAY xn[DT_GAUSS_COLUMN_FLOATS];
+  float DT_ALIGNED_ARRAY xa[DT_GAUSS_COLUMN_FLOATS];
+  float DT_ALIGNED_ARRAY yb[DT_GAUSS_COLUMN_FLOATS];
+  float DT_ALIGNED_ARRAY yp[DT_GAUSS_COLUMN_FLOATS];
+
+  // forward filter
+  for(int k = 0; k < n; k++)
+  {
+    xp[k] = CLAMPF(in[k], blockmin[k], blockmax[k]);
+    yb[k] = xp[k] * coefp;
+    yp[k] = yb[k];
+  }
+
+  for(size_t j = 0; j < height; j++)
+  {
+    const float *const row = in + j * stride;
+    float *const orow = out + j * stride;
+    DT_OMP_SIMD()
+    for(int k = 0; k < n; k++)
+    {
+      const float xc = CLAMPF(row[k], blockmin[k], blockmax[k]);
+      const float yc = (a0 * xc) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+      orow[k] = yc;
+      xp[k] = xc;
+      yb[k] = yp[k];
+      yp[k] = yc;
+    }
+  }
+
+  // backward filter, yp and yb are reused for yn and ya
+  const float *const last = in + (height - 1) * stride;
+  for(int k = 0; k < n; k++)
+  {
+    xn[k] = CLAMPF(last[k], blockmin[k], blockmax[k]);
+    xa[k] = xn[k];
+    yp[k] = xn[k] * coefn;
+    yb[k] = yp[k];
+  }
+
+  for(size_t j = height; j > 0; j--)
+  {
+    const float *const row = in + (j - 1) * stride;
+    float *const orow = out + (j - 1) * stride;
+    DT_OMP_SIMD()
+    for(int k = 0; k < n; k++)
+    {
+      const float xc = CLAMPF(row[k], blockmin[k], blockmax[k]);
+      const float yc = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+      xa[k] = xn[k];
+      xn[k] = xc;
+      yb[k] = yp[k];
+      yp[k] = yc;
+      orow[k] += yc;
+    }
+  }
+}
+
+// vertical pass of the recursive filter over blocks of adjacent columns
+static void _gaussian_vertical(const float *const in,
+                               float *const out,
+                               const size_t width,
+                               const size_t height,
+                               const int ch,
+                               const float *const min,
+                               const float *const max,
+                               const float a0,
+                               const float a1,
+                               const float a2,
+                               const float a3,
+                               const float b1,
+                               const float b2,
+                               const float coefp,
+                               const float coefn)
+{
+  // whole pixels per block
+  const int block = (DT_GAUSS_COLUMN_FLOATS / ch) * ch;
+  const size_t stride = width * ch;
+  const size_t nblocks = (stride + block - 1) / block;
+
+  float DT_ALIGNED_ARRAY blockmin[DT_GAUSS_COLUMN_FLOATS];
+  float DT_ALIGNED_ARRAY blockmax[DT_GAUSS_COLUMN_FLOATS];
+  for(int k = 0; k < block; k++)
+  {
+    blockmin[k] = min[k % ch];
+    blockmax[k] = max[k % ch];
+  }
+
+  DT_OMP_FOR()
+  for(size_t b = 0; b < nblocks; b++)
+  {
+    const size_t first = b * block;
+    const int n = MIN(block, stride - first);
+    // full blocks get a constant length for the compiler
+    if(n == DT_GAUSS_COLUMN_FLOATS)
+      _gaussian_column_block(in + first, out + first, stride, height, DT_GAUSS_COLUMN_FLOATS,
+                             blockmin, blockmax, a0, a1, a2, a3, b1, b2, coefp, coefn);
+    else
+      _gaussian_column_block(in + first, out + first, stride, height, n,
+                             blockmin, blockmax, a0, a1, a2, a3, b1, b2, coefp, coefn);
+  }
+}
+
 dt_gaussian_t *dt_gaussian_init(const int width,    // width of input image
                                 const int height,   // height of input image
                                 const int channels, // channels per pixel
@@ -212,73 +339,9 @@ void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
   float *Labmax = g->max;
   float *Labmin = g->min;
 
-// vertical blur column by column
-  DT_OMP_FOR()
-  for(int i = 0; i < width; i++)
-  {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
-
-    // forward filter
-    for(int k = 0; k < ch; k++)
-    {
-      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
-
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        temp[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
-
-    // backward filter
-    for(int k = 0; k < ch; k++)
-    {
-      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
-    }
-
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-
-        temp[offset + k] += yc[k];
-      }
-    }
-  }
+// vertical blur, blocks of columns at once
+  _gaussian_vertical(in, temp, width, height, ch, Labmin, Labmax,
+                     a0, a1, a2, a3, b1, b2, coefp, coefn);
 
 // horizontal blur line by line
   DT_OMP_FOR()
@@ -366,71 +429,9 @@ void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const o
   copy_pixel(Labmin, g->min);
   copy_pixel(Labmax, g->max);
 
-// vertical blur column by column
-  DT_OMP_FOR()
-  for(size_t i = 0; i < width; i++)
-  {
-    // forward filter
-    dt_aligned_pixel_t xp;
-    dt_aligned_pixel_t yb;
-    dt_aligned_pixel_t yp;
-    for_four_channels(k)
-    {
-      xp[k] = CLAMPF(in[4*i + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
-
-    dt_aligned_pixel_t xc;
-    dt_aligned_pixel_t xn;
-    dt_aligned_pixel_t xa;
-    for(size_t j = 0; j < height; j++)
-    {
-      size_t offset = 4 * (j * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-      copy_pixel(temp + offset, yc);
-    }
-
-    // backward filter
-    dt_aligned_pixel_t yn;
-    dt_aligned_pixel_t ya;
-    for_four_channels(k)
-    {
-      xn[k] = CLAMPF(in[4*((height - 1) * width + i) + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
-    }
-
-    for(size_t j = height; j > 0; j--)
-    {
-      size_t offset = 4 * ((j-1) * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-        temp[offset + k] += yc[k];
-      }
-    }
-  }
+// vertical blur, blocks of columns at once
+  _gaussian_vertical(in, temp, width, height, 4, Labmin, Labmax,
+                     a0, a1, a2, a3, b1, b2, coefp, coefn);
 
 // horizontal blur line by line
   DT_OMP_FOR()
@@ -40,6 +40,11 @@ typedef struct dt_gpx_t
   GList *trkpts;
   GList *trksegs;
 
+  /* the track points sorted by time, with their time relative to the first one */
+  dt_gpx_track_point_t **points;
+  GTimeSpan *times;
+  guint n_points;
+
   /* currently parsed track point */
   dt_gpx_track_point_t *current_track_point;
   _gpx_parser_element_t current_parser_element;
@@ -109,6 +114,17 @@ dt_gpx_t *dt_gpx_new(const gchar *filename)
   gpx->trkpts = g_list_sort(gpx->trkpts, _sort_track);
   gpx->trksegs = g_list_sort(gpx->trksegs, _sort_segment);
 
+  /* index the points for the lookups by time */
+  gpx->n_points = g_list_length(gpx->trkpts);
+  gpx->points = g_new(dt_gpx_track_point_t *, gpx->n_points);
+  gpx->times = g_new(GTimeSpan, gpx->n_points);
+  guint k = 0;
+  for(GList *item = gpx->trkpts; item; item = g_list_next(item), k++)
+  {
+    gpx->points[k] = item->data;
+    gpx->times[k] = g_date_time_difference(gpx->points[k]->time, gpx->points[0]->time);
+  }
+
   return gpx;
 
 error:
@@ -146,6 +162,8 @@ void dt_gpx_destroy(dt_gpx_t *gpx)
 
   if(gpx->trkpts) g_list_free_full(gpx->trkpts, (GDestroyNotify)_track_pts_free);
   if(gpx->trksegs) g_list_free_full(gpx->trksegs, (GDestroyNotify)_track_seg_free);
+  g_free(gpx->points);
+  g_free(gpx->times);
 
   g_free(gpx);
 }
@@ -155,100 +173,103 @@ gboolean dt_gpx_get_location(const dt_gpx_t *gpx, GDateTime *timestamp, dt_image
   g_assert(gpx != NULL);
 
   /* verify that we got at least 2 trackpoints */
-  if(g_list_shorter_than(gpx->trkpts,2)) return FALSE;
+  if(gpx->n_points < 2) return FALSE;
+
+  const guint last = gpx->n_points - 1;
+  const GTimeSpan t = g_date_time_difference(timestamp, gpx->points[0]->time);
+
+  /* if timestamp is out of time range return false but fill
+     closest location value start or end point */
+  if(t <= 0 || t > gpx->times[last])
+  {
+    const dt_gpx_track_point_t *tp = gpx->points[t <= 0 ? 0 : last];
+    geoloc->longitude = tp->longitude;
+    geoloc->latitude = tp->latitude;
+    geoloc->elevation = tp->elevation;
+    return FALSE;
+  }
 
-  for(GList *item = gpx->trkpts; item; item = g_list_next(item))
+  /* find the first trackpoint not before timestamp, it is the end
+     of the segment holding timestamp */
+  guint lo = 1, hi = last;
+  while(lo < hi)
   {
-    const dt_gpx_track_point_t *tp = item->data;
+    const guint mid = lo + (hi - lo) / 2;
+    if(gpx->times[mid] < t)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  const dt_gpx_track_point_t *tp = gpx->points[lo - 1];
+  const dt_gpx_track_point_t *tp_next = gpx->points[lo];
+  const GTimeSpan seg_diff = g_date_time_difference(tp_next->time, tp->time);
+  const GTimeSpan diff = g_date_time_difference(timestamp, tp->time);
+  if(seg_diff == 0 || diff == 0)
+  {
+    geoloc->longitude = tp->longitude;
+    geoloc->latitude = tp->latitude;
+    geoloc->elevation = tp->elevation;
+  }
+  else
+  {
+    /* get the point by interpolation according to timestamp
+
+    We assume that the maximum difference in longitude is less or equal 180º:
+    since the bigger use case is that of an airplane, never an airplane flies more than 180º in longitude */
 
-    /* if timestamp is out of time range return false but fill
-       closest location value start or end point */
-    const gint cmp = g_date_time_compare(timestamp, tp->time);
-    if((!item->next && cmp >= 0) || (cmp <= 0))
+    const double lat1 = tp->latitude;
+    const double lon1 = tp->longitude;
+    const double lat2 = tp_next->latitude;
+    const double lon2 = tp_next->longitude;
+
+    double lat, lon;
+
+    const double f = (double)diff / (double)seg_diff; /* the fraction of the distance */
+
+    if(fabs(lat2 - lat1) < DT_MINIMUM_ANGULAR_DELTA_FOR_GEODESIC
+        && fabs(lon2 - lon1) < DT_MINIMUM_ANGULAR_DELTA_FOR_GEODESIC)
     {
-      geoloc->longitude = tp->longitude;
-      geoloc->latitude = tp->latitude;
-      geoloc->elevation = tp->elevation;
-      return FALSE;
+      /* short distance (< 10 km), no need for geodesic interpolation */
+      lon = lon1 + (lon2 - lon1) * f;
+      lat = lat1 + (lat2 - lat1) * f;
     }
-
-    const dt_gpx_track_point_t *tp_next = item->next->data;
-    /* check if timestamp is within current and next trackpoint */
-    const gint cmp_n = g_date_time_compare(timestamp, tp_next->time);
-    if(item->next && cmp_n <= 0)
+    else
     {
-      const GTimeSpan seg_diff = g_date_time_difference(tp_next->time, tp->time);
-      const GTimeSpan diff = g_date_time_difference(timestamp, tp->time);
-      if(seg_diff == 0 || diff == 0)
-      {
-        geoloc->longitude = tp->longitude;
-        geoloc->latitude = tp->latitude;
-        geoloc->elevation = tp->elevation;
-      }
-      else
-      {
-        /* get the point by interpolation according to timestamp
-
-        We assume that the maximum difference in longitude is less or equal 180º:
-        since the bigger use case is that of an airplane, never an airplane flies more than 180º in longitude */
-
-        const double lat1 = tp->latitude;
-        const double lon1 = tp->longitude;
-        const double lat2 = tp_next->latitude;
-        const double lon2 = tp_next->longitude;
-
-        double lat, lon;
-
-        const double f = (double)diff / (double)seg_diff; /* the fraction of the distance */
-
-        if(fabs(lat2 - lat1) < DT_MINIMUM_ANGULAR_DELTA_FOR_GEODESIC
-            && fabs(lon2 - lon1) < DT_MINIMUM_ANGULAR_DELTA_FOR_GEODESIC)
-        {
-          /* short distance (< 10 km), no need for geodesic interpolation */
-          lon = lon1 + (lon2 - lon1) * f;
-          lat = lat1 + (lat2 - lat1) * f;
-        }
-        else
-        {
-          /* interpolation on the earth surface
-             formulas from http://www.movable-type.co.uk/scripts/latlong.html
-
-             the formulas are correct even if the two point are across the day line, e.g [(0, -179), (0,179)]
-             TO DO: in this case the line which is drawn is incorrect, but this should be a osm_gps issue
-          */
-
-          /* first, calculate the distance on the earth surface */
-          double d, delta;
-          dt_gpx_geodesic_distance(lat1, lon1,
-                                   lat2, lon2,
-                                   &d, &delta);
-          /* d is the distance on the surface in metres,
-             delta is the angle defined by the two points*/
-
-          /* then, calculate the intermediate point */
-          dt_gpx_geodesic_intermediate_point(lat1, lon1,
-                                             lat2, lon2,
-                                             delta,
-                                             TRUE,
-                                             f,
-                                             &lat, &lon);
-        }
-
-        geoloc->latitude = lat;
-        geoloc->longitude = lon;
-
-        /* make a simple linear interpolation on elevation */
-        if(tp_next->elevation == NAN || tp->elevation == NAN)
-          geoloc->elevation = NAN;
-        else
-          geoloc->elevation = tp->elevation + (tp_next->elevation - tp->elevation) * f;
-      }
-      return TRUE;
+      /* interpolation on the earth surface
+         formulas from http://www.movable-type.co.uk/scripts/latlong.html
+
+         the formulas are correct even if the two point are across the day line, e.g [(0, -179), (0,179)]
+         TO DO: in this case the line which is drawn is incorrect, but this should be a osm_gps issue
+      */
+
+      /* first, calculate the distance on the earth surface */
+      double d, delta;
+      dt_gpx_geodesic_distance(lat1, lon1,
+                               lat2, lon2,
+                               &d, &delta);
+      /* d is the distance on the surface in metres,
+         delta is the angle defined by the two points*/
+
+      /* then, calculate the intermediate point */
+      dt_gpx_geodesic_intermediate_point(lat1, lon1,
+                                         lat2, lon2,
+                                         delta,
+                                         TRUE,
+                                         f,
+                                         &lat, &lon);
     }
-  }
 
-  /* should not reach this point */
-  return FALSE;
+    geoloc->latitude = lat;
+    geoloc->longitude = lon;
+
+    /* make a simple linear interpolation on elevation */
+    if(tp_next->elevation == NAN || tp->elevation == NAN)
+      geoloc->elevation = NAN;
+    else
+      geoloc->elevation = tp->elevation + (tp_next->elevation - tp->elevation) * f;
+  }
+  return TRUE;
 }
 
 static void _gpx_parse_error(GError **error)
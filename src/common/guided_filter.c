@@ -54,19 +54,6 @@ typedef struct color_image
   int width, height, stride;
 } color_image;
 
-// allocate space for n-component image of size width x height
-static inline color_image _new_color_image(int width, int height, int ch)
-{
-  return (color_image){ dt_alloc_align_float((size_t)width * height * ch), width, height, ch };
-}
-
-// free space for n-component image
-static inline void _free_color_image(color_image *img_p)
-{
-  dt_free_align(img_p->data);
-  img_p->data = NULL;
-}
-
 // get a pointer to pixel number 'i' within the image
 static inline float *_get_color_pixel(color_image img, size_t i)
 {
@@ -114,8 +101,12 @@ static void _guided_filter_tiling(color_image imgg,
 #define VAR_GG 6
 #define VAR_BB 8
 #define VAR_GB 7
-  color_image mean = _new_color_image(width, height, 4);
-  color_image variance = _new_color_image(width, height, 9);
+  // the 4-channel means and the 9-channel variances share one allocation,
+  // the means padded so that the variances stay 64-bytes aligned
+  const size_t mean_size = dt_round_size(4 * size, 16);
+  float *const arena = dt_alloc_align_float(mean_size + 9 * size);
+  color_image mean = { arena, width, height, 4 };
+  color_image variance = { arena ? arena + mean_size : NULL, width, height, 9 };
   const size_t img_dimen = dt_round_size(mean.width, 16);
   size_t img_bak_sz;
   float *img_bak = dt_alloc_perthread_float(9*img_dimen, &img_bak_sz);
@@ -214,7 +205,6 @@ static void _guided_filter_tiling(color_image imgg,
     a_b.data[4*i+A_BLUE] = a_b_;
     a_b.data[4*i+B] = b_;
   }
-  _free_color_image(&variance);
 
   dt_box_mean(a_b.data, a_b.height, a_b.width, a_b.stride|BOXFILTER_KAHAN_SUM, w, 1);
 
@@ -236,7 +226,7 @@ static void _guided_filter_tiling(color_image imgg,
       img_out.data[i_imgg + (size_t)j_imgg * imgg.width] = CLAMP(res, min, max);
     }
   }
-  _free_color_image(&mean);
+  dt_free_align(arena);
 }
 
 void guided_filter(const float *const guide,
@@ -45,11 +45,17 @@
  */
 
 
-// Subtract bottom from top and store in result as a float; separate 'red' and 'black' pixels into
-// two contiguous regions
-static void _heal_sub(const float *const top_buffer, const float *const bottom_buffer,
-                      float *const restrict red_buffer, float *const restrict black_buffer,
-                      const size_t width, const size_t height)
+// the stamp is solved on a grid of half the size first, down to this size,
+// and the coarse solution is the starting point of the iterations on the
+// finer grid. Gauss-Seidel removes the high frequencies of the error in a
+// few iterations, the coarse grids take care of the low frequencies which
+// it is very slow at.
+#define DT_HEAL_COARSE_MIN 32
+
+// Store buffer as a float; separate 'red' and 'black' pixels into two contiguous regions
+static void _heal_split(const float *const buffer,
+                        float *const restrict red_buffer, float *const restrict black_buffer,
+                        const size_t width, const size_t height)
 {
   // how many red or black pixels per line?  For consistency, we need the larger of the two, so round up
   const size_t res_stride = 4 * ((width + 1) / 2);
@@ -67,8 +73,8 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
       const size_t idx = 4 * (row * width + 2*col);
       for_each_channel(c)
       {
-        buf1[4*col + c] = top_buffer[idx + c] - bottom_buffer[idx + c];
-        buf2[4*col + c] = top_buffer[idx+4 + c] - bottom_buffer[idx+4 + c];
+        buf1[4*col + c] = buffer[idx + c];
+        buf2[4*col + c] = buffer[idx+4 + c];
       }
     }
     if(width & 1)
@@ -79,7 +85,7 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
       const size_t idx = 4 * (row * width + (width-1));
       for_each_channel(c)
       {
-        buf1[4*res_idx + c] = top_buffer[idx + c] - bottom_buffer[idx + c];
+        buf1[4*res_idx + c] = buffer[idx + c];
         buf2[4*res_idx + c] = 0.0f;
       }
     }
@@ -91,10 +97,10 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
   memset(black_buffer + (height+1)*res_stride, 0, res_stride * sizeof(float));
 }
 
-// Add first to second and store in result, re-interleaving the 'red' and 'black' pixels
-static void _heal_add(const float *const restrict red_buffer, const float *const black_buffer,
-                      const float *const restrict second_buffer, float *const restrict result_buffer,
-                      const size_t width, const size_t height)
+// Store the 'red' and 'black' pixels back into result, re-interleaved
+static void _heal_merge(const float *const restrict red_buffer, const float *const black_buffer,
+                        float *const restrict result_buffer,
+                        const size_t width, const size_t height)
 {
   // how many red or black pixels per line?  For consistency, we need the larger of the two, so round up, then
   // add one to ensure a padding pixel on the right
@@ -113,8 +119,8 @@ static void _heal_add(const float *const restrict red_buffer, const float *const
       const size_t idx = 4 * (row * width + 2*col);
       for_each_channel(c)
       {
-        result_buffer[idx + c] = buf1[4*col + c] + second_buffer[idx + c];
-        result_buffer[idx + 4 + c] = buf2[4*col + c] + second_buffer[idx + 4 + c];
+        result_buffer[idx + c] = buf1[4*col + c];
+        result_buffer[idx + 4 + c] = buf2[4*col + c];
       }
     }
     if(width & 1)
@@ -123,7 +129,7 @@ static void _heal_add(const float *const restrict red_buffer, const float *const
       const size_t res_idx = (width-1)/2;
       const size_t idx = 4 * (row * width + (width-1));
       for_each_channel(c)
-        result_buffer[idx + c] = buf1[4*res_idx + c] + second_buffer[idx + c];
+        result_buffer[idx + c] = buf1[4*res_idx + c];
     }
   }
 }
@@ -346,6 +352,69 @@ cleanup:
 }
 
 
+// Solve the laplace equation for the masked pixels of the difference image, in-place.
+static void _heal_solve(float *const restrict diff, const float *const restrict mask,
+                        const size_t width, const size_t height, const int max_iter)
+{
+  // warm start from the solution on the coarser grid
+  if(width >= 2 * DT_HEAL_COARSE_MIN && height >= 2 * DT_HEAL_COARSE_MIN)
+  {
+    const size_t cwidth = width / 2;
+    const size_t cheight = height / 2;
+    float *const restrict cdiff = dt_alloc_align_float(4 * cwidth * cheight);
+    float *const restrict cmask = dt_alloc_align_float(cwidth * cheight);
+    if(cdiff && cmask)
+    {
+      // a coarse pixel is solved for as soon as one of its fine pixels is masked
+      DT_OMP_FOR()
+      for(size_t row = 0; row < cheight; row++)
+        for(size_t col = 0; col < cwidth; col++)
+        {
+          const size_t k = row * cwidth + col;
+          const size_t i = 2 * row * width + 2 * col;
+          cmask[k] = (mask[i] || mask[i + 1] || mask[i + width] || mask[i + width + 1]) ? 1.0f : 0.0f;
+          for_each_channel(c)
+            cdiff[4*k + c] = 0.25f * (diff[4*i + c] + diff[4*(i+1) + c]
+                                      + diff[4*(i+width) + c] + diff[4*(i+width+1) + c]);
+        }
+
+      _heal_solve(cdiff, cmask, cwidth, cheight, max_iter);
+
+      DT_OMP_FOR()
+      for(size_t row = 0; row < height; row++)
+        for(size_t col = 0; col < width; col++)
+        {
+          const size_t i = row * width + col;
+          if(!mask[i]) continue;
+          const size_t k = MIN(row / 2, cheight - 1) * cwidth + MIN(col / 2, cwidth - 1);
+          copy_pixel(diff + 4*i, cdiff + 4*k);
+        }
+    }
+    dt_free_align(cdiff);
+    dt_free_align(cmask);
+  }
+
+  const size_t subwidth = 4 * ((width+1)/2);  // round up to be able to handle odd widths
+  float *const restrict red_buffer = dt_alloc_align_float(subwidth * (height + 2));
+  float *const restrict black_buffer = dt_alloc_align_float(subwidth * (height + 2));
+  if(red_buffer == NULL || black_buffer == NULL)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "dt_heal: error allocating memory for healing");
+    goto cleanup;
+  }
+
+  /* store the difference split by 'red' and 'black' positions  */
+  _heal_split(diff, red_buffer, black_buffer, width, height);
+
+  _heal_laplace_loop(red_buffer, black_buffer, width, height, mask, max_iter);
+
+  _heal_merge(red_buffer, black_buffer, diff, width, height);
+
+cleanup:
+  if(red_buffer) dt_free_align(red_buffer);
+  if(black_buffer) dt_free_align(black_buffer);
+}
+
 /* Original Algorithm Design:
  *
  * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
@@ -359,26 +428,27 @@ void dt_heal(const float *const src_buffer, float *dest_buffer, const float *con
     dt_print(DT_DEBUG_ALWAYS, "dt_heal: full-color image required");
     return;
   }
-  const size_t subwidth = 4 * ((width+1)/2);  // round up to be able to handle odd widths
-  float *const restrict red_buffer = dt_alloc_align_float(subwidth * (height + 2));
-  float *const restrict black_buffer = dt_alloc_align_float(subwidth * (height + 2));
-  if(red_buffer == NULL || black_buffer == NULL)
+  const size_t npixels = (size_t)width * height;
+  float *const restrict diff_buffer = dt_alloc_align_float(4 * npixels);
+  if(diff_buffer == NULL)
   {
     dt_print(DT_DEBUG_ALWAYS, "dt_heal: error allocating memory for healing");
-    goto cleanup;
+    return;
   }
 
-  /* subtract pattern from image and store the result split by 'red' and 'black' positions  */
-  _heal_sub(dest_buffer, src_buffer, red_buffer, black_buffer, width, height);
+  /* subtract pattern from image */
+  DT_OMP_FOR_SIMD(aligned(diff_buffer:64))
+  for(size_t k = 0; k < 4 * npixels; k++)
+    diff_buffer[k] = dest_buffer[k] - src_buffer[k];
 
-  _heal_laplace_loop(red_buffer, black_buffer, width, height, mask_buffer, max_iter);
+  _heal_solve(diff_buffer, mask_buffer, width, height, max_iter);
 
   /* add solution to original image and store in dest */
-  _heal_add(red_buffer, black_buffer, src_buffer, dest_buffer, width, height);
+  DT_OMP_FOR_SIMD(aligned(diff_buffer:64))
+  for(size_t k = 0; k < 4 * npixels; k++)
+    dest_buffer[k] = diff_buffer[k] + src_buffer[k];
 
-cleanup:
-  if(red_buffer) dt_free_align(red_buffer);
-  if(black_buffer) dt_free_align(black_buffer);
+  dt_free_align(diff_buffer);
 }
 
 #ifdef HAVE_OPENCL
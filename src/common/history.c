@@ -587,44 +587,72 @@ gboolean dt_history_merge_module_into_history(dt_develop_t *dev_dest,
   return module_added;
 }
 
-static gboolean _history_copy_and_paste_on_image_merge(const dt_imgid_t imgid,
-                                                       const dt_imgid_t dest_imgid,
+struct dt_history_paste_source_t
+{
+  dt_imgid_t imgid;
+  GList *ops;
+  gboolean copy_iop_order;
+  gboolean copy_full;
+  // resolved on the first merge and shared by all destinations
+  gboolean resolved;
+  dt_develop_t dev;
+  GList *mod_list;
+  GList *autoinit_list;
+  GList *iop_list;
+  guint changed_tagid;
+  gboolean history_written;
+};
+
+dt_history_paste_source_t *dt_history_paste_source_new(const dt_imgid_t imgid,
                                                        GList *ops,
                                                        const gboolean copy_iop_order,
                                                        const gboolean copy_full)
 {
-  GList *modules_used = NULL;
+  dt_history_paste_source_t *src = g_malloc0(sizeof(dt_history_paste_source_t));
+  src->imgid = imgid;
+  src->ops = g_list_copy(ops);
+  src->copy_iop_order = copy_iop_order;
+  src->copy_full = copy_full;
+  if(copy_iop_order)
+    src->iop_list = dt_ioppr_get_iop_order_list(imgid, FALSE);
+  dt_tag_new("darktable|changed", &src->changed_tagid);
+  return src;
+}
 
-  dt_develop_t _dev_src = { 0 };
-  dt_develop_t _dev_dest = { 0 };
+void dt_history_paste_source_free(dt_history_paste_source_t *src)
+{
+  if(!src) return;
+  if(src->resolved)
+  {
+    dt_dev_cleanup(&src->dev);
+    g_list_free(src->mod_list);
+    g_list_free(src->autoinit_list);
+  }
+  g_list_free_full(src->iop_list, g_free);
+  g_list_free(src->ops);
+  g_free(src);
+}
 
-  dt_develop_t *dev_src = &_dev_src;
-  dt_develop_t *dev_dest = &_dev_dest;
+// load the source history and pick the modules to merge, once for all destinations
+static void _history_paste_source_resolve(dt_history_paste_source_t *src)
+{
+  if(src->resolved) return;
+  src->resolved = TRUE;
+
+  const dt_imgid_t imgid = src->imgid;
+  GList *ops = src->ops;
+  const gboolean copy_full = src->copy_full;
+  dt_develop_t *dev_src = &src->dev;
 
   // we will do the copy/paste on memory so we can deal with masks
   dt_dev_init(dev_src, FALSE);
-  dt_dev_init(dev_dest, FALSE);
-
   dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
-  dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
-
   dt_dev_read_history_ext(dev_src, imgid, TRUE);
-
-  // This prepends the default modules and converts just in case it's an empty history
-  dt_dev_read_history_ext(dev_dest, dest_imgid, TRUE);
-
   dt_ioppr_check_iop_order(dev_src, imgid,
                            "_history_copy_and_paste_on_image_merge ");
-  dt_ioppr_check_iop_order(dev_dest, dest_imgid,
-                           "_history_copy_and_paste_on_image_merge ");
-
   dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
-  dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
-
   dt_ioppr_check_iop_order(dev_src, imgid,
                            "_history_copy_and_paste_on_image_merge 1");
-  dt_ioppr_check_iop_order(dev_dest, dest_imgid,
-                           "_history_copy_and_paste_on_image_merge 1");
 
   GList *mod_list = NULL;
   GList *autoinit_list = NULL;
@@ -712,14 +740,40 @@ static gboolean _history_copy_and_paste_on_image_merge(const dt_imgid_t imgid,
   }
 
   // list were built in reverse order, so un-reverse it
-  mod_list = g_list_reverse(mod_list);
-  autoinit_list = g_list_reverse(autoinit_list);
+  src->mod_list = g_list_reverse(mod_list);
+  src->autoinit_list = g_list_reverse(autoinit_list);
+}
+
+static gboolean _history_copy_and_paste_on_image_merge(dt_history_paste_source_t *src,
+                                                       const dt_imgid_t dest_imgid)
+{
+  GList *modules_used = NULL;
+
+  _history_paste_source_resolve(src);
+
+  const gboolean copy_iop_order = src->copy_iop_order;
+  dt_develop_t *dev_src = &src->dev;
+  GList *mod_list = src->mod_list;
+
+  dt_develop_t _dev_dest = { 0 };
+  dt_develop_t *dev_dest = &_dev_dest;
+
+  dt_dev_init(dev_dest, FALSE);
+  dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
+
+  // This prepends the default modules and converts just in case it's an empty history
+  dt_dev_read_history_ext(dev_dest, dest_imgid, TRUE);
+  dt_ioppr_check_iop_order(dev_dest, dest_imgid,
+                           "_history_copy_and_paste_on_image_merge ");
+  dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
+  dt_ioppr_check_iop_order(dev_dest, dest_imgid,
+                           "_history_copy_and_paste_on_image_merge 1");
 
   // update iop-order list to have entries for the new modules
   if(!copy_iop_order)
     dt_ioppr_update_for_modules(dev_dest, mod_list, FALSE);
 
-  GList *ai = autoinit_list;
+  GList *ai = src->autoinit_list;
 
   for(GList *l = mod_list; l; l = g_list_next(l))
   {
@@ -741,22 +795,19 @@ static gboolean _history_copy_and_paste_on_image_merge(const dt_imgid_t imgid,
   // write history and forms to db
   dt_dev_write_history_ext(dev_dest, dest_imgid);
 
-  dt_dev_cleanup(dev_src);
   dt_dev_cleanup(dev_dest);
 
-  g_list_free(mod_list);
   g_list_free(modules_used);
-  g_list_free(autoinit_list);
 
   return FALSE;
 }
 
-static gboolean _history_copy_and_paste_on_image_overwrite(const dt_imgid_t imgid,
-                                                           const dt_imgid_t dest_imgid,
-                                                           GList *ops,
-                                                           const gboolean copy_iop_order,
-                                                           const gboolean copy_full)
+static gboolean _history_copy_and_paste_on_image_overwrite(dt_history_paste_source_t *src,
+                                                           const dt_imgid_t dest_imgid)
 {
+  const dt_imgid_t imgid = src->imgid;
+  GList *ops = src->ops;
+  const gboolean copy_full = src->copy_full;
   sqlite3_stmt *stmt;
 
   // replace history stack
@@ -908,18 +959,16 @@ static gboolean _history_copy_and_paste_on_image_overwrite(const dt_imgid_t imgi
   else
   {
     // since the history and masks where deleted we can do a merge
-    return _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops, copy_iop_order, copy_full);
+    return _history_copy_and_paste_on_image_merge(src, dest_imgid);
   }
 }
 
-gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
-                                            const dt_imgid_t dest_imgid,
-                                            const gboolean merge,
-                                            GList *ops,
-                                            const gboolean copy_iop_order,
-                                            const gboolean copy_full,
-                                            const gboolean sync)
+gboolean dt_history_paste_source_on_image(dt_history_paste_source_t *src,
+                                          const dt_imgid_t dest_imgid,
+                                          const gboolean merge,
+                                          const gboolean sync)
 {
+  const dt_imgid_t imgid = src->imgid;
   if(imgid == dest_imgid) return FALSE; // not pasted
 
   if(!dt_is_valid_imgid(imgid))
@@ -932,8 +981,9 @@ gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
   dt_lock_image_pair(imgid, dest_imgid);
 
   // be sure the current history is written before pasting some other history data
-  if(dt_view_get_current() == DT_VIEW_DARKROOM)
+  if(!src->history_written && dt_view_get_current() == DT_VIEW_DARKROOM)
     dt_dev_write_history(darktable.develop);
+  src->history_written = TRUE;
 
   dt_undo_lt_history_t *hist = dt_history_snapshot_item_init();
   hist->imgid = dest_imgid;
@@ -941,9 +991,9 @@ gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
 
   GList *iop_list = NULL;
 
-  if(copy_iop_order)
+  if(src->copy_iop_order)
   {
-    iop_list = dt_ioppr_get_iop_order_list(imgid, FALSE);
+    iop_list = dt_ioppr_iop_order_copy_deep(src->iop_list);
 
     // but we also want to keep the multi-instance on the destination if merge is active
     if(merge)
@@ -961,8 +1011,8 @@ gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
   }
 
   const gboolean ret_val = merge
-    ? _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops, copy_iop_order, copy_full)
-    : _history_copy_and_paste_on_image_overwrite(imgid, dest_imgid, ops, copy_iop_order, copy_full);
+    ? _history_copy_and_paste_on_image_merge(src, dest_imgid)
+    : _history_copy_and_paste_on_image_overwrite(src, dest_imgid);
 
   if(iop_list)
   {
@@ -981,9 +1031,7 @@ gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
   dt_overlay_add_from_history(dest_imgid);
 
   /* attach changed tag reflecting actual change */
-  guint tagid = 0;
-  dt_tag_new("darktable|changed", &tagid);
-  dt_tag_attach(tagid, dest_imgid, FALSE, FALSE);
+  dt_tag_attach(src->changed_tagid, dest_imgid, FALSE, FALSE);
   /* set change_timestamp */
   dt_image_cache_set_change_timestamp(dest_imgid);
 
@@ -1016,6 +1064,30 @@ gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
   return !ret_val;
 }
 
+gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
+                                            const dt_imgid_t dest_imgid,
+                                            const gboolean merge,
+                                            GList *ops,
+                                            const gboolean copy_iop_order,
+                                            const gboolean copy_full,
+                                            const gboolean sync)
+{
+  if(imgid == dest_imgid) return FALSE; // not pasted
+
+  if(!dt_is_valid_imgid(imgid))
+  {
+    dt_control_log(_("you need to copy history from an"
+                     " image before you paste it onto another"));
+    return FALSE; // not pasted
+  }
+
+  dt_history_paste_source_t *src =
+    dt_history_paste_source_new(imgid, ops, copy_iop_order, copy_full);
+  const gboolean res = dt_history_paste_source_on_image(src, dest_imgid, merge, sync);
+  dt_history_paste_source_free(src);
+  return res;
+}
+
 static char *_history_item_as_string(const char *name, const gboolean enabled)
 {
   return g_strconcat(enabled ? "●" : "○", "  ", name, NULL);
@@ -1475,6 +1547,162 @@ gboolean dt_history_compress(const dt_imgid_t imgid)
   return (test == 1);
 }
 
+static GList *_history_compress_query(const char *query)
+{
+  GList *imgs = NULL;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+  return g_list_reverse(imgs);
+}
+
+/* Please note: dt_history_compress_list
+  - does what dt_history_compress() does to the database for all the
+    images at once, with one statement per step instead of one per image
+  - doesn't take the image locks, callers keep away from the image
+    being edited in darkroom
+*/
+GList *dt_history_compress_list(const GList *imgs)
+{
+  if(!imgs) return NULL;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  dt_database_start_transaction(darktable.db);
+
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.compress_images", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.compress_renum", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT OR IGNORE INTO memory.compress_images (imgid)"
+                              " VALUES (?1)",
+                              -1, &stmt, NULL);
+  for(const GList *l = imgs; l; l = g_list_next(l))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, GPOINTER_TO_INT(l->data));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+
+  // as dt_history_compress(), only the images with history_end at the
+  // top of their history are compressed
+  // clang-format off
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "UPDATE memory.compress_images"
+                        " SET history_end = IFNULL((SELECT history_end FROM main.images"
+                        "                           WHERE id = compress_images.imgid), 0),"
+                        "     manager = EXISTS (SELECT 1 FROM main.history"
+                        "                       WHERE imgid = compress_images.imgid"
+                        "                         AND operation = 'mask_manager' AND num = 0)",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "DELETE FROM memory.compress_images"
+                        " WHERE history_end <= IFNULL((SELECT MAX(num) FROM main.history"
+                        "                              WHERE imgid = compress_images.imgid), 0)",
+                        NULL, NULL, NULL);
+
+  // compress history, keep disabled modules as documented
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "DELETE FROM main.history"
+                        " WHERE imgid IN (SELECT imgid FROM memory.compress_images)"
+                        "   AND num NOT IN"
+                        "     (SELECT MAX(k.num)"
+                        "      FROM main.history AS k, memory.compress_images AS c"
+                        "      WHERE k.imgid = history.imgid AND c.imgid = k.imgid"
+                        "        AND k.num < c.history_end"
+                        "      GROUP BY k.operation, k.multi_priority)",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "DELETE FROM main.history"
+                        " WHERE imgid IN (SELECT imgid FROM memory.compress_images)"
+                        "   AND operation = 'mask_manager'",
+                        NULL, NULL, NULL);
+
+  // compress masks history
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "DELETE FROM main.masks_history"
+                        " WHERE imgid IN (SELECT imgid FROM memory.compress_images)"
+                        "   AND num NOT IN"
+                        "     (SELECT MAX(k.num)"
+                        "      FROM main.masks_history AS k, memory.compress_images AS c"
+                        "      WHERE k.imgid = masks_history.imgid AND c.imgid = k.imgid"
+                        "        AND k.num < c.history_end)",
+                        NULL, NULL, NULL);
+
+  // the masks left are owned by a mask manager at slot 0
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "UPDATE memory.compress_images"
+                        " SET masks = EXISTS (SELECT 1 FROM main.masks_history"
+                        "                     WHERE imgid = compress_images.imgid)",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "UPDATE main.masks_history SET num = 0"
+                        " WHERE imgid IN (SELECT imgid FROM memory.compress_images WHERE masks)",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "UPDATE main.history SET num = num + 1"
+                        " WHERE imgid IN (SELECT imgid FROM memory.compress_images"
+                        "                 WHERE masks AND NOT manager)",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "INSERT INTO main.history"
+                        " (imgid, num, operation, op_params, module, enabled,"
+                        "  blendop_params, blendop_version, multi_priority, multi_name)"
+                        " SELECT imgid, 0, 'mask_manager', NULL, 1, 0, NULL, 0, 0, ''"
+                        " FROM memory.compress_images WHERE masks",
+                        NULL, NULL, NULL);
+
+  // renumber to remove the leaks. the new numbers are computed apart
+  // from the history so that the update doesn't see its own changes
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "INSERT OR IGNORE INTO memory.compress_renum (imgid, num, new_num)"
+                        " SELECT h.imgid, h.num,"
+                        "        (SELECT COUNT(DISTINCT k.num) FROM main.history AS k"
+                        "         WHERE k.imgid = h.imgid AND k.num < h.num)"
+                        " FROM main.history AS h"
+                        " WHERE h.imgid IN (SELECT imgid FROM memory.compress_images)",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "UPDATE main.history"
+                        " SET num = (SELECT new_num FROM memory.compress_renum AS r"
+                        "            WHERE r.imgid = history.imgid AND r.num = history.num)"
+                        " WHERE imgid IN (SELECT imgid FROM memory.compress_images)",
+                        NULL, NULL, NULL);
+  // history_end as set by dt_history_compress(), which leaves it at 0
+  // when the history was at most a single entry at slot 0
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "UPDATE main.images"
+                        " SET history_end = (SELECT CASE WHEN MAX(r.num) > 0 THEN COUNT(*) ELSE 0 END"
+                        "                    FROM memory.compress_renum AS r"
+                        "                    WHERE r.imgid = images.id)"
+                        " WHERE id IN (SELECT imgid FROM memory.compress_images)",
+                        NULL, NULL, NULL);
+  // clang-format on
+
+  GList *compressed = _history_compress_query("SELECT imgid FROM memory.compress_images"
+                                              " ORDER BY imgid");
+  for(GList *l = compressed; l; l = g_list_next(l))
+    dt_history_hash_write_from_history(GPOINTER_TO_INT(l->data), DT_HISTORY_HASH_CURRENT);
+
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.compress_images", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.compress_renum", NULL, NULL, NULL);
+
+  dt_database_release_transaction(darktable.db);
+
+  dt_show_times_f(&start, "[dt_history_compress_list]", "%u of %u images",
+                  g_list_length(compressed), g_list_length((GList *)imgs));
+
+  for(GList *l = compressed; l; l = g_list_next(l))
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, GPOINTER_TO_INT(l->data));
+
+  return compressed;
+}
+
 gboolean dt_history_check_module_exists(const dt_imgid_t imgid,
                                         const char *operation,
                                         const gboolean enabled)
@@ -1559,8 +1787,9 @@ GList *dt_history_duplicate(GList *hist)
     if(new->blend_params)
       memcpy(new->blend_params, old->blend_params, sizeof(dt_develop_blend_params_t));
 
+    // forms held by history items are never changed in place, share them
     if(old->forms)
-      new->forms = dt_masks_dup_forms_deep(old->forms, NULL);
+      new->forms = dt_masks_share_forms(old->forms);
 
     result = g_list_prepend(result, new);
   }
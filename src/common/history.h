@@ -89,6 +89,23 @@ gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
                                             const gboolean copy_full,
                                             const gboolean sync);
 
+/** the history of an image resolved once for pasting onto many images. the
+    source modules and their params are loaded on the first merge and shared
+    by all destinations */
+typedef struct dt_history_paste_source_t dt_history_paste_source_t;
+
+dt_history_paste_source_t *dt_history_paste_source_new(const dt_imgid_t imgid,
+                                                       GList *ops,
+                                                       const gboolean copy_iop_order,
+                                                       const gboolean copy_full);
+void dt_history_paste_source_free(dt_history_paste_source_t *src);
+
+/** as dt_history_copy_and_paste_on_image() with a resolved source */
+gboolean dt_history_paste_source_on_image(dt_history_paste_source_t *src,
+                                          const dt_imgid_t dest_imgid,
+                                          const gboolean merge,
+                                          const gboolean sync);
+
 /** delete all history for the given image */
 void dt_history_delete_on_image(const dt_imgid_t imgid);
 
@@ -125,6 +142,10 @@ gboolean dt_history_delete(const dt_imgid_t imgid,
 /** compress history stack */
 gboolean dt_history_compress(const dt_imgid_t imgid); // syncs to sidecar, says whether compress was successful
 void dt_history_compress_on_image(const dt_imgid_t imgid); // database only
+/** compress the history of many images in one transaction, database
+    only. returns the images actually compressed, whose sidecars are left
+    to the caller, to be freed with g_list_free() */
+GList *dt_history_compress_list(const GList *imgs);
 
 /** truncate history stack */
 void dt_history_truncate_on_image(const dt_imgid_t imgid,
@@ -17,6 +17,9 @@
 */
 
 #include "common/image.h"
+#ifdef HAVE_AI
+#include "common/ai/segmentation.h"
+#endif
 #include "common/collection.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
@@ -43,6 +46,7 @@
 #include "imageio/imageio_libraw.h"
 #include "win/filepath.h"
 #ifdef USE_LUA
+#include "lua/events.h"
 #include "lua/image.h"
 #endif
 #include <assert.h>
@@ -56,6 +60,15 @@
 #include <glob.h>
 #endif
 #include <glib/gstdio.h>
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 typedef struct dt_undo_monochrome_t
 {
@@ -672,6 +685,7 @@ static void _pop_undo(gpointer user_data,
   {
     int i = 0;
 
+    dt_image_cache_write_batch_begin();
     for(GList *list = (GList *)data; list; list = g_list_next(list))
     {
       dt_undo_geotag_t *undogeotag = list->data;
@@ -683,6 +697,7 @@ static void _pop_undo(gpointer user_data,
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(undogeotag->imgid));
       i++;
     }
+    dt_image_cache_write_batch_end();
     if(i > 1)
       dt_control_log((action == DT_ACTION_UNDO)
                      ? ngettext("geo-location undone for %d image",
@@ -697,6 +712,7 @@ static void _pop_undo(gpointer user_data,
   {
     int i = 0;
 
+    dt_image_cache_write_batch_begin();
     for(GList *list = (GList *)data; list; list = g_list_next(list))
     {
       dt_undo_datetime_t *undodatetime = list->data;
@@ -707,6 +723,7 @@ static void _pop_undo(gpointer user_data,
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(undodatetime->imgid));
       i++;
     }
+    dt_image_cache_write_batch_end();
     if(i > 1)
       dt_control_log((action == DT_ACTION_UNDO)
                      ? ngettext("date/time undone for %d image",
@@ -762,6 +779,7 @@ static void _image_set_location(GList *imgs,
                                 GList **undo,
                                 const gboolean undo_on)
 {
+  dt_image_cache_write_batch_begin();
   for(GList *images = imgs; images; images = g_list_next(images))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(images->data);
@@ -779,6 +797,7 @@ static void _image_set_location(GList *imgs,
 
     _set_location(imgid, geoloc);
   }
+  dt_image_cache_write_batch_end();
 }
 
 void dt_image_set_locations(const GList *imgs,
@@ -824,6 +843,7 @@ static void _image_set_images_locations(const GList *img,
                                         const gboolean undo_on)
 {
   int i = 0;
+  dt_image_cache_write_batch_begin();
   for(GList *imgs = (GList *)img; imgs; imgs = g_list_next(imgs))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
@@ -842,6 +862,7 @@ static void _image_set_images_locations(const GList *img,
     _set_location(imgid, geoloc);
     i++;
   }
+  dt_image_cache_write_batch_end();
 }
 
 void dt_image_set_images_locations(const GList *imgs,
@@ -1611,10 +1632,158 @@ void dt_image_remove(const dt_imgid_t imgid)
 
   // also clear all thumbnails in mipmap_cache.
   dt_mipmap_cache_remove(imgid);
+#ifdef HAVE_AI
+  dt_seg_disk_cache_remove(imgid);
+#endif
 
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGE_REMOVED, imgid, 0);
 }
 
+static int32_t _image_remove_thumbnails_job_run(dt_job_t *job)
+{
+  GList *imgs = dt_control_job_get_params(job);
+  for(const GList *l = imgs; l; l = g_list_next(l))
+  {
+    dt_mipmap_cache_remove(GPOINTER_TO_INT(l->data));
+#ifdef HAVE_AI
+    dt_seg_disk_cache_remove(GPOINTER_TO_INT(l->data));
+#endif
+  }
+  return 0;
+}
+
+static GList *_image_removed_query(const char *query)
+{
+  GList *imgs = NULL;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+  return g_list_reverse(imgs);
+}
+
+GList *dt_image_remove_list(const GList *imgs)
+{
+  if(!imgs) return NULL;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  dt_database_start_transaction(darktable.db);
+
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.removed_images", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT OR IGNORE INTO memory.removed_images (imgid)"
+                              " VALUES (?1)",
+                              -1, &stmt, NULL);
+  for(const GList *l = imgs; l; l = g_list_next(l))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, GPOINTER_TO_INT(l->data));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+
+  // the local copies are removed first, the images whose original file
+  // can't be reached stay in the library
+  gchar *query = g_strdup_printf("SELECT i.id"
+                                 " FROM main.images AS i, memory.removed_images AS r"
+                                 " WHERE i.id = r.imgid AND i.flags & %d",
+                                 DT_IMAGE_LOCAL_COPY);
+  GList *local = _image_removed_query(query);
+  g_free(query);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "DELETE FROM memory.removed_images WHERE imgid = ?1",
+                              -1, &stmt, NULL);
+  for(GList *l = local; l; l = g_list_next(l))
+  {
+    if(dt_image_local_copy_reset(GPOINTER_TO_INT(l->data)))
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, GPOINTER_TO_INT(l->data));
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+    }
+  }
+  sqlite3_finalize(stmt);
+  g_list_free(local);
+
+  // only the groups keeping some of their images need a new leader,
+  // one image at a time as each change moves the leader of the others
+  // clang-format off
+  GList *regroup = _image_removed_query
+    ("SELECT i.id"
+     " FROM main.images AS i, memory.removed_images AS r"
+     " WHERE i.id = r.imgid"
+     "   AND EXISTS (SELECT 1 FROM main.images AS o"
+     "               WHERE o.group_id = i.group_id"
+     "                 AND o.id NOT IN (SELECT imgid FROM memory.removed_images))");
+  // clang-format on
+  for(GList *l = regroup; l; l = g_list_next(l))
+  {
+    const dt_imgid_t imgid = GPOINTER_TO_INT(l->data);
+    const dt_image_t *img = dt_image_cache_get(imgid, 'r');
+    const dt_imgid_t old_group_id = img ? img->group_id : NO_IMGID;
+    dt_image_cache_read_release(img);
+
+    const dt_imgid_t new_group_id = dt_grouping_remove_from_group(imgid);
+    if(darktable.gui && darktable.gui->expanded_group_id == old_group_id)
+      darktable.gui->expanded_group_id = new_group_id;
+  }
+  g_list_free(regroup);
+
+  GList *removed = _image_removed_query("SELECT imgid FROM memory.removed_images"
+                                        " ORDER BY imgid");
+
+  // make sure we remove from the cache first, or else the cache will
+  // look for the images in sql
+  for(GList *l = removed; l; l = g_list_next(l))
+  {
+    const dt_imgid_t imgid = GPOINTER_TO_INT(l->data);
+    dt_image_cache_remove(imgid);
+    // a group removed as a whole is no longer expanded
+    if(darktable.gui && darktable.gui->expanded_group_id == imgid)
+      darktable.gui->expanded_group_id = NO_IMGID;
+  }
+
+  // due to foreign keys, all entries from tables having references to
+  // the images are deleted as well
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "DELETE FROM main.images"
+                        " WHERE id IN (SELECT imgid FROM memory.removed_images)",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.removed_images", NULL, NULL, NULL);
+
+  dt_database_release_transaction(darktable.db);
+
+  dt_show_times_f(&start, "[dt_image_remove_list]", "%u of %u images",
+                  g_list_length(removed), g_list_length((GList *)imgs));
+
+  for(GList *l = removed; l; l = g_list_next(l))
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGE_REMOVED, GPOINTER_TO_INT(l->data), 0);
+
+  // the thumbnails on disk go in the background
+  if(removed)
+  {
+    dt_job_t *job = dt_control_job_create(&_image_remove_thumbnails_job_run,
+                                          "remove thumbnails");
+    if(job)
+    {
+      dt_control_job_set_params(job, g_list_copy(removed), (dt_job_destroy_callback)g_list_free);
+      dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG, job);
+    }
+    else
+    {
+      for(GList *l = removed; l; l = g_list_next(l))
+        dt_mipmap_cache_remove(GPOINTER_TO_INT(l->data));
+    }
+  }
+
+  return removed;
+}
+
 gboolean dt_image_altered(const dt_imgid_t imgid)
 {
   const dt_history_hash_t status = dt_history_hash_get_status(imgid);
@@ -2084,17 +2253,23 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   g_free(normalized_filename);
 
 #ifdef USE_LUA
-  //Synchronous calling of lua post-import-image events
-  if(lua_locking)
-    dt_lua_lock();
+  //Synchronous calling of lua post-import-image events, the lua lock
+  //is only taken when a script listens to them
+  if(dt_lua_event_in_use("post-import-image"))
+  {
+    if(lua_locking)
+      dt_lua_lock();
 
-  lua_State *L = darktable.lua_state.state;
+    lua_State *L = darktable.lua_state.state;
 
-  luaA_push(L, dt_lua_image_t, &id);
-  dt_lua_event_trigger(L, "post-import-image", 1);
+    luaA_push(L, dt_lua_image_t, &id);
+    dt_lua_event_trigger(L, "post-import-image", 1);
 
-  if(lua_locking)
-    dt_lua_unlock();
+    if(lua_locking)
+      dt_lua_unlock();
+  }
+  if(dt_lua_event_in_use("post-import-batch"))
+    dt_lua_event_batch_add("post-import-batch", id);
 #endif
 
   if(raise_signals)
@@ -2532,6 +2707,107 @@ gboolean dt_image_move(const dt_imgid_t imgid,
   return dt_image_rename(imgid, filmid, NULL);
 }
 
+#ifdef __linux__
+// copy the data of fd_in into fd_out in the kernel: a reflink on file
+// systems sharing extents (btrfs, xfs), else copy_file_range which also
+// lets network file systems copy on the server. FALSE if neither is
+// supported here, the caller falls back to a copy through user space.
+static gboolean _image_file_copy_kernel(const int fd_in,
+                                        const int fd_out,
+                                        const off_t size,
+                                        int *err)
+{
+  *err = 0;
+#ifdef FICLONE
+  if(ioctl(fd_out, FICLONE, fd_in) == 0) return TRUE;
+#endif
+#ifdef SYS_copy_file_range
+  off_t done = 0;
+  while(done < size)
+  {
+    const ssize_t n = syscall(SYS_copy_file_range, fd_in, NULL, fd_out, NULL,
+                              (size_t)(size - done), 0u);
+    if(n > 0)
+      done += n;
+    else if(n == 0)
+      break;
+    else if(errno == EINTR)
+      continue;
+    else
+    {
+      // nothing written yet: not supported between these files
+      if(done == 0
+         && (errno == ENOSYS || errno == EXDEV || errno == EINVAL
+             || errno == EOPNOTSUPP || errno == EBADF))
+        return FALSE;
+      *err = errno;
+      return TRUE;
+    }
+  }
+  if(done == size) return TRUE;
+  *err = EIO;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+#endif
+
+// copy the file src to dest, same as g_file_copy() without overwriting:
+// fails with G_IO_ERROR_EXISTS if dest is already there.
+static gboolean _image_file_copy(GFile *src,
+                                 GFile *dest,
+                                 GError **error)
+{
+#ifdef __linux__
+  gchar *srcpath = g_file_get_path(src);
+  gchar *destpath = g_file_get_path(dest);
+  struct stat st;
+  int fd_in = -1;
+  int fd_out = -1;
+  int err = 0;
+  gboolean copied = FALSE;
+
+  if(srcpath && destpath
+     && (fd_in = open(srcpath, O_RDONLY | O_CLOEXEC)) >= 0
+     && fstat(fd_in, &st) == 0
+     && S_ISREG(st.st_mode))
+  {
+    fd_out = open(destpath, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777);
+    if(fd_out < 0 && errno == EEXIST)
+    {
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                  _("error copying `%s': target file exists"), destpath);
+      close(fd_in);
+      g_free(srcpath);
+      g_free(destpath);
+      return FALSE;
+    }
+    if(fd_out >= 0)
+    {
+      copied = _image_file_copy_kernel(fd_in, fd_out, st.st_size, &err);
+      if(copied && !err)
+      {
+        // keep the modification time, as G_FILE_COPY_NONE does
+        const struct timespec times[2] = { st.st_atim, st.st_mtim };
+        futimens(fd_out, times);
+      }
+      if(close(fd_out) != 0 && copied && !err) err = errno;
+      if(!copied || err) g_unlink(destpath);
+    }
+  }
+  if(fd_in >= 0) close(fd_in);
+
+  if(copied && err)
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(err),
+                _("error copying `%s': %s"), destpath, g_strerror(err));
+  g_free(srcpath);
+  g_free(destpath);
+  if(copied) return !err;
+#endif
+  return g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, error);
+}
+
 dt_imgid_t dt_image_copy_rename(const dt_imgid_t imgid,
                                 const dt_filmid_t filmid,
                                 const gchar *newname)
@@ -2596,8 +2872,7 @@ dt_imgid_t dt_image_copy_rename(const dt_imgid_t imgid,
     // copy image to new folder
     // if image file already exists, continue
     GError *gerror = NULL;
-    gboolean copyStatus =
-      g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &gerror);
+    const gboolean copyStatus = _image_file_copy(src, dest, &gerror);
 
     if(copyStatus || g_error_matches(gerror, G_IO_ERROR, G_IO_ERROR_EXISTS))
     {
@@ -2835,7 +3110,7 @@ gboolean dt_image_local_copy_set(const dt_imgid_t imgid)
     // copy image to cache directory
     GError *gerror = NULL;
 
-    if(!g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &gerror))
+    if(!_image_file_copy(src, dest, &gerror))
     {
       dt_control_log(_("cannot create local copy."));
       g_object_unref(dest);
@@ -2858,6 +3133,83 @@ gboolean dt_image_local_copy_set(const dt_imgid_t imgid)
   return FALSE;
 }
 
+typedef struct _local_copy_file_t
+{
+  gchar *src;
+  gchar *dest;
+} _local_copy_file_t;
+
+static void _image_local_copy_worker(gpointer data,
+                                     gpointer user_data)
+{
+  _local_copy_file_t *f = data;
+
+  // copy under a temporary name so that an interrupted copy is never
+  // taken for a complete local copy
+  gchar *part = g_strconcat(f->dest, ".part", NULL);
+  g_unlink(part);
+  GFile *src = g_file_new_for_path(f->src);
+  GFile *dest = g_file_new_for_path(part);
+  GError *gerror = NULL;
+  if(_image_file_copy(src, dest, &gerror))
+  {
+    if(g_rename(part, f->dest) != 0) g_unlink(part);
+  }
+  else
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[local copy] cannot copy `%s': %s",
+             f->src, gerror ? gerror->message : "");
+    g_unlink(part);
+  }
+  g_clear_error(&gerror);
+  g_object_unref(dest);
+  g_object_unref(src);
+  g_free(part);
+
+  g_free(f->src);
+  g_free(f->dest);
+  g_free(f);
+}
+
+void dt_image_local_copy_prefetch(const GList *imgs)
+{
+  // a few copies in flight hide the latency of network shares, more
+  // would just compete for the same disk
+  GThreadPool *pool = NULL;
+  GHashTable *seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for(const GList *l = imgs; l; l = g_list_next(l))
+  {
+    const dt_imgid_t imgid = GPOINTER_TO_INT(l->data);
+    gchar srcpath[PATH_MAX] = { 0 };
+    gchar destpath[PATH_MAX] = { 0 };
+
+    dt_image_full_path(imgid, srcpath, sizeof(srcpath), NULL);
+    _image_local_copy_full_path(imgid, destpath, sizeof(destpath));
+
+    // duplicates share the local copy of their file
+    if(!*destpath
+       || g_hash_table_contains(seen, destpath)
+       || g_file_test(destpath, G_FILE_TEST_EXISTS)
+       || !g_file_test(srcpath, G_FILE_TEST_IS_REGULAR))
+      continue;
+    g_hash_table_add(seen, g_strdup(destpath));
+
+    if(!pool)
+      pool = g_thread_pool_new(_image_local_copy_worker, NULL,
+                               CLAMP(dt_get_num_procs(), 1, 4), FALSE, NULL);
+    if(!pool) break;
+
+    _local_copy_file_t *f = g_malloc(sizeof(_local_copy_file_t));
+    f->src = g_strdup(srcpath);
+    f->dest = g_strdup(destpath);
+    g_thread_pool_push(pool, f, NULL);
+  }
+
+  if(pool) g_thread_pool_free(pool, FALSE, TRUE);
+  g_hash_table_destroy(seen);
+}
+
 static gboolean _nb_other_local_copy_for(const dt_imgid_t imgid)
 {
   sqlite3_stmt *stmt;
@@ -3126,6 +3478,7 @@ static void _image_set_datetimes(const GList *img,
                                  const gboolean undo_on)
 {
   int i = 0;
+  dt_image_cache_write_batch_begin();
   for(GList *imgs = (GList *)img; imgs; imgs = g_list_next(imgs))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
@@ -3145,6 +3498,7 @@ static void _image_set_datetimes(const GList *img,
     _set_datetime(imgid, datetime->dt);
     i++;
   }
+  dt_image_cache_write_batch_end();
 }
 
 void dt_image_set_datetimes(const GList *imgs,
@@ -3171,6 +3525,7 @@ static void _image_set_datetime(const GList *img,
                                 GList **undo,
                                 const gboolean undo_on)
 {
+  dt_image_cache_write_batch_begin();
   for(GList *imgs = (GList *)img; imgs;  imgs = g_list_next(imgs))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
@@ -3187,6 +3542,7 @@ static void _image_set_datetime(const GList *img,
 
     _set_datetime(imgid, datetime);
   }
+  dt_image_cache_write_batch_end();
 }
 
 void dt_image_set_datetime(const GList *imgs,
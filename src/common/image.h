@@ -466,6 +466,10 @@ dt_imgid_t dt_image_import_lua(const dt_filmid_t film_id,
                                const gboolean override_ignore_nonraws);
 /** removes the given image from the database. */
 void dt_image_remove(const dt_imgid_t imgid);
+/** removes the given images from the database in one go, the thumbnails
+ *  are deleted in the background. returns the list of the images
+ *  actually removed, to be freed with g_list_free(). */
+GList *dt_image_remove_list(const GList *imgs);
 /** duplicates the given image in the database with the duplicate
     getting the supplied version number. if that version already
     exists just return the imgid without producing new
@@ -596,6 +600,9 @@ dt_imgid_t dt_image_copy_rename(const dt_imgid_t imgid,
                                 const dt_filmid_t filmid,
                                 const gchar *newname);
 gboolean dt_image_local_copy_set(const dt_imgid_t imgid);
+/** copy the files of the images into the local copy cache, a few at a
+ *  time. dt_image_local_copy_set() then only has to flag them. */
+void dt_image_local_copy_prefetch(const GList *imgs);
 gboolean dt_image_local_copy_reset(const dt_imgid_t imgid);
 /* check whether it is safe to remove a file */
 gboolean dt_image_safe_remove(const dt_imgid_t imgid);
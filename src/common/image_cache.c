@@ -22,6 +22,7 @@
 #include "common/exif.h"
 #include "common/image.h"
 #include "common/datetime.h"
+#include "common/memory_account.h"
 #include "control/conf.h"
 #include "develop/develop.h"
 
@@ -36,11 +37,12 @@ static void _image_cache_allocate(void *data,
   dt_image_t *img = g_malloc0(sizeof(dt_image_t));
   dt_image_init(img);
   entry->data = img;
+  dt_mem_account_alloc(DT_MEM_ACCOUNT_IMAGE_CACHE, sizeof(dt_image_t));
   // load stuff from db and store in cache:
-  sqlite3_stmt *stmt;
+  // this runs for every image entering the cache, reuse the statement
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
+  sqlite3_stmt *stmt = dt_database_prepare_cached(
+      darktable.db,
       "SELECT mi.id, group_id, film_id, width, height, filename,"
       "       mk.name, md.name, ln.name,"
       "       exposure, aperture, iso, focal_length, datetime_taken, flags,"
@@ -59,8 +61,7 @@ static void _image_cache_allocate(void *data,
       "       LEFT JOIN main.flash AS fl ON fl.id = mi.flash_id"
       "       LEFT JOIN main.exposure_program AS ep ON ep.id = mi.exposure_program_id"
       "       LEFT JOIN main.metering_mode AS mm ON mm.id = mi.metering_mode_id"
-      "  WHERE mi.id = ?1",
-      -1, &stmt, NULL);
+      "  WHERE mi.id = ?1");
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, entry->key);
 
@@ -195,7 +196,7 @@ static void _image_cache_allocate(void *data,
              "[image_cache_allocate] failed to open image %" PRIu32 " from database: %s",
              entry->key, sqlite3_errmsg(dt_database_get(darktable.db)));
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   img->cache_entry = entry; // init backref
   // could downgrade lock write->read on entry->lock if we were using
   // concurrencykit..
@@ -208,6 +209,7 @@ static void _image_cache_deallocate(void *data, dt_cache_entry_t *entry)
   g_list_free_full(img->dng_gain_maps, g_free);
   g_free(img);
   entry->data = NULL;
+  dt_mem_account_free(DT_MEM_ACCOUNT_IMAGE_CACHE, sizeof(dt_image_t));
 }
 
 void dt_image_cache_init()
@@ -221,22 +223,57 @@ void dt_image_cache_init()
   //       can we get away with a fixed size?
   const uint32_t max_mem = 50 * 1024 * 1024;
   const uint32_t num = (uint32_t)(1.5f * max_mem / sizeof(dt_image_t));
-  dt_cache_init(&cache->cache, sizeof(dt_image_t), max_mem);
+  // all threads generating thumbnails or importing hit this cache
+  dt_cache_init_sharded(&cache->cache, sizeof(dt_image_t), max_mem, dt_get_num_threads());
   dt_cache_set_allocate_callback(&cache->cache, &_image_cache_allocate, cache);
   dt_cache_set_cleanup_callback(&cache->cache, &_image_cache_deallocate, cache);
 
   dt_print(DT_DEBUG_CACHE, "[image_cache] has %d entries", num);
 }
 
+#define DT_IMAGE_CACHE_BATCH_ROWS 500
+#define DT_IMAGE_CACHE_BATCH_MS 1000.0
+
+// the write-back batch of this thread, see dt_image_cache_write_batch_begin()
+static __thread int _batch_depth = 0;
+static __thread int _batch_rows = 0;
+static __thread double _batch_start = 0.0;
+
+void dt_image_cache_write_batch_begin(void)
+{
+  if(_batch_depth++ == 0)
+  {
+    dt_database_start_transaction(darktable.db);
+    _batch_rows = 0;
+    _batch_start = dt_get_wtime();
+  }
+}
+
+void dt_image_cache_write_batch_end(void)
+{
+  if(_batch_depth <= 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[image_cache] write batch ended outside of a batch");
+    return;
+  }
+  if(--_batch_depth == 0)
+  {
+    dt_database_release_transaction(darktable.db);
+    dt_print(DT_DEBUG_CACHE, "[image_cache] write batch of %d rows done", _batch_rows);
+  }
+}
+
 void dt_image_cache_cleanup()
 {
   dt_image_cache_t *cache = darktable.image_cache;
   if(!cache) return;
+  // commit a batch left open
+  while(_batch_depth > 0) dt_image_cache_write_batch_end();
   dt_print(DT_DEBUG_CACHE,
            "[image cache cleaup report] fill %.2f/%.2f MB (%.2f%%)",
-           cache->cache.cost / (1024.0 * 1024.0),
+           dt_cache_get_cost(&cache->cache) / (1024.0 * 1024.0),
            cache->cache.cost_quota / (1024.0 * 1024.0),
-           (float)cache->cache.cost / (float)cache->cache.cost_quota);
+           (float)dt_cache_get_cost(&cache->cache) / (float)cache->cache.cost_quota);
   dt_cache_cleanup(&cache->cache);
   free(cache);
   darktable.image_cache = NULL;
@@ -291,6 +328,21 @@ void dt_image_cache_read_release(const dt_image_t *img)
   if(cache) dt_cache_release(&cache->cache, img->cache_entry);
 }
 
+// commit the rows of a long batch now and then
+static void _batch_row_written(void)
+{
+  if(_batch_depth == 0) return;
+
+  _batch_rows++;
+  if(_batch_rows % DT_IMAGE_CACHE_BATCH_ROWS == 0
+     || 1000.0 * (dt_get_wtime() - _batch_start) > DT_IMAGE_CACHE_BATCH_MS)
+  {
+    dt_database_release_transaction(darktable.db);
+    dt_database_start_transaction(darktable.db);
+    _batch_start = dt_get_wtime();
+  }
+}
+
 // drops the write privileges on an image struct.
 // this triggers a write-through to sql, and if
 // a) mode == DT_IMAGE_CACHE_SAFE
@@ -331,10 +383,9 @@ void dt_image_cache_write_release_info(dt_image_t *img,
 
   img->aspect_ratio = dt_usable_aspect(img->aspect_ratio);
 
-  sqlite3_stmt *stmt;
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
      "UPDATE main.images"
      " SET width = ?1, height = ?2, filename = ?3,"
      "     maker_id = ?4, model_id = ?5, lens_id = ?6, camera_id = ?35,"
@@ -348,8 +399,7 @@ void dt_image_cache_write_release_info(dt_image_t *img,
      "     print_timestamp = ?31, output_width = ?32, output_height = ?33,"
      "     whitebalance_id = ?36, flash_id = ?37,"
      "     exposure_program_id = ?38, metering_mode_id = ?39, flash_tagvalue = ?41"
-     " WHERE id = ?40",
-     -1, &stmt, NULL);
+     " WHERE id = ?40");
 
   const int32_t maker_id = dt_image_get_camera_maker_id(img->exif_maker);
   const int32_t model_id = dt_image_get_camera_model_id(img->exif_model);
@@ -423,7 +473,8 @@ void dt_image_cache_write_release_info(dt_image_t *img,
              rc,
              sqlite3_errmsg(dt_database_get(darktable.db)),
              img->id);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+  _batch_row_written();
 
   if(mode == DT_IMAGE_CACHE_SAFE)
     dt_image_synch_xmp(img->id);
@@ -68,6 +68,14 @@ void dt_image_cache_write_release_info(dt_image_t *img,
                                        const dt_image_cache_write_mode_t mode,
                                        const char *info);
 
+// batch the write-back of many images done by this thread: between begin
+// and end the rows written by dt_image_cache_write_release() go into one
+// transaction, committed every DT_IMAGE_CACHE_BATCH_ROWS rows or
+// DT_IMAGE_CACHE_BATCH_MS milliseconds so that a crash loses little.
+// batches nest, the last end commits.
+void dt_image_cache_write_batch_begin(void);
+void dt_image_cache_write_batch_end(void);
+
 // remove the image from the cache
 void dt_image_cache_remove(const dt_imgid_t imgid);
 
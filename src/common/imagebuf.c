@@ -17,6 +17,7 @@
 */
 
 #include <stdarg.h>
+#include <string.h>
 #include "common/imagebuf.h"
 
 static size_t parallel_imgop_minimum = 500000;
@@ -479,6 +480,118 @@ void dt_iop_image_linear_blend(float *const restrict buf,
     buf[k] = lambda*buf[k] + lambda_1*other[k];
 }
 
+// side of the square blocks of pixels transposed at once, small enough
+// for the input rows and output columns of a block of float4 pixels to
+// stay in the L1 cache
+#define DT_ORIENT_BLOCK 32
+
+// copy the pixels of one block with mirrored and/or swapped axes. the
+// pixel size is a constant in the callers so the copies become single
+// loads and stores.
+static inline void _image_orient_block(char *const out,
+                                       const char *const in,
+                                       const size_t bpp,
+                                       const size_t stride,
+                                       const ptrdiff_t si,
+                                       const ptrdiff_t sj,
+                                       const int i0,
+                                       const int i1,
+                                       const int j0,
+                                       const int j1)
+{
+  // with swapped axes, consecutive input rows make consecutive output
+  // pixels: walk down the columns of the block
+  for(int i = i0; i < i1; i++)
+  {
+    char *out2 = out + si * i + sj * j0;
+    const char *in2 = in + stride * j0 + bpp * i;
+    for(int j = j0; j < j1; j++)
+    {
+      memcpy(out2, in2, bpp);
+      out2 += sj;
+      in2 += stride;
+    }
+  }
+}
+
+void dt_iop_image_orient(void *const out,
+                         const void *const in,
+                         const size_t bpp,
+                         const int wd,
+                         const int ht,
+                         const int fwd,
+                         const int fht,
+                         const size_t stride,
+                         const dt_image_orientation_t orientation)
+{
+  ptrdiff_t ii = 0;
+  ptrdiff_t jj = 0;
+  ptrdiff_t si = bpp;
+  ptrdiff_t sj = (ptrdiff_t)wd * bpp;
+  if(orientation & ORIENTATION_SWAP_XY)
+  {
+    sj = bpp;
+    si = (ptrdiff_t)ht * bpp;
+  }
+  if(orientation & ORIENTATION_FLIP_Y)
+  {
+    jj = fht - 1;
+    sj = -sj;
+  }
+  if(orientation & ORIENTATION_FLIP_X)
+  {
+    ii = fwd - 1;
+    si = -si;
+  }
+  // origin of the output, the input pixel i, j goes to origin + si * i + sj * j
+  char *const origin = (char *)out + labs(sj) * jj + labs(si) * ii;
+
+  if(!(orientation & ORIENTATION_SWAP_XY))
+  {
+    // rows stay rows, only their order and direction change
+    DT_OMP_FOR()
+    for(int j = 0; j < ht; j++)
+    {
+      char *out2 = origin + sj * j;
+      const char *in2 = (const char *)in + stride * j;
+      if(si > 0)
+        memcpy(out2, in2, bpp * wd);
+      else
+        for(int i = 0; i < wd; i++, in2 += bpp, out2 += si)
+          memcpy(out2, in2, bpp);
+    }
+    return;
+  }
+
+  // transpose block by block so that neither the reads nor the strided
+  // writes go to a new cacheline for each pixel
+  const int bw = (wd + DT_ORIENT_BLOCK - 1) / DT_ORIENT_BLOCK;
+  const int bh = (ht + DT_ORIENT_BLOCK - 1) / DT_ORIENT_BLOCK;
+  DT_OMP_FOR()
+  for(int b = 0; b < bw * bh; b++)
+  {
+    const int i0 = (b % bw) * DT_ORIENT_BLOCK;
+    const int j0 = (b / bw) * DT_ORIENT_BLOCK;
+    const int i1 = MIN(i0 + DT_ORIENT_BLOCK, wd);
+    const int j1 = MIN(j0 + DT_ORIENT_BLOCK, ht);
+    switch(bpp)
+    {
+      case 4 * sizeof(float):
+        _image_orient_block(origin, in, 4 * sizeof(float), stride, si, sj, i0, i1, j0, j1);
+        break;
+      case sizeof(float):
+        _image_orient_block(origin, in, sizeof(float), stride, si, sj, i0, i1, j0, j1);
+        break;
+      case sizeof(uint16_t):
+        _image_orient_block(origin, in, sizeof(uint16_t), stride, si, sj, i0, i1, j0, j1);
+        break;
+      default:
+        _image_orient_block(origin, in, bpp, stride, si, sj, i0, i1, j0, j1);
+        break;
+    }
+  }
+}
+
 // perform timings to determine the optimal threshold for switching to
 // parallel operations, as well as the maximal number of threads
 // before saturating the memory bus
@@ -17,6 +17,7 @@
 */
 
 #pragma once
+#include "common/image.h" // for dt_image_orientation_t
 #include "develop/imageop.h" // for dt_iop_roi_t
 
 G_BEGIN_DECLS
@@ -165,6 +166,20 @@ void dt_iop_image_linear_blend(float *const __restrict__ buf,
                                const size_t height,
                                const size_t ch);
 
+// Copy an image of wd x ht pixels of bpp bytes, rows stride bytes apart,
+// into a packed buffer in the given orientation. fwd and fht are the
+// width and height of the output before swapping the axes. swapped axes
+// are transposed block by block to keep the memory accesses local.
+void dt_iop_image_orient(void *const out,
+                         const void *const in,
+                         const size_t bpp,
+                         const int wd,
+                         const int ht,
+                         const int fwd,
+                         const int fht,
+                         const size_t stride,
+                         const dt_image_orientation_t orientation);
+
 // perform timings to determine the optimal threshold for switching to
 // parallel operations, as well as the maximal number of threads
 // before saturating the memory bus
@@ -0,0 +1,168 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/import_prefetch.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+#include "control/conf.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+#define DT_IMPORT_PREFETCH_MAX_THREADS 8
+// how far the workers may run ahead of the import, in files
+#define DT_IMPORT_PREFETCH_WINDOW 32
+// the exif data of raw files lives in the first few hundred KB
+#define DT_IMPORT_PREFETCH_BYTES (1024 * 1024)
+#define DT_IMPORT_PREFETCH_CHUNK (64 * 1024)
+
+struct dt_import_prefetch_t
+{
+  gchar **files;
+  int count;
+  int next;     // the next file to be read by a worker
+  int consumed; // files imported so far
+  gboolean stop;
+  dt_pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int num_threads;
+  pthread_t threads[DT_IMPORT_PREFETCH_MAX_THREADS];
+};
+
+static void _read_file(const char *filename,
+                       const size_t max_bytes,
+                       char *buf)
+{
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return;
+
+  size_t total = 0;
+  while(total < max_bytes)
+  {
+    const size_t got = fread(buf, 1, DT_IMPORT_PREFETCH_CHUNK, f);
+    if(got == 0) break;
+    total += got;
+  }
+  fclose(f);
+}
+
+static void *_prefetch_thread(void *arg)
+{
+  dt_import_prefetch_t *p = arg;
+  dt_pthread_setname("import prefetch");
+  char *buf = g_malloc(DT_IMPORT_PREFETCH_CHUNK);
+
+  dt_pthread_mutex_lock(&p->lock);
+  while(!p->stop && p->next < p->count)
+  {
+    if(p->next >= p->consumed + DT_IMPORT_PREFETCH_WINDOW)
+    {
+      // far enough ahead, don't push what we have read out of the page cache
+      dt_pthread_cond_wait(&p->cond, &p->lock);
+      continue;
+    }
+    const int k = p->next++;
+    // the import has overtaken us, nothing to win
+    const gboolean behind = k < p->consumed;
+    dt_pthread_mutex_unlock(&p->lock);
+
+    if(!behind)
+    {
+      _read_file(p->files[k], DT_IMPORT_PREFETCH_BYTES, buf);
+
+      gchar *xmp = g_strconcat(p->files[k], ".xmp", NULL);
+      _read_file(xmp, G_MAXSIZE, buf);
+      g_free(xmp);
+    }
+
+    dt_pthread_mutex_lock(&p->lock);
+  }
+  dt_pthread_mutex_unlock(&p->lock);
+
+  g_free(buf);
+  return NULL;
+}
+
+dt_import_prefetch_t *dt_import_prefetch_new(const GList *files)
+{
+  const int threads = MIN(dt_conf_get_int("import_prefetch_threads"),
+                          DT_IMPORT_PREFETCH_MAX_THREADS);
+  const int count = g_list_length((GList *)files);
+  // a few images are imported before the threads are up
+  if(threads <= 0 || count < 4) return NULL;
+
+  dt_import_prefetch_t *p = g_malloc0(sizeof(dt_import_prefetch_t));
+  p->files = g_new0(gchar *, count + 1);
+  int k = 0;
+  for(const GList *l = files; l; l = g_list_next(l))
+    p->files[k++] = g_strdup((const gchar *)l->data);
+  p->count = count;
+  dt_pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->cond, NULL);
+
+  for(int i = 0; i < threads; i++)
+  {
+    if(dt_pthread_create(&p->threads[p->num_threads], _prefetch_thread, p))
+      break;
+    p->num_threads++;
+  }
+
+  if(!p->num_threads)
+  {
+    dt_import_prefetch_destroy(p);
+    return NULL;
+  }
+
+  dt_print(DT_DEBUG_CONTROL, "[import_prefetch] %d threads for %d files",
+           p->num_threads, count);
+  return p;
+}
+
+void dt_import_prefetch_advance(dt_import_prefetch_t *p)
+{
+  if(!p) return;
+
+  dt_pthread_mutex_lock(&p->lock);
+  p->consumed++;
+  pthread_cond_broadcast(&p->cond);
+  dt_pthread_mutex_unlock(&p->lock);
+}
+
+void dt_import_prefetch_destroy(dt_import_prefetch_t *p)
+{
+  if(!p) return;
+
+  dt_pthread_mutex_lock(&p->lock);
+  p->stop = TRUE;
+  pthread_cond_broadcast(&p->cond);
+  dt_pthread_mutex_unlock(&p->lock);
+
+  for(int i = 0; i < p->num_threads; i++)
+    pthread_join(p->threads[i], NULL);
+
+  pthread_cond_destroy(&p->cond);
+  dt_pthread_mutex_destroy(&p->lock);
+  g_strfreev(p->files);
+  g_free(p);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
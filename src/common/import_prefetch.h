@@ -0,0 +1,52 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// reads the headers and sidecars of the files to be imported ahead of the
+// import, with a small pool of threads. the exif parsing itself is
+// serialized by exiv2, but it then finds the data in the page cache instead
+// of waiting on the card or the network for every single file.
+typedef struct dt_import_prefetch_t dt_import_prefetch_t;
+
+// the import jobs commit their database writes in transactions of this many
+// images instead of one commit per statement
+#define DT_IMPORT_BATCH_SIZE 32
+
+// files is a list of filenames in import order, copied. returns NULL if
+// prefetching is disabled by conf key 'import_prefetch_threads' or there is
+// nothing worth prefetching.
+dt_import_prefetch_t *dt_import_prefetch_new(const GList *files);
+
+// the next file of the list has been imported, lets the workers move on
+void dt_import_prefetch_advance(dt_import_prefetch_t *prefetch);
+
+// stops the workers, NULL is fine
+void dt_import_prefetch_destroy(dt_import_prefetch_t *prefetch);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
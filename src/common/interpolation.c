@@ -976,6 +976,214 @@ static gboolean _prepare_resampling_plan(const dt_interpolation_t *itor,
   return FALSE;
 }
 
+/* The plans of the last few configurations are kept, the same scaling is
+ * asked for over and over by finalscale, the thumbnails and exports. */
+#define RESAMPLING_PLAN_CACHE 8
+
+typedef struct _resampling_plan_t
+{
+  const dt_interpolation_t *itor;
+  int in;
+  int out;
+  int shift;
+  float scale;
+  int *length;
+  float *kernel;
+  int *index;
+  int *meta;
+  int span;      // max distance between the first and last sample of one output, plus one
+  int refs;      // the cache holds one reference
+  uint64_t used;
+} _resampling_plan_t;
+
+static GMutex _plan_lock;
+static _resampling_plan_t *_plan_cache[RESAMPLING_PLAN_CACHE];
+static uint64_t _plan_clock = 0;
+
+static void _plan_unref_locked(_resampling_plan_t *plan)
+{
+  if(plan && --plan->refs == 0)
+  {
+    dt_free_align(plan->length);
+    free(plan);
+  }
+}
+
+static void _plan_unref(_resampling_plan_t *plan)
+{
+  if(!plan) return;
+  g_mutex_lock(&_plan_lock);
+  _plan_unref_locked(plan);
+  g_mutex_unlock(&_plan_lock);
+}
+
+// returns a referenced plan with meta data, to be given back with _plan_unref()
+static _resampling_plan_t *_get_resampling_plan(const dt_interpolation_t *itor,
+                                                const int in,
+                                                const int out,
+                                                const int shift,
+                                                const float scale)
+{
+  g_mutex_lock(&_plan_lock);
+  int slot = 0;
+  for(int k = 0; k < RESAMPLING_PLAN_CACHE; k++)
+  {
+    _resampling_plan_t *p = _plan_cache[k];
+    if(p && p->itor == itor && p->in == in && p->out == out && p->shift == shift
+       && p->scale == scale)
+    {
+      p->refs++;
+      p->used = ++_plan_clock;
+      g_mutex_unlock(&_plan_lock);
+      return p;
+    }
+    if(!p || (_plan_cache[slot] && p->used < _plan_cache[slot]->used)) slot = k;
+  }
+  g_mutex_unlock(&_plan_lock);
+
+  _resampling_plan_t *plan = calloc(1, sizeof(_resampling_plan_t));
+  if(!plan) return NULL;
+  if(_prepare_resampling_plan(itor, in, out, shift, scale,
+                              &plan->length, &plan->kernel, &plan->index, &plan->meta)
+     || !plan->length)
+  {
+    free(plan);
+    return NULL;
+  }
+  plan->itor = itor;
+  plan->in = in;
+  plan->out = out;
+  plan->shift = shift;
+  plan->scale = scale;
+  plan->refs = 2;
+  plan->span = 1;
+
+  for(int x = 0; x < out; x++)
+  {
+    const int *index = plan->index + plan->meta[3 * x + 2];
+    int lo = in, hi = -1;
+    for(int k = 0; k < plan->length[x]; k++)
+    {
+      lo = MIN(lo, index[k]);
+      hi = MAX(hi, index[k]);
+    }
+    plan->span = MAX(plan->span, hi - lo + 1);
+  }
+
+  g_mutex_lock(&_plan_lock);
+  plan->used = ++_plan_clock;
+  _plan_unref_locked(_plan_cache[slot]);
+  _plan_cache[slot] = plan;
+  g_mutex_unlock(&_plan_lock);
+  return plan;
+}
+
+// horizontal pass of one input row into 'width' output pixels
+static inline void _resample_row(const float *const restrict in,
+                                 float *const restrict out,
+                                 const int *const restrict hlength,
+                                 const int *const restrict hindex,
+                                 const float *const restrict hkernel,
+                                 const size_t width)
+{
+  size_t hkidx = 0;
+  for(size_t ox = 0; ox < width; ox++)
+  {
+    dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const int hl = hlength[ox];
+    for(int ix = 0; ix < hl; ix++, hkidx++)
+    {
+      const float htap = hkernel[hkidx];
+      const float *const pixel = in + (size_t)hindex[hkidx] * 4;
+      for_each_channel(c, aligned(vs:16)) vs[c] += pixel[c] * htap;
+    }
+    copy_pixel(out + ox * 4, vs);
+  }
+}
+
+// separable resampling of the 4-channel input into the output with the given plans
+static void _resample_separable(const _resampling_plan_t *const hplan,
+                                const _resampling_plan_t *const vplan,
+                                float *out,
+                                const dt_iop_roi_t *const roi_out,
+                                const float *const in,
+                                const dt_iop_roi_t *const roi_in)
+{
+  const size_t in_stride_floats = roi_in->width * 4;
+  const size_t out_stride_floats = roi_out->width * 4;
+  const int *const hlength = hplan->length;
+  const int *const hindex = hplan->index;
+  const float *const hkernel = hplan->kernel;
+  const int *const vlength = vplan->length;
+  const int *const vindex = vplan->index;
+  const float *const vkernel = vplan->kernel;
+  const int *const vmeta = vplan->meta;
+
+  /* The filter is separable: every input line needed is resampled horizontally
+   * once into a per-thread ring of lines, then the output lines are accumulated
+   * from the ring. A ring of 'span' lines holds all lines of one output line,
+   * consecutive output lines share most of them. */
+  const size_t ring = vplan->span;
+  const size_t line_floats = dt_round_size(out_stride_floats, 16);
+  const size_t out_width = roi_out->width;
+  const size_t out_height = roi_out->height;
+  size_t rows_padded, tags_padded;
+  float *const rows = dt_alloc_perthread_float((ring + 1) * line_floats, &rows_padded);
+  int *const tags = dt_alloc_perthread(ring, sizeof(int), &tags_padded);
+  if(rows && tags)
+  {
+    // one band of output lines per thread keeps the ring hits high
+    const size_t bands = MIN(out_height, dt_get_num_threads());
+    DT_OMP_FOR()
+    for(size_t band = 0; band < bands; band++)
+    {
+      float *const restrict lines = dt_get_perthread(rows, rows_padded);
+      float *const restrict acc = lines + ring * line_floats;
+      int *const restrict tag = dt_get_perthread(tags, tags_padded);
+      for(size_t k = 0; k < ring; k++) tag[k] = -1;
+
+      const size_t oy_first = band * out_height / bands;
+      const size_t oy_last = (band + 1) * out_height / bands;
+      for(size_t oy = oy_first; oy < oy_last; oy++)
+      {
+        const int vl = vlength[vmeta[3 * oy + 0]]; // V(ertical) L(ength)
+        const int vkidx = vmeta[3 * oy + 1];       // V(ertical) K(ernel) I(n)d(e)x
+        const int viidx = vmeta[3 * oy + 2];       // V(ertical) I(ndex) I(n)d(e)x
+
+        memset(acc, 0, sizeof(float) * out_stride_floats);
+        for(int iy = 0; iy < vl; iy++)
+        {
+          // This is our input line, resampled horizontally on first use
+          const int line = vindex[viidx + iy];
+          const size_t slot = (size_t)line % ring;
+          float *const restrict hline = lines + slot * line_floats;
+          if(tag[slot] != line)
+          {
+            _resample_row(in + (size_t)line * in_stride_floats, hline,
+                          hlength, hindex, hkernel, out_width);
+            tag[slot] = line;
+          }
+
+          // Accumulate contribution from this line
+          const float vtap = vkernel[vkidx + iy];
+          DT_OMP_SIMD(aligned(acc, hline:64))
+          for(size_t k = 0; k < out_stride_floats; k++)
+            acc[k] += hline[k] * vtap;
+        }
+
+        // Output line is ready
+        float *const restrict outline = out + oy * out_stride_floats;
+        for(size_t ox = 0; ox < out_width; ox++)
+          copy_pixel_nontemporal(outline + ox * 4, acc + ox * 4);
+      }
+    }
+    dt_omploop_sfence();
+  }
+
+  dt_free_align(rows);
+  dt_free_align(tags);
+}
+
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
@@ -991,13 +1199,8 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
     return;
   }
 
-  int *hindex = NULL;
-  int *hlength = NULL;
-  float *hkernel = NULL;
-  int *vindex = NULL;
-  int *vlength = NULL;
-  float *vkernel = NULL;
-  int *vmeta = NULL;
+  _resampling_plan_t *hplan = NULL;
+  _resampling_plan_t *vplan = NULL;
 
   const size_t in_stride_floats = roi_in->width * 4;
   const size_t out_stride_floats = roi_out->width * 4;
@@ -1045,88 +1248,18 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
 
   // Generic non 1:1 case... much more complicated :D
 
-  // Prepare resampling plans once and for all
-  if(_prepare_resampling_plan(itor, roi_in->width, roi_out->width, dx, roi_out->scale,
-                              &hlength, &hkernel, &hindex, NULL))
-    goto exit;
-
-  if(_prepare_resampling_plan(itor, roi_in->height, roi_out->height, dy, roi_out->scale,
-                              &vlength, &vkernel, &vindex, &vmeta))
-    goto exit;
+  // Get the resampling plans, they are cached for the next call
+  hplan = _get_resampling_plan(itor, roi_in->width, roi_out->width, dx, roi_out->scale);
+  vplan = _get_resampling_plan(itor, roi_in->height, roi_out->height, dy, roi_out->scale);
+  if(!hplan || !vplan) goto exit;
 
   dt_get_perf_times(&mid);
 
-  // Process each output line
-  DT_OMP_FOR()
-  for(size_t oy = 0; oy < (size_t)roi_out->height; oy++)
-  {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
-
-    // Number of lines contributing to the output line
-    const int vl = vlength[vlidx++]; // V(ertical) L(ength)
-
-    // Process each output column
-    for(size_t ox = 0; ox < (size_t)roi_out->width; ox++)
-    {
-      // This will hold the resulting pixel
-      dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-      // Number of horizontal samples contributing to the output
-      const int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(size_t iy = 0; iy < vl; iy++)
-      {
-        // This is our input line
-        const size_t baseidx_vindex = (size_t)vindex[viidx++] * in_stride_floats;
-
-        dt_aligned_pixel_t vhs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-        for(size_t ix = 0; ix < hl; ix++)
-        {
-          // Apply the precomputed filter kernel
-          const size_t baseidx = baseidx_vindex + (size_t)hindex[hkidx] * 4;
-          const float htap = hkernel[hkidx++];
-          dt_aligned_pixel_t tmp;
-          copy_pixel(tmp, in + baseidx);
-          for_each_channel(c, aligned(tmp,vhs:16))
-            vhs[c] += tmp[c] * htap;
-        }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        for_each_channel(c, aligned(vhs,vs:16)) vs[c] += vhs[c] * vtap;
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
-      }
-
-      // Output pixel is ready
-      const size_t baseidx = (size_t)oy * out_stride_floats + (size_t)ox * 4;
-      copy_pixel_nontemporal(out + baseidx, vs);
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hkidx += hl;
-    }
-  }
-  dt_omploop_sfence();
+  _resample_separable(hplan, vplan, out, roi_out, in, roi_in);
 
 exit:
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  _plan_unref(hplan);
+  _plan_unref(vplan);
   _show_2_times(&start, &mid, "resample_plain");
 }
 
@@ -0,0 +1,149 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/library_counts.h"
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
+
+#include <sqlite3.h>
+
+// the minute of a datetime_taken, see DT_LIBRARY_COUNTS_MINUTE
+#define MINUTE_EXPR(col) "IFNULL(" col ", 0) / 60000000"
+
+// add delta to the count of key in table, the row is created if needed.
+// the targets of the trigger statements can't be qualified, the count
+// tables resolve to the memory schema.
+#define COUNT_ADD(table, key, delta)                                             \
+  " INSERT OR IGNORE INTO " table " (id, count) VALUES (" key ", 0);"            \
+  " UPDATE " table " SET count = count " delta " WHERE id = " key ";"
+
+static const char *_counts_tables[] =
+{
+  "CREATE TABLE memory.film_counts (id INTEGER PRIMARY KEY, count INTEGER)",
+  "CREATE TABLE memory.tag_counts (id INTEGER PRIMARY KEY, count INTEGER)",
+  "CREATE TABLE memory.camera_counts (id INTEGER PRIMARY KEY, count INTEGER)",
+  "CREATE TABLE memory.time_counts (id INTEGER PRIMARY KEY, count INTEGER)",
+};
+
+static const char *_counts_fill[] =
+{
+  "INSERT INTO memory.film_counts (id, count)"
+  " SELECT film_id, COUNT(*) FROM main.images GROUP BY film_id",
+  "INSERT INTO memory.tag_counts (id, count)"
+  " SELECT tagid, COUNT(*) FROM main.tagged_images GROUP BY tagid",
+  "INSERT INTO memory.camera_counts (id, count)"
+  " SELECT IFNULL(camera_id, 0), COUNT(*) FROM main.images GROUP BY IFNULL(camera_id, 0)",
+  "INSERT INTO memory.time_counts (id, count)"
+  " SELECT " MINUTE_EXPR("datetime_taken") " AS minute, COUNT(*)"
+  " FROM main.images GROUP BY minute",
+};
+
+static const char *_counts_triggers[] =
+{
+  "CREATE TEMP TRIGGER counts_images_insert AFTER INSERT ON main.images"
+  " BEGIN"
+  COUNT_ADD("film_counts", "NEW.film_id", "+ 1")
+  COUNT_ADD("camera_counts", "IFNULL(NEW.camera_id, 0)", "+ 1")
+  COUNT_ADD("time_counts", MINUTE_EXPR("NEW.datetime_taken"), "+ 1")
+  " END",
+  "CREATE TEMP TRIGGER counts_images_delete AFTER DELETE ON main.images"
+  " BEGIN"
+  "  UPDATE film_counts SET count = count - 1 WHERE id = OLD.film_id;"
+  "  UPDATE camera_counts SET count = count - 1"
+  "   WHERE id = IFNULL(OLD.camera_id, 0);"
+  "  UPDATE time_counts SET count = count - 1"
+  "   WHERE id = " MINUTE_EXPR("OLD.datetime_taken") ";"
+  " END",
+  "CREATE TEMP TRIGGER counts_images_film AFTER UPDATE OF film_id ON main.images"
+  " WHEN OLD.film_id IS NOT NEW.film_id"
+  " BEGIN"
+  "  UPDATE film_counts SET count = count - 1 WHERE id = OLD.film_id;"
+  COUNT_ADD("film_counts", "NEW.film_id", "+ 1")
+  " END",
+  "CREATE TEMP TRIGGER counts_images_camera AFTER UPDATE OF camera_id ON main.images"
+  " WHEN IFNULL(OLD.camera_id, 0) != IFNULL(NEW.camera_id, 0)"
+  " BEGIN"
+  "  UPDATE camera_counts SET count = count - 1"
+  "   WHERE id = IFNULL(OLD.camera_id, 0);"
+  COUNT_ADD("camera_counts", "IFNULL(NEW.camera_id, 0)", "+ 1")
+  " END",
+  "CREATE TEMP TRIGGER counts_images_time AFTER UPDATE OF datetime_taken ON main.images"
+  " WHEN " MINUTE_EXPR("OLD.datetime_taken") " != " MINUTE_EXPR("NEW.datetime_taken")
+  " BEGIN"
+  "  UPDATE time_counts SET count = count - 1"
+  "   WHERE id = " MINUTE_EXPR("OLD.datetime_taken") ";"
+  COUNT_ADD("time_counts", MINUTE_EXPR("NEW.datetime_taken"), "+ 1")
+  " END",
+  "CREATE TEMP TRIGGER counts_tagged_insert AFTER INSERT ON main.tagged_images"
+  " BEGIN"
+  COUNT_ADD("tag_counts", "NEW.tagid", "+ 1")
+  " END",
+  "CREATE TEMP TRIGGER counts_tagged_delete AFTER DELETE ON main.tagged_images"
+  " BEGIN"
+  "  UPDATE tag_counts SET count = count - 1 WHERE id = OLD.tagid;"
+  " END",
+  "CREATE TEMP TRIGGER counts_tagged_update AFTER UPDATE OF tagid ON main.tagged_images"
+  " WHEN OLD.tagid IS NOT NEW.tagid"
+  " BEGIN"
+  "  UPDATE tag_counts SET count = count - 1 WHERE id = OLD.tagid;"
+  COUNT_ADD("tag_counts", "NEW.tagid", "+ 1")
+  " END",
+};
+
+gboolean dt_library_counts_ready(void)
+{
+  // 0: not built yet, 1: ready, -1: not available
+  static int state = 0;
+  if(state) return state > 0;
+
+  sqlite3 *db = dt_database_get(darktable.db);
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  // the memory tables are part of the transaction, a rollback of the
+  // main connection takes back what its triggers did to them
+  state = -1;
+  dt_database_start_transaction(darktable.db);
+  gboolean ok = TRUE;
+  for(int k = 0; ok && k < G_N_ELEMENTS(_counts_tables); k++)
+    ok = sqlite3_exec(db, _counts_tables[k], NULL, NULL, NULL) == SQLITE_OK;
+  for(int k = 0; ok && k < G_N_ELEMENTS(_counts_fill); k++)
+    ok = sqlite3_exec(db, _counts_fill[k], NULL, NULL, NULL) == SQLITE_OK;
+  for(int k = 0; ok && k < G_N_ELEMENTS(_counts_triggers); k++)
+    ok = sqlite3_exec(db, _counts_triggers[k], NULL, NULL, NULL) == SQLITE_OK;
+
+  if(!ok)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[library counts] could not build the count tables: %s",
+             sqlite3_errmsg(db));
+    dt_database_rollback_transaction(darktable.db);
+    return FALSE;
+  }
+  dt_database_release_transaction(darktable.db);
+
+  state = 1;
+  dt_show_times(&start, "[library counts] build count tables");
+  return TRUE;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,54 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * number of images of the whole library per film roll, tag, camera and
+ * minute taken, so that the collect module and the timeline don't group
+ * all the images again on each collection change. the counts live in
+ * memory tables, built on first use and kept up to date by temporary
+ * triggers of the main connection:
+ *
+ *   memory.film_counts   (id INTEGER PRIMARY KEY, count INTEGER)  film roll id
+ *   memory.tag_counts    (id INTEGER PRIMARY KEY, count INTEGER)  tag id
+ *   memory.camera_counts (id INTEGER PRIMARY KEY, count INTEGER)  camera id
+ *   memory.time_counts   (id INTEGER PRIMARY KEY, count INTEGER)  datetime_taken
+ *                                                                 / DT_LIBRARY_COUNTS_MINUTE
+ *
+ * rows may be left with a count of 0.
+ */
+
+// datetime_taken is in microseconds, the time counts are per minute
+#define DT_LIBRARY_COUNTS_MINUTE G_GINT64_CONSTANT(60000000)
+
+/** build the count tables if needed. FALSE if they can't be used, the
+ *  callers then group main.images themselves. */
+gboolean dt_library_counts_ready(void);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
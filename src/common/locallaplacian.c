@@ -368,6 +368,13 @@ void apply_curve(
   pad_by_replication(out, w, h, padding);
 }
 
+void local_laplacian_pyramid_free(local_laplacian_pyramid_t *p)
+{
+  for(int l = 0; l < max_levels; l++) dt_free_align(p->padded[l]);
+  dt_free_align(p->coarse);
+  memset(p, 0, sizeof(*p));
+}
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -377,7 +384,8 @@ void local_laplacian_internal(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b)
+    local_laplacian_boundary_t *b,
+    local_laplacian_pyramid_t *cache)
 {
   if(wd <= 1 || ht <= 1) return;
 
@@ -389,14 +397,36 @@ void local_laplacian_internal(
   const int max_supp = 1<<last_level;
   int w, h;
   float *padded[max_levels] = {0};
-  if(b && b->mode == 2)
+
+  // the boundary modes pad with or hand out the preview buffers, so the
+  // input pyramid is only kept for regular processing
+  if(b) cache = NULL;
+  const gboolean from_cache = cache && cache->padded[0]
+    && cache->wd == wd && cache->ht == ht && cache->last_level == last_level;
+  if(from_cache)
+  {
+    w = cache->pwd;
+    h = cache->pht;
+    for(int l = 0; l < last_level; l++) padded[l] = cache->padded[l];
+  }
+  else if(cache)
+  {
+    const dt_hash_t hash = cache->hash;
+    local_laplacian_pyramid_free(cache);
+    cache->hash = hash;
+  }
+
+  if(from_cache)
+    ;
+  else if(b && b->mode == 2)
     padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
   else
     padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
 
-  // allocate pyramid pointers for padded input
+  // allocate pyramid pointers for padded input, the coarsest level
+  // goes to the output pyramid directly
   gboolean success = padded[0] != NULL;
-  for(int l=1;l<=last_level;l++)
+  for(int l=1;l<last_level && !from_cache;l++)
   {
     padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
     if(!padded[l])
@@ -425,7 +455,7 @@ void local_laplacian_internal(
     // declared below.  So just free whatever we've allocated and return.
     for(int l = 0; l <= last_level; l++)
     {
-      dt_free_align(padded[l]);
+      if(!from_cache) dt_free_align(padded[l]);
       dt_free_align(output[l]);
     }
     // copy the input buffer to the output so that we at least get a
@@ -436,9 +466,36 @@ void local_laplacian_internal(
   }
 
   // create gauss pyramid of padded input, write coarse directly to output
-  for(int l=1;l<last_level;l++)
-    gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-  gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+  const size_t coarse_size = (size_t)dl(w,last_level) * dl(h,last_level);
+  if(from_cache)
+    memcpy(output[last_level], cache->coarse, sizeof(float) * coarse_size);
+  else
+  {
+    for(int l=1;l<last_level;l++)
+      gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
+    gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+  }
+
+  // keep the input pyramid if it fits into the memory we are allowed
+  // for a single buffer, the tweaks of the curve parameters then only
+  // run the remapping and the collapse
+  gboolean keep = from_cache;
+  if(cache && !from_cache
+     && local_laplacian_singlebuffer_size(wd, ht) * 4 / 3 <= dt_get_singlebuffer_mem())
+  {
+    cache->coarse = dt_alloc_align_float(coarse_size);
+    if(cache->coarse)
+    {
+      memcpy(cache->coarse, output[last_level], sizeof(float) * coarse_size);
+      for(int l = 0; l < last_level; l++) cache->padded[l] = padded[l];
+      cache->wd = wd;
+      cache->ht = ht;
+      cache->pwd = w;
+      cache->pht = h;
+      cache->last_level = last_level;
+      keep = TRUE;
+    }
+  }
 
   // evenly sample brightness [0,1]:
   float gamma[num_gamma] = {0.0f};
@@ -579,7 +636,7 @@ void local_laplacian_internal(
 cleanup:
   for(int l=0;l<max_levels;l++)
   {
-    if(!b || b->mode != 1 || l)   dt_free_align(padded[l]);
+    if((!b || b->mode != 1 || l) && !keep) dt_free_align(padded[l]);
     if(!b || b->mode != 1)        dt_free_align(output[l]);
     for(int k=0; k<num_gamma;k++) dt_free_align(buf[k][l]);
   }
@@ -45,6 +45,25 @@ void local_laplacian_boundary_free(
   memset(b, 0, sizeof(*b));
 }
 
+// gaussian pyramid of the padded input brightness. it only depends on
+// the input buffer, so the caller can keep it while the curve parameters
+// are tweaked. it is only valid for the input it was built from, the caller
+// tracks that in the hash and frees the pyramid when the input changes.
+typedef struct local_laplacian_pyramid_t
+{
+  dt_hash_t hash;          // hash of the input the pyramid was built from
+  int wd;                  // input width
+  int ht;                  // input height
+  int pwd;                 // padded width
+  int pht;                 // padded height
+  int last_level;          // coarsest level
+  float *padded[30];       // levels below last_level (allocated via dt_alloc_align)
+  float *coarse;           // gaussian at last_level (allocated via dt_alloc_align)
+}
+local_laplacian_pyramid_t;
+
+void local_laplacian_pyramid_free(local_laplacian_pyramid_t *p);
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -55,7 +74,9 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
-    local_laplacian_boundary_t *b);
+    local_laplacian_boundary_t *b,
+    // input pyramid kept across calls, not used together with b (can be 0)
+    local_laplacian_pyramid_t *cache);
 
 void local_laplacian(
     const float *const input,   // input buffer in some Labx or yuvx format
@@ -66,9 +87,10 @@ void local_laplacian(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b) // can be 0
+    local_laplacian_boundary_t *b,       // can be 0
+    local_laplacian_pyramid_t *cache)    // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b, cache);
 }
 
 size_t local_laplacian_memory_use(const int width,      // width of input image
@@ -0,0 +1,173 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/memory_account.h"
+#include "common/atomic.h"
+#include "common/darktable.h"
+#include "common/mipmap_cache.h"
+#include "common/opencl.h"
+#include "develop/pixelpipe.h"
+
+G_STATIC_ASSERT(DT_MEM_ACCOUNT_MIPMAP_LAST - DT_MEM_ACCOUNT_MIPMAP + 1 == DT_MIPMAP_NONE);
+
+typedef struct _account_t
+{
+  dt_atomic_int64 bytes;
+  dt_atomic_int64 peak;
+  dt_atomic_int64 items;
+} _account_t;
+
+static _account_t _accounts[DT_MEM_ACCOUNT_LAST];
+
+static const char *_mip_names[DT_MIPMAP_NONE] =
+  { "mipmap 0", "mipmap 1", "mipmap 2", "mipmap 3", "mipmap 4", "mipmap 5", "mipmap 6",
+    "mipmap 7", "mipmap 8", "mipmap 9", "mipmap 10", "mipmap f", "mipmap full" };
+
+static const char *_account_name(const dt_mem_account_t account)
+{
+  if(account >= DT_MEM_ACCOUNT_MIPMAP && account <= DT_MEM_ACCOUNT_MIPMAP_LAST)
+    return _mip_names[account - DT_MEM_ACCOUNT_MIPMAP];
+
+  switch(account)
+  {
+    case DT_MEM_ACCOUNT_PIPE_FULL:      return "full pipe";
+    case DT_MEM_ACCOUNT_PIPE_PREVIEW:   return "preview pipe";
+    case DT_MEM_ACCOUNT_PIPE_PREVIEW2:  return "preview2 pipe";
+    case DT_MEM_ACCOUNT_PIPE_THUMBNAIL: return "thumbnail pipe";
+    case DT_MEM_ACCOUNT_PIPE_EXPORT:    return "export pipe";
+    case DT_MEM_ACCOUNT_IMAGE_CACHE:    return "image cache";
+    case DT_MEM_ACCOUNT_TILING:         return "tiling";
+    case DT_MEM_ACCOUNT_AI:             return "ai sessions";
+    case DT_MEM_ACCOUNT_UNDO:           return "undo";
+    default:                            return "unknown";
+  }
+}
+
+void dt_mem_account_alloc(const dt_mem_account_t account,
+                          const size_t bytes)
+{
+  if(account >= DT_MEM_ACCOUNT_LAST) return;
+
+  _account_t *a = &_accounts[account];
+  const int64_t now = dt_atomic_add_int64(&a->bytes, bytes) + (int64_t)bytes;
+  dt_atomic_add_int64(&a->items, 1);
+
+  int64_t peak = dt_atomic_get_int64(&a->peak);
+  while(now > peak && !dt_atomic_CAS_int64(&a->peak, &peak, now));
+}
+
+void dt_mem_account_free(const dt_mem_account_t account,
+                         const size_t bytes)
+{
+  if(account >= DT_MEM_ACCOUNT_LAST) return;
+
+  _account_t *a = &_accounts[account];
+  dt_atomic_sub_int64(&a->bytes, bytes);
+  dt_atomic_sub_int64(&a->items, 1);
+}
+
+dt_mem_account_t dt_mem_account_pipe(const int pipe_type)
+{
+  if(pipe_type & DT_DEV_PIXELPIPE_EXPORT)    return DT_MEM_ACCOUNT_PIPE_EXPORT;
+  if(pipe_type & DT_DEV_PIXELPIPE_PREVIEW)   return DT_MEM_ACCOUNT_PIPE_PREVIEW;
+  if(pipe_type & DT_DEV_PIXELPIPE_PREVIEW2)  return DT_MEM_ACCOUNT_PIPE_PREVIEW2;
+  if(pipe_type & DT_DEV_PIXELPIPE_THUMBNAIL) return DT_MEM_ACCOUNT_PIPE_THUMBNAIL;
+  return DT_MEM_ACCOUNT_PIPE_FULL;
+}
+
+size_t dt_mem_account_get(const dt_mem_account_t account,
+                          size_t *peak)
+{
+  if(account >= DT_MEM_ACCOUNT_LAST)
+  {
+    if(peak) *peak = 0;
+    return 0;
+  }
+
+  _account_t *a = &_accounts[account];
+  if(peak) *peak = MAX(0, dt_atomic_get_int64(&a->peak));
+  return MAX(0, dt_atomic_get_int64(&a->bytes));
+}
+
+static inline double _mb(const int64_t bytes)
+{
+  return MAX(0, bytes) / (1024.0 * 1024.0);
+}
+
+void dt_mem_account_print(const char *info)
+{
+  if(!(darktable.unmuted & DT_DEBUG_MEMORY)) return;
+
+  dt_print(DT_DEBUG_ALWAYS, "[memory_account] %s", info);
+  for(dt_mem_account_t k = 0; k < DT_MEM_ACCOUNT_LAST; k++)
+  {
+    _account_t *a = &_accounts[k];
+    const int64_t peak = dt_atomic_get_int64(&a->peak);
+    // leave out what was never used, most mipmap sizes are
+    if(!peak) continue;
+    dt_print(DT_DEBUG_ALWAYS, "[memory_account]   %-14s %9.1f MB in %6" PRId64
+             " allocations, peak %9.1f MB",
+             _account_name(k), _mb(dt_atomic_get_int64(&a->bytes)),
+             MAX(0, dt_atomic_get_int64(&a->items)), _mb(peak));
+  }
+
+#ifdef HAVE_OPENCL
+  const dt_opencl_t *cl = darktable.opencl;
+  if(cl && cl->inited)
+  {
+    for(int i = 0; i < cl->num_devs; i++)
+      dt_print(DT_DEBUG_ALWAYS, "[memory_account]   opencl %-7d %9.1f MB, pool %.1f MB,"
+               " peak %9.1f MB, '%s'",
+               i, _mb(cl->dev[i].memory_in_use), _mb(cl->dev[i].pool_bytes),
+               _mb(cl->dev[i].peak_memory), cl->dev[i].fullname);
+  }
+#endif
+}
+
+void dt_mem_account_print_peaks(const int flags,
+                                const char *info)
+{
+  if(!(darktable.unmuted & flags)) return;
+
+  GString *line = g_string_new(NULL);
+  for(dt_mem_account_t k = 0; k < DT_MEM_ACCOUNT_LAST; k++)
+  {
+    const int64_t peak = dt_atomic_get_int64(&_accounts[k].peak);
+    if(peak)
+      g_string_append_printf(line, "%s%s %.1f", line->len ? ", " : "",
+                             _account_name(k), _mb(peak));
+  }
+#ifdef HAVE_OPENCL
+  const dt_opencl_t *cl = darktable.opencl;
+  if(cl && cl->inited)
+  {
+    for(int i = 0; i < cl->num_devs; i++)
+      g_string_append_printf(line, "%sopencl %d %.1f", line->len ? ", " : "",
+                             i, _mb(cl->dev[i].peak_memory));
+  }
+#endif
+
+  dt_print(flags, "%s memory peaks (MB): %s", info, line->len ? line->str : "none");
+  g_string_free(line, TRUE);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
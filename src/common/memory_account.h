@@ -0,0 +1,75 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+/* Memory held by the big consumers, counted where they allocate and free
+   so that -d memory can tell which of them the process memory belongs to.
+   Each account keeps the bytes and allocations currently held and the
+   high-water mark of the bytes. OpenCL memory is taken from the per device
+   counters of the OpenCL layer.
+*/
+
+typedef enum dt_mem_account_t
+{
+  // pixelpipe cache lines and pipe scratch buffers, per pipe type
+  DT_MEM_ACCOUNT_PIPE_FULL = 0,
+  DT_MEM_ACCOUNT_PIPE_PREVIEW,
+  DT_MEM_ACCOUNT_PIPE_PREVIEW2,
+  DT_MEM_ACCOUNT_PIPE_THUMBNAIL,
+  DT_MEM_ACCOUNT_PIPE_EXPORT,
+  // one account per dt_mipmap_size_t, DT_MEM_ACCOUNT_MIPMAP + mip
+  DT_MEM_ACCOUNT_MIPMAP,
+  DT_MEM_ACCOUNT_MIPMAP_LAST = DT_MEM_ACCOUNT_MIPMAP + 12,
+  DT_MEM_ACCOUNT_IMAGE_CACHE,
+  DT_MEM_ACCOUNT_TILING,
+  // session weights and io buffers of the AI models
+  DT_MEM_ACCOUNT_AI,
+  // the undo records, not the data they point to
+  DT_MEM_ACCOUNT_UNDO,
+  DT_MEM_ACCOUNT_LAST
+} dt_mem_account_t;
+
+/** count bytes allocated for account */
+void dt_mem_account_alloc(const dt_mem_account_t account, const size_t bytes);
+/** count bytes given back by account */
+void dt_mem_account_free(const dt_mem_account_t account, const size_t bytes);
+
+/** the pipe account of a dt_dev_pixelpipe_type_t */
+dt_mem_account_t dt_mem_account_pipe(const int pipe_type);
+
+/** bytes currently held and high-water mark of account */
+size_t dt_mem_account_get(const dt_mem_account_t account, size_t *peak);
+
+/** print all accounts with -d memory */
+void dt_mem_account_print(const char *info);
+/** print the high-water marks on one line with the given debug flags */
+void dt_mem_account_print_peaks(const int flags, const char *info);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
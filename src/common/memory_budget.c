@@ -0,0 +1,316 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/memory_budget.h"
+#include "common/atomic.h"
+#include "common/darktable.h"
+#include "common/image_cache.h"
+#include "common/memory_account.h"
+#include "common/mipmap_cache.h"
+#include "control/conf.h"
+#include "develop/pixelpipe_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// poll interval and thresholds, pressure is the share of time in percent
+// some task was stalled on memory over the last 10 seconds
+#define DT_BUDGET_POLL_SECONDS 2
+#define DT_BUDGET_PRESSURE_HIGH 10.0f
+#define DT_BUDGET_PRESSURE_LOW 1.0f
+#define DT_BUDGET_CGROUP_HIGH 0.90
+#define DT_BUDGET_CGROUP_LOW 0.75
+// polls without pressure before a budget grows again
+#define DT_BUDGET_CALM_POLLS 5
+// budgets are scaled in permille
+#define DT_BUDGET_SCALE_MIN 250
+#define DT_BUDGET_SCALE_SHRINK 700
+#define DT_BUDGET_SCALE_GROW 100
+
+typedef struct _budget_cache_t
+{
+  const char *name;
+  dt_cache_t *cache;
+  size_t quota; // at startup
+  gboolean bytes; // cost is in bytes, otherwise in buffers
+} _budget_cache_t;
+
+typedef struct _budget_t
+{
+  gboolean running;
+  pthread_t thread;
+  GMutex lock;
+  GCond cond;
+  gchar *pressure_file; // memory.pressure of our cgroup or the system wide one
+  gchar *cgroup_dir;    // holding memory.max and memory.current, NULL if unlimited
+  _budget_cache_t caches[4];
+  int num_caches;
+  int calm;
+} _budget_t;
+
+static _budget_t _budget = { .running = FALSE };
+
+// the scale is read by the pipes, even if the coordinator isn't running
+static dt_atomic_int _budget_scale = 1000;
+
+float dt_memory_budget_scale(void)
+{
+  return dt_atomic_get_int(&_budget_scale) / 1000.0f;
+}
+
+// returns TRUE on success
+static gboolean _read_pressure(const char *filename, float *avg10)
+{
+  FILE *f = filename ? fopen(filename, "r") : NULL;
+  if(!f) return FALSE;
+
+  gboolean found = FALSE;
+  char line[256];
+  while(!found && fgets(line, sizeof(line), f))
+    found = sscanf(line, "some avg10=%f", avg10) == 1;
+  fclose(f);
+  return found;
+}
+
+// returns 0 if the file can't be read or holds "max"
+static guint64 _read_cgroup_value(const char *dir, const char *name)
+{
+  gchar *filename = g_build_filename(dir, name, NULL);
+  gchar *content = NULL;
+  guint64 value = 0;
+  if(g_file_get_contents(filename, &content, NULL, NULL))
+    value = g_ascii_strtoull(content, NULL, 10);
+  g_free(content);
+  g_free(filename);
+  return value;
+}
+
+static void _find_pressure_files(void)
+{
+#ifdef __linux__
+  // cgroup v2, a single line "0::/path"
+  gchar *content = NULL;
+  if(g_file_get_contents("/proc/self/cgroup", &content, NULL, NULL))
+  {
+    gchar **lines = g_strsplit(content, "\n", -1);
+    for(gchar **line = lines; *line; line++)
+    {
+      if(!g_str_has_prefix(*line, "0::")) continue;
+
+      gchar *dir = g_build_filename("/sys/fs/cgroup", *line + 3, NULL);
+      gchar *pressure = g_build_filename(dir, "memory.pressure", NULL);
+      float avg10 = 0.0f;
+      if(_read_pressure(pressure, &avg10))
+        _budget.pressure_file = pressure;
+      else
+        g_free(pressure);
+
+      if(_read_cgroup_value(dir, "memory.max"))
+        _budget.cgroup_dir = dir;
+      else
+        g_free(dir);
+      break;
+    }
+    g_strfreev(lines);
+    g_free(content);
+  }
+
+  float avg10 = 0.0f;
+  if(!_budget.pressure_file && _read_pressure("/proc/pressure/memory", &avg10))
+    _budget.pressure_file = g_strdup("/proc/pressure/memory");
+#endif
+}
+
+static void _add_cache(const char *name, dt_cache_t *cache, const gboolean bytes)
+{
+  _budget_cache_t *c = &_budget.caches[_budget.num_caches++];
+  c->name = name;
+  c->cache = cache;
+  c->quota = cache->cost_quota;
+  c->bytes = bytes;
+}
+
+static void _apply_scale(const int scale, const gboolean shrink)
+{
+  dt_atomic_set_int(&_budget_scale, scale);
+
+  for(int k = 0; k < _budget.num_caches; k++)
+  {
+    _budget_cache_t *c = &_budget.caches[k];
+    // the quota is only read by the caches, never a hard limit
+    c->cache->cost_quota = MAX(1, c->quota * scale / 1000);
+    if(shrink) dt_cache_gc(c->cache, 1.0f);
+  }
+
+  size_t freed = 0;
+  if(shrink) freed = dt_dev_pixelpipe_cache_global_trim();
+
+  dt_print(DT_DEBUG_MEMORY | DT_DEBUG_CACHE,
+           "[memory_budget] %s budgets to %d%%%s",
+           shrink ? "lowered" : "raised", scale / 10,
+           freed ? ", released idle pipe buffers" : "");
+  // who holds the memory while we are under pressure
+  if(shrink) dt_mem_account_print("under memory pressure");
+}
+
+static void _poll(void)
+{
+  float avg10 = 0.0f;
+  const gboolean have_pressure = _read_pressure(_budget.pressure_file, &avg10);
+
+  double fill = 0.0;
+  if(_budget.cgroup_dir)
+  {
+    const guint64 max = _read_cgroup_value(_budget.cgroup_dir, "memory.max");
+    const guint64 current = _read_cgroup_value(_budget.cgroup_dir, "memory.current");
+    if(max) fill = (double)current / (double)max;
+  }
+
+  const int scale = dt_atomic_get_int(&_budget_scale);
+  if((have_pressure && avg10 > DT_BUDGET_PRESSURE_HIGH) || fill > DT_BUDGET_CGROUP_HIGH)
+  {
+    _budget.calm = 0;
+    const int lowered = MAX(DT_BUDGET_SCALE_MIN, scale * DT_BUDGET_SCALE_SHRINK / 1000);
+    // keep collecting even at the minimum, more might have been freed by now
+    _apply_scale(lowered, TRUE);
+  }
+  else if((!have_pressure || avg10 < DT_BUDGET_PRESSURE_LOW)
+          && fill < DT_BUDGET_CGROUP_LOW
+          && scale < 1000)
+  {
+    if(++_budget.calm >= DT_BUDGET_CALM_POLLS)
+    {
+      _budget.calm = 0;
+      _apply_scale(MIN(1000, scale + DT_BUDGET_SCALE_GROW), FALSE);
+    }
+  }
+  else
+    _budget.calm = 0;
+}
+
+static void *_budget_thread(void *arg)
+{
+  dt_pthread_setname("memory budget");
+
+  g_mutex_lock(&_budget.lock);
+  while(_budget.running)
+  {
+    const gint64 end = g_get_monotonic_time() + DT_BUDGET_POLL_SECONDS * G_TIME_SPAN_SECOND;
+    if(!g_cond_wait_until(&_budget.cond, &_budget.lock, end) && _budget.running)
+    {
+      g_mutex_unlock(&_budget.lock);
+      _poll();
+      g_mutex_lock(&_budget.lock);
+    }
+  }
+  g_mutex_unlock(&_budget.lock);
+  return NULL;
+}
+
+void dt_memory_budget_init(void)
+{
+  dt_atomic_set_int(&_budget_scale, 1000);
+  if(!dt_conf_get_bool("memory_pressure_aware")) return;
+
+  _find_pressure_files();
+  if(!_budget.pressure_file && !_budget.cgroup_dir)
+  {
+    dt_print(DT_DEBUG_MEMORY, "[memory_budget] no memory pressure information available");
+    return;
+  }
+
+  _budget.num_caches = 0;
+  dt_mipmap_cache_t *mipmap = darktable.mipmap_cache;
+  if(mipmap)
+  {
+    _add_cache("thumbnails", &mipmap->mip_thumbs.cache, TRUE);
+    _add_cache("full images", &mipmap->mip_full.cache, FALSE);
+    _add_cache("float previews", &mipmap->mip_f.cache, FALSE);
+  }
+  if(darktable.image_cache)
+    _add_cache("images", &darktable.image_cache->cache, TRUE);
+
+  g_mutex_init(&_budget.lock);
+  g_cond_init(&_budget.cond);
+  _budget.calm = 0;
+  _budget.running = TRUE;
+  if(dt_pthread_create(&_budget.thread, _budget_thread, NULL))
+  {
+    _budget.running = FALSE;
+    g_mutex_clear(&_budget.lock);
+    g_cond_clear(&_budget.cond);
+    return;
+  }
+
+  dt_print(DT_DEBUG_MEMORY, "[memory_budget] watching %s%s%s",
+           _budget.pressure_file ? _budget.pressure_file : "",
+           _budget.pressure_file && _budget.cgroup_dir ? " and the limit of " : "",
+           _budget.cgroup_dir ? _budget.cgroup_dir : "");
+}
+
+void dt_memory_budget_cleanup(void)
+{
+  if(_budget.running)
+  {
+    g_mutex_lock(&_budget.lock);
+    _budget.running = FALSE;
+    g_cond_signal(&_budget.cond);
+    g_mutex_unlock(&_budget.lock);
+    pthread_join(_budget.thread, NULL);
+    g_mutex_clear(&_budget.lock);
+    g_cond_clear(&_budget.cond);
+
+    if(darktable.unmuted & DT_DEBUG_MEMORY) dt_memory_budget_print();
+
+    // leave the caches as configured
+    for(int k = 0; k < _budget.num_caches; k++)
+      _budget.caches[k].cache->cost_quota = _budget.caches[k].quota;
+    _budget.num_caches = 0;
+  }
+  dt_atomic_set_int(&_budget_scale, 1000);
+  g_free(_budget.pressure_file);
+  g_free(_budget.cgroup_dir);
+  _budget.pressure_file = _budget.cgroup_dir = NULL;
+}
+
+void dt_memory_budget_print(void)
+{
+  dt_print(DT_DEBUG_ALWAYS, "[memory_budget] budgets at %d%%",
+           dt_atomic_get_int(&_budget_scale) / 10);
+  for(int k = 0; k < _budget.num_caches; k++)
+  {
+    _budget_cache_t *c = &_budget.caches[k];
+    const size_t cost = dt_cache_get_cost(c->cache);
+    if(c->bytes)
+      dt_print(DT_DEBUG_ALWAYS, "[memory_budget]   %-14s %.1f/%.1f MB",
+               c->name, cost / (1024.0 * 1024.0), c->cache->cost_quota / (1024.0 * 1024.0));
+    else
+      dt_print(DT_DEBUG_ALWAYS, "[memory_budget]   %-14s %zu/%zu buffers",
+               c->name, cost, c->cache->cost_quota);
+  }
+  size_t idle = 0;
+  const size_t used = dt_dev_pixelpipe_cache_global_usage(&idle);
+  dt_print(DT_DEBUG_ALWAYS, "[memory_budget]   %-14s %.1f MB, %.1f MB idle",
+           "pipe buffers", used / (1024.0 * 1024.0), idle / (1024.0 * 1024.0));
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,54 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Coordinates the cache budgets with the memory pressure of the system.
+   The budgets derived from the resource level at startup are the maximum.
+   While the kernel reports memory pressure (Linux PSI of our cgroup or the
+   whole system) or the cgroup gets close to its memory.max, all budgets are
+   scaled down and the caches are garbage collected. Once the pressure is
+   gone for a while they grow back step by step.
+   Caches with their own locking (mipmap and image caches, the pixelpipe
+   buffer pool) are shrunk right away, the pixelpipe caches honour the
+   lowered limit on their next dt_dev_pixelpipe_cache_checkmem().
+   Disabled by conf key 'memory_pressure_aware' and where PSI isn't available.
+*/
+
+// must be called after the image, mipmap and pixelpipe caches are set up
+void dt_memory_budget_init(void);
+// stops the coordinator, must be called before the caches are cleaned up
+void dt_memory_budget_cleanup(void);
+
+// current fraction of the startup budgets to be used, 1.0 without pressure.
+float dt_memory_budget_scale(void);
+
+// print the usage of all coordinated caches
+void dt_memory_budget_print(void);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
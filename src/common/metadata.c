@@ -348,6 +348,7 @@ static void _pop_undo(gpointer user_data,
 {
   if(type == DT_UNDO_METADATA)
   {
+    dt_database_start_transaction(darktable.db);
     for(GList *list = (GList *)data; list; list = g_list_next(list))
     {
       dt_undo_metadata_t *undometadata = list->data;
@@ -357,6 +358,7 @@ static void _pop_undo(gpointer user_data,
       _pop_undo_execute(undometadata->imgid, before, after);
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(undometadata->imgid));
     }
+    dt_database_release_transaction(darktable.db);
 
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_MOUSE_OVER_IMAGE_CHANGE);
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_METADATA_CHANGED);
@@ -369,19 +371,50 @@ GList *dt_metadata_get_list_id(const dt_imgid_t imgid)
   if(!dt_is_valid_imgid(imgid))
     return NULL;
 
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT key, value FROM main.meta_data WHERE id=?1", -1, &stmt, NULL);
+  sqlite3_stmt *stmt =
+    dt_database_prepare_cached(darktable.db,
+                               "SELECT key, value FROM main.meta_data WHERE id=?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const gchar *value = (const char *)sqlite3_column_text(stmt, 1);
     gchar *ckey = g_strdup_printf("%d", sqlite3_column_int(stmt, 0));
     gchar *cvalue = g_strdup(value ? value : ""); // to avoid NULL value
-    metadata = g_list_append(metadata, (gpointer)ckey);
-    metadata = g_list_append(metadata, (gpointer)cvalue);
+    metadata = g_list_prepend(metadata, (gpointer)ckey);
+    metadata = g_list_prepend(metadata, (gpointer)cvalue);
+  }
+  dt_database_release_cached(darktable.db, stmt);
+  return g_list_reverse(metadata);
+}
+
+GHashTable *dt_metadata_get_list_id_images(const GList *imgs)
+{
+  GHashTable *metadata = g_hash_table_new(NULL, NULL);
+  gchar *images = NULL;
+  for(const GList *l = imgs; l; l = g_list_next(l))
+    dt_util_str_cat(&images, "%d,", GPOINTER_TO_INT(l->data));
+  if(!images) return metadata;
+  images[strlen(images) - 1] = '\0';
+
+  sqlite3_stmt *stmt;
+  gchar *query = g_strdup_printf("SELECT id, key, value FROM main.meta_data"
+                                 " WHERE id IN (%s)"
+                                 " ORDER BY id DESC, key DESC, value DESC", images);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  // rows are read backwards so the lists can be prepended to, they
+  // end up in the order of dt_metadata_get_list_id()
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    gpointer imgid = GINT_TO_POINTER(sqlite3_column_int(stmt, 0));
+    const gchar *value = (const char *)sqlite3_column_text(stmt, 2);
+    GList *list = g_hash_table_lookup(metadata, imgid);
+    list = g_list_prepend(list, g_strdup(value ? value : "")); // to avoid NULL value
+    list = g_list_prepend(list, g_strdup_printf("%d", sqlite3_column_int(stmt, 1)));
+    g_hash_table_insert(metadata, imgid, list);
   }
   sqlite3_finalize(stmt);
+  g_free(query);
+  g_free(images);
   return metadata;
 }
 
@@ -617,13 +650,19 @@ static void _metadata_execute(const GList *imgs,
                               const gboolean undo_on,
                               const gint action)
 {
+  // read the metadata of all images at once and write them in a single
+  // transaction, instead of a round trip per image
+  dt_database_start_transaction(darktable.db);
+  GHashTable *current = dt_metadata_get_list_id_images(imgs);
+  GList *done = NULL;
   for(const GList *images = imgs; images; images = g_list_next(images))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(images->data);
 
     dt_undo_metadata_t *undometadata = malloc(sizeof(dt_undo_metadata_t));
     undometadata->imgid = imgid;
-    undometadata->before = dt_metadata_get_list_id(imgid);
+    undometadata->before = g_hash_table_lookup(current, GINT_TO_POINTER(imgid));
+    g_hash_table_steal(current, GINT_TO_POINTER(imgid));
     switch(action)
     {
       case DT_MA_SET:
@@ -645,10 +684,19 @@ static void _metadata_execute(const GList *imgs,
     _pop_undo_execute(imgid, undometadata->before, undometadata->after);
 
     if(undo_on)
-      *undo = g_list_append(*undo, undometadata);
+      done = g_list_prepend(done, undometadata);
     else
       _undo_metadata_free(undometadata);
   }
+  // images are expected once in the list, nothing should be left
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, current);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+    g_list_free_full(value, g_free);
+  g_hash_table_destroy(current);
+  dt_database_release_transaction(darktable.db);
+  if(undo_on) *undo = g_list_concat(*undo, g_list_reverse(done));
 }
 
 void dt_metadata_set(const dt_imgid_t imgid,
@@ -110,6 +110,10 @@ GList *dt_metadata_get(const dt_imgid_t imgid, const char *key, uint32_t *count)
 /** Get metadata (id keys) for a specific image. The caller has to free the list after usage. */
 GList *dt_metadata_get_list_id(const dt_imgid_t imgid); // libs/image.c
 
+/** Same as dt_metadata_get_list_id() for all images in one query, imgid -> list.
+    Images without metadata aren't in the table. The caller has to free the lists and the table. */
+GHashTable *dt_metadata_get_list_id_images(const GList *imgs);
+
 /** Remove metadata from images in list */
 void dt_metadata_clear(const GList *imgs, const gboolean undo_on); // libs/metadata.c
 
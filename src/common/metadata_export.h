@@ -35,6 +35,7 @@ typedef struct dt_export_metadata_t
 {
   int32_t flags;
   GList *list;
+  int queue_batch; // batch in the persistent export queue, 0 if none
 } dt_export_metadata_t;
 
 uint32_t dt_lib_export_metadata_default_flags(void);
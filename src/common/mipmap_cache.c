@@ -23,12 +23,20 @@
 #include "common/file_location.h"
 #include "common/grealpath.h"
 #include "common/image_cache.h"
+#include "common/memory_account.h"
+#include "common/mipmap_residency.h"
+#include "common/phash.h"
+#include "common/thumbstore.h"
+#include "common/utility.h"
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
+#include "develop/pixelpipe_cache.h"
+#include "develop/pixelpipe_hb.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_jpeg.h"
 #include "imageio/imageio_module.h"
+#include "imageio/qoi.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -415,7 +423,11 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf,
   // so only check size and re-alloc if necessary:
   if(!buf->buf || _is_static_image((void *)dsc) || (entry->data_size < buffer_size))
   {
-    if(!_is_static_image((void *)dsc)) dt_free_align(entry->data);
+    if(!_is_static_image((void *)dsc))
+    {
+      dt_mem_account_free(DT_MEM_ACCOUNT_MIPMAP + DT_MIPMAP_FULL, entry->data_size);
+      dt_free_align(entry->data);
+    }
 
     entry->data_size = 0;
 
@@ -433,6 +445,7 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf,
     }
 
     entry->data_size = buffer_size;
+    dt_mem_account_alloc(DT_MEM_ACCOUNT_MIPMAP + DT_MIPMAP_FULL, buffer_size);
 
     // set buffer size only if we're making it larger.
     dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
@@ -461,6 +474,574 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf,
   return dsc + 1;
 }
 
+// how a DT_MIPMAP_FULL or DT_MIPMAP_F buffer has been produced, to tell
+// whether a compressed copy still matches the image
+typedef struct _mipmap_resident_meta_t
+{
+  dt_image_loader_t loader;
+  int32_t img_width;
+  int32_t img_height;
+  dt_iop_buffer_dsc_t buf_dsc;
+  uint32_t width;
+  uint32_t height;
+  float iscale;
+} _mipmap_resident_meta_t;
+
+static void _mipmap_resident_meta(_mipmap_resident_meta_t *meta,
+                                  const dt_image_t *img,
+                                  const uint32_t width,
+                                  const uint32_t height,
+                                  const float iscale)
+{
+  // zeroed for the memcmp, there may be padding
+  memset(meta, 0, sizeof(_mipmap_resident_meta_t));
+  meta->loader = img->loader;
+  meta->img_width = img->width;
+  meta->img_height = img->height;
+  meta->buf_dsc = img->buf_dsc;
+  meta->width = width;
+  meta->height = height;
+  meta->iscale = iscale;
+}
+
+// a full or f buffer has just been produced from img, let the compressed
+// tier know so it can take it over once evicted
+static void _mipmap_cache_note_resident(dt_mipmap_cache_t *cache,
+                                        const uint32_t key,
+                                        const dt_image_t *img,
+                                        const dt_mipmap_buffer_dsc_t *dsc)
+{
+  if(!cache->residency
+     || img->loader == LOADER_UNKNOWN
+     || _is_static_image((void *)dsc))
+    return;
+
+  const size_t bpp = dt_iop_buffer_dsc_to_bpp(&img->buf_dsc);
+  const size_t size = (size_t)dsc->width * dsc->height * bpp;
+  if(size == 0 || size > dsc->size - sizeof(dt_mipmap_buffer_dsc_t))
+    return;
+
+  _mipmap_resident_meta_t meta;
+  _mipmap_resident_meta(&meta, img, dsc->width, dsc->height, dsc->iscale);
+  const int elem_size = img->buf_dsc.datatype == TYPE_UINT16 ? 2
+                      : img->buf_dsc.datatype == TYPE_FLOAT ? 4 : 1;
+  // the closest sample of the same colour: two pixels away in a mosaic row,
+  // the same channel of the previous pixel otherwise
+  const int stride = img->buf_dsc.channels == 1 ? 2 : img->buf_dsc.channels;
+  dt_mipmap_residency_note(cache->residency, key, &meta, sizeof(meta),
+                           size, elem_size, stride);
+}
+
+// fill a write locked full or f buffer from its compressed copy instead of
+// decoding the file again, returns TRUE on success
+static gboolean _mipmap_cache_restore_resident(dt_mipmap_cache_t *cache,
+                                               dt_mipmap_buffer_t *buf,
+                                               const dt_image_t *img,
+                                               const char *filename)
+{
+  if(!cache->residency) return FALSE;
+
+  const uint32_t key = _get_key(img->id, buf->size);
+  _mipmap_resident_meta_t meta;
+  size_t size = 0;
+  gint64 time = 0;
+  if(!dt_mipmap_residency_lookup(cache->residency, key, &meta, sizeof(meta), &size, &time))
+    return FALSE;
+
+  // the image struct has to still hold what the loader set, it's reset when
+  // re-read from the database, and the file must not have changed since
+  _mipmap_resident_meta_t current;
+  _mipmap_resident_meta(&current, img, meta.width, meta.height, meta.iscale);
+  GStatBuf statbuf;
+  if(memcmp(&current, &meta, sizeof(meta))
+     || !filename || !*filename
+     || g_stat(filename, &statbuf)
+     || (gint64)statbuf.st_mtime * G_USEC_PER_SEC > time)
+  {
+    dt_mipmap_residency_remove(cache->residency, key);
+    return FALSE;
+  }
+
+  dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)buf->cache_entry->data;
+  if(buf->size == DT_MIPMAP_FULL)
+  {
+    buf->buf = NULL;
+    if(!dt_mipmap_cache_alloc(buf, img)) return FALSE;
+    dsc = (dt_mipmap_buffer_dsc_t *)buf->cache_entry->data;
+  }
+  if(_is_static_image((void *)dsc)
+     || size > dsc->size - sizeof(dt_mipmap_buffer_dsc_t)
+     || dt_mipmap_residency_restore(cache->residency, key, dsc + 1, size))
+    return FALSE;
+
+  dsc->width = meta.width;
+  dsc->height = meta.height;
+  dsc->iscale = meta.iscale;
+  dsc->color_space = DT_COLORSPACE_NONE;
+  dt_print(DT_DEBUG_CACHE,
+           "[mipmap_cache] restored mip %d for ID=%d from the compressed tier",
+           buf->size, img->id);
+  return TRUE;
+}
+
+static inline dt_thumbstore_t *_thumbstore(const dt_mipmap_cache_t *cache,
+                                           const dt_mipmap_size_t mip)
+{
+  return mip <= DT_MIPMAP_LDR_MAX ? cache->thumbstore[mip] : NULL;
+}
+
+static gboolean _mipmap_compressed_contains(struct dt_mipmap_compressed_t *tier,
+                                            const uint32_t key);
+
+static gboolean _mipmap_cache_ondisk_thumbnail_exists(const dt_mipmap_cache_t *cache,
+                                                      const dt_imgid_t imgid,
+                                                      const dt_mipmap_size_t mip)
+{
+  if(_mipmap_compressed_contains(cache->compressed, _get_key(imgid, mip))) return TRUE;
+  if(!cache->cachedir[0]) return FALSE;
+  if(dt_thumbstore_contains(_thumbstore(cache, mip), imgid)) return TRUE;
+
+  char filename[PATH_MAX] = {0};
+  snprintf(filename, sizeof(filename),
+           "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
+  return g_file_test(filename, G_FILE_TEST_EXISTS);
+}
+
+// decode one blob of the packed store into out, returns TRUE on error
+static gboolean _mipmap_cache_decode_packed(const dt_mipmap_cache_t *cache,
+                                            const dt_mipmap_size_t mip,
+                                            const uint8_t *blob,
+                                            const size_t len,
+                                            const dt_thumbstore_codec_t codec,
+                                            uint8_t *out,
+                                            int32_t *width,
+                                            int32_t *height)
+{
+  switch(codec)
+  {
+    case DT_THUMBSTORE_CODEC_JPEG:
+    {
+      dt_imageio_jpeg_t jpg;
+      if(dt_imageio_jpeg_decompress_header(blob, len, &jpg)
+         || jpg.width > cache->max_width[mip]
+         || jpg.height > cache->max_height[mip]
+         || dt_imageio_jpeg_decompress(&jpg, out))
+        return TRUE;
+      *width = jpg.width;
+      *height = jpg.height;
+      return FALSE;
+    }
+    case DT_THUMBSTORE_CODEC_QOI:
+    {
+      qoi_desc desc;
+      uint8_t *pixels = len <= INT_MAX ? qoi_decode(blob, (int)len, &desc, 4) : NULL;
+      const gboolean failed = !pixels
+        || desc.width > cache->max_width[mip]
+        || desc.height > cache->max_height[mip];
+      if(!failed)
+      {
+        memcpy(out, pixels, (size_t)4 * desc.width * desc.height);
+        *width = desc.width;
+        *height = desc.height;
+      }
+      free(pixels);
+      return failed;
+    }
+    case DT_THUMBSTORE_CODEC_RAW:
+    {
+      uint32_t dim[2];
+      if(len < sizeof(dim)) return TRUE;
+      memcpy(dim, blob, sizeof(dim));
+      if(dim[0] > cache->max_width[mip]
+         || dim[1] > cache->max_height[mip]
+         || len != sizeof(dim) + (size_t)4 * dim[0] * dim[1])
+        return TRUE;
+      memcpy(out, blob + sizeof(dim), (size_t)4 * dim[0] * dim[1]);
+      *width = dim[0];
+      *height = dim[1];
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// decode the thumbnail straight out of the mapped packed store
+static gboolean _mipmap_cache_read_packed(dt_mipmap_cache_t *cache,
+                                          dt_cache_entry_t *entry,
+                                          const dt_mipmap_size_t mip)
+{
+  dt_thumbstore_t *store = _thumbstore(cache, mip);
+  const dt_imgid_t imgid = _get_imgid(entry->key);
+  size_t len = 0;
+  int color_space = DT_COLORSPACE_NONE;
+  dt_thumbstore_codec_t codec = DT_THUMBSTORE_CODEC_JPEG;
+  const uint8_t *blob = dt_thumbstore_get(store, imgid, &len, &color_space, &codec);
+  if(!blob) return FALSE;
+
+  dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
+  int32_t width = 0, height = 0;
+  const gboolean failed = _mipmap_cache_decode_packed(cache, mip, blob, len, codec,
+                                                      (uint8_t *)entry->data + sizeof(*dsc),
+                                                      &width, &height);
+  dt_thumbstore_release(store);
+
+  if(failed)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[mipmap_cache] failed to decompress thumbnail for ID=%d from packed disk cache!",
+             imgid);
+    dt_thumbstore_remove(store, imgid);
+    return FALSE;
+  }
+
+  dt_print(DT_DEBUG_CACHE,
+           "[mipmap_cache] grab mip %d for ID=%d from packed disk cache", mip, imgid);
+  dsc->width = width;
+  dsc->height = height;
+  dsc->iscale = 1.0f;
+  dsc->color_space = color_space;
+  return TRUE;
+}
+
+static dt_thumbstore_codec_t _mipmap_cache_packed_codec(void)
+{
+  if(dt_conf_is_equal("cache_disk_codec", "QOI"))
+    return DT_THUMBSTORE_CODEC_QOI;
+  if(dt_conf_is_equal("cache_disk_codec", "uncompressed"))
+    return DT_THUMBSTORE_CODEC_RAW;
+  return DT_THUMBSTORE_CODEC_JPEG;
+}
+
+// encode the pixels of a thumbnail with codec, the blob has to be free()d
+static uint8_t *_mipmap_cache_encode(const dt_mipmap_buffer_dsc_t *dsc,
+                                     const dt_thumbstore_codec_t codec,
+                                     size_t *len)
+{
+  const uint8_t *pixels = (const uint8_t *)(dsc + 1);
+  const size_t size = (size_t)4 * dsc->width * dsc->height;
+  switch(codec)
+  {
+    case DT_THUMBSTORE_CODEC_JPEG:
+    {
+      uint8_t *blob = malloc(size);
+      if(!blob) return NULL;
+      const int cache_quality = dt_conf_get_int("database_cache_quality");
+      const int jpg_len = dt_imageio_jpeg_compress(pixels, blob, dsc->width, dsc->height,
+                                                   MIN(100, MAX(10, cache_quality)));
+      // dt_imageio_jpeg_compress() returns 1 on error
+      if(jpg_len <= 1)
+      {
+        free(blob);
+        return NULL;
+      }
+      *len = jpg_len;
+      return blob;
+    }
+    case DT_THUMBSTORE_CODEC_QOI:
+    {
+      const qoi_desc desc = { .width = dsc->width, .height = dsc->height,
+                              .channels = 4, .colorspace = QOI_SRGB };
+      int qoi_len = 0;
+      uint8_t *blob = qoi_encode(pixels, &desc, &qoi_len);
+      *len = qoi_len;
+      return blob;
+    }
+    case DT_THUMBSTORE_CODEC_RAW:
+    {
+      const uint32_t dim[2] = { dsc->width, dsc->height };
+      uint8_t *blob = malloc(sizeof(dim) + size);
+      if(!blob) return NULL;
+      memcpy(blob, dim, sizeof(dim));
+      memcpy(blob + sizeof(dim), pixels, size);
+      *len = sizeof(dim) + size;
+      return blob;
+    }
+  }
+  return NULL;
+}
+
+static void _mipmap_cache_write_packed(dt_mipmap_cache_t *cache,
+                                       dt_thumbstore_t *store,
+                                       const dt_mipmap_buffer_dsc_t *dsc,
+                                       const dt_imgid_t imgid)
+{
+  // same free space guard as for the single jpg files
+  char dirname[PATH_MAX] = {0};
+  snprintf(dirname, sizeof(dirname), "%s.d", cache->cachedir);
+  struct statvfs vfsbuf;
+  if(statvfs(dirname, &vfsbuf) || ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20) < 100)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[mipmap_cache] aborting packed thumbnail write for ID=%d, not enough free space in %s",
+             imgid, dirname);
+    return;
+  }
+
+  const dt_thumbstore_codec_t codec = _mipmap_cache_packed_codec();
+  size_t len = 0;
+  uint8_t *blob = _mipmap_cache_encode(dsc, codec, &len);
+  if(blob)
+    dt_thumbstore_put(store, imgid, blob, len, dsc->color_space, codec);
+  free(blob);
+}
+
+// compressed copies of evicted thumbnails, kept in memory with the codec
+// of the packed disk cache so that many more of them fit than decoded
+typedef struct _mipmap_compressed_entry_t
+{
+  uint32_t key;
+  int color_space;
+  dt_thumbstore_codec_t codec;
+  size_t len;
+  GList link;     // in the lru queue, data is the entry itself
+  uint8_t blob[];
+} _mipmap_compressed_entry_t;
+
+typedef struct dt_mipmap_compressed_t
+{
+  dt_pthread_mutex_t lock;
+  GHashTable *entries; // key -> _mipmap_compressed_entry_t
+  GQueue lru;          // least recently used first
+  size_t bytes;
+  size_t max_bytes;
+} dt_mipmap_compressed_t;
+
+// called with the lock held
+static void _mipmap_compressed_drop(dt_mipmap_compressed_t *tier,
+                                    _mipmap_compressed_entry_t *e)
+{
+  g_hash_table_remove(tier->entries, GUINT_TO_POINTER(e->key));
+  g_queue_unlink(&tier->lru, &e->link);
+  tier->bytes -= e->len;
+  g_free(e);
+}
+
+static dt_mipmap_compressed_t *_mipmap_compressed_new(const size_t max_bytes)
+{
+  dt_mipmap_compressed_t *tier = g_malloc0(sizeof(dt_mipmap_compressed_t));
+  dt_pthread_mutex_init(&tier->lock, NULL);
+  tier->entries = g_hash_table_new(NULL, NULL);
+  g_queue_init(&tier->lru);
+  tier->max_bytes = max_bytes;
+  dt_print(DT_DEBUG_CACHE, "[mipmap_cache] compressed thumbnails tier of %zu MB",
+           max_bytes >> 20);
+  return tier;
+}
+
+static void _mipmap_compressed_destroy(dt_mipmap_compressed_t *tier)
+{
+  if(!tier) return;
+  while(!g_queue_is_empty(&tier->lru))
+    _mipmap_compressed_drop(tier, g_queue_peek_head(&tier->lru));
+  g_hash_table_destroy(tier->entries);
+  dt_pthread_mutex_destroy(&tier->lock);
+  g_free(tier);
+}
+
+static gboolean _mipmap_compressed_contains(dt_mipmap_compressed_t *tier,
+                                            const uint32_t key)
+{
+  if(!tier) return FALSE;
+  dt_pthread_mutex_lock(&tier->lock);
+  const gboolean found = g_hash_table_contains(tier->entries, GUINT_TO_POINTER(key));
+  dt_pthread_mutex_unlock(&tier->lock);
+  return found;
+}
+
+static void _mipmap_compressed_remove(dt_mipmap_compressed_t *tier,
+                                      const uint32_t key)
+{
+  if(!tier) return;
+  dt_pthread_mutex_lock(&tier->lock);
+  _mipmap_compressed_entry_t *e = g_hash_table_lookup(tier->entries, GUINT_TO_POINTER(key));
+  if(e) _mipmap_compressed_drop(tier, e);
+  dt_pthread_mutex_unlock(&tier->lock);
+}
+
+// keep the thumbnail of an evicted entry, unless it's there already
+static void _mipmap_compressed_put(dt_mipmap_compressed_t *tier,
+                                   const uint32_t key,
+                                   const dt_mipmap_buffer_dsc_t *dsc)
+{
+  if(_mipmap_compressed_contains(tier, key)) return;
+
+  const dt_thumbstore_codec_t codec = _mipmap_cache_packed_codec();
+  size_t len = 0;
+  uint8_t *blob = _mipmap_cache_encode(dsc, codec, &len);
+  if(!blob || len > tier->max_bytes / 8)
+  {
+    free(blob);
+    return;
+  }
+
+  _mipmap_compressed_entry_t *e = g_try_malloc(sizeof(_mipmap_compressed_entry_t) + len);
+  if(e)
+  {
+    e->key = key;
+    e->color_space = dsc->color_space;
+    e->codec = codec;
+    e->len = len;
+    e->link = (GList){ .data = e };
+    memcpy(e->blob, blob, len);
+
+    dt_pthread_mutex_lock(&tier->lock);
+    _mipmap_compressed_entry_t *old = g_hash_table_lookup(tier->entries, GUINT_TO_POINTER(key));
+    if(old) _mipmap_compressed_drop(tier, old);
+    g_hash_table_insert(tier->entries, GUINT_TO_POINTER(key), e);
+    g_queue_push_tail_link(&tier->lru, &e->link);
+    tier->bytes += len;
+    // the least recently used ones make room
+    while(tier->bytes > tier->max_bytes)
+      _mipmap_compressed_drop(tier, g_queue_peek_head(&tier->lru));
+    dt_pthread_mutex_unlock(&tier->lock);
+  }
+  free(blob);
+}
+
+// decode the thumbnail of entry from the compressed tier
+static gboolean _mipmap_compressed_read(dt_mipmap_cache_t *cache,
+                                        dt_cache_entry_t *entry,
+                                        const dt_mipmap_size_t mip)
+{
+  dt_mipmap_compressed_t *tier = cache->compressed;
+  if(!tier) return FALSE;
+
+  // a copy of the blob, to decode without holding the lock
+  dt_pthread_mutex_lock(&tier->lock);
+  _mipmap_compressed_entry_t *e = g_hash_table_lookup(tier->entries,
+                                                      GUINT_TO_POINTER(entry->key));
+  _mipmap_compressed_entry_t *copy = NULL;
+  if(e)
+  {
+    g_queue_unlink(&tier->lru, &e->link);
+    g_queue_push_tail_link(&tier->lru, &e->link);
+    copy = g_try_malloc(sizeof(_mipmap_compressed_entry_t) + e->len);
+    if(copy) memcpy(copy, e, sizeof(_mipmap_compressed_entry_t) + e->len);
+  }
+  dt_pthread_mutex_unlock(&tier->lock);
+  if(!copy) return FALSE;
+
+  dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
+  int32_t width = 0, height = 0;
+  const gboolean failed = _mipmap_cache_decode_packed(cache, mip, copy->blob, copy->len,
+                                                      copy->codec,
+                                                      (uint8_t *)entry->data + sizeof(*dsc),
+                                                      &width, &height);
+  const int color_space = copy->color_space;
+  g_free(copy);
+
+  if(failed)
+  {
+    _mipmap_compressed_remove(tier, entry->key);
+    return FALSE;
+  }
+
+  dt_print(DT_DEBUG_CACHE,
+           "[mipmap_cache] grab mip %d for ID=%d from the compressed tier",
+           mip, _get_imgid(entry->key));
+  dsc->width = width;
+  dsc->height = height;
+  dsc->iscale = 1.0f;
+  dsc->color_space = color_space;
+  return TRUE;
+}
+
+// an 8-bit thumbnail being generated for a cancellable request
+typedef struct _mipmap_generation_t
+{
+  dt_imgid_t imgid;
+  dt_mipmap_size_t mip;
+  const void *owner;
+  dt_atomic_int cancel;
+} _mipmap_generation_t;
+
+// who asks for thumbnails in this thread, see dt_mipmap_cache_set_owner()
+static __thread const void *_thread_owner = NULL;
+
+void dt_mipmap_cache_set_owner(const void *owner)
+{
+  _thread_owner = owner;
+}
+
+static void _mipmap_generation_begin(dt_mipmap_cache_t *cache,
+                                     _mipmap_generation_t *gen)
+{
+  dt_pthread_mutex_lock(&cache->generating_mutex);
+  cache->generating = g_list_prepend(cache->generating, gen);
+  dt_pthread_mutex_unlock(&cache->generating_mutex);
+  // the thumbnail pipe runs in this thread, let it watch the flag
+  dt_dev_pixelpipe_set_thread_cancel(&gen->cancel);
+}
+
+// returns TRUE if the generation has been cancelled meanwhile
+static gboolean _mipmap_generation_end(dt_mipmap_cache_t *cache,
+                                       _mipmap_generation_t *gen)
+{
+  dt_dev_pixelpipe_set_thread_cancel(NULL);
+  dt_pthread_mutex_lock(&cache->generating_mutex);
+  cache->generating = g_list_remove(cache->generating, gen);
+  dt_pthread_mutex_unlock(&cache->generating_mutex);
+  return dt_atomic_get_int(&gen->cancel) != 0;
+}
+
+void dt_mipmap_cache_cancel(const dt_imgid_t imgid,
+                            const dt_mipmap_size_t mip,
+                            const void *owner)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  // requests nobody claimed may serve several views, they are never cancelled
+  if(!cache || !owner) return;
+  dt_pthread_mutex_lock(&cache->generating_mutex);
+  for(GList *l = cache->generating; l; l = g_list_next(l))
+  {
+    _mipmap_generation_t *gen = l->data;
+    if(gen->imgid == imgid
+       && gen->owner == owner
+       && (mip == DT_MIPMAP_NONE || gen->mip == mip))
+    {
+      dt_atomic_set_int(&gen->cancel, 1);
+      dt_print(DT_DEBUG_CACHE,
+               "[mipmap_cache] cancel generating mip %d for ID=%d", gen->mip, imgid);
+    }
+  }
+  dt_pthread_mutex_unlock(&cache->generating_mutex);
+}
+
+// mip pyramid: fill the smaller thumbnail levels of an image from a freshly
+// generated one, a downscale is much cheaper than running the pipe again
+// once the lighttable asks for another zoom level
+static void _mipmap_cache_derive_smaller(dt_mipmap_cache_t *cache,
+                                         const dt_imgid_t imgid,
+                                         const dt_mipmap_size_t mip,
+                                         const dt_mipmap_buffer_dsc_t *src)
+{
+  for(int k = (int)mip - 1; k >= DT_MIPMAP_0; k--)
+  {
+    // available already, or can be cheaply read from disk
+    dt_cache_t *c = &_get_cache(cache, k)->cache;
+    const uint32_t key = _get_key(imgid, k);
+    if(dt_cache_contains(c, key) || _mipmap_cache_ondisk_thumbnail_exists(cache, imgid, k))
+      continue;
+
+    dt_cache_entry_t *entry = dt_cache_get(c, key, 'w');
+    ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
+    dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
+    if((dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE) && !_is_static_image((void *)dsc))
+    {
+      ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(dt_mipmap_buffer_dsc_t));
+      dt_iop_flip_and_zoom_8((const uint8_t *)(src + 1), src->width, src->height,
+                             (uint8_t *)(dsc + 1), cache->max_width[k], cache->max_height[k],
+                             ORIENTATION_NONE, &dsc->width, &dsc->height);
+      dsc->iscale = 1.0f;
+      dsc->color_space = src->color_space;
+      dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+      dt_print(DT_DEBUG_CACHE,
+               "[mipmap_cache] derive mip %d for ID=%d from level %d", k, imgid, mip);
+    }
+    dt_cache_release(c, entry);
+  }
+}
+
 // callback for the cache backend to initialize payload pointers
 static void _mipmap_cache_allocate_dynamic(void *data,
                                            dt_cache_entry_t *entry)
@@ -499,6 +1080,7 @@ static void _mipmap_cache_allocate_dynamic(void *data,
       dt_print(DT_DEBUG_ALWAYS, "[mipmap_cache] memory allocation failed!");
       exit(1);
     }
+    dt_mem_account_alloc(DT_MEM_ACCOUNT_MIPMAP + mip, entry->data_size);
 
     dsc = entry->data;
 
@@ -525,16 +1107,23 @@ static void _mipmap_cache_allocate_dynamic(void *data,
   int loaded_from_disk = 0;
   if(mip <= DT_MIPMAP_LDR_MAX)
   {
-    if(cache->cachedir[0]
+    loaded_from_disk = _mipmap_compressed_read(cache, entry, mip);
+
+    if(!loaded_from_disk
+       && cache->cachedir[0]
        && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_LDR_MAX)
            || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_LDR_MAX)))
     {
       // try and load from disk, if successful set flag
+      loaded_from_disk = _mipmap_cache_read_packed(cache, entry, mip);
+
+      // fall back to the single files, they are migrated to the packed
+      // store when the entry gets evicted
       char filename[PATH_MAX] = {0};
       snprintf(filename, sizeof(filename),
                "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
                _get_imgid(entry->key));
-      FILE *f = g_fopen(filename, "rb");
+      FILE *f = loaded_from_disk ? NULL : g_fopen(filename, "rb");
       if(f)
       {
         uint8_t *blob = 0;
@@ -598,11 +1187,14 @@ static void _mipmap_cache_unlink_ondisk_thumbnail(void *data,
 {
   dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)data;
 
+  _mipmap_compressed_remove(cache->compressed, _get_key(imgid, mip));
+
   // also remove jpg backing (always try to do that, in case user just
   // temporarily switched it off, to avoid inconsistencies.
   // if(dt_conf_get_bool("cache_disk_backend"))
   if(cache->cachedir[0])
   {
+    dt_thumbstore_remove(_thumbstore(cache, mip), imgid);
     char filename[PATH_MAX] = { 0 };
     snprintf(filename, sizeof(filename),
              "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
@@ -615,12 +1207,21 @@ static void _mipmap_cache_deallocate_dynamic(void *data,
 {
   dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)data;
   const dt_mipmap_size_t mip = _get_size(entry->key);
+  // buffers adopted by the residency tier aren't ours anymore either
+  if(!_is_static_image(entry->data))
+    dt_mem_account_free(DT_MEM_ACCOUNT_MIPMAP + mip, entry->data_size);
   if(mip <= DT_MIPMAP_LDR_MAX)
   {
     dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
     // don't write skulls:
     if(dsc->width > ERR_IMG_MAX_DIM || dsc->height > ERR_IMG_MAX_DIM)
     {
+      // kept in memory independently of the disk backend
+      if(cache->compressed
+         && !(dsc->flags & (DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE
+                            | DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE)))
+        _mipmap_compressed_put(cache->compressed, entry->key, dsc);
+
       if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE)
       {
         _mipmap_cache_unlink_ondisk_thumbnail(data, _get_imgid(entry->key), mip);
@@ -631,6 +1232,16 @@ static void _mipmap_cache_deallocate_dynamic(void *data,
                   || (dt_conf_get_bool("cache_disk_backend_full")
                       && mip == DT_MIPMAP_LDR_MAX)))
       {
+        dt_thumbstore_t *store = _thumbstore(cache, mip);
+        const dt_imgid_t imgid = _get_imgid(entry->key);
+        if(store)
+        {
+          // thumbnails aren't rewritten, for the same reasons as below
+          if(!dt_thumbstore_contains(store, imgid))
+            _mipmap_cache_write_packed(cache, store, dsc, imgid);
+          goto finish;
+        }
+
         // serialize to disk
         char filename[PATH_MAX] = {0};
         snprintf(filename, sizeof(filename),
@@ -696,6 +1307,18 @@ write_error:
       }
     }
   }
+  else if(cache->residency && !_is_static_image(entry->data))
+  {
+    // full and f buffers may be kept compressed, that takes over the memory
+    const dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
+    if(dsc->width > ERR_IMG_MAX_DIM && dsc->height > ERR_IMG_MAX_DIM
+       && !(dsc->flags & (DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE
+                          | DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE))
+       && dt_mipmap_residency_adopt(cache->residency, entry->key,
+                                    entry->data, sizeof(dt_mipmap_buffer_dsc_t)))
+      return;
+  }
+finish:
   dt_free_align(entry->data);
 }
 
@@ -710,8 +1333,24 @@ void dt_mipmap_cache_init()
 {
   dt_mipmap_cache_t *cache = calloc(1, sizeof(dt_mipmap_cache_t));
   darktable.mipmap_cache = cache;
+  dt_pthread_mutex_init(&cache->generating_mutex, NULL);
 
   _mipmap_cache_get_filename(cache->cachedir, sizeof(cache->cachedir));
+
+  // optional packed disk backend, instead of one file per image and size
+  if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend_packed"))
+  {
+    char filename[PATH_MAX] = { 0 };
+    snprintf(filename, sizeof(filename), "%s.d", cache->cachedir);
+    if(!g_mkdir_with_parents(filename, 0750))
+    {
+      for(dt_mipmap_size_t k = DT_MIPMAP_0; k <= DT_MIPMAP_LDR_MAX; k++)
+      {
+        snprintf(filename, sizeof(filename), "%s.d/%d.thumbs", cache->cachedir, (int)k);
+        cache->thumbstore[k] = dt_thumbstore_open(filename);
+      }
+    }
+  }
   // make sure static memory is initialized
   dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)_mipmap_cache_static_dead_image;
   _dead_image_f((dt_mipmap_buffer_t *)(dsc + 1));
@@ -770,7 +1409,8 @@ void dt_mipmap_cache_init()
   cache->mip_full.stats_fetches = 0;
   cache->mip_full.stats_standin = 0;
 
-  dt_cache_init(&cache->mip_thumbs.cache, 0, max_mem);
+  // thumbnail generation and lighttable drawing hit this from many threads
+  dt_cache_init_sharded(&cache->mip_thumbs.cache, 0, max_mem, dt_get_num_threads());
   dt_cache_set_allocate_callback(&cache->mip_thumbs.cache,
                                  _mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_thumbs.cache,
@@ -798,6 +1438,16 @@ void dt_mipmap_cache_init()
   cache->buffer_size[DT_MIPMAP_F] = sizeof(dt_mipmap_buffer_dsc_t)
                                         + 4 * sizeof(float) * cache->max_width[DT_MIPMAP_F]
                                           * cache->max_height[DT_MIPMAP_F];
+
+  // optional compressed tier behind the full and f buffers
+  const int compressed_mb = dt_conf_get_int("cache_memory_compressed");
+  if(compressed_mb > 0)
+    cache->residency = dt_mipmap_residency_new((size_t)compressed_mb << 20);
+
+  // and behind the thumbnails
+  const int thumbs_mb = dt_conf_get_int("cache_memory_compressed_thumbs");
+  if(thumbs_mb > 0)
+    cache->compressed = _mipmap_compressed_new((size_t)thumbs_mb << 20);
 }
 
 void dt_mipmap_cache_cleanup()
@@ -805,9 +1455,20 @@ void dt_mipmap_cache_cleanup()
   dt_mipmap_cache_t *cache = darktable.mipmap_cache;
   if(!cache) return;
 
+  // nothing is worth compressing on the way out
+  dt_mipmap_residency_t *residency = cache->residency;
+  cache->residency = NULL;
+  dt_mipmap_compressed_t *compressed = cache->compressed;
+  cache->compressed = NULL;
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+  dt_mipmap_residency_destroy(residency);
+  _mipmap_compressed_destroy(compressed);
+  // after the caches, evicted entries end up in the stores
+  for(dt_mipmap_size_t k = DT_MIPMAP_0; k <= DT_MIPMAP_LDR_MAX; k++)
+    dt_thumbstore_close(cache->thumbstore[k]);
+  dt_pthread_mutex_destroy(&cache->generating_mutex);
   darktable.mipmap_cache = NULL;
   free(cache);
 }
@@ -818,15 +1479,15 @@ void dt_mipmap_cache_print()
   if(!cache) return;
 
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] thumbs fill %.2f/%.2f MB (%.2f%%)",
-           cache->mip_thumbs.cache.cost / (1024.0 * 1024.0),
+           dt_cache_get_cost(&cache->mip_thumbs.cache) / (1024.0 * 1024.0),
            cache->mip_thumbs.cache.cost_quota / (1024.0 * 1024.0),
-           100.0f * (float)cache->mip_thumbs.cache.cost / (float)cache->mip_thumbs.cache.cost_quota);
+           100.0f * (float)dt_cache_get_cost(&cache->mip_thumbs.cache) / (float)cache->mip_thumbs.cache.cost_quota);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] float fill %"PRIu32"/%"PRIu32" slots (%.2f%%)",
-           (uint32_t)cache->mip_f.cache.cost, (uint32_t)cache->mip_f.cache.cost_quota,
-           100.0f * (float)cache->mip_f.cache.cost / (float)cache->mip_f.cache.cost_quota);
+           (uint32_t)dt_cache_get_cost(&cache->mip_f.cache), (uint32_t)cache->mip_f.cache.cost_quota,
+           100.0f * (float)dt_cache_get_cost(&cache->mip_f.cache) / (float)cache->mip_f.cache.cost_quota);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] full  fill %"PRIu32"/%"PRIu32" slots (%.2f%%)",
-           (uint32_t)cache->mip_full.cache.cost, (uint32_t)cache->mip_full.cache.cost_quota,
-           100.0f * (float)cache->mip_full.cache.cost / (float)cache->mip_full.cache.cost_quota);
+           (uint32_t)dt_cache_get_cost(&cache->mip_full.cache), (uint32_t)cache->mip_full.cache.cost_quota,
+           100.0f * (float)dt_cache_get_cost(&cache->mip_full.cache) / (float)cache->mip_full.cache.cost_quota);
 
   uint64_t sum = 0;
   uint64_t sum_fetches = 0;
@@ -941,7 +1602,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     // and opposite: prefetch without locking
     if(mip > DT_MIPMAP_FULL || mip < DT_MIPMAP_0)
       return;
-    dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
+    dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG,
+                       dt_image_load_job_create(imgid, mip, _thread_owner));
   }
   else if(flags == DT_MIPMAP_PREFETCH_DISK)
   {
@@ -949,14 +1611,12 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     if(!cache->cachedir[0]) return;
     if(mip > DT_MIPMAP_FULL || mip < DT_MIPMAP_0)
       return;
-    char filename[PATH_MAX] = {0};
-    snprintf(filename, sizeof(filename),
-             "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
     // don't attempt to load if disk cache doesn't exist
-    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
-    dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
+    if(!_mipmap_cache_ondisk_thumbnail_exists(cache, imgid, mip)) return;
+    dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG,
+                       dt_image_load_job_create(imgid, mip, _thread_owner));
   }
-  else if(flags == DT_MIPMAP_BLOCKING)
+  else if(flags == DT_MIPMAP_BLOCKING || flags == DT_MIPMAP_BLOCKING_CANCELLABLE)
   {
     // simple case: blocking get
     dt_cache_entry_t *entry =
@@ -968,6 +1628,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     buf->cache_entry = entry;
 
     gboolean mipmap_generated = FALSE;
+    gboolean derive_smaller = FALSE;
+    gboolean cancelled = FALSE;
     if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE)
     {
       mipmap_generated = TRUE;
@@ -997,14 +1659,20 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
         buf->width = buf->height = 0;
         buf->iscale = 0.0f;
         buf->color_space = DT_COLORSPACE_NONE; // TODO: does the full buffer need to know this?
-        dt_imageio_retval_t ret =
-          dt_imageio_open(&buffered_image, filename, buf); // TODO: color_space?
+        // a recently evicted copy is much cheaper than decoding the file
+        const gboolean restored =
+          _mipmap_cache_restore_resident(cache, buf, &buffered_image, filename);
+        dt_imageio_retval_t ret = restored
+          ? DT_IMAGEIO_OK
+          : dt_imageio_open(&buffered_image, filename, buf); // TODO: color_space?
         buf->loader_status = ret;
         // might have been reallocated:
         ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
         dsc = (dt_mipmap_buffer_dsc_t *)buf->cache_entry->data;
         if(ret == DT_IMAGEIO_OK)
         {
+          if(!restored)
+            _mipmap_cache_note_resident(cache, key, &buffered_image, dsc);
           // swap back new image data:
           dt_image_t *img = dt_image_cache_get(imgid, 'w');
           *img = buffered_image;
@@ -1040,18 +1708,78 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
       else if(mip == DT_MIPMAP_F)
       {
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(dt_mipmap_buffer_dsc_t));
-        _init_f(buf, (float *)(dsc + 1),
-                &dsc->width, &dsc->height, &dsc->iscale, imgid);
+        if(cache->residency)
+        {
+          dt_image_t DT_ALIGNED_ARRAY buffered_image;
+          const dt_image_t *cimg = dt_image_cache_get(imgid, 'r');
+          buffered_image = *cimg;
+          dt_image_cache_read_release(cimg);
+
+          char filename[PATH_MAX] = { 0 };
+          gboolean from_cache = TRUE;
+          dt_image_full_path(imgid, filename, sizeof(filename), &from_cache);
+
+          buf->imgid = imgid;
+          buf->size = mip;
+          if(!_mipmap_cache_restore_resident(cache, buf, &buffered_image, filename))
+          {
+            _init_f(buf, (float *)(dsc + 1),
+                    &dsc->width, &dsc->height, &dsc->iscale, imgid);
+            // the loader may have run for the full buffer just now
+            cimg = dt_image_cache_get(imgid, 'r');
+            buffered_image = *cimg;
+            dt_image_cache_read_release(cimg);
+            if(dsc->width > ERR_IMG_MAX_DIM && dsc->height > ERR_IMG_MAX_DIM)
+              _mipmap_cache_note_resident(cache, key, &buffered_image, dsc);
+          }
+        }
+        else
+          _init_f(buf, (float *)(dsc + 1),
+                  &dsc->width, &dsc->height, &dsc->iscale, imgid);
       }
       else
       {
         // 8-bit thumbs
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(dt_mipmap_buffer_dsc_t));
+        _mipmap_generation_t gen =
+          { .imgid = imgid, .mip = mip, .owner = _thread_owner };
+        dt_atomic_set_int(&gen.cancel, 0);
+        const gboolean cancellable = flags == DT_MIPMAP_BLOCKING_CANCELLABLE;
+        if(cancellable) _mipmap_generation_begin(cache, &gen);
         _init_8((uint8_t *)(dsc + 1),
                 &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space, imgid, mip);
+        // a thumbnail completed before the pipe saw the request is kept
+        if(cancellable)
+          cancelled = _mipmap_generation_end(cache, &gen) && dsc->width == 0;
+        if(!cancelled
+           && dsc->width > ERR_IMG_MAX_DIM && dsc->height > ERR_IMG_MAX_DIM
+           && !_is_static_image((void *)dsc))
+          dt_phash_image_set(imgid, (uint8_t *)(dsc + 1), dsc->width, dsc->height);
+        derive_smaller = !cancelled
+          && mip > DT_MIPMAP_0
+          && dsc->width > ERR_IMG_MAX_DIM && dsc->height > ERR_IMG_MAX_DIM
+          && !_is_static_image((void *)dsc)
+          && dt_conf_get_bool("cache_mip_pyramid");
+      }
+      if(cancelled)
+      {
+        // nobody wants it any longer, drop the half done entry so the
+        // next request starts over instead of getting an error image
+        dt_cache_release(&_get_cache(cache, mip)->cache, entry);
+        dt_cache_remove(&_get_cache(cache, mip)->cache, key);
+        buf->cache_entry = NULL;
+        buf->width = buf->height = 0;
+        buf->iscale = 0.0f;
+        buf->imgid = NO_IMGID;
+        buf->color_space = DT_COLORSPACE_NONE;
+        buf->size = DT_MIPMAP_NONE;
+        buf->buf = NULL;
+        return;
       }
       dsc->color_space = buf->color_space;
       dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+      if(derive_smaller)
+        _mipmap_cache_derive_smaller(cache, imgid, mip, dsc);
     }
 
     // image cache is leaving the write lock in place in case the
@@ -1199,14 +1927,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_misses), 1);
     // in case we don't even have a disk cache for our requested thumbnail,
     // prefetch at least mip0, in case we have that in the disk caches:
-    if(cache->cachedir[0])
-    {
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename),
-               "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
-        dt_mipmap_cache_get(0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
-    }
+    if(_mipmap_cache_ondisk_thumbnail_exists(cache, imgid, mip))
+      dt_mipmap_cache_get(0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
     // nothing found :(
     buf->buf = NULL;
     buf->imgid = NO_IMGID;
@@ -1217,11 +1939,12 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
   }
 
   dt_print(DT_DEBUG_CACHE | DT_DEBUG_VERBOSE,
-           "[dt_mipmap_cache_get] %s%s%s%s%s for ID=%d mip=%d mode=%c at %p",
+           "[dt_mipmap_cache_get] %s%s%s%s%s%s for ID=%d mip=%d mode=%c at %p",
            flags == DT_MIPMAP_TESTLOCK ? "DT_MIPMAP_TESTLOCK" : "",
            flags == DT_MIPMAP_PREFETCH ? "DT_MIPMAP_PREFETCH" : "",
            flags == DT_MIPMAP_PREFETCH_DISK ? "DT_MIPMAP_PREFETCH_DISK" : "",
            flags == DT_MIPMAP_BLOCKING ? "DT_MIPMAP_BLOCKING" : "",
+           flags == DT_MIPMAP_BLOCKING_CANCELLABLE ? "DT_MIPMAP_BLOCKING_CANCELLABLE" : "",
            flags == DT_MIPMAP_BEST_EFFORT ? "DT_MIPMAP_BEST_EFFORT" : "",
            imgid, mip, mode, (buf ? buf->buf : NULL));
 }
@@ -1312,6 +2035,14 @@ void dt_mipmap_cache_remove(const dt_imgid_t imgid)
   {
     dt_mipmap_cache_remove_at_size(imgid, k);
   }
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(cache && cache->residency)
+  {
+    dt_mipmap_residency_remove(cache->residency, _get_key(imgid, DT_MIPMAP_F));
+    dt_mipmap_residency_remove(cache->residency, _get_key(imgid, DT_MIPMAP_FULL));
+  }
+  // the source or the history has changed, processed data is stale as well
+  dt_dev_pixelpipe_cache_disk_remove_image(imgid);
 }
 
 
@@ -1534,11 +2265,16 @@ static void _init_8(uint8_t *buf,
   // the orientation for this camera is not read correctly from exiv2, so we need
   // to go the full path (as the thumbnail will be flipped the wrong way round)
   const int incompatible = !strncmp(cimg->exif_maker, "Phase One", 9);
+  const gboolean is_raw = dt_image_is_raw(cimg);
   dt_image_cache_read_release(cimg);
 
   const char *min = dt_conf_get_string_const("plugins/lighttable/thumbnail_raw_min_level");
   const dt_mipmap_size_t min_s = dt_mipmap_cache_get_min_mip_from_pref(min);
-  const gboolean use_embedded = (size <= min_s);
+  // for culling on slow storage, unaltered raws only ever show their
+  // embedded preview and are never decoded
+  const gboolean embedded_only = !altered && is_raw && !incompatible
+    && dt_conf_get_bool("plugins/lighttable/thumbnail_embedded_only");
+  const gboolean use_embedded = embedded_only || (size <= min_s);
 
   if(!altered && use_embedded && !incompatible)
   {
@@ -1557,6 +2293,8 @@ static void _init_8(uint8_t *buf,
       dt_imageio_jpeg_t jpg;
       if(!dt_imageio_jpeg_read_header(filename, &jpg))
       {
+        // decode straight to about the mip size
+        dt_imageio_jpeg_scale_to_fit(&jpg, wd, ht);
         uint8_t *tmp = dt_alloc_align_uint8((size_t)jpg.width * jpg.height * 4);
         *color_space = dt_imageio_jpeg_read_color_space(&jpg);
         if(!dt_imageio_jpeg_read(&jpg, tmp))
@@ -1575,8 +2313,13 @@ static void _init_8(uint8_t *buf,
     {
       uint8_t *tmp = 0;
       int32_t thumb_width, thumb_height;
-      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height,
-                                       color_space);
+      res = TRUE;
+      if(embedded_only)
+        res = dt_imageio_embedded_preview(filename, wd, ht, &tmp,
+                                          &thumb_width, &thumb_height, color_space);
+      if(res)
+        res = dt_imageio_large_thumbnail_fit(filename, wd, ht, &tmp,
+                                             &thumb_width, &thumb_height, color_space);
       if(!res)
       {
         // use embedded JPEG if it is large enough or conf requests
@@ -1585,7 +2328,7 @@ static void _init_8(uint8_t *buf,
         const int imgwd = img2->width;
         const int imght = img2->height;
         dt_image_cache_read_release(img2);
-        const gboolean always_use_thumb = (min_s == DT_MIPMAP_NONE);
+        const gboolean always_use_thumb = embedded_only || (min_s == DT_MIPMAP_NONE);
         const gboolean thumb_lt_mip = ((thumb_width < wd) && (thumb_height < ht));
         const gboolean thumb_lt_raw = ((thumb_width < imgwd - 4) && (thumb_height < imght - 4));
         if (!always_use_thumb && thumb_lt_mip && thumb_lt_raw)
@@ -1629,7 +2372,7 @@ static void _init_8(uint8_t *buf,
     }
   }
 
-  if(res)
+  if(res && !embedded_only)
   {
     // try the real thing: rawspeed + pixelpipe
     dt_imageio_module_format_t format;
@@ -1701,6 +2444,22 @@ void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid,
   {
     for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip <= DT_MIPMAP_LDR_MAX; mip++)
     {
+      dt_thumbstore_t *store = _thumbstore(cache, mip);
+      size_t len = 0;
+      int color_space = DT_COLORSPACE_NONE;
+      dt_thumbstore_codec_t codec = DT_THUMBSTORE_CODEC_JPEG;
+      const uint8_t *blob = dt_thumbstore_get(store, src_imgid, &len, &color_space, &codec);
+      if(blob)
+      {
+        // can't append while holding the read lock
+        uint8_t *copy = g_malloc(len);
+        memcpy(copy, blob, len);
+        dt_thumbstore_release(store);
+        dt_thumbstore_put(store, dst_imgid, copy, len, color_space, codec);
+        g_free(copy);
+        continue;
+      }
+
       // try and load from disk, if successful set flag
       char srcpath[PATH_MAX] = {0};
       char dstpath[PATH_MAX] = {0};
@@ -1720,6 +2479,20 @@ void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid,
   }
 }
 
+gboolean dt_mipmap_cache_test_disk_thumbnail(const dt_imgid_t imgid,
+                                             const dt_mipmap_size_t mip)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(_mipmap_compressed_contains(cache->compressed, _get_key(imgid, mip))) return TRUE;
+  if(!cache->cachedir[0]) return FALSE;
+  if(dt_thumbstore_contains(_thumbstore(cache, mip), imgid)) return TRUE;
+
+  char filename[PATH_MAX] = { 0 };
+  snprintf(filename, sizeof(filename),
+           "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
+  return dt_util_test_image_file(filename);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
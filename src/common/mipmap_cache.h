@@ -66,7 +66,11 @@ typedef enum dt_mipmap_get_flags_t
   DT_MIPMAP_BLOCKING = 3,
   // don't actually acquire the lock if it is not
   // in cache (i.e. would have to be loaded first)
-  DT_MIPMAP_TESTLOCK = 4
+  DT_MIPMAP_TESTLOCK = 4,
+  // like blocking, but generating an 8-bit thumbnail may be aborted
+  // by dt_mipmap_cache_cancel(), the buffer is NULL in that case.
+  // meant for background jobs.
+  DT_MIPMAP_BLOCKING_CANCELLABLE = 5
 } dt_mipmap_get_flags_t;
 
 // struct to be alloc'ed by the client, filled by dt_mipmap_cache_get()
@@ -110,6 +114,15 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+  // packed disk backend, one store per thumbnail level, NULL if not used
+  struct dt_thumbstore_t *thumbstore[DT_MIPMAP_10 + 1];
+  // compressed copies of evicted DT_MIPMAP_FULL and DT_MIPMAP_F buffers, NULL if not used
+  struct dt_mipmap_residency_t *residency;
+  // compressed copies of evicted thumbnails, NULL if not used
+  struct dt_mipmap_compressed_t *compressed;
+  // thumbnails being generated for DT_MIPMAP_BLOCKING_CANCELLABLE requests
+  GList *generating;
+  dt_pthread_mutex_t generating_mutex;
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
@@ -142,6 +155,17 @@ void dt_mipmap_cache_release_with_caller(dt_mipmap_buffer_t *buf, const char *fi
 void dt_mipmap_cache_remove(const dt_imgid_t imgid);
 void dt_mipmap_cache_remove_at_size(const dt_imgid_t imgid, const dt_mipmap_size_t mip);
 
+// tag the thumbnail requests made from the calling thread with owner, NULL
+// clears the tag. load jobs queued by a prefetch carry the tag along.
+void dt_mipmap_cache_set_owner(const void *owner);
+
+// abort generating the thumbnail of imgid for a DT_MIPMAP_BLOCKING_CANCELLABLE
+// request made by owner, if one is running. the same image requested by
+// another owner keeps going. DT_MIPMAP_NONE stands for all sizes.
+void dt_mipmap_cache_cancel(const dt_imgid_t imgid,
+                            const dt_mipmap_size_t mip,
+                            const void *owner);
+
 // evict thumbnails from cache. They will be written to disc if not existing
 void dt_mipmap_cache_evict(const dt_imgid_t imgid);
 void dt_mipmap_cache_evict_at_size(const dt_imgid_t imgid, const dt_mipmap_size_t mip);
@@ -161,6 +185,9 @@ dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace(void);
 // only copies over the jpg backend on disk, doesn't directly affect the in-memory cache.
 void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid, const dt_imgid_t src_imgid);
 
+// check if the disk backend has a thumbnail of the image at size mip
+gboolean dt_mipmap_cache_test_disk_thumbnail(const dt_imgid_t imgid, const dt_mipmap_size_t mip);
+
 // return the mipmap corresponding to text value saved in prefs
 dt_mipmap_size_t dt_mipmap_cache_get_min_mip_from_pref(const char *value);
 
@@ -0,0 +1,492 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mipmap_residency.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+#include "control/jobs.h"
+
+#include <string.h>
+#include <zlib.h>
+
+/* codec:
+
+   the payload is cut into chunks of DT_RESIDENCY_CHUNK bytes, compressed
+   independently so they can be processed in parallel. in a chunk, every
+   element is replaced by its difference (uint8/uint16) or xor (float bits)
+   to the element stride positions before, then the bytes are regrouped by
+   significance and the result deflated at the fastest level. this keeps the
+   raw planes lossless at a fraction of their size.
+*/
+
+#define DT_RESIDENCY_CHUNK ((size_t)4 << 20)
+// noted entries without pixels are cheap, but keep their number bounded
+#define DT_RESIDENCY_MAX_ENTRIES 512
+
+typedef struct _residency_entry_t
+{
+  uint32_t key;
+  uint64_t serial;   // changes whenever new pixels are adopted
+  void *meta;
+  size_t meta_size;
+  gint64 time;       // when noted
+  size_t size;       // of the uncompressed payload
+  int elem_size;
+  int stride;
+
+  // adopted buffer waiting to be compressed, owned by the job while busy
+  uint8_t *raw;
+  size_t raw_offset;
+
+  size_t nchunks;
+  uint8_t **chunk;
+  size_t *chunk_len;
+
+  size_t stored;     // bytes held in raw or chunks
+  gboolean busy;     // the compression job is working on raw
+  gboolean removed;  // dropped while busy, the job frees it
+  GList *lru;
+} _residency_entry_t;
+
+struct dt_mipmap_residency_t
+{
+  dt_pthread_mutex_t lock;
+  GHashTable *entries; // key -> _residency_entry_t
+  GQueue lru;          // least recently used first
+  size_t stored;
+  size_t max_size;
+  uint64_t serial;
+};
+
+typedef struct _residency_job_t
+{
+  dt_mipmap_residency_t *res;
+  uint32_t key;
+  uint64_t serial;
+} _residency_job_t;
+
+static void _encode(uint8_t *out,
+                    const uint8_t *in,
+                    const size_t length,
+                    const int elem_size,
+                    const int stride)
+{
+  const size_t n = length / elem_size;
+  const size_t s = stride;
+  if(elem_size == 2)
+  {
+    const uint16_t *v = (const uint16_t *)in;
+    for(size_t i = 0; i < n; i++)
+    {
+      const uint16_t d = v[i] - (i >= s ? v[i - s] : 0);
+      out[i] = d & 0xff;
+      out[n + i] = d >> 8;
+    }
+  }
+  else if(elem_size == 4)
+  {
+    const uint32_t *v = (const uint32_t *)in;
+    for(size_t i = 0; i < n; i++)
+    {
+      const uint32_t d = v[i] ^ (i >= s ? v[i - s] : 0);
+      out[i] = d & 0xff;
+      out[n + i] = (d >> 8) & 0xff;
+      out[2 * n + i] = (d >> 16) & 0xff;
+      out[3 * n + i] = d >> 24;
+    }
+  }
+  else
+  {
+    for(size_t i = 0; i < n; i++)
+      out[i] = in[i] - (i >= s ? in[i - s] : 0);
+  }
+  // trailing bytes not making up an element
+  memcpy(out + n * elem_size, in + n * elem_size, length - n * elem_size);
+}
+
+static void _decode(uint8_t *out,
+                    const uint8_t *in,
+                    const size_t length,
+                    const int elem_size,
+                    const int stride)
+{
+  const size_t n = length / elem_size;
+  const size_t s = stride;
+  if(elem_size == 2)
+  {
+    uint16_t *v = (uint16_t *)out;
+    for(size_t i = 0; i < n; i++)
+    {
+      const uint16_t d = in[i] | (in[n + i] << 8);
+      v[i] = d + (i >= s ? v[i - s] : 0);
+    }
+  }
+  else if(elem_size == 4)
+  {
+    uint32_t *v = (uint32_t *)out;
+    for(size_t i = 0; i < n; i++)
+    {
+      const uint32_t d = (uint32_t)in[i]
+                       | ((uint32_t)in[n + i] << 8)
+                       | ((uint32_t)in[2 * n + i] << 16)
+                       | ((uint32_t)in[3 * n + i] << 24);
+      v[i] = d ^ (i >= s ? v[i - s] : 0);
+    }
+  }
+  else
+  {
+    for(size_t i = 0; i < n; i++)
+      out[i] = in[i] + (i >= s ? out[i - s] : 0);
+  }
+  memcpy(out + n * elem_size, in + n * elem_size, length - n * elem_size);
+}
+
+static inline size_t _chunk_length(const size_t size,
+                                   const size_t k)
+{
+  return MIN(DT_RESIDENCY_CHUNK, size - k * DT_RESIDENCY_CHUNK);
+}
+
+static void _entry_free_pixels(_residency_entry_t *e)
+{
+  for(size_t k = 0; k < e->nchunks; k++)
+    g_free(e->chunk[k]);
+  g_free(e->chunk);
+  g_free(e->chunk_len);
+  e->chunk = NULL;
+  e->chunk_len = NULL;
+  e->nchunks = 0;
+  dt_free_align(e->raw);
+  e->raw = NULL;
+}
+
+static void _entry_free(_residency_entry_t *e)
+{
+  _entry_free_pixels(e);
+  g_free(e->meta);
+  g_free(e);
+}
+
+// unlink e from the residency, freeing it unless the job still uses it.
+// called with the lock held.
+static void _entry_drop(dt_mipmap_residency_t *res,
+                        _residency_entry_t *e)
+{
+  g_hash_table_remove(res->entries, GUINT_TO_POINTER(e->key));
+  g_queue_delete_link(&res->lru, e->lru);
+  e->lru = NULL;
+  res->stored -= e->stored;
+  e->stored = 0;
+  if(e->busy)
+    e->removed = TRUE;
+  else
+    _entry_free(e);
+}
+
+// stay within the budget, dropping the least recently used entries first
+static void _gc(dt_mipmap_residency_t *res)
+{
+  GList *l = res->lru.head;
+  while(l && (res->stored > res->max_size
+              || g_hash_table_size(res->entries) > DT_RESIDENCY_MAX_ENTRIES))
+  {
+    _residency_entry_t *e = l->data;
+    l = g_list_next(l);
+    if(!e->busy) _entry_drop(res, e);
+  }
+}
+
+static void _touch(dt_mipmap_residency_t *res,
+                   _residency_entry_t *e)
+{
+  g_queue_unlink(&res->lru, e->lru);
+  g_queue_push_tail_link(&res->lru, e->lru);
+}
+
+dt_mipmap_residency_t *dt_mipmap_residency_new(const size_t max_size)
+{
+  dt_mipmap_residency_t *res = g_malloc0(sizeof(dt_mipmap_residency_t));
+  dt_pthread_mutex_init(&res->lock, NULL);
+  res->entries = g_hash_table_new(NULL, NULL);
+  g_queue_init(&res->lru);
+  res->max_size = max_size;
+  dt_print(DT_DEBUG_CACHE, "[mipmap_residency] compressed tier of %zu MB", max_size >> 20);
+  return res;
+}
+
+void dt_mipmap_residency_destroy(dt_mipmap_residency_t *res)
+{
+  if(!res) return;
+  // the control jobs have stopped already, nothing is busy any longer
+  for(GList *l = res->lru.head; l; l = g_list_next(l))
+    _entry_free(l->data);
+  g_queue_clear(&res->lru);
+  g_hash_table_destroy(res->entries);
+  dt_pthread_mutex_destroy(&res->lock);
+  g_free(res);
+}
+
+void dt_mipmap_residency_note(dt_mipmap_residency_t *res,
+                              const uint32_t key,
+                              const void *meta,
+                              const size_t meta_size,
+                              const size_t size,
+                              const int elem_size,
+                              const int stride)
+{
+  if(!res) return;
+  _residency_entry_t *e = g_malloc0(sizeof(_residency_entry_t));
+  e->key = key;
+  e->meta = g_malloc(meta_size);
+  memcpy(e->meta, meta, meta_size);
+  e->meta_size = meta_size;
+  e->time = g_get_real_time();
+  e->size = size;
+  e->elem_size = (elem_size == 2 || elem_size == 4) ? elem_size : 1;
+  e->stride = MAX(1, stride);
+
+  dt_pthread_mutex_lock(&res->lock);
+  _residency_entry_t *old = g_hash_table_lookup(res->entries, GUINT_TO_POINTER(key));
+  if(old) _entry_drop(res, old);
+  g_hash_table_insert(res->entries, GUINT_TO_POINTER(key), e);
+  g_queue_push_tail(&res->lru, e);
+  e->lru = res->lru.tail;
+  _gc(res);
+  dt_pthread_mutex_unlock(&res->lock);
+}
+
+static int32_t _residency_compress_job_run(dt_job_t *job)
+{
+  const _residency_job_t *params = dt_control_job_get_params(job);
+  dt_mipmap_residency_t *res = params->res;
+
+  dt_pthread_mutex_lock(&res->lock);
+  _residency_entry_t *e = g_hash_table_lookup(res->entries, GUINT_TO_POINTER(params->key));
+  if(!e || e->serial != params->serial || !e->raw || e->busy)
+  {
+    dt_pthread_mutex_unlock(&res->lock);
+    return 0;
+  }
+  e->busy = TRUE;
+  const uint8_t *in = e->raw + e->raw_offset;
+  const size_t size = e->size;
+  const int elem_size = e->elem_size;
+  const int stride = e->stride;
+  dt_pthread_mutex_unlock(&res->lock);
+
+  const double start = dt_get_wtime();
+  const size_t nchunks = (size + DT_RESIDENCY_CHUNK - 1) / DT_RESIDENCY_CHUNK;
+  uint8_t **chunk = g_malloc0(nchunks * sizeof(uint8_t *));
+  size_t *chunk_len = g_malloc0(nchunks * sizeof(size_t));
+  int err = 0;
+
+  DT_OMP_FOR(reduction(|:err))
+  for(size_t k = 0; k < nchunks; k++)
+  {
+    const size_t length = _chunk_length(size, k);
+    uint8_t *tmp = g_try_malloc(length);
+    uLongf clen = compressBound(length);
+    uint8_t *out = g_try_malloc(clen);
+    if(tmp && out)
+    {
+      _encode(tmp, in + k * DT_RESIDENCY_CHUNK, length, elem_size, stride);
+      if(compress2(out, &clen, tmp, length, Z_BEST_SPEED) == Z_OK)
+      {
+        chunk[k] = g_realloc(out, clen);
+        chunk_len[k] = clen;
+        out = NULL;
+      }
+      else
+        err |= 1;
+    }
+    else
+      err |= 1;
+    g_free(out);
+    g_free(tmp);
+  }
+
+  size_t total = 0;
+  for(size_t k = 0; k < nchunks; k++) total += chunk_len[k];
+
+  dt_pthread_mutex_lock(&res->lock);
+  e->busy = FALSE;
+  if(err || e->removed)
+  {
+    for(size_t k = 0; k < nchunks; k++) g_free(chunk[k]);
+    g_free(chunk);
+    g_free(chunk_len);
+    if(e->removed)
+      _entry_free(e);
+    else
+      _entry_drop(res, e);
+  }
+  else
+  {
+    dt_free_align(e->raw);
+    e->raw = NULL;
+    e->chunk = chunk;
+    e->chunk_len = chunk_len;
+    e->nchunks = nchunks;
+    res->stored -= e->stored;
+    e->stored = total;
+    res->stored += total;
+    _gc(res);
+    dt_print(DT_DEBUG_CACHE | DT_DEBUG_PERF,
+             "[mipmap_residency] key %" PRIu32 " %zu -> %zu KB in %.3fs, %zu MB held",
+             params->key, size >> 10, total >> 10, dt_get_wtime() - start, res->stored >> 20);
+  }
+  dt_pthread_mutex_unlock(&res->lock);
+  return 0;
+}
+
+gboolean dt_mipmap_residency_adopt(dt_mipmap_residency_t *res,
+                                   const uint32_t key,
+                                   void *data,
+                                   const size_t offset)
+{
+  if(!res) return FALSE;
+
+  dt_job_t *job = dt_control_job_create(&_residency_compress_job_run,
+                                        "compress mipmap %" PRIu32, key);
+  if(!job) return FALSE;
+  _residency_job_t *params = calloc(1, sizeof(_residency_job_t));
+  if(!params)
+  {
+    dt_control_job_dispose(job);
+    return FALSE;
+  }
+  dt_control_job_set_params(job, params, free);
+
+  dt_pthread_mutex_lock(&res->lock);
+  _residency_entry_t *e = g_hash_table_lookup(res->entries, GUINT_TO_POINTER(key));
+  if(!e || e->busy || e->size > res->max_size)
+  {
+    dt_pthread_mutex_unlock(&res->lock);
+    dt_control_job_dispose(job);
+    return FALSE;
+  }
+  _entry_free_pixels(e);
+  e->raw = data;
+  e->raw_offset = offset;
+  e->serial = ++res->serial;
+  res->stored -= e->stored;
+  e->stored = offset + e->size;
+  res->stored += e->stored;
+  _touch(res, e);
+  params->res = res;
+  params->key = key;
+  params->serial = e->serial;
+  dt_pthread_mutex_unlock(&res->lock);
+
+  dt_control_add_job(DT_JOB_QUEUE_SYSTEM_BG, job);
+  return TRUE;
+}
+
+gboolean dt_mipmap_residency_lookup(dt_mipmap_residency_t *res,
+                                    const uint32_t key,
+                                    void *meta,
+                                    const size_t meta_size,
+                                    size_t *size,
+                                    gint64 *time)
+{
+  if(!res) return FALSE;
+  dt_pthread_mutex_lock(&res->lock);
+  _residency_entry_t *e = g_hash_table_lookup(res->entries, GUINT_TO_POINTER(key));
+  const gboolean found = e && (e->raw || e->nchunks) && e->meta_size == meta_size;
+  if(found)
+  {
+    memcpy(meta, e->meta, meta_size);
+    *size = e->size;
+    *time = e->time;
+  }
+  dt_pthread_mutex_unlock(&res->lock);
+  return found;
+}
+
+gboolean dt_mipmap_residency_restore(dt_mipmap_residency_t *res,
+                                     const uint32_t key,
+                                     void *out,
+                                     const size_t size)
+{
+  if(!res) return TRUE;
+  dt_pthread_mutex_lock(&res->lock);
+  _residency_entry_t *e = g_hash_table_lookup(res->entries, GUINT_TO_POINTER(key));
+  if(!e || e->size != size || !(e->raw || e->nchunks))
+  {
+    dt_pthread_mutex_unlock(&res->lock);
+    return TRUE;
+  }
+
+  int err = 0;
+  if(e->raw)
+  {
+    // not compressed yet, the job only ever reads the buffer
+    memcpy(out, e->raw + e->raw_offset, size);
+  }
+  else
+  {
+    const double start = dt_get_wtime();
+    const size_t nchunks = e->nchunks;
+    uint8_t *const *chunk = e->chunk;
+    const size_t *chunk_len = e->chunk_len;
+    const int elem_size = e->elem_size;
+    const int stride = e->stride;
+    uint8_t *dst = out;
+
+    DT_OMP_FOR(reduction(|:err))
+    for(size_t k = 0; k < nchunks; k++)
+    {
+      const size_t length = _chunk_length(size, k);
+      uint8_t *tmp = g_try_malloc(length);
+      uLongf dlen = length;
+      if(tmp
+         && uncompress(tmp, &dlen, chunk[k], chunk_len[k]) == Z_OK
+         && dlen == length)
+        _decode(dst + k * DT_RESIDENCY_CHUNK, tmp, length, elem_size, stride);
+      else
+        err |= 1;
+      g_free(tmp);
+    }
+    dt_print(DT_DEBUG_CACHE | DT_DEBUG_PERF,
+             "[mipmap_residency] restored key %" PRIu32 " (%zu KB) in %.3fs",
+             key, size >> 10, dt_get_wtime() - start);
+  }
+
+  if(err)
+    _entry_drop(res, e);
+  else
+    _touch(res, e);
+  dt_pthread_mutex_unlock(&res->lock);
+  return err != 0;
+}
+
+void dt_mipmap_residency_remove(dt_mipmap_residency_t *res,
+                                const uint32_t key)
+{
+  if(!res) return;
+  dt_pthread_mutex_lock(&res->lock);
+  _residency_entry_t *e = g_hash_table_lookup(res->entries, GUINT_TO_POINTER(key));
+  if(e) _entry_drop(res, e);
+  dt_pthread_mutex_unlock(&res->lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,81 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stddef.h>
+
+G_BEGIN_DECLS
+
+// compressed in-memory tier behind the DT_MIPMAP_FULL and DT_MIPMAP_F caches.
+// buffers evicted from the memory cache are handed over here, compressed
+// losslessly in a background job and kept within a memory budget, so
+// reopening a recent image doesn't need to decode the raw file again.
+typedef struct dt_mipmap_residency_t dt_mipmap_residency_t;
+
+dt_mipmap_residency_t *dt_mipmap_residency_new(const size_t max_size);
+void dt_mipmap_residency_destroy(dt_mipmap_residency_t *res);
+
+// remember how the buffer for key has just been produced. meta is opaque to the
+// residency and handed back by dt_mipmap_residency_lookup(). the payload holds
+// size bytes of elements of elem_size bytes (1, 2 or 4), neighbours at a
+// distance of stride elements are expected to be similar.
+// any pixels stored for key before are dropped.
+void dt_mipmap_residency_note(dt_mipmap_residency_t *res,
+                              const uint32_t key,
+                              const void *meta,
+                              const size_t meta_size,
+                              const size_t size,
+                              const int elem_size,
+                              const int stride);
+
+// take over the evicted buffer of key, allocated with dt_alloc_aligned(),
+// with the payload starting at offset. returns FALSE, leaving the buffer to the
+// caller, if key hasn't been noted or the compression job can't be started.
+gboolean dt_mipmap_residency_adopt(dt_mipmap_residency_t *res,
+                                   const uint32_t key,
+                                   void *data,
+                                   const size_t offset);
+
+// returns TRUE if pixels are stored for key and copies its meta, payload size
+// and the time it was noted (as g_get_real_time())
+gboolean dt_mipmap_residency_lookup(dt_mipmap_residency_t *res,
+                                    const uint32_t key,
+                                    void *meta,
+                                    const size_t meta_size,
+                                    size_t *size,
+                                    gint64 *time);
+
+// decompress the pixels of key into out, which holds size bytes. the copy
+// stays stored. returns TRUE on error.
+gboolean dt_mipmap_residency_restore(dt_mipmap_residency_t *res,
+                                     const uint32_t key,
+                                     void *out,
+                                     const size_t size);
+
+void dt_mipmap_residency_remove(dt_mipmap_residency_t *res, const uint32_t key);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -347,10 +347,12 @@ void nlmeans_denoise(
   // allocate scratch space, including an overrun area on each end so we don't need a boundary check on every access
   const int radius = params->patch_radius;
 #if defined(CACHE_PIXDIFFS)
-  const size_t scratch_size = (2*radius+3)*(SLICE_WIDTH + 2*radius + 1);
+  const size_t sums_size = (2*radius+3)*(SLICE_WIDTH + 2*radius + 1);
 #else
-  const size_t scratch_size = SLICE_WIDTH + 2*radius + 1 + 48; // getting false sharing without the +48....
+  const size_t sums_size = SLICE_WIDTH + 2*radius + 1 + 48; // getting false sharing without the +48....
 #endif /* CACHE_PIXDIFFS */
+  // followed by the weights of one row of the chunk
+  const size_t scratch_size = sums_size + SLICE_WIDTH;
   size_t padded_scratch_size;
   float *const restrict scratch_buf = dt_alloc_perthread_float(scratch_size, &padded_scratch_size);
   const int chk_height = compute_slice_height(roi_out->height);
@@ -364,6 +366,7 @@ void nlmeans_denoise(
       // we'll offset by chunk_left so that we don't have to subtract on every access
       float *const restrict tmpbuf = dt_get_perthread(scratch_buf, padded_scratch_size);
       float *const col_sums =  tmpbuf + (radius+1) - chunk_left;
+      float *const restrict weights = tmpbuf + sums_size - chunk_left;
       // determine which horizontal slice of the image to process
       const int chunk_bot = MIN(chunk_top + chk_height, roi_out->height);
       // determine which vertical slice of the image to process
@@ -407,39 +410,41 @@ void nlmeans_denoise(
           float *const out = outbuf + (size_t)4 * width * row;
           const int offset = patch->offset;
           const float sharpness = params->sharpness;
+          // the sliding window is a serial dependency from one column to the next, keep it
+          // apart so that the weights and their accumulation vectorize across the columns
+          for(int col = col_min; col < col_max; col++)
+          {
+            distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
+            weights[col] = distortion;
+          }
           if(params->center_weight < 0.0f)
           {
             // computation as used by denoise(non-local) iop
+            DT_OMP_SIMD()
             for(int col = col_min; col < col_max; col++)
-            {
-              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
-              const float wt = gh(distortion * sharpness);
-              const float *const inpx = in+4*col;
-              const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
-              for_four_channels(c,aligned(pixel,out:16))
-              {
-                out[4*col+c] += pixel[c] * wt;
-              }
-              _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
-            }
+              weights[col] = gh(weights[col] * sharpness);
           }
           else
           {
             // computation as used by denoiseprofiled iop with non-local means
+            const float center_weight = params->center_weight;
             for(int col = col_min; col < col_max; col++)
             {
-              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
-              const float dissimilarity = (distortion + pixel_difference(in+4*col,in+4*col+offset,center_norm))
-                                           / (1.0f + params->center_weight);
-              const float wt = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
-              const float *const inpx = in + 4*col;
-              const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
-              for_four_channels(c,aligned(pixel,out:16))
-              {
-                out[4*col+c] += pixel[c] * wt;
-              }
-              _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+              const float dissimilarity = (weights[col] + pixel_difference(in+4*col,in+4*col+offset,center_norm))
+                                           / (1.0f + center_weight);
+              weights[col] = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
+            }
+          }
+          for(int col = col_min; col < col_max; col++)
+          {
+            const float wt = weights[col];
+            const float *const inpx = in+4*col;
+            const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
+            for_four_channels(c,aligned(pixel,out:16))
+            {
+              out[4*col+c] += pixel[c] * wt;
             }
+            _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
           }
           const int pcol_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
           const int pcol_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
@@ -27,6 +27,12 @@ const dt_noiseprofile_t dt_noiseprofile_generic = {N_("generic poissonian"), "",
 
 static gboolean _noiseprofile_verify(JsonParser *parser);
 
+// the profiles already looked up, per camera: the lookup goes through the
+// whole json tree, and is done again for every image of a burst and every
+// commit of the denoise parameters, in all pipes and exports.
+static GMutex _matching_lock;
+static GHashTable *_matching = NULL; // "maker\nmodel" -> sorted GList of profiles
+
 JsonParser *dt_noiseprofile_init(const char *alternative)
 {
   GError *error = NULL;
@@ -224,7 +230,7 @@ end:
 }
 #undef _ERROR
 
-GList *dt_noiseprofile_get_matching(const dt_image_t *cimg)
+static GList *_noiseprofile_lookup(const dt_image_t *cimg)
 {
   JsonParser *parser = darktable.noiseprofile_parser;
   JsonReader *reader = NULL;
@@ -363,6 +369,52 @@ end:
   return result;
 }
 
+static gpointer _noiseprofile_copy(gconstpointer src, gpointer data)
+{
+  const dt_noiseprofile_t *profile = src;
+  dt_noiseprofile_t *copy = malloc(sizeof(dt_noiseprofile_t));
+  *copy = *profile;
+  copy->name = g_strdup(profile->name);
+  copy->maker = g_strdup(profile->maker);
+  copy->model = g_strdup(profile->model);
+  return copy;
+}
+
+static void _matching_free(gpointer data)
+{
+  g_list_free_full(data, dt_noiseprofile_free);
+}
+
+GList *dt_noiseprofile_get_matching(const dt_image_t *cimg)
+{
+  gchar *key = g_strdup_printf("%s\n%s", cimg->camera_maker, cimg->camera_model);
+  GList *profiles = NULL;
+
+  g_mutex_lock(&_matching_lock);
+  if(!_matching)
+    _matching = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _matching_free);
+
+  if(g_hash_table_lookup_extended(_matching, key, NULL, (gpointer *)&profiles))
+    g_free(key);
+  else
+  {
+    profiles = _noiseprofile_lookup(cimg);
+    g_hash_table_insert(_matching, key, profiles);
+  }
+  GList *result = g_list_copy_deep(profiles, _noiseprofile_copy, NULL);
+  g_mutex_unlock(&_matching_lock);
+
+  return result;
+}
+
+void dt_noiseprofile_cleanup(void)
+{
+  g_mutex_lock(&_matching_lock);
+  if(_matching) g_hash_table_destroy(_matching);
+  _matching = NULL;
+  g_mutex_unlock(&_matching_lock);
+}
+
 void dt_noiseprofile_free(gpointer data)
 {
   dt_noiseprofile_t *profile = (dt_noiseprofile_t *)data;
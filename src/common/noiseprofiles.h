@@ -39,11 +39,15 @@ extern const dt_noiseprofile_t dt_noiseprofile_generic;
 JsonParser *dt_noiseprofile_init(const char *alternative);
 
 /*
- * returns the noiseprofiles matching the image's exif data.
+ * returns the noiseprofiles matching the image's exif data, looked up
+ * once per camera.
  * free with g_list_free_full(..., dt_noiseprofile_free);
  */
 GList *dt_noiseprofile_get_matching(const dt_image_t *cimg);
 
+/** forget the profiles looked up by dt_noiseprofile_get_matching() */
+void dt_noiseprofile_cleanup(void);
+
 /** convenience function to free a list of noiseprofiles */
 void dt_noiseprofile_free(gpointer data);
 
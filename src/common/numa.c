@@ -0,0 +1,181 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/numa.h"
+#include "common/darktable.h"
+#include "control/conf.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define DT_NUMA_MAX_NODES 64
+// smaller buffers are left alone, placing them costs more than it gains
+#define DT_NUMA_MIN_SIZE ((size_t)4 << 20)
+// from linux/mempolicy.h
+#define DT_MPOL_INTERLEAVE 3
+
+typedef struct _numa_t
+{
+  dt_numa_policy_t policy;
+  int nodes;
+  int id[DT_NUMA_MAX_NODES];  // kernel node ids, they may be sparse
+#ifdef __linux__
+  cpu_set_t cpus[DT_NUMA_MAX_NODES];
+#endif
+  size_t page;
+} _numa_t;
+
+static _numa_t _numa = { .policy = DT_NUMA_OFF, .nodes = 1 };
+
+static __thread gboolean _team_bound = FALSE;
+
+#ifdef __linux__
+// parse a kernel cpu list like "0-15,32-47"
+static void _parse_cpulist(const char *list, cpu_set_t *set)
+{
+  CPU_ZERO(set);
+  const char *p = list;
+  while(*p)
+  {
+    char *end = NULL;
+    const long first = strtol(p, &end, 10);
+    if(end == p) break;
+    long last = first;
+    p = end;
+    if(*p == '-')
+    {
+      last = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for(long c = first; c <= last && c < CPU_SETSIZE; c++)
+      CPU_SET(c, set);
+    if(*p == ',') p++;
+    else break;
+  }
+}
+
+static void _bind_self(const int node)
+{
+  if(sched_setaffinity(0, sizeof(cpu_set_t), &_numa.cpus[node]))
+    dt_print(DT_DEBUG_MEMORY, "[numa] can't bind thread to node %d", _numa.id[node]);
+}
+#endif
+
+void dt_numa_init(void)
+{
+  _numa.policy = DT_NUMA_OFF;
+  _numa.nodes = 1;
+
+#ifdef __linux__
+  const char *policy = dt_conf_get_string_const("numa_memory_policy");
+  const dt_numa_policy_t wanted = !g_strcmp0(policy, "interleave") ? DT_NUMA_INTERLEAVE
+                                : !g_strcmp0(policy, "local")      ? DT_NUMA_LOCAL
+                                : DT_NUMA_OFF;
+  if(wanted == DT_NUMA_OFF) return;
+
+  int nodes = 0;
+  for(int n = 0; n < DT_NUMA_MAX_NODES * 4 && nodes < DT_NUMA_MAX_NODES; n++)
+  {
+    gchar *path = g_strdup_printf("/sys/devices/system/node/node%d/cpulist", n);
+    gchar *list = NULL;
+    if(g_file_get_contents(path, &list, NULL, NULL))
+    {
+      _parse_cpulist(list, &_numa.cpus[nodes]);
+      // memory only nodes have no cpus to bind to
+      if(CPU_COUNT(&_numa.cpus[nodes]) > 0) _numa.id[nodes++] = n;
+    }
+    g_free(list);
+    g_free(path);
+  }
+
+  _numa.page = sysconf(_SC_PAGESIZE);
+  if(nodes > 1)
+  {
+    _numa.policy = wanted;
+    _numa.nodes = nodes;
+  }
+  dt_print(DT_DEBUG_MEMORY, "[numa] %d nodes, policy '%s'%s",
+           MAX(nodes, 1), policy, nodes > 1 ? "" : " not needed");
+#endif
+}
+
+int dt_numa_nodes(void)
+{
+  return _numa.nodes;
+}
+
+void dt_numa_bind_team(const int node)
+{
+  if(_numa.policy == DT_NUMA_OFF || _team_bound) return;
+  _team_bound = TRUE;
+
+#ifdef __linux__
+  if(node >= 0) _bind_self(node % _numa.nodes);
+
+#ifdef _OPENMP
+  const int nodes = _numa.nodes;
+  // thread t of a static schedule gets the t-th chunk of the rows, so
+  // consecutive threads go to the same node
+#pragma omp parallel default(none) firstprivate(node, nodes)
+  {
+    const int t = omp_get_thread_num();
+    const int n = omp_get_num_threads();
+    _bind_self(node >= 0 ? node % nodes : (int)((int64_t)t * nodes / n));
+  }
+#endif
+#endif
+}
+
+void dt_numa_place(void *mem, const size_t size)
+{
+  if(_numa.policy == DT_NUMA_OFF || !mem || size < DT_NUMA_MIN_SIZE) return;
+
+#ifdef __linux__
+  const size_t page = _numa.page;
+  const uintptr_t start = ((uintptr_t)mem + page - 1) & ~(uintptr_t)(page - 1);
+  const uintptr_t stop = ((uintptr_t)mem + size) & ~(uintptr_t)(page - 1);
+  if(stop <= start) return;
+
+  if(_numa.policy == DT_NUMA_INTERLEAVE)
+  {
+    unsigned long mask[DT_NUMA_MAX_NODES * 4 / (8 * sizeof(unsigned long)) + 1] = { 0 };
+    for(int n = 0; n < _numa.nodes; n++)
+      mask[_numa.id[n] / (8 * sizeof(unsigned long))] |= 1UL << (_numa.id[n] % (8 * sizeof(unsigned long)));
+    if(syscall(SYS_mbind, (void *)start, stop - start, DT_MPOL_INTERLEAVE,
+               mask, 8 * sizeof(mask) + 1, 0))
+      dt_print(DT_DEBUG_MEMORY, "[numa] interleaving %zuMB failed", size >> 20);
+    return;
+  }
+
+  // first touch, one write per page
+  char *const pages = (char *)start;
+  const size_t count = (stop - start) / page;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < count; k++)
+    pages[k * page] = 0;
+#endif
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,65 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stddef.h>
+
+G_BEGIN_DECLS
+
+/* Buffer placement and thread binding on machines with several NUMA nodes.
+   Selected by conf key 'numa_memory_policy':
+    - 'off': leave everything to the kernel,
+    - 'interleave': large buffers are spread page by page over all nodes,
+    - 'local': large buffers are first touched by the OpenMP team with the
+      same static schedule as the DT_OMP_FOR() loops processing them, so
+      every thread finds its rows on its own node.
+   In both active modes the OpenMP threads of a pipe are bound to the nodes,
+   consecutive threads on the same node, and export lanes each get a node.
+   Only available on Linux, a no-op on machines with a single node.
+*/
+
+typedef enum dt_numa_policy_t
+{
+  DT_NUMA_OFF = 0,
+  DT_NUMA_INTERLEAVE,
+  DT_NUMA_LOCAL
+} dt_numa_policy_t;
+
+// reads the topology, must be called after the conf is loaded
+void dt_numa_init(void);
+
+// number of nodes in use, 1 if the NUMA mode is off
+int dt_numa_nodes(void);
+
+// bind the calling thread and its OpenMP team. with node < 0 the team is
+// spread over all nodes, otherwise all of it goes to the given node.
+// only the first call of a thread has an effect.
+void dt_numa_bind_team(const int node);
+
+// place the pages of a freshly allocated buffer according to the policy
+void dt_numa_place(void *mem, const size_t size);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
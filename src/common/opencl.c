@@ -35,6 +35,9 @@
 #include "control/control.h"
 #include "develop/blend.h"
 #include "develop/pixelpipe.h"
+#ifdef HAVE_AI
+#include "ai/backend.h"
+#endif
 
 #include <assert.h>
 #include <locale.h>
@@ -44,6 +47,8 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <glib/gstdio.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <sys/stat.h>
 #include <zlib.h>
@@ -56,6 +61,7 @@ static gboolean _opencl_load_program(const int dev,
                                      const char *filename,
                                      const char *binname,
                                      const char *cachedir,
+                                     const char *shareddir,
                                      char *md5sum,
                                      char **includemd5,
                                      gboolean *loaded_cached);
@@ -67,6 +73,21 @@ static gboolean _opencl_build_program(const int dev,
                                       char *md5sum,
                                       const gboolean loaded_cached);
 
+// a program created from source, built by _opencl_build_thread()
+typedef struct _opencl_build_job_t
+{
+  int prog;
+  char *binname;
+  char *cachedir;
+  char md5sum[33];
+} _opencl_build_job_t;
+
+static void _opencl_build_job_free(gpointer data);
+
+static void _opencl_build_queue(const int dev);
+
+static void *_opencl_build_thread(void *arg);
+
 static char *_ascii_str_canonical(const char *in, char *out, int maxlen);
 
 static char *_strsep(char **stringp, const char *delim);
@@ -220,10 +241,15 @@ const char *cl_errstr(cl_int error)
   }
 }
 
+static void _opencl_autotune_grow(const int devid);
+
 static inline void _check_clmem_err(const int devid, const cl_int err)
 {
   if((err == CL_MEM_OBJECT_ALLOCATION_FAILURE) || (err == CL_OUT_OF_RESOURCES))
-  darktable.opencl->dev[devid].clmem_error |= TRUE;
+  {
+    darktable.opencl->dev[devid].clmem_error |= TRUE;
+    if(darktable.opencl->dev[devid].autotune) _opencl_autotune_grow(devid);
+  }
 }
 
 static inline gboolean _cl_running(void)
@@ -320,7 +346,9 @@ void dt_opencl_micro_nap(const int devid)
 {
   dt_opencl_t *cl = darktable.opencl;
   if(_cldev_running(devid))
-    dt_iop_nap(cl->dev[devid].micro_nap);
+    dt_iop_nap(cl->dev[devid].autotune
+               ? cl->dev[devid].tune_micro_nap
+               : cl->dev[devid].micro_nap);
 }
 
 gboolean dt_opencl_use_pinned_memory(const int devid)
@@ -329,6 +357,24 @@ gboolean dt_opencl_use_pinned_memory(const int devid)
   return (!_cldev_running(devid)) ? FALSE : cl->dev[devid].pinned_memory;
 }
 
+// keys read for every tile or device lock, resolved in dt_opencl_init
+static dt_conf_handle_t *_conf_async_tiling = NULL;
+static dt_conf_handle_t *_conf_mandatory_timeout = NULL;
+
+gboolean dt_opencl_use_async_transfers(const int devid)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  return _cldev_running(devid)
+    && cl->dev[devid].transfer_queue
+    && dt_conf_handle_get_bool(_conf_async_tiling);
+}
+
+float dt_opencl_get_transfer_rate(const int devid)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  return (!_cldev_running(devid)) ? 0.0f : cl->dev[devid].transfer_rate;
+}
+
 gboolean dt_opencl_unified_memory(const int devid)
 {
   dt_opencl_t *cl = darktable.opencl;
@@ -491,6 +537,357 @@ static gboolean _opencl_read_device_config(const int devid)
 }
 
 // returns 0 if all ok or an error if we failed to init this device
+// device side pool of the temporary images and buffers allocated by the
+// modules. released ones are kept and handed out again for the same
+// size and format, so a pipe run doesn't create and release the same
+// objects over and over. the pool is bounded and flushed whenever an
+// allocation fails.
+
+#define DT_OPENCL_POOL_ENTRIES 16
+
+typedef struct _pool_entry_t
+{
+  cl_mem mem;
+  int width;    // 0 for buffers
+  int height;
+  int bpp;
+  size_t size;  // bytes
+} _pool_entry_t;
+
+static void _opencl_pool_flush(const int devid)
+{
+  dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+  if(!cldev->pool_owned) return;
+
+  dt_pthread_mutex_lock(&cldev->pool_lock);
+  for(GList *l = cldev->pool_free; l; l = g_list_next(l))
+  {
+    _pool_entry_t *e = l->data;
+    (darktable.opencl->dlocl->symbols->dt_clReleaseMemObject)(e->mem);
+    g_hash_table_remove(cldev->pool_owned, e->mem);
+  }
+  g_list_free(cldev->pool_free);
+  cldev->pool_free = NULL;
+  cldev->pool_bytes = 0;
+  dt_pthread_mutex_unlock(&cldev->pool_lock);
+}
+
+// device memory is short: drop what is only kept around for reuse.
+// returns TRUE if there was anything to drop
+static gboolean _opencl_make_room(const int devid)
+{
+  const gboolean pooled = darktable.opencl->dev[devid].pool_free != NULL;
+  if(pooled) _opencl_pool_flush(devid);
+#ifdef HAVE_AI
+  // idle AI model sessions on an accelerated provider hold device memory too
+  const gboolean sessions = dt_ai_release_idle_sessions(TRUE) > 0;
+#else
+  const gboolean sessions = FALSE;
+#endif
+  return pooled || sessions;
+}
+
+// a released object of that kind, NULL if there is none
+static cl_mem _opencl_pool_take(const int devid,
+                                const int width,
+                                const int height,
+                                const int bpp,
+                                const size_t size)
+{
+  dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+  cl_mem mem = NULL;
+
+  dt_pthread_mutex_lock(&cldev->pool_lock);
+  for(GList *l = cldev->pool_free; l; l = g_list_next(l))
+  {
+    _pool_entry_t *e = l->data;
+    if(e->width == width && e->height == height && e->bpp == bpp && e->size == size)
+    {
+      mem = e->mem;
+      cldev->pool_bytes -= e->size;
+      cldev->pool_free = g_list_delete_link(cldev->pool_free, l);
+      break;
+    }
+  }
+  if(mem)
+    cldev->pool_hits++;
+  else
+    cldev->pool_misses++;
+  dt_pthread_mutex_unlock(&cldev->pool_lock);
+
+  return mem;
+}
+
+static void _opencl_pool_register(const int devid,
+                                  cl_mem mem,
+                                  const int width,
+                                  const int height,
+                                  const int bpp,
+                                  const size_t size)
+{
+  dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+  _pool_entry_t *e = malloc(sizeof(_pool_entry_t));
+  if(!e) return;
+  *e = (_pool_entry_t){ mem, width, height, bpp, size };
+
+  dt_pthread_mutex_lock(&cldev->pool_lock);
+  g_hash_table_insert(cldev->pool_owned, mem, e);
+  dt_pthread_mutex_unlock(&cldev->pool_lock);
+}
+
+// keep mem if it came from the pool. the pool takes at most an eighth
+// of the available memory, the oldest objects are released first.
+static gboolean _opencl_pool_give(cl_mem mem)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  for(int devid = 0; devid < cl->num_devs; devid++)
+  {
+    dt_opencl_device_t *cldev = &cl->dev[devid];
+    if(!cldev->pool_owned) continue;
+
+    dt_pthread_mutex_lock(&cldev->pool_lock);
+    _pool_entry_t *e = g_hash_table_lookup(cldev->pool_owned, mem);
+    if(!e)
+    {
+      dt_pthread_mutex_unlock(&cldev->pool_lock);
+      continue;
+    }
+
+    const size_t budget = cldev->used_available / 8;
+    gboolean kept = e->size <= budget;
+    if(kept)
+    {
+      cldev->pool_free = g_list_prepend(cldev->pool_free, e);
+      cldev->pool_bytes += e->size;
+      while(cldev->pool_bytes > budget
+            || g_list_length(cldev->pool_free) > DT_OPENCL_POOL_ENTRIES)
+      {
+        GList *last = g_list_last(cldev->pool_free);
+        _pool_entry_t *old = last->data;
+        cldev->pool_bytes -= old->size;
+        cldev->pool_free = g_list_delete_link(cldev->pool_free, last);
+        (cl->dlocl->symbols->dt_clReleaseMemObject)(old->mem);
+        g_hash_table_remove(cldev->pool_owned, old->mem);
+      }
+    }
+    else
+      g_hash_table_remove(cldev->pool_owned, mem);
+    dt_pthread_mutex_unlock(&cldev->pool_lock);
+    return kept;
+  }
+  return FALSE;
+}
+
+// images created over host buffers by dt_opencl_alloc_device_use_host()
+
+// TRUE if mem is an image living in host
+static gboolean _opencl_hostmem_is(const int devid,
+                                   cl_mem mem,
+                                   const void *host)
+{
+  dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+  if(!cldev->hostmem || !host) return FALSE;
+
+  dt_pthread_mutex_lock(&cldev->pool_lock);
+  const gboolean found = g_hash_table_lookup(cldev->hostmem, mem) == host;
+  dt_pthread_mutex_unlock(&cldev->pool_lock);
+  return found;
+}
+
+// forget mem if it lives in a host buffer. the caller may reuse that
+// buffer as soon as mem is released, the kernels using it must be done.
+static gboolean _opencl_hostmem_forget(cl_mem mem)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  for(int devid = 0; devid < cl->num_devs; devid++)
+  {
+    dt_opencl_device_t *cldev = &cl->dev[devid];
+    if(!cldev->hostmem) continue;
+
+    dt_pthread_mutex_lock(&cldev->pool_lock);
+    const gboolean found = g_hash_table_remove(cldev->hostmem, mem);
+    dt_pthread_mutex_unlock(&cldev->pool_lock);
+    if(found)
+    {
+      (cl->dlocl->symbols->dt_clFinish)(cldev->cmd_queue);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+// bring the host buffer of an image living there up to date. mapping it
+// waits for the kernels and gives back the host buffer itself.
+static cl_int _opencl_hostmem_sync(const int devid,
+                                   void *host,
+                                   cl_mem image,
+                                   const int width,
+                                   const int height,
+                                   const int bpp)
+{
+  const size_t origin[3] = { 0, 0, 0 };
+  const size_t region[3] = { width, height, 1 };
+  size_t row_pitch = 0;
+  cl_int err = CL_SUCCESS;
+  cl_command_queue queue = darktable.opencl->dev[devid].cmd_queue;
+
+  cl_event *eventp = _opencl_events_get_slot(devid, "[Map Image]");
+  void *mapped = (darktable.opencl->dlocl->symbols->dt_clEnqueueMapImage)
+    (queue, image, CL_TRUE, CL_MAP_READ, origin, region, &row_pitch, NULL,
+     0, NULL, eventp, &err);
+  if(err != CL_SUCCESS)
+    return err;
+
+  // implementations not sharing the memory map a copy
+  if(mapped != host)
+    for(int j = 0; j < height; j++)
+      memcpy((char *)host + (size_t)j * width * bpp, (char *)mapped + j * row_pitch,
+             (size_t)width * bpp);
+
+  eventp = _opencl_events_get_slot(devid, "[Unmap Image]");
+  return (darktable.opencl->dlocl->symbols->dt_clEnqueueUnmapMemObject)
+    (queue, image, mapped, 0, NULL, eventp);
+}
+
+// auto-tune mode. instead of the configured headroom and micro nap the
+// memory the device really gives us and the latency of its queue are
+// measured once per device and driver. the headroom grows whenever an
+// allocation fails, the learned values are kept in the conf.
+
+#define DT_OPENCL_TUNE_STEP 64 // MB
+
+static void _opencl_autotune_write(const int devid)
+{
+  const dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+  gchar *dat = g_strdup_printf("%i %i", cldev->tune_headroom, cldev->tune_micro_nap);
+  dt_conf_set_string(cldev->tune_key, dat);
+  g_free(dat);
+}
+
+static void _opencl_autotune_apply(const int devid)
+{
+  dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+  const size_t headroom = (size_t)cldev->tune_headroom * DT_MEGA;
+  const size_t lowmem = 256ul * DT_MEGA;
+  cldev->used_available = cldev->max_global_mem > headroom + lowmem
+    ? cldev->max_global_mem - headroom
+    : lowmem;
+}
+
+static void _opencl_autotune_grow(const int devid)
+{
+  dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+  const int max_headroom = cldev->max_global_mem / DT_MEGA / 2;
+
+  // only the pipe owning the device gets here, no locking needed
+  const int headroom = MIN(max_headroom, cldev->tune_headroom + DT_OPENCL_TUNE_STEP);
+  if(headroom > cldev->tune_headroom)
+  {
+    cldev->tune_headroom = headroom;
+    _opencl_autotune_apply(devid);
+    _opencl_autotune_write(devid);
+    dt_print(DT_DEBUG_OPENCL,
+             "[opencl autotune] device '%s' id=%d: allocation failed, headroom now %iMB",
+             cldev->fullname, devid, headroom);
+  }
+}
+
+// the memory we really get in chunks that are filled, some drivers
+// only commit buffers on first use
+static size_t _opencl_autotune_memory(const int devid)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  const dt_opencl_device_t *cldev = &cl->dev[devid];
+  const size_t chunk = MIN(cldev->max_mem_alloc, 256ul * DT_MEGA);
+  const int chunks = chunk ? cldev->max_global_mem / chunk : 0;
+  cl_mem *bufs = calloc(MAX(chunks, 1), sizeof(cl_mem));
+  const float zero = 0.0f;
+
+  int n = 0;
+  while(bufs && n < chunks)
+  {
+    cl_int err = CL_SUCCESS;
+    cl_mem buf = (cl->dlocl->symbols->dt_clCreateBuffer)
+      (cldev->context, CL_MEM_READ_WRITE, chunk, NULL, &err);
+    if(err == CL_SUCCESS)
+      err = (cl->dlocl->symbols->dt_clEnqueueFillBuffer)
+        (cldev->cmd_queue, buf, &zero, sizeof(zero), 0, chunk, 0, NULL, NULL);
+    if(err == CL_SUCCESS)
+      err = (cl->dlocl->symbols->dt_clFinish)(cldev->cmd_queue);
+    if(err != CL_SUCCESS)
+    {
+      if(buf) (cl->dlocl->symbols->dt_clReleaseMemObject)(buf);
+      break;
+    }
+    bufs[n++] = buf;
+  }
+
+  for(int k = 0; k < n; k++)
+    (cl->dlocl->symbols->dt_clReleaseMemObject)(bufs[k]);
+  free(bufs);
+  return (size_t)n * chunk;
+}
+
+// round trip of a tiny blocking write through the queue, in microseconds
+static int _opencl_autotune_latency(const int devid)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  const dt_opencl_device_t *cldev = &cl->dev[devid];
+  cl_int err = CL_SUCCESS;
+  cl_mem buf = (cl->dlocl->symbols->dt_clCreateBuffer)
+    (cldev->context, CL_MEM_READ_WRITE, sizeof(float), NULL, &err);
+  if(err != CL_SUCCESS) return -1;
+
+  const float val = 0.0f;
+  const int runs = 16;
+  const double start = dt_get_wtime();
+  for(int k = 0; k < runs && err == CL_SUCCESS; k++)
+    err = (cl->dlocl->symbols->dt_clEnqueueWriteBuffer)
+      (cldev->cmd_queue, buf, CL_TRUE, 0, sizeof(float), &val, 0, NULL, NULL);
+  const double elapsed = dt_get_wtime() - start;
+  (cl->dlocl->symbols->dt_clReleaseMemObject)(buf);
+
+  return err == CL_SUCCESS ? 1e6 * elapsed / runs : -1;
+}
+
+static void _opencl_autotune(const int devid,
+                             const char *drvversion)
+{
+  dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+  // measuring would take system memory from unified memory devices
+  if(cldev->unified_memory || !dt_conf_get_bool("opencl_autotune")) return;
+
+  cldev->tune_key = g_strdup_printf("%s%s_%s_tune", DT_CLDEVICE_HEAD, cldev->cname, drvversion);
+  cldev->autotune = TRUE;
+
+  const char *dat = dt_conf_key_not_empty(cldev->tune_key)
+    ? dt_conf_get_string_const(cldev->tune_key)
+    : NULL;
+  if(dat && sscanf(dat, "%i %i", &cldev->tune_headroom, &cldev->tune_micro_nap) == 2
+     && cldev->tune_headroom >= 0 && cldev->tune_micro_nap >= 0)
+  {
+    dt_print_nts(DT_DEBUG_OPENCL,
+                 "   AUTOTUNED:                headroom %iMB, micro nap %ius\n",
+                 cldev->tune_headroom, cldev->tune_micro_nap);
+    return;
+  }
+
+  const size_t got = _opencl_autotune_memory(devid);
+  const int latency = _opencl_autotune_latency(devid);
+
+  // what other applications hold now plus a safety step
+  const size_t missing = cldev->max_global_mem > got ? cldev->max_global_mem - got : 0;
+  cldev->tune_headroom = missing / DT_MEGA + DT_OPENCL_TUNE_STEP;
+  cldev->tune_micro_nap = latency < 0 ? cldev->micro_nap : CLAMP(4 * latency, 50, 1000);
+  _opencl_autotune_write(devid);
+
+  dt_print_nts(DT_DEBUG_OPENCL,
+               "   AUTOTUNE MEASURED:        %zuMB of %zuMB, queue latency %ius"
+               " -> headroom %iMB, micro nap %ius\n",
+               got / DT_MEGA, (size_t)(cldev->max_global_mem / DT_MEGA), latency,
+               cldev->tune_headroom, cldev->tune_micro_nap);
+}
+
 static gboolean _opencl_device_init(dt_opencl_t *cl,
                                     const int dev,
                                     cl_device_id *devices,
@@ -503,6 +900,10 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   memset(cl->dev[dev].program_used, 0x0, sizeof(int) * DT_OPENCL_MAX_PROGRAMS);
   memset(cl->dev[dev].kernel, 0x0, sizeof(cl_kernel) * DT_OPENCL_MAX_KERNELS);
   memset(cl->dev[dev].kernel_used, 0x0, sizeof(int) * DT_OPENCL_MAX_KERNELS);
+  memset(cl->dev[dev].program_pending, 0x0, sizeof(gboolean) * DT_OPENCL_MAX_PROGRAMS);
+  cl->dev[dev].build_queue = NULL;
+  cl->dev[dev].build_running = FALSE;
+  cl->dev[dev].build_stop = FALSE;
   cl->dev[dev].eventlist = NULL;
   cl->dev[dev].eventtags = NULL;
   cl->dev[dev].numevents = 0;
@@ -531,10 +932,21 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   cl->dev[dev].avoid = NULL;
   cl->dev[dev].memory_in_use = 0;
   cl->dev[dev].peak_memory = 0;
+  cl->dev[dev].pool_owned = NULL;
+  cl->dev[dev].hostmem = NULL;
+  cl->dev[dev].zero_copy = FALSE;
+  cl->dev[dev].hostptr_align = DT_CACHELINE_BYTES;
+  cl->dev[dev].pool_free = NULL;
+  cl->dev[dev].pool_bytes = 0;
+  cl->dev[dev].pool_hits = 0;
+  cl->dev[dev].pool_misses = 0;
   cl->dev[dev].used_available = 0;
   // setting sane/conservative defaults at first
   cl->dev[dev].unified_fraction = 0.25f;
   cl->dev[dev].micro_nap = 250;
+  cl->dev[dev].transfer_queue = NULL;
+  cl->dev[dev].throughput = 0.0f;
+  cl->dev[dev].transfer_rate = 0.0f;
   cl->dev[dev].pinned_memory = FALSE;
   cl->dev[dev].unified_memory = FALSE;
   cl->dev[dev].pinned_error = FALSE;
@@ -545,6 +957,10 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   cl->dev[dev].asyncmode = FALSE;
   cl->dev[dev].disabled = FALSE;
   cl->dev[dev].headroom = 0;
+  cl->dev[dev].autotune = FALSE;
+  cl->dev[dev].tune_headroom = 0;
+  cl->dev[dev].tune_micro_nap = 0;
+  cl->dev[dev].tune_key = NULL;
   cl->dev[dev].vendor_id = 0;
   cl->dev[dev].tunehead = FALSE;
   cl->dev[dev].atomic_support = DT_OPENCL_ATOMIC_NONE;
@@ -589,8 +1005,13 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   char *filename = calloc(PATH_MAX, sizeof(char));
   char *confentry = calloc(PATH_MAX, sizeof(char));
   char *binname = calloc(PATH_MAX, sizeof(char));
+  gchar *shareddir = NULL;
+  const gboolean async_build = dt_conf_get_bool("opencl_async_build");
 
   dt_pthread_mutex_init(&cl->dev[dev].lock, NULL);
+  dt_pthread_mutex_init(&cl->dev[dev].pool_lock, NULL);
+  cl->dev[dev].pool_owned = g_hash_table_new_full(NULL, NULL, NULL, free);
+  cl->dev[dev].hostmem = g_hash_table_new(NULL, NULL);
 
   // test GPU availability, vendor, memory, image support etc:
   (cl->dlocl->symbols->dt_clGetDeviceInfo)(devid, CL_DEVICE_AVAILABLE,
@@ -781,6 +1202,12 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
                                            sizeof(cl_bool), &unified_memory, NULL);
   cl->dev[dev].unified_memory = unified_memory ? TRUE : FALSE;
 
+  cl_uint base_align = 0;
+  (cl->dlocl->symbols->dt_clGetDeviceInfo)(devid, CL_DEVICE_MEM_BASE_ADDR_ALIGN,
+                                           sizeof(cl_uint), &base_align, NULL);
+  cl->dev[dev].hostptr_align = MAX(DT_CACHELINE_BYTES, base_align / 8);
+  cl->dev[dev].zero_copy = cl->dev[dev].unified_memory && dt_conf_get_bool("opencl_zero_copy");
+
 #ifndef _opencl_apply_scheduling_profile  // they never supported inline assembling
   if(strstr(platform_display_name, "NVIDIA CUDA"))
     cl->dev[dev].cuda = TRUE;
@@ -994,7 +1421,7 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   // create a command queue for first device the context reported
   cl->dev[dev].cmd_queue = (cl->dlocl->symbols->dt_clCreateCommandQueue)(
       cl->dev[dev].context, devid,
-      (darktable.unmuted & DT_DEBUG_PERF)
+      cl->profiling
       ? CL_QUEUE_PROFILING_ENABLE
       : 0,
       &err);
@@ -1006,6 +1433,16 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
     goto end;
   }
 
+  // the transfer queue is optional, tiling falls back to synchronous transfers without it
+  cl->dev[dev].transfer_queue = (cl->dlocl->symbols->dt_clCreateCommandQueue)(
+      cl->dev[dev].context, devid, 0, &err);
+  if(err != CL_SUCCESS)
+  {
+    dt_print_nts(DT_DEBUG_OPENCL,
+                 "   *** could not create transfer queue *** %s\n", cl_errstr(err));
+    cl->dev[dev].transfer_queue = NULL;
+  }
+
   dt_loc_get_user_cache_dir(dtcache, PATH_MAX * sizeof(char));
 
   int len = MIN(strlen(fullname),1024 * sizeof(char));;
@@ -1032,9 +1469,25 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
     goto end;
   }
 
+  // the same layout below the optional read-only shared cache
+  const char *sharedcache = dt_conf_get_string_const("opencl_shared_kernel_cache");
+  if(sharedcache && sharedcache[0])
+  {
+    gchar *dirname = g_path_get_basename(cachedir);
+    shareddir = g_build_filename(sharedcache, dirname, NULL);
+    g_free(dirname);
+    if(!g_file_test(shareddir, G_FILE_TEST_IS_DIR))
+    {
+      g_free(shareddir);
+      shareddir = NULL;
+    }
+  }
+
   dt_loc_get_kerneldir(kerneldir, sizeof(kerneldir));
   dt_print_nts(DT_DEBUG_OPENCL, "   KERNEL BUILD DIRECTORY:   %s\n", kerneldir);
   dt_print_nts(DT_DEBUG_OPENCL, "   KERNEL DIRECTORY:         %s\n", cachedir);
+  if(shareddir)
+    dt_print_nts(DT_DEBUG_OPENCL, "   SHARED KERNEL DIRECTORY:  %s\n", shareddir);
 
   snprintf(filename, PATH_MAX * sizeof(char),
            "%s" G_DIR_SEPARATOR_S "programs.conf", kerneldir);
@@ -1075,8 +1528,8 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
     _opencl_write_device_config(dev);
   }
 
-  // now load all darktable cl kernels.
-  // TODO: compile as a job?
+  // now load all darktable cl kernels. programs without a cached binary
+  // are built later by the background build thread if enabled.
   double tstart = dt_get_debug_wtime();
   FILE *f = g_fopen(filename, "rb");
   if(f)
@@ -1135,9 +1588,21 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
                "[dt_opencl_device_init] testing program `%s'\n", programname);
       gboolean loaded_cached;
       char md5sum[33];
-      if(_opencl_load_program(dev, prog, programname, filename, binname, cachedir,
-                              md5sum, includemd5, &loaded_cached)
-         && _opencl_build_program(dev, prog, binname, cachedir, md5sum, loaded_cached))
+      const gboolean loaded = _opencl_load_program(dev, prog, programname, filename,
+                                                   binname, cachedir, shareddir,
+                                                   md5sum, includemd5, &loaded_cached);
+      if(loaded && !loaded_cached && async_build)
+      {
+        _opencl_build_job_t *job = g_malloc(sizeof(_opencl_build_job_t));
+        job->prog = prog;
+        job->binname = g_strdup(binname);
+        job->cachedir = g_strdup(cachedir);
+        g_strlcpy(job->md5sum, md5sum, sizeof(job->md5sum));
+        cl->dev[dev].build_queue = g_list_append(cl->dev[dev].build_queue, job);
+        cl->dev[dev].program_pending[prog] = TRUE;
+      }
+      else if(loaded
+              && _opencl_build_program(dev, prog, binname, cachedir, md5sum, loaded_cached))
       {
         dt_print_nts(DT_DEBUG_OPENCL,
                  "[dt_opencl_device_init] failed to compile program `%s'\n", programname);
@@ -1164,6 +1629,23 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   for(int n = 0; n < DT_OPENCL_MAX_INCLUDES; n++) g_free(includemd5[n]);
   res = FALSE;
 
+  _opencl_autotune(dev, drvversion);
+
+  if(cl->dev[dev].build_queue)
+  {
+    dt_print_nts(DT_DEBUG_OPENCL,
+                 "   BACKGROUND BUILD:         %d programs\n",
+                 g_list_length(cl->dev[dev].build_queue));
+    cl->dev[dev].build_running = TRUE;
+    if(dt_pthread_create(&cl->dev[dev].build_thread, _opencl_build_thread,
+                         GINT_TO_POINTER(dev)))
+    {
+      // no thread, build them right away
+      cl->dev[dev].build_running = FALSE;
+      _opencl_build_queue(dev);
+    }
+  }
+
 end:
   // we always write the device config to keep track of disabled devices
   _opencl_write_device_config(dev);
@@ -1191,14 +1673,40 @@ end:
   free(filename);
   free(confentry);
   free(binname);
+  g_free(shareddir);
+
+  if(res)
+  {
+    g_list_free_full(cl->dev[dev].build_queue, _opencl_build_job_free);
+    cl->dev[dev].build_queue = NULL;
+  }
 
   return res;
 }
 
 static void _cleanup_cl_device_context(dt_opencl_t *cl, const int i)
 {
+  if(cl->dev[i].build_running)
+  {
+    // the program being built is finished, the rest is dropped
+    dt_pthread_mutex_lock(&cl->lock);
+    cl->dev[i].build_stop = TRUE;
+    dt_pthread_mutex_unlock(&cl->lock);
+    pthread_join(cl->dev[i].build_thread, NULL);
+    cl->dev[i].build_running = FALSE;
+  }
+  g_list_free_full(cl->dev[i].build_queue, _opencl_build_job_free);
+  cl->dev[i].build_queue = NULL;
+
   dt_pthread_mutex_destroy(&cl->dev[i].lock);
 
+  _opencl_pool_flush(i);
+  if(cl->dev[i].pool_owned) g_hash_table_destroy(cl->dev[i].pool_owned);
+  cl->dev[i].pool_owned = NULL;
+  if(cl->dev[i].hostmem) g_hash_table_destroy(cl->dev[i].hostmem);
+  cl->dev[i].hostmem = NULL;
+  dt_pthread_mutex_destroy(&cl->dev[i].pool_lock);
+
   for(int k = 0; k < DT_OPENCL_MAX_KERNELS; k++)
   {
     if(cl->dev[i].kernel_used[k])
@@ -1211,6 +1719,8 @@ static void _cleanup_cl_device_context(dt_opencl_t *cl, const int i)
       (cl->dlocl->symbols->dt_clReleaseProgram)(cl->dev[i].program[k]);
   }
 
+  if(cl->dev[i].transfer_queue)
+    (cl->dlocl->symbols->dt_clReleaseCommandQueue)(cl->dev[i].transfer_queue);
   (cl->dlocl->symbols->dt_clReleaseCommandQueue)(cl->dev[i].cmd_queue);
   (cl->dlocl->symbols->dt_clReleaseContext)(cl->dev[i].context);
 }
@@ -1226,6 +1736,7 @@ static void _cleanup_cl_device_mem(dt_opencl_t *cl, const int i)
 
   free((void *)(cl->dev[i].fullname));
   free((void *)(cl->dev[i].device_version));
+  g_free(cl->dev[i].tune_key);
   free((void *)(cl->dev[i].platform));
   free((void *)(cl->dev[i].cname));
   free((void *)(cl->dev[i].options));
@@ -1233,11 +1744,15 @@ static void _cleanup_cl_device_mem(dt_opencl_t *cl, const int i)
   g_free((void *)(cl->dev[i].avoid));
 }
 
+static void _kernel_profile_free(gpointer data);
+
 void dt_opencl_init(dt_opencl_t *cl,
                     const int options,
                     const gboolean print_statistics)
 {
   const gboolean exclude_opencl = options & DT_OPENCL_OPTION_EXCLUDE;
+  _conf_async_tiling = dt_conf_handle("opencl_async_tiling", DT_BOOL);
+  _conf_mandatory_timeout = dt_conf_handle("opencl_mandatory_timeout", DT_INT);
   dt_pthread_mutex_init(&cl->lock, NULL);
   cl->inited = FALSE;
   cl->enabled = FALSE;
@@ -1254,6 +1769,13 @@ void dt_opencl_init(dt_opencl_t *cl,
 #endif
   cl->print_statistics = print_statistics;
 
+  // per kernel profiling for the session, kept in memory if written to a file
+  dt_pthread_mutex_init(&cl->profile_lock, NULL);
+  cl->kernel_profile = dt_conf_key_not_empty("opencl_kernel_profile")
+    ? g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _kernel_profile_free)
+    : NULL;
+  cl->profiling = cl->kernel_profile || (darktable.unmuted & DT_DEBUG_PERF);
+
   // we might want to show an opencl error
   char *logerror = NULL;
   const gboolean opencl_requested = dt_conf_get_bool("opencl");
@@ -1659,9 +2181,10 @@ void dt_opencl_cleanup(dt_opencl_t *cl)
       {
         dt_print_nts(DT_DEBUG_OPENCL,
                      "[opencl_summary_statistics] device '%s' id=%d:"
-                     " peak memory usage %.1f MB%s\n",
+                     " peak memory usage %.1f MB, pool %d hits, %d misses%s\n",
                      cl->dev[i].fullname, i,
                      (float)cl->dev[i].peak_memory/(1024*1024),
+                     cl->dev[i].pool_hits, cl->dev[i].pool_misses,
                      cl->dev[i].clmem_error
                        ? ", clmem runtime problem"
                        : "");
@@ -1703,6 +2226,14 @@ void dt_opencl_cleanup(dt_opencl_t *cl)
     dt_dlopencl_close(cl->dlocl);
   }
 
+  if(cl->kernel_profile)
+  {
+    dt_opencl_kernel_profile_write(dt_conf_get_string_const("opencl_kernel_profile"));
+    g_hash_table_destroy(cl->kernel_profile);
+    cl->kernel_profile = NULL;
+  }
+  dt_pthread_mutex_destroy(&cl->profile_lock);
+
   free(cl->dev);
   dt_pthread_mutex_destroy(&cl->lock);
 }
@@ -2035,6 +2566,118 @@ static void _opencl_update_priorities(const char *configstr)
                STR_YESNO(cl->mandatory[4]));
 }
 
+// a device reaching less than this fraction of the best weight counts as slow
+#define DT_OPENCL_SLOW_DEVICE 0.25f
+
+/* weighted scheduling: try the devices of the priority list ordered by measured
+   throughput and available memory. heavy pipes give busy fast devices half of
+   the mandatory timeout before settling for a slow one, and never take a
+   device the CPU has proven to be faster than.
+*/
+static int _opencl_lock_weighted_device(const int *priority,
+                                        const gboolean mandatory,
+                                        const gboolean heavy)
+{
+  dt_opencl_t *cl = darktable.opencl;
+
+  int count = 0;
+  for(const int *prio = priority; *prio != DT_DEVICE_CPU; prio++) count++;
+  if(count == 0) return DT_DEVICE_CPU;
+
+  int *order = malloc(sizeof(int) * count);
+  float *weight = malloc(sizeof(float) * count);
+
+  dt_pthread_mutex_lock(&cl->lock);
+  // unmeasured devices are assumed to be as good as the best one so they get measured
+  float best = 0.0f;
+  cl_ulong maxmem = 1;
+  for(int k = 0; k < count; k++)
+  {
+    best = MAX(best, cl->dev[priority[k]].throughput);
+    maxmem = MAX(maxmem, dt_opencl_get_device_available(priority[k]));
+  }
+  if(best <= 0.0f) best = 1.0f;
+
+  for(int k = 0; k < count; k++)
+  {
+    const int devid = priority[k];
+    const float thr = cl->dev[devid].throughput > 0.0f ? cl->dev[devid].throughput : best;
+    const float mem = (float)dt_opencl_get_device_available(devid) / (float)maxmem;
+    // stable insertion keeps the user priority for equal weights
+    const float w = thr * (0.5f + 0.5f * mem);
+    int i = k;
+    for(; i > 0 && weight[i - 1] < w; i--)
+    {
+      weight[i] = weight[i - 1];
+      order[i] = order[i - 1];
+    }
+    weight[i] = w;
+    order[i] = devid;
+  }
+  const float cpu = cl->cpu_throughput;
+  dt_pthread_mutex_unlock(&cl->lock);
+
+  const int usec = 5000;
+  const int nloop = (heavy ? 10 : 1) * MAX(1, dt_conf_handle_get_int(_conf_mandatory_timeout));
+
+  int devid = DT_DEVICE_CPU;
+  for(int n = 0; n < nloop && devid == DT_DEVICE_CPU; n++)
+  {
+    const gboolean patient = heavy && n < nloop / 2;
+    gboolean waiting = FALSE;
+    for(int k = 0; k < count; k++)
+    {
+      const int dev = order[k];
+      if(weight[k] < DT_OPENCL_SLOW_DEVICE * weight[0])
+      {
+        // the CPU does better than this and all remaining devices
+        const float thr = cl->dev[dev].throughput;
+        if(thr > 0.0f && cpu > thr) break;
+        if(patient)
+        {
+          waiting = TRUE;
+          break;
+        }
+      }
+      if(!dt_pthread_mutex_BAD_trylock(&cl->dev[dev].lock))
+      {
+        devid = dev;
+        break;
+      }
+    }
+
+    if(devid == DT_DEVICE_CPU)
+    {
+      if(!mandatory && !waiting) break;
+      dt_iop_nap(usec);
+    }
+  }
+
+  free(order);
+  free(weight);
+  return devid;
+}
+
+void dt_opencl_update_throughput(const int devid,
+                                 const double mpix,
+                                 const double seconds)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->inited || devid >= cl->num_devs || mpix <= 0.0 || seconds <= 0.0) return;
+
+  const float thr = mpix / seconds;
+  dt_pthread_mutex_lock(&cl->lock);
+  float *avg = devid > DT_DEVICE_CPU ? &cl->dev[devid].throughput : &cl->cpu_throughput;
+  // moving average, the first measurement is taken as is
+  *avg = *avg > 0.0f ? 0.75f * *avg + 0.25f * thr : thr;
+  dt_pthread_mutex_unlock(&cl->lock);
+
+  dt_print(DT_DEBUG_OPENCL | DT_DEBUG_VERBOSE,
+           "[opencl_update_throughput] %s: %.1f MPix/s, average %.1f MPix/s",
+           devid > DT_DEVICE_CPU ? cl->dev[devid].fullname : "CPU", thr,
+           devid > DT_DEVICE_CPU ? cl->dev[devid].throughput : cl->cpu_throughput);
+}
+
 int dt_opencl_lock_device(const int pipetype)
 {
   dt_opencl_t *cl = darktable.opencl;
@@ -2078,12 +2721,19 @@ int dt_opencl_lock_device(const int pipetype)
       mandatory = FALSE;
   }
 
+  const gboolean weighted = cl->scheduling_profile == OPENCL_PROFILE_WEIGHTED_GPUS;
   dt_pthread_mutex_unlock(&cl->lock);
 
-  if(priority)
+  if(priority && weighted)
+  {
+    const int devid = _opencl_lock_weighted_device(priority, mandatory, heavy);
+    free(priority);
+    return devid;
+  }
+  else if(priority)
   {
     const int usec = 5000;
-    const int nloop = (heavy ? 10 : 1) * MAX(0, dt_conf_get_int("opencl_mandatory_timeout"));
+    const int nloop = (heavy ? 10 : 1) * MAX(0, dt_conf_handle_get_int(_conf_mandatory_timeout));
 
     // check for free opencl device repeatedly if mandatory is TRUE,
     // else give up after first try
@@ -2131,6 +2781,26 @@ int dt_opencl_lock_device(const int pipetype)
   return DT_DEVICE_CPU;
 }
 
+int dt_opencl_lock_idle_device(void)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!_cl_running()) return DT_DEVICE_CPU;
+
+  dt_pthread_mutex_lock(&cl->lock);
+  for(const int *prio = cl->dev_priority_export; *prio != DT_DEVICE_CPU; prio++)
+  {
+    if(cl->dev[*prio].disabled) continue;
+    if(!dt_pthread_mutex_BAD_trylock(&cl->dev[*prio].lock))
+    {
+      const int devid = *prio;
+      dt_pthread_mutex_unlock(&cl->lock);
+      return devid;
+    }
+  }
+  dt_pthread_mutex_unlock(&cl->lock);
+  return DT_DEVICE_CPU;
+}
+
 void dt_opencl_unlock_device(const int devid)
 {
   dt_opencl_t *cl = darktable.opencl;
@@ -2216,6 +2886,55 @@ static void _opencl_md5sum(const char **files,
   }
 }
 
+// the shared cache holds the binaries named like in the user cache
+// but is never written, so there are no links to follow.
+// returns TRUE if the program has been created from a shared binary
+static gboolean _opencl_load_shared_program(const int dev,
+                                            const int prog,
+                                            const char *binname,
+                                            const char *shareddir,
+                                            const char *md5sum)
+{
+  dt_opencl_t *cl = darktable.opencl;
+
+#if defined(_WIN32)
+  gchar *bname = g_path_get_basename(binname);
+  gchar *leaf = g_strdup_printf("%s.%s", bname, md5sum);
+  gchar *sharedname = g_build_filename(shareddir, leaf, NULL);
+  g_free(leaf);
+  g_free(bname);
+#else
+  gchar *sharedname = g_build_filename(shareddir, md5sum, NULL);
+#endif
+
+  gchar *content = NULL;
+  gsize size = 0;
+  gboolean loaded = FALSE;
+  if(g_file_get_contents(sharedname, &content, &size, NULL) && size > 0)
+  {
+    cl_int err;
+    size_t binary_size = size;
+    cl->dev[dev].program[prog] = (cl->dlocl->symbols->dt_clCreateProgramWithBinary)(
+        cl->dev[dev].context, 1, &(cl->dev[dev].devid), &binary_size,
+        (const unsigned char **)&content, NULL, &err);
+    if(err != CL_SUCCESS)
+      dt_print_nts(DT_DEBUG_OPENCL,
+                   "[opencl_load_program] could not load shared binary"
+                   " program from file '%s' (%s)\n", sharedname, cl_errstr(err));
+    else
+    {
+      cl->dev[dev].program_used[prog] = TRUE;
+      loaded = TRUE;
+      dt_print_nts(DT_DEBUG_OPENCL | DT_DEBUG_VERBOSE,
+                   "[opencl_load_program] loaded shared binary program from file '%s'\n",
+                   sharedname);
+    }
+  }
+  g_free(content);
+  g_free(sharedname);
+  return loaded;
+}
+
 // returns TRUE in case of an success
 static gboolean _opencl_load_program(const int dev,
                                      const int prog,
@@ -2223,6 +2942,7 @@ static gboolean _opencl_load_program(const int dev,
                                      const char *filename,
                                      const char *binname,
                                      const char *cachedir,
+                                     const char *shareddir,
                                      char *md5sum,
                                      char **includemd5,
                                      gboolean *loaded_cached)
@@ -2393,6 +3113,12 @@ static gboolean _opencl_load_program(const int dev,
     g_unlink(dup);
 #endif //!defined(_WIN32)
 
+    if(shareddir)
+      *loaded_cached = _opencl_load_shared_program(dev, prog, binname, shareddir, md5sum);
+  }
+
+  if(*loaded_cached == FALSE)
+  {
     dt_print_nts(DT_DEBUG_OPENCL | DT_DEBUG_VERBOSE,
              "[opencl_load_program] could not load cached binary program,"
              " trying to compile source\n");
@@ -2577,15 +3303,10 @@ static gboolean _opencl_build_program(const int dev,
     {
       if(cl->dev[dev].devid == devices[i])
       {
-        char dup[PATH_MAX] = { 0 };
-        g_strlcpy(dup, binname, sizeof(dup));
-        char *bname = basename(dup);
-
         // save opencl compiled binary as md5sum-named file
         char filename[PATH_MAX] = { 0 };
 #if defined(_WIN32)
-        snprintf(filename, sizeof(filename), "%s" G_DIR_SEPARATOR_S "%s.%s",
-                 cachedir, bname, md5sum);
+        snprintf(filename, sizeof(filename), "%s.%s", binname, md5sum);
 #else
         snprintf(filename, sizeof(filename), "%s" G_DIR_SEPARATOR_S "%s",
                  cachedir, md5sum);
@@ -2597,12 +3318,10 @@ static gboolean _opencl_build_program(const int dev,
         fclose(f);
 
 #if !defined(_WIN32)
-        // create link (e.g. basic.cl.bin -> f1430102c53867c162bb60af6c163328)
-        char cwd[PATH_MAX] = { 0 };
-        if(!getcwd(cwd, sizeof(cwd))) goto ret;
-        if(chdir(cachedir) != 0) goto ret;
-        if(symlink(md5sum, bname) != 0) goto ret;
-        if(chdir(cwd) != 0) goto ret;
+        // create link (e.g. basic.cl.bin -> f1430102c53867c162bb60af6c163328),
+        // the target is relative to the directory of the link. no chdir() as
+        // this might run in the background build thread.
+        if(symlink(md5sum, binname) != 0) goto ret;
 #endif //!defined(_WIN32)
       }
     }
@@ -2623,6 +3342,65 @@ static gboolean _opencl_build_program(const int dev,
   return err != CL_SUCCESS;
 }
 
+static void _opencl_build_job_free(gpointer data)
+{
+  _opencl_build_job_t *job = data;
+  g_free(job->binname);
+  g_free(job->cachedir);
+  g_free(job);
+}
+
+static void _opencl_build_queue(const int dev)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  const double tstart = dt_get_wtime();
+  int built = 0;
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&cl->lock);
+    _opencl_build_job_t *job = NULL;
+    if(!cl->dev[dev].build_stop && cl->dev[dev].build_queue)
+    {
+      job = cl->dev[dev].build_queue->data;
+      cl->dev[dev].build_queue = g_list_delete_link(cl->dev[dev].build_queue,
+                                                    cl->dev[dev].build_queue);
+    }
+    dt_pthread_mutex_unlock(&cl->lock);
+    if(!job) break;
+
+    const gboolean failed = _opencl_build_program(dev, job->prog, job->binname,
+                                                  job->cachedir, job->md5sum, FALSE);
+
+    dt_pthread_mutex_lock(&cl->lock);
+    if(failed)
+    {
+      // leave the modules on the CPU for good
+      dt_print_nts(DT_DEBUG_OPENCL,
+                   "[opencl_build_thread] failed to compile program %d for '%s'\n",
+                   job->prog, cl->dev[dev].fullname);
+      (cl->dlocl->symbols->dt_clReleaseProgram)(cl->dev[dev].program[job->prog]);
+      cl->dev[dev].program_used[job->prog] = FALSE;
+    }
+    else
+      built++;
+    cl->dev[dev].program_pending[job->prog] = FALSE;
+    dt_pthread_mutex_unlock(&cl->lock);
+
+    _opencl_build_job_free(job);
+  }
+
+  dt_print_nts(DT_DEBUG_OPENCL,
+               "[opencl_build_thread] built %d programs for '%s' in %.3f sec\n",
+               built, cl->dev[dev].fullname, dt_get_wtime() - tstart);
+}
+
+static void *_opencl_build_thread(void *arg)
+{
+  dt_pthread_setname("opencl build");
+  _opencl_build_queue(GPOINTER_TO_INT(arg));
+  return NULL;
+}
+
 int dt_opencl_create_kernel(const int prog,
                             const char *name)
 {
@@ -2657,6 +3435,13 @@ static gboolean _check_kernel(const int dev,
   if(prog < 0 || prog >= DT_OPENCL_MAX_PROGRAMS) return FALSE;
   dt_pthread_mutex_lock(&cl->lock);
 
+  // not built yet or failed in the background, try again later
+  if(cl->dev[dev].program_pending[prog] || !cl->dev[dev].program_used[prog])
+  {
+    dt_pthread_mutex_unlock(&cl->lock);
+    return FALSE;
+  }
+
   if(!cl->dev[dev].kernel_used[kernel]
      && cl->name_saved[kernel])
   {
@@ -2819,7 +3604,7 @@ int dt_opencl_enqueue_kernel_ndim_with_local(const int dev,
   if(kernel < 0 || kernel >= DT_OPENCL_MAX_KERNELS) return CL_INVALID_KERNEL;
 
   char buf[256] = { 0 };
-  if(darktable.unmuted & DT_DEBUG_OPENCL)
+  if((darktable.unmuted & DT_DEBUG_OPENCL) || cl->kernel_profile)
     (cl->dlocl->symbols->dt_clGetKernelInfo)(cl->dev[dev].kernel[kernel],
                                              CL_KERNEL_FUNCTION_NAME, sizeof(buf), buf, NULL);
   cl_event *eventp = _opencl_events_get_slot(dev, buf);
@@ -2926,10 +3711,29 @@ int dt_opencl_copy_image_to_host(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
+  // an image living in host needs no copy
+  if(_opencl_hostmem_is(devid, image, host))
+    return _opencl_hostmem_sync(devid, host, image, width, height, bpp);
+
   const size_t region[2] = { width, height };
+  const double start = dt_get_wtime();
   // blocking.
-  return dt_opencl_read_host_from_image_raw(devid, host, image, CLIMG_ORIGIN,
-                                             region, (size_t)width * bpp, TRUE);
+  const int err = dt_opencl_read_host_from_image_raw(devid, host, image, CLIMG_ORIGIN,
+                                                     region, (size_t)width * bpp, TRUE);
+
+  // small images are dominated by latency and would spoil the estimate
+  const size_t bytes = (size_t)width * height * bpp;
+  const double spent = dt_get_wtime() - start;
+  if(err == CL_SUCCESS && bytes >= DT_MEGA && spent > 0.0)
+  {
+    // the device is locked by the caller
+    dt_opencl_device_t *cldev = &darktable.opencl->dev[devid];
+    const float rate = (float)bytes / DT_MEGA / spent;
+    cldev->transfer_rate = cldev->transfer_rate > 0.0f
+      ? 0.75f * cldev->transfer_rate + 0.25f * rate
+      : rate;
+  }
+  return err;
 }
 
 int dt_opencl_read_host_from_image_raw(const int devid,
@@ -2967,6 +3771,122 @@ int dt_opencl_read_host_from_image_raw(const int devid,
   return err;
 }
 
+int dt_opencl_read_host_from_image_async(const int devid,
+                                         void *host,
+                                         cl_mem image,
+                                         const size_t *origin,
+                                         const size_t *region,
+                                         const int rowpitch,
+                                         cl_event wait,
+                                         cl_event *event)
+{
+  if(!_cldev_running(devid) || !darktable.opencl->dev[devid].transfer_queue)
+    return DT_OPENCL_NODEVICE;
+
+  dt_opencl_t *cl = darktable.opencl;
+  const size_t org[3] = { origin ? origin[0] : 0, origin ? origin[1] : 0, 0 };
+  const size_t reg[3] = { region[0], region[1], 1 };
+
+  cl_int err = (cl->dlocl->symbols->dt_clEnqueueReadImage)
+    (cl->dev[devid].transfer_queue, image, CL_FALSE,
+     org, reg, rowpitch, 0, host, wait ? 1 : 0, wait ? &wait : NULL, event);
+  if(err == CL_SUCCESS)
+    err = (cl->dlocl->symbols->dt_clFlush)(cl->dev[devid].transfer_queue);
+
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_OPENCL,
+             "[dt_opencl_read_host_from_image_async] could not read image from device '%s' id=%d: %s",
+             cl->dev[devid].fullname, devid, cl_errstr(err));
+
+  _check_clmem_err(devid, err);
+  return err;
+}
+
+int dt_opencl_write_host_to_image_async(const int devid,
+                                        const void *host,
+                                        cl_mem image,
+                                        const size_t *origin,
+                                        const size_t *region,
+                                        const int rowpitch,
+                                        cl_event wait,
+                                        cl_event *event)
+{
+  if(!_cldev_running(devid) || !darktable.opencl->dev[devid].transfer_queue)
+    return DT_OPENCL_NODEVICE;
+
+  dt_opencl_t *cl = darktable.opencl;
+  const size_t org[3] = { origin ? origin[0] : 0, origin ? origin[1] : 0, 0 };
+  const size_t reg[3] = { region[0], region[1], 1 };
+
+  cl_int err = (cl->dlocl->symbols->dt_clEnqueueWriteImage)
+    (cl->dev[devid].transfer_queue, image, CL_FALSE,
+     org, reg, rowpitch, 0, host, wait ? 1 : 0, wait ? &wait : NULL, event);
+  if(err == CL_SUCCESS)
+    err = (cl->dlocl->symbols->dt_clFlush)(cl->dev[devid].transfer_queue);
+
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_OPENCL,
+             "[dt_opencl_write_host_to_image_async] could not write image to device '%s' id=%d: %s",
+             cl->dev[devid].fullname, devid, cl_errstr(err));
+
+  _check_clmem_err(devid, err);
+  return err;
+}
+
+int dt_opencl_enqueue_wait_event(const int devid,
+                                 cl_event event)
+{
+  if(!_cldev_running(devid))
+    return DT_OPENCL_NODEVICE;
+
+  dt_opencl_t *cl = darktable.opencl;
+  cl_int err = (cl->dlocl->symbols->dt_clEnqueueWaitForEvents)(cl->dev[devid].cmd_queue, 1, &event);
+  if(err == CL_SUCCESS)
+    err = (cl->dlocl->symbols->dt_clFlush)(cl->dev[devid].cmd_queue);
+
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_OPENCL,
+             "[dt_opencl_enqueue_wait_event] could not enqueue wait on device '%s' id=%d: %s",
+             cl->dev[devid].fullname, devid, cl_errstr(err));
+  return err;
+}
+
+int dt_opencl_enqueue_marker(const int devid,
+                             cl_event *event)
+{
+  if(!_cldev_running(devid))
+    return DT_OPENCL_NODEVICE;
+
+  dt_opencl_t *cl = darktable.opencl;
+  cl_int err = (cl->dlocl->symbols->dt_clEnqueueMarker)(cl->dev[devid].cmd_queue, event);
+  if(err == CL_SUCCESS)
+    err = (cl->dlocl->symbols->dt_clFlush)(cl->dev[devid].cmd_queue);
+
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_OPENCL,
+             "[dt_opencl_enqueue_marker] could not enqueue marker on device '%s' id=%d: %s",
+             cl->dev[devid].fullname, devid, cl_errstr(err));
+  return err;
+}
+
+int dt_opencl_wait_event(cl_event *event)
+{
+  if(!event || !*event) return CL_SUCCESS;
+
+  dt_opencl_t *cl = darktable.opencl;
+  cl_int err = (cl->dlocl->symbols->dt_clWaitForEvents)(1, event);
+  if(err == CL_SUCCESS)
+  {
+    cl_int status = CL_COMPLETE;
+    (cl->dlocl->symbols->dt_clGetEventInfo)(*event, CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                            sizeof(cl_int), &status, NULL);
+    if(status < 0) err = status;
+  }
+  (cl->dlocl->symbols->dt_clReleaseEvent)(*event);
+  *event = NULL;
+  return err;
+}
+
 int dt_opencl_write_host_to_image(const int devid,
                                    const void *host,
                                    cl_mem image,
@@ -3300,6 +4220,9 @@ void dt_opencl_release_mem_object(cl_mem mem)
 
   dt_opencl_memory_statistics(DT_DEVICE_CPU, mem, OPENCL_MEMORY_SUB);
 
+  if(!_opencl_hostmem_forget(mem) && _opencl_pool_give(mem))
+    return;
+
   (darktable.opencl->dlocl->symbols->dt_clReleaseMemObject)(mem);
 }
 
@@ -3441,19 +4364,36 @@ void *dt_opencl_alloc_device(const int devid,
     return NULL;
   }
 
+  const size_t size = (size_t)width * height * bpp;
+  cl_mem dev = _opencl_pool_take(devid, width, height, bpp, size);
+  if(dev)
+  {
+    dt_opencl_memory_statistics(devid, dev, OPENCL_MEMORY_ADD);
+    return dev;
+  }
+
   cl_image_desc desc;
   memset(&desc, 0, sizeof(cl_image_desc));
   desc.image_type = CL_MEM_OBJECT_IMAGE2D;
   desc.image_width = width;
   desc.image_height = height;
 
-  cl_mem dev = (cl->dlocl->symbols->dt_clCreateImage)
+  dev = (cl->dlocl->symbols->dt_clCreateImage)
     (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
+  if((err == CL_MEM_OBJECT_ALLOCATION_FAILURE || err == CL_OUT_OF_RESOURCES)
+     && _opencl_make_room(devid))
+  {
+    // the pooled objects might have been in the way
+    dev = (cl->dlocl->symbols->dt_clCreateImage)
+      (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
+  }
 
   if(err != CL_SUCCESS || dev == NULL)
     dt_print(DT_DEBUG_OPENCL,
              "[opencl alloc_device] could not alloc image on device '%s' id=%d: %s",
              cl->dev[devid].fullname, devid, cl_errstr(err));
+  else
+    _opencl_pool_register(devid, dev, width, height, bpp, size);
 
   _check_clmem_err(devid, err);
   dt_opencl_memory_statistics(devid, dev, OPENCL_MEMORY_ADD);
@@ -3461,6 +4401,58 @@ void *dt_opencl_alloc_device(const int devid,
   return dev;
 }
 
+void *dt_opencl_alloc_device_use_host(const int devid,
+                                      const int width,
+                                      const int height,
+                                      const int bpp,
+                                      void *host)
+{
+  if(!_cldev_running(devid))
+    return NULL;
+
+  dt_opencl_t *cl = darktable.opencl;
+  dt_opencl_device_t *cldev = &cl->dev[devid];
+  cl_image_format fmt;
+  if(bpp == 4 * sizeof(float))
+    fmt = (cl_image_format){ CL_RGBA, CL_FLOAT };
+  else if(bpp == sizeof(float))
+    fmt = (cl_image_format){ CL_R, CL_FLOAT };
+  else
+    return dt_opencl_alloc_device(devid, width, height, bpp);
+
+  if(!cldev->zero_copy
+     || !host
+     || (uintptr_t)host % cldev->hostptr_align
+     || cldev->max_image_width < width
+     || cldev->max_image_height < height)
+    return dt_opencl_alloc_device(devid, width, height, bpp);
+
+  cl_image_desc desc;
+  memset(&desc, 0, sizeof(cl_image_desc));
+  desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+  desc.image_width = width;
+  desc.image_height = height;
+  desc.image_row_pitch = (size_t)width * bpp;
+
+  cl_int err = CL_SUCCESS;
+  cl_mem dev = (cl->dlocl->symbols->dt_clCreateImage)
+    (cldev->context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, &fmt, &desc, host, &err);
+  if(err != CL_SUCCESS || dev == NULL)
+  {
+    dt_print(DT_DEBUG_OPENCL,
+             "[opencl alloc_device_use_host] could not create image in host memory on device '%s' id=%d: %s",
+             cldev->fullname, devid, cl_errstr(err));
+    return dt_opencl_alloc_device(devid, width, height, bpp);
+  }
+
+  dt_pthread_mutex_lock(&cldev->pool_lock);
+  g_hash_table_insert(cldev->hostmem, dev, host);
+  dt_pthread_mutex_unlock(&cldev->pool_lock);
+
+  dt_opencl_memory_statistics(devid, dev, OPENCL_MEMORY_ADD);
+  return dev;
+}
+
 static cl_ulong _opencl_get_device_memalloc(const int devid)
 {
   dt_opencl_t *cl = darktable.opencl;
@@ -3477,13 +4469,30 @@ void *dt_opencl_alloc_device_buffer(const int devid,
     return NULL;
   cl_int err = CL_SUCCESS;
 
-  cl_mem buf = (cl->dlocl->symbols->dt_clCreateBuffer)
+  cl_mem buf = _opencl_pool_take(devid, 0, 0, 0, size);
+  if(buf)
+  {
+    dt_opencl_memory_statistics(devid, buf, OPENCL_MEMORY_ADD);
+    return buf;
+  }
+
+  buf = (cl->dlocl->symbols->dt_clCreateBuffer)
     (cl->dev[devid].context,
      CL_MEM_READ_WRITE, size, NULL, &err);
+  if((err == CL_MEM_OBJECT_ALLOCATION_FAILURE || err == CL_OUT_OF_RESOURCES)
+     && _opencl_make_room(devid))
+  {
+    buf = (cl->dlocl->symbols->dt_clCreateBuffer)
+      (cl->dev[devid].context,
+       CL_MEM_READ_WRITE, size, NULL, &err);
+  }
+
   if(err != CL_SUCCESS || buf == NULL)
     dt_print(DT_DEBUG_OPENCL,
              "[opencl alloc_device_buffer] could not allocate cl buffer on device '%s' id=%d: %s",
              cl->dev[devid].fullname, devid, cl_errstr(err));
+  else
+    _opencl_pool_register(devid, buf, 0, 0, 0, size);
 
   _check_clmem_err(devid, err);
   dt_opencl_memory_statistics(devid, buf, OPENCL_MEMORY_ADD);
@@ -3631,7 +4640,8 @@ void dt_opencl_memory_statistics(int devid,
                                  const cl_mem mem,
                                  const dt_opencl_memory_t action)
 {
-  if(!((darktable.unmuted & DT_DEBUG_MEMORY) && (darktable.unmuted & DT_DEBUG_OPENCL)))
+  // counted with -d memory alone for the memory accounts
+  if(!(darktable.unmuted & DT_DEBUG_MEMORY))
     return;
 
   if(devid <= DT_DEVICE_CPU)
@@ -3651,11 +4661,14 @@ void dt_opencl_memory_statistics(int devid,
 
   if(darktable.unmuted & DT_DEBUG_MEMORY)
   {
-    dt_print(DT_DEBUG_OPENCL,"[opencl memory] device '%s' id=%d: %.1fMB in use, %.1fMB available GPU mem of %.1fMB",
+    dt_print(DT_DEBUG_OPENCL,"[opencl memory] device '%s' id=%d: %.1fMB in use, %.1fMB available GPU mem of %.1fMB,"
+             " pool %.1fMB, %d hits, %d misses",
              cl->dev[devid].fullname, devid,
              (float)cl->dev[devid].memory_in_use / DT_MEGA,
              (float)cl->dev[devid].used_available / DT_MEGA,
-             (float)cl->dev[devid].max_global_mem / DT_MEGA);
+             (float)cl->dev[devid].max_global_mem / DT_MEGA,
+             (float)cl->dev[devid].pool_bytes / DT_MEGA,
+             cl->dev[devid].pool_hits, cl->dev[devid].pool_misses);
       if(cl->dev[devid].memory_in_use > darktable.opencl->dev[devid].used_available)
       {
         dt_print(DT_DEBUG_OPENCL,
@@ -3779,7 +4792,11 @@ void dt_opencl_update_settings(void)
   for(int i = 0; i < cl->num_devs; i++)
   {
     cl->dev[i].tunehead = tunehead;
-    if(level < 0)
+    if(cl->dev[i].autotune)
+    {
+      _opencl_autotune_apply(i);
+    }
+    else if(level < 0)
     {
       cl->dev[i].used_available = res->refresource[4*(-level-1) + 3] * DT_MEGA;
     }
@@ -3809,7 +4826,7 @@ void dt_opencl_update_settings(void)
     dt_print_nts(DT_DEBUG_OPENCL,
          "   AVAILABLE CLMEM SIZE:     %zu MB%s%s\n",
               (size_t)(cl->dev[i].used_available / DT_MEGA),
-              cl->dev[i].tunehead ? ", tuned" : "",
+              cl->dev[i].autotune ? ", autotuned" : cl->dev[i].tunehead ? ", tuned" : "",
               cl->dev[i].pinned_memory ? ", pinned": "");
   }
   if(res->cl_uni_memory)
@@ -3829,6 +4846,8 @@ static dt_opencl_scheduling_profile_t _opencl_get_scheduling_profile(void)
     profile = OPENCL_PROFILE_MULTIPLE_GPUS;
   else if(!strcmp(pstr, "very fast GPU"))
     profile = OPENCL_PROFILE_VERYFAST_GPU;
+  else if(!strcmp(pstr, "weighted GPUs"))
+    profile = OPENCL_PROFILE_WEIGHTED_GPUS;
 
   return profile;
 }
@@ -3851,6 +4870,7 @@ static void _opencl_apply_scheduling_profile(dt_opencl_scheduling_profile_t prof
   switch(profile)
   {
     case OPENCL_PROFILE_MULTIPLE_GPUS:
+    case OPENCL_PROFILE_WEIGHTED_GPUS:
       _opencl_update_priorities("*/*/*/*/*");
       _opencl_set_synchronization_timeout(20);
       break;
@@ -4144,6 +5164,146 @@ static void _opencl_events_profiling(const int devid,
   free(tags);
 }
 
+/* per kernel timings over the whole session. the time between queueing
+   and submitting, submitting and starting and the execution itself are
+   summed up separately, the execution times are sampled for the p95. */
+
+#define DT_KERNEL_PROFILE_SAMPLES 4096
+
+typedef struct _kernel_profile_t
+{
+  char name[DT_OPENCL_EVENTNAMELENGTH];
+  uint64_t count;
+  cl_ulong queued;  // ns
+  cl_ulong submit;
+  cl_ulong exec;
+  cl_ulong exec_max;
+  GArray *samples;  // exec times in ns, reservoir of the runs
+} _kernel_profile_t;
+
+static void _kernel_profile_free(gpointer data)
+{
+  _kernel_profile_t *p = data;
+  g_array_free(p->samples, TRUE);
+  free(p);
+}
+
+static void _kernel_profile_add(const char *tag,
+                                const cl_ulong queued,
+                                const cl_ulong submit,
+                                const cl_ulong exec)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  const char *name = tag[0] == '\0' ? "<?>" : tag;
+
+  dt_pthread_mutex_lock(&cl->profile_lock);
+  _kernel_profile_t *p = g_hash_table_lookup(cl->kernel_profile, name);
+  if(!p)
+  {
+    p = calloc(1, sizeof(_kernel_profile_t));
+    g_strlcpy(p->name, name, sizeof(p->name));
+    p->samples = g_array_new(FALSE, FALSE, sizeof(cl_ulong));
+    g_hash_table_insert(cl->kernel_profile, p->name, p);
+  }
+  p->count++;
+  p->queued += queued;
+  p->submit += submit;
+  p->exec += exec;
+  p->exec_max = MAX(p->exec_max, exec);
+
+  if(p->samples->len < DT_KERNEL_PROFILE_SAMPLES)
+    g_array_append_val(p->samples, exec);
+  else
+  {
+    const uint64_t slot = g_random_double() * p->count;
+    if(slot < DT_KERNEL_PROFILE_SAMPLES)
+      g_array_index(p->samples, cl_ulong, slot) = exec;
+  }
+  dt_pthread_mutex_unlock(&cl->profile_lock);
+}
+
+static int _kernel_profile_cmp_samples(const void *a, const void *b)
+{
+  const cl_ulong sa = *(const cl_ulong *)a;
+  const cl_ulong sb = *(const cl_ulong *)b;
+  return (sa > sb) - (sa < sb);
+}
+
+static gint _kernel_profile_cmp_exec(gconstpointer a, gconstpointer b)
+{
+  const _kernel_profile_t *pa = a;
+  const _kernel_profile_t *pb = b;
+  return (pa->exec < pb->exec) - (pa->exec > pb->exec);
+}
+
+void dt_opencl_kernel_profile_reset(void)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->kernel_profile) return;
+
+  dt_pthread_mutex_lock(&cl->profile_lock);
+  g_hash_table_remove_all(cl->kernel_profile);
+  dt_pthread_mutex_unlock(&cl->profile_lock);
+}
+
+gboolean dt_opencl_kernel_profile_write(const char *filename)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->kernel_profile || !filename || !filename[0]) return FALSE;
+
+  FILE *f = g_fopen(filename, "wb");
+  if(!f)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[opencl_profiling] can't write kernel profile to '%s'", filename);
+    return FALSE;
+  }
+
+  const gboolean json = g_str_has_suffix(filename, ".json");
+  if(json)
+    fprintf(f, "{\n  \"kernels\": [");
+  else
+    fprintf(f, "kernel,count,total_ms,avg_ms,p95_ms,max_ms,queued_ms,submit_ms\n");
+
+  dt_pthread_mutex_lock(&cl->profile_lock);
+  // most expensive first
+  GList *kernels = g_list_sort(g_hash_table_get_values(cl->kernel_profile),
+                               _kernel_profile_cmp_exec);
+  for(GList *l = kernels; l; l = g_list_next(l))
+  {
+    _kernel_profile_t *p = l->data;
+    qsort(p->samples->data, p->samples->len, sizeof(cl_ulong), _kernel_profile_cmp_samples);
+    const cl_ulong p95 = p->samples->len
+      ? g_array_index(p->samples, cl_ulong, (p->samples->len - 1) * 95 / 100)
+      : 0;
+    const double total = p->exec * 1e-6;
+    const double avg = total / p->count;
+    const double queued = p->queued * 1e-6;
+    const double submit = p->submit * 1e-6;
+
+    char *name = g_strescape(p->name, NULL);
+    if(json)
+      fprintf(f, "%s\n    { \"kernel\": \"%s\", \"count\": %" PRIu64 ", \"total_ms\": %.4f,"
+                 " \"avg_ms\": %.4f, \"p95_ms\": %.4f, \"max_ms\": %.4f,"
+                 " \"queued_ms\": %.4f, \"submit_ms\": %.4f }",
+              l == kernels ? "" : ",", name, p->count, total, avg,
+              p95 * 1e-6, p->exec_max * 1e-6, queued, submit);
+    else
+      fprintf(f, "\"%s\",%" PRIu64 ",%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+              name, p->count, total, avg, p95 * 1e-6, p->exec_max * 1e-6, queued, submit);
+    g_free(name);
+  }
+  const guint count = g_list_length(kernels);
+  g_list_free(kernels);
+  dt_pthread_mutex_unlock(&cl->profile_lock);
+
+  if(json) fprintf(f, "\n  ]\n}\n");
+  fclose(f);
+
+  dt_print(DT_DEBUG_OPENCL, "[opencl_profiling] wrote timings of %u kernels to '%s'",
+           count, filename);
+  return TRUE;
+}
+
 /** Wait for events in eventlist to terminate, check for return status
     and profiling info of events.  If "reset" is TRUE report summary
     info (would be CL_COMPLETE or last error code) and print profiling
@@ -4200,12 +5360,13 @@ cl_int dt_opencl_events_flush(const int devid,
     else
       (*totalsuccess)++;
 
-    if((darktable.unmuted & DT_DEBUG_PERF)
+    if(cl->profiling
        && err == CL_SUCCESS
        && *retval == CL_COMPLETE)
     {
-      // get profiling info of event (only if darktable was called with '-d perf').
-      // Initialize start/end so a driver that wrongly returns CL_SUCCESS without
+      // get profiling info of event (only if darktable was called with
+      // '-d perf' or the kernel profile is written).  Initialize
+      // start/end so a driver that wrongly returns CL_SUCCESS without
       // populating the value cannot make us subtract garbage.
       cl_ulong start = 0;
       cl_ulong end = 0;
@@ -4217,6 +5378,17 @@ cl_int dt_opencl_events_flush(const int devid,
       if(errs == CL_SUCCESS && erre == CL_SUCCESS && end >= start)
       {
         (*eventtags)[k].timelapsed = end - start;
+        if(cl->kernel_profile)
+        {
+          cl_ulong queued = start;
+          cl_ulong submit = start;
+          (cl->dlocl->symbols->dt_clGetEventProfilingInfo)
+            ((*eventlist)[k], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, NULL);
+          (cl->dlocl->symbols->dt_clGetEventProfilingInfo)
+            ((*eventlist)[k], CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &submit, NULL);
+          if(queued > submit || submit > start) queued = submit = start;
+          _kernel_profile_add(tag, submit - queued, start - submit, end - start);
+        }
       }
       else
       {
@@ -91,7 +91,8 @@ typedef enum dt_opencl_scheduling_profile_t
 {
   OPENCL_PROFILE_DEFAULT,
   OPENCL_PROFILE_MULTIPLE_GPUS,
-  OPENCL_PROFILE_VERYFAST_GPU
+  OPENCL_PROFILE_VERYFAST_GPU,
+  OPENCL_PROFILE_WEIGHTED_GPUS
 } dt_opencl_scheduling_profile_t;
 
 /**
@@ -121,6 +122,9 @@ typedef struct dt_opencl_device_t
   cl_device_id devid;
   cl_context context;
   cl_command_queue cmd_queue;
+  // second in-order queue used for host<->device transfers running
+  // concurrently to the kernels of cmd_queue, NULL if not available
+  cl_command_queue transfer_queue;
   size_t max_image_width;
   size_t max_image_height;
   cl_ulong max_mem_alloc;
@@ -136,6 +140,13 @@ typedef struct dt_opencl_device_t
   cl_kernel kernel[DT_OPENCL_MAX_KERNELS];
   gboolean program_used[DT_OPENCL_MAX_PROGRAMS];
   gboolean kernel_used[DT_OPENCL_MAX_KERNELS];
+  // programs waiting for the background build, protected by the global cl lock.
+  // kernels of these are not available and the modules run on the CPU.
+  gboolean program_pending[DT_OPENCL_MAX_PROGRAMS];
+  GList *build_queue;
+  pthread_t build_thread;
+  gboolean build_running;
+  gboolean build_stop;
   cl_event *eventlist;
   dt_opencl_eventtag_t *eventtags;
   int numevents;
@@ -157,6 +168,13 @@ typedef struct dt_opencl_device_t
   cl_int summary;
   size_t memory_in_use;
   size_t peak_memory;
+  // images and buffers released by the modules, kept for reuse
+  dt_pthread_mutex_t pool_lock;
+  GHashTable *pool_owned; // cl_mem allocated through the pool -> its description
+  GList *pool_free;       // released ones, most recent first
+  size_t pool_bytes;
+  int pool_hits;
+  int pool_misses;
   size_t used_available;
   // flags if we want headroom mode
   gboolean tunehead;
@@ -182,6 +200,11 @@ typedef struct dt_opencl_device_t
   gboolean unified_memory;
   // fraction of system memory allowed for a device in percent
   float unified_fraction;
+  // images of unified memory devices may be created over host buffers
+  // aligned to hostptr_align bytes, kept in hostmem -> host pointer
+  gboolean zero_copy;
+  size_t hostptr_align;
+  GHashTable *hostmem;
 
   // flags reporting cl runtime error conditions
   gboolean pinned_error;
@@ -212,8 +235,22 @@ typedef struct dt_opencl_device_t
   // all memory.
   int headroom;
 
+  // auto-tune mode: headroom in MB and micro nap measured for the device
+  // and driver, grown on allocation failures and kept in tune_key
+  gboolean autotune;
+  int tune_headroom;
+  int tune_micro_nap;
+  gchar *tune_key;
+
   // lets keep the vendor for runtime checks
   int vendor_id;
+
+  // measured throughput of image pipes in input megapixels per second,
+  // 0 as long as we haven't seen one pipe finish on the device
+  float throughput;
+
+  // measured bandwidth of blocking image downloads in MB per second, 0 if unknown
+  float transfer_rate;
 } dt_opencl_device_t;
 
 struct dt_bilateral_cl_global_t;
@@ -250,6 +287,7 @@ typedef struct dt_opencl_t
   int *dev_priority_preview2;
   int *dev_priority_export;
   int *dev_priority_thumbnail;
+  float cpu_throughput; // same as dt_opencl_device_t.throughput for the CPU
   dt_opencl_device_t *dev;
   dt_dlopencl_t *dlocl;
 
@@ -280,6 +318,11 @@ typedef struct dt_opencl_t
   // global kernels for guided filter.
   struct dt_guided_filter_cl_global_t *guided_filter;
 
+  // per kernel timings of the session if profiling, NULL otherwise
+  gboolean profiling;
+  dt_pthread_mutex_t profile_lock;
+  GHashTable *kernel_profile;
+
   // saved kernel info for deferred initialisation
   int program_saved[DT_OPENCL_MAX_KERNELS];
   const char *name_saved[DT_OPENCL_MAX_KERNELS];
@@ -330,9 +373,19 @@ gboolean dt_opencl_finish_sync_pipe(const int devid,
 /** locks a device for your thread's exclusive use and returns it's id */
 int dt_opencl_lock_device(const int pipetype);
 
+/** locks any currently unused device of the export priority list without waiting,
+ * returns DT_DEVICE_CPU if there is none */
+int dt_opencl_lock_idle_device(void);
+
 /** done with your command queue. */
 void dt_opencl_unlock_device(const int dev);
 
+/** account a finished image pipe of mpix input megapixels taking
+ * seconds on device devid (or the CPU), used for weighted device locking */
+void dt_opencl_update_throughput(const int devid,
+                                 const double mpix,
+                                 const double seconds);
+
 /** inits a kernel. returns the index or -1 if fail. */
 int dt_opencl_create_kernel(const int program,
                             const char *name);
@@ -469,6 +522,40 @@ int dt_opencl_write_host_to_image_raw(const int devid,
                                        const int rowpitch,
                                        const gboolean blocking);
 
+/** non-blocking transfers on the transfer queue of the device. the
+ * transfer waits for the optional event `wait`, `event` receives an
+ * event the caller has to release via dt_opencl_wait_event() */
+int dt_opencl_read_host_from_image_async(const int devid,
+                                         void *host,
+                                         cl_mem image,
+                                         const size_t *origin,
+                                         const size_t *region,
+                                         const int rowpitch,
+                                         cl_event wait,
+                                         cl_event *event);
+
+int dt_opencl_write_host_to_image_async(const int devid,
+                                        const void *host,
+                                        cl_mem image,
+                                        const size_t *origin,
+                                        const size_t *region,
+                                        const int rowpitch,
+                                        cl_event wait,
+                                        cl_event *event);
+
+/** let the command queue of the device wait for an event of the
+ * transfer queue or put a marker event into it, in both cases the
+ * queue is flushed */
+int dt_opencl_enqueue_wait_event(const int devid,
+                                 cl_event event);
+
+int dt_opencl_enqueue_marker(const int devid,
+                             cl_event *event);
+
+/** blocks until the event has completed and releases it, returns the
+ * event status */
+int dt_opencl_wait_event(cl_event *event);
+
 int dt_opencl_fill_buffer(const int devid,
                           cl_mem buffer,
                           const size_t pts,
@@ -501,6 +588,15 @@ void *dt_opencl_alloc_device(const int devid,
                              const int height,
                              const int bpp);
 
+/** on unified memory devices an image living in the host buffer host, of
+    the same size and organisation. copying it back to host is only a
+    synchronization. falls back to dt_opencl_alloc_device() otherwise. */
+void *dt_opencl_alloc_device_use_host(const int devid,
+                                      const int width,
+                                      const int height,
+                                      const int bpp,
+                                      void *host);
+
 int dt_opencl_enqueue_copy_image_to_buffer(const int devid,
                                            const cl_mem src_image,
                                            cl_mem dst_buffer,
@@ -605,6 +701,12 @@ void dt_opencl_events_reset(const int devid);
 cl_int dt_opencl_events_flush(const int devid,
                               const gboolean reset);
 
+/** drop the per kernel timings collected so far, e.g. before a benchmark */
+void dt_opencl_kernel_profile_reset(void);
+
+/** write the per kernel timings as csv, or as json if filename ends with .json */
+gboolean dt_opencl_kernel_profile_write(const char *filename);
+
 /** utility function to calculate optimal work group dimensions for a
     given kernel, returns an error code
 */
@@ -616,6 +718,8 @@ cl_int dt_opencl_local_buffer_opt(const int devid,
 gboolean dt_opencl_avoid_atomics(const int devid);
 void dt_opencl_micro_nap(const int devid);
 gboolean dt_opencl_use_pinned_memory(const int devid);
+gboolean dt_opencl_use_async_transfers(const int devid);
+float dt_opencl_get_transfer_rate(const int devid);
 gboolean dt_opencl_unified_memory(const int devid);
 unsigned int dt_opencl_tiling_align(const int devid);
 
@@ -666,9 +770,18 @@ static inline int dt_opencl_lock_device(const int pipetype)
 {
   return DT_OPENCL_DEFAULT_ERROR;
 }
+static inline int dt_opencl_lock_idle_device(void)
+{
+  return DT_DEVICE_CPU;
+}
 static inline void dt_opencl_unlock_device(const int dev)
 {
 }
+static inline void dt_opencl_update_throughput(const int devid,
+                                               const double mpix,
+                                               const double seconds)
+{
+}
 static inline int dt_opencl_create_kernel(const int program,
                                           const char *name)
 {
@@ -752,6 +865,13 @@ static inline int dt_opencl_events_flush(const int devid,
 {
   return CL_SUCCESS;
 }
+static inline void dt_opencl_kernel_profile_reset(void)
+{
+}
+static inline gboolean dt_opencl_kernel_profile_write(const char *filename)
+{
+  return FALSE;
+}
 
 G_END_DECLS
 
@@ -282,29 +282,84 @@ static size_t _pdf_stream_encoder_ASCIIHex(dt_pdf_t *pdf,
   return len * 2;
 }
 
-// using zlib we get quite small files, but it's slow
-static size_t _pdf_stream_encoder_Flate(dt_pdf_t *pdf,
-                                        const unsigned char *data,
-                                        const size_t len)
+// an encoded stream written piece by piece, so images can go to the
+// file row by row without a converted or compressed copy in memory.
+typedef struct _pdf_stream_t
 {
-  int result;
-  uLongf destLen = compressBound(len);
-  unsigned char *buffer = malloc(destLen);
-  if(!buffer)
-    return 0;
+  dt_pdf_t *pdf;
+  dt_pdf_stream_encoder_t encoder;
+  z_stream strm;
+  size_t written;
+  gboolean ok;
+} _pdf_stream_t;
+
+// using zlib we get quite small files, but it's slow. the data is
+// deflated through a small buffer straight into the file.
+static void _pdf_stream_deflate(_pdf_stream_t *stream,
+                                const int flush)
+{
+  unsigned char buffer[1 << 16];
+  int result = Z_OK;
+  do
+  {
+    stream->strm.next_out = buffer;
+    stream->strm.avail_out = sizeof(buffer);
+    result = deflate(&stream->strm, flush);
+    const size_t have = sizeof(buffer) - stream->strm.avail_out;
+    if(have && fwrite(buffer, 1, have, stream->pdf->fd) != have)
+      result = Z_ERRNO;
+    stream->written += have;
+  } while(result == Z_OK && (flush == Z_FINISH || stream->strm.avail_out == 0));
+
+  if(result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+    stream->ok = FALSE;
+}
 
-  result = compress(buffer, &destLen, data, len);
+static void _pdf_stream_begin(_pdf_stream_t *stream,
+                              dt_pdf_t *pdf,
+                              const dt_pdf_stream_encoder_t encoder)
+{
+  memset(stream, 0, sizeof(_pdf_stream_t));
+  stream->pdf = pdf;
+  stream->encoder = encoder;
+  stream->ok = encoder != DT_PDF_STREAM_ENCODER_FLATE
+    || deflateInit(&stream->strm, Z_DEFAULT_COMPRESSION) == Z_OK;
+}
+
+static void _pdf_stream_add(_pdf_stream_t *stream,
+                            const unsigned char *data,
+                            const size_t len)
+{
+  if(!stream->ok || len == 0) return;
 
-  if(result != Z_OK)
+  switch(stream->encoder)
   {
-    free(buffer);
-    return 0;
+    case DT_PDF_STREAM_ENCODER_ASCII_HEX:
+      stream->written += _pdf_stream_encoder_ASCIIHex(stream->pdf, data, len);
+      break;
+    case DT_PDF_STREAM_ENCODER_FLATE:
+      // feed the input in pieces zlib's uInt can hold
+      for(size_t offset = 0; offset < len && stream->ok;)
+      {
+        const size_t chunk = MIN(len - offset, (size_t)1 << 30);
+        stream->strm.next_in = (unsigned char *)data + offset;
+        stream->strm.avail_in = chunk;
+        _pdf_stream_deflate(stream, Z_NO_FLUSH);
+        offset += chunk;
+      }
+      break;
   }
+}
 
-  fwrite(buffer, 1, destLen, pdf->fd);
-
-  free(buffer);
-  return destLen;
+// the size of the encoded stream, 0 on error
+static size_t _pdf_stream_end(_pdf_stream_t *stream)
+{
+  if(stream->encoder == DT_PDF_STREAM_ENCODER_FLATE)
+  {
+    if(stream->ok) _pdf_stream_deflate(stream, Z_FINISH);
+    deflateEnd(&stream->strm);
+  }
+  return stream->ok ? stream->written : 0;
 }
 
 static size_t _pdf_write_stream(dt_pdf_t *pdf,
@@ -312,17 +367,10 @@ static size_t _pdf_write_stream(dt_pdf_t *pdf,
                                 const unsigned char *data,
                                 const size_t len)
 {
-  size_t stream_size = 0;
-  switch(encoder)
-  {
-    case DT_PDF_STREAM_ENCODER_ASCII_HEX:
-      stream_size = _pdf_stream_encoder_ASCIIHex(pdf, data, len);
-      break;
-    case DT_PDF_STREAM_ENCODER_FLATE:
-      stream_size = _pdf_stream_encoder_Flate(pdf, data, len);
-      break;
-  }
-  return stream_size;
+  _pdf_stream_t stream;
+  _pdf_stream_begin(&stream, pdf, encoder);
+  _pdf_stream_add(&stream, data, len);
+  return _pdf_stream_end(&stream);
 }
 
 int dt_pdf_add_icc(dt_pdf_t *pdf, const char *filename)
@@ -386,13 +434,17 @@ int dt_pdf_add_icc_from_data(dt_pdf_t *pdf,
 // reference it later.  if icc_id is 0 then we suppose the pixel data
 // to be in output device space, otherwise the ICC profile object is
 // referenced.  if image == NULL only the outline can be shown later
-dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf,
-                                 const unsigned char *image,
-                                 const int width,
-                                 const int height,
-                                 const int bpp,
-                                 const int icc_id,
-                                 const float border)
+// the image object around the stream written by add_rows, which passes
+// the rows of the image to _pdf_stream_add()
+static dt_pdf_image_t *_pdf_add_image(dt_pdf_t *pdf,
+                                      const int width,
+                                      const int height,
+                                      const int bpp,
+                                      const int icc_id,
+                                      const float border,
+                                      const gboolean outline,
+                                      void (*add_rows)(_pdf_stream_t *stream, const void *data),
+                                      const void *data)
 {
   size_t stream_size = 0;
   size_t bytes_written = 0;
@@ -402,7 +454,7 @@ dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf,
 
   pdf_image->width = width;
   pdf_image->height = height;
-  pdf_image->outline_mode = (image == NULL);
+  pdf_image->outline_mode = outline;
   // no need to do fancy math here:
   pdf_image->bb_x = border;
   pdf_image->bb_y = border;
@@ -447,8 +499,10 @@ dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf,
   );
 
   // the stream
-  stream_size = _pdf_write_stream(pdf, pdf->default_encoder,
-                                  image, (size_t)3 * (bpp / 8) * width * height);
+  _pdf_stream_t stream;
+  _pdf_stream_begin(&stream, pdf, pdf->default_encoder);
+  add_rows(&stream, data);
+  stream_size = _pdf_stream_end(&stream);
   if(stream_size == 0)
   {
     free(pdf_image);
@@ -476,6 +530,80 @@ dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf,
   return pdf_image;
 }
 
+typedef struct _pdf_rows_t
+{
+  const unsigned char *image;
+  size_t width, height;
+  int bpp;
+} _pdf_rows_t;
+
+static void _pdf_add_packed_rows(_pdf_stream_t *stream,
+                                 const void *data)
+{
+  const _pdf_rows_t *rows = data;
+  _pdf_stream_add(stream, rows->image, 3 * (rows->bpp / 8) * rows->width * rows->height);
+}
+
+// drop the 4th channel and make 16 bit values big endian, a row at a time
+static void _pdf_add_rgbx_rows(_pdf_stream_t *stream,
+                               const void *data)
+{
+  const _pdf_rows_t *rows = data;
+  const size_t row_size = 3 * (rows->bpp / 8) * rows->width;
+  unsigned char *row = malloc(row_size);
+  if(!row)
+  {
+    stream->ok = FALSE;
+    return;
+  }
+
+  for(size_t y = 0; y < rows->height && stream->ok; y++)
+  {
+    if(rows->bpp == 8)
+    {
+      const uint8_t *in = rows->image + 4 * rows->width * y;
+      for(size_t x = 0; x < rows->width; x++)
+        memcpy(row + 3 * x, in + 4 * x, 3);
+    }
+    else
+    {
+      const uint16_t *in = (const uint16_t *)rows->image + 4 * rows->width * y;
+      uint16_t *out = (uint16_t *)row;
+      for(size_t x = 0; x < rows->width; x++)
+        for(int c = 0; c < 3; c++)
+          out[3 * x + c] = (0xff00 & (in[4 * x + c] << 8)) | (in[4 * x + c] >> 8);
+    }
+    _pdf_stream_add(stream, row, row_size);
+  }
+  free(row);
+}
+
+dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf,
+                                 const unsigned char *image,
+                                 const int width,
+                                 const int height,
+                                 const int bpp,
+                                 const int icc_id,
+                                 const float border)
+{
+  const _pdf_rows_t rows = { image, width, height, bpp };
+  return _pdf_add_image(pdf, width, height, bpp, icc_id, border, image == NULL,
+                        _pdf_add_packed_rows, &rows);
+}
+
+dt_pdf_image_t *dt_pdf_add_image_rgbx(dt_pdf_t *pdf,
+                                      const void *image,
+                                      const int width,
+                                      const int height,
+                                      const int bpp,
+                                      const int icc_id,
+                                      const float border)
+{
+  const _pdf_rows_t rows = { image, width, height, bpp };
+  return _pdf_add_image(pdf, width, height, bpp, icc_id, border, image == NULL,
+                        _pdf_add_rgbx_rows, &rows);
+}
+
 dt_pdf_page_t *dt_pdf_add_page(dt_pdf_t *pdf,
                                dt_pdf_image_t **images,
                                const int n_images)
@@ -132,6 +132,15 @@ dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf,
                                  const int bpp,
                                  const int icc_id,
                                  const float border);
+// the same from 4 channels per pixel, 16 bit values in host byte order.
+// the image is written row by row without a converted copy.
+dt_pdf_image_t *dt_pdf_add_image_rgbx(dt_pdf_t *pdf,
+                                      const void *image,
+                                      const int width,
+                                      const int height,
+                                      const int bpp,
+                                      const int icc_id,
+                                      const float border);
 dt_pdf_page_t *dt_pdf_add_page(dt_pdf_t *pdf,
                                dt_pdf_image_t **images,
                                const int n_images);
@@ -0,0 +1,294 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/phash.h"
+#include "common/database.h"
+#include "common/collection.h"
+#include "common/debug.h"
+#include "common/mipmap_cache.h"
+#include "control/jobs.h"
+
+// the hash compares the brightness of neighbouring cells of a 9x8 grid
+#define PHASH_COLS 9
+#define PHASH_ROWS 8
+
+uint64_t dt_phash_compute(const uint8_t *buf,
+                          const int width,
+                          const int height)
+{
+  if(!buf || width < PHASH_COLS || height < PHASH_ROWS) return 0;
+
+  // mean brightness of the cells. r and b weigh the same, so it doesn't
+  // matter whether the buffer is rgba or bgra
+  float cell[PHASH_ROWS][PHASH_COLS];
+  for(int cy = 0; cy < PHASH_ROWS; cy++)
+  {
+    const int y0 = cy * height / PHASH_ROWS;
+    const int y1 = (cy + 1) * height / PHASH_ROWS;
+    for(int cx = 0; cx < PHASH_COLS; cx++)
+    {
+      const int x0 = cx * width / PHASH_COLS;
+      const int x1 = (cx + 1) * width / PHASH_COLS;
+      uint64_t sum = 0;
+      for(int y = y0; y < y1; y++)
+      {
+        const uint8_t *row = buf + (size_t)4 * ((size_t)y * width + x0);
+        for(int x = x0; x < x1; x++, row += 4)
+          sum += row[0] + 2 * row[1] + row[2];
+      }
+      cell[cy][cx] = (float)sum / ((x1 - x0) * (y1 - y0));
+    }
+  }
+
+  uint64_t hash = 0;
+  for(int cy = 0; cy < PHASH_ROWS; cy++)
+    for(int cx = 0; cx < PHASH_COLS - 1; cx++)
+      hash = (hash << 1) | (cell[cy][cx] < cell[cy][cx + 1]);
+  return hash;
+}
+
+void dt_phash_image_set(const dt_imgid_t imgid,
+                        const uint8_t *buf,
+                        const int width,
+                        const int height)
+{
+  if(!dt_is_valid_imgid(imgid)) return;
+
+  const uint64_t hash = dt_phash_compute(buf, width, height);
+  // flat images say nothing about their content
+  if(hash == 0 || hash == UINT64_MAX) return;
+
+  // the first thumbnail is made at import time, before any edit, and stays
+  // the reference of the image
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR IGNORE INTO main.image_phash (imgid, phash)"
+                              " VALUES (?1, ?2)",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 2, (sqlite3_int64)hash);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+// bk-tree over the hashes: the children of a node are linked in a list, each
+// one at a different distance from it. all hashes within d of a query
+// are found below the children at a distance in [dist - d, dist + d].
+typedef struct _bk_node_t
+{
+  uint64_t hash;
+  int distance;    // to the parent
+  int first_child;
+  int next;        // sibling
+} _bk_node_t;
+
+static void _bk_insert(_bk_node_t *nodes,
+                       const int n)
+{
+  int cur = 0;
+  while(TRUE)
+  {
+    const int d = dt_phash_distance(nodes[cur].hash, nodes[n].hash);
+    int child = nodes[cur].first_child;
+    while(child >= 0 && nodes[child].distance != d)
+      child = nodes[child].next;
+    if(child < 0)
+    {
+      nodes[n].distance = d;
+      nodes[n].next = nodes[cur].first_child;
+      nodes[cur].first_child = n;
+      return;
+    }
+    cur = child;
+  }
+}
+
+static int _group_find(int *parent,
+                       int k)
+{
+  while(parent[k] != k)
+  {
+    parent[k] = parent[parent[k]];
+    k = parent[k];
+  }
+  return k;
+}
+
+static void _group_union(int *parent,
+                         const int a,
+                         const int b)
+{
+  const int ra = _group_find(parent, a);
+  const int rb = _group_find(parent, b);
+  // the root is the earliest image, which is the lower id
+  if(ra < rb) parent[rb] = ra;
+  else if(rb < ra) parent[ra] = rb;
+}
+
+void dt_phash_update_near_duplicates(const int max_distance)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+
+  // the collection query is built over and over, only look again once
+  // hashes were added or removed
+  static int last_distance = -1;
+  static int last_count = -1;
+  static double last_sum = 0.0;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT COUNT(*), TOTAL(phash) FROM main.image_phash",
+                              -1, &stmt, NULL);
+  int hashes = 0;
+  double sum = 0.0;
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    hashes = sqlite3_column_int(stmt, 0);
+    sum = sqlite3_column_double(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+  if(max_distance == last_distance && hashes == last_count && sum == last_sum) return;
+  last_distance = max_distance;
+  last_count = hashes;
+  last_sum = sum;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  GArray *ids = g_array_new(FALSE, FALSE, sizeof(dt_imgid_t));
+  GArray *tree = g_array_new(FALSE, FALSE, sizeof(_bk_node_t));
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT imgid, phash FROM main.image_phash ORDER BY imgid",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+    const _bk_node_t node = { .hash = (uint64_t)sqlite3_column_int64(stmt, 1),
+                              .first_child = -1, .next = -1 };
+    g_array_append_val(ids, imgid);
+    g_array_append_val(tree, node);
+  }
+  sqlite3_finalize(stmt);
+
+  const int count = ids->len;
+  _bk_node_t *nodes = (_bk_node_t *)tree->data;
+  for(int k = 1; k < count; k++) _bk_insert(nodes, k);
+
+  int *parent = g_malloc_n(MAX(count, 1), sizeof(int));
+  for(int k = 0; k < count; k++) parent[k] = k;
+
+  // look up the neighbours of every image, the tree is walked with an
+  // explicit stack of the nodes still to visit
+  int *stack = g_malloc_n(MAX(count, 1), sizeof(int));
+  for(int k = 1; k < count; k++)
+  {
+    int top = 0;
+    stack[top++] = 0;
+    while(top > 0)
+    {
+      const int cur = stack[--top];
+      const int d = dt_phash_distance(nodes[cur].hash, nodes[k].hash);
+      if(d <= max_distance && cur != k) _group_union(parent, k, cur);
+      for(int child = nodes[cur].first_child; child >= 0; child = nodes[child].next)
+        if(abs(nodes[child].distance - d) <= max_distance)
+          stack[top++] = child;
+    }
+  }
+  g_free(stack);
+
+  // the roots of the groups with more than one image
+  int *size = g_malloc0_n(MAX(count, 1), sizeof(int));
+  for(int k = 0; k < count; k++) size[_group_find(parent, k)]++;
+
+  dt_database_start_transaction(darktable.db);
+  sqlite3_exec(db, "DELETE FROM memory.near_duplicates", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO memory.near_duplicates (imgid, grp) VALUES (?1, ?2)",
+                              -1, &stmt, NULL);
+  int found = 0;
+  for(int k = 0; k < count; k++)
+  {
+    const int root = _group_find(parent, k);
+    if(size[root] < 2) continue;
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, g_array_index(ids, dt_imgid_t, k));
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, g_array_index(ids, dt_imgid_t, root));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    found++;
+  }
+  sqlite3_finalize(stmt);
+  dt_database_release_transaction(darktable.db);
+
+  g_free(size);
+  g_free(parent);
+  g_array_free(tree, TRUE);
+  g_array_free(ids, TRUE);
+
+  dt_show_times_f(&start, "[phash]", "%d near duplicates among %d images", found, count);
+}
+
+static int32_t _phash_fill_job_run(dt_job_t *job)
+{
+  GArray *missing = g_array_new(FALSE, FALSE, sizeof(dt_imgid_t));
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT id FROM main.images"
+                              " WHERE id NOT IN (SELECT imgid FROM main.image_phash)",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+    g_array_append_val(missing, imgid);
+  }
+  sqlite3_finalize(stmt);
+
+  // images generating their thumbnail just now get their hash from the
+  // mipmap cache already, the others are hashed from the cached one
+  for(guint k = 0; k < missing->len; k++)
+  {
+    if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED) break;
+    const dt_imgid_t imgid = g_array_index(missing, dt_imgid_t, k);
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(&buf, imgid, DT_MIPMAP_0, DT_MIPMAP_BLOCKING, 'r');
+    if(buf.buf && buf.width > 0 && buf.height > 0)
+      dt_phash_image_set(imgid, buf.buf, buf.width, buf.height);
+    dt_mipmap_cache_release(&buf);
+    dt_control_job_set_progress(job, (double)(k + 1) / missing->len);
+  }
+
+  if(missing->len)
+    dt_collection_update_query(darktable.collection,
+                               DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_DUPLICATES, NULL);
+  g_array_free(missing, TRUE);
+  return 0;
+}
+
+void dt_phash_fill_missing(void)
+{
+  static gboolean started = FALSE;
+  if(started) return;
+  started = TRUE;
+
+  dt_job_t *job = dt_control_job_create(&_phash_fill_job_run, "compute perceptual hashes");
+  if(!job) return;
+  dt_control_job_add_progress(job, _("looking for near duplicates"), TRUE);
+  dt_control_add_job(DT_JOB_QUEUE_USER_BG, job);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,57 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+/*
+ * perceptual hashes of the thumbnails, to find copies of an image which
+ * are byte-identical or were re-encoded, resized or slightly cropped.
+ * the hash of an image is stored with its first thumbnail, images with a
+ * hash within a few bits of another one are near duplicates.
+ */
+
+/** difference hash of a 4 channel 8 bit buffer */
+uint64_t dt_phash_compute(const uint8_t *buf, const int width, const int height);
+
+/** number of different bits of two hashes */
+static inline int dt_phash_distance(const uint64_t a, const uint64_t b)
+{
+  return __builtin_popcountll(a ^ b);
+}
+
+/** store the hash of the thumbnail buf of imgid, unless it has one already */
+void dt_phash_image_set(const dt_imgid_t imgid,
+                        const uint8_t *buf,
+                        const int width,
+                        const int height);
+
+/** fill memory.near_duplicates with the images having at least one other
+ *  image within max_distance bits, grp is the smallest id of their group */
+void dt_phash_update_near_duplicates(const int max_distance);
+
+/** hash the images of the library without a hash in the background, once
+ *  per session, for libraries with thumbnails made before */
+void dt_phash_fill_missing(void);
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
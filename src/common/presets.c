@@ -32,7 +32,9 @@
 #include <libxml/xpathInternals.h>
 
 #include <glib.h>
+#include <float.h>
 #include <inttypes.h>
+#include <math.h>
 #include <sqlite3.h>
 
 static char *_preset_encode(sqlite3_stmt *stmt,
@@ -482,6 +484,510 @@ char *dt_presets_get_multi_name(const char *name,
     return g_strdup(strlen(multi_name) > 0 ? multi_name : "");
 }
 
+// in-memory copy of the auto-applied presets, so that matching them
+// against an image doesn't go through data.presets with a dozen LIKE and
+// BETWEEN per row. the presets are read once and bucketed by maker, a
+// change of data.presets or a rollback drops the copy.
+
+typedef struct _auto_preset_t
+{
+  int pos;                  // rowid order in data.presets
+  gchar *operation;
+  gchar *model;
+  gchar *maker;
+  gchar *lens;
+  double iso_min, iso_max;  // NAN when NULL, nothing is BETWEEN NULLs
+  double exposure_min, exposure_max;
+  double aperture_min, aperture_max;
+  double focal_length_min, focal_length_max;
+  gboolean has_format;
+  int format;
+  gboolean writeprotect;
+  sqlite3_value *name;
+  sqlite3_value *op_version;
+  sqlite3_value *op_params;
+  sqlite3_value *enabled;
+  sqlite3_value *blendop_params;
+  sqlite3_value *blendop_version;
+  sqlite3_value *multi_name;
+  sqlite3_value *multi_name_hand_edited;
+} _auto_preset_t;
+
+static struct
+{
+  GMutex lock;
+  gboolean ready;         // the triggers are in place
+  gboolean valid;
+  GPtrArray *presets;     // _auto_preset_t in rowid order
+  GHashTable *by_maker;   // folded literal maker -> GPtrArray of _auto_preset_t
+  GPtrArray *any_maker;   // presets with a wildcard maker
+} _auto_presets;
+
+static void _auto_preset_free(gpointer data)
+{
+  _auto_preset_t *p = data;
+  g_free(p->operation);
+  g_free(p->model);
+  g_free(p->maker);
+  g_free(p->lens);
+  sqlite3_value_free(p->name);
+  sqlite3_value_free(p->op_version);
+  sqlite3_value_free(p->op_params);
+  sqlite3_value_free(p->enabled);
+  sqlite3_value_free(p->blendop_params);
+  sqlite3_value_free(p->blendop_version);
+  sqlite3_value_free(p->multi_name);
+  sqlite3_value_free(p->multi_name_hand_edited);
+  g_free(p);
+}
+
+// the case folding of LIKE: unicode with the ICU extension, ASCII otherwise
+static inline gunichar _like_fold(const gunichar c)
+{
+#ifdef HAVE_ICU
+  return g_unichar_tolower(c);
+#else
+  return c < 0x80 ? g_ascii_tolower(c) : c;
+#endif
+}
+
+static gchar *_like_fold_string(const char *s)
+{
+  GString *folded = g_string_sized_new(strlen(s));
+  for(const char *c = s; *c; c = g_utf8_next_char(c))
+    g_string_append_unichar(folded, _like_fold(g_utf8_get_char(c)));
+  return g_string_free(folded, FALSE);
+}
+
+// str LIKE pattern, without ESCAPE. a NULL on either side doesn't match.
+static gboolean _like(const char *str,
+                      const char *pattern)
+{
+  if(!str || !pattern) return FALSE;
+
+  const char *star = NULL;  // pattern just after the last %
+  const char *retry = NULL; // where the string is resumed on a mismatch
+  while(*str)
+  {
+    if(*pattern == '%')
+    {
+      while(*pattern == '%') pattern++;
+      if(!*pattern) return TRUE;
+      star = pattern;
+      retry = str;
+    }
+    else if(*pattern
+            && (*pattern == '_'
+                || _like_fold(g_utf8_get_char(pattern)) == _like_fold(g_utf8_get_char(str))))
+    {
+      pattern = g_utf8_next_char(pattern);
+      str = g_utf8_next_char(str);
+    }
+    else if(star)
+    {
+      pattern = star;
+      str = retry = g_utf8_next_char(retry);
+    }
+    else
+      return FALSE;
+  }
+  while(*pattern == '%') pattern++;
+  return !*pattern;
+}
+
+static inline gboolean _between(const double v,
+                                const double min,
+                                const double max)
+{
+  return v >= min && v <= max;
+}
+
+static void _auto_presets_sql_changed(sqlite3_context *context,
+                                      int argc,
+                                      sqlite3_value **argv)
+{
+  g_mutex_lock(&_auto_presets.lock);
+  _auto_presets.valid = FALSE;
+  g_mutex_unlock(&_auto_presets.lock);
+  sqlite3_result_null(context);
+}
+
+static void _auto_presets_rollback(gpointer data)
+{
+  g_mutex_lock(&_auto_presets.lock);
+  _auto_presets.valid = FALSE;
+  g_mutex_unlock(&_auto_presets.lock);
+}
+
+static const char *_auto_presets_triggers[] =
+{
+  "CREATE TEMP TRIGGER auto_presets_insert AFTER INSERT ON data.presets"
+  " BEGIN SELECT dt_auto_presets_changed(); END",
+  "CREATE TEMP TRIGGER auto_presets_delete AFTER DELETE ON data.presets"
+  " BEGIN SELECT dt_auto_presets_changed(); END",
+  "CREATE TEMP TRIGGER auto_presets_update AFTER UPDATE ON data.presets"
+  " BEGIN SELECT dt_auto_presets_changed(); END",
+};
+
+static double _column_double(sqlite3_stmt *stmt,
+                             const int col)
+{
+  return sqlite3_column_type(stmt, col) == SQLITE_NULL
+    ? NAN
+    : sqlite3_column_double(stmt, col);
+}
+
+static gchar *_column_strdup(sqlite3_stmt *stmt,
+                             const int col)
+{
+  return g_strdup((const char *)sqlite3_column_text(stmt, col));
+}
+
+static void _auto_presets_load(sqlite3 *db)
+{
+  g_ptr_array_set_size(_auto_presets.presets, 0);
+  g_ptr_array_set_size(_auto_presets.any_maker, 0);
+  g_hash_table_remove_all(_auto_presets.by_maker);
+
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (db,
+     "SELECT operation, model, maker, lens,"
+     "       iso_min, iso_max, exposure_min, exposure_max,"
+     "       aperture_min, aperture_max, focal_length_min, focal_length_max,"
+     "       format, writeprotect, name, op_version, op_params, enabled,"
+     "       blendop_params, blendop_version, multi_name, multi_name_hand_edited"
+     " FROM data.presets"
+     " WHERE autoapply = 1"
+     " ORDER BY rowid",
+     -1, &stmt, NULL);
+  // clang-format on
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    _auto_preset_t *p = g_malloc0(sizeof(_auto_preset_t));
+    p->pos = _auto_presets.presets->len;
+    p->operation = _column_strdup(stmt, 0);
+    p->model = _column_strdup(stmt, 1);
+    p->maker = _column_strdup(stmt, 2);
+    p->lens = _column_strdup(stmt, 3);
+    p->iso_min = _column_double(stmt, 4);
+    p->iso_max = _column_double(stmt, 5);
+    p->exposure_min = _column_double(stmt, 6);
+    p->exposure_max = _column_double(stmt, 7);
+    p->aperture_min = _column_double(stmt, 8);
+    p->aperture_max = _column_double(stmt, 9);
+    p->focal_length_min = _column_double(stmt, 10);
+    p->focal_length_max = _column_double(stmt, 11);
+    p->has_format = sqlite3_column_type(stmt, 12) != SQLITE_NULL;
+    p->format = sqlite3_column_int(stmt, 12);
+    p->writeprotect = sqlite3_column_int(stmt, 13);
+    p->name = sqlite3_value_dup(sqlite3_column_value(stmt, 14));
+    p->op_version = sqlite3_value_dup(sqlite3_column_value(stmt, 15));
+    p->op_params = sqlite3_value_dup(sqlite3_column_value(stmt, 16));
+    p->enabled = sqlite3_value_dup(sqlite3_column_value(stmt, 17));
+    p->blendop_params = sqlite3_value_dup(sqlite3_column_value(stmt, 18));
+    p->blendop_version = sqlite3_value_dup(sqlite3_column_value(stmt, 19));
+    p->multi_name = sqlite3_value_dup(sqlite3_column_value(stmt, 20));
+    p->multi_name_hand_edited = sqlite3_value_dup(sqlite3_column_value(stmt, 21));
+    g_ptr_array_add(_auto_presets.presets, p);
+
+    if(!p->maker || strpbrk(p->maker, "%_"))
+    {
+      // a NULL maker never matches, leave it out of the buckets
+      if(p->maker) g_ptr_array_add(_auto_presets.any_maker, p);
+      continue;
+    }
+    gchar *key = _like_fold_string(p->maker);
+    GPtrArray *bucket = g_hash_table_lookup(_auto_presets.by_maker, key);
+    if(!bucket)
+    {
+      bucket = g_ptr_array_new();
+      g_hash_table_insert(_auto_presets.by_maker, key, bucket);
+    }
+    else
+      g_free(key);
+    g_ptr_array_add(bucket, p);
+  }
+  sqlite3_finalize(stmt);
+  _auto_presets.valid = TRUE;
+}
+
+// lock the copy, up to date. the connection mutex is taken first, as the
+// triggers run with it held.
+static void _auto_presets_lock(void)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_mutex_enter(sqlite3_db_mutex(db));
+  g_mutex_lock(&_auto_presets.lock);
+
+  if(!_auto_presets.presets)
+  {
+    _auto_presets.presets = g_ptr_array_new_with_free_func(_auto_preset_free);
+    _auto_presets.any_maker = g_ptr_array_new();
+    _auto_presets.by_maker = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                   (GDestroyNotify)g_ptr_array_unref);
+
+    gboolean ok = sqlite3_create_function(db, "dt_auto_presets_changed", 0, SQLITE_UTF8,
+                                          NULL, _auto_presets_sql_changed,
+                                          NULL, NULL) == SQLITE_OK;
+    for(size_t k = 0; ok && k < G_N_ELEMENTS(_auto_presets_triggers); k++)
+      ok = sqlite3_exec(db, _auto_presets_triggers[k], NULL, NULL, NULL) == SQLITE_OK;
+    if(ok)
+    {
+      dt_database_connect_rollback(darktable.db, _auto_presets_rollback, NULL);
+      _auto_presets.ready = TRUE;
+    }
+    else
+      dt_print(DT_DEBUG_ALWAYS,
+               "[presets] could not watch the presets, they are read for each image: %s",
+               sqlite3_errmsg(db));
+  }
+
+  if(!_auto_presets.valid || !_auto_presets.ready)
+  {
+    dt_times_t start;
+    dt_get_perf_times(&start);
+    _auto_presets_load(db);
+    dt_show_times_f(&start, "[presets]", "load %u auto-applied presets, %u makers",
+                    _auto_presets.presets->len,
+                    g_hash_table_size(_auto_presets.by_maker));
+  }
+}
+
+static void _auto_presets_unlock(void)
+{
+  g_mutex_unlock(&_auto_presets.lock);
+  sqlite3_mutex_leave(sqlite3_db_mutex(dt_database_get(darktable.db)));
+}
+
+static gint _auto_preset_cmp_pos(gconstpointer a, gconstpointer b)
+{
+  const _auto_preset_t *pa = *(const _auto_preset_t **)a;
+  const _auto_preset_t *pb = *(const _auto_preset_t **)b;
+  return pa->pos - pb->pos;
+}
+
+static void _add_bucket(GPtrArray *candidates,
+                        const char *maker)
+{
+  gchar *key = _like_fold_string(maker);
+  GPtrArray *bucket = g_hash_table_lookup(_auto_presets.by_maker, key);
+  g_free(key);
+  if(bucket)
+    for(guint i = 0; i < bucket->len; i++)
+      g_ptr_array_add(candidates, g_ptr_array_index(bucket, i));
+}
+
+// the auto-applied presets matching image, in rowid order. copy locked.
+// same conditions as the camera, lens, exposure and format filter of the
+// presets dialog.
+static GPtrArray *_auto_presets_match(const dt_image_t *image,
+                                      const int iformat,
+                                      const int excluded)
+{
+  GPtrArray *candidates = g_ptr_array_new();
+  for(guint i = 0; i < _auto_presets.any_maker->len; i++)
+    g_ptr_array_add(candidates, g_ptr_array_index(_auto_presets.any_maker, i));
+  _add_bucket(candidates, image->exif_maker);
+  _add_bucket(candidates, image->camera_maker);
+  g_ptr_array_sort(candidates, _auto_preset_cmp_pos);
+
+  const double iso = fmaxf(0.0f, fminf(FLT_MAX, image->exif_iso));
+  const double exposure = fmaxf(0.0f, fminf(1000000, image->exif_exposure));
+  const double aperture = fmaxf(0.0f, fminf(1000000, image->exif_aperture));
+  const double focal_length = fmaxf(0.0f, fminf(1000000, image->exif_focal_length));
+
+  GPtrArray *matches = g_ptr_array_new();
+  const _auto_preset_t *prev = NULL;
+  for(guint i = 0; i < candidates->len; i++)
+  {
+    const _auto_preset_t *p = g_ptr_array_index(candidates, i);
+    // both makers can be in the same bucket
+    if(p == prev) continue;
+    prev = p;
+
+    if(((_like(image->exif_model, p->model) && _like(image->exif_maker, p->maker))
+        || (_like(image->camera_alias, p->model) && _like(image->camera_maker, p->maker)))
+       && _like(image->exif_lens, p->lens)
+       && _between(iso, p->iso_min, p->iso_max)
+       && _between(exposure, p->exposure_min, p->exposure_max)
+       && _between(aperture, p->aperture_min, p->aperture_max)
+       && _between(focal_length, p->focal_length_min, p->focal_length_max)
+       && p->has_format
+       && (p->format == 0
+           || ((p->format & iformat) != 0 && (~p->format & excluded) != 0)))
+      g_ptr_array_add(matches, (gpointer)p);
+  }
+  g_ptr_array_free(candidates, TRUE);
+  return matches;
+}
+
+typedef struct _auto_instance_t
+{
+  const _auto_preset_t *preset;
+  int priority;
+} _auto_instance_t;
+
+// ORDER BY writeprotect DESC, LENGTH(model), LENGTH(maker), LENGTH(lens)
+static int _auto_preset_cmp_apply(const _auto_preset_t *a,
+                                  const _auto_preset_t *b)
+{
+  if(a->writeprotect != b->writeprotect) return b->writeprotect - a->writeprotect;
+  const glong model = g_utf8_strlen(a->model, -1) - g_utf8_strlen(b->model, -1);
+  if(model) return model < 0 ? -1 : 1;
+  const glong maker = g_utf8_strlen(a->maker, -1) - g_utf8_strlen(b->maker, -1);
+  if(maker) return maker < 0 ? -1 : 1;
+  const glong lens = g_utf8_strlen(a->lens, -1) - g_utf8_strlen(b->lens, -1);
+  if(lens) return lens < 0 ? -1 : 1;
+  return a->pos - b->pos;
+}
+
+static gint _auto_instance_cmp(gconstpointer a, gconstpointer b)
+{
+  return _auto_preset_cmp_apply(((const _auto_instance_t *)a)->preset,
+                                ((const _auto_instance_t *)b)->preset);
+}
+
+static gboolean _auto_preset_skipped(const char *operation,
+                                     const char *skip)
+{
+  // not iop modules
+  static const char *not_iop[] =
+    { "ioporder", "metadata", "modulegroups", "export", "tagging", "collect" };
+  for(size_t k = 0; k < G_N_ELEMENTS(not_iop); k++)
+    if(!g_strcmp0(operation, not_iop[k])) return TRUE;
+  return skip && !g_strcmp0(operation, skip);
+}
+
+void dt_presets_auto_apply(const dt_image_t *image,
+                           const int iformat,
+                           const int excluded,
+                           const char *skip)
+{
+  const gboolean auto_module = dt_conf_get_bool("darkroom/ui/auto_module_name_update");
+
+  _auto_presets_lock();
+  GPtrArray *matches = _auto_presets_match(image, iformat, excluded);
+
+  // the user's presets replace the hard-coded ones (for the workflow) of
+  // the same module
+  GHashTable *user_ops = g_hash_table_new(g_str_hash, g_str_equal);
+  for(guint i = 0; i < matches->len; i++)
+  {
+    const _auto_preset_t *p = g_ptr_array_index(matches, i);
+    if(!p->writeprotect && p->operation) g_hash_table_add(user_ops, p->operation);
+  }
+
+  // the instances of a module are numbered in rowid order
+  GHashTable *count = g_hash_table_new(g_str_hash, g_str_equal);
+  GArray *instances = g_array_sized_new(FALSE, FALSE, sizeof(_auto_instance_t), matches->len);
+  for(guint i = 0; i < matches->len; i++)
+  {
+    const _auto_preset_t *p = g_ptr_array_index(matches, i);
+    if(!p->operation
+       || _auto_preset_skipped(p->operation, skip)
+       || (p->writeprotect && g_hash_table_contains(user_ops, p->operation)))
+      continue;
+
+    const int priority = GPOINTER_TO_INT(g_hash_table_lookup(count, p->operation));
+    g_hash_table_insert(count, p->operation, GINT_TO_POINTER(priority + 1));
+    const _auto_instance_t instance = { .preset = p, .priority = priority };
+    g_array_append_val(instances, instance);
+  }
+  g_array_sort(instances, _auto_instance_cmp);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "INSERT OR REPLACE INTO memory.history"
+     " VALUES (?1, 0, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)",
+     -1, &stmt, NULL);
+  for(guint i = 0; i < instances->len; i++)
+  {
+    const _auto_instance_t *instance = &g_array_index(instances, _auto_instance_t, i);
+    const _auto_preset_t *p = instance->preset;
+    const int priority = instance->priority;
+
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, image->id);
+    sqlite3_bind_value(stmt, 2, p->op_version);
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, p->operation, -1, SQLITE_STATIC);
+    sqlite3_bind_value(stmt, 4, p->op_params);
+    sqlite3_bind_value(stmt, 5, p->enabled);
+    sqlite3_bind_value(stmt, 6, p->blendop_params);
+    sqlite3_bind_value(stmt, 7, p->blendop_version);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 8, priority);
+    // auto module:
+    //  ON  : we take as the preset label either the multi-name
+    //        if defined or the preset name.
+    //  OFF : we take the multi-name only if hand-edited otherwise a
+    //        simple incremental instance number (equivalent to the multi_priority
+    //        field is used).
+    const char *multi_name = (const char *)sqlite3_value_text(p->multi_name);
+    const char *name = (const char *)sqlite3_value_text(p->name);
+    if(auto_module)
+    {
+      if(multi_name && *multi_name)
+        sqlite3_bind_value(stmt, 9, p->multi_name);
+      else if(name && *name)
+        sqlite3_bind_value(stmt, 9, p->name);
+      else
+        sqlite3_bind_null(stmt, 9);
+    }
+    else if(sqlite3_value_int(p->multi_name_hand_edited))
+      sqlite3_bind_value(stmt, 9, p->multi_name);
+    else
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 9, priority);
+    sqlite3_bind_value(stmt, 10, p->multi_name_hand_edited);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  _auto_presets_unlock();
+
+  g_array_free(instances, TRUE);
+  g_hash_table_destroy(count);
+  g_hash_table_destroy(user_ops);
+  g_ptr_array_free(matches, TRUE);
+}
+
+gboolean dt_presets_get_auto_iop_order(const dt_image_t *image,
+                                       const int iformat,
+                                       const int excluded,
+                                       void **params,
+                                       int32_t *len)
+{
+  _auto_presets_lock();
+  GPtrArray *matches = _auto_presets_match(image, iformat, excluded);
+
+  // the user's presets are used first instead of the darktable internal
+  // ones: writeprotect ASC, LENGTH(model), LENGTH(maker), LENGTH(lens)
+  const _auto_preset_t *best = NULL;
+  for(guint i = 0; i < matches->len; i++)
+  {
+    const _auto_preset_t *p = g_ptr_array_index(matches, i);
+    if(g_strcmp0(p->operation, "ioporder")) continue;
+    if(!best
+       || (p->writeprotect != best->writeprotect
+           ? p->writeprotect < best->writeprotect
+           : _auto_preset_cmp_apply(p, best) < 0))
+      best = p;
+  }
+
+  *params = NULL;
+  *len = 0;
+  if(best)
+  {
+    *len = sqlite3_value_bytes(best->op_params);
+    *params = g_malloc(*len);
+    memcpy(*params, sqlite3_value_blob(best->op_params), *len);
+  }
+  _auto_presets_unlock();
+
+  g_ptr_array_free(matches, TRUE);
+  return best != NULL;
+}
+
 static void _menu_shell_insert_sorted(GtkWidget *menu_shell,
                                       GtkWidget *item,
                                       const gchar *name)
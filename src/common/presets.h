@@ -35,6 +35,22 @@ gboolean dt_presets_module_can_autoapply(const gchar *operation);
 /** get the preset filters */
 char *dt_presets_get_filter(const dt_image_t *image);
 
+/** insert into memory.history the auto-applied presets matching image,
+    iformat and excluded are the FOR_* flags of the image. the presets of
+    the non iop modules and of the skip module are left out. */
+void dt_presets_auto_apply(const dt_image_t *image,
+                           const int iformat,
+                           const int excluded,
+                           const char *skip);
+
+/** the params of the auto-applied iop-order preset matching image,
+    FALSE if there is none. params are to be freed. */
+gboolean dt_presets_get_auto_iop_order(const dt_image_t *image,
+                                       const int iformat,
+                                       const int excluded,
+                                       void **params,
+                                       int32_t *len);
+
 /** get preset multi_name for given module params */
 char *dt_presets_get_module_label(const char *module_name,
                                   const void *params,
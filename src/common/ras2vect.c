@@ -16,6 +16,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <math.h>
 #include <stddef.h>
 #include <potracelib.h>
 
@@ -135,6 +136,212 @@ static void _add_point(dt_masks_form_t *form,
 
 static gint formnb = 0;
 
+// masks beyond this are traced at a lower resolution, the contours of
+// an AI segmentation have no detail at the pixel level anyway
+#define RAS2VECT_MAX_PIXELS (4 * 1024 * 1024)
+
+// a group of 8-connected pixels of the bitmap, traced on its own
+typedef struct _ras2vect_component_t
+{
+  int x0, y0, x1, y1; // bounding box, inclusive
+  potrace_state_t *st;
+} _ras2vect_component_t;
+
+static inline int _uf_find(int *parent,
+                           int k)
+{
+  while(parent[k] != k)
+  {
+    parent[k] = parent[parent[k]];
+    k = parent[k];
+  }
+  return k;
+}
+
+static inline void _uf_union(int *parent,
+                             const int a,
+                             const int b)
+{
+  const int ra = _uf_find(parent, a);
+  const int rb = _uf_find(parent, b);
+  if(ra < rb) parent[rb] = ra;
+  else if(rb < ra) parent[ra] = rb;
+}
+
+// label the connected groups of set pixels, in the order potrace finds
+// them (from the last row down, left to right), so that the forms come
+// out in the same order as with a single trace of the whole bitmap
+static GArray *_find_components(const potrace_bitmap_t *bm,
+                                int *label)
+{
+  const int w = bm->w;
+  const int h = bm->h;
+  for(int y = 0; y < h; y++)
+    for(int x = 0; x < w; x++)
+    {
+      const int k = x + y * w;
+      if(!(*bm_index(bm, x, y) & bm_mask(x)))
+      {
+        label[k] = -1;
+        continue;
+      }
+      label[k] = k;
+      if(x > 0 && label[k - 1] >= 0) _uf_union(label, k, k - 1);
+      if(y > 0)
+        for(int dx = -1; dx <= 1; dx++)
+          if(x + dx >= 0 && x + dx < w && label[k - w + dx] >= 0)
+            _uf_union(label, k, k - w + dx);
+    }
+
+  GArray *components = g_array_new(FALSE, FALSE, sizeof(_ras2vect_component_t));
+  GHashTable *index = g_hash_table_new(NULL, NULL);
+  for(int y = h - 1; y >= 0; y--)
+    for(int x = 0; x < w; x++)
+    {
+      const int k = x + y * w;
+      if(label[k] < 0) continue;
+      const int root = _uf_find(label, k);
+      gpointer found = NULL;
+      int c;
+      if(g_hash_table_lookup_extended(index, GINT_TO_POINTER(root), NULL, &found))
+        c = GPOINTER_TO_INT(found);
+      else
+      {
+        const _ras2vect_component_t comp = { x, y, x, y, NULL };
+        c = components->len;
+        g_array_append_val(components, comp);
+        g_hash_table_insert(index, GINT_TO_POINTER(root), GINT_TO_POINTER(c));
+      }
+      _ras2vect_component_t *comp = &g_array_index(components, _ras2vect_component_t, c);
+      comp->x0 = MIN(comp->x0, x);
+      comp->x1 = MAX(comp->x1, x);
+      comp->y0 = MIN(comp->y0, y);
+      comp->y1 = MAX(comp->y1, y);
+    }
+
+  // from now on a pixel is labelled with its component
+  for(int k = 0; k < w * h; k++)
+    if(label[k] >= 0)
+      label[k] = GPOINTER_TO_INT(g_hash_table_lookup(index, GINT_TO_POINTER(_uf_find(label, k))));
+
+  g_hash_table_destroy(index);
+  return components;
+}
+
+static void _trace_component(_ras2vect_component_t *comp,
+                             const int c,
+                             const int *label,
+                             const int w,
+                             const potrace_param_t *param)
+{
+  const int bw = comp->x1 - comp->x0 + 1;
+  const int bh = comp->y1 - comp->y0 + 1;
+  // nothing left once the speckles are removed
+  if((size_t)bw * bh <= (size_t)param->turdsize) return;
+
+  potrace_bitmap_t *bm = _bm_new(bw, bh);
+  if(!bm) return;
+  for(int y = 0; y < bh; y++)
+  {
+    const int *row = label + (size_t)(y + comp->y0) * w + comp->x0;
+    for(int x = 0; x < bw; x++)
+      if(row[x] == c) BM_USET(bm, x, y);
+  }
+  comp->st = potrace_trace(param, bm);
+  _bm_free(bm);
+}
+
+static void _curve_to_form(const potrace_curve_t *cv,
+                           const _ras2vect_component_t *comp,
+                           const float scale,
+                           dt_masks_form_t *form,
+                           const dt_image_t *const image,
+                           const int width,
+                           const int height)
+{
+  const int n = cv->n;
+
+  // back from the traced bitmap of the component to the mask
+#define MASK_POINT(p) \
+  (potrace_dpoint_t){ ((p).x + comp->x0) * scale, ((p).y + comp->y0) * scale }
+
+  // Start = end of last segment
+  const potrace_dpoint_t start = MASK_POINT(cv->c[n-1][2]);
+
+  // Potrace outputs cubic Bezier segments where:
+  //   c[i][0] = outgoing ctrl of the segment's start point
+  //   c[i][1] = incoming ctrl of the segment's end point
+  //   c[i][2] = endpoint
+  // darktable stores per point: ctrl1 = incoming handle, ctrl2 = outgoing.
+  // We must split each segment's control pair across two adjacent points.
+
+  // precompute image scaling factors (used for handle coordinate transform)
+  const float xsc = image ? image->p_width / (float)width : 0.0f;
+  const float ysc = image ? image->p_height / (float)height : 0.0f;
+
+  // add all corner points with zero-length handles
+  _add_point(form, image, width, height, start.x, start.y, -1, -1, -1, -1);
+
+  for(int i = 0; i < n; i++)
+  {
+    if(cv->tag[i] == POTRACE_CURVETO)
+    {
+      const potrace_dpoint_t e = MASK_POINT(cv->c[i][2]);
+      _add_point(form, image, width, height, e.x, e.y, -1, -1, -1, -1);
+    }
+    else // POTRACE_CORNER
+    {
+      const potrace_dpoint_t v = MASK_POINT(cv->c[i][1]);
+      const potrace_dpoint_t e = MASK_POINT(cv->c[i][2]);
+
+      _add_point(form, image, width, height, v.x, v.y, -1, -1, -1, -1);
+      _add_point(form, image, width, height, e.x, e.y, -1, -1, -1, -1);
+    }
+  }
+
+  // assign Bezier handles: for each CURVETO segment, set
+  //   start_point.ctrl2 = c[i][0]  (outgoing)
+  //   end_point.ctrl1   = c[i][1]  (incoming)
+  // the path is closed, so the last segment wraps back to the start point
+  GList *pt = form->points;  // start point
+  for(int i = 0; i < n; i++)
+  {
+    if(cv->tag[i] == POTRACE_CURVETO)
+    {
+      const potrace_dpoint_t c0 = MASK_POINT(cv->c[i][0]);
+      const potrace_dpoint_t c1 = MASK_POINT(cv->c[i][1]);
+
+      // outgoing handle of current (start-of-segment) point
+      dt_masks_point_path_t *ps = pt->data;
+      ps->ctrl2[0] = c0.x;
+      ps->ctrl2[1] = c0.y;
+      if(image)
+        _scale_point(ps->ctrl2, xsc, ysc,
+                     image->crop_x, image->crop_y,
+                     image->width, image->height);
+
+      // advance to endpoint (wrap to start for the closing segment)
+      pt = g_list_next(pt);
+      if(!pt) pt = form->points;
+
+      // incoming handle of end-of-segment point
+      dt_masks_point_path_t *pe = pt->data;
+      pe->ctrl1[0] = c1.x;
+      pe->ctrl1[1] = c1.y;
+      if(image)
+        _scale_point(pe->ctrl1, xsc, ysc,
+                     image->crop_x, image->crop_y,
+                     image->width, image->height);
+    }
+    else // POTRACE_CORNER: two points added, no Bezier handles
+    {
+      pt = g_list_next(pt); if(!pt) pt = form->points;
+      pt = g_list_next(pt); if(!pt) pt = form->points;
+    }
+  }
+#undef MASK_POINT
+}
+
 GList *ras2forms(const float *mask,
                  const int width,
                  const int height,
@@ -147,17 +354,38 @@ GList *ras2forms(const float *mask,
   GList *forms = NULL;
   GList *signs = NULL;
 
+  // large masks are traced on a downscaled copy, the speckle size and
+  // the coordinates follow the scale
+  const double pixels = (double)width * height;
+  const int step = pixels > RAS2VECT_MAX_PIXELS
+    ? (int)ceil(sqrt(pixels / RAS2VECT_MAX_PIXELS)) : 1;
+  const int tw = (width + step - 1) / step;
+  const int th = (height + step - 1) / step;
+
   //  create bitmap mask for potrace
 
-  potrace_bitmap_t *bm = _bm_new(width, height);
+  potrace_bitmap_t *bm = _bm_new(tw, th);
+  int *label = bm ? g_try_malloc_n((size_t)tw * th, sizeof(int)) : NULL;
+  if(!label)
+  {
+    _bm_free(bm);
+    if(out_signs) *out_signs = NULL;
+    return NULL;
+  }
 
   DT_OMP_FOR()
-  for(int y=0; y < height; y++)
+  for(int y=0; y < th; y++)
   {
-    for(int x=0; x < width; x++)
+    for(int x=0; x < tw; x++)
     {
-      const int index = x + y * width;
-      if(mask[index] < threshold)
+      // mean of the mask over the cell of the traced pixel
+      const int x1 = MIN((x + 1) * step, width);
+      const int y1 = MIN((y + 1) * step, height);
+      float sum = 0.0f;
+      for(int j = y * step; j < y1; j++)
+        for(int i = x * step; i < x1; i++)
+          sum += mask[i + (size_t)j * width];
+      if(sum < threshold * (x1 - x * step) * (y1 - y * step))
       {
         // black enough to be a point of the form
         BM_USET(bm, x, y);
@@ -171,112 +399,53 @@ GList *ras2forms(const float *mask,
 
   potrace_param_t *param = potrace_param_default();
   // finer path possible
-  param->turdsize = turdsize > 0 ? turdsize : 50; // ignore area whose size are < 50
+  const int turd = turdsize > 0 ? turdsize : 50; // ignore area whose size are < 50
+  param->turdsize = (int)(turd / ((double)step * step) + 0.5);
   param->alphamax = alphamax;
   param->turnpolicy = POTRACE_TURNPOLICY_MINORITY;
   param->opticurve = 1;
   param->opttolerance = 0.8;
 
-  potrace_state_t *st = potrace_trace(param, bm);
-
-  //  get all paths, create corresponding path form
-
-  for(const potrace_path_t *p = st->plist;
-      p;
-      p = p->next)
-  {
-    const potrace_curve_t *cv = &p->curve;
-    const int n = cv->n;
-
-    // Start = end of last segment
-    const potrace_dpoint_t start = cv->c[n-1][2];
-
-    dt_masks_form_t *form = dt_masks_create(DT_MASKS_PATH);
-    snprintf(form->name, sizeof(form->name), "path raster %d",
-             g_atomic_int_add(&formnb, 1) + 1);
+  // the separate parts of the mask don't depend on each other, trace them
+  // in parallel
+  GArray *components = _find_components(bm, label);
+  _bm_free(bm);
+  _ras2vect_component_t *comps = (_ras2vect_component_t *)components->data;
+  const int ncomps = components->len;
 
-    // Potrace outputs cubic Bezier segments where:
-    //   c[i][0] = outgoing ctrl of the segment's start point
-    //   c[i][1] = incoming ctrl of the segment's end point
-    //   c[i][2] = endpoint
-    // darktable stores per point: ctrl1 = incoming handle, ctrl2 = outgoing.
-    // We must split each segment's control pair across two adjacent points.
+  DT_OMP_FOR(schedule(dynamic))
+  for(int c = 0; c < ncomps; c++)
+    _trace_component(&comps[c], c, label, tw, param);
 
-    // precompute image scaling factors (used for handle coordinate transform)
-    const float xsc = image ? image->p_width / (float)width : 0.0f;
-    const float ysc = image ? image->p_height / (float)height : 0.0f;
+  g_free(label);
 
-    // add all corner points with zero-length handles
-    _add_point(form, image, width, height, start.x, start.y, -1, -1, -1, -1);
+  //  get all paths, create corresponding path form
 
-    for(int i = 0; i < n; i++)
+  for(int c = 0; c < ncomps; c++)
+  {
+    if(!comps[c].st) continue;
+    for(const potrace_path_t *p = comps[c].st->plist;
+        p;
+        p = p->next)
     {
-      if(cv->tag[i] == POTRACE_CURVETO)
-      {
-        const potrace_dpoint_t e = cv->c[i][2];
-        _add_point(form, image, width, height, e.x, e.y, -1, -1, -1, -1);
-      }
-      else // POTRACE_CORNER
-      {
-        const potrace_dpoint_t v = cv->c[i][1];
-        const potrace_dpoint_t e = cv->c[i][2];
+      dt_masks_form_t *form = dt_masks_create(DT_MASKS_PATH);
+      snprintf(form->name, sizeof(form->name), "path raster %d",
+               g_atomic_int_add(&formnb, 1) + 1);
 
-        _add_point(form, image, width, height, v.x, v.y, -1, -1, -1, -1);
-        _add_point(form, image, width, height, e.x, e.y, -1, -1, -1, -1);
-      }
-    }
+      _curve_to_form(&p->curve, &comps[c], step, form, image, width, height);
 
-    // assign Bezier handles: for each CURVETO segment, set
-    //   start_point.ctrl2 = c[i][0]  (outgoing)
-    //   end_point.ctrl1   = c[i][1]  (incoming)
-    // the path is closed, so the last segment wraps back to the start point
-    {
-      GList *pt = form->points;  // start point
-      for(int i = 0; i < n; i++)
-      {
-        if(cv->tag[i] == POTRACE_CURVETO)
-        {
-          const potrace_dpoint_t c0 = cv->c[i][0];
-          const potrace_dpoint_t c1 = cv->c[i][1];
-
-          // outgoing handle of current (start-of-segment) point
-          dt_masks_point_path_t *ps = pt->data;
-          ps->ctrl2[0] = c0.x;
-          ps->ctrl2[1] = c0.y;
-          if(image)
-            _scale_point(ps->ctrl2, xsc, ysc,
-                         image->crop_x, image->crop_y,
-                         image->width, image->height);
-
-          // advance to endpoint (wrap to start for the closing segment)
-          pt = g_list_next(pt);
-          if(!pt) pt = form->points;
-
-          // incoming handle of end-of-segment point
-          dt_masks_point_path_t *pe = pt->data;
-          pe->ctrl1[0] = c1.x;
-          pe->ctrl1[1] = c1.y;
-          if(image)
-            _scale_point(pe->ctrl1, xsc, ysc,
-                         image->crop_x, image->crop_y,
-                         image->width, image->height);
-        }
-        else // POTRACE_CORNER: two points added, no Bezier handles
-        {
-          pt = g_list_next(pt); if(!pt) pt = form->points;
-          pt = g_list_next(pt); if(!pt) pt = form->points;
-        }
-      }
+      forms = g_list_prepend(forms, form);
+      if(out_signs)
+        signs = g_list_prepend(signs, GINT_TO_POINTER(p->sign));
     }
-
-    forms = g_list_prepend(forms, form);
-    if(out_signs)
-      signs = g_list_prepend(signs, GINT_TO_POINTER(p->sign));
+    potrace_state_free(comps[c].st);
   }
 
-  potrace_state_free(st);
+  g_array_free(components, TRUE);
   potrace_param_free(param);
-  _bm_free(bm);
+
+  dt_print(DT_DEBUG_MASKS, "[ras2forms] %dx%d mask traced at 1/%d, %d parts, %d forms",
+           width, height, step, ncomps, g_list_length(forms));
 
   // restore potrace's traversal order (outer first, then its holes).
   // group consumers need the outer at list position 0 so it acts as the
@@ -87,6 +87,7 @@ static void _pop_undo(gpointer user_data,
 {
   if(type == DT_UNDO_RATINGS)
   {
+    dt_image_cache_write_batch_begin();
     for(GList *list = (GList *)data; list; list = g_list_next(list))
     {
       dt_undo_ratings_t *ratings = list->data;
@@ -96,6 +97,7 @@ static void _pop_undo(gpointer user_data,
                               : ratings->after);
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(ratings->imgid));
     }
+    dt_image_cache_write_batch_end();
     dt_collection_hint_message(darktable.collection);
   }
 }
@@ -213,6 +215,9 @@ static void _ratings_apply(const GList *imgs,
   if(!g_list_shorter_than(imgs, 2))
     _ratings_log_multi(imgs, rating, toggle);
 
+  // all images are written back to the database in one batch
+  dt_image_cache_write_batch_begin();
+  GList *done = NULL;
   for(const GList *images = imgs;
       images;
       images = g_list_next(images))
@@ -226,11 +231,13 @@ static void _ratings_apply(const GList *imgs,
       undoratings->imgid = image_id;
       undoratings->before = old_rating;
       undoratings->after = new_rating;
-      *undo = g_list_append(*undo, undoratings);
+      done = g_list_prepend(done, undoratings);
     }
 
     _ratings_apply_to_image(image_id, new_rating);
   }
+  dt_image_cache_write_batch_end();
+  if(undo_on) *undo = g_list_concat(*undo, g_list_reverse(done));
 }
 
 void dt_ratings_apply_on_list(const GList *img,
@@ -32,6 +32,17 @@ typedef struct dt_selection_t
   /* this stores the last single clicked image id indicating
      the start of a selection range */
   dt_imgid_t last_single_id;
+
+  /* main.selected_images as a bitset over imgid, kept up to date by
+     temporary triggers of the main connection whatever writes it */
+  struct
+  {
+    guint64 *bits;
+    size_t words;
+    uint32_t count;
+    gboolean ready; // the triggers are in place
+    gboolean valid;
+  } set;
 } dt_selection_t;
 
 const dt_collection_t *dt_selection_get_collection(dt_selection_t *selection)
@@ -39,6 +50,159 @@ const dt_collection_t *dt_selection_get_collection(dt_selection_t *selection)
   return selection->collection;
 }
 
+static void _selection_set_bit(dt_selection_t *selection,
+                               const dt_imgid_t imgid,
+                               const gboolean on)
+{
+  if(!dt_is_valid_imgid(imgid)) return;
+
+  const size_t w = (size_t)imgid / 64;
+  const guint64 bit = (guint64)1 << (imgid % 64);
+  if(w >= selection->set.words)
+  {
+    if(!on) return;
+    const size_t words = MAX(w + 1, 2 * selection->set.words);
+    selection->set.bits = g_renew(guint64, selection->set.bits, words);
+    memset(selection->set.bits + selection->set.words, 0,
+           (words - selection->set.words) * sizeof(guint64));
+    selection->set.words = words;
+  }
+
+  const gboolean was = (selection->set.bits[w] & bit) != 0;
+  if(on && !was)
+  {
+    selection->set.bits[w] |= bit;
+    selection->set.count++;
+  }
+  else if(!on && was)
+  {
+    selection->set.bits[w] &= ~bit;
+    selection->set.count--;
+  }
+}
+
+// sql function called by the triggers
+static void _selection_sql_set(sqlite3_context *context,
+                               int argc,
+                               sqlite3_value **argv)
+{
+  dt_selection_t *selection = sqlite3_user_data(context);
+  if(selection->set.valid)
+    _selection_set_bit(selection, sqlite3_value_int(argv[0]), sqlite3_value_int(argv[1]));
+  sqlite3_result_null(context);
+}
+
+static void _selection_rollback(gpointer data)
+{
+  dt_selection_t *selection = data;
+  selection->set.valid = FALSE;
+}
+
+static const char *_selection_triggers[] =
+{
+  "CREATE TEMP TRIGGER IF NOT EXISTS selection_insert AFTER INSERT ON main.selected_images"
+  " BEGIN SELECT dt_selection_set(NEW.imgid, 1); END",
+  "CREATE TEMP TRIGGER IF NOT EXISTS selection_delete AFTER DELETE ON main.selected_images"
+  " BEGIN SELECT dt_selection_set(OLD.imgid, 0); END",
+  "CREATE TEMP TRIGGER IF NOT EXISTS selection_update AFTER UPDATE ON main.selected_images"
+  " BEGIN"
+  "  SELECT dt_selection_set(OLD.imgid, 0);"
+  "  SELECT dt_selection_set(NEW.imgid, 1);"
+  " END",
+};
+
+// enter the connection mutex with the bitset up to date. FALSE if it
+// can't be used, the mutex is released then.
+static gboolean _selection_set_enter(const dt_selection_t *sel)
+{
+  dt_selection_t *selection = (dt_selection_t *)sel;
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_mutex_enter(sqlite3_db_mutex(db));
+
+  if(!selection->set.ready)
+  {
+    gboolean ok = sqlite3_create_function(db, "dt_selection_set", 2, SQLITE_UTF8,
+                                          selection, _selection_sql_set,
+                                          NULL, NULL) == SQLITE_OK;
+    for(size_t k = 0; ok && k < G_N_ELEMENTS(_selection_triggers); k++)
+      ok = sqlite3_exec(db, _selection_triggers[k], NULL, NULL, NULL) == SQLITE_OK;
+    if(!ok)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[selection] could not set up the selection bitset: %s",
+               sqlite3_errmsg(db));
+      sqlite3_mutex_leave(sqlite3_db_mutex(db));
+      return FALSE;
+    }
+    dt_database_connect_rollback(darktable.db, _selection_rollback, selection);
+    selection->set.ready = TRUE;
+  }
+
+  if(!selection->set.valid)
+  {
+    if(selection->set.bits)
+      memset(selection->set.bits, 0, selection->set.words * sizeof(guint64));
+    selection->set.count = 0;
+
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT imgid FROM main.selected_images",
+                                -1, &stmt, NULL);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      _selection_set_bit(selection, sqlite3_column_int(stmt, 0), TRUE);
+    sqlite3_finalize(stmt);
+    selection->set.valid = TRUE;
+  }
+  return TRUE;
+}
+
+static void _selection_set_leave(void)
+{
+  sqlite3_mutex_leave(sqlite3_db_mutex(dt_database_get(darktable.db)));
+}
+
+gboolean dt_selection_is_selected(const dt_selection_t *selection,
+                                  const dt_imgid_t imgid)
+{
+  if(!dt_is_valid_imgid(imgid)) return FALSE;
+
+  if(!selection || !_selection_set_enter(selection))
+  {
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT imgid FROM main.selected_images WHERE imgid = ?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    const gboolean selected = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return selected;
+  }
+
+  const size_t w = (size_t)imgid / 64;
+  const gboolean selected = w < selection->set.words
+    && (selection->set.bits[w] & ((guint64)1 << (imgid % 64)));
+  _selection_set_leave();
+  return selected;
+}
+
+uint32_t dt_selection_get_count(const dt_selection_t *selection)
+{
+  if(!selection || !_selection_set_enter(selection))
+  {
+    sqlite3_stmt *stmt;
+    uint32_t count = 0;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT COUNT(*) FROM main.selected_images",
+                                -1, &stmt, NULL);
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+      count = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return count;
+  }
+
+  const uint32_t count = selection->set.count;
+  _selection_set_leave();
+  return count;
+}
+
 static void _selection_raise_signal()
 {
   // discard cached images_to_act_on list
@@ -155,6 +319,7 @@ const dt_selection_t *dt_selection_new()
 
 void dt_selection_free(dt_selection_t *selection)
 {
+  g_free(selection->set.bits);
   g_free(selection);
 }
 
@@ -258,22 +423,9 @@ void dt_selection_select_single(dt_selection_t *selection, const dt_imgid_t imgi
 
 void dt_selection_toggle(dt_selection_t *selection, const dt_imgid_t imgid)
 {
-  sqlite3_stmt *stmt;
-  gboolean exists = FALSE;
-
   if(!dt_is_valid_imgid(imgid)) return;
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT imgid"
-                              " FROM main.selected_images"
-                              " WHERE imgid=?1", -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-
-  if(sqlite3_step(stmt) == SQLITE_ROW) exists = TRUE;
-
-  sqlite3_finalize(stmt);
-
-  if(exists)
+  if(dt_selection_is_selected(selection, imgid))
   {
     dt_selection_deselect(selection, imgid);
   }
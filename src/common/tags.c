@@ -132,6 +132,7 @@ static void _pop_undo(gpointer user_data,
 {
   if(type == DT_UNDO_TAGS)
   {
+    dt_database_start_transaction(darktable.db);
     for(GList *list = (GList *)data; list; list = g_list_next(list))
     {
       dt_undo_tags_t *undotags = list->data;
@@ -141,6 +142,7 @@ static void _pop_undo(gpointer user_data,
       _pop_undo_execute(undotags->imgid, before, after);
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(undotags->imgid));
     }
+    dt_database_release_transaction(darktable.db);
 
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
   }
@@ -416,8 +418,64 @@ typedef enum dt_tag_actions_t
   DT_TA_SET_ALL,
 } dt_tag_actions_t;
 
-static GList *_tag_get_tags(const dt_imgid_t imgid,
-                            const dt_tag_type_t type);
+static const char *_tag_type_filter(const dt_tag_type_t type)
+{
+  return type == DT_TAG_TYPE_ALL ? "" :
+         type == DT_TAG_TYPE_DT ? "AND T.id IN memory.darktable_tags" :
+                                  "AND NOT T.id IN memory.darktable_tags";
+}
+
+// the tag ids of all images in one query, imgid -> GList of tag ids
+static GHashTable *_tag_get_tags_images(const GList *imgs,
+                                        const dt_tag_type_t type)
+{
+  GHashTable *tags = g_hash_table_new(NULL, NULL);
+  gchar *images = NULL;
+  for(const GList *l = imgs; l; l = g_list_next(l))
+    dt_util_str_cat(&images, "%d,", GPOINTER_TO_INT(l->data));
+  if(!images) return tags;
+  images[strlen(images) - 1] = '\0';
+
+  sqlite3_stmt *stmt;
+  // clang-format off
+  gchar *query = g_strdup_printf("SELECT I.imgid, T.id"
+                                 "  FROM main.tagged_images AS I"
+                                 "  JOIN data.tags T on T.id = I.tagid"
+                                 "  WHERE I.imgid IN (%s) %s",
+                                 images, _tag_type_filter(type));
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    gpointer imgid = GINT_TO_POINTER(sqlite3_column_int(stmt, 0));
+    GList *list = g_hash_table_lookup(tags, imgid);
+    g_hash_table_insert(tags, imgid,
+                        g_list_prepend(list, GINT_TO_POINTER(sqlite3_column_int(stmt, 1))));
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+  g_free(images);
+  return tags;
+}
+
+// takes the list of imgid out of the table
+static GList *_tag_steal_tags(GHashTable *tags, const dt_imgid_t imgid)
+{
+  GList *list = g_hash_table_lookup(tags, GINT_TO_POINTER(imgid));
+  g_hash_table_steal(tags, GINT_TO_POINTER(imgid));
+  return list;
+}
+
+static void _tag_free_tags_images(GHashTable *tags)
+{
+  if(!tags) return;
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, tags);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+    g_list_free(value);
+  g_hash_table_destroy(tags);
+}
 
 static gboolean _tag_execute(const GList *tags,
                              const GList *imgs,
@@ -426,12 +484,20 @@ static gboolean _tag_execute(const GList *tags,
                              const gint action)
 {
   gboolean res = FALSE;
+  // read the current tags of all images at once and write them in a
+  // single transaction, instead of a round trip per image
+  dt_database_start_transaction(darktable.db);
+  GHashTable *all_tags = _tag_get_tags_images(imgs, DT_TAG_TYPE_ALL);
+  GHashTable *dt_tags = action == DT_TA_SET
+    ? _tag_get_tags_images(imgs, DT_TAG_TYPE_DT)
+    : NULL;
+  GList *done = NULL;
   for(const GList *images = imgs; images; images = g_list_next(images))
   {
     const dt_imgid_t image_id = GPOINTER_TO_INT(images->data);
     dt_undo_tags_t *undotags = malloc(sizeof(dt_undo_tags_t));
     undotags->imgid = image_id;
-    undotags->before = _tag_get_tags(image_id, DT_TAG_TYPE_ALL);
+    undotags->before = _tag_steal_tags(all_tags, image_id);
     switch(action)
     {
       case DT_TA_ATTACH:
@@ -445,7 +511,7 @@ static gboolean _tag_execute(const GList *tags,
       case DT_TA_SET:
         undotags->after = g_list_copy((GList *)tags);
         // preserve dt tags
-        GList *dttags = _tag_get_tags(image_id, DT_TAG_TYPE_DT);
+        GList *dttags = _tag_steal_tags(dt_tags, image_id);
         if(dttags) undotags->after = g_list_concat(undotags->after, dttags);
         res = TRUE;
         break;
@@ -460,10 +526,14 @@ static gboolean _tag_execute(const GList *tags,
     }
     _pop_undo_execute(image_id, undotags->before, undotags->after);
     if(undo_on)
-      *undo = g_list_append(*undo, undotags);
+      done = g_list_prepend(done, undotags);
     else
       _undo_tags_free(undotags);
   }
+  _tag_free_tags_images(all_tags);
+  _tag_free_tags_images(dt_tags);
+  dt_database_release_transaction(darktable.db);
+  if(undo_on) *undo = g_list_concat(*undo, g_list_reverse(done));
   return res;
 }
 
@@ -725,75 +795,335 @@ uint32_t dt_tag_count_attached(const dt_imgid_t imgid,
   return count;
 }
 
+// in-memory copy of the tags and of the tags attached to each image, so
+// that the tagging panel counts tags of the selection without grouping
+// main.tagged_images over and over. temporary triggers of the main
+// connection keep the attachments up to date whatever the code path
+// writing them, and a change of data.tags or a rollback drops the copy.
+
+typedef struct _tag_cache_tag_t
+{
+  guint id;
+  gchar *name;
+  gchar *synonyms;
+  gint flags;
+  gboolean dt; // darktable|... internal tag
+} _tag_cache_tag_t;
+
+static struct
+{
+  GMutex lock;
+  gboolean ready;         // the triggers are in place
+  gboolean tags_valid;
+  gboolean images_valid;
+  GHashTable *tags;       // tagid -> _tag_cache_tag_t
+  GPtrArray *by_name;     // _tag_cache_tag_t ordered by name
+  GHashTable *images;     // imgid -> GArray of tagid
+  GHashTable *usage;      // tagid -> number of images
+} _tag_cache;
+
+static void _tag_cache_tag_free(gpointer data)
+{
+  _tag_cache_tag_t *t = data;
+  g_free(t->name);
+  g_free(t->synonyms);
+  g_free(t);
+}
+
+static void _tag_cache_usage_add(const guint tagid,
+                                 const int delta)
+{
+  gpointer key = GUINT_TO_POINTER(tagid);
+  const int count = GPOINTER_TO_INT(g_hash_table_lookup(_tag_cache.usage, key)) + delta;
+  if(count > 0)
+    g_hash_table_insert(_tag_cache.usage, key, GINT_TO_POINTER(count));
+  else
+    g_hash_table_remove(_tag_cache.usage, key);
+}
+
+static void _tag_cache_attach(const dt_imgid_t imgid,
+                              const guint tagid)
+{
+  gpointer key = GINT_TO_POINTER(imgid);
+  GArray *a = g_hash_table_lookup(_tag_cache.images, key);
+  if(!a)
+  {
+    a = g_array_sized_new(FALSE, FALSE, sizeof(guint), 4);
+    g_hash_table_insert(_tag_cache.images, key, a);
+  }
+  g_array_append_val(a, tagid);
+  _tag_cache_usage_add(tagid, 1);
+}
+
+static void _tag_cache_detach(const dt_imgid_t imgid,
+                              const guint tagid)
+{
+  GArray *a = g_hash_table_lookup(_tag_cache.images, GINT_TO_POINTER(imgid));
+  if(!a) return;
+  for(guint i = 0; i < a->len; i++)
+  {
+    if(g_array_index(a, guint, i) == tagid)
+    {
+      g_array_remove_index_fast(a, i);
+      _tag_cache_usage_add(tagid, -1);
+      break;
+    }
+  }
+}
+
+// sql functions called by the triggers
+static void _tag_cache_sql_attach(sqlite3_context *context,
+                                  int argc,
+                                  sqlite3_value **argv)
+{
+  g_mutex_lock(&_tag_cache.lock);
+  if(_tag_cache.images_valid)
+    _tag_cache_attach(sqlite3_value_int(argv[0]), sqlite3_value_int(argv[1]));
+  g_mutex_unlock(&_tag_cache.lock);
+  sqlite3_result_null(context);
+}
+
+static void _tag_cache_sql_detach(sqlite3_context *context,
+                                  int argc,
+                                  sqlite3_value **argv)
+{
+  g_mutex_lock(&_tag_cache.lock);
+  if(_tag_cache.images_valid)
+    _tag_cache_detach(sqlite3_value_int(argv[0]), sqlite3_value_int(argv[1]));
+  g_mutex_unlock(&_tag_cache.lock);
+  sqlite3_result_null(context);
+}
+
+static void _tag_cache_sql_tags_changed(sqlite3_context *context,
+                                        int argc,
+                                        sqlite3_value **argv)
+{
+  g_mutex_lock(&_tag_cache.lock);
+  _tag_cache.tags_valid = FALSE;
+  g_mutex_unlock(&_tag_cache.lock);
+  sqlite3_result_null(context);
+}
+
+// the attachments done by the triggers are lost with the transaction
+static void _tag_cache_rollback(gpointer data)
+{
+  g_mutex_lock(&_tag_cache.lock);
+  _tag_cache.images_valid = FALSE;
+  _tag_cache.tags_valid = FALSE;
+  g_mutex_unlock(&_tag_cache.lock);
+}
+
+static const char *_tag_cache_triggers[] =
+{
+  "CREATE TEMP TRIGGER IF NOT EXISTS tag_cache_attach AFTER INSERT ON main.tagged_images"
+  " BEGIN SELECT dt_tag_cache_attach(NEW.imgid, NEW.tagid); END",
+  "CREATE TEMP TRIGGER IF NOT EXISTS tag_cache_detach AFTER DELETE ON main.tagged_images"
+  " BEGIN SELECT dt_tag_cache_detach(OLD.imgid, OLD.tagid); END",
+  "CREATE TEMP TRIGGER IF NOT EXISTS tag_cache_move AFTER UPDATE OF imgid, tagid ON main.tagged_images"
+  " BEGIN"
+  "  SELECT dt_tag_cache_detach(OLD.imgid, OLD.tagid);"
+  "  SELECT dt_tag_cache_attach(NEW.imgid, NEW.tagid);"
+  " END",
+  "CREATE TEMP TRIGGER IF NOT EXISTS tag_cache_tag_insert AFTER INSERT ON data.tags"
+  " BEGIN SELECT dt_tag_cache_tags_changed(); END",
+  "CREATE TEMP TRIGGER IF NOT EXISTS tag_cache_tag_delete AFTER DELETE ON data.tags"
+  " BEGIN SELECT dt_tag_cache_tags_changed(); END",
+  "CREATE TEMP TRIGGER IF NOT EXISTS tag_cache_tag_update AFTER UPDATE ON data.tags"
+  " BEGIN SELECT dt_tag_cache_tags_changed(); END",
+};
+
+static gint _tag_cache_cmp_name(gconstpointer a, gconstpointer b)
+{
+  const _tag_cache_tag_t *ta = *(const _tag_cache_tag_t **)a;
+  const _tag_cache_tag_t *tb = *(const _tag_cache_tag_t **)b;
+  return g_strcmp0(ta->name, tb->name);
+}
+
+static void _tag_cache_load_tags(sqlite3 *db)
+{
+  g_hash_table_remove_all(_tag_cache.tags);
+  g_ptr_array_set_size(_tag_cache.by_name, 0);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT id, name, flags, synonyms FROM data.tags",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    _tag_cache_tag_t *t = g_malloc0(sizeof(_tag_cache_tag_t));
+    t->id = sqlite3_column_int(stmt, 0);
+    t->name = g_strdup((char *)sqlite3_column_text(stmt, 1));
+    t->flags = sqlite3_column_int(stmt, 2);
+    t->synonyms = g_strdup((char *)sqlite3_column_text(stmt, 3));
+    // same as memory.darktable_tags
+    t->dt = t->name && !g_ascii_strncasecmp(t->name, "darktable|", 10);
+    g_hash_table_insert(_tag_cache.tags, GUINT_TO_POINTER(t->id), t);
+    g_ptr_array_add(_tag_cache.by_name, t);
+  }
+  sqlite3_finalize(stmt);
+  g_ptr_array_sort(_tag_cache.by_name, _tag_cache_cmp_name);
+  _tag_cache.tags_valid = TRUE;
+}
+
+static void _tag_cache_load_images(sqlite3 *db)
+{
+  g_hash_table_remove_all(_tag_cache.images);
+  g_hash_table_remove_all(_tag_cache.usage);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT imgid, tagid FROM main.tagged_images",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    _tag_cache_attach(sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1));
+  sqlite3_finalize(stmt);
+  _tag_cache.images_valid = TRUE;
+}
+
+static void _tag_cache_unlock(void)
+{
+  g_mutex_unlock(&_tag_cache.lock);
+  sqlite3_mutex_leave(sqlite3_db_mutex(dt_database_get(darktable.db)));
+}
+
+// lock the cache, up to date. FALSE if it can't be used.
+// the connection mutex is taken first, as the triggers run with it held.
+static gboolean _tag_cache_lock(void)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_mutex_enter(sqlite3_db_mutex(db));
+  g_mutex_lock(&_tag_cache.lock);
+
+  if(!_tag_cache.tags)
+  {
+    _tag_cache.tags = g_hash_table_new_full(NULL, NULL, NULL, _tag_cache_tag_free);
+    _tag_cache.by_name = g_ptr_array_new();
+    _tag_cache.images = g_hash_table_new_full(NULL, NULL, NULL,
+                                              (GDestroyNotify)g_array_unref);
+    _tag_cache.usage = g_hash_table_new(NULL, NULL);
+  }
+
+  if(!_tag_cache.ready)
+  {
+    gboolean ok =
+      sqlite3_create_function(db, "dt_tag_cache_attach", 2, SQLITE_UTF8, NULL,
+                              _tag_cache_sql_attach, NULL, NULL) == SQLITE_OK
+      && sqlite3_create_function(db, "dt_tag_cache_detach", 2, SQLITE_UTF8, NULL,
+                                 _tag_cache_sql_detach, NULL, NULL) == SQLITE_OK
+      && sqlite3_create_function(db, "dt_tag_cache_tags_changed", 0, SQLITE_UTF8, NULL,
+                                 _tag_cache_sql_tags_changed, NULL, NULL) == SQLITE_OK;
+    for(size_t k = 0; ok && k < G_N_ELEMENTS(_tag_cache_triggers); k++)
+      ok = sqlite3_exec(db, _tag_cache_triggers[k], NULL, NULL, NULL) == SQLITE_OK;
+    if(!ok)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[tags] could not set up the tag cache: %s",
+               sqlite3_errmsg(db));
+      _tag_cache_unlock();
+      return FALSE;
+    }
+    dt_database_connect_rollback(darktable.db, _tag_cache_rollback, NULL);
+    _tag_cache.ready = TRUE;
+  }
+
+  if(!_tag_cache.tags_valid || !_tag_cache.images_valid)
+  {
+    dt_times_t start;
+    dt_get_perf_times(&start);
+    if(!_tag_cache.tags_valid) _tag_cache_load_tags(db);
+    if(!_tag_cache.images_valid) _tag_cache_load_images(db);
+    dt_show_times_f(&start, "[tags]", "load tag cache, %u tags, %u tagged images",
+                    g_hash_table_size(_tag_cache.tags),
+                    g_hash_table_size(_tag_cache.images));
+  }
+  return TRUE;
+}
+
+
+// count the images carrying each tag among imgs, cache locked
+static GHashTable *_tag_cache_count_images(const GList *imgs)
+{
+  GHashTable *counts = g_hash_table_new(NULL, NULL);
+  for(const GList *l = imgs; l; l = g_list_next(l))
+  {
+    GArray *a = g_hash_table_lookup(_tag_cache.images, l->data);
+    if(!a) continue;
+    for(guint i = 0; i < a->len; i++)
+    {
+      gpointer key = GUINT_TO_POINTER(g_array_index(a, guint, i));
+      const int count = GPOINTER_TO_INT(g_hash_table_lookup(counts, key));
+      g_hash_table_insert(counts, key, GINT_TO_POINTER(count + 1));
+    }
+  }
+  return counts;
+}
+
+static dt_tag_t *_tag_cache_new_tag(const _tag_cache_tag_t *ct)
+{
+  dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
+  t->id = ct->id;
+  t->tag = g_strdup(ct->name);
+  t->leave = g_strrstr(t->tag, "|");
+  t->leave = t->leave ? t->leave + 1 : t->tag;
+  t->flags = ct->flags;
+  t->synonym = g_strdup(ct->synonyms);
+  return t;
+}
+
+static GList *_tag_get_image_list(const char *query)
+{
+  GList *imgs = NULL;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+  return imgs;
+}
+
 uint32_t dt_tag_get_attached(const dt_imgid_t imgid,
                              GList **result,
                              const gboolean ignore_dt_tags)
 {
-  sqlite3_stmt *stmt;
-  uint32_t nb_selected = 0;
-  char *images = NULL;
+  GList *imgs = NULL;
   if(dt_is_valid_imgid(imgid))
-  {
-    images = g_strdup_printf("%d", imgid);
-    nb_selected = 1;
-  }
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(imgid));
   else
   {
     // we get the query used to retrieve the list of select images
-    images = dt_selection_get_list_query(darktable.selection, FALSE, FALSE);
-    // and we retrieve the number of image in the selection
-    gchar *query = g_strdup_printf("SELECT COUNT(*)"
-                                   " FROM (%s)",
-                                   images);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    if(sqlite3_step(stmt) == SQLITE_ROW)
-      nb_selected = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-    g_free(query);
+    gchar *images = dt_selection_get_list_query(darktable.selection, FALSE, FALSE);
+    if(!images) return 0;
+    imgs = _tag_get_image_list(images);
+    g_free(images);
   }
-  uint32_t count = 0;
-  if(images)
+  const uint32_t nb_selected = g_list_length(imgs);
+
+  *result = NULL;
+  if(!_tag_cache_lock())
   {
-    // clang-format off
-    gchar *query = g_strdup_printf
-      ("SELECT DISTINCT I.tagid, T.name, T.flags, T.synonyms,"
-       " COUNT(DISTINCT I.imgid) AS inb"
-       " FROM main.tagged_images AS I"
-       " JOIN data.tags AS T ON T.id = I.tagid"
-       " WHERE I.imgid IN (%s)%s"
-       " GROUP BY I.tagid "
-       " ORDER by T.name",
-       images, ignore_dt_tags ? " AND T.id NOT IN memory.darktable_tags" : "");
-    // clang-format on
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    g_free(images);
+    g_list_free(imgs);
+    return 0;
+  }
 
-    // Create result
-    *result = NULL;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
-      t->id = sqlite3_column_int(stmt, 0);
-      t->tag = g_strdup((char *)sqlite3_column_text(stmt, 1));
-      t->leave = g_strrstr(t->tag, "|");
-      t->leave = t->leave ? t->leave + 1 : t->tag;
-      t->flags = sqlite3_column_int(stmt, 2);
-      t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 3));
-      const uint32_t imgnb = sqlite3_column_int(stmt, 4);
-      t->count = imgnb;
-      t->select = (nb_selected == 0)
-                  ? DT_TS_NO_IMAGE
-                  : (imgnb == nb_selected)
-                    ? DT_TS_ALL_IMAGES
-                    : (imgnb == 0)
-                      ? DT_TS_NO_IMAGE
-                      : DT_TS_SOME_IMAGES;
-      *result = g_list_append(*result, t);
-      count++;
-    }
-    sqlite3_finalize(stmt);
-    g_free(query);
+  GHashTable *counts = _tag_cache_count_images(imgs);
+  g_list_free(imgs);
+
+  // walk the tags by name to keep the list ordered
+  uint32_t count = 0;
+  for(guint i = 0; i < _tag_cache.by_name->len; i++)
+  {
+    const _tag_cache_tag_t *ct = g_ptr_array_index(_tag_cache.by_name, i);
+    const uint32_t imgnb = GPOINTER_TO_INT(g_hash_table_lookup(counts,
+                                                               GUINT_TO_POINTER(ct->id)));
+    if(imgnb == 0 || (ignore_dt_tags && ct->dt)) continue;
+
+    dt_tag_t *t = _tag_cache_new_tag(ct);
+    t->count = imgnb;
+    t->select = (imgnb == nb_selected) ? DT_TS_ALL_IMAGES : DT_TS_SOME_IMAGES;
+    *result = g_list_prepend(*result, t);
+    count++;
   }
+  _tag_cache_unlock();
+  g_hash_table_destroy(counts);
+
+  *result = g_list_reverse(*result);
   return count;
 }
 
@@ -978,9 +1308,7 @@ static GList *_tag_get_tags(const dt_imgid_t imgid,
                                  "  FROM main.tagged_images AS I"
                                  "  JOIN data.tags T on T.id = I.tagid"
                                  "  WHERE I.imgid IN (%s) %s",
-           images, type == DT_TAG_TYPE_ALL ? "" :
-                   type == DT_TAG_TYPE_DT ? "AND T.id IN memory.darktable_tags" :
-                                            "AND NOT T.id IN memory.darktable_tags");
+           images, _tag_type_filter(type));
   // clang-format on
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
 
@@ -1154,18 +1482,17 @@ GList *dt_tag_get_hierarchical_export(const dt_imgid_t imgid,
 gboolean dt_is_tag_attached(const guint tagid,
                             const dt_imgid_t imgid)
 {
-  sqlite3_stmt *stmt;
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT imgid"
-                              " FROM main.tagged_images"
-                              " WHERE imgid = ?1 AND tagid = ?2", -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db,
+                                                  "SELECT imgid"
+                                                  " FROM main.tagged_images"
+                                                  " WHERE imgid = ?1 AND tagid = ?2");
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, tagid);
 
   const gboolean ret = (sqlite3_step(stmt) == SQLITE_ROW);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   return ret;
 }
 
@@ -1315,6 +1642,7 @@ uint32_t dt_tag_get_suggestions(GList **result)
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query,
                               -1, &stmt, NULL);
 
+  GList *tags = NULL;
   uint32_t count = 0;
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -1330,11 +1658,12 @@ uint32_t dt_tag_get_suggestions(GList **result)
                 (imgnb == 0) ? DT_TS_NO_IMAGE : DT_TS_SOME_IMAGES;
     t->flags = sqlite3_column_int(stmt, 4);
     t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 5));
-    *result = g_list_append(*result, t);
+    tags = g_list_prepend(tags, t);
     count++;
   }
 
   sqlite3_finalize(stmt);
+  *result = g_list_concat(*result, g_list_reverse(tags));
 
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
                         "DELETE FROM memory.taglist", NULL, NULL, NULL);
@@ -1487,64 +1816,40 @@ uint32_t dt_tag_images_count(gint tagid)
 
 uint32_t dt_tag_get_with_usage(GList **result)
 {
-  sqlite3_stmt *stmt;
-
-  /* Select tags that are similar to the keyword and are actually used to tag images*/
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "INSERT INTO memory.taglist (id, count)"
-                              "  SELECT tagid, COUNT(*)"
-                              "  FROM main.tagged_images"
-                              "  GROUP BY tagid",
-                              -1, &stmt, NULL);
-  // clang-format on
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  GList *imgs = _tag_get_image_list("SELECT imgid FROM main.selected_images");
+  const uint32_t nb_selected = g_list_length(imgs);
 
-  const uint32_t nb_selected = dt_selected_images_count();
+  if(!_tag_cache_lock())
+  {
+    g_list_free(imgs);
+    return 0;
+  }
 
-  /* Now put all the bits together */
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "SELECT T.name, T.id, MT.count, CT.imgnb, T.flags, T.synonyms"
-     "  FROM data.tags T "
-     "  LEFT JOIN memory.taglist MT ON MT.id = T.id "
-     "  LEFT JOIN (SELECT tagid, COUNT(DISTINCT imgid) AS imgnb"
-     "             FROM main.tagged_images "
-     "             WHERE imgid IN (SELECT imgid"
-     "                               FROM main.selected_images)"
-     "                               GROUP BY tagid) AS CT "
-     "    ON CT.tagid = T.id"
-     "  WHERE T.id NOT IN memory.darktable_tags "
-     "  ORDER BY T.name ",
-     -1, &stmt, NULL);
-  // clang-format on
+  GHashTable *counts = _tag_cache_count_images(imgs);
+  g_list_free(imgs);
 
-  /* ... and create the result list to send upwards */
+  /* all the tags but the darktable ones, ordered by name */
+  GList *tags = NULL;
   uint32_t count = 0;
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  for(guint i = 0; i < _tag_cache.by_name->len; i++)
   {
-    dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
-    t->tag = g_strdup((char *)sqlite3_column_text(stmt, 0));
-    t->leave = g_strrstr(t->tag, "|");
-    t->leave = t->leave ? t->leave + 1 : t->tag;
-    t->id = sqlite3_column_int(stmt, 1);
-    t->count = sqlite3_column_int(stmt, 2);
-    const uint32_t imgnb = sqlite3_column_int(stmt, 3);
+    const _tag_cache_tag_t *ct = g_ptr_array_index(_tag_cache.by_name, i);
+    if(ct->dt) continue;
+
+    gpointer key = GUINT_TO_POINTER(ct->id);
+    dt_tag_t *t = _tag_cache_new_tag(ct);
+    t->count = GPOINTER_TO_INT(g_hash_table_lookup(_tag_cache.usage, key));
+    const uint32_t imgnb = GPOINTER_TO_INT(g_hash_table_lookup(counts, key));
     t->select = (nb_selected == 0) ? DT_TS_NO_IMAGE :
                 (imgnb == nb_selected) ? DT_TS_ALL_IMAGES :
                 (imgnb == 0) ? DT_TS_NO_IMAGE : DT_TS_SOME_IMAGES;
-    t->flags = sqlite3_column_int(stmt, 4);
-    t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 5));
-    *result = g_list_append(*result, t);
+    tags = g_list_prepend(tags, t);
     count++;
   }
+  _tag_cache_unlock();
+  g_hash_table_destroy(counts);
 
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "DELETE FROM memory.taglist", NULL, NULL, NULL);
-
+  *result = g_list_concat(*result, g_list_reverse(tags));
   return count;
 }
 
@@ -0,0 +1,411 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/thumbstore.h"
+#include "common/dtpthread.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+/* file layout:
+
+     "DTTHUMB1"
+     record 0: [header][blob][padding to 8 bytes]
+     record 1: ...
+
+   records are only ever appended. a newer record for the same imgid
+   supersedes the older one, a record with length 0 is a tombstone. the
+   space of superseded records is reclaimed when the store is opened and
+   more than half of the file is dead.
+*/
+
+#define DT_THUMBSTORE_MAGIC "DTTHUMB2"
+#define DT_THUMBSTORE_MAGIC_LEN 8
+#define DT_THUMBSTORE_RECORD_MAGIC 0x6d756874u
+#define DT_THUMBSTORE_COMPACT_MIN ((uint64_t)16 << 20)
+
+typedef struct _thumbstore_record_t
+{
+  uint32_t magic;
+  int32_t imgid;
+  uint32_t length;
+  int16_t color_space;
+  uint16_t codec;
+} _thumbstore_record_t;
+
+typedef struct _thumbstore_entry_t
+{
+  uint64_t offset; // of the record header
+  uint32_t length;
+  int16_t color_space;
+  uint16_t codec;
+} _thumbstore_entry_t;
+
+struct dt_thumbstore_t
+{
+  // readers of the mapping and of the index hold the read lock,
+  // appending and remapping take the write lock
+  dt_pthread_rwlock_t lock;
+  char *filename;
+  FILE *file;
+  GMappedFile *map;
+  const uint8_t *data;
+  size_t mapped;
+  uint64_t end;     // offset of the next record
+  uint64_t dead;    // bytes taken by superseded records and tombstones
+  GHashTable *index; // imgid -> _thumbstore_entry_t
+};
+
+static inline uint64_t _record_size(const uint32_t length)
+{
+  return sizeof(_thumbstore_record_t) + ((length + 7u) & ~7u);
+}
+
+static void _remap(dt_thumbstore_t *store)
+{
+  if(store->map) g_mapped_file_unref(store->map);
+  store->map = NULL;
+  store->data = NULL;
+  store->mapped = 0;
+
+  GError *error = NULL;
+  store->map = g_mapped_file_new(store->filename, FALSE, &error);
+  if(!store->map)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[thumbstore] can't map `%s': %s", store->filename, error->message);
+    g_error_free(error);
+    return;
+  }
+  store->data = (const uint8_t *)g_mapped_file_get_contents(store->map);
+  store->mapped = g_mapped_file_get_length(store->map);
+}
+
+static void _index_insert(dt_thumbstore_t *store,
+                          const dt_imgid_t imgid,
+                          const uint64_t offset,
+                          const uint32_t length,
+                          const int color_space,
+                          const dt_thumbstore_codec_t codec)
+{
+  _thumbstore_entry_t *old = g_hash_table_lookup(store->index, GINT_TO_POINTER(imgid));
+  if(old)
+    store->dead += _record_size(old->length);
+
+  if(length == 0)
+  {
+    store->dead += _record_size(0);
+    g_hash_table_remove(store->index, GINT_TO_POINTER(imgid));
+    return;
+  }
+
+  _thumbstore_entry_t *entry = old ? old : g_malloc(sizeof(_thumbstore_entry_t));
+  entry->offset = offset;
+  entry->length = length;
+  entry->color_space = color_space;
+  entry->codec = codec;
+  if(!old)
+    g_hash_table_insert(store->index, GINT_TO_POINTER(imgid), entry);
+}
+
+// rebuild the index from the mapping, returns the end of the last intact record
+static uint64_t _scan(dt_thumbstore_t *store)
+{
+  uint64_t offset = DT_THUMBSTORE_MAGIC_LEN;
+  while(offset + sizeof(_thumbstore_record_t) <= store->mapped)
+  {
+    _thumbstore_record_t rec;
+    memcpy(&rec, store->data + offset, sizeof(rec));
+    if(rec.magic != DT_THUMBSTORE_RECORD_MAGIC
+       || rec.imgid <= 0
+       || offset + sizeof(rec) + rec.length > store->mapped)
+      break;
+    _index_insert(store, rec.imgid, offset, rec.length, rec.color_space, rec.codec);
+    offset += _record_size(rec.length);
+  }
+  return MIN(offset, store->mapped);
+}
+
+static gboolean _write_record(FILE *f,
+                              const dt_imgid_t imgid,
+                              const uint8_t *blob,
+                              const uint32_t length,
+                              const int color_space,
+                              const dt_thumbstore_codec_t codec)
+{
+  static const uint8_t zeros[8] = { 0 };
+  const _thumbstore_record_t rec = { .magic = DT_THUMBSTORE_RECORD_MAGIC,
+                                     .imgid = imgid,
+                                     .length = length,
+                                     .color_space = color_space,
+                                     .codec = codec };
+  const size_t pad = _record_size(length) - sizeof(rec) - length;
+  return fwrite(&rec, sizeof(rec), 1, f) != 1
+         || (length && fwrite(blob, length, 1, f) != 1)
+         || (pad && fwrite(zeros, pad, 1, f) != 1);
+}
+
+static gint _sort_by_offset(gconstpointer a, gconstpointer b)
+{
+  const _thumbstore_entry_t *ea = a, *eb = b;
+  return (ea->offset > eb->offset) - (ea->offset < eb->offset);
+}
+
+// rewrite the file with only the live records
+static void _compact(dt_thumbstore_t *store)
+{
+  gchar *tmpname = g_strdup_printf("%s.tmp", store->filename);
+  FILE *f = g_fopen(tmpname, "wb");
+  if(!f)
+  {
+    g_free(tmpname);
+    return;
+  }
+
+  gboolean error = fwrite(DT_THUMBSTORE_MAGIC, DT_THUMBSTORE_MAGIC_LEN, 1, f) != 1;
+  uint64_t offset = DT_THUMBSTORE_MAGIC_LEN;
+
+  GHashTableIter iter;
+  gpointer key, value;
+  GList *entries = NULL;
+  g_hash_table_iter_init(&iter, store->index);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+    entries = g_list_prepend(entries, value);
+  entries = g_list_sort(entries, _sort_by_offset);
+
+  // the new offsets can only be applied once the file is in place
+  uint64_t *offsets = g_malloc_n(MAX(1, g_list_length(entries)), sizeof(uint64_t));
+  int k = 0;
+  for(GList *l = entries; l && !error; l = g_list_next(l), k++)
+  {
+    const _thumbstore_entry_t *entry = l->data;
+    _thumbstore_record_t rec;
+    memcpy(&rec, store->data + entry->offset, sizeof(rec));
+    error = _write_record(f, rec.imgid, store->data + entry->offset + sizeof(rec),
+                          entry->length, entry->color_space, entry->codec);
+    offsets[k] = offset;
+    offset += _record_size(entry->length);
+  }
+  error |= fclose(f) != 0;
+
+  if(!error)
+  {
+    // nothing may keep the old file open while it is replaced (windows)
+    g_mapped_file_unref(store->map);
+    store->map = NULL;
+    fclose(store->file);
+    g_unlink(store->filename);
+    error = g_rename(tmpname, store->filename) != 0;
+    store->file = g_fopen(store->filename, "ab");
+    _remap(store);
+  }
+
+  if(!error && store->file && store->data)
+  {
+    k = 0;
+    for(GList *l = entries; l; l = g_list_next(l), k++)
+      ((_thumbstore_entry_t *)l->data)->offset = offsets[k];
+    dt_print(DT_DEBUG_CACHE, "[thumbstore] compacted `%s' from %" PRIu64 " to %" PRIu64 " bytes",
+             store->filename, store->end, offset);
+    store->end = offset;
+    store->dead = 0;
+  }
+  else
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[thumbstore] failed to compact `%s'", store->filename);
+    g_unlink(tmpname);
+    if(!store->data && store->file)
+    {
+      // the old file is gone, start over with an empty one
+      g_hash_table_remove_all(store->index);
+      if(fwrite(DT_THUMBSTORE_MAGIC, DT_THUMBSTORE_MAGIC_LEN, 1, store->file) == 1
+         && !fflush(store->file))
+        _remap(store);
+      store->end = store->mapped;
+      store->dead = 0;
+    }
+  }
+
+  g_free(offsets);
+  g_list_free(entries);
+  g_free(tmpname);
+}
+
+static gboolean _valid_header(const dt_thumbstore_t *store)
+{
+  return store->data
+    && store->mapped >= DT_THUMBSTORE_MAGIC_LEN
+    && !memcmp(store->data, DT_THUMBSTORE_MAGIC, DT_THUMBSTORE_MAGIC_LEN);
+}
+
+dt_thumbstore_t *dt_thumbstore_open(const char *filename)
+{
+  dt_thumbstore_t *store = g_malloc0(sizeof(dt_thumbstore_t));
+  store->filename = g_strdup(filename);
+  store->index = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  dt_pthread_rwlock_init(&store->lock, NULL);
+
+  for(int attempt = 0; attempt < 2; attempt++)
+  {
+    store->file = g_fopen(filename, "ab");
+    if(!store->file) break;
+    _remap(store);
+    if(store->map && store->mapped == 0)
+    {
+      if(fwrite(DT_THUMBSTORE_MAGIC, DT_THUMBSTORE_MAGIC_LEN, 1, store->file) == 1
+         && !fflush(store->file))
+        _remap(store);
+    }
+    if(_valid_header(store)) break;
+
+    // not one of ours, or broken beyond repair. it's just a cache, start over.
+    dt_print(DT_DEBUG_ALWAYS, "[thumbstore] discarding invalid thumbnail store `%s'", filename);
+    if(store->map) g_mapped_file_unref(store->map);
+    store->map = NULL;
+    store->data = NULL;
+    fclose(store->file);
+    store->file = NULL;
+    g_unlink(filename);
+  }
+
+  if(!store->file || !_valid_header(store))
+  {
+    dt_thumbstore_close(store);
+    return NULL;
+  }
+
+  store->end = _scan(store);
+  const gboolean broken_tail = store->end < store->mapped;
+  if(broken_tail
+     || (store->end > DT_THUMBSTORE_COMPACT_MIN && 2 * store->dead > store->end))
+    _compact(store);
+
+  dt_print(DT_DEBUG_CACHE, "[thumbstore] opened `%s', %u thumbnails, %" PRIu64 " bytes",
+           filename, g_hash_table_size(store->index), store->end);
+  return store;
+}
+
+void dt_thumbstore_close(dt_thumbstore_t *store)
+{
+  if(!store) return;
+  dt_pthread_rwlock_destroy(&store->lock);
+  if(store->map) g_mapped_file_unref(store->map);
+  if(store->file) fclose(store->file);
+  g_hash_table_destroy(store->index);
+  g_free(store->filename);
+  g_free(store);
+}
+
+gboolean dt_thumbstore_contains(dt_thumbstore_t *store, const dt_imgid_t imgid)
+{
+  if(!store) return FALSE;
+  dt_pthread_rwlock_rdlock(&store->lock);
+  const gboolean found = g_hash_table_contains(store->index, GINT_TO_POINTER(imgid));
+  dt_pthread_rwlock_unlock(&store->lock);
+  return found;
+}
+
+const uint8_t *dt_thumbstore_get(dt_thumbstore_t *store,
+                                 const dt_imgid_t imgid,
+                                 size_t *length,
+                                 int *color_space,
+                                 dt_thumbstore_codec_t *codec)
+{
+  if(!store) return NULL;
+
+  dt_pthread_rwlock_rdlock(&store->lock);
+  const _thumbstore_entry_t *entry = g_hash_table_lookup(store->index, GINT_TO_POINTER(imgid));
+  if(entry && entry->offset + _record_size(entry->length) > store->mapped)
+  {
+    // appended after the file was mapped, can't upgrade the lock in place
+    dt_pthread_rwlock_unlock(&store->lock);
+    dt_pthread_rwlock_wrlock(&store->lock);
+    if(store->end > store->mapped) _remap(store);
+    dt_pthread_rwlock_unlock(&store->lock);
+    dt_pthread_rwlock_rdlock(&store->lock);
+    entry = g_hash_table_lookup(store->index, GINT_TO_POINTER(imgid));
+  }
+
+  if(!entry || !store->data || entry->offset + _record_size(entry->length) > store->mapped)
+  {
+    dt_pthread_rwlock_unlock(&store->lock);
+    return NULL;
+  }
+
+  *length = entry->length;
+  *color_space = entry->color_space;
+  *codec = entry->codec;
+  return store->data + entry->offset + sizeof(_thumbstore_record_t);
+}
+
+void dt_thumbstore_release(dt_thumbstore_t *store)
+{
+  dt_pthread_rwlock_unlock(&store->lock);
+}
+
+gboolean dt_thumbstore_put(dt_thumbstore_t *store,
+                           const dt_imgid_t imgid,
+                           const uint8_t *blob,
+                           const size_t length,
+                           const int color_space,
+                           const dt_thumbstore_codec_t codec)
+{
+  if(!store || !store->file || !length || length > G_MAXUINT32) return TRUE;
+
+  dt_pthread_rwlock_wrlock(&store->lock);
+  const gboolean error = _write_record(store->file, imgid, blob, length, color_space, codec)
+                         || fflush(store->file);
+  if(!error)
+  {
+    _index_insert(store, imgid, store->end, length, color_space, codec);
+    store->end += _record_size(length);
+  }
+  else
+  {
+    // whatever was written is unreachable behind a broken record, the next
+    // open cuts it off
+    dt_print(DT_DEBUG_ALWAYS, "[thumbstore] failed to append ID=%d to `%s'", imgid, store->filename);
+  }
+  dt_pthread_rwlock_unlock(&store->lock);
+  return error;
+}
+
+void dt_thumbstore_remove(dt_thumbstore_t *store, const dt_imgid_t imgid)
+{
+  if(!store) return;
+
+  dt_pthread_rwlock_wrlock(&store->lock);
+  if(g_hash_table_contains(store->index, GINT_TO_POINTER(imgid)))
+  {
+    if(!store->file
+       || _write_record(store->file, imgid, NULL, 0, 0, DT_THUMBSTORE_CODEC_JPEG)
+       || fflush(store->file))
+      dt_print(DT_DEBUG_ALWAYS, "[thumbstore] failed to remove ID=%d from `%s'", imgid, store->filename);
+    else
+      store->end += _record_size(0);
+    // forget it in any case, it's outdated
+    _index_insert(store, imgid, 0, 0, 0, DT_THUMBSTORE_CODEC_JPEG);
+  }
+  dt_pthread_rwlock_unlock(&store->lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,74 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+#include <glib.h>
+#include <inttypes.h>
+
+G_BEGIN_DECLS
+
+// packed on-disk thumbnail store: one append-only file holding the encoded
+// thumbnails of all images of one mip level, plus an in-memory imgid -> offset
+// index rebuilt from the record headers when the file is opened. reads are
+// served straight out of a read-only mapping of the file.
+typedef struct dt_thumbstore_t dt_thumbstore_t;
+
+// how a blob is encoded, stored alongside it
+typedef enum dt_thumbstore_codec_t
+{
+  DT_THUMBSTORE_CODEC_JPEG = 0,
+  DT_THUMBSTORE_CODEC_QOI = 1,
+  DT_THUMBSTORE_CODEC_RAW = 2, // width, height as uint32 followed by 8 bit RGBA
+} dt_thumbstore_codec_t;
+
+// open or create the store in filename, returns NULL if the file can't be used
+dt_thumbstore_t *dt_thumbstore_open(const char *filename);
+void dt_thumbstore_close(dt_thumbstore_t *store);
+
+gboolean dt_thumbstore_contains(dt_thumbstore_t *store, const dt_imgid_t imgid);
+
+// returns a pointer to the blob of imgid inside the mapping, or NULL.
+// on success the store stays read locked until dt_thumbstore_release().
+const uint8_t *dt_thumbstore_get(dt_thumbstore_t *store,
+                                 const dt_imgid_t imgid,
+                                 size_t *length,
+                                 int *color_space,
+                                 dt_thumbstore_codec_t *codec);
+void dt_thumbstore_release(dt_thumbstore_t *store);
+
+// append the blob of imgid, replacing an older one. returns TRUE on error.
+gboolean dt_thumbstore_put(dt_thumbstore_t *store,
+                           const dt_imgid_t imgid,
+                           const uint8_t *blob,
+                           const size_t length,
+                           const int color_space,
+                           const dt_thumbstore_codec_t codec);
+
+// drop imgid from the store, a no-op if it isn't there
+void dt_thumbstore_remove(dt_thumbstore_t *store, const dt_imgid_t imgid);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
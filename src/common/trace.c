@@ -0,0 +1,123 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/trace.h"
+#include "common/darktable.h"
+
+#include <glib/gstdio.h>
+#include <inttypes.h>
+
+static FILE *_trace = NULL;
+static dt_pthread_mutex_t _trace_mutex;
+static double _trace_start = 0.0;
+static dt_atomic_int _trace_threads;
+
+// small per-thread ids keep the timeline readable
+static __thread int _trace_tid = 0;
+
+static int _thread_id(void)
+{
+  if(_trace_tid == 0)
+    _trace_tid = dt_atomic_add_int(&_trace_threads, 1) + 1;
+  return _trace_tid;
+}
+
+static void _write_escaped(FILE *f, const char *s)
+{
+  for(; s && *s; s++)
+  {
+    const unsigned char c = *s;
+    if(c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if(c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+}
+
+gboolean dt_trace_init(const char *filename)
+{
+  if(_trace || !filename) return FALSE;
+
+  FILE *f = g_fopen(filename, "wb");
+  if(!f)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[trace] can't open `%s' for writing", filename);
+    return FALSE;
+  }
+
+  dt_pthread_mutex_init(&_trace_mutex, NULL);
+  dt_atomic_set_int(&_trace_threads, 0);
+  _trace_start = dt_get_wtime();
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+             "\"args\":{\"name\":\"darktable\"}}");
+  _trace = f;
+  return TRUE;
+}
+
+void dt_trace_cleanup(void)
+{
+  if(!_trace) return;
+
+  dt_pthread_mutex_lock(&_trace_mutex);
+  fprintf(_trace, "\n]}\n");
+  fclose(_trace);
+  _trace = NULL;
+  dt_pthread_mutex_unlock(&_trace_mutex);
+  dt_pthread_mutex_destroy(&_trace_mutex);
+}
+
+gboolean dt_trace_enabled(void)
+{
+  return _trace != NULL;
+}
+
+void dt_trace_event(const char *name,
+                    const char *category,
+                    const double start,
+                    const double end,
+                    const char *args)
+{
+  if(!_trace) return;
+
+  // integer microseconds don't depend on the numeric locale
+  const int tid = _thread_id();
+  const int64_t ts = (int64_t)(1e6 * (start - _trace_start));
+  const int64_t dur = (int64_t)(1e6 * MAX(0.0, end - start));
+
+  dt_pthread_mutex_lock(&_trace_mutex);
+  if(_trace)
+  {
+    fprintf(_trace, ",\n{\"name\":\"");
+    _write_escaped(_trace, name);
+    fprintf(_trace, "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%" PRId64 ",\"dur\":%" PRId64,
+            category ? category : "", tid, ts, dur);
+    if(args) fprintf(_trace, ",\"args\":{%s}", args);
+    fprintf(_trace, "}");
+  }
+  dt_pthread_mutex_unlock(&_trace_mutex);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
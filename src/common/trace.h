@@ -0,0 +1,56 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* structured performance trace in the Chrome trace event format, written
+   when darktable is started with --trace FILE. the file can be loaded into
+   Perfetto (ui.perfetto.dev) or chrome://tracing. events are written as
+   they complete, the closing bracket is added by dt_trace_cleanup() but
+   both viewers also accept a file cut short by a crash. */
+
+/** open the trace file, returns FALSE if it can't be written */
+gboolean dt_trace_init(const char *filename);
+
+/** finish and close the trace file */
+void dt_trace_cleanup(void);
+
+/** TRUE if a trace is being written */
+gboolean dt_trace_enabled(void);
+
+/** write a complete event of the calling thread. start and end are
+    dt_get_wtime() values, `args` holds the members of the JSON args
+    object without the braces or is NULL. name gets escaped, category
+    and args are written verbatim. */
+void dt_trace_event(const char *name,
+                    const char *category,
+                    const double start,
+                    const double end,
+                    const char *args);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
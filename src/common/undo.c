@@ -21,6 +21,7 @@
 #include "common/darktable.h"
 #include "common/image.h"
 #include "common/image_cache.h"
+#include "common/memory_account.h"
 #include "control/control.h"
 #include <glib.h>   // for GList, gpointer, g_list_prepend
 #include <stdlib.h> // for NULL, malloc, free
@@ -81,6 +82,7 @@ static void _free_undo_data(void *p)
   dt_undo_item_t *item = (dt_undo_item_t *)p;
   if(item->free_data) item->free_data(item->data);
   free(item);
+  dt_mem_account_free(DT_MEM_ACCOUNT_UNDO, sizeof(dt_undo_item_t));
 }
 
 static void _undo_record(dt_undo_t *self,
@@ -108,6 +110,7 @@ static void _undo_record(dt_undo_t *self,
   else
   {
     dt_undo_item_t *item = malloc(sizeof(dt_undo_item_t));
+    dt_mem_account_alloc(DT_MEM_ACCOUNT_UNDO, sizeof(dt_undo_item_t));
 
     item->user_data = user_data;
     item->type      = type;
@@ -102,10 +102,106 @@ typedef struct dt_variables_data_t
 
   int flags;
 
+  // values read from the database for values_imgid, kept for all the
+  // expansions done with the same params (e.g. the metadata of an export)
+  dt_imgid_t values_imgid;
+  GHashTable *values;     // "TAGS", "CATEGORY"... variable -> value
+  GHashTable *metadata;   // metadata keyid -> value, NULL until needed
+  GList *color_labels;    // read with color_labels_read
+  gboolean color_labels_read;
+  int duplicates;         // images of the same file, -1 until needed
+
 } dt_variables_data_t;
 
 static char *_expand_source(dt_variables_params_t *params, char **source, char extra_stop);
 
+static void _reset_image_values(dt_variables_data_t *data,
+                                const dt_imgid_t imgid)
+{
+  if(data->values && data->values_imgid == imgid) return;
+
+  if(!data->values)
+    data->values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  g_hash_table_remove_all(data->values);
+  if(data->metadata) g_hash_table_destroy(data->metadata);
+  data->metadata = NULL;
+  g_list_free(data->color_labels);
+  data->color_labels = NULL;
+  data->color_labels_read = FALSE;
+  data->duplicates = -1;
+  data->values_imgid = imgid;
+}
+
+// the value of a database backed variable of the image, key includes
+// whatever the value depends on. TRUE if it has been computed already.
+// without an image the variables are about the selection, nothing is kept.
+static gboolean _get_image_value(dt_variables_params_t *params,
+                                 const char *key,
+                                 char **result)
+{
+  gpointer value;
+  if(!dt_is_valid_imgid(params->imgid)
+     || !g_hash_table_lookup_extended(params->data->values, key, NULL, &value)) return FALSE;
+  *result = g_strdup(value);
+  return TRUE;
+}
+
+static void _set_image_value(dt_variables_params_t *params,
+                             const char *key,
+                             const char *value)
+{
+  if(dt_is_valid_imgid(params->imgid))
+    g_hash_table_insert(params->data->values, g_strdup(key), g_strdup(value));
+}
+
+// all the metadata of the image are read at once, to be freed. metadata
+// lock held.
+static char *_get_image_metadata(dt_variables_params_t *params,
+                                 const char *tagname,
+                                 const uint32_t keyid)
+{
+  dt_variables_data_t *data = params->data;
+  if(!dt_is_valid_imgid(params->imgid))
+  {
+    GList *res = dt_metadata_get(params->imgid, tagname, NULL);
+    char *result = res ? g_strdup((char *)res->data) : NULL;
+    g_list_free_full(res, g_free);
+    return result;
+  }
+
+  if(!data->metadata)
+  {
+    data->metadata = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT key, value FROM main.meta_data WHERE id = ?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, params->imgid);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const char *value = (const char *)sqlite3_column_text(stmt, 1);
+      g_hash_table_insert(data->metadata, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)),
+                          g_strdup(value ? value : ""));
+    }
+    sqlite3_finalize(stmt);
+  }
+  return g_strdup(g_hash_table_lookup(data->metadata, GUINT_TO_POINTER(keyid)));
+}
+
+// the color labels of the image, owned by params
+static GList *_get_image_color_labels(dt_variables_params_t *params)
+{
+  dt_variables_data_t *data = params->data;
+  if(!data->color_labels_read || !dt_is_valid_imgid(params->imgid))
+  {
+    g_list_free(data->color_labels);
+    data->color_labels =
+      dt_metadata_get_lock(params->imgid, "Xmp.darktable.colorlabels", NULL);
+    data->color_labels_read = TRUE;
+  }
+  return data->color_labels;
+}
+
 
 // gather some data that might be used for variable expansion
 static void _init_expansion(dt_variables_params_t *params, gboolean iterate)
@@ -153,6 +249,7 @@ static void _init_expansion(dt_variables_params_t *params, gboolean iterate)
   params->data->show_msec = dt_conf_get_bool("lighttable/ui/milliseconds");
   params->data->camera_maker = NULL;
   params->data->camera_alias = NULL;
+  _reset_image_values(params->data, params->imgid);
   if(dt_is_valid_imgid(params->imgid))
   {
     const dt_image_t *img = params->img
@@ -261,6 +358,21 @@ static void _cleanup_expansion(dt_variables_params_t *params)
   params->data->pictures_folder = NULL;
 }
 
+static char *_get_image_subtags(dt_variables_params_t *params,
+                                const char *category,
+                                const uint8_t level)
+{
+  char *result = NULL;
+  gchar *key = g_strdup_printf("CATEGORY%d %s", level, category);
+  if(!_get_image_value(params, key, &result))
+  {
+    result = dt_tag_get_subtags(params->imgid, category, (int)level);
+    _set_image_value(params, key, result);
+  }
+  g_free(key);
+  return result;
+}
+
 static inline gboolean _has_prefix(char **str, const char *prefix)
 {
   const gboolean res = g_str_has_prefix(*str, prefix);
@@ -603,39 +715,41 @@ static char *_get_base_value(dt_variables_params_t *params, char **variable)
   else if(_has_prefix(variable, "VERSION.NAME")
           || _has_prefix(variable, "VERSION_NAME"))
   {
-    GList *res = dt_metadata_get_lock(params->imgid, "Xmp.darktable.version_name", NULL);
-    if(res != NULL)
-    {
-      result = g_strdup((char *)res->data);
-    }
-    g_list_free_full(res, &g_free);
+    dt_pthread_mutex_lock(&darktable.metadata_threadsafe);
+    const char *tagname = "Xmp.darktable.version_name";
+    const int keyid = dt_metadata_get_keyid(tagname);
+    if(keyid != -1)
+      result = _get_image_metadata(params, tagname, keyid);
+    dt_pthread_mutex_unlock(&darktable.metadata_threadsafe);
   }
   else if(_has_prefix(variable, "VERSION.IF_MULTI")
           || _has_prefix(variable, "VERSION_IF_MULTI"))
   {
-    sqlite3_stmt *stmt;
-
-    // count duplicates
-    // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT COUNT(1)"
-                                " FROM images AS i1"
-                                " WHERE EXISTS (SELECT 'y' FROM images AS i2"
-                                "               WHERE  i2.id = ?1"
-                                "               AND    i1.film_id = i2.film_id"
-                                "               AND    i1.filename = i2.filename)",
-                                -1, &stmt, NULL);
-    // clang-format on
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, params->imgid);
-
-    if(sqlite3_step(stmt) == SQLITE_ROW)
+    if(params->data->duplicates < 0)
     {
-      const int count = sqlite3_column_int(stmt, 0);
-      //only return data if more than one matching image
-      if(count > 1)
-        result = g_strdup_printf("%d", params->data->version);
+      sqlite3_stmt *stmt;
+
+      // count duplicates
+      // clang-format off
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                  "SELECT COUNT(1)"
+                                  " FROM images AS i1"
+                                  " WHERE EXISTS (SELECT 'y' FROM images AS i2"
+                                  "               WHERE  i2.id = ?1"
+                                  "               AND    i1.film_id = i2.film_id"
+                                  "               AND    i1.filename = i2.filename)",
+                                  -1, &stmt, NULL);
+      // clang-format on
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, params->imgid);
+
+      params->data->duplicates = 0;
+      if(sqlite3_step(stmt) == SQLITE_ROW)
+        params->data->duplicates = sqlite3_column_int(stmt, 0);
+      sqlite3_finalize (stmt);
     }
-    sqlite3_finalize (stmt);
+    //only return data if more than one matching image
+    if(params->data->duplicates > 1)
+      result = g_strdup_printf("%d", params->data->version);
   }
   else if(_has_prefix(variable, "VERSION"))
     result = g_strdup_printf("%d", params->data->version);
@@ -780,8 +894,9 @@ static char *_get_base_value(dt_variables_params_t *params, char **variable)
           && g_strcmp0(params->jobcode, "infos") == 0)
   {
     escape = FALSE;
-    GList *res = dt_metadata_get_lock(params->imgid, "Xmp.darktable.colorlabels", NULL);
-    for(GList *res_iter = res; res_iter; res_iter = g_list_next(res_iter))
+    for(GList *res_iter = _get_image_color_labels(params);
+        res_iter;
+        res_iter = g_list_next(res_iter))
     {
       const int dot_index = GPOINTER_TO_INT(res_iter->data);
       const GdkRGBA c = darktable.bauhaus->colorlabels[dot_index];
@@ -790,14 +905,13 @@ static char *_get_base_value(dt_variables_params_t *params, char **variable)
          "<span foreground='#%02x%02x%02x'>⬤ </span>",
          (guint)(c.red*255), (guint)(c.green*255), (guint)(c.blue*255));
     }
-    g_list_free(res);
   }
   else if(_has_prefix(variable, "LABELS"))
   {
     // TODO: currently we concatenate all the color labels with a ','
     // as a separator. Maybe it's better to only use the first/last
     // label?
-    GList *res = dt_metadata_get_lock(params->imgid, "Xmp.darktable.colorlabels", NULL);
+    GList *res = _get_image_color_labels(params);
     if(res != NULL)
     {
       GList *labels = NULL;
@@ -811,7 +925,6 @@ static char *_get_base_value(dt_variables_params_t *params, char **variable)
       result = dt_util_glist_to_str(",", labels);
       g_list_free(labels);
     }
-    g_list_free(res);
   }
   else if(_has_prefix(variable, "OPENCL.ACTIVATED")
           || _has_prefix(variable, "OPENCL_ACTIVATED"))
@@ -883,12 +996,7 @@ static char *_get_base_value(dt_variables_params_t *params, char **variable)
           end[0] = '|';
           end[1] = '\0';
           (*variable) += strlen(category) + 1;
-          char *tag = dt_tag_get_subtags(params->imgid, category, (int)level);
-          if(tag)
-          {
-            result = g_strdup(tag);
-            g_free(tag);
-          }
+          result = _get_image_subtags(params, category, level);
         }
         g_free(category);
       }
@@ -903,13 +1011,8 @@ static char *_get_base_value(dt_variables_params_t *params, char **variable)
       {
         const uint8_t level = (uint8_t)*level_s & 0b1111;
         gchar *cat = g_strdup_printf("%s|", category);
-        char *tag = dt_tag_get_subtags(params->imgid, cat, (int)level);
+        result = _get_image_subtags(params, cat, level);
         g_free(cat);
-        if(tag)
-        {
-          result = g_strdup(tag);
-          g_free(tag);
-        }
       }
       g_free(level_s);
       g_free(category);
@@ -917,17 +1020,28 @@ static char *_get_base_value(dt_variables_params_t *params, char **variable)
   }
   else if(_has_prefix(variable, "IMAGE.TAGS.HIERARCHY"))
   {
-    GList *tags_list = dt_tag_get_hierarchical_export(params->imgid, params->data->tags_flags);
-    result = dt_util_glist_to_str(", ", tags_list);
-    g_list_free_full(tags_list, g_free);
+    gchar *key = g_strdup_printf("IMAGE.TAGS.HIERARCHY %u", params->data->tags_flags);
+    if(!_get_image_value(params, key, &result))
+    {
+      GList *tags_list = dt_tag_get_hierarchical_export(params->imgid,
+                                                        params->data->tags_flags);
+      result = dt_util_glist_to_str(", ", tags_list);
+      g_list_free_full(tags_list, g_free);
+      _set_image_value(params, key, result);
+    }
+    g_free(key);
   }
   else if(_has_prefix(variable, "TAGS") || _has_prefix(variable, "IMAGE.TAGS"))
   {
-    GList *tags_list = dt_tag_get_list_export(params->imgid, params->data->tags_flags);
-    char *tags = dt_util_glist_to_str(", ", tags_list);
-    g_list_free_full(tags_list, g_free);
-    result = g_strdup(tags);
-    g_free(tags);
+    gchar *key = g_strdup_printf("TAGS %u", params->data->tags_flags);
+    if(!_get_image_value(params, key, &result))
+    {
+      GList *tags_list = dt_tag_get_list_export(params->imgid, params->data->tags_flags);
+      result = dt_util_glist_to_str(", ", tags_list);
+      g_list_free_full(tags_list, g_free);
+      _set_image_value(params, key, result);
+    }
+    g_free(key);
   }
   else if(_has_prefix(variable, "SIDECAR_TXT")
           && g_strcmp0(params->jobcode, "infos") == 0
@@ -962,10 +1076,7 @@ static char *_get_base_value(dt_variables_params_t *params, char **variable)
       gboolean found = FALSE;
       if(_has_prefix(variable, metadata->tagname))
       {
-        GList *res = dt_metadata_get(params->imgid, metadata->tagname, NULL);
-        if(res != NULL)
-          	result = g_strdup((char *)res->data);
-        g_list_free_full(res, g_free);
+        result = _get_image_metadata(params, metadata->tagname, metadata->key);
         found = TRUE;
       }
       if(found) break;
@@ -1417,6 +1528,9 @@ void dt_variables_params_destroy(dt_variables_params_t *params)
   g_free(params->data->exif_lens);
   g_free(params->data->camera_maker);
   g_free(params->data->camera_alias);
+  if(params->data->values) g_hash_table_destroy(params->data->values);
+  if(params->data->metadata) g_hash_table_destroy(params->data->metadata);
+  g_list_free(params->data->color_labels);
   g_free(params->data);
   g_free(params);
 }
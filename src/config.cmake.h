@@ -76,6 +76,10 @@ static const char *dt_supported_extensions[] __attribute__((unused)) = {"@DT_SUP
 
 #cmakedefine HAVE_THREAD_RWLOCK_ARCH_T_NR_READERS 1
 
+// instruction sets of the x86_64 variants built for functions marked __DT_CLONE_TARGETS__
+#cmakedefine USE_TARGET_CLONES 1
+#define DT_TARGET_CLONES_X86_64 "@DT_TARGET_CLONES_X86_64_STRING@"
+
 /******************************************************************************
  * OpenCL target settings
  * OpenCL 1.2 is the version supported by Apple, otherwise we use 3.0
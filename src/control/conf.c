@@ -69,6 +69,8 @@ fin:
   return str;
 }
 
+static void _conf_handle_update(dt_conf_handle_t *handle);
+
 /* set the value only if it hasn't been overridden from commandline
  * return 1 if key/value is still the one passed on commandline. */
 static int _conf_set_if_not_overridden(const char *name, char *str)
@@ -81,9 +83,12 @@ static int _conf_set_if_not_overridden(const char *name, char *str)
   {
     g_hash_table_insert(darktable.conf->table, g_strdup(name), str);
   }
+  dt_conf_handle_t *handle = g_hash_table_lookup(darktable.conf->handles, name);
 
   dt_pthread_mutex_unlock(&darktable.conf->mutex);
 
+  if(handle && !is_overridden) _conf_handle_update(handle);
+
   return is_overridden;
 }
 
@@ -311,6 +316,70 @@ gboolean dt_conf_get_bool(const char *name)
   return (str[0] != 'F') && (str[0] != 'f') && (str[0] != '0') && (str[0] != '\0');
 }
 
+static int _conf_handle_read(const dt_conf_handle_t *handle)
+{
+  switch(handle->type)
+  {
+    case DT_BOOL:
+      return dt_conf_get_bool(handle->name);
+    case DT_FLOAT:
+    {
+      const float value = dt_conf_get_float(handle->name);
+      int bits;
+      memcpy(&bits, &value, sizeof(bits));
+      return bits;
+    }
+    default:
+      return dt_conf_get_int(handle->name);
+  }
+}
+
+static void _conf_handle_update(dt_conf_handle_t *handle)
+{
+  dt_atomic_set_int(&handle->value, _conf_handle_read(handle));
+  dt_atomic_add_int(&handle->serial, 1);
+}
+
+dt_conf_handle_t *dt_conf_handle(const char *name,
+                                 const dt_confgen_type_t type)
+{
+  dt_pthread_mutex_lock(&darktable.conf->mutex);
+  dt_conf_handle_t *handle = g_hash_table_lookup(darktable.conf->handles, name);
+  dt_pthread_mutex_unlock(&darktable.conf->mutex);
+  if(handle) return handle;
+
+  // the value is read before the handle is published, the conf
+  // getters take the mutex themselves
+  dt_conf_handle_t *new_handle = g_malloc0(sizeof(dt_conf_handle_t));
+  new_handle->name = g_strdup(name);
+  new_handle->type = type;
+  dt_atomic_set_int(&new_handle->value, _conf_handle_read(new_handle));
+
+  dt_pthread_mutex_lock(&darktable.conf->mutex);
+  handle = g_hash_table_lookup(darktable.conf->handles, name);
+  if(!handle)
+  {
+    g_hash_table_insert(darktable.conf->handles, new_handle->name, new_handle);
+    handle = new_handle;
+    new_handle = NULL;
+  }
+  dt_pthread_mutex_unlock(&darktable.conf->mutex);
+
+  if(new_handle)
+  {
+    g_free(new_handle->name);
+    g_free(new_handle);
+  }
+  return handle;
+}
+
+static void _conf_handle_free(gpointer data)
+{
+  dt_conf_handle_t *handle = data;
+  g_free(handle->name);
+  g_free(handle);
+}
+
 void dt_conf_set_path(const char *name, const char *val)
 {
   dt_conf_set_string(name, val);
@@ -537,6 +606,7 @@ void dt_conf_init(dt_conf_t *cf,
   {
     cf->table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     cf->override_entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    cf->handles = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _conf_handle_free);
     dt_pthread_mutex_init(&darktable.conf->mutex, NULL);
   }
 
@@ -586,7 +656,11 @@ void dt_conf_remove_key(const char *key)
 {
   dt_pthread_mutex_lock(&darktable.conf->mutex);
   g_hash_table_remove(darktable.conf->table, key);
+  dt_conf_handle_t *handle = g_hash_table_lookup(darktable.conf->handles, key);
   dt_pthread_mutex_unlock(&darktable.conf->mutex);
+
+  // back to the default
+  if(handle) _conf_handle_update(handle);
 }
 
 static void _conf_add(char *key, char *val, dt_conf_dreggn_t *d)
@@ -936,6 +1010,7 @@ void dt_conf_cleanup(dt_conf_t *cf)
   _conf_save(cf);
   g_hash_table_unref(cf->table);
   g_hash_table_unref(cf->override_entries);
+  g_hash_table_unref(cf->handles);
   g_hash_table_unref(cf->x_confgen);
   dt_pthread_mutex_destroy(&darktable.conf->mutex);
 }
@@ -18,11 +18,13 @@
 
 #pragma once
 
+#include "common/atomic.h"
 #include "common/dtpthread.h"
 
 #include <glib.h>
 #include <gtk/gtk.h>
 #include <inttypes.h>
+#include <string.h>
 
 G_BEGIN_DECLS
 
@@ -61,8 +63,20 @@ typedef struct dt_conf_t
   GHashTable *table;
   GHashTable *x_confgen;
   GHashTable *override_entries;
+  GHashTable *handles;
 } dt_conf_t;
 
+/** typed handle of an int, bool or float key, for reads in process,
+    draw and expose functions. it is resolved once and read without
+    locking, dt_conf_set_* updates its value and bumps its serial. */
+typedef struct dt_conf_handle_t
+{
+  char *name;
+  dt_confgen_type_t type;
+  dt_atomic_int value;  // int, bool or the bits of a float
+  dt_atomic_int serial; // number of changes
+} dt_conf_handle_t;
+
 typedef struct dt_conf_string_entry_t
 {
   char *key;
@@ -116,6 +130,36 @@ gboolean dt_conf_key_not_empty(const char *key);
 GSList *dt_conf_all_string_entries(const char *dir);
 void dt_conf_string_entry_free(gpointer data);
 
+/** the handle of name, the same for all callers. keep it, it stays valid. */
+dt_conf_handle_t *dt_conf_handle(const char *name, const dt_confgen_type_t type);
+
+static inline int dt_conf_handle_get_int(dt_conf_handle_t *handle)
+{
+  return dt_atomic_get_int(&handle->value);
+}
+
+static inline gboolean dt_conf_handle_get_bool(dt_conf_handle_t *handle)
+{
+  return dt_atomic_get_int(&handle->value) != 0;
+}
+
+static inline float dt_conf_handle_get_float(dt_conf_handle_t *handle)
+{
+  const int bits = dt_atomic_get_int(&handle->value);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/** TRUE if the key has changed since *serial, which is updated */
+static inline gboolean dt_conf_handle_changed(dt_conf_handle_t *handle, int *serial)
+{
+  const int current = dt_atomic_get_int(&handle->serial);
+  const gboolean changed = current != *serial;
+  *serial = current;
+  return changed;
+}
+
 #define DT_CONF_SET_SANITIZED_INT(name, val, min, max) dt_conf_set_int(name, CLAMPS(val, min,max));
 #define DT_CONF_SET_SANITIZED_INT6464(name, val, min, max) dt_conf_set_int(name, CLAMPS(val, min,max));
 #define DT_CONF_SET_SANITIZED_FLOAT(name, val, min, max) dt_conf_set_float(name, CLAMPS(val, min,max));
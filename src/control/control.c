@@ -236,7 +236,6 @@ void dt_control_init(const gboolean withgui)
 
   pthread_cond_init(&s->cond, NULL);
   dt_pthread_mutex_init(&s->cond_mutex, NULL);
-  dt_pthread_mutex_init(&s->queue_mutex, NULL);
   dt_pthread_mutex_init(&s->res_mutex, NULL);
   dt_pthread_mutex_init(&s->global_mutex, NULL);
   dt_pthread_mutex_init(&s->progress_system.mutex, NULL);
@@ -444,13 +443,13 @@ void dt_control_shutdown()
 void dt_control_cleanup(const gboolean withgui)
 {
   dt_control_t *s = darktable.control;
+  // the workers also run without gui, their leftover jobs are dropped in both cases
+  dt_control_jobs_cleanup();
   if(withgui)
   {
     // vacuum TODO: optional?
     // DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "PRAGMA incremental_vacuum(0)", NULL, NULL, NULL);
     // DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "vacuum", NULL, NULL, NULL);
-    dt_control_jobs_cleanup();
-    dt_pthread_mutex_destroy(&s->queue_mutex);
     dt_pthread_mutex_destroy(&s->cond_mutex);
     dt_pthread_mutex_destroy(&s->log_mutex);
     dt_pthread_mutex_destroy(&s->log_history_mutex);
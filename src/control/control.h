@@ -125,6 +125,17 @@ typedef enum dt_control_state_t
   DT_CONTROL_STATE_CLEANUP  = -1
 } dt_control_state_t;
 
+/**
+ * per worker job queues, one per dt_job_queue_t. the owning worker
+ * schedules from them and idle workers steal from them.
+ */
+typedef struct dt_control_worker_queue_t
+{
+  dt_pthread_mutex_t lock;
+  GQueue queues[DT_JOB_QUEUE_MAX];
+  dt_job_t *running; // the job this worker executes right now (for job deduping)
+} dt_control_worker_queue_t;
+
 typedef struct dt_control_t
 {
   gboolean accel_initialised;
@@ -179,15 +190,19 @@ typedef struct dt_control_t
   dt_atomic_int quitting;
   dt_atomic_int pending_jobs;
   gboolean cups_started;
-  gboolean export_scheduled;
-  dt_pthread_mutex_t queue_mutex, cond_mutex;
+  dt_atomic_int export_scheduled;
+  dt_pthread_mutex_t cond_mutex;
   pthread_cond_t cond;
   int32_t num_threads;
   pthread_t *thread, kick_on_workers_thread, update_gphoto_thread;
-  dt_job_t **job;
 
-  GList *queues[DT_JOB_QUEUE_MAX];
-  size_t queue_length[DT_JOB_QUEUE_MAX];
+  // new jobs are pushed lock-free onto the inbox stack, the workers move them
+  // into their own queues and steal from each other when they run dry
+  dt_job_t *inbox;
+  dt_control_worker_queue_t *worker_queues;
+  dt_atomic_int queued_jobs;      // jobs in the inbox or any worker queue
+  dt_atomic_int queued_fg_jobs;   // DT_JOB_QUEUE_SYSTEM_FG jobs in the worker queues
+  dt_atomic_int job_generation;   // bumped on every submission, avoids lost wakeups
 
   dt_pthread_mutex_t res_mutex;
   dt_job_t *job_res[DT_CTL_WORKER_RESERVED];
@@ -109,193 +109,322 @@ static void _set_modification_time(char *filename,
 // progress update intervals in seconds
 #define FAST_UPDATE 0.2
 #define SLOW_UPDATE 1.0
+// images checked in parallel between two progress updates
+#define CRAWLER_BLOCK 256
+
+typedef struct _crawler_film_t
+{
+  gchar *folder;
+  time_t crawled; // folder mtime recorded after the last complete crawl
+  time_t mtime;   // folder mtime now, 0 if it can't be read
+  gboolean skip;
+  gboolean reported;
+} _crawler_film_t;
+
+typedef struct _crawler_entry_t
+{
+  dt_imgid_t id;
+  dt_filmid_t film_id;
+  time_t timestamp;
+  int version;
+  int flags;
+  gchar *image_path;
+  gboolean xmp_only; // its folder is unchanged, only the sidecar can be newer
+  // the outcome of the check
+  time_t xmp_mtime; // set if the xmp is newer than the database
+  gchar *xmp_path;
+  int new_flags;
+} _crawler_entry_t;
+
+static void _free_film(gpointer data)
+{
+  _crawler_film_t *film = data;
+  g_free(film->folder);
+  g_free(film);
+}
+
+static int _stat_file(const char *path,
+                      time_t *mtime)
+{
+  // on Windows the encoding might not be UTF8
+  gchar *path_locale = dt_util_normalize_path(path);
+  int stat_res = -1;
+#ifdef _WIN32
+  // UTF8 paths fail in this context, but converting to UTF16 works
+  struct _stati64 statbuf;
+  if(path_locale) // in Windows dt_util_normalize_path returns
+                  // NULL if file does not exist
+  {
+    wchar_t *wfilename = g_utf8_to_utf16(path_locale, -1, NULL, NULL, NULL);
+    stat_res = _wstati64(wfilename, &statbuf);
+    g_free(wfilename);
+  }
+#else
+  struct stat statbuf;
+  stat_res = path_locale ? stat(path_locale, &statbuf) : -1;
+#endif
+  g_free(path_locale);
+  if(!stat_res) *mtime = statbuf.st_mtime;
+  return stat_res;
+}
+
+// only touches the file system, runs in parallel
+static void _crawler_check(_crawler_entry_t *entry,
+                           const gboolean look_for_xmp)
+{
+  const gchar *image_path = entry->image_path;
+  entry->new_flags = entry->flags;
+
+  // if the image is missing we ignore it. in an unchanged folder it still is there
+  if(!entry->xmp_only && !g_file_test(image_path, G_FILE_TEST_EXISTS))
+  {
+    dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing", image_path, entry->id);
+    return;
+  }
+
+  // no need to look for xmp files if none get written anyway.
+  if(look_for_xmp)
+  {
+    // construct the xmp filename for this image
+    gchar xmp_path[PATH_MAX] = { 0 };
+    g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
+    dt_image_path_append_version_no_db(entry->version, xmp_path, sizeof(xmp_path));
+    size_t len = strlen(xmp_path);
+    if(len + 4 >= PATH_MAX) return;
+    xmp_path[len++] = '.';
+    xmp_path[len++] = 'x';
+    xmp_path[len++] = 'm';
+    xmp_path[len++] = 'p';
+    xmp_path[len] = '\0';
+
+    time_t xmp_mtime = 0;
+    if(_stat_file(xmp_path, &xmp_mtime)) return; // TODO: shall we report these?
+
+    // step 1: check if the xmp is newer than our db entry
+    if(entry->timestamp + MAX_TIME_SKEW < xmp_mtime)
+    {
+      entry->xmp_mtime = xmp_mtime;
+      entry->xmp_path = g_strdup(xmp_path);
+      dt_print(DT_DEBUG_CONTROL,
+               "[crawler] `%s' (id: %d) is a newer XMP file", xmp_path, entry->id);
+    }
+    // older timestamps are the case for all images after the db
+    // upgrade. better not report these
+  }
+
+  // .txt and .wav come and go with a change of the folder
+  if(entry->xmp_only) return;
+
+  // step 2: check if the image has associated files (.txt, .wav)
+  size_t len = strlen(image_path);
+  const char *c = image_path + len;
+  while((c > image_path) && (*c != '.')) c--;
+  len = c - image_path + 1;
+
+  char *extra_path = calloc(len + 3 + 1, sizeof(char));
+  if(extra_path)
+  {
+    g_strlcpy(extra_path, image_path, len + 1);
+
+    extra_path[len] = 't';
+    extra_path[len + 1] = 'x';
+    extra_path[len + 2] = 't';
+    gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+
+    if(!has_txt)
+    {
+      extra_path[len] = 'T';
+      extra_path[len + 1] = 'X';
+      extra_path[len + 2] = 'T';
+      has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+    }
+
+    extra_path[len] = 'w';
+    extra_path[len + 1] = 'a';
+    extra_path[len + 2] = 'v';
+    gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+
+    if(!has_wav)
+    {
+      extra_path[len] = 'W';
+      extra_path[len + 1] = 'A';
+      extra_path[len + 2] = 'V';
+      has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+    }
+
+    // TODO: decide if we want to remove the flag for images that lost
+    // their extra file. currently we do (the else cases)
+    if(has_txt)
+      entry->new_flags |= DT_IMAGE_HAS_TXT;
+    else
+      entry->new_flags &= ~DT_IMAGE_HAS_TXT;
+    if(has_wav)
+      entry->new_flags |= DT_IMAGE_HAS_WAV;
+    else
+      entry->new_flags &= ~DT_IMAGE_HAS_WAV;
+
+    free(extra_path);
+  }
+}
 
 GList *dt_control_crawler_run(void)
 {
   sqlite3_stmt *stmt, *inner_stmt;
   GList *result = NULL;
   const gboolean look_for_xmp = dt_image_get_xmp_mode() != DT_WRITE_XMP_NEVER;
-
-  int total_images = 1;
+  // new, removed and renamed files change the mtime of their folder, the
+  // images of an unchanged folder only get their XMP checked. sidecars
+  // rewritten in place don't touch the folder, so that check always runs.
+  const gboolean skip_unchanged = dt_conf_get_bool("crawler_skip_unchanged_folders");
+  const time_t now = time(NULL);
+
+  // first the folders, those not changed since the last complete crawl get a lighter check
+  GHashTable *films = g_hash_table_new_full(NULL, NULL, NULL, _free_film);
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images", -1, &stmt, 0);
+                              "SELECT id, folder, crawl_mtime FROM main.film_rolls",
+                              -1, &stmt, NULL);
   // clang-format on
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    total_images = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    _crawler_film_t *film = g_malloc0(sizeof(_crawler_film_t));
+    film->folder = g_strdup((const char *)sqlite3_column_text(stmt, 1));
+    film->crawled = sqlite3_column_int64(stmt, 2);
+    if(film->folder) _stat_file(film->folder, &film->mtime);
+    film->skip = skip_unchanged && film->mtime && film->crawled == film->mtime;
+    g_hash_table_insert(films, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)), film);
   }
+  sqlite3_finalize(stmt);
 
+  // then collect the images
+  GArray *entries = g_array_new(FALSE, TRUE, sizeof(_crawler_entry_t));
   // clang-format off
-  sqlite3_prepare_v2(dt_database_get(darktable.db),
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                      "SELECT i.id, write_timestamp, version,"
-                     "       folder || '" G_DIR_SEPARATOR_S "' || filename, flags"
+                     "       folder || '" G_DIR_SEPARATOR_S "' || filename, flags, film_id"
                      " FROM main.images i, main.film_rolls f"
                      " ON i.film_id = f.id"
                      " ORDER BY f.id, filename",
                      -1, &stmt, NULL);
-  sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
-                     &inner_stmt, NULL);
   // clang-format on
+  int skipped = 0;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const dt_filmid_t film_id = sqlite3_column_int(stmt, 5);
+    const _crawler_film_t *film = g_hash_table_lookup(films, GINT_TO_POINTER(film_id));
+    const gboolean unchanged = film && film->skip;
+    if(unchanged) skipped++;
+    if(unchanged && !look_for_xmp) continue;
+    _crawler_entry_t entry = { 0 };
+    entry.xmp_only = unchanged;
+    entry.id = sqlite3_column_int(stmt, 0);
+    entry.timestamp = sqlite3_column_int64(stmt, 1);
+    entry.version = sqlite3_column_int(stmt, 2);
+    entry.image_path = g_strdup((const char *)sqlite3_column_text(stmt, 3));
+    entry.flags = sqlite3_column_int(stmt, 4);
+    entry.film_id = film_id;
+    g_array_append_val(entries, entry);
+  }
+  sqlite3_finalize(stmt);
 
-  // let's wrap this into a transaction, it might make it a little faster.
-  dt_database_start_transaction(darktable.db);
+  const int count = entries->len;
+  const int total_images = MAX(1, count);
+  dt_print(DT_DEBUG_CONTROL,
+           "[crawler] checking %d images, %d in unchanged folders for their XMP only",
+           count, skipped);
 
-  int image_count = 0;
+  // the checks only stat files, on network shares we are waiting most of
+  // the time so have them done in parallel, block by block for the progress
   const double start_time = dt_get_wtime();
   // set the "previous update" time to 10ms after a notional previous
   // update to ensure visibility of the first update (which might not
   // appear when done with zero delay) while minimizing the delay
   double last_time = start_time - (FAST_UPDATE-0.01);
+  _crawler_entry_t *items = (_crawler_entry_t *)entries->data;
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  for(int block = 0; block < count; block += CRAWLER_BLOCK)
   {
-    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int64(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    const gchar *image_path = (char *)sqlite3_column_text(stmt, 3);
-    int flags = sqlite3_column_int(stmt, 4);
-    ++image_count;
+    const int block_end = MIN(block + CRAWLER_BLOCK, count);
+    DT_OMP_FOR(schedule(dynamic))
+    for(int k = block; k < block_end; k++)
+      _crawler_check(&items[k], look_for_xmp);
 
     // update the progress message - five times per second for first
     // four seconds, then once per second.
     const double curr_time = dt_get_wtime();
     if(curr_time >= last_time + ((curr_time - start_time > 4.0) ? SLOW_UPDATE : FAST_UPDATE))
     {
-      const double fraction = image_count / (double)total_images;
+      const double fraction = block_end / (double)total_images;
       dt_splash_screen_set_progress_percent(_("checking for updated sidecar files (%d%%)"),
                                             fraction,
                                             curr_time - start_time);
       last_time = curr_time;
     }
+  }
 
-    // if the image is missing we ignore it.
-    if(!g_file_test(image_path, G_FILE_TEST_EXISTS))
-    {
-      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing", image_path, id);
-      continue;
-    }
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
+                              &inner_stmt, NULL);
+
+  // let's wrap this into a transaction, it might make it a little faster.
+  dt_database_start_transaction(darktable.db);
 
-    // no need to look for xmp files if none get written anyway.
-    if(look_for_xmp)
+  for(int k = 0; k < count; k++)
+  {
+    _crawler_entry_t *entry = &items[k];
+    if(entry->xmp_path)
     {
-      // construct the xmp filename for this image
-      gchar xmp_path[PATH_MAX] = { 0 };
-      g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
-      size_t len = strlen(xmp_path);
-      if(len + 4 >= PATH_MAX) continue;
-      xmp_path[len++] = '.';
-      xmp_path[len++] = 'x';
-      xmp_path[len++] = 'm';
-      xmp_path[len++] = 'p';
-      xmp_path[len] = '\0';
-
-      // on Windows the encoding might not be UTF8
-      gchar *xmp_path_locale = dt_util_normalize_path(xmp_path);
-      int stat_res = -1;
-#ifdef _WIN32
-      // UTF8 paths fail in this context, but converting to UTF16 works
-      struct _stati64 statbuf;
-      if(xmp_path_locale) // in Windows dt_util_normalize_path returns
-                          // NULL if file does not exist
-      {
-        wchar_t *wfilename = g_utf8_to_utf16(xmp_path_locale, -1, NULL, NULL, NULL);
-        stat_res = _wstati64(wfilename, &statbuf);
-        g_free(wfilename);
-      }
- #else
-      struct stat statbuf;
-      stat_res = stat(xmp_path_locale, &statbuf);
-#endif
-      g_free(xmp_path_locale);
-      if(stat_res) continue; // TODO: shall we report these?
-
-      // step 1: check if the xmp is newer than our db entry
-      if(timestamp + MAX_TIME_SKEW < statbuf.st_mtime)
-      {
-        dt_control_crawler_result_t *item = malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
-        item->xmp_path = g_strdup(xmp_path);
-
-        result = g_list_prepend(result, item);
-        dt_print(DT_DEBUG_CONTROL,
-                 "[crawler] `%s' (id: %d) is a newer XMP file", xmp_path, id);
-      }
-      // older timestamps are the case for all images after the db
-      // upgrade. better not report these
+      dt_control_crawler_result_t *item = malloc(sizeof(dt_control_crawler_result_t));
+      item->id = entry->id;
+      item->timestamp_xmp = entry->xmp_mtime;
+      item->timestamp_db = entry->timestamp;
+      item->image_path = entry->image_path;
+      item->xmp_path = entry->xmp_path;
+      entry->image_path = entry->xmp_path = NULL;
+
+      result = g_list_prepend(result, item);
+
+      // keep reporting the folder until the user has dealt with it
+      _crawler_film_t *film = g_hash_table_lookup(films, GINT_TO_POINTER(entry->film_id));
+      if(film) film->reported = TRUE;
     }
-
-    // step 2: check if the image has associated files (.txt, .wav)
-    size_t len = strlen(image_path);
-    const char *c = image_path + len;
-    while((c > image_path) && (*c != '.')) c--;
-    len = c - image_path + 1;
-
-    char *extra_path = calloc(len + 3 + 1, sizeof(char));
-    if(extra_path)
+    if(entry->flags != entry->new_flags)
     {
-      g_strlcpy(extra_path, image_path, len + 1);
-
-      extra_path[len] = 't';
-      extra_path[len + 1] = 'x';
-      extra_path[len + 2] = 't';
-      gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-
-      if(!has_txt)
-      {
-        extra_path[len] = 'T';
-        extra_path[len + 1] = 'X';
-        extra_path[len + 2] = 'T';
-        has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-      }
-
-      extra_path[len] = 'w';
-      extra_path[len + 1] = 'a';
-      extra_path[len + 2] = 'v';
-      gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-
-      if(!has_wav)
-      {
-        extra_path[len] = 'W';
-        extra_path[len + 1] = 'A';
-        extra_path[len + 2] = 'V';
-        has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-      }
-
-      // TODO: decide if we want to remove the flag for images that lost
-      // their extra file. currently we do (the else cases)
-      int new_flags = flags;
-      if(has_txt)
-        new_flags |= DT_IMAGE_HAS_TXT;
-      else
-        new_flags &= ~DT_IMAGE_HAS_TXT;
-      if(has_wav)
-        new_flags |= DT_IMAGE_HAS_WAV;
-      else
-        new_flags &= ~DT_IMAGE_HAS_WAV;
-      if(flags != new_flags)
-      {
-        sqlite3_bind_int(inner_stmt, 1, new_flags);
-        sqlite3_bind_int(inner_stmt, 2, id);
-        sqlite3_step(inner_stmt);
-        sqlite3_reset(inner_stmt);
-        sqlite3_clear_bindings(inner_stmt);
-      }
-
-      free(extra_path);
+      sqlite3_bind_int(inner_stmt, 1, entry->new_flags);
+      sqlite3_bind_int(inner_stmt, 2, entry->id);
+      sqlite3_step(inner_stmt);
+      sqlite3_reset(inner_stmt);
+      sqlite3_clear_bindings(inner_stmt);
     }
+    g_free(entry->image_path);
   }
+  sqlite3_finalize(inner_stmt);
+
+  // remember the folders we are done with. a folder modified in the last
+  // seconds could still change within the same mtime, check it again next time
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.film_rolls SET crawl_mtime = ?1 WHERE id = ?2", -1,
+                              &inner_stmt, NULL);
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, films);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const _crawler_film_t *film = value;
+    const time_t crawled = film->reported || film->mtime + MAX_TIME_SKEW >= now ? 0 : film->mtime;
+    if(film->skip || crawled == film->crawled) continue;
+    sqlite3_bind_int64(inner_stmt, 1, crawled);
+    sqlite3_bind_int(inner_stmt, 2, GPOINTER_TO_INT(key));
+    sqlite3_step(inner_stmt);
+    sqlite3_reset(inner_stmt);
+    sqlite3_clear_bindings(inner_stmt);
+  }
+  sqlite3_finalize(inner_stmt);
 
   dt_database_release_transaction(darktable.db);
 
-  sqlite3_finalize(stmt);
-  sqlite3_finalize(inner_stmt);
+  g_array_free(entries, TRUE);
+  g_hash_table_destroy(films);
 
   return g_list_reverse(result); // list was built in reverse order, so un-reverse it
 }
@@ -54,6 +54,9 @@ typedef struct _dt_job_t
   char description[DT_CONTROL_DESCRIPTION_LEN];
   dt_view_type_flags_t view_creator;
   gboolean is_synchronous;
+  gboolean speculative;
+
+  struct _dt_job_t *next; // link in the submission inbox
 } _dt_job_t;
 
 /** check if two jobs are to be considered equal. a simple memcmp won't work since the mutexes probably won't
@@ -160,6 +163,11 @@ gboolean dt_control_job_is_synchronous(const dt_job_t *job)
   return job && job->is_synchronous;
 }
 
+void dt_control_job_set_speculative(_dt_job_t *job)
+{
+  if(job) job->speculative = TRUE;
+}
+
 void dt_control_job_dispose(_dt_job_t *job)
 {
   if(!job) return;
@@ -248,65 +256,244 @@ static gboolean _control_run_job_res(dt_control_t *control, int32_t res)
   return FALSE;
 }
 
-static _dt_job_t *_control_schedule_job(dt_control_t *control)
+// pick the queue whose head job has the highest priority. the order of the
+// queues matches our priority, and we only update the winner when the priority
+// is strictly bigger
+static int _control_pick_queue(dt_control_t *control,
+                               dt_control_worker_queue_t *wq)
 {
-  /*
-   * job scheduling works like this:
-   * - when there is a single job in the queue head with a maximal priority -> pick it
-   * - otherwise pick among the ones with the maximal priority in the following order:
-   *   * user foreground
-   *   * system foreground
-   *   * user background
-   *   * system background
-   * - the jobs that didn't get picked this round get their priority incremented
-   */
-
-  dt_pthread_mutex_lock(&control->queue_mutex);
-
-  // find the job
-  _dt_job_t *job = NULL;
-  int winner_queue = DT_JOB_QUEUE_MAX;
+  int winner_queue = -1;
   int max_priority = -1;
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(control->queues[i] == NULL) continue;
-    if(control->export_scheduled && i == DT_JOB_QUEUE_USER_EXPORT) continue;
-    _dt_job_t *_job = (_dt_job_t *)control->queues[i]->data;
-    if(_job->priority > max_priority)
+    _dt_job_t *job = g_queue_peek_head(&wq->queues[i]);
+    if(!job) continue;
+    if(i == DT_JOB_QUEUE_USER_EXPORT && dt_atomic_get_int(&control->export_scheduled)) continue;
+    if(job->priority > max_priority)
     {
-      max_priority = _job->priority;
-      job = _job;
+      max_priority = job->priority;
       winner_queue = i;
     }
   }
+  return winner_queue;
+}
 
-  if(!job)
+static _dt_job_t *_control_take_job(dt_control_t *control,
+                                    dt_control_worker_queue_t *wq)
+{
+  dt_pthread_mutex_lock(&wq->lock);
+
+  int winner_queue = _control_pick_queue(control, wq);
+  if(winner_queue == DT_JOB_QUEUE_USER_EXPORT)
   {
-    dt_pthread_mutex_unlock(&control->queue_mutex);
-    return NULL;
+    // only one export may run at a time, another worker might have been faster
+    int expected = FALSE;
+    if(!dt_atomic_CAS_int(&control->export_scheduled, &expected, TRUE))
+      winner_queue = _control_pick_queue(control, wq);
   }
 
-  // the order of the queues in control->queues matches our priority, and we only update job when the priority
-  // is strictly bigger
-  // invariant -> job is the one we are looking for
+  if(winner_queue < 0)
+  {
+    dt_pthread_mutex_unlock(&wq->lock);
+    return NULL;
+  }
 
   // remove the to be scheduled job from its queue
-  GList **queue = &control->queues[winner_queue];
-  *queue = g_list_delete_link(*queue, *queue);
-  control->queue_length[winner_queue]--;
-  if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = TRUE;
-
-  // and place it in scheduled job array (for job deduping)
-  control->job[_control_get_threadid()] = job;
+  _dt_job_t *job = g_queue_pop_head(&wq->queues[winner_queue]);
 
   // increment the priorities of the others
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(i == winner_queue || control->queues[i] == NULL) continue;
-    ((_dt_job_t *)control->queues[i]->data)->priority++;
+    _dt_job_t *other = g_queue_peek_head(&wq->queues[i]);
+    if(i != winner_queue && other) other->priority++;
   }
 
-  dt_pthread_mutex_unlock(&control->queue_mutex);
+  dt_pthread_mutex_unlock(&wq->lock);
+
+  dt_atomic_sub_int(&control->queued_jobs, 1);
+  if(winner_queue == DT_JOB_QUEUE_SYSTEM_FG)
+    dt_atomic_sub_int(&control->queued_fg_jobs, 1);
+  return job;
+}
+
+static void _control_discard_job(dt_control_t *control,
+                                 _dt_job_t *job)
+{
+  if(!job) return;
+  _control_job_set_state(job, DT_JOB_STATE_DISCARDED);
+  dt_control_job_dispose(job);
+  dt_atomic_sub_int(&control->queued_jobs, 1);
+  dt_atomic_sub_int(&control->pending_jobs, 1);
+}
+
+static void _control_enqueue_job(dt_control_t *control,
+                                 dt_control_worker_queue_t *own,
+                                 _dt_job_t *job)
+{
+  if(job->queue != DT_JOB_QUEUE_SYSTEM_FG)
+  {
+    // the rest are FIFOs
+    if(job->queue == DT_JOB_QUEUE_USER_BG ||
+       job->queue == DT_JOB_QUEUE_USER_EXPORT ||
+       job->queue == DT_JOB_QUEUE_SYSTEM_BG)
+      job->priority = 0;
+    else
+      job->priority = DT_CONTROL_FG_PRIORITY;
+
+    dt_pthread_mutex_lock(&own->lock);
+    GQueue *queue = &own->queues[job->queue];
+    _control_job_print(job, "add_job", "", (int32_t)queue->length);
+    g_queue_push_tail(queue, job);
+    dt_pthread_mutex_unlock(&own->lock);
+    return;
+  }
+
+  // this is a stack with limited size and bubble up and all that stuff
+  job->priority = DT_CONTROL_FG_PRIORITY;
+
+  _dt_job_t *job_for_disposal = NULL;
+  dt_control_worker_queue_t *longest = own;
+  guint longest_length = 0;
+
+  // look for a copy of the job in all workers, one lock at a time
+  for(int k = 0; k < control->num_threads && !job_for_disposal; k++)
+  {
+    dt_control_worker_queue_t *wq = &control->worker_queues[k];
+    GQueue *queue = &wq->queues[DT_JOB_QUEUE_SYSTEM_FG];
+    dt_pthread_mutex_lock(&wq->lock);
+
+    // check if we have already scheduled the job
+    if(_control_job_equal(job, wq->running))
+    {
+      _control_job_print(wq->running, "add_job", "found job already in scheduled:", -1);
+      job_for_disposal = job;
+      job = NULL;
+    }
+    else
+    {
+      // if the job is already in a queue -> move it to the top of ours
+      for(GList *iter = queue->head; iter; iter = g_list_next(iter))
+      {
+        _dt_job_t *other_job = iter->data;
+        if(_control_job_equal(job, other_job))
+        {
+          _control_job_print(other_job, "add_job", "found job already in queue", -1);
+          g_queue_delete_link(queue, iter);
+          // a prefetched job now actually requested gets promoted
+          other_job->speculative = other_job->speculative && job->speculative;
+          dt_atomic_sub_int(&control->queued_fg_jobs, 1);
+          job_for_disposal = job;
+          job = other_job;
+          break; // there can't be any further copy in the list
+        }
+      }
+    }
+
+    if(queue->length > longest_length)
+    {
+      longest_length = queue->length;
+      longest = wq;
+    }
+    dt_pthread_mutex_unlock(&wq->lock);
+  }
+
+  if(job)
+  {
+    // now we can add the job to our stack
+    dt_pthread_mutex_lock(&own->lock);
+    _control_job_print(job, "add_job", job->speculative ? "speculative" : "",
+                       (int32_t)own->queues[DT_JOB_QUEUE_SYSTEM_FG].length);
+    // speculative jobs go below everything requested, and are the first
+    // ones dropped from the bottom of the stack
+    if(job->speculative)
+      g_queue_push_tail(&own->queues[DT_JOB_QUEUE_SYSTEM_FG], job);
+    else
+      g_queue_push_head(&own->queues[DT_JOB_QUEUE_SYSTEM_FG], job);
+    dt_pthread_mutex_unlock(&own->lock);
+    dt_atomic_add_int(&control->queued_fg_jobs, 1);
+  }
+
+  // and take care of the maximal queue size, dropping the oldest job of the
+  // longest stack we have seen
+  if(dt_atomic_get_int(&control->queued_fg_jobs) > DT_CONTROL_MAX_JOBS)
+  {
+    dt_pthread_mutex_lock(&longest->lock);
+    GQueue *queue = &longest->queues[DT_JOB_QUEUE_SYSTEM_FG];
+    _dt_job_t *last = g_queue_peek_tail(queue);
+    if(last && last != job)
+      g_queue_pop_tail(queue);
+    else
+      last = NULL;
+    dt_pthread_mutex_unlock(&longest->lock);
+    if(last)
+    {
+      dt_atomic_sub_int(&control->queued_fg_jobs, 1);
+      _control_discard_job(control, last);
+    }
+  }
+
+  // dispose of dropped job, if any
+  _control_discard_job(control, job_for_disposal);
+}
+
+// move everything submitted by dt_control_add_job() into our own queues
+static void _control_drain_inbox(dt_control_t *control,
+                                 dt_control_worker_queue_t *own)
+{
+  _dt_job_t *list = g_atomic_pointer_get(&control->inbox);
+  while(list && !g_atomic_pointer_compare_and_exchange(&control->inbox, list, NULL))
+    list = g_atomic_pointer_get(&control->inbox);
+
+  // the inbox is a stack, restore the submission order
+  _dt_job_t *ordered = NULL;
+  while(list)
+  {
+    _dt_job_t *next = list->next;
+    list->next = ordered;
+    ordered = list;
+    list = next;
+  }
+
+  while(ordered)
+  {
+    _dt_job_t *next = ordered->next;
+    ordered->next = NULL;
+    _control_enqueue_job(control, own, ordered);
+    ordered = next;
+  }
+}
+
+static _dt_job_t *_control_schedule_job(dt_control_t *control)
+{
+  /*
+   * job scheduling works like this:
+   * - new jobs are collected from the inbox into the queues of the worker that finds them
+   * - a worker first schedules from its own queues:
+   *   * when there is a single job in the queue head with a maximal priority -> pick it
+   *   * otherwise pick among the ones with the maximal priority in the following order:
+   *     * user foreground
+   *     * system foreground
+   *     * user background
+   *     * system background
+   *   * the jobs that didn't get picked this round get their priority incremented
+   * - if its own queues are empty it steals from the other workers by the same rules
+   */
+  const int32_t self = _control_get_threadid();
+  dt_control_worker_queue_t *own = &control->worker_queues[self];
+
+  _control_drain_inbox(control, own);
+
+  _dt_job_t *job = _control_take_job(control, own);
+  for(int k = 1; !job && k < control->num_threads; k++)
+    job = _control_take_job(control, &control->worker_queues[(self + k) % control->num_threads]);
+
+  if(!job) return NULL;
+
+  // there is a short window between stealing and this where a job might not be deduped,
+  // taking both locks would risk a deadlock with a worker stealing from us.
+  dt_pthread_mutex_lock(&own->lock);
+  own->running = job;
+  dt_pthread_mutex_unlock(&own->lock);
 
   return job;
 }
@@ -338,10 +525,22 @@ static gboolean _control_run_job(dt_control_t *control)
   dt_pthread_mutex_unlock(&job->wait_mutex);
 
   // remove the job from scheduled job array (for job deduping)
-  dt_pthread_mutex_lock(&control->queue_mutex);
-  control->job[_control_get_threadid()] = NULL;
-  if(job->queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = FALSE;
-  dt_pthread_mutex_unlock(&control->queue_mutex);
+  dt_control_worker_queue_t *own = &control->worker_queues[_control_get_threadid()];
+  dt_pthread_mutex_lock(&own->lock);
+  own->running = NULL;
+  dt_pthread_mutex_unlock(&own->lock);
+
+  if(job->queue == DT_JOB_QUEUE_USER_EXPORT)
+  {
+    dt_atomic_set_int(&control->export_scheduled, FALSE);
+    // workers might be sleeping on a queued export
+    if(dt_atomic_get_int(&control->queued_jobs) > 0)
+    {
+      dt_pthread_mutex_lock(&control->cond_mutex);
+      pthread_cond_broadcast(&control->cond);
+      dt_pthread_mutex_unlock(&control->cond_mutex);
+    }
+  }
 
   // and free it
   dt_control_job_dispose(job);
@@ -406,100 +605,26 @@ gboolean dt_control_add_job(dt_job_queue_t queue_id, _dt_job_t *job)
   }
 
   job->queue = queue_id;
-
-  _dt_job_t *job_for_disposal = NULL;
-
-  dt_pthread_mutex_lock(&control->queue_mutex);
-
-  GList **queue = &control->queues[queue_id];
-  size_t length = control->queue_length[queue_id];
-
-  _control_job_print(job, "add_job", "", (int32_t)length);
+  _control_job_set_state(job, DT_JOB_STATE_QUEUED);
 
   dt_atomic_add_int(&control->pending_jobs, 1);
-  if(queue_id == DT_JOB_QUEUE_SYSTEM_FG)
-  {
-    // this is a stack with limited size and bubble up and all that stuff
-    job->priority = DT_CONTROL_FG_PRIORITY;
+  dt_atomic_add_int(&control->queued_jobs, 1);
 
-    // check if we have already scheduled the job
-    for(int k = 0; k < control->num_threads; k++)
-    {
-      _dt_job_t *other_job = control->job[k];
-      if(_control_job_equal(job, other_job))
-      {
-        _control_job_print(other_job, "add_job", "found job already in scheduled:", -1);
-
-        dt_pthread_mutex_unlock(&control->queue_mutex);
-
-        _control_job_set_state(job, DT_JOB_STATE_DISCARDED);
-        dt_control_job_dispose(job);
-        dt_atomic_sub_int(&control->pending_jobs, 1);
-
-        return 0; // there can't be any further copy
-      }
-    }
-
-    // if the job is already in the queue -> move it to the top
-    for(GList *iter = *queue; iter; iter = g_list_next(iter))
-    {
-      _dt_job_t *other_job = iter->data;
-      if(_control_job_equal(job, other_job))
-      {
-        _control_job_print(other_job, "add_job", "found job already in queue", -1);
-
-        *queue = g_list_delete_link(*queue, iter);
-        length--;
-        dt_atomic_sub_int(&control->pending_jobs, 1);
-
-        job_for_disposal = job;
-
-        job = other_job;
-        break; // there can't be any further copy in the list
-      }
-    }
-
-    // now we can add the new job to the list
-    *queue = g_list_prepend(*queue, job);
-    length++;
-
-    // and take care of the maximal queue size
-    if(length > DT_CONTROL_MAX_JOBS)
-    {
-      GList *last = g_list_last(*queue);
-      _control_job_set_state(last->data, DT_JOB_STATE_DISCARDED);
-      dt_control_job_dispose(last->data);
-      *queue = g_list_delete_link(*queue, last);
-      length--;
-      dt_atomic_sub_int(&control->pending_jobs, 1);
-    }
-
-    control->queue_length[queue_id] = length;
-  }
-  else
+  // push onto the inbox stack, deduping and queue limits are handled by the worker
+  // picking it up. the job may be gone as soon as it is on the stack.
+  _dt_job_t *head;
+  do
   {
-    // the rest are FIFOs
-    if(queue_id == DT_JOB_QUEUE_USER_BG ||
-       queue_id == DT_JOB_QUEUE_USER_EXPORT ||
-       queue_id == DT_JOB_QUEUE_SYSTEM_BG)
-      job->priority = 0;
-    else
-      job->priority = DT_CONTROL_FG_PRIORITY;
-    *queue = g_list_append(*queue, job);
-    control->queue_length[queue_id]++;
-  }
-  _control_job_set_state(job, DT_JOB_STATE_QUEUED);
-  dt_pthread_mutex_unlock(&control->queue_mutex);
+    head = g_atomic_pointer_get(&control->inbox);
+    job->next = head;
+  } while(!g_atomic_pointer_compare_and_exchange(&control->inbox, head, job));
 
   // notify workers
+  dt_atomic_add_int(&control->job_generation, 1);
   dt_pthread_mutex_lock(&control->cond_mutex);
   pthread_cond_broadcast(&control->cond);
   dt_pthread_mutex_unlock(&control->cond_mutex);
 
-  // dispose of dropped job, if any
-  _control_job_set_state(job_for_disposal, DT_JOB_STATE_DISCARDED);
-  dt_control_job_dispose(job_for_disposal);
-
   return FALSE;
 }
 
@@ -562,11 +687,13 @@ static void *_control_work(void *ptr)
   free(params);
   while(dt_control_running())
   {
+    const int generation = dt_atomic_get_int(&control->job_generation);
     if(_control_run_job(control))
     {
-      // wait for a new job.
+      // wait for a new job, unless one got submitted while we were looking
       dt_pthread_mutex_lock(&control->cond_mutex);
-      dt_pthread_cond_wait(&control->cond, &control->cond_mutex);
+      if(generation == dt_atomic_get_int(&control->job_generation) && dt_control_running())
+        dt_pthread_cond_wait(&control->cond, &control->cond_mutex);
       dt_pthread_mutex_unlock(&control->cond_mutex);
     }
   }
@@ -614,8 +741,14 @@ void dt_control_jobs_init()
   // start threads
   control->num_threads = dt_worker_threads();
   control->thread = (pthread_t *)calloc(control->num_threads, sizeof(pthread_t));
-  // allocate enough jobs to match _control_get_threadid()
-  control->job = (dt_job_t **)calloc(control->num_threads+1, sizeof(dt_job_t *));
+  control->worker_queues = calloc(control->num_threads, sizeof(dt_control_worker_queue_t));
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    dt_control_worker_queue_t *wq = &control->worker_queues[k];
+    dt_pthread_mutex_init(&wq->lock, NULL);
+    for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+      g_queue_init(&wq->queues[i]);
+  }
 
   dt_atomic_set_int(&control->running, DT_CONTROL_STATE_RUNNING);
 
@@ -652,8 +785,40 @@ void dt_control_jobs_init()
 void dt_control_jobs_cleanup()
 {
   dt_control_t *control = darktable.control;
-  free(control->job);
-  control->job = NULL;
+
+  // the workers are gone, whatever was submitted but never ran still owns
+  // its params and progress, discard it so their destroy callbacks run
+  _dt_job_t *list = g_atomic_pointer_get(&control->inbox);
+  while(list && !g_atomic_pointer_compare_and_exchange(&control->inbox, list, NULL))
+    list = g_atomic_pointer_get(&control->inbox);
+  while(list)
+  {
+    _dt_job_t *next = list->next;
+    _control_discard_job(control, list);
+    list = next;
+  }
+
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    dt_control_worker_queue_t *wq = &control->worker_queues[k];
+    for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+    {
+      _dt_job_t *job;
+      while((job = g_queue_pop_head(&wq->queues[i])))
+        _control_discard_job(control, job);
+    }
+    dt_pthread_mutex_destroy(&wq->lock);
+  }
+
+  for(int k = 0; k < DT_CTL_WORKER_RESERVED; k++)
+  {
+    if(!control->job_res[k]) continue;
+    _control_job_set_state(control->job_res[k], DT_JOB_STATE_DISCARDED);
+    dt_control_job_dispose(control->job_res[k]);
+    control->job_res[k] = NULL;
+  }
+  free(control->worker_queues);
+  control->worker_queues = NULL;
   free(control->thread);
   control->thread = NULL;
 }
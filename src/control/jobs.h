@@ -65,6 +65,9 @@ void dt_control_job_dispose(dt_job_t *job);
 /** cancel a job, running or in queue. */
 void dt_control_job_cancel(dt_job_t *job);
 dt_job_state_t dt_control_job_get_state(dt_job_t *job);
+/** mark a DT_JOB_QUEUE_SYSTEM_FG job as speculative (prefetching): it is queued behind
+ * the jobs for what is actually requested and is the first to be dropped when the queue is full. */
+void dt_control_job_set_speculative(dt_job_t *job);
 /** set job params and a callback to destroy those params */
 void dt_control_job_set_params(dt_job_t *job, void *params, dt_job_destroy_callback callback);
 /** set job params (with size params_size) and a callback to destroy those params.
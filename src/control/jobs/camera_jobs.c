@@ -21,6 +21,7 @@
 #include "common/import_session.h"
 #include "common/utility.h"
 #include "common/datetime.h"
+#include "common/import_prefetch.h"
 #include "control/conf.h"
 #include "control/jobs/image_jobs.h"
 #include "gui/gtk.h"
@@ -67,8 +68,26 @@ typedef struct dt_camera_import_t
   dt_job_t *job;
   double fraction;
   uint32_t import_count;
+
+  // the downloaded files waiting for their import, which runs in its own
+  // thread while the next files are downloaded
+  GMutex lock;
+  GCond cond;
+  GQueue pending;
+  gboolean downloaded; // no more files will come
+  gboolean threaded;   // FALSE if the import thread could not be started
 } dt_camera_import_t;
 
+typedef struct _camera_import_file_t
+{
+  gchar *filename;
+  gchar *in_filename;
+  time_t timestamp;
+} _camera_import_file_t;
+
+// downloaded files waiting for their import, the download waits beyond
+#define DT_CAMERA_IMPORT_QUEUE 16
+
 static int32_t dt_camera_capture_job_run(dt_job_t *job)
 {
   dt_camera_capture_t *params = dt_control_job_get_params(job);
@@ -239,26 +258,27 @@ dt_job_t *dt_camera_capture_job_create(const char *jobcode,
   return job;
 }
 
-/** Listener interface for import job */
-void _camera_import_image_downloaded(const dt_camera_t *camera,
-                                     const char *in_path,
-                                     const char *in_filename,
-                                     const char *filename,
-                                     void *data)
+static void _camera_import_file_free(_camera_import_file_t *file)
 {
-  // Import downloaded image to import filmroll
-  dt_camera_import_t *t = (dt_camera_import_t *)data;
+  g_free(file->filename);
+  g_free(file->in_filename);
+  g_free(file);
+}
+
+// Import downloaded image to import filmroll
+static void _camera_import_file(dt_camera_import_t *t,
+                                const _camera_import_file_t *file)
+{
+  const char *filename = file->filename;
   const dt_imgid_t imgid =
     dt_image_import(dt_import_session_film_id(t->shared.session), filename, FALSE, TRUE);
 
-  const time_t timestamp = (!in_path || !in_filename) ? 0 :
-               dt_camctl_get_image_file_timestamp(darktable.camctl, in_path, in_filename);
-  if(timestamp
+  if(file->timestamp
      && dt_is_valid_imgid(imgid))
   {
     char dt_txt[DT_DATETIME_EXIF_LENGTH];
-    dt_datetime_unix_to_exif(dt_txt, sizeof(dt_txt), &timestamp);
-    gchar *id = g_strconcat(in_filename, "-", dt_txt, NULL);
+    dt_datetime_unix_to_exif(dt_txt, sizeof(dt_txt), &file->timestamp);
+    gchar *id = g_strconcat(file->in_filename, "-", dt_txt, NULL);
     dt_metadata_set(imgid, "Xmp.darktable.image_id", id, FALSE);
     g_free(id);
   }
@@ -293,6 +313,78 @@ void _camera_import_image_downloaded(const dt_camera_t *camera,
   t->import_count++;
 }
 
+// imports the files as they are downloaded, the database writes are
+// committed in batches as long as files keep coming
+static void *_camera_import_worker(void *data)
+{
+  dt_camera_import_t *t = (dt_camera_import_t *)data;
+  dt_pthread_setname("camera import");
+  int batched = 0;
+
+  for(;;)
+  {
+    g_mutex_lock(&t->lock);
+    if(batched && g_queue_is_empty(&t->pending))
+    {
+      // waiting for the camera, don't keep the batch open meanwhile
+      g_mutex_unlock(&t->lock);
+      dt_database_release_transaction(darktable.db);
+      batched = 0;
+      continue;
+    }
+    while(g_queue_is_empty(&t->pending) && !t->downloaded)
+      g_cond_wait(&t->cond, &t->lock);
+    _camera_import_file_t *file = g_queue_pop_head(&t->pending);
+    g_cond_broadcast(&t->cond);
+    g_mutex_unlock(&t->lock);
+
+    if(!file) break;
+
+    if(!batched) dt_database_start_transaction(darktable.db);
+    _camera_import_file(t, file);
+    _camera_import_file_free(file);
+    if(++batched >= DT_IMPORT_BATCH_SIZE)
+    {
+      dt_database_release_transaction(darktable.db);
+      batched = 0;
+    }
+  }
+
+  if(batched) dt_database_release_transaction(darktable.db);
+  return NULL;
+}
+
+/** Listener interface for import job */
+void _camera_import_image_downloaded(const dt_camera_t *camera,
+                                     const char *in_path,
+                                     const char *in_filename,
+                                     const char *filename,
+                                     void *data)
+{
+  dt_camera_import_t *t = (dt_camera_import_t *)data;
+
+  // the camera is only to be asked from the download thread
+  _camera_import_file_t *file = g_malloc(sizeof(_camera_import_file_t));
+  file->filename = g_strdup(filename);
+  file->in_filename = g_strdup(in_filename);
+  file->timestamp = (!in_path || !in_filename) ? 0 :
+               dt_camctl_get_image_file_timestamp(darktable.camctl, in_path, in_filename);
+
+  if(!t->threaded)
+  {
+    _camera_import_file(t, file);
+    _camera_import_file_free(file);
+    return;
+  }
+
+  g_mutex_lock(&t->lock);
+  while(g_queue_get_length(&t->pending) >= DT_CAMERA_IMPORT_QUEUE)
+    g_cond_wait(&t->cond, &t->lock);
+  g_queue_push_tail(&t->pending, file);
+  g_cond_broadcast(&t->cond);
+  g_mutex_unlock(&t->lock);
+}
+
 static const char *_camera_request_image_filename(const dt_camera_t *camera,
                                                   const char *filename,
                                                   const dt_image_basic_exif_t *basic_exif,
@@ -343,11 +435,22 @@ static int32_t dt_camera_import_job_run(dt_job_t *job)
   listener.request_image_path = _camera_request_image_path;
   listener.request_image_filename = _camera_request_image_filename;
 
-  // start download of images
+  // start download of images, imported as they come
+  pthread_t worker;
+  params->threaded = dt_pthread_create(&worker, _camera_import_worker, params) == 0;
   dt_camctl_register_listener(darktable.camctl, &listener);
   dt_camctl_import(darktable.camctl, params->camera, params->images);
   dt_camctl_unregister_listener(darktable.camctl, &listener);
 
+  if(params->threaded)
+  {
+    g_mutex_lock(&params->lock);
+    params->downloaded = TRUE;
+    g_cond_broadcast(&params->cond);
+    g_mutex_unlock(&params->lock);
+    dt_pthread_join(worker);
+  }
+
   // notify the user via the window manager
   dt_ui_notify_user();
 
@@ -361,6 +464,9 @@ static dt_camera_import_t *dt_camera_import_alloc()
     return NULL;
 
   params->shared.session = dt_import_session_new();
+  g_mutex_init(&params->lock);
+  g_cond_init(&params->cond);
+  g_queue_init(&params->pending);
 
   return params;
 }
@@ -369,6 +475,12 @@ static void dt_camera_import_cleanup(void *p)
 {
   dt_camera_import_t *params = p;
 
+  _camera_import_file_t *file;
+  while((file = g_queue_pop_head(&params->pending)))
+    _camera_import_file_free(file);
+  g_mutex_clear(&params->lock);
+  g_cond_clear(&params->cond);
+
   // Free the dynamically allocated filename strings in the list, then the list itself.
   // These strings were allocated by gtk_tree_model_get in import.c:_import_from_dialog_run.
   g_list_free_full(params->images, g_free);
@@ -28,10 +28,13 @@
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/mipmap_cache.h"
+#include "common/numa.h"
+#include "common/ratings.h"
 #include "common/styles.h"
 #include "common/tags.h"
 #include "common/undo.h"
 #include "common/grouping.h"
+#include "common/import_prefetch.h"
 #include "common/import_session.h"
 #include "common/utility.h"
 #include "common/datetime.h"
@@ -72,6 +75,12 @@
 #define PROGRESS_UPDATE_INTERVAL 0.5
 // How lon in seconds between issuing a collection-query update?
 #define COLLECTION_UPDATE_INTERVAL 3.0
+// How many images share a database transaction when pasting history
+// or applying styles? Larger batches keep other writers waiting longer.
+#define DT_HISTORY_PASTE_BATCH 32
+// How many images are compressed by the same statements? Each batch is
+// a single transaction, the sidecars are written behind by the synch job.
+#define DT_HISTORY_COMPRESS_BATCH 1000
 
 typedef struct dt_control_datetime_t
 {
@@ -101,6 +110,7 @@ typedef struct dt_control_export_t
   gchar *icc_filename;
   dt_iop_color_intent_t icc_intent;
   gchar *metadata_export;
+  int queue_batch; // in main.export_batches, 0 if not queued
 } dt_control_export_t;
 
 typedef struct dt_control_import_t
@@ -221,15 +231,24 @@ static int32_t _generic_dt_control_fileop_images_job_run
 
   gboolean completeSuccess = TRUE;
   double prev_time = 0;
+  // the path updates of a batch of files are written in one transaction
+  int in_batch = 0;
   while(t && !_job_cancelled(job))
   {
+    if(in_batch == 0) dt_database_start_transaction(darktable.db);
     const gboolean success = fileop_callback(GPOINTER_TO_INT(t->data), film_id) != -1;
     completeSuccess &= success;
     t = g_list_next(t);
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
     if(success) col_count--;
+    if(++in_batch == DT_IMPORT_BATCH_SIZE)
+    {
+      dt_database_release_transaction(darktable.db);
+      in_batch = 0;
+    }
   }
+  if(in_batch) dt_database_release_transaction(darktable.db);
 
   char *new_chk = dt_collection_checksum(FALSE);
   const gboolean col_changed = g_strcmp0(old_chk, new_chk) != 0;
@@ -560,86 +579,92 @@ static int _control_merge_hdr_process(dt_imageio_module_data_t *datai,
   const float cal = 100.0f / (aperture * exp * iso);
   // about proportional to how many photons we can expect from this shot:
   const float photoncnt = 100.0f * aperture * exp / iso;
-  float saturation = 1.0f;
+  const float saturation = 1.0f;
   d->whitelevel = fmaxf(d->whitelevel, saturation * cal);
+  const float whitelevel = d->whitelevel;
+  const float epsw = d->epsw;
+  const int wd = d->wd;
+  const int ht = d->ht;
+  const float *const restrict in = (const float *)ivoid;
+  float *const restrict pixels = d->pixels;
+  float *const restrict weight = d->weight;
+
+  // need some safety margin due to upsampling and 16-bit quantization + dithering?
+  const float offset = 3000.0f / (float)UINT16_MAX;
+
+  // the envelope needs the maximum and minimum of all colour channels, we
+  // conservatively take a 3x3 block for bayer and xtrans. as that block is the
+  // same for all pixels of a 2x2 quad it is evaluated once per quad.
   DT_OMP_FOR(collapse(2))
-  for(int y = 0; y < d->ht; y++)
-    for(int x = 0; x < d->wd; x++)
+  for(int yy = 0; yy < ht; yy += 2)
+    for(int xx = 0; xx < wd; xx += 2)
     {
-      // read unclamped raw value with subtracted black and rescaled
-      // to 1.0 saturation.  this is the output of the rawprepare iop.
-      const float in = ((float *)ivoid)[x + d->wd * y];
       // weights based on siggraph 12 poster zijian zhu, zhengguo li,
       // susanto rahardja, pasi fraenti 2d denoising factor for high
       // dynamic range imaging
       float w = photoncnt;
-
-      // need some safety margin due to upsampling and 16-bit quantization + dithering?
-      float offset = 3000.0f / (float)UINT16_MAX;
-
-      // cannot do an envelope based on single pixel values here, need
-      // to get maximum value of all color channels. to find that, go
-      // through the pattern block (we conservatively do a 3x3 for
-      // bayer or xtrans):
-      int xx = x & ~1, yy = y & ~1;
       float M = 0.0f, m = FLT_MAX;
-      if(xx < d->wd - 2 && yy < d->ht - 2)
+      if(xx < wd - 2 && yy < ht - 2)
       {
-        for(int i = 0; i < 3; i++)
-          for(int j = 0; j < 3; j++)
-          {
-            M = MAX(M, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-            m = MIN(m, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-          }
+        for(int j = 0; j < 3; j++)
+        {
+          const float *const row = in + (size_t)wd * (yy + j) + xx;
+          M = MAX(M, MAX(row[0], MAX(row[1], row[2])));
+          m = MIN(m, MIN(row[0], MIN(row[1], row[2])));
+        }
         // move envelope a little to allow non-zero weight even for
         // clipped regions.  this is because even if the 2x2 block is
         // clipped somewhere, the other channels might still prove
         // useful. we'll check for individual channel saturation
         // below.
-        w *= d->epsw + _envelope((M + offset) / saturation);
+        w *= epsw + _envelope((M + offset) / saturation);
       }
+      const gboolean clipped = M + offset >= saturation;
 
-      if(M + offset >= saturation)
-      {
-        if(d->weight[x + d->wd * y] <= 0.0f)
-        { // only consider saturated pixels in case we have nothing better:
-          if(d->weight[x + d->wd * y] == 0 || m < -d->weight[x + d->wd * y])
+      for(int y = yy; y < MIN(yy + 2, ht); y++)
+        for(int x = xx; x < MIN(xx + 2, wd); x++)
+        {
+          // unclamped raw value with subtracted black and rescaled
+          // to 1.0 saturation.  this is the output of the rawprepare iop.
+          const size_t k = x + (size_t)wd * y;
+          const float val = in[k];
+          if(clipped)
           {
-            if(m + offset >= saturation)
-              d->pixels[x + d->wd * y] = 1.0f; // let's admit we were completely clipped, too
-            else
-              d->pixels[x + d->wd * y] = in * cal / d->whitelevel;
-            d->weight[x + d->wd * y]
-                = -m; // could use -cal here, but m is per pixel and
-                      // safer for varying illumination conditions
+            // only consider saturated pixels in case we have nothing better,
+            // else silently ignore, others have filled in a better color here already
+            if(weight[k] <= 0.0f && (weight[k] == 0.0f || m < -weight[k]))
+            {
+              // let's admit we were completely clipped, too
+              pixels[k] = m + offset >= saturation ? 1.0f : val * cal / whitelevel;
+              // could use -cal here, but m is per pixel and
+              // safer for varying illumination conditions
+              weight[k] = -m;
+            }
+          }
+          else
+          {
+            if(weight[k] <= 0.0f)
+            { // cleanup potentially blown highlights from earlier images
+              pixels[k] = 0.0f;
+              weight[k] = 0.0f;
+            }
+            pixels[k] += w * val * cal;
+            weight[k] += w;
           }
         }
-        // else silently ignore, others have filled in a better color here already
-      }
-      else
-      {
-        if(d->weight[x + d->wd * y] <= 0.0)
-        { // cleanup potentially blown highlights from earlier images
-          d->pixels[x + d->wd * y] = 0.0f;
-          d->weight[x + d->wd * y] = 0.0f;
-        }
-        d->pixels[x + d->wd * y] += w * in * cal;
-        d->weight[x + d->wd * y] += w;
-      }
     }
 
   return 0;
 }
 
-static int32_t _control_merge_hdr_job_run(dt_job_t *job)
+// merge the images into one HDR DNG next to the first one, fraction and
+// step are used for the progress of the job. returns TRUE if the job should stop.
+static gboolean _control_merge_hdr_group(dt_job_t *job,
+                                         GList *images,
+                                         double *fraction,
+                                         const double step)
 {
-  dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
-  GList *t = params->index;
-  const guint total = g_list_length(t);
-  double fraction = 0;
-  dt_control_job_set_progress_message(job, ngettext("merging %d image",
-                                                    "merging %d images", total), total);
-
+  const int total = g_list_length(images);
   dt_control_merge_hdr_t d = (dt_control_merge_hdr_t){.epsw = 1e-8f, .abort = FALSE };
 
   dt_imageio_module_format_t buf = (dt_imageio_module_format_t)
@@ -652,9 +677,9 @@ static int32_t _control_merge_hdr_job_run(dt_job_t *job)
     (dt_control_merge_hdr_format_t){.parent = { 0 }, .d = &d };
 
   int num = 1;
-  while(t)
+  for(GList *t = images; t; t = g_list_next(t))
   {
-    if(d.abort) goto end;
+    if(d.abort || _job_cancelled(job)) goto end;
 
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
     dt_imageio_export_with_flags(imgid, "unused", &buf, (dt_imageio_module_data_t *)&dat,
@@ -663,11 +688,9 @@ static int32_t _control_merge_hdr_job_run(dt_job_t *job)
                                  FALSE, DT_COLORSPACE_NONE, NULL, DT_INTENT_LAST, NULL,
                                  NULL, num, total, NULL, -1);
 
-    t = g_list_next(t);
-
     /* update the progress bar */
-    fraction += 1.0 / (total + 1);
-    dt_control_job_set_progress(job, fraction);
+    *fraction += step;
+    dt_control_job_set_progress(job, *fraction);
     num++;
   }
 
@@ -706,8 +729,6 @@ static int32_t _control_merge_hdr_job_run(dt_job_t *job)
                              d.adobe_XYZ_to_CAM);
   free(exif);
 
-  dt_control_job_set_progress(job, 1.0);
-
   while(*c != '/' && c > pathname) c--;
   dt_control_log(_("wrote merged HDR `%s'"), c + 1);
 
@@ -729,6 +750,97 @@ end:
   free(d.pixels);
   free(d.weight);
 
+  return d.abort;
+}
+
+typedef struct _hdr_shot_t
+{
+  dt_imgid_t imgid;
+  GTimeSpan taken;
+  GTimeSpan exposure;
+} _hdr_shot_t;
+
+static gint _hdr_shot_sort(gconstpointer a, gconstpointer b)
+{
+  const _hdr_shot_t *sa = a;
+  const _hdr_shot_t *sb = b;
+  return (sa->taken > sb->taken) - (sa->taken < sb->taken);
+}
+
+// split the images into bracket groups by capture time. a new group starts
+// if the gap between the end of one shot and the start of the next is longer
+// than gap seconds. returns a list of image lists.
+static GList *_hdr_bracket_groups(GList *images, const float gap)
+{
+  if(gap <= 0.0f)
+    return g_list_append(NULL, g_list_copy(images));
+
+  GArray *shots = g_array_new(FALSE, FALSE, sizeof(_hdr_shot_t));
+  for(GList *t = images; t; t = g_list_next(t))
+  {
+    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
+    const dt_image_t *img = dt_image_cache_get(imgid, 'r');
+    if(!img) continue;
+    const _hdr_shot_t shot = { .imgid = imgid,
+                               .taken = img->exif_datetime_taken,
+                               .exposure = (GTimeSpan)(MAX(0.0f, img->exif_exposure)
+                                                       * G_TIME_SPAN_SECOND) };
+    dt_image_cache_read_release(img);
+    g_array_append_val(shots, shot);
+  }
+  g_array_sort(shots, _hdr_shot_sort);
+
+  GList *groups = NULL;
+  GList *group = NULL;
+  GTimeSpan end = 0;
+  for(guint k = 0; k < shots->len; k++)
+  {
+    const _hdr_shot_t *shot = &g_array_index(shots, _hdr_shot_t, k);
+    if(group && shot->taken - end > (GTimeSpan)(gap * G_TIME_SPAN_SECOND))
+    {
+      groups = g_list_prepend(groups, g_list_reverse(group));
+      group = NULL;
+    }
+    group = g_list_prepend(group, GINT_TO_POINTER(shot->imgid));
+    end = shot->taken + shot->exposure;
+  }
+  if(group) groups = g_list_prepend(groups, g_list_reverse(group));
+  g_array_free(shots, TRUE);
+
+  return g_list_reverse(groups);
+}
+
+static int32_t _control_merge_hdr_job_run(dt_job_t *job)
+{
+  dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
+  const guint total = g_list_length(params->index);
+  dt_control_job_set_progress_message(job, ngettext("merging %d image",
+                                                    "merging %d images", total), total);
+
+  // with a gap set, separate bracket sets are detected by capture time
+  // and merged one after the other
+  const float gap = dt_conf_get_float("plugins/lighttable/hdr_merge_group_gap");
+  GList *groups = _hdr_bracket_groups(params->index, gap);
+  const guint nb_groups = g_list_length(groups);
+  if(nb_groups > 1)
+    dt_print(DT_DEBUG_CONTROL, "[merge hdr] %u images in %u bracket sets", total, nb_groups);
+
+  double fraction = 0.0;
+  const double step = 1.0 / (total + 1);
+  for(GList *g = groups; g; g = g_list_next(g))
+  {
+    GList *images = g->data;
+    // a single image of a batch is not a bracket set
+    if(nb_groups > 1 && !g_list_next(images))
+    {
+      fraction += step;
+      continue;
+    }
+    if(_control_merge_hdr_group(job, images, &fraction, step)) break;
+  }
+  g_list_free_full(groups, (GDestroyNotify)g_list_free);
+
+  dt_control_job_set_progress(job, 1.0);
   return 0;
 }
 
@@ -956,7 +1068,7 @@ static int32_t _control_remove_images_job_run(dt_job_t *job)
     return 0;
   }
 
-  char *really_removed = NULL;
+  GList *to_remove = NULL;
 
   double fraction = 0.0;
   double prev_time = 0;
@@ -975,14 +1087,23 @@ static int32_t _control_remove_images_job_run(dt_job_t *job)
       g_free(filename);
     }
     else
-    {
-      dt_util_str_cat(&really_removed, really_removed?",%d":"%d", imgid);
-      dt_image_remove(imgid);
-    }
-    fraction += 1.0 / total;
+      to_remove = g_list_prepend(to_remove, t->data);
+
+    fraction += 0.5 / total;
     _update_progress(job, fraction, &prev_time);
   }
 
+  // all the images go in one transaction
+  to_remove = g_list_reverse(to_remove);
+  GList *removed = dt_image_remove_list(to_remove);
+  g_list_free(to_remove);
+  dt_control_job_set_progress(job, 1.0);
+
+  char *really_removed = NULL;
+  for(GList *l = removed; l; l = g_list_next(l))
+    dt_util_str_cat(&really_removed, really_removed?",%d":"%d", GPOINTER_TO_INT(l->data));
+  g_list_free(removed);
+
   // update remove status
   _set_remove_flag(really_removed);
 
@@ -1449,6 +1570,7 @@ static int32_t _control_gpx_apply_job_run(dt_job_t *job)
       g_list_free(grps);
     }
     g_date_time_unref(utc_time);
+    fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   } while((t = g_list_next(t)) != NULL);
   imgs = g_list_reverse(imgs);
@@ -1512,9 +1634,26 @@ static int32_t _control_local_copy_images_job_run(dt_job_t *job)
 
   gboolean tag_change = FALSE;
   double prev_time = 0;
+  int in_batch = 0;
   for(; t && !_job_cancelled(job); t = g_list_next(t))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
+    if(in_batch == 0)
+    {
+      // copy the files of the next batch in parallel, then flag them
+      // in one transaction
+      if(is_copy)
+      {
+        GList *batch = NULL;
+        const GList *b = t;
+        for(int k = 0; b && k < DT_IMPORT_BATCH_SIZE; k++, b = g_list_next(b))
+          batch = g_list_prepend(batch, b->data);
+        dt_image_local_copy_prefetch(batch);
+        g_list_free(batch);
+      }
+      dt_database_start_transaction(darktable.db);
+    }
+
     if(is_copy)
     {
       if(dt_image_local_copy_set(imgid) == 0)
@@ -1532,7 +1671,13 @@ static int32_t _control_local_copy_images_job_run(dt_job_t *job)
 
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
+    if(++in_batch == DT_IMPORT_BATCH_SIZE)
+    {
+      dt_database_release_transaction(darktable.db);
+      in_batch = 0;
+    }
   }
+  if(in_batch) dt_database_release_transaction(darktable.db);
 
   dt_collection_update_query(darktable.collection,
                              DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_LOCAL_COPY,
@@ -1543,6 +1688,88 @@ static int32_t _control_local_copy_images_job_run(dt_job_t *job)
   return 0;
 }
 
+// the images whose info is refreshed are read block by block: exiv2 reads
+// the files of a block in parallel, each into its own copy of the image,
+// then the copies are written back in one transaction
+#define REFRESH_EXIF_BLOCK 64
+
+typedef struct _refresh_exif_t
+{
+  dt_imgid_t imgid;
+  char sourcefile[PATH_MAX];
+  time_t mtime;
+  gboolean read;
+  dt_image_t img;
+} _refresh_exif_t;
+
+static void _refresh_exif_read(_refresh_exif_t *item,
+                               GHashTable *unchanged)
+{
+  item->read = FALSE;
+  if(!dt_is_valid_imgid(item->imgid)) return;
+
+  gboolean from_cache = TRUE;
+  dt_image_full_path(item->imgid, item->sourcefile, sizeof(item->sourcefile), &from_cache);
+
+  GStatBuf statbuf;
+  item->mtime = g_stat(item->sourcefile, &statbuf) ? 0 : statbuf.st_mtime;
+  if(unchanged && item->mtime
+     && g_hash_table_lookup(unchanged, GINT_TO_POINTER(item->imgid))
+        == GSIZE_TO_POINTER((gsize)item->mtime))
+    return;
+
+  const dt_image_t *cimg = dt_image_cache_get(item->imgid, 'r');
+  if(!cimg) return;
+  item->img = *cimg;
+  dt_image_cache_read_release(cimg);
+
+  // the heap members stay with the cached image
+  item->img.profile = NULL;
+  item->img.dng_gain_maps = NULL;
+  item->img.cache_entry = NULL;
+  item->img.job_flags |= DT_IMAGE_JOB_NO_METADATA; // no metadata refresh, only EXIF
+  dt_exif_read(&item->img, item->sourcefile);
+  item->read = TRUE;
+}
+
+static void _refresh_exif_write(_refresh_exif_t *item,
+                                sqlite3_stmt *mtime_stmt)
+{
+  dt_image_t *img = dt_image_cache_get(item->imgid, 'w');
+  if(!img)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[dt_control_refresh_exif_run] couldn't dt_image_cache_get for imgid %i",
+             item->imgid);
+    g_list_free_full(item->img.dng_gain_maps, g_free);
+    return;
+  }
+
+  // keep what isn't read from the file, or was changed meanwhile
+  item->img.profile = img->profile;
+  item->img.profile_size = img->profile_size;
+  item->img.cache_entry = img->cache_entry;
+  item->img.job_flags = img->job_flags;
+  item->img.group_id = img->group_id;
+  item->img.flags = (item->img.flags & ~(DT_VIEW_RATINGS_MASK | DT_IMAGE_REJECTED))
+    | (img->flags & (DT_VIEW_RATINGS_MASK | DT_IMAGE_REJECTED));
+  if(item->img.dng_gain_maps)
+    g_list_free_full(img->dng_gain_maps, g_free);
+  else
+    item->img.dng_gain_maps = img->dng_gain_maps;
+  *img = item->img;
+  dt_image_cache_write_release_info(img, DT_IMAGE_CACHE_SAFE, "dt_control_refresh_exif_run");
+
+  if(item->mtime)
+  {
+    sqlite3_bind_int(mtime_stmt, 1, item->imgid);
+    sqlite3_bind_int64(mtime_stmt, 2, item->mtime);
+    sqlite3_step(mtime_stmt);
+    sqlite3_reset(mtime_stmt);
+    sqlite3_clear_bindings(mtime_stmt);
+  }
+}
+
 static int32_t _control_refresh_exif_run(dt_job_t *job)
 {
   dt_stop_backthumbs_crawler(FALSE);
@@ -1553,36 +1780,67 @@ static int32_t _control_refresh_exif_run(dt_job_t *job)
   double fraction = 0.0;
   dt_control_job_set_progress_message(job, ngettext("refreshing info for %d image",
                                                     "refreshing info for %d images", total), total);
+
+  // the files which didn't change since their last refresh are skipped
+  GHashTable *unchanged = NULL;
+  if(dt_conf_get_bool("refresh_exif_skip_unchanged"))
+  {
+    unchanged = g_hash_table_new(NULL, NULL);
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT imgid, mtime FROM main.image_exif_mtime", -1, &stmt, NULL);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      g_hash_table_insert(unchanged, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)),
+                          GSIZE_TO_POINTER((gsize)sqlite3_column_int64(stmt, 1)));
+    sqlite3_finalize(stmt);
+  }
+
+  sqlite3_stmt *mtime_stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO main.image_exif_mtime (imgid, mtime)"
+                              " VALUES (?1, ?2)", -1, &mtime_stmt, NULL);
+
+  _refresh_exif_t *items = g_malloc_n(REFRESH_EXIF_BLOCK, sizeof(_refresh_exif_t));
+  int skipped = 0;
   double prev_time = 0;
   while(t && !_job_cancelled(job))
   {
-    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    if(dt_is_valid_imgid(imgid))
+    int count = 0;
+    for(; t && count < REFRESH_EXIF_BLOCK; t = g_list_next(t))
     {
-      gboolean from_cache = TRUE;
-      char sourcefile[PATH_MAX];
-      dt_image_full_path(imgid, sourcefile, sizeof(sourcefile), &from_cache);
+      items[count].imgid = GPOINTER_TO_INT(t->data);
+      if(!dt_is_valid_imgid(items[count].imgid))
+        dt_print(DT_DEBUG_ALWAYS,"[dt_control_refresh_exif_run] illegal imgid %i",
+                 items[count].imgid);
+      count++;
+    }
 
-      dt_image_t *img = dt_image_cache_get(imgid, 'w');
-      if(img)
-      {
-        img->job_flags |= DT_IMAGE_JOB_NO_METADATA; // no metadata refresh, only EXIF
-        dt_exif_read(img, sourcefile);
-        dt_image_cache_write_release_info(img, DT_IMAGE_CACHE_SAFE, "dt_control_refresh_exif_run");
-        DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_DEVELOP_IMAGE_CHANGED);
-      }
-      else
-        dt_print(DT_DEBUG_ALWAYS,
-                 "[dt_control_refresh_exif_run] couldn't dt_image_cache_get for imgid %i",
-                 imgid);
+    // most of the time goes into waiting for the files
+    DT_OMP_FOR(schedule(dynamic))
+    for(int k = 0; k < count; k++)
+      _refresh_exif_read(&items[k], unchanged);
+
+    dt_database_start_transaction(darktable.db);
+    for(int k = 0; k < count; k++)
+    {
+      if(items[k].read)
+        _refresh_exif_write(&items[k], mtime_stmt);
+      else if(dt_is_valid_imgid(items[k].imgid))
+        skipped++;
     }
-    else
-      dt_print(DT_DEBUG_ALWAYS,"[dt_control_refresh_exif_run] illegal imgid %i", imgid);
+    dt_database_release_transaction(darktable.db);
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_DEVELOP_IMAGE_CHANGED);
 
-    t = g_list_next(t);
-    fraction += 1.0 / total;
+    fraction += (double)count / total;
     _update_progress(job, fraction, &prev_time);
   }
+  sqlite3_finalize(mtime_stmt);
+  g_free(items);
+  if(unchanged) g_hash_table_destroy(unchanged);
+
+  dt_print(DT_DEBUG_CONTROL, "[dt_control_refresh_exif_run] %d of %u images unchanged",
+           skipped, total);
+
   dt_collection_update_query(darktable.collection,
                              DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF,
                              g_list_copy(params->index));
@@ -1629,6 +1887,14 @@ static int32_t _control_paste_history_job_run(dt_job_t *job)
   dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
   double prev_time = 0;
   GList *to_synch = NULL;
+
+  // the copied history is loaded once and merged into all images,
+  // the database writes are grouped in transactions of a few images
+  const dt_history_copy_item_t *cp = &darktable.view_manager->copy_paste;
+  dt_history_paste_source_t *src =
+    dt_history_paste_source_new(cp->copied_imageid, cp->selops,
+                                cp->copy_iop_order, cp->full_copy);
+  int in_batch = 0;
   for( ; t && !_job_cancelled(job); t = g_list_next(t))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
@@ -1637,12 +1903,18 @@ static int32_t _control_paste_history_job_run(dt_job_t *job)
     // the one being edited in darkroom
     if(_safe_history_job_on_imgid(job, imgid))
     {
-      if(dt_history_paste(imgid, merge, FALSE))
+      if(in_batch == 0) dt_database_start_transaction(darktable.db);
+      if(dt_history_paste_source_on_image(src, imgid, merge, FALSE))
       {
         // remember that this image's history was updated, so we'll
         // need to synch its sidecar before we finish
         to_synch = g_list_prepend(to_synch, GINT_TO_POINTER(imgid));
       }
+      if(++in_batch == DT_HISTORY_PASTE_BATCH)
+      {
+        dt_database_release_transaction(darktable.db);
+        in_batch = 0;
+      }
     }
     else
       dt_control_log(_("skipped pasting history into image being edited"));
@@ -1650,6 +1922,8 @@ static int32_t _control_paste_history_job_run(dt_job_t *job)
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+  if(in_batch) dt_database_release_transaction(darktable.db);
+  dt_history_paste_source_free(src);
   dt_undo_end_group(darktable.undo);
 
   dt_collection_update_query(darktable.collection,
@@ -1692,20 +1966,33 @@ static int32_t _control_compress_history_job_run(dt_job_t *job)
                                                total),
                                       total);
   double prev_time = 0;
-  for( ; t && !_job_cancelled(job); t = g_list_next(t))
+  while(t && !_job_cancelled(job))
   {
-    dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    if(!dt_is_valid_imgid(imgid)) continue;
-
-    // compress the history of this image, unless it's the one being edited in darkroom
-    if(_safe_history_job_on_imgid(job, imgid))
+    // compress the history of a batch of images, except the one being edited in darkroom
+    GList *batch = NULL;
+    int in_batch = 0;
+    for( ; t && in_batch < DT_HISTORY_COMPRESS_BATCH; t = g_list_next(t))
     {
-      if(!dt_history_compress(imgid))
-        missing++;
+      const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
+      fraction += 1.0 / total;
+      if(!dt_is_valid_imgid(imgid)) continue;
+
+      if(_safe_history_job_on_imgid(job, imgid))
+      {
+        batch = g_list_prepend(batch, t->data);
+        in_batch++;
+      }
+      else
+        dt_control_log(_("skipped compressing history for image being edited"));
     }
-    else
-      dt_control_log(_("skipped compressing history for image being edited"));
-    fraction += 1.0 / total;
+
+    GList *compressed = dt_history_compress_list(batch);
+    missing += in_batch - g_list_length(compressed);
+    g_list_free(batch);
+
+    // the sidecars follow in the background
+    dt_image_synch_xmps(compressed);
+    g_list_free(compressed);
     _update_progress(job, fraction, &prev_time);
   }
 
@@ -1783,11 +2070,14 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
   const gboolean is_overwrite = style_data->overwrite;
 
   double prev_time = 0;
+  int in_batch = 0;
   for(GList *t = imgs ; t && !_job_cancelled(job); t = g_list_next(t))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
     if(!dt_is_valid_imgid(imgid)) continue;
 
+    if(in_batch == 0) dt_database_start_transaction(darktable.db);
+
     dt_undo_lt_history_t *hist = NULL;
     if(is_overwrite && g_list_is_singleton(styles))
     {
@@ -1812,9 +2102,15 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
                      dt_history_snapshot_undo_pop,
                      dt_history_snapshot_undo_lt_history_data_free);
     }
+    if(++in_batch == DT_HISTORY_PASTE_BATCH)
+    {
+      dt_database_release_transaction(darktable.db);
+      in_batch = 0;
+    }
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+  if(in_batch) dt_database_release_transaction(darktable.db);
   dt_undo_end_group(darktable.undo);
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
 
@@ -1827,6 +2123,348 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
   return 0;
 }
 
+typedef enum _export_result_t
+{
+  _EXPORT_PENDING = 0,
+  _EXPORT_DONE,
+  _EXPORT_DEFERRED, // the storage books the image itself once it is stored
+  _EXPORT_SKIPPED,
+  _EXPORT_FAILED
+} _export_result_t;
+
+// an additional format and size each image is written to, see
+// plugins/lighttable/export/extra_outputs
+typedef struct _export_output_t
+{
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_data_t *fdata;
+} _export_output_t;
+
+// shared state of the export lanes, each lane runs images through its own
+// export pixelpipe while the job thread books the results in list order
+typedef struct _export_lanes_t
+{
+  dt_job_t *job;
+  dt_control_export_t *settings;
+  dt_imageio_module_format_t *mformat;
+  dt_imageio_module_storage_t *mstorage;
+  dt_imageio_module_data_t *sdata;
+  dt_imageio_module_data_t *fdata;
+  dt_export_metadata_t *metadata;
+  GArray *extra; // _export_output_t
+  dt_imgid_t *imgs;
+  int total;
+  int omp_threads;
+
+  dt_atomic_int next;
+  dt_atomic_int running;
+  dt_atomic_int lane;
+  dt_pthread_mutex_t lock;
+  pthread_cond_t cond;
+  _export_result_t *result;
+
+  // decode stage, only touched by the job thread
+  int prefetched;
+  int prefetch_depth;
+  size_t prefetch_bytes;
+  size_t prefetch_budget;
+  size_t *prefetch_size;
+} _export_lanes_t;
+
+// the format data gets written to while exporting, every lane needs its own copy
+static dt_imageio_module_data_t *_export_fdata_copy(dt_imageio_module_format_t *format,
+                                                    const dt_imageio_module_data_t *fdata)
+{
+  dt_imageio_module_data_t *copy = format->get_params(format);
+  if(copy) memcpy(copy, fdata, format->params_size(format));
+  return copy;
+}
+
+static dt_imageio_module_data_t **_export_extra_copy(const _export_lanes_t *l)
+{
+  dt_imageio_module_data_t **extra = g_malloc0_n(MAX(1, l->extra->len),
+                                                 sizeof(dt_imageio_module_data_t *));
+  for(guint k = 0; k < l->extra->len; k++)
+  {
+    const _export_output_t *o = &g_array_index(l->extra, _export_output_t, k);
+    extra[k] = _export_fdata_copy(o->format, o->fdata);
+  }
+  return extra;
+}
+
+static void _export_extra_free(const _export_lanes_t *l,
+                               dt_imageio_module_data_t **extra)
+{
+  for(guint k = 0; k < l->extra->len; k++)
+  {
+    const _export_output_t *o = &g_array_index(l->extra, _export_output_t, k);
+    if(extra[k]) o->format->free_params(o->format, extra[k]);
+  }
+  g_free(extra);
+}
+
+// parse the additional outputs, "<format> [<width>x<height>]" separated by ';'.
+// they are developed in the same pipe as the main output so they get its style.
+static GArray *_export_extra_outputs(const dt_imageio_module_storage_t *mstorage,
+                                     const dt_imageio_module_data_t *fdata)
+{
+  GArray *extra = g_array_new(FALSE, TRUE, sizeof(_export_output_t));
+  // storages collecting all images lay them out on their own
+  if(mstorage->initialize_store || mstorage->finalize_store) return extra;
+
+  gchar *spec = dt_conf_get_string("plugins/lighttable/export/extra_outputs");
+  gchar **entries = g_strsplit(spec, ";", -1);
+  g_free(spec);
+
+  for(gchar **e = entries; *e; e++)
+  {
+    char name[64] = { 0 };
+    int max_width = 0, max_height = 0;
+    if(sscanf(g_strstrip(*e), "%63s %dx%d", name, &max_width, &max_height) < 1)
+      continue;
+
+    dt_imageio_module_format_t *format = dt_imageio_get_format_by_name(name);
+    dt_imageio_module_data_t *data = format ? format->get_params(format) : NULL;
+    if(!data)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[export_job] unknown output format `%s'", name);
+      continue;
+    }
+    data->max_width = MAX(max_width, 0);
+    data->max_height = MAX(max_height, 0);
+    g_strlcpy(data->style, fdata->style, sizeof(data->style));
+    data->style_append = fdata->style_append;
+
+    const _export_output_t o = { .format = format, .fdata = data };
+    g_array_append_val(extra, o);
+  }
+  g_strfreev(entries);
+
+  if(extra->len)
+    dt_print(DT_DEBUG_IMAGEIO, "[export_job] %u additional outputs per image", extra->len);
+  return extra;
+}
+
+static _export_result_t _export_image(_export_lanes_t *l,
+                                      dt_imageio_module_data_t *fdata,
+                                      dt_imageio_module_data_t **extra,
+                                      const int i)
+{
+  const dt_imgid_t imgid = l->imgs[i];
+  dt_control_export_t *settings = l->settings;
+
+  // check if image still exists:
+  const dt_image_t *image = dt_image_cache_get(imgid, 'r');
+  if(!image) return _EXPORT_SKIPPED;
+
+  char imgfilename[PATH_MAX] = { 0 };
+  gboolean from_cache = TRUE;
+  dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
+  if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
+  {
+    dt_control_log(_("image `%s' is currently unavailable"), image->filename);
+    dt_print(DT_DEBUG_ALWAYS, "image `%s' is currently unavailable", imgfilename);
+    // dt_image_remove(imgid);
+    dt_image_cache_read_release(image);
+    return _EXPORT_SKIPPED;
+  }
+  dt_image_cache_read_release(image);
+
+  // all outputs of the image are developed in one pipe
+  const gboolean shared = l->extra->len > 0;
+  if(shared) dt_imageio_export_session_begin();
+
+  int res =
+    l->mstorage->store(l->mstorage, l->sdata, imgid, l->mformat, fdata,
+                       i + 1, l->total, settings->high_quality, settings->upscale,
+                       settings->is_scaling, settings->scale_factor,
+                       settings->export_masks, settings->icc_type,
+                       settings->icc_filename, settings->icc_intent,
+                       l->metadata);
+
+  for(guint k = 0; (res == 0 || res == DT_IMAGEIO_STORE_DEFERRED) && k < l->extra->len; k++)
+  {
+    const _export_output_t *o = &g_array_index(l->extra, _export_output_t, k);
+    const int extra_res = !extra[k] ? 1
+      : l->mstorage->store(l->mstorage, l->sdata, imgid, o->format, extra[k],
+                           i + 1, l->total, settings->high_quality, settings->upscale,
+                           settings->is_scaling, settings->scale_factor,
+                           settings->export_masks, settings->icc_type,
+                           settings->icc_filename, settings->icc_intent,
+                           l->metadata);
+    if(extra_res != 0) res = extra_res;
+  }
+
+  if(shared) dt_imageio_export_session_end();
+
+  if(res == DT_IMAGEIO_STORE_DEFERRED) return _EXPORT_DEFERRED;
+  return res != 0 ? _EXPORT_FAILED : _EXPORT_DONE;
+}
+
+static void *_export_lane_run(void *data)
+{
+  _export_lanes_t *l = data;
+#ifdef _OPENMP
+  omp_set_num_threads(l->omp_threads);
+#endif
+  dt_pthread_setname("export lane");
+  // one lane per NUMA node, the pipe keeps its buffers local
+  dt_numa_bind_team(dt_atomic_add_int(&l->lane, 1));
+
+  dt_imageio_module_data_t *fdata = _export_fdata_copy(l->mformat, l->fdata);
+  if(fdata)
+  {
+    dt_imageio_module_data_t **extra = _export_extra_copy(l);
+
+    int i;
+    while((i = dt_atomic_add_int(&l->next, 1)) < l->total)
+    {
+      const _export_result_t res = _job_cancelled(l->job)
+        ? _EXPORT_SKIPPED
+        : _export_image(l, fdata, extra, i);
+
+      // stop the other lanes as early as possible
+      if(res == _EXPORT_FAILED) dt_control_job_cancel(l->job);
+
+      dt_pthread_mutex_lock(&l->lock);
+      l->result[i] = res;
+      pthread_cond_broadcast(&l->cond);
+      dt_pthread_mutex_unlock(&l->lock);
+    }
+    _export_extra_free(l, extra);
+    l->mformat->free_params(l->mformat, fdata);
+  }
+
+  dt_pthread_mutex_lock(&l->lock);
+  dt_atomic_sub_int(&l->running, 1);
+  pthread_cond_broadcast(&l->cond);
+  dt_pthread_mutex_unlock(&l->lock);
+  return NULL;
+}
+
+static _export_result_t _export_lane_wait(_export_lanes_t *l, const int i)
+{
+  dt_pthread_mutex_lock(&l->lock);
+  while(l->result[i] == _EXPORT_PENDING && dt_atomic_get_int(&l->running) > 0)
+    dt_pthread_cond_wait(&l->cond, &l->lock);
+  const _export_result_t res = l->result[i];
+  dt_pthread_mutex_unlock(&l->lock);
+  return res == _EXPORT_PENDING ? _EXPORT_SKIPPED : res;
+}
+
+// decode stage: have the background workers load the full buffers of the
+// upcoming images while the current ones are developed and encoded. the
+// window is bounded by the memory of the buffers not yet booked.
+static void _export_prefetch(_export_lanes_t *l, const int first)
+{
+  const int last = MIN(l->total, first + l->prefetch_depth);
+  for(l->prefetched = MAX(l->prefetched, first); l->prefetched < last; l->prefetched++)
+  {
+    const dt_imgid_t imgid = l->imgs[l->prefetched];
+    const dt_image_t *img = dt_image_cache_get(imgid, 'r');
+    if(!img) continue;
+    const size_t bpp = dt_iop_buffer_dsc_to_bpp(&img->buf_dsc);
+    const size_t bytes = (size_t)img->width * img->height * MAX(bpp, sizeof(uint16_t));
+    dt_image_cache_read_release(img);
+
+    // back off until booked images give their share back
+    if(l->prefetch_bytes > 0 && l->prefetch_bytes + bytes > l->prefetch_budget)
+      break;
+
+    l->prefetch_bytes += bytes;
+    l->prefetch_size[l->prefetched] = bytes;
+    dt_mipmap_cache_get(NULL, imgid, DT_MIPMAP_FULL, DT_MIPMAP_PREFETCH, 'r');
+  }
+}
+
+static int _export_lanes(const dt_imageio_module_storage_t *mstorage,
+                         dt_imageio_module_format_t *mformat,
+                         dt_imageio_module_data_t *fdata,
+                         const GArray *extra,
+                         const int total)
+{
+  // storages collecting all images and formats writing all images to
+  // one file depend on the export order
+  if(mstorage->initialize_store || mstorage->finalize_store
+     || (mformat->flags(fdata) & FORMAT_FLAGS_NO_PARALLEL))
+    return 1;
+
+  for(guint k = 0; k < extra->len; k++)
+  {
+    const _export_output_t *o = &g_array_index(extra, _export_output_t, k);
+    if(o->format->flags(o->fdata) & FORMAT_FLAGS_NO_PARALLEL) return 1;
+  }
+
+  const int lanes = dt_conf_get_int("plugins/lighttable/export/concurrency");
+  return CLAMP(lanes, 1, MAX(1, total));
+}
+
+// the image has been exported, with its history as of now
+static void _export_queue_done(const int batch,
+                               const dt_imgid_t imgid)
+{
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.export_queue"
+                              " SET done = 1,"
+                              "     history_hash = (SELECT current_hash"
+                              "                     FROM main.history_hash"
+                              "                     WHERE imgid = ?2)"
+                              " WHERE batch = ?1 AND imgid = ?2",
+                              -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, batch);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  // the batch makes progress, it's not the one crashing on start
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.export_batches SET attempts = 0 WHERE id = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, batch);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+gboolean dt_control_export_image_done(const int queue_batch,
+                                      const dt_imgid_t imgid)
+{
+  guint tagid = 0, etagid = 0;
+  dt_tag_new("darktable|changed", &tagid);
+  dt_tag_new("darktable|exported", &etagid);
+
+  gboolean tag_change = FALSE;
+  // remove 'changed' tag from image
+  if(dt_tag_detach(tagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+
+  // make sure the 'exported' tag is set on the image
+  if(dt_tag_attach(etagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+
+  /* register export timestamp in cache */
+  dt_image_cache_set_export_timestamp(imgid);
+
+  if(queue_batch) _export_queue_done(queue_batch, imgid);
+  return tag_change;
+}
+
+void dt_control_export_queue_remove(const int batch)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "DELETE FROM main.export_queue WHERE batch = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, batch);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "DELETE FROM main.export_batches WHERE id = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, batch);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
 static int32_t _control_export_job_run(dt_job_t *job)
 {
   dt_stop_backthumbs_crawler(FALSE);
@@ -1872,7 +2510,7 @@ static int32_t _control_export_job_run(dt_job_t *job)
   else
     h = sh < fh ? sh : fh;
 
-  const guint total = g_list_length(params->index);
+  const int total = g_list_length(params->index);
   if(total > 0)
     dt_control_log(ngettext("exporting %d image..", "exporting %d images..", total), total);
   else
@@ -1891,12 +2529,6 @@ static int32_t _control_export_job_run(dt_job_t *job)
 
   g_strlcpy(fdata->style, settings->style, sizeof(fdata->style));
   fdata->style_append = settings->style_append;
-  // Invariant: the tagid for 'darktable|changed' will not change
-  // while this function runs. Is this a sensible assumption?
-  guint tagid = 0, etagid = 0;
-  dt_tag_new("darktable|changed", &tagid);
-  dt_tag_new("darktable|exported", &etagid);
-
   const char iptc_envelope_characterset[] = "Iptc.Envelope.CharacterSet";
   if(!g_strstr_len(settings->metadata_export, -1, iptc_envelope_characterset))
   {
@@ -1909,6 +2541,7 @@ static int32_t _control_export_job_run(dt_job_t *job)
 
   dt_export_metadata_t metadata;
   metadata.flags = 0;
+  metadata.queue_batch = settings->queue_batch;
   metadata.list = dt_util_str_to_glist("\1", settings->metadata_export);
   if(metadata.list)
   {
@@ -1916,61 +2549,114 @@ static int32_t _control_export_job_run(dt_job_t *job)
     metadata.list = g_list_remove(metadata.list, metadata.list->data);
   }
 
-  GList *t = params->index;
+  _export_lanes_t l = {
+    .job = job,
+    .settings = settings,
+    .mformat = mformat,
+    .mstorage = mstorage,
+    .sdata = sdata,
+    .fdata = fdata,
+    .metadata = &metadata,
+    .extra = _export_extra_outputs(mstorage, fdata),
+    .imgs = g_malloc_n(MAX(1, total), sizeof(dt_imgid_t)),
+    .total = total,
+    .result = g_malloc0_n(MAX(1, total), sizeof(_export_result_t)),
+    .prefetch_size = g_malloc0_n(MAX(1, total), sizeof(size_t)),
+    .prefetch_budget = dt_get_available_mem() / 4,
+  };
+  int n = 0;
+  for(GList *t = params->index; t && n < total; t = g_list_next(t))
+    l.imgs[n++] = GPOINTER_TO_INT(t->data);
+
+  const int lanes = _export_lanes(mstorage, mformat, fdata, l.extra, total);
+  pthread_t *lane_thread = NULL;
+  int started = 0;
+  if(lanes > 1)
+  {
+    dt_print(DT_DEBUG_IMAGEIO, "[export_job] exporting %d images in %d lanes", total, lanes);
+    l.omp_threads = MAX(1, dt_get_num_threads() / lanes);
+    dt_pthread_mutex_init(&l.lock, NULL);
+    pthread_cond_init(&l.cond, NULL);
+    lane_thread = g_malloc0_n(lanes, sizeof(pthread_t));
+    for(int k = 0; k < lanes; k++)
+    {
+      dt_atomic_add_int(&l.running, 1);
+      if(dt_pthread_create(&lane_thread[started], _export_lane_run, &l))
+        dt_atomic_sub_int(&l.running, 1);
+      else
+        started++;
+    }
+    // no lane could be started, do the work ourselves
+    if(started == 0)
+    {
+      pthread_cond_destroy(&l.cond);
+      dt_pthread_mutex_destroy(&l.lock);
+      g_free(lane_thread);
+      lane_thread = NULL;
+    }
+  }
+
+  // a plain copy of the input doesn't need any decoding
+  const gboolean prefetch = strcmp(mformat->mime(fdata), "x-copy") != 0;
+  const int in_flight = lane_thread ? started : 1;
+  // keep the full buffers being developed, the prefetched ones and one for
+  // the darkroom within the slots of the full mipmap cache
+  const int slots = darktable.mipmap_cache->mip_full.cache.cost_quota;
+  l.prefetch_depth = CLAMP(slots - in_flight - 1, 0, MAX(2, in_flight));
+
   double prev_time = 0;
+  dt_imageio_module_data_t **extra = lane_thread ? NULL : _export_extra_copy(&l);
 
-  while(t && !_job_cancelled(job))
+  for(int i = 0; i < total; i++)
   {
-    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    t = g_list_next(t);
-    const guint num = total - g_list_length(t);
+    if(!lane_thread && _job_cancelled(job)) break;
+    const dt_imgid_t imgid = l.imgs[i];
+
+    // the images up to i + in_flight are already being developed
+    if(prefetch && !_job_cancelled(job))
+      _export_prefetch(&l, i + in_flight);
 
     // progress message
     // update the message. initialize_store() might have changed the number of images
     dt_control_job_set_progress_message(job, _("exporting %d / %d to %s"),
-                                             num, total, mstorage->name(mstorage));
-
-    // check if image still exists:
-    const dt_image_t *image = dt_image_cache_get(imgid, 'r');
-    if(image)
-    {
-      char imgfilename[PATH_MAX] = { 0 };
-      gboolean from_cache = TRUE;
-      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
-      if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
-      {
-        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
-        dt_print(DT_DEBUG_ALWAYS, "image `%s' is currently unavailable", imgfilename);
-        // dt_image_remove(imgid);
-        dt_image_cache_read_release(image);
-      }
-      else
-      {
-        dt_image_cache_read_release(image);
-        if(mstorage->store(mstorage, sdata, imgid, mformat, fdata,
-                           num, total, settings->high_quality, settings->upscale,
-                           settings->is_scaling, settings->scale_factor,
-                           settings->export_masks, settings->icc_type,
-                           settings->icc_filename, settings->icc_intent,
-                           &metadata) != 0)
-          dt_control_job_cancel(job);
-        else
-        {
-          // remove 'changed' tag from image
-          if(dt_tag_detach(tagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+                                             i + 1, total, mstorage->name(mstorage));
 
-          // make sure the 'exported' tag is set on the image
-          if(dt_tag_attach(etagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+    // results are booked in list order, whatever lane finished first
+    const _export_result_t res = lane_thread
+      ? _export_lane_wait(&l, i)
+      : _export_image(&l, fdata, extra, i);
 
-          /* register export timestamp in cache */
-          dt_image_cache_set_export_timestamp(imgid);
-        }
-      }
+    if(res == _EXPORT_FAILED)
+      dt_control_job_cancel(job);
+    else if(res == _EXPORT_DONE)
+    {
+      if(dt_control_export_image_done(settings->queue_batch, imgid)) tag_change = TRUE;
     }
 
+    l.prefetch_bytes -= l.prefetch_size[i];
+
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+
+  if(lane_thread)
+  {
+    for(int k = 0; k < started; k++)
+      dt_pthread_join(lane_thread[k]);
+    g_free(lane_thread);
+    pthread_cond_destroy(&l.cond);
+    dt_pthread_mutex_destroy(&l.lock);
+  }
+  if(extra) _export_extra_free(&l, extra);
+  for(guint k = 0; k < l.extra->len; k++)
+  {
+    const _export_output_t *o = &g_array_index(l.extra, _export_output_t, k);
+    o->format->free_params(o->format, o->fdata);
+  }
+  g_array_free(l.extra, TRUE);
+  g_free(l.imgs);
+  g_free(l.result);
+  g_free(l.prefetch_size);
   g_list_free_full(metadata.list, g_free);
 
   if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
@@ -1979,6 +2665,11 @@ end:
   // all threads free their fdata
   mformat->free_params(mformat, fdata);
 
+  // the batch is done, failed or was cancelled by the user. when darktable
+  // is shutting down it is kept to be resumed on the next start.
+  if(settings->queue_batch && dt_control_running())
+    dt_control_export_queue_remove(settings->queue_batch);
+
   // notify the user via the window manager
   dt_ui_notify_user();
 
@@ -2613,6 +3304,7 @@ void dt_control_export(GList *imgid_list,
   data->icc_filename = g_strdup(icc_filename);
   data->icc_intent = icc_intent;
   data->metadata_export = g_strdup(metadata_export);
+  data->queue_batch = queue_batch;
 
   dt_control_job_add_progress(job, _("export images"), TRUE);
   dt_control_add_job(DT_JOB_QUEUE_USER_EXPORT, job);
@@ -3019,6 +3711,10 @@ static int32_t _control_import_job_run(dt_job_t *job)
   double update_interval = INIT_UPDATE_INTERVAL;
   char *prev_filename = NULL;
   char *prev_output = NULL;
+  // copies read the files whole anyway, in place imports only look at headers
+  dt_import_prefetch_t *prefetch = data->session ? NULL : dt_import_prefetch_new(t);
+  int batched = 0;
+  dt_database_start_transaction(darktable.db);
   for(GList *img = t; img && !_job_cancelled(job); img = g_list_next(img))
   {
     if(data->session)
@@ -3053,6 +3749,13 @@ static int32_t _control_import_job_run(dt_job_t *job)
                                             &last_coll_update, &update_interval);
     if(filmid != -1)
       cntr++;
+    dt_import_prefetch_advance(prefetch);
+    if(++batched >= DT_IMPORT_BATCH_SIZE)
+    {
+      dt_database_release_transaction(darktable.db);
+      dt_database_start_transaction(darktable.db);
+      batched = 0;
+    }
     fraction += 1.0 / total;
     const double currtime  = dt_get_wtime();
     if(currtime - last_prog_update > PROGRESS_UPDATE_INTERVAL)
@@ -3064,7 +3767,13 @@ static int32_t _control_import_job_run(dt_job_t *job)
       g_usleep(100);
     }
   }
+  dt_database_release_transaction(darktable.db);
+  dt_import_prefetch_destroy(prefetch);
   g_free(prev_output);
+#ifdef USE_LUA
+  // the scripts get the last images of the import right away
+  dt_lua_event_batch_flush();
+#endif
 
   dt_control_log(ngettext("imported %d image", "imported %d images", cntr), cntr);
   dt_control_queue_redraw_center();
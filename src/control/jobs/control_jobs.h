@@ -64,7 +64,14 @@ void dt_control_export(GList *imgid_list,
                        const dt_colorspaces_color_profile_type_t icc_type,
                        const gchar *icc_filename,
                        const dt_iop_color_intent_t icc_intent,
-                       const gchar *metadata_export);
+                       const gchar *metadata_export,
+                       const int queue_batch);
+// drop a batch and its images from the persistent export queue
+void dt_control_export_queue_remove(const int batch);
+// book imgid as exported: tags, export timestamp and the queue batch, if any.
+// returns TRUE if the tags changed. for storages deferring the store, see
+// DT_IMAGEIO_STORE_DEFERRED, may be called from any thread
+gboolean dt_control_export_image_done(const int queue_batch, const dt_imgid_t imgid);
 void dt_control_merge_hdr(void);
 void dt_control_import(GList *imgs, const char *datetime_override, const gboolean inplace);
 void dt_control_refresh_exif(void);
@@ -19,6 +19,7 @@
 #include "common/darktable.h"
 #include "common/collection.h"
 #include "common/film.h"
+#include "common/import_prefetch.h"
 #include <stdlib.h>
 
 typedef struct dt_film_import1_t
@@ -303,6 +304,9 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
   dt_film_t *cfr = film;
   int pending = 0;
   double last_update = dt_get_wtime();
+  dt_import_prefetch_t *prefetch = dt_import_prefetch_new(images);
+  int batched = 0;
+  dt_database_start_transaction(darktable.db);
   for(GList *image = images; image; image = g_list_next(image))
   {
     gchar *cdn = g_path_get_dirname((const gchar *)image->data);
@@ -334,6 +338,13 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
 
     /* import image */
     const dt_imgid_t imgid = dt_image_import(cfr->id, (const gchar *)image->data, FALSE, FALSE);
+    dt_import_prefetch_advance(prefetch);
+    if(++batched >= DT_IMPORT_BATCH_SIZE)
+    {
+      dt_database_release_transaction(darktable.db);
+      dt_database_start_transaction(darktable.db);
+      batched = 0;
+    }
     pending++;  // we have another image which hasn't been reported yet
     fraction += 1.0 / total;
     dt_control_job_set_progress(job, fraction);
@@ -356,6 +367,12 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
       break;
   }
+  dt_database_release_transaction(darktable.db);
+  dt_import_prefetch_destroy(prefetch);
+#ifdef USE_LUA
+  // the scripts get the last images of the import right away
+  dt_lua_event_batch_flush();
+#endif
 
   g_list_free_full(images, g_free);
   all_imgs = g_list_reverse(all_imgs);
@@ -24,6 +24,7 @@ typedef struct dt_image_load_t
 {
   dt_imgid_t imgid;
   dt_mipmap_size_t mip;
+  const void *owner;
 } dt_image_load_t;
 
 static int32_t _image_load_job_run(dt_job_t *job)
@@ -32,7 +33,10 @@ static int32_t _image_load_job_run(dt_job_t *job)
 
   // hook back into mipmap_cache:
   dt_mipmap_buffer_t buf;
-  dt_mipmap_cache_get(&buf, params->imgid, params->mip, DT_MIPMAP_BLOCKING, 'r');
+  // only the view which asked for it may cancel the generation
+  dt_mipmap_cache_set_owner(params->owner);
+  dt_mipmap_cache_get(&buf, params->imgid, params->mip, DT_MIPMAP_BLOCKING_CANCELLABLE, 'r');
+  dt_mipmap_cache_set_owner(NULL);
 
   if(buf.buf && buf.height && buf.width)
   {
@@ -46,7 +50,9 @@ static int32_t _image_load_job_run(dt_job_t *job)
   return 0;
 }
 
-dt_job_t *dt_image_load_job_create(dt_imgid_t id, dt_mipmap_size_t mip)
+dt_job_t *dt_image_load_job_create(dt_imgid_t id,
+                                   dt_mipmap_size_t mip,
+                                   const void *owner)
 {
   dt_job_t *job = dt_control_job_create(&_image_load_job_run, "load image %d mip %d", id, mip);
   if(!job) return NULL;
@@ -59,6 +65,7 @@ dt_job_t *dt_image_load_job_create(dt_imgid_t id, dt_mipmap_size_t mip)
   dt_control_job_set_params_with_size(job, params, sizeof(dt_image_load_t), free);
   params->imgid = id;
   params->mip = mip;
+  params->owner = owner;
   return job;
 }
 
@@ -23,7 +23,9 @@
 #include "control/control.h"
 #include <inttypes.h>
 
-dt_job_t *dt_image_load_job_create(dt_imgid_t imgid, dt_mipmap_size_t mip);
+dt_job_t *dt_image_load_job_create(dt_imgid_t imgid,
+                                   dt_mipmap_size_t mip,
+                                   const void *owner);
 
 dt_job_t *dt_image_import_job_create(dt_filmid_t filmid, const char *filename);
 
@@ -17,117 +17,104 @@
 */
 
 #include "control/jobs/sidecar_jobs.h"
+#include "common/atomic.h"
+#include "common/dtpthread.h"
+#include "common/image.h"
 
-static GSList *pending_images = NULL;
-static gboolean background_running = FALSE;
+// sidecars are written this long after they have been requested, requests
+// for the same image in the meantime are written once
+#define DT_SIDECAR_DELAY (G_TIME_SPAN_MILLISECOND * 500)
+// sidecars written in a row before the job sleeps
+#define DT_SIDECAR_BATCH 16
 
-#ifndef _OPENMP
-#include "common/dtpthread.h"
-static gboolean lock_initialized = FALSE;
+// the lock is set up once by dt_control_sidecar_synch_start() and stays
+static dt_atomic_int started = 0;
 static dt_pthread_mutex_t pending_mutex;
+// imgid -> time the sidecar is due, requests are written straight away
+// when not running
+static GHashTable *pending_images = NULL;
+static gboolean background_running = FALSE;
 
-static void _lock_pending_queue()
+// remove up to max images due before limit from the queue
+static GList *_take_pending(const gint64 limit, const int max)
 {
-  if(!lock_initialized)
+  GList *imgs = NULL;
+  int count = 0;
+  dt_pthread_mutex_lock(&pending_mutex);
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, pending_images);
+  while(count < max && g_hash_table_iter_next(&iter, &key, &value))
   {
-    dt_pthread_mutex_init(&pending_mutex, NULL);
-    lock_initialized = TRUE;
+    if(*(gint64 *)value <= limit)
+    {
+      imgs = g_list_prepend(imgs, key);
+      g_hash_table_iter_remove(&iter);
+      count++;
+    }
   }
-  dt_pthread_mutex_lock(&pending_mutex);
+  dt_pthread_mutex_unlock(&pending_mutex);
+  return imgs;
 }
 
-static void _unlock_pending_queue()
+static void _write_sidecars(GList *imgs)
 {
-  if(lock_initialized)
-  {
-    dt_pthread_mutex_unlock(&pending_mutex);
-  }
+  for(GList *l = imgs; l; l = g_list_next(l))
+    dt_image_write_sidecar_file(GPOINTER_TO_INT(l->data));
 }
-#endif /* !_OPENMP */
 
 static int32_t _control_write_sidecars_job_run(dt_job_t *job)
 {
-  GSList *imgs = NULL;
-  GHashTable *enqueued = g_hash_table_new(g_direct_hash, g_direct_equal);
-
-  double prev_fetch = 0;
-  // keep going until explicitly cancelled or darktable shuts down AND all writes have finished
-  while(imgs || (dt_control_running() && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED))
+  // keep going until explicitly cancelled or darktable shuts down AND all queued writes have finished
+  while(TRUE)
   {
-    GSList *new_imgs = NULL;
-    double curr_fetch = dt_get_wtime();
-    // grab any pending images and add them to the list of images to be synchronized
-    if(curr_fetch > prev_fetch + 0.25)
-    {
-      prev_fetch = curr_fetch;
-#ifdef _OPENMP
-#pragma omp atomic capture
-      { new_imgs = pending_images; pending_images = NULL ; }
-#else
-      // don't have atomics, so use locks instead
-      _lock_pending_queue();
-      new_imgs = pending_images;
-      pending_images = NULL;
-      _unlock_pending_queue();
-#endif
-      if(new_imgs)
-      {
-        // add the new images to the queue being processed if they are not already on the queue
-        GSList *to_add = NULL;
-        for(GSList *imglist = new_imgs; imglist; imglist = g_slist_next(imglist))
-        {
-          if(!g_hash_table_contains(enqueued,GINT_TO_POINTER(imglist->data)))
-          {
-            to_add = g_slist_prepend(to_add, imglist->data);
-            g_hash_table_insert(enqueued, GINT_TO_POINTER(imglist->data), GINT_TO_POINTER(imglist->data));
-          }
-        }
-        imgs = g_slist_concat(imgs, to_add);
-        g_slist_free(new_imgs);
-      }
-    }
-    // synchronize the first few images on the queue
-    for(int i = 0; imgs && i < 3; i++)
-    {
-      dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
-      dt_image_write_sidecar_file(imgid);
-      // remove the head of the image queue
-      g_hash_table_remove(enqueued, GINT_TO_POINTER(imgid));
-      imgs = g_slist_delete_link(imgs, imgs);
-    }
-    if(imgs) // do we have more images already queued?
+    const gboolean stopping =
+      !dt_control_running() || dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED;
+
+    // when stopping, don't wait for the requests to be due
+    GList *imgs = _take_pending(stopping ? G_MAXINT64 : g_get_monotonic_time(),
+                                DT_SIDECAR_BATCH);
+    _write_sidecars(imgs);
+
+    if(imgs)
     {
       // give others a chance to run by sleeping 10ms; avoids apparent
       // hangs when trying to switch views
-      g_usleep(10000);
+      if(!stopping) g_usleep(10000);
+      g_list_free(imgs);
     }
+    else if(stopping)
+      break;
     else
     {
-      // we currently have nothing to do, so wait 1 second before checking for more work
-      g_usleep(1000000);
+      // nothing due, check again shortly
+      g_usleep(100000);
     }
   }
-  g_hash_table_destroy(enqueued);
   return 0;
 }
 
-void dt_sidecar_synch_enqueue(dt_imgid_t imgid)
+// returns TRUE if the image has been queued
+static gboolean _enqueue(const dt_imgid_t imgid, const gint64 due)
 {
-  if(background_running)
+  if(!dt_atomic_get_int(&started)) return FALSE;
+
+  dt_pthread_mutex_lock(&pending_mutex);
+  const gboolean queued = background_running;
+  // an already queued image keeps its time, so steady changes don't postpone it forever
+  if(queued && !g_hash_table_contains(pending_images, GINT_TO_POINTER(imgid)))
   {
-    GSList *img = g_slist_prepend(NULL,GINT_TO_POINTER(imgid));
-#ifdef _OPENMP
-#pragma omp atomic capture
-    { img->next = pending_images; pending_images = img; }
-#else
-    // don't have atomics, so use locks instead
-    _lock_pending_queue();
-    img->next = pending_images;
-    pending_images = img;
-    _unlock_pending_queue();
-#endif
+    gint64 *when = g_new(gint64, 1);
+    *when = due;
+    g_hash_table_insert(pending_images, GINT_TO_POINTER(imgid), when);
   }
-  else
+  dt_pthread_mutex_unlock(&pending_mutex);
+  return queued;
+}
+
+void dt_sidecar_synch_enqueue(dt_imgid_t imgid)
+{
+  if(!_enqueue(imgid, g_get_monotonic_time() + DT_SIDECAR_DELAY))
   {
     // synchronize the sidecar immediately instead of queueing it for background write
     dt_image_write_sidecar_file(imgid);
@@ -136,44 +123,52 @@ void dt_sidecar_synch_enqueue(dt_imgid_t imgid)
 
 void dt_sidecar_synch_enqueue_list(const GList *imgs)
 {
-  if(!imgs)
-    return;
-  if(!background_running)
+  const gint64 due = g_get_monotonic_time() + DT_SIDECAR_DELAY;
+  for(const GList *ilist = imgs; ilist; ilist = g_list_next(ilist))
   {
-    // synchronize the sidecars immediately instead of queueing them for background write
-    for(const GList *ilist = imgs; ilist; ilist = g_list_next(ilist))
+    const dt_imgid_t imgid = GPOINTER_TO_INT(ilist->data);
+    if(!_enqueue(imgid, due))
     {
-      dt_image_write_sidecar_file(GPOINTER_TO_INT(ilist->data));
+      // synchronize the sidecar immediately instead of queueing it for background write
+      dt_image_write_sidecar_file(imgid);
     }
-    return;
-  }
-  GSList *new_imgs = NULL;
-  for(const GList *ilist = imgs; ilist; ilist = g_list_next(ilist))
-  {
-    new_imgs = g_slist_prepend(new_imgs,ilist->data);
   }
-  GSList *last = g_slist_last(new_imgs);
-#ifdef _OPENMP
-#pragma omp atomic capture
-  { last->next = pending_images; pending_images = new_imgs; }
-#else
-  // don't have atomics, so use locks instead
-  _lock_pending_queue();
-  last->next = pending_images;
-  pending_images = new_imgs;
-  _unlock_pending_queue();
-#endif
+}
+
+void dt_sidecar_synch_flush()
+{
+  if(!dt_atomic_get_int(&started)) return;
+
+  // from now on sidecars are written right away
+  dt_pthread_mutex_lock(&pending_mutex);
+  background_running = FALSE;
+  dt_pthread_mutex_unlock(&pending_mutex);
+
+  GList *imgs = _take_pending(G_MAXINT64, G_MAXINT);
+  if(imgs)
+    dt_print(DT_DEBUG_CONTROL, "[sidecar] writing %d queued sidecars", g_list_length(imgs));
+  _write_sidecars(imgs);
+  g_list_free(imgs);
 }
 
 void dt_control_sidecar_synch_start()
 {
+  if(!dt_atomic_get_int(&started))
+  {
+    dt_pthread_mutex_init(&pending_mutex, NULL);
+    pending_images = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    dt_atomic_set_int(&started, 1);
+  }
+
   dt_job_t *job = dt_control_job_create(_control_write_sidecars_job_run, "%s", N_("synchronize sidecars"));
   if(!job)
   {
     return;
   }
-  dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, job);
+  dt_pthread_mutex_lock(&pending_mutex);
   background_running = TRUE;
+  dt_pthread_mutex_unlock(&pending_mutex);
+  dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, job);
 }
 
 // clang-format off
@@ -24,6 +24,9 @@
 void dt_sidecar_synch_enqueue(dt_imgid_t imgid);
 void dt_sidecar_synch_enqueue_list(const GList *imgs);
 void dt_control_sidecar_synch_start();
+// write all queued sidecars now and stop queueing, must be called on shutdown
+// once the background jobs have finished
+void dt_sidecar_synch_flush();
 
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
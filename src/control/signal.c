@@ -45,6 +45,9 @@ typedef struct dt_signal_description
   GType *param_types;
   GCallback destructor;
   gboolean synchronous;
+  // raises queued from other threads before the first one is dispatched
+  // are merged, see _signal_coalesce()
+  gboolean coalesce;
 } dt_signal_description;
 
 
@@ -98,14 +101,14 @@ static void _image_geotag_destroy_callback(gpointer instance, gpointer imgs, con
 static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
   /* Global signals */
   [DT_SIGNAL_MOUSE_OVER_IMAGE_CHANGE] = { "dt-global-mouse-over-image-change",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
   [DT_SIGNAL_ACTIVE_IMAGES_CHANGE] = { "dt-global-active-images-change",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_CONTROL_REDRAW_ALL] = { "dt-control-redraw-all",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
   [DT_SIGNAL_CONTROL_REDRAW_CENTER] = { "dt-control-redraw-center",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_VIEWMANAGER_VIEW_CHANGED] = { "dt-viewmanager-view-changed",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 2, pointer_2arg, NULL, FALSE },
@@ -117,23 +120,23 @@ static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 4, collection_args,
     G_CALLBACK(_collection_changed_destroy_callback), FALSE },
   [DT_SIGNAL_SELECTION_CHANGED] = { "dt-selection-changed",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
   [DT_SIGNAL_TAG_CHANGED] = { "dt-tag-changed",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
   [DT_SIGNAL_GEOTAG_CHANGED] = { "dt-geotag-changed",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 2, geotag_arg,
-    G_CALLBACK(_image_geotag_destroy_callback), FALSE },
+    G_CALLBACK(_image_geotag_destroy_callback), FALSE, TRUE },
   [DT_SIGNAL_METADATA_CHANGED] = { "dt-metadata-changed",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__UINT, 1, uint_arg, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__UINT, 1, uint_arg, NULL, FALSE, TRUE },
   [DT_SIGNAL_IMAGE_INFO_CHANGED] = { "dt-image-info-changed",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 1, pointer_arg,
-    G_CALLBACK(_image_info_changed_destroy_callback), FALSE },
+    G_CALLBACK(_image_info_changed_destroy_callback), FALSE, TRUE },
   [DT_SIGNAL_STYLE_CHANGED] = { "dt-style-changed",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
   [DT_SIGNAL_IMAGES_ORDER_CHANGE] = { "dt-images-order-change",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 1, pointer_arg, NULL, FALSE },
   [DT_SIGNAL_FILMROLLS_CHANGED] = { "dt-filmrolls-changed",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
   [DT_SIGNAL_FILMROLLS_IMPORTED] = { "dt-filmrolls-imported",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__UINT, 1, uint_arg, NULL, FALSE },
   [DT_SIGNAL_FILMROLLS_REMOVED] = { "dt-filmrolls-removed",
@@ -152,7 +155,7 @@ static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
   [DT_SIGNAL_DEVELOP_INITIALIZE] = { "dt-develop-initialized",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
   [DT_SIGNAL_DEVELOP_MIPMAP_UPDATED] = { "dt-develop-mipmap-updated",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__UINT, 1, uint_arg, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__UINT, 1, uint_arg, NULL, FALSE, TRUE },
   [DT_SIGNAL_DEVELOP_PREVIEW_PIPE_FINISHED] = { "dt-develop-preview-pipe-finished",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
   [DT_SIGNAL_DEVELOP_PREVIEW2_PIPE_FINISHED] = { "dt-develop-preview2-pipe-finished",
@@ -194,19 +197,19 @@ static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
 
   [DT_SIGNAL_CONTROL_NAVIGATION_REDRAW] = { "dt-control-navigation-redraw",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_CONTROL_LOG_REDRAW] = { "dt-control-log-redraw",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_CONTROL_TOAST_REDRAW] = { "dt-control-toast-redraw",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_CONTROL_PICKERDATA_READY] = { "dt-control-pickerdata-ready",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 2, pointer_2arg, NULL, FALSE },
 
   [DT_SIGNAL_METADATA_UPDATE] = { "dt-metadata-update",
-    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE },
+    NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0, NULL, NULL, FALSE, TRUE },
 
   [DT_SIGNAL_TROUBLE_MESSAGE] = { "dt-trouble-message",
     NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 3, pointer_trouble, NULL, FALSE },
@@ -258,11 +261,122 @@ typedef struct _signal_param_t
   GValue *instance_and_params;
   guint signal_id;
   guint n_params;
+
+  dt_signal_t signal;
+  int merged;              // raises merged into this one
 } _signal_param_t;
 
+// raises of coalescing signals waiting for the main loop, per signal
+static GMutex _pending_lock;
+static GList *_pending[DT_SIGNAL_COUNT];
+
+// dispatched and merged raises, for -d signal
+static guint _dispatched[DT_SIGNAL_COUNT];
+static guint _merged[DT_SIGNAL_COUNT];
+
+static GList *_signal_unique_list(GList *imgs)
+{
+  GHashTable *seen = g_hash_table_new(NULL, NULL);
+  GList *unique = NULL;
+  for(GList *l = imgs; l; l = g_list_next(l))
+  {
+    if(g_hash_table_add(seen, l->data))
+      unique = g_list_prepend(unique, l->data);
+  }
+  g_hash_table_destroy(seen);
+  g_list_free(imgs);
+  return g_list_reverse(unique);
+}
+
+// merge the arguments of params into pending if they are the same
+// signal and the handlers can't tell one from two raises: no arguments,
+// the same uint argument, or image lists to union (with the same
+// location for the geotag). pending takes the image list of params.
+static gboolean _signal_merge(_signal_param_t *pending,
+                              _signal_param_t *params)
+{
+  GValue *pv = pending->instance_and_params;
+  GValue *nv = params->instance_and_params;
+
+  switch(params->signal)
+  {
+    case DT_SIGNAL_DEVELOP_MIPMAP_UPDATED:
+    case DT_SIGNAL_METADATA_CHANGED:
+      return g_value_get_uint(&pv[1]) == g_value_get_uint(&nv[1]);
+
+    case DT_SIGNAL_GEOTAG_CHANGED:
+      if(g_value_get_uint(&pv[2]) != g_value_get_uint(&nv[2])) return FALSE;
+      // fall through
+    case DT_SIGNAL_IMAGE_INFO_CHANGED:
+    {
+      GList *pimgs = g_value_get_pointer(&pv[1]);
+      GList *nimgs = g_value_get_pointer(&nv[1]);
+      if(!pimgs || !nimgs) return FALSE;
+      g_value_set_pointer(&pv[1], g_list_concat(pimgs, nimgs));
+      g_value_set_pointer(&nv[1], NULL);
+      return TRUE;
+    }
+
+    default:
+      return params->n_params == 0;
+  }
+}
+
+// queue params to the pending raise it can be merged with, TRUE if so
+// and params is freed
+static gboolean _signal_coalesce(_signal_param_t *params)
+{
+  gboolean merged = FALSE;
+  g_mutex_lock(&_pending_lock);
+  for(GList *l = _pending[params->signal]; l && !merged; l = g_list_next(l))
+  {
+    _signal_param_t *pending = l->data;
+    if(_signal_merge(pending, params))
+    {
+      pending->merged++;
+      _merged[params->signal]++;
+      merged = TRUE;
+    }
+  }
+  if(!merged)
+    _pending[params->signal] = g_list_append(_pending[params->signal], params);
+  g_mutex_unlock(&_pending_lock);
+
+  if(merged)
+  {
+    for(int i = 0; i <= params->n_params; i++) g_value_unset(&params->instance_and_params[i]);
+    free(params->instance_and_params);
+    free(params);
+  }
+  return merged;
+}
+
 static gboolean _signal_raise(gpointer user_data)
 {
   _signal_param_t *params = (_signal_param_t *)user_data;
+
+  if(_signal_description[params->signal].coalesce)
+  {
+    // no more merging into this raise from now on
+    g_mutex_lock(&_pending_lock);
+    _pending[params->signal] = g_list_remove(_pending[params->signal], params);
+    _dispatched[params->signal]++;
+    g_mutex_unlock(&_pending_lock);
+
+    if(params->merged)
+    {
+      GValue *v = &params->instance_and_params[1];
+      if(params->signal == DT_SIGNAL_IMAGE_INFO_CHANGED
+         || params->signal == DT_SIGNAL_GEOTAG_CHANGED)
+        g_value_set_pointer(v, _signal_unique_list(g_value_get_pointer(v)));
+
+      dt_print(DT_DEBUG_SIGNAL,
+               "[signal] %s: %d raises merged, %u dispatched and %u merged so far",
+               _signal_description[params->signal].name, params->merged + 1,
+               _dispatched[params->signal], _merged[params->signal]);
+    }
+  }
+
   g_signal_emitv(params->instance_and_params, params->signal_id, 0, NULL);
   for(int i = 0; i <= params->n_params; i++) g_value_unset(&params->instance_and_params[i]);
   free(params->instance_and_params);
@@ -370,9 +484,17 @@ void dt_control_signal_raise(const dt_control_signal_t *ctlsig, dt_signal_t sign
   params->instance_and_params = instance_and_params;
   params->signal_id = g_signal_lookup(_signal_description[signal].name, _signal_type);
   params->n_params = signal_description->n_params;
+  params->signal = signal;
+  params->merged = 0;
 
   if(!signal_description->synchronous)
   {
+    // from the gui thread the raise is dispatched right away, from the
+    // others it may be merged with one still waiting for the main loop
+    if(signal_description->coalesce
+       && !pthread_equal(darktable.control->gui_thread, pthread_self())
+       && _signal_coalesce(params))
+      return;
     g_main_context_invoke_full(NULL, G_PRIORITY_HIGH_IDLE, _signal_raise, params, NULL);
   }
   else
@@ -29,6 +29,9 @@
 #include "develop/imageop_math.h"
 #include <math.h>
 
+// input, output and mask of a band of rows blended at once
+#define DT_BLEND_BAND_BYTES (4 << 20)
+
 typedef enum _develop_mask_post_processing
 {
   DEVELOP_MASK_POST_NONE = 0,
@@ -455,6 +458,100 @@ static const char *_develop_blend_colorspace_to_str(const dt_develop_blend_color
 }
 
 /* we test in pixelpipe processing if this required */
+// get parametric mask (if any) and apply global opacity
+static void _blendif_make_mask(dt_dev_pixelpipe_iop_t *piece,
+                               const float *const restrict a,
+                               const float *const restrict b,
+                               const dt_iop_roi_t *const roi_in,
+                               const dt_iop_roi_t *const roi_out,
+                               float *const restrict mask)
+{
+  const dt_develop_blend_params_t *const d = piece->blendop_data;
+  switch(d->blend_cst)
+  {
+    case DEVELOP_BLEND_CS_LAB:
+      dt_develop_blendif_lab_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RGB_DISPLAY:
+      dt_develop_blendif_rgb_hsl_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RGB_SCENE:
+      dt_develop_blendif_rgb_jzczhz_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RAW:
+      dt_develop_blendif_raw_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    default:
+      break;
+  }
+}
+
+// apply blending with per-pixel opacity value as defined in mask
+static void _blendif_blend(dt_dev_pixelpipe_iop_t *piece,
+                           const float *const restrict a,
+                           float *const restrict b,
+                           const dt_iop_roi_t *const roi_in,
+                           const dt_iop_roi_t *const roi_out,
+                           const float *const restrict mask,
+                           const dt_dev_pixelpipe_display_mask_t request_mask_display)
+{
+  const dt_develop_blend_params_t *const d = piece->blendop_data;
+  switch(d->blend_cst)
+  {
+    case DEVELOP_BLEND_CS_LAB:
+      dt_develop_blendif_lab_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RGB_DISPLAY:
+      dt_develop_blendif_rgb_hsl_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RGB_SCENE:
+      dt_develop_blendif_rgb_jzczhz_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RAW:
+      dt_develop_blendif_raw_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    default:
+      break;
+  }
+}
+
+/* A parametric mask without drawn form, feathering, blur or detail refinement
+   only depends on the same pixel of input and output. Mask and blend are then
+   done band after band of rows, the band of input, output and mask still in the
+   cache while blending, instead of two sweeps over the whole image. The mask
+   holds a single band.
+*/
+static void _develop_blend_process_bands(dt_dev_pixelpipe_iop_t *piece,
+                                         const float *const restrict a,
+                                         float *const restrict b,
+                                         const dt_iop_roi_t *const roi_in,
+                                         const dt_iop_roi_t *const roi_out,
+                                         float *const restrict mask,
+                                         const int band_rows,
+                                         const gboolean tone_curve)
+{
+  const dt_develop_blend_params_t *const d = piece->blendop_data;
+  const size_t ch = piece->colors;
+  const int owidth = roi_out->width;
+  const float opacity = CLIP(d->opacity / 100.0f);
+  const float fill = (d->mask_combine & DEVELOP_COMBINE_INCL) ? 0.0f : 1.0f;
+
+  for(int y = 0; y < roi_out->height; y += band_rows)
+  {
+    dt_iop_roi_t band = *roi_out;
+    band.y = roi_out->y + y;
+    band.height = MIN(band_rows, roi_out->height - y);
+    float *const restrict out = b + (size_t)y * owidth * ch;
+
+    dt_iop_image_fill(mask, fill, owidth, band.height, 1); // mask[k] = fill;
+    _blendif_make_mask(piece, a, out, roi_in, &band, mask);
+    if(tone_curve)
+      _develop_blend_process_mask_tone_curve(mask, (size_t)owidth * band.height,
+                                             d->contrast, d->brightness, opacity);
+    _blendif_blend(piece, a, out, roi_in, &band, mask, DT_DEV_PIXELPIPE_DISPLAY_NONE);
+  }
+}
+
 void dt_develop_blend_process(dt_iop_module_t *self,
                               dt_dev_pixelpipe_iop_t *piece,
                               const void *const ivoid,
@@ -528,8 +625,22 @@ void dt_develop_blend_process(dt_iop_module_t *self,
   // get the clipped opacity value  0 - 1
   const float opacity = CLIP(d->opacity / 100.0f);
 
+  // pixel-wise mask: blend band after band, see _develop_blend_process_bands()
+  const gboolean pointwise_post =
+    post_operations_size == 0
+    || (post_operations_size == 1 && post_operations[0] == DEVELOP_MASK_POST_TONE_CURVE);
+  const int band_rows = MAX(4 * (int)dt_get_num_threads(),
+                            (int)(DT_BLEND_BAND_BYTES / (MAX(owidth, 1) * (2 * ch + 1) * sizeof(float))));
+  const gboolean banded = !uniform && !raster && mode_parametric && !mode_drawn
+                          && pointwise_post
+                          && request_mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE
+                          && feqf(d->details, 0.0f, 1e-6f)
+                          && oheight > band_rows
+                          && !dt_iop_piece_is_raster_mask_used(piece, BLEND_RASTER_ID);
+
   // allocate space for blend mask used by roi_out
-  float *const restrict _mask = dt_alloc_align_float(obuffsize);
+  float *const restrict _mask =
+    dt_alloc_align_float(banded ? (size_t)owidth * band_rows : obuffsize);
   if(!_mask)
   {
     dt_print_pipe(DT_DEBUG_PIPE,
@@ -541,7 +652,19 @@ void dt_develop_blend_process(dt_iop_module_t *self,
 
   float *const restrict mask = _mask;
 
-  if(uniform)
+  if(banded)
+  {
+    dt_print_pipe(DT_DEBUG_PIPE,
+       "blend in bands",
+       piece->pipe, self, DT_DEVICE_CPU, roi_in, roi_out, "%s, %s, %i rows",
+       dt_iop_colorspace_to_name(cst),
+       _develop_blend_colorspace_to_str(blend_csp),
+       band_rows);
+    _develop_blend_process_bands(piece, (const float *const restrict)ivoid,
+                                 (float *const restrict)ovoid,
+                                 roi_in, roi_out, mask, band_rows, post_operations_size == 1);
+  }
+  else if(uniform)
   {
     // blend uniformly (no drawn or parametric mask)
     dt_iop_image_fill(mask, opacity, owidth, oheight, 1); // mask[k] = value;
@@ -629,36 +752,12 @@ void dt_develop_blend_process(dt_iop_module_t *self,
 
     _refine_with_detail_mask(self, piece, mask, roi_in, roi_out, d->details);
 
-    // get parametric mask (if any) and apply global opacity
-    switch(blend_csp)
-    {
-      case DEVELOP_BLEND_CS_LAB:
-        dt_develop_blendif_lab_make_mask(piece,
-                                         (const float *const restrict)ivoid,
-                                         (const float *const restrict)ovoid,
-                                         roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RGB_DISPLAY:
-        dt_develop_blendif_rgb_hsl_make_mask(piece, (const float *const restrict)ivoid,
-                                             (const float *const restrict)ovoid,
-                                             roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RGB_SCENE:
-        dt_develop_blendif_rgb_jzczhz_make_mask(piece, (const float *const restrict)ivoid,
-                                                (const float *const restrict)ovoid,
-                                                roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RAW:
-        dt_develop_blendif_raw_make_mask(piece, (const float *const restrict)ivoid,
-                                         (const float *const restrict)ovoid,
-                                         roi_in, roi_out, mask);
-        break;
-      default:
-        break;
-    }
+    _blendif_make_mask(piece, (const float *const restrict)ivoid,
+                       (const float *const restrict)ovoid,
+                       roi_in, roi_out, mask);
   }
 
-  if(!uniform)
+  if(!uniform && !banded)
   {
     const float guide_weight = _get_guide_weight(piece);
     const float sqrt_eps = _get_feathering_eps(piece);
@@ -722,32 +821,10 @@ void dt_develop_blend_process(dt_iop_module_t *self,
   }
 
   // now apply blending with per-pixel opacity value as defined in mask
-  // select the blend operator
-  switch(blend_csp)
-  {
-    case DEVELOP_BLEND_CS_LAB:
-      dt_develop_blendif_lab_blend(piece, (const float *const restrict)ivoid,
-                                   (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RGB_DISPLAY:
-      dt_develop_blendif_rgb_hsl_blend(piece, (const float *const restrict)ivoid,
-                                       (float *const restrict)ovoid,
-                                       roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RGB_SCENE:
-      dt_develop_blendif_rgb_jzczhz_blend(piece, (const float *const restrict)ivoid,
-                                          (float *const restrict)ovoid,
-                                          roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RAW:
-      dt_develop_blendif_raw_blend(piece, (const float *const restrict)ivoid,
-                                   (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
-      break;
-    default:
-      break;
-  }
+  if(!banded)
+    _blendif_blend(piece, (const float *const restrict)ivoid,
+                   (float *const restrict)ovoid,
+                   roi_in, roi_out, mask, request_mask_display);
 
   // register if _this_ module should expose mask or display channel
   if(request_mask_display
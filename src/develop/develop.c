@@ -51,6 +51,15 @@
 #endif
 
 #define DT_DEV_AVERAGE_DELAY_COUNT 5
+// progressive rendering of the center view: full pipe runs slower than this (ms)
+// are preceded by a coarse pass at 1/DT_DEV_PROGRESSIVE_FACTOR of the scale
+#define DT_DEV_PROGRESSIVE_DELAY 150
+#define DT_DEV_PROGRESSIVE_FACTOR 4
+#define DT_DEV_PROGRESSIVE_MIN_SIZE 64
+// slow full pipe runs are split into up to DT_DEV_PRIORITY_TILES^2 tiles of
+// at least DT_DEV_PRIORITY_TILE_SIZE pixels, processed nearest to the pointer first
+#define DT_DEV_PRIORITY_TILES 3
+#define DT_DEV_PRIORITY_TILE_SIZE 512
 
 // Margins (as a fraction of the image size) by which the editable "canvas" may
 // extend beyond the image while working on a mask, so off-image content can be
@@ -165,6 +174,7 @@ void dt_dev_init(dt_develop_t *dev,
   dev->full.closeup = dev->preview2.closeup = 0;
   dev->full.zoom_x = dev->full.zoom_y = dev->preview2.zoom_x = dev->preview2.zoom_y = 0.0f;
   dev->full.zoom_scale = dev->preview2.zoom_scale = 1.0f;
+  dev->full.focus_x = dev->full.focus_y = 0.5f;
 
   // Set back-pointers from viewports to their owning develop
   dev->full.dev = dev;
@@ -223,6 +233,8 @@ void dt_dev_cleanup(dt_develop_t *dev)
     dt_dev_pixelpipe_cleanup(dev->preview2.pipe);
     free(dev->preview2.pipe);
   }
+  if(dev->full.focus_peaking) cairo_surface_destroy(dev->full.focus_peaking);
+  if(dev->preview2.focus_peaking) cairo_surface_destroy(dev->preview2.focus_peaking);
   while(dev->history)
   {
     dt_dev_free_history_item(((dt_dev_history_item_t *)dev->history->data));
@@ -603,6 +615,84 @@ static void _dev_average_delay_update(const dt_times_t *start,
                      - *average_delay / DT_DEV_AVERAGE_DELAY_COUNT);
 }
 
+// process the area in tiles, the one nearest to port->focus first, and let
+// the center view paint each of them as soon as it is done. Once all tiles
+// of an area are done it is processed as a whole again, tiles only help to
+// get the first view of a new area or image.
+static gboolean _dev_process_tiles(dt_develop_t *dev,
+                                   dt_dev_viewport_t *port,
+                                   dt_dev_pixelpipe_t *pipe,
+                                   const int x,
+                                   const int y,
+                                   const int wd,
+                                   const int ht,
+                                   const float scale,
+                                   const int devid)
+{
+  const int nx = CLAMP(wd / DT_DEV_PRIORITY_TILE_SIZE, 1, DT_DEV_PRIORITY_TILES);
+  const int ny = CLAMP(ht / DT_DEV_PRIORITY_TILE_SIZE, 1, DT_DEV_PRIORITY_TILES);
+  const int num = nx * ny;
+  if(num == 1)
+    return dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid);
+
+  const float fx = port->focus_x * scale * pipe->processed_width;
+  const float fy = port->focus_y * scale * pipe->processed_height;
+
+  int order[DT_DEV_PRIORITY_TILES * DT_DEV_PRIORITY_TILES];
+  float dist[DT_DEV_PRIORITY_TILES * DT_DEV_PRIORITY_TILES];
+  for(int k = 0; k < num; k++)
+  {
+    const float cx = x + (k % nx + 0.5f) * wd / nx;
+    const float cy = y + (k / nx + 0.5f) * ht / ny;
+    const float d = sqf(cx - fx) + sqf(cy - fy);
+    int i = k;
+    for(; i > 0 && dist[i - 1] > d; i--)
+    {
+      dist[i] = dist[i - 1];
+      order[i] = order[i - 1];
+    }
+    dist[i] = d;
+    order[i] = k;
+  }
+
+  // the tiles are composed into a backbuf covering the whole area
+  pipe->region = (dt_iop_roi_t){ x, y, wd, ht, scale };
+  gboolean early = FALSE;
+  for(int k = 0; k < num && !early; k++)
+  {
+    const int i = order[k] % nx;
+    const int j = order[k] / nx;
+    const int tx = x + i * wd / nx;
+    const int ty = y + j * ht / ny;
+    const int tw = x + (i + 1) * wd / nx - tx;
+    const int th = y + (j + 1) * ht / ny - ty;
+
+    early = dt_dev_pixelpipe_process(pipe, dev, tx, ty, tw, th, scale, devid);
+    if(!early
+       && (dt_atomic_get_int(&pipe->shutdown) != DT_DEV_PIXELPIPE_STOP_NO
+           || pipe->changed != DT_DEV_PIPE_UNCHANGED
+           || dev->gui_leaving))
+      early = TRUE;
+    else if(!early && k < num - 1)
+      dt_control_queue_redraw_center();
+  }
+  if(!early) pipe->tiled_region = pipe->region;
+  pipe->region.width = pipe->region.height = 0;
+  return early;
+}
+
+static gboolean _dev_tiles_done(const dt_dev_pixelpipe_t *pipe,
+                                const int x,
+                                const int y,
+                                const int wd,
+                                const int ht,
+                                const float scale)
+{
+  const dt_iop_roi_t *t = &pipe->tiled_region;
+  return pipe->output_imgid == pipe->image.id
+    && t->x == x && t->y == y && t->width == wd && t->height == ht && t->scale == scale;
+}
+
 void dt_dev_process_image_job(dt_develop_t *dev,
                               dt_dev_viewport_t *port,
                               dt_dev_pixelpipe_t *pipe,
@@ -783,9 +873,45 @@ restart:
   const int x = port ? CLAMP(pipe_width  * (.5 + zoom_x) - wd / 2, 0, pipe_width  - wd) : 0;
   const int y = port ? CLAMP(pipe_height * (.5 + zoom_y) - ht / 2, 0, pipe_height - ht) : 0;
 
+  /* progressive rendering: if the last runs of the center view were slow, show a
+     coarse pass of the same area first. A history change or shutdown request while
+     it runs skips the full pass and restarts below, so slider drags keep getting
+     coarse feedback until they settle.
+  */
+  const int coarse = DT_DEV_PROGRESSIVE_FACTOR;
+  const gboolean slow = port == &dev->full
+                        && dev->gui_attached
+                        && pipe->average_delay > DT_DEV_PROGRESSIVE_DELAY;
+  gboolean early = FALSE;
+  if(slow
+     && wd >= coarse * DT_DEV_PROGRESSIVE_MIN_SIZE
+     && ht >= coarse * DT_DEV_PROGRESSIVE_MIN_SIZE
+     && dt_conf_get_bool("darkroom/ui/progressive_rendering"))
+  {
+    pipe->progressive = coarse;
+    dt_dev_pixelpipe_process(pipe, dev, x / coarse, y / coarse,
+                             wd / coarse, ht / coarse, scale / coarse, devid);
+    pipe->progressive = 0;
+
+    if(dt_atomic_get_int(&pipe->shutdown) != DT_DEV_PIXELPIPE_STOP_NO
+       || pipe->changed != DT_DEV_PIPE_UNCHANGED
+       || dev->gui_leaving)
+      early = TRUE;
+    else
+      dt_control_queue_redraw_center();
+  }
+
   dt_get_times(&start);
 
-  const gboolean early = dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid);
+  if(!early)
+  {
+    if(slow
+       && dt_conf_get_bool("darkroom/ui/priority_tiles")
+       && !_dev_tiles_done(pipe, x, y, wd, ht, scale))
+      early = _dev_process_tiles(dev, port, pipe, x, y, wd, ht, scale, devid);
+    else
+      early = dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid);
+  }
   const dt_dev_pixelpipe_stopper_t shutdown = dt_atomic_exch_int(&pipe->shutdown, DT_DEV_PIXELPIPE_STOP_NO);
   const gboolean stopped = early || shutdown != DT_DEV_PIXELPIPE_STOP_NO;
 
@@ -1182,6 +1308,18 @@ static void _dev_auto_module_label(dt_develop_t *dev,
   }
 }
 
+// the forms of the topmost history item having some, used to share
+// the unchanged forms with a new item
+static GList *_dev_last_history_forms(GList *history)
+{
+  for(GList *l = g_list_last(history); l; l = g_list_previous(l))
+  {
+    const dt_dev_history_item_t *hist = l->data;
+    if(hist->forms) return hist->forms;
+  }
+  return NULL;
+}
+
 static void _dev_add_history_item_ext(dt_develop_t *dev,
                                       dt_iop_module_t *module,
                                       const gboolean enable,
@@ -1286,7 +1424,8 @@ static void _dev_add_history_item_ext(dt_develop_t *dev,
     memcpy(hist->params, module->params, module->params_size);
     memcpy(hist->blend_params, module->blend_params, sizeof(dt_develop_blend_params_t));
     if(include_masks)
-      hist->forms = dt_masks_dup_forms_deep(dev->forms, NULL);
+      hist->forms = dt_masks_dup_forms_shared(dev->forms,
+                                              _dev_last_history_forms(dev->history));
     else
       hist->forms = NULL;
 
@@ -1316,8 +1455,9 @@ static void _dev_add_history_item_ext(dt_develop_t *dev,
 
     if(include_masks)
     {
+      GList *forms = dt_masks_dup_forms_shared(dev->forms, hist->forms);
       g_list_free_full(hist->forms, (void (*)(void *))dt_masks_free_form);
-      hist->forms = dt_masks_dup_forms_deep(dev->forms, NULL);
+      hist->forms = forms;
     }
     if(!no_image)
     {
@@ -1962,89 +2102,14 @@ static gboolean _dev_auto_apply_presets(dt_develop_t *dev)
   else
     excluded |= FOR_NOT_COLOR;
 
-  // select all presets from one of the following table and add them
-  // into memory.history. Note that this is appended to possibly
-  // already present default modules.
+  // add all matching presets into memory.history. Note that this is
+  // appended to possibly already present default modules.
   //
   // Also it may be possible that multiple presets for a module not
   // supporting multiple instances (e.g. demosaic) may be added. Those
   // instances are properly merged in dt_dev_read_history_ext.
 
-  char query[2048];
-  // clang-format off
-
-  const gboolean auto_module = dt_conf_get_bool("darkroom/ui/auto_module_name_update");
-
-  snprintf(query, sizeof(query),
-           "INSERT OR REPLACE INTO memory.history"
-           " SELECT ?1, 0, op_version, operation AS op, op_params,"
-           "       enabled, blendop_params, blendop_version,"
-           "       ROW_NUMBER() OVER (PARTITION BY operation ORDER BY operation) - 1,"
-           "       %s, multi_name_hand_edited"
-           " FROM data.presets"
-           // only auto-applied presets matching the camera/lens/focal/format/exposure
-           " WHERE ( (autoapply=1"
-           "          AND ((?2 LIKE model AND ?3 LIKE maker)"
-           "               OR (?4 LIKE model AND ?5 LIKE maker))"
-           "          AND ?6 LIKE lens AND ?7 BETWEEN iso_min AND iso_max"
-           "          AND ?8 BETWEEN exposure_min AND exposure_max"
-           "          AND ?9 BETWEEN aperture_min AND aperture_max"
-           "          AND ?10 BETWEEN focal_length_min AND focal_length_max"
-           "          AND (format = 0 OR (format&?11 != 0 AND ~format&?12 != 0))))"
-           // skip non iop modules:
-           "   AND operation NOT IN"
-           "       ('ioporder', 'metadata', 'modulegroups', 'export',"
-           "        'tagging', 'collect', '%s')"
-           // select all user's auto presets or the hard-coded presets (for the workflow)
-           // if non auto-presets for the same operation and matching
-           // camera/lens/focal/format/exposure found.
-           "   AND (writeprotect = 0"
-           "        OR (SELECT NOT EXISTS"
-           "             (SELECT op"
-           "              FROM presets"
-           "              WHERE autoapply = 1 AND operation = op AND writeprotect = 0"
-           "                    AND ((?2 LIKE model AND ?3 LIKE maker)"
-           "                         OR (?4 LIKE model AND ?5 LIKE maker))"
-           "                    AND ?6 LIKE lens AND ?7 BETWEEN iso_min AND iso_max"
-           "                    AND ?8 BETWEEN exposure_min AND exposure_max"
-           "                    AND ?9 BETWEEN aperture_min AND aperture_max"
-           "                    AND ?10 BETWEEN focal_length_min AND focal_length_max"
-           "                    AND (format = 0 OR (format&?11 != 0 AND ~format&?12 != 0)))))"
-           " ORDER BY writeprotect DESC, LENGTH(model), LENGTH(maker), LENGTH(lens)",
-           // auto module:
-           //  ON  : we take as the preset label either the multi-name
-           //        if defined or the preset name.
-           //  OFF : we take the multi-name only if hand-edited otherwise a
-           //        simple incremental instance number (equivalent to the multi_priority
-           //        field is used).
-           auto_module
-             ? "COALESCE(NULLIF(multi_name,''), NULLIF(name,''))"
-             : "CASE WHEN multi_name_hand_edited"
-               "  THEN multi_name"
-               "  ELSE (ROW_NUMBER() OVER (PARTITION BY operation ORDER BY operation) - 1)"
-               " END",
-           is_display_referred ? "" : "basecurve");
-  // clang-format on
-
-  // query for all modules at once:
-  sqlite3_stmt *stmt;
-
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, image->exif_model, -1, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, image->exif_maker, -1, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 4, image->camera_alias, -1, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 5, image->camera_maker, -1, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 6, image->exif_lens, -1, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 7, fmaxf(0.0f, fminf(FLT_MAX, image->exif_iso)));
-  DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 8, fmaxf(0.0f, fminf(1000000, image->exif_exposure)));
-  DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 9, fmaxf(0.0f, fminf(1000000, image->exif_aperture)));
-  DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 10, fmaxf(0.0f, fminf(1000000, image->exif_focal_length)));
-  // 0: dontcare, 1: ldr, 2: raw plus monochrome & color
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 11, iformat);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 12, excluded);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_presets_auto_apply(image, iformat, excluded, is_display_referred ? NULL : "basecurve");
 
   // now we want to auto-apply the iop-order list if one corresponds and none are
   // still applied. Note that we can already have an iop-order list set when
@@ -2052,51 +2117,17 @@ static gboolean _dev_auto_apply_presets(dt_develop_t *dev)
 
   if(!dt_ioppr_has_iop_order_list(imgid))
   {
-    // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
-       "SELECT op_params"
-       " FROM data.presets"
-       " WHERE autoapply=1"
-       "       AND ((?2 LIKE model AND ?3 LIKE maker) OR (?4 LIKE model AND ?5 LIKE maker))"
-       "       AND ?6 LIKE lens AND ?7 BETWEEN iso_min AND iso_max"
-       "       AND ?8 BETWEEN exposure_min AND exposure_max"
-       "       AND ?9 BETWEEN aperture_min AND aperture_max"
-       "       AND ?10 BETWEEN focal_length_min AND focal_length_max"
-       "       AND (format = 0 OR (format&?11 != 0 AND ~format&?12 != 0))"
-       "       AND operation = 'ioporder'"
-       " ORDER BY writeprotect ASC, LENGTH(model), LENGTH(maker), LENGTH(lens)",
-       -1, &stmt, NULL);
-    // NOTE: the order "writeprotect ASC" is very important as it ensure that
-    //       user's defined presets are listed first and will be used instead of
-    //       the darktable internal ones.
-    // clang-format on
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, image->exif_model, -1, SQLITE_TRANSIENT);
-    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, image->exif_maker, -1, SQLITE_TRANSIENT);
-    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 4, image->camera_alias, -1, SQLITE_TRANSIENT);
-    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 5, image->camera_maker, -1, SQLITE_TRANSIENT);
-    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 6, image->exif_lens, -1, SQLITE_TRANSIENT);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 7, fmaxf(0.0f, fminf(FLT_MAX, image->exif_iso)));
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 8, fmaxf(0.0f,
-                                                fminf(1000000, image->exif_exposure)));
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 9, fmaxf(0.0f,
-                                                fminf(1000000, image->exif_aperture)));
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 10, fmaxf(0.0f,
-                                                 fminf(1000000, image->exif_focal_length)));
-    // 0: dontcare, 1: ldr, 2: raw plus monochrome & color
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 11, iformat);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 12, excluded);
-
+    // NOTE: user's defined presets are used instead of the darktable internal ones.
+    void *params = NULL;
+    int32_t params_len = 0;
     GList *iop_list = NULL;
 
-    if(sqlite3_step(stmt) == SQLITE_ROW)
+    if(dt_presets_get_auto_iop_order(image, iformat, excluded, &params, &params_len))
     {
       dt_print(DT_DEBUG_PARAMS,
                "[dev_auto_apply_presets] found iop-order preset, apply it on %d", imgid);
-      const char *params = (char *)sqlite3_column_blob(stmt, 0);
-      const int32_t params_len = sqlite3_column_bytes(stmt, 0);
       iop_list = dt_ioppr_deserialize_iop_order_list(params, params_len);
+      g_free(params);
     }
     else
     {
@@ -2127,8 +2158,6 @@ static gboolean _dev_auto_apply_presets(dt_develop_t *dev)
     g_list_free_full(mi_list, free);
     g_list_free_full(final_list, free);
     dt_ioppr_set_default_iop_order(dev, imgid);
-
-    sqlite3_finalize(stmt);
   }
 
   image->flags |= DT_IMAGE_AUTO_PRESETS_APPLIED | DT_IMAGE_NO_LEGACY_PRESETS;
@@ -2993,6 +3022,43 @@ static char *_transform_type(const dt_dev_transform_direction_t transf_direction
   }
 }
 
+typedef gboolean (*_dev_distort_fn_t)(dt_iop_module_t*, dt_dev_pixelpipe_iop_t*, float*, size_t);
+
+// the transform of the piece if it applies in that direction
+static _dev_distort_fn_t _dev_distort_piece_transform(dt_develop_t *dev,
+                                                      dt_dev_pixelpipe_t *pipe,
+                                                      dt_iop_module_t *module,
+                                                      dt_dev_pixelpipe_iop_t *piece,
+                                                      const gboolean back,
+                                                      const double iop_order,
+                                                      const dt_dev_transform_direction_t transf_direction)
+{
+  _dev_distort_fn_t transform =
+    back
+    ? module->distort_backtransform
+    : module->distort_transform;
+
+  if(piece->enabled
+     && transform
+     && piece->data
+     && ((transf_direction == DT_DEV_TRANSFORM_DIR_ALL)
+         || (transf_direction == DT_DEV_TRANSFORM_DIR_ALL_GEOMETRY
+             && !(module->operation_tags() & IOP_TAG_GEOMETRY))
+         || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_INCL
+             && module->iop_order >= iop_order)
+         || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_EXCL
+             && module->iop_order > iop_order)
+         || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_INCL
+             && module->iop_order <= iop_order)
+         || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_EXCL
+             && module->iop_order < iop_order))
+     && !(dt_iop_module_is_skipped(dev, module)
+          && (pipe->type & DT_DEV_PIXELPIPE_BASIC)))
+    return transform;
+
+  return NULL;
+}
+
 // running with the history locked
 static gboolean _dev_distort_transform_locked(dt_develop_t *dev,
                                               dt_dev_pixelpipe_t *pipe,
@@ -3014,27 +3080,10 @@ static gboolean _dev_distort_transform_locked(dt_develop_t *dev,
     }
     dt_iop_module_t *module = modules->data;
     dt_dev_pixelpipe_iop_t *piece = pieces->data;
-    gboolean (*transform)(dt_iop_module_t*, dt_dev_pixelpipe_iop_t*, float*, size_t) =
-      back
-      ? module->distort_backtransform
-      : module->distort_transform;
-
-    if(piece->enabled
-       && transform
-       && piece->data
-       && ((transf_direction == DT_DEV_TRANSFORM_DIR_ALL)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_ALL_GEOMETRY
-               && !(module->operation_tags() & IOP_TAG_GEOMETRY))
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_INCL
-               && module->iop_order >= iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_EXCL
-               && module->iop_order > iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_INCL
-               && module->iop_order <= iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_EXCL
-               && module->iop_order < iop_order))
-       && !(dt_iop_module_is_skipped(dev, module)
-            && (pipe->type & DT_DEV_PIXELPIPE_BASIC)))
+    _dev_distort_fn_t transform =
+      _dev_distort_piece_transform(dev, pipe, module, piece, back, iop_order, transf_direction);
+
+    if(transform)
     {
       if(log)
       {
@@ -3066,6 +3115,206 @@ static gboolean _dev_distort_transform_locked(dt_develop_t *dev,
   return TRUE;
 }
 
+/*
+ * the mask gui sends the points of a form through the distortion
+ * chain of the preview pipe on every mouse move. most of them are the
+ * same as last time, only the part around the edited node moves. the
+ * transformed coordinates are kept per pipe state so that only new
+ * points go through the modules.
+ */
+
+// fewer points are transformed directly
+#define DT_DEV_DISTORT_MEMO_MIN 64
+#define DT_DEV_DISTORT_MEMO_MAX (1 << 22)
+#define DT_DEV_DISTORT_MEMO_EMPTY UINT64_MAX
+
+static dt_hash_t _dev_distort_memo_state(dt_develop_t *dev,
+                                         dt_dev_pixelpipe_t *pipe,
+                                         const gboolean back,
+                                         const double iop_order,
+                                         const dt_dev_transform_direction_t transf_direction)
+{
+  dt_hash_t hash = dt_hash(DT_INITHASH, &back, sizeof(back));
+  hash = dt_hash(hash, &iop_order, sizeof(iop_order));
+  hash = dt_hash(hash, &transf_direction, sizeof(transf_direction));
+  hash = dt_hash(hash, &pipe->image.id, sizeof(pipe->image.id));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+
+  GList *modules = pipe->iop;
+  for(GList *pieces = pipe->nodes;
+      pieces && modules;
+      pieces = g_list_next(pieces), modules = g_list_next(modules))
+  {
+    dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(_dev_distort_piece_transform(dev, pipe, modules->data, piece,
+                                    back, iop_order, transf_direction))
+    {
+      hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
+      hash = dt_hash(hash, &piece->buf_in, sizeof(piece->buf_in));
+      hash = dt_hash(hash, &piece->buf_out, sizeof(piece->buf_out));
+    }
+  }
+  return hash;
+}
+
+static inline size_t _dev_distort_memo_slot(const dt_dev_distort_memo_t *memo,
+                                            const uint64_t key)
+{
+  size_t slot = (size_t)((key * 0x9e3779b97f4a7c15ull) >> 32) & (memo->size - 1);
+  while(memo->keys[slot] != key && memo->keys[slot] != DT_DEV_DISTORT_MEMO_EMPTY)
+    slot = (slot + 1) & (memo->size - 1);
+  return slot;
+}
+
+static inline uint64_t _dev_distort_memo_key(const float *p)
+{
+  uint32_t x, y;
+  memcpy(&x, p, sizeof(x));
+  memcpy(&y, p + 1, sizeof(y));
+  return (uint64_t)x << 32 | y;
+}
+
+static gboolean _dev_distort_transform_memo(dt_develop_t *dev,
+                                            dt_dev_pixelpipe_t *pipe,
+                                            const gboolean back,
+                                            const double iop_order,
+                                            const dt_dev_transform_direction_t transf_direction,
+                                            float *points,
+                                            const size_t points_count)
+{
+  const dt_hash_t state =
+    _dev_distort_memo_state(dev, pipe, back, iop_order, transf_direction);
+
+  dt_dev_distort_memo_t *memo = NULL;
+  for(int k = 0; k < DT_DEV_DISTORT_MEMO_SLOTS && !memo; k++)
+    if(pipe->distort_memo[k].state == state && pipe->distort_memo[k].keys)
+      memo = &pipe->distort_memo[k];
+
+  if(!memo)
+  {
+    memo = &pipe->distort_memo[pipe->distort_memo_next];
+    pipe->distort_memo_next = (pipe->distort_memo_next + 1) % DT_DEV_DISTORT_MEMO_SLOTS;
+    memo->state = state;
+    memo->count = memo->size; // cleared below
+  }
+
+  // keep the table at most half full, start over when it gets there
+  if(memo->size < 4 * points_count)
+  {
+    size_t size = 1024;
+    while(size < 4 * points_count) size <<= 1;
+    dt_free_align(memo->keys);
+    dt_free_align(memo->values);
+    memo->keys = dt_alloc_align_type(uint64_t, size);
+    memo->values = dt_alloc_align_float(2 * size);
+    memo->size = memo->keys && memo->values ? size : 0;
+    memo->count = memo->size;
+  }
+  if(!memo->size)
+    return _dev_distort_transform_locked(dev, pipe, back, iop_order,
+                                         transf_direction, points, points_count);
+  if(memo->count + points_count > memo->size / 2)
+  {
+    memset(memo->keys, 0xff, sizeof(uint64_t) * memo->size);
+    memo->count = 0;
+  }
+
+  size_t *missed = dt_alloc_align_type(size_t, points_count);
+  float *batch = dt_alloc_align_float(2 * points_count);
+  if(!missed || !batch)
+  {
+    dt_free_align(missed);
+    dt_free_align(batch);
+    return _dev_distort_transform_locked(dev, pipe, back, iop_order,
+                                         transf_direction, points, points_count);
+  }
+
+  size_t n = 0;
+  for(size_t i = 0; i < points_count; i++)
+  {
+    const uint64_t key = _dev_distort_memo_key(points + 2 * i);
+    const size_t slot = _dev_distort_memo_slot(memo, key);
+    if(key != DT_DEV_DISTORT_MEMO_EMPTY && memo->keys[slot] == key)
+    {
+      points[2 * i] = memo->values[2 * slot];
+      points[2 * i + 1] = memo->values[2 * slot + 1];
+    }
+    else
+    {
+      missed[n] = i;
+      batch[2 * n] = points[2 * i];
+      batch[2 * n + 1] = points[2 * i + 1];
+      n++;
+    }
+  }
+
+  gboolean success = TRUE;
+  if(n)
+    success = _dev_distort_transform_locked(dev, pipe, back, iop_order,
+                                            transf_direction, batch, n);
+  if(success)
+  {
+    for(size_t j = 0; j < n; j++)
+    {
+      float *p = points + 2 * missed[j];
+      const uint64_t key = _dev_distort_memo_key(p);
+      if(key != DT_DEV_DISTORT_MEMO_EMPTY)
+      {
+        const size_t slot = _dev_distort_memo_slot(memo, key);
+        if(memo->keys[slot] == DT_DEV_DISTORT_MEMO_EMPTY)
+        {
+          memo->keys[slot] = key;
+          memo->values[2 * slot] = batch[2 * j];
+          memo->values[2 * slot + 1] = batch[2 * j + 1];
+          memo->count++;
+        }
+      }
+      p[0] = batch[2 * j];
+      p[1] = batch[2 * j + 1];
+    }
+  }
+
+  dt_print(DT_DEBUG_MASKS | DT_DEBUG_VERBOSE,
+           "[dt_dev_distort_transform_memo] %s %s, %zu of %zu points transformed",
+           back ? "back" : "forward", _transform_type(transf_direction), n, points_count);
+
+  dt_free_align(missed);
+  dt_free_align(batch);
+  return success;
+}
+
+static gboolean _dev_distort_transform(dt_develop_t *dev,
+                                       dt_dev_pixelpipe_t *pipe,
+                                       const gboolean back,
+                                       const double iop_order,
+                                       const dt_dev_transform_direction_t transf_direction,
+                                       float *points,
+                                       const size_t points_count)
+{
+  return dev->gui_attached
+      && pipe == dev->preview_pipe
+      && points_count >= DT_DEV_DISTORT_MEMO_MIN
+      && points_count <= DT_DEV_DISTORT_MEMO_MAX
+    ? _dev_distort_transform_memo(dev, pipe, back, iop_order,
+                                  transf_direction, points, points_count)
+    : _dev_distort_transform_locked(dev, pipe, back, iop_order,
+                                    transf_direction, points, points_count);
+}
+
+void dt_dev_distort_memo_cleanup(dt_dev_pixelpipe_t *pipe)
+{
+  for(int k = 0; k < DT_DEV_DISTORT_MEMO_SLOTS; k++)
+  {
+    dt_dev_distort_memo_t *memo = &pipe->distort_memo[k];
+    dt_free_align(memo->keys);
+    dt_free_align(memo->values);
+    memset(memo, 0, sizeof(dt_dev_distort_memo_t));
+  }
+  pipe->distort_memo_next = 0;
+}
+
 // Compute the bounding box of the mask overlay currently being edited
 // (all displayed points, borders and clone sources), expressed in
 // normalised image coordinates where the image spans [-0.5, 0.5]. The
@@ -3818,8 +4067,8 @@ gboolean dt_dev_distort_transform_plus(dt_develop_t *dev,
                                        const size_t points_count)
 {
   dt_pthread_mutex_lock(&dev->history_mutex);
-  const gboolean success = _dev_distort_transform_locked(dev, pipe, FALSE, iop_order,
-                                                         transf_direction, points, points_count);
+  const gboolean success = _dev_distort_transform(dev, pipe, FALSE, iop_order,
+                                                  transf_direction, points, points_count);
   dt_pthread_mutex_unlock(&dev->history_mutex);
   return success;
 }
@@ -3833,8 +4082,8 @@ gboolean dt_dev_distort_backtransform_plus(dt_develop_t *dev,
                                            const size_t points_count)
 {
   dt_pthread_mutex_lock(&dev->history_mutex);
-  const gboolean success = _dev_distort_transform_locked(dev, pipe, TRUE, iop_order,
-                                                         transf_direction, points, points_count);
+  const gboolean success = _dev_distort_transform(dev, pipe, TRUE, iop_order,
+                                                  transf_direction, points, points_count);
   dt_pthread_mutex_unlock(&dev->history_mutex);
   return success;
 }
@@ -3843,17 +4092,7 @@ dt_dev_pixelpipe_iop_t *dt_dev_distort_get_iop_pipe(dt_develop_t *dev,
                                                     dt_dev_pixelpipe_t *pipe,
                                                     dt_iop_module_t *module)
 {
-  for(const GList *pieces = g_list_last(pipe->nodes);
-      pieces;
-      pieces = g_list_previous(pieces))
-  {
-    dt_dev_pixelpipe_iop_t *piece = pieces->data;
-    if(piece->module == module)
-    {
-      return piece;
-    }
-  }
-  return NULL;
+  return dt_dev_pixelpipe_get_piece(pipe, module);
 }
 
 dt_hash_t dt_dev_hash_plus(dt_develop_t *dev,
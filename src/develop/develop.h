@@ -124,6 +124,8 @@ typedef struct dt_dev_viewport_t
   int closeup;
   float zoom_x, zoom_y;
   float zoom_scale;
+  // last pointer position in normalized image coordinates, rendered first
+  float focus_x, focus_y;
 
   // image processing pipeline with caching
   struct dt_dev_pixelpipe_t *pipe;
@@ -133,6 +135,10 @@ typedef struct dt_dev_viewport_t
   
   // Back-pointer to the owning develop structure
   struct dt_develop_t *dev;
+
+  // focus peaking overlay of the backbuf last painted, only redone when that changes
+  cairo_surface_t *focus_peaking;
+  dt_hash_t focus_peaking_hash;
 } dt_dev_viewport_t;
 
 /* keep track on what and where we do chromatic adaptation, used
@@ -571,7 +577,9 @@ gboolean dt_dev_distort_backtransform
   (dt_develop_t *dev,
    float *points,
    const size_t points_count);
-/** same fct, but we can specify iop with priority between pmin and pmax */
+/** same fct, but we can specify iop with priority between pmin and pmax.
+    on the darkroom preview pipe the results of larger point batches are kept
+    per pipe state, so that only the points not seen before are transformed. */
 gboolean dt_dev_distort_transform_plus
   (dt_develop_t *dev,
    struct dt_dev_pixelpipe_t *pipe,
@@ -589,6 +597,9 @@ gboolean dt_dev_distort_backtransform_plus
    float *points,
    const size_t points_count);
 
+/** free the transformed points kept for the mask gui */
+void dt_dev_distort_memo_cleanup(struct dt_dev_pixelpipe_t *pipe);
+
 /** get the iop_pixelpipe instance corresponding to the iop in the given pipe */
 struct dt_dev_pixelpipe_iop_t *dt_dev_distort_get_iop_pipe(dt_develop_t *dev,
                                                            struct dt_dev_pixelpipe_t *pipe,
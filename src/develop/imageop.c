@@ -1112,6 +1112,7 @@ static void _gui_off_callback(GtkToggleButton *togglebutton,
     if(gtk_toggle_button_get_active(togglebutton))
     {
       module->enabled = TRUE;
+      dt_iop_gui_ensure(module);
       if(!basics)
       {
         if(activate_expand && !module->expanded)
@@ -1413,10 +1414,93 @@ int dt_iop_legacy_params(dt_iop_module_t *module,
   return auto_init ? -1 : ret;
 }
 
-static void _init_presets(dt_iop_module_so_t *module_so)
+// the built-in presets only change with the darktable and module
+// versions, the language of their names and the workflow some depend on
+static gchar *_presets_fingerprint(dt_iop_module_so_t *module_so)
+{
+  gchar *workflow = dt_conf_get_string("plugins/darkroom/workflow");
+  gchar *fingerprint = g_strdup_printf("%s|%d|%s|%s",
+                                       darktable_package_version,
+                                       module_so->version(),
+                                       g_get_language_names()[0],
+                                       workflow);
+  g_free(workflow);
+  return fingerprint;
+}
+
+// returns TRUE if the built-in presets have been written with the same
+// fingerprint before, restoring pref_based_presets set by init_presets()
+static gboolean _presets_up_to_date(dt_iop_module_so_t *module_so,
+                                    const char *key,
+                                    const char *fingerprint)
+{
+  gboolean up_to_date = FALSE;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT value FROM data.db_info WHERE key = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    // stored as fingerprint|pref_based_presets
+    const char *value = (const char *)sqlite3_column_text(stmt, 0);
+    const size_t len = strlen(fingerprint);
+    if(value && !strncmp(value, fingerprint, len)
+       && value[len] == '|' && value[len + 1] && !value[len + 2])
+    {
+      module_so->pref_based_presets = value[len + 1] == '1';
+      up_to_date = TRUE;
+    }
+  }
+  sqlite3_finalize(stmt);
+  return up_to_date;
+}
+
+static void _init_presets(dt_iop_module_so_t *module_so, const gboolean force)
 {
   if(module_so->init_presets)
-    module_so->init_presets(module_so);
+  {
+    gchar *key = g_strdup_printf("iop_presets_%s", module_so->op);
+    gchar *fingerprint = _presets_fingerprint(module_so);
+
+    // rewriting all built-in presets on each start is a major part of the
+    // startup time, so only do it if something they depend on has changed.
+    // dt_gui_presets_init() keeps the built-in presets of these modules.
+    if(force || !_presets_up_to_date(module_so, key, fingerprint))
+    {
+      sqlite3_stmt *stmt;
+      // first delete the outdated built-in presets for this module
+      DT_DEBUG_SQLITE3_PREPARE_V2
+        (dt_database_get(darktable.db),
+         "DELETE FROM data.presets"
+         " WHERE writeprotect = 1"
+         "   AND operation = ?1",
+         -1, &stmt, NULL);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, module_so->op, -1, SQLITE_TRANSIENT);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+
+      module_so->init_presets(module_so);
+
+      gchar *value = g_strdup_printf("%s|%d", fingerprint,
+                                     module_so->pref_based_presets ? 1 : 0);
+      DT_DEBUG_SQLITE3_PREPARE_V2
+        (dt_database_get(darktable.db),
+         "INSERT OR REPLACE INTO data.db_info (key, value) VALUES (?1, ?2)",
+         -1, &stmt, NULL);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, key, -1, SQLITE_TRANSIENT);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, value, -1, SQLITE_TRANSIENT);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+      g_free(value);
+    }
+    else
+      dt_print(DT_DEBUG_PARAMS, "[imageop_init_presets] built-in presets of '%s' are up to date",
+               module_so->op);
+
+    g_free(fingerprint);
+    g_free(key);
+  }
 
   // this seems like a reasonable place to check for and update legacy
   // presets.
@@ -1650,24 +1734,10 @@ static void _iop_preferences_changed(gpointer instance, gpointer self)
   {
     dt_iop_module_so_t *mod = iop->data;
 
+    // drop the auto built-in presets and reload whatever new presets
+    // are needed for the new workflow
     if(mod->pref_based_presets)
-    {
-      sqlite3_stmt *stmt;
-      // first delete auto built-in presets for this module
-      DT_DEBUG_SQLITE3_PREPARE_V2
-        (dt_database_get(darktable.db),
-         "DELETE FROM data.presets"
-         " WHERE writeprotect = 1"
-         "   AND operation = ?1",
-         -1, &stmt, NULL);
-      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, mod->op, -1, SQLITE_TRANSIENT);
-
-      sqlite3_step(stmt);
-      sqlite3_finalize(stmt);
-
-      // and reload whatever new presets are needed for the new workflow
-      _init_presets(mod);
-    }
+      _init_presets(mod, TRUE);
 
     iop = g_list_next(iop);
   }
@@ -1695,7 +1765,7 @@ static void _init_module_so(void *m)
 {
   dt_iop_module_so_t *module = (dt_iop_module_so_t *)m;
 
-  _init_presets(module);
+  _init_presets(module, FALSE);
 
   // do not init accelerators if there is no gui
   if(darktable.gui)
@@ -2195,6 +2265,9 @@ void dt_iop_commit_params(dt_iop_module_t *module,
   if(module->flags() & IOP_FLAGS_ALLOW_TILING)
     piece->process_tiling_ready = TRUE;
 
+  // same for chained processing of per-pixel modules
+  piece->process_pointwise = (module->flags() & IOP_FLAGS_POINTWISE) != 0;
+
   if((piece->enabled || module->enabled) // better to check for both
     && module->so->get_introspection()
     && darktable.unmuted & DT_DEBUG_PARAMS)
@@ -2250,15 +2323,25 @@ void dt_iop_gui_cleanup_module(dt_iop_module_t *module)
   g_slist_free_full(module->widget_list, g_free);
   module->widget_list = NULL;
   DT_CONTROL_SIGNAL_DISCONNECT_ALL(module, module->so->op);
-  if(module->gui_cleanup) module->gui_cleanup(module);
+  // a module never expanded only has its header
+  const gboolean built = module->widget != NULL;
+  if(built && module->gui_cleanup) module->gui_cleanup(module);
   gtk_widget_destroy(module->expander ? module->expander : module->widget);
   dt_iop_gui_cleanup_blending(module);
-  dt_pthread_mutex_destroy(&module->gui_lock);
+  if(built) dt_pthread_mutex_destroy(&module->gui_lock);
   dt_free_align(module->gui_data);
 }
 
 void dt_iop_gui_update(dt_iop_module_t *module)
 {
+  // some modules look at their gui data while processing in darkroom,
+  // build the widgets of the modules in use. that updates them too.
+  if(module->enabled && !module->widget && module->expander)
+  {
+    dt_iop_gui_ensure(module);
+    return;
+  }
+
   DT_ENTER_GUI_UPDATE();
   if(!dt_iop_is_hidden(module))
   {
@@ -2299,7 +2382,7 @@ void dt_iop_gui_update(dt_iop_module_t *module)
 void dt_iop_gui_reset(dt_iop_module_t *module)
 {
   DT_ENTER_GUI_UPDATE();
-  if(module->gui_reset && !dt_iop_is_hidden(module))
+  if(module->gui_reset && module->widget && !dt_iop_is_hidden(module))
     module->gui_reset(module);
   DT_LEAVE_GUI_UPDATE();
 }
@@ -2401,6 +2484,10 @@ void dt_iop_request_focus(dt_iop_module_t *module)
   if(DT_IN_GUI_UPDATE() || (out_focus_module == module))
     return;
 
+  // the focused module gets the mouse and expose events
+  if(module && !dt_iop_gui_ensure(module))
+    return;
+
   dev->gui_module = module;
   dev->focus_hash = TRUE;
 
@@ -2505,6 +2592,8 @@ static void _gui_set_single_expanded(dt_iop_module_t *module, gboolean expanded)
 {
   if(!module->expander) return;
 
+  if(expanded) dt_iop_gui_ensure(module);
+
   /* update expander arrow state */
   dtgtk_expander_set_expanded(DTGTK_EXPANDER(module->expander), expanded);
 
@@ -2581,6 +2670,7 @@ void dt_iop_gui_update_expanded(dt_iop_module_t *module)
   if(!module->expander) return;
 
   const gboolean expanded = module->expanded;
+  if(expanded) dt_iop_gui_ensure(module);
 
   dtgtk_expander_set_expanded(DTGTK_EXPANDER(module->expander), expanded);
 }
@@ -3154,6 +3244,20 @@ static gboolean _on_drag_drop(GtkWidget *widget,
   return _on_drag_motion(widget, dc, DND_DROP, y, time, module);
 }
 
+static void _iop_gui_pack_body(dt_iop_module_t *module,
+                               GtkWidget *iopw)
+{
+  /* add the blending ui if supported */
+  gtk_box_pack_start(GTK_BOX(iopw), module->widget, TRUE, TRUE, 0);
+  dt_guides_init_module_widget(iopw, module);
+  dt_iop_gui_init_blending(iopw, module);
+  dt_gui_add_class(module->widget, "dt_plugin_ui_main");
+  dt_gui_add_help_link(module->widget, module->op);
+
+  gtk_widget_set_hexpand(module->widget, FALSE);
+  gtk_widget_set_vexpand(module->widget, FALSE);
+}
+
 void dt_iop_gui_set_expander(dt_iop_module_t *module)
 {
   GtkWidget *header = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
@@ -3290,12 +3394,8 @@ void dt_iop_gui_set_expander(dt_iop_module_t *module)
     gtk_widget_show(lb);
   }
 
-  /* add the blending ui if supported */
-  gtk_box_pack_start(GTK_BOX(iopw), module->widget, TRUE, TRUE, 0);
-  dt_guides_init_module_widget(iopw, module);
-  dt_iop_gui_init_blending(iopw, module);
-  dt_gui_add_class(module->widget, "dt_plugin_ui_main");
-  dt_gui_add_help_link(module->widget, module->op);
+  /* the module widgets are added once created */
+  if(module->widget) _iop_gui_pack_body(module, iopw);
   gtk_widget_hide(iopw);
 
   module->expander = expander;
@@ -3303,15 +3403,50 @@ void dt_iop_gui_set_expander(dt_iop_module_t *module)
   /* update header */
   dt_iop_gui_update_header(module);
 
-  gtk_widget_set_hexpand(module->widget, FALSE);
-  gtk_widget_set_vexpand(module->widget, FALSE);
-
   gtk_widget_show_all(expander);
   dt_ui_container_add_widget(darktable.gui->ui,
                              DT_UI_CONTAINER_PANEL_RIGHT_CENTER, expander);
   dt_iop_show_hide_header_buttons(module, NULL, FALSE, FALSE);
 }
 
+gboolean dt_iop_gui_ensure(dt_iop_module_t *module)
+{
+  if(module->widget) return TRUE;
+  if(!module->expander) return FALSE;
+
+  // the modules not in use only get their header when entering
+  // darkroom, the bauhaus widgets are built on first expand, focus,
+  // enable or shortcut
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  dt_iop_gui_init(module);
+  if(!module->widget) return FALSE;
+
+  GtkWidget *iopw = dt_iop_gui_get_widget(module);
+  _iop_gui_pack_body(module, iopw);
+  gtk_widget_show_all(iopw);
+
+  // the gui part of the defaults of the current image, some modules
+  // also reset their params there
+  if(module->reload_defaults && module->dev)
+  {
+    void *params = malloc(module->params_size);
+    memcpy(params, module->params, module->params_size);
+    DT_ENTER_GUI_UPDATE();
+    module->reload_defaults(module);
+    DT_LEAVE_GUI_UPDATE();
+    memcpy(module->params, params, module->params_size);
+    free(params);
+  }
+
+  dt_iop_gui_update(module);
+  dt_iop_connect_accels_multi(module->so);
+
+  dt_show_times_f(&start, "[dt_iop_gui_ensure]", "widgets of %s", module->op);
+  return TRUE;
+}
+
 GtkWidget *dt_iop_gui_get_widget(dt_iop_module_t *module)
 {
   return dtgtk_expander_get_body(DTGTK_EXPANDER(module->expander));
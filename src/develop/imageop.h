@@ -107,6 +107,7 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_WRITE_RASTER = 1 << 19,      // modules not supporting blending might still advertise a raster mask
   IOP_FLAGS_WRITE_PIPECACHE = 1 << 20,   // enforce pipecache writing
   IOP_FLAGS_WRITE_PIPECACHE_IN = 1 << 21, // makes input cacheline important, also ensure input pipecache writing for OpenCL code
+  IOP_FLAGS_POINTWISE = 1 << 22,         // process() only reads the pixel it writes, can run on bands chained with other modules
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -393,7 +394,8 @@ dt_iop_module_t *dt_iop_commit_blend_params(dt_iop_module_t *module,
                                             const struct dt_develop_blend_params_t *blendop_params);
 /** make sure the raster mask is advertised if available */
 void dt_iop_advertise_rastermask(dt_iop_module_t *module, const int mask_mode);
-/** creates a label widget for the expander, with callback to enable/disable this module. */
+/** creates a label widget for the expander, with callback to enable/disable this module.
+    without module->widget the body is filled in later by dt_iop_gui_ensure(). */
 void dt_iop_gui_set_expander(dt_iop_module_t *module);
 /** get the widget of plugin ui in expander */
 GtkWidget *dt_iop_gui_get_widget(dt_iop_module_t *module);
@@ -417,6 +419,9 @@ void dt_iop_default_cleanup(dt_iop_module_t *module);
 void dt_iop_load_default_params(dt_iop_module_t *module);
 /** creates the module's gui widget */
 void dt_iop_gui_init(dt_iop_module_t *module);
+/** creates the widgets of a module whose expander only has its header yet.
+    returns TRUE if the module has its widgets. */
+gboolean dt_iop_gui_ensure(dt_iop_module_t *module);
 /** reloads certain gui/param defaults when the image was switched. */
 void dt_iop_reload_defaults(dt_iop_module_t *module);
 
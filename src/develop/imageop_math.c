@@ -17,6 +17,7 @@
 */
 
 #include "common/darktable.h"        // for darktable, darktable_t, dt_code...
+#include "common/imagebuf.h"         // for dt_iop_image_orient
 #include "common/interpolation.h"    // for dt_interpolation_new, dt_interp...
 #include "common/math.h"             // for dt_vector_powf
 #include "develop/imageop.h"         // for dt_iop_roi_t
@@ -45,6 +46,13 @@ void dt_iop_flip_and_zoom_8(const uint8_t *in,
   const uint32_t wd = *width = MIN(ow, iwd / scale);
   const uint32_t ht = *height = MIN(oh, iht / scale);
   const int bpp = 4; // bytes per pixel
+  if(scale == 1.0f)
+  {
+    // nothing to average, only reorder the pixels. the output is the
+    // whole input here, the alpha byte is copied along.
+    dt_iop_image_orient(out, in, bpp, iw, ih, iw, ih, (size_t)bpp * iw, orientation);
+    return;
+  }
   int32_t ii = 0, jj = 0;
   int32_t si = 1, sj = iw;
   if(orientation & ORIENTATION_FLIP_Y)
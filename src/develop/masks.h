@@ -369,6 +369,10 @@ typedef struct dt_masks_form_t
   dt_mask_id_t formid;
   // version of the form
   int version;
+  // extra owners of this form. forms held by history items and undo
+  // snapshots are never modified in place and may be shared between
+  // lists, dt_masks_free_form() only releases the last reference.
+  int shared;
 } dt_masks_form_t;
 
 typedef struct dt_masks_form_gui_points_t
@@ -486,6 +490,9 @@ extern const dt_masks_functions_t dt_masks_functions_group;
 extern const dt_masks_functions_t dt_masks_functions_object;
 /** check if AI object mask model is downloaded and AI is enabled */
 gboolean dt_masks_object_available(void);
+/** encode a list of image ids in a background job, so object masks
+ * on them start from cached embeddings */
+void dt_masks_object_precompute(GList *imgs);
 #endif
 
 /** init dt_masks_form_gui_t struct with default values */
@@ -555,6 +562,9 @@ int dt_masks_group_render_roi(dt_iop_module_t *module,
                               const dt_iop_roi_t *roi,
                               float *buffer);
 
+// free the cached rasterised shapes of groups
+void dt_masks_raster_cache_cleanup(void);
+
 // returns current masks version
 int dt_masks_version(void);
 
@@ -695,6 +705,13 @@ int dt_masks_form_duplicate(dt_develop_t *dev,
 dt_masks_form_t *dt_masks_dup_masks_form(const dt_masks_form_t *form);
 /* duplicate the list of forms, replace item in the list with form with the same formid */
 GList *dt_masks_dup_forms_deep(GList *forms, dt_masks_form_t *form);
+/* take an extra reference on a form of a history list */
+dt_masks_form_t *dt_masks_ref_form(dt_masks_form_t *form);
+/* shallow copy of a history forms list, all forms are shared */
+GList *dt_masks_share_forms(GList *forms);
+/* copy the list of forms for a new history item, forms identical to
+   the ones in previous are shared instead of duplicated */
+GList *dt_masks_dup_forms_shared(GList *forms, GList *previous);
 
 /** utils functions */
 gboolean dt_masks_point_in_form_exact(const float x,
@@ -628,6 +628,153 @@ static void _combine_masks_exclusion(float *const restrict dest,
   }
 }
 
+/* raster cache for the shapes of groups, keyed by the shape geometry, the roi
+   and the distortions of the pipe. Editing one of many brush strokes only
+   rasterises that one again, the others are composited from the cache. The
+   rasters are kept cropped to their non-zero area.
+*/
+#define DT_MASKS_RASTER_CACHE_BYTES ((size_t)256 << 20)
+#define DT_MASKS_RASTER_CACHE_ENTRIES 4096
+
+typedef struct _raster_entry_t
+{
+  dt_hash_t hash;
+  int x, y, width, height; // non-zero area within the roi
+  size_t size;             // in bytes
+  float *data;
+} _raster_entry_t;
+
+static GMutex _raster_lock;
+static GList *_raster_cache = NULL; // most recently used first
+static size_t _raster_cache_size = 0;
+static int _raster_cache_entries = 0;
+
+static void _raster_entry_free(gpointer data)
+{
+  _raster_entry_t *entry = data;
+  dt_free_align(entry->data);
+  g_free(entry);
+}
+
+void dt_masks_raster_cache_cleanup(void)
+{
+  g_mutex_lock(&_raster_lock);
+  g_list_free_full(_raster_cache, _raster_entry_free);
+  _raster_cache = NULL;
+  _raster_cache_size = 0;
+  _raster_cache_entries = 0;
+  g_mutex_unlock(&_raster_lock);
+}
+
+static dt_hash_t _raster_base_hash(const dt_iop_module_t *const module,
+                                   const dt_dev_pixelpipe_iop_t *const piece,
+                                   const dt_iop_roi_t *const roi)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  const dt_hash_t distort = dt_dev_hash_distort_plus(module->dev, pipe, module->iop_order,
+                                                     DT_DEV_TRANSFORM_DIR_ALL);
+  if(distort == DT_INVALID_HASH) return DT_INVALID_HASH;
+
+  dt_hash_t hash = dt_hash(DT_INITHASH, &distort, sizeof(distort));
+  hash = dt_hash(hash, roi, sizeof(dt_iop_roi_t));
+  hash = dt_hash(hash, &module->iop_order, sizeof(module->iop_order));
+  hash = dt_hash(hash, &pipe->image.id, sizeof(pipe->image.id));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  return hash;
+}
+
+// fills the zeroed buffer from the cache, returns FALSE if not found
+static gboolean _raster_cache_get(const dt_hash_t hash,
+                                  float *const buffer,
+                                  const int width)
+{
+  gboolean found = FALSE;
+  g_mutex_lock(&_raster_lock);
+  for(GList *l = _raster_cache; l; l = g_list_next(l))
+  {
+    _raster_entry_t *entry = l->data;
+    if(entry->hash != hash) continue;
+
+    for(int j = 0; j < entry->height; j++)
+      memcpy(buffer + (size_t)(entry->y + j) * width + entry->x,
+             entry->data + (size_t)j * entry->width,
+             sizeof(float) * entry->width);
+    _raster_cache = g_list_remove_link(_raster_cache, l);
+    _raster_cache = g_list_concat(l, _raster_cache);
+    found = TRUE;
+    break;
+  }
+  g_mutex_unlock(&_raster_lock);
+  return found;
+}
+
+static void _raster_cache_put(const dt_hash_t hash,
+                              const float *const buffer,
+                              const int width,
+                              const int height)
+{
+  // find the non-zero area
+  int x0 = width, x1 = -1, y0 = height, y1 = -1;
+  for(int j = 0; j < height; j++)
+  {
+    const float *row = buffer + (size_t)j * width;
+    int first = 0;
+    while(first < width && row[first] == 0.0f) first++;
+    if(first == width) continue;
+    int last = width - 1;
+    while(row[last] == 0.0f) last--;
+    x0 = MIN(x0, first);
+    x1 = MAX(x1, last);
+    y0 = MIN(y0, j);
+    y1 = j;
+  }
+
+  _raster_entry_t *entry = g_malloc0(sizeof(_raster_entry_t));
+  entry->hash = hash;
+  if(x1 >= 0)
+  {
+    entry->x = x0;
+    entry->y = y0;
+    entry->width = x1 - x0 + 1;
+    entry->height = y1 - y0 + 1;
+    entry->size = sizeof(float) * entry->width * entry->height;
+    entry->data = dt_alloc_align_float((size_t)entry->width * entry->height);
+    if(!entry->data)
+    {
+      g_free(entry);
+      return;
+    }
+    for(int j = 0; j < entry->height; j++)
+      memcpy(entry->data + (size_t)j * entry->width,
+             buffer + (size_t)(y0 + j) * width + x0,
+             sizeof(float) * entry->width);
+  }
+
+  if(entry->size > DT_MASKS_RASTER_CACHE_BYTES / 4)
+  {
+    _raster_entry_free(entry);
+    return;
+  }
+
+  g_mutex_lock(&_raster_lock);
+  _raster_cache = g_list_prepend(_raster_cache, entry);
+  _raster_cache_size += entry->size;
+  _raster_cache_entries++;
+  while(_raster_cache_size > DT_MASKS_RASTER_CACHE_BYTES
+        || _raster_cache_entries > DT_MASKS_RASTER_CACHE_ENTRIES)
+  {
+    GList *last = g_list_last(_raster_cache);
+    _raster_entry_t *old = last->data;
+    _raster_cache_size -= old->size;
+    _raster_cache_entries--;
+    _raster_cache = g_list_delete_link(_raster_cache, last);
+    _raster_entry_free(old);
+  }
+  g_mutex_unlock(&_raster_lock);
+}
+
 static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
                                const dt_dev_pixelpipe_iop_t *const restrict piece,
                                dt_masks_form_t *const form,
@@ -647,6 +794,9 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
   float *const restrict bufs = dt_alloc_align_float(npixels);
   if(bufs == NULL) return 0;
 
+  const dt_hash_t base_hash = _raster_base_hash(module, piece, roi);
+  int nb_cached = 0;
+
   // and we get all masks
   for(GList *fpts = form->points; fpts; fpts = g_list_next(fpts))
   {
@@ -658,7 +808,20 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
       // ensure that we start with a zeroed buffer regardless of what
       // was previously written into 'bufs'
       memset(bufs, 0, npixels*sizeof(float));
-      const int ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+      // groups are composed from their own cached shapes
+      const gboolean cachable = base_hash != DT_INVALID_HASH && !(sel->type & DT_MASKS_GROUP);
+      const dt_hash_t hash = cachable ? dt_masks_group_hash(base_hash, sel) : DT_INVALID_HASH;
+      int ok = 0;
+      if(cachable && _raster_cache_get(hash, bufs, width))
+      {
+        ok = 1;
+        nb_cached++;
+      }
+      else
+      {
+        ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+        if(ok && cachable) _raster_cache_put(hash, bufs, width, height);
+      }
       const float op = fpt->opacity;
       const int state = fpt->state;
 
@@ -732,6 +895,10 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
   // and we free the intermediate buffer
   dt_free_align(bufs);
 
+  dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+           "[masks] group %d: %d of %d shapes from raster cache",
+           form->formid, nb_cached, nb_ok);
+
   return nb_ok != 0;
 }
 
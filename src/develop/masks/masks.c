@@ -33,6 +33,7 @@ dt_masks_form_t *dt_masks_dup_masks_form(const dt_masks_form_t *form)
 
   dt_masks_form_t *new_form = malloc(sizeof(struct dt_masks_form_t));
   memcpy(new_form, form, sizeof(struct dt_masks_form_t));
+  new_form->shared = 0;
 
   // then duplicate the GList *points
 
@@ -74,6 +75,62 @@ GList *dt_masks_dup_forms_deep(GList *forms,
   return (GList *)g_list_copy_deep(forms, _dup_masks_form_cb, (gpointer)form);
 }
 
+dt_masks_form_t *dt_masks_ref_form(dt_masks_form_t *form)
+{
+  if(form) g_atomic_int_inc(&form->shared);
+  return form;
+}
+
+static void *_ref_masks_form_cb(const void *formdata, const gpointer user_data)
+{
+  return (void *)dt_masks_ref_form((dt_masks_form_t *)formdata);
+}
+
+GList *dt_masks_share_forms(GList *forms)
+{
+  return (GList *)g_list_copy_deep(forms, _ref_masks_form_cb, NULL);
+}
+
+static gboolean _masks_form_equal(const dt_masks_form_t *a,
+                                  const dt_masks_form_t *b)
+{
+  if(a->formid != b->formid
+     || a->type != b->type
+     || a->functions != b->functions
+     || a->version != b->version
+     || memcmp(a->source, b->source, sizeof(a->source))
+     || strcmp(a->name, b->name))
+    return FALSE;
+
+  const size_t size_item = a->functions ? a->functions->point_struct_size : 0;
+
+  const GList *pa = a->points;
+  const GList *pb = b->points;
+  for(; pa && pb; pa = g_list_next(pa), pb = g_list_next(pb))
+    if(size_item && memcmp(pa->data, pb->data, size_item))
+      return FALSE;
+
+  return pa == NULL && pb == NULL;
+}
+
+GList *dt_masks_dup_forms_shared(GList *forms, GList *previous)
+{
+  GList *result = NULL;
+  for(GList *l = forms; l; l = g_list_next(l))
+  {
+    const dt_masks_form_t *form = l->data;
+    dt_masks_form_t *prev = dt_masks_get_from_id_ext(previous, form->formid);
+
+    // a brush stroke only adds or changes one form, all the others
+    // are the very same as in the previous history item
+    result = g_list_prepend(result,
+                            prev && _masks_form_equal(form, prev)
+                            ? dt_masks_ref_form(prev)
+                            : dt_masks_dup_masks_form(form));
+  }
+  return g_list_reverse(result);
+}
+
 static int _get_opacity(const dt_masks_form_gui_t *gui,
                         const dt_masks_form_t *form)
 {
@@ -1137,6 +1194,8 @@ void dt_masks_write_masks_history_item(const dt_imgid_t imgid,
 void dt_masks_free_form(dt_masks_form_t *form)
 {
   if(!form) return;
+  // still referenced by another history list
+  if(g_atomic_int_add(&form->shared, -1) > 0) return;
   g_list_free_full(form->points, free);
   form->points = NULL;
   free(form);
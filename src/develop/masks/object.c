@@ -26,6 +26,7 @@
 #include "common/ras2vect.h"
 #include "control/conf.h"
 #include "control/control.h"
+#include "control/jobs.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
 #include "develop/masks.h"
@@ -204,6 +205,9 @@ static void _destroy_data(_object_data_t *d)
   g_free(d->mask);
   _free_preview_forms(d);
   g_free(d);
+
+  // the lattices kept for refining more masks of this image
+  dt_dense_crf_release_cache();
 }
 
 // idle callback for deferred cleanup when background thread was still running
@@ -234,56 +238,13 @@ static void _free_data(dt_masks_form_gui_t *gui)
   _destroy_data(d);
 }
 
-// data passed to the background encoding thread
-typedef struct _encode_thread_data_t
-{
-  _object_data_t *d;
-  dt_imgid_t imgid;        // image to encode (thread renders via export pipe)
-  int32_t history_end;     // darkroom history_end (may be ahead of database)
-  dt_hash_t distort_hash;  // hash from live darkroom state (for disk cache key)
-} _encode_thread_data_t;
-
-// background thread: loads model, renders image via export pipe, and encodes,
-// does ZERO GLib/GTK calls - only computation + atomic state set,
-// the poll timer on the main thread detects completion
-static gpointer _encode_thread_func(gpointer data)
+// render the image of dev through a temporary export pipe at the size
+// the encoder gets, returns uint8 RGB (HWC) or NULL
+static uint8_t *_render_for_encoding(dt_develop_t *dev,
+                                     int *out_width,
+                                     int *out_height)
 {
-  _encode_thread_data_t *td = data;
-  _object_data_t *d = td->d;
-  const dt_imgid_t imgid = td->imgid;
-  const int32_t td_history_end = td->history_end;
-  const dt_hash_t distort_hash = td->distort_hash;
-  g_free(td);
-
-  // load model if needed
-  if(!d->model_loaded)
-  {
-    if(!d->env)
-      d->env = dt_ai_env_init(NULL);
-
-    char *model_id = dt_ai_models_get_active_for_task("mask");
-    d->seg = dt_seg_load(d->env, model_id);
-    g_free(model_id);
-
-    if(!d->seg)
-    {
-      g_atomic_int_set(&d->encode_state, ENCODE_ERROR);
-      return NULL;
-    }
-    d->model_loaded = TRUE;
-  }
-
-  // render image at high resolution via temporary export pipeline
-  dt_develop_t dev;
-  dt_dev_init(&dev, FALSE);
-  dt_dev_load_image(&dev, imgid);
-
-  // the database's history_end may lag behind the darkroom's
-  // in-memory state (crop/rotate not flushed yet), override
-  // so synch_all applies all current edits
-  if(td_history_end > 0 && td_history_end > dev.history_end)
-    dev.history_end = td_history_end;
-
+  const dt_imgid_t imgid = dev->image_storage.id;
   dt_mipmap_buffer_t buf;
   dt_mipmap_cache_get(&buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
 
@@ -292,13 +253,11 @@ static gpointer _encode_thread_func(gpointer data)
     dt_print(DT_DEBUG_AI,
              "[object mask] failed to get image buffer for encoding");
     dt_mipmap_cache_release(&buf);
-    dt_dev_cleanup(&dev);
-    g_atomic_int_set(&d->encode_state, ENCODE_ERROR);
     return NULL;
   }
 
-  const int wd = dev.image_storage.width;
-  const int ht = dev.image_storage.height;
+  const int wd = dev->image_storage.width;
+  const int ht = dev->image_storage.height;
 
   dt_dev_pixelpipe_t pipe;
   if(!dt_dev_pixelpipe_init_export(&pipe, wd, ht, IMAGEIO_RGB | IMAGEIO_INT8,
@@ -307,19 +266,17 @@ static gpointer _encode_thread_func(gpointer data)
     dt_print(DT_DEBUG_AI,
              "[object mask] failed to init export pipe for encoding");
     dt_mipmap_cache_release(&buf);
-    dt_dev_cleanup(&dev);
-    g_atomic_int_set(&d->encode_state, ENCODE_ERROR);
     return NULL;
   }
 
   dt_dev_pixelpipe_set_icc(&pipe, DT_COLORSPACE_SRGB, NULL,
                            DT_INTENT_PERCEPTUAL);
-  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf,
+  dt_dev_pixelpipe_set_input(&pipe, dev, (float *)buf.buf,
                              buf.width, buf.height, buf.iscale);
-  dt_dev_pixelpipe_create_nodes(&pipe, &dev);
-  dt_dev_pixelpipe_synch_all(&pipe, &dev);
+  dt_dev_pixelpipe_create_nodes(&pipe, dev);
+  dt_dev_pixelpipe_synch_all(&pipe, dev);
 
-  dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight,
+  dt_dev_pixelpipe_get_dimensions(&pipe, dev, pipe.iwidth, pipe.iheight,
                                   &pipe.processed_width,
                                   &pipe.processed_height);
 
@@ -332,25 +289,11 @@ static gpointer _encode_thread_func(gpointer data)
   const int out_w = (int)(final_scale * pipe.processed_width);
   const int out_h = (int)(final_scale * pipe.processed_height);
 
-  // use distort hash from darkroom's live state (passed by caller)
-  // instead of computing from the thread's dev, which may have
-  // stale history (not yet flushed to database)
-  if(dt_seg_disk_cache_load(d->seg, imgid, distort_hash))
-  {
-    dt_dev_pixelpipe_cleanup(&pipe);
-    dt_mipmap_cache_release(&buf);
-    dt_dev_cleanup(&dev);
-    dt_seg_get_encoded_rgb(d->seg, &d->encode_w, &d->encode_h);
-    g_atomic_int_set(&d->encode_state, ENCODE_READY);
-    dt_seg_warmup_decoder(d->seg);
-    return NULL;
-  }
-
   dt_print(DT_DEBUG_AI,
            "[object mask] rendering %dx%d (scale=%.3f) for encoding...",
            out_w, out_h, final_scale);
 
-  dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, out_w, out_h, final_scale);
+  dt_dev_pixelpipe_process_no_gamma(&pipe, dev, 0, 0, out_w, out_h, final_scale);
 
   // backbuf is float RGBA after process_no_gamma, convert to uint8 RGB for SAM
   uint8_t *rgb = NULL;
@@ -371,11 +314,82 @@ static gpointer _encode_thread_func(gpointer data)
 
   dt_dev_pixelpipe_cleanup(&pipe);
   dt_mipmap_cache_release(&buf);
+
+  if(!rgb)
+    dt_print(DT_DEBUG_AI, "[object mask] failed to render image for encoding");
+
+  *out_width = out_w;
+  *out_height = out_h;
+  return rgb;
+}
+
+// data passed to the background encoding thread
+typedef struct _encode_thread_data_t
+{
+  _object_data_t *d;
+  dt_imgid_t imgid;        // image to encode (thread renders via export pipe)
+  int32_t history_end;     // darkroom history_end (may be ahead of database)
+  dt_hash_t distort_hash;  // hash from live darkroom state (for disk cache key)
+} _encode_thread_data_t;
+
+// background thread: loads model, renders image via export pipe, and encodes,
+// does ZERO GLib/GTK calls - only computation + atomic state set,
+// the poll timer on the main thread detects completion
+static gpointer _encode_thread_func(gpointer data)
+{
+  _encode_thread_data_t *td = data;
+  _object_data_t *d = td->d;
+  const dt_imgid_t imgid = td->imgid;
+  const int32_t td_history_end = td->history_end;
+  const dt_hash_t distort_hash = td->distort_hash;
+  g_free(td);
+
+  // load model if needed
+  if(!d->model_loaded)
+  {
+    if(!d->env)
+      d->env = dt_ai_env_init(NULL);
+
+    char *model_id = dt_ai_models_get_active_for_task("mask");
+    d->seg = dt_seg_load(d->env, model_id);
+    g_free(model_id);
+
+    if(!d->seg)
+    {
+      g_atomic_int_set(&d->encode_state, ENCODE_ERROR);
+      return NULL;
+    }
+    d->model_loaded = TRUE;
+  }
+
+  // use distort hash from darkroom's live state (passed by caller)
+  // instead of computing from the thread's dev, which may have
+  // stale history (not yet flushed to database)
+  if(dt_seg_disk_cache_load(d->seg, imgid, distort_hash))
+  {
+    dt_seg_get_encoded_rgb(d->seg, &d->encode_w, &d->encode_h);
+    g_atomic_int_set(&d->encode_state, ENCODE_READY);
+    dt_seg_warmup_decoder(d->seg);
+    return NULL;
+  }
+
+  // render image at high resolution via temporary export pipeline
+  dt_develop_t dev;
+  dt_dev_init(&dev, FALSE);
+  dt_dev_load_image(&dev, imgid);
+
+  // the database's history_end may lag behind the darkroom's
+  // in-memory state (crop/rotate not flushed yet), override
+  // so synch_all applies all current edits
+  if(td_history_end > 0 && td_history_end > dev.history_end)
+    dev.history_end = td_history_end;
+
+  int out_w = 0, out_h = 0;
+  uint8_t *rgb = _render_for_encoding(&dev, &out_w, &out_h);
   dt_dev_cleanup(&dev);
 
   if(!rgb)
   {
-    dt_print(DT_DEBUG_AI, "[object mask] failed to render image for encoding");
     g_atomic_int_set(&d->encode_state, ENCODE_ERROR);
     return NULL;
   }
@@ -1981,6 +1995,72 @@ const dt_masks_functions_t dt_masks_functions_object = {
   .post_expose = _object_events_post_expose
 };
 
+// background job encoding a list of images ahead of time, so object
+// masks start without waiting on the encoder once the image is opened.
+// uses its own model instance, the darkroom's one is left alone
+static int32_t _precompute_job_run(dt_job_t *job)
+{
+  GList *imgs = dt_control_job_get_params(job);
+  const int total = g_list_length(imgs);
+  if(!total) return 0;
+
+  dt_ai_environment_t *env = dt_ai_env_init(NULL);
+  char *model_id = dt_ai_models_get_active_for_task("mask");
+  dt_seg_context_t *seg = env ? dt_seg_load(env, model_id) : NULL;
+  g_free(model_id);
+  if(!seg)
+  {
+    if(env) dt_ai_env_destroy(env);
+    return 1;
+  }
+
+  int done = 0, encoded = 0;
+  for(GList *l = imgs;
+      l && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED;
+      l = g_list_next(l))
+  {
+    const dt_imgid_t imgid = GPOINTER_TO_INT(l->data);
+    dt_develop_t dev;
+    dt_dev_init(&dev, FALSE);
+    dt_dev_load_image(&dev, imgid);
+
+    // same hash the darkroom computes from its history on opening
+    const dt_hash_t distort_hash = _compute_distort_hash(&dev);
+    if(!dt_seg_disk_cache_exists(seg, imgid, distort_hash))
+    {
+      int out_w = 0, out_h = 0;
+      uint8_t *rgb = _render_for_encoding(&dev, &out_w, &out_h);
+      if(rgb && dt_seg_encode_image(seg, rgb, out_w, out_h)
+         && dt_seg_disk_cache_save(seg, imgid, distort_hash, rgb, out_w, out_h))
+        encoded++;
+      g_free(rgb);
+      dt_seg_reset_encoding(seg);
+    }
+    dt_dev_cleanup(&dev);
+
+    dt_control_job_set_progress(job, (double)++done / total);
+  }
+
+  dt_print(DT_DEBUG_AI,
+           "[object mask] precomputed embeddings for %d of %d images",
+           encoded, total);
+  dt_seg_free(seg);
+  dt_ai_env_destroy(env);
+  return 0;
+}
+
+void dt_masks_object_precompute(GList *imgs)
+{
+  if(!imgs || !dt_masks_object_available()) return;
+
+  dt_job_t *job = dt_control_job_create(&_precompute_job_run,
+                                        "object mask embeddings");
+  if(!job) return;
+  dt_control_job_add_progress(job, _("preparing object masks"), TRUE);
+  dt_control_job_set_params(job, g_list_copy(imgs), (dt_job_destroy_callback)g_list_free);
+  dt_control_add_job(DT_JOB_QUEUE_USER_BG, job);
+}
+
 gboolean dt_masks_object_available(void)
 {
   if(!dt_ai_registry_is_enabled())
@@ -17,17 +17,950 @@
 */
 
 #include "develop/pixelpipe_cache.h"
+#include "common/database.h"
+#include "common/file_location.h"
+#include "common/grealpath.h"
+#include "common/memory_account.h"
+#include "common/memory_budget.h"
+#include "common/numa.h"
+#include "control/conf.h"
+#include "control/signal.h"
 #include "develop/format.h"
 #include "develop/pixelpipe.h"
 #include "libs/lib.h"
 #include "libs/colorpicker.h"
+#include <glib/gstdio.h>
+#include <stdio.h>
 #include <stdlib.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
 
 static inline int _to_mb(size_t m)
 {
   return (int)((m + 0x80000lu) / 0x400lu / 0x400lu);
 }
 
+/* The buffer pool is shared by all pipes and keeps freed cacheline buffers for reuse.
+   Buffers from DT_PIPECACHE_POOL_MIN on are rounded up to size classes having
+   DT_PIPECACHE_POOL_STEPS steps per power of two so a buffer can be reused for
+   slightly differing sizes. On linux large buffers are aligned to huge pages
+   and advised to be backed by transparent huge pages.
+   The capacity of a buffer is always derived from the requested size via _pool_capacity().
+*/
+#define DT_PIPECACHE_POOL_MIN (DT_MEGA)
+#define DT_PIPECACHE_POOL_STEPS 8
+#define DT_PIPECACHE_HUGEPAGE (2 * DT_MEGA)
+
+typedef struct _pool_buffer_t
+{
+  void *mem;
+  size_t capacity;
+} _pool_buffer_t;
+
+typedef struct _pool_t
+{
+  gboolean enabled;
+  dt_pthread_mutex_t lock;
+  GQueue idle;  // _pool_buffer_t, least recently returned first
+  size_t idle_mem;
+  size_t limit;
+  uint64_t reused;
+  uint64_t allocated;
+  dt_atomic_int64 used; // capacity handed out to the pipes
+} _pool_t;
+
+static _pool_t _pool = { .enabled = FALSE };
+
+static size_t _pool_capacity(const size_t size)
+{
+  if(size < DT_PIPECACHE_POOL_MIN) return dt_round_size(size, DT_CACHELINE_BYTES);
+
+  size_t power = DT_PIPECACHE_POOL_MIN;
+  while(power <= size / 2) power <<= 1;
+  const size_t step = power / DT_PIPECACHE_POOL_STEPS;
+  return dt_round_size(size, step);
+}
+
+static void *_pool_sysalloc(const size_t capacity)
+{
+#if defined(__linux__) && !defined(_DEBUG)
+  const gboolean huge = capacity >= DT_PIPECACHE_HUGEPAGE;
+  void *ptr = NULL;
+  if(posix_memalign(&ptr, huge ? DT_PIPECACHE_HUGEPAGE : DT_CACHELINE_BYTES, capacity))
+    return NULL;
+#ifdef MADV_HUGEPAGE
+  if(huge) madvise(ptr, capacity, MADV_HUGEPAGE);
+#endif
+  dt_numa_place(ptr, capacity);
+  return ptr;
+#else
+  return dt_alloc_aligned(capacity);
+#endif
+}
+
+static void _pool_sysfree(void *mem)
+{
+#if defined(__linux__) && !defined(_DEBUG)
+  free(mem);
+#else
+  dt_free_align(mem);
+#endif
+}
+
+// returns a buffer of at least _pool_capacity(size) bytes, its capacity
+// is counted in the memory account
+static void *_pool_alloc(const size_t size,
+                         const int account)
+{
+  const size_t capacity = _pool_capacity(size);
+  if(_pool.enabled && capacity >= DT_PIPECACHE_POOL_MIN)
+  {
+    dt_pthread_mutex_lock(&_pool.lock);
+    // prefer the most recently returned buffer, it's more likely to be resident
+    for(GList *link = _pool.idle.tail; link; link = g_list_previous(link))
+    {
+      _pool_buffer_t *buf = link->data;
+      if(buf->capacity == capacity)
+      {
+        void *mem = buf->mem;
+        _pool.idle_mem -= capacity;
+        _pool.reused++;
+        g_queue_delete_link(&_pool.idle, link);
+        dt_pthread_mutex_unlock(&_pool.lock);
+        g_free(buf);
+        dt_atomic_add_int64(&_pool.used, capacity);
+        dt_mem_account_alloc(account, capacity);
+        return mem;
+      }
+    }
+    _pool.allocated++;
+    dt_pthread_mutex_unlock(&_pool.lock);
+  }
+  void *mem = _pool_sysalloc(capacity);
+  if(mem)
+  {
+    dt_atomic_add_int64(&_pool.used, capacity);
+    dt_mem_account_alloc(account, capacity);
+  }
+  return mem;
+}
+
+// gives back a buffer allocated via _pool_alloc(size, account)
+static void _pool_free(void *mem,
+                       const size_t size,
+                       const int account)
+{
+  if(!mem) return;
+
+  const size_t capacity = _pool_capacity(size);
+  dt_atomic_sub_int64(&_pool.used, capacity);
+  dt_mem_account_free(account, capacity);
+  if(!_pool.enabled || capacity < DT_PIPECACHE_POOL_MIN || capacity > _pool.limit)
+  {
+    _pool_sysfree(mem);
+    return;
+  }
+
+  _pool_buffer_t *buf = g_malloc(sizeof(_pool_buffer_t));
+  buf->mem = mem;
+  buf->capacity = capacity;
+
+  GSList *release = NULL;
+  dt_pthread_mutex_lock(&_pool.lock);
+  g_queue_push_tail(&_pool.idle, buf);
+  _pool.idle_mem += capacity;
+  while(_pool.idle_mem > _pool.limit)
+  {
+    _pool_buffer_t *old = g_queue_pop_head(&_pool.idle);
+    _pool.idle_mem -= old->capacity;
+    release = g_slist_prepend(release, old);
+  }
+  dt_pthread_mutex_unlock(&_pool.lock);
+
+  for(GSList *l = release; l; l = g_slist_next(l))
+  {
+    _pool_buffer_t *old = l->data;
+    _pool_sysfree(old->mem);
+    g_free(old);
+  }
+  g_slist_free(release);
+}
+
+static void _pool_init(void)
+{
+  dt_pthread_mutex_init(&_pool.lock, NULL);
+  g_queue_init(&_pool.idle);
+  _pool.idle_mem = 0;
+  _pool.reused = _pool.allocated = 0;
+  dt_atomic_set_int64(&_pool.used, 0);
+  // same as the memory limit of the full pipe cache
+  _pool.limit = MAX(64 * DT_MEGA, darktable.dtresources.mipmap_memory / 4);
+  _pool.enabled = TRUE;
+}
+
+static void _pool_cleanup(void)
+{
+  if(!_pool.enabled) return;
+
+  _pool.enabled = FALSE;
+  dt_print(DT_DEBUG_PIPE | DT_DEBUG_MEMORY,
+           "[pixelpipe_cache] buffer pool: %" PRIu64 " reused, %" PRIu64 " allocated, %iMB idle",
+           _pool.reused, _pool.allocated, _to_mb(_pool.idle_mem));
+
+  _pool_buffer_t *buf;
+  while((buf = g_queue_pop_head(&_pool.idle)))
+  {
+    _pool_sysfree(buf->mem);
+    g_free(buf);
+  }
+  _pool.idle_mem = 0;
+  dt_pthread_mutex_destroy(&_pool.lock);
+}
+
+/* The disk tier keeps cachelines that have been important for a pipe in files
+   named by their hash. It is shared by all pipes, all access to the index is
+   protected by the lock, file data is read and written outside of the lock.
+   Image ids are only unique within a library so every library gets its own
+   folder, files written by another darktable build are dropped as a changed
+   pipeline might give different data for the same hash.
+*/
+#define DT_PIPECACHE_DISK_MAGIC 0x63706474u // "dtpc"
+#define DT_PIPECACHE_DISK_VERSION 3
+
+typedef struct _disk_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  dt_hash_t build; // hash of the darktable version string
+  dt_hash_t hash;
+  uint64_t size;
+  int32_t imgid;
+  int32_t ioporder;
+  dt_iop_buffer_dsc_t dsc;
+} _disk_header_t;
+
+typedef struct _disk_entry_t
+{
+  dt_hash_t hash;
+  size_t size;
+  dt_imgid_t imgid;
+  int32_t ioporder;
+  GList *link;
+} _disk_entry_t;
+
+typedef struct _disk_tier_t
+{
+  gboolean enabled;
+  dt_pthread_mutex_t lock;
+  gchar *dir;
+  dt_hash_t build;
+  size_t limit;
+  size_t used;
+  GHashTable *index; // dt_hash_t -> _disk_entry_t
+  GQueue lru;        // oldest entries first
+} _disk_tier_t;
+
+static _disk_tier_t _disk = { .enabled = FALSE };
+
+static void _disk_filename(char *filename,
+                           const size_t size,
+                           const dt_hash_t hash)
+{
+  snprintf(filename, size, "%s/%016" PRIx64 ".dtpc", _disk.dir, hash);
+}
+
+static void _disk_remove_entry(_disk_entry_t *entry)
+{
+  char filename[PATH_MAX] = { 0 };
+  _disk_filename(filename, sizeof(filename), entry->hash);
+  g_unlink(filename);
+  g_queue_delete_link(&_disk.lru, entry->link);
+  _disk.used -= entry->size;
+  g_hash_table_remove(_disk.index, &entry->hash);
+}
+
+static void _disk_add_entry(const dt_hash_t hash,
+                            const size_t size,
+                            const dt_imgid_t imgid,
+                            const int32_t ioporder)
+{
+  _disk_entry_t *entry = g_malloc(sizeof(_disk_entry_t));
+  entry->hash = hash;
+  entry->size = size;
+  entry->imgid = imgid;
+  entry->ioporder = ioporder;
+  g_queue_push_tail(&_disk.lru, entry);
+  entry->link = g_queue_peek_tail_link(&_disk.lru);
+  _disk.used += size;
+  g_hash_table_insert(_disk.index, &entry->hash, entry);
+}
+
+// must be called with the lock held, evicts the oldest files until
+// 'needed' bytes fit into the limit.
+static void _disk_make_room(const size_t needed)
+{
+  while(_disk.used + needed > _disk.limit && !g_queue_is_empty(&_disk.lru))
+    _disk_remove_entry(g_queue_peek_head(&_disk.lru));
+}
+
+typedef struct _disk_found_t
+{
+  _disk_header_t hdr;
+  GStatBuf st;
+} _disk_found_t;
+
+static inline gboolean _disk_header_valid(const _disk_header_t *hdr)
+{
+  return hdr->magic == DT_PIPECACHE_DISK_MAGIC
+    && hdr->version == DT_PIPECACHE_DISK_VERSION
+    && hdr->build == _disk.build;
+}
+
+static gint _disk_sort_mtime(gconstpointer a, gconstpointer b)
+{
+  const _disk_found_t *fa = a;
+  const _disk_found_t *fb = b;
+  return (fa->st.st_mtime > fb->st.st_mtime) - (fa->st.st_mtime < fb->st.st_mtime);
+}
+
+void dt_dev_pixelpipe_cache_disk_remove_image(const dt_imgid_t imgid)
+{
+  if(!_disk.enabled) return;
+
+  dt_pthread_mutex_lock(&_disk.lock);
+  GList *link = _disk.lru.head;
+  while(link)
+  {
+    GList *next = g_list_next(link);
+    _disk_entry_t *entry = link->data;
+    if(entry->imgid == imgid)
+      _disk_remove_entry(entry);
+    link = next;
+  }
+  dt_pthread_mutex_unlock(&_disk.lock);
+}
+
+static void _disk_image_removed(gpointer instance,
+                                const dt_imgid_t imgid,
+                                gpointer user_data)
+{
+  dt_dev_pixelpipe_cache_disk_remove_image(imgid);
+}
+
+static void _disk_init(void)
+{
+  const int limit_mb = dt_conf_get_int("pipecache_disk_size");
+  if(limit_mb <= 0 || !darktable.pipe_cache) return;
+
+  // an in-memory library starts empty each time, image ids are reused
+  const gchar *dbfilename = dt_database_get_path(darktable.db);
+  if(!dbfilename || !strcmp(dbfilename, ":memory:")) return;
+
+  gchar *abspath = g_realpath(dbfilename);
+  if(!abspath) abspath = g_strdup(dbfilename);
+  gchar *library = g_compute_checksum_for_string(G_CHECKSUM_SHA1, abspath, -1);
+  g_free(abspath);
+
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  _disk.dir = g_build_filename(cachedir, "pixelpipe", library, NULL);
+  g_free(library);
+  if(g_mkdir_with_parents(_disk.dir, 0750))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[pixelpipe_cache] can't create disk cache directory %s", _disk.dir);
+    g_free(_disk.dir);
+    _disk.dir = NULL;
+    return;
+  }
+
+  dt_pthread_mutex_init(&_disk.lock, NULL);
+  _disk.build = dt_hash(DT_INITHASH, darktable_package_version, strlen(darktable_package_version));
+  _disk.index = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+  g_queue_init(&_disk.lru);
+  _disk.limit = (size_t)limit_mb * DT_MEGA;
+  _disk.used = 0;
+
+  // read all valid headers, sort them by modification time so the
+  // least recently written files are evicted first
+  GArray *found = g_array_new(FALSE, FALSE, sizeof(_disk_found_t));
+  GDir *dir = g_dir_open(_disk.dir, 0, NULL);
+  const gchar *name;
+  while(dir && (name = g_dir_read_name(dir)))
+  {
+    gchar *path = g_build_filename(_disk.dir, name, NULL);
+    _disk_found_t record;
+    FILE *f = g_str_has_suffix(name, ".dtpc") ? g_fopen(path, "rb") : NULL;
+    const gboolean valid = f
+      && fread(&record.hdr, sizeof(_disk_header_t), 1, f) == 1
+      && _disk_header_valid(&record.hdr)
+      && !g_stat(path, &record.st)
+      && record.st.st_size == (goffset)(sizeof(_disk_header_t) + record.hdr.size);
+    if(f) fclose(f);
+    if(valid)
+      g_array_append_val(found, record);
+    else
+      g_unlink(path);
+    g_free(path);
+  }
+  if(dir) g_dir_close(dir);
+
+  g_array_sort(found, _disk_sort_mtime);
+  for(guint k = 0; k < found->len; k++)
+  {
+    const _disk_header_t *hdr = &g_array_index(found, _disk_found_t, k).hdr;
+    if(!g_hash_table_contains(_disk.index, &hdr->hash))
+      _disk_add_entry(hdr->hash, hdr->size, hdr->imgid, hdr->ioporder);
+  }
+  g_array_free(found, TRUE);
+  _disk_make_room(0);
+
+  _disk.enabled = TRUE;
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_IMAGE_REMOVED, _disk_image_removed, NULL);
+  dt_print(DT_DEBUG_PIPE | DT_DEBUG_CACHE,
+           "[pixelpipe_cache] disk tier %s: %i files, using %iMB, limit=%iMB",
+           _disk.dir, g_queue_get_length(&_disk.lru), _to_mb(_disk.used), limit_mb);
+}
+
+static void _disk_cleanup(void)
+{
+  if(!_disk.enabled) return;
+
+  if(darktable.signals)
+    DT_CONTROL_SIGNAL_DISCONNECT(_disk_image_removed, NULL);
+  _disk.enabled = FALSE;
+  g_queue_clear(&_disk.lru);
+  g_hash_table_destroy(_disk.index);
+  _disk.index = NULL;
+  g_free(_disk.dir);
+  _disk.dir = NULL;
+  dt_pthread_mutex_destroy(&_disk.lock);
+}
+
+size_t dt_dev_pixelpipe_cache_global_usage(size_t *idle)
+{
+  if(idle)
+  {
+    *idle = 0;
+    if(_pool.enabled)
+    {
+      dt_pthread_mutex_lock(&_pool.lock);
+      *idle = _pool.idle_mem;
+      dt_pthread_mutex_unlock(&_pool.lock);
+    }
+  }
+  return (size_t)MAX(0, dt_atomic_get_int64(&_pool.used));
+}
+
+size_t dt_dev_pixelpipe_cache_global_trim(void)
+{
+  if(!_pool.enabled) return 0;
+
+  dt_pthread_mutex_lock(&_pool.lock);
+  GQueue release = _pool.idle;
+  const size_t freed = _pool.idle_mem;
+  g_queue_init(&_pool.idle);
+  _pool.idle_mem = 0;
+  dt_pthread_mutex_unlock(&_pool.lock);
+
+  _pool_buffer_t *buf;
+  while((buf = g_queue_pop_head(&release)))
+  {
+    _pool_sysfree(buf->mem);
+    g_free(buf);
+  }
+  return freed;
+}
+
+void dt_dev_pixelpipe_cache_global_init(void)
+{
+  _pool_init();
+  _disk_init();
+}
+
+void dt_dev_pixelpipe_cache_global_cleanup(void)
+{
+  _disk_cleanup();
+  _pool_cleanup();
+}
+
+static inline gboolean _disk_usable(const dt_dev_pixelpipe_t *pipe)
+{
+  // only the full pipe is flushed reliably if the input has changed without
+  // changing the hash so it's the only one we can use the disk tier for.
+  return _disk.enabled
+    && dt_pipe_is_full(pipe)
+    && pipe->cache.entries > DT_PIPECACHE_MIN
+    && dt_pipe_no_mask_display(pipe)
+    && !pipe->nocache;
+}
+
+static gboolean _disk_available(const dt_dev_pixelpipe_t *pipe,
+                                const dt_hash_t hash,
+                                const size_t size)
+{
+  if(!_disk_usable(pipe)) return FALSE;
+
+  dt_pthread_mutex_lock(&_disk.lock);
+  const _disk_entry_t *entry = g_hash_table_lookup(_disk.index, &hash);
+  const gboolean found = entry && entry->size == size;
+  dt_pthread_mutex_unlock(&_disk.lock);
+  return found;
+}
+
+// write the data of cacheline k to disk if it's worth keeping and not already there
+static void _disk_write(dt_dev_pixelpipe_t *pipe, const int k)
+{
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  if(!_disk_usable(pipe)
+     || !cache->important[k]
+     || !cache->data[k]
+     || cache->hash[k] == DT_INVALID_HASH
+     || cache->size[k] == 0
+     || cache->size[k] > _disk.limit)
+    return;
+
+  const _disk_header_t hdr = { .magic = DT_PIPECACHE_DISK_MAGIC,
+                               .version = DT_PIPECACHE_DISK_VERSION,
+                               .build = _disk.build,
+                               .hash = cache->hash[k],
+                               .size = cache->size[k],
+                               .imgid = pipe->image.id,
+                               .ioporder = cache->ioporder[k],
+                               .dsc = cache->dsc[k] };
+
+  dt_pthread_mutex_lock(&_disk.lock);
+  const gboolean exists = g_hash_table_contains(_disk.index, &hdr.hash);
+  dt_pthread_mutex_unlock(&_disk.lock);
+  if(exists) return;
+
+  char filename[PATH_MAX] = { 0 };
+  char tmpname[PATH_MAX] = { 0 };
+  _disk_filename(filename, sizeof(filename), hdr.hash);
+  snprintf(tmpname, sizeof(tmpname), "%s.%p", filename, (void *)pipe);
+
+  FILE *f = g_fopen(tmpname, "wb");
+  gboolean written = f
+    && fwrite(&hdr, sizeof(hdr), 1, f) == 1
+    && fwrite(cache->data[k], cache->size[k], 1, f) == 1;
+  if(f) written = !fclose(f) && written;
+
+  dt_pthread_mutex_lock(&_disk.lock);
+  if(written && !g_hash_table_contains(_disk.index, &hdr.hash))
+  {
+    _disk_make_room(hdr.size);
+    written = !g_rename(tmpname, filename);
+    if(written)
+      _disk_add_entry(hdr.hash, hdr.size, hdr.imgid, hdr.ioporder);
+  }
+  dt_pthread_mutex_unlock(&_disk.lock);
+  g_unlink(tmpname);
+
+  if(written)
+  {
+    cache->disk_writes++;
+    dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE, "pipe cache disk write",
+      pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+      "line%3i %iMB, hash=%" PRIx64, k, _to_mb(hdr.size), hdr.hash);
+  }
+}
+
+// read the data for the hash into cacheline k, returns TRUE on success
+static gboolean _disk_read(dt_dev_pixelpipe_t *pipe,
+                           const int k,
+                           const dt_hash_t hash)
+{
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  char filename[PATH_MAX] = { 0 };
+
+  // open the file while holding the lock so it can't be evicted in between
+  dt_pthread_mutex_lock(&_disk.lock);
+  _disk_entry_t *entry = g_hash_table_lookup(_disk.index, &hash);
+  FILE *f = NULL;
+  if(entry && entry->size == cache->size[k])
+  {
+    _disk_filename(filename, sizeof(filename), hash);
+    f = g_fopen(filename, "rb");
+    g_queue_unlink(&_disk.lru, entry->link);
+    g_queue_push_tail_link(&_disk.lru, entry->link);
+  }
+  dt_pthread_mutex_unlock(&_disk.lock);
+  if(!f) return FALSE;
+
+  _disk_header_t hdr;
+  const gboolean valid = fread(&hdr, sizeof(hdr), 1, f) == 1
+    && _disk_header_valid(&hdr)
+    && hdr.hash == hash
+    && hdr.size == cache->size[k]
+    && fread(cache->data[k], cache->size[k], 1, f) == 1;
+  fclose(f);
+
+  if(!valid)
+  {
+    dt_pthread_mutex_lock(&_disk.lock);
+    entry = g_hash_table_lookup(_disk.index, &hash);
+    if(entry) _disk_remove_entry(entry);
+    dt_pthread_mutex_unlock(&_disk.lock);
+    return FALSE;
+  }
+
+  cache->dsc[k] = hdr.dsc;
+  cache->ioporder[k] = hdr.ioporder;
+  return TRUE;
+}
+
+// drop all files of the pipe's image from modules with at least the given iop_order
+static int _disk_invalidate_later(const dt_dev_pixelpipe_t *pipe, const int32_t order)
+{
+  if(!_disk.enabled || !dt_pipe_is_full(pipe)) return 0;
+
+  int removed = 0;
+  dt_pthread_mutex_lock(&_disk.lock);
+  GList *link = _disk.lru.head;
+  while(link)
+  {
+    GList *next = g_list_next(link);
+    _disk_entry_t *entry = link->data;
+    if(entry->imgid == pipe->image.id && entry->ioporder >= order)
+    {
+      _disk_remove_entry(entry);
+      removed++;
+    }
+    link = next;
+  }
+  dt_pthread_mutex_unlock(&_disk.lock);
+  return removed;
+}
+
+/* Preview pipes may keep lines that have been evicted in half precision, the
+   preview is only shown in small size so the reduced precision is not visible.
+   The compacted lines are private to the pipe, they are expanded back into a
+   float line on a hit and dropped together with the float lines on invalidation.
+   Lines in raw colorspace are kept in float as they are sensitive to precision.
+*/
+#define DT_PIPECACHE_HALF_MAX 65504.0f
+
+typedef struct _half_line_t
+{
+  dt_hash_t hash;
+  size_t size; // of the float line
+  int32_t ioporder;
+  dt_iop_buffer_dsc_t dsc;
+  uint16_t *data;
+} _half_line_t;
+
+static inline uint16_t _float_to_half(const float f)
+{
+  // round to nearest even, adapted from https://gist.github.com/rygorous/2156668
+  union { uint32_t u; float f; } v = { .f = fminf(fmaxf(f, -DT_PIPECACHE_HALF_MAX), DT_PIPECACHE_HALF_MAX) };
+  const union { uint32_t u; float f; } denorm_magic = { .u = ((127 - 15) + (23 - 10) + 1) << 23 };
+  const uint32_t sign = v.u & 0x80000000u;
+  v.u ^= sign;
+
+  uint16_t h;
+  if(v.u < (113u << 23))
+  {
+    v.f += denorm_magic.f;
+    h = (uint16_t)(v.u - denorm_magic.u);
+  }
+  else
+  {
+    const uint32_t mant_odd = (v.u >> 13) & 1;
+    v.u += ((uint32_t)(15 - 127) << 23) + 0xfff + mant_odd;
+    h = (uint16_t)(v.u >> 13);
+  }
+  return h | (uint16_t)(sign >> 16);
+}
+
+static inline float _half_to_float(const uint16_t h)
+{
+  const union { uint32_t u; float f; } magic = { .u = 113u << 23 };
+  const uint32_t shifted_exp = 0x7c00u << 13;
+  union { uint32_t u; float f; } o = { .u = ((uint32_t)h & 0x7fffu) << 13 };
+  const uint32_t exp = shifted_exp & o.u;
+  o.u += (127 - 15) << 23;
+  if(exp == shifted_exp)
+    o.u += (128 - 16) << 23;
+  else if(exp == 0)
+  {
+    o.u += 1 << 23;
+    o.f -= magic.f;
+  }
+  o.u |= ((uint32_t)h & 0x8000u) << 16;
+  return o.f;
+}
+
+static void _half_compact(uint16_t *const restrict out,
+                          const float *const restrict in,
+                          const size_t n)
+{
+  size_t i = 0;
+#ifdef __F16C__
+  const __m256 hmax = _mm256_set1_ps(DT_PIPECACHE_HALF_MAX);
+  const __m256 hmin = _mm256_set1_ps(-DT_PIPECACHE_HALF_MAX);
+  for(; i + 8 <= n; i += 8)
+  {
+    const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i), hmin), hmax);
+    _mm_storeu_si128((__m128i *)(out + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+  }
+#endif
+  for(; i < n; i++)
+    out[i] = _float_to_half(in[i]);
+}
+
+static void _half_expand(float *const restrict out,
+                         const uint16_t *const restrict in,
+                         const size_t n)
+{
+  size_t i = 0;
+#ifdef __F16C__
+  for(; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(in + i))));
+#endif
+  for(; i < n; i++)
+    out[i] = _half_to_float(in[i]);
+}
+
+static inline gboolean _half_usable(const dt_dev_pixelpipe_t *pipe)
+{
+  return pipe->cache.half_enabled
+    && (dt_pipe_is_preview(pipe) || dt_pipe_is_preview2(pipe))
+    && pipe->cache.entries > DT_PIPECACHE_MIN
+    && dt_pipe_no_mask_display(pipe)
+    && !pipe->nocache;
+}
+
+static GList *_half_find(const dt_dev_pixelpipe_cache_t *cache,
+                         const dt_hash_t hash)
+{
+  for(GList *link = cache->half.head; link; link = g_list_next(link))
+  {
+    const _half_line_t *line = link->data;
+    if(line->hash == hash) return link;
+  }
+  return NULL;
+}
+
+static void _half_remove(dt_dev_pixelpipe_cache_t *cache, GList *link)
+{
+  _half_line_t *line = link->data;
+  cache->half_mem -= line->size / 2;
+  dt_mem_account_free(cache->mem_account, line->size / 2);
+  dt_free_align(line->data);
+  g_free(line);
+  g_queue_delete_link(&cache->half, link);
+}
+
+static gboolean _half_available(const dt_dev_pixelpipe_t *pipe,
+                                const dt_hash_t hash,
+                                const size_t size)
+{
+  if(!_half_usable(pipe)) return FALSE;
+
+  const GList *link = _half_find(&pipe->cache, hash);
+  return link && ((const _half_line_t *)link->data)->size == size;
+}
+
+// keep the data of cacheline k in half precision, we keep as many compacted
+// lines as the pipe has float lines, dropping the oldest ones.
+static void _half_write(dt_dev_pixelpipe_t *pipe, const int k)
+{
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  if(!_half_usable(pipe)
+     || k < DT_PIPECACHE_MIN
+     || !cache->data[k]
+     || cache->hash[k] == DT_INVALID_HASH
+     || cache->size[k] == 0
+     || cache->size[k] % sizeof(float)
+     || cache->dsc[k].datatype != TYPE_FLOAT
+     || cache->dsc[k].cst == IOP_CS_RAW
+     || _half_find(cache, cache->hash[k]))
+    return;
+
+  const size_t count = cache->size[k] / sizeof(float);
+  uint16_t *data = dt_alloc_aligned(count * sizeof(uint16_t));
+  if(!data) return;
+
+  _half_compact(data, cache->data[k], count);
+
+  _half_line_t *line = g_malloc(sizeof(_half_line_t));
+  line->hash = cache->hash[k];
+  line->size = cache->size[k];
+  line->ioporder = cache->ioporder[k];
+  line->dsc = cache->dsc[k];
+  line->data = data;
+  g_queue_push_tail(&cache->half, line);
+  cache->half_mem += line->size / 2;
+  dt_mem_account_alloc(cache->mem_account, line->size / 2);
+  cache->half_writes++;
+
+  while(g_queue_get_length(&cache->half) > (guint)cache->entries)
+    _half_remove(cache, cache->half.head);
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE, "pipe cache half write",
+    pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+    "line%3i %iMB, hash=%" PRIx64, k, _to_mb(line->size / 2), line->hash);
+}
+
+// expand the data for the hash into cacheline k, returns TRUE on success
+static gboolean _half_read(dt_dev_pixelpipe_t *pipe,
+                           const int k,
+                           const dt_hash_t hash)
+{
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  GList *link = _half_find(cache, hash);
+  if(!link) return FALSE;
+
+  const _half_line_t *line = link->data;
+  const gboolean valid = line->size == cache->size[k];
+  if(valid)
+  {
+    _half_expand(cache->data[k], line->data, line->size / sizeof(float));
+    cache->dsc[k] = line->dsc;
+    cache->ioporder[k] = line->ioporder;
+  }
+  // the data is in a float line now and compacted again if evicted
+  _half_remove(cache, link);
+  return valid;
+}
+
+static int _half_invalidate_later(dt_dev_pixelpipe_cache_t *cache, const int32_t order)
+{
+  int removed = 0;
+  GList *link = cache->half.head;
+  while(link)
+  {
+    GList *next = g_list_next(link);
+    if(((const _half_line_t *)link->data)->ioporder >= order)
+    {
+      _half_remove(cache, link);
+      removed++;
+    }
+    link = next;
+  }
+  return removed;
+}
+
+static inline int64_t _age(const dt_dev_pixelpipe_cache_t *cache, const int k)
+{
+  return (int64_t)cache->calls - cache->stamp[k];
+}
+
+static inline uint32_t _index_slot(const dt_dev_pixelpipe_cache_t *cache,
+                                   const dt_hash_t hash)
+{
+  return (uint32_t)(hash ^ (hash >> 32)) & cache->index_mask;
+}
+
+// returns the line having the hash or -1, the index always has free slots
+static int _index_find(const dt_dev_pixelpipe_cache_t *cache,
+                       const dt_hash_t hash)
+{
+  for(uint32_t i = _index_slot(cache, hash);; i = (i + 1) & cache->index_mask)
+  {
+    const int k = cache->index[i];
+    if(k < 0) return -1;
+    if(cache->hash[k] == hash) return k;
+  }
+}
+
+static void _index_remove(const dt_dev_pixelpipe_cache_t *cache, const int k)
+{
+  const uint32_t mask = cache->index_mask;
+  uint32_t i = _index_slot(cache, cache->hash[k]);
+  while(cache->index[i] != k)
+  {
+    if(cache->index[i] < 0) return;
+    i = (i + 1) & mask;
+  }
+
+  // backward shift deletion, move following lines of the probe sequence into the gap
+  for(uint32_t j = (i + 1) & mask; cache->index[j] >= 0; j = (j + 1) & mask)
+  {
+    const int m = cache->index[j];
+    const uint32_t home = _index_slot(cache, cache->hash[m]);
+    if(((j - home) & mask) >= ((j - i) & mask))
+    {
+      cache->index[i] = m;
+      i = j;
+    }
+  }
+  cache->index[i] = -1;
+}
+
+// all changes of a line's hash must be done here to keep the index in sync.
+// The first cachelines are used for swapping and are never looked up so they are not indexed.
+static void _set_hash(const dt_dev_pixelpipe_cache_t *cache,
+                      const int k,
+                      const dt_hash_t hash)
+{
+  if(k < DT_PIPECACHE_MIN)
+  {
+    cache->hash[k] = hash;
+    return;
+  }
+
+  if(cache->hash[k] != DT_INVALID_HASH) _index_remove(cache, k);
+  cache->hash[k] = DT_INVALID_HASH;
+  if(hash == DT_INVALID_HASH) return;
+
+  // a hash is only valid for the latest line written
+  const int other = _index_find(cache, hash);
+  if(other >= 0)
+  {
+    _index_remove(cache, other);
+    cache->hash[other] = DT_INVALID_HASH;
+    cache->important[other] = FALSE;
+  }
+
+  cache->hash[k] = hash;
+  uint32_t i = _index_slot(cache, hash);
+  while(cache->index[i] >= 0) i = (i + 1) & cache->index_mask;
+  cache->index[i] = k;
+}
+
+static void _lru_unlink(dt_dev_pixelpipe_cache_t *cache, const int k)
+{
+  const int list = cache->lru_list[k];
+  const int prev = cache->lru_prev[k];
+  const int next = cache->lru_next[k];
+  if(prev >= 0) cache->lru_next[prev] = next;
+  else          cache->lru_head[list] = next;
+  if(next >= 0) cache->lru_prev[next] = prev;
+  else          cache->lru_tail[list] = prev;
+}
+
+static void _lru_append(dt_dev_pixelpipe_cache_t *cache,
+                        const int k,
+                        const int list)
+{
+  const int tail = cache->lru_tail[list];
+  cache->lru_list[k] = list;
+  cache->lru_prev[k] = tail;
+  cache->lru_next[k] = -1;
+  if(tail >= 0) cache->lru_next[tail] = k;
+  else          cache->lru_head[list] = k;
+  cache->lru_tail[list] = k;
+}
+
+/* Sets the age of a line to zero or, if important, to -entries so it survives
+   the following calls. As both have a constant offset to calls the lists stay sorted
+   if we append to their tail.
+*/
+static void _touch(dt_dev_pixelpipe_cache_t *cache,
+                   const int k,
+                   const gboolean important)
+{
+  cache->stamp[k] = (int64_t)cache->calls + (important ? cache->entries : 0);
+  if(k < DT_PIPECACHE_MIN) return;
+
+  _lru_unlink(cache, k);
+  _lru_append(cache, k, important ? 1 : 0);
+}
+
 gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
                                      const int entries,
                                      const size_t size,
@@ -37,20 +970,52 @@ gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
 
   cache->entries = entries;
   cache->allmem = cache->hits = cache->calls = cache->tests = 0;
+  cache->misses = cache->evictions = 0;
   cache->memlimit = limit;
+  cache->mem_account = dt_mem_account_pipe(pipe->type);
+
+  cache->disk_hits = cache->disk_writes = 0;
+
+  cache->half_enabled = dt_conf_get_bool("pipecache_half_precision");
+  g_queue_init(&cache->half);
+  cache->half_mem = cache->half_hits = cache->half_writes = 0;
+  cache->peer_hits = 0;
 
-  const size_t csize = sizeof(void *) + sizeof(size_t) + sizeof(dt_iop_buffer_dsc_t) + 2*sizeof(int32_t) + sizeof(uint64_t);
-  cache->data = (void **) calloc(entries, csize);
+  cache->chain_size = 0;
+  cache->chain_valid[0] = cache->chain_valid[1] = 0;
+  cache->chain[0] = cache->chain[1] = cache->node[0] = cache->node[1] = NULL;
+
+  // the index has at least twice the slots of lines so probe sequences stay short
+  uint32_t slots = 4;
+  while(slots < 2 * (uint32_t)entries) slots <<= 1;
+  cache->index_mask = slots - 1;
+
+  const size_t csize = sizeof(void *) + sizeof(size_t) + sizeof(dt_iop_buffer_dsc_t)
+                     + sizeof(dt_hash_t) + sizeof(int64_t) + sizeof(int32_t) + sizeof(gboolean)
+                     + 3 * sizeof(int32_t);
+  cache->data = (void **) calloc(1, entries * csize + slots * sizeof(int32_t));
   cache->size = (size_t *)((void *)cache->data + entries * sizeof(void *));
   cache->dsc = (dt_iop_buffer_dsc_t *)((void *)cache->size + entries * sizeof(size_t));
   cache->hash = (dt_hash_t *)((void *)cache->dsc + entries * sizeof(dt_iop_buffer_dsc_t));
-  cache->used = (int32_t *)((void *)cache->hash + entries * sizeof(dt_hash_t));
-  cache->ioporder = (int32_t *)((void *)cache->used + entries * sizeof(int32_t));
+  cache->stamp = (int64_t *)((void *)cache->hash + entries * sizeof(dt_hash_t));
+  cache->ioporder = (int32_t *)((void *)cache->stamp + entries * sizeof(int64_t));
+  cache->important = (gboolean *)((void *)cache->ioporder + entries * sizeof(int32_t));
+  cache->lru_prev = (int32_t *)((void *)cache->important + entries * sizeof(gboolean));
+  cache->lru_next = cache->lru_prev + entries;
+  cache->lru_list = cache->lru_next + entries;
+  cache->index = cache->lru_list + entries;
 
-  for(int k = 0; k < entries; k++)
+  for(uint32_t i = 0; i < slots; i++)
+    cache->index[i] = -1;
+
+  cache->lru_head[0] = cache->lru_head[1] = -1;
+  cache->lru_tail[0] = cache->lru_tail[1] = -1;
+  for(int k = entries - 1; k >= 0; k--)
   {
     cache->hash[k] = DT_INVALID_HASH;
-    cache->used[k] = 64 + k;
+    // initially all lines are old, higher lines being older
+    cache->stamp[k] = -(64 + k);
+    if(k >= DT_PIPECACHE_MIN) _lru_append(cache, k, 0);
   }
   if(!size) return TRUE;
 
@@ -58,7 +1023,7 @@ gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
   for(int k = 0; k < entries; k++)
   {
     cache->size[k] = size;
-    cache->data[k] = (void *)dt_alloc_aligned(size);
+    cache->data[k] = _pool_alloc(size, cache->mem_account);
     if(!cache->data[k])
       goto alloc_memory_fail;
 
@@ -72,7 +1037,7 @@ gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
   // but will only fail to generate thumbnails for example.
   for(int k = 0; k < cache->entries; k++)
   {
-    dt_free_align(cache->data[k]);
+    _pool_free(cache->data[k], cache->size[k], cache->mem_account);
     cache->size[k] = 0;
     cache->data[k] = NULL;
   }
@@ -86,21 +1051,121 @@ void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_t *pipe)
 
   if(dt_pipe_is_full(pipe))
   {
-    dt_print(DT_DEBUG_PIPE, "Session fullpipe cache report. hits/run=%.2f, hits/test=%.3f",
+    dt_print(DT_DEBUG_PIPE, "Session fullpipe cache report. hits/run=%.2f, hits/test=%.3f, misses=%" PRIu64 ", evictions=%" PRIu64,
     (double)(cache->hits) / fmax(1.0, pipe->runs),
-    (double)(cache->hits) / fmax(1.0, cache->tests));
+    (double)(cache->hits) / fmax(1.0, cache->tests),
+    cache->misses, cache->evictions);
   }
 
   for(int k = 0; k < cache->entries; k++)
   {
-    dt_free_align(cache->data[k]);
+    _disk_write(pipe, k);
+    _pool_free(cache->data[k], cache->size[k], cache->mem_account);
     cache->data[k] = NULL;
   }
+  _half_invalidate_later(cache, 0);
   free(cache->data);
   cache->data = NULL;
+  free(cache->chain[0]);
+  cache->chain[0] = cache->chain[1] = cache->node[0] = cache->node[1] = NULL;
+  cache->chain_size = 0;
+}
+
+// Profiles are identified by type, filename and intent instead of the address of
+// the profile info so the hash stays valid across sessions for the disk tier.
+static dt_hash_t _profile_hash(dt_hash_t hash,
+                               const dt_iop_order_iccprofile_info_t *info)
+{
+  if(!info) return dt_hash(hash, &info, sizeof(info));
+
+  hash = dt_hash(hash, &info->type, sizeof(info->type));
+  hash = dt_hash(hash, info->filename, strlen(info->filename));
+  return dt_hash(hash, &info->intent, sizeof(info->intent));
+}
+
+// what the piece at a pipe node adds to the hash, DT_INVALID_HASH if nothing
+static dt_hash_t _dev_pixelpipe_cache_node(dt_dev_pixelpipe_t *pipe,
+                                           dt_dev_pixelpipe_iop_t *piece,
+                                           const gboolean with_roi)
+{
+  // As this runs through all pipe nodes - also the ones not commited -
+  // we can safely avoid disabled modules/pieces
+  const gboolean included = piece->module->enabled || piece->enabled;
+  // don't take skipped modules into account
+  const gboolean skipped = dt_iop_module_is_skipped(piece->module->dev, piece->module)
+    && dt_pipe_is_basic(pipe);
+  if(skipped || !included) return DT_INVALID_HASH;
+
+  dt_hash_t hash = piece->hash;
+  if(piece->module->request_color_pick != DT_REQUEST_COLORPICK_OFF && with_roi)
+  {
+    if(darktable.lib->proxy.colorpicker.primary_sample->size == DT_LIB_COLORPICKER_SIZE_BOX)
+    {
+      hash = dt_hash(hash, darktable.lib->proxy.colorpicker.primary_sample->box, sizeof(dt_pickerbox_t));
+    }
+    else if(darktable.lib->proxy.colorpicker.primary_sample->size == DT_LIB_COLORPICKER_SIZE_POINT)
+    {
+      hash = dt_hash(hash, darktable.lib->proxy.colorpicker.primary_sample->point, 2 * sizeof(float));
+    }
+  }
+  // keep a node that is included apart from one that isn't
+  return hash == DT_INVALID_HASH ? DT_INITHASH : hash;
+}
+
+/* The hash of all nodes before position. Each pipe run asks for it at every node so the
+   prefix hashes are kept, a node whose contribution is unchanged reuses the prefix up to it
+   and only the part downstream of the first changed node is hashed again.
+*/
+static dt_hash_t _dev_pixelpipe_cache_chain(dt_dev_pixelpipe_t *pipe,
+                                            const int position,
+                                            const gboolean with_roi)
+{
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  const int v = with_roi ? 1 : 0;
+
+  if(position >= cache->chain_size)
+  {
+    const int32_t size = MAX(position + 1, 2 * cache->chain_size);
+    dt_hash_t *mem = malloc(sizeof(dt_hash_t) * 4 * size);
+    if(!mem)
+    {
+      // no prefix cache, hash the whole chain
+      dt_hash_t hash = DT_INITHASH;
+      GList *pieces = pipe->nodes;
+      for(int k = 0; k < position && pieces; k++, pieces = g_list_next(pieces))
+      {
+        const dt_hash_t node = _dev_pixelpipe_cache_node(pipe, pieces->data, with_roi);
+        if(node != DT_INVALID_HASH) hash = dt_hash(hash, &node, sizeof(node));
+      }
+      return hash;
+    }
+    free(cache->chain[0]);
+    cache->chain[0] = mem;
+    cache->chain[1] = mem + size;
+    cache->node[0] = mem + 2 * size;
+    cache->node[1] = mem + 3 * size;
+    cache->chain[0][0] = cache->chain[1][0] = DT_INITHASH;
+    cache->chain_valid[0] = cache->chain_valid[1] = 0;
+    cache->chain_size = size;
+  }
+
+  dt_hash_t *chain = cache->chain[v];
+  dt_hash_t *nodes = cache->node[v];
+  int k = 0;
+  for(GList *pieces = pipe->nodes; k < position && pieces; k++, pieces = g_list_next(pieces))
+  {
+    const dt_hash_t node = _dev_pixelpipe_cache_node(pipe, pieces->data, with_roi);
+    if(k < cache->chain_valid[v] && nodes[k] == node) continue;
+
+    nodes[k] = node;
+    chain[k + 1] = node == DT_INVALID_HASH ? chain[k] : dt_hash(chain[k], &node, sizeof(node));
+    cache->chain_valid[v] = k + 1;
+  }
+  return chain[k];
 }
 
 static dt_hash_t _dev_pixelpipe_cache_basichash(dt_dev_pixelpipe_t *pipe,
+                                                const dt_dev_pixelpipe_type_t type,
                                                 const int position,
                                                 const dt_iop_roi_t *roi)
 {
@@ -119,62 +1184,90 @@ static dt_hash_t _dev_pixelpipe_cache_basichash(dt_dev_pixelpipe_t *pipe,
           for better support of dt_dev_pixelpipe_piece_hash()
   */
   const uint32_t hashing_pipemode[3] = {(uint32_t)pipe->image.id,
-                                        (uint32_t)pipe->type,
+                                        (uint32_t)type,
                                         (uint32_t)pipe->want_detail_mask };
   dt_hash_t hash = dt_hash(DT_INITHASH, &hashing_pipemode, sizeof(uint32_t) * (roi ? 3 : 1));
-  hash = dt_hash(hash, &pipe->input_profile_info, sizeof(pipe->input_profile_info));
-  hash = dt_hash(hash, &pipe->work_profile_info, sizeof(pipe->work_profile_info));
-  hash = dt_hash(hash, &pipe->output_profile_info, sizeof(pipe->output_profile_info));
-  hash = dt_hash(hash, &pipe->export_profile_info, sizeof(pipe->export_profile_info));
-
-  // go through all modules up to position and compute a hash using the operation and params.
-  GList *pieces = pipe->nodes;
-  for(int k = 0; k < position && pieces; k++)
-  {
-    dt_dev_pixelpipe_iop_t *piece = pieces->data;
-    // As this runs through all pipe nodes - also the ones not commited -
-    // we can safely avoid disabled modules/pieces
-    const gboolean included = piece->module->enabled || piece->enabled;
-    // don't take skipped modules into account
-    const gboolean skipped = dt_iop_module_is_skipped(piece->module->dev, piece->module)
-      && dt_pipe_is_basic(pipe);
-    if(!skipped && included)
-    {
-      hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
-      if(piece->module->request_color_pick != DT_REQUEST_COLORPICK_OFF && roi)
-      {
-        if(darktable.lib->proxy.colorpicker.primary_sample->size == DT_LIB_COLORPICKER_SIZE_BOX)
-        {
-          hash = dt_hash(hash, darktable.lib->proxy.colorpicker.primary_sample->box, sizeof(dt_pickerbox_t));
-        }
-        else if(darktable.lib->proxy.colorpicker.primary_sample->size == DT_LIB_COLORPICKER_SIZE_POINT)
-        {
-          hash = dt_hash(hash, darktable.lib->proxy.colorpicker.primary_sample->point, 2 * sizeof(float));
-        }
-      }
-    }
-    pieces = g_list_next(pieces);
-  }
-  return hash;
+  hash = _profile_hash(hash, pipe->input_profile_info);
+  hash = _profile_hash(hash, pipe->work_profile_info);
+  hash = _profile_hash(hash, pipe->output_profile_info);
+  hash = _profile_hash(hash, pipe->export_profile_info);
+
+  const dt_hash_t chain = _dev_pixelpipe_cache_chain(pipe, position, roi != NULL);
+  return dt_hash(hash, &chain, sizeof(chain));
 }
 
 /* If we don't provide a roi this reflects the parameters including blending of all used pieces
    in the pipe until the provided postion.
 */
-dt_hash_t dt_dev_pixelpipe_cache_hash(const dt_iop_roi_t *roi,
-                                      dt_dev_pixelpipe_t *pipe,
-                                      const int position)
+static dt_hash_t _dev_pixelpipe_cache_hash(const dt_iop_roi_t *roi,
+                                           dt_dev_pixelpipe_t *pipe,
+                                           const dt_dev_pixelpipe_type_t type,
+                                           const int position)
 {
-  dt_hash_t hash = _dev_pixelpipe_cache_basichash(pipe, position, roi);
-  // also include roi data if provided
+  dt_hash_t hash = _dev_pixelpipe_cache_basichash(pipe, type, position, roi);
+  // also include roi data if provided, relative to the input of the pipe
   if(roi)
   {
+    const int input[2] = { pipe->iwidth, pipe->iheight };
+    hash = dt_hash(hash, input, sizeof(input));
     hash = dt_hash(hash, roi, sizeof(dt_iop_roi_t));
     hash = dt_hash(hash, &pipe->scharr.hash, sizeof(pipe->scharr.hash));
   }
   return hash;
 }
 
+dt_hash_t dt_dev_pixelpipe_cache_hash(const dt_iop_roi_t *roi,
+                                      dt_dev_pixelpipe_t *pipe,
+                                      const int position)
+{
+  return _dev_pixelpipe_cache_hash(roi, pipe, pipe->type, position);
+}
+
+gboolean dt_dev_pixelpipe_cache_get_from(dt_dev_pixelpipe_t *pipe,
+                                         dt_dev_pixelpipe_t *peer,
+                                         const dt_iop_roi_t *roi,
+                                         const int position,
+                                         const dt_hash_t hash,
+                                         const size_t size,
+                                         void **data,
+                                         dt_iop_buffer_dsc_t **dsc,
+                                         const dt_iop_module_t *module)
+{
+  if(pipe->cache.entries <= DT_PIPECACHE_MIN
+     || peer->cache.entries <= DT_PIPECACHE_MIN
+     || peer->image.id != pipe->image.id
+     || peer->input != pipe->input
+     || hash == DT_INVALID_HASH)
+    return FALSE;
+
+  // the peer's lines are only stable while it doesn't process
+  if(dt_pthread_mutex_trylock(&peer->busy_mutex)) return FALSE;
+
+  // the line the peer would have for our pieces
+  const dt_hash_t peer_hash = _dev_pixelpipe_cache_hash(roi, pipe, peer->type, position);
+  const dt_dev_pixelpipe_cache_t *pc = &peer->cache;
+  const int k = dt_pipe_no_mask_display(peer) && !peer->nocache
+    ? _index_find(pc, peer_hash)
+    : -1;
+  const gboolean found = k >= 0 && pc->data[k] && pc->size[k] == size;
+  if(found)
+  {
+    **dsc = pc->dsc[k];
+    dt_dev_pixelpipe_cache_get(pipe, hash, size, data, dsc, module, TRUE);
+    if(*data) memcpy(*data, pc->data[k], size);
+  }
+  dt_pthread_mutex_unlock(&peer->busy_mutex);
+
+  if(found && *data)
+  {
+    pipe->cache.peer_hits++;
+    dt_print_pipe(DT_DEBUG_PIPE, "cache PEER HIT",
+          pipe, module, DT_DEVICE_NONE, NULL, NULL,
+          "from %s, hash=%" PRIx64, dt_dev_pixelpipe_type_to_str(peer->type), hash);
+  }
+  return found && *data;
+}
+
 gboolean dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_t *pipe,
                                           const dt_hash_t hash,
                                           const size_t size)
@@ -187,41 +1280,59 @@ gboolean dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_t *pipe,
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
   cache->tests++;
   // search for hash in cache and make the sizes are identical
-  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  const int k = _index_find(cache, hash);
+  if(k >= 0 && cache->size[k] == size)
   {
-    if((cache->size[k] == size) && (cache->hash[k] == hash))
-    {
-      cache->hits++;
-      return TRUE;
-    }
+    cache->hits++;
+    return TRUE;
+  }
+
+  // not in memory but maybe in the disk or half tier, the data is read by the following cache get
+  if(_disk_available(pipe, hash, size) || _half_available(pipe, hash, size))
+  {
+    cache->hits++;
+    return TRUE;
   }
   return FALSE;
 }
 
+static void _mark_invalid_cacheline(const dt_dev_pixelpipe_cache_t *cache, const int k)
+{
+  _set_hash(cache, k, DT_INVALID_HASH);
+  cache->ioporder[k] = 0;
+  cache->important[k] = FALSE;
+}
+
 // While looking for the oldest cacheline we always ignore the first two lines as they are used
-// for swapping buffers while in entries==DT_PIPECACHE_MIN or masking mode
+// for swapping buffers while in entries==DT_PIPECACHE_MIN or masking mode.
+// Both LRU lists are walked from their heads in order of age so we usually stop at the first line.
 static int _get_oldest_cacheline(dt_dev_pixelpipe_cache_t *cache,
                                  const dt_dev_pixelpipe_cache_test_t mode)
 {
-  // we never want the latest used cacheline! It was <= 0 and the weight has increased just now
-  int age = 1;
-  int id = 0;
-  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  int plain = cache->lru_head[0];
+  int important = cache->lru_head[1];
+  while(plain >= 0 || important >= 0)
   {
-    gboolean older = (cache->used[k] > age) && (k != cache->lastline);
-    if(older)
-    {
-      if(mode == DT_CACHETEST_USED)         older = cache->data[k] != NULL;
-      else if(mode == DT_CACHETEST_FREE)    older = cache->data[k] == NULL;
-      else if(mode == DT_CACHETEST_INVALID) older = cache->hash[k] == DT_INVALID_HASH;
-      if(older)
-      {
-        age = cache->used[k];
-        id = k;
-      }
-    }
+    const gboolean take_plain = important < 0
+      || (plain >= 0 && cache->stamp[plain] <= cache->stamp[important]);
+    const int k = take_plain ? plain : important;
+
+    // we never want the latest used cacheline! It was <= 0 and the weight has increased just now
+    // all following lines are younger
+    if(_age(cache, k) <= 1) break;
+
+    if(take_plain) plain = cache->lru_next[k];
+    else           important = cache->lru_next[k];
+
+    if(k == cache->lastline) continue;
+
+    gboolean older = TRUE;
+    if(mode == DT_CACHETEST_USED)         older = cache->data[k] != NULL;
+    else if(mode == DT_CACHETEST_FREE)    older = cache->data[k] == NULL;
+    else if(mode == DT_CACHETEST_INVALID) older = cache->hash[k] == DT_INVALID_HASH;
+    if(older) return k;
   }
-  return id;
+  return 0;
 }
 
 static int _get_c_cacheline(dt_dev_pixelpipe_cache_t *cache)
@@ -258,36 +1369,33 @@ static gboolean _get_by_hash(dt_dev_pixelpipe_t *pipe,
                              dt_iop_buffer_dsc_t **dsc)
 {
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
-  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  const int k = _index_find(cache, hash);
+  if(k < 0) return FALSE;
+
+  if(cache->size[k] != size)
   {
-    if(cache->hash[k] == hash)
-    {
-      if(cache->size[k] != size)
-      {
-        /* We check for situation with a hash identity but buffer sizes don't match.
-           This could happen because of "hash overlaps" or other situations where the hash
-           doesn't reflect the complete status.
-           Anyway this has to be accepted as a dt bug so we always report
-        */
-        cache->hash[k] = DT_INVALID_HASH;
-        dt_print_pipe(DT_DEBUG_ALWAYS, "CACHELINE_SIZE ERROR",
-          pipe, module, DT_DEVICE_NONE, NULL, NULL);
-      }
-      else if(pipe->mask_display || pipe->nocache)
-      {
-        // this should not happen but we make sure
-        cache->hash[k] = DT_INVALID_HASH;
-      }
-      else
-      {
-        // we have a proper hit
-        *data = cache->data[k];
-        *dsc = &cache->dsc[k];
-        // in case of a hit it's always good to further keep the cacheline as important
-        cache->used[k] = -cache->entries;
-        return TRUE;
-      }
-    }
+    /* We check for situation with a hash identity but buffer sizes don't match.
+       This could happen because of "hash overlaps" or other situations where the hash
+       doesn't reflect the complete status.
+       Anyway this has to be accepted as a dt bug so we always report
+    */
+    _set_hash(cache, k, DT_INVALID_HASH);
+    dt_print_pipe(DT_DEBUG_ALWAYS, "CACHELINE_SIZE ERROR",
+      pipe, module, DT_DEVICE_NONE, NULL, NULL);
+  }
+  else if(pipe->mask_display || pipe->nocache)
+  {
+    // this should not happen but we make sure
+    _set_hash(cache, k, DT_INVALID_HASH);
+  }
+  else
+  {
+    // we have a proper hit
+    *data = cache->data[k];
+    *dsc = &cache->dsc[k];
+    // in case of a hit it's always good to further keep the cacheline as important
+    _touch(cache, k, TRUE);
+    return TRUE;
   }
   return FALSE;
 }
@@ -301,9 +1409,7 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
                                     const gboolean important)
 {
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
-  cache->calls++;
-  for(int k = 0; k < cache->entries; k++)
-    cache->used[k]++; // age all entries
+  cache->calls++; // ages all entries
 
   // cache keeps history and we have a cache hit, so no new buffer
   if(cache->entries > DT_PIPECACHE_MIN
@@ -318,6 +1424,13 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
           hash);
     return FALSE;
   }
+
+  if(cache->entries > DT_PIPECACHE_MIN && hash != DT_INVALID_HASH)
+    cache->misses++;
+
+  const gboolean from_disk = (hash != DT_INVALID_HASH) && _disk_available(pipe, hash, size);
+  const gboolean from_half = (hash != DT_INVALID_HASH) && _half_available(pipe, hash, size);
+
   // We need a fresh buffer as there was no hit.
   //
   // Pipes with two cache lines have pre-allocated memory, but we must
@@ -327,12 +1440,28 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
   // Check both for free and non-matching (and grow or shrink buffer).
   const int cline = _get_cacheline(pipe);
 
-  if(((cache->entries == DT_PIPECACHE_MIN) && (cache->size[cline] < size))
+  // the line is about to be reused, keep its data in the disk tier if it was important
+  // or compacted for preview pipes
+  _disk_write(pipe, cline);
+  _half_write(pipe, cline);
+  if(cline >= DT_PIPECACHE_MIN && cache->data[cline] && cache->hash[cline] != DT_INVALID_HASH)
+    cache->evictions++;
+
+  // A buffer of the same size class can be kept as is, we only have to
+  // update the size for lines being looked up.
+  const gboolean same_class = cache->data[cline]
+    && _pool_capacity(cache->size[cline]) == _pool_capacity(size);
+  if((cache->entries > DT_PIPECACHE_MIN) && (cache->size[cline] != size) && same_class)
+  {
+    cache->allmem += size - cache->size[cline];
+    cache->size[cline] = size;
+  }
+  else if(((cache->entries == DT_PIPECACHE_MIN) && (cache->size[cline] < size))
      || ((cache->entries > DT_PIPECACHE_MIN) && (cache->size[cline] != size)))
   {
-    dt_free_align(cache->data[cline]);
+    _pool_free(cache->data[cline], cache->size[cline], cache->mem_account);
     cache->allmem -= cache->size[cline];
-    cache->data[cline] = (void *)dt_alloc_aligned(size);
+    cache->data[cline] = _pool_alloc(size, cache->mem_account);
     if(cache->data[cline])
     {
       cache->size[cline] = size;
@@ -351,7 +1480,7 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
   *dsc = &cache->dsc[cline];
 
   const gboolean masking = pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE;
-  cache->hash[cline]      = masking ? DT_INVALID_HASH : hash;
+  _set_hash(cache, cline, masking ? DT_INVALID_HASH : hash);
 
   const dt_iop_buffer_dsc_t *cdsc = *dsc;
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE, "pipe cache get",
@@ -359,26 +1488,50 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
     "%s %sline%3i(%2i) at %p. hash=%" PRIx64 "%s",
      dt_iop_colorspace_to_name(cdsc->cst),
      important ? "important " : "",
-     cline, cache->used[cline], cache->data[cline], cache->hash[cline],
+     cline, (int)_age(cache, cline), cache->data[cline], cache->hash[cline],
      masking ? ". masking." : "");
 
-  cache->used[cline]      = !masking && important ? -cache->entries : 0;
+  _touch(cache, cline, !masking && important);
   cache->ioporder[cline]  = module ? module->iop_order : 0;
+  cache->important[cline] = !masking && important;
 
-  return TRUE;
-}
+  if(from_disk && cache->data[cline])
+  {
+    if(_disk_read(pipe, cline, hash))
+    {
+      cache->disk_hits++;
+      // the line has been important before so keep it like that
+      _touch(cache, cline, TRUE);
+      cache->important[cline] = TRUE;
+      dt_print_pipe(DT_DEBUG_PIPE, "cache DISK HIT",
+          pipe, module, DT_DEVICE_NONE, NULL, NULL,
+          "line%3i, hash=%" PRIx64, cline, hash);
+      return FALSE;
+    }
+    // reading has failed so the line holds no valid data
+    _mark_invalid_cacheline(cache, cline);
+  }
+  else if(from_half && cache->data[cline])
+  {
+    if(_half_read(pipe, cline, hash))
+    {
+      cache->half_hits++;
+      dt_print_pipe(DT_DEBUG_PIPE, "cache HALF HIT",
+          pipe, module, DT_DEVICE_NONE, NULL, NULL,
+          "line%3i, hash=%" PRIx64, cline, hash);
+      return FALSE;
+    }
+    _mark_invalid_cacheline(cache, cline);
+  }
 
-static void _mark_invalid_cacheline(const dt_dev_pixelpipe_cache_t *cache, const int k)
-{
-  cache->hash[k] = DT_INVALID_HASH;
-  cache->ioporder[k] = 0;
+  return TRUE;
 }
 
 void dt_dev_pixelpipe_cache_invalidate_later(dt_dev_pixelpipe_t *pipe,
                                              const int32_t order,
                                              const char *info)
 {
-  const dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
   int invalidated = 0;
   for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
   {
@@ -388,17 +1541,21 @@ void dt_dev_pixelpipe_cache_invalidate_later(dt_dev_pixelpipe_t *pipe,
       invalidated++;
     }
   }
+  invalidated += _half_invalidate_later(cache, order);
 
   const gboolean bcache = pipe->bcache_data != NULL && pipe->bcache_hash != DT_INVALID_HASH;
   pipe->bcache_hash = DT_INVALID_HASH;
 
-  if(invalidated || bcache)
+  // data on disk might be just as outdated as the hash doesn't always reflect the reason
+  const int disk_invalidated = _disk_invalidate_later(pipe, order);
+
+  if(invalidated || bcache || disk_invalidated)
     dt_print_pipe(DT_DEBUG_PIPE,
     order ? "pipecache invalidate" : "pipecache flush",
     pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
-    "%s%i cachelines after ioporder=%i%s",
+    "%s%i cachelines after ioporder=%i%s, %i disk files",
     info ? info : "",
-    invalidated, order, bcache ? ", blend cache" : "");
+    invalidated, order, bcache ? ", blend cache" : "", disk_invalidated);
 }
 
 void dt_dev_pixelpipe_cache_flush(dt_dev_pixelpipe_t *pipe)
@@ -406,17 +1563,20 @@ void dt_dev_pixelpipe_cache_flush(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cache_invalidate_later(pipe, 0, "flush: ");
 }
 
-void dt_dev_pixelpipe_important_cacheline(const dt_dev_pixelpipe_t *pipe,
+void dt_dev_pixelpipe_important_cacheline(dt_dev_pixelpipe_t *pipe,
                                           const void *data,
                                           const size_t size)
 {
-  const dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
   for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
   {
     if((cache->data[k] == data)
         && (size == cache->size[k])
         && (cache->hash[k] != DT_INVALID_HASH))
-      cache->used[k] = -cache->entries;
+    {
+      _touch(cache, k, TRUE);
+      cache->important[k] = TRUE;
+    }
   }
 }
 
@@ -434,7 +1594,7 @@ static size_t _free_cacheline(dt_dev_pixelpipe_cache_t *cache, const int k)
 {
   const size_t removed = cache->size[k];
 
-  dt_free_align(cache->data[k]);
+  _pool_free(cache->data[k], removed, cache->mem_account);
   cache->allmem -= removed;
   cache->size[k] = 0;
   cache->data[k] = NULL;
@@ -449,7 +1609,7 @@ static void _cline_stats(dt_dev_pixelpipe_cache_t *cache)
   {
     if(cache->data[k]) cache->lused++;
     if(cache->data[k] && (cache->hash[k] == DT_INVALID_HASH)) cache->linvalid++;
-    if(cache->used[k] < 0) cache->limportant++;
+    if(_age(cache, k) < 0) cache->limportant++;
   }
 }
 
@@ -470,11 +1630,16 @@ void dt_dev_pixelpipe_cache_checkmem(dt_dev_pixelpipe_t *pipe)
       freed_invalid += _free_cacheline(cache, k);
   }
 
-  while(cache->memlimit && (cache->memlimit < cache->allmem))
+  // the limit is lowered while the system is short of memory
+  const size_t memlimit = cache->memlimit * dt_memory_budget_scale();
+  while(memlimit && (memlimit < cache->allmem))
   {
     const int k = _get_oldest_cacheline(cache, DT_CACHETEST_USED);
     if(k == 0) break;
 
+    _disk_write(pipe, k);
+    _half_write(pipe, k);
+    if(cache->hash[k] != DT_INVALID_HASH) cache->evictions++;
     freed += _free_cacheline(cache, k);
   }
 
@@ -482,7 +1647,7 @@ void dt_dev_pixelpipe_cache_checkmem(dt_dev_pixelpipe_t *pipe)
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MEMORY, "pipe cache check", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
     "%i lines (important=%i, used=%i). Freed: invalid %iMB used %iMB. Using %iMB, limit=%iMB",
     cache->entries, cache->limportant, cache->lused,
-    _to_mb(freed_invalid), _to_mb(freed), _to_mb(cache->allmem), _to_mb(cache->memlimit));
+    _to_mb(freed_invalid), _to_mb(freed), _to_mb(cache->allmem), _to_mb(memlimit));
 }
 
 void dt_dev_pixelpipe_cache_report(dt_dev_pixelpipe_t *pipe)
@@ -491,11 +1656,15 @@ void dt_dev_pixelpipe_cache_report(dt_dev_pixelpipe_t *pipe)
 
   _cline_stats(cache);
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MEMORY, "cache report", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
-    "%i lines (important=%i, used=%i, invalid=%i). Using %iMB, limit=%iMB. Hits/run=%.2f. Hits/test=%.3f",
+    "%i lines (important=%i, used=%i, invalid=%i). Using %iMB, limit=%iMB. Hits/run=%.2f. Hits/test=%.3f. Misses=%" PRIu64 ", evictions=%" PRIu64 ". Disk hits=%" PRIu64 ", writes=%" PRIu64 ". Half %iMB, hits=%" PRIu64 ", writes=%" PRIu64 ". Peer hits=%" PRIu64,
     cache->entries, cache->limportant, cache->lused, cache->linvalid,
     _to_mb(cache->allmem), _to_mb(cache->memlimit),
     (double)(cache->hits) / fmax(1.0, pipe->runs),
-    (double)(cache->hits) / fmax(1.0, cache->tests));
+    (double)(cache->hits) / fmax(1.0, cache->tests),
+    cache->misses, cache->evictions,
+    cache->disk_hits, cache->disk_writes,
+    _to_mb(cache->half_mem), cache->half_hits, cache->half_writes,
+    cache->peer_hits);
 }
 
 // clang-format off
@@ -29,6 +29,15 @@ struct dt_iop_roi_t;
  * corresponding to history items and zoom/pan settings in the develop module.
  * correctness is secured via the hash so make sure everything is included here.
  * No caching if cl_mem, instead copied cache buffers are used.
+ *
+ * All per-line data is kept as one struct-of-arrays block. Lines are found via
+ * an open-addressing index on the hash, the age of a line is defined by the
+ * number of calls since its stamp, important lines get a stamp in the future.
+ * Each line is in one of two LRU lists (plain and important) both ordered by
+ * stamp so the oldest line is found from the list heads.
+ *
+ * Preview pipes can keep evicted lines in half precision, those are expanded
+ * back into a line if requested again.
  */
 typedef struct dt_dev_pixelpipe_cache_t
 {
@@ -39,16 +48,47 @@ typedef struct dt_dev_pixelpipe_cache_t
   size_t *size;
   struct dt_iop_buffer_dsc_t *dsc;
   dt_hash_t *hash;
-  int32_t *used;
+  int64_t *stamp;
   int32_t *ioporder;
+  gboolean *important;
+  // LRU lists, index 0 for plain, 1 for important lines
+  int32_t *lru_prev;
+  int32_t *lru_next;
+  int32_t *lru_list;
+  int32_t lru_head[2];
+  int32_t lru_tail[2];
+  // open-addressing index hash -> line, -1 for free slots
+  int32_t *index;
+  uint32_t index_mask;
   uint64_t calls;
   int32_t lastline;
   // profiling & stats:
   uint64_t tests;
   uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
   uint32_t lused;
   uint32_t linvalid;
   uint32_t limportant;
+  uint64_t disk_hits;
+  uint64_t disk_writes;
+  // evicted lines kept in half precision, oldest first
+  gboolean half_enabled;
+  GQueue half;
+  size_t half_mem;
+  uint64_t half_hits;
+  uint64_t half_writes;
+  // lines copied from another pipe
+  uint64_t peer_hits;
+  // prefix hashes of the pipe nodes, [0] without and [1] with the roi dependent parts.
+  // chain[v][k] covers the nodes before position k and is valid for k <= chain_valid[v],
+  // node[v][k] is what node k added to it.
+  int32_t chain_size;
+  int32_t chain_valid[2];
+  dt_hash_t *chain[2];
+  dt_hash_t *node[2];
+  // dt_mem_account_t the buffers of the pipe are counted in
+  int mem_account;
 } dt_dev_pixelpipe_cache_t;
 
 typedef enum dt_dev_pixelpipe_cache_test_t
@@ -77,7 +117,18 @@ dt_hash_t dt_dev_pixelpipe_cache_hash(const struct dt_iop_roi_t *roi,
 gboolean dt_dev_pixelpipe_cache_get(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash,
                                const size_t size, void **data, struct dt_iop_buffer_dsc_t **dsc, const struct dt_iop_module_t *module, const gboolean important);
 
-/** test availability of a cache line without destroying another, if it is not found. */
+/** copies the line the peer pipe has computed for the same pieces and roi into a new
+    line of pipe for hash. Only done if the peer is idle, returns TRUE if the data was copied.
+*/
+gboolean dt_dev_pixelpipe_cache_get_from(struct dt_dev_pixelpipe_t *pipe, struct dt_dev_pixelpipe_t *peer,
+                                         const struct dt_iop_roi_t *roi, const int position,
+                                         const dt_hash_t hash, const size_t size, void **data,
+                                         struct dt_iop_buffer_dsc_t **dsc, const struct dt_iop_module_t *module);
+
+/** test availability of a cache line without destroying another, if it is not found.
+    Lines only available in the disk or half precision tier are reported too, they are loaded by the next
+    dt_dev_pixelpipe_cache_get() for that hash.
+*/
 gboolean dt_dev_pixelpipe_cache_available(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash, const size_t size);
 
 /** invalidates all cachelines. */
@@ -87,11 +138,27 @@ void dt_dev_pixelpipe_cache_flush(struct dt_dev_pixelpipe_t *pipe);
 void dt_dev_pixelpipe_cache_invalidate_later(struct dt_dev_pixelpipe_t *pipe, const int32_t order, const char *info);
 
 /** makes this buffer very important after it has been pulled from the cache. */
-void dt_dev_pixelpipe_important_cacheline(const struct dt_dev_pixelpipe_t *pipe, const void *data, const size_t size);
+void dt_dev_pixelpipe_important_cacheline(struct dt_dev_pixelpipe_t *pipe, const void *data, const size_t size);
 
 /** mark the given cache line as invalid or to be ignored */
 void dt_dev_pixelpipe_invalidate_cacheline(const struct dt_dev_pixelpipe_t *pipe, const void *data);
 
+/** sets up and tears down the state shared by all pipes:
+  - the pool recycling cacheline buffers, the memory kept idle is bounded
+    by the memory limit of the full pipe cache.
+  - the optional on-disk tier. Important cachelines are written to
+    <cachedir>/pixelpipe/<library hash> when evicted, the directory is capped to the size in MB given by conf key
+    'pipecache_disk_size', a size of 0 disables the disk tier.
+*/
+void dt_dev_pixelpipe_cache_global_init(void);
+void dt_dev_pixelpipe_cache_global_cleanup(void);
+// bytes of cacheline buffers in use by all pipes, optionally the idle pooled ones
+size_t dt_dev_pixelpipe_cache_global_usage(size_t *idle);
+// give the idle pooled buffers back to the system, returns the bytes freed
+size_t dt_dev_pixelpipe_cache_global_trim(void);
+// drop all files of the image from the on-disk tier
+void dt_dev_pixelpipe_cache_disk_remove_image(const dt_imgid_t imgid);
+
 /** print out cache lines/hashes and do a cache cleanup */
 void dt_dev_pixelpipe_cache_report(struct dt_dev_pixelpipe_t *pipe);
 void dt_dev_pixelpipe_cache_checkmem(struct dt_dev_pixelpipe_t *pipe);
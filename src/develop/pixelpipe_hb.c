@@ -22,6 +22,8 @@
 #include "common/opencl.h"
 #include "common/iop_order.h"
 #include "common/imagebuf.h"
+#include "common/numa.h"
+#include "common/trace.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
@@ -47,8 +49,20 @@
 #define DT_DEV_AVERAGE_DELAY_START 250
 #define DT_DEV_PREVIEW_AVERAGE_DELAY_START 50
 
+// external cancel request for the pipes processed in this thread
+static __thread dt_atomic_int *_thread_cancel = NULL;
+
+void dt_dev_pixelpipe_set_thread_cancel(dt_atomic_int *flag)
+{
+  _thread_cancel = flag;
+}
+
 static inline gboolean _pipe_has_shutdown(dt_dev_pixelpipe_t *pipe)
 {
+  if(_thread_cancel
+     && dt_atomic_get_int(_thread_cancel)
+     && dt_atomic_get_int(&pipe->shutdown) == DT_DEV_PIXELPIPE_STOP_NO)
+    dt_dev_pixelpipe_set_shutdown(pipe, DT_DEV_PIXELPIPE_STOP_NODES);
   return dt_atomic_get_int(&pipe->shutdown) != DT_DEV_PIXELPIPE_STOP_NO;
 }
 
@@ -62,6 +76,7 @@ static inline gboolean _is_debug_pipe(dt_dev_pixelpipe_t *pipe)
 // forward declarations for mask cache helpers
 static void _clear_piece_mask_caches(dt_dev_pixelpipe_iop_t *piece);
 static void _free_distort_bufs(dt_dev_pixelpipe_t *pipe);
+static void _bcache_clear(dt_dev_pixelpipe_t *pipe);
 
 typedef enum dt_pixelpipe_flow_t
 {
@@ -209,6 +224,20 @@ gboolean dt_dev_pixelpipe_init_export(dt_dev_pixelpipe_t *pipe,
   return res;
 }
 
+gboolean dt_dev_pixelpipe_init_export_shared(dt_dev_pixelpipe_t *pipe,
+                                             const int levels,
+                                             const gboolean store_masks)
+{
+  // lines are allocated on demand, one more than the two of a plain
+  // export pipe keeps the input of finalscale while the tail is processed
+  const gboolean res =
+    dt_dev_pixelpipe_init_cached(pipe, 0, DT_PIPECACHE_MIN + 3, 0);
+  pipe->type = DT_DEV_PIXELPIPE_EXPORT;
+  pipe->levels = levels;
+  pipe->store_all_raster_masks = store_masks;
+  return res;
+}
+
 gboolean dt_dev_pixelpipe_init_thumbnail(dt_dev_pixelpipe_t *pipe,
                                          const int32_t width,
                                          const int32_t height)
@@ -272,10 +301,14 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
   pipe->processed_width = pipe->backbuf_width = pipe->iwidth = pipe->final_width = 0;
   pipe->processed_height = pipe->backbuf_height = pipe->iheight = pipe->final_height = 0;
   pipe->nodes = NULL;
+  pipe->node_index = NULL;
+  pipe->keep_input_of = NULL;
   pipe->backbuf_size = size;
   pipe->cache_obsolete = FALSE;
   pipe->backbuf = NULL;
   pipe->backbuf_scale = 0.0f;
+  pipe->progressive = pipe->backbuf_progressive = 0;
+  pipe->backbuf_roi = pipe->region = pipe->tiled_region = (dt_iop_roi_t){ 0 };
   memset(pipe->backbuf_zoom_pos, 0, sizeof(dt_dev_zoom_pos_t));
   pipe->output_imgid = NO_IMGID;
 
@@ -305,10 +338,13 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
   pipe->output_profile_info = NULL;
   pipe->export_profile_info = NULL;
   pipe->runs = 0;
-  pipe->bcache_data = NULL;
-  pipe->bcache_hash = DT_INVALID_HASH;
+  memset(pipe->bcache, 0, sizeof(pipe->bcache));
+  pipe->bcache_used = 0;
   memset(pipe->mask_distort_buf, 0, sizeof(pipe->mask_distort_buf));
   memset(pipe->mask_distort_buf_size, 0, sizeof(pipe->mask_distort_buf_size));
+  memset(pipe->distort_memo, 0, sizeof(pipe->distort_memo));
+  pipe->distort_memo_next = 0;
+  memset(&pipe->scratch, 0, sizeof(pipe->scratch));
   return dt_dev_pixelpipe_cache_init(pipe, entries, size, memlimit);
 }
 
@@ -391,8 +427,10 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cleanup_nodes(pipe);
   // so now it's safe to clean up cache:
   dt_dev_pixelpipe_cache_cleanup(pipe);
-  dt_free_align(pipe->bcache_data);
+  _bcache_clear(pipe);
   _free_distort_bufs(pipe);
+  dt_dev_distort_memo_cleanup(pipe);
+  dt_dev_pixelpipe_scratch_cleanup(pipe);
 
   pipe->icc_type = DT_COLORSPACE_NONE;
   g_free(pipe->icc_filename);
@@ -417,6 +455,44 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_pthread_mutex_destroy(&pipe->mutex);
 }
 
+static void _free_piece(dt_dev_pixelpipe_t *pipe,
+                        dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->module->cleanup_pipe(piece->module, pipe, piece);
+  free(piece->blendop_data);
+  piece->blendop_data = NULL;
+  dt_free_align(piece->histogram);
+  piece->histogram = NULL;
+  g_hash_table_destroy(piece->raster_masks);
+  piece->raster_masks = NULL;
+  _clear_piece_mask_caches(piece);
+  free(piece);
+}
+
+// set up the state of a fresh piece, data is taken care of by the caller
+static void _init_piece(dt_dev_pixelpipe_t *pipe,
+                        dt_dev_pixelpipe_iop_t *piece,
+                        dt_iop_module_t *module)
+{
+  piece->enabled = module->enabled;
+  piece->request_histogram = DT_REQUEST_ONLY_IN_GUI;
+  piece->histogram_params.roi = NULL;
+  piece->histogram_params.bins_count = 256;
+  piece->histogram_stats.bins_count = 0;
+  piece->histogram_stats.pixels = 0;
+  piece->colors = module->default_colorspace(module, pipe, NULL) == IOP_CS_RAW ? 1 : 4;
+  piece->iscale = pipe->iscale;
+  piece->iwidth = pipe->iwidth;
+  piece->iheight = pipe->iheight;
+  piece->module = module;
+  piece->pipe = pipe;
+  piece->hash = DT_INVALID_HASH;
+  piece->process_cl_ready = FALSE;
+  piece->process_tiling_ready = FALSE;
+  memset(&piece->processed_roi_in, 0, sizeof(piece->processed_roi_in));
+  memset(&piece->processed_roi_out, 0, sizeof(piece->processed_roi_out));
+}
+
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
 {
   // tell pipe that it should shut itself down if currently running
@@ -429,21 +505,12 @@ void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
 
   // destroy all nodes
   for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
-  {
-    dt_dev_pixelpipe_iop_t *piece = nodes->data;
-    // printf("cleanup module `%s'\n", piece->module->name());
-    piece->module->cleanup_pipe(piece->module, pipe, piece);
-    free(piece->blendop_data);
-    piece->blendop_data = NULL;
-    dt_free_align(piece->histogram);
-    piece->histogram = NULL;
-    g_hash_table_destroy(piece->raster_masks);
-    piece->raster_masks = NULL;
-    _clear_piece_mask_caches(piece);
-    free(piece);
-  }
+    _free_piece(pipe, nodes->data);
   g_list_free(pipe->nodes);
   pipe->nodes = NULL;
+  if(pipe->node_index) g_hash_table_destroy(pipe->node_index);
+  pipe->node_index = NULL;
+  pipe->keep_input_of = NULL;
 
   dt_dev_clear_scharr_mask(pipe);
   pipe->want_detail_mask = FALSE;
@@ -487,151 +554,211 @@ void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe,
   pipe->iop_order_list = dt_ioppr_iop_order_copy_deep(dev->iop_order_list);
   // for all modules in dev:
   pipe->iop = g_list_copy(dev->iop);
+  pipe->node_index = g_hash_table_new(g_direct_hash, g_direct_equal);
 
   for(GList *modules = pipe->iop; modules; modules = g_list_next(modules))
   {
     dt_iop_module_t *module = modules->data;
     dt_dev_pixelpipe_iop_t *piece = calloc(1, sizeof(dt_dev_pixelpipe_iop_t));
-    piece->enabled = module->enabled;
-    piece->request_histogram = DT_REQUEST_ONLY_IN_GUI;
-    piece->histogram_params.roi = NULL;
-    piece->histogram_params.bins_count = 256;
-    piece->histogram_stats.bins_count = 0;
-    piece->histogram_stats.pixels = 0;
-    piece->colors = module->default_colorspace(module, pipe, NULL) == IOP_CS_RAW ? 1 : 4;
-    piece->iscale = pipe->iscale;
-    piece->iwidth = pipe->iwidth;
-    piece->iheight = pipe->iheight;
-    piece->module = module;
-    piece->pipe = pipe;
-    piece->data = NULL;
-    piece->hash = DT_INVALID_HASH;
-    piece->process_cl_ready = FALSE;
-    piece->process_tiling_ready = FALSE;
+    _init_piece(pipe, piece, module);
     piece->raster_masks = g_hash_table_new_full(g_direct_hash,
                                                 g_direct_equal, NULL, dt_free_align_ptr);
-    memset(&piece->processed_roi_in, 0, sizeof(piece->processed_roi_in));
-    memset(&piece->processed_roi_out, 0, sizeof(piece->processed_roi_out));
     dt_iop_init_pipe(piece->module, pipe, piece);
-    pipe->nodes = g_list_append(pipe->nodes, piece);
+    pipe->nodes = g_list_prepend(pipe->nodes, piece);
+    g_hash_table_insert(pipe->node_index, module, piece);
+  }
+  pipe->nodes = g_list_reverse(pipe->nodes);
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+}
+
+void dt_dev_pixelpipe_update_nodes(dt_dev_pixelpipe_t *pipe,
+                                   dt_develop_t *dev)
+{
+  dt_dev_pixelpipe_set_shutdown(pipe, DT_DEV_PIXELPIPE_STOP_NODES);
+  dt_pthread_mutex_lock(&pipe->busy_mutex); // block until the pipe has shut down
+  dt_atomic_set_int(&pipe->shutdown, DT_DEV_PIXELPIPE_STOP_NO);
+
+  GHashTable *old_index = pipe->node_index;
+  GList *old_nodes = pipe->nodes;
+  int kept = 0, created = 0, dropped = 0;
+
+  g_list_free(pipe->iop);
+  pipe->iop = g_list_copy(dev->iop);
+  g_list_free_full(pipe->iop_order_list, free);
+  pipe->iop_order_list = dt_ioppr_iop_order_copy_deep(dev->iop_order_list);
+  pipe->node_index = g_hash_table_new(g_direct_hash, g_direct_equal);
+  pipe->nodes = NULL;
+
+  for(GList *modules = pipe->iop; modules; modules = g_list_next(modules))
+  {
+    dt_iop_module_t *module = modules->data;
+    dt_dev_pixelpipe_iop_t *piece = old_index ? g_hash_table_lookup(old_index, module) : NULL;
+    if(piece)
+    {
+      // the module data stays, the params are committed again by the next synch
+      g_hash_table_remove(old_index, module);
+      void *data = piece->data;
+      void *blendop_data = piece->blendop_data;
+      GHashTable *raster_masks = piece->raster_masks;
+      dt_free_align(piece->histogram);
+      _clear_piece_mask_caches(piece);
+      g_hash_table_remove_all(raster_masks);
+      memset(piece, 0, sizeof(dt_dev_pixelpipe_iop_t));
+      _init_piece(pipe, piece, module);
+      piece->data = data;
+      piece->blendop_data = blendop_data;
+      piece->raster_masks = raster_masks;
+      kept++;
+    }
+    else
+    {
+      piece = calloc(1, sizeof(dt_dev_pixelpipe_iop_t));
+      _init_piece(pipe, piece, module);
+      piece->raster_masks = g_hash_table_new_full(g_direct_hash,
+                                                  g_direct_equal, NULL, dt_free_align_ptr);
+      dt_iop_init_pipe(piece->module, pipe, piece);
+      created++;
+    }
+    pipe->nodes = g_list_prepend(pipe->nodes, piece);
+    g_hash_table_insert(pipe->node_index, module, piece);
+  }
+  pipe->nodes = g_list_reverse(pipe->nodes);
+
+  // the pieces of modules no longer in the pipe are still in the old index
+  for(GList *nodes = old_nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    if(g_hash_table_lookup(old_index, piece->module) == piece)
+    {
+      _free_piece(pipe, piece);
+      dropped++;
+    }
   }
+  g_list_free(old_nodes);
+  if(old_index) g_hash_table_destroy(old_index);
+  pipe->keep_input_of = NULL;
+
+  dt_dev_clear_scharr_mask(pipe);
+  pipe->want_detail_mask = FALSE;
+
+  dt_print_pipe(DT_DEBUG_PIPE, "update nodes",
+                pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+                "%d kept, %d created, %d dropped", kept, created, dropped);
   dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
+dt_dev_pixelpipe_iop_t *dt_dev_pixelpipe_get_piece(const dt_dev_pixelpipe_t *pipe,
+                                                   const dt_iop_module_t *module)
+{
+  return pipe->node_index ? g_hash_table_lookup(pipe->node_index, module) : NULL;
+}
+
 // helper
 static void _dev_pixelpipe_synch(dt_dev_pixelpipe_t *pipe,
                                  dt_develop_t *dev,
                                  GList *history)
 {
   dt_dev_history_item_t *hist = history->data;
-  // find piece in nodes list
-  dt_dev_pixelpipe_iop_t *piece = NULL;
+  dt_dev_pixelpipe_iop_t *piece = dt_dev_pixelpipe_get_piece(pipe, hist->module);
+  if(!piece) return;
 
   const dt_image_t *img      = &pipe->image;
   const dt_imgid_t imgid     = img->id;
   const gboolean rawprep_img = dt_image_is_rawprepare_supported(img);
 
-  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  const gboolean active = hist->enabled;
+  piece->enabled = active;
+
+  // the last crop module in the pixelpipe might handle the exposing if enabled
+  if(piece->module->flags() & IOP_FLAGS_CROP_EXPOSER)
+    dev->cropping.exposer = active ? piece->module : NULL;
+
+  // Styles, presets or history copy&paste might set history items
+  // not appropriate for the image.  Fixing that seemed to be
+  // almost impossible after long discussions but at least we can
+  // test, correct and add a problem hint here.
+  if(dt_iop_module_is(piece->module, "demosaic")
+     || dt_iop_module_is(piece->module, "rawprepare"))
   {
-    piece = nodes->data;
+    if(rawprep_img && !active)
+      piece->enabled = TRUE;
+    else if(!rawprep_img && active)
+      piece->enabled = FALSE;
+  }
+  else if((dt_iop_module_is(piece->module, "rawdenoise"))
+          || (dt_iop_module_is(piece->module, "hotpixels"))
+          || (dt_iop_module_is(piece->module, "cacorrect")))
+  {
+    if(!rawprep_img && active) piece->enabled = FALSE;
+  }
 
-    if(piece->module == hist->module)
-    {
-      const gboolean active = hist->enabled;
-      piece->enabled = active;
-
-      // the last crop module in the pixelpipe might handle the exposing if enabled
-      if(piece->module->flags() & IOP_FLAGS_CROP_EXPOSER)
-        dev->cropping.exposer = active ? piece->module : NULL;
-
-      // Styles, presets or history copy&paste might set history items
-      // not appropriate for the image.  Fixing that seemed to be
-      // almost impossible after long discussions but at least we can
-      // test, correct and add a problem hint here.
-      if(dt_iop_module_is(piece->module, "demosaic")
-         || dt_iop_module_is(piece->module, "rawprepare"))
-      {
-        if(rawprep_img && !active)
-          piece->enabled = TRUE;
-        else if(!rawprep_img && active)
-          piece->enabled = FALSE;
-      }
-      else if((dt_iop_module_is(piece->module, "rawdenoise"))
-              || (dt_iop_module_is(piece->module, "hotpixels"))
-              || (dt_iop_module_is(piece->module, "cacorrect")))
-      {
-        if(!rawprep_img && active) piece->enabled = FALSE;
-      }
+  if(piece->enabled != hist->enabled)
+  {
+    if(piece->enabled)
+      dt_iop_set_module_trouble_message
+        (piece->module,
+         _("enabled as required"),
+         _("history had module disabled but it is required for"
+           " this type of image.\nlikely introduced by applying a preset,"
+           " style or history copy&paste"),
+         NULL);
+    else
+      dt_iop_set_module_trouble_message
+        (piece->module,
+         _("disabled as not appropriate"),
+         _("history had module enabled but it is not allowed for this type"
+           " of image.\nlikely introduced by applying a preset, style or"
+           " history copy&paste"),
+         NULL);
+
+    dt_print_pipe(DT_DEBUG_PIPE, "pipe synch problem",
+      pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
+      "piece enabling mismatch for image %i, piece hash=%" PRIx64,
+      imgid, piece->hash);
+  }
 
-      if(piece->enabled != hist->enabled)
-      {
-        if(piece->enabled)
-          dt_iop_set_module_trouble_message
-            (piece->module,
-             _("enabled as required"),
-             _("history had module disabled but it is required for"
-               " this type of image.\nlikely introduced by applying a preset,"
-               " style or history copy&paste"),
-             NULL);
-        else
-          dt_iop_set_module_trouble_message
-            (piece->module,
-             _("disabled as not appropriate"),
-             _("history had module enabled but it is not allowed for this type"
-               " of image.\nlikely introduced by applying a preset, style or"
-               " history copy&paste"),
-             NULL);
-
-        dt_print_pipe(DT_DEBUG_PIPE, "pipe synch problem",
-          pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
-          "piece enabling mismatch for image %i, piece hash=%" PRIx64,
-          imgid, piece->hash);
-      }
+  if(active && hist->iop_order == INT_MAX)
+  {
+    piece->enabled = FALSE;
+    dt_print_pipe(DT_DEBUG_PARAMS | DT_DEBUG_PIPE,
+                  "dt_dev_pixelpipe_synch",
+                  pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
+                  "enabled module with iop_order of INT_MAX is disabled");
+  }
 
-      if(active && hist->iop_order == INT_MAX)
+  // disable pieces if included in list
+  if(piece->enabled && dev->module_filter_out)
+  {
+    for(GList *m = dev->module_filter_out; m; m = g_list_next(m))
+    {
+      char *mod = (char *)(m->data);
+      if(dt_iop_module_is(piece->module, mod))
       {
         piece->enabled = FALSE;
         dt_print_pipe(DT_DEBUG_PARAMS | DT_DEBUG_PIPE,
                       "dt_dev_pixelpipe_synch",
                       pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
-                      "enabled module with iop_order of INT_MAX is disabled");
-      }
-
-      // disable pieces if included in list
-      if(piece->enabled && dev->module_filter_out)
-      {
-        for(GList *m = dev->module_filter_out; m; m = g_list_next(m))
-        {
-          char *mod = (char *)(m->data);
-          if(dt_iop_module_is(piece->module, mod))
-          {
-            piece->enabled = FALSE;
-            dt_print_pipe(DT_DEBUG_PARAMS | DT_DEBUG_PIPE,
-                          "dt_dev_pixelpipe_synch",
-                          pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
-                          "module is disabled because it's included in module_filter_out");
-          }
-        }
+                      "module is disabled because it's included in module_filter_out");
       }
+    }
+  }
 
-      dt_iop_commit_params(hist->module, hist->params, hist->blend_params, pipe, piece);
+  dt_iop_commit_params(hist->module, hist->params, hist->blend_params, pipe, piece);
 
-      dt_print_pipe(DT_DEBUG_PARAMS,
-                    "committed",
-                    pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
-                    "%s piece hash=%" PRIx64,
-                    piece->enabled ? "enabled " : "disabled",
-                    piece->hash);
+  dt_print_pipe(DT_DEBUG_PARAMS,
+                "committed",
+                pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
+                "%s piece hash=%" PRIx64,
+                piece->enabled ? "enabled " : "disabled",
+                piece->hash);
 
-      if(piece->enabled && piece->blendop_data)
-      {
-        const dt_develop_blend_params_t *const bp = piece->blendop_data;
-        const gboolean valid_mask = bp->mask_mode > DEVELOP_MASK_ENABLED;
+  if(piece->enabled && piece->blendop_data)
+  {
+    const dt_develop_blend_params_t *const bp = piece->blendop_data;
+    const gboolean valid_mask = bp->mask_mode > DEVELOP_MASK_ENABLED;
 
-        if(!feqf(bp->details, 0.0f, 1e-6) && valid_mask)
-          dt_dev_pixelpipe_usedetails(piece);
-      }
-    }
+    if(!feqf(bp->details, 0.0f, 1e-6) && valid_mask)
+      dt_dev_pixelpipe_usedetails(piece);
   }
 }
 
@@ -732,14 +859,29 @@ void dt_dev_pixelpipe_synch_all(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
      We might call dt_dev_pixelpipe_usedetails() with want_detail_mask == FALSE
      here resulting in a pipecache invalidation.
      Can this somehow be avoided?
+
+     The last item of a module up to history_end overrides all earlier ones,
+     so only that one is committed, still in history order.
   */
+  GHashTable *last = g_hash_table_new(g_direct_hash, g_direct_equal);
   GList *history = dev->history;
   for(int k = 0; k < dev->history_end && history; k++)
   {
-    _dev_pixelpipe_synch(pipe, dev, history);
+    const dt_dev_history_item_t *hist = history->data;
+    g_hash_table_insert(last, hist->module, history);
     history = g_list_next(history);
   }
 
+  history = dev->history;
+  for(int k = 0; k < dev->history_end && history; k++)
+  {
+    const dt_dev_history_item_t *hist = history->data;
+    if(g_hash_table_lookup(last, hist->module) == history)
+      _dev_pixelpipe_synch(pipe, dev, history);
+    history = g_list_next(history);
+  }
+  g_hash_table_destroy(last);
+
   // history has been (re)applied, so real raster consumers have re-registered;
   // drop any phantom users left behind by deleted or de-synced consumers
   for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
@@ -810,9 +952,8 @@ void dt_dev_pixelpipe_change(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
     if(pipe->changed & DT_DEV_PIPE_REMOVE)
     {
       // modules have been added in between or removed. need to
-      // rebuild the whole pipeline.
-      dt_dev_pixelpipe_cleanup_nodes(pipe);
-      dt_dev_pixelpipe_create_nodes(pipe, dev);
+      // rebuild the pipeline, the pieces of the remaining modules are kept.
+      dt_dev_pixelpipe_update_nodes(pipe, dev);
       dt_dev_pixelpipe_synch_all(pipe, dev);
     }
   }
@@ -1163,7 +1304,8 @@ static void _pixelpipe_pick_samples(dt_develop_t *dev,
                                     dt_iop_module_t *module,
                                     const dt_iop_buffer_dsc_t *dsc,
                                     const float *const input,
-                                    const dt_iop_roi_t *roi_in)
+                                    const dt_iop_roi_t *roi_in,
+                                    const dt_hash_t input_hash)
 {
   const dt_iop_order_iccprofile_info_t *const histogram_profile =
     dt_ioppr_get_histogram_profile_info(dev);
@@ -1184,40 +1326,83 @@ static void _pixelpipe_pick_samples(dt_develop_t *dev,
     samples = &primary;
   }
 
-  while(samples)
+  // the statistics only change with the picked pixels and the profiles,
+  // samples picked from the same input with the same box are kept.
+  const void *profiles[2] = { display_profile, histogram_profile };
+  const dt_hash_t pipe_hash = dt_hash(input_hash, profiles, sizeof(profiles));
+
+  GPtrArray *picked = g_ptr_array_new();
+  for(; samples; samples = g_slist_next(samples))
   {
     int box[4];
     dt_colorpicker_sample_t *sample = samples->data;
-    if(!sample->locked &&
-       !dt_color_picker_box(module, roi_in, sample, PIXELPIPE_PICKER_INPUT, box))
+    if(sample->locked
+       || dt_color_picker_box(module, roi_in, sample, PIXELPIPE_PICKER_INPUT, box))
+      continue;
+
+    dt_hash_t hash = dt_hash(pipe_hash, box, sizeof(box));
+    hash = dt_hash(hash, &sample->denoise, sizeof(sample->denoise));
+    if(hash == sample->picked_hash)
+      continue;
+
+    // pixel input is in display profile, hence the sample output will be as well
+    dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_PICKER,
+                  "pixelpipe pick samples",
+                  NULL, module, DT_DEVICE_NONE, roi_in, NULL, " %sbox %i/%i -- %i/%i",
+                  sample->denoise ? "denoised " : "",
+                  box[0], box[1], box[2], box[3]);
+
+    dt_color_picker_helper(dsc, input, roi_in, box, sample->denoise,
+                           sample->display,
+                           IOP_CS_RGB, IOP_CS_RGB, display_profile);
+    sample->picked_hash = hash;
+    g_ptr_array_add(picked, sample);
+  }
+
+  // convert the statistics of all picked samples at once, as an image
+  // of DT_PICK_N pixels per sample
+  const int n = picked->len;
+  float *display = n ? dt_alloc_align_float((size_t)3 * 4 * DT_PICK_N * n) : NULL;
+  if(display)
+  {
+    const size_t stats_size = sizeof(lib_colorpicker_stats);
+    float *lab = display + (size_t)4 * DT_PICK_N * n;
+    float *scope = lab + (size_t)4 * DT_PICK_N * n;
+    for(int k = 0; k < n; k++)
+    {
+      dt_colorpicker_sample_t *sample = g_ptr_array_index(picked, k);
+      memcpy(display + (size_t)4 * DT_PICK_N * k, sample->display, stats_size);
+    }
+
+    // NOTE: conversions assume that dt_aligned_pixel_t[x] has no
+    // padding, e.g. is equivalent to float[x*4], and that on failure
+    // it's OK not to touch output
+    dt_iop_colorspace_type_t converted_cst;
+    dt_ioppr_transform_image_colorspace(module, display, lab, DT_PICK_N * n, 1,
+                                        IOP_CS_RGB, IOP_CS_LAB, &converted_cst,
+                                        display_profile);
+    if(display_profile && histogram_profile)
+      dt_ioppr_transform_image_colorspace_rgb(display, scope, DT_PICK_N * n, 1,
+                                              display_profile, histogram_profile,
+                                              "primary picker");
+
+    for(int k = 0; k < n; k++)
     {
-      // pixel input is in display profile, hence the sample output will be as well
-      dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_PICKER,
-                    "pixelpipe pick samples",
-                    NULL, module, DT_DEVICE_NONE, roi_in, NULL, " %sbox %i/%i -- %i/%i",
-                    darktable.lib->proxy.colorpicker.primary_sample->denoise
-                      ? "denoised "
-                      : "",
-                    box[0], box[1], box[2], box[3]);
-
-      dt_color_picker_helper(dsc, input, roi_in, box, sample->denoise,
-                             sample->display,
-                             IOP_CS_RGB, IOP_CS_RGB, display_profile);
-
-      // NOTE: conversions assume that dt_aligned_pixel_t[x] has no
-      // padding, e.g. is equivalent to float[x*4], and that on failure
-      // it's OK not to touch output
-      dt_iop_colorspace_type_t converted_cst;
-      dt_ioppr_transform_image_colorspace(module, sample->display[0], sample->lab[0], 3, 1,
-                                          IOP_CS_RGB, IOP_CS_LAB, &converted_cst,
-                                          display_profile);
+      dt_colorpicker_sample_t *sample = g_ptr_array_index(picked, k);
+      if(converted_cst == IOP_CS_LAB)
+        memcpy(sample->lab, lab + (size_t)4 * DT_PICK_N * k, stats_size);
       if(display_profile && histogram_profile)
-        dt_ioppr_transform_image_colorspace_rgb(sample->display[0], sample->scope[0], 3, 1,
-                                                display_profile, histogram_profile,
-                                                "primary picker");
+        memcpy(sample->scope, scope + (size_t)4 * DT_PICK_N * k, stats_size);
     }
-    samples = g_slist_next(samples);
+    dt_free_align(display);
   }
+  else
+  {
+    // no memory for the batch, the samples will be picked again
+    for(int k = 0; k < n; k++)
+      ((dt_colorpicker_sample_t *)g_ptr_array_index(picked, k))->picked_hash = 0;
+  }
+  g_ptr_array_free(picked, TRUE);
 }
 
 // returns TRUE if blend process need the module default colorspace
@@ -1316,24 +1501,95 @@ static inline dt_hash_t _piece_process_hash(const dt_dev_pixelpipe_iop_t *piece,
 static inline gboolean _piece_fast_blend(const dt_dev_pixelpipe_iop_t *piece,
                                          const dt_iop_module_t *module)
 {
-  return dt_pipe_is_canvas(piece->pipe)
+  // the output is kept even while blending is off, so switching on a mask
+  // or changing the opacity for the first time is fast too
+  return (dt_pipe_is_canvas(piece->pipe) || dt_pipe_is_preview(piece->pipe))
          && darktable.pipe_cache
          && dt_iop_has_focus(module)
          // IOP_FLAGS_NO_MASKS modules (retouch, spots) consume their drawn forms
          // inside process(), so the cached output depends on shape geometry that
          // the fast-blend hash ignores. Skip the fast path for them.
          && !(module->flags() & IOP_FLAGS_NO_MASKS)
-         && _transform_for_blend(module, piece);
+         && (module->flags() & IOP_FLAGS_SUPPORTS_BLENDING);
+}
+
+static inline float *_get_bcache(dt_dev_pixelpipe_t *pipe,
+                                 const dt_hash_t phash,
+                                 const size_t nfloats)
+{
+  if(phash == DT_INVALID_HASH) return NULL;
+
+  for(int k = 0; k < DT_DEV_PIXELPIPE_BCACHE_SLOTS; k++)
+  {
+    dt_dev_pixelpipe_bcache_t *slot = &pipe->bcache[k];
+    if(slot->data && slot->hash == phash && slot->nfloats == nfloats)
+    {
+      slot->used = ++pipe->bcache_used;
+      return slot->data;
+    }
+  }
+  return NULL;
 }
 
+static void _bcache_free_slot(dt_dev_pixelpipe_bcache_t *slot)
+{
+  dt_free_align(slot->data);
+  slot->data = NULL;
+  slot->nfloats = 0;
+  slot->hash = DT_INVALID_HASH;
+}
+
+static void _bcache_remove(dt_dev_pixelpipe_t *pipe,
+                           const dt_hash_t phash)
+{
+  for(int k = 0; k < DT_DEV_PIXELPIPE_BCACHE_SLOTS; k++)
+    if(pipe->bcache[k].data && pipe->bcache[k].hash == phash)
+      _bcache_free_slot(&pipe->bcache[k]);
+}
+
+static void _bcache_clear(dt_dev_pixelpipe_t *pipe)
+{
+  for(int k = 0; k < DT_DEV_PIXELPIPE_BCACHE_SLOTS; k++)
+    _bcache_free_slot(&pipe->bcache[k]);
+}
+
+// returns a new blend cache buffer for phash, evicting the least recently
+// used ones to keep within the slots and DT_DEV_PIXELPIPE_BCACHE_BYTES
 static inline float *_get_fast_blendcache(const size_t nfloats,
                                           const dt_hash_t phash,
                                           dt_dev_pixelpipe_t *pipe)
 {
-  dt_free_align(pipe->bcache_data);
-  pipe->bcache_data = phash != DT_INVALID_HASH ? dt_alloc_align_float(nfloats) : NULL;
-  pipe->bcache_hash = phash;
-  return pipe->bcache_data;
+  if(phash == DT_INVALID_HASH) return NULL;
+  _bcache_remove(pipe, phash);
+
+  while(TRUE)
+  {
+    size_t total = nfloats;
+    int free_slot = -1, oldest = -1;
+    for(int k = 0; k < DT_DEV_PIXELPIPE_BCACHE_SLOTS; k++)
+    {
+      const dt_dev_pixelpipe_bcache_t *slot = &pipe->bcache[k];
+      if(!slot->data)
+      {
+        if(free_slot < 0) free_slot = k;
+        continue;
+      }
+      total += slot->nfloats;
+      if(oldest < 0 || slot->used < pipe->bcache[oldest].used) oldest = k;
+    }
+
+    if(free_slot >= 0 && (total * sizeof(float) <= DT_DEV_PIXELPIPE_BCACHE_BYTES || oldest < 0))
+    {
+      dt_dev_pixelpipe_bcache_t *slot = &pipe->bcache[free_slot];
+      slot->data = dt_alloc_align_float(nfloats);
+      if(!slot->data) return NULL;
+      slot->nfloats = nfloats;
+      slot->hash = phash;
+      slot->used = ++pipe->bcache_used;
+      return slot->data;
+    }
+    _bcache_free_slot(&pipe->bcache[oldest]);
+  }
 }
 
 /* use _module_pipe_stop to test for the just processed module leaving a flag to shutdown the pipeline
@@ -1409,7 +1665,10 @@ static void _cpu_benchmark(dt_dev_pixelpipe_t *pipe,
   if(module->process_plain)
   {
     for(int i = 0; i < counter; i++)
+    {
       module->process_plain(module, piece, in, out, roi_in, roi_out);
+      dt_dev_pixelpipe_scratch_reset(pipe);
+    }
   }
   dt_get_times(&end);
   const float clock = (end.clock - start.clock) / (float) counter;
@@ -1525,9 +1784,14 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
   const dt_hash_t phash = want_bcache
     ? _piece_process_hash(piece, roi_out, module, position)
     : DT_INVALID_HASH;
-  const gboolean bcaching = want_bcache
-    ? pipe->bcache_data && phash == pipe->bcache_hash && phash != DT_INVALID_HASH
-    : FALSE;
+  const float *bcached = want_bcache ? _get_bcache(pipe, phash, nfloats) : NULL;
+  const gboolean bcaching = bcached != NULL;
+
+  // expect the module's temporary buffers to be what the tiling factor accounts for
+  // besides input and output. tiles grow the arena on demand.
+  pipe->scratch.want = fitting
+    ? (size_t)(MAX(0.0f, tiling->factor - 2.0f) * (m_width * m_height * m_bpp)) + tiling->overhead
+    : 0;
 
   if(!fitting && _piece_may_tile(piece))
   {
@@ -1540,11 +1804,12 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
 
     if(bcaching)
     {
-      dt_iop_image_copy(*output, pipe->bcache_data, nfloats);
+      dt_iop_image_copy(*output, bcached, nfloats);
     }
     else
     {
       module->process_tiling(module, piece, input, *output, roi_in, roi_out, in_bpp);
+      dt_dev_pixelpipe_scratch_reset(pipe);
       if(want_bcache)
       {
         if(dt_pipe_no_mask_display(pipe))
@@ -1553,7 +1818,7 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
           if(cache) dt_iop_image_copy(cache, *output, nfloats);
         }
         else
-          pipe->bcache_hash = DT_INVALID_HASH;
+          _bcache_remove(pipe, phash);
       }
     }
     *pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU
@@ -1575,7 +1840,7 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
 
     if(bcaching)
     {
-      dt_iop_image_copy(*output, pipe->bcache_data, nfloats);
+      dt_iop_image_copy(*output, bcached, nfloats);
     }
     else
     {
@@ -1583,6 +1848,7 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
         _cpu_benchmark(pipe, module, piece, input, *output, roi_out, roi_in);
 
       module->process(module, piece, input, *output, roi_in, roi_out);
+      dt_dev_pixelpipe_scratch_reset(pipe);
       if(want_bcache)
       {
         if(dt_pipe_no_mask_display(pipe))
@@ -1591,7 +1857,7 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
           if(cache) dt_iop_image_copy(cache, *output, nfloats);
         }
         else
-          pipe->bcache_hash = DT_INVALID_HASH;
+          _bcache_remove(pipe, phash);
       }
     }
 
@@ -1750,6 +2016,7 @@ static void _opencl_dump_diff_pipe_pfm(dt_dev_pixelpipe_t *pipe,
         if(err == CL_SUCCESS)
         {
           module->process(module, piece, clin, cpudata, roi_in, roi_out);
+          dt_dev_pixelpipe_scratch_reset(pipe);
           if(cst == IOP_CS_LAB)
           {
             for(size_t k = 0; k < (size_t)ow * oh * cho; k+=cho)
@@ -1778,6 +2045,15 @@ static inline gboolean _avoid_cl_module(const dt_dev_pixelpipe_iop_t *piece)
   return cldid->avoid && dt_str_commasubstring(cldid->avoid, piece->module->op);
 }
 
+static inline gboolean _piece_possible_cl(const dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_module_t *module = piece->module;
+  return module->process_cl
+      && piece->process_cl_ready
+      && !(dt_pipe_is_preview(piece->pipe) && (module->flags() & IOP_FLAGS_PREVIEW_NON_OPENCL))
+      && !_avoid_cl_module(piece);
+}
+
 #endif
 
 static inline gboolean _skip_piece_on_tags(const dt_dev_pixelpipe_iop_t *piece)
@@ -1802,6 +2078,367 @@ static inline gboolean _dev_pixelpipe_early_exit(const dt_develop_t *dev,
       || (pipe->changed != DT_DEV_PIPE_UNCHANGED && pipe->changed != DT_DEV_PIPE_ZOOMED);
 }
 
+/* The darkroom pipes processing the same input may take the output of a module from each
+   other if it has been computed for the same pieces and roi. That is the full pipe and
+   preview2 showing the same image, the preview pipe works on the downscaled mipmap.
+   Some modules visualize masks or collect data only in the full pipe, we stay before
+   the focused module and before colorout writing the display profile.
+*/
+static inline dt_dev_pixelpipe_t *_dev_pixelpipe_peer(const dt_develop_t *dev,
+                                                      const dt_dev_pixelpipe_t *pipe,
+                                                      const dt_iop_module_t *module)
+{
+  if(!module || !dt_pipe_is_screen(pipe))
+    return NULL;
+
+  const dt_iop_module_t *focus = dt_dev_gui_module();
+  if(focus && module->iop_order >= focus->iop_order)
+    return NULL;
+
+  if(module->iop_order >= dt_ioppr_get_iop_order(dev->iop_order_list, "colorout", 0))
+    return NULL;
+
+  dt_dev_pixelpipe_t *candidates[] = { dev->full.pipe, dev->preview2.pipe, dev->preview_pipe };
+  for(int k = 0; k < G_N_ELEMENTS(candidates); k++)
+  {
+    dt_dev_pixelpipe_t *peer = candidates[k];
+    if(peer && peer != pipe && peer->input && peer->input == pipe->input)
+      return peer;
+  }
+  return NULL;
+}
+
+#ifdef HAVE_OPENCL
+/* planning pass for pipes running on an OpenCL device: find the modules that need their
+   input in host memory, either because they have no usable process_cl() or because they
+   must be tiled. consecutive host modules share their buffers, so every such island
+   in between device modules costs one download and one upload. reports the islands,
+   the histograms downloaded for device modules and the expected transfer cost.
+*/
+static void _dev_pixelpipe_plan_transfers(dt_dev_pixelpipe_t *pipe)
+{
+  const int devid = pipe->devid;
+  gboolean on_host = TRUE;  // the input image starts in host memory
+  int roundtrips = 0;
+  int histograms = 0;
+  size_t bytes = 0;        // transfers caused by round-trips and histograms
+  size_t pending = 0;      // download that opened the current island
+  gchar *islands = NULL;
+  gchar *island = NULL;
+
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    if(_skip_piece_on_tags(piece)) continue;
+
+    dt_iop_module_t *module = piece->module;
+    const size_t in_bytes = (size_t)piece->buf_in.width * piece->buf_in.height
+                              * dt_iop_buffer_dsc_to_bpp(&piece->dsc_in);
+    gboolean host = !_piece_possible_cl(piece);
+    const char *reason = host ? "CPU only" : NULL;
+    if(!host)
+    {
+      dt_develop_tiling_t tiling = { 0 };
+      tiling.factor_cl = tiling.maxbuf_cl = -1.0f;
+      module->tiling_callback(module, piece, &piece->buf_in, &piece->buf_out, &tiling);
+      if(tiling.factor_cl < 0.0f) tiling.factor_cl = tiling.factor;
+      const size_t width = MAX(piece->buf_in.width, piece->buf_out.width);
+      const size_t height = MAX(piece->buf_in.height, piece->buf_out.height);
+      const uint32_t bpp = MAX(dt_iop_buffer_dsc_to_bpp(&piece->dsc_in),
+                               dt_iop_buffer_dsc_to_bpp(&piece->dsc_out));
+      if(!dt_opencl_image_fits_device(devid, width, height, bpp, tiling.factor_cl, tiling.overhead))
+      {
+        host = TRUE;
+        reason = _piece_may_tile(piece) ? "tiling" : "too large";
+      }
+    }
+
+    if(host)
+    {
+      if(!on_host)
+      {
+        pending = in_bytes;
+        island = g_strdup("");
+      }
+      if(island)
+        dt_util_str_cat(&island, "%s%s%s (%s)", *island ? ", " : "",
+                        module->op, dt_iop_get_instance_id(module), reason);
+    }
+    else
+    {
+      // histograms of device modules are collected from a downloaded copy of the input
+      if(piece->request_histogram & DT_REQUEST_ON)
+      {
+        histograms++;
+        bytes += (size_t)piece->buf_in.width * piece->buf_in.height * 4 * sizeof(float);
+      }
+      if(island)
+      {
+        // the island is surrounded by device modules
+        roundtrips++;
+        bytes += pending + in_bytes;
+        dt_util_str_cat(&islands, "%s[%s]", islands ? " " : "", island);
+        g_free(island);
+        island = NULL;
+      }
+    }
+    on_host = host;
+  }
+  g_free(island);
+
+  // the expected time is based on the measured download bandwidth of the device
+  const float rate = dt_opencl_get_transfer_rate(devid);
+  char cost[32] = "";
+  if(rate > 0.0f && bytes)
+    snprintf(cost, sizeof(cost), " ~%.3fs", (float)bytes / DT_MEGA / rate);
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_PERF, "transfer plan",
+                pipe, NULL, devid, NULL, NULL,
+                "%d host round-trips, %d histogram downloads, %.1fMB%s %s",
+                roundtrips, histograms, (float)bytes / DT_MEGA, cost, islands ? islands : "");
+  g_free(islands);
+}
+#endif
+
+// one trace event per module run or cache hit
+static void _trace_piece(const dt_dev_pixelpipe_t *pipe,
+                         const dt_iop_module_t *module,
+                         const int devid,
+                         const dt_iop_roi_t *roi,
+                         const gboolean cached,
+                         const size_t bytes,
+                         const double start)
+{
+  char scale[G_ASCII_DTOSTR_BUF_SIZE];
+  g_ascii_formatd(scale, sizeof(scale), "%.4f", roi->scale);
+  gchar *args = g_strdup_printf("\"pipe\":\"%s\",\"device\":%d,"
+                                "\"roi\":[%d,%d,%d,%d],\"scale\":%s,"
+                                "\"tiles\":%d,\"cache\":\"%s\",\"bytes\":%zu",
+                                dt_dev_pixelpipe_type_to_str(pipe->type), devid,
+                                roi->x, roi->y, roi->width, roi->height, scale,
+                                cached ? 0 : pipe->tiles, cached ? "hit" : "miss", bytes);
+  gchar *name = module
+    ? g_strdup_printf("%s%s", module->op, dt_iop_get_instance_id(module))
+    : g_strdup("input");
+  dt_trace_event(name, "pixelpipe", start, dt_get_wtime(), args);
+  g_free(name);
+  g_free(args);
+}
+
+// chains of per-pixel modules are processed in bands of about this size per thread,
+// small enough for the data to stay in the L2 caches from one module to the next
+#define DT_PIPE_FUSE_BAND_BYTES (256 * 1024)
+#define DT_PIPE_FUSE_MAX 16
+
+static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
+                                           dt_develop_t *dev,
+                                           void **output,
+                                           void **cl_mem_output,
+                                           dt_iop_buffer_dsc_t **out_format,
+                                           const dt_iop_roi_t *roi_out,
+                                           GList *modules,
+                                           GList *pieces,
+                                           const int pos);
+
+static inline gboolean _pipe_may_fuse(const dt_dev_pixelpipe_t *pipe)
+{
+  // the skipped modules have no cachelines, keep that to pipes not used for editing
+  if(!(dt_pipe_is_export(pipe) || dt_pipe_is_thumb(pipe))
+     || !dt_pipe_no_mask_display(pipe)
+     || darktable.dump_pfm_pipe)
+    return FALSE;
+#ifdef HAVE_OPENCL
+  if(_opencl_pipe_isok(pipe))
+    return FALSE;
+#endif
+  static dt_conf_handle_t *fuse_pointwise = NULL;
+  if(!fuse_pointwise)
+    fuse_pointwise = dt_conf_handle("pixelpipe_fuse_pointwise", DT_BOOL);
+  return dt_conf_handle_get_bool(fuse_pointwise);
+}
+
+static gboolean _piece_may_fuse(dt_dev_pixelpipe_t *pipe,
+                                dt_develop_t *dev,
+                                dt_dev_pixelpipe_iop_t *piece,
+                                const dt_iop_roi_t *roi)
+{
+  dt_iop_module_t *module = piece->module;
+  const dt_develop_blend_params_t *const b = piece->blendop_data;
+  if(!piece->process_pointwise
+     || !module->process
+     || (b && b->mask_mode != DEVELOP_MASK_DISABLED)
+     || (piece->request_histogram & DT_REQUEST_ON)
+     || _request_color_pick(pipe, dev, module))
+    return FALSE;
+
+  dt_iop_roi_t roi_in = *roi;
+  module->modify_roi_in(module, piece, roi, &roi_in);
+  return !memcmp(&roi_in, roi, sizeof(dt_iop_roi_t));
+}
+
+/* find the per-pixel modules ending with the one in modules/pieces. returns their
+   number, the pieces in chain[] in processing order and where to continue upstream.
+   a chain is only useful if there are at least two modules.
+*/
+static int _pointwise_chain(dt_dev_pixelpipe_t *pipe,
+                            dt_develop_t *dev,
+                            const dt_iop_roi_t *roi,
+                            GList *modules,
+                            GList *pieces,
+                            int pos,
+                            dt_dev_pixelpipe_iop_t **chain,
+                            GList **up_modules,
+                            GList **up_pieces,
+                            int *up_pos)
+{
+  dt_dev_pixelpipe_iop_t *found[DT_PIPE_FUSE_MAX];
+  int count = 0;
+  for(; modules && count < DT_PIPE_FUSE_MAX;
+      modules = g_list_previous(modules), pieces = g_list_previous(pieces), pos--)
+  {
+    dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(_skip_piece_on_tags(piece))
+      continue;
+    if(!_piece_may_fuse(pipe, dev, piece, roi))
+      break;
+
+    // the module after this one gets our output without colorspace conversion
+    if(count)
+    {
+      dt_dev_pixelpipe_iop_t *next = found[count - 1];
+      if(piece->module->output_colorspace(piece->module, pipe, piece)
+         != next->module->input_colorspace(next->module, pipe, next))
+        break;
+    }
+    found[count++] = piece;
+  }
+
+  if(count < 2) return 0;
+
+  for(int k = 0; k < count; k++)
+    chain[k] = found[count - 1 - k];
+  *up_modules = modules;
+  *up_pieces = pieces;
+  *up_pos = pos;
+  return count;
+}
+
+/* process a chain of per-pixel modules band by band, the output of a module is
+   passed on to the next one while still in the CPU caches. only the input of the first
+   and the output of the last module are kept in the pipe cache.
+*/
+static gboolean _dev_pixelpipe_process_fused(dt_dev_pixelpipe_t *pipe,
+                                             dt_develop_t *dev,
+                                             void **output,
+                                             dt_iop_buffer_dsc_t **out_format,
+                                             const dt_iop_roi_t *roi_out,
+                                             const dt_hash_t hash,
+                                             const size_t bufsize,
+                                             dt_dev_pixelpipe_iop_t **chain,
+                                             const int count,
+                                             GList *up_modules,
+                                             GList *up_pieces,
+                                             const int up_pos,
+                                             float *bands,
+                                             const int band_rows)
+{
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  dt_dev_pixelpipe_iop_t *first = chain[0];
+  dt_dev_pixelpipe_iop_t *last = chain[count - 1];
+
+  for(int k = 0; k < count; k++)
+    chain[k]->processed_roi_in = chain[k]->processed_roi_out = *roi_out;
+
+  void *input = NULL;
+  void *cl_mem_input = NULL;
+  dt_iop_buffer_dsc_t _input_format = { 0 };
+  dt_iop_buffer_dsc_t *input_format = &_input_format;
+
+  if(_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, roi_out,
+                                up_modules, up_pieces, up_pos))
+    return TRUE;
+
+  dt_dev_pixelpipe_cache_get(pipe, hash, bufsize, output, out_format, last->module, FALSE);
+
+  if(_pipe_has_shutdown(pipe))
+    return TRUE;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  // as in _pixelpipe_process_on_CPU() the input is converted in place
+  const dt_iop_order_iccprofile_info_t *const work_profile =
+    (input_format->cst != IOP_CS_RAW)
+      ? dt_ioppr_get_pipe_work_profile_info(pipe)
+      : NULL;
+  const dt_iop_colorspace_type_t cst_from = input_format->cst;
+  const dt_iop_colorspace_type_t cst_to =
+    first->module->input_colorspace(first->module, pipe, first);
+  dt_ioppr_transform_image_colorspace(first->module, input, input, width, height,
+                                      cst_from, cst_to, &input_format->cst, work_profile);
+  if(cst_from != cst_to)
+    dt_dev_pixelpipe_invalidate_cacheline(pipe, input);
+
+  const size_t band_floats = (size_t)4 * width * band_rows;
+  float *band[2] = { bands, bands + band_floats };
+  // modules may scale processed_maximum, they must see the same pipe format for every band
+  dt_iop_buffer_dsc_t dsc_before[DT_PIPE_FUSE_MAX];
+
+  for(int row = 0; row < height && !_pipe_has_shutdown(pipe); row += band_rows)
+  {
+    dt_iop_roi_t roi = *roi_out;
+    roi.y += row;
+    roi.height = MIN(band_rows, height - row);
+
+    for(int k = 0; k < count; k++)
+    {
+      dt_dev_pixelpipe_iop_t *piece = chain[k];
+      dt_iop_module_t *module = piece->module;
+      if(row == 0)
+      {
+        piece->dsc_out = piece->dsc_in = k ? chain[k - 1]->dsc_out : *input_format;
+        module->output_format(module, pipe, piece, &piece->dsc_out);
+        dsc_before[k] = piece->dsc_out;
+      }
+      pipe->dsc = dsc_before[k];
+
+      const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(&piece->dsc_in);
+      const size_t out_bpp = dt_iop_buffer_dsc_to_bpp(&piece->dsc_out);
+      const void *in = k
+        ? (const void *)band[(k - 1) & 1]
+        : (const void *)((const char *)input + in_bpp * width * row);
+      void *out = k < count - 1
+        ? (void *)band[k & 1]
+        : (void *)((char *)*output + out_bpp * width * row);
+
+      module->process(module, piece, in, out, &roi, &roi);
+      dt_dev_pixelpipe_scratch_reset(pipe);
+
+      if(row == 0)
+      {
+        pipe->dsc.cst = module->output_colorspace(module, pipe, piece);
+        piece->dsc_out = pipe->dsc;
+      }
+    }
+  }
+
+  pipe->dsc = last->dsc_out;
+  **out_format = pipe->dsc;
+
+  dt_print_pipe(DT_DEBUG_PIPE,
+                "process fused",
+                pipe, last->module, DT_DEVICE_CPU, roi_out, roi_out,
+                "%d modules from `%s%s', %d rows per band",
+                count, first->module->op, dt_iop_get_instance_id(first->module), band_rows);
+  dt_show_times_f(&start, "[dev_pixelpipe]", "[%s] processed `%s%s' to `%s%s' fused on CPU",
+                  dt_dev_pixelpipe_type_to_str(pipe->type),
+                  first->module->op, dt_iop_get_instance_id(first->module),
+                  last->module->op, dt_iop_get_instance_id(last->module));
+
+  return _pipe_has_shutdown(pipe);
+}
+
 // recursive helper for process, returns TRUE in case of unfinished work or error
 static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                            dt_develop_t *dev,
@@ -1878,19 +2515,39 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
       && !pipe->nocache
       && dt_dev_pixelpipe_cache_available(pipe, hash, bufsize);
 
-  if(cache_available)
+  // a line only available in the disk tier might fail to load, then we process as usual
+  if(cache_available
+     && !dt_dev_pixelpipe_cache_get(pipe, hash, bufsize,
+                                    output, out_format, module, TRUE))
   {
-    dt_dev_pixelpipe_cache_get(pipe, hash, bufsize,
-                               output, out_format, module, TRUE);
     dt_print_pipe(DT_DEBUG_PIPE,
                   "pipe data: from cache",
                   pipe, module, DT_DEVICE_NONE, &roi_in, NULL);
+    if(dt_trace_enabled())
+      _trace_piece(pipe, module, DT_DEVICE_NONE, roi_out, TRUE, bufsize, dt_get_wtime());
     // we're done! as colorpicker/scopes only work on gamma iop
     // input -- which is unavailable via cache -- there's no need to
     // run these
     return FALSE;
   }
 
+  dt_dev_pixelpipe_t *peer = !cache_available
+                              && !gamma_preview
+                              && dt_pipe_no_mask_display(pipe)
+                              && !pipe->nocache
+                              ? _dev_pixelpipe_peer(dev, pipe, module)
+                              : NULL;
+  if(peer
+     && dt_dev_pixelpipe_cache_get_from(pipe, peer, roi_out, pos, hash, bufsize,
+                                        output, out_format, module))
+  {
+    dt_print_pipe(DT_DEBUG_PIPE,
+                  "pipe data: from peer",
+                  pipe, module, DT_DEVICE_NONE, &roi_in, NULL, "%s",
+                  dt_dev_pixelpipe_type_to_str(peer->type));
+    return FALSE;
+  }
+
   // 2) if history changed, zoomed ... stop pipe processing, reasons will be handled in dt_dev_process_image_job()
   if(_dev_pixelpipe_early_exit(dev, pipe))
     return TRUE;
@@ -1994,7 +2651,8 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           if(cl_scale_possible)
           {
             cl_mem clin = dt_opencl_copy_host_to_image(pipe->devid, pipe->input, roi_in.width, roi_in.height, bpp);
-            cl_mem clout = dt_opencl_alloc_device(pipe->devid, roi_out->width, roi_out->height, bpp);
+            cl_mem clout = dt_opencl_alloc_device_use_host(pipe->devid, roi_out->width, roi_out->height,
+                                                           bpp, *output);
             if(clin && clout)
             {
               cl_int err = CL_SUCCESS;
@@ -2054,6 +2712,36 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
   if(_pipe_has_shutdown(pipe))
     return TRUE;
 
+  // chains of per-pixel modules skip the intermediate buffers and run band by band
+  if(_pipe_may_fuse(pipe))
+  {
+    dt_dev_pixelpipe_iop_t *chain[DT_PIPE_FUSE_MAX];
+    GList *up_modules = NULL;
+    GList *up_pieces = NULL;
+    int up_pos = 0;
+    const int count = _pointwise_chain(pipe, dev, roi_out, modules, pieces, pos,
+                                       chain, &up_modules, &up_pieces, &up_pos);
+    if(count)
+    {
+      // at least a row per thread
+      const int threads = dt_get_num_threads();
+      const size_t row_bytes = (size_t)4 * sizeof(float) * roi_out->width;
+      const int band_rows = CLAMP((int)((size_t)DT_PIPE_FUSE_BAND_BYTES * threads / row_bytes),
+                                  MIN(threads, roi_out->height), roi_out->height);
+      float *bands = dt_alloc_align_float((size_t)2 * 4 * roi_out->width * band_rows);
+      if(bands)
+      {
+        const gboolean err = _dev_pixelpipe_process_fused(pipe, dev, output, out_format,
+                                                          roi_out, hash, bufsize,
+                                                          chain, count,
+                                                          up_modules, up_pieces, up_pos,
+                                                          bands, band_rows);
+        dt_free_align(bands);
+        return err;
+      }
+    }
+  }
+
   // 3b) recurse and obtain output array in &input
 
   // get region of interest which is needed in input
@@ -2110,6 +2798,8 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   dt_times_t start;
   dt_get_perf_times(&start);
+  const double trace_start = dt_trace_enabled() ? dt_get_wtime() : 0.0;
+  pipe->tiles = 0;
 
   dt_pixelpipe_flow_t pixelpipe_flow =
     (PIXELPIPE_FLOW_NONE | PIXELPIPE_FLOW_HISTOGRAM_NONE);
@@ -2221,11 +2911,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
     /* test for a possible opencl path after checking some module
        specific pre-requisites */
-    gboolean possible_cl =
-        module->process_cl
-        && piece->process_cl_ready
-        && !(dt_pipe_is_preview(pipe) && (module->flags() & IOP_FLAGS_PREVIEW_NON_OPENCL))
-        && !_avoid_cl_module(piece);
+    gboolean possible_cl = _piece_possible_cl(piece);
 
     const uint32_t m_bpp = MAX(in_bpp, bpp);
     const size_t m_width = MAX(roi_in.width, roi_out->width);
@@ -2293,7 +2979,10 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
       const dt_hash_t phash = want_bcache
             ? _piece_process_hash(piece, roi_out, module, pos)
             : DT_INVALID_HASH;
-      const gboolean bcaching = want_bcache && pipe->bcache_data && phash == pipe->bcache_hash && phash != DT_INVALID_HASH;
+      const float *bcached = want_bcache
+            ? _get_bcache(pipe, phash, out_bpp * roi_out->width * roi_out->height / sizeof(float))
+            : NULL;
+      const gboolean bcaching = bcached != NULL;
 
       dt_print_pipe(DT_DEBUG_PIPE,
                         bcaching ? "from blend cache" : "process",
@@ -2361,19 +3050,19 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           cl_int err = CL_SUCCESS;
           if(bcaching)
           {
-            *cl_mem_output = dt_opencl_copy_host_to_image(pipe->devid, pipe->bcache_data, roi_out->width, roi_out->height, out_bpp);
+            *cl_mem_output = dt_opencl_copy_host_to_image(pipe->devid, (void *)bcached, roi_out->width, roi_out->height, out_bpp);
             if(*cl_mem_output == NULL)
             {
               // for some reason reading from bcache failed so let's clear/invalidate it now and leave the error condition
-              dt_free_align(pipe->bcache_data);
-              pipe->bcache_data = NULL;
-              pipe->bcache_hash = DT_INVALID_HASH;
+              _bcache_remove(pipe, phash);
               err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
             }
           }
           else
           {
-            *cl_mem_output = dt_opencl_alloc_device(pipe->devid, roi_out->width, roi_out->height, bpp);
+            // on unified memory the output lives in its cacheline, no copy back is needed
+            *cl_mem_output = dt_opencl_alloc_device_use_host(pipe->devid, roi_out->width, roi_out->height,
+                                                             bpp, *output);
             if(*cl_mem_output)
               err = module->process_cl(module, piece, cl_mem_input, *cl_mem_output, &roi_in, roi_out);
             else
@@ -2391,14 +3080,12 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                   if(err != CL_SUCCESS)
                   {
                     // for some reason writing to bcache failed so let's clear/invalidate it now and leave the error condition
-                    dt_free_align(cache);
-                    pipe->bcache_data = NULL;
-                    pipe->bcache_hash = DT_INVALID_HASH;
+                    _bcache_remove(pipe, phash);
                   }
                 }
               }
               else
-                pipe->bcache_hash = DT_INVALID_HASH;
+                _bcache_remove(pipe, phash);
             }
           }
 
@@ -2574,7 +3261,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           const size_t nfloats = out_bpp * roi_out->width * roi_out->height / sizeof(float);
           if(bcaching)
           {
-            dt_iop_image_copy(*output, pipe->bcache_data, nfloats);
+            dt_iop_image_copy(*output, bcached, nfloats);
           }
           else
           {
@@ -2588,7 +3275,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                 if(cache) dt_iop_image_copy(cache, *output, nfloats);
               }
               else
-                pipe->bcache_hash = DT_INVALID_HASH;
+                _bcache_remove(pipe, phash);
             }
           }
           success_opencl = (err == CL_SUCCESS);
@@ -2879,9 +3566,24 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           ? "GPU"
           : pixelpipe_flow & PIXELPIPE_FLOW_BLENDED_ON_CPU ? "CPU" : "");
 
+  if(dt_trace_enabled())
+    _trace_piece(pipe, module,
+                 pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU ? pipe->devid : DT_DEVICE_CPU,
+                 roi_out, FALSE, bufsize, trace_start);
+
   // in case we get this buffer from the cache in the future, cache some stuff:
   **out_format = piece->dsc_out = pipe->dsc;
 
+  // export pipes shared by several outputs keep the input of finalscale,
+  // it's the same for all of them as long as the profiles are. the input
+  // of the first module changed by a style is the same for all styles.
+  if(module
+     && dt_pipe_is_export(pipe)
+     && pipe->cache.entries > DT_PIPECACHE_MIN
+     && (dt_iop_module_is_finalscale(module) || module == pipe->keep_input_of))
+    dt_dev_pixelpipe_important_cacheline(pipe, input,
+                                         roi_in.width * roi_in.height * in_bpp);
+
   // special cases for active modules with available gui
   if(module
      && darktable.develop->gui_attached
@@ -2992,7 +3694,8 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
        || darktable.lib->proxy.colorpicker.live_samples)
     {
       _pixelpipe_pick_samples(dev, module, *out_format,
-                              (const float *const )input, &roi_in);
+                              (const float *const )input, &roi_in,
+                              dt_dev_pixelpipe_cache_hash(&roi_in, pipe, pos - 1));
     }
 
     // FIXME: read this from dt_ioppr_get_pipe_output_profile_info()?
@@ -3005,6 +3708,10 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     // in the pixelpipe and has a "process" call, why not treat it
     // as an iop? Granted, other views such as tether may also
     // benefit via a histogram.
+    //
+    // NOTE: gamma has no OpenCL path, so its input is always in host
+    // memory by now -- the main window needs this buffer anyway, and
+    // computing scope bins on the device would not save a readback.
     darktable.lib->proxy.histogram.process(darktable.lib->proxy.histogram.module, input,
                                            roi_in.width, roi_in.height,
                                            display_profile,
@@ -3118,6 +3825,98 @@ static gboolean _dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe
   return ret;
 }
 
+/* copy the processed area into a backbuf covering pipe->region. A backbuf of
+   another region or scale is replaced. The new one starts from the old backbuf
+   of the same image, resampled to the region, so tiles not done yet show the
+   previous rendering or the upscaled coarse pass instead of black.
+*/
+static void _dev_pixelpipe_compose_backbuf(dt_dev_pixelpipe_t *pipe,
+                                           const void *buf,
+                                           const dt_iop_roi_t *roi,
+                                           const dt_dev_zoom_pos_t pts,
+                                           const size_t bbpp)
+{
+  const dt_iop_roi_t *region = &pipe->region;
+  const int bw = region->width;
+  const int bh = region->height;
+  dt_dev_zoom_pos_t zoom_pos;
+  for(int i = 0; i < 6; i++) zoom_pos[i] = pts[i] * pipe->iscale;
+
+  const gboolean same = pipe->backbuf
+    && pipe->backbuf_width == bw && pipe->backbuf_height == bh
+    && pipe->backbuf_size == bbpp * bw * bh
+    && !pipe->backbuf_progressive
+    && pipe->backbuf_scale == region->scale
+    && pipe->output_imgid == pipe->image.id
+    && !memcmp(pipe->backbuf_zoom_pos, zoom_pos, sizeof(dt_dev_zoom_pos_t));
+
+  if(!same)
+  {
+    uint8_t *old = pipe->backbuf;
+    const dt_iop_roi_t old_roi = pipe->backbuf_roi;
+    const int ow = pipe->backbuf_width;
+    const int oh = pipe->backbuf_height;
+    pipe->backbuf = g_malloc0(bbpp * bw * bh);
+    pipe->backbuf_size = pipe->backbuf ? bbpp * bw * bh : 0;
+    if(pipe->backbuf && old && pipe->output_imgid == pipe->image.id
+       && ow > 0 && oh > 0 && old_roi.scale > 0.0f)
+    {
+      // nearest neighbour lookup of each pixel in the old area
+      const float f = old_roi.scale / region->scale;
+      DT_OMP_FOR()
+      for(int j = 0; j < bh; j++)
+      {
+        const int oj = (int)((region->y + j + 0.5f) * f) - old_roi.y;
+        if(oj < 0 || oj >= oh) continue;
+        const uint8_t *in = old + bbpp * ow * (size_t)oj;
+        uint8_t *out = pipe->backbuf + bbpp * bw * (size_t)j;
+        for(int i = 0; i < bw; i++)
+        {
+          const int oi = (int)((region->x + i + 0.5f) * f) - old_roi.x;
+          if(oi >= 0 && oi < ow)
+            memcpy(out + bbpp * i, in + bbpp * oi, bbpp);
+        }
+      }
+    }
+    g_free(old);
+    pipe->backbuf_width = pipe->backbuf ? bw : 0;
+    pipe->backbuf_height = pipe->backbuf ? bh : 0;
+  }
+
+  if(!pipe->backbuf) return;
+
+  const int ox = roi->x - region->x;
+  const int oy = roi->y - region->y;
+  for(int j = 0; j < roi->height; j++)
+    memcpy(pipe->backbuf + bbpp * ((size_t)(oy + j) * bw + ox),
+           (const uint8_t *)buf + bbpp * (size_t)j * roi->width,
+           bbpp * roi->width);
+
+  pipe->backbuf_scale = region->scale;
+  pipe->backbuf_roi = *region;
+  pipe->backbuf_progressive = 0;
+  memcpy(pipe->backbuf_zoom_pos, zoom_pos, sizeof(dt_dev_zoom_pos_t));
+  pipe->output_imgid = pipe->image.id;
+}
+
+static dt_thread_budget_class_t _pipe_budget_class(const dt_dev_pixelpipe_t *pipe)
+{
+  if(pipe->type & DT_DEV_PIXELPIPE_FULL) return DT_THREAD_BUDGET_FULL;
+  if(pipe->type & (DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_PREVIEW2))
+    return DT_THREAD_BUDGET_PREVIEW;
+  if(pipe->type & DT_DEV_PIXELPIPE_EXPORT) return DT_THREAD_BUDGET_EXPORT;
+  return DT_THREAD_BUDGET_BACKGROUND;
+}
+
+static gboolean _dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
+                                       dt_develop_t *dev,
+                                       const int x,
+                                       const int y,
+                                       const int width,
+                                       const int height,
+                                       const float scale,
+                                       const int devid);
+
 gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
                                   dt_develop_t *dev,
                                   const int x,
@@ -3126,12 +3925,33 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
                                   const int height,
                                   const float scale,
                                   const int devid)
+{
+  // share the cores with the other pipes running right now
+  const dt_thread_budget_class_t budget = _pipe_budget_class(pipe);
+  int previous_threads;
+  dt_thread_budget_acquire(budget, &previous_threads);
+  const gboolean altered = _dev_pixelpipe_process(pipe, dev, x, y, width, height, scale, devid);
+  dt_thread_budget_release(budget, previous_threads);
+  return altered;
+}
+
+static gboolean _dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
+                                       dt_develop_t *dev,
+                                       const int x,
+                                       const int y,
+                                       const int width,
+                                       const int height,
+                                       const float scale,
+                                       const int devid)
 {
   pipe->processing = TRUE;
   pipe->nocache = dt_pipe_is_image(pipe);
   pipe->runs++;
   pipe->opencl_enabled = dt_opencl_running();
 
+  // spread the OpenMP team of this thread over the NUMA nodes, once per thread
+  dt_numa_bind_team(-1);
+
   // if devid is a valid CL device we don't lock it as the caller has done so already
   const gboolean claimed = devid > DT_DEVICE_CPU;
   pipe->devid = pipe->opencl_enabled
@@ -3147,7 +3967,9 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
   pipe->final_width = width;
   pipe->final_height = height;
 
-  float zx = (x + 0.5f * width) / scale, zy = (y + 0.5f * height) / scale;
+  // the backbuf position refers to the whole region if we are composing into it
+  const dt_iop_roi_t *area = pipe->region.width ? &pipe->region : &roi;
+  float zx = (area->x + 0.5f * area->width) / scale, zy = (area->y + 0.5f * area->height) / scale;
   dt_dev_zoom_pos_t pts = { zx, zy, zx + 1000.f, zy, zx, zy + 1000.f };
   dt_dev_distort_backtransform_plus(dev, pipe, 0.0f, DT_DEV_TRANSFORM_DIR_ALL_GEOMETRY, pts, 3);
 
@@ -3164,10 +3986,12 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
   const guint pos = g_list_length(pipe->iop);
   GList *modules = g_list_last(pipe->iop);
   GList *pieces = g_list_last(pipe->nodes);
+  double start = 0.0;
 
 // re-entry point: in case of late opencl errors we start all over
 // again with opencl-support disabled
 restart:
+  start = dt_get_wtime();
 
   // check if we should obsolete caches
   if(pipe->cache_obsolete) dt_dev_pixelpipe_cache_flush(pipe);
@@ -3195,6 +4019,11 @@ restart:
                   pipe->image.filename, pipe->image.id, avail_mem / DT_MEGA);
   dt_print_mem_usage("before pixelpipe process");
 
+#ifdef HAVE_OPENCL
+  if(pipe->devid > DT_DEVICE_CPU && (darktable.unmuted & (DT_DEBUG_PIPE | DT_DEBUG_PERF)))
+    _dev_pixelpipe_plan_transfers(pipe);
+#endif
+
   // run pixelpipe recursively and get error status
   const gboolean err = _dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &buf,
                                                                &cl_mem_out, &out_format,
@@ -3254,6 +4083,7 @@ restart:
   }
 
   // release resources:
+  dt_dev_pixelpipe_scratch_cleanup(pipe);
   if(pipe->forms)
   {
     g_list_free_full(pipe->forms, (void (*)(void *))dt_masks_free_form);
@@ -3286,31 +4116,48 @@ restart:
     // backbuf is 16 B/px (4 floats) rather than the usual 8-bit ARGB.
     const size_t bbpp =
       (pipe->type & DT_DEV_PIXELPIPE_IMAGE_FLOAT) ? 4 * sizeof(float) : 4 * sizeof(uint8_t);
-    if(pipe->backbuf == NULL || pipe->backbuf_width * pipe->backbuf_height != width * height ||
-       pipe->backbuf_size != bbpp * width * height)
+    if(pipe->region.width)
+      _dev_pixelpipe_compose_backbuf(pipe, buf, &roi, pts, bbpp);
+    else
     {
-      g_free(pipe->backbuf);
-      pipe->backbuf = g_malloc0(bbpp * width * height);
-      pipe->backbuf_size = bbpp * width * height;
-    }
+      if(pipe->backbuf == NULL || pipe->backbuf_width * pipe->backbuf_height != width * height ||
+         pipe->backbuf_size != bbpp * width * height)
+      {
+        g_free(pipe->backbuf);
+        pipe->backbuf = g_malloc0(bbpp * width * height);
+        pipe->backbuf_size = bbpp * width * height;
+      }
 
-    if(pipe->backbuf)
-    {
-      memcpy(pipe->backbuf, buf, bbpp * width * height);
-      pipe->backbuf_scale = scale;
-      for(int i = 0; i < 6; i++) pipe->backbuf_zoom_pos[i] = pts[i] * pipe->iscale;
-      pipe->output_imgid = pipe->image.id;
+      if(pipe->backbuf)
+      {
+        memcpy(pipe->backbuf, buf, bbpp * width * height);
+        pipe->backbuf_scale = scale;
+        pipe->backbuf_roi = roi;
+        pipe->backbuf_progressive = pipe->progressive;
+        for(int i = 0; i < 6; i++) pipe->backbuf_zoom_pos[i] = pts[i] * pipe->iscale;
+        pipe->output_imgid = pipe->image.id;
+      }
+      pipe->backbuf_width = width;
+      pipe->backbuf_height = height;
     }
   }
   else
+  {
     pipe->backbuf = buf;
-  pipe->backbuf_width = width;
-  pipe->backbuf_height = height;
+    pipe->backbuf_width = width;
+    pipe->backbuf_height = height;
+  }
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
 
   if(!claimed)
     dt_dev_pixelpipe_cache_report(pipe);
 
+  // export pipes process the full input without cache hits, good to
+  // compare the speed of the devices
+  if(pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+    dt_opencl_update_throughput(old_devid, (double)pipe->iwidth * pipe->iheight / 1e6,
+                                dt_get_wtime() - start);
+
   dt_print_pipe(DT_DEBUG_PIPE, "pipe finished",
                 pipe, NULL, old_devid, &roi, &roi, "'%s' ID=%i",
                 pipe->image.filename, pipe->image.id);
@@ -3379,9 +4226,11 @@ static float *_ensure_distort_buf(dt_dev_pixelpipe_t *pipe, const int idx, const
   if(pipe->mask_distort_buf_size[idx] >= needed)
     return pipe->mask_distort_buf[idx];
 
-  dt_free_align(pipe->mask_distort_buf[idx]);
-  pipe->mask_distort_buf[idx] = dt_alloc_align_float(num_floats);
-  pipe->mask_distort_buf_size[idx] = pipe->mask_distort_buf[idx] ? needed : 0;
+  // buffers come from the pipe cache pool, we keep their full capacity as the size
+  _pool_free(pipe->mask_distort_buf[idx], pipe->mask_distort_buf_size[idx],
+             pipe->cache.mem_account);
+  pipe->mask_distort_buf[idx] = _pool_alloc(needed, pipe->cache.mem_account);
+  pipe->mask_distort_buf_size[idx] = pipe->mask_distort_buf[idx] ? _pool_capacity(needed) : 0;
   return pipe->mask_distort_buf[idx];
 }
 
@@ -3389,12 +4238,76 @@ static void _free_distort_bufs(dt_dev_pixelpipe_t *pipe)
 {
   for(int i = 0; i < 2; i++)
   {
-    dt_free_align(pipe->mask_distort_buf[i]);
+    _pool_free(pipe->mask_distort_buf[i], pipe->mask_distort_buf_size[i],
+               pipe->cache.mem_account);
     pipe->mask_distort_buf[i] = NULL;
     pipe->mask_distort_buf_size[i] = 0;
   }
 }
 
+void *dt_dev_pixelpipe_scratch_alloc(dt_dev_pixelpipe_iop_t *piece, const size_t size)
+{
+  dt_dev_pixelpipe_scratch_t *s = &piece->pipe->scratch;
+  const size_t bytes = dt_round_size(MAX(size, 1), DT_CACHELINE_BYTES);
+  s->demand += bytes;
+
+  // the arena can only be replaced while nothing of it is handed out
+  const size_t want = MAX(bytes, s->want);
+  if(s->used == 0 && s->size < want)
+  {
+    _pool_free(s->base, s->size, piece->pipe->cache.mem_account);
+    s->base = _pool_alloc(want, piece->pipe->cache.mem_account);
+    s->size = s->base ? _pool_capacity(want) : 0;
+  }
+
+  if(s->base && s->used + bytes <= s->size)
+  {
+    void *mem = s->base + s->used;
+    s->used += bytes;
+    return mem;
+  }
+
+  void *mem = dt_alloc_aligned(bytes);
+  if(mem) s->spill = g_slist_prepend(s->spill, mem);
+  return mem;
+}
+
+float *dt_dev_pixelpipe_scratch_perthread_float(dt_dev_pixelpipe_iop_t *piece,
+                                                const size_t nfloats,
+                                                size_t *padded_size)
+{
+  const size_t cache_lines = (nfloats * sizeof(float) + DT_CACHELINE_BYTES - 1) / DT_CACHELINE_BYTES;
+  *padded_size = DT_CACHELINE_BYTES * cache_lines / sizeof(float);
+  return dt_dev_pixelpipe_scratch_float(piece, *padded_size * dt_get_num_threads());
+}
+
+void dt_dev_pixelpipe_scratch_reset(dt_dev_pixelpipe_t *pipe)
+{
+  dt_dev_pixelpipe_scratch_t *s = &pipe->scratch;
+  if(s->demand == 0) return;
+
+  if(s->spill)
+    dt_print(DT_DEBUG_MEMORY, "[pixelpipe scratch] %s: %zuMB requested, arena holds %zuMB",
+             dt_dev_pixelpipe_type_to_str(pipe->type), s->demand >> 20, s->size >> 20);
+
+  g_slist_free_full(s->spill, dt_free_align_ptr);
+  s->spill = NULL;
+  // the next tile of the same module will ask for the same amount
+  s->want = MAX(s->want, s->demand);
+  s->used = 0;
+  s->demand = 0;
+}
+
+void dt_dev_pixelpipe_scratch_cleanup(dt_dev_pixelpipe_t *pipe)
+{
+  dt_dev_pixelpipe_scratch_reset(pipe);
+  dt_dev_pixelpipe_scratch_t *s = &pipe->scratch;
+  _pool_free(s->base, s->size, pipe->cache.mem_account);
+  s->base = NULL;
+  s->size = 0;
+  s->want = 0;
+}
+
 // compute a hash for a cached detail mask at a given piece's output.
 // incorporates the scharr source hash and the cumulative pipe hash up to this piece.
 static dt_hash_t _detail_mask_cache_hash(dt_dev_pixelpipe_iop_t *piece)
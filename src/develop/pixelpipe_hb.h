@@ -69,6 +69,7 @@ typedef struct dt_dev_pixelpipe_iop_t
   dt_iop_roi_t processed_roi_out;
   gboolean process_cl_ready;      // set this to FALSE in commit_params to temporarily disable the use of process_cl
   gboolean process_tiling_ready;  // set this to FALSE in commit_params to temporarily disable tiling
+  gboolean process_pointwise;     // set this to FALSE in commit_params if the parameters need more than single pixels
 
   // the following are used internally for caching:
   dt_iop_buffer_dsc_t dsc_in;
@@ -142,6 +143,21 @@ typedef enum dt_dev_pixelpipe_stopper_t
   DT_DEV_PIXELPIPE_STOP_LAST,
 } dt_dev_pixelpipe_stopper_t;
 
+/* pre-blend outputs of the focused module. Changing blend or mask parameters
+   doesn't change them, so those edits only redo the blend. There are several
+   slots as the darkroom might process a coarse pass and tiles of the same view.
+*/
+#define DT_DEV_PIXELPIPE_BCACHE_SLOTS 12
+#define DT_DEV_PIXELPIPE_BCACHE_BYTES ((size_t)512 << 20)
+
+typedef struct dt_dev_pixelpipe_bcache_t
+{
+  dt_hash_t hash;
+  float *data;
+  size_t nfloats;
+  uint64_t used; // for LRU eviction
+} dt_dev_pixelpipe_bcache_t;
+
 typedef struct dt_dev_detail_mask_t
 {
   dt_iop_roi_t roi;
@@ -149,6 +165,39 @@ typedef struct dt_dev_detail_mask_t
   float *data;
 } dt_dev_detail_mask_t;
 
+/**
+ * scratch arena for the temporary buffers a module needs inside process().
+ * requests are carved from one pooled block that is kept across the modules
+ * and tiles of a pipe run, so the allocator and the page faults of fresh
+ * buffers are paid once per run instead of once per module and tile.
+ * the arena is sized by the tiling_callback() memory factors, requests that
+ * don't fit are served by the system allocator and grow it for the next call.
+ */
+typedef struct dt_dev_pixelpipe_scratch_t
+{
+  char *base;     // the arena, from the pipe cache pool
+  size_t size;    // capacity of base in bytes
+  size_t used;    // bytes handed out since the last reset
+  size_t want;    // bytes expected by the module being processed
+  size_t demand;  // bytes requested since the last reset, including spills
+  GSList *spill;  // requests that did not fit into the arena
+} dt_dev_pixelpipe_scratch_t;
+
+/* transformed coordinates of the points sent through the distortion chain,
+   keyed by their input coordinates. one table per pipe state and direction,
+   see dt_dev_distort_transform_plus().
+*/
+#define DT_DEV_DISTORT_MEMO_SLOTS 4
+
+typedef struct dt_dev_distort_memo_t
+{
+  dt_hash_t state; // direction and parameters of the distorting modules
+  size_t size;     // slots, a power of 2
+  size_t count;
+  uint64_t *keys;  // the input coordinates as float bits
+  float *values;   // the transformed coordinates
+} dt_dev_distort_memo_t;
+
 /**
  * this encapsulates the pixelpipe.
  * a develop module will need several of these:
@@ -186,6 +235,11 @@ typedef struct dt_dev_pixelpipe_t
 
   // instances of pixelpipe, stored in GList of dt_dev_pixelpipe_iop_t
   GList *nodes;
+  // module -> piece of nodes, built along with them
+  GHashTable *node_index;
+  // module whose input stays in the cache of export pipes shared by
+  // several outputs, along with the input of finalscale
+  const struct dt_iop_module_t *keep_input_of;
   // event flag
   dt_dev_pixelpipe_change_t changed;
   // pipe status
@@ -197,8 +251,17 @@ typedef struct dt_dev_pixelpipe_t
   size_t backbuf_size;
   int backbuf_width, backbuf_height;
   float backbuf_scale;
+  // the processed area held in the backbuf, at backbuf_scale
+  dt_iop_roi_t backbuf_roi;
   dt_dev_zoom_pos_t backbuf_zoom_pos;
   dt_hash_t backbuf_hash;
+  // scale divisor of the coarse progressive pass being processed and of
+  // the one held in the backbuf, 0 for full resolution
+  int progressive, backbuf_progressive;
+  // if width is set, processed areas are composed into a backbuf covering this region
+  dt_iop_roi_t region;
+  // the last region that has been completely rendered in tiles
+  dt_iop_roi_t tiled_region;
   dt_pthread_mutex_t mutex, backbuf_mutex, busy_mutex;
   int final_width, final_height;
 
@@ -228,6 +291,8 @@ typedef struct dt_dev_pixelpipe_t
   gboolean opencl_error;
   // running in a tiling context?
   gboolean tiling;
+  // number of tiles of the last tiled module run, reset for every module
+  int tiles;
   // should this pixelpipe display a mask in the end?
   dt_dev_pixelpipe_display_mask_t mask_display;
   // should this pixelpipe completely suppressed the blendif module?
@@ -255,12 +320,17 @@ typedef struct dt_dev_pixelpipe_t
   // the masks generated in the pipe for later reusal are inside dt_dev_pixelpipe_iop_t
   gboolean store_all_raster_masks;
   // module blending cache
-  float *bcache_data;
-  dt_hash_t bcache_hash;
+  dt_dev_pixelpipe_bcache_t bcache[DT_DEV_PIXELPIPE_BCACHE_SLOTS];
+  uint64_t bcache_used;
 
   // reusable ping-pong buffers for mask distortion walks
   float *mask_distort_buf[2];
   size_t mask_distort_buf_size[2];
+  // points already sent through the distortion chain by the mask gui
+  dt_dev_distort_memo_t distort_memo[DT_DEV_DISTORT_MEMO_SLOTS];
+  int distort_memo_next;
+  // temporary buffers of the module being processed on the CPU
+  dt_dev_pixelpipe_scratch_t scratch;
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
@@ -327,12 +397,20 @@ const char *dt_dev_pixelpipe_shutdown_to_str(const dt_dev_pixelpipe_stopper_t st
 // If DT_PIPE_CAS_SHUTDOWN is defined do that only if shutdown was DT_DEV_PIXELPIPE_STOP_NO
 void dt_dev_pixelpipe_set_shutdown(dt_dev_pixelpipe_t *pipe, const dt_dev_pixelpipe_stopper_t stopper);
 
+// while flag is set (not NULL), any pipe processed by the calling thread is
+// shut down between modules as soon as *flag becomes non-zero.
+// used by background jobs whose result may become unwanted while running.
+void dt_dev_pixelpipe_set_thread_cancel(dt_atomic_int *flag);
+
 // inits the pixelpipe with plain passthrough input/output and empty input and default caching settings.
 gboolean dt_dev_pixelpipe_init(dt_dev_pixelpipe_t *pipe);
 // inits the preview pixelpipe with plain passthrough input/output and empty input and default caching
 // settings.
 gboolean dt_dev_pixelpipe_init_preview(dt_dev_pixelpipe_t *pipe);
 gboolean dt_dev_pixelpipe_init_preview2(dt_dev_pixelpipe_t *pipe);
+// returns the piece of module in the nodes of pipe, NULL if there is none
+struct dt_dev_pixelpipe_iop_t *dt_dev_pixelpipe_get_piece(const dt_dev_pixelpipe_t *pipe,
+                                                          const struct dt_iop_module_t *module);
 // inits the pixelpipe with settings optimized for full-image export
 // (no history stack cache)
 gboolean dt_dev_pixelpipe_init_export(dt_dev_pixelpipe_t *pipe,
@@ -340,6 +418,11 @@ gboolean dt_dev_pixelpipe_init_export(dt_dev_pixelpipe_t *pipe,
                                       const int32_t height,
                                       const int levels,
                                       const gboolean store_masks);
+// inits an export pixelpipe with a small history cache, to be used for
+// several outputs of the same image
+gboolean dt_dev_pixelpipe_init_export_shared(dt_dev_pixelpipe_t *pipe,
+                                             const int levels,
+                                             const gboolean store_masks);
 // inits the pixelpipe with settings optimized for thumbnail export
 // (no history stack cache)
 gboolean dt_dev_pixelpipe_init_thumbnail(dt_dev_pixelpipe_t *pipe,
@@ -390,6 +473,10 @@ void dt_dev_pixelpipe_change(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev)
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe);
 // sync with develop_t history stack from scratch (new node added, have to pop old ones)
 void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
+// bring the nodes in line with the modules of dev, keeping the pieces of modules
+// still in dev and only creating or destroying the others. the modules of the
+// dropped pieces must still be alive.
+void dt_dev_pixelpipe_update_nodes(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 // sync with develop_t history stack by just copying the top item params (same op, new params on top)
 void dt_dev_pixelpipe_synch_all(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 // adjust output node according to history stack (history pop event)
@@ -417,6 +504,25 @@ gboolean dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe,
                                       const int height,
                                       const float scale);
 
+// get a 64-bytes aligned temporary buffer of 'size' bytes from the pipe's scratch
+// arena. it is valid until the module's process() returns and must not be freed.
+// not to be called from within parallel regions.
+void *dt_dev_pixelpipe_scratch_alloc(dt_dev_pixelpipe_iop_t *piece, const size_t size);
+// same for 'nfloats' floats
+static inline float *dt_dev_pixelpipe_scratch_float(dt_dev_pixelpipe_iop_t *piece,
+                                                    const size_t nfloats)
+{
+  return (float *)dt_dev_pixelpipe_scratch_alloc(piece, nfloats * sizeof(float));
+}
+// same as dt_alloc_perthread_float(), use dt_get_perthread() to access the buffers
+float *dt_dev_pixelpipe_scratch_perthread_float(dt_dev_pixelpipe_iop_t *piece,
+                                                const size_t nfloats,
+                                                size_t *padded_size);
+// hand all scratch buffers back after a process() call, called by the pipe and tiling
+void dt_dev_pixelpipe_scratch_reset(dt_dev_pixelpipe_t *pipe);
+// give the arena back to the pool, done at the end of a pipe run
+void dt_dev_pixelpipe_scratch_cleanup(dt_dev_pixelpipe_t *pipe);
+
 // disable given op and all that comes after it in the pipe:
 void dt_dev_pixelpipe_disable_after(dt_dev_pixelpipe_t *pipe, const char *op);
 // disable given op and all that comes before it in the pipe:
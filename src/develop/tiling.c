@@ -17,12 +17,14 @@
 */
 
 #include "develop/tiling.h"
+#include "common/memory_account.h"
 #include "common/opencl.h"
 #include "control/control.h"
 #include "develop/blend.h"
 #include "develop/pixelpipe.h"
 
 #include <assert.h>
+#include <float.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -90,6 +92,26 @@ static inline void _print_roi(const dt_iop_roi_t *roi, const char *label)
            roi->width, roi->height, roi->scale, label);
 }
 
+/* host tile buffers are counted in the tiling memory account, their size is
+   kept in the cacheline in front of them as they are freed on all kinds of
+   paths */
+static void *_tile_alloc(const size_t size)
+{
+  char *mem = dt_alloc_aligned(size + DT_CACHELINE_BYTES);
+  if(!mem) return NULL;
+  *(size_t *)mem = size;
+  dt_mem_account_alloc(DT_MEM_ACCOUNT_TILING, size);
+  return mem + DT_CACHELINE_BYTES;
+}
+
+static void _tile_free(void *buf)
+{
+  if(!buf) return;
+  char *mem = (char *)buf - DT_CACHELINE_BYTES;
+  dt_mem_account_free(DT_MEM_ACCOUNT_TILING, *(size_t *)mem);
+  dt_free_align(mem);
+}
+
 
 static double _nm_fitness(double x[], void *rest[])
 {
@@ -568,6 +590,100 @@ static gboolean _fit_output_to_input_roi(dt_iop_module_t *self,
 
 
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
+/* tiling planner for the ptp case. instead of shrinking the image
+   dimensions until a tile fits the single buffer limit, all tile grids are
+   evaluated and the cheapest is used. the cost is the number of pixels
+   processed including the redundant overlap, the same pixels moved in and
+   out of the tile buffers (weighted by transfer) and a fixed cost per tile
+   in pixels for setup and kernel launches. */
+typedef struct _tile_plan_t
+{
+  int width;    // tile dimensions including overlap
+  int height;
+  int tile_wd;  // step between tiles
+  int tile_ht;
+  int tiles_x;
+  int tiles_y;
+  float redundant; // processed pixels in excess of the image
+} _tile_plan_t;
+
+static inline int _align_to(const int n, const unsigned a)
+{
+  return ((n + a - 1) / a) * a;
+}
+
+// pixels processed along one dimension, the same way the tile loops do it
+static size_t _tiled_extent(const int full,
+                            const int size,
+                            const int step,
+                            const int tiles,
+                            const int overlap)
+{
+  size_t extent = 0;
+  for(int t = 0; t < tiles; t++)
+  {
+    const int len = t * step + size > full ? full - t * step : size;
+    if(t == 0 || len > 2 * overlap) extent += len;
+  }
+  return extent;
+}
+
+static gboolean _plan_tiles(const int full_w,
+                            const int full_h,
+                            const int max_w,
+                            const int max_h,
+                            const float max_pixels,
+                            const int overlap,
+                            const unsigned walign,
+                            const unsigned halign,
+                            const float transfer,
+                            const float tile_cost,
+                            _tile_plan_t *plan)
+{
+  double best = DBL_MAX;
+  const int max_tiles = _maximum_number_tiles();
+
+  for(int nx = 1; nx <= MIN(full_w, max_tiles); nx++)
+  {
+    // the narrowest aligned tile giving nx columns
+    int width = nx == 1 ? full_w : _align_to(_align_to(full_w, nx) / nx + 2 * overlap, walign);
+    if(width >= full_w) width = full_w;
+    else if(width <= 2 * overlap) break;
+    if(width > max_w) continue;
+
+    const float rows_fit = max_pixels / width;
+    int height = rows_fit >= full_h ? full_h : (int)rows_fit;
+    height = MIN(height, max_h);
+    if(height < full_h)
+    {
+      height = (height / halign) * halign;
+      if(height <= 2 * overlap) continue;
+      // the lowest tile giving the same number of rows
+      const int rows = ceilf(full_h / (float)(height - 2 * overlap));
+      height = MIN(height, _align_to(_align_to(full_h, rows) / rows + 2 * overlap, halign));
+    }
+
+    const int tile_wd = width < full_w ? width - 2 * overlap : width;
+    const int tile_ht = height < full_h ? height - 2 * overlap : height;
+    const int tiles_x = width < full_w ? ceilf(full_w / (float)tile_wd) : 1;
+    const int tiles_y = height < full_h ? ceilf(full_h / (float)tile_ht) : 1;
+    if((size_t)tiles_x * tiles_y > max_tiles) continue;
+
+    const double area = (double)_tiled_extent(full_w, width, tile_wd, tiles_x, overlap)
+                        * _tiled_extent(full_h, height, tile_ht, tiles_y, overlap);
+    const double cost = area * (1.0 + transfer) + (double)tiles_x * tiles_y * tile_cost;
+    if(cost < best)
+    {
+      best = cost;
+      *plan = (_tile_plan_t){ width, height, MAX(tile_wd, 1), MAX(tile_ht, 1), tiles_x, tiles_y,
+                              area / ((double)full_w * full_h) - 1.0 };
+    }
+    // a single column or tile can't be beaten by more of them
+    if(width == full_w && height == MIN(full_h, max_h)) break;
+  }
+  return best < DBL_MAX;
+}
+
 static void _default_process_tiling_ptp(dt_iop_module_t *self,
                                         dt_dev_pixelpipe_iop_t *piece,
                                         const void *const ivoid,
@@ -622,42 +738,6 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
   const float maxbuf = fmaxf(tiling.maxbuf, 1.0f);
   singlebuffer = fmaxf(available / factor, singlebuffer);
 
-  int width = roi_in->width;
-  int height = roi_in->height;
-
-  /* shrink tile size in case it would exceed singlebuffer size */
-  if((float)width * height * max_bpp * maxbuf > singlebuffer)
-  {
-    const float scale = singlebuffer / ((float)width * height * max_bpp * maxbuf);
-
-    /* TODO: can we make this more efficient to minimize total overlap between tiles? */
-    if(width < height && scale >= 0.333f)
-    {
-      height = floorf(height * scale);
-    }
-    else if(height <= width && scale >= 0.333f)
-    {
-      width = floorf(width * scale);
-    }
-    else
-    {
-      width = floorf(width * sqrtf(scale));
-      height = floorf(height * sqrtf(scale));
-    }
-    dt_print(DT_DEBUG_TILING | DT_DEBUG_VERBOSE,
-             "[default_process_tiling_ptp] buffer exceeds singlebuffer, corrected to %dx%d",
-             width, height);
-  }
-
-  /* make sure we have a reasonably effective tile dimension. if not try square tiles */
-  if(3 * tiling.overlap > width || 3 * tiling.overlap > height)
-  {
-    width = height = floorf(sqrtf((float)width * height));
-    dt_print(DT_DEBUG_TILING | DT_DEBUG_VERBOSE,
-             "[default_process_tiling_roi] use squares because of overlap, corrected to %dx%d",
-             width, height);
-  }
-
   /* Alignment rules: we need to make sure that alignment requirements of module are fulfilled.
      Modules will report alignment requirements via align within tiling_callback().
      We guarantee alignment by selecting image width/height and overlap accordingly. For a tile width/height
@@ -666,34 +746,44 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
   const unsigned int align = tiling.align;
   assert(align != 0);
 
-  /* properly align tile width and height by making them smaller if needed */
-  if(width < roi_in->width) width = (width / align) * align;
-  if(height < roi_in->height) height = (height / align) * align;
-
   /* also make sure that overlap follows alignment rules by making it wider when needed */
   const int overlap = tiling.overlap % align != 0 ? (tiling.overlap / align + 1) * align
                                                     : tiling.overlap;
 
-  /* calculate effective tile size */
-  const int tile_wd = width - 2 * overlap > 0 ? width - 2 * overlap : 1;
-  const int tile_ht = height - 2 * overlap > 0 ? height - 2 * overlap : 1;
-
-  /* calculate number of tiles */
-  const int tiles_x = width < roi_in->width ? ceilf(roi_in->width / (float)tile_wd) : 1;
-  const int tiles_y = height < roi_in->height ? ceilf(roi_in->height / (float)tile_ht) : 1;
+  /* pick the cheapest tile grid fitting the single buffer, copying tiles
+     in and out is cheap compared to processing them */
+  _tile_plan_t plan = { 0 };
+  const gboolean planned =
+    _plan_tiles(roi_in->width, roi_in->height, roi_in->width, roi_in->height,
+                singlebuffer / ((float)max_bpp * maxbuf), overlap, align, align,
+                0.1f, 64.0f * 1024.0f, &plan);
+
+  const int width = plan.width;
+  const int height = plan.height;
+  const int tile_wd = plan.tile_wd;
+  const int tile_ht = plan.tile_ht;
+  const int tiles_x = plan.tiles_x;
+  const int tiles_y = plan.tiles_y;
 
   /* sanity check: don't run wild on too many tiles */
-  if(tiles_x * tiles_y > _maximum_number_tiles())
+  if(!planned)
   {
     dt_print(DT_DEBUG_PIPE | DT_DEBUG_TILING,
-             "[default_process_tiling_ptp] [%s] gave up tiling for module '%s%s'. too many tiles: %d x %d",
+             "[default_process_tiling_ptp] [%s] gave up tiling for module '%s%s'."
+             " no tile grid fits with overlap %d",
              dt_dev_pixelpipe_type_to_str(piece->pipe->type),
-             self->op, dt_iop_get_instance_id(self), tiles_x, tiles_y);
+             self->op, dt_iop_get_instance_id(self), overlap);
     goto error;
   }
+  piece->pipe->tiles = tiles_x * tiles_y;
+  dt_print(DT_DEBUG_TILING,
+           "[tiling planner] [%s] module '%s%s' CPU: %dx%d tiles of %dx%d, overlap %d,"
+           " %.0f%% redundant pixels",
+           dt_dev_pixelpipe_type_to_str(piece->pipe->type), self->op, dt_iop_get_instance_id(self),
+           tiles_x, tiles_y, width, height, overlap, 100.0f * plan.redundant);
 
   /* reserve input and output buffers for tiles */
-  input = dt_alloc_aligned((size_t)width * height * in_bpp);
+  input = _tile_alloc((size_t)width * height * in_bpp);
   if(input == NULL)
   {
     dt_print(DT_DEBUG_TILING,
@@ -701,7 +791,7 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
              dt_dev_pixelpipe_type_to_str(piece->pipe->type), self->op, dt_iop_get_instance_id(self));
     goto error;
   }
-  output = dt_alloc_aligned((size_t)width * height * out_bpp);
+  output = _tile_alloc((size_t)width * height * out_bpp);
   if(output == NULL)
   {
     dt_print(DT_DEBUG_TILING,
@@ -760,6 +850,7 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
 
       /* call process() of module */
       self->process(self, piece, input, output, &iroi, &oroi);
+      dt_dev_pixelpipe_scratch_reset(piece->pipe);
 
       /* aggregate resulting processed_maximum */
       /* TODO: check if there really can be differences between tiles and take
@@ -800,8 +891,8 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
   /* copy back final processed_maximum */
   for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
 
-  dt_free_align(input);
-  dt_free_align(output);
+  _tile_free(input);
+  _tile_free(output);
   piece->pipe->tiling = FALSE;
   return;
 
@@ -811,8 +902,8 @@ error:
 // fall through
 
 fallback:
-  dt_free_align(input);
-  dt_free_align(output);
+  _tile_free(input);
+  _tile_free(output);
   piece->pipe->tiling = FALSE;
   dt_print(DT_DEBUG_TILING,
            "[default_process_tiling_ptp] [%s] fall back to standard processing for module '%s%s'",
@@ -964,6 +1055,7 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
              self->op, dt_iop_get_instance_id(self), tiles_x, tiles_y);
     goto error;
   }
+  piece->pipe->tiles = tiles_x * tiles_y;
 
 
   /* calculate tile width and height excl. overlap (i.e. the good part) for output.
@@ -1079,7 +1171,7 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
                "tile (%zu,%zu)", tx, ty);
 
       /* prepare input tile buffer */
-      input = dt_alloc_aligned((size_t)iroi_full.width * iroi_full.height * in_bpp);
+      input = _tile_alloc((size_t)iroi_full.width * iroi_full.height * in_bpp);
       if(input == NULL)
       {
         dt_print(DT_DEBUG_TILING,
@@ -1087,7 +1179,7 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
                  dt_dev_pixelpipe_type_to_str(piece->pipe->type), self->op, dt_iop_get_instance_id(self));
         goto error;
       }
-      output = dt_alloc_aligned((size_t)oroi_full.width * oroi_full.height * out_bpp);
+      output = _tile_alloc((size_t)oroi_full.width * oroi_full.height * out_bpp);
       if(output == NULL)
       {
         dt_print(DT_DEBUG_TILING,
@@ -1107,6 +1199,7 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
 
       /* call process() of module */
       self->process(self, piece, input, output, &iroi_full, &oroi_full);
+      dt_dev_pixelpipe_scratch_reset(piece->pipe);
 
       /* aggregate resulting processed_maximum */
       /* TODO: check if there really can be differences between tiles and take
@@ -1129,16 +1222,16 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
                (char *)output + ((j + origin_y) * oroi_full.width + origin_x) * out_bpp,
                (size_t)oroi_good.width * out_bpp);
 
-      dt_free_align(input);
-      dt_free_align(output);
+      _tile_free(input);
+      _tile_free(output);
       input = output = NULL;
     }
 
   /* copy back final processed_maximum */
   for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
 
-  dt_free_align(input);
-  dt_free_align(output);
+  _tile_free(input);
+  _tile_free(output);
   piece->pipe->tiling = FALSE;
   return;
 
@@ -1148,8 +1241,8 @@ error:
 // fall through
 
 fallback:
-  dt_free_align(input);
-  dt_free_align(output);
+  _tile_free(input);
+  _tile_free(output);
   piece->pipe->tiling = FALSE;
   dt_print(DT_DEBUG_TILING,
            "[default_process_tiling_roi] [%s] fall back to standard processing for module '%s%s'",
@@ -1182,6 +1275,606 @@ void default_process_tiling(dt_iop_module_t *self,
 }
 
 #ifdef HAVE_OPENCL
+/* cooperative tiling for the ptp case: the tiles of one module are shared
+   between the device of the pipe, other idle OpenCL devices and optionally
+   the CPU. every worker runs on private copies of pipe and piece as process()
+   and process_cl() take the device and processed_maximum from there.
+   the good parts of the tiles don't overlap so workers write the output directly.
+*/
+typedef struct _coop_tiling_t
+{
+  dt_iop_module_t *self;
+  dt_dev_pixelpipe_t *pipe; // the original one, only for shutdown requests
+  const void *ivoid;
+  void *ovoid;
+  const dt_iop_roi_t *roi_in;
+  const dt_iop_roi_t *roi_out;
+  int in_bpp, out_bpp, ipitch, opitch;
+  int width, height, tile_wd, tile_ht, overlap;
+  int tiles_x, tiles_y;
+  dt_aligned_pixel_t processed_maximum;
+  dt_atomic_int next;
+  gboolean *done; // each tile is written by exactly one worker
+} _coop_tiling_t;
+
+typedef struct _coop_worker_t
+{
+  _coop_tiling_t *c;
+  int devid;
+  dt_dev_pixelpipe_t pipe;
+  dt_dev_pixelpipe_iop_t piece;
+  void *input;      // cl_mem for devices, host memory for the CPU
+  void *output;
+  size_t buf_w, buf_h;
+  int tiles;
+  cl_int err;
+  pthread_t thread;
+} _coop_worker_t;
+
+static void _coop_worker_release(_coop_worker_t *w)
+{
+  if(w->devid > DT_DEVICE_CPU)
+  {
+    dt_opencl_release_mem_object(w->input);
+    dt_opencl_release_mem_object(w->output);
+  }
+  else
+  {
+    _tile_free(w->input);
+    _tile_free(w->output);
+  }
+  w->input = w->output = NULL;
+  w->buf_w = w->buf_h = 0;
+}
+
+static cl_int _coop_process_tile(_coop_worker_t *w, const int k)
+{
+  _coop_tiling_t *c = w->c;
+  const int devid = w->devid;
+  const size_t tx = k / c->tiles_y;
+  const size_t ty = k % c->tiles_y;
+  const size_t wd = tx * c->tile_wd + c->width > c->roi_in->width
+    ? c->roi_in->width - tx * c->tile_wd : c->width;
+  const size_t ht = ty * c->tile_ht + c->height > c->roi_in->height
+    ? c->roi_in->height - ty * c->tile_ht : c->height;
+
+  /* no need to process (end)tiles that are smaller than the total overlap area */
+  if((wd <= 2 * c->overlap && tx > 0) || (ht <= 2 * c->overlap && ty > 0))
+    return CL_SUCCESS;
+
+  size_t origin[2] = { 0, 0 };
+  size_t region[2] = { wd, ht };
+  const dt_iop_roi_t iroi = { c->roi_in->x + tx * c->tile_wd, c->roi_in->y + ty * c->tile_ht,
+                              wd, ht, c->roi_in->scale };
+  const dt_iop_roi_t oroi = { c->roi_out->x + tx * c->tile_wd, c->roi_out->y + ty * c->tile_ht,
+                              wd, ht, c->roi_out->scale };
+  const size_t ioffs = (ty * c->tile_ht) * c->ipitch + (tx * c->tile_wd) * c->in_bpp;
+  size_t ooffs = (ty * c->tile_ht) * c->opitch + (tx * c->tile_wd) * c->out_bpp;
+
+  dt_print_pipe(DT_DEBUG_TILING, "  tile coop", &w->pipe, c->self, devid, &iroi, &oroi,
+                "tile (%zu,%zu)", tx, ty);
+
+  if(w->buf_w != wd || w->buf_h != ht)
+  {
+    _coop_worker_release(w);
+    if(devid > DT_DEVICE_CPU)
+    {
+      w->input = dt_opencl_alloc_device(devid, wd, ht, c->in_bpp);
+      w->output = dt_opencl_alloc_device(devid, wd, ht, c->out_bpp);
+    }
+    else
+    {
+      w->input = _tile_alloc(wd * ht * c->in_bpp);
+      w->output = _tile_alloc(wd * ht * c->out_bpp);
+    }
+    if(w->input == NULL || w->output == NULL)
+      return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    w->buf_w = wd;
+    w->buf_h = ht;
+  }
+
+  /* take original processed_maximum as starting point */
+  for_four_channels(n) w->pipe.dsc.processed_maximum[n] = c->processed_maximum[n];
+  dt_dev_prepare_piece_cfa(&w->piece, &iroi);
+
+  if(devid > DT_DEVICE_CPU)
+  {
+    cl_int err = dt_opencl_write_host_to_image_raw(devid, (char *)c->ivoid + ioffs, w->input,
+                                                   origin, region, c->ipitch, TRUE);
+    if(err != CL_SUCCESS) return err;
+    err = c->self->process_cl(c->self, &w->piece, w->input, w->output, &iroi, &oroi);
+    if(err != CL_SUCCESS) return err;
+  }
+  else
+  {
+    for(size_t j = 0; j < ht; j++)
+      memcpy((char *)w->input + j * wd * c->in_bpp, (char *)c->ivoid + ioffs + j * c->ipitch,
+             wd * c->in_bpp);
+    c->self->process(c->self, &w->piece, w->input, w->output, &iroi, &oroi);
+    dt_dev_pixelpipe_scratch_reset(&w->pipe);
+  }
+
+  /* correct origin and region of tile for overlap.
+     makes sure that we only copy back the "good" part. */
+  if(tx > 0)
+  {
+    origin[0] += c->overlap;
+    region[0] -= c->overlap;
+    ooffs += (size_t)c->overlap * c->out_bpp;
+  }
+  if(ty > 0)
+  {
+    origin[1] += c->overlap;
+    region[1] -= c->overlap;
+    ooffs += (size_t)c->overlap * c->opitch;
+  }
+
+  if(devid > DT_DEVICE_CPU)
+  {
+    const cl_int err = dt_opencl_read_host_from_image_raw(devid, (char *)c->ovoid + ooffs, w->output,
+                                                          origin, region, c->opitch, TRUE);
+    if(err != CL_SUCCESS) return err;
+    dt_opencl_finish_sync_pipe(devid, w->pipe.type);
+  }
+  else
+  {
+    for(size_t j = 0; j < region[1]; j++)
+      memcpy((char *)c->ovoid + ooffs + j * c->opitch,
+             (char *)w->output + ((j + origin[1]) * wd + origin[0]) * c->out_bpp,
+             region[0] * c->out_bpp);
+  }
+  return CL_SUCCESS;
+}
+
+static inline gboolean _coop_shutdown(_coop_tiling_t *c)
+{
+  return dt_atomic_get_int(&c->pipe->shutdown) != DT_DEV_PIXELPIPE_STOP_NO;
+}
+
+static void *_coop_worker_run(void *data)
+{
+  _coop_worker_t *w = data;
+  _coop_tiling_t *c = w->c;
+  const int count = c->tiles_x * c->tiles_y;
+
+  int k;
+  while(w->err == CL_SUCCESS
+        && !_coop_shutdown(c)
+        && (k = dt_atomic_add_int(&c->next, 1)) < count)
+  {
+    w->err = _coop_process_tile(w, k);
+    c->done[k] = w->err == CL_SUCCESS;
+    if(c->done[k]) w->tiles++;
+  }
+  _coop_worker_release(w);
+  dt_dev_pixelpipe_scratch_cleanup(&w->pipe);
+  return NULL;
+}
+
+static void _coop_worker_init(_coop_worker_t *w,
+                              _coop_tiling_t *c,
+                              dt_dev_pixelpipe_iop_t *piece,
+                              const int devid)
+{
+  w->c = c;
+  w->devid = devid;
+  w->pipe = *piece->pipe;
+  w->pipe.devid = devid;
+  // every worker has its own scratch arena
+  memset(&w->pipe.scratch, 0, sizeof(w->pipe.scratch));
+  w->piece = *piece;
+  w->piece.pipe = &w->pipe;
+}
+
+/* returns DT_OPENCL_NODEVICE if there is nobody to cooperate with */
+static int _default_process_tiling_cl_ptp_coop(dt_iop_module_t *self,
+                                               dt_dev_pixelpipe_iop_t *piece,
+                                               const void *const ivoid,
+                                               void *const ovoid,
+                                               const dt_iop_roi_t *const roi_in,
+                                               const dt_iop_roi_t *const roi_out,
+                                               const int in_bpp,
+                                               const int out_bpp,
+                                               const dt_develop_tiling_t *tiling,
+                                               const int width,
+                                               const int height,
+                                               const int overlap,
+                                               const int tile_wd,
+                                               const int tile_ht,
+                                               const int tiles_x,
+                                               const int tiles_y)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  const int devid = piece->pipe->devid;
+  const int max_bpp = MAX(in_bpp, out_bpp);
+  static dt_conf_handle_t *coop_cpu = NULL;
+  if(!coop_cpu) coop_cpu = dt_conf_handle("opencl_cooperative_tiling_cpu", DT_BOOL);
+  const gboolean use_cpu = dt_conf_handle_get_bool(coop_cpu)
+    && dt_tiling_piece_fits_host_memory(piece, width, height, max_bpp,
+                                        tiling->factor, tiling->overhead);
+
+  // workers: the pipe's device, all idle devices the tiles fit onto and the CPU
+  _coop_worker_t *workers = calloc(cl->num_devs + 1, sizeof(_coop_worker_t));
+  if(!workers) return DT_OPENCL_NODEVICE;
+
+  _coop_tiling_t c = {
+    .self = self, .pipe = piece->pipe, .ivoid = ivoid, .ovoid = ovoid, .roi_in = roi_in, .roi_out = roi_out,
+    .in_bpp = in_bpp, .out_bpp = out_bpp,
+    .ipitch = roi_in->width * in_bpp, .opitch = roi_out->width * out_bpp,
+    .width = width, .height = height, .tile_wd = tile_wd, .tile_ht = tile_ht,
+    .overlap = overlap, .tiles_x = tiles_x, .tiles_y = tiles_y,
+  };
+  for_four_channels(k) c.processed_maximum[k] = piece->pipe->dsc.processed_maximum[k];
+
+  int num = 0;
+  _coop_worker_init(&workers[num++], &c, piece, devid);
+  int helper;
+  while(num < cl->num_devs && (helper = dt_opencl_lock_idle_device()) != DT_DEVICE_CPU)
+  {
+    if(!dt_opencl_image_fits_device(helper, width, height, max_bpp,
+                                    tiling->factor_cl, tiling->overhead))
+    {
+      dt_opencl_unlock_device(helper);
+      break;
+    }
+    dt_opencl_events_reset(helper);
+    _coop_worker_init(&workers[num++], &c, piece, helper);
+  }
+  if(use_cpu)
+    _coop_worker_init(&workers[num++], &c, piece, DT_DEVICE_CPU);
+
+  if(num == 1)
+  {
+    free(workers);
+    return DT_OPENCL_NODEVICE;
+  }
+
+  const int count = tiles_x * tiles_y;
+  c.done = calloc(count, sizeof(gboolean));
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_TILING,
+                "default *tiled* cl_ptp coop", piece->pipe, self, devid, roi_in, roi_out,
+                "%dx%d tiles on %d workers%s, size=%dx%d, overlap=%d",
+                tiles_x, tiles_y, num, use_cpu ? " incl. CPU" : "", tile_wd, tile_ht, overlap);
+
+  piece->pipe->tiling = TRUE;
+  // the pipe's device works in this thread, the others get their own
+  for(int k = 1; k < num; k++)
+    if(dt_pthread_create(&workers[k].thread, _coop_worker_run, &workers[k]))
+      workers[k].err = DT_OPENCL_NODEVICE;
+  _coop_worker_run(&workers[0]);
+
+  for(int k = 1; k < num; k++)
+  {
+    if(workers[k].err == DT_OPENCL_NODEVICE) continue;
+    dt_pthread_join(workers[k].thread);
+    if(workers[k].devid > DT_DEVICE_CPU)
+    {
+      if(dt_opencl_events_flush(workers[k].devid, TRUE) != CL_SUCCESS)
+        workers[k].err = DT_OPENCL_DEFAULT_ERROR;
+      dt_opencl_unlock_device(workers[k].devid);
+    }
+    dt_print(DT_DEBUG_TILING, "[default_process_tiling_cl_ptp_coop] worker %s did %d tiles%s",
+             workers[k].devid > DT_DEVICE_CPU ? cl->dev[workers[k].devid].fullname : "CPU",
+             workers[k].tiles, workers[k].err != CL_SUCCESS ? ", failed" : "");
+  }
+
+  // the pipe's device takes care of tiles a helper failed on
+  _coop_worker_t *own = &workers[0];
+  for(int k = 0; k < count && own->err == CL_SUCCESS; k++)
+  {
+    if(c.done[k] || _coop_shutdown(&c)) continue;
+    own->err = _coop_process_tile(own, k);
+  }
+  _coop_worker_release(own);
+
+  const cl_int err = own->err;
+  // all tiles started from the same processed_maximum
+  for_four_channels(k)
+    piece->pipe->dsc.processed_maximum[k] = err == CL_SUCCESS
+      ? own->pipe.dsc.processed_maximum[k]
+      : c.processed_maximum[k];
+  piece->pipe->tiling = FALSE;
+
+  free(c.done);
+  free(workers);
+  return err;
+}
+
+/* double buffered tiling for the ptp case: while tile N is processed on the command queue of
+   the device, the transfer queue reads back tile N-1 and uploads tile N+1 via pinned staging
+   buffers so the device doesn't idle during host<->device transfers.
+*/
+typedef struct _async_slot_t
+{
+  cl_mem input;
+  cl_mem output;
+  size_t wd, ht;
+  cl_mem pinned_input;
+  cl_mem pinned_output;
+  void *input_buffer;
+  void *output_buffer;
+  cl_event written;   // upload of the tile has finished
+  cl_event processed; // process_cl() of the tile has finished
+  cl_event read;      // readback of the tile has finished
+} _async_slot_t;
+
+typedef struct _async_tiling_t
+{
+  const dt_iop_roi_t *roi_in;
+  const dt_iop_roi_t *roi_out;
+  int width, height, tile_wd, tile_ht, overlap, tiles_y;
+} _async_tiling_t;
+
+static inline void _async_tile(const _async_tiling_t *t,
+                               const int k,
+                               size_t *tx,
+                               size_t *ty,
+                               size_t *wd,
+                               size_t *ht)
+{
+  *tx = k / t->tiles_y;
+  *ty = k % t->tiles_y;
+  *wd = *tx * t->tile_wd + t->width > t->roi_in->width ? t->roi_in->width - *tx * t->tile_wd : t->width;
+  *ht = *ty * t->tile_ht + t->height > t->roi_in->height ? t->roi_in->height - *ty * t->tile_ht : t->height;
+}
+
+static void _async_slot_drain(_async_slot_t *sl)
+{
+  dt_opencl_wait_event(&sl->written);
+  dt_opencl_wait_event(&sl->processed);
+  dt_opencl_wait_event(&sl->read);
+}
+
+static void _async_slot_release(const int devid, _async_slot_t *sl)
+{
+  _async_slot_drain(sl);
+  if(sl->input_buffer) dt_opencl_unmap_mem_object(devid, sl->pinned_input, sl->input_buffer);
+  if(sl->output_buffer) dt_opencl_unmap_mem_object(devid, sl->pinned_output, sl->output_buffer);
+  dt_opencl_release_mem_object(sl->pinned_input);
+  dt_opencl_release_mem_object(sl->pinned_output);
+  dt_opencl_release_mem_object(sl->input);
+  dt_opencl_release_mem_object(sl->output);
+}
+
+static cl_int _async_upload(const int devid,
+                            const _async_tiling_t *t,
+                            _async_slot_t *sl,
+                            const int k,
+                            const void *const ivoid,
+                            const int in_bpp,
+                            const int out_bpp)
+{
+  size_t tx, ty, wd, ht;
+  _async_tile(t, k, &tx, &ty, &wd, &ht);
+
+  /* the staging buffer is free again once the last upload from it has finished */
+  cl_int err = dt_opencl_wait_event(&sl->written);
+  if(err != CL_SUCCESS) return err;
+
+  if(sl->wd != wd || sl->ht != ht)
+  {
+    /* commands still using the old tiles keep them alive until they are done */
+    dt_opencl_release_mem_object(sl->input);
+    dt_opencl_release_mem_object(sl->output);
+    sl->input = dt_opencl_alloc_device(devid, wd, ht, in_bpp);
+    sl->output = dt_opencl_alloc_device(devid, wd, ht, out_bpp);
+    if(sl->input == NULL || sl->output == NULL) return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    sl->wd = wd;
+    sl->ht = ht;
+  }
+
+  const int ipitch = t->roi_in->width * in_bpp;
+  const size_t ioffs = (ty * t->tile_ht) * ipitch + (tx * t->tile_wd) * in_bpp;
+  DT_OMP_FOR()
+  for(size_t j = 0; j < ht; j++)
+    memcpy((char *)sl->input_buffer + j * wd * in_bpp, (char *)ivoid + ioffs + j * ipitch,
+           (size_t)wd * in_bpp);
+
+  /* the previous tile of this slot must have been processed before its input gets overwritten */
+  const size_t region[2] = { wd, ht };
+  return dt_opencl_write_host_to_image_async(devid, sl->input_buffer, sl->input, NULL, region,
+                                             wd * in_bpp, sl->processed, &sl->written);
+}
+
+static cl_int _async_download(const int devid,
+                              const _async_tiling_t *t,
+                              _async_slot_t *sl,
+                              const int k,
+                              const int out_bpp)
+{
+  size_t tx, ty, wd, ht;
+  _async_tile(t, k, &tx, &ty, &wd, &ht);
+  const size_t region[2] = { wd, ht };
+  return dt_opencl_read_host_from_image_async(devid, sl->output_buffer, sl->output, NULL, region,
+                                              wd * out_bpp, sl->processed, &sl->read);
+}
+
+static cl_int _async_store(const _async_tiling_t *t,
+                           _async_slot_t *sl,
+                           const int k,
+                           void *const ovoid,
+                           const int out_bpp)
+{
+  cl_int err = dt_opencl_wait_event(&sl->read);
+  if(err == CL_SUCCESS) err = dt_opencl_wait_event(&sl->processed);
+  if(err != CL_SUCCESS) return err;
+
+  size_t tx, ty, wd, ht;
+  _async_tile(t, k, &tx, &ty, &wd, &ht);
+
+  const int opitch = t->roi_out->width * out_bpp;
+  size_t ooffs = (ty * t->tile_ht) * opitch + (tx * t->tile_wd) * out_bpp;
+  size_t origin[2] = { 0, 0 };
+  size_t region[2] = { wd, ht };
+
+  /* correct origin and region of tile for overlap.
+     makes sure that we only copy back the "good" part. */
+  if(tx > 0)
+  {
+    origin[0] += t->overlap;
+    region[0] -= t->overlap;
+    ooffs += (size_t)t->overlap * out_bpp;
+  }
+  if(ty > 0)
+  {
+    origin[1] += t->overlap;
+    region[1] -= t->overlap;
+    ooffs += (size_t)t->overlap * opitch;
+  }
+
+  for(size_t j = 0; j < region[1]; j++)
+    memcpy((char *)ovoid + ooffs + j * opitch,
+           (char *)sl->output_buffer + ((j + origin[1]) * wd + origin[0]) * out_bpp,
+           (size_t)region[0] * out_bpp);
+  return CL_SUCCESS;
+}
+
+/* returns DT_OPENCL_NODEVICE if the staging buffers are not available */
+static int _default_process_tiling_cl_ptp_async(dt_iop_module_t *self,
+                                                dt_dev_pixelpipe_iop_t *piece,
+                                                const void *const ivoid,
+                                                void *const ovoid,
+                                                const dt_iop_roi_t *const roi_in,
+                                                const dt_iop_roi_t *const roi_out,
+                                                const int in_bpp,
+                                                const int out_bpp,
+                                                const int width,
+                                                const int height,
+                                                const int overlap,
+                                                const int tile_wd,
+                                                const int tile_ht,
+                                                const int tiles_x,
+                                                const int tiles_y)
+{
+  const int devid = piece->pipe->devid;
+  const _async_tiling_t t = { roi_in, roi_out, width, height, tile_wd, tile_ht, overlap, tiles_y };
+
+  /* no need to process (end)tiles that are smaller than the total overlap area */
+  int *tiles = malloc(sizeof(int) * tiles_x * tiles_y);
+  if(!tiles) return DT_OPENCL_NODEVICE;
+  int count = 0;
+  for(int k = 0; k < tiles_x * tiles_y; k++)
+  {
+    size_t tx, ty, wd, ht;
+    _async_tile(&t, k, &tx, &ty, &wd, &ht);
+    if((wd <= 2 * overlap && tx > 0) || (ht <= 2 * overlap && ty > 0)) continue;
+    tiles[count++] = k;
+  }
+
+  _async_slot_t slot[2] = { { 0 } };
+  gboolean staged = TRUE;
+  for(int s = 0; s < 2 && staged; s++)
+  {
+    const size_t isize = (size_t)width * height * in_bpp;
+    const size_t osize = (size_t)width * height * out_bpp;
+    slot[s].pinned_input = dt_opencl_alloc_device_buffer_with_flags(devid, isize, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR);
+    slot[s].pinned_output = dt_opencl_alloc_device_buffer_with_flags(devid, osize, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR);
+    if(slot[s].pinned_input)
+      slot[s].input_buffer = dt_opencl_map_buffer(devid, slot[s].pinned_input, TRUE, CL_MAP_WRITE, 0, isize);
+    if(slot[s].pinned_output)
+      slot[s].output_buffer = dt_opencl_map_buffer(devid, slot[s].pinned_output, TRUE, CL_MAP_READ, 0, osize);
+    staged = slot[s].input_buffer && slot[s].output_buffer;
+  }
+
+  if(!staged || count == 0)
+  {
+    for(int s = 0; s < 2; s++) _async_slot_release(devid, &slot[s]);
+    free(tiles);
+    if(!staged)
+      dt_print(DT_DEBUG_OPENCL | DT_DEBUG_TILING,
+               "[default_process_tiling_cl_ptp_async] [%s] could not map pinned staging buffers "
+               "for module '%s%s'",
+               dt_dev_pixelpipe_type_to_str(piece->pipe->type), self->op, dt_iop_get_instance_id(self));
+    return staged ? CL_SUCCESS : DT_OPENCL_NODEVICE;
+  }
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_TILING,
+                "default *tiled* cl_ptp async", piece->pipe, piece->module, devid, roi_in, roi_out,
+                "%dx%d tiles, size=%dx%d, overlap=%d",
+                tiles_x, tiles_y, tile_wd, tile_ht, overlap);
+
+  /* store processed_maximum to be re-used and aggregated */
+  dt_aligned_pixel_t processed_maximum_saved;
+  dt_aligned_pixel_t processed_maximum_new = { 1.0f };
+  for_four_channels(k) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
+
+  piece->pipe->tiling = TRUE;
+
+  cl_int err = _async_upload(devid, &t, &slot[0], tiles[0], ivoid, in_bpp, out_bpp);
+  for(int i = 0; i < count && err == CL_SUCCESS; i++)
+  {
+    _async_slot_t *cur = &slot[i & 1];
+    _async_slot_t *other = &slot[(i + 1) & 1];
+
+    size_t tx, ty, wd, ht;
+    _async_tile(&t, tiles[i], &tx, &ty, &wd, &ht);
+    const dt_iop_roi_t iroi = { roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
+    const dt_iop_roi_t oroi = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
+
+    dt_print_pipe(DT_DEBUG_TILING,
+                  "  tile cl_ptp async", piece->pipe, piece->module, devid, &iroi, &oroi,
+                  "tile (%zu,%zu)", tx, ty);
+
+    /* process tile i as soon as it has arrived on the device */
+    err = dt_opencl_enqueue_wait_event(devid, cur->written);
+    if(err != CL_SUCCESS) break;
+
+    /* take original processed_maximum as starting point */
+    for_four_channels(k) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
+    dt_dev_prepare_piece_cfa(piece, &iroi);
+    err = self->process_cl(self, piece, cur->input, cur->output, &iroi, &oroi);
+    if(err != CL_SUCCESS) break;
+
+    /* aggregate resulting processed_maximum */
+    for(int k = 0; k < 4; k++)
+    {
+      if(i > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
+        dt_print(DT_DEBUG_TILING,
+                 "[default_process_tiling_cl_ptp_async] [%s] processed_maximum[%d] differs between tiles in module '%s%s'",
+                 dt_dev_pixelpipe_type_to_str(piece->pipe->type), k, self->op, dt_iop_get_instance_id(self));
+      processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
+    }
+
+    err = dt_opencl_enqueue_marker(devid, &cur->processed);
+    if(err != CL_SUCCESS) break;
+
+    /* meanwhile the transfer queue reads back tile i-1 and uploads tile i+1 */
+    if(i > 0) err = _async_download(devid, &t, other, tiles[i - 1], out_bpp);
+    if(err == CL_SUCCESS && i + 1 < count)
+      err = _async_upload(devid, &t, other, tiles[i + 1], ivoid, in_bpp, out_bpp);
+    if(err == CL_SUCCESS && i > 0)
+      err = _async_store(&t, other, tiles[i - 1], ovoid, out_bpp);
+  }
+
+  if(err == CL_SUCCESS)
+  {
+    _async_slot_t *last = &slot[(count - 1) & 1];
+    err = _async_download(devid, &t, last, tiles[count - 1], out_bpp);
+    if(err == CL_SUCCESS) err = _async_store(&t, last, tiles[count - 1], ovoid, out_bpp);
+  }
+
+  for(int s = 0; s < 2; s++) _async_slot_release(devid, &slot[s]);
+  free(tiles);
+
+  /* block until opencl queue has finished to free all used event handlers */
+  dt_opencl_finish_sync_pipe(devid, piece->pipe->type);
+
+  /* copy back final or stored processed_maximum */
+  for_four_channels(k)
+    piece->pipe->dsc.processed_maximum[k] = err == CL_SUCCESS ? processed_maximum_new[k]
+                                                              : processed_maximum_saved[k];
+  piece->pipe->tiling = FALSE;
+
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_TILING | DT_DEBUG_OPENCL,
+             "[default_process_tiling_cl_ptp_async] [%s] couldn't run process_cl() for "
+             "module '%s%s' in tiling mode: %s",
+             dt_dev_pixelpipe_type_to_str(piece->pipe->type), self->op, dt_iop_get_instance_id(self),
+             cl_errstr(err));
+  return err;
+}
+
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
 static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
                                           dt_dev_pixelpipe_iop_t *piece,
@@ -1220,53 +1913,23 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
 
   /* shall we use pinned memory transfers? */
   gboolean use_pinned_memory = dt_opencl_use_pinned_memory(devid);
+  /* overlapping transfers and processing needs two sets of tile and staging buffers */
+  const gboolean use_async = use_pinned_memory && dt_opencl_use_async_transfers(devid);
   /* If using pinned transfer on devices with dedicated GPU mem there is an additional
      mem pressure as they will allocate also on device as cache for performance
   */
-  const float pinned_buffer_overhead = use_pinned_memory && !dt_opencl_unified_memory(devid) ? 2.0f : 0.0f;
+  const float pinned_buffer_overhead = use_pinned_memory && !dt_opencl_unified_memory(devid)
+    ? (use_async ? 4.0f : 2.0f)
+    : 0.0f;
+  const float async_overhead = use_async ? 2.0f : 0.0f;
 
   // avoid problems when pinned buffer size gets too close to max_mem_alloc size
   const float pinned_buffer_slack = use_pinned_memory ? 0.85f : 1.0f;
   const float available = (float)dt_opencl_get_device_available(devid);
-  const float factor = fmaxf(tiling.factor_cl + pinned_buffer_overhead, 1.0f);
+  const float factor = fmaxf(tiling.factor_cl + pinned_buffer_overhead + async_overhead, 1.0f);
   const float singlebuffer = fminf(fmaxf((available - tiling.overhead) / factor, 0.0f),
                                   pinned_buffer_slack * (float)(dt_opencl_get_device_memalloc(devid)));
   const float maxbuf = fmaxf(tiling.maxbuf_cl, 1.0f);
-  int width = MIN(roi_in->width, darktable.opencl->dev[devid].max_image_width);
-  int height = MIN(roi_in->height, darktable.opencl->dev[devid].max_image_height);
-
-  /* shrink tile size in case it would exceed singlebuffer size */
-  if((float)width * height * max_bpp * maxbuf > singlebuffer)
-  {
-    const float scale = singlebuffer / ((float)width * height * max_bpp * maxbuf);
-
-    if(width < height && scale >= 0.333f)
-    {
-      height = floorf(height * scale);
-    }
-    else if(height <= width && scale >= 0.333f)
-    {
-      width = floorf(width * scale);
-    }
-    else
-    {
-      width = floorf(width * sqrtf(scale));
-      height = floorf(height * sqrtf(scale));
-    }
-    dt_print(DT_DEBUG_TILING | DT_DEBUG_VERBOSE,
-             "[default_process_tiling_cl_ptp] [%s] buffer exceeds singlebuffer, corrected to %dx%d",
-             dt_dev_pixelpipe_type_to_str(piece->pipe->type), width, height);
-  }
-
-  /* make sure we have a reasonably effective tile dimension. if not try square tiles */
-  if(3 * tiling.overlap > width || 3 * tiling.overlap > height)
-  {
-    width = height = floorf(sqrtf((float)width * height));
-    dt_print(DT_DEBUG_TILING | DT_DEBUG_VERBOSE,
-             "[default_process_tiling_cl_ptp] [%s] use squares because of overlap, corrected to %dx%d",
-             dt_dev_pixelpipe_type_to_str(piece->pipe->type), width, height);
-  }
-
   /* Alignment rules: we need to make sure that alignment requirements of module are fulfilled.
      Modules will report alignment requirements via align within tiling_callback().
      Additional alignment requirements are set via dt_opencl_tiling_align().
@@ -1279,32 +1942,66 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
   const unsigned int halign = align;
   assert(align != 0 && walign != 0 && halign != 0);
 
-  /* properly align tile width and height by making them smaller if needed */
-  if(width < roi_in->width) width = (width / walign) * walign;
-  if(height < roi_in->height) height = (height / halign) * halign;
-
   /* also make sure that overlap follows alignment rules by making it wider when needed */
   const int overlap = tiling.overlap % align != 0 ? (tiling.overlap / align + 1) * align
                                                     : tiling.overlap;
 
-  /* calculate effective tile size */
-  const int tile_wd = width - 2 * overlap > 0 ? width - 2 * overlap : 1;
-  const int tile_ht = height - 2 * overlap > 0 ? height - 2 * overlap : 1;
-
-  /* calculate number of tiles */
-  const int tiles_x = width < roi_in->width ? ceilf(roi_in->width / (float)tile_wd) : 1;
-  const int tiles_y = height < roi_in->height ? ceilf(roi_in->height / (float)tile_ht) : 1;
+  /* pick the cheapest tile grid fitting the device. every tile is a host
+     to device round trip plus kernel launches, so small tiles cost more
+     than on the CPU. any grid that fits keeps the module on the GPU and
+     only if there is none we fall back to the CPU. */
+  _tile_plan_t plan = { 0 };
+  const gboolean planned =
+    _plan_tiles(roi_in->width, roi_in->height,
+                darktable.opencl->dev[devid].max_image_width,
+                darktable.opencl->dev[devid].max_image_height,
+                singlebuffer / ((float)max_bpp * maxbuf), overlap, walign, halign,
+                dt_opencl_unified_memory(devid) ? 0.1f : 0.5f, 256.0f * 1024.0f, &plan);
+
+  const int width = plan.width;
+  const int height = plan.height;
+  const int tile_wd = plan.tile_wd;
+  const int tile_ht = plan.tile_ht;
+  const int tiles_x = plan.tiles_x;
+  const int tiles_y = plan.tiles_y;
 
   /* sanity check: don't run wild on too many tiles */
-  if(tiles_x * tiles_y > _maximum_number_tiles())
+  if(!planned)
   {
     dt_print(DT_DEBUG_TILING,
              "[default_process_tiling_cl_ptp] [%s] aborted tiling for module '%s%s'. "
-             "too many tiles: %d x %d",
+             "no tile grid fits with overlap %d",
              dt_dev_pixelpipe_type_to_str(piece->pipe->type),
-             self->op, dt_iop_get_instance_id(self), tiles_x, tiles_y);
+             self->op, dt_iop_get_instance_id(self), overlap);
     return DT_OPENCL_PROCESS_CL;
   }
+  piece->pipe->tiles = tiles_x * tiles_y;
+  dt_print(DT_DEBUG_TILING,
+           "[tiling planner] [%s] module '%s%s' GPU: %dx%d tiles of %dx%d, overlap %d,"
+           " %.0f%% redundant pixels",
+           dt_dev_pixelpipe_type_to_str(piece->pipe->type), self->op, dt_iop_get_instance_id(self),
+           tiles_x, tiles_y, width, height, overlap, 100.0f * plan.redundant);
+
+  /* share the tiles of huge exports with other idle devices */
+  static dt_conf_handle_t *coop = NULL;
+  if(!coop) coop = dt_conf_handle("opencl_cooperative_tiling", DT_BOOL);
+  if(tiles_x * tiles_y > 1
+     && (piece->pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+     && dt_conf_handle_get_bool(coop))
+  {
+    const int coop = _default_process_tiling_cl_ptp_coop(self, piece, ivoid, ovoid, roi_in, roi_out,
+                                                         in_bpp, out_bpp, &tiling, width, height,
+                                                         overlap, tile_wd, tile_ht, tiles_x, tiles_y);
+    if(coop != DT_OPENCL_NODEVICE) return coop;
+  }
+
+  if(use_async && tiles_x * tiles_y > 1)
+  {
+    const int async = _default_process_tiling_cl_ptp_async(self, piece, ivoid, ovoid, roi_in, roi_out,
+                                                           in_bpp, out_bpp, width, height, overlap,
+                                                           tile_wd, tile_ht, tiles_x, tiles_y);
+    if(async != DT_OPENCL_NODEVICE) return async;
+  }
 
   /* store processed_maximum to be re-used and aggregated */
   dt_aligned_pixel_t processed_maximum_saved;
@@ -1653,6 +2350,7 @@ static int _default_process_tiling_cl_roi(dt_iop_module_t *self,
              self->op, dt_iop_get_instance_id(self), tiles_x, tiles_y);
     return DT_OPENCL_PROCESS_CL;
   }
+  piece->pipe->tiles = tiles_x * tiles_y;
 
   /* calculate tile width and height excl. overlap (i.e. the good part) for output.
      important for all following processing steps. */
@@ -1406,28 +1406,88 @@ void dt_culling_init(dt_culling_t *table,
   table->offset_imgid = first_id;
 }
 
-static void _thumbs_prefetch(dt_culling_t *table)
+typedef struct _culling_prefetch_t
 {
-  if(!table->list) return;
+  dt_culling_t *table;
+  dt_imgid_t imgid;
+  int generation;
+} _culling_prefetch_t;
+
+// load the 1:1 thumbnail of a neighbour image, so that zooming into it
+// once it is shown does not wait for the pipe
+static int32_t _culling_prefetch_job_run(dt_job_t *job)
+{
+  const _culling_prefetch_t *params = dt_control_job_get_params(job);
 
-  // get the mip level by using the max image size actually shown
-  int maxw = 0;
-  int maxh = 0;
-  for(GList *l = table->list; l; l = g_list_next(l))
+  // the user has moved on while the job was queued
+  if(params->generation != dt_atomic_get_int(&params->table->prefetch_generation))
+    return 0;
+
+  int w = 0, h = 0;
+  dt_image_get_final_size(params->imgid, &w, &h);
+  if(w <= 0 || h <= 0) return 0;
+
+  const dt_mipmap_size_t mip =
+    dt_mipmap_cache_get_matching_size(w * darktable.gui->ppd, h * darktable.gui->ppd);
+
+  // keep within the memory cap and leave most of the thumbnail cache to
+  // what is displayed
+  const size_t cap = (size_t)MAX(0, dt_conf_get_int("plugins/lighttable/culling_prefetch_mb")) << 20;
+  const size_t bytes = (size_t)darktable.mipmap_cache->max_width[mip]
+                       * darktable.mipmap_cache->max_height[mip] * 4;
+  if(2 * bytes > MIN(cap, darktable.mipmap_cache->mip_thumbs.cache.cost_quota / 2))
   {
-    const dt_thumbnail_t *th = l->data;
-    maxw = MAX(maxw, th->width);
-    maxh = MAX(maxh, th->height);
+    dt_print(DT_DEBUG_LIGHTTABLE,
+             "[culling] no 1:1 prefetch for ID=%d, mip %d exceeds the memory cap",
+             params->imgid, mip);
+    return 0;
   }
-  const int32_t mipwidth = maxw * darktable.gui->ppd;
-  const int32_t mipheight = maxh * darktable.gui->ppd;
-  dt_mipmap_size_t mip =
-    dt_mipmap_cache_get_matching_size(mipwidth, mipheight);
 
-  // prefetch next image
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_set_owner(params->table);
+  dt_mipmap_cache_get(&buf, params->imgid, mip, DT_MIPMAP_BLOCKING_CANCELLABLE, 'r');
+  dt_mipmap_cache_set_owner(NULL);
+  dt_mipmap_cache_release(&buf);
+  return 0;
+}
+
+static void _culling_prefetch_job_add(dt_culling_t *table,
+                                      const dt_imgid_t imgid)
+{
+  dt_job_t *job = dt_control_job_create(&_culling_prefetch_job_run,
+                                        "prefetch image %d at 1:1", imgid);
+  if(!job) return;
+  // calloc, the job queue compares the params with memcmp to drop duplicates
+  _culling_prefetch_t *params = calloc(1, sizeof(_culling_prefetch_t));
+  if(!params)
+  {
+    dt_control_job_dispose(job);
+    return;
+  }
+  params->table = table;
+  params->imgid = imgid;
+  params->generation = dt_atomic_get_int(&table->prefetch_generation);
+  dt_control_job_set_params_with_size(job, params, sizeof(_culling_prefetch_t), free);
+  // behind all requested thumbnails and the first to go if the queue is full
+  dt_control_job_set_speculative(job);
+  dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, job);
+}
+
+static gboolean _list_contains_imgid(GList *list,
+                                     const dt_imgid_t imgid)
+{
+  for(GList *l = list; l; l = g_list_next(l))
+    if(((dt_thumbnail_t *)l->data)->imgid == imgid) return TRUE;
+  return FALSE;
+}
+
+// the image next to rowid in navigation order, after it if next
+static dt_imgid_t _neighbour_image(const dt_culling_t *table,
+                                   const int rowid,
+                                   const gboolean next)
+{
   gchar *query;
   sqlite3_stmt *stmt;
-  dt_thumbnail_t *last = g_list_last(table->list)->data;
   if(table->navigate_inside_selection)
   {
     // clang-format off
@@ -1435,10 +1495,10 @@ static void _thumbs_prefetch(dt_culling_t *table)
       ("SELECT m.imgid"
        " FROM memory.collected_images AS m, main.selected_images AS s"
        " WHERE m.imgid = s.imgid"
-       "   AND m.rowid > %d"
-       " ORDER BY m.rowid "
+       "   AND m.rowid %s %d"
+       " ORDER BY m.rowid %s"
        " LIMIT 1",
-       last->rowid);
+       next ? ">" : "<", rowid, next ? "" : "DESC");
     // clang-format on
   }
   else
@@ -1446,58 +1506,61 @@ static void _thumbs_prefetch(dt_culling_t *table)
     // clang-format off
     query = g_strdup_printf
       ("SELECT m.imgid"
-       " FROM memory.collected_images AS m "
-       " WHERE m.rowid > %d"
-       " ORDER BY m.rowid "
+       " FROM memory.collected_images AS m"
+       " WHERE m.rowid %s %d"
+       " ORDER BY m.rowid %s"
        " LIMIT 1",
-       last->rowid);
+       next ? ">" : "<", rowid, next ? "" : "DESC");
     // clang-format on
   }
+  dt_imgid_t id = NO_IMGID;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
   if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
-    if(dt_is_valid_imgid(id))
-      dt_mipmap_cache_get(NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
-  }
+    id = sqlite3_column_int(stmt, 0);
   sqlite3_finalize(stmt);
   g_free(query);
+  return id;
+}
 
-  // prefetch previous image
-  dt_thumbnail_t *prev = (table->list)->data;
-  if(table->navigate_inside_selection)
-  {
-    // clang-format off
-    query = g_strdup_printf
-      ("SELECT m.imgid"
-       " FROM memory.collected_images AS m, main.selected_images AS s"
-       " WHERE m.imgid = s.imgid"
-       "   AND m.rowid < %d"
-       " ORDER BY m.rowid DESC "
-       " LIMIT 1",
-       prev->rowid);
-    // clang-format on
-  }
-  else
-  {
-    // clang-format off
-    query = g_strdup_printf
-      ("SELECT m.imgid"
-       " FROM memory.collected_images AS m"
-       " WHERE m.rowid < %d"
-       " ORDER BY m.rowid DESC "
-       " LIMIT 1",
-       prev->rowid);
-    // clang-format on
-  }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+static void _thumbs_prefetch(dt_culling_t *table)
+{
+  if(!table->list) return;
+
+  // get the mip level by using the max image size actually shown
+  int maxw = 0;
+  int maxh = 0;
+  for(GList *l = table->list; l; l = g_list_next(l))
   {
-    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
-    if(dt_is_valid_imgid(id))
-      dt_mipmap_cache_get(NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    const dt_thumbnail_t *th = l->data;
+    maxw = MAX(maxw, th->width);
+    maxh = MAX(maxh, th->height);
   }
-  sqlite3_finalize(stmt);
+  const int32_t mipwidth = maxw * darktable.gui->ppd;
+  const int32_t mipheight = maxh * darktable.gui->ppd;
+  dt_mipmap_size_t mip =
+    dt_mipmap_cache_get_matching_size(mipwidth, mipheight);
+
+  // 1:1 prefetches for the previous neighbours are not needed anymore
+  dt_atomic_add_int(&table->prefetch_generation, 1);
+  for(int k = 0; k < 2; k++)
+    if(dt_is_valid_imgid(table->prefetch_ids[k])
+       && !_list_contains_imgid(table->list, table->prefetch_ids[k]))
+      dt_mipmap_cache_cancel(table->prefetch_ids[k], DT_MIPMAP_NONE, table);
+
+  // prefetch next and previous image at the display size, then at 1:1
+  const dt_thumbnail_t *last = g_list_last(table->list)->data;
+  const dt_thumbnail_t *first = table->list->data;
+  table->prefetch_ids[0] = _neighbour_image(table, last->rowid, TRUE);
+  table->prefetch_ids[1] = _neighbour_image(table, first->rowid, FALSE);
+
+  for(int k = 0; k < 2; k++)
+    if(dt_is_valid_imgid(table->prefetch_ids[k]))
+      dt_mipmap_cache_get(NULL, table->prefetch_ids[k], mip, DT_MIPMAP_PREFETCH, 'r');
+
+  if(dt_conf_get_int("plugins/lighttable/culling_prefetch_mb") > 0)
+    for(int k = 0; k < 2; k++)
+      if(dt_is_valid_imgid(table->prefetch_ids[k]))
+        _culling_prefetch_job_add(table, table->prefetch_ids[k]);
 }
 
 static gboolean _thumbs_recreate_list_at(dt_culling_t *table,
@@ -85,6 +85,10 @@ typedef struct dt_culling_t
   gboolean show_tooltips;          // are tooltips visible ?
 
   dt_imgid_t selection; // image selected inside culling (used with selection act_on algorithm)
+
+  // neighbours prefetched at 1:1, the generation drops queued jobs for older ones
+  dt_imgid_t prefetch_ids[2];
+  dt_atomic_int prefetch_generation;
 } dt_culling_t;
 
 dt_culling_t *dt_culling_new(const dt_culling_mode_t mode);
@@ -51,6 +51,135 @@ static void _set_flag(GtkWidget *w,
     gtk_widget_unset_state_flags(w, flag);
 }
 
+// the overlay infos of the images, read a page of thumbnails at a time by
+// dt_thumbnail_prefetch_infos() instead of a few queries per thumbnail.
+// only used from the gui thread, an entry is dropped when its image changes.
+typedef struct _thumb_infos_t
+{
+  int colorlabels; // CPF_LABEL_* flags
+  gboolean altered;
+  gboolean grouped;
+} _thumb_infos_t;
+
+static GHashTable *_thumb_infos = NULL; // imgid -> _thumb_infos_t
+
+static void _thumb_infos_drop_list(const GList *imgs)
+{
+  for(const GList *l = imgs; l; l = g_list_next(l))
+    g_hash_table_remove(_thumb_infos, l->data);
+}
+
+static void _thumb_infos_image_changed(gpointer instance,
+                                       const gpointer imgs,
+                                       gpointer user_data)
+{
+  _thumb_infos_drop_list(imgs);
+}
+
+static void _thumb_infos_collection_changed(gpointer instance,
+                                            dt_collection_change_t query_change,
+                                            dt_collection_properties_t changed_property,
+                                            const gpointer imgs,
+                                            const int next,
+                                            gpointer user_data)
+{
+  _thumb_infos_drop_list(imgs);
+}
+
+static void _thumb_infos_image_updated(gpointer instance,
+                                       const dt_imgid_t imgid,
+                                       gpointer user_data)
+{
+  // no image means all of them
+  if(dt_is_valid_imgid(imgid))
+    g_hash_table_remove(_thumb_infos, GINT_TO_POINTER(imgid));
+  else
+    g_hash_table_remove_all(_thumb_infos);
+}
+
+static void _thumb_infos_init(void)
+{
+  if(_thumb_infos) return;
+  _thumb_infos = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  // connected before the thumbnails so that they read fresh infos
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_IMAGE_INFO_CHANGED, _thumb_infos_image_changed, NULL);
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_COLLECTION_CHANGED, _thumb_infos_collection_changed, NULL);
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, _thumb_infos_image_updated, NULL);
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_IMAGE_REMOVED, _thumb_infos_image_updated, NULL);
+}
+
+// read the infos of the images given by set, a query returning imgid
+// with up to two parameters
+static void _thumb_infos_fetch(const char *set,
+                               const int param1,
+                               const int param2)
+{
+  _thumb_infos_init();
+
+  // altered is DT_HISTORY_HASH_CURRENT in dt_history_hash_get_status()
+  sqlite3_stmt *stmt;
+  // clang-format off
+  gchar *query = g_strdup_printf
+    ("SELECT s.imgid,"
+     "       (SELECT SUM(DISTINCT 1 << color) FROM main.color_labels"
+     "        WHERE imgid = s.imgid),"
+     "       EXISTS (SELECT 1 FROM main.history_hash AS h"
+     "               WHERE h.imgid = s.imgid"
+     "                 AND CASE"
+     "                       WHEN h.basic_hash == h.current_hash THEN 0"
+     "                       WHEN h.auto_hash == h.current_hash THEN 0"
+     "                       WHEN (h.basic_hash IS NULL OR h.current_hash != h.basic_hash)"
+     "                        AND (h.auto_hash IS NULL OR h.current_hash != h.auto_hash)"
+     "                         THEN 1"
+     "                       ELSE 0 END),"
+     "       EXISTS (SELECT 1 FROM main.images AS i, main.images AS o"
+     "               WHERE i.id = s.imgid AND o.group_id = i.group_id AND o.id != i.id)"
+     " FROM (%s) AS s", set);
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, param1);
+  if(sqlite3_bind_parameter_count(stmt) > 1)
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, param2);
+
+  // color label numbers, see colorlabels.h
+  static const int labels[] = { CPF_LABEL_RED, CPF_LABEL_YELLOW, CPF_LABEL_GREEN,
+                                CPF_LABEL_BLUE, CPF_LABEL_PURPLE };
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    _thumb_infos_t *infos = g_malloc0(sizeof(_thumb_infos_t));
+    const int colors = sqlite3_column_int(stmt, 1);
+    for(int k = 0; k < G_N_ELEMENTS(labels); k++)
+      if(colors & (1 << k)) infos->colorlabels |= labels[k];
+    infos->altered = sqlite3_column_int(stmt, 2);
+    infos->grouped = sqlite3_column_int(stmt, 3);
+    g_hash_table_insert(_thumb_infos, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)), infos);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+}
+
+void dt_thumbnail_prefetch_infos(const int first_rowid,
+                                 const int last_rowid)
+{
+  if(last_rowid < first_rowid) return;
+  _thumb_infos_fetch("SELECT imgid FROM memory.collected_images"
+                     " WHERE rowid BETWEEN ?1 AND ?2",
+                     first_rowid, last_rowid);
+}
+
+static const _thumb_infos_t *_thumb_infos_get(const dt_imgid_t imgid)
+{
+  static const _thumb_infos_t none = { 0 };
+  _thumb_infos_init();
+  const _thumb_infos_t *infos = g_hash_table_lookup(_thumb_infos, GINT_TO_POINTER(imgid));
+  if(!infos)
+  {
+    _thumb_infos_fetch("SELECT ?1 AS imgid", imgid, 0);
+    infos = g_hash_table_lookup(_thumb_infos, GINT_TO_POINTER(imgid));
+  }
+  return infos ? infos : &none;
+}
+
 // create a new extended infos line from scratch
 static void _thumb_update_extended_infos_line(dt_thumbnail_t *thumb)
 {
@@ -97,17 +226,24 @@ static void _thumb_update_tags_tooltip(dt_thumbnail_t *thumb)
 
 static void _thumb_update_altered_tooltip(dt_thumbnail_t *thumb)
 {
-  thumb->is_altered = dt_image_altered(thumb->imgid);
+  thumb->is_altered = _thumb_infos_get(thumb->imgid)->altered;
   gtk_widget_set_visible(thumb->w_altered, thumb->is_altered);
-  if(thumb->is_altered)
-  {
-    char *tooltip = dt_history_get_items_as_string(thumb->imgid);
-    if(tooltip)
-    {
-      gtk_widget_set_tooltip_text(thumb->w_altered, tooltip);
-      g_free(tooltip);
-    }
-  }
+  // the history is only read when the tooltip shows up
+  gtk_widget_set_has_tooltip(thumb->w_altered, thumb->is_altered);
+}
+
+static gboolean _event_altered_tooltip(GtkWidget *widget,
+                                       gint x,
+                                       gint y,
+                                       gboolean keyboard_mode,
+                                       GtkTooltip *tooltip,
+                                       dt_thumbnail_t *thumb)
+{
+  char *text = dt_history_get_items_as_string(thumb->imgid);
+  if(!text) return FALSE;
+  gtk_tooltip_set_text(tooltip, text);
+  g_free(text);
+  return TRUE;
 }
 static void _thumb_update_tooltip_text(dt_thumbnail_t *thumb)
 {
@@ -148,11 +284,18 @@ static void _thumb_update_tooltip_text(dt_thumbnail_t *thumb)
 static void _image_update_group_tooltip(dt_thumbnail_t *thumb)
 {
   if(!thumb->w_group) return;
-  if(!thumb->is_grouped)
-  {
-    gtk_widget_set_has_tooltip(thumb->w_group, FALSE);
-    return;
-  }
+  // the group is only read when the tooltip shows up
+  gtk_widget_set_has_tooltip(thumb->w_group, thumb->is_grouped);
+}
+
+static gboolean _event_group_tooltip(GtkWidget *widget,
+                                     gint x,
+                                     gint y,
+                                     gboolean keyboard_mode,
+                                     GtkTooltip *tooltip,
+                                     dt_thumbnail_t *thumb)
+{
+  if(!thumb->is_grouped) return FALSE;
 
   gchar *tt = NULL;
   int nb = 0;
@@ -208,8 +351,9 @@ static void _image_update_group_tooltip(dt_thumbnail_t *thumb)
   g_free(tt);
 
   // let's apply the tooltip
-  gtk_widget_set_tooltip_markup(thumb->w_group, ttf);
+  gtk_tooltip_set_markup(tooltip, ttf);
   g_free(ttf);
+  return TRUE;
 }
 
 static void _thumb_update_rating_class(const dt_thumbnail_t *thumb)
@@ -268,27 +412,11 @@ static void _image_get_infos(dt_thumbnail_t *thumb)
     _thumb_update_rating_class(thumb);
   }
 
-  // colorlabels
-  thumb->colorlabels = 0;
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.get_color);
-  DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.get_color);
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.get_color, 1, thumb->imgid);
+  const _thumb_infos_t *infos = _thumb_infos_get(thumb->imgid);
 
-  while(sqlite3_step(darktable.view_manager->statements.get_color) == SQLITE_ROW)
-  {
-    const int col = sqlite3_column_int(darktable.view_manager->statements.get_color, 0);
-    // we reuse CPF_* flags, as we'll pass them to the paint fct after
-    if(col == 0)
-      thumb->colorlabels |= CPF_LABEL_RED;
-    else if(col == 1)
-      thumb->colorlabels |= CPF_LABEL_YELLOW;
-    else if(col == 2)
-      thumb->colorlabels |= CPF_LABEL_GREEN;
-    else if(col == 3)
-      thumb->colorlabels |= CPF_LABEL_BLUE;
-    else if(col == 4)
-      thumb->colorlabels |= CPF_LABEL_PURPLE;
-  }
+  // colorlabels
+  // we reuse CPF_* flags, as we'll pass them to the paint fct after
+  thumb->colorlabels = infos->colorlabels;
   if(thumb->w_color)
   {
     GtkDarktableThumbnailBtn *btn = (GtkDarktableThumbnailBtn *)thumb->w_color;
@@ -296,17 +424,10 @@ static void _image_get_infos(dt_thumbnail_t *thumb)
   }
 
   // altered
-  thumb->is_altered = dt_image_altered(thumb->imgid);
+  thumb->is_altered = infos->altered;
 
   // grouping
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.get_grouped);
-  DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.get_grouped);
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.get_grouped,
-                            1, thumb->imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.get_grouped,
-                            2, thumb->imgid);
-  thumb->is_grouped =
-    (sqlite3_step(darktable.view_manager->statements.get_grouped) == SQLITE_ROW);
+  thumb->is_grouped = infos->grouped;
 
   // grouping tooltip
   _image_update_group_tooltip(thumb);
@@ -820,6 +941,9 @@ static gboolean _event_image_draw(GtkWidget *widget,
     else
     {
       cairo_surface_t *img_surf = NULL;
+      // a load queued from here belongs to this thumbnail, the thumbtable
+      // cancels it when the thumbnail goes away
+      dt_mipmap_cache_set_owner(thumb);
       if(thumb->zoomable)
       {
         if(thumb->zoom > 1.0f)
@@ -843,6 +967,7 @@ static gboolean _event_image_draw(GtkWidget *widget,
       {
         res = dt_view_image_get_surface(thumb->imgid, image_w, image_h, &img_surf, FALSE);
       }
+      dt_mipmap_cache_set_owner(NULL);
 
       if(res == DT_VIEW_SURFACE_OK || res == DT_VIEW_SURFACE_SMALLER)
       {
@@ -1210,16 +1335,7 @@ void dt_thumbnail_update_selection(dt_thumbnail_t *thumb)
   if(!thumb) return;
   if(!gtk_widget_is_visible(thumb->w_main)) return;
 
-  gboolean selected = FALSE;
-  /* clear and reset statements */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.is_selected);
-  DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.is_selected);
-  /* bind imgid to prepared statements */
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.is_selected,
-                            1, thumb->imgid);
-  /* lets check if imgid is selected */
-  if(sqlite3_step(darktable.view_manager->statements.is_selected) == SQLITE_ROW)
-    selected = TRUE;
+  const gboolean selected = dt_selection_is_selected(darktable.selection, thumb->imgid);
 
   // if there's a change, update the thumb
   dt_thumbnail_set_selection(thumb, selected);
@@ -1671,6 +1787,8 @@ GtkWidget *dt_thumbnail_create_widget(dt_thumbnail_t *thumb,
                      G_CALLBACK(_event_btn_enter_leave), thumb);
     g_signal_connect(G_OBJECT(thumb->w_altered), "leave-notify-event",
                      G_CALLBACK(_event_btn_enter_leave), thumb);
+    g_signal_connect(G_OBJECT(thumb->w_altered), "query-tooltip",
+                     G_CALLBACK(_event_altered_tooltip), thumb);
     gtk_overlay_add_overlay(GTK_OVERLAY(overlays_parent), thumb->w_altered);
 
     // the tags icon
@@ -1694,6 +1812,8 @@ GtkWidget *dt_thumbnail_create_widget(dt_thumbnail_t *thumb,
                      G_CALLBACK(_event_btn_enter_leave), thumb);
     g_signal_connect(G_OBJECT(thumb->w_group), "leave-notify-event",
                      G_CALLBACK(_event_btn_enter_leave), thumb);
+    g_signal_connect(G_OBJECT(thumb->w_group), "query-tooltip",
+                     G_CALLBACK(_event_group_tooltip), thumb);
     gtk_widget_set_valign(thumb->w_group, GTK_ALIGN_START);
     gtk_widget_set_halign(thumb->w_group, GTK_ALIGN_END);
     gtk_widget_set_no_show_all(thumb->w_group, TRUE);
@@ -1794,17 +1914,6 @@ dt_thumbnail_t *dt_thumbnail_new(const int width,
   if(dt_control_get_mouse_over_id() == thumb->imgid)
     dt_thumbnail_set_mouseover(thumb, TRUE);
 
-  // set tooltip for altered icon if needed
-  if(thumb->is_altered)
-  {
-    char *tooltip_txt = dt_history_get_items_as_string(thumb->imgid);
-    if(tooltip_txt)
-    {
-      gtk_widget_set_tooltip_text(thumb->w_altered, tooltip_txt);
-      g_free(tooltip_txt);
-    }
-  }
-
   // update tooltips
   _image_update_group_tooltip(thumb);
   _thumb_update_tooltip_text(thumb);
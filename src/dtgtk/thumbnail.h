@@ -196,6 +196,9 @@ void dt_thumbnail_set_drop(dt_thumbnail_t *thumb,
 
 // update the information of the image and update icons accordingly
 void dt_thumbnail_update_infos(dt_thumbnail_t *thumb);
+// read at once the overlay infos of the collected images with rowid in
+// [first_rowid, last_rowid], before creating or refreshing their thumbnails
+void dt_thumbnail_prefetch_infos(const int first_rowid, const int last_rowid);
 
 // check if the image is selected and set its state and background
 void dt_thumbnail_update_selection(dt_thumbnail_t *thumb);
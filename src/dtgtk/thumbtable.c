@@ -37,6 +37,10 @@
 #include "osx/osx.h"
 #endif
 
+// read while scrolling, resolved in dt_thumbtable_new
+static dt_conf_handle_t *_conf_fractional_scrolling = NULL;
+static dt_conf_handle_t *_conf_prefetch_rows = NULL;
+
 static void _list_remove_thumb(gpointer user_data)
 {
   dt_thumbnail_t *thumb = (dt_thumbnail_t *)user_data;
@@ -504,6 +508,9 @@ static int _thumbs_remove_unneeded(dt_thumbtable_t *table,
   for(const GList *l = *th_invalid; l; l = g_list_next(l))
   {
     dt_thumbnail_t *th = l->data;
+    // still waiting for its image, the job producing it can stop
+    if(th->busy)
+      dt_mipmap_cache_cancel(th->imgid, DT_MIPMAP_NONE, th);
     gtk_container_remove(GTK_CONTAINER(gtk_widget_get_parent(th->w_main)), th->w_main);
     dt_thumbnail_destroy(th);
     changed++;
@@ -557,6 +564,8 @@ static void _thumb_move_or_create(dt_thumbtable_t *table,
   {
     // let's reuse a now unaffected widget
     dt_thumbnail_t *thumb = (*th_invalid)->data;
+    if(thumb->busy && thumb->imgid != imgid)
+      dt_mipmap_cache_cancel(thumb->imgid, DT_MIPMAP_NONE, thumb);
     thumb->imgid = imgid;
     thumb->rowid = rowid;
     thumb->x = posx;
@@ -606,6 +615,8 @@ static int _thumbs_load_needed(dt_thumbtable_t *table,
       space = first->x;
 
     const int nb_to_load = space / table->thumb_size + (space % table->thumb_size != 0);
+    dt_thumbnail_prefetch_infos(first->rowid - nb_to_load * table->thumbs_per_row,
+                                first->rowid - 1);
     // clang-format off
     gchar *query = g_strdup_printf(
        "SELECT mi.rowid, mi.imgid, si.imgid"
@@ -658,6 +669,8 @@ static int _thumbs_load_needed(dt_thumbtable_t *table,
     if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
       space = table->view_width - (last_x + table->thumb_size);
     const int nb_to_load = space / table->thumb_size + (space % table->thumb_size != 0);
+    dt_thumbnail_prefetch_infos(last_rowid + 1,
+                                last_rowid + nb_to_load * table->thumbs_per_row);
     // clang-format off
     gchar *query = g_strdup_printf(
        "SELECT mi.rowid, mi.imgid, si.imgid"
@@ -699,6 +712,189 @@ static int _thumbs_load_needed(dt_thumbtable_t *table,
   return changed;
 }
 
+// the foreground job queue keeps at most 30 jobs, dropping the oldest ones,
+// leave room for the thumbnails actually shown
+#define PREFETCH_MAX_IMAGES 24
+
+typedef struct _thumbs_prefetch_t
+{
+  dt_thumbtable_t *table;
+  dt_imgid_t imgid;
+  int rowid;
+  dt_mipmap_size_t mip;
+} _thumbs_prefetch_t;
+
+static int32_t _thumbs_prefetch_job_run(dt_job_t *job)
+{
+  const _thumbs_prefetch_t *params = dt_control_job_get_params(job);
+  dt_thumbtable_t *table = params->table;
+
+  // the row went out of the prefetch window while the job was queued
+  if(params->rowid < dt_atomic_get_int(&table->prefetch_first)
+     || params->rowid > dt_atomic_get_int(&table->prefetch_last))
+    return 0;
+
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_set_owner(table);
+  dt_mipmap_cache_get(&buf, params->imgid, params->mip, DT_MIPMAP_BLOCKING_CANCELLABLE, 'r');
+  dt_mipmap_cache_set_owner(NULL);
+  dt_mipmap_cache_release(&buf);
+  return 0;
+}
+
+static void _thumbs_prefetch_job_add(dt_thumbtable_t *table,
+                                     const dt_imgid_t imgid,
+                                     const int rowid,
+                                     const dt_mipmap_size_t mip)
+{
+  dt_job_t *job = dt_control_job_create(&_thumbs_prefetch_job_run,
+                                        "prefetch image %d mip %d", imgid, mip);
+  if(!job) return;
+  // calloc, the job queue compares the params with memcmp to drop duplicates
+  _thumbs_prefetch_t *params = calloc(1, sizeof(_thumbs_prefetch_t));
+  if(!params)
+  {
+    dt_control_job_dispose(job);
+    return;
+  }
+  params->table = table;
+  params->imgid = imgid;
+  params->rowid = rowid;
+  params->mip = mip;
+  dt_control_job_set_params_with_size(job, params, sizeof(_thumbs_prefetch_t), free);
+  dt_control_job_set_speculative(job);
+  dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, job);
+  g_hash_table_insert(table->prefetch_queued, GINT_TO_POINTER(imgid), GINT_TO_POINTER(rowid));
+}
+
+// abort the prefetching of the images which left the window
+static gboolean _thumbs_prefetch_cancel_outside(gpointer key,
+                                                gpointer value,
+                                                gpointer user_data)
+{
+  dt_thumbtable_t *table = user_data;
+  const int rowid = GPOINTER_TO_INT(value);
+  if(rowid >= dt_atomic_get_int(&table->prefetch_first)
+     && rowid <= dt_atomic_get_int(&table->prefetch_last))
+    return FALSE;
+  dt_mipmap_cache_cancel(GPOINTER_TO_INT(key), DT_MIPMAP_NONE, table);
+  return TRUE;
+}
+
+// keep track of the scroll velocity, move is the displacement of the thumbs
+static void _thumbs_prefetch_update_velocity(dt_thumbtable_t *table,
+                                            const int move)
+{
+  const gint64 now = g_get_monotonic_time();
+  const float dt = (now - table->prefetch_time) / (float)G_USEC_PER_SEC;
+  table->prefetch_time = now;
+
+  // thumbs move up (or left) when going towards the end of the collection
+  const float v = -move / (float)table->thumb_size / MAX(dt, 0.001f);
+
+  // a pause or a change of direction restarts the estimate
+  if(dt > 0.5f || (v > 0.0f) != (table->prefetch_velocity > 0.0f))
+    table->prefetch_velocity = v;
+  else
+    table->prefetch_velocity = 0.5f * (table->prefetch_velocity + v);
+}
+
+// queue the thumbnails of the rows about to scroll into view, nearest first.
+// queued requests for rows which left the window in the meantime are skipped
+// when their job comes up, running ones are aborted.
+static void _thumbs_prefetch(dt_thumbtable_t *table)
+{
+  if(!table->list
+     || table->thumb_size <= 0
+     || (table->mode != DT_THUMBTABLE_MODE_FILEMANAGER
+         && table->mode != DT_THUMBTABLE_MODE_FILMSTRIP))
+    return;
+
+  const dt_thumbnail_t *first = table->list->data;
+  const dt_thumbnail_t *last = g_list_last(table->list)->data;
+
+  if(!table->prefetch_queued)
+    table->prefetch_queued = g_hash_table_new(NULL, NULL);
+
+  const int rows = dt_conf_handle_get_int(_conf_prefetch_rows);
+  if(rows <= 0)
+  {
+    // cancel anything still pending
+    dt_atomic_set_int(&table->prefetch_first, INT_MAX);
+    dt_atomic_set_int(&table->prefetch_last, 0);
+    g_hash_table_foreach_remove(table->prefetch_queued, _thumbs_prefetch_cancel_outside, table);
+    return;
+  }
+
+  // enough rows for half a second of travel at the current speed
+  const float velocity = table->prefetch_velocity;
+  const int ahead = CLAMP((int)(fabsf(velocity) * 0.5f), rows, 3 * rows);
+  const int nb = MIN(ahead * table->thumbs_per_row, PREFETCH_MAX_IMAGES);
+  const gboolean forward = velocity >= 0.0f;
+
+  if(forward)
+  {
+    dt_atomic_set_int(&table->prefetch_first, first->rowid);
+    dt_atomic_set_int(&table->prefetch_last, last->rowid + nb);
+  }
+  else
+  {
+    dt_atomic_set_int(&table->prefetch_first, first->rowid - nb);
+    dt_atomic_set_int(&table->prefetch_last, last->rowid);
+  }
+  g_hash_table_foreach_remove(table->prefetch_queued, _thumbs_prefetch_cancel_outside, table);
+
+  // request the mip level the visible thumbnails are using
+  int w = 0;
+  int h = 0;
+  gtk_widget_get_size_request(first->w_image_box, &w, &h);
+  if(w <= 0 || h <= 0) return;
+  const dt_mipmap_size_t mip =
+    dt_mipmap_cache_get_matching_size(w * darktable.gui->ppd, h * darktable.gui->ppd);
+
+  sqlite3_stmt *stmt;
+  // clang-format off
+  gchar *query = forward
+    ? g_strdup_printf("SELECT rowid, imgid"
+                      " FROM memory.collected_images"
+                      " WHERE rowid>%d"
+                      " ORDER BY rowid LIMIT %d",
+                      last->rowid, nb)
+    : g_strdup_printf("SELECT rowid, imgid"
+                      " FROM memory.collected_images"
+                      " WHERE rowid<%d"
+                      " ORDER BY rowid DESC LIMIT %d",
+                      first->rowid, nb);
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+
+  int rowids[PREFETCH_MAX_IMAGES];
+  dt_imgid_t imgids[PREFETCH_MAX_IMAGES];
+  int count = 0;
+  while(sqlite3_step(stmt) == SQLITE_ROW && count < nb)
+  {
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 1);
+
+    // nothing to do if it's already in memory
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(&buf, imgid, mip, DT_MIPMAP_TESTLOCK, 'r');
+    if(buf.buf)
+    {
+      dt_mipmap_cache_release(&buf);
+      continue;
+    }
+    rowids[count] = sqlite3_column_int(stmt, 0);
+    imgids[count] = imgid;
+    count++;
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  // speculative jobs are appended below the requested ones, nearest first
+  for(int k = 0; k < count; k++)
+    _thumbs_prefetch_job_add(table, imgids[k], rowids[k], mip);
+}
+
 // move all thumbs from the table.
 // if clamp, we verify that the move is allowed (collection bounds, etc...)
 static gboolean _move(dt_thumbtable_t *table,
@@ -809,6 +1005,11 @@ static gboolean _move(dt_thumbtable_t *table,
   if(changed > 0)
     _pos_compute_area(table);
 
+  // and look ahead each time new thumbs are shown
+  _thumbs_prefetch_update_velocity(table, posy ? posy : posx);
+  if(changed > 0)
+    _thumbs_prefetch(table);
+
   // we update the offset
   if(table->mode == DT_THUMBTABLE_MODE_FILEMANAGER)
   {
@@ -1078,7 +1279,7 @@ static gboolean _event_scroll_compressed(gpointer user_data)
 
     // for fractional scrolling, scroll by a number of pixels proportionate to
     // the delta (which is a float value for most touch pads and some mice)
-    if(dt_conf_get_bool("thumbtable_fractional_scrolling"))
+    if(dt_conf_handle_get_bool(_conf_fractional_scrolling))
     {
       // scale scroll increment for an appropriate scroll speed
       delta *= 50;
@@ -1130,7 +1331,7 @@ static gboolean _event_scroll(GtkWidget *widget,
   {
     gdouble deltaf = 0.f;
     gboolean did_scroll;
-    if(dt_conf_get_bool("thumbtable_fractional_scrolling"))
+    if(dt_conf_handle_get_bool(_conf_fractional_scrolling))
     {
       gdouble deltaf_x, deltaf_y;
       did_scroll = dt_gui_get_scroll_deltas(e, &deltaf_x, &deltaf_y);
@@ -2541,6 +2742,9 @@ static void _thumbtable_init_accels();
 
 dt_thumbtable_t *dt_thumbtable_new()
 {
+  _conf_fractional_scrolling = dt_conf_handle("thumbtable_fractional_scrolling", DT_BOOL);
+  _conf_prefetch_rows = dt_conf_handle("thumbtable_prefetch_rows", DT_INT);
+
   dt_thumbtable_t *table = calloc(1, sizeof(dt_thumbtable_t));
   table->widget = gtk_layout_new(NULL, NULL);
   dt_gui_add_help_link(table->widget, "lighttable_filemanager");
@@ -2760,6 +2964,8 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table,
 
     // we add the thumbs
     int nbnew = 0;
+    const int nb_thumbs = table->rows * table->thumbs_per_row - empty_start;
+    dt_thumbnail_prefetch_infos(offset, offset + nb_thumbs - 1);
     gchar *query
         = g_strdup_printf
       ("SELECT mi.rowid, mi.imgid, si.imgid"
@@ -2767,7 +2973,7 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table,
        " LEFT JOIN main.selected_images AS si"
        "   ON mi.imgid = si.imgid"
        " WHERE mi.rowid>=%d LIMIT %d",
-       offset, table->rows * table->thumbs_per_row - empty_start);
+       offset, nb_thumbs);
 
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
     while(sqlite3_step(stmt) == SQLITE_ROW)
@@ -16,6 +16,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 /** a class to manage a table of thumbnail for lighttable and filmstrip.  */
+#include "common/atomic.h"
 #include "dtgtk/thumbnail.h"
 #include <gtk/gtk.h>
 
@@ -109,6 +110,12 @@ typedef struct dt_thumbtable_t
   // darkroom selection from filmstrip (support for single & double click)
   guint sel_single_cb;
   dt_imgid_t to_selid;
+
+  // scroll-ahead prefetching
+  gint64 prefetch_time;     // time of the last move, to estimate the scroll velocity
+  float prefetch_velocity;  // smoothed, in rows per second, > 0 towards the end of the collection
+  dt_atomic_int prefetch_first, prefetch_last; // rowids still worth prefetching
+  GHashTable *prefetch_queued; // imgid -> rowid of the images queued for prefetching
 } dt_thumbtable_t;
 
 dt_thumbtable_t *dt_thumbtable_new();
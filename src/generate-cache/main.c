@@ -17,6 +17,7 @@
 */
 
 #include <glib.h>    // for g_mkdir_with_parents, _
+#include <glib/gstdio.h> // for g_unlink
 #include <gtk/gtk.h> // for gtk_init_check
 #include <libintl.h> // for bind_textdomain_codeset, etc
 #include <limits.h>  // for PATH_MAX
@@ -28,6 +29,7 @@
 #include <string.h>  // for strcmp
 #include <unistd.h>  // for access, R_OK
 
+#include "common/atomic.h"       // for dt_atomic_int
 #include "common/darktable.h"    // for darktable, darktable_t, dt_cleanup, etc
 #include "common/database.h"     // for dt_database_get
 #include "common/debug.h"        // for DT_DEBUG_SQLITE3_PREPARE_V2
@@ -44,7 +46,142 @@
 #include "win/main_wrapper.h"
 #endif
 
-static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, const dt_imgid_t min_imgid, const int32_t max_imgid)
+typedef struct dt_generate_cache_t
+{
+  dt_mipmap_size_t min_mip, max_mip;
+  GArray *imgids;        // to work on, ascending
+  dt_atomic_int next;    // index of the next image to pick up
+  dt_atomic_int finished;
+  dt_atomic_int skipped;
+  dt_pthread_mutex_t lock; // protects done
+  gboolean *done;          // per image, for the checkpoint
+} dt_generate_cache_t;
+
+// the mips of an image are current if they were written after the last
+// history change. images which were never edited have no hash at all.
+static gboolean _mipmap_outdated(const dt_imgid_t imgid)
+{
+  gboolean outdated = FALSE;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT mipmap_hash IS NOT current_hash"
+                              " FROM main.history_hash"
+                              " WHERE imgid = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    outdated = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  return outdated;
+}
+
+static void _generate_image(dt_generate_cache_t *gc, const dt_imgid_t imgid)
+{
+  const gboolean outdated = _mipmap_outdated(imgid);
+  gboolean generated = FALSE;
+
+  for(int k = gc->max_mip; k >= gc->min_mip && k >= 0; k--)
+  {
+    // if a valid and current thumbnail is already on disc - do nothing
+    if(dt_mipmap_cache_test_disk_thumbnail(imgid, k))
+    {
+      if(!outdated) continue;
+      dt_mipmap_cache_remove_at_size(imgid, k);
+    }
+
+    // else, generate thumbnail and store in mipmap cache.
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
+    dt_mipmap_cache_release(&buf);
+    generated = TRUE;
+  }
+
+  if(!generated)
+  {
+    dt_atomic_add_int(&gc->skipped, 1);
+    return;
+  }
+
+  // and immediately write thumbs to disc and remove from mipmap cache.
+  dt_mipmap_cache_evict(imgid);
+  // thumbnail in sync with image
+  dt_history_hash_set_mipmap(imgid);
+}
+
+static void *_generate_worker(void *data)
+{
+  dt_generate_cache_t *gc = (dt_generate_cache_t *)data;
+  dt_pthread_setname("generate-cache");
+
+  const int count = gc->imgids->len;
+  int i;
+  while((i = dt_atomic_add_int(&gc->next, 1)) < count)
+  {
+    const dt_imgid_t imgid = g_array_index(gc->imgids, dt_imgid_t, i);
+    _generate_image(gc, imgid);
+    dt_pthread_mutex_lock(&gc->lock);
+    gc->done[i] = TRUE;
+    dt_pthread_mutex_unlock(&gc->lock);
+    dt_atomic_add_int(&gc->finished, 1);
+  }
+  return NULL;
+}
+
+static gchar *_checkpoint_filename(void)
+{
+  return g_strdup_printf("%s.d/generate-cache.checkpoint", darktable.mipmap_cache->cachedir);
+}
+
+// the checkpoint holds the parameters of the run and the first image id not finished yet
+static dt_imgid_t _read_checkpoint(const char *filename,
+                                   const dt_mipmap_size_t min_mip,
+                                   const dt_mipmap_size_t max_mip,
+                                   const dt_imgid_t min_imgid,
+                                   const int32_t max_imgid)
+{
+  gchar *contents = NULL;
+  dt_imgid_t resume = NO_IMGID;
+  if(g_file_get_contents(filename, &contents, NULL, NULL))
+  {
+    int c_min_mip, c_max_mip, c_min_imgid, c_max_imgid, c_next;
+    if(sscanf(contents, "%d %d %d %d %d", &c_min_mip, &c_max_mip, &c_min_imgid, &c_max_imgid, &c_next) == 5
+       && c_min_mip == min_mip && c_max_mip == max_mip
+       && c_min_imgid == min_imgid && c_max_imgid == max_imgid)
+      resume = c_next;
+  }
+  g_free(contents);
+  return resume;
+}
+
+static void _write_checkpoint(const char *filename,
+                              const dt_generate_cache_t *gc,
+                              const dt_imgid_t min_imgid,
+                              const int32_t max_imgid,
+                              const dt_imgid_t next)
+{
+  gchar *contents = g_strdup_printf("%d %d %d %d %d\n", gc->min_mip, gc->max_mip, min_imgid, max_imgid, next);
+  g_file_set_contents(filename, contents, -1, NULL);
+  g_free(contents);
+}
+
+static void _print_progress(dt_generate_cache_t *gc, const int total, const double start)
+{
+  const int finished = dt_atomic_get_int(&gc->finished);
+  const int skipped = dt_atomic_get_int(&gc->skipped);
+  const double elapsed = dt_get_wtime() - start;
+  const double rate = elapsed > 0.0 ? finished / elapsed : 0.0;
+  const int eta = rate > 0.0 ? (int)((total - finished) / rate) : 0;
+  fprintf(stderr, _("%d/%d images (%.02f%%), %d up to date, %.2f images/s, ETA %d:%02d:%02d\n"),
+          finished, total, total ? 100.0 * finished / total : 100.0, skipped, rate,
+          eta / 3600, (eta / 60) % 60, eta % 60);
+}
+
+static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip,
+                                    const dt_mipmap_size_t max_mip,
+                                    const dt_imgid_t min_imgid,
+                                    const int32_t max_imgid,
+                                    const int jobs,
+                                    const gboolean restart)
 {
   fprintf(stderr, _("creating cache directories\n"));
   for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++)
@@ -60,23 +197,35 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // some progress counter
+  // pick up where an interrupted run with the same parameters stopped
+  gchar *checkpoint = _checkpoint_filename();
+  dt_imgid_t first_imgid = min_imgid;
+  if(!restart)
+  {
+    const dt_imgid_t resume = _read_checkpoint(checkpoint, min_mip, max_mip, min_imgid, max_imgid);
+    if(dt_is_valid_imgid(resume) && resume > first_imgid)
+    {
+      fprintf(stderr, _("resuming interrupted run at image id %d\n"), resume);
+      first_imgid = resume;
+    }
+  }
+
+  dt_generate_cache_t gc = { .min_mip = min_mip, .max_mip = max_mip };
+  gc.imgids = g_array_new(FALSE, FALSE, sizeof(dt_imgid_t));
+
   sqlite3_stmt *stmt;
-  size_t image_count = 0, counter = 0;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
+                              "SELECT id FROM main.images WHERE id >= ?1 AND id <= ?2 ORDER BY id", -1, &stmt, 0);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, first_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    image_count = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-  }
-  else
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    return 1;
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+    g_array_append_val(gc.imgids, imgid);
   }
+  sqlite3_finalize(stmt);
 
+  const int image_count = gc.imgids->len;
   if(!image_count)
   {
     fprintf(stderr, _("warning: no images are matching the requested image id range\n"));
@@ -86,40 +235,51 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // go through all images:
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT id, filename FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  gc.done = g_malloc0_n(MAX(1, image_count), sizeof(gboolean));
+  dt_pthread_mutex_init(&gc.lock, NULL);
+  dt_atomic_set_int(&gc.next, 0);
+  dt_atomic_set_int(&gc.finished, 0);
+  dt_atomic_set_int(&gc.skipped, 0);
+
+  const int nthreads = CLAMP(jobs, 1, MAX(1, image_count));
+  fprintf(stderr, _("generating thumbnails for %d images with %d workers\n"), image_count, nthreads);
+
+  const double start = dt_get_wtime();
+  pthread_t *threads = g_malloc_n(nthreads, sizeof(pthread_t));
+  int started = 0;
+  for(; started < nthreads; started++)
+    if(dt_pthread_create(&threads[started], _generate_worker, &gc)) break;
+  if(!started) _generate_worker(&gc);
+
+  // report progress and advance the checkpoint past all images finished so far
+  int watermark = 0;
+  double last_report = start;
+  while(dt_atomic_get_int(&gc.finished) < image_count)
   {
-    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
-    const char *imgfilename = (const char*)sqlite3_column_text(stmt, 1);
-
-    counter++;
-    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d, file=%s)\n", counter, image_count, 100.0 * counter / (float)image_count, imgid, imgfilename);
-
-    for(int k = max_mip; k >= min_mip && k >= 0; k--)
-    {
-      char filename[PATH_MAX] = { 0 };
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
+    g_usleep(250000);
+    if(dt_get_wtime() - last_report < 10.0) continue;
+    last_report = dt_get_wtime();
+
+    dt_pthread_mutex_lock(&gc.lock);
+    while(watermark < image_count && gc.done[watermark]) watermark++;
+    dt_pthread_mutex_unlock(&gc.lock);
+    if(watermark < image_count)
+      _write_checkpoint(checkpoint, &gc, min_imgid, max_imgid,
+                        g_array_index(gc.imgids, dt_imgid_t, watermark));
+    _print_progress(&gc, image_count, start);
+  }
 
-      // if a valid thumbnail file is already on disc - do nothing
-      if(dt_util_test_image_file(filename)) continue;
+  for(int i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
 
-      // else, generate thumbnail and store in mipmap cache.
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
-      dt_mipmap_cache_release(&buf);
-    }
+  _print_progress(&gc, image_count, start);
+  g_unlink(checkpoint);
 
-    // and immediately write thumbs to disc and remove from mipmap cache.
-    dt_mipmap_cache_evict(imgid);
-    // thumbnail in sync with image
-    dt_history_hash_set_mipmap(imgid);
-  }
-
-  sqlite3_finalize(stmt);
+  g_free(threads);
+  dt_pthread_mutex_destroy(&gc.lock);
+  g_free(gc.done);
+  g_array_free(gc.imgids, TRUE);
+  g_free(checkpoint);
   fprintf(stderr, "done\n");
 
   return 0;
@@ -131,13 +291,18 @@ static void usage(const char *progname)
           "usage: %s [-h, --help; --version]\n"
           "  [--min-mip <0-8> (default = 0)] [-m, --max-mip <0-8> (default = 2)]\n"
           "  [--min-imgid <N>] [--max-imgid <N>]\n"
+          "  [-j, --jobs <N> (default = 1)] [--restart]\n"
           "  [--core <darktable options>]\n"
           "\n"
           "When multiple mipmap sizes are requested, the biggest one is computed\n"
           "while the rest are quickly downsampled.\n"
           "\n"
           "The --min-imgid and --max-imgid specify the range of internal image ID\n"
-          "numbers to work on.\n",
+          "numbers to work on.\n"
+          "\n"
+          "With --jobs several images are processed concurrently. Images whose\n"
+          "thumbnails are on disk and current are skipped. An interrupted run\n"
+          "resumes where it stopped unless --restart is given.\n",
           progname);
 }
 
@@ -163,6 +328,8 @@ int main(int argc, char *arg[])
   dt_mipmap_size_t max_mip = DT_MIPMAP_2;
   dt_imgid_t min_imgid = NO_IMGID;
   int32_t max_imgid = INT32_MAX;
+  int jobs = 1;
+  gboolean restart = FALSE;
 
   int k;
   for(k = 1; k < argc; k++)
@@ -198,6 +365,15 @@ int main(int argc, char *arg[])
       k++;
       max_imgid = (int32_t)MIN(MAX(atoi(arg[k]), 0), INT32_MAX);
     }
+    else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--jobs")) && argc > k + 1)
+    {
+      k++;
+      jobs = MAX(atoi(arg[k]), 1);
+    }
+    else if(!strcmp(arg[k], "--restart"))
+    {
+      restart = TRUE;
+    }
     else if(!strcmp(arg[k], "--core"))
     {
       // everything from here on should be passed to the core
@@ -251,7 +427,7 @@ int main(int argc, char *arg[])
 
   fprintf(stderr, _("creating complete lighttable thumbnail cache\n"));
 
-  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid))
+  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid, jobs, restart))
   {
     free(m_arg);
     exit(EXIT_FAILURE);
@@ -3843,6 +3843,7 @@ static float _process_action(dt_action_t *action,
       // find module instance widget
       if(mod && action->type >= DT_ACTION_TYPE_PER_INSTANCE)
       {
+        dt_iop_gui_ensure(mod);
         for(GSList *w = mod->widget_list; w; w = w->next)
         {
           const dt_action_target_t *referral = w->data;
@@ -3861,6 +3862,14 @@ static float _process_action(dt_action_t *action,
     {
       action_target = dt_iop_get_module_preferred_instance((dt_iop_module_so_t *)owner);
     }
+    else if(action->type >= DT_ACTION_TYPE_PER_INSTANCE)
+    {
+      // the widgets of the preferred instance may not have been built
+      // yet, that connects them
+      mod = dt_iop_get_module_preferred_instance(module);
+      if(mod && !mod->widget && dt_iop_gui_ensure(mod))
+        action_target = action->target;
+    }
   }
 
   if(action->type == DT_ACTION_TYPE_COMMAND
@@ -82,9 +82,13 @@ void _insert_text_event(GtkEditable *editable,
 void dt_gui_presets_init()
 {
   // remove auto generated presets from plugins, not the user included
-  // ones.
+  // ones. processing modules whose presets are known to be up to date
+  // keep them, see _init_presets() in imageop.c.
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "DELETE FROM data.presets WHERE writeprotect = 1", NULL,
+                        "DELETE FROM data.presets"
+                        " WHERE writeprotect = 1"
+                        "   AND 'iop_presets_' || operation NOT IN"
+                        "       (SELECT key FROM data.db_info)", NULL,
                         NULL, NULL);
 }
 
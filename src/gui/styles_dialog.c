@@ -26,6 +26,7 @@
 #include "gui/gtk.h"
 #include "gui/draw.h"
 #include "gui/styles.h"
+#include "imageio/imageio_common.h"
 #ifdef GDK_WINDOWING_QUARTZ
 #include "osx/osx.h"
 #endif
@@ -879,69 +880,165 @@ static gboolean _gui_styles_dialog_run(const gboolean edit,
 
 // style preview
 
+// previews are rendered one at a time by a background job and kept per
+// image, history, style and size. hovering down a list of styles only
+// renders the last one asked for once the current render is done, all
+// renders of a job share the pipe cache of the image.
+
+#define DT_STYLE_PREVIEW_CACHE 32
+
 typedef struct _preview_data_t
 {
   char style_name[128];
   dt_imgid_t imgid;
-  gboolean first_draw;
-  cairo_surface_t *surface;
-  guint8 *hash;
-  int hash_len;
   int psize;
+  gchar *key;
 } _preview_data_t;
 
+static struct
+{
+  GMutex lock;
+  GHashTable *surfaces; // key -> cairo_surface_t
+  GQueue keys;          // oldest first, owned by surfaces
+  _preview_data_t *pending;
+  gboolean running;
+  uint32_t generation;  // bumped when the styles change
+  GtkWidget *area;      // drawing area of the current tooltip
+} _previews;
+
+static void _preview_data_free(_preview_data_t *data)
+{
+  if(!data) return;
+  g_free(data->key);
+  g_free(data);
+}
+
+static gboolean _preview_ready(gpointer user_data)
+{
+  if(_previews.area) gtk_widget_queue_draw(_previews.area);
+  return G_SOURCE_REMOVE;
+}
+
+static int32_t _preview_job_run(dt_job_t *job)
+{
+  dt_imageio_export_session_begin();
+
+  g_mutex_lock(&_previews.lock);
+  while(_previews.pending)
+  {
+    // requests coming in while rendering replace each other
+    _preview_data_t *data = _previews.pending;
+    _previews.pending = NULL;
+    const uint32_t generation = _previews.generation;
+    g_mutex_unlock(&_previews.lock);
+
+    cairo_surface_t *surface =
+      dt_gui_get_style_preview(data->imgid, data->style_name, data->psize);
+
+    g_mutex_lock(&_previews.lock);
+    if(surface)
+    {
+      if(generation != _previews.generation
+         || g_hash_table_contains(_previews.surfaces, data->key))
+        cairo_surface_destroy(surface);
+      else
+      {
+        while(g_queue_get_length(&_previews.keys) >= DT_STYLE_PREVIEW_CACHE)
+          g_hash_table_remove(_previews.surfaces, g_queue_pop_head(&_previews.keys));
+        gchar *key = g_strdup(data->key);
+        g_hash_table_insert(_previews.surfaces, key, surface);
+        g_queue_push_tail(&_previews.keys, key);
+      }
+      g_idle_add(_preview_ready, NULL);
+    }
+    _preview_data_free(data);
+  }
+  _previews.running = FALSE;
+  g_mutex_unlock(&_previews.lock);
+
+  dt_imageio_export_session_end();
+  return 0;
+}
+
+static void _preview_request(const _preview_data_t *data)
+{
+  g_mutex_lock(&_previews.lock);
+  if(!_previews.pending || strcmp(_previews.pending->key, data->key))
+  {
+    _preview_data_free(_previews.pending);
+    _previews.pending = g_malloc(sizeof(_preview_data_t));
+    *_previews.pending = *data;
+    _previews.pending->key = g_strdup(data->key);
+  }
+
+  if(!_previews.running)
+  {
+    dt_job_t *job = dt_control_job_create(_preview_job_run, "style preview");
+    if(job)
+    {
+      _previews.running = TRUE;
+      dt_control_add_job(DT_JOB_QUEUE_USER_BG, job);
+    }
+  }
+  g_mutex_unlock(&_previews.lock);
+}
+
+static void _preview_area_destroy(GtkWidget *widget,
+                                  gpointer user_data)
+{
+  if(_previews.area == widget) _previews.area = NULL;
+}
+
 static gboolean _preview_draw(GtkWidget *widget,
                               cairo_t *cr,
                               gpointer user_data)
 {
   _preview_data_t *data = (_preview_data_t *)user_data;
 
-  if(dt_is_valid_imgid(data->imgid) && !data->first_draw && !data->surface)
-    data->surface = dt_gui_get_style_preview(data->imgid, data->style_name, data->psize);
+  if(!dt_is_valid_imgid(data->imgid) || !data->key) return FALSE;
 
-  if(data->surface)
+  g_mutex_lock(&_previews.lock);
+  cairo_surface_t *surface = g_hash_table_lookup(_previews.surfaces, data->key);
+  if(surface)
   {
     const int psize = data->psize;
-    const int swidth = cairo_image_surface_get_width(data->surface);
-    const int sheight = cairo_image_surface_get_height(data->surface);
-    cairo_set_source_surface(cr, data->surface, .5f * (psize - swidth), .5f * (psize - sheight));
+    const int swidth = cairo_image_surface_get_width(surface);
+    const int sheight = cairo_image_surface_get_height(surface);
+    cairo_set_source_surface(cr, surface, .5f * (psize - swidth), .5f * (psize - sheight));
     cairo_paint(cr);
   }
-  else
-  {
-    data->first_draw = FALSE;
-    gtk_widget_queue_draw(widget);
-  }
+  g_mutex_unlock(&_previews.lock);
+
+  if(!surface) _preview_request(data);
 
   return FALSE;
 }
 
 GtkWidget *dt_gui_style_content_dialog(char *name, const dt_imgid_t imgid)
 {
-  static _preview_data_t data = { "", -1, FALSE, NULL, NULL, 0, 0};
+  static _preview_data_t data = { "", -1, 0, NULL };
 
-  dt_history_hash_values_t hash = { NULL, 0, NULL, 0, NULL, 0 };
-  dt_history_hash_read(imgid, &hash);
+  if(!_previews.surfaces)
+  {
+    _previews.surfaces = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify)cairo_surface_destroy);
+    g_queue_init(&_previews.keys);
+  }
 
-  if(imgid != data.imgid
-     || g_strcmp0(data.style_name, name)
-     || data.hash_len != hash.current_len
-     || memcmp(data.hash, hash.current, data.hash_len))
+  // a style has been created or changed
+  if(!*name)
   {
-    if(data.surface)
-    {
-      cairo_surface_destroy(data.surface);
-      data.surface = NULL;
-    }
-    data.imgid = imgid;
-    g_strlcpy(data.style_name, name, sizeof(data.style_name));
-    g_free(data.hash);
-    data.hash = g_malloc(hash.current_len);
-    memcpy(data.hash, hash.current, hash.current_len);
-    data.hash_len = hash.current_len;
+    g_mutex_lock(&_previews.lock);
+    g_queue_clear(&_previews.keys);
+    g_hash_table_remove_all(_previews.surfaces);
+    _preview_data_free(_previews.pending);
+    _previews.pending = NULL;
+    _previews.generation++;
+    g_mutex_unlock(&_previews.lock);
   }
 
-  dt_history_hash_free(&hash);
+  data.imgid = imgid;
+  g_strlcpy(data.style_name, name, sizeof(data.style_name));
 
   if(!*name) return NULL;
 
@@ -1037,13 +1134,24 @@ GtkWidget *dt_gui_style_content_dialog(char *name, const dt_imgid_t imgid)
       {
         data.psize = dt_conf_get_int("ui/style/preview_size");
       }
+
+      // the preview is up to date as long as the history of the image is
+      dt_history_hash_values_t hash = { NULL, 0, NULL, 0, NULL, 0 };
+      dt_history_hash_read(imgid, &hash);
+      g_free(data.key);
+      data.key = g_strdup_printf("%d %d %" PRIx64 " %s", imgid, data.psize,
+                                 dt_hash(DT_INITHASH, hash.current, hash.current_len),
+                                 name);
+      dt_history_hash_free(&hash);
+
       GtkWidget *da = gtk_drawing_area_new();
       gtk_widget_set_size_request(da, data.psize, data.psize);
       gtk_widget_set_halign(da, GTK_ALIGN_CENTER);
       gtk_widget_set_app_paintable(da, TRUE);
       gtk_box_pack_start(GTK_BOX(ht), da, TRUE, TRUE, 0);
-      data.first_draw = TRUE;
       g_signal_connect(G_OBJECT(da), "draw", G_CALLBACK(_preview_draw), &data);
+      g_signal_connect(G_OBJECT(da), "destroy", G_CALLBACK(_preview_area_destroy), NULL);
+      _previews.area = da;
     }
   }
 
@@ -610,6 +610,9 @@ int write_image(struct dt_imageio_module_data_t *data,
    * The minimum size for a tile is 512x512. We use a default tile size of
    * 1024x1024.
    */
+  // without tiles the encoder still uses threads for rows
+  encoder->maxThreads = dt_imageio_encoder_threads();
+
   switch(d->tiling)
   {
     case AVIF_TILING_ON:
@@ -642,7 +645,7 @@ int write_image(struct dt_imageio_module_data_t *data,
        */
       max_threads = (1 << encoder->tileRowsLog2) * (1 << encoder->tileColsLog2);
 
-      encoder->maxThreads = MIN(max_threads, dt_get_num_threads());
+      encoder->maxThreads = MIN(max_threads, dt_imageio_encoder_threads());
     }
     case AVIF_TILING_OFF:
       break;
@@ -660,6 +663,8 @@ int write_image(struct dt_imageio_module_data_t *data,
 
   avifRWData output = AVIF_DATA_EMPTY;
 
+  dt_times_t start;
+  dt_get_perf_times(&start);
   result = avifEncoderWrite(encoder, image, &output);
   if(result != AVIF_RESULT_OK)
   {
@@ -667,6 +672,8 @@ int write_image(struct dt_imageio_module_data_t *data,
     rc = 1;
     goto out;
   }
+  dt_show_times_f(&start, "[avif]", "to encode %ux%u with %i threads",
+                  (unsigned)width, (unsigned)height, encoder->maxThreads);
 
   if(output.size == 0 || output.data == NULL)
   {
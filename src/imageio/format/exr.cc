@@ -33,6 +33,7 @@
 #include <OpenEXR/ImfOutputFile.h>
 #include <OpenEXR/ImfStandardAttributes.h>
 #include <OpenEXR/ImfThreading.h>
+#include <OpenEXR/ImfTiledOutputFile.h>
 #include <OpenEXR/ImfCRgbaFile.h> // for macros to check HTJ2K compressions availability
 
 #include <cstdio>
@@ -43,7 +44,10 @@
 
 G_BEGIN_DECLS
 
-DT_MODULE(5)
+DT_MODULE(6)
+
+// tile size of tiled files
+#define DT_EXR_TILE_SIZE 256
 
 enum dt_imageio_exr_compression_t
 {
@@ -81,12 +85,16 @@ typedef struct dt_imageio_exr_t
   dt_imageio_module_data_t global;
   dt_imageio_exr_compression_t compression;
   dt_imageio_exr_pixeltype_t pixel_type;
+  int tiled;
+  Imf::OutputFile *file; // when writing in bands
+  int row;               // next row when writing in bands
 } dt_imageio_exr_t;
 
 typedef struct dt_imageio_exr_gui_t
 {
   GtkWidget *bpp;
   GtkWidget *compression;
+  GtkWidget *tiled;
 } dt_imageio_exr_gui_t;
 
 void init(dt_imageio_module_format_t *self)
@@ -117,39 +125,28 @@ void init(dt_imageio_module_format_t *self)
 
   dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_exr_t, pixel_type,
                                 dt_imageio_exr_pixeltype_t);
+  dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_exr_t, tiled, int);
 #endif
   Imf::BlobAttribute::registerAttributeType();
+
+  // the pool is shared by all files written at the same time, each of
+  // them only queues as many blocks as its share of the threads
+  Imf::setGlobalThreadCount(dt_get_num_threads());
 }
 
 void cleanup(dt_imageio_module_format_t *self)
 {
 }
 
-int write_image(dt_imageio_module_data_t *tmp,
-                const char *filename,
-                const void *in_tmp,
-                dt_colorspaces_color_profile_type_t over_type,
-                const char *over_filename,
-                void *exif,
-                int exif_len,
-                dt_imgid_t imgid,
-                int num,
-                int total,
-                struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+// metadata, chromaticities and the RGB channels
+static void _init_header(Imf::Header &header,
+                         const dt_imageio_exr_t *exr,
+                         dt_colorspaces_color_profile_type_t over_type,
+                         const char *over_filename,
+                         void *exif,
+                         int exif_len,
+                         dt_imgid_t imgid)
 {
-  const dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
-
-  Imf::setGlobalThreadCount(dt_get_num_threads());
-
-  Imf::Header header(exr->global.width,  // image width
-                     exr->global.height, // image height
-                     1,                  // pixel aspect ratio
-                     Imath::V2f(0, 0),   // screen window center
-                     1,                  // screen window width
-                     Imf::INCREASING_Y,  // line order
-                     (Imf::Compression)exr->compression);
-
   char comment[1024];
   snprintf(comment, sizeof(comment), "Created with %s", darktable_package_string);
 
@@ -249,11 +246,39 @@ icc_error:
            "might lead to wrong results when opening the image\n");
 icc_end:
 
-  Imf::PixelType pixel_type = (Imf::PixelType)exr->pixel_type;
+  const Imf::PixelType pixel_type = (Imf::PixelType)exr->pixel_type;
 
   header.channels().insert("R", Imf::Channel(pixel_type, 1, 1, true));
   header.channels().insert("G", Imf::Channel(pixel_type, 1, 1, true));
   header.channels().insert("B", Imf::Channel(pixel_type, 1, 1, true));
+}
+
+int write_image(dt_imageio_module_data_t *tmp,
+                const char *filename,
+                const void *in_tmp,
+                dt_colorspaces_color_profile_type_t over_type,
+                const char *over_filename,
+                void *exif,
+                int exif_len,
+                dt_imgid_t imgid,
+                int num,
+                int total,
+                struct dt_dev_pixelpipe_t *pipe,
+                const gboolean export_masks)
+{
+  const dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
+
+  Imf::Header header(exr->global.width,  // image width
+                     exr->global.height, // image height
+                     1,                  // pixel aspect ratio
+                     Imath::V2f(0, 0),   // screen window center
+                     1,                  // screen window width
+                     Imf::INCREASING_Y,  // line order
+                     (Imf::Compression)exr->compression);
+
+  _init_header(header, exr, over_type, over_filename, exif, exif_len, imgid);
+
+  Imf::PixelType pixel_type = (Imf::PixelType)exr->pixel_type;
 
   Imf::FrameBuffer data;
   size_t stride;
@@ -384,10 +409,29 @@ icc_end:
   }
 
   // write out to file
-  Imf::OutputFile file(filename, header);
+  dt_times_t start;
+  dt_get_perf_times(&start);
+  const int threads = dt_imageio_encoder_threads();
+  if(exr->tiled)
+  {
+    // tiles are compressed independently, which viewers of large plates
+    // can read back in parallel and in pieces
+    header.setTileDescription(Imf::TileDescription(DT_EXR_TILE_SIZE, DT_EXR_TILE_SIZE,
+                                                   Imf::ONE_LEVEL));
+    Imf::TiledOutputFile file(filename, header, threads);
+
+    file.setFrameBuffer(data);
+    file.writeTiles(0, file.numXTiles() - 1, 0, file.numYTiles() - 1);
+  }
+  else
+  {
+    Imf::OutputFile file(filename, header, threads);
 
-  file.setFrameBuffer(data);
-  file.writePixels(exr->global.height);
+    file.setFrameBuffer(data);
+    file.writePixels(exr->global.height);
+  }
+  dt_show_times_f(&start, "[exr export]", "to write %dx%d%s with %d threads",
+                  exr->global.width, exr->global.height, exr->tiled ? " in tiles" : "", threads);
 
   // clean up
   dt_free_align(out_image);
@@ -399,9 +443,132 @@ icc_end:
   return 0;
 }
 
+int write_image_begin(dt_imageio_module_data_t *tmp,
+                      const char *filename,
+                      dt_colorspaces_color_profile_type_t over_type,
+                      const char *over_filename,
+                      void *exif,
+                      int exif_len,
+                      dt_imgid_t imgid,
+                      int num,
+                      int total,
+                      struct dt_dev_pixelpipe_t *pipe)
+{
+  dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
+
+  // tiles would need whole rows of tiles per band
+  if(exr->tiled) return 1;
+
+  Imf::Header header(exr->global.width,  // image width
+                     exr->global.height, // image height
+                     1,                  // pixel aspect ratio
+                     Imath::V2f(0, 0),   // screen window center
+                     1,                  // screen window width
+                     Imf::INCREASING_Y,  // line order
+                     (Imf::Compression)exr->compression);
+
+  _init_header(header, exr, over_type, over_filename, exif, exif_len, imgid);
+
+  try
+  {
+    exr->file = new Imf::OutputFile(filename, header, dt_imageio_encoder_threads());
+  }
+  catch(const std::exception &e)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[exr export] can't write '%s': %s", filename, e.what());
+    exr->file = NULL;
+    return 1;
+  }
+  exr->row = 0;
+  return 0;
+}
+
+int write_image_rows(dt_imageio_module_data_t *tmp, const void *in, const int rows)
+{
+  dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
+  if(!exr->file) return 1;
+
+  const size_t width = exr->global.width;
+  const Imf::PixelType pixel_type = (Imf::PixelType)exr->pixel_type;
+
+  // the slices are addressed by the row in the file, shift them so that
+  // the first row of the band lands at the start of its buffer
+  Imf::FrameBuffer data;
+  void *out_band = NULL;
+  if(pixel_type == Imf::PixelType::FLOAT)
+  {
+    const size_t stride = 4 * sizeof(float);
+    char *base = (char *)in - (size_t)exr->row * stride * width;
+
+    data.insert("R", Imf::Slice(pixel_type, base + 0 * sizeof(float), stride, stride * width));
+    data.insert("G", Imf::Slice(pixel_type, base + 1 * sizeof(float), stride, stride * width));
+    data.insert("B", Imf::Slice(pixel_type, base + 2 * sizeof(float), stride, stride * width));
+  }
+  else
+  {
+    const size_t stride = 3 * sizeof(unsigned short);
+    out_band = dt_alloc_aligned(stride * width * rows);
+    if(out_band == NULL)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[exr export] error allocating band conversion buffer");
+      return 1;
+    }
+
+    DT_OMP_FOR(collapse(2))
+    for(size_t y = 0; y < (size_t)rows; y++)
+    {
+      for(size_t x = 0; x < width; x++)
+      {
+        const float *in_pixel = (const float *)in + 4 * ((y * width) + x);
+        unsigned short *out_pixel = (unsigned short *)out_band + 3 * ((y * width) + x);
+
+        out_pixel[0] = half(in_pixel[0]).bits();
+        out_pixel[1] = half(in_pixel[1]).bits();
+        out_pixel[2] = half(in_pixel[2]).bits();
+      }
+    }
+
+    char *base = (char *)out_band - (size_t)exr->row * stride * width;
+    data.insert("R", Imf::Slice(pixel_type, base + 0 * sizeof(unsigned short), stride, stride * width));
+    data.insert("G", Imf::Slice(pixel_type, base + 1 * sizeof(unsigned short), stride, stride * width));
+    data.insert("B", Imf::Slice(pixel_type, base + 2 * sizeof(unsigned short), stride, stride * width));
+  }
+
+  int rc = 0;
+  try
+  {
+    exr->file->setFrameBuffer(data);
+    exr->file->writePixels(rows);
+  }
+  catch(const std::exception &e)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[exr export] error writing rows %d..%d: %s",
+             exr->row, exr->row + rows - 1, e.what());
+    rc = 1;
+  }
+  dt_free_align(out_band);
+  exr->row += rows;
+  return rc;
+}
+
+int write_image_end(dt_imageio_module_data_t *tmp,
+                    const char *filename,
+                    void *exif,
+                    int exif_len,
+                    const gboolean failed)
+{
+  dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
+  if(!exr->file) return 1;
+
+  // exif went into the header already
+  delete exr->file;
+  exr->file = NULL;
+  return failed ? 1 : 0;
+}
+
 size_t params_size(dt_imageio_module_format_t *self)
 {
-  return sizeof(dt_imageio_exr_t);
+  return offsetof(dt_imageio_exr_t, file);
 }
 
 void *legacy_params(dt_imageio_module_format_t *self,
@@ -522,20 +689,41 @@ void *legacy_params(dt_imageio_module_format_t *self,
     return n;
   }
 
+  if(old_version == 5)
+  {
+    typedef struct _imageio_exr_v6_t
+    {
+      dt_imageio_module_data_t global;
+      dt_imageio_exr_compression_t compression;
+      dt_imageio_exr_pixeltype_t pixel_type;
+      int tiled;
+    } dt_imageio_exr_v6_t;
+
+    const dt_imageio_exr_v5_t *o = (dt_imageio_exr_v5_t *)old_params;
+    dt_imageio_exr_v6_t *n = (dt_imageio_exr_v6_t *)malloc(sizeof(dt_imageio_exr_v6_t));
+
+    memcpy(n, o, sizeof(dt_imageio_exr_v5_t));
+    n->tiled = FALSE;
+
+    *new_version = 6;
+    *new_size = sizeof(dt_imageio_exr_v6_t);
+    return n;
+  }
+
   // incremental update supported:
   /*
-  typedef struct dt_imageio_exr_v6_t
+  typedef struct dt_imageio_exr_v7_t
   {
     ...
-  } dt_imageio_exr_v6_t;
+  } dt_imageio_exr_v7_t;
 
-  if(old_version == 5)
+  if(old_version == 6)
   {
-    // let's update from 5 to 6
+    // let's update from 6 to 7
 
     ...
-    *new_size = sizeof(dt_imageio_exr_v6_t);
-    *new_version = 6;
+    *new_size = sizeof(dt_imageio_exr_v7_t);
+    *new_version = 7;
     return n;
   }
   */
@@ -548,6 +736,7 @@ void *get_params(dt_imageio_module_format_t *self)
   d->compression = (dt_imageio_exr_compression_t)dt_conf_get_int("plugins/imageio/format/exr/compression");
   const int bpp = dt_conf_get_int("plugins/imageio/format/exr/bpp");
   d->pixel_type = (dt_imageio_exr_pixeltype_t)(bpp >> 4);
+  d->tiled = dt_conf_get_bool("plugins/imageio/format/exr/tiled");
   return d;
 }
 
@@ -563,6 +752,7 @@ int set_params(dt_imageio_module_format_t *self, const void *params, const int s
   dt_imageio_exr_gui_t *g = (dt_imageio_exr_gui_t *)self->gui_data;
   dt_bauhaus_combobox_set(g->bpp, d->pixel_type - EXR_PT_HALF);
   dt_bauhaus_combobox_set(g->compression, d->compression);
+  dt_bauhaus_combobox_set(g->tiled, d->tiled ? 1 : 0);
   return 0;
 }
 
@@ -608,6 +798,11 @@ static void compression_combobox_changed(GtkWidget *widget, gpointer user_data)
   dt_conf_set_int("plugins/imageio/format/exr/compression", compression);
 }
 
+static void tiled_combobox_changed(GtkWidget *widget, gpointer user_data)
+{
+  dt_conf_set_bool("plugins/imageio/format/exr/tiled", dt_bauhaus_combobox_get(widget) == 1);
+}
+
 void gui_init(dt_imageio_module_format_t *self)
 {
   self->gui_data = malloc(sizeof(dt_imageio_exr_gui_t));
@@ -650,6 +845,18 @@ void gui_init(dt_imageio_module_format_t *self)
                                   dt_confgen_get_int("plugins/imageio/format/exr/compression",
                                   DT_DEFAULT));
   gtk_box_pack_start(GTK_BOX(self->widget), gui->compression, TRUE, TRUE, 0);
+
+  // Layout combo box
+  DT_BAUHAUS_COMBOBOX_NEW_FULL(gui->tiled, self, NULL, N_("layout"),
+                               _("tiles are compressed and can be read back independently,\n"
+                                 "which helps with very large images"),
+                               dt_conf_get_bool("plugins/imageio/format/exr/tiled") ? 1 : 0,
+                               tiled_combobox_changed, self,
+                               N_("scanlines"), N_("tiles"));
+  dt_bauhaus_combobox_set_default(gui->tiled,
+                                  dt_confgen_get_bool("plugins/imageio/format/exr/tiled",
+                                  DT_DEFAULT) ? 1 : 0);
+  gtk_box_pack_start(GTK_BOX(self->widget), gui->tiled, TRUE, TRUE, 0);
 }
 
 void gui_cleanup(dt_imageio_module_format_t *self)
@@ -665,6 +872,9 @@ void gui_reset(dt_imageio_module_format_t *self)
   dt_bauhaus_combobox_set(gui->compression,
                           dt_confgen_get_int("plugins/imageio/format/exr/compression",
                           DT_DEFAULT));
+  dt_bauhaus_combobox_set(gui->tiled,
+                          dt_confgen_get_bool("plugins/imageio/format/exr/tiled",
+                          DT_DEFAULT) ? 1 : 0);
 }
 
 G_END_DECLS
@@ -82,6 +82,18 @@ REQUIRED(int, write_image, struct dt_imageio_module_data_t *data, const char *fi
                            dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                            void *exif, int exif_len, dt_imgid_t imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
                            const gboolean export_masks);
+/* streaming export of very large images, write_image_begin() returns 0 if the format can take
+   data->width x data->height pixels in bands. write_image_rows() then gets consecutive bands of
+   rows in the layout of write_image() and write_image_end() finishes the file, adding exif if
+   not NULL. formats keeping exif in their header get it in write_image_begin() already.
+   write_image_end() is called whenever write_image_begin() succeeded. */
+OPTIONAL(int, write_image_begin, struct dt_imageio_module_data_t *data, const char *filename,
+                                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                                 void *exif, int exif_len,
+                                 dt_imgid_t imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe);
+OPTIONAL(int, write_image_rows, struct dt_imageio_module_data_t *data, const void *in, const int rows);
+OPTIONAL(int, write_image_end, struct dt_imageio_module_data_t *data, const char *filename,
+                               void *exif, int exif_len, const gboolean failed);
 /* flag that describes the available precision/levels of output format. mainly used for dithering. */
 OPTIONAL(int, levels, struct dt_imageio_module_data_t *data);
 
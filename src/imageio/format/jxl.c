@@ -22,6 +22,7 @@
 #include "common/exif.h"
 #include "control/conf.h"
 #include "imageio/imageio_common.h"
+#include "imageio/imageio_module.h"
 #include "imageio/format/imageio_format_api.h"
 
 #include <jxl/encode.h>
@@ -150,7 +151,11 @@ int write_image(struct dt_imageio_module_data_t *data,
 
   JxlEncoder *encoder = JxlEncoderCreate(NULL);
 
-  const uint32_t num_threads = JxlResizableParallelRunnerSuggestThreads(width, height);
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  const uint32_t num_threads = MIN(JxlResizableParallelRunnerSuggestThreads(width, height),
+                                   (uint32_t)dt_imageio_encoder_threads());
   void *runner = JxlResizableParallelRunnerCreate(NULL);
   if(!runner) JXL_FAIL("could not create resizable parallel runner");
   JxlResizableParallelRunnerSetThreads(runner, num_threads);
@@ -410,6 +415,7 @@ int write_image(struct dt_imageio_module_data_t *data,
 
   // Finally, successful write: set to success code
   ret = 0;
+  dt_show_times_f(&start, "[jxl]", "to encode %ux%u with %u threads", width, height, num_threads);
 
 end:
   if(runner)
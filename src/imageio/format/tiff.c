@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <tiffio.h>
+#include <zlib.h>
 #ifdef HAVE_IMATH
 #include "Imath/half.h"
 #endif
@@ -41,6 +42,10 @@
 // but at least GIMP can't open TIFF files where not all layers have the same format.
 #define MASKS_USE_SAME_FORMAT
 
+// strips compressed in parallel, and how many of them are kept in memory
+#define DT_TIFF_STRIP_BYTES (1 << 20)
+#define DT_TIFF_STRIPS_PER_THREAD 2
+
 DT_MODULE(4)
 
 typedef struct dt_imageio_tiff_t
@@ -52,6 +57,7 @@ typedef struct dt_imageio_tiff_t
   int compresslevel;
   int shortfile;
   TIFF *handle;
+  int row; // next row when writing strips
 } dt_imageio_tiff_t;
 
 typedef struct dt_imageio_tiff_gui_t
@@ -64,6 +70,256 @@ typedef struct dt_imageio_tiff_gui_t
 } dt_imageio_tiff_gui_t;
 
 
+// returns FALSE if out of memory
+static gboolean _get_profile(const dt_imgid_t imgid,
+                             const dt_colorspaces_color_profile_type_t over_type,
+                             const char *over_filename,
+                             uint8_t **profile,
+                             uint32_t *profile_len)
+{
+  cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
+  *profile = NULL;
+  *profile_len = 0;
+  cmsSaveProfileToMem(out_profile, NULL, profile_len);
+  if(*profile_len > 0)
+  {
+    *profile = malloc(*profile_len);
+    if(!*profile) return FALSE;
+    cmsSaveProfileToMem(out_profile, *profile, profile_len);
+  }
+  return TRUE;
+}
+
+static void _set_image_tags(TIFF *tif,
+                            const dt_imageio_tiff_t *d,
+                            const char *filename,
+                            const uint16_t n_pages,
+                            const uint16_t layers,
+                            uint8_t *profile,
+                            const uint32_t profile_len)
+{
+  if(n_pages > 1)
+  {
+    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+    TIFFSetField(tif, TIFFTAG_PAGENAME, _("image"));
+    TIFFSetField(tif, TIFFTAG_PAGENUMBER, 0, n_pages);
+  }
+  else
+    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, 0);
+
+  TIFFSetField(tif, TIFFTAG_DOCUMENTNAME, filename);
+
+  // http://partners.adobe.com/public/developer/en/tiff/TIFFphotoshop.pdf (dated 2002)
+  // "A proprietary ZIP/Flate compression code (0x80b2) has been used by some"
+  // "software vendors. This code should be considered obsolete. We recommend"
+  // "that TIFF implementations recognize and read the obsolete code but only"
+  // "write the official compression code (0x0008)."
+  // http://www.awaresystems.be/imaging/tiff/tifftags/compression.html
+  // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
+  if(d->compress == 1)
+  {
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
+  }
+  else if(d->compress == 2)
+  {
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
+    else
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
+  }
+
+  if(profile != NULL)
+  {
+    TIFFSetField(tif, TIFFTAG_ICCPROFILE, (uint32_t)profile_len, profile);
+  }
+
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, layers);
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
+  TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT,
+               d->bpp == 32 || (d->bpp == 16 && d->pixelformat) ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32_t)d->global.width);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->global.height);
+  if(layers == 3)
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  else
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
+
+  const int resolution = dt_conf_get_int("metadata/resolution");
+  TIFFSetField(tif, TIFFTAG_XRESOLUTION, (float)resolution);
+  TIFFSetField(tif, TIFFTAG_YRESOLUTION, (float)resolution);
+  TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
+}
+
+// pack row y of the 4 channel buffer in_void into the layout of the file
+static void _pack_row(const dt_imageio_tiff_t *d,
+                      const void *in_void,
+                      const uint16_t layers,
+                      const int y,
+                      void *rowdata)
+{
+  if(d->bpp == 32)
+  {
+    const float *in = (float *)in_void + (size_t)4 * y * d->global.width;
+    float *out = (float *)rowdata;
+
+    for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
+    {
+      memcpy(out, in, sizeof(float) * layers);
+    }
+  }
+#ifdef HAVE_IMATH
+  else if(d->bpp == 16 && d->pixelformat)
+  {
+    const float *in = (float *)in_void + (size_t)4 * y * d->global.width;
+    uint16_t *out = (uint16_t *)rowdata;
+
+    for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
+    {
+      for(int l = 0; l < layers; ++l) out[l] = imath_float_to_half(in[l]);
+    }
+  }
+#endif
+  else if(d->bpp == 16 && !d->pixelformat)
+  {
+    const uint16_t *in = (uint16_t *)in_void + (size_t)4 * y * d->global.width;
+    uint16_t *out = (uint16_t *)rowdata;
+
+    for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
+    {
+      memcpy(out, in, sizeof(uint16_t) * layers);
+    }
+  }
+  else // 8bpp
+  {
+    const uint8_t *in = (uint8_t *)in_void + (size_t)4 * y * d->global.width;
+    uint8_t *out = (uint8_t *)rowdata;
+
+    for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
+    {
+      memcpy(out, in, sizeof(uint8_t) * layers);
+    }
+  }
+}
+
+// write rows, starting at row y0 of the image, from the 4 channel buffer in_void
+static int _write_rows(TIFF *tif,
+                       const dt_imageio_tiff_t *d,
+                       const void *in_void,
+                       const uint16_t layers,
+                       const int y0,
+                       const int rows,
+                       void *rowdata)
+{
+  for(int y = 0; y < rows; y++)
+  {
+    _pack_row(d, in_void, layers, y, rowdata);
+    if(TIFFWriteScanline(tif, rowdata, y0 + y, 0) == -1)
+      return 1;
+  }
+  return 0;
+}
+
+// apply the predictor set in _set_image_tags() to a packed row, the way
+// libtiff does on a little endian machine. tmp holds a row.
+static void _predict_row(const dt_imageio_tiff_t *d,
+                         const uint16_t layers,
+                         uint8_t *row,
+                         uint8_t *tmp)
+{
+  const size_t samples = (size_t)d->global.width * layers;
+  if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
+  {
+    // PREDICTOR_FLOATINGPOINT: the bytes of all samples are split into
+    // planes, most significant first, and then differenced
+    const int bps = d->bpp / 8;
+    memcpy(tmp, row, samples * bps);
+    for(size_t k = 0; k < samples; k++)
+      for(int b = 0; b < bps; b++)
+        row[(bps - b - 1) * samples + k] = tmp[bps * k + b];
+    for(size_t k = samples * bps - 1; k >= layers; k--)
+      row[k] -= row[k - layers];
+  }
+  else if(d->bpp == 16)
+  {
+    uint16_t *row16 = (uint16_t *)row;
+    for(size_t k = samples - 1; k >= layers; k--)
+      row16[k] -= row16[k - layers];
+  }
+  else
+  {
+    for(size_t k = samples - 1; k >= layers; k--)
+      row[k] -= row[k - layers];
+  }
+}
+
+// deflate strips of about DT_TIFF_STRIP_BYTES on all threads of the export
+// and write them in order, a group of strips at a time
+static int _write_strips_parallel(TIFF *tif,
+                                  const dt_imageio_tiff_t *d,
+                                  const void *in_void,
+                                  const uint16_t layers,
+                                  const size_t rowsize)
+{
+  const int height = d->global.height;
+  const int rows = CLAMP(DT_TIFF_STRIP_BYTES / rowsize, 1, height);
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)rows);
+
+  const int strips = (height + rows - 1) / rows;
+  const int threads = dt_imageio_encoder_threads();
+  const int group = MIN(strips, threads * DT_TIFF_STRIPS_PER_THREAD);
+  const size_t raw_size = rowsize * rows;
+  const size_t out_size = compressBound(raw_size);
+  const gboolean predict = d->compress == 2;
+  const int level = d->compresslevel;
+
+  uint8_t *raw = g_try_malloc(raw_size * group);
+  uint8_t *out = g_try_malloc(out_size * group);
+  uLongf *lengths = g_new(uLongf, group);
+  int rc = raw && out ? 0 : 1;
+
+  for(int first = 0; !rc && first < strips; first += group)
+  {
+    const int n = MIN(group, strips - first);
+    int failed = 0;
+    DT_OMP_FOR(num_threads(threads) reduction(|:failed))
+    for(int k = 0; k < n; k++)
+    {
+      uint8_t *strip = raw + k * raw_size;
+      const int y0 = (first + k) * rows;
+      const int nrows = MIN(rows, height - y0);
+      uint8_t *tmp = predict ? g_malloc(rowsize) : NULL;
+      for(int y = 0; y < nrows; y++)
+      {
+        uint8_t *row = strip + y * rowsize;
+        _pack_row(d, in_void, layers, y0 + y, row);
+        if(predict) _predict_row(d, layers, row, tmp);
+      }
+      g_free(tmp);
+
+      lengths[k] = out_size;
+      failed |= compress2(out + k * out_size, &lengths[k], strip, nrows * rowsize, level) != Z_OK;
+    }
+    rc = failed;
+
+    for(int k = 0; !rc && k < n; k++)
+      if(TIFFWriteRawStrip(tif, first + k, out + k * out_size, lengths[k]) == -1)
+        rc = 1;
+  }
+
+  g_free(lengths);
+  g_free(out);
+  g_free(raw);
+  return rc;
+}
+
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, dt_imgid_t imgid, int num, int total, dt_dev_pixelpipe_t *pipe,
@@ -85,17 +341,10 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
 #endif
   int rc = 1; // default to error
 
-  cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
-  cmsSaveProfileToMem(out_profile, NULL, &profile_len);
-  if(profile_len > 0)
+  if(!_get_profile(imgid, over_type, over_filename, &profile, &profile_len))
   {
-    profile = malloc(profile_len);
-    if(!profile)
-    {
-      rc = 1;
-      goto exit;
-    }
-    cmsSaveProfileToMem(out_profile, profile, &profile_len);
+    rc = 1;
+    goto exit;
   }
 
   uint16_t n_pages = 1;
@@ -119,45 +368,6 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     goto exit;
   }
 
-  if(n_pages > 1)
-  {
-    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
-    TIFFSetField(tif, TIFFTAG_PAGENAME, _("image"));
-    TIFFSetField(tif, TIFFTAG_PAGENUMBER, 0, n_pages);
-  }
-  else
-    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, 0);
-
-  TIFFSetField(tif, TIFFTAG_DOCUMENTNAME, filename);
-
-  // http://partners.adobe.com/public/developer/en/tiff/TIFFphotoshop.pdf (dated 2002)
-  // "A proprietary ZIP/Flate compression code (0x80b2) has been used by some"
-  // "software vendors. This code should be considered obsolete. We recommend"
-  // "that TIFF implementations recognize and read the obsolete code but only"
-  // "write the official compression code (0x0008)."
-  // http://www.awaresystems.be/imaging/tiff/tifftags/compression.html
-  // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
-  if(d->compress == 1)
-  {
-    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-    TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-  }
-  else if(d->compress == 2)
-  {
-    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-    if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
-    else
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-  }
-
-  if(profile != NULL)
-  {
-    TIFFSetField(tif, TIFFTAG_ICCPROFILE, (uint32_t)profile_len, profile);
-  }
-
 /* Howto check for a grayscale image?
    We test every pixel for differences between the rgb channels using specific thresholds
    for every precision. If there is such a pixel we keep it as an rgb image, otherwise
@@ -227,25 +437,8 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   if(d->shortfile && layers == 3)
     dt_print(DT_DEBUG_IMAGEIO, "[tiff export] '%s' is not a B&W image, not exporting as grayscale\n", filename);
 
-  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, layers);
-  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
-  TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT,
-               d->bpp == 32 || (d->bpp == 16 && d->pixelformat) ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
-  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32_t)d->global.width);
-  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->global.height);
-  if(layers == 3)
-    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-  else
-    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-
-  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-  TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
-
+  _set_image_tags(tif, d, filename, n_pages, layers, profile, profile_len);
   const int resolution = dt_conf_get_int("metadata/resolution");
-  TIFFSetField(tif, TIFFTAG_XRESOLUTION, (float)resolution);
-  TIFFSetField(tif, TIFFTAG_YRESOLUTION, (float)resolution);
-  TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
 
   const size_t rowsize = (d->global.width * layers) * d->bpp / 8;
   if((rowdata = malloc(rowsize)) == NULL)
@@ -254,84 +447,25 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     goto exit;
   }
 
-  if(d->bpp == 32)
+  // libtiff deflates on this thread only, do that ahead of it instead.
+  // the predictor is applied as for a little endian file on a little
+  // endian machine.
+  const gboolean parallel = d->compress > 0
+    && G_BYTE_ORDER == G_LITTLE_ENDIAN
+    && dt_imageio_encoder_threads() > 1
+    && dt_conf_get_bool("plugins/imageio/format/tiff/parallel");
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+  if(parallel
+     ? _write_strips_parallel(tif, d, in_void, layers, rowsize)
+     : _write_rows(tif, d, in_void, layers, 0, d->global.height, rowdata))
   {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      float *in = (float *)in_void + (size_t)4 * y * d->global.width;
-      float *out = (float *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(float) * layers);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-#ifdef HAVE_IMATH
-  else if(d->bpp == 16 && d->pixelformat)
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      float *in = (float *)in_void + (size_t)4 * y * d->global.width;
-      uint16_t *out = (uint16_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        for(int l = 0; l < layers; ++l) out[l] = imath_float_to_half(in[l]);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-#endif
-  else if(d->bpp == 16 && !d->pixelformat)
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint16_t *in = (uint16_t *)in_void + (size_t)4 * y * d->global.width;
-      uint16_t *out = (uint16_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(uint16_t) * layers);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-  else // 8bpp
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint8_t *in = (uint8_t *)in_void + (size_t)4 * y * d->global.width;
-      uint8_t *out = (uint8_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(uint8_t) * layers);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
+    rc = 1;
+    goto exit;
   }
+  dt_show_times_f(&start, "[tiff export]", "to write %dx%d%s", d->global.width, d->global.height,
+                  parallel ? " with parallel compression" : "");
 
   rc = 0;
 
@@ -585,9 +719,71 @@ exit:
   return rc;
 }
 
+int write_image_begin(dt_imageio_module_data_t *d_tmp, const char *filename,
+                      dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                      void *exif, int exif_len,
+                      dt_imgid_t imgid, int num, int total, dt_dev_pixelpipe_t *pipe)
+{
+  dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+
+  // the grayscale check needs the whole image
+  if(d->shortfile) return 1;
+
+  uint8_t *profile = NULL;
+  uint32_t profile_len = 0;
+  if(!_get_profile(imgid, over_type, over_filename, &profile, &profile_len))
+    return 1;
+
+#ifdef _WIN32
+  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
+  d->handle = TIFFOpenW(wfilename, "wl");
+  g_free(wfilename);
+#else
+  d->handle = TIFFOpen(filename, "wl");
+#endif
+
+  if(d->handle)
+    _set_image_tags(d->handle, d, filename, 1, 3, profile, profile_len);
+  d->row = 0;
+  free(profile);
+  return d->handle ? 0 : 1;
+}
+
+int write_image_rows(dt_imageio_module_data_t *d_tmp, const void *in, const int rows)
+{
+  dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+  if(!d->handle) return 1;
+
+  void *rowdata = malloc((size_t)d->global.width * 3 * d->bpp / 8);
+  const int rc = rowdata ? _write_rows(d->handle, d, in, 3, d->row, rows, rowdata) : 1;
+  free(rowdata);
+  d->row += rows;
+  return rc;
+}
+
+int write_image_end(dt_imageio_module_data_t *d_tmp, const char *filename,
+                    void *exif, int exif_len, const gboolean failed)
+{
+  dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+  if(!d->handle) return 1;
+
+  TIFFClose(d->handle);
+  d->handle = NULL;
+  if(failed) return 1;
+
+  int rc = 0;
+  if(exif)
+  {
+    rc = dt_exif_write_blob(exif, exif_len, filename, d->compress > 0);
+    // Until we get symbolic error status codes, if rc is 1, return 0
+    rc = (rc == 1) ? 0 : 1;
+  }
+  return rc;
+}
+
 size_t params_size(dt_imageio_module_format_t *self)
 {
-  return sizeof(dt_imageio_tiff_t) - sizeof(TIFF *);
+  return offsetof(dt_imageio_tiff_t, handle);
 }
 
 void *legacy_params(dt_imageio_module_format_t *self,
@@ -147,6 +147,8 @@ int write_image(dt_imageio_module_data_t *webp, const char *filename, const void
   // TODO(jinxos): these values should be adjusted as needed and ideally determined at runtime.
   config.segments = 4;
   config.partition_limit = 70;
+  // libwebp only knows single or multi-threaded
+  config.thread_level = dt_imageio_encoder_threads() > 1 ? 1 : 0;
   if(!WebPValidateConfig(&config))
   {
     dt_print(DT_DEBUG_ALWAYS, "[webp export] error validating encoder configuration");
@@ -198,12 +200,16 @@ int write_image(dt_imageio_module_data_t *webp, const char *filename, const void
     WebPPictureSharpARGBToYUVA(&pic);
   }
 
+  dt_times_t start;
+  dt_get_perf_times(&start);
   if(!WebPEncode(&config, &pic))
   {
     dt_print(DT_DEBUG_ALWAYS, "[webp export] error (%d) during encoding: %s", pic.error_code,
             get_error_str(pic.error_code));
     goto error;
   }
+  dt_show_times_f(&start, "[webp export]", "to encode %dx%d, %s", pic.width, pic.height,
+                  config.thread_level ? "multi-threaded" : "single-threaded");
 
   bitstream.bytes = writer.mem;
   bitstream.size = writer.size;
@@ -22,6 +22,8 @@
 #include "common/debug.h"
 #include "common/exif.h"
 #include "common/image_cache.h"
+#include "common/imagebuf.h"
+#include "common/memory_account.h"
 #include "common/mipmap_cache.h"
 #include "common/styles.h"
 #include "control/conf.h"
@@ -29,6 +31,7 @@
 #include "develop/blend.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
+#include "develop/imageop_math.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_module.h"
 
@@ -90,6 +93,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #ifdef USE_LUA
 #include "lua/image.h"
@@ -142,6 +148,14 @@ typedef enum {
 // the longest string of magic bytes
 #define MAX_MAGIC 32
 
+// streamed exports are processed in bands of about this many bytes of float output
+#define DT_EXPORT_BAND_BYTES ((size_t)256 << 20)
+#define DT_EXPORT_BAND_MIN_ROWS 64
+
+// small exports start from DT_MIPMAP_F if it has at least this many times
+// the pixels per side of the output
+#define DT_EXPORT_MIPMAP_OVERSAMPLING 2.0
+
 // declare the image-loading function's type
 typedef dt_imageio_retval_t dt_image_loader_fn_t(dt_image_t *img,
                                                  const char *filename,
@@ -651,12 +665,352 @@ dt_image_flags_t dt_imageio_get_type_from_extension(const char *extension)
   return 0;
 }
 
+// a mapped file that is truncated or goes away while it's decoded raises
+// SIGBUS instead of a read error. only map files on local storage.
+static gboolean _file_is_local(const char *filename)
+{
+  GFile *file = g_file_new_for_path(filename);
+  GFileInfo *info = g_file_query_filesystem_info(file, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE,
+                                                 NULL, NULL);
+  const gboolean local = info
+    && !g_file_info_get_attribute_boolean(info, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE);
+  if(info) g_object_unref(info);
+  g_object_unref(file);
+  return local;
+}
+
+GMappedFile *dt_imageio_map_file(const char *filename)
+{
+  if(!dt_conf_get_bool("raw_file_mmap") || !_file_is_local(filename)) return NULL;
+
+  GError *error = NULL;
+  GMappedFile *map = g_mapped_file_new(filename, FALSE, &error);
+  if(!map)
+  {
+    dt_print(DT_DEBUG_IMAGEIO, "[dt_imageio_map_file] can't map '%s': %s",
+             filename, error->message);
+    g_error_free(error);
+    return NULL;
+  }
+  if(g_mapped_file_get_length(map) == 0)
+  {
+    g_mapped_file_unref(map);
+    return NULL;
+  }
+
+#ifndef _WIN32
+  // the decoders walk the file front to back, start reading it right away
+  void *data = g_mapped_file_get_contents(map);
+  const size_t length = g_mapped_file_get_length(map);
+  madvise(data, length, MADV_SEQUENTIAL);
+  madvise(data, length, MADV_WILLNEED);
+#endif
+  return map;
+}
+
+void dt_imageio_unmap_file(GMappedFile *map)
+{
+  if(!map) return;
+#ifndef _WIN32
+  // the decoded image is all we keep, don't leave the file resident
+  madvise(g_mapped_file_get_contents(map), g_mapped_file_get_length(map), MADV_DONTNEED);
+#endif
+  g_mapped_file_unref(map);
+}
+
+// limits for walking untrusted containers
+#define DT_PREVIEW_MAX_IFDS 32
+#define DT_PREVIEW_MAX_ENTRIES 1024
+#define DT_PREVIEW_MAX_SUBIFDS 8
+#define DT_PREVIEW_MAX_MARKERS 32
+#define DT_PREVIEW_MAX_BOXES 64
+
+typedef struct _preview_reader_t
+{
+  FILE *f;
+  int64_t size;
+  gboolean big_endian;
+  int ifds_left;
+  // the largest baseline jpeg found so far
+  int64_t offset;
+  uint32_t length;
+} _preview_reader_t;
+
+static gboolean _preview_read(_preview_reader_t *r,
+                              const int64_t offset,
+                              void *out,
+                              const size_t length)
+{
+  return offset >= 0
+    && offset + (int64_t)length <= r->size
+    && !fseek(r->f, offset, SEEK_SET)
+    && fread(out, 1, length, r->f) == length;
+}
+
+static uint32_t _preview_u16(const _preview_reader_t *r, const uint8_t *p)
+{
+  return r->big_endian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+}
+
+static uint32_t _preview_u32(const _preview_reader_t *r, const uint8_t *p)
+{
+  return r->big_endian
+    ? ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]
+    : ((uint32_t)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+static uint32_t _be_u32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// raw data is often stored as lossless jpeg as well, only take what
+// libjpeg can decode
+static gboolean _preview_is_baseline(_preview_reader_t *r, const int64_t offset)
+{
+  uint8_t m[4];
+  if(!_preview_read(r, offset, m, 2) || m[0] != 0xff || m[1] != 0xd8) return FALSE;
+
+  int64_t pos = offset + 2;
+  for(int k = 0; k < DT_PREVIEW_MAX_MARKERS; k++)
+  {
+    if(!_preview_read(r, pos, m, 4) || m[0] != 0xff) return FALSE;
+    if(m[1] == 0xc0 || m[1] == 0xc1 || m[1] == 0xc2) return TRUE;
+    // any other frame type, or image data before a frame header
+    if((m[1] >= 0xc3 && m[1] <= 0xcf && m[1] != 0xc4 && m[1] != 0xc8 && m[1] != 0xcc)
+       || m[1] == 0xda || m[1] == 0xd9)
+      return FALSE;
+    pos += 2 + ((m[2] << 8) | m[3]);
+  }
+  return FALSE;
+}
+
+static void _preview_candidate(_preview_reader_t *r, const int64_t offset, const uint32_t length)
+{
+  if(length > r->length
+     && offset + (int64_t)length <= r->size
+     && _preview_is_baseline(r, offset))
+  {
+    r->offset = offset;
+    r->length = length;
+  }
+}
+
+static void _preview_scan_ifd(_preview_reader_t *r, uint32_t offset, const int depth)
+{
+  while(offset && r->ifds_left-- > 0)
+  {
+    uint8_t head[2];
+    if(!_preview_read(r, offset, head, 2)) return;
+    const uint32_t count = _preview_u16(r, head);
+    if(count == 0 || count > DT_PREVIEW_MAX_ENTRIES) return;
+
+    const size_t bytes = 12 * count + 4;
+    uint8_t *entries = g_malloc(bytes);
+    if(!_preview_read(r, offset + 2, entries, bytes))
+    {
+      g_free(entries);
+      return;
+    }
+
+    uint32_t jpeg_offset = 0, jpeg_length = 0;
+    uint32_t strip_offset = 0, strip_length = 0, strips = 0;
+    uint32_t compression = 0, subfile = 0;
+    uint32_t subifds[DT_PREVIEW_MAX_SUBIFDS];
+    int num_subifds = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+      const uint8_t *e = entries + 12 * i;
+      const uint32_t tag = _preview_u16(r, e);
+      const uint32_t type = _preview_u16(r, e + 2);
+      const uint32_t n = _preview_u32(r, e + 4);
+      // a single short is stored in the first half of the value field
+      const uint32_t value = type == 3 ? _preview_u16(r, e + 8) : _preview_u32(r, e + 8);
+
+      switch(tag)
+      {
+        case 0x00fe: // NewSubfileType
+          subfile = value;
+          break;
+        case 0x0103: // Compression
+          compression = value;
+          break;
+        case 0x0111: // StripOffsets
+          strip_offset = value;
+          strips = n;
+          break;
+        case 0x0117: // StripByteCounts
+          strip_length = value;
+          break;
+        case 0x0201: // JPEGInterchangeFormat
+          jpeg_offset = value;
+          break;
+        case 0x0202: // JPEGInterchangeFormatLength
+          jpeg_length = value;
+          break;
+        case 0x002e: // JpgFromRaw of Panasonic, stored as undefined bytes
+          if(type == 7 && n > 4) _preview_candidate(r, value, n);
+          break;
+        case 0x014a: // SubIFDs
+          if(n == 1 && num_subifds < DT_PREVIEW_MAX_SUBIFDS)
+            subifds[num_subifds++] = value;
+          else if(n > 1)
+          {
+            uint8_t list[4 * DT_PREVIEW_MAX_SUBIFDS];
+            const int num = MIN(n, DT_PREVIEW_MAX_SUBIFDS - num_subifds);
+            if(num > 0 && _preview_read(r, value, list, 4 * num))
+              for(int k = 0; k < num; k++)
+                subifds[num_subifds++] = _preview_u32(r, list + 4 * k);
+          }
+          break;
+        default:
+          break;
+      }
+    }
+    const uint32_t next = _preview_u32(r, entries + 12 * count);
+    g_free(entries);
+
+    if(jpeg_offset && jpeg_length)
+      _preview_candidate(r, jpeg_offset, jpeg_length);
+    // a jpeg compressed reduced resolution image in one strip, like the DNG previews
+    if(strips == 1 && (compression == 6 || compression == 7) && (subfile & 1))
+      _preview_candidate(r, strip_offset, strip_length);
+
+    if(depth < 2)
+      for(int k = 0; k < num_subifds; k++)
+        _preview_scan_ifd(r, subifds[k], depth + 1);
+
+    offset = next;
+  }
+}
+
+// Canon CR3 keeps a 1620x1080 jpeg in a PRVW box inside this uuid box
+static const uint8_t _cr3_preview_uuid[16] =
+  { 0xea, 0xf4, 0x2b, 0x5e, 0x1c, 0x98, 0x4b, 0x88,
+    0xb9, 0xfb, 0xb7, 0xdc, 0x40, 0x6e, 0x4d, 0x16 };
+
+static void _preview_scan_bmff(_preview_reader_t *r)
+{
+  int64_t pos = 0;
+  for(int k = 0; k < DT_PREVIEW_MAX_BOXES && pos < r->size; k++)
+  {
+    uint8_t box[8 + 16];
+    if(!_preview_read(r, pos, box, 8)) return;
+    int64_t size = _be_u32(box);
+    if(size == 0) size = r->size - pos;
+    if(size == 1)
+    {
+      uint8_t large[8];
+      if(!_preview_read(r, pos + 8, large, 8)) return;
+      size = ((int64_t)_be_u32(large) << 32) | _be_u32(large + 4);
+    }
+    if(size < 8) return;
+
+    if(!memcmp(box + 4, "uuid", 4)
+       && _preview_read(r, pos + 8, box + 8, 16)
+       && !memcmp(box + 8, _cr3_preview_uuid, 16))
+    {
+      // the PRVW box follows a few bytes into the payload
+      uint8_t payload[64];
+      const int64_t start = pos + 24;
+      const size_t len = MIN(sizeof(payload), (size_t)MAX(0, r->size - start));
+      if(!_preview_read(r, start, payload, len)) return;
+      for(size_t i = 4; i + 20 <= len; i++)
+      {
+        if(memcmp(payload + i, "PRVW", 4)) continue;
+        // unknown(4) 1(2) width(2) height(2) 1(2) jpeg length(4) jpeg
+        _preview_candidate(r, start + i + 20, _be_u32(payload + i + 16));
+        return;
+      }
+      return;
+    }
+    pos += size;
+  }
+}
+
+gboolean dt_imageio_embedded_preview(const char *filename,
+                                     const int width,
+                                     const int height,
+                                     uint8_t **buffer,
+                                     int32_t *out_width,
+                                     int32_t *out_height,
+                                     dt_colorspaces_color_profile_type_t *color_space)
+{
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return TRUE;
+
+  _preview_reader_t r = { .f = f, .ifds_left = DT_PREVIEW_MAX_IFDS };
+  uint8_t head[12] = { 0 };
+  if(!fseek(f, 0, SEEK_END)) r.size = ftell(f);
+
+  if(_preview_read(&r, 0, head, sizeof(head)))
+  {
+    if(!memcmp(head + 4, "ftypcrx ", 8))
+      _preview_scan_bmff(&r);
+    else if((head[0] == 'I' && head[1] == 'I') || (head[0] == 'M' && head[1] == 'M'))
+    {
+      // the magic number varies (ORF, RW2), the first IFD is where tiff has it
+      r.big_endian = head[0] == 'M';
+      _preview_scan_ifd(&r, _preview_u32(&r, head + 4), 0);
+    }
+  }
+
+  uint8_t *jpeg = r.length ? g_try_malloc(r.length) : NULL;
+  const gboolean read = jpeg && _preview_read(&r, r.offset, jpeg, r.length);
+  fclose(f);
+  if(!read)
+  {
+    g_free(jpeg);
+    return TRUE;
+  }
+
+  gboolean res = TRUE;
+  dt_imageio_jpeg_t jpg;
+  if(!dt_imageio_jpeg_decompress_header(jpeg, r.length, &jpg))
+  {
+    dt_imageio_jpeg_scale_to_fit(&jpg, width, height);
+    *buffer = dt_alloc_align_uint8((size_t)4 * jpg.width * jpg.height);
+    if(!*buffer)
+      jpeg_destroy_decompress(&jpg.dinfo);
+    else if(dt_imageio_jpeg_decompress(&jpg, *buffer))
+    {
+      dt_free_align(*buffer);
+      *buffer = NULL;
+    }
+    else
+    {
+      *out_width = jpg.width;
+      *out_height = jpg.height;
+      // as for dt_imageio_large_thumbnail(), assume sRGB
+      *color_space = DT_COLORSPACE_SRGB;
+      res = FALSE;
+    }
+  }
+  dt_print(DT_DEBUG_IMAGEIO,
+           "[dt_imageio_embedded_preview] %s %u bytes at %" PRId64 " of '%s'",
+           res ? "failed to decode" : "decoded", r.length, r.offset, filename);
+  g_free(jpeg);
+  return res;
+}
+
 // load a full-res thumbnail:
 gboolean dt_imageio_large_thumbnail(const char *filename,
                                     uint8_t **buffer,
                                     int32_t *width,
                                     int32_t *height,
                                     dt_colorspaces_color_profile_type_t *color_space)
+{
+  return dt_imageio_large_thumbnail_fit(filename, 0, 0, buffer, width, height, color_space);
+}
+
+gboolean dt_imageio_large_thumbnail_fit(const char *filename,
+                                        const int fit_width,
+                                        const int fit_height,
+                                        uint8_t **buffer,
+                                        int32_t *width,
+                                        int32_t *height,
+                                        dt_colorspaces_color_profile_type_t *color_space)
 {
   int res = TRUE;
 
@@ -674,9 +1028,15 @@ gboolean dt_imageio_large_thumbnail(const char *filename,
     dt_imageio_jpeg_t jpg;
     if(dt_imageio_jpeg_decompress_header(buf, bufsize, &jpg))
       goto error;
+    if(fit_width > 0 && fit_height > 0)
+      dt_imageio_jpeg_scale_to_fit(&jpg, fit_width, fit_height);
 
     *buffer = dt_alloc_align_uint8(4 * jpg.width * jpg.height);
-    if(!*buffer) goto error;
+    if(!*buffer)
+    {
+      jpeg_destroy_decompress(&jpg.dinfo);
+      goto error;
+    }
 
     *width = jpg.width;
     *height = jpg.height;
@@ -828,8 +1188,9 @@ gboolean dt_imageio_has_mono_preview(const char *filename)
   int32_t thumb_width = 0, thumb_height = 0;
   gboolean mono = FALSE;
 
-  if(dt_imageio_large_thumbnail(filename, &tmp, &thumb_width,
-                                &thumb_height, &color_space))
+  // a colour cast survives scaling, no need to look at every pixel
+  if(dt_imageio_large_thumbnail_fit(filename, 512, 512, &tmp, &thumb_width,
+                                    &thumb_height, &color_space))
     goto cleanup;
   if((thumb_width < 32) || (thumb_height < 32) || (tmp == NULL))
     goto cleanup;
@@ -867,44 +1228,7 @@ void dt_imageio_flip_buffers(char *out,
                              const int stride,
                              const dt_image_orientation_t orientation)
 {
-  if(!orientation)
-  {
-    DT_OMP_FOR()
-    for(int j = 0; j < ht; j++)
-      memcpy(out + (size_t)j * bpp * wd, in + (size_t)j * stride, bpp * wd);
-    return;
-  }
-  int ii = 0;
-  int jj = 0;
-  int si = bpp;
-  int sj = wd * bpp;
-  if(orientation & ORIENTATION_SWAP_XY)
-  {
-    sj = bpp;
-    si = ht * bpp;
-  }
-  if(orientation & ORIENTATION_FLIP_Y)
-  {
-    jj = (int)fht - jj - 1;
-    sj = -sj;
-  }
-  if(orientation & ORIENTATION_FLIP_X)
-  {
-    ii = (int)fwd - ii - 1;
-    si = -si;
-  }
-  DT_OMP_FOR()
-  for(int j = 0; j < ht; j++)
-  {
-    char *out2 = out + (size_t)labs(sj) * jj + (size_t)labs(si) * ii + (size_t)sj * j;
-    const char *in2 = in + (size_t)stride * j;
-    for(int i = 0; i < wd; i++)
-    {
-      memcpy(out2, in2, bpp);
-      in2 += bpp;
-      out2 += si;
-    }
-  }
+  dt_iop_image_orient(out, in, bpp, wd, ht, fwd, fht, stride, orientation);
 }
 
 void dt_imageio_flip_buffers_ui8_to_float(float *out,
@@ -1040,6 +1364,297 @@ static double _get_pipescale(dt_dev_pixelpipe_t *pipe,
   return fmin(scalex, scaley);
 }
 
+// the nodes have been created for the full sized input
+static void _export_input_changed(dt_dev_pixelpipe_t *pipe)
+{
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    piece->iscale = pipe->iscale;
+    piece->iwidth = pipe->iwidth;
+    piece->iheight = pipe->iheight;
+  }
+}
+
+// exports much smaller than the image without high quality processing start
+// from the downscaled DT_MIPMAP_F input of the preview pipe, which replaces
+// the full buffer in buf. Returns TRUE if the input of the pipe has been replaced.
+static gboolean _export_mipmap_input(dt_dev_pixelpipe_t *pipe,
+                                     dt_develop_t *dev,
+                                     dt_mipmap_buffer_t *buf,
+                                     const double scale)
+{
+  const dt_image_t *img = &dev->image_storage;
+  const dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  const double mip_scale = fmin(1.0, fmin((double)cache->max_width[DT_MIPMAP_F] / buf->width,
+                                          (double)cache->max_height[DT_MIPMAP_F] / buf->height));
+  if(scale * DT_EXPORT_MIPMAP_OVERSAMPLING > mip_scale) return FALSE;
+
+  dt_mipmap_buffer_t mip;
+  dt_mipmap_cache_get(&mip, img->id, DT_MIPMAP_F, DT_MIPMAP_BLOCKING, 'r');
+  // iscale is the downscaling factor, the mip might be smaller than expected
+  if(!mip.buf || !mip.width || !mip.height
+     || scale * DT_EXPORT_MIPMAP_OVERSAMPLING * mip.iscale > 1.0)
+  {
+    dt_mipmap_cache_release(&mip);
+    return FALSE;
+  }
+
+  dt_dev_pixelpipe_set_input(pipe, dev, (float *)mip.buf, mip.width, mip.height, mip.iscale);
+  _export_input_changed(pipe);
+
+  dt_print(DT_DEBUG_IMAGEIO | DT_DEBUG_PIPE,
+           "[dt_imageio_export] ID=%d from mipmap %ix%i instead of %ix%i",
+           img->id, mip.width, mip.height, buf->width, buf->height);
+  dt_mipmap_cache_release(buf);
+  *buf = mip;
+  return TRUE;
+}
+
+// thumbnails of mosaiced raws much smaller than the sensor are processed from a
+// CFA downsampled by 1/2 (1/3 for xtrans) right at the pipe input, as done for the
+// DT_MIPMAP_F buffer of the preview pipe. The raw modules use the input scale to
+// adapt their parameters. Returns TRUE if the input of the pipe has been replaced.
+static gboolean _thumbnail_mosaic_input(dt_dev_pixelpipe_t *pipe,
+                                        dt_develop_t *dev,
+                                        const dt_mipmap_buffer_t *buf,
+                                        const double scale,
+                                        void **mosaic)
+{
+  const dt_image_t *img = &dev->image_storage;
+  const uint32_t filters = img->buf_dsc.filters;
+  const dt_iop_buffer_type_t datatype = img->buf_dsc.datatype;
+  const int factor = filters == 9u ? 3 : 2;
+
+  if(!filters
+     || (datatype != TYPE_FLOAT && datatype != TYPE_UINT16)
+     || scale * factor > 1.0)
+    return FALSE;
+
+  const dt_iop_roi_t roi_in = { .width = buf->width, .height = buf->height, .scale = 1.0f };
+  const dt_iop_roi_t roi_out = { .width = buf->width / factor,
+                                 .height = buf->height / factor,
+                                 .scale = 1.0f / factor };
+  const size_t bpp = datatype == TYPE_FLOAT ? sizeof(float) : sizeof(uint16_t);
+  void *out = dt_alloc_aligned((size_t)roi_out.width * roi_out.height * bpp);
+  if(!out) return FALSE;
+
+  if(filters != 9u && datatype == TYPE_FLOAT)
+    dt_iop_clip_and_zoom_mosaic_half_size_f(out, (const float *)buf->buf, &roi_out, &roi_in,
+                                            roi_out.width, roi_in.width, filters);
+  else if(filters != 9u)
+    dt_iop_clip_and_zoom_mosaic_half_size(out, (const uint16_t *)buf->buf, &roi_out, &roi_in,
+                                          roi_out.width, roi_in.width, filters);
+  else if(datatype == TYPE_FLOAT)
+    dt_iop_clip_and_zoom_mosaic_third_size_xtrans_f(out, (const float *)buf->buf,
+                                                    &roi_out, &roi_in, roi_out.width,
+                                                    roi_in.width, img->buf_dsc.xtrans);
+  else
+    dt_iop_clip_and_zoom_mosaic_third_size_xtrans(out, (const uint16_t *)buf->buf,
+                                                  &roi_out, &roi_in, roi_out.width,
+                                                  roi_in.width, img->buf_dsc.xtrans);
+
+  dt_dev_pixelpipe_set_input(pipe, dev, out, roi_out.width, roi_out.height,
+                             buf->iscale * factor);
+  _export_input_changed(pipe);
+
+  dt_print(DT_DEBUG_IMAGEIO | DT_DEBUG_PIPE,
+           "[dt_imageio_export] thumbnail ID=%d from 1/%i mosaic %ix%i",
+           img->id, factor, roi_out.width, roi_out.height);
+  *mosaic = out;
+  return TRUE;
+}
+
+// a band of rows is only the same as the corresponding rows of the full
+// image if all enabled modules can work on a region of their input,
+// modules using global image data (like hazeremoval) would give seams.
+static gboolean _export_bands_allowed(const dt_dev_pixelpipe_t *pipe)
+{
+  for(const GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    if(piece->enabled && !(piece->module->flags() & IOP_FLAGS_ALLOW_TILING))
+    {
+      dt_print(DT_DEBUG_IMAGEIO,
+               "[dt_imageio_export] no banded export, module `%s' needs the full image",
+               piece->module->op);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// process the rows y .. y + height of the export
+static void _export_process(dt_dev_pixelpipe_t *pipe,
+                            dt_develop_t *dev,
+                            const int y,
+                            const int width,
+                            const int height,
+                            const double scale,
+                            const gboolean hq_process,
+                            const int bpp)
+{
+  if(hq_process)
+  {
+    /*
+     * if high quality processing was requested, downsampling will be done
+     * at the very end of the pipe (just before border and watermark)
+     */
+    dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, y, width, height, scale);
+  }
+  else
+  {
+    // else, downsampling will be right after demosaic
+
+    // so we need to turn temporarily disable in-pipe late downsampling iop.
+
+    // find the finalscale module
+    dt_dev_pixelpipe_iop_t *finalscale = NULL;
+    {
+      for(const GList *nodes = g_list_last(pipe->nodes);
+          nodes;
+          nodes = g_list_previous(nodes))
+      {
+        dt_dev_pixelpipe_iop_t *node = nodes->data;
+        if(dt_iop_module_is_finalscale(node->module))
+        {
+          finalscale = node;
+          break;
+        }
+      }
+    }
+
+    if(finalscale) finalscale->enabled = FALSE;
+
+    // do the processing (8-bit with special treatment, to make sure
+    // we can use openmp further down):
+    if(bpp == 8)
+      dt_dev_pixelpipe_process(pipe, dev, 0, y, width, height, scale, DT_DEVICE_NONE);
+    else
+      dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, y, width, height, scale);
+
+    if(finalscale) finalscale->enabled = TRUE;
+  }
+}
+
+// convert the pipe output to what the format asked for
+static void _export_convert(uint8_t *outbuf,
+                            const size_t npixels,
+                            const int bpp,
+                            const gboolean hq_process,
+                            const gboolean display_byteorder)
+{
+  // downconversion to low-precision formats:
+  if(bpp == 8)
+  {
+    if(display_byteorder)
+    {
+      if(hq_process)
+      {
+        const float *const inbuf = (float *)outbuf;
+        for(size_t k = 0; k < npixels; k++)
+        {
+          // convert in place, this is unfortunately very serial..
+          const uint8_t r = roundf(CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff));
+          const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
+          const uint8_t b = roundf(CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff));
+          outbuf[4 * k + 0] = r;
+          outbuf[4 * k + 1] = g;
+          outbuf[4 * k + 2] = b;
+        }
+      }
+      // else processing output was 8-bit already, and no need to swap order
+    }
+    else // need to flip
+    {
+      // ldr output: char
+      if(hq_process)
+      {
+        const float *const inbuf = (float *)outbuf;
+        for(size_t k = 0; k < npixels; k++)
+        {
+          // convert in place, this is unfortunately very serial..
+          const uint8_t r = roundf(CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff));
+          const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
+          const uint8_t b = roundf(CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff));
+          outbuf[4 * k + 0] = r;
+          outbuf[4 * k + 1] = g;
+          outbuf[4 * k + 2] = b;
+        }
+      }
+      else
+      { // !display_byteorder, need to swap:
+        uint8_t *const buf8 = outbuf;
+        DT_OMP_FOR()
+        // just flip byte order
+        for(size_t k = 0; k < npixels; k++)
+        {
+          uint8_t tmp = buf8[4 * k + 0];
+          buf8[4 * k + 0] = buf8[4 * k + 2];
+          buf8[4 * k + 2] = tmp;
+        }
+      }
+    }
+  }
+  else if(bpp == 16)
+  {
+    // uint16_t per color channel
+    float *buff = (float *)outbuf;
+    uint16_t *buf16 = (uint16_t *)outbuf;
+    for(size_t k = 0; k < npixels; k++)
+    {
+      // convert in place
+      for(int i = 0; i < 3; i++)
+        buf16[4 * k + i] = roundf(CLAMP(buff[4 * k + i] * 0xffff, 0, 0xffff));
+    }
+  }
+  // else output float, no further harm done to the pixels :)
+}
+
+// exports of one image to several outputs keep its developed pipe in
+// between, within the pipe cache the input of finalscale stays around so
+// all outputs processed in high quality start from there. outputs of the
+// same image with another style set up the development again on the same
+// pipe, the lines upstream of the style are taken from its cache.
+typedef struct _export_session_t
+{
+  gboolean valid; // dev, pipe and buf are set up for the image below
+  dt_imgid_t imgid;
+  int history_end;
+  gboolean export_masks;
+  gboolean mipmap_input; // the pipe got the mipmap as input
+  gboolean style_append;
+  char style[128];
+  dt_develop_t dev;
+  dt_dev_pixelpipe_t pipe;
+  dt_mipmap_buffer_t buf;
+} _export_session_t;
+
+static __thread _export_session_t *_export_session = NULL;
+
+static void _export_session_release(_export_session_t *session)
+{
+  if(!session->valid) return;
+  dt_dev_pixelpipe_cleanup(&session->pipe);
+  dt_dev_cleanup(&session->dev);
+  dt_mipmap_cache_release(&session->buf);
+  session->valid = FALSE;
+}
+
+void dt_imageio_export_session_begin(void)
+{
+  if(!_export_session)
+    _export_session = g_malloc0(sizeof(_export_session_t));
+}
+
+void dt_imageio_export_session_end(void)
+{
+  if(!_export_session) return;
+  _export_session_release(_export_session);
+  g_free(_export_session);
+  _export_session = NULL;
+}
+
 // internal function: to avoid exif blob reading + 8-bit byteorder
 // flag + high-quality override
 gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
@@ -1066,21 +1681,75 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
                                       dt_export_metadata_t *metadata,
                                       const int history_end)
 {
-  dt_develop_t dev;
-  dt_dev_init(&dev, FALSE);
-  dt_dev_load_image(&dev, imgid);
-  if(history_end != -1)
-    dt_dev_pop_history_items_ext(&dev, history_end);
+  // within an export session the pipe of the previous output is taken
+  // again if it has been set up for the same image, history and style
+  _export_session_t *session = thumbnail_export || filter ? NULL : _export_session;
+  const gboolean same_image = session && session->valid
+    && session->imgid == imgid
+    && session->history_end == history_end
+    && session->export_masks == export_masks;
+  const gboolean reuse = same_image
+    && !session->mipmap_input
+    && session->style_append == format_params->style_append
+    && !strcmp(session->style, format_params->style);
+  if(session && !same_image) _export_session_release(session);
+
+  dt_develop_t local_dev;
+  dt_dev_pixelpipe_t local_pipe;
+  dt_mipmap_buffer_t local_buf;
+  dt_develop_t *dev = session ? &session->dev : &local_dev;
+  dt_dev_pixelpipe_t *pipe = session ? &session->pipe : &local_pipe;
+  dt_mipmap_buffer_t *buf = session ? &session->buf : &local_buf;
+  void *mosaic = NULL;
+  gboolean pipe_input_changed = FALSE;
 
   if(!thumbnail_export)
     dt_set_backthumb_time(600.0); // make sure we don't interfere
 
-  dt_mipmap_buffer_t buf;
-  dt_mipmap_cache_get(&buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  dt_times_t start;
+  dt_get_perf_times(&start);
 
-  const dt_image_t *img = &dev.image_storage;
+  if(reuse)
+  {
+    pipe->levels = format->levels(format_params);
+    // the profile is committed to colorout, everything after the
+    // changed profile is processed again anyway
+    if(pipe->icc_type != icc_type
+       || pipe->icc_intent != icc_intent
+       || strcmp(pipe->icc_filename, icc_filename ? icc_filename : ""))
+    {
+      dt_dev_pixelpipe_set_icc(pipe, icc_type, icc_filename, icc_intent);
+      dt_dev_pixelpipe_synch_all(pipe, dev);
+    }
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[dt_imageio_export] ID=%d continues with the pipe of the previous output",
+             imgid);
+    goto pipe_ready;
+  }
 
-  if(!buf.buf || !buf.width || !buf.height)
+  if(same_image)
+  {
+    // keep the pipe and its cache, the development of the image is
+    // loaded again for the new style
+    dt_dev_pixelpipe_cleanup_nodes(pipe);
+    dt_dev_cleanup(dev);
+    dt_mipmap_cache_release(buf);
+    session->valid = FALSE;
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[dt_imageio_export] ID=%d continues with the pipe cache of the previous output",
+             imgid);
+  }
+
+  dt_dev_init(dev, FALSE);
+  dt_dev_load_image(dev, imgid);
+  if(history_end != -1)
+    dt_dev_pop_history_items_ext(dev, history_end);
+
+  dt_mipmap_cache_get(buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+
+  const dt_image_t *img = &dev->image_storage;
+
+  if(!buf->buf || !buf->width || !buf->height)
   {
     if(img->load_status == DT_IMAGEIO_FILE_NOT_FOUND)
       dt_control_log(_("image `%s' is not available!"), img->filename);
@@ -1095,18 +1764,21 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     }
     else
       dt_control_log(_("image '%s' not supported"), img->filename);
+    if(same_image) goto error; // the pipe of the session is still set up
     goto error_early;
   }
 
   const int wd = img->width;
   const int ht = img->height;
 
-  dt_times_t start;
-  dt_get_perf_times(&start);
-  dt_dev_pixelpipe_t pipe;
-  gboolean res = thumbnail_export
-    ? dt_dev_pixelpipe_init_thumbnail(&pipe, wd, ht)
-    : dt_dev_pixelpipe_init_export(&pipe, wd, ht,
+  gboolean res = same_image
+    ? TRUE
+    : thumbnail_export
+    ? dt_dev_pixelpipe_init_thumbnail(pipe, wd, ht)
+    : session
+    ? dt_dev_pixelpipe_init_export_shared(pipe, format->levels(format_params),
+                                          export_masks)
+    : dt_dev_pixelpipe_init_export(pipe, wd, ht,
                                    format->levels(format_params), export_masks);
   if(!res)
   {
@@ -1117,7 +1789,8 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     goto error;
   }
 
-  const int final_history_end = history_end == -1 ? dev.history_end : history_end;
+  const int final_history_end = history_end == -1 ? dev->history_end : history_end;
+  const int style_history_start = dev->history_end;
   const gboolean use_style = !thumbnail_export && format_params->style[0] != '\0';
   const gboolean appending = format_params->style_append != FALSE;
   //  If a style is to be applied during export, add the iop params into the history
@@ -1141,9 +1814,9 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
 
     GList *modules_used = NULL;
 
-    if(!appending) dt_dev_pop_history_items_ext(&dev, 0);
+    if(!appending) dt_dev_pop_history_items_ext(dev, 0);
 
-    dt_ioppr_update_for_style_items(&dev, style_items, appending);
+    dt_ioppr_update_for_style_items(dev, style_items, appending);
 
     if(style_items)
     {
@@ -1154,13 +1827,13 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
       {
         // the style has an iop-order, we need to merge the
         // multi-instance from dev image. Get dev image iop-order:
-        GList *img_iop_order_list = dev.iop_order_list;;
+        GList *img_iop_order_list = dev->iop_order_list;;
         // Get multi-instance modules if any:
         GList *mi = dt_ioppr_extract_multi_instances_list(img_iop_order_list);
         // If some where found merge them with the style list
         if(mi) iop_list = dt_ioppr_merge_multi_instance_iop_order_list(iop_list, mi);
         // finally we have the final list for the image, use it:
-        dev.iop_order_list = iop_list;
+        dev->iop_order_list = iop_list;
 
         g_list_free_full(img_iop_order_list, g_free);
         g_list_free_full(mi, g_free);
@@ -1179,7 +1852,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
         // get iop for this operation as we need the corresponding
         // default parameters
         const dt_iop_module_t *module =
-          dt_iop_get_module_from_list(dev.iop, st_item->operation);
+          dt_iop_get_module_from_list(dev->iop, st_item->operation);
         if(module)
         {
           st_item->params_size = module->params_size;
@@ -1198,7 +1871,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
 
       if(ok)
       {
-        dt_styles_apply_style_item(&dev, st_item, &modules_used, !autoinit && appending);
+        dt_styles_apply_style_item(dev, st_item, &modules_used, !autoinit && appending);
       }
     }
 
@@ -1206,20 +1879,33 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     g_list_free_full(style_items, dt_style_item_free);
   }
   else if(history_end != -1)
-    dt_dev_pop_history_items_ext(&dev, final_history_end);
+    dt_dev_pop_history_items_ext(dev, final_history_end);
 
-  dt_ioppr_resync_modules_order(&dev);
+  dt_ioppr_resync_modules_order(dev);
+
+  // the input of the first module changed by the style is the same for
+  // all styles applied to the image in a session, keep it in the cache
+  pipe->keep_input_of = NULL;
+  if(session && use_style && appending)
+  {
+    for(const GList *h = g_list_nth(dev->history, style_history_start); h; h = g_list_next(h))
+    {
+      const dt_dev_history_item_t *hist = h->data;
+      if(!pipe->keep_input_of || hist->module->iop_order < pipe->keep_input_of->iop_order)
+        pipe->keep_input_of = hist->module;
+    }
+  }
 
-  dt_dev_pixelpipe_set_icc(&pipe, icc_type, icc_filename, icc_intent);
-  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf,
-                             buf.width, buf.height, buf.iscale);
-  dt_dev_pixelpipe_create_nodes(&pipe, &dev);
-  dt_dev_pixelpipe_synch_all(&pipe, &dev);
+  dt_dev_pixelpipe_set_icc(pipe, icc_type, icc_filename, icc_intent);
+  dt_dev_pixelpipe_set_input(pipe, dev, (float *)buf->buf,
+                             buf->width, buf->height, buf->iscale);
+  dt_dev_pixelpipe_create_nodes(pipe, dev);
+  dt_dev_pixelpipe_synch_all(pipe, dev);
 
   if(darktable.unmuted & DT_DEBUG_IMAGEIO)
   {
     char mbuf[2048] = { 0 };
-    for(GList *nodes = pipe.nodes; nodes; nodes = g_list_next(nodes))
+    for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
     {
       dt_dev_pixelpipe_iop_t *piece = nodes->data;
       if(piece->enabled)
@@ -1243,14 +1929,15 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   if(filter)
   {
     if(!strncmp(filter, "pre:", 4))
-      dt_dev_pixelpipe_disable_after(&pipe, filter + 4);
+      dt_dev_pixelpipe_disable_after(pipe, filter + 4);
     if(!strncmp(filter, "post:", 5))
-      dt_dev_pixelpipe_disable_before(&pipe, filter + 5);
+      dt_dev_pixelpipe_disable_before(pipe, filter + 5);
   }
 
-  dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight,
-                                  &pipe.processed_width,
-                                  &pipe.processed_height);
+pipe_ready:
+  dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight,
+                                  &pipe->processed_width,
+                                  &pipe->processed_height);
 
   dt_show_times(&start, "[export] creating pixelpipe");
 
@@ -1260,7 +1947,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   else if(icc_type == DT_COLORSPACE_NONE)
   {
     dt_iop_module_t *colorout = NULL;
-    for(GList *modules = dev.iop; modules; modules = g_list_next(modules))
+    for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
     {
       colorout = (dt_iop_module_t *)modules->data;
       if(colorout->get_p && dt_iop_module_is(colorout, "colorout"))
@@ -1283,27 +1970,27 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
 
   if(!thumbnail_export && width == 0 && height == 0)
   {
-    width = pipe.processed_width;
-    height = pipe.processed_height;
+    width = pipe->processed_width;
+    height = pipe->processed_height;
   }
 
   // Upscaling in finalscale requires additional memory so the final image size is restricted to avoid dt oom killing
-  const double planesize = sizeof(float) * 4 * pipe.processed_width * pipe.processed_height;
+  const double planesize = sizeof(float) * 4 * pipe->processed_width * pipe->processed_height;
   const double max_possible_scale = fmin(100.0, fmax(1.0, // keep maximum allowed scale as we had in 4.6
-      (double)dt_get_available_pipe_mem(&pipe) / (1.0 + 2.5 * planesize)));
+      (double)dt_get_available_pipe_mem(pipe) / (1.0 + 2.5 * planesize)));
 
   const gboolean doscale = upscale && ((width > 0 || height > 0) || is_scaling);
   const double max_scale = doscale ? max_possible_scale : 1.00;
 
-  double scale = _get_pipescale(&pipe, width, height, max_scale);
+  double scale = _get_pipescale(pipe, width, height, max_scale);
   float origin[2] = { 0.0f, 0.0f };
 
-  if(dt_dev_distort_backtransform_plus(&dev, &pipe, 0.0,
+  if(dt_dev_distort_backtransform_plus(dev, pipe, 0.0,
                                        DT_DEV_TRANSFORM_DIR_ALL, origin, 1))
   {
-    if(width == 0) width = pipe.processed_width;
-    if(height == 0) height = pipe.processed_height;
-    scale = _get_pipescale(&pipe, width, height, max_scale);
+    if(width == 0) width = pipe->processed_width;
+    if(height == 0) height = pipe->processed_height;
+    scale = _get_pipescale(pipe, width, height, max_scale);
 
     if(is_scaling)
     {
@@ -1314,8 +2001,27 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     }
   }
 
-  const int processed_width = floor(scale * pipe.processed_width);
-  const int processed_height = floor(scale * pipe.processed_height);
+  if(!thumbnail_export && !high_quality_processing && !export_masks
+     && dt_conf_get_bool("plugins/lighttable/export/mipmap_input")
+     && _export_mipmap_input(pipe, dev, buf, scale))
+  {
+    pipe_input_changed = TRUE;
+    dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight,
+                                    &pipe->processed_width,
+                                    &pipe->processed_height);
+    scale = _get_pipescale(pipe, width, height, max_scale);
+  }
+  else if(thumbnail_export && !high_quality_processing
+          && _thumbnail_mosaic_input(pipe, dev, buf, scale, &mosaic))
+  {
+    dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight,
+                                    &pipe->processed_width,
+                                    &pipe->processed_height);
+    scale = _get_pipescale(pipe, width, height, max_scale);
+  }
+
+  const int processed_width = floor(scale * pipe->processed_width);
+  const int processed_height = floor(scale * pipe->processed_height);
   if(scale == max_possible_scale && !thumbnail_export)
     dt_control_log(_("export reduced to %dx%d because of memory restrictions"),
             processed_width, processed_height);
@@ -1326,7 +2032,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
            " upscale=%s, hq=%s%s",
            size_warning ? "**missing size** " : "",
            thumbnail_export ? "thumbnail" : "export", imgid,
-           pipe.processed_width, pipe.processed_height,
+           pipe->processed_width, pipe->processed_height,
            processed_width, processed_height, scale, max_scale,
            STR_YESNO(upscale),
            STR_YESNO(high_quality_processing || scale > 1.0f),
@@ -1334,132 +2040,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
 
   const int bpp = format->bpp(format_params);
 
-  dt_get_perf_times(&start);
   const gboolean hq_process = high_quality_processing || scale > 1.0f;
-  if(hq_process)
-  {
-    /*
-     * if high quality processing was requested, downsampling will be done
-     * at the very end of the pipe (just before border and watermark)
-     */
-    dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0,
-                                      processed_width, processed_height, scale);
-  }
-  else
-  {
-    // else, downsampling will be right after demosaic
-
-    // so we need to turn temporarily disable in-pipe late downsampling iop.
-
-    // find the finalscale module
-    dt_dev_pixelpipe_iop_t *finalscale = NULL;
-    {
-      for(const GList *nodes = g_list_last(pipe.nodes);
-          nodes;
-          nodes = g_list_previous(nodes))
-      {
-        dt_dev_pixelpipe_iop_t *node = nodes->data;
-        if(dt_iop_module_is_finalscale(node->module))
-        {
-          finalscale = node;
-          break;
-        }
-      }
-    }
-
-    if(finalscale) finalscale->enabled = FALSE;
-
-    // do the processing (8-bit with special treatment, to make sure
-    // we can use openmp further down):
-    if(bpp == 8)
-      dt_dev_pixelpipe_process(&pipe, &dev, 0, 0,
-                               processed_width, processed_height, scale, DT_DEVICE_NONE);
-    else
-      dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0,
-                                        processed_width, processed_height, scale);
-
-    if(finalscale) finalscale->enabled = TRUE;
-  }
-  dt_show_times(&start,
-                thumbnail_export
-                  ? "[dev_process_thumbnail] pixel pipeline processing"
-                  : "[dev_process_export] pixel pipeline processing");
-
-  uint8_t *outbuf = pipe.backbuf;
-  if(outbuf == NULL)
-  {
-    dt_print(DT_DEBUG_IMAGEIO,
-             "[dt_imageio_export_with_flags] no valid output buffer");
-    goto error;
-  }
-
-  // downconversion to low-precision formats:
-  if(bpp == 8)
-  {
-    if(display_byteorder)
-    {
-      if(hq_process)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = roundf(CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff));
-          const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
-          const uint8_t b = roundf(CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff));
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      // else processing output was 8-bit already, and no need to swap order
-    }
-    else // need to flip
-    {
-      // ldr output: char
-      if(hq_process)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = roundf(CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff));
-          const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
-          const uint8_t b = roundf(CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff));
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      else
-      { // !display_byteorder, need to swap:
-        uint8_t *const buf8 = pipe.backbuf;
-        DT_OMP_FOR()
-        // just flip byte order
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          uint8_t tmp = buf8[4 * k + 0];
-          buf8[4 * k + 0] = buf8[4 * k + 2];
-          buf8[4 * k + 2] = tmp;
-        }
-      }
-    }
-  }
-  else if(bpp == 16)
-  {
-    // uint16_t per color channel
-    float *buff = (float *)outbuf;
-    uint16_t *buf16 = (uint16_t *)outbuf;
-    for(int y = 0; y < processed_height; y++)
-      for(int x = 0; x < processed_width; x++)
-      {
-        // convert in place
-        const size_t k = (size_t)processed_width * y + x;
-        for(int i = 0; i < 3; i++)
-          buf16[4 * k + i] = roundf(CLAMP(buff[4 * k + i] * 0xffff, 0, 0xffff));
-      }
-  }
-  // else output float, no further harm done to the pixels :)
 
   format_params->width = processed_width;
   format_params->height = processed_height;
@@ -1487,35 +2068,96 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     md_flags_set = metadata ? (metadata->flags & meta_all) == meta_all : FALSE;
   }
 
+  uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes
+                                // max, but if original size is
+                                // close to that, adding new tags
+                                // could make it go over that... so
+                                // let it be and see what happens
+                                // when we write the image
+  int exif_length = 0;
   if(!ignore_exif && md_flags_set)
   {
-    uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes
-                                  // max, but if original size is
-                                  // close to that, adding new tags
-                                  // could make it go over that... so
-                                  // let it be and see what happens
-                                  // when we write the image
     char pathname[PATH_MAX] = { 0 };
     gboolean from_cache = TRUE;
     dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
 
     // last param is dng mode, it's false here
-    const int length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB,
-                                         processed_width, processed_height, FALSE);
+    exif_length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB,
+                                    processed_width, processed_height, FALSE);
+  }
 
-    res = (format->write_image(format_params, filename, outbuf, icc_type,
-                              icc_filename, exif_profile, length, imgid,
-                              num, total, &pipe, export_masks)) != 0;
+  // very large exports are processed and written in bands of rows to
+  // formats supporting it, so memory is bounded by the band size
+  const size_t stream_threshold = (size_t)dt_conf_get_int("export_stream_threshold") << 20;
+  const size_t out_size = (size_t)processed_width * processed_height * 4 * sizeof(float);
+  const gboolean stream = !thumbnail_export && !export_masks
+    && stream_threshold > 0 && out_size > stream_threshold
+    && format->write_image_begin && format->write_image_rows && format->write_image_end
+    && _export_bands_allowed(pipe)
+    && format->write_image_begin(format_params, filename, icc_type, icc_filename,
+                                 exif_profile, exif_length, imgid, num, total, pipe) == 0;
+
+  dt_get_perf_times(&start);
+  if(stream)
+  {
+    const int band_rows =
+      CLAMP(DT_EXPORT_BAND_BYTES / ((size_t)processed_width * 4 * sizeof(float)),
+            DT_EXPORT_BAND_MIN_ROWS, processed_height);
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[dt_imageio_export] writing %ix%i in bands of %i rows",
+             processed_width, processed_height, band_rows);
 
-    free(exif_profile);
+    res = FALSE;
+    for(int y = 0; y < processed_height && !res; y += band_rows)
+    {
+      const int rows = MIN(band_rows, processed_height - y);
+      _export_process(pipe, dev, y, processed_width, rows, scale, hq_process, bpp);
+      if(pipe->backbuf == NULL)
+      {
+        dt_print(DT_DEBUG_IMAGEIO,
+                 "[dt_imageio_export_with_flags] no valid output buffer");
+        res = TRUE;
+        break;
+      }
+      _export_convert(pipe->backbuf, (size_t)processed_width * rows,
+                      bpp, hq_process, display_byteorder);
+      res = format->write_image_rows(format_params, pipe->backbuf, rows) != 0;
+    }
+    res = (format->write_image_end(format_params, filename,
+                                   exif_profile, exif_length, res) != 0) || res;
+    dt_show_times(&start, "[dev_process_export] pixel pipeline processing and writing");
+    dt_mem_account_print_peaks(DT_DEBUG_PERF | DT_DEBUG_MEMORY, "[dev_process_export]");
   }
   else
   {
+    _export_process(pipe, dev, 0, processed_width, processed_height,
+                    scale, hq_process, bpp);
+    dt_show_times(&start,
+                  thumbnail_export
+                    ? "[dev_process_thumbnail] pixel pipeline processing"
+                    : "[dev_process_export] pixel pipeline processing");
+    if(!thumbnail_export)
+      dt_mem_account_print_peaks(DT_DEBUG_PERF | DT_DEBUG_MEMORY, "[dev_process_export]");
+
+    uint8_t *outbuf = pipe->backbuf;
+    if(outbuf == NULL)
+    {
+      dt_print(DT_DEBUG_IMAGEIO,
+               "[dt_imageio_export_with_flags] no valid output buffer");
+      free(exif_profile);
+      goto error;
+    }
+
+    _export_convert(outbuf, (size_t)processed_width * processed_height,
+                    bpp, hq_process, display_byteorder);
+
     res = (format->write_image(format_params, filename, outbuf, icc_type,
-                              icc_filename, NULL, 0, imgid, num, total,
-                              &pipe, export_masks)) != 0;
+                               icc_filename, exif_profile, exif_length, imgid,
+                               num, total, pipe, export_masks)) != 0;
   }
 
+  free(exif_profile);
+
   if(res)
     goto error;
 
@@ -1523,13 +2165,29 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   if(copy_metadata
      && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
   {
-    dt_exif_xmp_attach_export(imgid, filename, metadata, &dev, &pipe);
+    dt_exif_xmp_attach_export(imgid, filename, metadata, dev, pipe);
     // no need to cancel the export if this fail
   }
 
-  dt_dev_pixelpipe_cleanup(&pipe);
-  dt_dev_cleanup(&dev);
-  dt_mipmap_cache_release(&buf);
+  // keep the pipe for the next output, if it got the mipmap as input only
+  // its cache is of use to the next one
+  if(session)
+  {
+    session->valid = TRUE;
+    session->imgid = imgid;
+    session->history_end = history_end;
+    session->export_masks = export_masks;
+    session->mipmap_input = pipe_input_changed;
+    session->style_append = format_params->style_append;
+    g_strlcpy(session->style, format_params->style, sizeof(session->style));
+  }
+  else
+  {
+    dt_dev_pixelpipe_cleanup(pipe);
+    dt_dev_cleanup(dev);
+    dt_mipmap_cache_release(buf);
+  }
+  dt_free_align(mosaic);
 
   if(!thumbnail_export && strcmp(format->mime(format_params), "memory")
     && !(format->flags(format_params) & FORMAT_FLAGS_NO_TMPFILE))
@@ -1565,10 +2223,12 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   return FALSE; // success
 
 error:
-  dt_dev_pixelpipe_cleanup(&pipe);
+  dt_dev_pixelpipe_cleanup(pipe);
 error_early:
-  dt_dev_cleanup(&dev);
-  dt_mipmap_cache_release(&buf);
+  dt_dev_cleanup(dev);
+  dt_mipmap_cache_release(buf);
+  dt_free_align(mosaic);
+  if(session) session->valid = FALSE;
 
   if(!thumbnail_export)
     dt_set_backthumb_time(5.0);
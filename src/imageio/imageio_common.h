@@ -127,6 +127,11 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid, const char *filena
                                  dt_export_metadata_t *metadata,
                                  const int history_end);
 
+// exports of the calling thread between begin and end share the developed
+// pipe of an image, use it around writing the same image to several outputs
+void dt_imageio_export_session_begin(void);
+void dt_imageio_export_session_end(void);
+
 // general, efficient buffer flipping function using memcopies
 void dt_imageio_flip_buffers(char *out,
                              const char *in,
@@ -150,12 +155,39 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out,
                                           const int stride,
                                           const dt_image_orientation_t orientation);
 
+// map a raw file read-only with readahead hints for the decoders, NULL if
+// mapping is disabled or fails and the file has to be read instead
+GMappedFile *dt_imageio_map_file(const char *filename);
+// unmap and drop the pages of a file mapped by dt_imageio_map_file()
+void dt_imageio_unmap_file(GMappedFile *map);
+
 // allocate buffer and return 0 on success along with largest jpg thumbnail from raw.
 gboolean dt_imageio_large_thumbnail(const char *filename,
                                uint8_t **buffer,
                                int32_t *width,
                                int32_t *height,
                                dt_colorspaces_color_profile_type_t *color_space);
+// same, but lets libjpeg decode the thumbnail scaled down as long as it
+// still covers fit_width x fit_height
+gboolean dt_imageio_large_thumbnail_fit(const char *filename,
+                                        const int fit_width,
+                                        const int fit_height,
+                                        uint8_t **buffer,
+                                        int32_t *width,
+                                        int32_t *height,
+                                        dt_colorspaces_color_profile_type_t *color_space);
+
+// decode the largest jpeg preview of a raw without going through exiv2 or
+// the raw decoder, reading just its byte range from the TIFF IFDs or the
+// CR3 preview box. it's scaled down while decoding as long as it still
+// covers width x height. returns FALSE on success, like the above.
+gboolean dt_imageio_embedded_preview(const char *filename,
+                                     const int width,
+                                     const int height,
+                                     uint8_t **buffer,
+                                     int32_t *out_width,
+                                     int32_t *out_height,
+                                     dt_colorspaces_color_profile_type_t *color_space);
 
 // lookup maker and model, dispatch lookup to rawspeed or libraw
 gboolean dt_imageio_lookup_makermodel(const char *maker,
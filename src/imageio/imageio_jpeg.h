@@ -46,6 +46,10 @@ typedef struct dt_imageio_jpeg_t
 
 /** reads the header and fills width/height in jpg struct. */
 int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_jpeg_t *jpg);
+/** lets libjpeg scale the image down by 1/2, 1/4 or 1/8 while decompressing or reading, as
+ * long as it still covers width x height. call after reading the header, updates width/height
+ * in jpg struct. */
+void dt_imageio_jpeg_scale_to_fit(dt_imageio_jpeg_t *jpg, const int width, const int height);
 /** reads the whole image to the out buffer, which has to be large enough. */
 int dt_imageio_jpeg_decompress(dt_imageio_jpeg_t *jpg, uint8_t *out);
 /** compresses in to out buffer with given quality (0..100). out buffer must be large enough. returns actual
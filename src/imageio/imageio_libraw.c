@@ -395,13 +395,21 @@ dt_imageio_retval_t dt_imageio_open_libraw(dt_image_t *img,
   if(!raw)
     return DT_IMAGEIO_LOAD_FAILED;
 
+  // decode a mapped file in place, it has to stay mapped until libraw_close()
+  GMappedFile *map = dt_imageio_map_file(filename);
+  if(map)
+    libraw_err = libraw_open_buffer(raw, g_mapped_file_get_contents(map),
+                                    g_mapped_file_get_length(map));
+  else
+  {
 #if defined(_WIN32) && (defined(UNICODE) || defined(_UNICODE))
-  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
-  libraw_err = libraw_open_wfile(raw, wfilename);
-  g_free(wfilename);
+    wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
+    libraw_err = libraw_open_wfile(raw, wfilename);
+    g_free(wfilename);
 #else
-  libraw_err = libraw_open_file(raw, filename);
+    libraw_err = libraw_open_file(raw, filename);
 #endif
+  }
   if(libraw_err != LIBRAW_SUCCESS)
     goto error;
 
@@ -575,6 +583,7 @@ error:
     }
   }
   libraw_close(raw);
+  dt_imageio_unmap_file(map);
   return err;
 }
 #endif
@@ -26,6 +26,9 @@
 #include "imageio/imageio_module.h"
 
 #include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static gint dt_imageio_sort_modules_storage(gconstpointer a, gconstpointer b)
 {
@@ -406,6 +409,16 @@ void dt_imageio_remove_storage(dt_imageio_module_storage_t *storage)
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGEIO_STORAGE_CHANGE);
 }
 
+int dt_imageio_encoder_threads(void)
+{
+#ifdef _OPENMP
+  // export lanes lower the openmp threads of their thread to their share
+  return CLAMP(omp_get_max_threads(), 1, (int)dt_get_num_threads());
+#else
+  return 1;
+#endif
+}
+
 gchar *dt_imageio_resizing_factor_get_and_parsing(double *num, double *denum)
 {
   double _num, _denum;
@@ -42,7 +42,8 @@ typedef enum dt_imageio_format_flags_t
 {
   FORMAT_FLAGS_SUPPORT_XMP = 1,
   FORMAT_FLAGS_NO_TMPFILE = 2,
-  FORMAT_FLAGS_SUPPORT_LAYERS = 4
+  FORMAT_FLAGS_SUPPORT_LAYERS = 4,
+  FORMAT_FLAGS_NO_PARALLEL = 8   // write_image() depends on the previous images of the export
 } dt_imageio_format_flags_t;
 
 /**
@@ -92,6 +93,10 @@ typedef struct dt_imageio_module_format_t
 } dt_imageio_module_format_t;
 
 
+/* returned by store() when the image is handed over to another thread, which
+ * reports it with dt_control_export_image_done() once it is really stored */
+#define DT_IMAGEIO_STORE_DEFERRED (-1)
+
 /* responsible for image storage, such as flickr, harddisk, etc */
 typedef struct dt_imageio_module_storage_t
 {
@@ -147,6 +152,11 @@ void dt_imageio_insert_storage(dt_imageio_module_storage_t *storage);
 /* remove a module from the known module list */
 void dt_imageio_remove_storage(dt_imageio_module_storage_t *storage);
 
+// number of threads a format may give its encoder for the image exported
+// on the calling thread. parallel exports share the cores between them, so
+// encoders must not size their thread pools from the processor count.
+int dt_imageio_encoder_threads(void);
+
 // This function returns value of string which stored in the
 // "plugins/lighttable/export/resizing_factor" parameter of the configuration file
 // and its "num" and "denum" fraction's elements to calculate the scaling factor
@@ -29,32 +29,85 @@
 #define TYPE_FLOAT32 RawImageType::F32
 #define TYPE_USHORT16 RawImageType::UINT16
 
+#include <limits>
 #include <memory>
 
 #define __STDC_LIMIT_MACROS
 
+#include "common/atomic.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
 #include "common/exif.h"
 #include "common/file_location.h"
 #include "common/tags.h"
+#include "control/conf.h"
 #include "develop/imageop.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_rawspeed.h"
 #include <stdint.h>
 
 // define this function, it is only declared in rawspeed:
+// rawspeed sizes its parallel slice and tile loops with this. a decode
+// running on the calling thread gets its share of the thread budget,
+// everything else all threads darktable may use.
+static thread_local int _decode_threads = 0;
+static dt_atomic_int _active_decodes;
+
 int rawspeed_get_number_of_processor_cores()
 {
 #ifdef _OPENMP
-  return omp_get_num_procs();
+  return _decode_threads > 0 ? _decode_threads : (int)dt_get_num_threads();
 #else
   return 1;
 #endif
 }
 
+// splits the configured budget between the decodes running at the same
+// time, so a single large raw uses all cores while the thumbnail and
+// import jobs decoding in parallel don't oversubscribe them
+class _decode_budget_t
+{
+public:
+  _decode_budget_t()
+  {
+    const int active = dt_atomic_add_int(&_active_decodes, 1) + 1;
+    const int threads = (int)dt_get_num_threads();
+    const int configured = dt_conf_get_int("rawspeed_decode_threads");
+    const int budget = configured > 0 ? MIN(configured, threads) : threads;
+    _decode_threads = MAX(1, budget / active);
+  }
+  ~_decode_budget_t()
+  {
+    dt_atomic_decr_int(&_active_decodes);
+    _decode_threads = 0;
+  }
+};
+
 using namespace rawspeed;
 
+struct _mapped_raw_t
+{
+  GMappedFile *map = NULL;
+  ~_mapped_raw_t() { dt_imageio_unmap_file(map); }
+};
+
+// holds darktable.readFile_mutex until unlocked or out of scope
+struct _read_lock_t
+{
+  bool locked = false;
+  void lock()
+  {
+    dt_pthread_mutex_lock(&darktable.readFile_mutex);
+    locked = true;
+  }
+  void unlock()
+  {
+    if(locked) dt_pthread_mutex_unlock(&darktable.readFile_mutex);
+    locked = false;
+  }
+  ~_read_lock_t() { unlock(); }
+};
+
 static dt_imageio_retval_t dt_imageio_open_rawspeed_sraw (dt_image_t *img,
                                                           const RawImage r,
                                                           dt_mipmap_buffer_t *buf);
@@ -181,14 +234,31 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img,
   char filen[PATH_MAX] = { 0 };
   snprintf(filen, sizeof(filen), "%s", filename);
   FileReader f(filen);
+  // outlives the decoder, which may reference the file until it's gone
+  _mapped_raw_t mapped;
 
   try
   {
     dt_rawspeed_load_meta();
 
-    dt_pthread_mutex_lock(&darktable.readFile_mutex);
-    auto [storage, storageBuf] = f.readFile();
-    dt_pthread_mutex_unlock(&darktable.readFile_mutex);
+    _read_lock_t reading;
+    reading.lock();
+    mapped.map = dt_imageio_map_file(filename);
+    if(mapped.map
+       && g_mapped_file_get_length(mapped.map) > std::numeric_limits<Buffer::size_type>::max())
+    {
+      dt_imageio_unmap_file(mapped.map);
+      mapped.map = NULL;
+    }
+    // a mapped file is decoded in place, otherwise it's read into memory first
+    auto [storage, fileBuf] = mapped.map ? decltype(f.readFile())() : f.readFile();
+    // a mapped file is only read while it's decoded, keep the lock until then
+    if(!mapped.map) reading.unlock();
+
+    const Buffer storageBuf = mapped.map
+      ? Buffer((const uint8_t *)g_mapped_file_get_contents(mapped.map),
+               (Buffer::size_type)g_mapped_file_get_length(mapped.map))
+      : fileBuf;
 
     RawParser t(storageBuf);
     std::unique_ptr<RawDecoder> d = t.getDecoder(meta);
@@ -197,8 +267,14 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img,
 
     d->failOnUnknown = true;
     d->checkSupport(meta);
-    d->decodeRaw();
+    {
+      _decode_budget_t budget;
+      dt_print(DT_DEBUG_PERF, "[rawspeed] decoding '%s' with %d threads",
+               img->filename, rawspeed_get_number_of_processor_cores());
+      d->decodeRaw();
+    }
     d->decodeMetaData(meta);
+    reading.unlock();
     RawImage r = d->mRaw;
 
     const auto errors = r->getErrors();
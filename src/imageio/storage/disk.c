@@ -19,7 +19,9 @@
 #include "bauhaus/bauhaus.h"
 #include "common/darktable.h"
 #include "common/datetime.h"
+#include "common/debug.h"
 #include "common/exif.h"
+#include "common/history.h"
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/metadata.h"
@@ -316,6 +318,82 @@ void gui_reset(dt_imageio_module_storage_t *self)
                   dt_bauhaus_combobox_get(d->onsave_action));
 }
 
+// everything the exported file depends on: history of the image, export
+// settings and darktable version
+static dt_hash_t _export_hash(const dt_imgid_t imgid,
+                              dt_imageio_module_format_t *format,
+                              dt_imageio_module_data_t *fdata,
+                              const int32_t flags[4],
+                              const double scale_factor,
+                              const dt_colorspaces_color_profile_type_t icc_type,
+                              const gchar *icc_filename,
+                              const dt_iop_color_intent_t icc_intent,
+                              const dt_export_metadata_t *metadata)
+{
+  dt_hash_t hash = dt_hash(DT_INITHASH, darktable_package_version,
+                           strlen(darktable_package_version));
+
+  dt_history_hash_values_t history = { NULL, 0, NULL, 0, NULL, 0 };
+  dt_history_hash_read(imgid, &history);
+  hash = dt_hash(hash, history.current, history.current_len);
+  dt_history_hash_free(&history);
+
+  // the format parameters, without the size of the last image exported
+  hash = dt_hash(hash, format->plugin_name, strlen(format->plugin_name));
+  hash = dt_hash(hash, &fdata->max_width, sizeof(fdata->max_width));
+  hash = dt_hash(hash, &fdata->max_height, sizeof(fdata->max_height));
+  hash = dt_hash(hash, fdata->style, strlen(fdata->style));
+  hash = dt_hash(hash, &fdata->style_append, sizeof(fdata->style_append));
+  const size_t fsize = format->params_size(format);
+  if(fsize > sizeof(dt_imageio_module_data_t))
+    hash = dt_hash(hash, (char *)fdata + sizeof(dt_imageio_module_data_t),
+                   fsize - sizeof(dt_imageio_module_data_t));
+
+  hash = dt_hash(hash, flags, 4 * sizeof(int32_t));
+  hash = dt_hash(hash, &scale_factor, sizeof(scale_factor));
+  hash = dt_hash(hash, &icc_type, sizeof(icc_type));
+  if(icc_filename) hash = dt_hash(hash, icc_filename, strlen(icc_filename));
+  hash = dt_hash(hash, &icc_intent, sizeof(icc_intent));
+  if(metadata)
+  {
+    hash = dt_hash(hash, &metadata->flags, sizeof(metadata->flags));
+    for(const GList *l = metadata->list; l; l = g_list_next(l))
+      hash = dt_hash(hash, l->data, strlen(l->data) + 1);
+  }
+  return hash;
+}
+
+// the hash the file was exported with, FALSE if not exported by us
+static gboolean _manifest_lookup(const char *filename,
+                                 dt_hash_t *hash)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT hash FROM main.export_manifest WHERE filename = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, filename, -1, SQLITE_STATIC);
+  const gboolean found = sqlite3_step(stmt) == SQLITE_ROW;
+  if(found) *hash = (dt_hash_t)sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+static void _manifest_record(const char *filename,
+                             const dt_imgid_t imgid,
+                             const dt_hash_t hash)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO main.export_manifest (filename, imgid, hash)"
+                              " VALUES (?1, ?2, ?3)",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, filename, -1, SQLITE_STATIC);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 3, (sqlite3_int64)hash);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
 int store(dt_imageio_module_storage_t *self,
           dt_imageio_module_data_t *sdata,
           const dt_imgid_t imgid,
@@ -352,6 +430,10 @@ int store(dt_imageio_module_storage_t *self,
     variable_expand ? "expand variables" : "FINAL GIMP EXPORT",
     pattern);
 
+  const int32_t flags[4] = { high_quality, upscale, is_scaling, export_masks };
+  const dt_hash_t export_hash = _export_hash(imgid, format, fdata, flags, scale_factor,
+                                             icc_type, icc_filename, icc_intent, metadata);
+
   dt_image_full_path(imgid, input_dir, sizeof(input_dir), NULL);
   // set variable values to expand them afterwards in darktable variables
   dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
@@ -472,8 +554,26 @@ try_again:
       }
     }
 
-    // conflict handling option: overwrite if newer
-    if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_OVERWRITE_IF_CHANGED)
+    // conflict handling option: overwrite if changed. a file we exported
+    // before is compared by the hash of what it was developed from, others
+    // by their modification time
+    dt_hash_t manifest_hash = DT_INVALID_HASH;
+    if(!fail
+       && d->onsave_action == DT_EXPORT_ONCONFLICT_OVERWRITE_IF_CHANGED
+       && g_file_test(filename, G_FILE_TEST_EXISTS)
+       && _manifest_lookup(filename, &manifest_hash))
+    {
+      if(manifest_hash == export_hash)
+      {
+        dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+        dt_print(DT_DEBUG_ALWAYS, "[export_job] skipping (unchanged since export) `%s'", filename);
+        dt_control_log(ngettext("%d/%d skipping (not modified since export) `%s'",
+                                "%d/%d skipping (not modified since export) `%s'", num),
+                       num, total, filename);
+        return 0;
+      }
+    }
+    else if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_OVERWRITE_IF_CHANGED)
     {
       // check if the file exists. If not, it will be exported again, regardless
       // of the changes.
@@ -539,6 +639,8 @@ try_again:
     return 1;
   }
 
+  _manifest_record(filename, imgid, export_hash);
+
   dt_print(DT_DEBUG_ALWAYS, "[export_job] exported to `%s'", filename);
   dt_control_log(ngettext("%d/%d exported to `%s'", "%d/%d exported to `%s'", num),
                  num, total, filename);
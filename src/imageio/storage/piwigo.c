@@ -28,6 +28,7 @@
 #include "common/variables.h"
 #include "control/conf.h"
 #include "control/control.h"
+#include "control/jobs/control_jobs.h"
 #include "dtgtk/button.h"
 #include "gui/gtk.h"
 #include "gui/gtkentry.h"
@@ -49,6 +50,11 @@ DT_MODULE(3)
 #define MAX_ALBUM_NAME_SIZE 100
 #define MAX_SERVER_NAME_SIZE 2048
 
+// uploads run on their own connections while the next images are exported
+#define DT_PIWIGO_MAX_CONNECTIONS 8
+// failed uploads are tried again after 1, 2 and 4 seconds
+#define DT_PIWIGO_UPLOAD_RETRIES 3
+
 typedef struct _piwigo_api_context_t
 {
   /// curl context
@@ -132,6 +138,8 @@ typedef struct dt_storage_piwigo_preset_data_t
   char server[MAX_SERVER_NAME_SIZE];
 } dt_storage_piwigo_preset_data_t;
 
+struct _piwigo_uploader_t;
+
 typedef struct dt_storage_piwigo_params_t
 {
   dt_storage_piwigo_preset_data_t preset_data;
@@ -140,10 +148,41 @@ typedef struct dt_storage_piwigo_params_t
   int64_t parent_album_id;
   char *album;
   gboolean new_album;
-  gchar *tags;
   dt_variables_params_t *vp;
+  struct _piwigo_uploader_t *uploader;
 } dt_storage_piwigo_params_t;
 
+// an exported image waiting for its upload
+typedef struct _piwigo_upload_t
+{
+  gchar *fname;    // the exported file, removed once uploaded
+  gchar *filename; // the name on the server, to find conflicts
+  gchar *author;
+  gchar *caption;
+  gchar *description;
+  gchar *tags;
+  dt_imgid_t imgid;
+  int queue_batch;
+  int num;
+  int total;
+} _piwigo_upload_t;
+
+// the upload queue of an export, the store() of the export job pushes the
+// images and waits while it is full, the upload threads pop them
+typedef struct _piwigo_uploader_t
+{
+  dt_storage_piwigo_params_t *p;
+  dt_pthread_mutex_t lock;
+  pthread_cond_t cond;
+  GQueue queue;
+  int capacity;
+  gboolean closing;
+  int threads;
+  pthread_t thread[DT_PIWIGO_MAX_CONNECTIONS];
+  int failed;
+  gboolean tag_change;
+} _piwigo_uploader_t;
+
 void *legacy_params(dt_imageio_module_storage_t *self,
                     const void *const old_params,
                     const size_t old_params_size,
@@ -415,9 +454,11 @@ static int _piwigo_api_post_internal(_piwigo_api_context_t *ctx,
     /* construct a temporary file name */
     char cookie_fmt[PATH_MAX] = { 0 };
     dt_loc_get_tmp_dir(cookie_fmt, sizeof(cookie_fmt));
-    g_strlcat(cookie_fmt, "/cookies.%.4lf.txt", sizeof(cookie_fmt));
+    g_strlcat(cookie_fmt, "/cookies.%.4lf.%p.txt", sizeof(cookie_fmt));
 
-    ctx->cookie_file = g_strdup_printf(cookie_fmt, dt_get_wtime());
+    // the upload connections authenticate at the same time
+    g_free(ctx->cookie_file);
+    ctx->cookie_file = g_strdup_printf(cookie_fmt, dt_get_wtime(), (void *)ctx);
 
     // not that this is safe as the cookie file is written only when
     // the curl context is finalized.  At this stage we unlink the
@@ -844,9 +885,8 @@ static gboolean _piwigo_api_create_new_album(dt_storage_piwigo_params_t *p)
 }
 
 static int _piwigo_api_get_image_id(dt_storage_piwigo_params_t *p,
-                                    dt_image_t *img,
-                                    dt_imageio_module_format_t *format,
-                                    dt_imageio_module_data_t *fdata,
+                                    _piwigo_api_context_t *api,
+                                    const char *filename,
                                     const int page)
 {
   GList *args = NULL;
@@ -860,17 +900,15 @@ static int _piwigo_api_get_image_id(dt_storage_piwigo_params_t *p,
   args = _piwigo_query_add_arguments(args, "per_page", "100");
   args = _piwigo_query_add_arguments(args, "page", page_string);
 
-  _piwigo_api_post(p->api, args, NULL, TRUE);
+  _piwigo_api_post(api, args, NULL, TRUE);
 
   g_list_free(args);
 
-  char *filename = _get_filename(img, format, fdata);
-
-  if(p->api->response
-     && !p->api->error_occured
-     && json_object_has_member(p->api->response, "result"))
+  if(api->response
+     && !api->error_occured
+     && json_object_has_member(api->response, "result"))
   {
-    JsonNode *result_node = json_object_get_member(p->api->response, "result");
+    JsonNode *result_node = json_object_get_member(api->response, "result");
 
     if(result_node != NULL
        && json_node_get_node_type(result_node) == JSON_NODE_OBJECT)
@@ -898,25 +936,20 @@ static int _piwigo_api_get_image_id(dt_storage_piwigo_params_t *p,
               {
                 if(strcmp(filename,
                           json_object_get_string_member(existing_image, "file")) == 0)
-                {
-                  g_free(filename);
                   return json_object_get_int_member(existing_image, "id");
-                }
               }
             }
-            g_free(filename);
-            return _piwigo_api_get_image_id(p, img, format, fdata, page+1);
+            return _piwigo_api_get_image_id(p, api, filename, page+1);
           }
         }
       }
     }
   }
 
-  g_free(filename);
   return -1;
 }
 
-static gboolean _piwigo_api_set_info(dt_storage_piwigo_params_t *p,
+static gboolean _piwigo_api_set_info(_piwigo_api_context_t *api,
                                      gchar *author,
                                      gchar *caption,
                                      gchar *description,
@@ -939,18 +972,20 @@ static gboolean _piwigo_api_set_info(dt_storage_piwigo_params_t *p,
   if(description && strlen(description)>0)
     args = _piwigo_query_add_arguments(args, "comment", description);
 
-  _piwigo_api_post(p->api, args, NULL, TRUE);
+  _piwigo_api_post(api, args, NULL, TRUE);
 
   g_list_free(args);
 
-  return !p->api->error_occured;
+  return !api->error_occured;
 }
 
 static gboolean _piwigo_api_upload_photo(dt_storage_piwigo_params_t *p,
+                                         _piwigo_api_context_t *api,
                                          gchar *fname,
                                          gchar *author,
                                          gchar *caption,
                                          gchar *description,
+                                         gchar *tags,
                                          const int pwg_image_id)
 {
   GList *args = NULL;
@@ -978,17 +1013,200 @@ static gboolean _piwigo_api_upload_photo(dt_storage_piwigo_params_t *p,
   if(description && strlen(description)>0)
     args = _piwigo_query_add_arguments(args, "comment", description);
 
-  if(p->tags && strlen(p->tags)>0)
-    args = _piwigo_query_add_arguments(args, "tags", p->tags);
+  if(tags && strlen(tags)>0)
+    args = _piwigo_query_add_arguments(args, "tags", tags);
 
   if(pwg_image_id >= 0)
     args = _piwigo_query_add_arguments(args, "image_id", pwg_image_id_string);
 
-  _piwigo_api_post(p->api, args, fname, FALSE);
+  _piwigo_api_post(api, args, fname, FALSE);
 
   g_list_free(args);
 
-  return !p->api->error_occured;
+  return !api->error_occured;
+}
+
+// the exported file and its directory
+static void _piwigo_remove_file(const char *fname)
+{
+  g_unlink(fname);
+  gchar *dir = g_path_get_dirname(fname);
+  g_rmdir(dir);
+  g_free(dir);
+}
+
+static void _piwigo_upload_free(_piwigo_upload_t *u)
+{
+  _piwigo_remove_file(u->fname);
+  g_free(u->fname);
+  g_free(u->filename);
+  g_free(u->author);
+  g_free(u->caption);
+  g_free(u->description);
+  g_free(u->tags);
+  g_free(u);
+}
+
+typedef enum _piwigo_upload_result_t
+{
+  _PIWIGO_UPLOAD_DONE,
+  _PIWIGO_UPLOAD_SKIPPED,
+  _PIWIGO_UPLOAD_FAILED
+} _piwigo_upload_result_t;
+
+static _piwigo_upload_result_t _piwigo_upload(dt_storage_piwigo_params_t *p,
+                                              _piwigo_api_context_t *api,
+                                              _piwigo_upload_t *u)
+{
+  int pwg_image_id = -1;
+
+  if(p->preset_data.conflict_action != DT_PIWIGO_CONFLICT_NOTHING)
+    pwg_image_id = _piwigo_api_get_image_id(p, api, u->filename, 0);
+
+  if(pwg_image_id >= 0 && p->preset_data.conflict_action == DT_PIWIGO_CONFLICT_SKIP)
+    return _PIWIGO_UPLOAD_SKIPPED;
+
+  const gboolean update =
+    pwg_image_id >= 0 && p->preset_data.conflict_action == DT_PIWIGO_CONFLICT_METADATA;
+
+  gulong backoff = G_USEC_PER_SEC;
+  for(int attempt = 0; ; attempt++)
+  {
+    const gboolean status = update
+      ? _piwigo_api_set_info(api, u->author, u->caption, u->description, pwg_image_id)
+      : _piwigo_api_upload_photo(p, api, u->fname, u->author, u->caption,
+                                 u->description, u->tags, pwg_image_id);
+    if(status) return _PIWIGO_UPLOAD_DONE;
+    if(attempt == DT_PIWIGO_UPLOAD_RETRIES) break;
+
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[imageio_storage_piwigo] upload of `%s' failed, retrying in %lus",
+             u->filename, backoff / G_USEC_PER_SEC);
+    g_usleep(backoff);
+    backoff *= 2;
+  }
+
+  dt_print(DT_DEBUG_ALWAYS,
+           "[imageio_storage_piwigo] could not %s `%s' to Piwigo!",
+           update ? "update" : "upload", u->filename);
+  dt_control_log(update ? _("could not update to Piwigo!") : _("could not upload to Piwigo!"));
+  return _PIWIGO_UPLOAD_FAILED;
+}
+
+static void *_piwigo_upload_run(void *data)
+{
+  _piwigo_uploader_t *up = data;
+  dt_storage_piwigo_params_t *p = up->p;
+  dt_pthread_setname("piwigo upload");
+
+  // a session of its own for each connection
+  _piwigo_api_context_t *api = _piwigo_ctx_init();
+  api->server = g_strdup(p->api->server);
+  api->username = g_strdup(p->api->username);
+  api->password = g_strdup(p->api->password);
+  _piwigo_api_authenticate(api);
+
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&up->lock);
+    while(g_queue_is_empty(&up->queue) && !up->closing)
+      dt_pthread_cond_wait(&up->cond, &up->lock);
+    _piwigo_upload_t *u = g_queue_pop_head(&up->queue);
+    // room for the next export
+    pthread_cond_broadcast(&up->cond);
+    dt_pthread_mutex_unlock(&up->lock);
+    if(!u) break;
+
+    const _piwigo_upload_result_t res = _piwigo_upload(p, api, u);
+
+    if(res == _PIWIGO_UPLOAD_SKIPPED)
+      dt_control_log(_("%d/%d skipped (already exists)"), u->num, u->total);
+    else if(res == _PIWIGO_UPLOAD_DONE)
+      dt_control_log(ngettext("%d/%d exported to Piwigo webalbum",
+                              "%d/%d exported to Piwigo webalbum", u->num),
+                     u->num, u->total);
+
+    // the export job left the booking to us, the server has the image now
+    const gboolean tag_change = res != _PIWIGO_UPLOAD_FAILED
+      && dt_control_export_image_done(u->queue_batch, u->imgid);
+
+    dt_pthread_mutex_lock(&up->lock);
+    if(res == _PIWIGO_UPLOAD_FAILED) up->failed++;
+    if(tag_change) up->tag_change = TRUE;
+    dt_pthread_mutex_unlock(&up->lock);
+    _piwigo_upload_free(u);
+  }
+
+  _piwigo_ctx_destroy(&api);
+  return NULL;
+}
+
+static _piwigo_uploader_t *_piwigo_uploader_start(dt_storage_piwigo_params_t *p,
+                                                  const int total)
+{
+  _piwigo_uploader_t *up = g_malloc0(sizeof(_piwigo_uploader_t));
+  up->p = p;
+  dt_pthread_mutex_init(&up->lock, NULL);
+  pthread_cond_init(&up->cond, NULL);
+  g_queue_init(&up->queue);
+
+  const int connections = CLAMP(dt_conf_get_int("storage/piwigo/connections"),
+                                1, DT_PIWIGO_MAX_CONNECTIONS);
+  const int wanted = MIN(connections, MAX(total, 1));
+  // the exported files waiting on disk
+  up->capacity = 2 * wanted;
+  for(int k = 0; k < wanted; k++)
+    if(!dt_pthread_create(&up->thread[up->threads], _piwigo_upload_run, up))
+      up->threads++;
+
+  return up;
+}
+
+// wait for the queued uploads, returns the number of failed ones
+static int _piwigo_uploader_finish(dt_storage_piwigo_params_t *p,
+                                   gboolean *tag_change)
+{
+  _piwigo_uploader_t *up = p->uploader;
+  if(!up) return 0;
+
+  dt_pthread_mutex_lock(&up->lock);
+  up->closing = TRUE;
+  pthread_cond_broadcast(&up->cond);
+  dt_pthread_mutex_unlock(&up->lock);
+
+  for(int k = 0; k < up->threads; k++)
+    pthread_join(up->thread[k], NULL);
+
+  // none of the threads could be started
+  _piwigo_upload_t *u;
+  while((u = g_queue_pop_head(&up->queue)))
+  {
+    up->failed++;
+    _piwigo_upload_free(u);
+  }
+
+  const int failed = up->failed;
+  if(tag_change) *tag_change = up->tag_change;
+  pthread_cond_destroy(&up->cond);
+  dt_pthread_mutex_destroy(&up->lock);
+  g_free(up);
+  p->uploader = NULL;
+  return failed;
+}
+
+// hand the exported image over to the upload threads, FALSE if there are none
+static gboolean _piwigo_uploader_push(_piwigo_uploader_t *up,
+                                      _piwigo_upload_t *u)
+{
+  if(up->threads == 0) return FALSE;
+
+  dt_pthread_mutex_lock(&up->lock);
+  while(g_queue_get_length(&up->queue) >= up->capacity)
+    dt_pthread_cond_wait(&up->cond, &up->lock);
+  g_queue_push_tail(&up->queue, u);
+  pthread_cond_broadcast(&up->cond);
+  dt_pthread_mutex_unlock(&up->lock);
+  return TRUE;
 }
 
 // Login button pressed...
@@ -1259,6 +1477,15 @@ static gboolean _finalize_store(gpointer user_data)
 void finalize_store(struct dt_imageio_module_storage_t *self,
                     dt_imageio_module_data_t *data)
 {
+  // the album is complete once the last uploads are done
+  gboolean tag_change = FALSE;
+  const int failed = _piwigo_uploader_finish((dt_storage_piwigo_params_t *)data,
+                                             &tag_change);
+  if(tag_change) DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
+  if(failed)
+    dt_control_log(ngettext("%d image could not be uploaded to Piwigo",
+                            "%d images could not be uploaded to Piwigo", failed),
+                   failed);
   g_main_context_invoke(NULL, _finalize_store, self->gui_data);
 }
 
@@ -1291,7 +1518,6 @@ int store(dt_imageio_module_storage_t *self,
   }
 
   gint result = 0;
-  gint skipped = 0;
 
   // Let's upload image...
 
@@ -1302,6 +1528,8 @@ int store(dt_imageio_module_storage_t *self,
   dt_image_t *img = dt_image_cache_get(imgid, 'r');
 
   char *filename = _get_filename(img, format, fdata);
+  // the name the server knows the image by
+  gchar *server_filename = g_strdup(filename);
 
   if(*(p->preset_data.filename_pattern))
   {
@@ -1316,7 +1544,12 @@ int store(dt_imageio_module_storage_t *self,
     g_free(result_filename);
   }
 
-  gchar *fname = g_strconcat(darktable.tmpdir, "/", filename, NULL);
+  // a directory for each image, the next ones are exported while it is
+  // waiting for its upload, maybe with the same name
+  gchar *dir = g_strdup_printf("%s/piwigo-%d-%d", darktable.tmpdir, imgid, num);
+  g_mkdir_with_parents(dir, 0700);
+  gchar *fname = g_build_filename(dir, filename, NULL);
+  g_free(dir);
 
   if((metadata->flags & DT_META_METADATA) && !(metadata->flags & DT_META_CALCULATED))
   {
@@ -1368,93 +1601,66 @@ int store(dt_imageio_module_storage_t *self,
     goto cleanup;
   }
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+  if(p->new_album)
   {
-    gboolean status = TRUE;
-
-    if(metadata->flags & DT_META_TAG)
-    {
-      GList *tags_list = dt_tag_get_list_export(imgid, metadata->flags);
-      p->tags = dt_util_glist_to_str(",", tags_list);
-      g_list_free_full(tags_list, g_free);
-    }
-
-    if(p->new_album)
+    if(_piwigo_api_create_new_album(p))
     {
-      status = _piwigo_api_create_new_album(p);
-      if(!status) dt_control_log(_("cannot create a new Piwigo album!"));
-    }
-
-    if(status)
-    {
-      int pwg_image_id = -1;
-
-      if(p->preset_data.conflict_action != DT_PIWIGO_CONFLICT_NOTHING)
-      {
-        pwg_image_id = _piwigo_api_get_image_id(p, img, format, fdata, 0);
-      }
-
-      if(pwg_image_id >= 0 && p->preset_data.conflict_action == DT_PIWIGO_CONFLICT_METADATA)
-      {
-        status = _piwigo_api_set_info(p, author, caption, description, pwg_image_id);
-        if(!status)
-        {
-          dt_print(DT_DEBUG_ALWAYS,
-                   "[imageio_storage_piwigo] could not update to Piwigo!");
-          dt_control_log(_("could not update to Piwigo!"));
-          result = 1;
-        }
-      }
-      else if(pwg_image_id >= 0 && p->preset_data.conflict_action == DT_PIWIGO_CONFLICT_SKIP)
-      {
-        skipped = 1;
-      }
-      else
-      {
-        status = _piwigo_api_upload_photo(p, fname, author, caption,
-                                          description, pwg_image_id);
-        if(!status)
-        {
-          dt_print(DT_DEBUG_ALWAYS,
-                   "[imageio_storage_piwigo] could not upload to Piwigo!");
-          dt_control_log(_("could not upload to Piwigo!"));
-          result = 1;
-        }
-        else if(p->new_album)
-        {
-          // we do not want to create more albums when multiple upload
-          p->new_album = FALSE;
-          _piwigo_refresh_albums(ui, p->album);
-        }
-      }
+      // we do not want to create more albums when multiple upload
+      p->new_album = FALSE;
+      _piwigo_refresh_albums(ui, p->album);
     }
-    if(p->tags)
+    else
     {
-      g_free(p->tags);
-      p->tags = NULL;
+      dt_control_log(_("cannot create a new Piwigo album!"));
+      result = 1;
     }
   }
+  if(!result && !p->uploader)
+    p->uploader = _piwigo_uploader_start(p, total);
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  if(result) goto cleanup;
+
+  _piwigo_upload_t *u = g_malloc0(sizeof(_piwigo_upload_t));
+  u->fname = fname;
+  u->filename = server_filename;
+  u->author = author;
+  u->caption = caption;
+  u->description = description;
+  u->imgid = imgid;
+  u->queue_batch = metadata->queue_batch;
+  u->num = num;
+  u->total = total;
+  if(metadata->flags & DT_META_TAG)
+  {
+    GList *tags_list = dt_tag_get_list_export(imgid, metadata->flags);
+    u->tags = dt_util_glist_to_str(",", tags_list);
+    g_list_free_full(tags_list, g_free);
+  }
+
+  // the upload threads report the completion of the image and book it as
+  // exported once the server has it
+  if(_piwigo_uploader_push(p->uploader, u)) return DT_IMAGEIO_STORE_DEFERRED;
+
+  // no upload thread, do it right away
+  const _piwigo_upload_result_t res = _piwigo_upload(p, p->api, u);
+  if(res == _PIWIGO_UPLOAD_SKIPPED)
+    dt_control_log(_("%d/%d skipped (already exists)"), num, total);
+  else if(res == _PIWIGO_UPLOAD_DONE)
+    dt_control_log(ngettext("%d/%d exported to Piwigo webalbum",
+                            "%d/%d exported to Piwigo webalbum", num),
+                   num, total);
+  _piwigo_upload_free(u);
+  return res == _PIWIGO_UPLOAD_FAILED;
 
 cleanup:
 
   // And remove from filesystem..
-  g_unlink(fname);
+  _piwigo_remove_file(fname);
+  g_free(fname);
+  g_free(server_filename);
   g_free(caption);
   g_free(description);
   g_free(author);
-
-  if(skipped)
-  {
-    dt_control_log(_("%d/%d skipped (already exists)"), num, total);
-  }
-  else if(!result && !skipped)
-  {
-    // this makes sense only if the export was successful
-    dt_control_log
-      (ngettext("%d/%d exported to Piwigo webalbum",
-                "%d/%d exported to Piwigo webalbum", num),
-       num, total);
-  }
   return result;
 }
 
@@ -1525,7 +1731,6 @@ void *get_params(dt_imageio_module_storage_t *self)
     int index = dt_bauhaus_combobox_get(ui->album_list);
 
     p->album_id = 0;
-    p->tags = NULL;
 
     if(index >= 0)
     {
@@ -1642,8 +1847,8 @@ void free_params(dt_imageio_module_storage_t *self,
 
   if(p)
   {
+    _piwigo_uploader_finish(p, NULL);
     g_free(p->album);
-    g_free(p->tags);
     dt_variables_params_destroy(p->vp);
     _piwigo_ctx_destroy(&p->api);
     free(p);
@@ -485,6 +485,9 @@ public:
 
   ~PermutohedralLattice()
   {
+    delete[] neighbors;
+    delete[] gatherStart;
+    delete[] gather;
     delete[] scaleFactor;
     delete[] replay;
     delete[] canonical;
@@ -729,6 +732,70 @@ public:
       vals[r.offset[i]].add(value, r.weight[i]);
   }
 
+  /* Prepare a lattice which is going to be filtered many times (DenseCRF
+   * refining several masks on the same guide image): the neighbours of
+   * each vertex along each axis are looked up once for all blurs, and the
+   * replay table is transposed so that gatherSplat() can fill the vertices
+   * in parallel. Call after the splat (and merge_splat_threads()).
+   */
+  void prepareReuse()
+  {
+    const size_t n = hashTables[0].size();
+    const Key *keyBase = hashTables[0].getKeys();
+    const Value *hashTableBase = hashTables[0].getValues();
+
+    neighbors = new int[n * (D + 1) * 2];
+    DT_OMP_FOR()
+    for(size_t i = 0; i < n; i++)
+    {
+      for(int j = 0; j <= D; j++)
+      {
+        const Key neighbor1(keyBase[i], j, +1);
+        const Key neighbor2(keyBase[i], j, -1);
+        const Value *vm1 = hashTables[0].lookup(neighbor1, false);
+        const Value *vp1 = hashTables[0].lookup(neighbor2, false);
+        neighbors[(i * (D + 1) + j) * 2 + 0] = vm1 ? (int)(vm1 - hashTableBase) : -1;
+        neighbors[(i * (D + 1) + j) * 2 + 1] = vp1 ? (int)(vp1 - hashTableBase) : -1;
+      }
+    }
+
+    // counting sort of the replay entries by vertex
+    gatherStart = new size_t[n + 1]();
+    for(size_t k = 0; k < nData; k++)
+      for(int i = 0; i <= D; i++) gatherStart[replay[k].offset[i] + 1]++;
+    for(size_t v = 0; v < n; v++) gatherStart[v + 1] += gatherStart[v];
+
+    gather = new GatherEntry[nData * (D + 1)];
+    size_t *fill = new size_t[n];
+    std::copy(gatherStart, gatherStart + n, fill);
+    for(size_t k = 0; k < nData; k++)
+      for(int i = 0; i <= D; i++)
+        gather[fill[replay[k].offset[i]]++] = { (int)k, replay[k].weight[i] };
+    delete[] fill;
+
+    dt_print(DT_DEBUG_MEMORY,
+      "[permutohedral] reuse tables using %lu bytes for %lu vertices",
+      n * (D + 1) * 2 * sizeof(int) + (n + 1) * sizeof(size_t)
+      + nData * (D + 1) * sizeof(GatherEntry), n);
+  }
+
+  /* Splat values[nData * VD] into the vertices of a prepared lattice,
+   * replacing what they held. Each vertex sums its own contributions, so
+   * there are no races between the threads.
+   */
+  void gatherSplat(const float *values)
+  {
+    Value *vals = hashTables[0].getValues();
+    const size_t n = hashTables[0].size();
+    DT_OMP_FOR()
+    for(size_t v = 0; v < n; v++)
+    {
+      Value::clear((float *)&vals[v].value);
+      for(size_t k = gatherStart[v]; k < gatherStart[v + 1]; k++)
+        vals[v].add(values + (size_t)gather[k].index * VD, gather[k].weight);
+    }
+  }
+
   /* Performs slicing out of position vectors. Note that the barycentric weights and the simplex
    * containing each position vector were calculated and stored in the splatting step.
    * We may reuse this to accelerate the algorithm. (See pg. 6 in paper.)
@@ -762,6 +829,21 @@ public:
     // For each of d+1 axes,
     for(int j = 0; j <= D; j++)
     {
+      if(neighbors)
+      {
+        // prepared lattice: the neighbours are known, no hash lookups
+        DT_OMP_FOR()
+        for(size_t i = 0; i < hashTables[0].size(); i++)
+        {
+          const int n1 = neighbors[(i * (D + 1) + j) * 2 + 0];
+          const int n2 = neighbors[(i * (D + 1) + j) * 2 + 1];
+          newValue[i].mix(n1 >= 0 ? oldValue + n1 : zeroPtr, oldValue + i,
+                          n2 >= 0 ? oldValue + n2 : zeroPtr);
+        }
+        std::swap(newValue, oldValue);
+        continue;
+      }
+
       DT_OMP_FOR()
       // For each vertex in the lattice,
       for(size_t i = 0; i < hashTables[0].size(); i++) // blur point i in dimension j
@@ -814,6 +896,16 @@ private:
     float weight[D + 1];
   } * replay;
 
+  // set up by prepareReuse()
+  struct GatherEntry
+  {
+    int index;    // data point
+    float weight;
+  };
+  int *neighbors = nullptr;      // per vertex and axis: the +1 and -1 neighbours, or -1
+  size_t *gatherStart = nullptr; // per vertex: its first entry in gather
+  GatherEntry *gather = nullptr;
+
   HashTable *hashTables;
 };
 
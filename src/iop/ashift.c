@@ -77,6 +77,9 @@
 #define NMS_EPSILON 1e-3                    // break criterion for Nelder-Mead simplex
 #define NMS_SCALE 1.0                       // scaling factor for Nelder-Mead simplex
 #define NMS_ITERATIONS 400                  // number of iterations for Nelder-Mead simplex
+#define NMS_COARSE_LINES 64                 // number of strongest lines for the coarse pass of the simplex fit
+#define NMS_FINE_SCALE 0.1                  // scaling factor for the simplex refining the coarse fit
+#define LSD_BAND_HEIGHT 512                 // LSD: minimum height of the bands detected in parallel
 #define NMS_CROP_EPSILON 100.0              // break criterion for Nelder-Mead simplex on crop fitting
 #define NMS_CROP_SCALE 0.5                  // scaling factor for Nelder-Mead simplex on crop fitting
 #define NMS_CROP_ITERATIONS 100             // number of iterations for Nelder-Mead simplex on crop fitting
@@ -1473,6 +1476,79 @@ static void gamma_correct(const float *const in,
 
 // do actual line_detection based on LSD algorithm and return results according
 // to this module's conventions
+// run LSD on horizontal bands of the image in parallel and return the
+// lines in image coordinates, in the same layout as LineSegmentDetection()
+static double *_lsd_bands(const double *greyscale,
+                          const int width,
+                          const int height,
+                          int *lines_count)
+{
+  const int bands = MAX(1, MIN((int)dt_get_num_threads(), height / LSD_BAND_HEIGHT));
+  if(bands == 1)
+    return LineSegmentDetection(lines_count, (double *)greyscale, width, height,
+                                LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
+                                LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                LSD_N_BINS, NULL, NULL, NULL);
+
+  double **band_lines = calloc(bands, sizeof(double *));
+  int *band_count = calloc(bands, sizeof(int));
+  if(!band_lines || !band_count)
+  {
+    free(band_lines);
+    free(band_count);
+    *lines_count = 0;
+    return NULL;
+  }
+
+  DT_OMP_FOR(shared(band_lines, band_count))
+  for(int b = 0; b < bands; b++)
+  {
+    const int y0 = b * height / bands;
+    const int y1 = (b + 1) * height / bands;
+    band_lines[b] = LineSegmentDetection(&band_count[b],
+                                         (double *)greyscale + (size_t)y0 * width,
+                                         width, y1 - y0,
+                                         LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
+                                         LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                         LSD_N_BINS, NULL, NULL, NULL);
+    if(!band_lines[b]) band_count[b] = 0;
+  }
+
+  int total = 0;
+  for(int b = 0; b < bands; b++) total += band_count[b];
+
+  double *lines = total ? malloc(sizeof(double) * 7 * total) : NULL;
+  int count = 0;
+  for(int b = 0; b < bands && lines; b++)
+  {
+    const int y0 = b * height / bands;
+    const int band_height = (b + 1) * height / bands - y0;
+    for(int n = 0; n < band_count[b]; n++)
+    {
+      const double *l = band_lines[b] + n * 7;
+      // like on the image borders, lines running along the cut
+      // between bands are artifacts
+      if(fabs(l[1] - l[3]) < 1
+         && ((b > 0 && fmax(l[1], l[3]) < 2)
+             || (b < bands - 1 && fmin(l[1], l[3]) > band_height - 3)))
+        continue;
+
+      double *dst = lines + count * 7;
+      memcpy(dst, l, sizeof(double) * 7);
+      dst[1] += y0;
+      dst[3] += y0;
+      count++;
+    }
+  }
+
+  for(int b = 0; b < bands; b++) free(band_lines[b]);
+  free(band_lines);
+  free(band_count);
+
+  *lines_count = count;
+  return lines;
+}
+
 static gboolean line_detect(float *in,
                        const int width,
                        const int height,
@@ -1527,10 +1603,7 @@ static gboolean line_detect(float *in,
   // it returns structural details as vector 'double lines[7 * lines_count]'
   int lines_count;
 
-  lsd_lines = LineSegmentDetection(&lines_count, greyscale, width, height,
-                                   LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
-                                   LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
-                                   LSD_N_BINS, NULL, NULL, NULL);
+  lsd_lines = _lsd_bands(greyscale, width, height, &lines_count);
 
   // we count the lines that we really want to use
   int lct = 0;
@@ -2250,6 +2323,59 @@ static double model_fitness(double *params, void *data)
   return sum;
 }
 
+static int _compare_line_weight(const void *a, const void *b)
+{
+  const float wa = ((const dt_iop_ashift_line_t *)a)->weight;
+  const float wb = ((const dt_iop_ashift_line_t *)b)->weight;
+  return (wa < wb) - (wa > wb);
+}
+
+// get the strongest lines used by fit, half of them of each direction.
+// returns NULL if there are too few lines for a coarse pass to pay off.
+static dt_iop_ashift_line_t *_strongest_lines(const dt_iop_ashift_fit_params_t *fit,
+                                              int *count)
+{
+  int used = 0;
+  for(int n = 0; n < fit->lines_count; n++)
+    used += (fit->lines[n].type & fit->linemask) == fit->linetype;
+  if(used <= 2 * NMS_COARSE_LINES) return NULL;
+
+  dt_iop_ashift_line_t *vertical = malloc(sizeof(dt_iop_ashift_line_t) * used);
+  dt_iop_ashift_line_t *horizontal = malloc(sizeof(dt_iop_ashift_line_t) * used);
+  dt_iop_ashift_line_t *coarse = malloc(sizeof(dt_iop_ashift_line_t) * NMS_COARSE_LINES);
+  if(!vertical || !horizontal || !coarse)
+  {
+    free(vertical);
+    free(horizontal);
+    free(coarse);
+    return NULL;
+  }
+
+  int vcount = 0;
+  int hcount = 0;
+  for(int n = 0; n < fit->lines_count; n++)
+  {
+    if((fit->lines[n].type & fit->linemask) != fit->linetype) continue;
+    if(fit->lines[n].type & ASHIFT_LINE_DIRVERT)
+      vertical[vcount++] = fit->lines[n];
+    else
+      horizontal[hcount++] = fit->lines[n];
+  }
+  qsort(vertical, vcount, sizeof(dt_iop_ashift_line_t), _compare_line_weight);
+  qsort(horizontal, hcount, sizeof(dt_iop_ashift_line_t), _compare_line_weight);
+
+  // take what one direction can't fill from the other one
+  const int vtake = MIN(vcount, MAX(NMS_COARSE_LINES / 2, NMS_COARSE_LINES - hcount));
+  const int htake = MIN(hcount, NMS_COARSE_LINES - vtake);
+  memcpy(coarse, vertical, sizeof(dt_iop_ashift_line_t) * vtake);
+  memcpy(coarse + vtake, horizontal, sizeof(dt_iop_ashift_line_t) * htake);
+
+  free(vertical);
+  free(horizontal);
+  *count = vtake + htake;
+  return coarse;
+}
+
 // setup all data structures for fitting and call NM simplex
 static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *self,
                                         dt_iop_ashift_params_t *p,
@@ -2376,9 +2502,32 @@ static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *self,
     return NMS_NOT_ENOUGH_LINES;
   }
 
+  // coarse to fine: with many lines fit the strongest ones first, and
+  // refine that with all lines starting from a smaller simplex
+  double nms_scale = NMS_SCALE;
+  int coarse_count = 0;
+  dt_iop_ashift_line_t *coarse = _strongest_lines(&fit, &coarse_count);
+  if(coarse)
+  {
+    dt_iop_ashift_fit_params_t coarse_fit = fit;
+    coarse_fit.lines = coarse;
+    coarse_fit.lines_count = coarse_count;
+    double coarse_params[4];
+    memcpy(coarse_params, params, sizeof(params));
+    const int coarse_iter = simplex(model_fitness, coarse_params, fit.params_count,
+                                    NMS_EPSILON, NMS_SCALE, NMS_ITERATIONS,
+                                    NULL, (void*)&coarse_fit);
+    if(coarse_iter < NMS_ITERATIONS)
+    {
+      memcpy(params, coarse_params, sizeof(params));
+      nms_scale = NMS_FINE_SCALE;
+    }
+    free(coarse);
+  }
+
   // start the simplex fit
   const int iter = simplex(model_fitness, params, fit.params_count,
-                           NMS_EPSILON, NMS_SCALE, NMS_ITERATIONS, NULL, (void*)&fit);
+                           NMS_EPSILON, nms_scale, NMS_ITERATIONS, NULL, (void*)&fit);
 
   // error case: the fit did not converge
   if(iter >= NMS_ITERATIONS)
@@ -1071,7 +1071,11 @@ static double *inv = NULL; /* table to keep computed inverse values */
 __attribute__((constructor)) static void invConstructor()
 {
   if(inv) return;
+  // fill the table up front so concurrent detections only read from it
   inv = malloc(sizeof(double) * TABSIZE);
+  if(!inv) return;
+  inv[0] = 0.0;
+  for(int i = 1; i < TABSIZE; i++) inv[i] = 1.0 / (double) i;
 }
 
 __attribute__((destructor)) static void invDestructor()
@@ -55,7 +55,17 @@ typedef struct dt_iop_bilat_params_t
   float midtone; // $MIN: 0.001 $MAX: 1.0 $DEFAULT: 0.5 $DESCRIPTION: "midtone range"
 } dt_iop_bilat_params_t;
 
-typedef dt_iop_bilat_params_t dt_iop_bilat_data_t;
+typedef struct dt_iop_bilat_data_t
+{
+  dt_iop_bilat_mode_t mode;
+  float sigma_r;
+  float sigma_s;
+  float detail;
+  float midtone;
+  // input pyramid of the local laplacian, kept while only the
+  // parameters change
+  local_laplacian_pyramid_t pyramid;
+} dt_iop_bilat_data_t;
 
 typedef struct dt_iop_bilat_gui_data_t
 {
@@ -297,7 +307,14 @@ void commit_params(dt_iop_module_t *self,
 {
   dt_iop_bilat_params_t *p = (dt_iop_bilat_params_t *)p1;
   dt_iop_bilat_data_t *d = piece->data;
-  *d = *p;
+  d->mode = p->mode;
+  d->sigma_r = p->sigma_r;
+  d->sigma_s = p->sigma_s;
+  d->detail = p->detail;
+  d->midtone = p->midtone;
+
+  if(d->mode != s_mode_local_laplacian)
+    local_laplacian_pyramid_free(&d->pyramid);
 
 #ifdef HAVE_OPENCL
   if(d->mode == s_mode_bilateral)
@@ -321,6 +338,8 @@ void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_bilat_data_t *d = piece->data;
+  local_laplacian_pyramid_free(&d->pyramid);
   free(piece->data);
   piece->data = NULL;
 }
@@ -360,8 +379,19 @@ void process(dt_iop_module_t *self,
   }
   else // s_mode_local_laplacian
   {
+    // the interactive pipes keep the input pyramid as long as the
+    // upstream pipe and the roi don't change
+    local_laplacian_pyramid_t *cache = NULL;
+    if(piece->pipe->type & DT_DEV_PIXELPIPE_BASIC)
+    {
+      const dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi_in, FALSE);
+      if(d->pyramid.hash != hash)
+        local_laplacian_pyramid_free(&d->pyramid);
+      d->pyramid.hash = hash;
+      cache = &d->pyramid;
+    }
     local_laplacian(i, o, roi_in->width, roi_in->height,
-                    d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+                    d->midtone, d->sigma_s, d->sigma_r, d->detail, 0, cache);
   }
 }
 
@@ -243,7 +243,8 @@ const char **description(dt_iop_module_t *self)
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING
+         | IOP_FLAGS_POINTWISE;
 }
 
 int default_group()
@@ -768,6 +769,7 @@ static inline void _luma_chroma(const dt_aligned_pixel_t input,
 }
 
 DT_OMP_DECLARE_SIMD(aligned(in, out, XYZ_to_RGB, RGB_to_XYZ, MIX : 64) aligned(illuminant, saturation, lightness, grey:16))
+__DT_CLONE_TARGETS__
 static inline void _loop_switch(const float *const restrict in,
                                 float *const restrict out,
                                 const size_t width,
@@ -59,6 +59,7 @@ typedef struct dt_iop_colorout_data_t
 typedef struct dt_iop_colorout_global_data_t
 {
   int kernel_colorout;
+  dt_conf_handle_t *force_lcms2;
 } dt_iop_colorout_global_data_t;
 
 typedef struct dt_iop_colorout_params_t
@@ -98,7 +99,8 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_WRITE_PIPECACHE_IN;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_WRITE_PIPECACHE_IN
+         | IOP_FLAGS_POINTWISE;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -232,6 +234,7 @@ void init_global(dt_iop_module_so_t *self)
   dt_iop_colorout_global_data_t *gd = malloc(sizeof(dt_iop_colorout_global_data_t));
   self->data = gd;
   gd->kernel_colorout = dt_opencl_create_kernel(program, "colorout");
+  gd->force_lcms2 = dt_conf_handle("plugins/lighttable/export/force_lcms2", DT_BOOL);
 }
 
 void cleanup_global(dt_iop_module_so_t *self)
@@ -556,7 +559,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   // to be used in pixel-pipe cache
   dt_ioppr_set_pipe_export_profile_info(self->dev, piece->pipe, p->type, p->filename, p->intent);
 
-  const gboolean force_lcms2 = dt_conf_get_bool("plugins/lighttable/export/force_lcms2");
+  const dt_iop_colorout_global_data_t *gd = self->global_data;
+  const gboolean force_lcms2 = dt_conf_handle_get_bool(gd->force_lcms2);
 
   dt_colorspaces_color_profile_type_t out_type = DT_COLORSPACE_SRGB;
   gchar *out_filename = NULL;
@@ -232,6 +232,7 @@ typedef struct dt_iop_demosaic_global_data_t
   int kernel_write_blended_dual;
   int gaussian_9x9_mul;
   int gaussian_9x9_div;
+  int gaussian_9x9_iter;
   int prepare_blend;
   int modify_blend;
   int show_blend_mask;
@@ -1277,6 +1278,7 @@ void init_global(dt_iop_module_so_t *self)
   const int capt = 38; // capture.cl, from programs.conf
   gd->gaussian_9x9_mul = dt_opencl_create_kernel(capt, "kernel_9x9_mul");
   gd->gaussian_9x9_div = dt_opencl_create_kernel(capt, "kernel_9x9_div");
+  gd->gaussian_9x9_iter = dt_opencl_create_kernel(capt, "kernel_9x9_iter");
   gd->prepare_blend = dt_opencl_create_kernel(capt, "prepare_blend");
   gd->modify_blend = dt_opencl_create_kernel(capt, "modify_blend");
   gd->show_blend_mask = dt_opencl_create_kernel(capt, "show_blend_mask");
@@ -1337,6 +1339,7 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_write_blended_dual);
   dt_opencl_free_kernel(gd->gaussian_9x9_mul);
   dt_opencl_free_kernel(gd->gaussian_9x9_div);
+  dt_opencl_free_kernel(gd->gaussian_9x9_iter);
   dt_opencl_free_kernel(gd->prepare_blend);
   dt_opencl_free_kernel(gd->modify_blend);
   dt_opencl_free_kernel(gd->show_blend_mask);
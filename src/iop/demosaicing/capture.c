@@ -1052,6 +1052,7 @@ static int _capture_sharpen_cl(dt_iop_module_t *self,
 
   cl_mem gcoeffs = NULL;
   cl_mem gauss_idx = NULL;
+  cl_mem tmp3 = NULL;
 
   cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
   cl_mem blendmask = dt_opencl_alloc_device_buffer(devid, bsize);
@@ -1108,21 +1109,56 @@ static int _capture_sharpen_cl(dt_iop_module_t *self,
     goto finish;
   }
 
-  for(int iter = 0; iter < d->cs_iter; iter++)
+  // the fused iterations keep the blurred estimate and ratio in local
+  // memory and ping-pong the estimate between tmp1 and tmp3, tmp2 keeps
+  // the ratio of the pixels not being sharpened.
+  dt_opencl_local_buffer_t locopt
+    = (dt_opencl_local_buffer_t){ .xoffset = 2*8, .xfactor = 1, .yoffset = 2*8, .yfactor = 1,
+                                  .cellsize = 2 * sizeof(float), .overhead = 0,
+                                  .sizex = 1 << 4, .sizey = 1 << 4 };
+  if(d->cs_iter > 0
+     && dt_opencl_local_buffer_opt(devid, gd->gaussian_9x9_iter, &locopt) == CL_SUCCESS)
+    tmp3 = dt_opencl_alloc_device_buffer(devid, bsize);
+
+  cl_mem estimate = tmp1;
+  if(tmp3)
   {
-    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->gaussian_9x9_div, width, height,
-      CLARG(tmp1), CLARG(tmp2), CLARG(luminance), CLARG(blendmask),
-      CLARG(gcoeffs), CLARG(gauss_idx), CLARG(width), CLARG(height));
-    if(err != CL_SUCCESS) goto finish;
-
-    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->gaussian_9x9_mul, width, height,
-      CLARG(tmp2), CLARG(tmp1), CLARG(blendmask),
-      CLARG(gcoeffs), CLARG(gauss_idx), CLARG(width), CLARG(height));
-    if(err != CL_SUCCESS) goto finish;
+    const size_t sizes[2] = { ROUNDUP(width, locopt.sizex), ROUNDUP(height, locopt.sizey) };
+    const size_t local[2] = { locopt.sizex, locopt.sizey };
+    const size_t esize = sizeof(float) * (locopt.sizex + 16) * (locopt.sizey + 16);
+    const size_t qsize = sizeof(float) * (locopt.sizex + 8) * (locopt.sizey + 8);
+    cl_mem next = tmp3;
+    for(int iter = 0; iter < d->cs_iter; iter++)
+    {
+      err = dt_opencl_enqueue_kernel_2d_local_args(devid, gd->gaussian_9x9_iter, sizes, local,
+        CLARG(estimate), CLARG(next), CLARG(tmp2), CLARG(luminance), CLARG(blendmask),
+        CLARG(gcoeffs), CLARG(gauss_idx), CLARG(width), CLARG(height),
+        CLLOCAL(esize), CLLOCAL(qsize));
+      if(err != CL_SUCCESS) goto finish;
+
+      cl_mem t = estimate;
+      estimate = next;
+      next = t;
+    }
+  }
+  else
+  {
+    for(int iter = 0; iter < d->cs_iter; iter++)
+    {
+      err = dt_opencl_enqueue_kernel_2d_args(devid, gd->gaussian_9x9_div, width, height,
+        CLARG(tmp1), CLARG(tmp2), CLARG(luminance), CLARG(blendmask),
+        CLARG(gcoeffs), CLARG(gauss_idx), CLARG(width), CLARG(height));
+      if(err != CL_SUCCESS) goto finish;
+
+      err = dt_opencl_enqueue_kernel_2d_args(devid, gd->gaussian_9x9_mul, width, height,
+        CLARG(tmp2), CLARG(tmp1), CLARG(blendmask),
+        CLARG(gcoeffs), CLARG(gauss_idx), CLARG(width), CLARG(height));
+      if(err != CL_SUCCESS) goto finish;
+    }
   }
 
   err = dt_opencl_enqueue_kernel_2d_args(devid, gd->capture_result, width, height,
-    CLARG(dev_rgb), CLARG(dev_out), CLARG(blendmask), CLARG(luminance), CLARG(tmp1),
+    CLARG(dev_rgb), CLARG(dev_out), CLARG(blendmask), CLARG(luminance), CLARG(estimate),
     CLARG(width), CLARG(height));
 
   finish:
@@ -1137,6 +1173,7 @@ static int _capture_sharpen_cl(dt_iop_module_t *self,
   dt_opencl_release_mem_object(dev_rgb);
   dt_opencl_release_mem_object(tmp2);
   dt_opencl_release_mem_object(tmp1);
+  dt_opencl_release_mem_object(tmp3);
   dt_opencl_release_mem_object(luminance);
 
   return err;
@@ -83,6 +83,7 @@ static inline float _safe_in(float a, float scale)
 }
 
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
+__DT_CLONE_TARGETS__
 static void demosaic_box3(float *const restrict out,
                           const float *const restrict in,
                           const int width,
@@ -116,6 +117,7 @@ static void demosaic_box3(float *const restrict out,
 }
 
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
+__DT_CLONE_TARGETS__
 static void rcd_demosaic(float *const restrict out,
                          const float *const restrict in,
                          const int width,
@@ -42,6 +42,7 @@ static inline const short *_hexmap(const int row,
 /*
    Frank Markesteijn's algorithm for Fuji X-Trans sensors
 */
+__DT_CLONE_TARGETS__
 static void xtrans_markesteijn_interpolate(float *out,
                                            const float *const in,
                                            const int width,
@@ -515,6 +516,7 @@ static void xtrans_markesteijn_interpolate(float *out,
 #undef TS
 
 #define TS DT_FDC_TS
+__DT_CLONE_TARGETS__
 static void xtrans_fdc_interpolate(float *out,
                                    const float *const in,
                                    const int width,
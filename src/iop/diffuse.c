@@ -1337,83 +1337,59 @@ static inline void inpaint_mask(float *const restrict inpainted,
   }
 }
 
-void process(dt_iop_module_t *self,
-             dt_dev_pixelpipe_iop_t *piece,
-             const void *const restrict ivoid,
-             void *const restrict ovoid,
-             const dt_iop_roi_t *const roi_in,
-             const dt_iop_roi_t *const roi_out)
+// run all iterations on a width x height image, returns FALSE if out of memory.
+// the temporary buffers come from the pipe's scratch arena.
+static gboolean _diffuse(dt_dev_pixelpipe_iop_t *piece,
+                         const dt_iop_diffuse_data_t *const data,
+                         const float *const restrict input,
+                         float *const restrict out,
+                         const size_t width,
+                         const size_t height,
+                         const float scale)
 {
-  const gboolean fastmode = dt_pipe_is_fast(piece->pipe);
-
-  const dt_iop_diffuse_data_t *const data = piece->data;
-
-  const size_t width = roi_out->width;
-  const size_t height = roi_out->height;
-
-  // allow fast mode, just copy input to output
-  if(fastmode)
-  {
-    const size_t ch = piece->colors;
-    dt_iop_copy_image_roi(ovoid, ivoid, ch, roi_in, roi_out);
-    return;
-  }
-
-  uint8_t *const restrict mask = dt_alloc_align_uint8(width * height);
-
-  float *restrict in = DT_IS_ALIGNED((float *const restrict)ivoid);
-  float *const restrict out = DT_IS_ALIGNED((float *const restrict)ovoid);
-
-  float *restrict temp1, *restrict temp2;
-  // temp buffer for blurs. We will need to cycle between them for memory efficiency
-  float *restrict LF_odd, *restrict LF_even;
-
-  float *restrict temp_in = NULL;
-  float *restrict temp_out = NULL;
-
-  gboolean out_of_memory = !mask
-    || !dt_iop_alloc_image_buffers(self, roi_in, roi_out,
-                                 4 | DT_IMGSZ_OUTPUT, &temp1,
-                                 4 | DT_IMGSZ_OUTPUT, &temp2,
-                                 4 | DT_IMGSZ_OUTPUT, &LF_odd,
-                                 4 | DT_IMGSZ_OUTPUT, &LF_even,
-                                 0, NULL); // if failing all pointers are NULL
-
-  const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
   const float final_radius = (data->radius + data->radius_center) * 2.f / scale;
 
   const int iterations = MAX(data->iterations, 1);
   const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
   const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
 
+  uint8_t *const restrict mask = dt_dev_pixelpipe_scratch_alloc(piece, width * height);
+
+  // temp buffer for blurs. We will need to cycle between them for memory efficiency
+  float *const restrict temp1 = dt_dev_pixelpipe_scratch_float(piece, width * height * 4);
+  float *const restrict temp2 = dt_dev_pixelpipe_scratch_float(piece, width * height * 4);
+  float *const restrict LF_odd = dt_dev_pixelpipe_scratch_float(piece, width * height * 4);
+  float *const restrict LF_even = dt_dev_pixelpipe_scratch_float(piece, width * height * 4);
+
+  gboolean out_of_memory = !mask || !temp1 || !temp2 || !LF_odd || !LF_even;
+
   // wavelets scales buffers
   float *restrict HF[MAX_NUM_SCALES];
   for(int s = 0; s < scales; s++)
   {
-    HF[s] = out_of_memory ? NULL : dt_alloc_align_float(width * height * 4);
+    HF[s] = out_of_memory ? NULL : dt_dev_pixelpipe_scratch_float(piece, width * height * 4);
     if(!HF[s]) out_of_memory = TRUE;
   }
 
   // check that all buffers exist before processing because we use a lot of memory here.
-  if(out_of_memory)
-  {
-    dt_iop_copy_image_roi(ovoid, ivoid, piece->colors, roi_in, roi_out);
-    dt_control_log(_("diffuse/sharpen failed to allocate memory, check your RAM settings"));
-    goto finish;
-  }
+  if(out_of_memory) return FALSE;
 
+  const float *restrict in = input;
   const gboolean has_mask = (data->threshold > 0.f);
   if(has_mask)
   {
     // build a boolean mask, TRUE where image is above threshold, FALSE otherwise
-    build_mask(in, mask, data->threshold, roi_out->width, roi_out->height);
+    build_mask(in, mask, data->threshold, width, height);
 
     // init the inpainting area with noise
-    inpaint_mask(temp1, in, mask, roi_out->width, roi_out->height);
+    inpaint_mask(temp1, in, mask, width, height);
 
     in = temp1;
   }
 
+  const float *restrict temp_in = NULL;
+  float *restrict temp_out = NULL;
+
   for(int it = 0; it < iterations; it++)
   {
     if(it == 0)
@@ -1435,19 +1411,135 @@ void process(dt_iop_module_t *self,
     if(it == iterations - 1)
       temp_out = out;
 
-    wavelets_process(temp_in, temp_out, mask,
-                     roi_out->width, roi_out->height,
+    wavelets_process(temp_in, temp_out, mask, width, height,
                      data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
   }
 
-finish:
-  dt_free_align(mask);
-  dt_free_align(temp1);
-  dt_free_align(temp2);
-  dt_free_align(LF_even);
-  dt_free_align(LF_odd);
-  for(int s = 0; s < scales; s++)
-    if(HF[s]) dt_free_align(HF[s]);
+  return TRUE;
+}
+
+/* Approximation for the small preview and thumbnail pipes: the image is diffused at
+   half its size and only the change is upsampled and added back to the input, so the
+   finest details the module doesn't touch are kept. The radii work out the same as at
+   full size, the difference lies in the finest wavelet scale, about one pixel of the
+   image processed, which the half resolution can't diffuse.
+*/
+static inline gboolean _use_approximation(const dt_dev_pixelpipe_iop_t *piece,
+                                          const size_t width,
+                                          const size_t height)
+{
+  return (dt_pipe_is_preview(piece->pipe) || dt_pipe_is_thumb(piece->pipe))
+    && width >= 64 && height >= 64;
+}
+
+static gboolean _diffuse_approximated(dt_dev_pixelpipe_iop_t *piece,
+                                      const dt_iop_diffuse_data_t *const data,
+                                      const float *const restrict in,
+                                      float *const restrict out,
+                                      const size_t width,
+                                      const size_t height,
+                                      const float scale)
+{
+  const size_t ds_width = (width + 1) / 2;
+  const size_t ds_height = (height + 1) / 2;
+  float *const restrict ds_in = dt_dev_pixelpipe_scratch_float(piece, ds_width * ds_height * 4);
+  float *const restrict ds_out = dt_dev_pixelpipe_scratch_float(piece, ds_width * ds_height * 4);
+  gboolean success = ds_in && ds_out;
+
+  if(success)
+  {
+    // 2x2 box downscaling, the last row and column may be single
+    DT_OMP_FOR(collapse(2))
+    for(size_t i = 0; i < ds_height; i++)
+      for(size_t j = 0; j < ds_width; j++)
+      {
+        const size_t y0 = 2 * i;
+        const size_t x0 = 2 * j;
+        const size_t y1 = MIN(y0 + 1, height - 1);
+        const size_t x1 = MIN(x0 + 1, width - 1);
+        for_four_channels(c)
+          ds_in[(i * ds_width + j) * 4 + c] = 0.25f * (in[(y0 * width + x0) * 4 + c]
+                                                     + in[(y0 * width + x1) * 4 + c]
+                                                     + in[(y1 * width + x0) * 4 + c]
+                                                     + in[(y1 * width + x1) * 4 + c]);
+      }
+
+    success = _diffuse(piece, data, ds_in, ds_out, ds_width, ds_height, 2.f * scale);
+  }
+
+  if(success)
+  {
+    // bilinear upsampling of the change, pixel centers of the half size image
+    // are at 2 * i + 0.5 in the full size image
+    DT_OMP_FOR()
+    for(size_t i = 0; i < height; i++)
+    {
+      const float fy = CLAMP(0.5f * i - 0.25f, 0.f, (float)(ds_height - 1));
+      const size_t y0 = (size_t)fy;
+      const size_t y1 = MIN(y0 + 1, ds_height - 1);
+      const float dy = fy - y0;
+      for(size_t j = 0; j < width; j++)
+      {
+        const float fx = CLAMP(0.5f * j - 0.25f, 0.f, (float)(ds_width - 1));
+        const size_t x0 = (size_t)fx;
+        const size_t x1 = MIN(x0 + 1, ds_width - 1);
+        const float dx = fx - x0;
+        const size_t k00 = (y0 * ds_width + x0) * 4;
+        const size_t k01 = (y0 * ds_width + x1) * 4;
+        const size_t k10 = (y1 * ds_width + x0) * 4;
+        const size_t k11 = (y1 * ds_width + x1) * 4;
+        const size_t k = (i * width + j) * 4;
+        for_four_channels(c)
+        {
+          const float top = (1.f - dx) * (ds_out[k00 + c] - ds_in[k00 + c])
+                            + dx * (ds_out[k01 + c] - ds_in[k01 + c]);
+          const float bottom = (1.f - dx) * (ds_out[k10 + c] - ds_in[k10 + c])
+                               + dx * (ds_out[k11 + c] - ds_in[k11 + c]);
+          out[k + c] = in[k + c] + (1.f - dy) * top + dy * bottom;
+        }
+      }
+    }
+  }
+
+  return success;
+}
+
+void process(dt_iop_module_t *self,
+             dt_dev_pixelpipe_iop_t *piece,
+             const void *const restrict ivoid,
+             void *const restrict ovoid,
+             const dt_iop_roi_t *const roi_in,
+             const dt_iop_roi_t *const roi_out)
+{
+  const gboolean fastmode = dt_pipe_is_fast(piece->pipe);
+
+  const dt_iop_diffuse_data_t *const data = piece->data;
+
+  const size_t width = roi_out->width;
+  const size_t height = roi_out->height;
+
+  // allow fast mode, just copy input to output
+  if(fastmode)
+  {
+    const size_t ch = piece->colors;
+    dt_iop_copy_image_roi(ovoid, ivoid, ch, roi_in, roi_out);
+    return;
+  }
+
+  const float *const restrict in = DT_IS_ALIGNED((const float *const restrict)ivoid);
+  float *const restrict out = DT_IS_ALIGNED((float *const restrict)ovoid);
+
+  const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
+
+  const gboolean success = _use_approximation(piece, width, height)
+    ? _diffuse_approximated(piece, data, in, out, width, height, scale)
+    : _diffuse(piece, data, in, out, width, height, scale);
+
+  if(!success)
+  {
+    dt_iop_copy_image_roi(ovoid, ivoid, piece->colors, roi_in, roi_out);
+    dt_control_log(_("diffuse/sharpen failed to allocate memory, check your RAM settings"));
+  }
 }
 
 #if HAVE_OPENCL
@@ -58,6 +58,11 @@ typedef struct dt_iop_enlargecanvas_data_t
   dt_iop_canvas_color_t color;
 } dt_iop_enlargecanvas_data_t;
 
+typedef struct dt_iop_enlargecanvas_global_data_t
+{
+  int kernel_borders_fill;
+} dt_iop_enlargecanvas_global_data_t;
+
 typedef struct dt_iop_enlargecanvas_gui_data_t
 {
   GtkWidget *percent_left;
@@ -330,12 +335,10 @@ void distort_mask(dt_iop_module_t *self,
   }
 }
 
-void process(dt_iop_module_t *self,
-             dt_dev_pixelpipe_iop_t *piece,
-             const void *const ivoid,
-             void *const ovoid,
-             const dt_iop_roi_t *const roi_in,
-             const dt_iop_roi_t *const roi_out)
+static void _setup_binfo(dt_dev_pixelpipe_iop_t *piece,
+                         const dt_iop_roi_t *const roi_in,
+                         const dt_iop_roi_t *const roi_out,
+                         dt_iop_border_positions_t *binfo)
 {
   const dt_iop_enlargecanvas_data_t *const d = piece->data;
 
@@ -382,19 +385,71 @@ void process(dt_iop_module_t *self,
         break;
   }
 
-  dt_iop_border_positions_t binfo;
-
   dt_iop_setup_binfo(piece, roi_in, roi_out, pos_v, pos_h,
-                     bcolor, fcolor, 0.f, 0.f, &binfo);
+                     bcolor, fcolor, 0.f, 0.f, binfo);
 
-  binfo.border_in_x = CLAMP(binfo.border_in_x, 0, roi_out->width - roi_in->width);
-  binfo.border_in_y = CLAMP(binfo.border_in_y, 0, roi_out->height - roi_in->height);
+  binfo->border_in_x = CLAMP(binfo->border_in_x, 0, roi_out->width - roi_in->width);
+  binfo->border_in_y = CLAMP(binfo->border_in_y, 0, roi_out->height - roi_in->height);
+}
+
+void process(dt_iop_module_t *self,
+             dt_dev_pixelpipe_iop_t *piece,
+             const void *const ivoid,
+             void *const ovoid,
+             const dt_iop_roi_t *const roi_in,
+             const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_border_positions_t binfo;
+  _setup_binfo(piece, roi_in, roi_out, &binfo);
 
   dt_iop_copy_image_with_border((float*)ovoid, (const float*)ivoid, &binfo);
 }
 
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_enlargecanvas_global_data_t *const gd = self->global_data;
+  const int devid = piece->pipe->devid;
+
+  dt_iop_border_positions_t binfo;
+  _setup_binfo(piece, roi_in, roi_out, &binfo);
+
+  // there is no frame line, the canvas is the border color except for the image
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const float col[4] = { binfo.bcolor[0], binfo.bcolor[1], binfo.bcolor[2], binfo.bcolor[3] };
+  cl_int err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_borders_fill, width, height,
+                                                CLARG(dev_out), CLARGINT(0), CLARGINT(0),
+                                                CLARG(width), CLARG(height), CLARG(col));
+  if(err != CL_SUCCESS) return err;
+
+  const size_t oorigin[2] = { binfo.image_left, binfo.image_top };
+  const size_t region[2] = { binfo.image_right - binfo.image_left,
+                             binfo.image_bot - binfo.image_top };
+  if(region[0] == 0 || region[1] == 0) return CL_SUCCESS;
+
+  return dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, CLIMG_ORIGIN, oorigin, region);
+}
+#endif
+
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 2; // basic.cl from programs.conf
+
+  dt_iop_enlargecanvas_global_data_t *gd = malloc(sizeof(dt_iop_enlargecanvas_global_data_t));
+  self->data = gd;
+  gd->kernel_borders_fill = dt_opencl_create_kernel(program, "borders_fill");
+}
+
 void cleanup_global(dt_iop_module_so_t *self)
 {
+  dt_iop_enlargecanvas_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_borders_fill);
   free(self->data);
   self->data = NULL;
 }
@@ -140,7 +140,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_POINTWISE;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -639,6 +639,8 @@ void commit_params(dt_iop_module_t *self,
      && self->dev->image_storage.buf_dsc.datatype == TYPE_UINT16)
   {
     d->deflicker = 1;
+    // the correction is computed from the raw histogram on every process() call
+    piece->process_pointwise = FALSE;
   }
 }
 
@@ -354,7 +354,8 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING
+         | IOP_FLAGS_POINTWISE;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -1388,6 +1389,7 @@ error:
 }
 
 
+__DT_CLONE_TARGETS__
 static inline void filmic_split_v1(const float *const restrict in,
                                    float *const restrict out,
                                    const dt_iop_order_iccprofile_info_t *const work_profile,
@@ -1433,6 +1435,7 @@ static inline void filmic_split_v1(const float *const restrict in,
 }
 
 
+__DT_CLONE_TARGETS__
 static inline void filmic_split_v2_v3(const float *const restrict in,
                                       float *const restrict out,
                                       const dt_iop_order_iccprofile_info_t *const work_profile,
@@ -1481,6 +1484,7 @@ static inline void filmic_split_v2_v3(const float *const restrict in,
 }
 
 
+__DT_CLONE_TARGETS__
 static inline void filmic_chroma_v1(const float *const restrict in, float *const restrict out,
                                     const dt_iop_order_iccprofile_info_t *const work_profile,
                                     const dt_iop_filmicrgb_data_t *const data,
@@ -1537,6 +1541,7 @@ static inline void filmic_chroma_v1(const float *const restrict in, float *const
 }
 
 
+__DT_CLONE_TARGETS__
 static inline void filmic_chroma_v2_v3(const float *const restrict in,
                                        float *const restrict out,
                                        const dt_iop_order_iccprofile_info_t *const work_profile,
@@ -1836,6 +1841,7 @@ static inline void RGB_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
   dt_vector_pow1(mapped, data->output_power, pix_out);
 }
 
+__DT_CLONE_TARGETS__
 static inline void filmic_chroma_v4(const float *const restrict in,
                                     float *const restrict out,
                                     const dt_iop_order_iccprofile_info_t *const work_profile,
@@ -1889,6 +1895,7 @@ static inline void filmic_chroma_v4(const float *const restrict in,
   dt_omploop_sfence();	// ensure that nontemporal writes complete before we attempt to read output
 }
 
+__DT_CLONE_TARGETS__
 static inline void filmic_split_v4(const float *const restrict in,
                                    float *const restrict out,
                                    const dt_iop_order_iccprofile_info_t *const work_profile,
@@ -1943,6 +1950,7 @@ static inline void filmic_split_v4(const float *const restrict in,
 }
 
 
+__DT_CLONE_TARGETS__
 static inline void filmic_v5(const float *const restrict in, float *const restrict out,
                                     const dt_iop_order_iccprofile_info_t *const work_profile,
                                     const dt_iop_order_iccprofile_info_t *const export_profile,
@@ -3099,6 +3107,10 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   d->reconstruct_grey_vs_color = (p->reconstruct_grey_vs_color / 100.0f + 1.f) / 2.f;
 
   d->enable_highlight_reconstruction = p->enable_highlight_reconstruction;
+
+  // the reconstruction diffuses clipped areas over their neighbourhood
+  if(d->enable_highlight_reconstruction)
+    piece->process_pointwise = FALSE;
 }
 
 void gui_focus(dt_iop_module_t *self, gboolean in)
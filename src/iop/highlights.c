@@ -811,6 +811,24 @@ static void process_visualize(dt_dev_pixelpipe_iop_t *piece,
   }
 }
 
+/* Segmentation and the opposed chroma estimation may work on reduced resolution,
+   this gives up some detail in the reconstruction and is a preference for
+   quality vs performance. Small inputs are always processed at full resolution.
+*/
+#define HL_REDUCED_MIN_SIZE 600
+
+static int _reduced_resolution(const dt_dev_pixelpipe_t *pipe,
+                               const dt_iop_roi_t *const roi_in)
+{
+  if(MIN(roi_in->width, roi_in->height) < HL_REDUCED_MIN_SIZE) return 1;
+
+  const char *pref = dt_conf_get_string_const("plugins/darkroom/highlights/reduced_resolution");
+  const gboolean reduce = !g_strcmp0(pref, "always")
+    || (!g_strcmp0(pref, "previews")
+        && (dt_pipe_is_preview(pipe) || dt_pipe_is_preview2(pipe) || dt_pipe_is_thumb(pipe)));
+  return reduce ? 2 : 1;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -885,6 +903,7 @@ void process(dt_iop_module_t *self,
   }
 
   const float clipper = d->clip * highlights_clip_magics[dmode];
+  const int ds = _reduced_resolution(pipe, roi_in);
 
   if(filters == 0)
   {
@@ -896,7 +915,7 @@ void process(dt_iop_module_t *self,
     }
     else
     {
-      _process_linear_opposed(self, piece, ivoid, out, roi_in, high_quality);
+      _process_linear_opposed(self, piece, ivoid, out, roi_in, high_quality, ds);
       dt_iop_clip_and_zoom_roi((float *)ovoid, out, roi_out, roi_in);
       dt_free_align(out);
     }
@@ -965,9 +984,11 @@ void process(dt_iop_module_t *self,
     {
       const dt_highlights_mask_t vmode = ((g != NULL) && fullpipe && (g->hlr_mask_mode != DT_HIGHLIGHTS_MASK_CLIPPED)) ? g->hlr_mask_mode : DT_HIGHLIGHTS_MASK_OFF;
 
-      float *tmp = _process_opposed(self, piece, ivoid, ovoid, roi_in, roi_out, TRUE, TRUE, clipper);
+      // the mask visualisation is always shown at full resolution
+      const int seg_ds = vmode == DT_HIGHLIGHTS_MASK_OFF ? ds : 1;
+      float *tmp = _process_opposed(self, piece, ivoid, ovoid, roi_in, roi_out, TRUE, TRUE, clipper, seg_ds);
       if(tmp)
-        _process_segmentation(piece, ivoid, ovoid, roi_in, roi_out, d, vmode, tmp);
+        _process_segmentation(piece, ivoid, ovoid, roi_in, roi_out, d, vmode, seg_ds, tmp);
       dt_free_align(tmp);
       break;
     }
@@ -989,7 +1010,7 @@ void process(dt_iop_module_t *self,
 
     default:
     {
-      _process_opposed(self, piece, ivoid, ovoid, roi_in, roi_out, FALSE, high_quality, clipper);
+      _process_opposed(self, piece, ivoid, ovoid, roi_in, roi_out, FALSE, high_quality, clipper, ds);
       break;
     }
   }
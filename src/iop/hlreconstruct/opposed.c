@@ -59,6 +59,13 @@ static inline size_t _raw_to_cmap(const size_t width, const size_t row, const si
   return (row / 3) * width + (col / 3);
 }
 
+// The chrominance is a mean over the photosites around clipped data, with reduced
+// resolution only the superpixels on a grid of ds are taken into account.
+static inline gboolean _cmap_sampled(const size_t row, const size_t col, const int ds)
+{
+  return ds == 1 || ((row / 3) % ds == 0 && (col / 3) % ds == 0);
+}
+
 static inline char _mask_dilated(const char *in, const size_t w1)
 {
   if(in[0])
@@ -85,7 +92,8 @@ static void _process_linear_opposed(dt_iop_module_t *self,
                                     const float *const input,
                                     float *const output,
                                     const dt_iop_roi_t *const roi_in,
-                                    const gboolean quality)
+                                    const gboolean quality,
+                                    const int ds)
 {
   dt_iop_highlights_data_t *d = piece->data;
   const float clipval = highlights_clip_magics[DT_IOP_HIGHLIGHTS_OPPOSED] * d->clip;
@@ -169,7 +177,9 @@ static void _process_linear_opposed(dt_iop_module_t *self,
             for_three_channels(c)
             {
               const float inval = input[idx+c];
-              if((inval > 0.2f * clips[c]) && (inval < clips[c]) && (mask[(c+3) * msize + _raw_to_cmap(mwidth, row, col)]))
+              if((inval > 0.2f * clips[c]) && (inval < clips[c])
+                 && _cmap_sampled(row, col, ds)
+                 && (mask[(c+3) * msize + _raw_to_cmap(mwidth, row, col)]))
               {
                 sums[c] += inval - _calc_linear_refavg(&input[idx], c);
                 cnts[c] += 1.0f;
@@ -178,7 +188,7 @@ static void _process_linear_opposed(dt_iop_module_t *self,
           }
         }
         for_three_channels(c)
-          chrominance[c] = (cnts[c] > 30.0f) ? sums[c] / cnts[c] : 0.0f;
+          chrominance[c] = (cnts[c] > 30.0f / sqrf(ds)) ? sums[c] / cnts[c] : 0.0f;
 
         if(piece->pipe->type == DT_DEV_PIXELPIPE_FULL)
         {
@@ -222,7 +232,8 @@ static float *_process_opposed(dt_iop_module_t *self,
                                const dt_iop_roi_t *const roi_out,
                                const gboolean keep,
                                const gboolean quality,
-                               const float clipval)
+                               const float clipval,
+                               const int ds)
 {
   const uint8_t(*const xtrans)[6] = (const uint8_t(*const)[6])piece->xtrans;
   const uint32_t filters = piece->filters;
@@ -325,6 +336,7 @@ static float *_process_opposed(dt_iop_module_t *self,
 
             /* we only use the unclipped photosites very close the true clipped data to calculate the chrominance offset */
             if((inval < clips[color]) && (inval > lo_clips[color])
+               && _cmap_sampled(row, col, ds)
                && (mask[(color+3) * msize + _raw_to_cmap(mwidth, row, col)]))
             {
               sums[color] += inval - _calc_refavg(input, xtrans, filters, row, col, roi_in, correction, TRUE);
@@ -333,7 +345,7 @@ static float *_process_opposed(dt_iop_module_t *self,
           }
         }
         for_three_channels(c)
-          chrominance[c] = (cnts[c] > 100.0f) ? sums[c] / cnts[c] : 0.0f;
+          chrominance[c] = (cnts[c] > 100.0f / sqrf(ds)) ? sums[c] / cnts[c] : 0.0f;
       }
 
       if(piece->pipe->type == DT_DEV_PIXELPIPE_FULL)
@@ -411,9 +411,36 @@ static void _add_poisson_noise(float *lum,
   }
 }
 
-static inline size_t _raw_to_plane(const int width, const int row, const int col)
+static inline size_t _raw_to_plane(const int width, const int row, const int col, const int step)
 {
-  return (HL_BORDER + (row / 3)) * width + (col / 3) + HL_BORDER;
+  return (HL_BORDER + (row / step)) * width + (col / step) + HL_BORDER;
+}
+
+// bilinear sample of a plane at a raw location. As the plane locations are
+// the centres of step x step photosite blocks this is used to upsample
+// the correction of reduced resolution planes without blocking.
+static inline float _plane_sample(const float *plane,
+                                  const int width,
+                                  const int row,
+                                  const int col,
+                                  const int step,
+                                  const int xoffset)
+{
+  const float fy = fmaxf(0.0f, ((float)row - 0.5f * (step - 1)) / step);
+  const float fx = fmaxf(0.0f, ((float)(col - xoffset) - 0.5f * (step - 1)) / step);
+  const int y = (int)fy;
+  const int x = (int)fx;
+  const float dy = fy - y;
+  const float dx = fx - x;
+  const size_t o = (size_t)(HL_BORDER + y) * width + x + HL_BORDER;
+  return (1.0f - dy) * ((1.0f - dx) * plane[o] + dx * plane[o + 1])
+        + dy * ((1.0f - dx) * plane[o + width] + dx * plane[o + width + 1]);
+}
+
+// radius of a morphological operation in a plane reduced by ds
+static inline int _reduced_radius(const int radius, const int ds)
+{
+  return radius > 0 ? MAX(1, radius / ds) : 0;
 }
 
 static void _masks_extend_border(float *const mask,
@@ -453,6 +480,7 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
                                   const dt_iop_roi_t *const roi_out,
                                   dt_iop_highlights_data_t *d,
                                   const int vmode,
+                                  const int ds,
                                   float *tmpout)
 {
   const uint8_t(*const xtrans)[6] = (const uint8_t(*const)[6])piece->xtrans;
@@ -474,11 +502,13 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   const float strength = d->strength;
 
   const int recovery_closing[NUM_RECOVERY_MODES] = { 0, 0, 0, 2, 2, 0, 2};
-  const int recovery_close = recovery_closing[recovery_mode];
+  const int recovery_close = _reduced_radius(recovery_closing[recovery_mode], ds);
   const int segmentation_limit = (piece->pipe->iwidth * piece->pipe->iheight) * sqrf(piece->pipe->iscale) / 4000; // 250 segments per mpix
 
-  const size_t pwidth  = dt_round_size(roi_in->width / 3, 2) + 2 * HL_BORDER;
-  const size_t pheight = dt_round_size(roi_in->height / 3, 2) + 2 * HL_BORDER;
+  // each plane location holds the means of a step x step photosite block
+  const int step = 3 * ds;
+  const size_t pwidth  = dt_round_size(roi_in->width / step, 2) + 2 * HL_BORDER;
+  const size_t pheight = dt_round_size(roi_in->height / step, 2) + 2 * HL_BORDER;
   const size_t p_size =  dt_round_size((size_t) pwidth * pheight, 64);
 
   float *fbuffer = dt_alloc_align_float(HL_FLOAT_PLANES * p_size);
@@ -518,51 +548,50 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   int32_t anyclipped = 0;
   gboolean has_allclipped = FALSE;
   DT_OMP_FOR(reduction( | : has_allclipped) reduction( + : anyclipped) collapse(2))
-  for(int row = 1; row < roi_in->height - 1; row++)
+  for(int prow = 0; prow < roi_in->height / step; prow++)
   {
-    for(int col = 1; col < roi_in->width - 1; col++)
+    for(int pcol = 0; pcol < (roi_in->width - xshifter + 1) / step; pcol++)
     {
-      // calc all color planes in a 3x3 area. For chroma noise stability in bayer sensors we make sure
-      // to align the box with a green photosite in centre so we always have a 5:2:2 ratio
-      if((col % 3 == xshifter) && (row % 3 == 1))
+      // calc all color planes in a block of photosites. For chroma noise stability in bayer sensors we make sure
+      // to align the block with a green photosite in centre so we always have a 5:2:2 ratio in a 3x3 block
+      const int row0 = prow * step;
+      const int col0 = pcol * step + xshifter - 1;
+      dt_aligned_pixel_t mean = { 0.0f, 0.0f, 0.0f, 0.0f };
+      dt_aligned_pixel_t cnt = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(int dy = row0; dy < row0 + step; dy++)
       {
-        dt_aligned_pixel_t mean = { 0.0f, 0.0f, 0.0f, 0.0f };
-        dt_aligned_pixel_t cnt = { 0.0f, 0.0f, 0.0f, 0.0f };
-        for(int dy = row - 1; dy < row + 2; dy++)
+        for(int dx = col0; dx < col0 + step; dx++)
         {
-          for(int dx = col -1; dx < col + 2; dx++)
-          {
-            const size_t idx = (size_t)dy * roi_in->width + dx;
-            const float val = tmpout[idx];
-            const int c = fcol(dy, dx, filters, xtrans);
-            mean[c] += val;
-            cnt[c] += 1.0f;
-          }
+          const size_t idx = (size_t)dy * roi_in->width + dx;
+          const float val = tmpout[idx];
+          const int c = fcol(dy, dx, filters, xtrans);
+          mean[c] += val;
+          cnt[c] += 1.0f;
         }
+      }
 
-        for_each_channel(c)
-          mean[c] = (cnt[c] > 0.0f) ? cbrtf(correction[c] * mean[c] / cnt[c]) : 0.0f;
-        const dt_aligned_pixel_t cube_refavg = { 0.5f * (mean[1] + mean[2]),
-                                                 0.5f * (mean[0] + mean[2]),
-                                                 0.5f * (mean[0] + mean[1]),
-                                                 0.0f};
+      for_each_channel(c)
+        mean[c] = (cnt[c] > 0.0f) ? cbrtf(correction[c] * mean[c] / cnt[c]) : 0.0f;
+      const dt_aligned_pixel_t cube_refavg = { 0.5f * (mean[1] + mean[2]),
+                                               0.5f * (mean[0] + mean[2]),
+                                               0.5f * (mean[0] + mean[1]),
+                                               0.0f};
 
-        const size_t o = _raw_to_plane(pwidth, row, col);
-        int allclipped = 0;
-        for_three_channels(c)
+      const size_t o = (size_t)(HL_BORDER + prow) * pwidth + pcol + HL_BORDER;
+      int allclipped = 0;
+      for_three_channels(c)
+      {
+        plane[c][o] = mean[c];
+        refavg[c][o] = cube_refavg[c];
+        if(mean[c] > cube_coeffs[c])
         {
-          plane[c][o] = mean[c];
-          refavg[c][o] = cube_refavg[c];
-          if(mean[c] > cube_coeffs[c])
-          {
-            allclipped += 1;
-            isegments[c].data[o] = 1;
-          }
+          allclipped += 1;
+          isegments[c].data[o] = 1;
         }
-        isegments[3].data[o] = (allclipped == 3) ? 1 : 0;
-        has_allclipped |= (allclipped == 3) ? TRUE : FALSE;
-        anyclipped += allclipped;
       }
+      isegments[3].data[o] = (allclipped == 3) ? 1 : 0;
+      has_allclipped |= (allclipped == 3) ? TRUE : FALSE;
+      anyclipped += allclipped;
     }
   }
 
@@ -573,7 +602,7 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
     _masks_extend_border(plane[i], pwidth, pheight, HL_BORDER);
 
   for(int p = 0; p < HL_RGB_PLANES; p++)
-    dt_segments_combine(&isegments[p], d->combine);
+    dt_segments_combine(&isegments[p], _reduced_radius(d->combine, ds));
 
   if(dt_get_num_threads() >= HL_RGB_PLANES)
   {
@@ -601,7 +630,7 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
       const int color = fcol(row, col, filters, xtrans);
       if(inval > clips[color])
       {
-        const size_t o = _raw_to_plane(pwidth, row, col);
+        const size_t o = _raw_to_plane(pwidth, row, col, step);
         const uint32_t pid = _get_segment_id(&isegments[color], o);
         if((pid > 1) && (pid < isegments[color].nr))
         {
@@ -651,7 +680,11 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
 
   if(do_recovery)
   {
-    const float max_distance = dt_image_distance_transform(NULL, distance, pwidth, pheight, 1.0f, DT_DISTANCE_TRANSFORM_NONE);
+    // the navigation preview can do with approximate distances
+    const gboolean preview = piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW;
+    const float max_distance =
+      dt_image_distance_transform_approx(NULL, distance, pwidth, pheight, 1.0f,
+                                         DT_DISTANCE_TRANSFORM_NONE, preview ? 2 : 1);
     if(max_distance > 3.0f)
     {
       dt_segmentize_plane(segall);
@@ -691,9 +724,11 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
           const float ival = fmaxf(0.0f, input[idx]);
           if(ival > clips[color])
           {
-            const size_t o = _raw_to_plane(pwidth, row, col);
-            const float effect = strength / (1.0f + expf(-(distance[o] - dshift)));
-            tmpout[idx]+= fmaxf(0.0f, gradient[o] * effect);
+            const size_t o = _raw_to_plane(pwidth, row, col, step);
+            const float dist = ds > 1 ? _plane_sample(distance, pwidth, row, col, step, xshifter - 1) : distance[o];
+            const float grad = ds > 1 ? _plane_sample(gradient, pwidth, row, col, step, xshifter - 1) : gradient[o];
+            const float effect = strength / (1.0f + expf(-(dist - dshift)));
+            tmpout[idx]+= fmaxf(0.0f, grad * effect);
           }
         }
       }
@@ -711,7 +746,7 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
 
       if((inrow >= 0) && (inrow < roi_in->height) && (incol >= 0) && (incol < roi_in->width))
       {
-        const size_t ppos = _raw_to_plane(pwidth, inrow, incol);
+        const size_t ppos = _raw_to_plane(pwidth, inrow, incol, step);
         const size_t idx = (size_t)inrow * roi_in->width + incol;
 
         output[odx] = do_masking ? fminf(0.2f, 0.2f * luminance[ppos]) : tmpout[idx];
@@ -744,9 +779,9 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
     }
   }
 
-  dt_print(DT_DEBUG_PERF, "[segmentation report %-12s] %5.1fMpix, segments: %3i red, %3i green, %3i blue, %3i all, %4i allowed",
+  dt_print(DT_DEBUG_PERF, "[segmentation report %-12s] %5.1fMpix 1/%i, segments: %3i red, %3i green, %3i blue, %3i all, %4i allowed",
       dt_dev_pixelpipe_type_to_str(piece->pipe->type),
-      (float) (roi_in->width * roi_in->height) / 1.0e6f, isegments[0].nr -2, isegments[1].nr-2, isegments[2].nr-2, isegments[3].nr-2,
+      (float) (roi_in->width * roi_in->height) / 1.0e6f, step, isegments[0].nr -2, isegments[1].nr-2, isegments[2].nr-2, isegments[3].nr-2,
       segmentation_limit-2);
 
   finish:
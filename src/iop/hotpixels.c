@@ -60,6 +60,11 @@ typedef struct dt_iop_hotpixels_data_t
   gboolean pure_monochrome;
 } dt_iop_hotpixels_data_t;
 
+typedef struct dt_iop_hotpixels_global_data_t
+{
+  int kernel_hotpixels_1f;
+} dt_iop_hotpixels_global_data_t;
+
 
 const char *name()
 {
@@ -355,6 +360,114 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   }
 }
 
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_hotpixels_data_t *data = piece->data;
+  const dt_iop_hotpixels_global_data_t *gd = self->global_data;
+
+  // marking writes the neighbours of fixed pixels and the 4 channel
+  // monochrome raws are rare, leave both to the cpu
+  if(data->markfixed || data->pure_monochrome)
+    return DT_OPENCL_PROCESS_CL;
+
+  const int devid = piece->pipe->devid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const int min_neighbours = data->permissive ? 3 : 4;
+
+  // the four nearest sites of the same color for each site of the sensor
+  // period, the same search as the cpu code
+  int offsets[6][6][4][2];
+  int border = 2;
+  if(data->monochrome)
+  {
+    border = 1;
+    const int direct[4][2] = { { -1, 0 }, { 0, -1 }, { 1, 0 }, { 0, 1 } };
+    for(int j = 0; j < 6; j++)
+      for(int i = 0; i < 6; i++)
+        memcpy(offsets[j][i], direct, sizeof(direct));
+  }
+  else if(piece->pipe->dsc.filters == 9u)
+  {
+    const int search[20][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 },
+                                { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 },
+                                { -2, 0 }, { 2, 0 }, { 0, -2 }, { 0, 2 },
+                                { -2, -1 }, { -2, 1 }, { 2, -1 }, { 2, 1 },
+                                { -1, -2 }, { 1, -2 }, { -1, 2 }, { 1, 2 } };
+    for(int j = 0; j < 6; j++)
+      for(int i = 0; i < 6; i++)
+      {
+        const uint8_t c = FCNxtrans(j, i, piece->xtrans);
+        for(int k = 0, found = 0; k < 20 && found < 4; k++)
+          if(c == FCNxtrans(j + search[k][1], i + search[k][0], piece->xtrans))
+          {
+            offsets[j][i][found][0] = search[k][0];
+            offsets[j][i][found][1] = search[k][1];
+            found++;
+          }
+      }
+  }
+  else
+  {
+    const int direct[4][2] = { { -2, 0 }, { 0, -2 }, { 2, 0 }, { 0, 2 } };
+    for(int j = 0; j < 6; j++)
+      for(int i = 0; i < 6; i++)
+        memcpy(offsets[j][i], direct, sizeof(direct));
+  }
+
+  cl_int err = DT_OPENCL_DEFAULT_ERROR;
+  cl_mem dev_fixed = NULL;
+  cl_mem dev_offsets = dt_opencl_copy_host_to_device_constant(devid, sizeof(offsets), offsets);
+  if(dev_offsets == NULL) goto finish;
+
+  int fixed = 0;
+  dev_fixed = dt_opencl_alloc_device_buffer(devid, sizeof(int));
+  if(dev_fixed == NULL) goto finish;
+  err = dt_opencl_write_buffer_to_device(devid, &fixed, dev_fixed, 0, sizeof(int), TRUE);
+  if(err != CL_SUCCESS) goto finish;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_hotpixels_1f, width, height,
+    CLARG(dev_in), CLARG(dev_out), CLARG(width), CLARG(height), CLARG(border),
+    CLARG(data->threshold), CLARG(data->multiplier), CLARG(min_neighbours),
+    CLARG(dev_offsets), CLARG(dev_fixed));
+  if(err != CL_SUCCESS) goto finish;
+
+  dt_iop_hotpixels_gui_data_t *g = self->gui_data;
+  if(g && self->dev->gui_attached && dt_pipe_is_full(piece->pipe))
+  {
+    err = dt_opencl_read_buffer_from_device(devid, &fixed, dev_fixed, 0, sizeof(int), TRUE);
+    if(err == CL_SUCCESS) g->pixels_fixed = fixed;
+  }
+
+finish:
+  dt_opencl_release_mem_object(dev_offsets);
+  dt_opencl_release_mem_object(dev_fixed);
+  return err;
+}
+#endif
+
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 2; // basic.cl, from programs.conf
+  dt_iop_hotpixels_global_data_t *gd = malloc(sizeof(dt_iop_hotpixels_global_data_t));
+  self->data = gd;
+  gd->kernel_hotpixels_1f = dt_opencl_create_kernel(program, "hotpixels_1f");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_hotpixels_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_hotpixels_1f);
+  free(self->data);
+  self->data = NULL;
+}
+
 void reload_defaults(dt_iop_module_t *self)
 {
   const dt_image_t *img = &self->dev->image_storage;
@@ -194,6 +194,18 @@ typedef struct dt_iop_lens_gui_data_t
 } dt_iop_lens_gui_data_t;
 
 
+// Lensfun results sampled every LF_GRID_STEP pixels, shared by all
+// pipes. Coordinates have 6 channels, vignetting gains 3.
+typedef struct dt_iop_lens_grid_t
+{
+  dt_hash_t hash;
+  int refs; // the cache and the users, protected by grid_lock
+  int x, y; // position of the first node
+  int width, height; // in nodes
+  int channels;
+  float *data;
+} dt_iop_lens_grid_t;
+
 typedef struct dt_iop_lens_global_data_t
 {
   int kernel_lens_distort_bilinear;
@@ -205,6 +217,8 @@ typedef struct dt_iop_lens_global_data_t
   int kernel_md_vignette;
   int kernel_md_correct;
   lfDatabase *db;
+  dt_pthread_mutex_t grid_lock;
+  GList *grids; // of dt_iop_lens_grid_t, most recently used first
 } dt_iop_lens_global_data_t;
 
 typedef struct dt_iop_lens_data_t
@@ -997,6 +1011,236 @@ static lfModifier * _get_modifier(int *mods_done,
   return mod;
 }
 
+/* Sampled Lensfun results.
+
+   The coordinate and vignetting corrections are smooth, so they are
+   evaluated on a coarse grid and interpolated bilinearly. The grids
+   are kept in a small global cache, keyed by everything that makes up
+   the modifier and the roi, so repeated runs and exports of images
+   from the same lens skip the Lensfun evaluation.
+*/
+#define LF_GRID_STEP 8
+#define LF_GRID_CACHE_SIZE 4
+
+static dt_hash_t _grid_hash(const dt_iop_lens_data_t *d,
+                            const int mods_filter,
+                            const int w,
+                            const int h,
+                            const int x,
+                            const int y,
+                            const int width,
+                            const int height,
+                            const int channels)
+{
+  dt_hash_t hash = DT_INITHASH;
+  if(d->lens->Maker) hash = dt_hash(hash, d->lens->Maker, strlen(d->lens->Maker));
+  if(d->lens->Model) hash = dt_hash(hash, d->lens->Model, strlen(d->lens->Model));
+  const int ivals[] = { d->modify_flags, d->inverse, (int)d->target_geom, d->tca_override,
+                        (int)d->custom_tca.Model, mods_filter, w, h,
+                        x, y, width, height, channels };
+  const float fvals[] = { d->scale, d->crop, d->focal, d->aperture, d->distance };
+  hash = dt_hash(hash, ivals, sizeof(ivals));
+  hash = dt_hash(hash, fvals, sizeof(fvals));
+  return dt_hash(hash, d->custom_tca.Terms, sizeof(d->custom_tca.Terms));
+}
+
+static void _grid_unref(dt_iop_lens_grid_t *grid)
+{
+  if(--grid->refs == 0)
+  {
+    dt_free_align(grid->data);
+    free(grid);
+  }
+}
+
+static void _release_grid(dt_iop_lens_global_data_t *gd,
+                          dt_iop_lens_grid_t *grid)
+{
+  if(!grid) return;
+  dt_pthread_mutex_lock(&gd->grid_lock);
+  _grid_unref(grid);
+  dt_pthread_mutex_unlock(&gd->grid_lock);
+}
+
+// returns the grid covering width x height pixels at x, y or NULL if
+// out of memory. The grid must be handed back to _release_grid().
+static dt_iop_lens_grid_t *_get_grid(dt_iop_lens_global_data_t *gd,
+                                     const lfModifier *modifier,
+                                     const dt_hash_t hash,
+                                     const int x,
+                                     const int y,
+                                     const int width,
+                                     const int height,
+                                     const int channels)
+{
+  dt_pthread_mutex_lock(&gd->grid_lock);
+  for(GList *l = gd->grids; l; l = g_list_next(l))
+  {
+    dt_iop_lens_grid_t *grid = (dt_iop_lens_grid_t *)l->data;
+    if(grid->hash == hash)
+    {
+      grid->refs++;
+      gd->grids = g_list_remove_link(gd->grids, l);
+      gd->grids = g_list_concat(l, gd->grids);
+      dt_pthread_mutex_unlock(&gd->grid_lock);
+      return grid;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->grid_lock);
+
+  dt_iop_lens_grid_t *grid = (dt_iop_lens_grid_t *)calloc(1, sizeof(dt_iop_lens_grid_t));
+  if(!grid) return NULL;
+  grid->hash = hash;
+  grid->x = x;
+  grid->y = y;
+  // the last node is at or beyond the last pixel
+  grid->width = (width - 1) / LF_GRID_STEP + 2;
+  grid->height = (height - 1) / LF_GRID_STEP + 2;
+  grid->channels = channels;
+  grid->data = dt_alloc_align_float((size_t)grid->width * grid->height * channels);
+  if(!grid->data)
+  {
+    free(grid);
+    return NULL;
+  }
+
+  DT_OMP_FOR(shared(grid, modifier))
+  for(int j = 0; j < grid->height; j++)
+  {
+    float *node = grid->data + (size_t)j * grid->width * channels;
+    for(int i = 0; i < grid->width; i++, node += channels)
+    {
+      const int px = x + i * LF_GRID_STEP;
+      const int py = y + j * LF_GRID_STEP;
+      if(channels == 6)
+        modifier->ApplySubpixelGeometryDistortion(px, py, 1, 1, node);
+      else
+      {
+        node[0] = node[1] = node[2] = 1.0f;
+        modifier->ApplyColorModification(node, px, py, 1, 1,
+                                         LF_CR_3(RED, GREEN, BLUE), 3);
+      }
+    }
+  }
+
+  dt_pthread_mutex_lock(&gd->grid_lock);
+  grid->refs = 2;
+  gd->grids = g_list_prepend(gd->grids, grid);
+  while(g_list_length(gd->grids) > LF_GRID_CACHE_SIZE)
+  {
+    GList *last = g_list_last(gd->grids);
+    _grid_unref((dt_iop_lens_grid_t *)last->data);
+    gd->grids = g_list_delete_link(gd->grids, last);
+  }
+  dt_pthread_mutex_unlock(&gd->grid_lock);
+  return grid;
+}
+
+static inline void _grid_sample(const dt_iop_lens_grid_t *grid,
+                                const int px,
+                                const int py,
+                                float *out)
+{
+  const float fx = (float)(px - grid->x) / LF_GRID_STEP;
+  const float fy = (float)(py - grid->y) / LF_GRID_STEP;
+  const int i = MIN((int)fx, grid->width - 2);
+  const int j = MIN((int)fy, grid->height - 2);
+  const float wx = fx - i;
+  const float wy = fy - j;
+  const int ch = grid->channels;
+  const float *n00 = grid->data + ((size_t)j * grid->width + i) * ch;
+  const float *n10 = n00 + ch;
+  const float *n01 = n00 + (size_t)grid->width * ch;
+  const float *n11 = n01 + ch;
+  for(int c = 0; c < ch; c++)
+  {
+    const float top = n00[c] + wx * (n10[c] - n00[c]);
+    const float bottom = n01[c] + wx * (n11[c] - n01[c]);
+    out[c] = top + wy * (bottom - top);
+  }
+}
+
+// distorted coordinates of a row of pixels, from the grid if there is one
+static inline void _lf_coords_row(const lfModifier *modifier,
+                                  const dt_iop_lens_grid_t *grid,
+                                  const int x,
+                                  const int y,
+                                  const int width,
+                                  float *out)
+{
+  if(grid)
+  {
+    for(int k = 0; k < width; k++)
+      _grid_sample(grid, x + k, y, out + 6 * k);
+  }
+  else
+    modifier->ApplySubpixelGeometryDistortion(x, y, width, 1, out);
+}
+
+// vignetting correction of a row of pixels, from the grid if there is one
+static inline void _lf_vignette_row(const lfModifier *modifier,
+                                    const dt_iop_lens_grid_t *grid,
+                                    float *buf,
+                                    const int x,
+                                    const int y,
+                                    const int width,
+                                    const unsigned int pixelformat,
+                                    const int ch)
+{
+  if(grid)
+  {
+    for(int k = 0; k < width; k++)
+    {
+      float gain[3];
+      _grid_sample(grid, x + k, y, gain);
+      for(int c = 0; c < 3; c++)
+        buf[ch * k + c] *= gain[c];
+    }
+  }
+  else
+    // actually this way row stride does not matter.
+    modifier->ApplyColorModification(buf, x, y, width, 1, pixelformat, ch * width);
+}
+
+static void _get_lf_grids(dt_iop_lens_global_data_t *gd,
+                          const dt_iop_lens_data_t *d,
+                          const lfModifier *modifier,
+                          const int modflags,
+                          const int mods_filter,
+                          const int w,
+                          const int h,
+                          const gboolean pass_mode,
+                          const dt_iop_roi_t *const roi_in,
+                          const dt_iop_roi_t *const roi_out,
+                          dt_iop_lens_grid_t **coords,
+                          dt_iop_lens_grid_t **vignette)
+{
+  *coords = *vignette = NULL;
+
+  // interpolating across NaN coordinates would grow the invalid border
+  if(!d->do_nan_checks
+     && (modflags & (LF_MODIFY_TCA
+                     | LF_MODIFY_DISTORTION
+                     | LF_MODIFY_GEOMETRY
+                     | LF_MODIFY_SCALE)))
+  {
+    const dt_hash_t hash = _grid_hash(d, mods_filter, w, h, roi_out->x, roi_out->y,
+                                      roi_out->width, roi_out->height, 6);
+    *coords = _get_grid(gd, modifier, hash, roi_out->x, roi_out->y,
+                        roi_out->width, roi_out->height, 6);
+  }
+
+  if(!pass_mode && (modflags & LF_MODIFY_VIGNETTING))
+  {
+    // vignetting is corrected on the output when rendering, on the input otherwise
+    const dt_iop_roi_t *roi = d->inverse ? roi_out : roi_in;
+    const dt_hash_t hash = _grid_hash(d, mods_filter, w, h, roi->x, roi->y,
+                                      roi->width, roi->height, 3);
+    *vignette = _get_grid(gd, modifier, hash, roi->x, roi->y,
+                          roi->width, roi->height, 3);
+  }
+}
+
 static float _get_autoscale_lf(dt_iop_module_t *self,
                                dt_iop_lens_params_t *p,
                                const lfCamera *camera)
@@ -1084,6 +1328,11 @@ static void _process_lf(dt_iop_module_t *self,
 
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  dt_iop_lens_grid_t *cgrid, *vgrid;
+  _get_lf_grids(gd, d, modifier, modflags, used_lf_mask, orig_w, orig_h,
+                pass_mode, roi_in, roi_out, &cgrid, &vgrid);
+
   const dt_interpolation_t *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
   if(d->inverse)
@@ -1100,12 +1349,12 @@ static void _process_lf(dt_iop_module_t *self,
       size_t padded_bufsize;
       float *const buf = dt_alloc_perthread_float(bufsize, &padded_bufsize);
 
-      DT_OMP_FOR(dt_omp_sharedconst(buf) shared(modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(buf) shared(modifier, cgrid))
       for(int y = 0; y < roi_out->height; y++)
       {
         float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                                  roi_out->width, 1, bufptr);
+        _lf_coords_row(modifier, cgrid, roi_out->x, roi_out->y + y,
+                       roi_out->width, bufptr);
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -1166,15 +1415,13 @@ static void _process_lf(dt_iop_module_t *self,
 
     if(!pass_mode && (modflags & LF_MODIFY_VIGNETTING))
     {
-      DT_OMP_FOR(shared(modifier))
+      DT_OMP_FOR(shared(modifier, vgrid))
       for(int y = 0; y < roi_out->height; y++)
       {
         /* Colour correction: vignetting */
-        // actually this way row stride does not matter.
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
-        modifier->ApplyColorModification(out, roi_out->x, roi_out->y + y,
-                                         roi_out->width, 1,
-                                         pixelformat, ch * roi_out->width);
+        _lf_vignette_row(modifier, vgrid, out, roi_out->x, roi_out->y + y,
+                         roi_out->width, pixelformat, ch);
       }
     }
   }
@@ -1188,15 +1435,13 @@ static void _process_lf(dt_iop_module_t *self,
 
     if(!pass_mode && (modflags & LF_MODIFY_VIGNETTING))
     {
-      DT_OMP_FOR(shared(buf, modifier))
+      DT_OMP_FOR(shared(buf, modifier, vgrid))
       for(int y = 0; y < roi_in->height; y++)
       {
         /* Colour correction: vignetting */
-        // actually this way row stride does not matter.
         float *bufptr = ((float *)buf) + (size_t)ch * roi_in->width * y;
-        modifier->ApplyColorModification(bufptr, roi_in->x, roi_in->y + y,
-                                         roi_in->width, 1,
-                                         pixelformat, ch * roi_in->width);
+        _lf_vignette_row(modifier, vgrid, bufptr, roi_in->x, roi_in->y + y,
+                         roi_in->width, pixelformat, ch);
       }
     }
 
@@ -1210,14 +1455,12 @@ static void _process_lf(dt_iop_module_t *self,
       size_t padded_buf2size;
       float *const buf2 = dt_alloc_perthread_float(buf2size, &padded_buf2size);
 
-      DT_OMP_FOR(dt_omp_sharedconst(buf2) shared(buf, modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(buf2) shared(buf, modifier, cgrid))
       for(int y = 0; y < roi_out->height; y++)
       {
         float *buf2ptr = (float*)dt_get_perthread(buf2, padded_buf2size);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width,
-                                                  1, buf2ptr);
+        _lf_coords_row(modifier, cgrid, roi_out->x, roi_out->y + y,
+                       roi_out->width, buf2ptr);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -1275,6 +1518,8 @@ static void _process_lf(dt_iop_module_t *self,
     }
     dt_free_align(buf);
   }
+  _release_grid(gd, cgrid);
+  _release_grid(gd, vgrid);
   delete modifier;
 }
 
@@ -1300,6 +1545,8 @@ static int _process_cl_lf(dt_iop_module_t *self,
 
   float *tmpbuf = NULL;
   lfModifier *modifier = NULL;
+  dt_iop_lens_grid_t *cgrid = NULL;
+  dt_iop_lens_grid_t *vgrid = NULL;
 
   const int devid = piece->pipe->devid;
   const int iwidth = roi_in->width;
@@ -1368,6 +1615,9 @@ static int _process_cl_lf(dt_iop_module_t *self,
   modifier = _get_modifier(&modflags, orig_w, orig_h, d, used_lf_mask, FALSE);
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
+  _get_lf_grids(gd, d, modifier, modflags, used_lf_mask, orig_w, orig_h,
+                pass_mode, roi_in, roi_out, &cgrid, &vgrid);
+
   if(d->inverse)
   {
     // reverse direction (useful for renderings)
@@ -1376,13 +1626,12 @@ static int _process_cl_lf(dt_iop_module_t *self,
                    | LF_MODIFY_GEOMETRY
                    | LF_MODIFY_SCALE))
     {
-      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier, cgrid))
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
+        _lf_coords_row(modifier, cgrid, roi_out->x, roi_out->y + y,
+                       roi_out->width, pi);
       }
 
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
@@ -1407,17 +1656,15 @@ static int _process_cl_lf(dt_iop_module_t *self,
 
     if(!pass_mode && (modflags & LF_MODIFY_VIGNETTING))
     {
-      DT_OMP_FOR(shared(tmpbuf, modifier, d))
+      DT_OMP_FOR(shared(tmpbuf, modifier, d, vgrid))
       for(int y = 0; y < roi_out->height; y++)
       {
         /* Colour correction: vignetting */
-        // actually this way row stride does not matter.
         float *buf = tmpbuf + (size_t)y * ch * roi_out->width;
         for(int k = 0; k < ch * roi_out->width; k++)
           buf[k] = 0.5f;
-        modifier->ApplyColorModification(buf, roi_out->x, roi_out->y + y,
-                                         roi_out->width, 1,
-                                         pixelformat, ch * roi_out->width);
+        _lf_vignette_row(modifier, vgrid, buf, roi_out->x, roi_out->y + y,
+                         roi_out->width, pixelformat, ch);
       }
 
       const size_t bsize =
@@ -1446,19 +1693,14 @@ static int _process_cl_lf(dt_iop_module_t *self,
   {
     if(!pass_mode && (modflags & LF_MODIFY_VIGNETTING))
     {
-      DT_OMP_FOR(shared(tmpbuf, modifier, d))
+      DT_OMP_FOR(shared(tmpbuf, modifier, d, vgrid))
       for(int y = 0; y < roi_in->height; y++)
       {
         /* Colour correction: vignetting */
-        // actually this way row stride does not matter.
         float *buf = tmpbuf + (size_t)y * ch * roi_in->width;
         for(int k = 0; k < ch * roi_in->width; k++) buf[k] = 0.5f;
-        modifier->ApplyColorModification(buf,
-                                         roi_in->x,
-                                         roi_in->y + y,
-                                         roi_in->width, 1,
-                                         pixelformat,
-                                         ch * roi_in->width);
+        _lf_vignette_row(modifier, vgrid, buf, roi_in->x, roi_in->y + y,
+                         roi_in->width, pixelformat, ch);
       }
 
       const size_t bsize =
@@ -1487,13 +1729,12 @@ static int _process_cl_lf(dt_iop_module_t *self,
                    | LF_MODIFY_GEOMETRY
                    | LF_MODIFY_SCALE))
     {
-      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier, cgrid))
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
+        _lf_coords_row(modifier, cgrid, roi_out->x, roi_out->y + y,
+                       roi_out->width, pi);
       }
 
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
@@ -1520,6 +1761,8 @@ error:
   dt_opencl_release_mem_object(dev_tmp);
   dt_opencl_release_mem_object(dev_tmpbuf);
   dt_free_align(tmpbuf);
+  _release_grid(gd, cgrid);
+  _release_grid(gd, vgrid);
   if(modifier != NULL) delete modifier;
   return err;
 }
@@ -3339,6 +3582,9 @@ void init_global(dt_iop_module_so_t *self)
   gd->kernel_md_correct =
     dt_opencl_create_kernel(program, "md_lens_correction");
 
+  dt_pthread_mutex_init(&gd->grid_lock, NULL);
+  gd->grids = NULL;
+
   lfDatabase *dt_iop_lensfun_db = new lfDatabase;
   gd->db = (lfDatabase *)dt_iop_lensfun_db;
 
@@ -3579,6 +3825,11 @@ void cleanup_global(dt_iop_module_so_t *self)
   lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
   delete dt_iop_lensfun_db;
 
+  for(GList *l = gd->grids; l; l = g_list_next(l))
+    _grid_unref((dt_iop_lens_grid_t *)l->data);
+  g_list_free(gd->grids);
+  dt_pthread_mutex_destroy(&gd->grid_lock);
+
   dt_opencl_free_kernel(gd->kernel_lens_distort_bilinear);
   dt_opencl_free_kernel(gd->kernel_lens_distort_bicubic);
   dt_opencl_free_kernel(gd->kernel_lens_distort_lanczos2);
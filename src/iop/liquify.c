@@ -255,6 +255,29 @@ typedef struct
   dt_liquify_path_data_t nodes[MAX_NODES];
 } dt_iop_liquify_params_t;
 
+// the composited distortion map of the last run of an interactive
+// pipe. While dragging a node only the stamps of the changed part of
+// the path are taken out of and put back into the map.
+typedef struct
+{
+  gboolean valid;
+  dt_hash_t hash;                 // of the params in piece coordinates
+  float scale;
+  dt_iop_roi_t roi;
+  cairo_rectangle_int_t extent;
+  float complex *map;
+  dt_liquify_warp_t *warps;       // the stamps composited into map
+  int num_warps;
+  int updates;                    // incremental updates since the map was built
+} dt_liquify_map_cache_t;
+
+typedef struct
+{
+  dt_iop_liquify_params_t params;
+  dt_pthread_mutex_t lock;
+  dt_liquify_map_cache_t cache;
+} dt_iop_liquify_data_t;
+
 typedef struct
 {
   int warp_kernel;
@@ -916,18 +939,20 @@ static void compute_round_stamp_extent(cairo_rectangle_int_t *const restrict sta
 
 static void apply_round_stamp(const dt_liquify_warp_t *const restrict warp,
                               float complex *global_map,
-                              const cairo_rectangle_int_t *const restrict global_map_extent)
+                              const cairo_rectangle_int_t *const restrict global_map_extent,
+                              const float sign)
 {
   const size_t iradius = round(cabsf(warp->radius - warp->point));
   assert(iradius > 0);
 
   // 0.5 is factored in so the warp starts to degenerate when the
-  // strength arrow crosses the warp radius.
-  float complex strength = 0.5f * (warp->strength - warp->point);
+  // strength arrow crosses the warp radius.  A negative sign takes
+  // a stamp back out of the map.
+  float complex strength = 0.5f * sign * (warp->strength - warp->point);
   strength = (warp->status & DT_LIQUIFY_STATUS_INTERPOLATED) ?
     (strength * STAMP_RELOCATION) : strength;
   const float abs_strength
-    = cabsf(strength) * (warp->type == DT_LIQUIFY_WARP_TYPE_RADIAL_SHRINK ? -1.0f : 1.0f);
+    = sign * cabsf(strength) * (warp->type == DT_LIQUIFY_WARP_TYPE_RADIAL_SHRINK ? -1.0f : 1.0f);
 
   // lookup table: map of distance from center point => warp
   const size_t table_size = iradius * LOOKUP_OVERSAMPLE;
@@ -1115,7 +1140,7 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
   for(const GSList *i = interpolated; i; i = g_slist_next(i))
   {
     const dt_liquify_warp_t *warp = ((dt_liquify_warp_t *) i->data);
-    apply_round_stamp(warp, map, map_extent);
+    apply_round_stamp(warp, map, map_extent, 1.0f);
   }
 
   if(inverted)
@@ -1182,8 +1207,9 @@ static void _build_global_distortion_map(const dt_iop_module_t *self,
                                          float complex **map)
 {
   // copy params
+  const dt_iop_liquify_data_t *d = piece->data;
   dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, piece->data, sizeof(dt_iop_liquify_params_t));
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
 
   distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
 
@@ -1197,6 +1223,155 @@ static void _build_global_distortion_map(const dt_iop_module_t *self,
   g_list_free_full(interpolated, free);
 }
 
+// after this many incremental updates the map is rebuilt from scratch
+// so rounding errors of taking stamps out again can't accumulate
+#define MAP_CACHE_MAX_UPDATES 32
+
+static gboolean _use_map_cache(const dt_dev_pixelpipe_iop_t *piece)
+{
+  // only the interactive pipes are rerun while dragging a node
+  return (piece->pipe->type & DT_DEV_PIXELPIPE_BASIC) != 0;
+}
+
+static gboolean _same_warp(const dt_liquify_warp_t *a, const dt_liquify_warp_t *b)
+{
+  return a->point == b->point
+    && a->strength == b->strength
+    && a->radius == b->radius
+    && a->control1 == b->control1
+    && a->control2 == b->control2
+    && a->type == b->type
+    && a->status == b->status;
+}
+
+// Bring the cached map up to date with the new stamps. Editing a
+// node changes a contiguous run of the interpolated stamps, so
+// everything between the common head and tail of the old and new
+// stamps is taken out and put back in. Returns FALSE if a full
+// rebuild is cheaper or required.
+static gboolean _update_cached_map(dt_liquify_map_cache_t *c,
+                                   const dt_liquify_warp_t *warps,
+                                   const int num_warps)
+{
+  if(!c->map || c->updates >= MAP_CACHE_MAX_UPDATES) return FALSE;
+
+  const int common = MIN(c->num_warps, num_warps);
+  int head = 0;
+  while(head < common && _same_warp(&c->warps[head], &warps[head]))
+    head++;
+  int tail = 0;
+  while(tail < common - head
+        && _same_warp(&c->warps[c->num_warps - 1 - tail], &warps[num_warps - 1 - tail]))
+    tail++;
+
+  const int removed = c->num_warps - head - tail;
+  const int added = num_warps - head - tail;
+  if(removed + added == 0) return TRUE;
+  if(removed + added >= num_warps) return FALSE;
+
+  for(int k = head; k < head + removed; k++)
+    apply_round_stamp(&c->warps[k], c->map, &c->extent, -1.0f);
+  for(int k = head; k < head + added; k++)
+    apply_round_stamp(&warps[k], c->map, &c->extent, 1.0f);
+
+  c->updates++;
+  return TRUE;
+}
+
+static void _clear_map_cache(dt_liquify_map_cache_t *c)
+{
+  dt_free_align(c->map);
+  free(c->warps);
+  memset(c, 0, sizeof(dt_liquify_map_cache_t));
+}
+
+/*
+  Returns the distortion map for processing roi. For the interactive
+  pipes the map is kept in the piece and reused as long as the params
+  and the roi don't change, on a node edit only the affected stamps
+  are redone. The map must be handed back to
+  _release_global_distortion_map().
+*/
+
+static const float complex *_get_global_distortion_map(const dt_iop_module_t *self,
+                                                       dt_dev_pixelpipe_iop_t *piece,
+                                                       const float scale,
+                                                       const dt_iop_roi_t *roi,
+                                                       cairo_rectangle_int_t *map_extent)
+{
+  if(!_use_map_cache(piece))
+  {
+    float complex *map = NULL;
+    _build_global_distortion_map(self, piece, scale, roi, map_extent, FALSE, &map);
+    return map;
+  }
+
+  dt_iop_liquify_data_t *d = piece->data;
+  dt_liquify_map_cache_t *c = &d->cache;
+
+  dt_iop_liquify_params_t copy_params;
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
+  distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
+  const dt_hash_t hash = dt_hash(DT_INITHASH, &copy_params, sizeof(copy_params));
+
+  dt_pthread_mutex_lock(&d->lock);
+  const gboolean same_roi = c->valid
+    && c->scale == scale
+    && c->roi.x == roi->x && c->roi.y == roi->y
+    && c->roi.width == roi->width && c->roi.height == roi->height;
+
+  if(same_roi && c->hash == hash)
+  {
+    *map_extent = c->extent;
+    return c->map;
+  }
+
+  GList *interpolated = interpolate_paths(&copy_params);
+  GSList *interpolated_in_roi = _get_map_extent(roi, interpolated, map_extent);
+
+  const int num_warps = g_slist_length(interpolated_in_roi);
+  dt_liquify_warp_t *warps = malloc(sizeof(dt_liquify_warp_t) * MAX(1, num_warps));
+  int k = 0;
+  for(const GSList *i = interpolated_in_roi; i; i = g_slist_next(i))
+    warps[k++] = *(dt_liquify_warp_t *)i->data;
+
+  const gboolean same_extent = same_roi
+    && c->extent.x == map_extent->x && c->extent.y == map_extent->y
+    && c->extent.width == map_extent->width && c->extent.height == map_extent->height;
+
+  if(!same_extent || !_update_cached_map(c, warps, num_warps))
+  {
+    _clear_map_cache(c);
+    c->map = create_global_distortion_map(map_extent, interpolated_in_roi, FALSE);
+    c->extent = *map_extent;
+    c->scale = scale;
+    c->roi = *roi;
+    c->valid = TRUE;
+  }
+
+  free(c->warps);
+  c->warps = warps;
+  c->num_warps = num_warps;
+  c->hash = hash;
+
+  g_slist_free(interpolated_in_roi);
+  g_list_free_full(interpolated, free);
+
+  return c->map;
+}
+
+static void _release_global_distortion_map(dt_dev_pixelpipe_iop_t *piece,
+                                           const float complex *map)
+{
+  if(_use_map_cache(piece))
+  {
+    dt_iop_liquify_data_t *d = piece->data;
+    dt_pthread_mutex_unlock(&d->lock);
+  }
+  else
+    dt_free_align((void *)map);
+}
+
 void modify_roi_in(dt_iop_module_t *self,
                    dt_dev_pixelpipe_iop_t *piece,
                    const dt_iop_roi_t *roi_out,
@@ -1366,16 +1541,13 @@ void distort_mask(dt_iop_module_t *self,
   // 1. copy the whole image (we'll change only a small part of it)
   dt_iop_copy_image_roi(out, in, 1, roi_in, roi_out);
 
-  // 2. build the distortion map
+  // 2. get the distortion map
   cairo_rectangle_int_t map_extent;
-  float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
-  if(map == NULL)
-    return;
+  const float complex *map = _get_global_distortion_map(self, piece, roi_in->scale,
+                                                        roi_out, &map_extent);
 
   // 3. apply the map
-  if(map_extent.width != 0 && map_extent.height != 0)
+  if(map && map_extent.width != 0 && map_extent.height != 0)
   {
     const int ch = piece->colors;
     piece->colors = 1;
@@ -1383,7 +1555,7 @@ void distort_mask(dt_iop_module_t *self,
     piece->colors = ch;
   }
 
-  dt_free_align((void *) map);
+  _release_global_distortion_map(piece, map);
 }
 
 void process(dt_iop_module_t *self,
@@ -1399,19 +1571,16 @@ void process(dt_iop_module_t *self,
   // 1. copy the whole image (we'll change only a small part of it)
   dt_iop_copy_image_roi(out, in, piece->colors, roi_in, roi_out);
 
-  // 2. build the distortion map
+  // 2. get the distortion map
   cairo_rectangle_int_t map_extent;
-  float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
-  if(map == NULL)
-    return;
+  const float complex *map = _get_global_distortion_map(self, piece, roi_in->scale,
+                                                        roi_out, &map_extent);
 
   // 3. apply the map
-  if(map_extent.width != 0 && map_extent.height != 0)
+  if(map && map_extent.width != 0 && map_extent.height != 0)
     _apply_global_distortion_map(self, piece, in, out, roi_in, roi_out, map, &map_extent);
 
-  dt_free_align((void *)map);
+  _release_global_distortion_map(piece, map);
 }
 
 #ifdef HAVE_OPENCL
@@ -1563,20 +1732,16 @@ int process_cl(dt_iop_module_t *self,
     if(err != CL_SUCCESS) return err;
   }
 
-  // 2. build the distortion map
+  // 2. get the distortion map
   cairo_rectangle_int_t map_extent;
-  float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
-
-  if(map == NULL)
-    return CL_SUCCESS;
+  const float complex *map = _get_global_distortion_map(self, piece, roi_in->scale,
+                                                        roi_out, &map_extent);
 
   // 3. apply the map
-  if(map_extent.width != 0 && map_extent.height != 0)
+  if(map && map_extent.width != 0 && map_extent.height != 0)
     err = _apply_global_distortion_map_cl(self, piece, dev_in,
                                           dev_out, roi_in, roi_out, map, &map_extent);
-  dt_free_align((void *) map);
+  _release_global_distortion_map(piece, map);
   return err;
 }
 
@@ -1600,6 +1765,36 @@ void cleanup_global(dt_iop_module_so_t *self)
   self->data = NULL;
 }
 
+void commit_params(dt_iop_module_t *self,
+                   dt_iop_params_t *p1,
+                   dt_dev_pixelpipe_t *pipe,
+                   dt_dev_pixelpipe_iop_t *piece)
+{
+  // the cached map is validated against the params in process()
+  dt_iop_liquify_data_t *d = piece->data;
+  memcpy(&d->params, p1, sizeof(dt_iop_liquify_params_t));
+}
+
+void init_pipe(dt_iop_module_t *self,
+               dt_dev_pixelpipe_t *pipe,
+               dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = calloc(1, sizeof(dt_iop_liquify_data_t));
+  dt_pthread_mutex_init(&d->lock, NULL);
+  piece->data = d;
+}
+
+void cleanup_pipe(dt_iop_module_t *self,
+                  dt_dev_pixelpipe_t *pipe,
+                  dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+  _clear_map_cache(&d->cache);
+  dt_pthread_mutex_destroy(&d->lock);
+  free(piece->data);
+  piece->data = NULL;
+}
+
 // calculate the dot product of 2 vectors.
 
 static float cdot(const float complex p0, const float complex p1)
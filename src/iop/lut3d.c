@@ -226,6 +226,7 @@ int legacy_params(dt_iop_module_t *self,
 }
 
 // From `HaldCLUT_correct.c' by Eskil Steenberg (http://www.quelsolaar.com) (BSD licensed)
+__DT_CLONE_TARGETS__
 static void _correct_pixel_trilinear(const float *const in,
                                      float *const out,
                                      const size_t pixel_nb,
@@ -296,6 +297,7 @@ static void _correct_pixel_trilinear(const float *const in,
 
 // from OpenColorIO
 // https://github.com/imageworks/OpenColorIO/blob/master/src/OpenColorIO/ops/Lut3D/Lut3DOp.cpp
+__DT_CLONE_TARGETS__
 static void _correct_pixel_tetrahedral(const float *const in,
                                        float *const out,
                                        const size_t pixel_nb,
@@ -391,6 +393,7 @@ static void _correct_pixel_tetrahedral(const float *const in,
 
 // from Study on the 3D Interpolation Models Used in Color Conversion
 // http://ijetch.org/papers/318-T860.pdf
+__DT_CLONE_TARGETS__
 static void _correct_pixel_pyramid(const float *const in,
                                    float *const out,
                                    const size_t pixel_nb,
@@ -1006,6 +1009,98 @@ static uint16_t _calculate_clut_3dl(const char *const filepath, float **clut)
   return level;
 }
 
+// parsed cube and 3dl files are kept in the cache directory as raw floats,
+// named after the md5 of the file so a changed file is parsed again
+#define DT_LUT3D_CACHE_MAGIC "dtlut3d"
+#define DT_LUT3D_CACHE_VERSION 1
+
+typedef struct _lut3d_cache_header_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t level;
+} _lut3d_cache_header_t;
+
+static gchar *_clut_cache_filename(const char *const filepath)
+{
+  GMappedFile *map = g_mapped_file_new(filepath, FALSE, NULL);
+  if(!map) return NULL;
+
+  gchar *md5sum = NULL;
+  const gsize length = g_mapped_file_get_length(map);
+  if(length)
+    md5sum = g_compute_checksum_for_data(G_CHECKSUM_MD5,
+                                         (guchar *)g_mapped_file_get_contents(map), length);
+  g_mapped_file_unref(map);
+  if(!md5sum) return NULL;
+
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  gchar *basename = g_strconcat(md5sum, ".bin", NULL);
+  gchar *filename = g_build_filename(cachedir, "lut3d", basename, NULL);
+  g_free(basename);
+  g_free(md5sum);
+  return filename;
+}
+
+static uint16_t _read_cached_clut(const char *const cachename, float **clut)
+{
+  FILE *f = g_fopen(cachename, "rb");
+  if(!f) return 0;
+
+  uint16_t level = 0;
+  _lut3d_cache_header_t header;
+  if(fread(&header, sizeof(header), 1, f) == 1
+     && !memcmp(header.magic, DT_LUT3D_CACHE_MAGIC, sizeof(header.magic))
+     && header.version == DT_LUT3D_CACHE_VERSION
+     && header.level >= 2 && header.level <= 256)
+  {
+    const size_t buf_size = (size_t)header.level * header.level * header.level * 3;
+    // padded by one like the parsed LUTs
+    float *lclut = dt_alloc_align_float(buf_size + 1);
+    if(lclut && fread(lclut, sizeof(float), buf_size, f) == buf_size)
+    {
+      lclut[buf_size] = 0.0f;
+      *clut = lclut;
+      level = header.level;
+      dt_print(DT_DEBUG_DEV, "[lut3d] loaded parsed LUT from %s - level %d", cachename, level);
+    }
+    else
+      dt_free_align(lclut);
+  }
+  fclose(f);
+  return level;
+}
+
+static void _write_cached_clut(const char *const cachename,
+                               const float *const clut,
+                               const uint16_t level)
+{
+  gchar *dir = g_path_get_dirname(cachename);
+  const int err = g_mkdir_with_parents(dir, 0700);
+  g_free(dir);
+  if(err) return;
+
+  // several pipes might parse the same file, write to a private file first
+  gchar *tmpname = g_strdup_printf("%s.%08x", cachename, g_random_int());
+  FILE *f = g_fopen(tmpname, "wb");
+  gboolean ok = FALSE;
+  if(f)
+  {
+    _lut3d_cache_header_t header = { .version = DT_LUT3D_CACHE_VERSION, .level = level };
+    memcpy(header.magic, DT_LUT3D_CACHE_MAGIC, sizeof(header.magic));
+    const size_t buf_size = (size_t)level * level * level * 3;
+    ok = fwrite(&header, sizeof(header), 1, f) == 1
+      && fwrite(clut, sizeof(float), buf_size, f) == buf_size;
+    ok = (fclose(f) == 0) && ok;
+  }
+  if(ok)
+    ok = g_rename(tmpname, cachename) == 0;
+  if(!ok)
+    g_unlink(tmpname);
+  g_free(tmpname);
+}
+
 #ifdef HAVE_OPENCL
 int process_cl(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem dev_in, cl_mem dev_out,
                const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
@@ -1191,13 +1286,22 @@ static int _calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
       {
         level = _calculate_clut_haldclut(p, fullpath, clut);
       }
-      else if(g_str_has_suffix (filepath, ".cube") || g_str_has_suffix (filepath, ".CUBE"))
-      {
-        level = _calculate_clut_cube(fullpath, clut);
-      }
-      else if(g_str_has_suffix (filepath, ".3dl") || g_str_has_suffix (filepath, ".3DL"))
+      else if(g_str_has_suffix (filepath, ".cube") || g_str_has_suffix (filepath, ".CUBE")
+              || g_str_has_suffix (filepath, ".3dl") || g_str_has_suffix (filepath, ".3DL"))
       {
-        level = _calculate_clut_3dl(fullpath, clut);
+        gchar *cachename = _clut_cache_filename(fullpath);
+        if(cachename)
+          level = _read_cached_clut(cachename, clut);
+        if(!level)
+        {
+          if(g_str_has_suffix (filepath, ".cube") || g_str_has_suffix (filepath, ".CUBE"))
+            level = _calculate_clut_cube(fullpath, clut);
+          else
+            level = _calculate_clut_3dl(fullpath, clut);
+          if(level && cachename)
+            _write_cached_clut(cachename, *clut, level);
+        }
+        g_free(cachename);
       }
       g_free(fullpath);
     }
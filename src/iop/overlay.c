@@ -17,6 +17,7 @@
 */
 
 #include "bauhaus/bauhaus.h"
+#include "common/history.h"
 #include "common/interpolation.h"
 #include "common/math.h"
 #include "common/overlay.h"
@@ -117,23 +118,28 @@ typedef struct dt_iop_overlay_data_t
   dt_iop_overlay_compositing_t compositing;
 } dt_iop_overlay_data_t;
 
-#define MAX_OVERLAY 50
+// A rendered overlay image. The stored format depends on the compositing mode:
+//  - HQ: 4-channel float in the pipe's scene-referred linear working RGB
+//    (colorout filtered out, gamma terminal but passing the float through),
+//    so compositing stays high-precision and colour-matched to the host pipe.
+//  - LEGACY: 8-bit Cairo ARGB32 (the original behaviour), kept for backward
+//    compatibility with edits made before the float path existed.
+// The key covers everything the rendering depends on: the overlay image and
+// its history, the render size, the mode and the modules filtered out.
+typedef struct _overlay_cache_t
+{
+  dt_hash_t key;
+  void *buf;
+  size_t width;
+  size_t height;
+  size_t size;
+} _overlay_cache_t;
 
 typedef struct dt_iop_overlay_global_data_t
 {
-  // Cached overlay buffer, one slot per instance (index = multi_priority).
-  // The stored format depends on the instance's compositing mode:
-  //  - HQ: 4-channel float in the pipe's scene-referred linear working RGB
-  //    (colorout filtered out, gamma terminal but passing the float through),
-  //    so compositing stays high-precision and colour-matched to the host pipe.
-  //  - LEGACY: 8-bit Cairo ARGB32 (the original behaviour), kept for backward
-  //    compatibility with edits made before the float path existed.
-  // cache_legacy[] records which format the slot currently holds, so a mode
-  // change invalidates and re-renders it.
-  void *cache[MAX_OVERLAY];
-  size_t cwidth[MAX_OVERLAY];
-  size_t cheight[MAX_OVERLAY];
-  gboolean cache_legacy[MAX_OVERLAY];
+  // rendered overlays shared by all instances and pipes, least recently used first
+  GQueue cache;
+  size_t cache_bytes;
   dt_pthread_mutex_t overlay_threadsafe;
   int kernel_overlay_blend;        // float RGBA blend (HQ)
   int kernel_overlay_blend_legacy; // 8-bit Cairo ARGB blend (legacy)
@@ -157,9 +163,10 @@ typedef struct dt_iop_overlay_gui_data_t
    The creation of the overlay image use a standard pipe run. This is
    not fast so a cache is used.
 
-   - The cached overlay buffers are stored into the global data.
-     One slot is allocated for each instance (index is the multi_priority)
-     and holds buffer address and dimensions.
+   - The cached overlay buffers are stored into the global data, shared
+     by the instances, the darkroom pipes and the exports. They are found
+     by a key of the overlay image, its history and the render size, the
+     least recently used ones are dropped beyond a memory budget.
 
    - To make the internal cache working safely we use a mutex encapsulating cache
      buffer changes making process() re-entry safe for concurrent pixelpipe runs.
@@ -267,13 +274,11 @@ static GList *_get_disabled_modules(const dt_iop_module_t *self,
   return result;
 }
 
-static void _clear_cache_entry(const dt_iop_module_t *self, const int index)
+static void _cache_entry_free(gpointer data)
 {
-  dt_iop_overlay_global_data_t *gd = self->global_data;
-  if(!gd) return;
-
-  dt_free_align(gd->cache[index]);
-  gd->cache[index] = NULL;
+  _overlay_cache_t *c = data;
+  dt_free_align(c->buf);
+  g_free(c);
 }
 
 static void _module_remove_callback(gpointer instance,
@@ -388,6 +393,71 @@ static void _setup_overlay(dt_iop_module_t *self,
   }
 }
 
+// The rendered overlay for the piece, from the cache or rendered now. Only
+// valid while overlay_threadsafe is held.
+static const _overlay_cache_t *_get_overlay(dt_iop_module_t *self,
+                                            const dt_dev_pixelpipe_iop_t *piece,
+                                            const gboolean legacy)
+{
+  dt_iop_overlay_global_data_t *gd = self->global_data;
+  const dt_iop_overlay_data_t *data = piece->data;
+  if(!dt_is_valid_imgid(data->imgid)) return NULL;
+
+  const size_t size[2] = { self->dev->image_storage.width, self->dev->image_storage.height };
+  dt_hash_t key = dt_hash(DT_INITHASH, &data->imgid, sizeof(data->imgid));
+  key = dt_hash(key, size, sizeof(size));
+  key = dt_hash(key, &legacy, sizeof(legacy));
+
+  dt_history_hash_values_t hash;
+  dt_history_hash_read(data->imgid, &hash);
+  key = dt_hash(key, hash.current, hash.current_len);
+  dt_history_hash_free(&hash);
+
+  GList *disabled_modules = _get_disabled_modules(self, data->imgid);
+  for(const GList *m = disabled_modules; m; m = g_list_next(m))
+    key = dt_hash(key, m->data, strlen(m->data));
+  g_list_free(disabled_modules);
+
+  for(GList *l = gd->cache.head; l; l = g_list_next(l))
+  {
+    _overlay_cache_t *c = l->data;
+    if(c->key == key)
+    {
+      g_queue_unlink(&gd->cache, l);
+      g_queue_push_tail_link(&gd->cache, l);
+      return c;
+    }
+  }
+
+  void *buf = NULL;
+  size_t bw = 0;
+  size_t bh = 0;
+  _setup_overlay(self, piece, legacy, &buf, &bw, &bh);
+  if(!buf) return NULL;
+
+  _overlay_cache_t *c = g_malloc(sizeof(_overlay_cache_t));
+  c->key = key;
+  c->buf = buf;
+  c->width = bw;
+  c->height = bh;
+  c->size = bw * bh * (legacy ? 4 : 4 * sizeof(float));
+  g_queue_push_tail(&gd->cache, c);
+  gd->cache_bytes += c->size;
+
+  // keep the one just rendered whatever its size
+  const size_t budget = dt_get_available_mem() / 8;
+  while(gd->cache_bytes > budget && gd->cache.length > 1)
+  {
+    _overlay_cache_t *old = g_queue_pop_head(&gd->cache);
+    gd->cache_bytes -= old->size;
+    _cache_entry_free(old);
+  }
+
+  dt_print(DT_DEBUG_CACHE, "[overlay] %u rendered overlays, %zu MB",
+           gd->cache.length, gd->cache_bytes >> 20);
+  return c;
+}
+
 // Placement geometry shared by the HQ (float) and legacy (Cairo) compositors.
 // All of this math is identical between the two paths; only the final
 // resampling/blend differs.
@@ -576,7 +646,7 @@ static _overlay_geometry_t _overlay_compute_geometry(const dt_iop_overlay_data_t
 /* Composite the overlay into a straight-alpha float RGBA buffer at roi_out
  * dimensions, in the host pipe's scene-referred linear working RGB.
  *
- * The cached overlay (*pbuf) is rendered once at parent-image storage
+ * The cached overlay is rendered once at parent-image storage
  * resolution and reused across zoom levels. Placement / scale / rotation are
  * applied here with a two-stage float resampler: anti-aliased minification
  * (dt_interpolation_resample) followed by per-pixel bicubic sampling of the
@@ -599,43 +669,20 @@ static float *_get_overlay_rgba_f(dt_iop_module_t *self,
 {
   dt_iop_overlay_data_t *data = piece->data;
   dt_iop_overlay_global_data_t *gd = self->global_data;
-  const int index = self->multi_priority;
   const float angle = deg2radf(-data->rotate);
 
-  // ── Acquire / refresh the overlay buffer ─────────────────────────────────
+  // ── Acquire the overlay buffer ───────────────────────────────────────────
   dt_pthread_mutex_lock(&gd->overlay_threadsafe);
 
-  const gboolean use_cache = (self->dev->image_storage.id == darktable.develop->image_storage.id);
-
-  void *cbuf = NULL;
-  size_t cwidth = 0;
-  size_t cheight = 0;
-  void **pbuf = use_cache ? &gd->cache[index] : &cbuf;
-  size_t *pwidth = use_cache ? &gd->cwidth[index] : &cwidth;
-  size_t *pheight = use_cache ? &gd->cheight[index] : &cheight;
-
-  if(!dt_is_valid_imgid(data->imgid))
-    _clear_cache_entry(self, index);
-
-  // drop a cached buffer left over from the other compositing mode
-  if(use_cache && gd->cache[index] && gd->cache_legacy[index])
-    _clear_cache_entry(self, index);
-
-  if(!*pbuf)
-  {
-    _setup_overlay(self, piece, FALSE /* legacy */, pbuf, pwidth, pheight);
-    if(use_cache)
-      gd->cache_legacy[index] = FALSE;
-  }
-
-  if(!*pbuf)
+  const _overlay_cache_t *overlay = _get_overlay(self, piece, FALSE /* legacy */);
+  if(!overlay)
   {
     dt_pthread_mutex_unlock(&gd->overlay_threadsafe);
     return NULL;
   }
 
-  const size_t bw = *pwidth;
-  const size_t bh = *pheight;
+  const size_t bw = overlay->width;
+  const size_t bh = overlay->height;
 
   const _overlay_geometry_t geo = _overlay_compute_geometry(data, piece, roi_out, bw, bh, angle);
   const float scale = geo.scale;
@@ -648,7 +695,7 @@ static float *_get_overlay_rgba_f(dt_iop_module_t *self,
   // Stage 1: anti-aliased minification of the source down to roughly its
   // displayed footprint, so the per-pixel sampling below runs near 1:1 and does
   // not alias on heavy downscales (storage resolution → preview).
-  const float *src = *pbuf;
+  const float *src = overlay->buf;
   size_t sw = bw;
   size_t sh = bh;
   float *mip = NULL;
@@ -662,7 +709,7 @@ static float *_get_overlay_rgba_f(dt_iop_module_t *self,
       const dt_iop_roi_t rin = { 0, 0, (int)bw, (int)bh, 1.0f };
       const dt_iop_roi_t rout = { 0, 0, mw, mh, (float)mw / (float)bw };
       const dt_interpolation_t *down = dt_interpolation_new(DT_INTERPOLATION_LANCZOS3);
-      dt_interpolation_resample(down, mip, &rout, *pbuf, &rin);
+      dt_interpolation_resample(down, mip, &rout, overlay->buf, &rin);
       src = mip;
       sw = mw;
       sh = mh;
@@ -677,8 +724,6 @@ static float *_get_overlay_rgba_f(dt_iop_module_t *self,
     dt_print(DT_DEBUG_ALWAYS, "[overlay] out of memory %d*%d", ow, oh);
     dt_pthread_mutex_unlock(&gd->overlay_threadsafe);
     dt_free_align(mip);
-    if(!use_cache)
-      dt_free_align(cbuf);
     return NULL;
   }
 
@@ -736,8 +781,6 @@ static float *_get_overlay_rgba_f(dt_iop_module_t *self,
   dt_pthread_mutex_unlock(&gd->overlay_threadsafe);
 
   dt_free_align(mip);
-  // Scratch overlay was local to this call; free it now that the resample is done.
-  if(!use_cache) dt_free_align(cbuf);
 
   return canvas;
 }
@@ -757,36 +800,13 @@ static guint8 *_get_overlay_argb(dt_iop_module_t *self,
 {
   dt_iop_overlay_data_t *data = piece->data;
   dt_iop_overlay_global_data_t *gd = self->global_data;
-  const int index = self->multi_priority;
   const float angle = deg2radf(-data->rotate);
 
-  // ── Acquire / refresh the overlay buffer ─────────────────────────────────
+  // ── Acquire the overlay buffer ───────────────────────────────────────────
   dt_pthread_mutex_lock(&gd->overlay_threadsafe);
 
-  const gboolean use_cache = (self->dev->image_storage.id == darktable.develop->image_storage.id);
-
-  void *cbuf = NULL;
-  size_t cwidth = 0;
-  size_t cheight = 0;
-  void **pbuf = use_cache ? &gd->cache[index] : &cbuf;
-  size_t *pwidth = use_cache ? &gd->cwidth[index] : &cwidth;
-  size_t *pheight = use_cache ? &gd->cheight[index] : &cheight;
-
-  if(!dt_is_valid_imgid(data->imgid))
-    _clear_cache_entry(self, index);
-
-  // drop a cached buffer left over from the HQ float mode
-  if(use_cache && gd->cache[index] && !gd->cache_legacy[index])
-    _clear_cache_entry(self, index);
-
-  if(!*pbuf)
-  {
-    _setup_overlay(self, piece, TRUE /* legacy */, pbuf, pwidth, pheight);
-    if(use_cache)
-      gd->cache_legacy[index] = TRUE;
-  }
-
-  if(!*pbuf)
+  const _overlay_cache_t *overlay = _get_overlay(self, piece, TRUE /* legacy */);
+  if(!overlay)
   {
     dt_pthread_mutex_unlock(&gd->overlay_threadsafe);
     return NULL;
@@ -828,11 +848,11 @@ static guint8 *_get_overlay_argb(dt_iop_module_t *self,
   // then plugin_threadsafe — consistent everywhere, no deadlock risk.
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
 
-  const size_t bw = *pwidth;
-  const size_t bh = *pheight;
+  const size_t bw = overlay->width;
+  const size_t bh = overlay->height;
 
-  // Wrap *pbuf directly — no memcpy of the (potentially large) buffer.
-  cairo_surface_t *surface_two = dt_view_create_surface(*pbuf, bw, bh);
+  // Wrap the cached buffer directly — no memcpy of the (potentially large) buffer.
+  cairo_surface_t *surface_two = dt_view_create_surface(overlay->buf, bw, bh);
 
   if(cairo_surface_status(surface_two) != CAIRO_STATUS_SUCCESS)
   {
@@ -843,8 +863,6 @@ static guint8 *_get_overlay_argb(dt_iop_module_t *self,
     dt_pthread_mutex_unlock(&gd->overlay_threadsafe);
     cairo_surface_destroy(surface_two);
     cairo_surface_destroy(surface);
-    if(!use_cache)
-      dt_free_align(cbuf);
     g_free(image);
     return NULL;
   }
@@ -865,18 +883,14 @@ static guint8 *_get_overlay_argb(dt_iop_module_t *self,
   cairo_set_source_surface(cr, surface_two, 0.0, 0.0);
   cairo_paint(cr);
 
-  // cairo_paint() is synchronous for CPU surfaces: *pbuf is no longer read.
+  // cairo_paint() is synchronous for CPU surfaces: the cached buffer is no longer read.
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
   dt_pthread_mutex_unlock(&gd->overlay_threadsafe);
 
   cairo_destroy(cr);
   cairo_surface_flush(surface);
   cairo_surface_destroy(surface);
-  cairo_surface_destroy(surface_two); // drops reference to *pbuf, not ownership
-
-  // Scratch overlay was local to this call; free it now that Cairo is done.
-  if(!use_cache)
-    dt_free_align(cbuf);
+  cairo_surface_destroy(surface_two); // drops reference to the cached buffer, not ownership
 
   *out_stride = stride;
   return image;
@@ -1318,6 +1332,7 @@ void gui_changed(dt_iop_module_t *self,
 void init_global(dt_iop_module_so_t *self)
 {
   dt_iop_overlay_global_data_t *gd = calloc(1, sizeof(dt_iop_overlay_global_data_t));
+  g_queue_init(&gd->cache);
 
   pthread_mutexattr_t recursive_locking;
   pthread_mutexattr_init(&recursive_locking);
@@ -1340,8 +1355,7 @@ void cleanup_global(dt_iop_module_so_t *self)
 {
   dt_iop_overlay_global_data_t *gd = self->data;
 
-  for(int k=0; k<MAX_OVERLAY; k++)
-    dt_free_align(gd->cache[k]);
+  g_queue_clear_full(&gd->cache, _cache_entry_free);
 
   dt_pthread_mutex_destroy(&gd->overlay_threadsafe);
 
@@ -1354,19 +1368,10 @@ void cleanup_global(dt_iop_module_so_t *self)
   self->data = NULL;
 }
 
-static void _signal_image_changed(gpointer instance, dt_iop_module_t *self)
-{
-  if(!self) return;
-
-  for(int k=0; k<MAX_OVERLAY; k++)
-    _clear_cache_entry(self, k);
-}
-
 static void _signal_module_moved(gpointer instance, dt_iop_module_t *self)
 {
   if(!self) return;
 
-  _clear_cache_entry(self, self->multi_priority);
   dt_dev_reprocess_all(self->dev);
 }
 
@@ -1388,7 +1393,6 @@ static void _drag_and_drop_received(GtkWidget *widget,
     const int imgs_nb = gtk_selection_data_get_length(selection_data) / sizeof(dt_imgid_t);
     if(imgs_nb)
     {
-      const int index  = self->multi_priority;
       const dt_imgid_t *imgs = (dt_imgid_t *)gtk_selection_data_get_data(selection_data);
 
       const dt_imgid_t imgid_intended_overlay = imgs[0];
@@ -1412,7 +1416,6 @@ static void _drag_and_drop_received(GtkWidget *widget,
 
         // and record the new one
         p->imgid         = imgid_intended_overlay;
-        _clear_cache_entry(self, index);
 
         dt_overlay_record(imgid_target_image, imgid_intended_overlay);
 
@@ -1561,7 +1564,6 @@ void gui_init(dt_iop_module_t *self)
   gtk_widget_set_tooltip_text(g->rotate, _("the rotation of the overlay"));
 
   DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_DEVELOP_MODULE_REMOVE, _module_remove_callback);
-  DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_DEVELOP_IMAGE_CHANGED, _signal_image_changed);
   DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_DEVELOP_MODULE_MOVED, _signal_module_moved);
 }
 
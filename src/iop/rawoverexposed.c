@@ -53,11 +53,30 @@ typedef struct dt_iop_rawoverexposed_data_t
   unsigned int threshold[4];
 } dt_iop_rawoverexposed_data_t;
 
+// backtransformed raw position of the pixels of a roi
+typedef struct dt_iop_rawoverexposed_lut_t
+{
+  dt_hash_t hash;   // image, roi and distortion of the full pipe
+  size_t size;      // pixels
+  int32_t *index;   // raw pixel of each output pixel, -1 outside of the raw
+  uint64_t stamp;
+} dt_iop_rawoverexposed_lut_t;
+
+#define RAWOVEREXPOSED_LUTS 4
+
 typedef struct dt_iop_rawoverexposed_global_data_t
 {
-  int kernel_rawoverexposed_mark_cfa;
-  int kernel_rawoverexposed_mark_solid;
-  int kernel_rawoverexposed_falsecolor;
+  int kernel_rawoverexposed_mark;
+
+  // dragging a slider shouldn't redo the raw pass nor the backtransform,
+  // we keep the clipped pixels of the image and the lookups of recent rois
+  GMutex lock;
+  dt_hash_t mask_hash; // image and thresholds
+  uint8_t *mask;       // per raw pixel, 0 if not clipped, else 1 + cfa color
+  int mask_width;
+  int mask_height;
+  dt_iop_rawoverexposed_lut_t lut[RAWOVEREXPOSED_LUTS];
+  uint64_t stamp;
 } dt_iop_rawoverexposed_global_data_t;
 
 const char *name()
@@ -107,28 +126,19 @@ static void _process_common_setup(const dt_iop_module_t *self, dt_dev_pixelpipe_
   }
 }
 
-void process(dt_iop_module_t *self,
-             dt_dev_pixelpipe_iop_t *piece,
-             const void *const ivoid,
-             void *const ovoid,
-             const dt_iop_roi_t *const roi_in,
-             const dt_iop_roi_t *const roi_out)
+static gboolean _update_mask(dt_iop_rawoverexposed_global_data_t *gd,
+                             const dt_iop_module_t *self,
+                             const dt_iop_rawoverexposed_data_t *const d)
 {
-  const dt_iop_rawoverexposed_data_t *const d = piece->data;
-
-  _process_common_setup(self, piece);
-
-  dt_develop_t *dev = self->dev;
-  const dt_image_t *const image = &(dev->image_storage);
-
-  const int ch = piece->colors;
-  const double iop_order = self->iop_order;
-
-  const dt_dev_rawoverexposed_mode_t mode = dev->rawoverexposed.mode;
-  const int colorscheme = dev->rawoverexposed.colorscheme;
-  const float *const color = dt_iop_rawoverexposed_colors[colorscheme];
+  const dt_image_t *const image = &self->dev->image_storage;
+  // NOT FROM THE PIPE !!!
+  const uint32_t filters = image->buf_dsc.filters;
 
-  dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
+  dt_hash_t hash = dt_hash(DT_INITHASH, &image->id, sizeof(image->id));
+  hash = dt_hash(hash, &filters, sizeof(filters));
+  hash = dt_hash(hash, image->buf_dsc.xtrans, sizeof(image->buf_dsc.xtrans));
+  hash = dt_hash(hash, d->threshold, sizeof(d->threshold));
+  if(gd->mask && gd->mask_hash == hash) return TRUE;
 
   dt_mipmap_buffer_t buf;
   dt_mipmap_cache_get(&buf, image->id, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
@@ -136,21 +146,101 @@ void process(dt_iop_module_t *self,
   {
     dt_control_log(_("failed to get raw buffer from image `%s'"), image->filename);
     dt_mipmap_cache_release(&buf);
-    return;
+    return FALSE;
   }
 
-  const uint16_t *const raw = (const uint16_t *const)buf.buf;
-  float *const restrict out = DT_IS_ALIGNED((float *const)ovoid);
+  const size_t npixels = (size_t)buf.width * buf.height;
+  if(!gd->mask || (size_t)gd->mask_width * gd->mask_height != npixels)
+  {
+    dt_free_align(gd->mask);
+    gd->mask = dt_alloc_aligned(npixels);
+  }
+  if(!gd->mask)
+  {
+    dt_mipmap_cache_release(&buf);
+    return FALSE;
+  }
 
-  // NOT FROM THE PIPE !!!
-  const uint32_t filters = image->buf_dsc.filters;
+  const uint16_t *const raw = (const uint16_t *const)buf.buf;
   const uint8_t(*const xtrans)[6] = (const uint8_t(*const)[6])image->buf_dsc.xtrans;
+  const int width = buf.width;
+  uint8_t *const mask = gd->mask;
+
+  DT_OMP_FOR()
+  for(int j = 0; j < buf.height; j++)
+  {
+    for(int i = 0; i < width; i++)
+    {
+      const size_t k = (size_t)j * width + i;
+      const int c = (filters == 9u) ? FCNxtrans(j, i, xtrans) : FC(j, i, filters);
+      // was the raw pixel clipped?
+      mask[k] = raw[k] < d->threshold[c] ? 0 : 1 + c;
+    }
+  }
+
+  gd->mask_width = buf.width;
+  gd->mask_height = buf.height;
+  gd->mask_hash = hash;
+  dt_mipmap_cache_release(&buf);
+
+  // the lookups depend on the raw size
+  for(int k = 0; k < RAWOVEREXPOSED_LUTS; k++)
+    gd->lut[k].hash = DT_INVALID_HASH;
+  return TRUE;
+}
+
+static const int32_t *_get_lut(dt_iop_rawoverexposed_global_data_t *gd,
+                               dt_iop_module_t *self,
+                               const dt_iop_roi_t *const roi_in,
+                               const dt_iop_roi_t *const roi_out)
+{
+  dt_develop_t *dev = self->dev;
+  const double iop_order = self->iop_order;
+
+  // the positions come from the full pipe whatever pipe we run in
+  const dt_hash_t distort = dt_dev_hash_distort_plus(dev, dev->full.pipe, iop_order,
+                                                     DT_DEV_TRANSFORM_DIR_BACK_INCL);
+  dt_hash_t hash = DT_INVALID_HASH;
+  if(distort != DT_INVALID_HASH)
+  {
+    hash = dt_hash(DT_INITHASH, &distort, sizeof(distort));
+    hash = dt_hash(hash, roi_out, sizeof(dt_iop_roi_t));
+    hash = dt_hash(hash, &roi_in->scale, sizeof(roi_in->scale));
+    hash = dt_hash(hash, &gd->mask_hash, sizeof(gd->mask_hash));
+  }
+
+  dt_iop_rawoverexposed_lut_t *lut = &gd->lut[0];
+  for(int k = 0; k < RAWOVEREXPOSED_LUTS; k++)
+  {
+    dt_iop_rawoverexposed_lut_t *l = &gd->lut[k];
+    if(hash != DT_INVALID_HASH && l->index && l->hash == hash)
+    {
+      l->stamp = ++gd->stamp;
+      return l->index;
+    }
+    if(l->stamp < lut->stamp) lut = l;
+  }
+
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+  if(!lut->index || lut->size != npixels)
+  {
+    dt_free_align(lut->index);
+    lut->index = dt_alloc_align_type(int32_t, npixels);
+    lut->size = lut->index ? npixels : 0;
+  }
+  lut->hash = DT_INVALID_HASH;
+  if(!lut->index) return NULL;
 
   // acquire temp memory for distorted pixel coords
   size_t coordbufsize;
   float *const restrict coordbuf = dt_alloc_perthread_float(2*roi_out->width, &coordbufsize);
+  if(!coordbuf) return NULL;
 
-  DT_OMP_FOR(firstprivate(dt_iop_rawoverexposed_colors))
+  int32_t *const index = lut->index;
+  const int raw_width = gd->mask_width;
+  const int raw_height = gd->mask_height;
+
+  DT_OMP_FOR()
   for(int j = 0; j < roi_out->height; j++)
   {
     float *const restrict bufptr = dt_get_perthread(coordbuf, coordbufsize);
@@ -163,188 +253,145 @@ void process(dt_iop_module_t *self,
     }
 
     // where did they come from?
-    dt_dev_distort_backtransform_plus(self->dev, self->dev->full.pipe, iop_order, DT_DEV_TRANSFORM_DIR_BACK_INCL, bufptr, roi_out->width);
+    dt_dev_distort_backtransform_plus(dev, dev->full.pipe, iop_order, DT_DEV_TRANSFORM_DIR_BACK_INCL, bufptr, roi_out->width);
 
+    int32_t *const row = index + (size_t)j * roi_out->width;
     for(int i = 0; i < roi_out->width; i++)
     {
-      const size_t pout = (size_t)ch * (j * roi_out->width + i);
-
       // not sure which float -> int to use here
       const int i_raw = (int)bufptr[2 * i];
       const int j_raw = (int)bufptr[2 * i + 1];
 
-      if(i_raw < 0 || j_raw < 0 || i_raw >= buf.width || j_raw >= buf.height) continue;
-
-      int c;
-      if(filters == 9u)
-      {
-        c = FCNxtrans(j_raw, i_raw, xtrans);
-      }
-      else // if(filters)
-      {
-        c = FC(j_raw, i_raw, filters);
-      }
-
-      const size_t pin = (size_t)j_raw * buf.width + i_raw;
-      const float in = raw[pin];
-
-      // was the raw pixel clipped?
-      if(in < d->threshold[c]) continue;
-
-      switch(mode)
-      {
-        case DT_DEV_RAWOVEREXPOSED_MODE_MARK_CFA:
-          memcpy(out + pout, dt_iop_rawoverexposed_colors[c], sizeof(float) * 4);
-          break;
-        case DT_DEV_RAWOVEREXPOSED_MODE_MARK_SOLID:
-          memcpy(out + pout, color, sizeof(float) * 4);
-          break;
-        case DT_DEV_RAWOVEREXPOSED_MODE_FALSECOLOR:
-          out[pout + c] = 0.0;
-          break;
-      }
+      row[i] = (i_raw < 0 || j_raw < 0 || i_raw >= raw_width || j_raw >= raw_height)
+        ? -1
+        : j_raw * raw_width + i_raw;
     }
   }
 
   dt_free_align(coordbuf);
 
-  dt_mipmap_cache_release(&buf);
-
-  if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) dt_iop_alpha_copy(ivoid, ovoid, roi_out->width, roi_out->height);
+  lut->hash = hash;
+  lut->stamp = ++gd->stamp;
+  return index;
 }
 
-#ifdef HAVE_OPENCL
-int process_cl(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem dev_in, cl_mem dev_out,
-               const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+// the clipping code of each output pixel, 0 or 1 + cfa color
+static uint8_t *_get_overlay(dt_iop_module_t *self,
+                             dt_dev_pixelpipe_iop_t *piece,
+                             const dt_iop_roi_t *const roi_in,
+                             const dt_iop_roi_t *const roi_out)
 {
-  const dt_iop_rawoverexposed_data_t *const d = piece->data;
-  dt_develop_t *dev = self->dev;
   dt_iop_rawoverexposed_global_data_t *gd = self->global_data;
+  const dt_iop_rawoverexposed_data_t *const d = piece->data;
 
-  cl_mem dev_raw = NULL;
-  float *coordbuf = NULL;
-  cl_mem dev_coord = NULL;
-  cl_mem dev_thresholds = NULL;
-  cl_mem dev_colors = NULL;
-  cl_mem dev_xtrans = NULL;
-
-  cl_int err = DT_OPENCL_PROCESS_CL;
+  _process_common_setup(self, piece);
 
-  const dt_image_t *const image = &dev->image_storage;
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+  uint8_t *overlay = NULL;
 
-  dt_mipmap_buffer_t buf;
-  dt_mipmap_cache_get(&buf, image->id, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
-  if(!buf.buf)
+  g_mutex_lock(&gd->lock);
+  const int32_t *index = _update_mask(gd, self, d) ? _get_lut(gd, self, roi_in, roi_out) : NULL;
+  if(index && (overlay = dt_alloc_aligned(npixels)))
   {
-    dt_control_log(_("failed to get raw buffer from image `%s'"), image->filename);
-    dt_mipmap_cache_release(&buf);
-    goto error;
+    const uint8_t *const mask = gd->mask;
+    DT_OMP_FOR_SIMD()
+    for(size_t k = 0; k < npixels; k++)
+      overlay[k] = index[k] < 0 ? 0 : mask[index[k]];
   }
+  g_mutex_unlock(&gd->lock);
 
-  const int devid = piece->pipe->devid;
-
-  const int width = roi_out->width;
-  const int height = roi_out->height;
-
-  const size_t region[2] = { width, height };
-
-  _process_common_setup(self, piece);
+  return overlay;
+}
 
-  err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
-  err = dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, CLIMG_ORIGIN, CLIMG_ORIGIN, region);
-  if(err != CL_SUCCESS) goto error;
+void process(dt_iop_module_t *self,
+             dt_dev_pixelpipe_iop_t *piece,
+             const void *const ivoid,
+             void *const ovoid,
+             const dt_iop_roi_t *const roi_in,
+             const dt_iop_roi_t *const roi_out)
+{
+  dt_develop_t *dev = self->dev;
+  const int ch = piece->colors;
 
+  const dt_dev_rawoverexposed_mode_t mode = dev->rawoverexposed.mode;
   const int colorscheme = dev->rawoverexposed.colorscheme;
   const float *const color = dt_iop_rawoverexposed_colors[colorscheme];
 
-  // NOT FROM THE PIPE !!!
-  const uint32_t filters = image->buf_dsc.filters;
-
-  const int raw_width = buf.width;
-  const int raw_height = buf.height;
-
-  dev_raw = dt_opencl_copy_host_to_image(devid, buf.buf, raw_width, raw_height, sizeof(uint16_t));
-  if(dev_raw == NULL) goto error;
+  dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
 
-  const size_t coordbufsize = (size_t)height * width * 2 * sizeof(float);
+  uint8_t *const overlay = _get_overlay(self, piece, roi_in, roi_out);
+  if(!overlay) return;
 
-  coordbuf = dt_alloc_aligned(coordbufsize);
-  if(coordbuf == NULL) goto error;
+  float *const restrict out = DT_IS_ALIGNED((float *const)ovoid);
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
 
-  DT_OMP_FOR()
-  for(int j = 0; j < height; j++)
+  DT_OMP_FOR(firstprivate(dt_iop_rawoverexposed_colors))
+  for(size_t k = 0; k < npixels; k++)
   {
-    float *bufptr = ((float *)coordbuf) + (size_t)2 * j * width;
+    if(!overlay[k]) continue;
 
-    // here are all the pixels of this row
-    for(int i = 0; i < roi_out->width; i++)
+    const int c = overlay[k] - 1;
+    const size_t pout = (size_t)ch * k;
+    switch(mode)
     {
-      bufptr[2 * i] = (float)(roi_out->x + i) / roi_in->scale;
-      bufptr[2 * i + 1] = (float)(roi_out->y + j) / roi_in->scale;
+      case DT_DEV_RAWOVEREXPOSED_MODE_MARK_CFA:
+        memcpy(out + pout, dt_iop_rawoverexposed_colors[c], sizeof(float) * 4);
+        break;
+      case DT_DEV_RAWOVEREXPOSED_MODE_MARK_SOLID:
+        memcpy(out + pout, color, sizeof(float) * 4);
+        break;
+      case DT_DEV_RAWOVEREXPOSED_MODE_FALSECOLOR:
+        out[pout + c] = 0.0;
+        break;
     }
-
-    // where did they come from?
-    dt_dev_distort_backtransform_plus(self->dev, self->dev->full.pipe, self->iop_order, DT_DEV_TRANSFORM_DIR_BACK_INCL, bufptr, roi_out->width);
   }
 
-  dev_coord = dt_opencl_copy_host_to_device_constant(devid, coordbufsize, coordbuf);
-  if(dev_coord == NULL) goto error;
+  dt_free_align(overlay);
 
-  int kernel;
-  switch(dev->rawoverexposed.mode)
-  {
-    case DT_DEV_RAWOVEREXPOSED_MODE_MARK_CFA:
-      kernel = gd->kernel_rawoverexposed_mark_cfa;
-
-      dev_colors = dt_opencl_copy_host_to_device_constant(devid, sizeof(dt_iop_rawoverexposed_colors), (void *)dt_iop_rawoverexposed_colors);
-      if(dev_colors == NULL) goto error;
-
-      break;
-    case DT_DEV_RAWOVEREXPOSED_MODE_MARK_SOLID:
-      kernel = gd->kernel_rawoverexposed_mark_solid;
-      break;
-    case DT_DEV_RAWOVEREXPOSED_MODE_FALSECOLOR:
-    default:
-      kernel = gd->kernel_rawoverexposed_falsecolor;
-      break;
-  }
+  if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) dt_iop_alpha_copy(ivoid, ovoid, roi_out->width, roi_out->height);
+}
 
-  if(filters == 9u)
-  {
-    dev_xtrans = dt_opencl_copy_host_to_device_constant(devid, sizeof(image->buf_dsc.xtrans), (void *)image->buf_dsc.xtrans);
-    if(dev_xtrans == NULL) goto error;
-  }
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem dev_in, cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  dt_develop_t *dev = self->dev;
+  dt_iop_rawoverexposed_global_data_t *gd = self->global_data;
+
+  cl_mem dev_overlay = NULL;
+  cl_mem dev_colors = NULL;
+
+  const int devid = piece->pipe->devid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const size_t region[2] = { width, height };
+
+  cl_int err = dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, CLIMG_ORIGIN, CLIMG_ORIGIN, region);
+  if(err != CL_SUCCESS) return err;
+
+  uint8_t *overlay = _get_overlay(self, piece, roi_in, roi_out);
+  // without the raw data the image is shown as is, like on the cpu
+  if(!overlay) return CL_SUCCESS;
+
+  err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  dev_overlay = dt_opencl_copy_host_to_device_constant(devid, (size_t)width * height, overlay);
+  if(dev_overlay == NULL) goto error;
+
+  dev_colors = dt_opencl_copy_host_to_device_constant(devid, sizeof(dt_iop_rawoverexposed_colors), (void *)dt_iop_rawoverexposed_colors);
+  if(dev_colors == NULL) goto error;
+
+  const int mode = dev->rawoverexposed.mode;
+  const int colorscheme = dev->rawoverexposed.colorscheme;
+  const float *const color = dt_iop_rawoverexposed_colors[colorscheme];
 
-  dev_thresholds = dt_opencl_copy_host_to_device_constant(devid, sizeof(unsigned int) * 4, (void *)d->threshold);
-  if(dev_thresholds == NULL) goto error;
-
-  if(dev->rawoverexposed.mode == DT_DEV_RAWOVEREXPOSED_MODE_MARK_CFA)
-    err = dt_opencl_enqueue_kernel_2d_args(devid, kernel, width, height,
-              CLARG(dev_in), CLARG(dev_out), CLARG(dev_coord),
-              CLARG(width), CLARG(height),
-              CLARG(dev_raw), CLARG(raw_width), CLARG(raw_height), CLARG(filters), CLARG(dev_xtrans),
-              CLARG(dev_thresholds),
-              CLARG(dev_colors));
-  else if(dev->rawoverexposed.mode == DT_DEV_RAWOVEREXPOSED_MODE_MARK_SOLID)
-     err = dt_opencl_enqueue_kernel_2d_args(devid, kernel, width, height,
-              CLARG(dev_in), CLARG(dev_out), CLARG(dev_coord),
-              CLARG(width), CLARG(height),
-              CLARG(dev_raw), CLARG(raw_width), CLARG(raw_height), CLARG(filters), CLARG(dev_xtrans),
-              CLARG(dev_thresholds), CLARG(color));
-   else
-     err = dt_opencl_enqueue_kernel_2d_args(devid, kernel, width, height,
-              CLARG(dev_in), CLARG(dev_out), CLARG(dev_coord),
-              CLARG(width), CLARG(height),
-              CLARG(dev_raw), CLARG(raw_width), CLARG(raw_height), CLARG(filters), CLARG(dev_xtrans),
-              CLARG(dev_thresholds));
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_rawoverexposed_mark, width, height,
+          CLARG(dev_in), CLARG(dev_out), CLARG(dev_overlay),
+          CLARG(width), CLARG(height), CLARG(mode),
+          CLARG(dev_colors), CLARRAY(4, color));
 error:
-  dt_opencl_release_mem_object(dev_xtrans);
   dt_opencl_release_mem_object(dev_colors);
-  dt_opencl_release_mem_object(dev_thresholds);
-  dt_opencl_release_mem_object(dev_coord);
-  dt_free_align(coordbuf);
-  dt_opencl_release_mem_object(dev_raw);
-  dt_mipmap_cache_release(&buf);
+  dt_opencl_release_mem_object(dev_overlay);
+  dt_free_align(overlay);
   return err;
 }
 #endif
@@ -353,29 +400,10 @@ void tiling_callback(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
                      const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out,
                      dt_develop_tiling_t *tiling)
 {
-  dt_develop_t *dev = self->dev;
-  const dt_image_t *const image = &(dev->image_storage);
-
-  // the module needs access to the full raw image which adds to the memory footprint
-  // on OpenCL devices. We take account in tiling->overhead.
-
-  dt_mipmap_buffer_t buf;
-  int raw_width = 0;
-  int raw_height = 0;
-
-  dt_mipmap_cache_get(&buf, image->id, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
-
-  if(buf.buf)
-  {
-    raw_width = buf.width;
-    raw_height = buf.height;
-  }
-
-  dt_mipmap_cache_release(&buf);
-
-  tiling->factor = 2.5f;  // in + out + coordinates
+  // the raw data stays on the host, the device only gets a byte per pixel
+  tiling->factor = 2.1f;  // in + out + overlay
   tiling->maxbuf = 1.0f;
-  tiling->overhead = (size_t)raw_width * raw_height * sizeof(uint16_t);
+  tiling->overhead = 0;
   tiling->overlap = 0;
   tiling->align = 1;
 }
@@ -394,23 +422,34 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   if(image->buf_dsc.datatype != TYPE_UINT16 || !image->buf_dsc.filters) piece->enabled = FALSE;
 }
 
+static void _cache_clear(dt_iop_rawoverexposed_global_data_t *gd)
+{
+  for(int k = 0; k < RAWOVEREXPOSED_LUTS; k++)
+    dt_free_align(gd->lut[k].index);
+  memset(gd->lut, 0, sizeof(gd->lut));
+  dt_free_align(gd->mask);
+  gd->mask = NULL;
+  gd->mask_hash = DT_INVALID_HASH;
+  gd->mask_width = gd->mask_height = 0;
+}
+
 void init_global(dt_iop_module_so_t *self)
 {
   const int program = 2; // basic.cl from programs.conf
-  self->data = malloc(sizeof(dt_iop_rawoverexposed_global_data_t));
+  self->data = calloc(1, sizeof(dt_iop_rawoverexposed_global_data_t));
   dt_iop_rawoverexposed_global_data_t *gd = self->data;
-  gd->kernel_rawoverexposed_mark_cfa = dt_opencl_create_kernel(program, "rawoverexposed_mark_cfa");
-  gd->kernel_rawoverexposed_mark_solid = dt_opencl_create_kernel(program, "rawoverexposed_mark_solid");
-  gd->kernel_rawoverexposed_falsecolor = dt_opencl_create_kernel(program, "rawoverexposed_falsecolor");
+  gd->kernel_rawoverexposed_mark = dt_opencl_create_kernel(program, "rawoverexposed_mark");
+  g_mutex_init(&gd->lock);
+  gd->mask_hash = DT_INVALID_HASH;
 }
 
 
 void cleanup_global(dt_iop_module_so_t *self)
 {
   dt_iop_rawoverexposed_global_data_t *gd = self->data;
-  dt_opencl_free_kernel(gd->kernel_rawoverexposed_falsecolor);
-  dt_opencl_free_kernel(gd->kernel_rawoverexposed_mark_solid);
-  dt_opencl_free_kernel(gd->kernel_rawoverexposed_mark_cfa);
+  dt_opencl_free_kernel(gd->kernel_rawoverexposed_mark);
+  _cache_clear(gd);
+  g_mutex_clear(&gd->lock);
   free(self->data);
   self->data = NULL;
 }
@@ -424,6 +463,15 @@ void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelp
 {
   free(piece->data);
   piece->data = NULL;
+
+  // the full pipe is gone with the image it has shown
+  if(dt_pipe_is_full(pipe))
+  {
+    dt_iop_rawoverexposed_global_data_t *gd = self->global_data;
+    g_mutex_lock(&gd->lock);
+    _cache_clear(gd);
+    g_mutex_unlock(&gd->lock);
+  }
 }
 
 void init(dt_iop_module_t *self)
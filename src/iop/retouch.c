@@ -17,6 +17,7 @@
 */
 
 #include "bauhaus/bauhaus.h"
+#include "common/artifact_cache.h"
 #include "common/bilateral.h"
 #include "common/bilateralcl.h"
 #include "common/colorspaces_inline_conversions.h"
@@ -171,7 +172,14 @@ typedef struct dt_iop_retouch_gui_data_t
   GtkWidget *sl_mask_opacity; // draw mask opacity
 } dt_iop_retouch_gui_data_t;
 
-typedef struct dt_iop_retouch_params_t dt_iop_retouch_data_t;
+typedef struct dt_iop_retouch_data_t
+{
+  // the default commit_params() copies the params here, they must stay first
+  dt_iop_retouch_params_t p;
+  // forward wavelet transform of the last input, reused while only the
+  // shapes on the detail scales change
+  dwt_cache_t dwt_cache;
+} dt_iop_retouch_data_t;
 
 typedef struct dt_iop_retouch_global_data_t
 {
@@ -2276,13 +2284,15 @@ void init_pipe(dt_iop_module_t *self,
                dt_dev_pixelpipe_t *pipe,
                dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc(sizeof(dt_iop_retouch_data_t));
+  piece->data = calloc(1, sizeof(dt_iop_retouch_data_t));
 }
 
 void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_dwt_cache_free(&d->dwt_cache);
   free(piece->data);
   piece->data = NULL;
 }
@@ -3687,9 +3697,22 @@ static void _retouch_heal(float *const in,
   rt_copy_in_to_out(in, roi_in, img_src, roi_mask_scaled, 4, dx, dy, angle, cx, cy);
   rt_copy_in_to_out(in, roi_in, img_dest, roi_mask_scaled, 4, 0, 0, 0.0f, 0.0f, 0.0f);
 
-  // heal it
-  dt_heal(img_src, img_dest, mask_scaled,
-          roi_mask_scaled->width, roi_mask_scaled->height, 4, max_iter);
+  // heal it, unless the very same patch has been healed before
+  const size_t size = sizeof(float) * 4 * roi_mask_scaled->width * roi_mask_scaled->height;
+  const size_t mask_size = sizeof(float) * roi_mask_scaled->width * roi_mask_scaled->height;
+  dt_hash_t key = dt_artifact_key_init("retouch heal");
+  key = dt_artifact_key_add(key, &roi_mask_scaled->width, sizeof(int));
+  key = dt_artifact_key_add(key, &roi_mask_scaled->height, sizeof(int));
+  key = dt_artifact_key_add(key, &max_iter, sizeof(int));
+  key = dt_artifact_key_add(key, mask_scaled, mask_size);
+  key = dt_artifact_key_add(key, img_src, size);
+  key = dt_artifact_key_add(key, img_dest, size);
+  if(!dt_artifact_cache_get(key, img_dest, size))
+  {
+    dt_heal(img_src, img_dest, mask_scaled,
+            roi_mask_scaled->width, roi_mask_scaled->height, 4, max_iter);
+    dt_artifact_cache_put(key, img_dest, size);
+  }
 
   // copy healed (temp) image to destination image
   rt_copy_image_masked(img_dest, in, roi_in, mask_scaled, roi_mask_scaled, opacity);
@@ -3954,6 +3977,11 @@ void process(dt_iop_module_t *self,
                       roi_in->scale / piece->iscale);
   if(dwt_p == NULL) goto cleanup;
 
+  // in darkroom keep the decomposition, editing a shape on a detail
+  // scale then only runs the synthesis again
+  if(piece->pipe->type & DT_DEV_PIXELPIPE_BASIC)
+    dt_dwt_set_cache(dwt_p, &((dt_iop_retouch_data_t *)piece->data)->dwt_cache);
+
   // check if this module should expose mask.
   if(dt_pipe_is_full(piece->pipe) && g
      && (g->mask_display || display_wavelet_scale)
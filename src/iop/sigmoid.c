@@ -209,7 +209,7 @@ const char **description(dt_iop_module_t *self)
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_POINTWISE;
 }
 
 int default_group()
@@ -563,6 +563,7 @@ static void _pixel_channel_order(const dt_aligned_pixel_t pix_in, dt_iop_sigmoid
   }
 }
 
+__DT_CLONE_TARGETS__
 void process_loglogistic_rgb_ratio(const dt_dev_pixelpipe_iop_t *piece,
                                    const void *const ivoid,
                                    void *const ovoid,
@@ -700,6 +701,7 @@ static inline void _preserve_hue_and_energy(const dt_aligned_pixel_t pix_in,
   }
 }
 
+__DT_CLONE_TARGETS__
 void process_loglogistic_per_channel(dt_develop_t *dev,
                                      const dt_dev_pixelpipe_iop_t *piece,
                                      const void *const ivoid, void *const ovoid,
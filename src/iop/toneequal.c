@@ -204,7 +204,13 @@ typedef struct dt_iop_toneequalizer_data_t
 
 typedef struct dt_iop_toneequalizer_global_data_t
 {
-  // TODO: put OpenCL kernels here at some point
+  int kernel_luminance;
+  int kernel_downsample;
+  int kernel_quantize;
+  int kernel_guided_blend;
+  int kernel_eigf_blend;
+  int kernel_apply;
+  int kernel_display_mask;
 } dt_iop_toneequalizer_global_data_t;
 
 
@@ -1174,6 +1180,262 @@ void process(dt_iop_module_t *self,
   toneeq_process(self, piece, ivoid, ovoid, roi_in, roi_out);
 }
 
+#ifdef HAVE_OPENCL
+// the OpenCL code paths mirror fast_surface_blur() and fast_eigf_surface_blur():
+// scaling and blending run on the device at full resolution while the
+// variance analysis of the downscaled mask, 1/16 of the pixels for the
+// guided filter, is done on the host with the CPU code.
+static cl_int _toneeq_guided_cl(const int devid,
+                                const dt_iop_toneequalizer_global_data_t *const gd,
+                                const dt_iop_toneequalizer_data_t *const d,
+                                cl_mem luminance,
+                                const int width,
+                                const int height,
+                                const dt_iop_guided_filter_blending_t filter)
+{
+  const float scaling = 4.0f;
+  const int ds_radius = (d->radius < 4) ? 1 : d->radius / scaling;
+  const int ds_width = width / scaling;
+  const int ds_height = height / scaling;
+  if(ds_width < 1 || ds_height < 1) return DT_OPENCL_PROCESS_CL;
+
+  const size_t num_elem_ds = (size_t)ds_width * ds_height;
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  float *ds_image = NULL, *ds_mask = NULL, *ds_ab = NULL, *workspace = NULL;
+  float *const arena = fast_surface_blur_arena_alloc(num_elem_ds, &ds_image, &ds_mask, &ds_ab, &workspace);
+  cl_mem dev_ds_image = dt_opencl_alloc_device_buffer(devid, sizeof(float) * num_elem_ds);
+  cl_mem dev_ds_ab = dt_opencl_alloc_device_buffer(devid, sizeof(float) * num_elem_ds * 2);
+  if(!arena || !dev_ds_image || !dev_ds_ab) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_downsample, ds_width, ds_height,
+                                         CLARG(luminance), CLARG(width), CLARG(height),
+                                         CLARG(dev_ds_image), CLARG(ds_width), CLARG(ds_height));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_read_buffer_from_device(devid, ds_image, dev_ds_image, 0,
+                                          sizeof(float) * num_elem_ds, TRUE);
+  if(err != CL_SUCCESS) goto error;
+
+  fast_surface_blur_ds(ds_image, ds_mask, ds_ab, workspace, ds_width, ds_height, ds_radius,
+                       d->feathering, d->iterations, d->quantization, exp2f(-14.0f), 4.0f);
+
+  err = dt_opencl_write_buffer_to_device(devid, ds_ab, dev_ds_ab, 0,
+                                         sizeof(float) * num_elem_ds * 2, TRUE);
+  if(err != CL_SUCCESS) goto error;
+
+  const int geomean = filter == DT_GF_BLENDING_GEOMEAN;
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_guided_blend, width, height,
+                                         CLARG(luminance), CLARG(dev_ds_ab),
+                                         CLARG(width), CLARG(height),
+                                         CLARG(ds_width), CLARG(ds_height), CLARG(geomean));
+
+error:
+  dt_opencl_release_mem_object(dev_ds_ab);
+  dt_opencl_release_mem_object(dev_ds_image);
+  dt_free_align(arena);
+  return err;
+}
+
+static cl_int _toneeq_eigf_cl(const int devid,
+                              const dt_iop_toneequalizer_global_data_t *const gd,
+                              const dt_iop_toneequalizer_data_t *const d,
+                              cl_mem luminance,
+                              const int width,
+                              const int height,
+                              const dt_iop_guided_filter_blending_t filter)
+{
+  const float sigma = d->radius;
+  const float scaling = fmaxf(fminf(sigma, 4.0f), 1.0f);
+  const float ds_sigma = fmaxf(sigma / scaling, 1.0f);
+  const int ds_width = width / scaling;
+  const int ds_height = height / scaling;
+  if(ds_width < 1 || ds_height < 1) return DT_OPENCL_PROCESS_CL;
+
+  const gboolean use_mask = d->quantization != 0.0f;
+  const size_t num_elem_ds = (size_t)ds_width * ds_height;
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  float *const ds_image = dt_alloc_align_float(num_elem_ds);
+  float *const ds_mask = use_mask ? dt_alloc_align_float(num_elem_ds) : NULL;
+  float *const ds_av = dt_alloc_align_float(num_elem_ds * 4);
+  cl_mem dev_mask = use_mask
+    ? dt_opencl_alloc_device_buffer(devid, sizeof(float) * width * height)
+    : NULL;
+  cl_mem dev_ds_image = dt_opencl_alloc_device_buffer(devid, sizeof(float) * num_elem_ds);
+  cl_mem dev_ds_mask = use_mask
+    ? dt_opencl_alloc_device_buffer(devid, sizeof(float) * num_elem_ds)
+    : NULL;
+  cl_mem dev_ds_av = dt_opencl_alloc_device_buffer(devid, sizeof(float) * num_elem_ds * 4);
+  if(!ds_image || !ds_av || !dev_ds_image || !dev_ds_av
+     || (use_mask && (!ds_mask || !dev_mask || !dev_ds_mask)))
+    goto error;
+
+  const float qmin = exp2f(-14.0f);
+  const float qmax = 4.0f;
+  const int av_channels = use_mask ? 4 : 2;
+  const int use_mask_arg = use_mask;
+
+  for(int i = 0; i < d->iterations; i++)
+  {
+    // blend linear for all intermediate images, use filter for the last iteration
+    const int geomean = i == d->iterations - 1 && filter == DT_GF_BLENDING_GEOMEAN;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_downsample, ds_width, ds_height,
+                                           CLARG(luminance), CLARG(width), CLARG(height),
+                                           CLARG(dev_ds_image), CLARG(ds_width), CLARG(ds_height));
+    if(err != CL_SUCCESS) goto error;
+    err = dt_opencl_read_buffer_from_device(devid, ds_image, dev_ds_image, 0,
+                                            sizeof(float) * num_elem_ds, TRUE);
+    if(err != CL_SUCCESS) goto error;
+
+    if(use_mask)
+    {
+      // (re)build the mask from the quantized image to help guiding
+      err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_quantize, width, height,
+                                             CLARG(luminance), CLARG(dev_mask),
+                                             CLARG(width), CLARG(height),
+                                             CLARG(d->quantization), CLARG(qmin), CLARG(qmax));
+      if(err != CL_SUCCESS) goto error;
+      err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_downsample, ds_width, ds_height,
+                                             CLARG(dev_mask), CLARG(width), CLARG(height),
+                                             CLARG(dev_ds_mask), CLARG(ds_width), CLARG(ds_height));
+      if(err != CL_SUCCESS) goto error;
+      err = dt_opencl_read_buffer_from_device(devid, ds_mask, dev_ds_mask, 0,
+                                              sizeof(float) * num_elem_ds, TRUE);
+      if(err != CL_SUCCESS) goto error;
+
+      eigf_variance_analysis(ds_mask, ds_image, ds_av, ds_width, ds_height, ds_sigma);
+    }
+    else
+      eigf_variance_analysis_no_mask(ds_image, ds_av, ds_width, ds_height, ds_sigma);
+
+    err = dt_opencl_write_buffer_to_device(devid, ds_av, dev_ds_av, 0,
+                                           sizeof(float) * num_elem_ds * av_channels, TRUE);
+    if(err != CL_SUCCESS) goto error;
+
+    cl_mem mask = use_mask ? dev_mask : luminance;
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_eigf_blend, width, height,
+                                           CLARG(luminance), CLARG(mask), CLARG(dev_ds_av),
+                                           CLARG(width), CLARG(height),
+                                           CLARG(ds_width), CLARG(ds_height),
+                                           CLARG(use_mask_arg), CLARG(geomean),
+                                           CLARG(d->feathering));
+    if(err != CL_SUCCESS) goto error;
+  }
+
+error:
+  dt_opencl_release_mem_object(dev_ds_av);
+  dt_opencl_release_mem_object(dev_ds_mask);
+  dt_opencl_release_mem_object(dev_ds_image);
+  dt_opencl_release_mem_object(dev_mask);
+  dt_free_align(ds_av);
+  dt_free_align(ds_mask);
+  dt_free_align(ds_image);
+  return err;
+}
+
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_toneequalizer_data_t *const d = piece->data;
+  const dt_iop_toneequalizer_global_data_t *const gd = self->global_data;
+  const dt_iop_toneequalizer_gui_data_t *const g = self->gui_data;
+
+  // the preview pipe keeps the luminance mask on the host for the gui,
+  // histogram and cursor readings
+  if(piece->colors != 4
+     || roi_in->width != roi_out->width
+     || roi_in->height != roi_out->height
+     || (self->dev->gui_attached && dt_pipe_is_preview(piece->pipe)))
+    return DT_OPENCL_PROCESS_CL;
+
+  const int devid = piece->pipe->devid;
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  const gboolean display_mask =
+    g && self->dev->gui_attached && dt_pipe_is_full(piece->pipe) && g->mask_display;
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem luminance = dt_opencl_alloc_device_buffer(devid, sizeof(float) * width * height);
+  cl_mem lut = dt_opencl_copy_host_to_device_constant(devid, sizeof(d->correction_lut),
+                                                      (void *)d->correction_lut);
+  if(!luminance || !lut) goto error;
+
+  // contrast boosting is only done for the plain guided filters, see compute_luminance_mask()
+  const gboolean boost = d->details == DT_TONEEQ_GUIDED || d->details == DT_TONEEQ_EIGF;
+  const float fulcrum = boost ? CONTRAST_FULCRUM : 0.0f;
+  const float contrast_boost = boost ? d->contrast_boost : 1.0f;
+  const int method = d->method;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_luminance, width, height,
+                                         CLARG(dev_in), CLARG(luminance),
+                                         CLARG(width), CLARG(height), CLARG(method),
+                                         CLARG(d->exposure_boost), CLARG(fulcrum),
+                                         CLARG(contrast_boost));
+  if(err != CL_SUCCESS) goto error;
+
+  switch(d->details)
+  {
+    case DT_TONEEQ_AVG_GUIDED:
+      err = _toneeq_guided_cl(devid, gd, d, luminance, width, height, DT_GF_BLENDING_GEOMEAN);
+      break;
+    case DT_TONEEQ_GUIDED:
+      err = _toneeq_guided_cl(devid, gd, d, luminance, width, height, DT_GF_BLENDING_LINEAR);
+      break;
+    case DT_TONEEQ_AVG_EIGF:
+      err = _toneeq_eigf_cl(devid, gd, d, luminance, width, height, DT_GF_BLENDING_GEOMEAN);
+      break;
+    case DT_TONEEQ_EIGF:
+      err = _toneeq_eigf_cl(devid, gd, d, luminance, width, height, DT_GF_BLENDING_LINEAR);
+      break;
+    default:
+      break;
+  }
+  if(err != CL_SUCCESS) goto error;
+
+  if(display_mask)
+  {
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_display_mask, width, height,
+                                           CLARG(dev_in), CLARG(luminance), CLARG(dev_out),
+                                           CLARG(width), CLARG(height));
+    piece->pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_PASSTHRU;
+  }
+  else
+  {
+    const float lutres = LUT_RESOLUTION;
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_apply, width, height,
+                                           CLARG(dev_in), CLARG(luminance), CLARG(dev_out),
+                                           CLARG(width), CLARG(height),
+                                           CLARG(lut), CLARG(lutres));
+  }
+
+error:
+  dt_opencl_release_mem_object(lut);
+  dt_opencl_release_mem_object(luminance);
+  return err;
+}
+#endif
+
+void tiling_callback(dt_iop_module_t *self,
+                     dt_dev_pixelpipe_iop_t *piece,
+                     const dt_iop_roi_t *roi_in,
+                     const dt_iop_roi_t *roi_out,
+                     dt_develop_tiling_t *tiling)
+{
+  tiling->factor = 2.0f;
+  // the luminance and quantized masks at full resolution on the device
+  tiling->factor_cl = 2.5f;
+  tiling->maxbuf = 1.0f;
+  tiling->maxbuf_cl = 1.0f;
+  tiling->overhead = 0;
+  tiling->overlap = 0;
+  tiling->align = 1;
+}
 
 void modify_roi_in(dt_iop_module_t *self,
                    dt_dev_pixelpipe_iop_t *piece,
@@ -1565,14 +1827,30 @@ static inline gboolean update_curve_lut(dt_iop_module_t *self)
 
 void init_global(dt_iop_module_so_t *self)
 {
+  const int program = 42; // toneequal.cl, from programs.conf
   dt_iop_toneequalizer_global_data_t *gd = malloc(sizeof(dt_iop_toneequalizer_global_data_t));
 
   self->data = gd;
+  gd->kernel_luminance = dt_opencl_create_kernel(program, "toneeq_luminance");
+  gd->kernel_downsample = dt_opencl_create_kernel(program, "toneeq_downsample");
+  gd->kernel_quantize = dt_opencl_create_kernel(program, "toneeq_quantize");
+  gd->kernel_guided_blend = dt_opencl_create_kernel(program, "toneeq_guided_blend");
+  gd->kernel_eigf_blend = dt_opencl_create_kernel(program, "toneeq_eigf_blend");
+  gd->kernel_apply = dt_opencl_create_kernel(program, "toneeq_apply");
+  gd->kernel_display_mask = dt_opencl_create_kernel(program, "toneeq_display_mask");
 }
 
 
 void cleanup_global(dt_iop_module_so_t *self)
 {
+  dt_iop_toneequalizer_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_luminance);
+  dt_opencl_free_kernel(gd->kernel_downsample);
+  dt_opencl_free_kernel(gd->kernel_quantize);
+  dt_opencl_free_kernel(gd->kernel_guided_blend);
+  dt_opencl_free_kernel(gd->kernel_eigf_blend);
+  dt_opencl_free_kernel(gd->kernel_apply);
+  dt_opencl_free_kernel(gd->kernel_display_mask);
   free(self->data);
   self->data = NULL;
 }
@@ -17,6 +17,7 @@
 */
 
 #include "bauhaus/bauhaus.h"
+#include "common/artifact_cache.h"
 #include "common/imagebuf.h"
 #include "common/math.h"
 #include "common/tags.h"
@@ -553,6 +554,20 @@ static gchar *_string_substitute(gchar *string,
   return result;
 }
 
+// the last parsed svg document, exports of images with the same
+// expanded document reuse it. only used under darktable.plugin_threadsafe
+static struct
+{
+  dt_hash_t hash;
+  RsvgHandle *svg;
+} _watermark_svg;
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  if(_watermark_svg.svg) g_object_unref(_watermark_svg.svg);
+  _watermark_svg.svg = NULL;
+}
+
 static gchar *_watermark_get_svgdoc(dt_iop_module_t *self,
                                     const dt_iop_watermark_data_t *data,
                                     const dt_image_t *image,
@@ -730,11 +745,24 @@ void process(dt_iop_module_t *self,
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
 
   RsvgHandle *svg = NULL;
+  dt_hash_t svg_hash = DT_INVALID_HASH;
   if(type == DT_WTM_SVG)
   {
-    /* create the rsvghandle from parsed svg data */
+    svg_hash = dt_hash(DT_INITHASH, svgdoc, strlen(svgdoc));
     GError *error = NULL;
-    svg = rsvg_handle_new_from_data((const guint8 *)svgdoc, strlen(svgdoc), &error);
+    if(_watermark_svg.svg && _watermark_svg.hash == svg_hash)
+      svg = g_object_ref(_watermark_svg.svg);
+    else
+    {
+      /* create the rsvghandle from parsed svg data */
+      svg = rsvg_handle_new_from_data((const guint8 *)svgdoc, strlen(svgdoc), &error);
+      if(svg && !error)
+      {
+        if(_watermark_svg.svg) g_object_unref(_watermark_svg.svg);
+        _watermark_svg.svg = g_object_ref(svg);
+        _watermark_svg.hash = svg_hash;
+      }
+    }
     g_free(svgdoc);
     if(!svg || error)
     {
@@ -951,6 +979,10 @@ void process(dt_iop_module_t *self,
 
   float svg_offset_x = 0;
   float svg_offset_y = 0;
+  // the rendered watermark only depends on the document and its scale
+  dt_hash_t raster_key = DT_INVALID_HASH;
+  size_t raster_size = 0;
+  gboolean rendered = FALSE;
   if(type == DT_WTM_SVG)
   {
     /* the svg_offsets allow safe text boxes as they might render out
@@ -974,6 +1006,13 @@ void process(dt_iop_module_t *self,
       dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
       return;
     }
+    raster_size = (size_t)watermark_height * stride_two;
+    raster_key = dt_artifact_key_init("watermark svg");
+    raster_key = dt_artifact_key_add(raster_key, &svg_hash, sizeof(svg_hash));
+    raster_key = dt_artifact_key_add(raster_key, &scale, sizeof(scale));
+    raster_key = dt_artifact_key_add(raster_key, &watermark_width, sizeof(int));
+    rendered = dt_artifact_cache_get(raster_key, image_two, raster_size);
+
     surface_two = cairo_image_surface_create_for_data(image_two,
                                                       CAIRO_FORMAT_ARGB32,
                                                       watermark_width,
@@ -1044,9 +1083,12 @@ void process(dt_iop_module_t *self,
   switch(type)
   {
     case DT_WTM_SVG:
+      if(rendered) break;
       cairo_scale(cr_two, scale, scale);
       /* render svg into surface*/
       dt_render_svg(svg, cr_two, dimension.width, dimension.height, 0, 0);
+      cairo_surface_flush(surface_two);
+      dt_artifact_cache_put(raster_key, image_two, raster_size);
       break;
     case DT_WTM_PNG:
       cairo_scale(cr, scale, scale);
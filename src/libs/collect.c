@@ -23,6 +23,7 @@
 #include "common/datetime.h"
 #include "common/debug.h"
 #include "common/film.h"
+#include "common/library_counts.h"
 #include "common/map_locations.h"
 #include "common/metadata.h"
 #include "common/utility.h"
@@ -164,6 +165,13 @@ static int _is_time_property(const int property);
 
 static void _populate_collect_combo(GtkWidget *w);
 
+// the extended where of a rule is empty or "1=1" when no other rule
+// restricts its counts
+static gboolean _where_is_whole_library(const gchar *where_ext)
+{
+  return !where_ext || !g_strcmp0(where_ext, "") || !g_strcmp0(where_ext, "1=1");
+}
+
 static gint _sort_filmroll_by_display_name(gconstpointer a, gconstpointer b)
 {
   const filmroll_row_t *ra = a;
@@ -1453,21 +1461,33 @@ static void _tree_view(dt_lib_collect_rule_t *dr)
 
     /* query construction */
     gchar *where_ext = dt_collection_get_extended_where(darktable.collection, dr->num);
+    // without other rules the counts are those of the whole library
+    const gboolean counts = _where_is_whole_library(where_ext) && dt_library_counts_ready();
     gchar *query = NULL;
     switch(property)
     {
       case DT_COLLECTION_PROP_FOLDERS:
-        // clang-format off
-        query = g_strdup_printf
-          ("SELECT folder, film_rolls_id, COUNT(*) AS count, status"
-           " FROM main.images AS mi"
-           " JOIN (SELECT fr.id AS film_rolls_id, folder, status"
-           "       FROM main.film_rolls AS fr"
-           "       JOIN memory.film_folder AS ff"
-           "       ON fr.id = ff.id)"
-           "   ON film_id = film_rolls_id "
-           " WHERE %s"
-           " GROUP BY folder, film_rolls_id", where_ext);
+        if(counts)
+          // clang-format off
+          query = g_strdup
+            ("SELECT folder, fr.id AS film_rolls_id, fc.count AS count, status"
+             " FROM main.film_rolls AS fr"
+             " JOIN memory.film_folder AS ff ON fr.id = ff.id"
+             " JOIN memory.film_counts AS fc ON fc.id = fr.id"
+             " WHERE fc.count > 0");
+          // clang-format on
+        else
+          // clang-format off
+          query = g_strdup_printf
+            ("SELECT folder, film_rolls_id, COUNT(*) AS count, status"
+             " FROM main.images AS mi"
+             " JOIN (SELECT fr.id AS film_rolls_id, folder, status"
+             "       FROM main.film_rolls AS fr"
+             "       JOIN memory.film_folder AS ff"
+             "       ON fr.id = ff.id)"
+             "   ON film_id = film_rolls_id "
+             " WHERE %s"
+             " GROUP BY folder, film_rolls_id", where_ext);
           // clang-format on
         break;
 
@@ -1476,7 +1496,24 @@ static void _tree_view(dt_lib_collect_rule_t *dr)
         const gboolean is_insensitive =
           dt_conf_is_equal("plugins/lighttable/tagging/case_sensitivity", "insensitive");
 
-        if(is_insensitive)
+        if(counts && is_insensitive)
+          // clang-format off
+          query = g_strdup
+            ("SELECT name, 1 AS tagid, SUM(count) AS count"
+             " FROM (SELECT id AS tagid, count FROM memory.tag_counts WHERE count > 0)"
+             " JOIN (SELECT lower(name) AS name, id AS tag_id FROM data.tags)"
+             "   ON tagid = tag_id"
+             "   GROUP BY name");
+          // clang-format on
+        else if(counts)
+          // clang-format off
+          query = g_strdup
+            ("SELECT name, tagid, count"
+             " FROM (SELECT id AS tagid, count FROM memory.tag_counts WHERE count > 0)"
+             " JOIN (SELECT name, id AS tag_id FROM data.tags)"
+             "   ON tagid = tag_id");
+          // clang-format on
+        else if(is_insensitive)
           // clang-format off
           query = g_strdup_printf
             ("SELECT name, 1 AS tagid, SUM(count) AS count"
@@ -1610,7 +1647,9 @@ static void _tree_view(dt_lib_collect_rule_t *dr)
 
     g_free(where_ext);
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    // the counts are only read, don't wait for a writer
+    sqlite3 *reader = dt_database_get_reader(darktable.db);
+    DT_DEBUG_SQLITE3_PREPARE_V2(reader, query, -1, &stmt, NULL);
 
     char **last_tokens = NULL;
     int last_tokens_length = 0;
@@ -1673,6 +1712,7 @@ static void _tree_view(dt_lib_collect_rule_t *dr)
       sorted_names = g_list_prepend(sorted_names, tuple);
     }
     sqlite3_finalize(stmt);
+    dt_database_release_reader(darktable.db, reader);
     g_free(query);
 
     // this order should not be altered. the right feeding of the tree relies on it.
@@ -1946,18 +1986,30 @@ static void _list_view(dt_lib_collect_rule_t *dr)
     switch(property)
     {
       case DT_COLLECTION_PROP_CAMERA:; // camera
-        // clang-format off
-        g_snprintf(query, sizeof(query),
-                   "SELECT TRIM(cm.maker || ' ' || cm.model) AS camera,"
-                   "       1, COUNT(*) AS count"
-                   "  FROM main.images AS mi, main.cameras AS cm"
-                   "  WHERE mi.camera_id = cm.id"
-                   "    AND %s "
-                   "  GROUP BY LOWER(camera)"
-                   "  ORDER BY LOWER(camera) %s",
-                   where_ext,
-                   sort_descending ? "DESC" : "ASC");
-        // clang-format on
+        if(_where_is_whole_library(where_ext) && dt_library_counts_ready())
+          // clang-format off
+          g_snprintf(query, sizeof(query),
+                     "SELECT TRIM(cm.maker || ' ' || cm.model) AS camera,"
+                     "       1, SUM(cc.count) AS count"
+                     "  FROM memory.camera_counts AS cc, main.cameras AS cm"
+                     "  WHERE cc.id = cm.id AND cc.count > 0"
+                     "  GROUP BY LOWER(camera)"
+                     "  ORDER BY LOWER(camera) %s",
+                     sort_descending ? "DESC" : "ASC");
+          // clang-format on
+        else
+          // clang-format off
+          g_snprintf(query, sizeof(query),
+                     "SELECT TRIM(cm.maker || ' ' || cm.model) AS camera,"
+                     "       1, COUNT(*) AS count"
+                     "  FROM main.images AS mi, main.cameras AS cm"
+                     "  WHERE mi.camera_id = cm.id"
+                     "    AND %s "
+                     "  GROUP BY LOWER(camera)"
+                     "  ORDER BY LOWER(camera) %s",
+                     where_ext,
+                     sort_descending ? "DESC" : "ASC");
+          // clang-format on
         break;
 
       case DT_COLLECTION_PROP_HISTORY: // History
@@ -2348,7 +2400,9 @@ static void _list_view(dt_lib_collect_rule_t *dr)
 
     if(strlen(query) > 0)
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+      // the counts are only read, don't wait for a writer
+      sqlite3 *reader = dt_database_get_reader(darktable.db);
+      DT_DEBUG_SQLITE3_PREPARE_V2(reader, query, -1, &stmt, NULL);
 
       GList *rows = NULL;
 
@@ -2511,6 +2565,7 @@ static void _list_view(dt_lib_collect_rule_t *dr)
       }
 
       sqlite3_finalize(stmt);
+      dt_database_release_reader(darktable.db, reader);
     }
 
     gtk_tree_view_set_tooltip_column(GTK_TREE_VIEW(d->view), DT_LIB_COLLECT_COL_TOOLTIP);
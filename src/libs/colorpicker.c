@@ -907,6 +907,7 @@ void gui_reset(dt_lib_module_t *self)
     }
     data->primary_sample.label_rgb[i] = 0;
   }
+  data->primary_sample.picked_hash = 0;
   data->primary_sample.swatch.red = data->primary_sample.swatch.green
     = data->primary_sample.swatch.blue = 0.0;
 
@@ -60,6 +60,8 @@ typedef struct dt_colorpicker_sample_t
   lib_colorpicker_stats scope;
   // picked color converted display profile -> Lab
   lib_colorpicker_stats lab;
+  // what the colors were picked from, to skip unchanged samples
+  dt_hash_t picked_hash;
   // in scope profile with current statistic
   int label_rgb[4];
   // in display profile with current statistic
@@ -319,7 +319,184 @@ static void _scale_optim()
   free(scale_str);
 }
 
-static void _export_with_current_settings(dt_lib_module_t *self)
+/* the persistent export queue: every export is a batch holding the settings
+   of the module, the same blob as for presets, and one row per image which
+   the export job marks as done. batches left over when darktable was closed
+   or crashed are offered to be resumed on the next start. a batch resumed
+   twice without exporting a single image is dropped, it might be the one
+   crashing darktable. */
+static int _export_queue_add(dt_lib_module_t *self,
+                             GList *imgs)
+{
+  if(!imgs) return 0;
+
+  int size = 0;
+  void *params = get_params(self, &size);
+  if(!params) return 0;
+
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+  dt_database_start_transaction(darktable.db);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO main.export_batches (params, created)"
+                              " VALUES (?1, strftime('%s', 'now'))",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 1, params, size, SQLITE_TRANSIENT);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  const int batch = sqlite3_last_insert_rowid(db);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO main.export_queue (batch, position, imgid)"
+                              " VALUES (?1, ?2, ?3)",
+                              -1, &stmt, NULL);
+  int position = 0;
+  for(const GList *l = imgs; l; l = g_list_next(l))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, batch);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, position++);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, GPOINTER_TO_INT(l->data));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  dt_database_release_transaction(darktable.db);
+
+  free(params);
+  return batch;
+}
+
+static void _export_with_current_settings(dt_lib_module_t *self,
+                                          GList *resume,
+                                          const int resume_batch);
+
+static gboolean _export_queue_resume(gpointer user_data)
+{
+  dt_lib_module_t *self = user_data;
+  sqlite3 *db = dt_database_get(darktable.db);
+
+  // clang-format off
+  // images removed since, and images exported but edited since, which are exported again
+  sqlite3_exec(db,
+               "DELETE FROM main.export_queue"
+               " WHERE imgid NOT IN (SELECT id FROM main.images)", NULL, NULL, NULL);
+  sqlite3_exec(db,
+               "UPDATE main.export_queue SET done = 0"
+               " WHERE done = 1"
+               "   AND history_hash IS NOT (SELECT current_hash FROM main.history_hash AS h"
+               "                            WHERE h.imgid = export_queue.imgid)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db,
+               "DELETE FROM main.export_queue"
+               " WHERE batch NOT IN (SELECT batch FROM main.export_queue WHERE done = 0)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db,
+               "DELETE FROM main.export_batches"
+               " WHERE id NOT IN (SELECT batch FROM main.export_queue)", NULL, NULL, NULL);
+  // clang-format on
+
+  sqlite3_stmt *stmt, *imgs_stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT id FROM main.export_batches WHERE attempts >= 2",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int batch = sqlite3_column_int(stmt, 0);
+    dt_print(DT_DEBUG_ALWAYS, "[export] export batch %d failed to resume twice, dropped", batch);
+    dt_control_export_queue_remove(batch);
+  }
+  sqlite3_finalize(stmt);
+
+  int pending = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT COUNT(*) FROM main.export_queue WHERE done = 0",
+                              -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW) pending = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  if(pending == 0) return G_SOURCE_REMOVE;
+
+  if(!dt_conf_get_bool(CONFIG_PREFIX "resume_queue")
+     || !dt_gui_show_yes_no_dialog(_("resume exports"), "",
+                                   ngettext("resume the interrupted export of %d image?",
+                                            "resume the interrupted export of %d images?",
+                                            pending), pending))
+  {
+    sqlite3_exec(db, "DELETE FROM main.export_queue", NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM main.export_batches", NULL, NULL, NULL);
+    return G_SOURCE_REMOVE;
+  }
+
+  // the batches are run with their own settings, restore the current ones afterwards
+  int params_size = 0;
+  void *params = NULL;
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT id, params FROM main.export_batches ORDER BY id",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT imgid FROM main.export_queue"
+                              " WHERE batch = ?1 AND done = 0"
+                              " ORDER BY position",
+                              -1, &imgs_stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int batch = sqlite3_column_int(stmt, 0);
+    if(!params) params = get_params(self, &params_size);
+
+    // settings of a module no longer there or of an older version
+    if(set_params(self, sqlite3_column_blob(stmt, 1), sqlite3_column_bytes(stmt, 1)))
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[export] can't resume the export batch %d, dropped", batch);
+      dt_control_export_queue_remove(batch);
+      continue;
+    }
+
+    dt_lib_export_t *d = self->data;
+    if(d->storage_module->storage_login
+       && !d->storage_module->storage_login(d->storage_module))
+    {
+      dt_control_log(_("could not login to storage `%s'!"),
+                     d->storage_module->name(d->storage_module));
+      dt_control_export_queue_remove(batch);
+      continue;
+    }
+
+    sqlite3_stmt *attempt_stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "UPDATE main.export_batches SET attempts = attempts + 1"
+                                " WHERE id = ?1",
+                                -1, &attempt_stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(attempt_stmt, 1, batch);
+    sqlite3_step(attempt_stmt);
+    sqlite3_finalize(attempt_stmt);
+
+    GList *imgs = NULL;
+    DT_DEBUG_SQLITE3_BIND_INT(imgs_stmt, 1, batch);
+    while(sqlite3_step(imgs_stmt) == SQLITE_ROW)
+      imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(imgs_stmt, 0)));
+    sqlite3_reset(imgs_stmt);
+    imgs = g_list_reverse(imgs);
+
+    const int count = g_list_length(imgs);
+    dt_control_log(ngettext("resuming the interrupted export of %d image",
+                            "resuming the interrupted export of %d images", count), count);
+    _export_with_current_settings(self, imgs, batch);
+  }
+  sqlite3_finalize(imgs_stmt);
+  sqlite3_finalize(stmt);
+
+  if(params)
+  {
+    set_params(self, params, params_size);
+    free(params);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// export the images to act on, or the images left of an interrupted batch
+static void _export_with_current_settings(dt_lib_module_t *self,
+                                          GList *resume,
+                                          const int resume_batch)
 {
   dt_lib_export_t *d = self->data;
 
@@ -341,14 +518,16 @@ static void _export_with_current_settings(dt_lib_module_t *self)
   const int storage_index =
     dt_imageio_get_index_of_storage(dt_imageio_get_storage_by_name(storage_name));
 
-  if(format_index == -1)
-  {
-    dt_control_log(_("invalid format for export selected"));
-    return;
-  }
-  if(storage_index == -1)
+  if(format_index == -1 || storage_index == -1)
   {
-    dt_control_log(_("invalid storage for export selected"));
+    dt_control_log(format_index == -1
+                   ? _("invalid format for export selected")
+                   : _("invalid storage for export selected"));
+    if(resume)
+    {
+      g_list_free(resume);
+      dt_control_export_queue_remove(resume_batch);
+    }
     return;
   }
 
@@ -366,6 +545,11 @@ static void _export_with_current_settings(dt_lib_module_t *self)
 
     if(!res)
     {
+      if(resume)
+      {
+        g_list_free(resume);
+        dt_control_export_queue_remove(resume_batch);
+      }
       return;
     }
   }
@@ -417,13 +601,14 @@ static void _export_with_current_settings(dt_lib_module_t *self)
   gchar *icc_filename = dt_conf_get_string(CONFIG_PREFIX "iccprofile");
   const dt_iop_color_intent_t icc_intent = dt_conf_get_int(CONFIG_PREFIX "iccintent");
 
-  GList *list = dt_act_on_get_images(TRUE, TRUE, TRUE);
+  GList *list = resume ? resume : dt_act_on_get_images(TRUE, TRUE, TRUE);
+  const int batch = resume ? resume_batch : _export_queue_add(self, list);
   dt_control_export(list, max_width, max_height, format_index, storage_index,
                     high_quality, upscale, scaledimension,
                     is_scaling, scale_factor,
                     export_masks, style, style_append,
                     icc_type, icc_filename, icc_intent,
-                    d->metadata_export);
+                    d->metadata_export, batch);
 
   g_free(icc_filename);
 
@@ -461,7 +646,7 @@ static void _export_with_preset(const gchar *preset_name, dt_lib_module_t *self)
       login = d->storage_module->storage_login(d->storage_module);
 
     if(login)
-      _export_with_current_settings(self);
+      _export_with_current_settings(self, NULL, 0);
     else
       dt_control_log(_("could not login to storage `%s'!"), d->storage_module->name(d->storage_module));
   }
@@ -473,7 +658,7 @@ static void _export_with_preset(const gchar *preset_name, dt_lib_module_t *self)
 
 static void _export_button_clicked(GtkWidget *widget, dt_lib_module_t *self)
 {
-  _export_with_current_settings(self);
+  _export_with_current_settings(self, NULL, 0);
 }
 
 static void _batch_export_button_clicked(GtkWidget *widget, dt_lib_module_t *self)
@@ -1815,6 +2000,9 @@ void gui_init(dt_lib_module_t *self)
   DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_COLLECTION_CHANGED, _collection_updated_callback);
   DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_IMAGEIO_STORAGE_EXPORT_ENABLE, _export_enable_callback);
   DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_PRESETS_CHANGED, _export_presets_changed_callback);
+
+  // once the gui is up
+  g_idle_add(_export_queue_resume, self);
 }
 
 void gui_cleanup(dt_lib_module_t *self)
@@ -20,6 +20,7 @@
 #include "common/collection.h"
 #include "common/darktable.h"
 #include "common/metadata.h"
+#include "common/phash.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "control/jobs.h"
@@ -118,6 +119,30 @@ typedef struct dt_lib_filtering_rule_t
   struct dt_lib_filtering_t *lib;
 } dt_lib_filtering_rule_t;
 
+// numeric image columns kept in memory for the histograms of the range widgets
+typedef enum _column_t
+{
+  _COLUMN_EXPOSURE = 0,
+  _COLUMN_APERTURE,
+  _COLUMN_ISO,
+  _COLUMN_FOCAL_LENGTH,
+  _COLUMN_EXPOSURE_BIAS,
+  _COLUMN_LAST
+} _column_t;
+
+#define _COLUMN_NO_DATE INT64_MIN
+
+typedef struct _columns_t
+{
+  int count;
+  dt_imgid_t *id;          // ascending
+  double *value[_COLUMN_LAST];
+  int64_t *datetime_taken; // _COLUMN_NO_DATE when not set
+  uint8_t *match;          // images matching last_where_ext
+  gboolean loaded;
+  gboolean match_valid;
+} _columns_t;
+
 typedef struct dt_lib_filtering_t
 {
   dt_lib_filtering_rule_t rule[DT_COLLECTION_MAX_RULES];
@@ -137,6 +162,7 @@ typedef struct dt_lib_filtering_t
   struct dt_lib_filtering_params_t *params;
 
   gchar *last_where_ext;
+  _columns_t columns;
 } dt_lib_filtering_t;
 
 typedef struct dt_lib_filtering_params_rule_t
@@ -203,6 +229,235 @@ typedef struct _filter_t
 } _filter_t;
 
 
+static void _columns_free(_columns_t *c)
+{
+  g_free(c->id);
+  for(int k = 0; k < _COLUMN_LAST; k++) g_free(c->value[k]);
+  g_free(c->datetime_taken);
+  g_free(c->match);
+  memset(c, 0, sizeof(_columns_t));
+}
+
+#define _COLUMNS_SELECT "SELECT id, exposure, aperture, iso, focal_length," \
+                        " exposure_bias, datetime_taken FROM main.images"
+
+static void _columns_set_row(_columns_t *c, const int i, sqlite3_stmt *stmt)
+{
+  for(int k = 0; k < _COLUMN_LAST; k++)
+    c->value[k][i] = sqlite3_column_double(stmt, k + 1);
+  c->datetime_taken[i] = sqlite3_column_type(stmt, _COLUMN_LAST + 1) == SQLITE_NULL
+    ? _COLUMN_NO_DATE
+    : sqlite3_column_int64(stmt, _COLUMN_LAST + 1);
+}
+
+// load the columns of all the images once, the range widgets then
+// compute their histograms out of them instead of a GROUP BY each
+static gboolean _columns_load(_columns_t *c)
+{
+  _columns_free(c);
+
+  sqlite3 *db = dt_database_get_reader(darktable.db);
+  sqlite3_stmt *stmt;
+  int count = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT COUNT(*) FROM main.images", -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW) count = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  c->id = g_try_new(dt_imgid_t, count + 1);
+  gboolean ok = c->id != NULL;
+  for(int k = 0; k < _COLUMN_LAST; k++)
+  {
+    c->value[k] = g_try_new(double, count + 1);
+    ok = ok && c->value[k];
+  }
+  c->datetime_taken = g_try_new(int64_t, count + 1);
+  c->match = g_try_new0(uint8_t, count + 1);
+  ok = ok && c->datetime_taken && c->match;
+
+  if(ok)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, _COLUMNS_SELECT " ORDER BY id", -1, &stmt, NULL);
+    int i = 0;
+    while(i < count && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      c->id[i] = sqlite3_column_int(stmt, 0);
+      _columns_set_row(c, i, stmt);
+      i++;
+    }
+    sqlite3_finalize(stmt);
+    c->count = i;
+  }
+  dt_database_release_reader(darktable.db, db);
+
+  if(!ok)
+  {
+    _columns_free(c);
+    return FALSE;
+  }
+  c->loaded = TRUE;
+  return TRUE;
+}
+
+static int _columns_find(const _columns_t *c, const dt_imgid_t imgid)
+{
+  int lo = 0, hi = c->count - 1;
+  while(lo <= hi)
+  {
+    const int mid = lo + (hi - lo) / 2;
+    if(c->id[mid] == imgid) return mid;
+    if(c->id[mid] < imgid) lo = mid + 1;
+    else hi = mid - 1;
+  }
+  return -1;
+}
+
+// flag the images of the current filters, loading the columns again if
+// an image unknown to them shows up (import, duplicate...)
+static gboolean _columns_update_match(dt_lib_filtering_t *d)
+{
+  _columns_t *c = &d->columns;
+  if(c->loaded && c->match_valid) return TRUE;
+
+  for(int attempt = 0; attempt < 2; attempt++)
+  {
+    if(!c->loaded && !_columns_load(c)) return FALSE;
+
+    memset(c->match, 0, c->count);
+    gchar *query = g_strdup_printf("SELECT id FROM main.images AS mi WHERE %s",
+                                   d->last_where_ext);
+    sqlite3 *db = dt_database_get_reader(darktable.db);
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+    gboolean complete = TRUE;
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const int i = _columns_find(c, sqlite3_column_int(stmt, 0));
+      if(i < 0)
+      {
+        complete = FALSE;
+        break;
+      }
+      c->match[i] = 1;
+    }
+    sqlite3_finalize(stmt);
+    dt_database_release_reader(darktable.db, db);
+    g_free(query);
+
+    if(complete)
+    {
+      c->match_valid = TRUE;
+      return TRUE;
+    }
+    c->loaded = FALSE;
+  }
+  return FALSE;
+}
+
+// read again the columns of the given images
+static void _columns_refresh(_columns_t *c, GList *imgs)
+{
+  if(!c->loaded) return;
+
+  sqlite3 *db = dt_database_get_reader(darktable.db);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, _COLUMNS_SELECT " WHERE id = ?1", -1, &stmt, NULL);
+  for(GList *l = imgs; l; l = g_list_next(l))
+  {
+    const int i = _columns_find(c, GPOINTER_TO_INT(l->data));
+    if(i < 0) continue;
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, c->id[i]);
+    if(sqlite3_step(stmt) == SQLITE_ROW) _columns_set_row(c, i, stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+  }
+  sqlite3_finalize(stmt);
+  dt_database_release_reader(darktable.db, db);
+}
+
+static int _columns_cmp_double(const void *a, const void *b)
+{
+  const double da = *(const double *)a, db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+static int _columns_cmp_int64(const void *a, const void *b)
+{
+  const int64_t ia = *(const int64_t *)a, ib = *(const int64_t *)b;
+  return (ia > ib) - (ia < ib);
+}
+
+// fill the range widgets with the histogram of a column among the
+// filtered images, rounded to the given number of decimals (< 0 to keep
+// the raw values). the blocks come sorted like the GROUP BY did.
+static gboolean _columns_add_blocks(dt_lib_filtering_t *d,
+                                    const _column_t column,
+                                    const int decimals,
+                                    GtkDarktableRangeSelect *range,
+                                    GtkDarktableRangeSelect *rangetop)
+{
+  if(!_columns_update_match(d)) return FALSE;
+
+  const _columns_t *c = &d->columns;
+  double *keys = g_try_new(double, c->count + 1);
+  if(!keys) return FALSE;
+
+  const double *value = c->value[column];
+  const double scale = decimals >= 0 ? pow(10.0, decimals) : 1.0;
+  int n = 0;
+  for(int i = 0; i < c->count; i++)
+  {
+    if(!c->match[i]) continue;
+    keys[n++] = decimals >= 0 ? round(value[i] * scale) / scale : value[i];
+  }
+  qsort(keys, n, sizeof(double), _columns_cmp_double);
+
+  dtgtk_range_select_reset_blocks(range);
+  if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
+  for(int i = 0; i < n;)
+  {
+    int j = i + 1;
+    while(j < n && keys[j] == keys[i]) j++;
+    dtgtk_range_select_add_block(range, keys[i], j - i);
+    if(rangetop) dtgtk_range_select_add_block(rangetop, keys[i], j - i);
+    i = j;
+  }
+  g_free(keys);
+  return TRUE;
+}
+
+static gboolean _columns_add_date_blocks(dt_lib_filtering_t *d,
+                                         GtkDarktableRangeSelect *range,
+                                         GtkDarktableRangeSelect *rangetop)
+{
+  if(!_columns_update_match(d)) return FALSE;
+
+  const _columns_t *c = &d->columns;
+  int64_t *keys = g_try_new(int64_t, c->count + 1);
+  if(!keys) return FALSE;
+
+  int n = 0;
+  for(int i = 0; i < c->count; i++)
+  {
+    if(c->match[i] && c->datetime_taken[i] != _COLUMN_NO_DATE)
+      keys[n++] = c->datetime_taken[i];
+  }
+  qsort(keys, n, sizeof(int64_t), _columns_cmp_int64);
+
+  dtgtk_range_select_reset_blocks(range);
+  if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
+  for(int i = 0; i < n;)
+  {
+    int j = i + 1;
+    while(j < n && keys[j] == keys[i]) j++;
+    dtgtk_range_select_add_block(range, keys[i], j - i);
+    if(rangetop) dtgtk_range_select_add_block(rangetop, keys[i], j - i);
+    i = j;
+  }
+  g_free(keys);
+  return TRUE;
+}
+
+
 // filters definitions
 #include "libs/filters/aperture.c"
 #include "libs/filters/colors.c"
@@ -1454,6 +1709,23 @@ static void _dt_collection_updated(gpointer instance, dt_collection_change_t que
   else
     g_free(where_ext);
 
+  // the same filters may match other images now
+  d->columns.match_valid = FALSE;
+
+  for(int i = 0; i <= d->nb_rules; i++)
+  {
+    _widget_update(&d->rule[i]);
+  }
+}
+
+static void _image_info_changed(gpointer instance, gpointer imgs, gpointer self)
+{
+  dt_lib_module_t *dm = (dt_lib_module_t *)self;
+  dt_lib_filtering_t *d = dm->data;
+
+  if(!d->columns.loaded) return;
+
+  _columns_refresh(&d->columns, imgs);
   for(int i = 0; i <= d->nb_rules; i++)
   {
     _widget_update(&d->rule[i]);
@@ -2260,6 +2532,7 @@ void gui_init(dt_lib_module_t *self)
 
   DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_COLLECTION_CHANGED, _dt_collection_updated);
   DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_IMAGES_ORDER_CHANGE, _dt_images_order_change);
+  DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_IMAGE_INFO_CHANGED, _image_info_changed);
 }
 
 void gui_cleanup(dt_lib_module_t *self)
@@ -2273,6 +2546,7 @@ void gui_cleanup(dt_lib_module_t *self)
 
   darktable.view_manager->proxy.module_filtering.module = NULL;
   free(d->params);
+  _columns_free(&d->columns);
 
   /* TODO: Make sure we are cleaning up all allocations */
 
@@ -49,29 +49,34 @@ static gboolean _date_update(dt_lib_filtering_rule_t *rule)
 
   rule->manual_widget_set++;
   // first, we update the graph
-  gchar *colname = _date_get_db_colname(rule);
-  char query[1024] = { 0 };
-  // clang-format off
-  g_snprintf(query, sizeof(query),
-             "SELECT %s AS date, COUNT(*) AS count"
-             " FROM main.images AS mi"
-             " WHERE %s IS NOT NULL AND %s"
-             " GROUP BY date",
-             colname, colname, d->last_where_ext);
-  // clang-format on
-  g_free(colname);
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  dtgtk_range_select_reset_blocks(range);
-  if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  // out of the in-memory columns, or from the database if they can't be loaded
+  if((rule->prop != DT_COLLECTION_PROP_TIME && rule->prop != DT_COLLECTION_PROP_DAY)
+     || !_columns_add_date_blocks(d, range, rangetop))
   {
-    const int count = sqlite3_column_int(stmt, 1);
-    const int64_t dt = sqlite3_column_int64(stmt, 0);
-    dtgtk_range_select_add_block(range, dt, count);
-    if(rangetop) dtgtk_range_select_add_block(rangetop, dt, count);
+    gchar *colname = _date_get_db_colname(rule);
+    char query[1024] = { 0 };
+    // clang-format off
+    g_snprintf(query, sizeof(query),
+               "SELECT %s AS date, COUNT(*) AS count"
+               " FROM main.images AS mi"
+               " WHERE %s IS NOT NULL AND %s"
+               " GROUP BY date",
+               colname, colname, d->last_where_ext);
+    // clang-format on
+    g_free(colname);
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    dtgtk_range_select_reset_blocks(range);
+    if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const int count = sqlite3_column_int(stmt, 1);
+      const int64_t dt = sqlite3_column_int64(stmt, 0);
+      dtgtk_range_select_add_block(range, dt, count);
+      if(rangetop) dtgtk_range_select_add_block(rangetop, dt, count);
+    }
+    sqlite3_finalize(stmt);
   }
-  sqlite3_finalize(stmt);
 
   // and setup the selection
   dtgtk_range_select_set_selection_from_raw_text(range, rule->raw_text, FALSE);
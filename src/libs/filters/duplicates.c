@@ -31,11 +31,13 @@ typedef enum _duplicates_type_t
 {
   _DUP_ALL = 0,
   _DUP_WITH_DUPS,
-  _DUP_DUPS_ONLY
+  _DUP_DUPS_ONLY,
+  _DUP_NEAR
 } _duplicates_type_t;
 
 static const char *_duplicates_names[]
-    = { N_("all images"), N_("images with duplicates"), N_("duplicates only"), NULL };
+    = { N_("all images"), N_("images with duplicates"), N_("duplicates only"),
+        N_("near duplicates"), NULL };
 
 static void _duplicates_synchronise(_widgets_duplicates_t *source)
 {
@@ -71,6 +73,11 @@ static void _duplicates_changed(GtkWidget *widget, gpointer user_data)
     case _DUP_DUPS_ONLY:
       _rule_set_raw_text(duplicates->rule, "$DUPLICATES_ONLY", TRUE);
       break;
+    case _DUP_NEAR:
+      // copies from other cards or backups, found by their thumbnails
+      dt_phash_fill_missing();
+      _rule_set_raw_text(duplicates->rule, "$NEAR_DUPLICATES", TRUE);
+      break;
   }
   _duplicates_synchronise(duplicates);
 }
@@ -83,6 +90,8 @@ static void _duplicates_decode(const gchar *txt, int *val)
     *val = _DUP_WITH_DUPS;
   else if(!g_strcmp0(txt, "$DUPLICATES_ONLY"))
     *val = _DUP_DUPS_ONLY;
+  else if(!g_strcmp0(txt, "$NEAR_DUPLICATES"))
+    *val = _DUP_NEAR;
   else
     *val = _DUP_ALL;
 }
@@ -140,6 +149,25 @@ static gboolean _duplicates_update(dt_lib_filtering_rule_t *rule)
     g_free(item);
   }
 
+  // the near duplicates are only counted once asked for, finding them
+  // goes through the hashes of the whole library
+  if(val == _DUP_NEAR)
+  {
+    dt_phash_update_near_duplicates(dt_conf_get_int("plugins/lighttable/duplicates/phash_distance"));
+    g_snprintf(query, sizeof(query),
+               "SELECT COUNT(*) FROM main.images AS mi"
+               " WHERE mi.id IN (SELECT imgid FROM memory.near_duplicates) AND %s",
+               rule->lib->last_where_ext);
+    int near = 0;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    if(sqlite3_step(stmt) == SQLITE_ROW) near = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+
+    gchar *item = g_strdup_printf("%s (%d)", _(_duplicates_names[_DUP_NEAR]), near);
+    dt_bauhaus_combobox_set_entry_label(duplicates->combo, _DUP_NEAR, item);
+    g_free(item);
+  }
+
   dt_bauhaus_combobox_set(duplicates->combo, val);
   _duplicates_synchronise(duplicates);
   rule->manual_widget_set--;
@@ -34,27 +34,31 @@ static gboolean _exposure_bias_update(dt_lib_filtering_rule_t *rule)
 
   rule->manual_widget_set++;
   // first, we update the graph
-  char query[1024] = { 0 };
-  // clang-format off
-  g_snprintf(query, sizeof(query),
-             "SELECT ROUND(exposure_bias,2), COUNT(*) AS count"
-             " FROM main.images AS mi"
-             " WHERE %s"
-             " GROUP BY ROUND(exposure_bias,2)",
-             d->last_where_ext);
-  // clang-format on
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  dtgtk_range_select_reset_blocks(range);
-  if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  // out of the in-memory columns, or from the database if they can't be loaded
+  if(!_columns_add_blocks(d, _COLUMN_EXPOSURE_BIAS, 2, range, rangetop))
   {
-    const double val = sqlite3_column_double(stmt, 0);
-    const int count = sqlite3_column_int(stmt, 1);
-    dtgtk_range_select_add_block(range, val, count);
-    if(rangetop) dtgtk_range_select_add_block(rangetop, val, count);
+    char query[1024] = { 0 };
+    // clang-format off
+    g_snprintf(query, sizeof(query),
+               "SELECT ROUND(exposure_bias,2), COUNT(*) AS count"
+               " FROM main.images AS mi"
+               " WHERE %s"
+               " GROUP BY ROUND(exposure_bias,2)",
+               d->last_where_ext);
+    // clang-format on
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    dtgtk_range_select_reset_blocks(range);
+    if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const double val = sqlite3_column_double(stmt, 0);
+      const int count = sqlite3_column_int(stmt, 1);
+      dtgtk_range_select_add_block(range, val, count);
+      if(rangetop) dtgtk_range_select_add_block(rangetop, val, count);
+    }
+    sqlite3_finalize(stmt);
   }
-  sqlite3_finalize(stmt);
 
   // and setup the selection
   dtgtk_range_select_set_selection_from_raw_text(range, rule->raw_text, FALSE);
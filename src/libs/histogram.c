@@ -18,6 +18,7 @@
 
 #include "common/darktable.h"
 #include "common/color_picker.h"
+#include "control/control.h"
 #include "gui/accelerators.h"
 #include "scopes.h"
 #include "scopes/vectorscope.h"
@@ -77,6 +78,60 @@ int position(const dt_lib_module_t *self)
   return 1000;
 }
 
+// run the current mode on a frame already in the histogram profile
+static void _scope_compute(dt_scopes_t *const s,
+                           const float *const img,
+                           dt_histogram_roi_t *const roi,
+                           const dt_iop_order_iccprofile_info_t *const profile)
+{
+  dt_pthread_mutex_lock(&s->lock);
+  s->update_counter++;
+  dt_scopes_call(s->cur_mode, process, img, roi, profile);
+  dt_pthread_mutex_unlock(&s->lock);
+}
+
+static void _drop_pending(dt_scopes_t *const s)
+{
+  g_mutex_lock(&s->pending_lock);
+  dt_free_align(s->pending);
+  s->pending = NULL;
+  g_mutex_unlock(&s->pending_lock);
+}
+
+static void *_scope_worker(void *arg)
+{
+  dt_scopes_t *const s = arg;
+  dt_pthread_setname("scopes");
+
+  g_mutex_lock(&s->pending_lock);
+  while(s->worker_running)
+  {
+    if(!s->pending)
+    {
+      g_cond_wait(&s->pending_cond, &s->pending_lock);
+      continue;
+    }
+
+    float *img = s->pending;
+    dt_histogram_roi_t roi = s->pending_roi;
+    const dt_iop_order_iccprofile_info_t *profile = s->pending_profile;
+    s->pending = NULL;
+    g_mutex_unlock(&s->pending_lock);
+
+    dt_times_t start;
+    dt_get_perf_times(&start);
+    _scope_compute(s, img, &roi, profile);
+    dt_free_align(img);
+    dt_show_times_f(&start, "[histogram]", "scope %s",
+                    dt_scopes_call(s->cur_mode, name));
+    dt_control_queue_redraw_widget(s->scope_draw);
+
+    g_mutex_lock(&s->pending_lock);
+  }
+  g_mutex_unlock(&s->pending_lock);
+  return NULL;
+}
+
 static void _scope_process
   (struct dt_lib_module_t *self,
    const float *const input,
@@ -93,6 +148,7 @@ static void _scope_process
   // special case, clear the scopes
   if(!input)
   {
+    if(s->worker_running) _drop_pending(s);
     dt_pthread_mutex_lock(&s->lock);
     // FIXME: is better to do this or just advance update_counter by one?
     for(dt_scopes_mode_type_t i = 0; i < DT_SCOPES_MODE_N; i++)
@@ -182,15 +238,31 @@ static void _scope_process
   dt_ioppr_transform_image_colorspace_rgb(input, img_display, width, height,
                                             profile_info_from, profile_info_out,
                                             "final histogram");
-  dt_pthread_mutex_lock(&s->lock);
 
-  s->update_counter++;
   // if using a non-rgb profile_info_out as in cmyk softproofing we pass
   // DT_COLORSPACE_LIN_REC2020 for calculating the vertex_rgb data.
-  dt_scopes_call(s->cur_mode, process, img_display, &roi,
-                 profile_info_out->type ? profile_info_out : fallback);
+  const dt_iop_order_iccprofile_info_t *const profile =
+    profile_info_out->type ? profile_info_out : fallback;
 
-  dt_pthread_mutex_unlock(&s->lock);
+  if(s->worker_running)
+  {
+    // hand the frame over, the binning doesn't hold up the pipe
+    g_mutex_lock(&s->pending_lock);
+    const gboolean stale = s->pending != NULL;
+    dt_free_align(s->pending);
+    s->pending = img_display;
+    s->pending_roi = roi;
+    s->pending_profile = profile;
+    g_cond_signal(&s->pending_cond);
+    g_mutex_unlock(&s->pending_lock);
+
+    dt_show_times_f(&start, "[histogram]", "final %s queued%s",
+                    dt_scopes_call(s->cur_mode, name),
+                    stale ? ", dropped stale frame" : "");
+    return;
+  }
+
+  _scope_compute(s, img_display, &roi, profile);
   dt_free_align(img_display);
 
   dt_show_times_f(&start, "[histogram]", "final %s",
@@ -726,6 +798,17 @@ void gui_init(dt_lib_module_t *self)
 
   dt_pthread_mutex_init(&s->lock, NULL);
 
+  g_mutex_init(&s->pending_lock);
+  g_cond_init(&s->pending_cond);
+  s->pending = NULL;
+  s->worker_running = TRUE;
+  if(dt_pthread_create(&s->worker, _scope_worker, s))
+  {
+    // scopes are then computed on the calling thread
+    s->worker_running = FALSE;
+    dt_print(DT_DEBUG_ALWAYS, "[histogram] could not start the scopes worker");
+  }
+
   s->channels[DT_SCOPES_RGB_RED]
     = dt_conf_get_bool("plugins/darkroom/histogram/show_red");
   s->channels[DT_SCOPES_RGB_GREEN]
@@ -939,6 +1022,18 @@ void gui_cleanup(dt_lib_module_t *self)
 {
   dt_scopes_t *s = self->data;
 
+  if(s->worker_running)
+  {
+    g_mutex_lock(&s->pending_lock);
+    s->worker_running = FALSE;
+    g_cond_signal(&s->pending_cond);
+    g_mutex_unlock(&s->pending_lock);
+    pthread_join(s->worker, NULL);
+  }
+  dt_free_align(s->pending);
+  g_mutex_clear(&s->pending_lock);
+  g_cond_clear(&s->pending_cond);
+
   for(dt_scopes_mode_type_t i = 0; i < DT_SCOPES_MODE_N; i++)
     dt_scopes_call(&s->modes[i], gui_cleanup);
   dt_pthread_mutex_destroy(&s->lock);
@@ -147,10 +147,14 @@ typedef struct dt_lib_import_t
     GtkWidget *thumbs;
     GtkTreeView *folderview;
     GtkTreeViewColumn *foldercol;
-    GtkTreeIter iter;
     guint event;
     guint nb;
     GdkPixbuf *eye;
+    GdkPixbuf *logo;
+    GThreadPool *thumb_pool;   // extracts the thumbnails of the visible rows
+    GHashTable *thumb_cache;   // filename -> GdkPixbuf, NULL while extracting
+    guint thumb_session;       // the results for a closed dialog are dropped
+    guint thumb_seq;
     GtkTreeViewColumn *pixcol;
     GtkWidget *img_nb;
     GtkGrid *patterns;
@@ -419,6 +423,7 @@ static void detach_lua_widgets(GtkWidget *extra_lua_widgets)
 #endif
 
 // maybe this should be (partly) in imageio/imageio.[c|h]?
+// runs in the thumbnail workers, NULL if the file has no preview
 static GdkPixbuf *_import_get_thumbnail(const gchar *filename)
 {
   GdkPixbuf *pixbuf = NULL;
@@ -500,9 +505,15 @@ static GdkPixbuf *_import_get_thumbnail(const gchar *filename)
     }
   }
 
-  // if no thumbanail found or read failed for whatever reason
-  // just display the default darktable logo
-  if(!have_preview || no_preview_fallback)
+return pixbuf;
+}
+
+// if no thumbnail found or read failed for whatever reason
+// just display the default darktable logo
+static GdkPixbuf *_import_get_logo(dt_lib_module_t *self)
+{
+  dt_lib_import_t *d = self->data;
+  if(!d->from.logo)
   {
     /* load the dt logo as a background */
     cairo_surface_t *surface = dt_util_get_logo(128.0);
@@ -512,16 +523,127 @@ static GdkPixbuf *_import_get_thumbnail(const gchar *filename)
       const int image_width = cairo_image_surface_get_width(surface);
       const int image_height = cairo_image_surface_get_height(surface);
 
-      pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, image_width, image_height);
+      d->from.logo = gdk_pixbuf_get_from_surface(surface, 0, 0, image_width, image_height);
 
       cairo_surface_destroy(surface);
       free(image_buffer);
-
-      have_preview = TRUE;
     }
   }
+  return d->from.logo;
+}
 
-return pixbuf;
+// the thumbnails are extracted in the background, for the visible rows
+// only, and kept until the dialog is closed.
+
+typedef struct _import_thumb_job_t
+{
+  dt_lib_module_t *self;
+  guint session;
+  guint seq;
+  gchar *filename;
+  GdkPixbuf *pixbuf;
+} _import_thumb_job_t;
+
+static void _import_thumb_job_free(_import_thumb_job_t *job)
+{
+  if(job->pixbuf) g_object_unref(job->pixbuf);
+  g_free(job->filename);
+  g_free(job);
+}
+
+static void _thumbs_update_visible(dt_lib_module_t *self);
+
+static gboolean _import_thumb_ready(gpointer data)
+{
+  _import_thumb_job_t *job = data;
+  dt_lib_import_t *d = job->self->data;
+
+  if(job->session == d->from.thumb_session && d->from.thumb_cache)
+  {
+    GdkPixbuf *pixbuf = job->pixbuf ? job->pixbuf : _import_get_logo(job->self);
+    if(pixbuf) g_object_ref(pixbuf);
+    g_hash_table_replace(d->from.thumb_cache, job->filename, pixbuf);
+    job->filename = NULL;
+    _thumbs_update_visible(job->self);
+  }
+  _import_thumb_job_free(job);
+  return G_SOURCE_REMOVE;
+}
+
+static void _import_thumb_worker(gpointer data,
+                                 gpointer user_data)
+{
+  _import_thumb_job_t *job = data;
+  dt_lib_import_t *d = job->self->data;
+
+  // the dialog may have been closed in the meantime
+  if(job->session != g_atomic_int_get(&d->from.thumb_session))
+  {
+    _import_thumb_job_free(job);
+    return;
+  }
+  job->pixbuf = _import_get_thumbnail(job->filename);
+  g_main_context_invoke(NULL, _import_thumb_ready, job);
+}
+
+// the rows shown last come first
+static gint _import_thumb_job_cmp(gconstpointer a,
+                                  gconstpointer b,
+                                  gpointer user_data)
+{
+  const _import_thumb_job_t *ja = a;
+  const _import_thumb_job_t *jb = b;
+  return ja->seq < jb->seq ? 1 : ja->seq > jb->seq ? -1 : 0;
+}
+
+static void _import_thumb_unref(gpointer data)
+{
+  if(data) g_object_unref(data);
+}
+
+// the thumbnail of filename if there is one already, the eye otherwise
+// while it is extracted
+static GdkPixbuf *_import_thumb_get(dt_lib_module_t *self,
+                                    const gchar *filename)
+{
+  dt_lib_import_t *d = self->data;
+  if(!d->from.thumb_cache)
+  {
+    d->from.thumb_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free, _import_thumb_unref);
+    d->from.thumb_pool = g_thread_pool_new(_import_thumb_worker, NULL,
+                                           CLAMP(dt_get_num_procs() / 2, 1, 4),
+                                           FALSE, NULL);
+    g_thread_pool_set_sort_function(d->from.thumb_pool, _import_thumb_job_cmp, NULL);
+  }
+
+  gpointer pixbuf;
+  if(g_hash_table_lookup_extended(d->from.thumb_cache, filename, NULL, &pixbuf))
+    return pixbuf ? pixbuf : d->from.eye;
+
+  g_hash_table_insert(d->from.thumb_cache, g_strdup(filename), NULL);
+  _import_thumb_job_t *job = g_malloc0(sizeof(_import_thumb_job_t));
+  job->self = self;
+  job->session = d->from.thumb_session;
+  job->seq = ++d->from.thumb_seq;
+  job->filename = g_strdup(filename);
+  g_thread_pool_push(d->from.thumb_pool, job, NULL);
+  return d->from.eye;
+}
+
+static void _import_thumb_cleanup(dt_lib_module_t *self)
+{
+  dt_lib_import_t *d = self->data;
+  g_atomic_int_inc(&d->from.thumb_session);
+  if(d->from.thumb_pool)
+    g_thread_pool_free(d->from.thumb_pool, FALSE, TRUE);
+  d->from.thumb_pool = NULL;
+  if(d->from.thumb_cache)
+    g_hash_table_destroy(d->from.thumb_cache);
+  d->from.thumb_cache = NULL;
+  if(d->from.logo)
+    g_object_unref(d->from.logo);
+  d->from.logo = NULL;
 }
 
 static void _thumb_set_in_listview(GtkTreeModel *model,
@@ -537,21 +659,22 @@ static void _thumb_set_in_listview(GtkTreeModel *model,
                      DT_IMPORT_FILENAME, &fullname,
                      -1);
   GdkPixbuf *pixbuf = NULL;
+  GdkPixbuf *owned = NULL;
 #ifdef HAVE_GPHOTO2
   if(d->import_case == DT_IMPORT_CAMERA)
-    pixbuf = thumb_sel ?
+    pixbuf = owned = thumb_sel ?
       dt_camctl_get_thumbnail(darktable.camctl, d->camera, filename)
-      : d->from.eye;
+      : NULL;
   else
 #endif
   {
-    pixbuf = thumb_sel ? _import_get_thumbnail(fullname) : d->from.eye;
+    pixbuf = thumb_sel ? _import_thumb_get(self, fullname) : NULL;
   }
   gtk_list_store_set(d->from.store, iter, DT_IMPORT_SEL_THUMB, thumb_sel,
-                                          DT_IMPORT_THUMB, pixbuf, -1);
-
-  if(pixbuf)
-    g_object_ref(pixbuf);
+                                          DT_IMPORT_THUMB, pixbuf ? pixbuf : d->from.eye,
+                                          -1);
+  if(owned)
+    g_object_unref(owned);
 
   g_free(filename);
   g_free(fullname);
@@ -604,22 +727,58 @@ static gboolean _files_button_press(GtkWidget *view,
   return FALSE;
 }
 
+// set the thumbnails of the visible rows still showing the eye
 static gboolean _thumb_set(dt_lib_module_t *self)
 {
   dt_lib_import_t *d = self->data;
+  d->from.event = 0;
 
-  if(d->from.event)
+  const gboolean all = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(d->from.thumbs));
+  GtkTreePath *start = NULL, *end = NULL;
+  if(!gtk_tree_view_get_visible_range(d->from.treeview, &start, &end))
+    return G_SOURCE_REMOVE;
+
+  GtkTreeModel *model = GTK_TREE_MODEL(d->from.store);
+  GtkTreeIter iter;
+  for(gboolean valid = gtk_tree_model_get_iter(model, &iter, start);
+      valid && gtk_tree_path_compare(start, end) <= 0;
+      valid = gtk_tree_model_iter_next(model, &iter))
   {
-    GtkTreeModel *model = GTK_TREE_MODEL(d->from.store);
     gboolean thumb_sel;
-    gtk_tree_model_get(model, &d->from.iter, DT_IMPORT_SEL_THUMB, &thumb_sel, -1);
-    if(!thumb_sel)
-      _thumb_set_in_listview(model, &d->from.iter, TRUE, self);
-    if(d->from.event && gtk_tree_model_iter_next(model, &d->from.iter))
-      return TRUE;
+    GdkPixbuf *thumb;
+    gtk_tree_model_get(model, &iter,
+                       DT_IMPORT_SEL_THUMB, &thumb_sel,
+                       DT_IMPORT_THUMB, &thumb,
+                       -1);
+    if((all || thumb_sel) && thumb == d->from.eye)
+      _thumb_set_in_listview(model, &iter, TRUE, self);
+    if(thumb) g_object_unref(thumb);
+    gtk_tree_path_next(start);
   }
+  gtk_tree_path_free(start);
+  gtk_tree_path_free(end);
+  return G_SOURCE_REMOVE;
+}
+
+static void _thumbs_update_visible(dt_lib_module_t *self)
+{
+  dt_lib_import_t *d = self->data;
+  if(!d->from.event)
+    d->from.event = g_timeout_add_full(G_PRIORITY_LOW, 100, (GSourceFunc)_thumb_set, self, NULL);
+}
+
+static void _thumbs_stop_update(dt_lib_module_t *self)
+{
+  dt_lib_import_t *d = self->data;
+  if(d->from.event)
+    g_source_remove(d->from.event);
   d->from.event = 0;
-  return FALSE;
+}
+
+static void _files_scrolled(GtkAdjustment *adjustment,
+                            dt_lib_module_t *self)
+{
+  _thumbs_update_visible(self);
 }
 
 static void _all_thumb_toggled(GtkTreeViewColumn *column,
@@ -633,7 +792,7 @@ static void _all_thumb_toggled(GtkTreeViewColumn *column,
   if(!thumb_sel)
   {
     // remove the thumbnails
-    d->from.event = 0;
+    _thumbs_stop_update(self);
     GtkTreeModel *model = GTK_TREE_MODEL(d->from.store);
     GtkTreeIter iter;
     for(gboolean valid = gtk_tree_model_get_iter_first(model, &iter);
@@ -643,13 +802,8 @@ static void _all_thumb_toggled(GtkTreeViewColumn *column,
       _thumb_set_in_listview(model, &iter, FALSE, self);
     }
   }
-  else if(!d->from.event)
-  {
-    // if the display is not yet started, start it
-    GtkTreeModel *model = GTK_TREE_MODEL(d->from.store);
-    if(gtk_tree_model_get_iter_first(model, &d->from.iter))
-      d->from.event = g_timeout_add_full(G_PRIORITY_LOW, 100, (GSourceFunc)_thumb_set, self, NULL);
-  }
+  else
+    _thumbs_update_visible(self);
 }
 
 static void _show_all_thumbs(dt_lib_module_t* self)
@@ -657,13 +811,8 @@ static void _show_all_thumbs(dt_lib_module_t* self)
   dt_lib_import_t *d = self->data;
   const gboolean thumb_sel =
     gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(d->from.thumbs));
-  if(!d->from.event && thumb_sel)
-  {
-    // if the display is not yet started, start it
-    GtkTreeModel *model = GTK_TREE_MODEL(d->from.store);
-    if(gtk_tree_model_get_iter_first(model, &d->from.iter))
-      d->from.event = g_timeout_add_full(G_PRIORITY_LOW, 100, (GSourceFunc)_thumb_set, self, NULL);
-  }
+  if(thumb_sel)
+    _thumbs_update_visible(self);
 }
 
 #define FILE_REQUEST_BLOCK 50
@@ -762,6 +911,7 @@ static void _import_add_file_callback(GObject *direnum,
 
       gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(d->from.store),
                                            DT_IMPORT_DATETIME, GTK_SORT_ASCENDING);
+      _show_all_thumbs(self);
     }
 
     return;
@@ -874,6 +1024,7 @@ static void _import_add_file_callback(GObject *direnum,
     }
 
     g_free(folder);
+    _show_all_thumbs(self);
   }
   g_list_free(file_list);
 }
@@ -1005,7 +1156,7 @@ static gboolean _update_files_list(dt_lib_module_t *self)
 {
   dt_lib_import_t *d = self->data;
   // clear parallel thumb refresh
-  d->from.event = 0;
+  _thumbs_stop_update(self);
   GtkTreeModel *model = GTK_TREE_MODEL(d->from.store);
   g_object_ref(model);
   gtk_tree_view_set_model(d->from.treeview, NULL);
@@ -1902,6 +2053,8 @@ static void _set_files_list(GtkWidget *rbox, dt_lib_module_t* self)
   d->from.pixcol = column;
   g_signal_connect(G_OBJECT(d->from.treeview), "button-press-event",
                    G_CALLBACK(_files_button_press), self);
+  g_signal_connect(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(d->from.w)),
+                   "value-changed", G_CALLBACK(_files_scrolled), self);
 
   GtkTreeSelection *selection = gtk_tree_view_get_selection(d->from.treeview);
   gtk_tree_selection_set_mode(selection, GTK_SELECTION_MULTIPLE);
@@ -2288,7 +2441,8 @@ static void _import_from_dialog_run(dt_lib_module_t* self)
 static void _import_from_dialog_free(dt_lib_module_t* self)
 {
   dt_lib_import_t *d = self->data;
-  d->from.event = 0;
+  _thumbs_stop_update(self);
+  _import_thumb_cleanup(self);
   g_object_unref(d->from.eye);
   g_object_unref(d->from.store);
   if(d->import_case != DT_IMPORT_CAMERA)
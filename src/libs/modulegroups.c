@@ -759,11 +759,13 @@ static void _basics_show(dt_lib_module_t *self)
     if(!dt_iop_is_hidden(module) && !(module->flags() & IOP_FLAGS_DEPRECATED) && module->iop_order != INT_MAX)
     {
       // first, we add on-off buttons if any
+      gboolean in_basics = FALSE;
       for(const GList *l = d->basics; l; l = g_list_next(l))
       {
         dt_lib_modulegroups_basic_item_t *item = l->data;
         if(!item->module && g_strcmp0(item->module_op, module->op) == 0)
         {
+          in_basics = TRUE;
           if(item->widget_type == WIDGET_TYPE_ACTIVATE_BTN)
           {
             item->module = module;
@@ -773,8 +775,10 @@ static void _basics_show(dt_lib_module_t *self)
         }
       }
 
-      // for the other items, we want them in same order as the module gui
-      _basics_add_items_from_module_widget(self, module, module->widget, item_pos);
+      // for the other items, we want them in same order as the module gui,
+      // the module widgets may not have been built yet
+      if(in_basics && dt_iop_gui_ensure(module))
+        _basics_add_items_from_module_widget(self, module, module->widget, item_pos);
     }
   }
 
@@ -86,7 +86,12 @@
 //        serialises inference so the new worker queues without
 //        fighting for the GPU; preview_sequence is bumped so any
 //        in-flight result is discarded by its idle callback when it
-//        eventually arrives.
+//        eventually arrives. each worker also gets a job used as a
+//        cancellation token, which the tiled RGB inference polls
+//        between tiles, so a superseded run stops at the next tile
+//      - the display transform and the DWT detail are computed in
+//        the worker; strength changes only re-blend on the UI thread
+//        (debounced to 50 ms) and never re-run inference
 //
 // 2. batch processing (multi-image)
 //    runs as a dt_control_job on the user background queue.
@@ -140,6 +145,8 @@
 //   stale workers are discarded via the atomic preview_sequence
 //   counter, checked at the dispatcher entry and at key points
 //   inside the worker; idle callbacks re-check before installing.
+//   the latest worker's cancellation token (preview_job, guarded by
+//   preview_job_lock) is cancelled together with the sequence bump.
 //   gui_cleanup joins the latest worker and drains the main context
 //   to flush any pending idle callbacks before freeing module state.
 // - batch: dt_control_job on DT_JOB_QUEUE_USER_BG. supports
@@ -348,6 +355,13 @@ typedef struct dt_lib_neural_restore_t
   // until it finishes, so a freshly-spawned worker waits its turn
   // rather than competing for the same GPU/CPU
   GMutex preview_inference_lock;
+  // cancellation token of the latest worker, polled between tiles by
+  // the tiled inference so a superseded preview stops mid-run instead
+  // of holding preview_inference_lock until it is done. never queued,
+  // only used for its state. the worker disposes it after taking it
+  // out of preview_job under preview_job_lock
+  GMutex preview_job_lock;
+  dt_job_t *preview_job;
   // per-task cache of the last successful preview, keyed by
   // (imgid, patch_center). on tab switch we look up the new task's
   // slot; if it matches the current image+patch we install the
@@ -433,6 +447,8 @@ typedef struct dt_neural_preview_data_t
   const float *reuse_pixels;
   int reuse_w;
   int reuse_h;
+  // cancellation token, see preview_job. NULL when control isn't running
+  dt_job_t *job;
 } dt_neural_preview_data_t;
 
 typedef struct dt_neural_preview_result_t
@@ -440,6 +456,7 @@ typedef struct dt_neural_preview_result_t
   dt_lib_module_t *self;
   float *before;
   float *after;
+  float *detail;  // DWT luminance detail, dt_alloc_align; may be NULL
   float *export_pixels;
   int export_w;
   int export_h;
@@ -1994,6 +2011,7 @@ static gboolean _preview_result_idle(gpointer data)
   {
     g_free(res->before);
     g_free(res->after);
+    dt_free_align(res->detail);
     g_free(res->export_pixels);
     g_free(res);
     return G_SOURCE_REMOVE;
@@ -2004,6 +2022,7 @@ static gboolean _preview_result_idle(gpointer data)
   {
     g_free(res->before);
     g_free(res->after);
+    dt_free_align(res->detail);
     g_free(res->export_pixels);
     g_free(res);
     return G_SOURCE_REMOVE;
@@ -2028,9 +2047,9 @@ static gboolean _preview_result_idle(gpointer data)
     d->export_cairo = NULL;
   }
 
-  // pre-compute DWT-filtered luminance detail for instant slider response
-  d->preview_detail = dt_restore_compute_dwt_detail(res->before, res->after,
-                                                    res->width, res->height);
+  // DWT-filtered luminance detail was computed by the worker so the
+  // strength slider only re-blends
+  d->preview_detail = res->detail;
 
   // rebuild cached cairo surface data
   g_free(d->cairo_before);
@@ -2256,18 +2275,38 @@ static gpointer _preview_thread(gpointer data)
   _buf_writer_data_t bwd = { .out_buf = out_4ch, .out_w = pw };
   const int ret = dt_restore_process_tiled(
     ctx, crop_4ch, crop_w, crop_h, pd->scale,
-    _buf_row_writer, &bwd, NULL);
+    _buf_row_writer, &bwd, pd->job);
   g_free(crop_4ch);
   dt_restore_unref(ctx);
 
   if(ret != 0)
   {
-    dt_print(DT_DEBUG_AI, "[neural_restore] preview: inference failed");
+    if(dt_control_job_get_state(pd->job) == DT_JOB_STATE_CANCELLED)
+      dt_print(DT_DEBUG_AI, "[neural_restore] preview: superseded, inference stopped");
+    else
+      dt_print(DT_DEBUG_AI, "[neural_restore] preview: inference failed");
     g_free(out_4ch);
     g_free(crop_rgb);
     goto cleanup;
   }
 
+  if(pd->sequence != g_atomic_int_get(&d->preview_sequence))
+  {
+    g_free(out_4ch);
+    g_free(crop_rgb);
+    goto cleanup;
+  }
+
+  // convert LIN_REC2020 → linear sRGB for cairo
+  // (_float_rgb_to_cairo applies sRGB gamma, assumes sRGB primaries).
+  // the "before" crop is converted at model input size, ahead of the
+  // nearest-neighbour upscale, so upscaling tasks transform scale²
+  // fewer pixels
+  cmsHTRANSFORM xform_disp
+    = _build_output_color_transform(DT_COLORSPACE_LIN_REC709, "");
+  if(xform_disp)
+    cmsDoTransform(xform_disp, crop_rgb, crop_rgb, (size_t)crop_w * crop_h);
+
   // build "before" buffer: pw × ph interleaved RGB
   float *before_buf = NULL;
   if(pd->scale > 1)
@@ -2296,22 +2335,22 @@ static gpointer _preview_thread(gpointer data)
   }
   g_free(out_4ch);
 
-  // convert LIN_REC2020 → linear sRGB for cairo
-  // (_float_rgb_to_cairo applies sRGB gamma, assumes sRGB primaries)
-  cmsHTRANSFORM xform_disp
-    = _build_output_color_transform(DT_COLORSPACE_LIN_REC709, "");
   if(xform_disp)
   {
-    cmsDoTransform(xform_disp, before_buf, before_buf, (size_t)pw * ph);
     cmsDoTransform(xform_disp, after_buf, after_buf, (size_t)pw * ph);
     cmsDeleteTransform(xform_disp);
   }
 
+  // pre-compute DWT-filtered luminance detail here rather than in the
+  // idle callback so the UI thread only has to blend
+  float *detail_buf = dt_restore_compute_dwt_detail(before_buf, after_buf, pw, ph);
+
   // deliver result to main thread
   dt_neural_preview_result_t *result = g_new(dt_neural_preview_result_t, 1);
   result->self = pd->self;
   result->before = before_buf;
   result->after = after_buf;
+  result->detail = detail_buf;
   // only pass export pixels on fresh export (owned by cap).
   // on reuse, the main thread already has them cached
   result->export_pixels = owns_pixels ? cap.pixels : NULL;
@@ -2336,6 +2375,29 @@ cleanup:
   return NULL;
 }
 
+// stop the latest preview worker at its next tile. it keeps running
+// until then and drops its result through the sequence check
+static void _preview_job_cancel(dt_lib_neural_restore_t *d)
+{
+  g_mutex_lock(&d->preview_job_lock);
+  if(d->preview_job)
+    dt_control_job_cancel(d->preview_job);
+  d->preview_job = NULL;
+  g_mutex_unlock(&d->preview_job_lock);
+}
+
+// called by the worker once it is done with its token
+static void _preview_job_release(dt_lib_neural_restore_t *d,
+                                 dt_job_t *job)
+{
+  if(!job) return;
+  g_mutex_lock(&d->preview_job_lock);
+  if(d->preview_job == job)
+    d->preview_job = NULL;
+  g_mutex_unlock(&d->preview_job_lock);
+  dt_control_job_dispose(job);
+}
+
 static void _cancel_preview(dt_lib_module_t *self)
 {
   dt_lib_neural_restore_t *d = (dt_lib_neural_restore_t *)self->data;
@@ -2349,8 +2411,10 @@ static void _cancel_preview(dt_lib_module_t *self)
   // worker may still be reading from them. take + release the
   // inference lock as a synchronisation barrier — the worker holds
   // it during the heavy work, so once we get it we know it's done
-  // touching shared buffers
+  // touching shared buffers. cancelling its token first makes a
+  // running RGB inference stop at the next tile rather than finish
   g_atomic_int_inc(&d->preview_sequence);
+  _preview_job_cancel(d);
   if(d->preview_trigger_timer)
   {
     g_source_remove(d->preview_trigger_timer);
@@ -2390,7 +2454,7 @@ static void _cancel_preview(dt_lib_module_t *self)
 //     fast drags don't queue up redraws
 // ============================================================================
 
-#define RAW_PREVIEW_STRENGTH_DEBOUNCE_MS 50
+#define PREVIEW_STRENGTH_DEBOUNCE_MS 50
 
 typedef struct dt_neural_preview_result_raw_t
 {
@@ -2548,15 +2612,23 @@ static void _install_cache_slot(dt_lib_module_t *self,
     _install_cache_slot_rgb(self, task);
 }
 
-// debounced strength-slider re-blend. returns G_SOURCE_REMOVE so the
-// timer fires once.
+// debounced strength-slider re-blend, for the raw and the RGB tabs.
+// returns G_SOURCE_REMOVE so the timer fires once.
 static gboolean _strength_blend_timer_cb(gpointer data)
 {
   dt_lib_module_t *self = (dt_lib_module_t *)data;
   dt_lib_neural_restore_t *d = (dt_lib_neural_restore_t *)self->data;
   d->preview_strength_timer = 0;
 
-  if(d->task != NEURAL_TASK_RAW_DENOISE) return G_SOURCE_REMOVE;
+  if(d->task != NEURAL_TASK_RAW_DENOISE)
+  {
+    if(d->preview_ready)
+    {
+      _rebuild_cairo_after(d);
+      gtk_widget_queue_draw(d->preview_area);
+    }
+    return G_SOURCE_REMOVE;
+  }
   if(!d->preview_raw_src_rgb || !d->preview_raw_denoised_rgb)
     return G_SOURCE_REMOVE;
 
@@ -2566,13 +2638,13 @@ static gboolean _strength_blend_timer_cb(gpointer data)
   return G_SOURCE_REMOVE;
 }
 
-static void _schedule_raw_strength_reblend(dt_lib_module_t *self)
+static void _schedule_strength_reblend(dt_lib_module_t *self)
 {
   dt_lib_neural_restore_t *d = (dt_lib_neural_restore_t *)self->data;
   if(d->preview_strength_timer)
     g_source_remove(d->preview_strength_timer);
   d->preview_strength_timer
-    = g_timeout_add(RAW_PREVIEW_STRENGTH_DEBOUNCE_MS,
+    = g_timeout_add(PREVIEW_STRENGTH_DEBOUNCE_MS,
                     _strength_blend_timer_cb, self);
 }
 
@@ -3149,13 +3221,20 @@ static gpointer _preview_thread_dispatch(gpointer data)
 {
   dt_neural_preview_data_t *pd = (dt_neural_preview_data_t *)data;
   dt_lib_neural_restore_t *d = (dt_lib_neural_restore_t *)pd->self->data;
+  // the workers free pd
+  dt_job_t *job = pd->job;
 
+  // the token is released while still holding the lock, so that once
+  // gui_cleanup has joined the latest worker no older one can touch
+  // preview_job_lock anymore
   g_mutex_lock(&d->preview_inference_lock);
 
-  if(pd->sequence != g_atomic_int_get(&d->preview_sequence))
+  if(pd->sequence != g_atomic_int_get(&d->preview_sequence)
+     || dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
   {
-    g_mutex_unlock(&d->preview_inference_lock);
     g_free(pd);
+    _preview_job_release(d, job);
+    g_mutex_unlock(&d->preview_inference_lock);
     return NULL;
   }
 
@@ -3163,6 +3242,7 @@ static gpointer _preview_thread_dispatch(gpointer data)
     ? _preview_thread_raw(data)
     : _preview_thread(data);
 
+  _preview_job_release(d, job);
   g_mutex_unlock(&d->preview_inference_lock);
   return res;
 }
@@ -3207,6 +3287,7 @@ static void _trigger_preview(dt_lib_module_t *self)
   d->preview_ready = FALSE;
   d->preview_error = DT_NR_PREVIEW_ERR_NONE;
   g_atomic_int_inc(&d->preview_sequence);
+  _preview_job_cancel(d);
   gtk_widget_queue_draw(d->preview_area);
 
   GList *imgs = dt_act_on_get_images(TRUE, FALSE, FALSE);
@@ -3269,6 +3350,10 @@ static void _trigger_preview(dt_lib_module_t *self)
     pd->reuse_w = d->export_w;
     pd->reuse_h = d->export_h;
   }
+  pd->job = dt_control_job_create(NULL, "neural restore preview");
+  g_mutex_lock(&d->preview_job_lock);
+  d->preview_job = pd->job;
+  g_mutex_unlock(&d->preview_job_lock);
   // detach the previous worker (don't join — that would block the
   // UI thread for the duration of the in-flight inference / pipe
   // call). preview_inference_lock serialises the actual heavy work,
@@ -3339,11 +3424,9 @@ static void _recovery_slider_changed(GtkWidget *widget,
   dt_lib_neural_restore_t *d = (dt_lib_neural_restore_t *)self->data;
   if(d->recovery_changing) return;
   dt_conf_set_float(CONF_STRENGTH, dt_bauhaus_slider_get(d->recovery_slider));
+  // only the blend with the cached detail changes, never the inference
   if(d->preview_ready)
-  {
-    _rebuild_cairo_after(d);
-    gtk_widget_queue_draw(d->preview_area);
-  }
+    _schedule_strength_reblend(self);
 }
 
 static void _raw_strength_slider_changed(GtkWidget *widget,
@@ -3359,7 +3442,7 @@ static void _raw_strength_slider_changed(GtkWidget *widget,
   if(d->task == NEURAL_TASK_RAW_DENOISE
      && d->preview_raw_src_rgb
      && d->preview_raw_denoised_rgb)
-    _schedule_raw_strength_reblend(self);
+    _schedule_strength_reblend(self);
 }
 
 static void _process_clicked(GtkWidget *widget, gpointer user_data)
@@ -4263,6 +4346,7 @@ void gui_init(dt_lib_module_t *self)
   d->processing_images = g_hash_table_new(g_direct_hash, g_direct_equal);
   dt_pthread_mutex_init(&d->ctx_lock, NULL);
   g_mutex_init(&d->preview_inference_lock);
+  g_mutex_init(&d->preview_job_lock);
   d->split_pos = 0.5f;
 
   // notebook tabs (denoise / upscale)
@@ -4542,6 +4626,7 @@ void gui_cleanup(dt_lib_module_t *self)
     }
     // signal preview thread to exit and join (blocks; shutdown only)
     g_atomic_int_inc(&d->preview_sequence);
+    _preview_job_cancel(d);
     if(d->preview_thread)
     {
       g_thread_join(d->preview_thread);
@@ -4551,6 +4636,7 @@ void gui_cleanup(dt_lib_module_t *self)
     // sources during cleanup crashed on a stale GSource owned by another
     // lib (issue #20928). idle callbacks guard against d == NULL instead
     g_mutex_clear(&d->preview_inference_lock);
+    g_mutex_clear(&d->preview_job_lock);
 
     g_free(d->preview_before);
     g_free(d->preview_after);
@@ -122,6 +122,14 @@ typedef struct dt_lib_print_settings_t
 
   GList *printer_list;
   dt_pthread_mutex_t printer_list_mutex;
+
+  // last rendering of each box, reused while the layout changes
+  struct
+  {
+    dt_imgid_t imgid;
+    int width, height;
+    cairo_surface_t *surf;
+  } box_surface[MAX_IMAGE_PER_PAGE];
 } dt_lib_print_settings_t;
 
 typedef struct dt_lib_print_job_t
@@ -364,7 +372,6 @@ static int _export_image(dt_job_t *job, dt_image_box *img)
   if(params->style) g_strlcpy(dat.head.style, params->style, sizeof(dat.head.style));
 
   // let the user know something is happening
-  dt_control_job_set_progress(job, 0.05);
   dt_control_log(_("processing `%s' for `%s'"),
                  params->job_title, params->prt.printer.name);
 
@@ -436,23 +443,22 @@ static int _export_image(dt_job_t *job, dt_image_box *img)
   return 0;
 }
 
-static void _create_pdf(dt_job_t *job,
-                        dt_images_box imgs,
-                        const float width,
-                        const float height)
+// the PDF is written while the images are exported, each image object
+// goes to the file as soon as its box is ready and its buffer is freed.
+static dt_pdf_t *_start_pdf(dt_lib_print_job_t *params,
+                            const float width,
+                            const float height,
+                            int *icc_id)
 {
-  dt_lib_print_job_t *params = dt_control_job_get_params(job);
-
   const float page_width  = dt_pdf_mm_to_point(width);
   const float page_height = dt_pdf_mm_to_point(height);
-  int icc_id = 0;
-
-  dt_pdf_image_t *pdf_image[MAX_IMAGE_PER_PAGE];
+  *icc_id = 0;
 
   // create the PDF page
   dt_pdf_t *pdf = dt_pdf_start(params->pdf_filename, page_width, page_height,
                                params->prt.printer.resolution,
                                DT_PDF_STREAM_ENCODER_FLATE);
+  if(!pdf) return NULL;
 
 #ifdef __APPLE__
   // On macOS, embed the printer ICC profile in the PDF so the
@@ -464,41 +470,35 @@ static void _create_pdf(dt_job_t *job,
   // see the ICCBased color space and convert the data back to sRGB,
   // undoing the LittleCMS conversion. Linux uses cm-calibration instead.
   if(params->p_icc_profile && *params->p_icc_profile)
-    icc_id = dt_pdf_add_icc(pdf, params->p_icc_profile);
+    *icc_id = dt_pdf_add_icc(pdf, params->p_icc_profile);
 #endif
 
-  int32_t count = 0;
+  return pdf;
+}
 
-  for(int k=0; k<imgs.count; k++)
-  {
-    const int resolution = params->prt.printer.resolution;
-    const dt_image_box *box = &imgs.box[k];
+static dt_pdf_image_t *_add_pdf_image(dt_lib_print_job_t *params,
+                                      dt_pdf_t *pdf,
+                                      dt_image_box *box,
+                                      const int icc_id)
+{
+  const int resolution = params->prt.printer.resolution;
 
-    if(dt_is_valid_imgid(box->imgid))
-    {
-      pdf_image[count] =
-        dt_pdf_add_image(pdf, (uint8_t *)box->buf, box->exp_width, box->exp_height,
-                         8, icc_id, 0.0);
-
-      //  PDF bounding-box has origin on bottom-left
-      pdf_image[count]->bb_x      = dt_pdf_pixel_to_point(box->print.x, resolution);
-      pdf_image[count]->bb_y      = dt_pdf_pixel_to_point(box->print.y, resolution);
-      pdf_image[count]->bb_width  = dt_pdf_pixel_to_point(box->print.width, resolution);
-      pdf_image[count]->bb_height = dt_pdf_pixel_to_point(box->print.height, resolution);
-      count++;
-    }
-  }
+  dt_pdf_image_t *pdf_image =
+    dt_pdf_add_image(pdf, (uint8_t *)box->buf, box->exp_width, box->exp_height,
+                     8, icc_id, 0.0);
 
-  params->pdf_page = dt_pdf_add_page(pdf, pdf_image, count);
-  dt_pdf_finish(pdf, &params->pdf_page, 1);
+  // the data is in the file now
+  g_free(box->buf);
+  box->buf = NULL;
 
-  // now releases all the buf
-  for(int k=0; k<imgs.count; k++)
-  {
-    dt_image_box *box = &imgs.box[k];
-    g_free(box->buf);
-    box->buf = NULL;
-  }
+  if(!pdf_image) return NULL;
+
+  //  PDF bounding-box has origin on bottom-left
+  pdf_image->bb_x      = dt_pdf_pixel_to_point(box->print.x, resolution);
+  pdf_image->bb_y      = dt_pdf_pixel_to_point(box->print.y, resolution);
+  pdf_image->bb_width  = dt_pdf_pixel_to_point(box->print.width, resolution);
+  pdf_image->bb_height = dt_pdf_pixel_to_point(box->print.height, resolution);
+  return pdf_image;
 }
 
 void _fill_box_values(dt_lib_print_settings_t *ps)
@@ -568,22 +568,9 @@ static int _print_job_run(dt_job_t *job)
   // get first image on a box, needed as print leader
 
   dt_imgid_t imgid = NO_IMGID;
-
-  // compute the needed size for picture for the given printer resolution
-
+  int images = 0;
   for(int k=0; k<params->imgs.count; k++)
-  {
-    if(dt_is_valid_imgid(params->imgs.box[k].imgid))
-    {
-      if(!dt_is_valid_imgid(imgid)) imgid = params->imgs.box[k].imgid;
-      if(_export_and_setup_pos(job, &params->imgs.box[k], k))
-        return 1;
-    }
-  }
-
-  if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
-    return 0;
-  dt_control_job_set_progress(job, 0.9);
+    if(dt_is_valid_imgid(params->imgs.box[k].imgid)) images++;
 
   dt_loc_get_tmp_dir(params->pdf_filename, sizeof(params->pdf_filename));
   g_strlcat(params->pdf_filename, "/pf.XXXXXX.pdf", sizeof(params->pdf_filename));
@@ -593,6 +580,7 @@ static int _print_job_run(dt_job_t *job)
   {
     dt_control_log(_("failed to create temporary PDF for printing"));
     dt_print(DT_DEBUG_ALWAYS, "failed to create temporary PDF for printing");
+    params->pdf_filename[0] = '\0';
     return 1;
   }
   close(fd);
@@ -600,9 +588,56 @@ static int _print_job_run(dt_job_t *job)
   float width, height;
   _get_page_dimension(&params->prt, &width, &height);
 
-  _create_pdf(job, params->imgs, width, height);
+  int icc_id = 0;
+  dt_pdf_t *pdf = _start_pdf(params, width, height, &icc_id);
+  if(!pdf)
+  {
+    dt_control_log(_("failed to create temporary PDF for printing"));
+    return 1;
+  }
+
+  dt_pdf_image_t *pdf_image[MAX_IMAGE_PER_PAGE];
+  int32_t count = 0;
+  gboolean failed = FALSE;
+
+  // compute the needed size for picture for the given printer
+  // resolution, export it and write it to the PDF right away
+
+  for(int k=0; k<params->imgs.count && !failed; k++)
+  {
+    dt_image_box *box = &params->imgs.box[k];
+    if(!dt_is_valid_imgid(box->imgid)) continue;
+
+    if(!dt_is_valid_imgid(imgid)) imgid = box->imgid;
+    if(_export_and_setup_pos(job, box, k)
+       || dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
+    {
+      failed = TRUE;
+      break;
+    }
+
+    pdf_image[count] = _add_pdf_image(params, pdf, box, icc_id);
+    if(pdf_image[count])
+      count++;
+    else
+      failed = TRUE;
+
+    dt_control_job_set_progress(job, 0.9 * count / MAX(images, 1));
+  }
+
+  params->pdf_page = dt_pdf_add_page(pdf, pdf_image, count);
+  dt_pdf_finish(pdf, &params->pdf_page, 1);
+  for(int k = 0; k < count; k++) free(pdf_image[k]);
 
-  if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED) return 0;
+  if(failed || dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
+  {
+    for(int k=0; k<params->imgs.count; k++)
+    {
+      g_free(params->imgs.box[k].buf);
+      params->imgs.box[k].buf = NULL;
+    }
+    return failed ? 1 : 0;
+  }
   dt_control_job_set_progress(job, 0.95);
 
   // send to CUPS
@@ -1382,12 +1417,24 @@ static void _load_image_full_page(dt_lib_print_settings_t *ps,
   dt_control_queue_redraw_center();
 }
 
+static void _box_surface_drop(dt_lib_print_settings_t *ps,
+                              const int k)
+{
+  if(ps->box_surface[k].surf) cairo_surface_destroy(ps->box_surface[k].surf);
+  ps->box_surface[k].surf = NULL;
+  ps->box_surface[k].imgid = NO_IMGID;
+}
+
 static void _print_settings_update_callback(gpointer instance,
                                             const dt_imgid_t imgid,
                                             dt_lib_module_t *self)
 {
   dt_lib_print_settings_t *ps = self->data;
 
+  // the image changed, render its boxes again
+  for(int k = 0; k < MAX_IMAGE_PER_PAGE; k++)
+    if(ps->box_surface[k].imgid == imgid) _box_surface_drop(ps, k);
+
   // if a mipmap has arrived for an image just activated in fullpage
   // mode, reorient the page (landscape or portrait) based on the
   // mipmap's orientation
@@ -2012,8 +2059,32 @@ void gui_post_expose(struct dt_lib_module_t *self,
 
       dt_printing_get_screen_pos(&ps->imgs, img, &screen);
 
-      const dt_view_surface_value_t res =
-        dt_view_image_get_surface(img->imgid, screen.width, screen.height, &surf, TRUE);
+      // the rendering of the box is kept as long as the image and its
+      // size don't change. while a box is dragged or resized the last
+      // one is scaled instead of rendering the image at each step.
+      dt_view_surface_value_t res = DT_VIEW_SURFACE_OK;
+      float surf_scale = 1.0f;
+      const int sw = screen.width;
+      const int sh = screen.height;
+      if(ps->box_surface[k].surf && ps->box_surface[k].imgid == img->imgid
+         && ((ps->box_surface[k].width == sw && ps->box_surface[k].height == sh)
+             || ps->dragging))
+      {
+        surf = cairo_surface_reference(ps->box_surface[k].surf);
+        surf_scale = (float)sw / MAX(ps->box_surface[k].width, 1);
+      }
+      else
+      {
+        res = dt_view_image_get_surface(img->imgid, sw, sh, &surf, TRUE);
+        if(res == DT_VIEW_SURFACE_OK)
+        {
+          _box_surface_drop(ps, k);
+          ps->box_surface[k].imgid = img->imgid;
+          ps->box_surface[k].width = sw;
+          ps->box_surface[k].height = sh;
+          ps->box_surface[k].surf = cairo_surface_reference(surf);
+        }
+      }
 
       if(res != DT_VIEW_SURFACE_OK)
       {
@@ -2026,7 +2097,7 @@ void gui_post_expose(struct dt_lib_module_t *self,
       {
         cairo_save(cr);
         cairo_translate(cr, screen.x, screen.y);
-        cairo_scale(cr, scaler, scaler);
+        cairo_scale(cr, scaler * surf_scale, scaler * surf_scale);
         cairo_set_source_surface(cr, surf, 0, 0);
         const double alpha =
           (ps->dragging
@@ -2404,6 +2475,11 @@ void gui_init(dt_lib_module_t *self)
 
   d->paper_list = NULL;
   d->media_list = NULL;
+  for(int k = 0; k < MAX_IMAGE_PER_PAGE; k++)
+  {
+    d->box_surface[k].surf = NULL;
+    d->box_surface[k].imgid = NO_IMGID;
+  }
   d->unit = 0;
   d->width = d->height = NULL;
   d->v_piccprofile = NULL;
@@ -3478,6 +3554,9 @@ void gui_cleanup(dt_lib_module_t *self)
   g_free(ps->v_piccprofile);
   g_free(ps->v_style);
 
+  for(int k = 0; k < MAX_IMAGE_PER_PAGE; k++)
+    _box_surface_drop(ps, k);
+
   free(self->data);
   self->data = NULL;
 }
@@ -154,6 +154,15 @@ typedef struct dt_scopes_t
   GtkWidget *scope_draw;                        // GtkDrawingArea -- scope & resize
   // for access to data during process/draw
   dt_pthread_mutex_t lock;
+  // scopes are computed by a worker, off the pipe thread, from the
+  // most recent pending frame -- a newer frame replaces a stale one
+  pthread_t worker;
+  gboolean worker_running;
+  GMutex pending_lock;
+  GCond pending_cond;
+  float *pending;                               // frame in histogram profile, or NULL
+  dt_histogram_roi_t pending_roi;
+  const dt_iop_order_iccprofile_info_t *pending_profile;
 } dt_scopes_t;
 
 /** the scope-specific function tables */
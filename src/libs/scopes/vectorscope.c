@@ -416,6 +416,7 @@ static void _lib_histogram_vectorscope_bkgd(dt_scopes_vec_t *d,
   d->hue_ring_colorspace = d->vectorscope_type;
 }
 
+DT_OMP_DECLARE_SIMD(aligned(RGB, chromaticity:16) uniform(vs_type, vs_prof, rgb2ryb_ypp))
 static void _get_chromaticity(const dt_aligned_pixel_t RGB,
                               dt_aligned_pixel_t chromaticity,
                               const dt_scopes_vec_vectorscope_type_t vs_type,
@@ -529,7 +530,23 @@ static void _vec_process(dt_scopes_mode_t *const self,
   // histogram profile PCS (always D50)?
   //
   // FIXME: pre-allocate? -- use the same buffer as for waveform?
-  dt_atomic_int *const restrict binned = (dt_atomic_int*)dt_calloc_align_int(diam_px * diam_px);
+  //
+  // Binning is into per-thread histograms, merged when making the
+  // graph, as atomic increments contend badly on the few bins near
+  // the center of the plot. Each row of chromaticities is first
+  // computed into a per-thread row of bin indices, so that the
+  // heavy color math runs as a SIMD loop free of scattered writes.
+  size_t bin_pad, row_pad;
+  uint32_t *const restrict partial_binned =
+    dt_calloc_perthread((size_t)diam_px * diam_px, sizeof(uint32_t), &bin_pad);
+  int *const restrict row_bins =
+    dt_alloc_perthread(MAX(1, sample_width / 2), sizeof(int), &row_pad);
+  if(!partial_binned || !row_bins)
+  {
+    dt_free_align(partial_binned);
+    dt_free_align(row_bins);
+    return;
+  }
   // FIXME: move verbosed interleaved comments into a method note at
   // the start, as the code itself is succinct and clear
   //
@@ -553,8 +570,12 @@ static void _vec_process(dt_scopes_mode_t *const self,
   // and scan, or do an optimized search (1/2, 1/2, 1/2, etc.) --
   // would also find point sample pixel this way
 
-  DT_OMP_FOR(collapse(2))
+  DT_OMP_FOR()
   for(size_t y=0; y<sample_max_y; y+=2)
+  {
+    uint32_t *const restrict binned = dt_get_perthread(partial_binned, bin_pad);
+    int *const restrict bins = dt_get_perthread(row_bins, row_pad);
+    DT_OMP_SIMD()
     for(size_t x=0; x<sample_max_x; x+=2)
     {
       // FIXME: There are unnecessary color math hops. Right now the
@@ -597,9 +618,14 @@ static void _vec_process(dt_scopes_mode_t *const self,
       const int out_y = (diam_px-1) * (chromaticity[2] / max_diam + 0.5f);
 
       // clip any out-of-scale values, so there aren't light edges
-      if(out_x >= 0 && out_x <= diam_px-1 && out_y >= 0 && out_y <= diam_px-1)
-        dt_atomic_add_int(binned + out_y * diam_px + out_x, 1);
+      const gboolean inside =
+        out_x >= 0 && out_x <= diam_px-1 && out_y >= 0 && out_y <= diam_px-1;
+      bins[x / 2] = inside ? out_y * diam_px + out_x : -1;
     }
+    for(size_t x=0; x<sample_max_x / 2; x++)
+      if(bins[x] >= 0) binned[bins[x]]++;
+  }
+  dt_free_align(row_bins);
 
   dt_aligned_pixel_t RGB = {0.f}, chromaticity;
   const dt_lib_colorpicker_statistic_t statistic =
@@ -669,17 +695,20 @@ static void _vec_process(dt_scopes_mode_t *const self,
   const float gain = 1.f / 30.f;
   const float scale = gain * (diam_px * diam_px) / (sample_width * sample_height);
 
-  // loop appears to be too small to benefit w/OpenMP
-  // FIXME: is this still true?
+  const size_t nthreads = dt_get_num_threads();
+
+  DT_OMP_FOR(collapse(2))
   for(size_t out_y = 0; out_y < diam_px; out_y++)
     for(size_t out_x = 0; out_x < diam_px; out_x++)
     {
-      const int count = binned[out_y * diam_px + out_x];
+      uint32_t count = 0;
+      for(size_t n = 0; n < nthreads; n++)
+        count += dt_get_bythread(partial_binned, bin_pad, n)[out_y * diam_px + out_x];
       const float intensity = lut[(int)(MIN(1.f, scale * count) * lutmax)];
       graph[out_y * out_stride + out_x] = intensity * 255.0f;
     }
 
-  dt_free_align(binned);
+  dt_free_align(partial_binned);
   self->update_counter = self->scopes->update_counter;
 }
 
@@ -34,6 +34,8 @@ DT_MODULE(1)
 
 #define HANDLE_SIZE 0.02
 #define MAX_SNAPSHOT 10
+// number of rendered snapshot surfaces kept around, for all snapshots
+#define SNAPSHOT_CACHE_SIZE 8
 
 // the snapshot offset in the memory table to use an area not used by the
 // undo/redo support.
@@ -55,11 +57,22 @@ typedef struct dt_lib_snapshot_t
   dt_imgid_t imgid;
   uint32_t history_end;
   uint32_t id;
+  // unique for each snapshot taken, identifies its rendered surfaces
+  uint32_t key;
+} dt_lib_snapshot_t;
+
+/* a rendered snapshot for a given view context and viewport size */
+typedef struct dt_lib_snapshot_render_t
+{
+  uint32_t key; // 0 when the slot is free
+  dt_view_context_t ctx;
+  int32_t vp_width, vp_height;
+  uint64_t last_used;
   uint8_t *buf;
   float scale;
   size_t width, height;
   dt_dev_zoom_pos_t zoom_pos;
-} dt_lib_snapshot_t;
+} dt_lib_snapshot_render_t;
 
 typedef struct dt_lib_snapshots_t
 {
@@ -75,6 +88,12 @@ typedef struct dt_lib_snapshots_t
   /* snapshots */
   dt_lib_snapshot_t snapshot[MAX_SNAPSHOT];
 
+  /* LRU of the rendered snapshots, toggling between snapshots or
+     going back to a previous zoom level won't run the pipe again */
+  dt_lib_snapshot_render_t cache[SNAPSHOT_CACHE_SIZE];
+  uint64_t cache_clock;
+  uint32_t next_key;
+
   /* change snapshot overlay controls */
   gboolean dragging, vertical, inverted, panning, sidebyside;
   double vp_width, vp_height, vp_xpointer, vp_ypointer, vp_xrotate, vp_yrotate;
@@ -208,6 +227,118 @@ static inline gboolean _get_rotation_area(dt_lib_module_t *self,
   return (abs(x - _rx) < area_size) && (abs(y - _ry) < area_size);
 }
 
+static void _cache_free_entry(dt_lib_snapshot_render_t *r)
+{
+  dt_free_align(r->buf);
+  memset(r, 0, sizeof(dt_lib_snapshot_render_t));
+}
+
+static void _cache_drop(dt_lib_snapshots_t *d, const uint32_t key)
+{
+  for(int k = 0; k < SNAPSHOT_CACHE_SIZE; k++)
+    if(d->cache[k].key && (key == 0 || d->cache[k].key == key))
+      _cache_free_entry(&d->cache[k]);
+}
+
+static dt_lib_snapshot_render_t *_cache_lookup(dt_lib_snapshots_t *d,
+                                               const uint32_t key,
+                                               const dt_view_context_t ctx,
+                                               const int32_t width,
+                                               const int32_t height)
+{
+  for(int k = 0; k < SNAPSHOT_CACHE_SIZE; k++)
+  {
+    dt_lib_snapshot_render_t *r = &d->cache[k];
+    if(r->key == key && r->ctx == ctx
+       && r->vp_width == width && r->vp_height == height)
+      return r;
+  }
+  return NULL;
+}
+
+// the most recently used render of a snapshot, whatever the view
+static dt_lib_snapshot_render_t *_cache_latest(dt_lib_snapshots_t *d,
+                                               const uint32_t key)
+{
+  dt_lib_snapshot_render_t *latest = NULL;
+  for(int k = 0; k < SNAPSHOT_CACHE_SIZE; k++)
+  {
+    dt_lib_snapshot_render_t *r = &d->cache[k];
+    if(r->key == key && (!latest || r->last_used > latest->last_used))
+      latest = r;
+  }
+  return latest;
+}
+
+// a free slot or the least recently used one, emptied
+static dt_lib_snapshot_render_t *_cache_get_slot(dt_lib_snapshots_t *d)
+{
+  dt_lib_snapshot_render_t *slot = &d->cache[0];
+  for(int k = 0; k < SNAPSHOT_CACHE_SIZE; k++)
+  {
+    dt_lib_snapshot_render_t *r = &d->cache[k];
+    if(!r->key)
+    {
+      slot = r;
+      break;
+    }
+    if(r->last_used < slot->last_used) slot = r;
+  }
+  _cache_free_entry(slot);
+  return slot;
+}
+
+static gboolean _snapshot_key_exists(dt_lib_snapshots_t *d, const uint32_t key)
+{
+  for(uint32_t k = 0; k < d->num_snapshots; k++)
+    if(d->snapshot[k].key == key) return TRUE;
+  return FALSE;
+}
+
+typedef struct _snapshot_prerender_t
+{
+  dt_lib_snapshots_t *d;
+  dt_imgid_t imgid;
+  uint32_t history_end;
+  uint32_t id;
+  dt_lib_snapshot_render_t render;
+} _snapshot_prerender_t;
+
+static gboolean _snapshot_prerender_done(gpointer user_data)
+{
+  _snapshot_prerender_t *p = user_data;
+  dt_lib_snapshots_t *d = p->d;
+
+  // the snapshot may have been removed or rendered on expose meanwhile
+  if(p->render.buf
+     && _snapshot_key_exists(d, p->render.key)
+     && !_cache_lookup(d, p->render.key, p->render.ctx,
+                       p->render.vp_width, p->render.vp_height))
+  {
+    dt_lib_snapshot_render_t *r = _cache_get_slot(d);
+    *r = p->render;
+    p->render.buf = NULL;
+    dt_control_queue_redraw_center();
+  }
+
+  dt_free_align(p->render.buf);
+  free(p);
+  return G_SOURCE_REMOVE;
+}
+
+static int32_t _snapshot_prerender_job_run(dt_job_t *job)
+{
+  _snapshot_prerender_t *p = dt_control_job_get_params(job);
+  dt_lib_snapshot_render_t *r = &p->render;
+
+  dt_dev_image(p->imgid, r->vp_width, r->vp_height, p->history_end,
+               &r->buf, &r->scale, &r->width, &r->height, r->zoom_pos,
+               p->id, NULL, DT_DEVICE_NONE, FALSE, FALSE);
+
+  g_idle_add(_snapshot_prerender_done, p);
+  return 0;
+}
+
 /* expose snapshot over center viewport */
 void gui_post_expose(dt_lib_module_t *self,
                      cairo_t *cri,
@@ -228,22 +359,28 @@ void gui_post_expose(dt_lib_module_t *self,
 
     const dt_view_context_t ctx = dt_view_get_context_hash();
 
+    dt_lib_snapshot_render_t *render =
+      _cache_lookup(d, snap->key, ctx, width, height);
+
     // if a new snapshot is needed, do this now
-    if(d->snap_requested && snap->ctx == ctx)
+    if(!render && d->snap_requested && snap->ctx == ctx)
     {
-      dt_free_align(snap->buf);
-      snap->buf = NULL;
+      render = _cache_get_slot(d);
+      render->key = snap->key;
+      render->ctx = ctx;
+      render->vp_width = width;
+      render->vp_height = height;
 
       // export image with proper size
       dt_dev_image(snap->imgid,
                    width,
                    height,
                    snap->history_end,
-                   &snap->buf,
-                   &snap->scale,
-                   &snap->width,
-                   &snap->height,
-                   snap->zoom_pos,
+                   &render->buf,
+                   &render->scale,
+                   &render->width,
+                   &render->height,
+                   render->zoom_pos,
                    snap->id,
                    NULL,
                    DT_DEVICE_NONE,
@@ -253,12 +390,18 @@ void gui_post_expose(dt_lib_module_t *self,
       d->expose_again_timeout_id = 0;
     }
 
+    if(render)
+    {
+      snap->ctx = ctx;
+      d->snap_requested = FALSE;
+    }
+
     // if ctx has changed, get a new snapshot at the right zoom
     // level. this is using a time out to ensure we don't try to
     // create many snapshot while zooming (this is slow), so we wait
     // to the zoom level to be stabilized to create the new snapshot.
-    if(snap->ctx != ctx
-       || !snap->buf)
+    // meanwhile the last render of this snapshot is shown.
+    else
     {
       // request a new snapshot in the following conditions:
       //    1. we are not panning
@@ -272,8 +415,12 @@ void gui_post_expose(dt_lib_module_t *self,
         g_source_remove(d->expose_again_timeout_id);
 
       d->expose_again_timeout_id = g_timeout_add(150, _snap_expose_again, d);
+
+      render = _cache_latest(d, snap->key);
     }
 
+    if(render) render->last_used = ++d->cache_clock;
+
     float pzx, pzy, zoom_scale;
     dt_dev_get_pointer_zoom_pos(&dev->full, 0, 0, &pzx, &pzy, &zoom_scale);
 
@@ -308,10 +455,11 @@ void gui_post_expose(dt_lib_module_t *self,
     cairo_clip(cri);
     cairo_fill(cri);
 
-    if(snap->buf)
+    if(render && render->buf)
     {
       dt_view_paint_surface(cri, width, height, &dev->full, DT_WINDOW_MAIN,
-                            snap->buf, snap->scale, snap->width, snap->height, snap->zoom_pos);
+                            render->buf, render->scale,
+                            render->width, render->height, render->zoom_pos);
     }
 
     cairo_restore(cri);
@@ -615,12 +763,15 @@ static void _init_snapshot_entry(dt_lib_module_t *self,
                    G_CALLBACK(_lib_snapshots_restore_callback), self);
 }
 
-static void _clear_snapshot_entry(dt_lib_snapshot_t *s)
+static void _clear_snapshot_entry(dt_lib_snapshots_t *d, dt_lib_snapshot_t *s)
 {
   // delete corresponding entry from the database
 
   dt_history_snapshot_clear(s->imgid, s->id);
 
+  if(s->key) _cache_drop(d, s->key);
+  s->key = 0;
+
   s->ctx = 0;
   s->imgid = NO_IMGID;
   s->history_end = -1;
@@ -636,10 +787,8 @@ static void _clear_snapshot_entry(dt_lib_snapshot_t *s)
 
   g_free(s->module);
   g_free(s->label);
-  dt_free_align(s->buf);
   s->module = NULL;
   s->label = NULL;
-  s->buf = NULL;
 }
 
 static void _clear_snapshots(dt_lib_module_t *self)
@@ -653,7 +802,7 @@ static void _clear_snapshots(dt_lib_module_t *self)
   {
     dt_lib_snapshot_t *s = &d->snapshot[k];
     s->id = SNAPSHOT_ID_OFFSET | k;
-    _clear_snapshot_entry(s);
+    _clear_snapshot_entry(d, s);
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(s->button), FALSE);
   }
 
@@ -677,6 +826,9 @@ static void _signal_profile_changed(gpointer instance,
   {
     dt_lib_snapshots_t *d = self->data;
 
+    // all rendered snapshots are for the previous profile
+    _cache_drop(d, 0);
+
     if(d->selected >= 0)
       d->snap_requested = TRUE;
 
@@ -689,7 +841,7 @@ static void _remove_snapshot_entry(dt_lib_module_t *self, const uint32_t index)
   dt_lib_snapshots_t *d = self->data;
 
   //  First clean the entry
-  _clear_snapshot_entry(&d->snapshot[index]);
+  _clear_snapshot_entry(d, &d->snapshot[index]);
 
   //  Repack all entries
   for(uint32_t k = index; k < MAX_SNAPSHOT-1; k++)
@@ -697,8 +849,10 @@ static void _remove_snapshot_entry(dt_lib_module_t *self, const uint32_t index)
     memcpy(&d->snapshot[k], &d->snapshot[k+1], sizeof(dt_lib_snapshot_t));
   }
 
-  //  And finally clear last entry
-  _clear_snapshot_entry(&d->snapshot[MAX_SNAPSHOT-1]);
+  //  And finally clear last entry, its renders now belong to the
+  //  repacked one
+  d->snapshot[MAX_SNAPSHOT-1].key = 0;
+  _clear_snapshot_entry(d, &d->snapshot[MAX_SNAPSHOT-1]);
   //  And dedup widgets by initializing the last entry
   _init_snapshot_entry(self, &d->snapshot[MAX_SNAPSHOT-1]);
 
@@ -832,7 +986,7 @@ void gui_init(dt_lib_module_t *self)
     dt_lib_snapshot_t *s = &d->snapshot[k];
     s->id = SNAPSHOT_ID_OFFSET | k;
 
-    _clear_snapshot_entry(s);
+    _clear_snapshot_entry(d, s);
     _init_snapshot_entry(self, s);
 
     GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
@@ -913,7 +1067,7 @@ static void _lib_snapshots_add_button_clicked_callback(GtkWidget *widget,
   // id at a specific offset.
   s->id = SNAPSHOT_ID_OFFSET | d->num_snapshots;
 
-  _clear_snapshot_entry(s);
+  _clear_snapshot_entry(d, s);
 
   if(darktable.develop->history_end > 0)
   {
@@ -943,6 +1097,33 @@ static void _lib_snapshots_add_button_clicked_callback(GtkWidget *widget,
 
   dt_history_snapshot_create(s->imgid, s->id, s->history_end);
 
+  s->key = ++d->next_key;
+
+  // render the snapshot for the current view in the background, so
+  // that it shows up at once when first toggled
+  if(d->vp_width > 0 && d->vp_height > 0)
+  {
+    _snapshot_prerender_t *p = calloc(1, sizeof(_snapshot_prerender_t));
+    dt_job_t *job = p
+      ? dt_control_job_create(_snapshot_prerender_job_run, "render snapshot")
+      : NULL;
+    if(job)
+    {
+      p->d = d;
+      p->imgid = s->imgid;
+      p->history_end = s->history_end;
+      p->id = s->id;
+      p->render.key = s->key;
+      p->render.ctx = dt_view_get_context_hash();
+      p->render.vp_width = d->vp_width;
+      p->render.vp_height = d->vp_height;
+      dt_control_job_set_params(job, p, NULL);
+      dt_control_add_job(DT_JOB_QUEUE_USER_BG, job);
+    }
+    else
+      free(p);
+  }
+
   GtkLabel *lnum =
     (GtkLabel *)_lib_snapshot_button_get_item(s->button, _SNAPSHOT_BUTTON_NUM);
   GtkLabel *lstatus =
@@ -20,6 +20,7 @@
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/datetime.h"
+#include "common/library_counts.h"
 #include "control/control.h"
 #include "develop/develop.h"
 #include "gui/accelerators.h"
@@ -662,26 +663,54 @@ static int _block_get_at_zoom(dt_lib_module_t *self, int width)
   if(_time_compare_at_zoom(strip->stop_t, strip->time_pos, strip->zoom) < 0) strip->stop_x = -1;
 
   sqlite3_stmt *stmt;
-  // clang-format off
-  gchar *query = g_strdup_printf("SELECT db.datetime_taken AS dt,"
-                                 " col.imgid FROM main.images AS db "
-                                 "LEFT JOIN memory.collected_images AS col ON db.id=col.imgid "
-                                 "WHERE dt > %lld "
-                                 "ORDER BY dt ASC",
-                                 (long long)_time_format_for_db(strip->time_pos, strip->zoom));
-  // clang-format on
+  const long long pos = _time_format_for_db(strip->time_pos, strip->zoom);
+  // rows of time, number of images and number of collected images. the
+  // images of the library are counted per minute in memory.time_counts,
+  // only those of the collection are grouped here.
+  gchar *query = NULL;
+  if(dt_library_counts_ready())
+    // clang-format off
+    query = g_strdup_printf("SELECT t.id * %lld AS dt, t.count, IFNULL(c.count, 0)"
+                            " FROM memory.time_counts AS t"
+                            " LEFT JOIN (SELECT db.datetime_taken / %lld AS minute,"
+                            "                   COUNT(*) AS count"
+                            "            FROM main.images AS db, memory.collected_images AS col"
+                            "            WHERE db.id = col.imgid AND db.datetime_taken >= %lld"
+                            "            GROUP BY minute) AS c"
+                            "   ON c.minute = t.id"
+                            " WHERE t.id >= %lld AND t.id > 0 AND t.count > 0"
+                            " ORDER BY t.id ASC",
+                            (long long)DT_LIBRARY_COUNTS_MINUTE,
+                            (long long)DT_LIBRARY_COUNTS_MINUTE, pos,
+                            pos / DT_LIBRARY_COUNTS_MINUTE);
+    // clang-format on
+  else
+    // clang-format off
+    query = g_strdup_printf("SELECT db.datetime_taken AS dt, 1,"
+                            " col.imgid IS NOT NULL FROM main.images AS db "
+                            "LEFT JOIN memory.collected_images AS col ON db.id=col.imgid "
+                            "WHERE dt > %lld "
+                            "ORDER BY dt ASC",
+                            pos);
+    // clang-format on
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
 
   dt_datetime_t tx;
-  int id = 0;
+  int count = 0;
+  int collected = 0;
   int stat = sqlite3_step(stmt);
   if(stat == SQLITE_ROW)
   {
     dt_datetime_gtimespan_to_numbers(&tx, sqlite3_column_int64(stmt, 0));
-    id = sqlite3_column_int(stmt, 1);
+    count = sqlite3_column_int(stmt, 1);
+    collected = sqlite3_column_int(stmt, 2);
   }
   else
+  {
+    sqlite3_finalize(stmt);
+    g_free(query);
     return 0;
+  }
 
   dt_datetime_t tt = strip->time_pos;
   // we round correctly this date
@@ -744,11 +773,12 @@ static int _block_get_at_zoom(dt_lib_module_t *self, int width)
       // and we count how many photos we have for this time
       while(stat == SQLITE_ROW && _time_compare_at_zoom(tt, tx, strip->zoom) == 0)
       {
-        bloc->values[i]++;
-        if(id > 0) bloc->collect_values[i]++;
+        bloc->values[i] += count;
+        bloc->collect_values[i] += collected;
         stat = sqlite3_step(stmt);
         dt_datetime_gtimespan_to_numbers(&tx, sqlite3_column_int64(stmt, 0));
-        id = sqlite3_column_int(stmt, 1);
+        count = sqlite3_column_int(stmt, 1);
+        collected = sqlite3_column_int(stmt, 2);
       }
 
       // and we jump to next date
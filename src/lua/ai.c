@@ -27,6 +27,7 @@
 #include "common/image_cache.h"
 #include "common/mipmap_cache.h"
 #include "develop/format.h"
+#include "develop/masks.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_dng.h"
 #include "imageio/imageio_module.h"
@@ -1364,6 +1365,26 @@ static int _ai_load_raw(lua_State *L)
   return 2; // tensor, metadata
 }
 
+// darktable.ai.precompute_object_masks({img, ...}): encode the images
+// for object masks in a background job
+static int _ai_precompute_object_masks(lua_State *L)
+{
+  luaL_checktype(L, 1, LUA_TTABLE);
+  GList *imgs = NULL;
+  lua_pushnil(L);
+  while(lua_next(L, 1))
+  {
+    dt_lua_image_t imgid;
+    luaA_to(L, dt_lua_image_t, &imgid, -1);
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(imgid));
+    lua_pop(L, 1);
+  }
+  imgs = g_list_reverse(imgs);
+  dt_masks_object_precompute(imgs);
+  g_list_free(imgs);
+  return 0;
+}
+
 // read EXIF blob from the source raw image. caller frees with g_free.
 // returns blob length; 0 means none (and *out_blob stays NULL)
 static int _read_exif_for_imgid(dt_imgid_t imgid,
@@ -1818,6 +1839,10 @@ int dt_lua_init_ai(lua_State *L)
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const_type(L, type_id, "save_dng_linear");
 
+  lua_pushcfunction(L, _ai_precompute_object_masks);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const_type(L, type_id, "precompute_object_masks");
+
   return 0;
 }
 
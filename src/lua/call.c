@@ -569,6 +569,97 @@ void dt_lua_async_call_string_internal(const char* function, int line,const char
 
 
 
+typedef struct _lua_job_t
+{
+  dt_lua_job_callback run;
+  void *data;
+  dt_job_destroy_callback destroy;
+  int callback; // registry reference of the lua function, LUA_NOREF without
+} _lua_job_t;
+
+typedef struct _lua_job_result_t
+{
+  int callback;
+  int32_t result;
+} _lua_job_result_t;
+
+static int _lua_job_finished(lua_State *L)
+{
+  // the result is freed once we yield, so read it first
+  const _lua_job_result_t *res = lua_touserdata(L, 1);
+  const int callback = res->callback;
+  const gboolean success = res->result == 0;
+  lua_rawgeti(L, LUA_REGISTRYINDEX, callback);
+  luaL_unref(L, LUA_REGISTRYINDEX, callback);
+  lua_pushboolean(L, success);
+  lua_call(L, 1, 0);
+  return 0;
+}
+
+static int32_t _lua_job_run(dt_job_t *job)
+{
+  _lua_job_t *j = dt_control_job_get_params(job);
+  const int32_t result = j->run(j->data);
+
+  if(j->callback != LUA_NOREF)
+  {
+    _lua_job_result_t *res = malloc(sizeof(_lua_job_result_t));
+    res->callback = j->callback;
+    res->result = result;
+    j->callback = LUA_NOREF;
+    dt_lua_async_call_alien(_lua_job_finished,
+        0, NULL, NULL,
+        LUA_ASYNC_TYPENAME_WITH_FREE, "void*", res, g_cclosure_new(G_CALLBACK(&free), NULL, NULL),
+        LUA_ASYNC_DONE);
+  }
+  return result;
+}
+
+static int _lua_job_unref(lua_State *L)
+{
+  luaL_unref(L, LUA_REGISTRYINDEX, lua_tointeger(L, 1));
+  return 0;
+}
+
+static void _lua_job_destroy(void *data)
+{
+  _lua_job_t *j = data;
+  // the job has been cancelled before it ran, the callback is never called
+  if(j->callback != LUA_NOREF && !darktable.lua_state.ending)
+    dt_lua_async_call_alien(_lua_job_unref,
+        0, NULL, NULL,
+        LUA_ASYNC_TYPENAME, "int32_t", j->callback,
+        LUA_ASYNC_DONE);
+  if(j->destroy) j->destroy(j->data);
+  free(j);
+}
+
+void dt_lua_run_job(lua_State *L, const char *name, dt_lua_job_callback run, void *data,
+                    dt_job_destroy_callback destroy, int cb_index)
+{
+  _lua_job_t *j = malloc(sizeof(_lua_job_t));
+  j->run = run;
+  j->data = data;
+  j->destroy = destroy;
+  j->callback = LUA_NOREF;
+  if(!lua_isnoneornil(L, cb_index))
+  {
+    lua_pushvalue(L, cb_index);
+    j->callback = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+
+  dt_job_t *job = dt_control_job_create(_lua_job_run, "lua: %s", name);
+  if(!job)
+  {
+    if(j->callback != LUA_NOREF) luaL_unref(L, LUA_REGISTRYINDEX, j->callback);
+    j->callback = LUA_NOREF;
+    _lua_job_destroy(j);
+    return;
+  }
+  dt_control_job_set_params(job, j, _lua_job_destroy);
+  dt_control_add_job(DT_JOB_QUEUE_USER_BG, job);
+}
+
 static gpointer lua_thread_main(gpointer data)
 {
   darktable.lua_state.pool = g_thread_pool_new(run_async_thread_main,NULL,-1,false,NULL);
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "control/jobs.h"
 #include "lua/lua.h"
 
 /*
@@ -83,6 +84,20 @@ void dt_lua_async_call_string_internal(const char* function, int line,const char
 
 
 
+/*
+   run some work in a background job (DT_JOB_QUEUE_USER_BG), without holding the lua lock
+   * run : does the work on data, returns 0 on success
+   * destroy : frees data once the job is gone
+   * cb_index : stack index of an optional lua function, called with a boolean success
+     flag once the job is done
+
+   takes ownership of data, even if the job can't be queued
+   */
+typedef int32_t (*dt_lua_job_callback)(void *data);
+void dt_lua_run_job(lua_State *L, const char *name, dt_lua_job_callback run, void *data,
+                    dt_job_destroy_callback destroy, int cb_index);
+
+
 int dt_lua_init_call(lua_State *L);
 
 // clang-format off
@@ -44,10 +44,11 @@
 // 5.2.0 was 9.5.0 (added apply_sidecar to image)
 // 5.4.0 was 9.6.0 (added event querying)
 // 5.6.0 was 9.7.0 (bundled lua scripts)
+// 5.8.0 was 9.8.0 (added batch image operations with background jobs)
 /* incompatible API change */
 #define LUA_API_VERSION_MAJOR 9
 /* backward compatible API change */
-#define LUA_API_VERSION_MINOR 7
+#define LUA_API_VERSION_MINOR 9
 /* bugfixes that should not change anything to the API */
 #define LUA_API_VERSION_PATCH 0
 /* suffix for unstable version */
@@ -25,6 +25,41 @@
 #include "lua/call.h"
 #include "lua/image.h"
 
+// how many images are passed to a batched event at most, and how long
+// the first one waits for the others
+#define DT_LUA_EVENT_BATCH_SIZE 256
+#define DT_LUA_EVENT_BATCH_DELAY 250 // ms
+
+// the events with callbacks registered, to be checked without the lua lock
+static GMutex _events_lock;
+static GHashTable *_events_in_use;
+
+// event name -> GArray of the image ids waiting to be sent
+static GMutex _batch_lock;
+static GHashTable *_batches;
+static guint _batch_source;
+
+static void _event_set_in_use(const char *event,
+                              const gboolean in_use)
+{
+  g_mutex_lock(&_events_lock);
+  if(!_events_in_use)
+    _events_in_use = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  if(in_use)
+    g_hash_table_add(_events_in_use, g_strdup(event));
+  else
+    g_hash_table_remove(_events_in_use, event);
+  g_mutex_unlock(&_events_lock);
+}
+
+gboolean dt_lua_event_in_use(const char *event)
+{
+  g_mutex_lock(&_events_lock);
+  const gboolean in_use = _events_in_use && g_hash_table_contains(_events_in_use, event);
+  g_mutex_unlock(&_events_lock);
+  return in_use;
+}
+
 
 void dt_lua_event_trigger(lua_State *L, const char *event, int nargs)
 {
@@ -466,6 +501,7 @@ static int lua_register_event(lua_State *L)
   // mark the event as in use
   lua_pushboolean(L, true);
   lua_setfield(L, -2, "in_use");
+  _event_set_in_use(evt_name, TRUE);
 
   //clear the stack
   lua_pop(L, 2);
@@ -537,6 +573,7 @@ static int lua_destroy_event(lua_State *L)
 
   // set in use
   lua_setfield(L, -2, "in_use");
+  _event_set_in_use(evt_name, count != 0);
 
   return 0;
 }
@@ -628,6 +665,91 @@ int dt_lua_init_early_events(lua_State *L)
   return 0;
 }
 
+/*
+ * BATCHED EVENTS
+ * the images are collected and passed to the callbacks as a table, at
+ * most DT_LUA_EVENT_BATCH_SIZE at a time, instead of one call each
+ */
+
+static int _batch_trigger(lua_State *L)
+{
+  // 1 : the name of the event
+  // 2 : the GArray of images, freed once we yield, so read it first
+  const char *event = luaL_checkstring(L, 1);
+  const GArray *imgs = lua_touserdata(L, 2);
+
+  lua_newtable(L);
+  for(guint i = 0; i < imgs->len; i++)
+  {
+    dt_imgid_t imgid = g_array_index(imgs, dt_imgid_t, i);
+    luaA_push(L, dt_lua_image_t, &imgid);
+    lua_seti(L, -2, i + 1);
+  }
+  dt_lua_event_trigger(L, event, 1);
+  return 0;
+}
+
+static void _batch_send(const char *event,
+                        GArray *imgs)
+{
+  dt_lua_async_call_alien(_batch_trigger,
+      0, NULL, NULL,
+      LUA_ASYNC_TYPENAME, "const char*", event,
+      LUA_ASYNC_TYPENAME_WITH_FREE, "void*", imgs, g_cclosure_new(G_CALLBACK(&g_array_unref), NULL, NULL),
+      LUA_ASYNC_DONE);
+}
+
+static gboolean _batch_timeout(gpointer user_data)
+{
+  g_mutex_lock(&_batch_lock);
+  _batch_source = 0;
+  g_mutex_unlock(&_batch_lock);
+  dt_lua_event_batch_flush();
+  return G_SOURCE_REMOVE;
+}
+
+void dt_lua_event_batch_add(const char *event,
+                            const dt_imgid_t imgid)
+{
+  GArray *full = NULL;
+  g_mutex_lock(&_batch_lock);
+  if(!_batches)
+    _batches = g_hash_table_new(g_str_hash, g_str_equal);
+  GArray *imgs = g_hash_table_lookup(_batches, event);
+  if(!imgs)
+  {
+    imgs = g_array_sized_new(FALSE, FALSE, sizeof(dt_imgid_t), DT_LUA_EVENT_BATCH_SIZE);
+    g_hash_table_insert(_batches, (gpointer)event, imgs);
+  }
+  g_array_append_val(imgs, imgid);
+  if(imgs->len >= DT_LUA_EVENT_BATCH_SIZE)
+  {
+    g_hash_table_remove(_batches, event);
+    full = imgs;
+  }
+  else if(!_batch_source)
+    _batch_source = g_timeout_add(DT_LUA_EVENT_BATCH_DELAY, _batch_timeout, NULL);
+  g_mutex_unlock(&_batch_lock);
+
+  if(full) _batch_send(event, full);
+}
+
+void dt_lua_event_batch_flush(void)
+{
+  g_mutex_lock(&_batch_lock);
+  GHashTable *batches = _batches;
+  _batches = NULL;
+  g_mutex_unlock(&_batch_lock);
+  if(!batches) return;
+
+  GHashTableIter iter;
+  gpointer event, imgs;
+  g_hash_table_iter_init(&iter, batches);
+  while(g_hash_table_iter_next(&iter, &event, &imgs))
+    _batch_send(event, imgs);
+  g_hash_table_destroy(batches);
+}
+
 /****************************
  * MSIC EVENTS REGISTRATION *
  ****************************/
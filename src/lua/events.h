@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "common/darktable.h"
 #include <lauxlib.h>
 #include <lua.h>
 #include <lualib.h>
@@ -70,6 +71,23 @@ void dt_lua_event_trigger(lua_State *L, const char *event, int nargs);
   */
 int dt_lua_event_trigger_wrapper(lua_State *L) ;
 
+/**
+  whether scripts have registered callbacks for the event,
+  can be called from any thread without the lua lock
+  */
+gboolean dt_lua_event_in_use(const char *event);
+
+/**
+  BATCHED EVENT
+  queue an image for a multiinstance event whose callbacks get a table of
+  images. the batch is sent once it is full, a short while after its first
+  image or on dt_lua_event_batch_flush(). the event name must be a static
+  string. can be called from any thread without the lua lock
+  */
+void dt_lua_event_batch_add(const char *event, const dt_imgid_t imgid);
+/** send all the pending batches */
+void dt_lua_event_batch_flush(void);
+
 /////////////////////
 //    HELPERS      //
 /////////////////////
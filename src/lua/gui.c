@@ -23,6 +23,7 @@
 #include "control/settings.h"
 #include "gui/accelerators.h"
 #include "lua/call.h"
+#include "lua/events.h"
 #include "lua/image.h"
 #include "lua/types.h"
 #include <glib.h>
@@ -382,24 +383,36 @@ static int _lua_job_valid(lua_State *L)
   }
 }
 
-static void _on_mouse_over_image_changed(gpointer instance, gpointer user_data)
+// set while a mouse-over event waits for the lua thread, the ones
+// raised meanwhile are superseded by it
+static gint _mouse_over_pending = 0;
+
+static int _mouse_over_trigger(lua_State *L)
 {
-  const dt_imgid_t imgid = dt_control_get_mouse_over_id();
+  // 1 : the name of the event
+  const char *event = luaL_checkstring(L, 1);
+  // the image hovered when the scripts run, not when it was queued
+  g_atomic_int_set(&_mouse_over_pending, 0);
+  dt_imgid_t imgid = dt_control_get_mouse_over_id();
   if(dt_is_valid_imgid(imgid))
   {
-    dt_lua_async_call_alien(dt_lua_event_trigger_wrapper,
-        0, NULL, NULL,
-        LUA_ASYNC_TYPENAME, "char*", "mouse-over-image-changed",
-        LUA_ASYNC_TYPENAME, "dt_lua_image_t", imgid,
-        LUA_ASYNC_DONE);
+    luaA_push(L, dt_lua_image_t, &imgid);
+    dt_lua_event_trigger(L, event, 1);
   }
   else
-  {
-    dt_lua_async_call_alien(dt_lua_event_trigger_wrapper,
+    dt_lua_event_trigger(L, event, 0);
+  return 0;
+}
+
+static void _on_mouse_over_image_changed(gpointer instance, gpointer user_data)
+{
+  if(!dt_lua_event_in_use("mouse-over-image-changed")) return;
+
+  if(g_atomic_int_compare_and_exchange(&_mouse_over_pending, 0, 1))
+    dt_lua_async_call_alien(_mouse_over_trigger,
         0, NULL, NULL,
         LUA_ASYNC_TYPENAME, "char*", "mouse-over-image-changed",
         LUA_ASYNC_DONE);
-  }
 }
 
 
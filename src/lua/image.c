@@ -141,12 +141,8 @@ static int generate_cache(lua_State *L)
 
   for(int k = max; k >= min && k >= 0; k--)
   {
-    char filename[PATH_MAX] = { 0 };
-    snprintf(filename, sizeof(filename),
-             "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-
-    // if a valid thumbnail file is already on disc - do nothing
-    if(dt_util_test_image_file(filename)) continue;
+    // if a valid thumbnail is already on disc - do nothing
+    if(dt_mipmap_cache_test_disk_thumbnail(imgid, k)) continue;
     // else, generate thumbnail and store in mipmap cache.
     dt_mipmap_buffer_t buf;
     dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
@@ -525,6 +521,22 @@ static int image_luaautoc_member(lua_State *L)
   }
 }
 
+GList *dt_lua_image_list_to_imgids(lua_State *L, int index)
+{
+  index = lua_absindex(L, index);
+  luaL_checktype(L, index, LUA_TTABLE);
+  GList *imgs = NULL;
+  lua_pushnil(L);
+  while(lua_next(L, index))
+  {
+    dt_lua_image_t imgid;
+    luaA_to(L, dt_lua_image_t, &imgid, -1);
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(imgid));
+    lua_pop(L, 1);
+  }
+  return g_list_reverse(imgs);
+}
+
 int dt_lua_init_image(lua_State *L)
 {
   luaA_struct(L, dt_image_t);
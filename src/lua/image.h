@@ -23,6 +23,9 @@
 
 typedef int dt_lua_image_t; // wrapper for dt_image_t id
 
+/** returns a list of image ids (GINT_TO_POINTER) from the table of images at index, the caller frees it */
+GList *dt_lua_image_list_to_imgids(lua_State *L, int index);
+
 int dt_lua_init_image(lua_State *L);
 
 // clang-format off
@@ -16,9 +16,13 @@
    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "common/image.h"
 #include "common/metadata.h"
+#include "control/signal.h"
 #include "lua/metadata.h"
+#include "lua/call.h"
 #include "lua/glist.h"
+#include "lua/image.h"
 #include "lua/types.h"
 
 static int exists(lua_State *L)
@@ -37,6 +41,72 @@ static int exists(lua_State *L)
   return 1;
 }
 
+typedef struct _metadata_images_t
+{
+  GList *imgs;
+  GList *key_value; // key, value, ...
+} _metadata_images_t;
+
+static int32_t _metadata_images_run(void *data)
+{
+  const _metadata_images_t *m = data;
+  dt_metadata_set_list(m->imgs, m->key_value, TRUE);
+  dt_image_synch_xmps(m->imgs);
+  DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_METADATA_CHANGED, DT_METADATA_SIGNAL_NEW_VALUE);
+  return 0;
+}
+
+static void _metadata_images_free(void *data)
+{
+  _metadata_images_t *m = data;
+  g_list_free(m->imgs);
+  // keys are owned by the metadata list, values are ours
+  for(GList *kv = m->key_value; kv && kv->next; kv = kv->next->next)
+    g_free(kv->next->data);
+  g_list_free(m->key_value);
+  free(m);
+}
+
+// table of images, table of name = value (as the image members), optional function
+// called once done in the background
+static int set_images(lua_State *L)
+{
+  luaL_checktype(L, 2, LUA_TTABLE);
+  if(!lua_isnoneornil(L, 3)) luaL_checktype(L, 3, LUA_TFUNCTION);
+  GList *imgs = dt_lua_image_list_to_imgids(L, 1);
+
+  GList *key_value = NULL;
+  lua_pushnil(L);
+  while(lua_next(L, 2))
+  {
+    const char *name = lua_type(L, -2) == LUA_TSTRING ? lua_tostring(L, -2) : NULL;
+    const char *key = dt_metadata_get_key_by_subkey(name);
+    if(!key || !lua_isstring(L, -1))
+    {
+      g_list_free(imgs);
+      for(GList *kv = key_value; kv && kv->next; kv = kv->next->next)
+        g_free(kv->next->data);
+      g_list_free(key_value);
+      return luaL_error(L, "invalid metadata %s", name ? name : "");
+    }
+    key_value = g_list_append(key_value, (gpointer)key);
+    key_value = g_list_append(key_value, g_strdup(lua_tostring(L, -1)));
+    lua_pop(L, 1);
+  }
+
+  _metadata_images_t *m = malloc(sizeof(_metadata_images_t));
+  m->key_value = key_value;
+  m->imgs = imgs;
+  if(lua_isnoneornil(L, 3))
+  {
+    _metadata_images_run(m);
+    _metadata_images_free(m);
+  }
+  else
+    dt_lua_run_job(L, "set metadata", _metadata_images_run, m, _metadata_images_free, 3);
+  return 0;
+}
+
 int dt_lua_init_metadata(lua_State *L)
 {
   dt_lua_push_darktable_lib(L);
@@ -45,6 +115,9 @@ int dt_lua_init_metadata(lua_State *L)
   lua_pushcfunction(L, exists);
   lua_setfield(L, -2, "exists");
 
+  lua_pushcfunction(L, set_images);
+  lua_setfield(L, -2, "set_images");
+
   lua_pop(L, 1);
 
   return 0;
@@ -19,6 +19,8 @@
 #include "lua/styles.h"
 #include "common/debug.h"
 #include "common/styles.h"
+#include "control/control.h"
+#include "lua/call.h"
 #include "lua/glist.h"
 #include "lua/image.h"
 #include "lua/types.h"
@@ -274,6 +276,84 @@ int dt_lua_style_apply(lua_State *L)
   return 1;
 }
 
+typedef struct _style_images_t
+{
+  gchar *name;
+  GList *imgs;
+} _style_images_t;
+
+static int32_t _style_images_run(void *data)
+{
+  const _style_images_t *st = data;
+  for(const GList *l = st->imgs; l; l = g_list_next(l))
+    dt_styles_apply_to_image(st->name, FALSE, FALSE, GPOINTER_TO_INT(l->data));
+  DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
+  dt_control_queue_redraw_center();
+  return 0;
+}
+
+static void _style_images_free(void *data)
+{
+  _style_images_t *st = data;
+  g_free(st->name);
+  g_list_free(st->imgs);
+  free(st);
+}
+
+typedef struct _style_dev_t
+{
+  gchar *name;
+  dt_imgid_t imgid;
+} _style_dev_t;
+
+// the history of the image being edited belongs to darkroom, change it on the gui thread
+static gboolean _style_apply_to_dev(gpointer data)
+{
+  _style_dev_t *sd = data;
+  if(darktable.develop && darktable.develop->image_storage.id == sd->imgid)
+    dt_styles_apply_to_dev(sd->name, sd->imgid);
+  else
+  {
+    dt_styles_apply_to_image(sd->name, FALSE, FALSE, sd->imgid);
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
+  }
+  g_free(sd->name);
+  free(sd);
+  return G_SOURCE_REMOVE;
+}
+
+int dt_lua_style_apply_images(lua_State *L)
+{
+  dt_style_t style;
+  luaA_to(L, dt_style_t, &style, 1);
+  if(!lua_isnoneornil(L, 3)) luaL_checktype(L, 3, LUA_TFUNCTION);
+  GList *imgs = dt_lua_image_list_to_imgids(L, 2);
+
+  _style_images_t *st = malloc(sizeof(_style_images_t));
+  st->name = g_strdup(style.name);
+  st->imgs = imgs;
+
+  // the image being edited gets the style through darkroom, as with apply
+  const dt_imgid_t dev_imgid = darktable.develop ? darktable.develop->image_storage.id : NO_IMGID;
+  if(dt_is_valid_imgid(dev_imgid) && g_list_find(st->imgs, GINT_TO_POINTER(dev_imgid)))
+  {
+    _style_dev_t *sd = malloc(sizeof(_style_dev_t));
+    sd->name = g_strdup(st->name);
+    sd->imgid = dev_imgid;
+    g_main_context_invoke(NULL, _style_apply_to_dev, sd);
+    st->imgs = g_list_remove(st->imgs, GINT_TO_POINTER(dev_imgid));
+  }
+
+  if(lua_isnoneornil(L, 3))
+  {
+    _style_images_run(st);
+    _style_images_free(st);
+  }
+  else
+    dt_lua_run_job(L, "apply style", _style_images_run, st, _style_images_free, 3);
+  return 0;
+}
+
 int dt_lua_style_import(lua_State *L)
 {
   const char *filename = luaL_checkstring(L, 1);
@@ -358,6 +438,10 @@ int dt_lua_init_styles(lua_State *L)
   dt_lua_gtk_wrap(L);
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const_type(L, type_id, "apply");
+  lua_pushcfunction(L, dt_lua_style_apply_images);
+  dt_lua_gtk_wrap(L);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const_type(L, type_id, "apply_images");
   lua_pushcfunction(L, dt_lua_style_import);
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const_type(L, type_id, "import");
@@ -36,6 +36,14 @@ int dt_lua_style_create_from_image(lua_State *L);
   */
 int dt_lua_style_apply(lua_State *L);
 
+/**
+  (-3,0)
+  takes a style, a table of images and an optional function, applies the style to all images.
+  with a function given, the styles are applied in a background job and the function is
+  called with a success flag once done
+  */
+int dt_lua_style_apply_images(lua_State *L);
+
 int dt_lua_init_styles(lua_State *L);
 
 // clang-format off
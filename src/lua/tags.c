@@ -21,6 +21,7 @@
 #include "common/image.h"
 #include "common/tags.h"
 #include "control/signal.h"
+#include "lua/call.h"
 #include "lua/image.h"
 #include "lua/types.h"
 
@@ -237,6 +238,66 @@ int dt_lua_tag_detach(lua_State *L)
   return 0;
 }
 
+typedef struct _tag_images_t
+{
+  dt_lua_tag_t tagid;
+  GList *imgs;
+  gboolean attach;
+} _tag_images_t;
+
+static int32_t _tag_images_run(void *data)
+{
+  const _tag_images_t *t = data;
+  const gboolean changed = t->attach
+    ? dt_tag_attach_images(t->tagid, t->imgs, TRUE)
+    : dt_tag_detach_images(t->tagid, t->imgs, TRUE);
+  if(changed)
+  {
+    dt_image_synch_xmps(t->imgs);
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
+  }
+  return 0;
+}
+
+static void _tag_images_free(void *data)
+{
+  _tag_images_t *t = data;
+  g_list_free(t->imgs);
+  free(t);
+}
+
+// tag, table of images, optional function called once done in the background
+static int _tag_images(lua_State *L, const gboolean attach)
+{
+  dt_lua_tag_t tagid;
+  luaA_to(L, dt_lua_tag_t, &tagid, 1);
+  if(!lua_isnoneornil(L, 3)) luaL_checktype(L, 3, LUA_TFUNCTION);
+  GList *imgs = dt_lua_image_list_to_imgids(L, 2);
+
+  _tag_images_t *t = malloc(sizeof(_tag_images_t));
+  t->tagid = tagid;
+  t->imgs = imgs;
+  t->attach = attach;
+  if(lua_isnoneornil(L, 3))
+  {
+    _tag_images_run(t);
+    _tag_images_free(t);
+  }
+  else
+    dt_lua_run_job(L, attach ? "attach tag" : "detach tag", _tag_images_run, t, _tag_images_free, 3);
+  return 0;
+}
+
+static int tag_lib_attach_images(lua_State *L)
+{
+  return _tag_images(L, TRUE);
+}
+
+static int tag_lib_detach_images(lua_State *L)
+{
+  return _tag_images(L, FALSE);
+}
+
 static int tag_lib_find(lua_State *L)
 {
   const char *name = luaL_checkstring(L, 1);
@@ -348,6 +409,12 @@ int dt_lua_init_tags(lua_State *L)
   lua_pushcfunction(L, dt_lua_tag_detach);
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const_type(L, type_id, "detach");
+  lua_pushcfunction(L, tag_lib_attach_images);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const_type(L, type_id, "attach_images");
+  lua_pushcfunction(L, tag_lib_detach_images);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const_type(L, type_id, "detach_images");
   lua_pushcfunction(L, dt_lua_tag_get_attached);
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const_type(L, type_id, "get_tags");
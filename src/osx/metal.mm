@@ -0,0 +1,153 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import <Foundation/Foundation.h>
+#import <Metal/Metal.h>
+
+#include "common/darktable.h"
+#include "metal.h"
+
+#if __has_feature(objc_arc)
+#define DT_METAL_RELEASE(obj) (obj) = nil
+#else
+#define DT_METAL_RELEASE(obj) do { [(obj) release]; (obj) = nil; } while(0)
+#endif
+
+static id<MTLDevice> _device = nil;
+static id<MTLCommandQueue> _queue = nil;
+
+// the self test: scale a float4 buffer in place, buffers use shared storage
+// so on unified memory no copy is needed to read the result back.
+static NSString *const _selftest_source =
+  @"#include <metal_stdlib>\n"
+   "using namespace metal;\n"
+   "kernel void dt_scale(device float4 *buf [[buffer(0)]],\n"
+   "                     constant float &factor [[buffer(1)]],\n"
+   "                     constant uint &count [[buffer(2)]],\n"
+   "                     uint gid [[thread_position_in_grid]])\n"
+   "{\n"
+   "  if(gid < count) buf[gid] *= factor;\n"
+   "}\n";
+
+static gboolean _metal_selftest(id<MTLDevice> device, id<MTLCommandQueue> queue)
+{
+  const uint32_t count = 1024;
+  const float factor = 2.0f;
+  gboolean success = FALSE;
+
+  @autoreleasepool
+  {
+    NSError *error = nil;
+    id<MTLLibrary> library = [device newLibraryWithSource:_selftest_source options:nil error:&error];
+    if(!library)
+    {
+      dt_print(DT_DEBUG_OPENCL, "[metal_init] can't compile the self test kernel: %s",
+               error ? [[error localizedDescription] UTF8String] : "unknown error");
+      return FALSE;
+    }
+    id<MTLFunction> function = [library newFunctionWithName:@"dt_scale"];
+    id<MTLComputePipelineState> pipeline = function
+      ? [device newComputePipelineStateWithFunction:function error:&error] : nil;
+    id<MTLBuffer> buffer = [device newBufferWithLength:count * 4 * sizeof(float)
+                                               options:MTLResourceStorageModeShared];
+
+    if(pipeline && buffer)
+    {
+      float *data = (float *)[buffer contents];
+      for(uint32_t k = 0; k < 4 * count; k++) data[k] = (float)k;
+
+      id<MTLCommandBuffer> command = [queue commandBuffer];
+      id<MTLComputeCommandEncoder> encoder = [command computeCommandEncoder];
+      [encoder setComputePipelineState:pipeline];
+      [encoder setBuffer:buffer offset:0 atIndex:0];
+      [encoder setBytes:&factor length:sizeof(factor) atIndex:1];
+      [encoder setBytes:&count length:sizeof(count) atIndex:2];
+      const NSUInteger width = MIN([pipeline maxTotalThreadsPerThreadgroup], (NSUInteger)256);
+      [encoder dispatchThreadgroups:MTLSizeMake((count + width - 1) / width, 1, 1)
+              threadsPerThreadgroup:MTLSizeMake(width, 1, 1)];
+      [encoder endEncoding];
+      [command commit];
+      [command waitUntilCompleted];
+
+      if([command status] == MTLCommandBufferStatusCompleted)
+      {
+        success = TRUE;
+        for(uint32_t k = 0; k < 4 * count && success; k++)
+          success = data[k] == factor * (float)k;
+      }
+      if(!success)
+        dt_print(DT_DEBUG_OPENCL, "[metal_init] self test kernel returned wrong results");
+    }
+    else
+      dt_print(DT_DEBUG_OPENCL, "[metal_init] can't set up the self test pipeline");
+
+    if(buffer) DT_METAL_RELEASE(buffer);
+    if(pipeline) DT_METAL_RELEASE(pipeline);
+    if(function) DT_METAL_RELEASE(function);
+    DT_METAL_RELEASE(library);
+  }
+  return success;
+}
+
+gboolean dt_metal_init(void)
+{
+  if(_device) return TRUE;
+
+  @autoreleasepool
+  {
+    id<MTLDevice> device = MTLCreateSystemDefaultDevice();
+    if(!device)
+    {
+      dt_print(DT_DEBUG_OPENCL, "[metal_init] no Metal device found");
+      return FALSE;
+    }
+    id<MTLCommandQueue> queue = [device newCommandQueue];
+    if(!queue || !_metal_selftest(device, queue))
+    {
+      if(queue) DT_METAL_RELEASE(queue);
+      DT_METAL_RELEASE(device);
+      dt_print(DT_DEBUG_OPENCL, "[metal_init] Metal device can't be used");
+      return FALSE;
+    }
+
+    dt_print(DT_DEBUG_OPENCL, "[metal_init] device '%s', %s memory, %.0f MB working set",
+             [[device name] UTF8String],
+             [device hasUnifiedMemory] ? "unified" : "discrete",
+             (double)[device recommendedMaxWorkingSetSize] / (1024.0 * 1024.0));
+    _device = device;
+    _queue = queue;
+  }
+  return TRUE;
+}
+
+void dt_metal_cleanup(void)
+{
+  if(_queue) DT_METAL_RELEASE(_queue);
+  if(_device) DT_METAL_RELEASE(_device);
+}
+
+gboolean dt_metal_available(void)
+{
+  return _device != nil;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,519 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* darktable-bench-kernels: times the reusable image kernels of src/common on
+   synthetic images at a set of image sizes and thread counts, on the CPU and
+   on the first OpenCL device
+
+     darktable-bench-kernels [--sizes 1024x768,6000x4000] [--threads 1,4,16]
+                             [--reps N] [--kernel NAME] [--cpu-only]
+
+   one line per kernel, size, thread count and device is printed, with the
+   median over the repetitions in milliseconds and the throughput in
+   megapixels per second.
+*/
+
+#include "common/darktable.h"
+#include "common/bilateral.h"
+#include "common/box_filters.h"
+#include "common/dwt.h"
+#include "common/eaw.h"
+#include "common/fast_guided_filter.h"
+#include "common/gaussian.h"
+#include "common/guided_filter.h"
+#include "common/interpolation.h"
+#include "common/locallaplacian.h"
+#include "common/nlmeans_core.h"
+#include "common/opencl.h"
+#ifdef HAVE_OPENCL
+#include "common/bilateralcl.h"
+#include "common/locallaplaciancl.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define MAX_REPS 64
+
+typedef void (*bench_cpu_func)(const float *const in, float *const out, const int width, const int height);
+#ifdef HAVE_OPENCL
+typedef cl_int (*bench_cl_func)(const int devid, cl_mem in, cl_mem out, const int width, const int height);
+#endif
+
+typedef struct bench_kernel_t
+{
+  const char *name;
+  bench_cpu_func cpu;
+#ifdef HAVE_OPENCL
+  bench_cl_func cl;
+#endif
+} bench_kernel_t;
+
+/* ---- CPU variants ---- */
+
+static void _gaussian(const float *const in, float *const out, const int width, const int height)
+{
+  const dt_aligned_pixel_t max = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_aligned_pixel_t min = { 0.0f, 0.0f, 0.0f, 0.0f };
+  dt_gaussian_t *g = dt_gaussian_init(width, height, 4, max, min, 8.0f, 0);
+  if(!g) return;
+  dt_gaussian_blur_4c(g, in, out);
+  dt_gaussian_free(g);
+}
+
+// the masks are blurred on one channel, by the generic path
+static void _gaussian_1c(const float *const in, float *const out, const int width, const int height)
+{
+  const float max = 1.0f;
+  const float min = 0.0f;
+  const size_t npixels = (size_t)width * height;
+  float *grey = dt_alloc_align_float(npixels);
+  dt_gaussian_t *g = dt_gaussian_init(width, height, 1, &max, &min, 8.0f, 0);
+  if(grey && g)
+  {
+    for(size_t k = 0; k < npixels; k++) grey[k] = in[4 * k];
+    dt_gaussian_blur(g, grey, out);
+  }
+  dt_gaussian_free(g);
+  dt_free_align(grey);
+}
+
+// three box means approximating the gaussian of sigma 8 above: their variance
+// 3 ((2r + 1)^2 - 1) / 12 is 56 for r = 7, against sigma^2 = 64
+static void _box_gaussian(const float *const in, float *const out, const int width, const int height)
+{
+  memcpy(out, in, sizeof(float) * 4 * width * height);
+  dt_box_mean(out, height, width, 4, 7, 3);
+}
+
+static void _bilateral(const float *const in, float *const out, const int width, const int height)
+{
+  dt_bilateral_t *b = dt_bilateral_init(width, height, 16.0f, 10.0f);
+  if(!b) return;
+  dt_bilateral_splat(b, in);
+  dt_bilateral_blur(b);
+  dt_bilateral_slice(b, in, out, 1.0f);
+  dt_bilateral_free(b);
+}
+
+static void _box_mean(const float *const in, float *const out, const int width, const int height)
+{
+  memcpy(out, in, sizeof(float) * 4 * width * height);
+  dt_box_mean(out, height, width, 4, 16, 1);
+}
+
+static void _eaw(const float *const in, float *const out, const int width, const int height)
+{
+  float *accum = dt_alloc_align_float((size_t)4 * width * height);
+  float *tmp = dt_alloc_align_float((size_t)4 * width * height);
+  if(accum && tmp)
+  {
+    const dt_aligned_pixel_t threshold = { 0.01f, 0.01f, 0.01f, 0.01f };
+    const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
+    memset(accum, 0, sizeof(float) * 4 * width * height);
+    const float *src = in;
+    for(int scale = 0; scale < 5; scale++)
+    {
+      float *dst = (scale & 1) ? out : tmp;
+      eaw_decompose_and_synthesize(dst, src, accum, scale, 0.001f, threshold, boost, width, height);
+      src = dst;
+    }
+  }
+  dt_free_align(accum);
+  dt_free_align(tmp);
+}
+
+static void _dwt(const float *const in, float *const out, const int width, const int height)
+{
+  memcpy(out, in, sizeof(float) * 4 * width * height);
+  dwt_params_t *p = dt_dwt_init(out, width, height, 4, 5, 0, 0, NULL, 1.0f);
+  if(!p) return;
+  dwt_decompose(p, NULL);
+  dt_dwt_free(p);
+}
+
+static void _guided_filter(const float *const in, float *const out, const int width, const int height)
+{
+  guided_filter(in, in, out, width, height, 4, 8, 0.1f, 1.0f, 0.0f, 1.0f);
+}
+
+static void _guided_filter_r64(const float *const in, float *const out, const int width, const int height)
+{
+  guided_filter(in, in, out, width, height, 4, 64, 0.1f, 1.0f, 0.0f, 1.0f);
+}
+
+// the fast guided filter works in-place on a grey image, blur the first channel.
+// the box means make its cost independent of the radius, compare the r16 and r256 timings.
+static void _fast_guided(const float *const in, float *const out, const int width, const int height,
+                         const int radius)
+{
+  const size_t npixels = (size_t)width * height;
+  for(size_t k = 0; k < npixels; k++) out[k] = fmaxf(in[4 * k], MIN_FLOAT);
+  fast_surface_blur(out, width, height, radius, 0.01f, 3, DT_GF_BLENDING_LINEAR, 1.0f,
+                    0.0f, exp2f(-14.0f), 4.0f);
+}
+
+static void _fast_guided_r16(const float *const in, float *const out, const int width, const int height)
+{
+  _fast_guided(in, out, width, height, 16);
+}
+
+static void _fast_guided_r256(const float *const in, float *const out, const int width, const int height)
+{
+  _fast_guided(in, out, width, height, 256);
+}
+
+static void _local_laplacian(const float *const in, float *const out, const int width, const int height)
+{
+  local_laplacian_internal(in, out, width, height, 0.2f, 0.5f, 0.5f, 0.2f, NULL, NULL);
+}
+
+static void _nlmeans(const float *const in, float *const out, const int width, const int height)
+{
+  const dt_iop_roi_t roi = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+  const dt_aligned_pixel_t norm = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_nlmeans_param_t params = { .scattering = 0.0f,
+                                      .scale = 1.0f,
+                                      .luma = 1.0f,
+                                      .chroma = 1.0f,
+                                      .center_weight = -1.0f,
+                                      .sharpness = 0.001f,
+                                      .patch_radius = 2,
+                                      .search_radius = 7,
+                                      .decimate = 0,
+                                      .norm = norm,
+                                      .pipetype = DT_DEV_PIXELPIPE_EXPORT };
+  nlmeans_denoise(in, out, &roi, &roi, &params);
+}
+
+static void _interpolation(const float *const in, float *const out, const int width, const int height)
+{
+  // downscale by a non-integer factor like the export does, the output fits into the input size
+  const dt_interpolation_t *itor = dt_interpolation_new(DT_INTERPOLATION_LANCZOS3);
+  const dt_iop_roi_t roi_in = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+  const float scale = 0.7f;
+  const dt_iop_roi_t roi_out = { .x = 0, .y = 0, .width = width * scale, .height = height * scale, .scale = scale };
+  dt_interpolation_resample(itor, out, &roi_out, in, &roi_in);
+}
+
+/* ---- OpenCL variants ---- */
+
+#ifdef HAVE_OPENCL
+static cl_int _gaussian_cl(const int devid, cl_mem in, cl_mem out, const int width, const int height)
+{
+  const dt_aligned_pixel_t max = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_aligned_pixel_t min = { 0.0f, 0.0f, 0.0f, 0.0f };
+  dt_gaussian_cl_t *g = dt_gaussian_init_cl(devid, width, height, 4, max, min, 8.0f, 0);
+  if(!g) return DT_OPENCL_PROCESS_CL;
+  const cl_int err = dt_gaussian_blur_cl(g, in, out);
+  dt_gaussian_free_cl(g);
+  return err;
+}
+
+static cl_int _bilateral_cl(const int devid, cl_mem in, cl_mem out, const int width, const int height)
+{
+  dt_bilateral_cl_t *b = dt_bilateral_init_cl(devid, width, height, 16.0f, 10.0f);
+  if(!b) return DT_OPENCL_PROCESS_CL;
+  cl_int err = dt_bilateral_splat_cl(b, in);
+  if(err == CL_SUCCESS) err = dt_bilateral_blur_cl(b);
+  if(err == CL_SUCCESS) err = dt_bilateral_slice_cl(b, in, out, 1.0f);
+  dt_bilateral_free_cl(b);
+  return err;
+}
+
+static cl_int _dwt_cl(const int devid, cl_mem in, cl_mem out, const int width, const int height)
+{
+  size_t origin[] = { 0, 0, 0 };
+  size_t region[] = { width, height, 1 };
+  cl_int err = dt_opencl_enqueue_copy_image(devid, in, out, origin, origin, region);
+  if(err != CL_SUCCESS) return err;
+  dwt_params_cl_t *p = dt_dwt_init_cl(devid, out, width, height, 5, 0, 0, NULL, 1.0f);
+  if(!p) return DT_OPENCL_PROCESS_CL;
+  err = dwt_decompose_cl(p, NULL);
+  dt_dwt_free_cl(p);
+  return err;
+}
+
+static cl_int _guided_filter_cl(const int devid, cl_mem in, cl_mem out, const int width, const int height)
+{
+  return guided_filter_cl(devid, in, in, out, width, height, 4, 8, 0.1f, 1.0f, 0.0f, 1.0f);
+}
+
+static cl_int _local_laplacian_cl(const int devid, cl_mem in, cl_mem out, const int width, const int height)
+{
+  dt_local_laplacian_cl_t *g = dt_local_laplacian_init_cl(devid, width, height, 0.2f, 0.5f, 0.5f, 0.2f);
+  if(!g) return DT_OPENCL_PROCESS_CL;
+  const cl_int err = dt_local_laplacian_cl(g, in, out);
+  dt_local_laplacian_free_cl(g);
+  return err;
+}
+
+static cl_int _interpolation_cl(const int devid, cl_mem in, cl_mem out, const int width, const int height)
+{
+  const dt_interpolation_t *itor = dt_interpolation_new(DT_INTERPOLATION_LANCZOS3);
+  const dt_iop_roi_t roi_in = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+  const float scale = 0.7f;
+  const dt_iop_roi_t roi_out = { .x = 0, .y = 0, .width = width * scale, .height = height * scale, .scale = scale };
+  return dt_interpolation_resample_cl(itor, devid, out, &roi_out, in, &roi_in);
+}
+#define CL(f) , f
+#else
+#define CL(f)
+#endif
+
+static const bench_kernel_t _kernels[] =
+{
+  { "gaussian",        _gaussian        CL(_gaussian_cl) },
+  { "gaussian_1c",     _gaussian_1c     CL(NULL) },
+  { "box_gaussian",    _box_gaussian    CL(NULL) },
+  { "bilateral",       _bilateral       CL(_bilateral_cl) },
+  { "box_mean",        _box_mean        CL(NULL) },
+  { "eaw",             _eaw             CL(NULL) },
+  { "dwt",             _dwt             CL(_dwt_cl) },
+  { "guided_filter",   _guided_filter   CL(_guided_filter_cl) },
+  { "guided_filter_r64", _guided_filter_r64 CL(NULL) },
+  { "fast_guided_r16", _fast_guided_r16 CL(NULL) },
+  { "fast_guided_r256", _fast_guided_r256 CL(NULL) },
+  { "local_laplacian", _local_laplacian CL(_local_laplacian_cl) },
+  { "nlmeans",         _nlmeans         CL(NULL) },
+  { "interpolation",   _interpolation   CL(_interpolation_cl) },
+};
+
+#undef CL
+
+static int _compare_double(const void *a, const void *b)
+{
+  const double da = *(const double *)a, db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+static double _median(double *t, const int n)
+{
+  qsort(t, n, sizeof(double), _compare_double);
+  return (n & 1) ? t[n / 2] : 0.5 * (t[n / 2 - 1] + t[n / 2]);
+}
+
+// a smooth gradient with some deterministic noise on top, so that edge aware
+// filters have something to do but the numbers stay reproducible
+static void _fill_input(float *const buf, const int width, const int height)
+{
+  uint32_t state = 0x9e3779b9u;
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+    {
+      float *px = buf + 4 * ((size_t)j * width + i);
+      for(int c = 0; c < 3; c++)
+      {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const float noise = (state & 0xffff) / 65535.0f - 0.5f;
+        px[c] = CLAMP(0.5f * (i + c * j) / (width + height) + 0.05f * noise + 0.25f, 0.0f, 1.0f);
+      }
+      px[3] = 1.0f;
+    }
+}
+
+static void _print(const char *kernel, const int width, const int height, const char *device, const double *t,
+                   const int reps)
+{
+  double sorted[MAX_REPS];
+  memcpy(sorted, t, sizeof(double) * reps);
+  const double median = _median(sorted, reps);
+  printf("%-16s %5dx%-5d %-24s %10.2f ms %9.1f MP/s\n", kernel, width, height, device, 1000.0 * median,
+         (double)width * height / 1e6 / MAX(median, 1e-9));
+  fflush(stdout);
+}
+
+static void _bench_cpu(const bench_kernel_t *k, const float *const in, float *const out, const int width,
+                       const int height, const int threads, const int reps)
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = threads;
+  omp_set_num_threads(threads);
+#endif
+  double t[MAX_REPS];
+  k->cpu(in, out, width, height); // warm up caches and allocator
+  for(int r = 0; r < reps; r++)
+  {
+    const double start = dt_get_wtime();
+    k->cpu(in, out, width, height);
+    t[r] = dt_get_wtime() - start;
+  }
+  char device[32];
+  snprintf(device, sizeof(device), "CPU %d thread%s", threads, threads > 1 ? "s" : "");
+  _print(k->name, width, height, device, t, reps);
+}
+
+#ifdef HAVE_OPENCL
+static void _bench_cl(const bench_kernel_t *k, const int devid, const float *const in, const int width,
+                      const int height, const int reps)
+{
+  cl_mem dev_in = dt_opencl_copy_host_to_image(devid, (void *)in, width, height, 4 * sizeof(float));
+  cl_mem dev_out = dt_opencl_alloc_device(devid, width, height, 4 * sizeof(float));
+  double t[MAX_REPS];
+  cl_int err = (dev_in && dev_out) ? CL_SUCCESS : CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  if(err == CL_SUCCESS)
+  {
+    err = k->cl(devid, dev_in, dev_out, width, height);
+    dt_opencl_finish(devid);
+  }
+  for(int r = 0; r < reps && err == CL_SUCCESS; r++)
+  {
+    const double start = dt_get_wtime();
+    err = k->cl(devid, dev_in, dev_out, width, height);
+    // the kernels are only enqueued, wait for the device to get the real time
+    dt_opencl_finish(devid);
+    t[r] = dt_get_wtime() - start;
+  }
+
+  dt_opencl_release_mem_object(dev_in);
+  dt_opencl_release_mem_object(dev_out);
+
+  char device[32];
+  snprintf(device, sizeof(device), "OpenCL %d", devid);
+  if(err == CL_SUCCESS)
+    _print(k->name, width, height, device, t, reps);
+  else
+    printf("%-16s %5dx%-5d %-24s failed: %s\n", k->name, width, height, device, cl_errstr(err));
+}
+#endif
+
+static void _usage(const char *prog)
+{
+  printf("usage: %s [--sizes WxH[,WxH...]] [--threads N[,N...]] [--reps N] [--kernel NAME] [--cpu-only]\n",
+         prog);
+  printf("kernels:");
+  for(int i = 0; i < sizeof(_kernels) / sizeof(*_kernels); i++) printf(" %s", _kernels[i].name);
+  printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *sizes_arg = "1024x768,3000x2000,6000x4000";
+  const char *threads_arg = NULL;
+  const char *kernel = NULL;
+  int reps = 5;
+  gboolean cpu_only = FALSE;
+
+  for(int k = 1; k < argc; k++)
+  {
+    if(!strcmp(argv[k], "--sizes") && argc > k + 1)
+      sizes_arg = argv[++k];
+    else if(!strcmp(argv[k], "--threads") && argc > k + 1)
+      threads_arg = argv[++k];
+    else if(!strcmp(argv[k], "--reps") && argc > k + 1)
+      reps = CLAMP(atoi(argv[++k]), 1, MAX_REPS);
+    else if(!strcmp(argv[k], "--kernel") && argc > k + 1)
+      kernel = argv[++k];
+    else if(!strcmp(argv[k], "--cpu-only"))
+      cpu_only = TRUE;
+    else
+    {
+      _usage(argv[0]);
+      exit(strcmp(argv[k], "--help") ? 1 : 0);
+    }
+  }
+
+  char *argv_override[] = { "darktable-bench-kernels", "--library", ":memory:", "--conf",
+                            "write_sidecar_files=never", cpu_only ? "--disable-opencl" : NULL, NULL };
+  int argc_override = cpu_only ? 6 : 5;
+
+  // init dt without gui and without data.db:
+  if(dt_init(argc_override, argv_override, FALSE, FALSE, NULL)) exit(1);
+
+  const int max_threads = darktable.num_openmp_threads;
+  gchar **sizes = g_strsplit(sizes_arg, ",", -1);
+  gchar **threads = threads_arg ? g_strsplit(threads_arg, ",", -1) : NULL;
+
+#ifdef HAVE_OPENCL
+  int devid = DT_DEVICE_NONE;
+  if(!cpu_only && dt_opencl_is_enabled())
+    devid = dt_opencl_lock_device(DT_DEV_PIXELPIPE_EXPORT);
+  if(devid >= 0)
+    printf("OpenCL device %d: %s\n", devid, darktable.opencl->dev[devid].fullname);
+#endif
+
+  for(int s = 0; sizes[s]; s++)
+  {
+    int width = 0, height = 0;
+    if(sscanf(sizes[s], "%dx%d", &width, &height) != 2 || width < 16 || height < 16)
+    {
+      fprintf(stderr, "invalid image size '%s'\n", sizes[s]);
+      continue;
+    }
+    float *in = dt_alloc_align_float((size_t)4 * width * height);
+    float *out = dt_alloc_align_float((size_t)4 * width * height);
+    if(!in || !out)
+    {
+      fprintf(stderr, "can't allocate buffers for %dx%d\n", width, height);
+      dt_free_align(in);
+      dt_free_align(out);
+      continue;
+    }
+    _fill_input(in, width, height);
+
+    for(int i = 0; i < sizeof(_kernels) / sizeof(*_kernels); i++)
+    {
+      const bench_kernel_t *k = &_kernels[i];
+      if(kernel && strcmp(kernel, k->name)) continue;
+
+      if(threads)
+      {
+        for(int t = 0; threads[t]; t++)
+          _bench_cpu(k, in, out, width, height, CLAMP(atoi(threads[t]), 1, max_threads), reps);
+      }
+      else
+      {
+        // single threaded and all threads by default
+        _bench_cpu(k, in, out, width, height, 1, reps);
+        if(max_threads > 1) _bench_cpu(k, in, out, width, height, max_threads, reps);
+      }
+#ifdef HAVE_OPENCL
+      if(devid >= 0 && k->cl) _bench_cl(k, devid, in, width, height, reps);
+#endif
+    }
+
+    dt_free_align(in);
+    dt_free_align(out);
+  }
+
+#ifdef _OPENMP
+  darktable.num_openmp_threads = max_threads;
+  omp_set_num_threads(max_threads);
+#endif
+#ifdef HAVE_OPENCL
+  if(devid >= 0) dt_opencl_unlock_device(devid);
+#endif
+
+  g_strfreev(sizes);
+  g_strfreev(threads);
+  dt_cleanup();
+
+  return 0;
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
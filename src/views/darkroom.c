@@ -30,6 +30,7 @@
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/metadata.h"
+#include "common/mipmap_cache.h"
 #include "common/overlay.h"
 #include "common/selection.h"
 #include "common/styles.h"
@@ -98,6 +99,35 @@ static void _refresh_active_image_rowid(const dt_imgid_t imgid)
   g_free(q);
 }
 
+// start loading the images next to imgid in the collection in the
+// background, so that stepping through the filmstrip finds their raw
+// data and the preview input in the mipmap cache. the next one goes first.
+static void _prefetch_neighbours(const dt_imgid_t imgid)
+{
+  if(!dt_is_valid_imgid(imgid) || !dt_conf_get_bool("plugins/darkroom/prefetch_neighbours"))
+    return;
+
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "SELECT c.imgid"
+     " FROM memory.collected_images AS c,"
+     "      (SELECT rowid AS r FROM memory.collected_images WHERE imgid = ?1) AS cur"
+     " WHERE c.rowid IN (cur.r + 1, cur.r - 1) AND c.imgid != ?1"
+     " ORDER BY c.rowid DESC",
+     -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
+    dt_mipmap_cache_get(NULL, id, DT_MIPMAP_FULL, DT_MIPMAP_PREFETCH, 'r');
+    dt_mipmap_cache_get(NULL, id, DT_MIPMAP_F, DT_MIPMAP_PREFETCH, 'r');
+  }
+  sqlite3_finalize(stmt);
+}
+
 /* signal handler for filmstrip image switching */
 
 static void _dev_change_image(dt_develop_t *dev, const dt_imgid_t imgid);
@@ -214,9 +244,13 @@ static void _get_zoom_pos_bnd(dt_dev_viewport_t *port,
   }
 }
 
+// read in expose, resolved in init
+static dt_conf_handle_t *_conf_loading_screen = NULL;
+
 void init(dt_view_t *self)
 {
   self->data = darktable.develop;
+  _conf_loading_screen = dt_conf_handle("darkroom/ui/loading_screen", DT_BOOL);
   darktable.view_manager->proxy.darkroom.view = self;
 
 #ifdef USE_LUA
@@ -749,7 +783,7 @@ void expose(dt_view_t *self,
       cairo_surface_destroy(darktable.gui->surface);
       darktable.gui->surface = NULL;
     }
-    if(!dt_conf_get_bool("darkroom/ui/loading_screen"))
+    if(!dt_conf_handle_get_bool(_conf_loading_screen))
     {
       // Cache the rendered content for display while loading the next image.
 #ifdef _WIN32
@@ -851,14 +885,14 @@ void expose(dt_view_t *self,
     else
     {
       fontsize = DT_PIXEL_APPLY_DPI(14);
-      if(dt_conf_get_bool("darkroom/ui/loading_screen"))
+      if(dt_conf_handle_get_bool(_conf_loading_screen))
         load_txt = g_strdup_printf(C_("darkroom", "loading `%s' ..."),
                                    dev->image_storage.filename);
       else
         load_txt = g_strdup(dev->image_storage.filename);
     }
 
-    if(dt_conf_get_bool("darkroom/ui/loading_screen"))
+    if(dt_conf_handle_get_bool(_conf_loading_screen))
     {
       dt_gui_gtk_set_source_rgb(cri, DT_GUI_COLOR_DARKROOM_BG);
       cairo_paint(cri);
@@ -1431,9 +1465,10 @@ static gboolean _dev_load_requested_image(gpointer user_data)
   DT_ENTER_GUI_UPDATE();
 
   dt_pthread_mutex_lock(&dev->history_mutex);
-  dt_dev_pixelpipe_cleanup_nodes(dev->full.pipe);
-  dt_dev_pixelpipe_cleanup_nodes(dev->preview_pipe);
-  dt_dev_pixelpipe_cleanup_nodes(dev->preview2.pipe);
+
+  // the pipe nodes are kept for the modules still there after the image
+  // change, the removed instances are freed once their nodes are gone
+  GList *removed = NULL;
 
   // chroma data will be fixed by reading whitebalance data from history
   dt_dev_reset_chroma(dev);
@@ -1473,11 +1508,19 @@ static gboolean _dev_load_requested_image(gpointer user_data)
       // we cleanup the module
       dt_action_cleanup_instance_iop(module);
 
-      free(module);
+      removed = g_list_prepend(removed, module);
     }
   }
   dev->iop = g_list_sort(dev->iop, dt_sort_iop_by_order);
 
+  dt_dev_pixelpipe_update_nodes(dev->full.pipe, dev);
+  dt_dev_pixelpipe_update_nodes(dev->preview_pipe, dev);
+  if(dev->preview2.widget && GTK_IS_WIDGET(dev->preview2.widget))
+    dt_dev_pixelpipe_update_nodes(dev->preview2.pipe, dev);
+  else
+    dt_dev_pixelpipe_cleanup_nodes(dev->preview2.pipe);
+  g_list_free_full(removed, free);
+
   // we also clear the saved modules
   while(dev->alliop)
   {
@@ -1491,14 +1534,11 @@ static gboolean _dev_load_requested_image(gpointer user_data)
   g_list_free_full(dev->allforms, (void (*)(void *))dt_masks_free_form);
   dev->allforms = NULL;
 
-  dt_dev_pixelpipe_create_nodes(dev->full.pipe, dev);
-  dt_dev_pixelpipe_create_nodes(dev->preview_pipe, dev);
-  if(dev->preview2.widget && GTK_IS_WIDGET(dev->preview2.widget))
-    dt_dev_pixelpipe_create_nodes(dev->preview2.pipe, dev);
   dt_dev_read_history(dev);
 
   // we have to init all module instances other than "base" instance
   char option[1024];
+  const gboolean lazy = dt_conf_get_bool("plugins/darkroom/lazy_module_widgets");
   for(const GList *modules = g_list_last(dev->iop);
       modules;
       modules = g_list_previous(modules))
@@ -1508,7 +1548,8 @@ static gboolean _dev_load_requested_image(gpointer user_data)
     {
       if(!dt_iop_is_hidden(module))
       {
-        dt_iop_gui_init(module);
+        if(!lazy || module->enabled)
+          dt_iop_gui_init(module);
 
         /* add module to right panel with safe header buttons */
         dt_iop_gui_set_expander(module);
@@ -1525,7 +1566,7 @@ static gboolean _dev_load_requested_image(gpointer user_data)
         snprintf(option, sizeof(option), "plugins/darkroom/%s/expanded", module->op);
         module->expanded = dt_conf_get_bool(option);
         dt_iop_gui_update_expanded(module);
-        if(module->change_image) module->change_image(module);
+        if(module->change_image && module->widget) module->change_image(module);
         dt_iop_gui_update_header(module);
       }
     }
@@ -1597,6 +1638,8 @@ static gboolean _dev_load_requested_image(gpointer user_data)
 
   dt_image_check_camera_missing_sample(&dev->image_storage);
 
+  _prefetch_neighbours(imgid);
+
 #ifdef USE_LUA
 
   _fire_darkroom_image_loaded_event(TRUE, imgid);
@@ -3863,6 +3906,8 @@ void enter(dt_view_t *self)
   darktable.darkroom_active_imgid_rowid = 0;
   _refresh_active_image_rowid(dev->image_storage.id);
 
+  _prefetch_neighbours(dev->image_storage.id);
+
   /*
    * add IOP modules to plugin list
    */
@@ -3871,6 +3916,7 @@ void enter(dt_view_t *self)
   if(sw) gtk_scrolled_window_set_propagate_natural_width(sw, FALSE);
 
   char option[1024];
+  const gboolean lazy = dt_conf_get_bool("plugins/darkroom/lazy_module_widgets");
 
   for(const GList *modules = g_list_last(dev->iop);
       modules;
@@ -3878,10 +3924,12 @@ void enter(dt_view_t *self)
   {
     dt_iop_module_t *module = modules->data;
 
-    /* initialize gui if iop have one defined */
+    /* initialize gui if iop have one defined, the modules not in use
+       only get their header until they are needed */
     if(!dt_iop_is_hidden(module))
     {
-      dt_iop_gui_init(module);
+      if(!lazy || module->enabled)
+        dt_iop_gui_init(module);
 
       /* add module to right panel */
       dt_iop_gui_set_expander(module);
@@ -4242,6 +4290,11 @@ void mouse_moved(dt_view_t *self,
 
   float zoom_x = FLT_MAX, zoom_y, zoom_scale;
 
+  // slow renderings of the center view start with the area under the pointer
+  _get_zoom_pos(&dev->full, x, y, &zoom_x, &zoom_y, &zoom_scale);
+  dev->full.focus_x = CLAMP(zoom_x, 0.0f, 1.0f);
+  dev->full.focus_y = CLAMP(zoom_y, 0.0f, 1.0f);
+
   if(!darktable.develop->darkroom_skip_mouse_events
      && dt_iop_color_picker_is_visible(dev)
      && ctl->button_down && ctl->button_down_which == 1)
@@ -51,6 +51,13 @@ typedef struct dt_geo_position_t
   dt_imgid_t imgid;
 } dt_geo_position_t;
 
+// one geotagged image of the index, sorted by longitude
+typedef struct dt_geo_index_t
+{
+  double lon, lat;
+  dt_imgid_t imgid;
+} dt_geo_index_t;
+
 typedef struct dt_map_image_t
 {
   dt_imgid_t imgid;
@@ -81,6 +88,11 @@ typedef struct dt_map_t
   int start_drag_offset_x, start_drag_offset_y;
   float thumb_lat_angle, thumb_lon_angle;
   sqlite3_stmt *main_query;
+  struct
+  {
+    GArray *points; // dt_geo_index_t sorted by longitude
+    gboolean valid;
+  } index;
   gboolean drop_filmstrip_activated;
   gboolean filter_images_drawn;
   int max_images_drawn;
@@ -252,6 +264,10 @@ static int _dbscan(const dt_map_t *lib,
                    const unsigned int minpts);
 static gboolean _view_map_prefs_changed(dt_map_t *lib);
 static void _view_map_build_main_query(dt_map_t *lib);
+static void _view_map_index_invalidate(dt_map_t *lib);
+static int _view_map_index_query(dt_map_t *lib,
+                                 const dt_map_box_t *bbox,
+                                 dt_geo_position_t **points);
 
 /* center map to on the baricenter of the image list */
 static gboolean _view_map_center_on_image_list(dt_view_t *self,
@@ -863,6 +879,7 @@ void cleanup(dt_view_t *self)
     // segfaults.  g_object_unref(G_OBJECT(lib->map));
   }
   if(lib->main_query) sqlite3_finalize(lib->main_query);
+  if(lib->index.points) g_array_free(lib->index.points, TRUE);
   free(self->data);
 }
 
@@ -881,6 +898,7 @@ gboolean try_enter(dt_view_t *self)
 static void _view_map_signal_change_raise(const gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;
+  _view_map_index_invalidate(self->data);
   dt_control_signal_block_by_func(darktable.signals,
                                   G_CALLBACK(_view_map_geotag_changed), self);
   dt_control_signal_block_by_func(darktable.signals,
@@ -1405,7 +1423,6 @@ static void _view_map_changed_callback_delayed(const gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;
   dt_map_t *lib = self->data;
-  const gboolean all_good = TRUE;
   gboolean needs_redraw = FALSE;
   const gboolean prefs_changed = _view_map_prefs_changed(lib);
 
@@ -1448,47 +1465,16 @@ static void _view_map_changed_callback_delayed(const gpointer user_data)
     dt_conf_set_float("plugins/map/latitude", center_lat);
     dt_conf_set_int("plugins/map/zoom", zoom);
 
-    /* let's reset and reuse the main_query statement */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->main_query);
-    DT_DEBUG_SQLITE3_RESET(lib->main_query);
-
-    /* bind bounding box coords for the main query */
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 1, lib->bbox.lon1);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 2, lib->bbox.lon2);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 3, lib->bbox.lat1);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 4, lib->bbox.lat2);
-
-    // count the images
-    int img_count = 0;
-    while(sqlite3_step(lib->main_query) == SQLITE_ROW)
-    {
-      img_count++;
-    }
-
     if(lib->points)
-      g_free(lib->points);
-    lib->points = NULL;
+      free(lib->points);
+    dt_times_t start;
+    dt_get_perf_times(&start);
+    const int img_count = _view_map_index_query(lib, &lib->bbox, &lib->points);
     lib->nb_points = img_count;
-    if(img_count > 0)
-      lib->points = (dt_geo_position_t *)calloc(img_count, sizeof(dt_geo_position_t));
+    dt_show_times(&start, "[map] retrieve image geolocations");
     dt_geo_position_t *p = lib->points;
     if(p)
     {
-      DT_DEBUG_SQLITE3_RESET(lib->main_query);
-      /* make the image list */
-      dt_times_t start;
-      dt_get_perf_times(&start);
-      int i = 0;
-      while(sqlite3_step(lib->main_query) == SQLITE_ROW && all_good && i < img_count)
-      {
-        p[i].imgid = sqlite3_column_int(lib->main_query, 0);
-        p[i].x = deg2rad(sqlite3_column_double(lib->main_query, 1));
-        p[i].y = deg2rad(sqlite3_column_double(lib->main_query, 2));
-        p[i].cluster_id = UNCLASSIFIED;
-        i++;
-      }
-      dt_show_times(&start, "[map] retrieve image geolocations");
-
       const float epsilon_factor = dt_conf_get_int("plugins/map/epsilon_factor");
       const int min_images = dt_conf_get_int("plugins/map/min_images_per_group");
       // zoom varies from 0 (156412 m/pixel) to 20 (0.149 m/pixel)
@@ -1503,12 +1489,20 @@ static void _view_map_changed_callback_delayed(const gpointer user_data)
       const int num_clusters = _dbscan(lib, p, img_count, epsilon, min_images);
       dt_show_times(&start, "[map] dbscan calculation");
 
-      // set the clusters
-      gboolean *processed = calloc(num_clusters+1,sizeof(gboolean));
+      // set the clusters in a single pass, the first image met in a
+      // cluster stands for it
+      struct { dt_map_image_t *entry; double x, y; } *groups =
+        calloc(num_clusters + 1, sizeof(*groups));
       GList *sel_imgs = dt_act_on_get_images(FALSE, FALSE, FALSE);
-      int group = -1;
-      for(i = 0; i< img_count; i++)
+      GHashTable *selected = g_hash_table_new(NULL, NULL);
+      for(const GList *l = sel_imgs; l; l = g_list_next(l))
+        g_hash_table_add(selected, l->data);
+      g_list_free(sel_imgs);
+
+      for(int i = 0; i < img_count; i++)
       {
+        const gboolean is_selected =
+          g_hash_table_contains(selected, GINT_TO_POINTER(p[i].imgid));
         if(p[i].cluster_id == NOISE)
         {
           dt_map_image_t *entry = calloc(1, sizeof(dt_map_image_t));
@@ -1520,54 +1514,47 @@ static void _view_map_changed_callback_delayed(const gpointer user_data)
             entry->longitude = rad2deg(p[i].x);
             entry->latitude = rad2deg(p[i].y);
             entry->group_same_loc = TRUE;
-            if(sel_imgs)
-              entry->selected_in_group = g_list_find((GList *)sel_imgs,
-                                                     GINT_TO_POINTER(entry->imgid))
-                                         ? TRUE : FALSE;
+            entry->selected_in_group = is_selected;
             lib->images = g_slist_prepend(lib->images, entry);
           }
+          continue;
         }
-        else if(!processed[p[i].cluster_id])
+
+        if(!groups) continue;
+        const int c = p[i].cluster_id;
+        dt_map_image_t *entry = groups[c].entry;
+        if(!entry)
         {
-          processed[p[i].cluster_id] = TRUE;
-          group = p[i].cluster_id;
-          dt_map_image_t *entry = calloc(1, sizeof(dt_map_image_t));
-          if(entry)
-          {
-            entry->imgid = p[i].imgid;
-            entry->group = p[i].cluster_id;
-            entry->group_same_loc = TRUE;
-            entry->selected_in_group = (sel_imgs && g_list_find((GList *)sel_imgs,
-                                                                GINT_TO_POINTER(p[i].imgid)))
-                                       ? TRUE : FALSE;
-            const double lon = p[i].x, lat = p[i].y;
+          entry = calloc(1, sizeof(dt_map_image_t));
+          if(!entry) continue;
+          entry->imgid = p[i].imgid;
+          entry->group = c;
+          entry->group_same_loc = TRUE;
+          groups[c].entry = entry;
+          groups[c].x = p[i].x;
+          groups[c].y = p[i].y;
+          lib->images = g_slist_prepend(lib->images, entry);
+        }
+        entry->group_count++;
+        entry->longitude += p[i].x;
+        entry->latitude += p[i].y;
+        if(entry->group_same_loc && (p[i].x != groups[c].x || p[i].y != groups[c].y))
+          entry->group_same_loc = FALSE;
+        if(is_selected) entry->selected_in_group = TRUE;
+      }
 
-            for(int j = 0; j < img_count; j++)
-            {
-              if(p[j].cluster_id == group)
-              {
-                entry->group_count++;
-                entry->longitude += p[j].x;
-                entry->latitude += p[j].y;
-                if(entry->group_same_loc && (p[j].x != lon || p[j].y != lat))
-                {
-                  entry->group_same_loc = FALSE;
-                }
-                if(sel_imgs && !entry->selected_in_group)
-                {
-                  if(g_list_find((GList *)sel_imgs, GINT_TO_POINTER(p[j].imgid)))
-                    entry->selected_in_group = TRUE;
-                }
-              }
-            }
-            entry->latitude = rad2deg(entry->latitude) / entry->group_count;
-            entry->longitude = rad2deg(entry->longitude) / entry->group_count;
-            lib->images = g_slist_prepend(lib->images, entry);
-          }
+      if(groups)
+      {
+        for(int c = 0; c <= num_clusters; c++)
+        {
+          dt_map_image_t *entry = groups[c].entry;
+          if(!entry) continue;
+          entry->latitude = rad2deg(entry->latitude) / entry->group_count;
+          entry->longitude = rad2deg(entry->longitude) / entry->group_count;
         }
+        free(groups);
       }
-      free(processed);
-      g_list_free(sel_imgs);
+      g_hash_table_destroy(selected);
     }
 
     needs_redraw = _view_map_draw_images(self);
@@ -2316,7 +2303,7 @@ void leave(dt_view_t *self)
 static void _view_map_undo_callback(dt_action_t *action)
 {
   dt_view_t *self = dt_action_view(action);
-  const dt_map_t *lib = self->data;
+  dt_map_t *lib = self->data;
 
   // let current map view unchanged (avoid to center the map on collection)
   dt_control_signal_block_by_func(darktable.signals,
@@ -2328,13 +2315,14 @@ static void _view_map_undo_callback(dt_action_t *action)
                                     G_CALLBACK(_view_map_collection_changed), self);
   dt_control_signal_unblock_by_func(darktable.signals,
                                     G_CALLBACK(_view_map_geotag_changed), self);
+  _view_map_index_invalidate(lib);
   g_signal_emit_by_name(lib->map, "changed");
 }
 
 static void _view_map_redo_callback(dt_action_t *action)
 {
   dt_view_t *self = dt_action_view(action);
-  const dt_map_t *lib = self->data;
+  dt_map_t *lib = self->data;
 
   // let current map view unchanged (avoid to center the map on collection)
   dt_control_signal_block_by_func(darktable.signals,
@@ -2346,6 +2334,7 @@ static void _view_map_redo_callback(dt_action_t *action)
                                     G_CALLBACK(_view_map_collection_changed), self);
   dt_control_signal_unblock_by_func(darktable.signals,
                                     G_CALLBACK(_view_map_geotag_changed), self);
+  _view_map_index_invalidate(lib);
   g_signal_emit_by_name(lib->map, "changed");
 }
 
@@ -2849,7 +2838,9 @@ static void _view_map_collection_changed(gpointer instance,
                                          const gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;
-  const dt_map_t *lib = self->data;
+  dt_map_t *lib = self->data;
+  // the index also holds the removed images or, when filtering, the old collection
+  _view_map_index_invalidate(lib);
   // avoid to centre the map on collection while a location is active
   if(darktable.view_manager->proxy.map.view && !lib->loc.main.id)
   {
@@ -2883,7 +2874,8 @@ static void _view_map_geotag_changed(gpointer instance, GList *imgs,
   if(!locid)
   {
     const dt_view_t *self = (dt_view_t *)user_data;
-    const dt_map_t *lib = self->data;
+    dt_map_t *lib = self->data;
+    _view_map_index_invalidate(lib);
     if(darktable.view_manager->proxy.map.view)
       g_signal_emit_by_name(lib->map, "changed");
   }
@@ -3199,6 +3191,97 @@ static void _view_map_build_main_query(dt_map_t *lib)
                               geo_query, -1, &lib->main_query, NULL);
 
   g_free(geo_query);
+  _view_map_index_invalidate(lib);
+}
+
+static void _view_map_index_invalidate(dt_map_t *lib)
+{
+  lib->index.valid = FALSE;
+}
+
+static gint _view_map_index_cmp(gconstpointer a, gconstpointer b)
+{
+  const dt_geo_index_t *pa = (const dt_geo_index_t *)a;
+  const dt_geo_index_t *pb = (const dt_geo_index_t *)b;
+  return pa->lon < pb->lon ? -1 : pa->lon > pb->lon ? 1 : 0;
+}
+
+// load the locations of all the images the main query can return once
+// and keep them sorted by longitude, so panning and zooming only have
+// to look up the visible strip instead of querying the database again
+static void _view_map_index_build(dt_map_t *lib)
+{
+  if(!lib->index.points)
+    lib->index.points = g_array_new(FALSE, FALSE, sizeof(dt_geo_index_t));
+  g_array_set_size(lib->index.points, 0);
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->main_query);
+  DT_DEBUG_SQLITE3_RESET(lib->main_query);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 1, -180.0);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 2, 180.0);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 3, 90.0);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 4, -90.0);
+  while(sqlite3_step(lib->main_query) == SQLITE_ROW)
+  {
+    const dt_geo_index_t pt = { .imgid = sqlite3_column_int(lib->main_query, 0),
+                                .lon = sqlite3_column_double(lib->main_query, 1),
+                                .lat = sqlite3_column_double(lib->main_query, 2) };
+    g_array_append_val(lib->index.points, pt);
+  }
+  g_array_sort(lib->index.points, _view_map_index_cmp);
+  lib->index.valid = TRUE;
+
+  dt_show_times_f(&start, "[map]", "build location index of %u images",
+                  lib->index.points->len);
+}
+
+// return the number of indexed images inside the bounding box and
+// allocate *points for them, left to the caller to free
+static int _view_map_index_query(dt_map_t *lib,
+                                 const dt_map_box_t *bbox,
+                                 dt_geo_position_t **points)
+{
+  *points = NULL;
+  if(!lib->index.valid) _view_map_index_build(lib);
+
+  const dt_geo_index_t *idx = (dt_geo_index_t *)lib->index.points->data;
+  const int len = lib->index.points->len;
+
+  // first entry with longitude >= lon1
+  int lo = 0, hi = len;
+  while(lo < hi)
+  {
+    const int mid = lo + (hi - lo) / 2;
+    if(idx[mid].lon < bbox->lon1) lo = mid + 1;
+    else hi = mid;
+  }
+  int end = lo;
+  while(end < len && idx[end].lon <= bbox->lon2) end++;
+  if(end == lo) return 0;
+
+  dt_geo_position_t *p = calloc(end - lo, sizeof(dt_geo_position_t));
+  if(!p) return 0;
+
+  int count = 0;
+  for(int i = lo; i < end; i++)
+  {
+    if(idx[i].lat > bbox->lat1 || idx[i].lat < bbox->lat2) continue;
+    p[count].imgid = idx[i].imgid;
+    p[count].x = deg2rad(idx[i].lon);
+    p[count].y = deg2rad(idx[i].lat);
+    p[count].cluster_id = UNCLASSIFIED;
+    count++;
+  }
+  if(!count)
+  {
+    free(p);
+    return 0;
+  }
+  *points = p;
+  return count;
 }
 
 GSList *mouse_actions(const dt_view_t *self)
@@ -41,15 +41,13 @@ typedef enum dt_slideshow_event_t
   S_REQUEST_STEP_BACK,
 } dt_slideshow_event_t;
 
-typedef enum dt_slideshow_slot_t
-{
-  S_LEFT      = 0,
-  S_LEFT_M    = 1,
-  S_CURRENT   = 2,
-  S_RIGHT_M   = 3,
-  S_RIGHT     = 4,
-  S_SLOT_LAST = 5
-} dt_slideshow_slot_t;
+// images kept ready on each side of the current one, see slideshow_lookahead
+#define SLIDESHOW_MAX_DEPTH 8
+#define SLIDESHOW_MAX_SLOTS (2 * SLIDESHOW_MAX_DEPTH + 1)
+// images rendered at the same time
+#define SLIDESHOW_MAX_JOBS 2
+// a cached mip filling this much of the screen is shown instead of rendering
+#define SLIDESHOW_MIP_FILL 0.9f
 
 typedef struct _slideshow_buf_t
 {
@@ -59,6 +57,7 @@ typedef struct _slideshow_buf_t
   int rank;
   dt_imgid_t imgid;
   gboolean invalidated;
+  gboolean processing;
 } dt_slideshow_buf_t;
 
 typedef struct dt_slideshow_t
@@ -66,8 +65,11 @@ typedef struct dt_slideshow_t
   int32_t col_count;
   size_t width, height;
 
-  // buffers
-  dt_slideshow_buf_t buf[S_SLOT_LAST];
+  // buffers, the current image is in the middle at buf[depth]
+  dt_slideshow_buf_t buf[SLIDESHOW_MAX_SLOTS];
+  int depth, nslots;
+  // frames which dropped out of the slots, reused when going back
+  dt_slideshow_buf_t spare[SLIDESHOW_MAX_DEPTH];
   int id_preview_displayed;
   int id_displayed;
 
@@ -76,6 +78,7 @@ typedef struct dt_slideshow_t
 
   gboolean auto_advance;
   int exporting;
+  int jobs;
   int delay;
 
   // some magic to hide the mouse pointer
@@ -93,6 +96,11 @@ typedef struct dt_slideshow_format_t
 static void _step_state(dt_slideshow_t *d, dt_slideshow_event_t event);
 static dt_job_t *_process_job_create(dt_slideshow_t *d);
 
+static inline dt_slideshow_buf_t *_current(dt_slideshow_t *d)
+{
+  return &d->buf[d->depth];
+}
+
 static dt_imgid_t _get_image_at_rank(const int rank)
 {
   // get random image id from sql
@@ -114,12 +122,12 @@ static dt_imgid_t _get_image_at_rank(const int rank)
   return id;
 }
 
-static dt_slideshow_slot_t _get_slot_for_image(const dt_slideshow_t *d,
-                                               const dt_imgid_t imgid)
+static int _get_slot_for_image(const dt_slideshow_t *d,
+                               const dt_imgid_t imgid)
 {
-  dt_slideshow_slot_t slt = -1;
+  int slt = -1;
 
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
+  for(int slot = 0; slot < d->nslots; slot++)
   {
     if(d->buf[slot].imgid == imgid)
     {
@@ -138,49 +146,117 @@ static void _init_slot(dt_slideshow_buf_t *s)
   s->rank = -1;
   s->imgid = NO_IMGID;
   s->invalidated = TRUE;
+  s->processing = FALSE;
 }
 
-static void _shift_left(dt_slideshow_t *d)
+// keep a frame leaving the slots, dropping the oldest spare one
+static void _keep_spare(dt_slideshow_t *d,
+                        dt_slideshow_buf_t *s)
 {
-  uint8_t *tmp_buf = d->buf[S_LEFT].buf;
+  if(!s->buf || s->invalidated)
+  {
+    dt_free_align(s->buf);
+    return;
+  }
+  dt_free_align(d->spare[d->depth - 1].buf);
+  memmove(&d->spare[1], &d->spare[0], (d->depth - 1) * sizeof(dt_slideshow_buf_t));
+  d->spare[0] = *s;
+  d->spare[0].processing = FALSE;
+}
 
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_RIGHT; slot++)
+// fill a new slot, with a kept frame if there is one for the screen size
+static void _fill_slot(dt_slideshow_t *d,
+                       dt_slideshow_buf_t *s,
+                       const int rank)
+{
+  _init_slot(s);
+  s->rank = rank;
+  s->imgid = rank >= 0 && rank < d->col_count ? _get_image_at_rank(rank) : NO_IMGID;
+  if(!dt_is_valid_imgid(s->imgid)) return;
+
+  for(int k = 0; k < d->depth; k++)
   {
-    memcpy(&d->buf[slot], &d->buf[slot+1], sizeof(dt_slideshow_buf_t));
+    dt_slideshow_buf_t *sp = &d->spare[k];
+    if(sp->buf && sp->imgid == s->imgid)
+    {
+      if(sp->width <= d->width && sp->height <= d->height)
+      {
+        s->buf = sp->buf;
+        s->width = sp->width;
+        s->height = sp->height;
+        s->invalidated = FALSE;
+      }
+      else
+        dt_free_align(sp->buf);
+      memmove(sp, sp + 1, (d->depth - 1 - k) * sizeof(dt_slideshow_buf_t));
+      _init_slot(&d->spare[d->depth - 1]);
+      break;
+    }
   }
+}
+
+static void _shift_left(dt_slideshow_t *d)
+{
+  dt_slideshow_buf_t first = d->buf[0];
 
-  _init_slot(&d->buf[S_RIGHT]);
-  d->buf[S_RIGHT].rank  = d->buf[S_CURRENT].rank + 2;
-  d->buf[S_RIGHT].imgid = d->buf[S_RIGHT].rank <= d->col_count
-    ? _get_image_at_rank(d->buf[S_RIGHT].rank)
-    : NO_IMGID;
+  memmove(&d->buf[0], &d->buf[1], (d->nslots - 1) * sizeof(dt_slideshow_buf_t));
+
+  _keep_spare(d, &first);
+  _fill_slot(d, &d->buf[d->nslots - 1], _current(d)->rank + d->depth);
   d->id_displayed = -1;
   d->id_preview_displayed = -1;
-  dt_free_align(tmp_buf);
 }
 
 static void _shift_right(dt_slideshow_t *d)
 {
-  uint8_t *tmp_buf = d->buf[S_RIGHT].buf;
+  dt_slideshow_buf_t last = d->buf[d->nslots - 1];
 
-  for(dt_slideshow_slot_t slot=S_RIGHT; slot>S_LEFT; slot--)
-  {
-    memcpy(&d->buf[slot], &d->buf[slot-1], sizeof(dt_slideshow_buf_t));
-  }
+  memmove(&d->buf[1], &d->buf[0], (d->nslots - 1) * sizeof(dt_slideshow_buf_t));
 
-  _init_slot(&d->buf[S_LEFT]);
-  d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 2;
-  d->buf[S_LEFT].imgid = d->buf[S_LEFT].rank >= 0
-    ? _get_image_at_rank(d->buf[S_LEFT].rank)
-    : NO_IMGID;
+  _keep_spare(d, &last);
+  _fill_slot(d, &d->buf[0], _current(d)->rank - d->depth);
   d->id_displayed = -1;
   d->id_preview_displayed = -1;
-  dt_free_align(tmp_buf);
 }
 
+static gboolean _is_slot_waiting(const dt_slideshow_t *d,
+                                 const int slot)
+{
+  return d->buf[slot].invalidated
+         && !d->buf[slot].processing
+         && d->buf[slot].buf == NULL
+         && dt_is_valid_imgid(d->buf[slot].imgid)
+         && d->buf[slot].rank >= 0;
+}
+
+// the slot to render next: the current image, then the following ones
+// and then the previous ones, nearest first. -1 if there is none.
+static int _next_waiting_slot(const dt_slideshow_t *d)
+{
+  if(_is_slot_waiting(d, d->depth)) return d->depth;
+  for(int k = 1; k <= d->depth; k++)
+    if(_is_slot_waiting(d, d->depth + k)) return d->depth + k;
+  for(int k = 1; k <= d->depth; k++)
+    if(_is_slot_waiting(d, d->depth - k)) return d->depth - k;
+  return -1;
+}
+
+// must be called with the lock held
 static void _requeue_job(dt_slideshow_t *d)
 {
-  dt_control_add_job(DT_JOB_QUEUE_USER_BG, _process_job_create(d));
+  int waiting = 0;
+  for(int slot = 0; slot < d->nslots; slot++)
+    if(_is_slot_waiting(d, slot)) waiting++;
+
+  while(d->jobs < MIN(waiting, SLIDESHOW_MAX_JOBS))
+  {
+    d->jobs++;
+    if(!dt_control_add_job(DT_JOB_QUEUE_USER_BG, _process_job_create(d)))
+    {
+      d->jobs--;
+      break;
+    }
+  }
 }
 
 static void _set_delay(dt_slideshow_t *d,
@@ -190,8 +266,49 @@ static void _set_delay(dt_slideshow_t *d,
   dt_conf_set_int("slideshow_delay", d->delay);
 }
 
+// copy a cached mip if it is about the size of the screen
+static uint8_t *_mip_frame(const dt_imgid_t imgid,
+                           const size_t s_width,
+                           const size_t s_height,
+                           size_t *width,
+                           size_t *height)
+{
+  const dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(s_width, s_height);
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(&buf, imgid, mip, DT_MIPMAP_TESTLOCK, 'r');
+  if(!buf.buf) return NULL;
+
+  uint8_t *frame = NULL;
+  const gboolean fits = buf.width <= s_width && buf.height <= s_height;
+  const gboolean fills = buf.width >= SLIDESHOW_MIP_FILL * s_width
+                         || buf.height >= SLIDESHOW_MIP_FILL * s_height;
+  if(fits && fills
+     && (buf.color_space == DT_COLORSPACE_SRGB || buf.color_space == DT_COLORSPACE_ADOBERGB)
+     && (frame = dt_alloc_align_uint8((size_t)buf.width * buf.height * 4)))
+  {
+    // same display transform as the thumbnails
+    pthread_rwlock_rdlock(&darktable.color_profiles->xprofile_lock);
+    const dt_colorspaces_transform_t *transform =
+      buf.color_space == DT_COLORSPACE_SRGB
+      ? darktable.color_profiles->compiled_srgb_to_display
+      : darktable.color_profiles->compiled_adobe_rgb_to_display;
+    DT_OMP_FOR()
+    for(int row = 0; row < buf.height; row++)
+    {
+      const size_t offset = (size_t)row * buf.width * 4;
+      dt_colorspaces_transform_rgba8(transform, buf.buf + offset, frame + offset, buf.width);
+    }
+    pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
+
+    *width = buf.width;
+    *height = buf.height;
+  }
+  dt_mipmap_cache_release(&buf);
+  return frame;
+}
+
 static int _process_image(dt_slideshow_t *d,
-                          dt_slideshow_slot_t slot)
+                          const int slot)
 {
   dt_pthread_mutex_lock(&d->lock);
   d->exporting++;
@@ -199,50 +316,50 @@ static int _process_image(dt_slideshow_t *d,
   const size_t s_height = d->height;
   const dt_imgid_t imgid = d->buf[slot].imgid;
   size_t width, height;
-  uint8_t *buf = NULL;
 
   dt_pthread_mutex_unlock(&d->lock);
 
-  dt_dev_image(imgid,
-               d->width / darktable.gui->ppd,
-               d->height / darktable.gui->ppd,
-               -1,
-               &buf,
-               NULL,
-               &width,
-               &height,
-               NULL,
-               -1,
-               NULL,
-               DT_DEVICE_NONE,
-               FALSE,
-               FALSE);
+  uint8_t *buf = _mip_frame(imgid, s_width, s_height, &width, &height);
+  if(!buf)
+    dt_dev_image(imgid,
+                 s_width / darktable.gui->ppd,
+                 s_height / darktable.gui->ppd,
+                 -1,
+                 &buf,
+                 NULL,
+                 &width,
+                 &height,
+                 NULL,
+                 -1,
+                 NULL,
+                 DT_DEVICE_NONE,
+                 FALSE,
+                 FALSE);
 
   dt_pthread_mutex_lock(&d->lock);
 
-  // original slot for this image
-  dt_slideshow_slot_t slt = slot;
-
-  // check if we have not moved the slideshow forward or backward, if the
-  // slot is not the same, check for a possible new slot for this image.
-  if(d->buf[slt].imgid != imgid)
-    slt = _get_slot_for_image(d, imgid);
+  // check if we have not moved the slideshow forward or backward, the
+  // image may be in another slot now or not needed anymore.
+  const int slt = _get_slot_for_image(d, imgid);
 
   // also ensure that the screen has not been resized, otherwise we discard
   // the image. it will get regenerated in another later job.
-  if(slt != -1
-     && d->width == s_width
-     && d->height == s_height)
+  const gboolean same_size = d->width == s_width && d->height == s_height;
+  if(slt != -1 && same_size)
   {
     d->buf[slt].width = width;
     d->buf[slt].height = height;
     d->buf[slt].buf = buf;
     d->buf[slt].invalidated = FALSE;
+    d->buf[slt].processing = FALSE;
   }
   else
   {
-    // otherwise, just free the buffer which is now not needed
-    dt_free_align(buf);
+    if(slt != -1) d->buf[slt].processing = FALSE;
+    dt_slideshow_buf_t frame = { .buf = buf, .width = width, .height = height,
+                                 .imgid = imgid, .invalidated = !same_size || !buf };
+    // an image we stepped over, still good for going back
+    _keep_spare(d, &frame);
   }
 
   d->exporting--;
@@ -251,29 +368,18 @@ static int _process_image(dt_slideshow_t *d,
   return 0;
 }
 
-static gboolean _is_slot_waiting(const dt_slideshow_t *d,
-                                 const dt_slideshow_slot_t slot)
-{
-  return d->buf[slot].invalidated
-         && d->buf[slot].buf == NULL
-         && dt_is_valid_imgid(d->buf[slot].imgid)
-         && d->buf[slot].rank >= 0;
-}
-
-static gboolean _is_idle(const dt_slideshow_t *d)
-{
-  gboolean idle = TRUE;
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
-    idle &= !_is_slot_waiting(d, slot);
-  return idle;
-}
-
 static gboolean _auto_advance(gpointer user_data)
 {
   dt_slideshow_t *d = (dt_slideshow_t *)user_data;
   if(!d->auto_advance) return FALSE;
-  if(!_is_idle(d))
-    return TRUE; // never try to advance if still exporting, but call me back again
+
+  // never try to advance before the next image is there, but call me back again
+  dt_pthread_mutex_lock(&d->lock);
+  const dt_slideshow_buf_t *next = &d->buf[d->depth + 1];
+  const gboolean ready = !dt_is_valid_imgid(next->imgid) || (next->buf && !next->invalidated);
+  dt_pthread_mutex_unlock(&d->lock);
+  if(!ready) return TRUE;
+
   _step_state(d, S_REQUEST_STEP);
   return FALSE;
 }
@@ -283,41 +389,21 @@ static int32_t _process_job_run(dt_job_t *job)
   dt_slideshow_t *d = dt_control_job_get_params(job);
 
   dt_pthread_mutex_lock(&d->lock);
+  const int slot = _next_waiting_slot(d);
+  if(slot != -1) d->buf[slot].processing = TRUE;
+  dt_pthread_mutex_unlock(&d->lock);
 
-  if(_is_slot_waiting(d,S_CURRENT))
-  {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_CURRENT);
-    dt_control_queue_redraw_center();
-  }
-  else if(_is_slot_waiting(d, S_RIGHT_M))
-  {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_RIGHT_M);
-  }
-  else if(_is_slot_waiting(d, S_RIGHT))
-  {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_RIGHT);
-  }
-  else if(_is_slot_waiting(d, S_LEFT_M))
+  if(slot != -1)
   {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_LEFT_M);
-  }
-  else if(_is_slot_waiting(d, S_LEFT))
-  {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_LEFT);
-  }
-  else
-  {
-    dt_pthread_mutex_unlock(&d->lock);
+    _process_image(d, slot);
+    if(slot == d->depth) dt_control_queue_redraw_center();
   }
 
   // any other slot to fill?
-  if(!_is_idle(d))
-    _requeue_job(d);
+  dt_pthread_mutex_lock(&d->lock);
+  if(d->jobs > 0) d->jobs--;
+  _requeue_job(d);
+  dt_pthread_mutex_unlock(&d->lock);
 
   return 0;
 }
@@ -341,16 +427,9 @@ static void _step_state(dt_slideshow_t *d,
 
   if(event == S_REQUEST_STEP)
   {
-    if(d->buf[S_CURRENT].rank < d->col_count - 1)
+    if(_current(d)->rank < d->col_count - 1)
     {
       _shift_left(d);
-      d->buf[S_RIGHT].rank = d->buf[S_CURRENT].rank + 2;
-      d->buf[S_RIGHT].imgid = d->buf[S_RIGHT].rank < d->col_count
-        ? _get_image_at_rank(d->buf[S_RIGHT].rank)
-        : NO_IMGID;
-      d->buf[S_RIGHT].invalidated = TRUE;
-      dt_free_align(d->buf[S_RIGHT].buf);
-      d->buf[S_RIGHT].buf = NULL;
       refresh_display = TRUE;
       _requeue_job(d);
     }
@@ -362,16 +441,9 @@ static void _step_state(dt_slideshow_t *d,
   }
   else if(event == S_REQUEST_STEP_BACK)
   {
-    if(d->buf[S_CURRENT].rank > 0)
+    if(_current(d)->rank > 0)
     {
       _shift_right(d);
-      d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 2;
-      d->buf[S_LEFT].imgid = d->buf[S_LEFT].rank >= 0
-        ? _get_image_at_rank(d->buf[S_LEFT].rank)
-        : NO_IMGID;
-      d->buf[S_LEFT].invalidated = TRUE;
-      dt_free_align(d->buf[S_LEFT].buf);
-      d->buf[S_LEFT].buf = NULL;
       refresh_display = TRUE;
       _requeue_job(d);
     }
@@ -459,10 +531,13 @@ void enter(dt_view_t *self)
   d->width = rect.width * darktable.gui->ppd;
   d->height = rect.height * darktable.gui->ppd;
 
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
-  {
+  d->depth = CLAMP(dt_conf_get_int("slideshow_lookahead"), 1, SLIDESHOW_MAX_DEPTH);
+  d->nslots = 2 * d->depth + 1;
+  d->jobs = 0;
+  for(int slot = 0; slot < SLIDESHOW_MAX_SLOTS; slot++)
     _init_slot(&d->buf[slot]);
-  }
+  for(int k = 0; k < SLIDESHOW_MAX_DEPTH; k++)
+    _init_slot(&d->spare[k]);
 
   // if one selected start with it, otherwise start at the current lighttable offset
   const dt_imgid_t imgid = dt_act_on_get_main_image();
@@ -489,17 +564,11 @@ void enter(dt_view_t *self)
     ? dt_thumbtable_get_offset(dt_ui_thumbtable(darktable.gui->ui))
     : selrank;
 
-  d->buf[S_LEFT].rank    = rank - 2;
-  d->buf[S_LEFT_M].rank  = rank - 1;
-  d->buf[S_CURRENT].rank = rank;
-  d->buf[S_RIGHT_M].rank = rank + 1;
-  d->buf[S_RIGHT].rank   = rank + 2;
-
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
-    d->buf[slot].imgid = _get_image_at_rank(d->buf[slot].rank);
-
   d->col_count = dt_collection_get_count(darktable.collection);
 
+  for(int slot = 0; slot < d->nslots; slot++)
+    _fill_slot(d, &d->buf[slot], rank + slot - d->depth);
+
   d->auto_advance = FALSE;
   d->delay = dt_conf_get_int("slideshow_delay");
   // restart from beginning, will first increment counter by step and then prefetch
@@ -507,9 +576,11 @@ void enter(dt_view_t *self)
 
   gtk_widget_grab_focus(dt_ui_center(darktable.gui->ui));
 
-  // start first job
+  // start first jobs
   dt_control_queue_redraw_center();
-  dt_control_add_job(DT_JOB_QUEUE_USER_BG, _process_job_create(d));
+  dt_pthread_mutex_lock(&d->lock);
+  _requeue_job(d);
+  dt_pthread_mutex_unlock(&d->lock);
   dt_control_log(_("waiting to start slideshow"));
 }
 
@@ -527,14 +598,20 @@ void leave(dt_view_t *self)
   while(d->exporting > 0) sleep(1);
 
   dt_thumbtable_set_offset(dt_ui_thumbtable(darktable.gui->ui),
-                           d->buf[S_CURRENT].rank, FALSE);
+                           _current(d)->rank, FALSE);
 
   dt_pthread_mutex_lock(&d->lock);
 
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
+  // queued jobs which have not started yet find nothing to do
+  for(int slot = 0; slot < SLIDESHOW_MAX_SLOTS; slot++)
   {
     dt_free_align(d->buf[slot].buf);
-    d->buf[slot].buf = NULL;
+    _init_slot(&d->buf[slot]);
+  }
+  for(int k = 0; k < SLIDESHOW_MAX_DEPTH; k++)
+  {
+    dt_free_align(d->spare[k].buf);
+    _init_slot(&d->spare[k]);
   }
   dt_pthread_mutex_unlock(&d->lock);
 }
@@ -550,13 +627,15 @@ void expose(dt_view_t *self,
   dt_slideshow_t *d = self->data;
 
   dt_pthread_mutex_lock(&d->lock);
-  dt_slideshow_buf_t *slot = &(d->buf[S_CURRENT]);
+  dt_slideshow_buf_t *slot = _current(d);
   const dt_imgid_t imgid = slot->imgid;
 
   if(d->width < slot->width
      || d->height < slot->height)
   {
     slot->invalidated = TRUE;
+    dt_free_align(slot->buf);
+    slot->buf = NULL;
     _requeue_job(d);
   }
 
@@ -87,6 +87,9 @@ typedef struct dt_capture_t
   /** Cursor position for dragging the zoomed live view */
   double live_view_zoom_cursor_x, live_view_zoom_cursor_y;
 
+  /** The live view frame the histogram was computed for */
+  uint32_t live_view_histogram_frame;
+
   gboolean busy;
 } dt_capture_t;
 
@@ -245,27 +248,26 @@ static void _expose_tethered_mode(dt_view_t *self,
 
   if(cam->is_live_viewing == TRUE) // display the preview
   {
+    // the frames are decoded no larger than needed to fit the view
+    const float fit_w = (width - (MARGIN * 2.0f)) * darktable.gui->ppd;
+    const float fit_h = (height - (MARGIN * 2.0f) - BAR_HEIGHT) * darktable.gui->ppd;
+    cam->live_view_fit_width = cam->live_view_rotation % 2 == 0 ? fit_w : fit_h;
+    cam->live_view_fit_height = cam->live_view_rotation % 2 == 0 ? fit_h : fit_w;
+
     dt_pthread_mutex_lock(&cam->live_view_buffer_mutex);
-    if(cam->live_view_buffer)
+    if(cam->live_view_buffer && cam->live_view_display)
     {
       const gint pw = cam->live_view_width;
       const gint ph = cam->live_view_height;
       const uint8_t *const p_buf = cam->live_view_buffer;
 
-      // draw live view image
-      uint8_t *const tmp_i = dt_alloc_align_uint8(pw * ph * 4);
-      if(tmp_i)
+      // draw live view image, converted to the display profile by the
+      // camera thread already
       {
         const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, pw);
-        pthread_rwlock_rdlock(&darktable.color_profiles->xprofile_lock);
-        // FIXME: if liveview image is tagged and we can read its colorspace, use that
-        cmsDoTransformLineStride(darktable.color_profiles->transform_srgb_to_display,
-                                 p_buf, tmp_i, pw, ph, pw * 4,
-                                 stride, 0, 0);
-        pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
-
         cairo_surface_t *source
-            = dt_cairo_image_surface_create_for_data(tmp_i, CAIRO_FORMAT_RGB24,
+            = dt_cairo_image_surface_create_for_data(cam->live_view_display,
+                                                     CAIRO_FORMAT_RGB24,
                                                      pw, ph, stride);
         if(cairo_surface_status(source) == CAIRO_STATUS_SUCCESS)
         {
@@ -294,13 +296,15 @@ static void _expose_tethered_mode(dt_view_t *self,
           cairo_paint(cr);
         }
         cairo_surface_destroy(source);
-        dt_free_align(tmp_i);
       }
 
-      // process live view histogram
-      float *const tmp_f = dt_alloc_align_float((size_t)4 * pw * ph);
+      // process live view histogram, once per frame and not on each redraw
+      float *const tmp_f = lib->live_view_histogram_frame != cam->live_view_frame
+        ? dt_alloc_align_float((size_t)4 * pw * ph)
+        : NULL;
       if(tmp_f)
       {
+        lib->live_view_histogram_frame = cam->live_view_frame;
         dt_develop_t *dev = darktable.develop;
         // FIXME: add OpenMP
         for(size_t p = 0; p < (size_t)4 * pw * ph; p += 4)
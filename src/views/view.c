@@ -57,12 +57,260 @@ static int dt_view_load_module(void *v,
                                const char *module_name);
 static void dt_view_unload_module(dt_view_t *view);
 
+// upper limit of the memory used by display transformed thumbnail surfaces
+#define DT_VIEW_SURFACE_CACHE_MEM ((size_t)128 << 20)
+
+typedef struct _surface_cache_entry_t
+{
+  dt_imgid_t imgid;
+  dt_mipmap_size_t mip;
+  // the mipmap buffer the surface was made from and how it was transformed
+  const uint8_t *buf;
+  int32_t width, height;
+  dt_colorspaces_color_profile_type_t color_space;
+  gboolean color_managed;
+  cairo_surface_t *surface;
+  // focus peaking overlay of the surface, computed by a background job
+  cairo_surface_t *peaking;
+  gboolean peaking_job;
+} _surface_cache_entry_t;
+
+static const cairo_user_data_key_t _surface_data_key;
+
+static void _surface_cache_entry_free(_surface_cache_entry_t *entry)
+{
+  cairo_surface_destroy(entry->surface);
+  if(entry->peaking) cairo_surface_destroy(entry->peaking);
+  free(entry);
+}
+
+static size_t _surface_cache_entry_mem(const _surface_cache_entry_t *entry)
+{
+  return (size_t)entry->width * entry->height * 4;
+}
+
+// remove all surfaces of an image, or all of them for an invalid imgid
+static void _surface_cache_flush(dt_view_manager_t *vm,
+                                 const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&vm->surface_cache.lock);
+  GList *iter = vm->surface_cache.lru.head;
+  while(iter)
+  {
+    GList *next = g_list_next(iter);
+    _surface_cache_entry_t *entry = iter->data;
+    if(!dt_is_valid_imgid(imgid) || entry->imgid == imgid)
+    {
+      vm->surface_cache.mem -= _surface_cache_entry_mem(entry);
+      _surface_cache_entry_free(entry);
+      g_queue_delete_link(&vm->surface_cache.lru, iter);
+    }
+    iter = next;
+  }
+  dt_pthread_mutex_unlock(&vm->surface_cache.lock);
+}
+
+// returns a new reference to the cached surface for the mipmap buffer or NULL
+static cairo_surface_t *_surface_cache_get(dt_view_manager_t *vm,
+                                           const dt_mipmap_buffer_t *buf,
+                                           const gboolean color_managed)
+{
+  cairo_surface_t *surface = NULL;
+  dt_pthread_mutex_lock(&vm->surface_cache.lock);
+  for(GList *iter = vm->surface_cache.lru.head; iter; iter = g_list_next(iter))
+  {
+    _surface_cache_entry_t *entry = iter->data;
+    if(entry->imgid == buf->imgid && entry->mip == buf->size)
+    {
+      if(entry->buf == buf->buf
+         && entry->width == buf->width
+         && entry->height == buf->height
+         && entry->color_space == buf->color_space
+         && entry->color_managed == color_managed)
+      {
+        surface = cairo_surface_reference(entry->surface);
+        g_queue_unlink(&vm->surface_cache.lru, iter);
+        g_queue_push_head_link(&vm->surface_cache.lru, iter);
+      }
+      else
+      {
+        // the mipmap has been regenerated since
+        vm->surface_cache.mem -= _surface_cache_entry_mem(entry);
+        _surface_cache_entry_free(entry);
+        g_queue_delete_link(&vm->surface_cache.lru, iter);
+      }
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&vm->surface_cache.lock);
+  return surface;
+}
+
+static void _surface_cache_put(dt_view_manager_t *vm,
+                               const dt_mipmap_buffer_t *buf,
+                               const gboolean color_managed,
+                               cairo_surface_t *surface)
+{
+  _surface_cache_entry_t *entry = malloc(sizeof(_surface_cache_entry_t));
+  if(!entry) return;
+
+  entry->imgid = buf->imgid;
+  entry->mip = buf->size;
+  entry->buf = buf->buf;
+  entry->width = buf->width;
+  entry->height = buf->height;
+  entry->color_space = buf->color_space;
+  entry->color_managed = color_managed;
+  entry->surface = cairo_surface_reference(surface);
+  entry->peaking = NULL;
+  entry->peaking_job = FALSE;
+
+  dt_pthread_mutex_lock(&vm->surface_cache.lock);
+  g_queue_push_head(&vm->surface_cache.lru, entry);
+  vm->surface_cache.mem += _surface_cache_entry_mem(entry);
+  while(vm->surface_cache.mem > DT_VIEW_SURFACE_CACHE_MEM
+        && g_queue_get_length(&vm->surface_cache.lru) > 1)
+  {
+    _surface_cache_entry_t *old = g_queue_pop_tail(&vm->surface_cache.lru);
+    vm->surface_cache.mem -= _surface_cache_entry_mem(old);
+    _surface_cache_entry_free(old);
+  }
+  dt_pthread_mutex_unlock(&vm->surface_cache.lock);
+}
+
+typedef struct _focus_peaking_params_t
+{
+  dt_imgid_t imgid;
+  dt_mipmap_size_t mip;
+  cairo_surface_t *surface;
+  cairo_surface_t *peaking;
+} _focus_peaking_params_t;
+
+static _surface_cache_entry_t *_surface_cache_find(dt_view_manager_t *vm,
+                                                   const dt_imgid_t imgid,
+                                                   const dt_mipmap_size_t mip,
+                                                   const cairo_surface_t *surface)
+{
+  for(GList *iter = vm->surface_cache.lru.head; iter; iter = g_list_next(iter))
+  {
+    _surface_cache_entry_t *entry = iter->data;
+    if(entry->imgid == imgid && entry->mip == mip && entry->surface == surface)
+      return entry;
+  }
+  return NULL;
+}
+
+static int32_t _focus_peaking_job_run(dt_job_t *job)
+{
+  _focus_peaking_params_t *params = dt_control_job_get_params(job);
+  cairo_surface_t *surface = params->surface;
+
+  // skip the work if the surface has been evicted meanwhile
+  dt_view_manager_t *vm = darktable.view_manager;
+  dt_pthread_mutex_lock(&vm->surface_cache.lock);
+  const gboolean wanted = _surface_cache_find(vm, params->imgid, params->mip, surface) != NULL;
+  dt_pthread_mutex_unlock(&vm->surface_cache.lock);
+  if(!wanted) return 0;
+
+  params->peaking = dt_focuspeaking_surface(cairo_image_surface_get_width(surface),
+                                            cairo_image_surface_get_height(surface),
+                                            cairo_image_surface_get_data(surface));
+  return 0;
+}
+
+static void _focus_peaking_params_free(void *data)
+{
+  _focus_peaking_params_t *params = data;
+  dt_view_manager_t *vm = darktable.view_manager;
+
+  // hand the overlay to the cache entry, the thumbnail asking for it
+  // again picks it up
+  dt_pthread_mutex_lock(&vm->surface_cache.lock);
+  _surface_cache_entry_t *entry =
+    _surface_cache_find(vm, params->imgid, params->mip, params->surface);
+  if(entry)
+  {
+    entry->peaking_job = FALSE;
+    if(params->peaking && !entry->peaking)
+    {
+      entry->peaking = params->peaking;
+      params->peaking = NULL;
+    }
+  }
+  dt_pthread_mutex_unlock(&vm->surface_cache.lock);
+
+  if(params->peaking) cairo_surface_destroy(params->peaking);
+  cairo_surface_destroy(params->surface);
+  free(params);
+}
+
+// returns a new reference to the focus peaking overlay of a cached surface,
+// or NULL and starts computing it in the background
+static cairo_surface_t *_surface_cache_peaking(dt_view_manager_t *vm,
+                                               const dt_imgid_t imgid,
+                                               const dt_mipmap_size_t mip,
+                                               cairo_surface_t *surface)
+{
+  cairo_surface_t *peaking = NULL;
+  gboolean start = FALSE;
+  dt_pthread_mutex_lock(&vm->surface_cache.lock);
+  _surface_cache_entry_t *entry = _surface_cache_find(vm, imgid, mip, surface);
+  if(entry && entry->peaking)
+    peaking = cairo_surface_reference(entry->peaking);
+  else if(entry && !entry->peaking_job)
+    start = entry->peaking_job = TRUE;
+  dt_pthread_mutex_unlock(&vm->surface_cache.lock);
+
+  if(start)
+  {
+    _focus_peaking_params_t *params = calloc(1, sizeof(_focus_peaking_params_t));
+    dt_job_t *job = params
+      ? dt_control_job_create(&_focus_peaking_job_run, "focus peaking %d", imgid)
+      : NULL;
+    if(job)
+    {
+      params->imgid = imgid;
+      params->mip = mip;
+      params->surface = cairo_surface_reference(surface);
+      dt_control_job_set_params(job, params, _focus_peaking_params_free);
+      dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, job);
+    }
+    else
+    {
+      free(params);
+      dt_pthread_mutex_lock(&vm->surface_cache.lock);
+      entry = _surface_cache_find(vm, imgid, mip, surface);
+      if(entry) entry->peaking_job = FALSE;
+      dt_pthread_mutex_unlock(&vm->surface_cache.lock);
+    }
+  }
+  return peaking;
+}
+
+static void _surface_cache_mipmap_updated(gpointer instance,
+                                          const dt_imgid_t imgid,
+                                          dt_view_manager_t *vm)
+{
+  _surface_cache_flush(vm, imgid);
+}
+
+static void _surface_cache_profile_changed(gpointer instance,
+                                           dt_view_manager_t *vm)
+{
+  _surface_cache_flush(vm, NO_IMGID);
+}
+
+static void _surface_cache_profile_user_changed(gpointer instance,
+                                                const uint8_t profile_type,
+                                                dt_view_manager_t *vm)
+{
+  if(profile_type == DT_COLORSPACES_PROFILE_TYPE_DISPLAY)
+    _surface_cache_flush(vm, NO_IMGID);
+}
+
 void dt_view_manager_init(dt_view_manager_t *vm)
 {
   /* prepare statements */
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT imgid FROM main.selected_images "
-                              "WHERE imgid = ?1", -1, &vm->statements.is_selected, NULL);
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "DELETE FROM main.selected_images WHERE imgid = ?1",
                               -1, &vm->statements.delete_from_selected, NULL);
@@ -92,6 +340,16 @@ void dt_view_manager_init(dt_view_manager_t *vm)
 
   vm->current_view = NULL;
   vm->audio.audio_player_id = -1;
+
+  g_queue_init(&vm->surface_cache.lru);
+  vm->surface_cache.mem = 0;
+  dt_pthread_mutex_init(&vm->surface_cache.lock, NULL);
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED,
+                            _surface_cache_mipmap_updated, vm);
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_CONTROL_PROFILE_CHANGED,
+                            _surface_cache_profile_changed, vm);
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_CONTROL_PROFILE_USER_CHANGED,
+                            _surface_cache_profile_user_changed, vm);
 }
 
 void dt_view_manager_cleanup(dt_view_manager_t *vm)
@@ -103,6 +361,9 @@ void dt_view_manager_cleanup(dt_view_manager_t *vm)
 
   g_list_free_full(vm->views, free);
   vm->views = NULL;
+  DT_CONTROL_SIGNAL_DISCONNECT_ALL(vm, "view manager");
+  _surface_cache_flush(vm, NO_IMGID);
+  dt_pthread_mutex_destroy(&vm->surface_cache.lock);
 }
 
 const dt_view_t *dt_view_manager_get_current_view(const dt_view_manager_t *vm)
@@ -878,15 +1139,24 @@ dt_view_surface_value_t dt_view_image_get_surface_cached(const dt_imgid_t imgid,
   scale = fmaxf(img_width / (float)buf_wd, img_height / (float)buf_ht);
   *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, img_width, img_height);
 
-  // we transfer cached image on a cairo_surface (with colorspace transform if needed)
-  cairo_surface_t *tmp_surface = NULL;
-  uint8_t *rgbbuf = calloc((size_t)buf_wd * buf_ht * 4, sizeof(uint8_t));
+  // we transfer cached image on a cairo_surface (with colorspace transform if needed).
+  // surfaces of the exact mip are kept, so scrolling over the same images
+  // again only needs to paint them
+  const gboolean color_managed = dt_conf_get_bool("cache_color_managed");
+  const gboolean cacheable = mip == buf.size && buf_wd > 30;
+  cairo_surface_t *tmp_surface = cacheable
+    ? _surface_cache_get(darktable.view_manager, &buf, color_managed)
+    : NULL;
+  const gboolean from_cache = tmp_surface != NULL;
+  gboolean peaking_pending = FALSE;
+  uint8_t *rgbbuf = from_cache ? NULL : calloc((size_t)buf_wd * buf_ht * 4, sizeof(uint8_t));
   if(rgbbuf)
   {
     gboolean have_lock = FALSE;
     cmsHTRANSFORM transform = NULL;
+    const dt_colorspaces_transform_t *compiled = NULL;
 
-    if(dt_conf_get_bool("cache_color_managed"))
+    if(color_managed)
     {
       pthread_rwlock_rdlock(&darktable.color_profiles->xprofile_lock);
       have_lock = TRUE;
@@ -897,11 +1167,13 @@ dt_view_surface_value_t dt_view_image_get_surface_cached(const dt_imgid_t imgid,
          && darktable.color_profiles->transform_srgb_to_display)
       {
         transform = darktable.color_profiles->transform_srgb_to_display;
+        compiled = darktable.color_profiles->compiled_srgb_to_display;
       }
       else if(buf.color_space == DT_COLORSPACE_ADOBERGB
               && darktable.color_profiles->transform_adobe_rgb_to_display)
       {
         transform = darktable.color_profiles->transform_adobe_rgb_to_display;
+        compiled = darktable.color_profiles->compiled_adobe_rgb_to_display;
       }
       else
       {
@@ -930,7 +1202,11 @@ dt_view_surface_value_t dt_view_image_get_surface_cached(const dt_imgid_t imgid,
       const uint8_t *in = buf.buf + i * buf.width * 4;
       uint8_t *out = rgbbuf + i * buf.width * 4;
 
-      if(transform)
+      if(compiled)
+      {
+        dt_colorspaces_transform_rgba8(compiled, in, out, buf.width);
+      }
+      else if(transform)
       {
         cmsDoTransform(transform, in, out, buf.width);
       }
@@ -951,6 +1227,15 @@ dt_view_surface_value_t dt_view_image_get_surface_cached(const dt_imgid_t imgid,
     tmp_surface = cairo_image_surface_create_for_data(rgbbuf,
                                                       CAIRO_FORMAT_RGB24,
                                                       buf_wd, buf_ht, stride);
+    // the surface owns the pixels from now on
+    if(cairo_surface_status(tmp_surface) != CAIRO_STATUS_SUCCESS
+       || cairo_surface_set_user_data(tmp_surface, &_surface_data_key, rgbbuf, free)
+          != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy(tmp_surface);
+      tmp_surface = NULL;
+      free(rgbbuf);
+    }
   }
 
   // draw the image scaled:
@@ -990,59 +1275,52 @@ dt_view_surface_value_t dt_view_image_get_surface_cached(const dt_imgid_t imgid,
        organized as a rectangle without a stride, So we pass the raw
        data to be processed, this is more data but correct.
     */
-    if(darktable.gui->show_focus_peaking && mip == buf.size)
-      dt_focuspeaking(cr, buf_wd, buf_ht, rgbbuf);
+    if(cacheable && !from_cache)
+      _surface_cache_put(darktable.view_manager, &buf, color_managed, tmp_surface);
+
+    // cached surfaces get their overlay from a background job, until it
+    // is there the surface is reported as not final so it is asked for again
+    if(darktable.gui->show_focus_peaking && cacheable)
+    {
+      cairo_surface_t *peaking =
+        _surface_cache_peaking(darktable.view_manager, imgid, mip, tmp_surface);
+      if(peaking)
+      {
+        dt_focuspeaking_paint(cr, peaking);
+        cairo_surface_destroy(peaking);
+      }
+      else
+        peaking_pending = TRUE;
+    }
+    else if(darktable.gui->show_focus_peaking && mip == buf.size)
+      dt_focuspeaking(cr, buf_wd, buf_ht, cairo_image_surface_get_data(tmp_surface));
 
-    cairo_surface_destroy(tmp_surface);
     cairo_destroy(cr);
 
     // Cache the native-resolution surface so future zoom events at the
     // same mip level can skip the expensive mipmap fetch + color conversion.
     // Only cache when we have the exact mip (not a fallback standin) and
     // the image is not a skull/error placeholder.
-    if(mip_cache && mip == buf.size && buf_wd > 30)
+    if(mip_cache && cacheable)
     {
       if(*mip_cache && cairo_surface_get_reference_count(*mip_cache) > 0)
         cairo_surface_destroy(*mip_cache);
-      *mip_cache = cairo_image_surface_create(CAIRO_FORMAT_RGB24, buf_wd, buf_ht);
-      if(*mip_cache && cairo_surface_status(*mip_cache) == CAIRO_STATUS_SUCCESS)
-      {
-        // Reconstruct the tmp_surface content from rgbbuf into the cached surface.
-        // We use create_for_data here (cheap, no extra alloc) since rgbbuf is still
-        // live at this point.
-        const int32_t cache_stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, buf_wd);
-        cairo_surface_t *src = cairo_image_surface_create_for_data(
-            rgbbuf, CAIRO_FORMAT_RGB24, buf_wd, buf_ht, cache_stride);
-        if(src && cairo_surface_status(src) == CAIRO_STATUS_SUCCESS)
-        {
-          cairo_t *cr_cache = cairo_create(*mip_cache);
-          cairo_set_source_surface(cr_cache, src, 0, 0);
-          cairo_pattern_set_filter(cairo_get_source(cr_cache), CAIRO_FILTER_NEAREST);
-          cairo_paint(cr_cache);
-          cairo_destroy(cr_cache);
-          cairo_surface_destroy(src);
-        }
-        else
-        {
-          if(src) cairo_surface_destroy(src);
-          cairo_surface_destroy(*mip_cache);
-          *mip_cache = NULL;
-        }
-      }
+      *mip_cache = cairo_surface_reference(tmp_surface);
       if(mip_cache_level) *mip_cache_level = mip;
     }
+
+    cairo_surface_destroy(tmp_surface);
   }
 
   // we consider skull/error as ok as the image hasn't to be reload
   if(buf_wd <= 30 && buf_ht <= 30)
     ret = DT_VIEW_SURFACE_OK;
-  else if(mip != buf.size)
+  else if(mip != buf.size || peaking_pending)
     ret = DT_VIEW_SURFACE_SMALLER;
   else
     ret = DT_VIEW_SURFACE_OK;
 
   dt_mipmap_cache_release(&buf);
-  if(rgbbuf) free(rgbbuf);
 
   // logs
   if(darktable.unmuted & DT_DEBUG_PERF)
@@ -1119,14 +1397,7 @@ char* dt_view_extend_modes_str(const char * name,
 void dt_view_set_selection(const dt_imgid_t imgid,
                            const int value)
 {
-  /* clear and reset statement */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.is_selected);
-  DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.is_selected);
-
-  /* setup statement and iterate over rows */
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.is_selected, 1, imgid);
-
-  if(sqlite3_step(darktable.view_manager->statements.is_selected) == SQLITE_ROW)
+  if(dt_selection_is_selected(darktable.selection, imgid))
   {
     if(!value)
     {
@@ -1164,13 +1435,7 @@ void dt_view_set_selection(const dt_imgid_t imgid,
  */
 void dt_view_toggle_selection(const dt_imgid_t imgid)
 {
-  /* clear and reset statement */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.is_selected);
-  DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.is_selected);
-
-  /* setup statement and iterate over rows */
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.is_selected, 1, imgid);
-  if(sqlite3_step(darktable.view_manager->statements.is_selected) == SQLITE_ROW)
+  if(dt_selection_is_selected(darktable.selection, imgid))
   {
     /* clear and reset statement */
     DT_DEBUG_SQLITE3_CLEAR_BINDINGS
@@ -1997,12 +2262,15 @@ void dt_view_paint_surface(cairo_t *cr,
   const double cov_trans_x = (offset_x - reach_x) * processed_width * buf_scale - 0.5 * buf_width;
   const double cov_trans_y = (offset_y - reach_y) * processed_height * buf_scale - 0.5 * buf_height;
 
+  // a coarse progressive pass is painted upscaled until the full pass arrives
+  const float buf_full_scale = buf_scale * MAX(1, port->pipe->backbuf_progressive);
+
   // Check if we should use the preview pipe for fallback rendering
   // This is only valid for the main develop (not for pinned images which have dev != darktable.develop)
   const gboolean use_preview_fallback =
     (dev == darktable.develop) && pp->output_imgid == dev->image_storage.id &&
     (port->pipe->output_imgid != dev->image_storage.id ||
-     fabsf(backbuf_scale / buf_scale - 1.0f) > .09f ||
+     fabsf(backbuf_scale / buf_full_scale - 1.0f) > .09f ||
      floor(maxw / 2 / back_scale) - 1 > MIN(-cov_trans_x, cov_trans_x + buf_width) ||
      floor(maxh / 2 / back_scale) - 1 > MIN(-cov_trans_y, cov_trans_y + buf_height)) &&
     (port == &dev->full || port == &dev->preview2);
@@ -2068,8 +2336,23 @@ void dt_view_paint_surface(cairo_t *cr,
     if(darktable.gui->show_focus_peaking
       && window != DT_WINDOW_SLIDESHOW)
     {
-      dt_focuspeaking(cr, buf_width, buf_height,
-                      cairo_image_surface_get_data(surface));
+      // the overlay only depends on the backbuf, keep it for redraws of
+      // the center view caused by pointer moves and overlays
+      const uint32_t key[] = { (uint32_t)buf_width, (uint32_t)buf_height,
+                               (uint32_t)port->pipe->backbuf_progressive };
+      const dt_hash_t hash = buf == port->pipe->backbuf
+                             && port->pipe->backbuf_hash != DT_INVALID_HASH
+        ? dt_hash(port->pipe->backbuf_hash, key, sizeof(key))
+        : DT_INVALID_HASH;
+
+      if(hash == DT_INVALID_HASH || hash != port->focus_peaking_hash || !port->focus_peaking)
+      {
+        if(port->focus_peaking) cairo_surface_destroy(port->focus_peaking);
+        port->focus_peaking = dt_focuspeaking_surface(buf_width, buf_height,
+                                                      cairo_image_surface_get_data(surface));
+        port->focus_peaking_hash = hash;
+      }
+      dt_focuspeaking_paint(cr, port->focus_peaking);
     }
     cairo_surface_destroy(surface);
   }
@@ -240,8 +240,6 @@ typedef struct dt_view_manager_t
   {
     /* select num from history where imgid = ?1*/
     sqlite3_stmt *have_history;
-    /* select * from selected_images where imgid = ?1 */
-    sqlite3_stmt *is_selected;
     /* delete from selected_images where imgid = ?1 */
     sqlite3_stmt *delete_from_selected;
     /* insert into selected_images values (?1) */
@@ -265,6 +263,14 @@ typedef struct dt_view_manager_t
   // toolbox containers
   GtkWidget *module_toolbox, *view_toolbox;
 
+  // display transformed thumbnail surfaces at their mip size, most recently used first
+  struct
+  {
+    GQueue lru;
+    size_t mem;
+    dt_pthread_mutex_t lock;
+  } surface_cache;
+
   /*
    * Proxy
    */
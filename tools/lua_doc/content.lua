@@ -1035,6 +1035,13 @@ local widget = dt.new_widget("button"){
 	events["post-import-image"].callback:add_parameter("image",types.dt_lua_image_t,[[The image object that has been imported.]])
 	events["post-import-image"].extra_registration_parameters:set_text([[This event has no extra registration parameters.]])
 
+	events["post-import-batch"]:set_text([[This event is triggered for the newly imported images, a batch of them at a time. It gets the same images as post-import-image, but with one call for up to 256 images, which keeps large imports fast.
+
+	This event can be registered multiple times, all callbacks will be called. The call is not blocking, it comes shortly after the images of the batch are imported.]])
+	events["post-import-batch"].callback:add_parameter("event","string",[[The name of the event that triggered the callback.]])
+	events["post-import-batch"].callback:add_parameter("images","table of types.dt_lua_image_t",[[The images that have been imported.]])
+	events["post-import-batch"].extra_registration_parameters:set_text([[This event has no extra registration parameters.]])
+
 
 	events["shortcut"]:set_text([[This event registers a new keyboard shortcut. The shortcut isn't bound to any key until the users does so in the preference panel.
 
@@ -1071,7 +1078,7 @@ local widget = dt.new_widget("button"){
 	events["global_toolbox-overlay_toggle"].callback:add_parameter("toggle", "boolean", [[the new overlay status.]]);
 	events["global_toolbox-overlay_toggle"].extra_registration_parameters:set_text([[This event has no extra registration parameters.]])
 
-  events["mouse-over-image-changed"]:set_text([[This event is triggered whenever the image under the mouse changes]])
+  events["mouse-over-image-changed"]:set_text([[This event is triggered whenever the image under the mouse changes. Changes happening while the callbacks are still pending are merged into one call with the latest image.]])
 	events["mouse-over-image-changed"].callback:add_parameter("event","string",[[The name of the event that triggered the callback.]])
   events["mouse-over-image-changed"].callback:add_parameter("image",types.dt_lua_image_t,[[The new image under the mouse, can be nil if there is no image under the mouse]])
 	events["mouse-over-image-changed"].extra_registration_parameters:set_text([[This event has no extra registration parameters.]])